@@ -0,0 +1,473 @@
+/***********************************************************************************************************************
+ * Copyright (C) 2016 Andrew Zonenberg and contributors                                                                *
+ *                                                                                                                     *
+ * This program is free software; you can redistribute it and/or modify it under the terms of the GNU Lesser General   *
+ * Public License as published by the Free Software Foundation; either version 2.1 of the License, or (at your option) *
+ * any later version.                                                                                                  *
+ *                                                                                                                     *
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied  *
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for     *
+ * more details.                                                                                                       *
+ *                                                                                                                     *
+ * You should have received a copy of the GNU Lesser General Public License along with this program; if not, you may   *
+ * find one here:                                                                                                      *
+ * https://www.gnu.org/licenses/old-licenses/lgpl-2.1.txt                                                              *
+ * or you may search the http://www.gnu.org website for the version 2.1 license, or you may write to the Free Software *
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA                                      *
+ **********************************************************************************************************************/
+
+#include "gp4bench.h"
+#include <algorithm>
+#include <cmath>
+
+using namespace std;
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Construction / destruction
+
+/**
+	@brief Default shape: a bit bigger than the SLG46620, three quarters full
+ */
+SyntheticDeviceOptions::SyntheticDeviceOptions()
+	: matrices(2)
+	, labels(4)
+	, sitesPerLabel(8)
+	, crossConnections(10)
+	, dedicatedDensity(0.05)
+	, fill(0.75)
+	, inputs(3)
+	, fanout(3)
+	, locality(0.9)
+	, seed(1)
+{
+}
+
+SyntheticDevice::SyntheticDevice(const SyntheticDeviceOptions& options)
+	: m_options(options)
+	, m_random(options.seed)
+	, m_ngraph(NULL)
+	, m_dgraph(NULL)
+	, m_dedicatedPort(PARGraph::InternPort("IN0"))
+	, m_dedicatedCount(0)
+	, m_edgeCount(0)
+{
+}
+
+SyntheticDevice::~SyntheticDevice()
+{
+	delete m_ngraph;
+	m_ngraph = NULL;
+	delete m_dgraph;
+	m_dgraph = NULL;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Generation
+
+/**
+	@brief Builds the device and netlist graphs
+
+	@return True on success, false if the options don't describe a device PAR can handle
+ */
+bool SyntheticDevice::Generate()
+{
+	m_ngraph = new PARGraph;
+	m_dgraph = new PARGraph;
+	if(!GenerateDevice())
+		return false;
+	GenerateNetlist();
+
+	//Same finishing touches as BuildGraphs()
+	m_ngraph->Freeze();
+	m_dgraph->Freeze();
+	m_ngraph->IndexNodesByLabel();
+	m_dgraph->IndexNodesByLabel();
+	m_lmap.IndexSites(m_dgraph, m_options.matrices, [this](PARGraphNode* site)
+	{
+		return m_siteMatrix[site->GetIndex()];
+	});
+
+	LogVerbose("Generated %u sites in %u matrices (%u dedicated routes), %u cells, %u edges\n",
+		m_dgraph->GetNumNodes(), m_options.matrices, m_dedicatedCount, m_ngraph->GetNumNodes(), m_edgeCount);
+	return true;
+}
+
+/**
+	@brief Creates the sites, matrix by matrix, and the dedicated routes between them
+ */
+bool SyntheticDevice::GenerateDevice()
+{
+	if( (m_options.matrices == 0) || (m_options.labels == 0) || (m_options.sitesPerLabel == 0) ||
+		(m_options.inputs == 0) )
+	{
+		LogError("Synthetic device must have at least one matrix, site type, site and input\n");
+		return false;
+	}
+	if( (m_options.fill < 0) || (m_options.fill > 1) )
+	{
+		LogError("Synthetic device fill must be between 0 and 1\n");
+		return false;
+	}
+
+	//Mates are 16 bits and one value means "none"
+	uint64_t per_matrix = static_cast<uint64_t>(m_options.labels) * m_options.sitesPerLabel;
+	uint64_t total = per_matrix * m_options.matrices;
+	if(total >= PARGraph::NO_MATE)
+	{
+		LogError("Synthetic device would have %llu sites, PAR can't handle more than %u\n",
+			static_cast<unsigned long long>(total), PARGraph::NO_MATE - 1);
+		return false;
+	}
+
+	for(unsigned int l=0; l<m_options.labels; l++)
+		m_labels.push_back(AllocateLabel(m_ngraph, m_dgraph, m_lmap, "CELL" + to_string(l)));
+
+	//Every site can reach every other site in its matrix over the fabric
+	vector<string> inputs;
+	for(unsigned int j=0; j<m_options.inputs; j++)
+		inputs.push_back("IN" + to_string(j));
+	for(unsigned int m=0; m<m_options.matrices; m++)
+	{
+		for(auto label : m_labels)
+		{
+			for(unsigned int s=0; s<m_options.sitesPerLabel; s++)
+			{
+				PARGraphNode* site = m_dgraph->CreateNode(label, NULL);
+				site->AddFabricOutput("OUT");
+				for(auto& port : inputs)
+					site->AddFabricInput(port);
+				m_siteMatrix.push_back(m);
+			}
+		}
+	}
+
+	//Give each site about the requested share of the sites in other matrices as dedicated destinations. Sites are in
+	//matrix order, so the others are everything outside our block.
+	uint32_t others = total - per_matrix;
+	double expected = m_options.dedicatedDensity * others;
+	m_dedicatedRoutes.resize(total);
+	for(uint32_t i=0; (i<total) && (others > 0); i++)
+	{
+		uint32_t count = floor(expected);
+		if(m_random.NextUnit() < (expected - count))
+			count ++;
+
+		uint32_t block = m_siteMatrix[i] * per_matrix;
+		vector<uint32_t>& routes = m_dedicatedRoutes[i];
+		for(uint32_t k=0; k<count; k++)
+		{
+			uint32_t dst = m_random.NextBelow(others);
+			if(dst >= block)
+				dst += per_matrix;
+			routes.push_back(dst);
+		}
+		sort(routes.begin(), routes.end());
+		routes.erase(unique(routes.begin(), routes.end()), routes.end());
+
+		PARGraphNode* src = m_dgraph->GetNodeByIndex(i);
+		for(auto dst : routes)
+			src->AddEdge("OUT", m_dgraph->GetNodeByIndex(dst), "IN0");
+		m_dedicatedCount += routes.size();
+	}
+
+	return true;
+}
+
+/**
+	@brief Fills the device with cells in one cluster per matrix, mostly connected within their own cluster
+ */
+void SyntheticDevice::GenerateNetlist()
+{
+	//Deal the cells of each type out to the clusters evenly, so a cluster always fits in one matrix
+	vector< vector<PARGraphNode*> > clusters(m_options.matrices);
+	uint32_t per_label = lround(m_options.fill * m_options.sitesPerLabel * m_options.matrices);
+	for(auto label : m_labels)
+	{
+		for(uint32_t i=0; i<per_label; i++)
+			clusters[i % m_options.matrices].push_back(m_ngraph->CreateNode(label, NULL));
+	}
+
+	//Pick which cells of each cluster drive a net, so that each net has about the requested number of loads
+	vector< vector<PARGraphNode*> > drivers(clusters.size());
+	for(size_t c=0; c<clusters.size(); c++)
+	{
+		if(clusters[c].empty())
+			continue;
+		drivers[c] = clusters[c];
+		Shuffle(drivers[c], m_random);
+		size_t nets = lround(clusters[c].size() * m_options.inputs / max(m_options.fanout, 1.0));
+		drivers[c].resize(min(max(nets, static_cast<size_t>(1)), clusters[c].size()));
+	}
+
+	//Then hook every input up to a driver in the same cluster, or now and then a random other one
+	for(size_t c=0; c<clusters.size(); c++)
+	{
+		for(auto node : clusters[c])
+		{
+			for(unsigned int j=0; j<m_options.inputs; j++)
+			{
+				size_t dc = c;
+				if( (clusters.size() > 1) && (m_random.NextUnit() >= m_options.locality) )
+					dc = (c + 1 + m_random.NextBelow(clusters.size() - 1)) % clusters.size();
+				if(drivers[dc].empty())
+					dc = c;
+				vector<PARGraphNode*>& candidates = drivers[dc];
+
+				//Don't feed a cell back to itself, unless there's nothing else to use
+				size_t k = m_random.NextBelow(candidates.size());
+				PARGraphNode* driver = candidates[k];
+				if( (driver == node) && (candidates.size() > 1) )
+					driver = candidates[(k + 1) % candidates.size()];
+
+				driver->AddEdge("OUT", node, "IN" + to_string(j));
+				m_edgeCount ++;
+			}
+		}
+	}
+}
+
+/**
+	@brief Checks if there's a dedicated route from one site to an input of another (by device node index)
+ */
+bool SyntheticDevice::HasDedicatedRoute(uint32_t src, uint32_t dst, uint16_t dstport) const
+{
+	if(dstport != m_dedicatedPort)
+		return false;
+	const vector<uint32_t>& routes = m_dedicatedRoutes[src];
+	return binary_search(routes.begin(), routes.end(), dst);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// PAR engine: construction / destruction
+
+SyntheticPAREngine::SyntheticPAREngine(PARGraph* netlist, PARGraph* device, const SyntheticDevice* model)
+	: PARModelEngine<SyntheticPAREngine>(netlist, device)
+	, m_model(model)
+	, m_siteMatrix(model->GetSiteMatrices())
+	, m_matrixCount(model->GetOptions().matrices)
+	, m_crossCapacity(model->GetOptions().crossConnections)
+{
+	//Moves between matrices only make sense if there's more than one
+	if(m_matrixCount > 1)
+		AddMoveGenerator(new PARClusterMoveGenerator);
+}
+
+SyntheticPAREngine::~SyntheticPAREngine()
+{
+
+}
+
+PAREngine* SyntheticPAREngine::CreateReplica(PARGraph* netlist, PARGraph* device)
+{
+	return new SyntheticPAREngine(netlist, device, m_model);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// PAR engine: placement
+
+/**
+	@brief Puts each cell at a random site of its type (using the generator's seed, so runs are repeatable)
+ */
+bool SyntheticPAREngine::InitialPlacement_core()
+{
+	PARRandom random(m_model->GetOptions().seed);
+	for(uint32_t label=0; label<=m_netlist->GetMaxLabel(); label++)
+	{
+		uint32_t ncells = m_netlist->GetNumNodesWithLabel(label);
+		vector<PARGraphNode*> sites;
+		for(uint32_t i=0; i<m_device->GetNumNodesWithLabel(label); i++)
+			sites.push_back(m_device->GetNodeByLabelAndIndex(label, i));
+		if(ncells > sites.size())
+		{
+			LogError("Synthetic netlist has %u cells of type %u, device only has %zu\n", ncells, label, sites.size());
+			return false;
+		}
+
+		Shuffle(sites, random);
+		for(uint32_t i=0; i<ncells; i++)
+			m_netlist->GetNodeByLabelAndIndex(label, i)->MateWith(sites[i]);
+	}
+	return true;
+}
+
+/**
+	@brief Returns the netlist nodes on either end of an unroutable edge, or one using a cross connection
+ */
+void SyntheticPAREngine::FindSubOptimalPlacements(std::vector<PARGraphNode*>& bad_nodes)
+{
+	bad_nodes = m_badNodes;
+}
+
+void SyntheticPAREngine::InitBadNodeCache()
+{
+	m_edgeBad.assign(m_netlistEdges.size(), 0);
+	m_nodeBadEdges.assign(m_netlist->GetNumNodes(), 0);
+	m_badNodes.clear();
+	m_badNodeSlots.assign(m_netlist->GetNumNodes(), -1);
+
+	for(uint32_t i=0; i<m_netlistEdges.size(); i++)
+		UpdateEdgeBadness(i);
+}
+
+void SyntheticPAREngine::UpdateBadNodeCache(PARGraphNode* a, PARGraphNode* b)
+{
+	if(a != NULL)
+	{
+		for(auto i : m_nodeEdges[a->GetIndex()])
+			UpdateEdgeBadness(i);
+	}
+	if( (b != NULL) && (b != a) )
+	{
+		for(auto i : m_nodeEdges[b->GetIndex()])
+			UpdateEdgeBadness(i);
+	}
+}
+
+/**
+	@brief Recomputes whether one edge is bad, and moves its endpoints in or out of the bad node list to match
+ */
+void SyntheticPAREngine::UpdateEdgeBadness(uint32_t edge)
+{
+	PARGraphEdge* nedge = m_netlistEdges[edge];
+	PARGraphNode* src = nedge->m_sourcenode->GetMate();
+	PARGraphNode* dst = nedge->m_destnode->GetMate();
+	uint8_t bad = !IsEdgeRoutable(nedge, src, dst) || (EdgeCongestionBin(nedge) >= 0);
+	if(bad == m_edgeBad[edge])
+		return;
+	m_edgeBad[edge] = bad;
+
+	PARGraphNode* ends[2] = {nedge->m_sourcenode, nedge->m_destnode};
+	for(auto node : ends)
+	{
+		uint32_t index = node->GetIndex();
+		if(bad)
+		{
+			if(m_nodeBadEdges[index]++ == 0)
+			{
+				m_badNodeSlots[index] = m_badNodes.size();
+				m_badNodes.push_back(node);
+			}
+		}
+		else if(--m_nodeBadEdges[index] == 0)
+		{
+			//Swap the last node into our slot
+			int32_t slot = m_badNodeSlots[index];
+			PARGraphNode* last = m_badNodes.back();
+			m_badNodes[slot] = last;
+			m_badNodeSlots[last->GetIndex()] = slot;
+			m_badNodes.pop_back();
+			m_badNodeSlots[index] = -1;
+		}
+	}
+}
+
+/**
+	@brief Picks a site in the matrix of one of the node's neighbors (or any other matrix, if it's next to them
+	already)
+ */
+PARGraphNode* SyntheticPAREngine::GetNewPlacementForNode(PARGraphNode* pivot)
+{
+	uint32_t label = pivot->GetLabel();
+	uint32_t current_matrix = m_siteMatrix[pivot->GetMate()->GetIndex()];
+
+	uint32_t matrix = m_random.NextBelow(m_matrixCount);
+	auto& edges = m_nodeEdges[pivot->GetIndex()];
+	if(!edges.empty())
+	{
+		PARGraphEdge* edge = m_netlistEdges[edges[m_random.NextBelow(edges.size())]];
+		PARGraphNode* neighbor = (edge->m_sourcenode == pivot) ? edge->m_destnode : edge->m_sourcenode;
+		matrix = m_siteMatrix[neighbor->GetMate()->GetIndex()];
+	}
+	if( (matrix == current_matrix) && (m_matrixCount > 1) )
+		matrix = (current_matrix + 1 + m_random.NextBelow(m_matrixCount - 1)) % m_matrixCount;
+
+	return SampleSite(matrix, label);
+}
+
+/**
+	@brief Picks a site for a node in the same matrix as another site (for moving clusters between matrices)
+ */
+PARGraphNode* SyntheticPAREngine::GetNewPlacementNear(PARGraphNode* node, PARGraphNode* site)
+{
+	uint32_t matrix = m_siteMatrix[site->GetIndex()];
+	if(m_siteMatrix[node->GetMate()->GetIndex()] == matrix)
+		return NULL;
+	return SampleSite(matrix, node->GetLabel());
+}
+
+/**
+	@brief Picks a random site of one type in one matrix, or NULL if there aren't any
+ */
+PARGraphNode* SyntheticPAREngine::SampleSite(uint32_t matrix, uint32_t label)
+{
+	auto& sites = m_model->GetLabelMap().GetSites(label, matrix);
+	if(sites.empty())
+		return NULL;
+	return m_device->GetNodeByIndex(sites[m_random.NextBelow(sites.size())]);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// PAR engine: congestion metrics
+
+uint32_t SyntheticPAREngine::GetCongestionBinCount()
+{
+	return m_matrixCount * m_matrixCount;
+}
+
+/**
+	@brief Finds the cross connection an edge needs (called from the innermost cost loop, see PARModelEngine)
+ */
+int32_t SyntheticPAREngine::EdgeCongestionBin(PARGraphEdge* edge)
+{
+	uint32_t src = edge->m_sourcenode->GetMate()->GetIndex();
+	uint32_t dst = edge->m_destnode->GetMate()->GetIndex();
+	uint32_t msrc = m_siteMatrix[src];
+	uint32_t mdst = m_siteMatrix[dst];
+	if( (msrc == mdst) || m_model->HasDedicatedRoute(src, dst, edge->m_destport) )
+		return -1;
+	return msrc*m_matrixCount + mdst;
+}
+
+/**
+	@brief All edges of a net share one cross connection
+ */
+uint32_t SyntheticPAREngine::EdgeCongestionNet(PARGraphEdge* edge)
+{
+	return edge->m_net;
+}
+
+/**
+	@brief Same as Greenpak4PAREngine::ComputeCongestionCostFromBins(), less the congestion history
+ */
+uint32_t SyntheticPAREngine::ComputeCongestionCostFromBins(const vector<uint32_t>& bins)
+{
+	uint32_t sum = 0;
+	for(auto b : bins)
+		sum += b*b;
+	uint32_t cost = sqrt(sum);
+
+	for(auto b : bins)
+	{
+		if(b > m_crossCapacity)
+			cost += (b - m_crossCapacity) * 10;
+	}
+	return cost;
+}
+
+uint32_t SyntheticPAREngine::GetCongestionBinCapacity(uint32_t /*bin*/)
+{
+	return m_crossCapacity;
+}
+
+/**
+	@brief Each routing matrix is a region for multi-level placement
+ */
+uint32_t SyntheticPAREngine::GetRegionCount()
+{
+	return m_matrixCount;
+}
+
+uint32_t SyntheticPAREngine::GetSiteRegion(PARGraphNode* site)
+{
+	return m_siteMatrix[site->GetIndex()];
+}
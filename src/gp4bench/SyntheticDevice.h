@@ -0,0 +1,172 @@
+/***********************************************************************************************************************
+ * Copyright (C) 2016 Andrew Zonenberg and contributors                                                                *
+ *                                                                                                                     *
+ * This program is free software; you can redistribute it and/or modify it under the terms of the GNU Lesser General   *
+ * Public License as published by the Free Software Foundation; either version 2.1 of the License, or (at your option) *
+ * any later version.                                                                                                  *
+ *                                                                                                                     *
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied  *
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for     *
+ * more details.                                                                                                       *
+ *                                                                                                                     *
+ * You should have received a copy of the GNU Lesser General Public License along with this program; if not, you may   *
+ * find one here:                                                                                                      *
+ * https://www.gnu.org/licenses/old-licenses/lgpl-2.1.txt                                                              *
+ * or you may search the http://www.gnu.org website for the version 2.1 license, or you may write to the Free Software *
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA                                      *
+ **********************************************************************************************************************/
+
+#ifndef SyntheticDevice_h
+#define SyntheticDevice_h
+
+/**
+	@brief Shape of a generated device, and of the netlist generated to fill it
+ */
+class SyntheticDeviceOptions
+{
+public:
+	SyntheticDeviceOptions();
+
+	///Number of routing matrices
+	unsigned int matrices;
+
+	///Number of different site types
+	unsigned int labels;
+
+	///Number of sites of each type in each matrix
+	unsigned int sitesPerLabel;
+
+	///Number of cross connections from each matrix to each other matrix
+	unsigned int crossConnections;
+
+	///Fraction of (source, destination) pairs of sites in different matrices joined by a dedicated route
+	double dedicatedDensity;
+
+	///Fraction of the sites to fill with netlist cells
+	double fill;
+
+	///Number of inputs on each site (and cell)
+	unsigned int inputs;
+
+	///Average number of loads on each net
+	double fanout;
+
+	///Fraction of net loads in the same cluster of cells as the driver (there's one cluster per matrix)
+	double locality;
+
+	uint32_t seed;
+};
+
+/**
+	@brief A made-up device of identical routing matrices, and a random netlist sized to fill it.
+
+	Every site has one output and the same number of inputs, all on the fabric of its matrix. Routes between matrices
+	use a cross connection, unless there's a dedicated route between the two sites. This keeps the model simple enough
+	to scale the device far beyond the real parts, for seeing how PAR time grows with device size.
+ */
+class SyntheticDevice
+{
+public:
+	SyntheticDevice(const SyntheticDeviceOptions& options);
+	~SyntheticDevice();
+
+	bool Generate();
+
+	PARGraph* GetNetlistGraph()
+	{ return m_ngraph; }
+
+	PARGraph* GetDeviceGraph()
+	{ return m_dgraph; }
+
+	const PARLabelRegistry& GetLabelMap() const
+	{ return m_lmap; }
+
+	const SyntheticDeviceOptions& GetOptions() const
+	{ return m_options; }
+
+	///Matrix each device site is in, by node index
+	const std::vector<uint32_t>& GetSiteMatrices() const
+	{ return m_siteMatrix; }
+
+	bool HasDedicatedRoute(uint32_t src, uint32_t dst, uint16_t dstport) const;
+
+	uint32_t GetEdgeCount()
+	{ return m_edgeCount; }
+
+	uint32_t GetDedicatedRouteCount()
+	{ return m_dedicatedCount; }
+
+protected:
+	bool GenerateDevice();
+	void GenerateNetlist();
+
+	SyntheticDeviceOptions m_options;
+	PARRandom m_random;
+
+	PARGraph* m_ngraph;
+	PARGraph* m_dgraph;
+	PARLabelRegistry m_lmap;
+	std::vector<uint32_t> m_labels;
+
+	std::vector<uint32_t> m_siteMatrix;
+
+	//Destination sites of the dedicated routes from each site, sorted (they all go to input 0)
+	std::vector< std::vector<uint32_t> > m_dedicatedRoutes;
+	uint16_t m_dedicatedPort;
+	uint32_t m_dedicatedCount;
+
+	uint32_t m_edgeCount;
+};
+
+/**
+	@brief PAR engine for a SyntheticDevice.
+
+	Same cost model as Greenpak4PAREngine (without the congestion history): one congestion bin per pair of matrices,
+	regions are matrices, and moves look for sites in the matrix of a neighbor.
+ */
+class SyntheticPAREngine : public PARModelEngine<SyntheticPAREngine>
+{
+	friend class PARModelEngine<SyntheticPAREngine>;
+
+public:
+	SyntheticPAREngine(PARGraph* netlist, PARGraph* device, const SyntheticDevice* model);
+	virtual ~SyntheticPAREngine();
+
+protected:
+	virtual PAREngine* CreateReplica(PARGraph* netlist, PARGraph* device);
+
+	virtual bool InitialPlacement_core();
+
+	virtual void FindSubOptimalPlacements(std::vector<PARGraphNode*>& bad_nodes);
+	virtual void InitBadNodeCache();
+	virtual void UpdateBadNodeCache(PARGraphNode* a, PARGraphNode* b);
+	void UpdateEdgeBadness(uint32_t edge);
+
+	virtual PARGraphNode* GetNewPlacementForNode(PARGraphNode* pivot);
+	virtual PARGraphNode* GetNewPlacementNear(PARGraphNode* node, PARGraphNode* site);
+	PARGraphNode* SampleSite(uint32_t matrix, uint32_t label);
+
+	virtual uint32_t GetCongestionBinCount();
+	int32_t EdgeCongestionBin(PARGraphEdge* edge);
+	uint32_t EdgeCongestionNet(PARGraphEdge* edge);
+	virtual uint32_t ComputeCongestionCostFromBins(const std::vector<uint32_t>& bins);
+	virtual uint32_t GetCongestionBinCapacity(uint32_t bin);
+
+	virtual uint32_t GetRegionCount();
+	virtual uint32_t GetSiteRegion(PARGraphNode* site);
+
+	const SyntheticDevice* m_model;
+	const std::vector<uint32_t>& m_siteMatrix;
+	uint32_t m_matrixCount;
+	uint32_t m_crossCapacity;
+
+	//Whether each netlist edge is unroutable or crosses matrices, and how many such edges each node has
+	std::vector<uint8_t> m_edgeBad;
+	std::vector<uint32_t> m_nodeBadEdges;
+
+	//Nodes with at least one bad edge, and where each node is in the list (-1 if not there)
+	std::vector<PARGraphNode*> m_badNodes;
+	std::vector<int32_t> m_badNodeSlots;
+};
+
+#endif
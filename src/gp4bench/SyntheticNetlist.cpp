@@ -0,0 +1,203 @@
+/***********************************************************************************************************************
+ * Copyright (C) 2016 Andrew Zonenberg and contributors                                                                *
+ *                                                                                                                     *
+ * This program is free software; you can redistribute it and/or modify it under the terms of the GNU Lesser General   *
+ * Public License as published by the Free Software Foundation; either version 2.1 of the License, or (at your option) *
+ * any later version.                                                                                                  *
+ *                                                                                                                     *
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied  *
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for     *
+ * more details.                                                                                                       *
+ *                                                                                                                     *
+ * You should have received a copy of the GNU Lesser General Public License along with this program; if not, you may   *
+ * find one here:                                                                                                      *
+ * https://www.gnu.org/licenses/old-licenses/lgpl-2.1.txt                                                              *
+ * or you may search the http://www.gnu.org website for the version 2.1 license, or you may write to the Free Software *
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA                                      *
+ **********************************************************************************************************************/
+
+#include "gp4bench.h"
+#include <algorithm>
+#include <cmath>
+
+using namespace std;
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Construction / destruction
+
+/**
+	@brief Default shape: about three quarters of the SLG46620's logic, with a little of everything
+ */
+SyntheticNetlistOptions::SyntheticNetlistOptions()
+	: lut2(6)
+	, lut3(12)
+	, lut4(2)
+	, dff(10)
+	, count8(4)
+	, fanout(3)
+	, locDensity(0.1)
+	, seed(1)
+{
+}
+
+SyntheticNetlist::SyntheticNetlist(Greenpak4Device* device, const SyntheticNetlistOptions& options)
+	: m_device(device)
+	, m_options(options)
+	, m_random(options.seed)
+	, m_ngraph(NULL)
+	, m_dgraph(NULL)
+	, m_edgeCount(0)
+{
+}
+
+SyntheticNetlist::~SyntheticNetlist()
+{
+	delete m_ngraph;
+	m_ngraph = NULL;
+	delete m_dgraph;
+	m_dgraph = NULL;
+
+	for(auto cell : m_cells)
+		delete cell;
+	m_cells.clear();
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Generation
+
+/**
+	@brief Builds the netlist and device graphs
+
+	@return True on success, false if the requested cells don't fit in the device
+ */
+bool SyntheticNetlist::Generate()
+{
+	//Labels have to match the device graph, so allocate them the same way a real compile does
+	m_ngraph = new PARGraph;
+	m_dgraph = MakeDeviceGraph(m_device, m_ngraph, m_lmap);
+	for(uint32_t label=0; label<m_lmap.GetNumLabels(); label++)
+		m_ilmap[m_lmap.GetName(label)] = label;
+
+	//Create the cells
+	vector<string> lut_inputs = {"IN0", "IN1", "IN2", "IN3"};
+	if(!AddCells("GP_2LUT", m_options.lut2, vector<string>(lut_inputs.begin(), lut_inputs.begin() + 2), "OUT"))
+		return false;
+	if(!AddCells("GP_3LUT", m_options.lut3, vector<string>(lut_inputs.begin(), lut_inputs.begin() + 3), "OUT"))
+		return false;
+	if(!AddCells("GP_4LUT", m_options.lut4, lut_inputs, "OUT"))
+		return false;
+	if(!AddCells("GP_DFF", m_options.dff, {"D", "CLK"}, "Q"))
+		return false;
+	if(!AddCells("GP_COUNT8", m_options.count8, {"RST"}, "OUT"))
+		return false;
+	if(m_ngraph->GetNumNodes() == 0)
+	{
+		LogError("Synthetic netlist must have at least one cell\n");
+		return false;
+	}
+
+	//Pick which cells drive a net, so that each net has about the requested number of loads
+	vector<PARGraphNode*> drivers;
+	for(uint32_t i=0; i<m_ngraph->GetNumNodes(); i++)
+		drivers.push_back(m_ngraph->GetNodeByIndex(i));
+	Shuffle(drivers, m_random);
+	size_t nets = lround(m_sinks.size() / max(m_options.fanout, 1.0));
+	nets = min(max(nets, static_cast<size_t>(1)), drivers.size());
+	drivers.resize(nets);
+
+	//Then deal the inputs out to them at random
+	Shuffle(m_sinks, m_random);
+	for(size_t i=0; i<m_sinks.size(); i++)
+	{
+		//Don't feed a cell back to itself, unless there's nothing else to use
+		Sink& sink = m_sinks[i];
+		PARGraphNode* driver = drivers[i % nets];
+		if( (driver == sink.m_node) && (nets > 1) )
+			driver = drivers[(i + 1) % nets];
+
+		driver->AddEdge(m_outputs[driver->GetIndex()], sink.m_node, sink.m_port);
+		m_edgeCount ++;
+	}
+
+	//Same finishing touches as BuildGraphs()
+	m_ngraph->Freeze();
+	m_dgraph->Freeze();
+	m_ngraph->IndexNodesByLabel();
+	m_dgraph->IndexNodesByLabel();
+
+	LogVerbose("Generated %u cells (%zu with LOC constraints), %zu nets, %u edges\n",
+		m_ngraph->GetNumNodes(), m_lockedSites.size(), nets, m_edgeCount);
+	return true;
+}
+
+/**
+	@brief Creates some cells of one type
+
+	@param type		Primitive name (must be a label of the device graph)
+	@param count	Number of cells to create
+	@param inputs	Input ports of the cell, all of which get connected to something
+	@param output	Output port of the cell
+ */
+bool SyntheticNetlist::AddCells(
+	const string& type,
+	unsigned int count,
+	const vector<string>& inputs,
+	const string& output)
+{
+	if(count == 0)
+		return true;
+
+	if(m_ilmap.find(type) == m_ilmap.end())
+	{
+		LogError("Device has no sites for %s\n", type.c_str());
+		return false;
+	}
+	uint32_t label = m_ilmap[type];
+
+	//Find the sites we could be placed at
+	vector<PARGraphNode*> sites;
+	for(uint32_t i=0; i<m_dgraph->GetNumNodes(); i++)
+	{
+		PARGraphNode* site = m_dgraph->GetNodeByIndex(i);
+		if(site->MatchesLabel(label))
+			sites.push_back(site);
+	}
+	if(count > sites.size())
+	{
+		LogError("Can't make %u %s cells, device only has %zu\n", count, type.c_str(), sites.size());
+		return false;
+	}
+	Shuffle(sites, m_random);
+
+	//Sites of other types can hold some of ours (e.g. a COUNT14 can hold a COUNT8). LOC to our own type first, so
+	//we don't take a site something else needs.
+	stable_partition(sites.begin(), sites.end(), [label](PARGraphNode* site) { return site->GetLabel() == label; });
+
+	for(unsigned int i=0; i<count; i++)
+	{
+		Greenpak4NetlistCell* cell = new Greenpak4NetlistCell(NULL);
+		cell->m_type = type;
+		cell->m_name = type + "_" + to_string(i);
+		m_cells.push_back(cell);
+
+		PARGraphNode* node = m_ngraph->CreateNode(label, cell);
+		cell->m_parnode = node;
+		m_outputs.push_back(output);
+		for(auto port : inputs)
+			m_sinks.push_back(Sink{node, port});
+
+		//Pin some of the cells to sites nobody else is pinned to
+		if(m_random.NextUnit() >= m_options.locDensity)
+			continue;
+		for(auto site : sites)
+		{
+			if(m_lockedSites.find(site) != m_lockedSites.end())
+				continue;
+			m_lockedSites.insert(site);
+			cell->m_attributes["LOC"] = static_cast<Greenpak4BitstreamEntity*>(site->GetData())->GetDescription();
+			break;
+		}
+	}
+
+	return true;
+}
@@ -0,0 +1,115 @@
+/***********************************************************************************************************************
+ * Copyright (C) 2016 Andrew Zonenberg and contributors                                                                *
+ *                                                                                                                     *
+ * This program is free software; you can redistribute it and/or modify it under the terms of the GNU Lesser General   *
+ * Public License as published by the Free Software Foundation; either version 2.1 of the License, or (at your option) *
+ * any later version.                                                                                                  *
+ *                                                                                                                     *
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied  *
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for     *
+ * more details.                                                                                                       *
+ *                                                                                                                     *
+ * You should have received a copy of the GNU Lesser General Public License along with this program; if not, you may   *
+ * find one here:                                                                                                      *
+ * https://www.gnu.org/licenses/old-licenses/lgpl-2.1.txt                                                              *
+ * or you may search the http://www.gnu.org website for the version 2.1 license, or you may write to the Free Software *
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA                                      *
+ **********************************************************************************************************************/
+
+#ifndef SyntheticNetlist_h
+#define SyntheticNetlist_h
+
+#include <set>
+
+/**
+	@brief Shape of a generated netlist
+ */
+class SyntheticNetlistOptions
+{
+public:
+	SyntheticNetlistOptions();
+
+	//Number of cells of each type
+	unsigned int lut2;
+	unsigned int lut3;
+	unsigned int lut4;
+	unsigned int dff;
+	unsigned int count8;
+
+	///Average number of loads on each net
+	double fanout;
+
+	///Fraction of cells with a LOC constraint (to a random legal site)
+	double locDensity;
+
+	uint32_t seed;
+};
+
+/**
+	@brief A random netlist of LUTs, flipflops and counters, built straight into PAR graphs.
+
+	The cells don't belong to any module and have no parameters, so this is only good for exercising PAR and routing,
+	not for generating a bitstream.
+ */
+class SyntheticNetlist
+{
+public:
+	SyntheticNetlist(Greenpak4Device* device, const SyntheticNetlistOptions& options);
+	~SyntheticNetlist();
+
+	bool Generate();
+
+	PARGraph* GetNetlistGraph()
+	{ return m_ngraph; }
+
+	PARGraph* GetDeviceGraph()
+	{ return m_dgraph; }
+
+	PARLabelRegistry& GetLabelMap()
+	{ return m_lmap; }
+
+	const std::vector<Greenpak4NetlistCell*>& GetCells()
+	{ return m_cells; }
+
+	uint32_t GetEdgeCount()
+	{ return m_edgeCount; }
+
+protected:
+	/**
+		@brief One input port of a cell, waiting for something to drive it
+	 */
+	struct Sink
+	{
+		PARGraphNode* m_node;
+		std::string m_port;
+	};
+
+	bool AddCells(
+		const std::string& type,
+		unsigned int count,
+		const std::vector<std::string>& inputs,
+		const std::string& output);
+
+	Greenpak4Device* m_device;
+	SyntheticNetlistOptions m_options;
+	PARRandom m_random;
+
+	PARGraph* m_ngraph;
+	PARGraph* m_dgraph;
+	PARLabelRegistry m_lmap;
+	ilabelmap m_ilmap;
+
+	//Cells we created (we own them, since there's no module to)
+	std::vector<Greenpak4NetlistCell*> m_cells;
+
+	//Output port of each netlist node (by index), and all of the inputs
+	std::vector<std::string> m_outputs;
+	std::vector<Sink> m_sinks;
+
+	//Device sites already used by a LOC constraint
+	std::set<PARGraphNode*> m_lockedSites;
+
+	uint32_t m_edgeCount;
+};
+
+#endif
@@ -0,0 +1,564 @@
+/***********************************************************************************************************************
+ * Copyright (C) 2016 Andrew Zonenberg and contributors                                                                *
+ *                                                                                                                     *
+ * This program is free software; you can redistribute it and/or modify it under the terms of the GNU Lesser General   *
+ * Public License as published by the Free Software Foundation; either version 2.1 of the License, or (at your option) *
+ * any later version.                                                                                                  *
+ *                                                                                                                     *
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied  *
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for     *
+ * more details.                                                                                                       *
+ *                                                                                                                     *
+ * You should have received a copy of the GNU Lesser General Public License along with this program; if not, you may   *
+ * find one here:                                                                                                      *
+ * https://www.gnu.org/licenses/old-licenses/lgpl-2.1.txt                                                              *
+ * or you may search the http://www.gnu.org website for the version 2.1 license, or you may write to the Free Software *
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA                                      *
+ **********************************************************************************************************************/
+
+#include "gp4bench.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+using namespace std;
+
+/**
+	@brief All of the runs of one design, summarized (this is also what the baseline stores)
+ */
+struct CorpusDesign
+{
+	string m_name;
+	unsigned int m_runs;
+	unsigned int m_successes;
+
+	//Median time spent in each phase over all runs, in ms
+	double m_load;
+	double m_par;
+	double m_commit;
+
+	///Median number of annealing iterations
+	double m_iterations;
+
+	///Highest peak RSS of any run, in KB
+	long m_peakRSS;
+};
+
+/**
+	@brief How much worse than the baseline a design can get before we call it a regression
+ */
+struct CorpusThresholds
+{
+	///Allowed increase in phase times, as a fraction of the baseline
+	double m_time;
+
+	///Allowed increase in phase times regardless of the fraction, in ms (small designs are mostly noise)
+	double m_timeSlack;
+
+	///Allowed increase in peak RSS, as a fraction of the baseline
+	double m_memory;
+
+	///Allowed increase in annealing iterations, as a fraction of the baseline
+	double m_iterations;
+};
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Running the compiles
+
+/**
+	@brief Total time spent in some phases of a compile, in seconds
+ */
+static double GetPhaseTime(const CompileStatistics& stats, const vector<string>& names)
+{
+	double seconds = 0;
+	for(auto& phase : stats.phases)
+	{
+		if(find(names.begin(), names.end(), phase.first) != names.end())
+			seconds += phase.second;
+	}
+	return seconds;
+}
+
+/**
+	@brief Compiles a netlist in a child process, so we can measure its peak memory use by itself
+
+	@param options		What to compile
+	@param verbosity	Console log level for the compile
+	@param run			Set to the results. A compile that crashes counts as a failed run.
+
+	@return True if the compile ran (whether or not it succeeded), false if we couldn't start it
+ */
+bool RunCompile(const CompileOptions& options, Severity verbosity, CorpusRun& run)
+{
+	int fds[2];
+	if(pipe(fds) != 0)
+	{
+		LogError("Couldn't create pipe: %s\n", strerror(errno));
+		return false;
+	}
+
+	fflush(stdout);
+	pid_t pid = fork();
+	if(pid < 0)
+	{
+		LogError("Couldn't fork: %s\n", strerror(errno));
+		close(fds[0]);
+		close(fds[1]);
+		return false;
+	}
+
+	//In the child: compile, send the results back, and leave without running any of the parent's exit handlers
+	if(pid == 0)
+	{
+		close(fds[0]);
+		g_log_sinks.clear();
+		g_log_sinks.emplace_back(new STDLogSink(verbosity));
+
+		CompileResult result;
+		bool ok = CompileFile(options, result);
+		uint32_t iterations = 0;
+		for(auto& anneal : result.stats.par.anneals)
+			iterations += anneal.iterations;
+
+		FILE* fp = fdopen(fds[1], "w");
+		fprintf(fp, "%d %.9f %.9f %.9f %u\n",
+			ok,
+			GetPhaseTime(result.stats, {"read_netlist", "load_netlist"}),
+			GetPhaseTime(result.stats, {"placement"}),
+			GetPhaseTime(result.stats, {"commit"}),
+			iterations);
+		fclose(fp);
+		fflush(stdout);
+		_exit(0);
+	}
+
+	//In the parent: collect the results
+	close(fds[1]);
+	FILE* fp = fdopen(fds[0], "r");
+	int ok = 0;
+	int fields = fscanf(fp, "%d %lf %lf %lf %u", &ok, &run.m_load, &run.m_par, &run.m_commit, &run.m_iterations);
+	fclose(fp);
+
+	int status;
+	struct rusage usage;
+	if(wait4(pid, &status, 0, &usage) < 0)
+	{
+		LogError("Couldn't wait for compile: %s\n", strerror(errno));
+		return false;
+	}
+	run.m_peakRSS = usage.ru_maxrss;
+
+	run.m_ok = (fields == 5) && ok;
+	if(fields != 5)
+	{
+		LogError("Compile of %s crashed\n", options.netlistFile.c_str());
+		run.m_load = run.m_par = run.m_commit = 0;
+		run.m_iterations = 0;
+	}
+	return true;
+}
+
+double Median(vector<double> values)
+{
+	if(values.empty())
+		return 0;
+	sort(values.begin(), values.end());
+	size_t mid = values.size() / 2;
+	if(values.size() % 2)
+		return values[mid];
+	return (values[mid - 1] + values[mid]) / 2;
+}
+
+static CorpusDesign Summarize(const string& name, const vector<CorpusRun>& runs)
+{
+	CorpusDesign design = {name, static_cast<unsigned int>(runs.size()), 0, 0, 0, 0, 0, 0};
+
+	vector<double> load;
+	vector<double> par;
+	vector<double> commit;
+	vector<double> iterations;
+	for(auto& run : runs)
+	{
+		if(run.m_ok)
+			design.m_successes ++;
+		load.push_back(run.m_load * 1000);
+		par.push_back(run.m_par * 1000);
+		commit.push_back(run.m_commit * 1000);
+		iterations.push_back(run.m_iterations);
+		design.m_peakRSS = max(design.m_peakRSS, run.m_peakRSS);
+	}
+
+	design.m_load = Median(load);
+	design.m_par = Median(par);
+	design.m_commit = Median(commit);
+	design.m_iterations = Median(iterations);
+	return design;
+}
+
+/**
+	@brief Gets the design name from a netlist file name (the file name without its directory or extension)
+ */
+static string GetDesignName(const string& fname)
+{
+	string name = fname;
+	size_t slash = name.find_last_of('/');
+	if(slash != string::npos)
+		name = name.substr(slash + 1);
+	size_t dot = name.rfind(".json");
+	if(dot != string::npos)
+		name = name.substr(0, dot);
+	return name;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Results and baselines
+
+static void WriteResults(
+	FILE* fp,
+	Greenpak4Device::GREENPAK4_PART part,
+	unsigned int seeds,
+	const vector<CorpusDesign>& designs)
+{
+	unsigned int runs = 0;
+	unsigned int successes = 0;
+	for(auto& d : designs)
+	{
+		runs += d.m_runs;
+		successes += d.m_successes;
+	}
+
+	fprintf(fp, "{\n");
+	fprintf(fp, "    \"part\": \"%s\",\n", GetPartName(part).c_str());
+	fprintf(fp, "    \"seeds\": %u,\n", seeds);
+	fprintf(fp, "    \"success_rate\": %.4f,\n", runs ? (successes / static_cast<double>(runs)) : 0.0);
+	fprintf(fp, "    \"designs\": [");
+	for(size_t i=0; i<designs.size(); i++)
+	{
+		auto& d = designs[i];
+		fprintf(fp, "%s\n        {\"name\": ", i ? "," : "");
+		WriteJSONString(fp, d.m_name);
+		fprintf(fp, ", \"runs\": %u, \"successes\": %u, \"load_ms\": %.3f, \"par_ms\": %.3f, \"commit_ms\": %.3f, "
+			"\"iterations\": %.1f, \"peak_rss_kb\": %ld}",
+			d.m_runs,
+			d.m_successes,
+			d.m_load,
+			d.m_par,
+			d.m_commit,
+			d.m_iterations,
+			d.m_peakRSS);
+	}
+	fprintf(fp, "\n    ]\n");
+	fprintf(fp, "}\n");
+}
+
+/**
+	@brief Reads the designs back out of a file written by WriteResults()
+ */
+static bool ReadBaseline(const string& fname, vector<CorpusDesign>& designs)
+{
+	FILE* fp = fopen(fname.c_str(), "r");
+	if(!fp)
+	{
+		LogError("Couldn't open baseline %s\n", fname.c_str());
+		return false;
+	}
+
+	Greenpak4JSONReader reader(fp);
+	string name;
+	reader.BeginObject();
+	while(reader.NextMember(name))
+	{
+		if(name != "designs")
+		{
+			reader.SkipValue();
+			continue;
+		}
+
+		reader.BeginArray();
+		while(reader.NextElement())
+		{
+			CorpusDesign d = {"", 0, 0, 0, 0, 0, 0, 0};
+			string field;
+			string value;
+			reader.BeginObject();
+			while(reader.NextMember(field))
+			{
+				if(field == "name")
+				{
+					reader.ReadString(d.m_name);
+					continue;
+				}
+
+				reader.ReadScalar(value);
+				if(field == "runs")
+					d.m_runs = strtoul(value.c_str(), NULL, 10);
+				else if(field == "successes")
+					d.m_successes = strtoul(value.c_str(), NULL, 10);
+				else if(field == "load_ms")
+					d.m_load = atof(value.c_str());
+				else if(field == "par_ms")
+					d.m_par = atof(value.c_str());
+				else if(field == "commit_ms")
+					d.m_commit = atof(value.c_str());
+				else if(field == "iterations")
+					d.m_iterations = atof(value.c_str());
+				else if(field == "peak_rss_kb")
+					d.m_peakRSS = strtol(value.c_str(), NULL, 10);
+			}
+			designs.push_back(d);
+		}
+	}
+
+	bool ok = reader.Validate();
+	fclose(fp);
+	if(!ok)
+		LogError("Baseline %s is malformed\n", fname.c_str());
+	return ok;
+}
+
+/**
+	@brief Checks one number against its baseline
+
+	@return True if it's within the threshold
+ */
+static bool CheckMetric(
+	const string& design,
+	const char* metric,
+	double value,
+	double baseline,
+	double fraction,
+	double slack)
+{
+	if(value <= baseline * (1 + fraction) + slack)
+		return true;
+
+	LogError("%s: %s went from %.1f to %.1f (more than %.0f%% worse)\n",
+		design.c_str(), metric, baseline, value, fraction * 100);
+	return false;
+}
+
+/**
+	@brief Compares our results to a baseline
+
+	@return Number of regressions found
+ */
+static unsigned int CompareToBaseline(
+	const vector<CorpusDesign>& designs,
+	const vector<CorpusDesign>& baseline,
+	const CorpusThresholds& thresholds)
+{
+	unsigned int regressions = 0;
+	for(auto& d : designs)
+	{
+		auto it = find_if(baseline.begin(), baseline.end(),
+			[&](const CorpusDesign& b) { return b.m_name == d.m_name; });
+		if(it == baseline.end())
+		{
+			LogNotice("%s: not in the baseline\n", d.m_name.c_str());
+			continue;
+		}
+		const CorpusDesign& b = *it;
+
+		//Anything that used to route more often than it does now is a regression, no matter by how little
+		if( (b.m_runs != 0) && (d.m_successes * b.m_runs < b.m_successes * d.m_runs) )
+		{
+			LogError("%s: success rate went from %u/%u to %u/%u\n",
+				d.m_name.c_str(), b.m_successes, b.m_runs, d.m_successes, d.m_runs);
+			regressions ++;
+		}
+
+		double time = thresholds.m_time;
+		double slack = thresholds.m_timeSlack;
+		if(!CheckMetric(d.m_name, "load time (ms)", d.m_load, b.m_load, time, slack))
+			regressions ++;
+		if(!CheckMetric(d.m_name, "PAR time (ms)", d.m_par, b.m_par, time, slack))
+			regressions ++;
+		if(!CheckMetric(d.m_name, "commit time (ms)", d.m_commit, b.m_commit, time, slack))
+			regressions ++;
+		if(!CheckMetric(d.m_name, "iterations", d.m_iterations, b.m_iterations, thresholds.m_iterations, 0))
+			regressions ++;
+		if(!CheckMetric(d.m_name, "peak RSS (KB)", d.m_peakRSS, b.m_peakRSS, thresholds.m_memory, 0))
+			regressions ++;
+	}
+
+	return regressions;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Entry point
+
+int CorpusMain(int argc, char* argv[])
+{
+	Severity console_verbosity = Severity::NOTICE;
+
+	Greenpak4Device::GREENPAK4_PART part = Greenpak4Device::GREENPAK4_SLG46620;
+	vector<string> netlists;
+
+	//Number of seeds to compile each design with, and the first one
+	unsigned int seeds = 3;
+	uint32_t first_seed = 1;
+
+	//Baseline to compare against (empty = don't), and where to write the results (empty = stdout)
+	string baselineFile = "";
+	string outputFile = "";
+
+	CorpusThresholds thresholds = {0.25, 5, 0.15, 0.25};
+
+	//Parse command-line arguments (argv[1] is --corpus)
+	for(int i=2; i<argc; i++)
+	{
+		string s(argv[i]);
+		const char* arg = NULL;
+
+		//Let the logger eat its args first
+		if(ParseLoggerArguments(i, argc, argv, console_verbosity))
+			continue;
+
+		else if(s == "--help")
+		{
+			ShowUsage();
+			return 0;
+		}
+		else if(s == "--part")
+		{
+			if( ((arg = GetArgument(i, argc, argv)) == NULL) || !ParsePart(arg, part) )
+				return 1;
+		}
+		else if(s == "--seeds")
+		{
+			if( (arg = GetArgument(i, argc, argv)) == NULL)
+				return 1;
+			seeds = max(strtoul(arg, NULL, 10), 1ul);
+		}
+		else if(s == "--seed")
+		{
+			if( (arg = GetArgument(i, argc, argv)) == NULL)
+				return 1;
+			first_seed = strtoul(arg, NULL, 10);
+		}
+		else if(s == "--baseline")
+		{
+			if( (arg = GetArgument(i, argc, argv)) == NULL)
+				return 1;
+			baselineFile = arg;
+		}
+		else if(s == "--time-threshold")
+		{
+			if( (arg = GetArgument(i, argc, argv)) == NULL)
+				return 1;
+			thresholds.m_time = atof(arg);
+		}
+		else if(s == "--time-slack")
+		{
+			if( (arg = GetArgument(i, argc, argv)) == NULL)
+				return 1;
+			thresholds.m_timeSlack = atof(arg);
+		}
+		else if(s == "--memory-threshold")
+		{
+			if( (arg = GetArgument(i, argc, argv)) == NULL)
+				return 1;
+			thresholds.m_memory = atof(arg);
+		}
+		else if(s == "--iteration-threshold")
+		{
+			if( (arg = GetArgument(i, argc, argv)) == NULL)
+				return 1;
+			thresholds.m_iterations = atof(arg);
+		}
+		else if( (s == "-o") || (s == "--output") )
+		{
+			if( (arg = GetArgument(i, argc, argv)) == NULL)
+				return 1;
+			outputFile = arg;
+		}
+		else if( (s[0] == '-') && (s != "-") )
+		{
+			printf("Unrecognized command-line argument \"%s\", use --help\n", s.c_str());
+			return 1;
+		}
+		else
+			netlists.push_back(s);
+	}
+
+	if(netlists.empty())
+	{
+		printf("No netlists specified\n");
+		return 1;
+	}
+
+	g_log_sinks.emplace_back(new STDLogSink(console_verbosity));
+	SetDebugLogging(console_verbosity >= Severity::DEBUG);
+
+	//Only show errors from the compiles themselves (their warnings are the same every run), unless asked for more
+	Severity compile_verbosity = (console_verbosity > Severity::NOTICE) ? console_verbosity : Severity::ERROR;
+
+	//Read the baseline first, so we don't spend ages compiling only to find it's missing
+	vector<CorpusDesign> baseline;
+	if( (baselineFile != "") && !ReadBaseline(baselineFile, baseline) )
+		return 1;
+
+	//Compile everything
+	vector<CorpusDesign> designs;
+	for(auto& fname : netlists)
+	{
+		string name = GetDesignName(fname);
+		LogNotice("%s:\n", name.c_str());
+		LogIndenter li;
+
+		vector<CorpusRun> runs;
+		for(unsigned int i=0; i<seeds; i++)
+		{
+			CompileOptions options;
+			options.netlistFile = fname;
+			options.part = part;
+			options.par.seed = first_seed + i;
+
+			CorpusRun run;
+			if(!RunCompile(options, compile_verbosity, run))
+				return 1;
+			runs.push_back(run);
+
+			LogNotice("seed %u: %s, load %.1f ms, PAR %.1f ms, commit %.1f ms, %u iterations, %ld KB peak\n",
+				options.par.seed,
+				run.m_ok ? "ok" : "FAILED",
+				run.m_load * 1000,
+				run.m_par * 1000,
+				run.m_commit * 1000,
+				run.m_iterations,
+				run.m_peakRSS);
+		}
+
+		designs.push_back(Summarize(name, runs));
+	}
+
+	//Write the results
+	FILE* fp = stdout;
+	if(outputFile != "")
+	{
+		fp = fopen(outputFile.c_str(), "w");
+		if(!fp)
+		{
+			LogError("Couldn't open %s for writing\n", outputFile.c_str());
+			return 1;
+		}
+	}
+	WriteResults(fp, part, seeds, designs);
+	if(fp != stdout)
+		fclose(fp);
+
+	//and see how they compare
+	if(baselineFile == "")
+		return 0;
+	unsigned int regressions = CompareToBaseline(designs, baseline, thresholds);
+	if(regressions)
+	{
+		LogError("%u regressions against baseline %s\n", regressions, baselineFile.c_str());
+		return 1;
+	}
+	LogNotice("No regressions against baseline %s\n", baselineFile.c_str());
+	return 0;
+}
@@ -0,0 +1,74 @@
+/***********************************************************************************************************************
+ * Copyright (C) 2016 Andrew Zonenberg and contributors                                                                *
+ *                                                                                                                     *
+ * This program is free software; you can redistribute it and/or modify it under the terms of the GNU Lesser General   *
+ * Public License as published by the Free Software Foundation; either version 2.1 of the License, or (at your option) *
+ * any later version.                                                                                                  *
+ *                                                                                                                     *
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied  *
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for     *
+ * more details.                                                                                                       *
+ *                                                                                                                     *
+ * You should have received a copy of the GNU Lesser General Public License along with this program; if not, you may   *
+ * find one here:                                                                                                      *
+ * https://www.gnu.org/licenses/old-licenses/lgpl-2.1.txt                                                              *
+ * or you may search the http://www.gnu.org website for the version 2.1 license, or you may write to the Free Software *
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA                                      *
+ **********************************************************************************************************************/
+
+#ifndef gp4bench_h
+#define gp4bench_h
+
+#include <gp4par.h>
+#include "SyntheticNetlist.h"
+#include "SyntheticDevice.h"
+
+//Console help
+void ShowUsage();
+
+//Command line helpers
+bool ParsePart(const std::string& name, Greenpak4Device::GREENPAK4_PART& part);
+const char* GetArgument(int& i, int argc, char* argv[]);
+double SecondsSince(std::chrono::steady_clock::time_point start);
+
+/**
+	@brief Fisher-Yates shuffle driven by our own generator, so generated netlists depend only on the seed
+ */
+template<class T>
+void Shuffle(std::vector<T>& items, PARRandom& random)
+{
+	for(size_t i=items.size(); i>1; i--)
+		std::swap(items[i-1], items[random.NextBelow(i)]);
+}
+
+/**
+	@brief What one compile of one design did
+ */
+struct CorpusRun
+{
+	bool m_ok;
+
+	//Time spent in each phase, in seconds
+	double m_load;
+	double m_par;
+	double m_commit;
+
+	///Annealing iterations, over all the annealing runs
+	uint32_t m_iterations;
+
+	///Peak resident set size of the compile, in KB
+	long m_peakRSS;
+};
+
+//Benchmarking real designs (gp4bench --corpus)
+int CorpusMain(int argc, char* argv[]);
+bool RunCompile(const CompileOptions& options, Severity verbosity, CorpusRun& run);
+double Median(std::vector<double> values);
+
+//Tuning the annealing schedule on real designs (gp4bench --tune)
+int TuneMain(int argc, char* argv[]);
+
+//Timing PAR on ever larger synthetic devices (gp4bench --scale)
+int ScaleMain(int argc, char* argv[]);
+
+#endif
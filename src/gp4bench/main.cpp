@@ -0,0 +1,569 @@
+/***********************************************************************************************************************
+ * Copyright (C) 2016 Andrew Zonenberg and contributors                                                                *
+ *                                                                                                                     *
+ * This program is free software; you can redistribute it and/or modify it under the terms of the GNU Lesser General   *
+ * Public License as published by the Free Software Foundation; either version 2.1 of the License, or (at your option) *
+ * any later version.                                                                                                  *
+ *                                                                                                                     *
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied  *
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for     *
+ * more details.                                                                                                       *
+ *                                                                                                                     *
+ * You should have received a copy of the GNU Lesser General Public License along with this program; if not, you may   *
+ * find one here:                                                                                                      *
+ * https://www.gnu.org/licenses/old-licenses/lgpl-2.1.txt                                                              *
+ * or you may search the http://www.gnu.org website for the version 2.1 license, or you may write to the Free Software *
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA                                      *
+ **********************************************************************************************************************/
+
+#include "gp4bench.h"
+#include <cmath>
+#include <functional>
+
+using namespace std;
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Command line helpers
+
+/**
+	@brief Parts we can benchmark, by name
+ */
+static const struct
+{
+	const char* m_name;
+	Greenpak4Device::GREENPAK4_PART m_part;
+} g_parts[] =
+{
+	{ "SLG46620V", Greenpak4Device::GREENPAK4_SLG46620 },
+	{ "SLG46621V", Greenpak4Device::GREENPAK4_SLG46621 },
+	{ "SLG46140V", Greenpak4Device::GREENPAK4_SLG46140 }
+};
+
+/**
+	@brief Looks up a part by its full name
+
+	@return True if found, false (after complaining) if it's not a part we know
+ */
+bool ParsePart(const string& name, Greenpak4Device::GREENPAK4_PART& part)
+{
+	for(auto& p : g_parts)
+	{
+		if(name == p.m_name)
+		{
+			part = p.m_part;
+			return true;
+		}
+	}
+
+	printf("invalid part (supported: SLG46620V, SLG46621V, SLG46140V)\n");
+	return false;
+}
+
+/**
+	@brief Returns the argument of an option, or NULL (after complaining) if there isn't one
+ */
+const char* GetArgument(int& i, int argc, char* argv[])
+{
+	if(i+1 < argc)
+		return argv[++i];
+
+	printf("%s requires an argument\n", argv[i]);
+	return NULL;
+}
+
+/**
+	@brief Seconds elapsed since a time point
+ */
+double SecondsSince(chrono::steady_clock::time_point start)
+{
+	return chrono::duration<double>(chrono::steady_clock::now() - start).count();
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Microbenchmarks
+
+/**
+	@brief Timing of one benchmark over all of its runs
+ */
+struct BenchmarkResult
+{
+	string m_name;
+
+	///Number of times the body was run
+	uint64_t m_runs;
+
+	///Number of operations done over all runs
+	uint64_t m_ops;
+
+	///Time spent in the timed part of the body over all runs, in seconds
+	double m_seconds;
+
+	///Fastest time per operation of any run, in seconds
+	double m_best;
+};
+
+/**
+	@brief One run of a benchmark. Does some operations, adds how many to ops, and returns the seconds they took
+	(not counting any setup or cleanup around them).
+ */
+typedef function<double(uint64_t& ops)> BenchmarkBody;
+
+/**
+	@brief Runs a benchmark until at least min_time seconds of operations have been timed (and at least once)
+
+	@param name	Name of the benchmark (must be a literal, since it also names the trace span)
+ */
+static BenchmarkResult RunBenchmark(const char* name, double min_time, BenchmarkBody body)
+{
+	LogVerbose("Running %s...\n", name);
+	TraceSpan span(name);
+
+	BenchmarkResult result = {name, 0, 0, 0, INFINITY};
+	do
+	{
+		uint64_t ops = 0;
+		double seconds = body(ops);
+		result.m_runs ++;
+		result.m_ops += ops;
+		result.m_seconds += seconds;
+		if(ops)
+			result.m_best = min(result.m_best, seconds / ops);
+	} while(result.m_seconds < min_time);
+
+	return result;
+}
+
+/**
+	@brief A PAR engine that lets us call the candidate generator directly
+ */
+class BenchmarkPAREngine : public Greenpak4PAREngine
+{
+public:
+	BenchmarkPAREngine(
+		PARGraph* netlist,
+		PARGraph* device,
+		Greenpak4Device* pdev,
+		const Greenpak4SiteTable* sites,
+		const PARLabelRegistry* labels)
+		: Greenpak4PAREngine(netlist, device, pdev, sites, labels)
+	{}
+
+	PARGraphNode* GetCandidate(PARGraphNode* pivot)
+	{ return GetNewPlacementForNode(pivot); }
+};
+
+int main(int argc, char* argv[])
+{
+	//Benchmarking real designs is different enough to have its own options
+	if( (argc > 1) && (string(argv[1]) == "--corpus") )
+		return CorpusMain(argc, argv);
+	if( (argc > 1) && (string(argv[1]) == "--tune") )
+		return TuneMain(argc, argv);
+	if( (argc > 1) && (string(argv[1]) == "--scale") )
+		return ScaleMain(argc, argv);
+
+	//PAR logs a lot even when it's quiet, and the results go to stdout by default, so only show problems
+	Severity console_verbosity = Severity::WARNING;
+
+	Greenpak4Device::GREENPAK4_PART part = Greenpak4Device::GREENPAK4_SLG46620;
+	SyntheticNetlistOptions options;
+
+	//Minimum time to spend on each benchmark, in seconds
+	double min_time = 0.5;
+
+	//Where to write the results (empty = stdout)
+	string outputFile = "";
+
+	//Chrome trace of the benchmarks (empty = don't record one)
+	string traceFile = "";
+
+	//Parse command-line arguments
+	for(int i=1; i<argc; i++)
+	{
+		string s(argv[i]);
+		const char* arg = NULL;
+
+		//Let the logger eat its args first
+		if(ParseLoggerArguments(i, argc, argv, console_verbosity))
+			continue;
+
+		else if(s == "--help")
+		{
+			ShowUsage();
+			return 0;
+		}
+		else if(s == "--part")
+		{
+			if( ((arg = GetArgument(i, argc, argv)) == NULL) || !ParsePart(arg, part) )
+				return 1;
+		}
+		else if(s == "--lut2")
+		{
+			if( (arg = GetArgument(i, argc, argv)) == NULL)
+				return 1;
+			options.lut2 = strtoul(arg, NULL, 10);
+		}
+		else if(s == "--lut3")
+		{
+			if( (arg = GetArgument(i, argc, argv)) == NULL)
+				return 1;
+			options.lut3 = strtoul(arg, NULL, 10);
+		}
+		else if(s == "--lut4")
+		{
+			if( (arg = GetArgument(i, argc, argv)) == NULL)
+				return 1;
+			options.lut4 = strtoul(arg, NULL, 10);
+		}
+		else if(s == "--dff")
+		{
+			if( (arg = GetArgument(i, argc, argv)) == NULL)
+				return 1;
+			options.dff = strtoul(arg, NULL, 10);
+		}
+		else if(s == "--count8")
+		{
+			if( (arg = GetArgument(i, argc, argv)) == NULL)
+				return 1;
+			options.count8 = strtoul(arg, NULL, 10);
+		}
+		else if(s == "--fanout")
+		{
+			if( (arg = GetArgument(i, argc, argv)) == NULL)
+				return 1;
+			options.fanout = atof(arg);
+		}
+		else if(s == "--loc-density")
+		{
+			if( (arg = GetArgument(i, argc, argv)) == NULL)
+				return 1;
+			options.locDensity = atof(arg);
+		}
+		else if(s == "--seed")
+		{
+			if( (arg = GetArgument(i, argc, argv)) == NULL)
+				return 1;
+			options.seed = strtoul(arg, NULL, 10);
+		}
+		else if(s == "--min-time")
+		{
+			if( (arg = GetArgument(i, argc, argv)) == NULL)
+				return 1;
+			min_time = atof(arg);
+		}
+		else if( (s == "-o") || (s == "--output") )
+		{
+			if( (arg = GetArgument(i, argc, argv)) == NULL)
+				return 1;
+			outputFile = arg;
+		}
+		else if(s == "--trace")
+		{
+			if( (arg = GetArgument(i, argc, argv)) == NULL)
+				return 1;
+			traceFile = arg;
+		}
+		else
+		{
+			printf("Unrecognized command-line argument \"%s\", use --help\n", s.c_str());
+			return 1;
+		}
+	}
+
+	g_log_sinks.emplace_back(new STDLogSink(console_verbosity));
+	SetDebugLogging(console_verbosity >= Severity::DEBUG);
+	if( (traceFile != "") && !StartTracing(traceFile) )
+		return 1;
+
+	//Make the netlist
+	Greenpak4Device device(part);
+	SyntheticNetlist netlist(&device, options);
+	if(!netlist.Generate())
+		return 1;
+	PARGraph* ngraph = netlist.GetNetlistGraph();
+	PARGraph* dgraph = netlist.GetDeviceGraph();
+	PARLabelRegistry& lmap = netlist.GetLabelMap();
+	Greenpak4SiteTable sites(ngraph, dgraph);
+
+	vector<BenchmarkResult> results;
+
+	//Building the device graph edges. They can only be added once, so each run copies a graph with just the nodes
+	//and points it at a fresh device (the same way a prebuilt device model is instantiated).
+	Greenpak4Device node_device(device.GetPart());
+	PARGraph* node_ngraph = new PARGraph;
+	PARGraph* node_dgraph = new PARGraph;
+	PARLabelRegistry node_lmap;
+	MakeDeviceNodes(&node_device, node_ngraph, node_dgraph, node_lmap);
+	map<void*, uint32_t> entity_index;
+	for(unsigned int i=0; i<node_device.GetEntityCount(); i++)
+		entity_index[node_device.GetEntity(i)] = i;
+
+	results.push_back(RunBenchmark("make_device_edges", min_time, [&](uint64_t& ops)
+	{
+		Greenpak4Device scratch(device.GetPart());
+		PARGraph* scratch_dgraph = node_dgraph->Clone();
+		for(uint32_t i=0; i<scratch_dgraph->GetNumNodes(); i++)
+		{
+			auto node = scratch_dgraph->GetNodeByIndex(i);
+			auto entity = scratch.GetEntity(entity_index[node->GetData()]);
+			node->SetData(entity);
+			entity->SetPARNode(node);
+		}
+
+		auto start = chrono::steady_clock::now();
+		MakeDeviceEdges(&scratch);
+		double seconds = SecondsSince(start);
+
+		delete scratch_dgraph;
+		ops ++;
+		return seconds;
+	}));
+	delete node_ngraph;
+	delete node_dgraph;
+
+	//Full PAR from scratch, on copies of the unplaced graphs
+	bool routed = true;
+	results.push_back(RunBenchmark("place_and_route", min_time, [&](uint64_t& ops)
+	{
+		PARGraph* run_ngraph;
+		PARGraph* run_dgraph;
+		PARGraph::ClonePair(ngraph, dgraph, run_ngraph, run_dgraph);
+
+		double seconds;
+		{
+			Greenpak4PAREngine engine(run_ngraph, run_dgraph, &device, &sites, &lmap);
+			engine.SetQuiet(true);
+
+			auto start = chrono::steady_clock::now();
+			if(!engine.PlaceAndRoute(lmap, options.seed))
+				routed = false;
+			seconds = SecondsSince(start);
+		}
+
+		delete run_ngraph;
+		delete run_dgraph;
+		ops ++;
+		return seconds;
+	}));
+	if(!routed)
+		LogWarning("Synthetic netlist didn't route, the remaining benchmarks use an illegal placement\n");
+
+	//Everything else works on a placed design, so place the original graphs once
+	BenchmarkPAREngine engine(ngraph, dgraph, &device, &sites, &lmap);
+	engine.SetQuiet(true);
+	engine.PlaceAndRoute(lmap, options.seed);
+	for(uint32_t i=0; i<ngraph->GetNumNodes(); i++)
+	{
+		if(ngraph->GetNodeByIndex(i)->GetMate() == NULL)
+		{
+			LogError("Synthetic netlist can't be placed, try fewer cells or LOC constraints\n");
+			return 1;
+		}
+	}
+	uint32_t cost = engine.ComputeCost();
+
+	//Computing the cost of the placement from scratch
+	results.push_back(RunBenchmark("compute_cost", min_time, [&](uint64_t& ops)
+	{
+		const unsigned int batch = 100;
+		auto start = chrono::steady_clock::now();
+		for(unsigned int i=0; i<batch; i++)
+			engine.ComputeCost();
+		ops += batch;
+		return SecondsSince(start);
+	}));
+
+	//Picking a new site for each node in the netlist
+	results.push_back(RunBenchmark("candidate_generation", min_time, [&](uint64_t& ops)
+	{
+		auto start = chrono::steady_clock::now();
+		for(uint32_t i=0; i<ngraph->GetNumNodes(); i++)
+			engine.GetCandidate(ngraph->GetNodeByIndex(i));
+		ops += ngraph->GetNumNodes();
+		return SecondsSince(start);
+	}));
+
+	//Writing the routes into the device (every run routes the same nets into the same cross connections)
+	bool fits = true;
+	results.push_back(RunBenchmark("commit_routing", min_time, [&](uint64_t& ops)
+	{
+		vector<unsigned int> num_routes_used;
+		auto start = chrono::steady_clock::now();
+		if(!CommitRouting(ngraph, dgraph, &device, sites, num_routes_used))
+			fits = false;
+		ops ++;
+		return SecondsSince(start);
+	}));
+	if(!fits)
+		LogWarning("Synthetic netlist needs more cross connections than the device has\n");
+
+	//Write the results
+	FILE* fp = stdout;
+	if(outputFile != "")
+	{
+		fp = fopen(outputFile.c_str(), "w");
+		if(!fp)
+		{
+			LogError("Couldn't open %s for writing\n", outputFile.c_str());
+			return 1;
+		}
+	}
+
+	fprintf(fp, "{\n");
+	fprintf(fp, "    \"part\": \"%s\",\n", GetPartName(part).c_str());
+	fprintf(fp, "    \"netlist\": {\n");
+	fprintf(fp, "        \"seed\": %u,\n", options.seed);
+	fprintf(fp, "        \"lut2\": %u,\n", options.lut2);
+	fprintf(fp, "        \"lut3\": %u,\n", options.lut3);
+	fprintf(fp, "        \"lut4\": %u,\n", options.lut4);
+	fprintf(fp, "        \"dff\": %u,\n", options.dff);
+	fprintf(fp, "        \"count8\": %u,\n", options.count8);
+	fprintf(fp, "        \"fanout\": %g,\n", options.fanout);
+	fprintf(fp, "        \"loc_density\": %g,\n", options.locDensity);
+	fprintf(fp, "        \"nodes\": %u,\n", ngraph->GetNumNodes());
+	fprintf(fp, "        \"edges\": %u\n", netlist.GetEdgeCount());
+	fprintf(fp, "    },\n");
+	fprintf(fp, "    \"routed\": %s,\n", routed ? "true" : "false");
+	fprintf(fp, "    \"cost\": %u,\n", cost);
+	fprintf(fp, "    \"benchmarks\": [");
+	for(size_t i=0; i<results.size(); i++)
+	{
+		auto& r = results[i];
+		fprintf(fp, "%s\n        {\"name\": ", i ? "," : "");
+		WriteJSONString(fp, r.m_name);
+		fprintf(fp, ", \"runs\": %llu, \"ops\": %llu, \"seconds\": %.6f, \"mean_ns\": %.1f, \"best_ns\": %.1f}",
+			static_cast<unsigned long long>(r.m_runs),
+			static_cast<unsigned long long>(r.m_ops),
+			r.m_seconds,
+			r.m_ops ? (r.m_seconds * 1e9 / r.m_ops) : 0.0,
+			r.m_ops ? (r.m_best * 1e9) : 0.0);
+	}
+	fprintf(fp, "\n    ]\n");
+	fprintf(fp, "}\n");
+
+	if(fp != stdout)
+		fclose(fp);
+	return 0;
+}
+
+void ShowUsage()
+{
+	printf(//                                                                               v 80th column
+		"Usage: gp4bench [options]\n"
+		"    Generates a random netlist and times the main steps of place-and-route on it,\n"
+		"    writing the results in JSON format.\n"
+		"       gp4bench --corpus [corpus options] netlist.json...\n"
+		"    Compiles each netlist with several seeds and writes the phase times,\n"
+		"    annealing iterations, peak memory use and success rate of each in JSON\n"
+		"    format. The results can be used as a baseline for later runs.\n"
+		"       gp4bench --tune -o profile.txt [tune options] netlist.json...\n"
+		"    Searches for the annealing schedule that compiles the netlists fastest\n"
+		"    without routing any less often, and writes it as a gp4par --anneal-profile.\n"
+		"       gp4bench --scale [scale options]\n"
+		"    Places random netlists on made-up devices with more and more matrices, and\n"
+		"    writes how PAR time grows with the number of cells in JSON format.\n"
+		"\n"
+		"    Options:\n"
+		"    --count8             <count>\n"
+		"        Number of 8-bit counters in the netlist (default 4).\n"
+		"    --debug\n"
+		"        Prints lots of internal debugging information.\n"
+		"    --dff                <count>\n"
+		"        Number of flipflops in the netlist (default 10).\n"
+		"    --fanout             <loads>\n"
+		"        Average number of loads on each net (default 3).\n"
+		"    --loc-density        <fraction>\n"
+		"        Fraction of cells to LOC to a random site (default 0.1).\n"
+		"    --lut2, --lut3, --lut4 <count>\n"
+		"        Number of LUTs of each size in the netlist (default 6, 12 and 2).\n"
+		"    --min-time           <seconds>\n"
+		"        Repeats each benchmark until it has run for at least <seconds>\n"
+		"        (default 0.5).\n"
+		"    -o, --output         <file>\n"
+		"        Writes the results to <file> instead of stdout.\n"
+		"    --part               <part>\n"
+		"        Specifies the part to target (SLG46620V, SLG46621V, or SLG46140V).\n"
+		"    --seed               <seed>\n"
+		"        Seed for the netlist generator and the placer (default 1).\n"
+		"    --trace              <file>\n"
+		"        Writes a timeline of the benchmarks to <file>, in Chrome trace format.\n"
+		"    --verbose\n"
+		"        Prints the progress of the benchmarks and the PAR log. Only warnings and\n"
+		"        errors are printed by default.\n"
+		"\n"
+		"    Corpus options:\n"
+		"    --baseline           <file>\n"
+		"        Compares the results to <file> (the results of an earlier run), and fails\n"
+		"        if any design routes less often or got worse by more than the thresholds.\n"
+		"    --iteration-threshold <fraction>\n"
+		"        Allowed increase in annealing iterations (default 0.25).\n"
+		"    --memory-threshold   <fraction>\n"
+		"        Allowed increase in peak memory use (default 0.15).\n"
+		"    -o, --output         <file>\n"
+		"        Writes the results to <file> instead of stdout.\n"
+		"    --part               <part>\n"
+		"        Specifies the part the netlists target (default SLG46620V).\n"
+		"    --seed               <seed>\n"
+		"        First seed to compile with (default 1).\n"
+		"    --seeds              <count>\n"
+		"        Number of seeds to compile each netlist with (default 3).\n"
+		"    --time-slack         <ms>\n"
+		"        Increase in phase times to allow on top of the threshold, since times of\n"
+		"        a few ms are mostly noise (default 5).\n"
+		"    --time-threshold     <fraction>\n"
+		"        Allowed increase in load, PAR and commit times (default 0.25).\n"
+		"    --verbose, --debug\n"
+		"        Print the log of each compile. Only errors are printed by default.\n"
+		"\n"
+		"    Tune options:\n"
+		"    -o, --output         <file>\n"
+		"        Writes the best annealing profile found to <file>.\n"
+		"    --part               <part>\n"
+		"        Specifies the part the netlists target (default SLG46620V).\n"
+		"    --search-seed        <seed>\n"
+		"        Seed for picking the parameters to try (default 1).\n"
+		"    --seed               <seed>\n"
+		"        First seed to compile with (default 1).\n"
+		"    --seeds              <count>\n"
+		"        Number of seeds to compile each netlist with per trial (default 3).\n"
+		"    --start              <file>\n"
+		"        Profile to start from (default the one built into gp4par for the part).\n"
+		"    --trials             <count>\n"
+		"        Number of sets of parameters to try, including the starting one\n"
+		"        (default 20).\n"
+		"    --verbose, --debug\n"
+		"        Print the log of each compile. Only errors are printed by default.\n"
+		"\n"
+		"    Scale options:\n"
+		"    --cross-connections  <count>\n"
+		"        Cross connections from each matrix to each other matrix (default 10).\n"
+		"    --dedicated-density  <fraction>\n"
+		"        Fraction of pairs of sites in different matrices with a dedicated route\n"
+		"        between them (default 0.05).\n"
+		"    --fanout             <loads>\n"
+		"        Average number of loads on each net (default 3).\n"
+		"    --fill               <fraction>\n"
+		"        Fraction of the sites to fill with cells (default 0.75).\n"
+		"    --inputs             <count>\n"
+		"        Number of inputs on each site (default 3).\n"
+		"    --labels             <count>\n"
+		"        Number of different site types (default 4).\n"
+		"    --locality           <fraction>\n"
+		"        Fraction of loads driven from the same cluster of cells, one cluster\n"
+		"        per matrix (default 0.9).\n"
+		"    --matrices           <count>[,<count>...]\n"
+		"        Device sizes to place, in matrices (default 2,4,8,16).\n"
+		"    --max-exponent       <exponent>\n"
+		"        Fails if PAR time grows faster than cells^<exponent> (by a least\n"
+		"        squares fit of the median times).\n"
+		"    -o, --output         <file>\n"
+		"        Writes the results to <file> instead of stdout.\n"
+		"    --seed               <seed>\n"
+		"        Seed for the generator, and first seed to place with (default 1).\n"
+		"    --seeds              <count>\n"
+		"        Number of seeds to place each size with (default 3).\n"
+		"    --sites              <count>\n"
+		"        Number of sites of each type in each matrix (default 8).\n"
+		"    --verbose, --debug\n"
+		"        Print the time of each run, not just of each size.\n");
+}
@@ -0,0 +1,417 @@
+/***********************************************************************************************************************
+ * Copyright (C) 2016 Andrew Zonenberg and contributors                                                                *
+ *                                                                                                                     *
+ * This program is free software; you can redistribute it and/or modify it under the terms of the GNU Lesser General   *
+ * Public License as published by the Free Software Foundation; either version 2.1 of the License, or (at your option) *
+ * any later version.                                                                                                  *
+ *                                                                                                                     *
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied  *
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for     *
+ * more details.                                                                                                       *
+ *                                                                                                                     *
+ * You should have received a copy of the GNU Lesser General Public License along with this program; if not, you may   *
+ * find one here:                                                                                                      *
+ * https://www.gnu.org/licenses/old-licenses/lgpl-2.1.txt                                                              *
+ * or you may search the http://www.gnu.org website for the version 2.1 license, or you may write to the Free Software *
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA                                      *
+ **********************************************************************************************************************/
+
+#include "gp4bench.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+
+using namespace std;
+
+/*
+	Scaling study: the same shape of device and netlist is generated with more and more matrices, and each one is
+	placed with several seeds. The slope of log(PAR time) against log(cells) is how fast PAR time grows with the
+	design size, which should stay close to what it was when the schedule was tuned (a jump means something went
+	super-linear).
+ */
+
+/**
+	@brief All of the runs on one size of device, summarized
+ */
+struct ScaleSize
+{
+	unsigned int m_matrices;
+	uint32_t m_sites;
+	uint32_t m_cells;
+	uint32_t m_edges;
+	uint32_t m_dedicatedRoutes;
+
+	unsigned int m_runs;
+	unsigned int m_successes;
+
+	///Median PAR time, in seconds
+	double m_seconds;
+
+	///Median annealing iterations and cost evaluations
+	double m_iterations;
+	double m_costEvaluations;
+
+	///Time of each run, in seconds
+	vector<double> m_times;
+};
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Running PAR
+
+/**
+	@brief Places and routes one size of device with several seeds
+
+	@return True on success, false if the device couldn't be generated
+ */
+static bool RunSize(const SyntheticDeviceOptions& options, unsigned int seeds, uint32_t first_seed, ScaleSize& size)
+{
+	SyntheticDevice model(options);
+	if(!model.Generate())
+		return false;
+	PARGraph* ngraph = model.GetNetlistGraph();
+	PARGraph* dgraph = model.GetDeviceGraph();
+
+	size.m_matrices = options.matrices;
+	size.m_sites = dgraph->GetNumNodes();
+	size.m_cells = ngraph->GetNumNodes();
+	size.m_edges = model.GetEdgeCount();
+	size.m_dedicatedRoutes = model.GetDedicatedRouteCount();
+	size.m_runs = seeds;
+	size.m_successes = 0;
+
+	vector<double> iterations;
+	vector<double> evaluations;
+	for(unsigned int i=0; i<seeds; i++)
+	{
+		//Every run starts from the unplaced graphs
+		PARGraph* run_ngraph;
+		PARGraph* run_dgraph;
+		PARGraph::ClonePair(ngraph, dgraph, run_ngraph, run_dgraph);
+
+		bool ok;
+		double seconds;
+		PARStatistics stats;
+		{
+			SyntheticPAREngine engine(run_ngraph, run_dgraph, &model);
+			engine.SetQuiet(true);
+
+			auto start = chrono::steady_clock::now();
+			ok = engine.PlaceAndRoute(model.GetLabelMap(), first_seed + i);
+			seconds = SecondsSince(start);
+			stats = engine.GetStatistics();
+		}
+		delete run_ngraph;
+		delete run_dgraph;
+
+		uint32_t nits = 0;
+		for(auto& anneal : stats.anneals)
+			nits += anneal.iterations;
+
+		if(ok)
+			size.m_successes ++;
+		size.m_times.push_back(seconds);
+		iterations.push_back(nits);
+		evaluations.push_back(stats.costEvaluations);
+
+		LogVerbose("seed %u: %s, %.1f ms, %u iterations\n",
+			first_seed + i, ok ? "ok" : "FAILED", seconds * 1000, nits);
+	}
+
+	size.m_seconds = Median(size.m_times);
+	size.m_iterations = Median(iterations);
+	size.m_costEvaluations = Median(evaluations);
+	return true;
+}
+
+/**
+	@brief Least-squares slope of log(median PAR time) against log(cells)
+
+	@return The slope, or NAN if there aren't two different sizes to fit
+ */
+static double FitExponent(const vector<ScaleSize>& sizes)
+{
+	vector<double> xs;
+	vector<double> ys;
+	for(auto& s : sizes)
+	{
+		if(s.m_cells == 0)
+			continue;
+		xs.push_back(log(s.m_cells));
+		ys.push_back(log(max(s.m_seconds, 1e-6)));
+	}
+	if(xs.size() < 2)
+		return NAN;
+
+	double xmean = 0;
+	double ymean = 0;
+	for(size_t i=0; i<xs.size(); i++)
+	{
+		xmean += xs[i];
+		ymean += ys[i];
+	}
+	xmean /= xs.size();
+	ymean /= ys.size();
+
+	double num = 0;
+	double den = 0;
+	for(size_t i=0; i<xs.size(); i++)
+	{
+		num += (xs[i] - xmean) * (ys[i] - ymean);
+		den += (xs[i] - xmean) * (xs[i] - xmean);
+	}
+	if(den == 0)
+		return NAN;
+	return num / den;
+}
+
+static void WriteResults(
+	FILE* fp,
+	const SyntheticDeviceOptions& options,
+	unsigned int seeds,
+	const vector<ScaleSize>& sizes,
+	double exponent)
+{
+	fprintf(fp, "{\n");
+	fprintf(fp, "    \"device\": {\n");
+	fprintf(fp, "        \"seed\": %u,\n", options.seed);
+	fprintf(fp, "        \"labels\": %u,\n", options.labels);
+	fprintf(fp, "        \"sites_per_label\": %u,\n", options.sitesPerLabel);
+	fprintf(fp, "        \"cross_connections\": %u,\n", options.crossConnections);
+	fprintf(fp, "        \"dedicated_density\": %g,\n", options.dedicatedDensity);
+	fprintf(fp, "        \"fill\": %g,\n", options.fill);
+	fprintf(fp, "        \"inputs\": %u,\n", options.inputs);
+	fprintf(fp, "        \"fanout\": %g,\n", options.fanout);
+	fprintf(fp, "        \"locality\": %g\n", options.locality);
+	fprintf(fp, "    },\n");
+	fprintf(fp, "    \"seeds\": %u,\n", seeds);
+	if(std::isnan(exponent))
+		fprintf(fp, "    \"exponent\": null,\n");
+	else
+		fprintf(fp, "    \"exponent\": %.4f,\n", exponent);
+	fprintf(fp, "    \"sizes\": [");
+	for(size_t i=0; i<sizes.size(); i++)
+	{
+		auto& s = sizes[i];
+		fprintf(fp, "%s\n        {\"matrices\": %u, \"sites\": %u, \"cells\": %u, \"edges\": %u, "
+			"\"dedicated_routes\": %u, \"runs\": %u, \"successes\": %u, \"par_ms\": %.3f, \"iterations\": %.1f, "
+			"\"cost_evaluations\": %.0f, \"run_ms\": [",
+			i ? "," : "",
+			s.m_matrices,
+			s.m_sites,
+			s.m_cells,
+			s.m_edges,
+			s.m_dedicatedRoutes,
+			s.m_runs,
+			s.m_successes,
+			s.m_seconds * 1000,
+			s.m_iterations,
+			s.m_costEvaluations);
+		for(size_t j=0; j<s.m_times.size(); j++)
+			fprintf(fp, "%s%.3f", j ? ", " : "", s.m_times[j] * 1000);
+		fprintf(fp, "]}");
+	}
+	fprintf(fp, "\n    ]\n");
+	fprintf(fp, "}\n");
+}
+
+/**
+	@brief Parses a comma separated list of matrix counts
+
+	@return True on success, false (after complaining) if any of them isn't a positive number
+ */
+static bool ParseSizes(const string& list, vector<unsigned int>& sizes)
+{
+	sizes.clear();
+	size_t start = 0;
+	while(start <= list.length())
+	{
+		size_t end = list.find(',', start);
+		if(end == string::npos)
+			end = list.length();
+
+		string item = list.substr(start, end - start);
+		char* last = NULL;
+		unsigned long n = strtoul(item.c_str(), &last, 10);
+		if(item.empty() || (*last != '\0') || (n == 0))
+		{
+			printf("Invalid matrix count \"%s\"\n", item.c_str());
+			return false;
+		}
+		sizes.push_back(n);
+		start = end + 1;
+	}
+	return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Entry point
+
+int ScaleMain(int argc, char* argv[])
+{
+	Severity console_verbosity = Severity::NOTICE;
+
+	SyntheticDeviceOptions options;
+	vector<unsigned int> sizes = {2, 4, 8, 16};
+
+	//Number of seeds to place each size with, and the first one
+	unsigned int seeds = 3;
+	uint32_t first_seed = 1;
+
+	//Fail if the time grows faster than cells^max_exponent (0 = don't check)
+	double max_exponent = 0;
+
+	string outputFile = "";
+
+	//Parse command-line arguments (argv[1] is --scale)
+	for(int i=2; i<argc; i++)
+	{
+		string s(argv[i]);
+		const char* arg = NULL;
+
+		//Let the logger eat its args first
+		if(ParseLoggerArguments(i, argc, argv, console_verbosity))
+			continue;
+
+		else if(s == "--help")
+		{
+			ShowUsage();
+			return 0;
+		}
+		else if(s == "--matrices")
+		{
+			if( ((arg = GetArgument(i, argc, argv)) == NULL) || !ParseSizes(arg, sizes) )
+				return 1;
+		}
+		else if(s == "--labels")
+		{
+			if( (arg = GetArgument(i, argc, argv)) == NULL)
+				return 1;
+			options.labels = strtoul(arg, NULL, 10);
+		}
+		else if(s == "--sites")
+		{
+			if( (arg = GetArgument(i, argc, argv)) == NULL)
+				return 1;
+			options.sitesPerLabel = strtoul(arg, NULL, 10);
+		}
+		else if(s == "--cross-connections")
+		{
+			if( (arg = GetArgument(i, argc, argv)) == NULL)
+				return 1;
+			options.crossConnections = strtoul(arg, NULL, 10);
+		}
+		else if(s == "--dedicated-density")
+		{
+			if( (arg = GetArgument(i, argc, argv)) == NULL)
+				return 1;
+			options.dedicatedDensity = atof(arg);
+		}
+		else if(s == "--fill")
+		{
+			if( (arg = GetArgument(i, argc, argv)) == NULL)
+				return 1;
+			options.fill = atof(arg);
+		}
+		else if(s == "--inputs")
+		{
+			if( (arg = GetArgument(i, argc, argv)) == NULL)
+				return 1;
+			options.inputs = strtoul(arg, NULL, 10);
+		}
+		else if(s == "--fanout")
+		{
+			if( (arg = GetArgument(i, argc, argv)) == NULL)
+				return 1;
+			options.fanout = atof(arg);
+		}
+		else if(s == "--locality")
+		{
+			if( (arg = GetArgument(i, argc, argv)) == NULL)
+				return 1;
+			options.locality = atof(arg);
+		}
+		else if(s == "--seeds")
+		{
+			if( (arg = GetArgument(i, argc, argv)) == NULL)
+				return 1;
+			seeds = max(strtoul(arg, NULL, 10), 1ul);
+		}
+		else if(s == "--seed")
+		{
+			if( (arg = GetArgument(i, argc, argv)) == NULL)
+				return 1;
+			first_seed = strtoul(arg, NULL, 10);
+			options.seed = first_seed;
+		}
+		else if(s == "--max-exponent")
+		{
+			if( (arg = GetArgument(i, argc, argv)) == NULL)
+				return 1;
+			max_exponent = atof(arg);
+		}
+		else if( (s == "-o") || (s == "--output") )
+		{
+			if( (arg = GetArgument(i, argc, argv)) == NULL)
+				return 1;
+			outputFile = arg;
+		}
+		else
+		{
+			printf("Unrecognized command-line argument \"%s\", use --help\n", s.c_str());
+			return 1;
+		}
+	}
+
+	//Progress goes to stderr if the results are going to stdout, so they stay parseable
+	if(outputFile == "")
+		g_log_sinks.emplace_back(new FILELogSink(stderr, false, console_verbosity));
+	else
+		g_log_sinks.emplace_back(new STDLogSink(console_verbosity));
+	SetDebugLogging(console_verbosity >= Severity::DEBUG);
+
+	//Smallest device first, so a broken setup shows up quickly
+	sort(sizes.begin(), sizes.end());
+	sizes.erase(unique(sizes.begin(), sizes.end()), sizes.end());
+
+	vector<ScaleSize> results;
+	for(auto matrices : sizes)
+	{
+		LogNotice("%u matrices:\n", matrices);
+		LogIndenter li;
+
+		options.matrices = matrices;
+		ScaleSize size;
+		if(!RunSize(options, seeds, first_seed, size))
+			return 1;
+		results.push_back(size);
+
+		LogNotice("%u sites, %u cells: %u/%u routed, PAR %.1f ms, %.1f iterations\n",
+			size.m_sites, size.m_cells, size.m_successes, size.m_runs, size.m_seconds * 1000, size.m_iterations);
+	}
+	double exponent = FitExponent(results);
+	if(!std::isnan(exponent))
+		LogNotice("PAR time grows as cells^%.2f\n", exponent);
+
+	//Write the results
+	FILE* fp = stdout;
+	if(outputFile != "")
+	{
+		fp = fopen(outputFile.c_str(), "w");
+		if(!fp)
+		{
+			LogError("Couldn't open %s for writing\n", outputFile.c_str());
+			return 1;
+		}
+	}
+	WriteResults(fp, options, seeds, results, exponent);
+	if(fp != stdout)
+		fclose(fp);
+
+	//and see if it's worse than allowed
+	if( (max_exponent > 0) && !std::isnan(exponent) && (exponent > max_exponent) )
+	{
+		LogError("PAR time grows as cells^%.2f, more than the allowed cells^%.2f\n", exponent, max_exponent);
+		return 1;
+	}
+	return 0;
+}
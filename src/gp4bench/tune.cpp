@@ -0,0 +1,312 @@
+/***********************************************************************************************************************
+ * Copyright (C) 2016 Andrew Zonenberg and contributors                                                                *
+ *                                                                                                                     *
+ * This program is free software; you can redistribute it and/or modify it under the terms of the GNU Lesser General   *
+ * Public License as published by the Free Software Foundation; either version 2.1 of the License, or (at your option) *
+ * any later version.                                                                                                  *
+ *                                                                                                                     *
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied  *
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for     *
+ * more details.                                                                                                       *
+ *                                                                                                                     *
+ * You should have received a copy of the GNU Lesser General Public License along with this program; if not, you may   *
+ * find one here:                                                                                                      *
+ * https://www.gnu.org/licenses/old-licenses/lgpl-2.1.txt                                                              *
+ * or you may search the http://www.gnu.org website for the version 2.1 license, or you may write to the Free Software *
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA                                      *
+ **********************************************************************************************************************/
+
+#include "gp4bench.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+
+using namespace std;
+
+/*
+	Random search over the annealing schedule: every trial compiles the whole corpus with one set of parameters, and
+	the fastest one (by median plus 95th percentile PAR time, summed over the designs) which routes at least as often
+	as the starting profile wins. Half the trials are drawn from the whole search space and half near the best so far.
+ */
+
+/**
+	@brief The parameters we tune, and the range to search for each. Ranges marked m_log are searched by ratio
+	rather than difference.
+ */
+static const struct
+{
+	double PARAnnealOptions::* m_double;
+	uint32_t PARAnnealOptions::* m_uint;
+	double m_min;
+	double m_max;
+	bool m_log;
+} g_tuneParameters[] =
+{
+	{ &PARAnnealOptions::initialAcceptance, NULL, 0.3, 0.95, false },
+	{ NULL, &PARAnnealOptions::initialSamples, 10, 200, true },
+	{ &PARAnnealOptions::finalTemperature, NULL, 0.01, 1, true },
+	{ &PARAnnealOptions::fastCooling, NULL, 0.3, 0.8, false },
+	{ &PARAnnealOptions::normalCooling, NULL, 0.8, 0.97, false },
+	{ &PARAnnealOptions::slowCooling, NULL, 0.9, 0.99, false },
+	{ NULL, &PARAnnealOptions::stagnationLimit, 3, 30, true },
+	{ NULL, &PARAnnealOptions::maxReheats, 0, 6, false },
+	{ &PARAnnealOptions::reheatTemperature, NULL, 0.1, 0.6, false },
+	{ &PARAnnealOptions::moveWeightFloor, NULL, 0.005, 0.1, true },
+	{ &PARAnnealOptions::moveWeightSmoothing, NULL, 0.1, 0.9, false }
+};
+
+/**
+	@brief How one set of parameters did over the corpus
+ */
+struct TuneTrial
+{
+	PARAnnealOptions m_options;
+	unsigned int m_runs;
+	unsigned int m_successes;
+
+	//Median and 95th percentile PAR time of each design, summed over the designs, in ms
+	double m_median;
+	double m_p95;
+};
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Searching
+
+/**
+	@brief Picks new parameters, either anywhere in the search space or near the best ones so far
+ */
+static PARAnnealOptions Sample(const PARAnnealOptions& best, bool local, PARRandom& random)
+{
+	PARAnnealOptions options = best;
+	for(auto& p : g_tuneParameters)
+	{
+		double lo = p.m_log ? log(p.m_min) : p.m_min;
+		double hi = p.m_log ? log(p.m_max) : p.m_max;
+
+		double x;
+		if(local)
+		{
+			//Step up to a tenth of the range either way from where we are
+			double current = p.m_double ? best.*p.m_double : best.*p.m_uint;
+			if(p.m_log)
+				current = log(max(current, p.m_min));
+			x = current + (random.NextUnit() - 0.5) * 0.2 * (hi - lo);
+		}
+		else
+			x = lo + random.NextUnit() * (hi - lo);
+		x = min(max(x, lo), hi);
+		if(p.m_log)
+			x = exp(x);
+
+		if(p.m_double)
+			options.*p.m_double = x;
+		else
+			options.*p.m_uint = static_cast<uint32_t>(round(x));
+	}
+	return options;
+}
+
+/**
+	@brief Value at a given fraction of the way through a list (nearest rank)
+ */
+static double Percentile(vector<double> values, double fraction)
+{
+	if(values.empty())
+		return 0;
+	sort(values.begin(), values.end());
+	size_t rank = static_cast<size_t>(ceil(fraction * values.size()));
+	return values[(rank > 0) ? (rank - 1) : 0];
+}
+
+/**
+	@brief Compiles every netlist with every seed using one set of parameters
+
+	@param profile		File to write the parameters to, for the compiles to read
+	@param options		Everything else about the compiles (the netlist file and seed are overwritten)
+
+	@return True if all of the compiles ran (whether or not they routed)
+ */
+static bool RunTrial(
+	TuneTrial& trial,
+	const string& profile,
+	CompileOptions options,
+	const vector<string>& netlists,
+	unsigned int seeds,
+	uint32_t first_seed,
+	Severity verbosity)
+{
+	if(!WriteOutputFile(profile, FormatAnnealProfile(trial.m_options, "gp4bench --tune trial")))
+		return false;
+	options.par.annealProfileFile = profile;
+
+	trial.m_runs = 0;
+	trial.m_successes = 0;
+	trial.m_median = 0;
+	trial.m_p95 = 0;
+	for(auto& fname : netlists)
+	{
+		vector<double> times;
+		for(unsigned int i=0; i<seeds; i++)
+		{
+			options.netlistFile = fname;
+			options.par.seed = first_seed + i;
+
+			CorpusRun run;
+			if(!RunCompile(options, verbosity, run))
+				return false;
+			trial.m_runs ++;
+			if(run.m_ok)
+				trial.m_successes ++;
+			times.push_back(run.m_par * 1000);
+		}
+		trial.m_median += Median(times);
+		trial.m_p95 += Percentile(times, 0.95);
+	}
+	return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Entry point
+
+int TuneMain(int argc, char* argv[])
+{
+	Severity console_verbosity = Severity::NOTICE;
+
+	Greenpak4Device::GREENPAK4_PART part = Greenpak4Device::GREENPAK4_SLG46620;
+	vector<string> netlists;
+
+	//Number of seeds to compile each design with in each trial, and the first one
+	unsigned int seeds = 3;
+	uint32_t first_seed = 1;
+
+	//Number of trials (including the starting profile), and the seed for choosing their parameters
+	unsigned int trials = 20;
+	uint32_t search_seed = 1;
+
+	//Profile to start from (empty = the built-in one for the part), and where to write the best one
+	string startFile = "";
+	string outputFile = "";
+
+	//Parse command-line arguments (argv[1] is --tune)
+	for(int i=2; i<argc; i++)
+	{
+		string s(argv[i]);
+		const char* arg = NULL;
+
+		//Let the logger eat its args first
+		if(ParseLoggerArguments(i, argc, argv, console_verbosity))
+			continue;
+
+		else if(s == "--help")
+		{
+			ShowUsage();
+			return 0;
+		}
+		else if(s == "--part")
+		{
+			if( ((arg = GetArgument(i, argc, argv)) == NULL) || !ParsePart(arg, part) )
+				return 1;
+		}
+		else if(s == "--seeds")
+		{
+			if( (arg = GetArgument(i, argc, argv)) == NULL)
+				return 1;
+			seeds = max(strtoul(arg, NULL, 10), 1ul);
+		}
+		else if(s == "--seed")
+		{
+			if( (arg = GetArgument(i, argc, argv)) == NULL)
+				return 1;
+			first_seed = strtoul(arg, NULL, 10);
+		}
+		else if(s == "--trials")
+		{
+			if( (arg = GetArgument(i, argc, argv)) == NULL)
+				return 1;
+			trials = max(strtoul(arg, NULL, 10), 1ul);
+		}
+		else if(s == "--search-seed")
+		{
+			if( (arg = GetArgument(i, argc, argv)) == NULL)
+				return 1;
+			search_seed = strtoul(arg, NULL, 10);
+		}
+		else if(s == "--start")
+		{
+			if( (arg = GetArgument(i, argc, argv)) == NULL)
+				return 1;
+			startFile = arg;
+		}
+		else if( (s == "-o") || (s == "--output") )
+		{
+			if( (arg = GetArgument(i, argc, argv)) == NULL)
+				return 1;
+			outputFile = arg;
+		}
+		else if( (s[0] == '-') && (s != "-") )
+		{
+			printf("Unrecognized command-line argument \"%s\", use --help\n", s.c_str());
+			return 1;
+		}
+		else
+			netlists.push_back(s);
+	}
+
+	if(netlists.empty())
+	{
+		printf("No netlists specified\n");
+		return 1;
+	}
+	if(outputFile == "")
+	{
+		printf("No output file specified\n");
+		return 1;
+	}
+
+	g_log_sinks.emplace_back(new STDLogSink(console_verbosity));
+	SetDebugLogging(console_verbosity >= Severity::DEBUG);
+
+	//Only show errors from the compiles themselves, unless asked for more
+	Severity compile_verbosity = (console_verbosity > Severity::NOTICE) ? console_verbosity : Severity::ERROR;
+
+	CompileOptions options;
+	options.part = part;
+
+	//The starting profile is the first trial, and the success rate to beat
+	TuneTrial best;
+	if(!GetAnnealProfile(part, startFile, best.m_options))
+		return 1;
+	string trialFile = outputFile + ".trial";
+	PARRandom random(search_seed);
+	unsigned int best_index = 0;
+	for(unsigned int t=0; t<trials; t++)
+	{
+		TuneTrial trial;
+		trial.m_options = (t == 0) ? best.m_options : Sample(best.m_options, (t % 2) == 0, random);
+		if(!RunTrial(trial, trialFile, options, netlists, seeds, first_seed, compile_verbosity))
+			return 1;
+
+		LogNotice("trial %u: %u/%u routed, median %.1f ms, p95 %.1f ms\n",
+			t, trial.m_successes, trial.m_runs, trial.m_median, trial.m_p95);
+
+		bool better =
+			(t == 0) ||
+			( (trial.m_successes >= best.m_successes) && (trial.m_median + trial.m_p95 < best.m_median + best.m_p95) );
+		if(better)
+		{
+			best = trial;
+			best_index = t;
+		}
+	}
+	remove(trialFile.c_str());
+
+	//Save the winner
+	char comment[256];
+	snprintf(comment, sizeof(comment), "tuned for %s on %zu designs x %u seeds (trial %u of %u)",
+		GetPartName(part).c_str(), netlists.size(), seeds, best_index, trials);
+	if(!WriteOutputFile(outputFile, FormatAnnealProfile(best.m_options, comment)))
+		return 1;
+	LogNotice("Best was trial %u: %u/%u routed, median %.1f ms, p95 %.1f ms (written to %s)\n",
+		best_index, best.m_successes, best.m_runs, best.m_median, best.m_p95, outputFile.c_str());
+	return 0;
+}
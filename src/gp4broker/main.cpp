@@ -0,0 +1,900 @@
+/***********************************************************************************************************************
+ * Copyright (C) 2016 Andrew Zonenberg and contributors                                                                *
+ *                                                                                                                     *
+ * This program is free software; you can redistribute it and/or modify it under the terms of the GNU Lesser General   *
+ * Public License as published by the Free Software Foundation; either version 2.1 of the License, or (at your option) *
+ * any later version.                                                                                                  *
+ *                                                                                                                     *
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied  *
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for     *
+ * more details.                                                                                                       *
+ *                                                                                                                     *
+ * You should have received a copy of the GNU Lesser General Public License along with this program; if not, you may   *
+ * find one here:                                                                                                      *
+ * https://www.gnu.org/licenses/old-licenses/lgpl-2.1.txt                                                              *
+ * or you may search the http://www.gnu.org website for the version 2.1 license, or you may write to the Free Software *
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA                                      *
+ **********************************************************************************************************************/
+
+#include <cerrno>
+#include <chrono>
+#include <csignal>
+#include <cstdarg>
+#include <cstring>
+#include <deque>
+#include <map>
+#include <thread>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <log.h>
+#include <debuglog.h>
+#include <metrics.h>
+#include <gpdevboard.h>
+#include <gp4par.h>
+
+using namespace std;
+
+void ShowUsage();
+void ShowVersion();
+
+//Longest request line we'll accept
+static const size_t MAX_REQUEST_LINE = 256;
+
+//Set by SIGINT/SIGTERM
+static volatile sig_atomic_t g_brokerStop = 0;
+
+static void OnBrokerSignal(int /*sig*/)
+{
+	g_brokerStop = 1;
+}
+
+/**
+	@brief Keeps what each board's worker thread logs while boards are being checked, and everything else goes to the
+	console
+
+	Boards are checked all at once, so their messages are held back and written out one board at a time afterwards,
+	rather than interleaved.
+ */
+class BoardLogSink : public LogSink
+{
+public:
+	BoardLogSink(LogSink* console)
+		: m_console(console)
+	{}
+
+	virtual void Log(Severity severity, const string& msg)
+	{
+		if(m_boardLog)
+			m_boardLog->push_back(make_pair(severity, msg));
+		else
+			m_console->Log(severity, msg);
+	}
+
+	virtual void Log(Severity severity, const char* format, va_list va)
+	{
+		if(!m_boardLog)
+		{
+			m_console->Log(severity, format, va);
+			return;
+		}
+
+		char buf[1024];
+		vsnprintf(buf, sizeof(buf), format, va);
+		m_boardLog->push_back(make_pair(severity, string(buf)));
+	}
+
+	///Writes out everything a board's thread logged
+	void Replay(const vector<pair<Severity, string>>& log)
+	{
+		for(auto& it : log)
+			m_console->Log(it.first, it.second);
+	}
+
+	///Messages from the board being checked by this thread (NULL if none)
+	static thread_local vector<pair<Severity, string>>* m_boardLog;
+
+protected:
+	unique_ptr<LogSink> m_console;
+};
+
+thread_local vector<pair<Severity, string>>* BoardLogSink::m_boardLog = NULL;
+
+//The sink everything goes through
+static BoardLogSink* g_boardLogSink = NULL;
+
+/**
+	@brief One developer board the broker looks after
+ */
+class BrokerBoard
+{
+public:
+	BrokerBoard()
+		: index(0)
+		, part(SilegoPart::UNRECOGNIZED)
+		, hdev(NULL)
+		, leaseFd(-1)
+		, faulty(false)
+		, leases(0)
+	{}
+
+	//Index to pass to OpenBoard(), and the serial number that says it's still the same board
+	int index;
+	string serial;
+
+	//Part in the board's socket
+	SilegoPart part;
+
+	//Our handle on the board while it isn't leased (NULL while it is, so the client can open it)
+	hdevice hdev;
+
+	//Connection of the client holding the lease (-1 if none)
+	int leaseFd;
+
+	//Set if the board failed a check or couldn't be opened again, so it isn't handed out any more
+	bool faulty;
+
+	//Number of leases so far, and when the current one started
+	unsigned int leases;
+	chrono::steady_clock::time_point leaseStart;
+
+	//What the last client found out about the board (BoardSession::Serialize()), passed on with the next lease
+	string session;
+};
+
+/**
+	@brief A connection from a client: either still sending its request, waiting for a board, or holding a lease
+ */
+class BrokerClient
+{
+public:
+	BrokerClient()
+		: part(SilegoPart::UNRECOGNIZED)
+	{}
+
+	//What the client has sent so far that isn't a whole line yet
+	string buffer;
+
+	//Part the client wants a board with (UNRECOGNIZED until it asks for one), and when it asked
+	SilegoPart part;
+	chrono::steady_clock::time_point waitStart;
+};
+
+/**
+	@brief Owns every developer board on the machine, and leases them out to HIL tests over a Unix socket
+
+	Boards are found, identified and checked once at startup. While a board isn't leased the broker keeps it open,
+	so nothing that doesn't go through the broker can use it. A lease is handed out by closing the board and telling
+	the client which one to open, and lasts until the client's connection closes. The board is then opened, reset and
+	made available again.
+
+	Once the boards are found, everything happens on one thread: requests are tiny, and the only slow work is on the
+	boards, which have to be handled one at a time anyway since opening one may make the bus re-enumerate.
+ */
+class BoardBroker
+{
+public:
+	BoardBroker();
+
+	bool Run(const string& path, const string& metrics_address);
+
+protected:
+	bool FindBoards();
+	bool Listen(const string& path);
+	void Poll();
+
+	void OnReadable(int fd);
+	void HandleRequest(int fd, const string& request);
+	void HandleStatus(int fd);
+	void Disconnect(int fd);
+
+	void GrantWaitingLeases();
+	bool CheckBoard(BrokerBoard& board);
+	void ReturnBoard(BrokerBoard& board);
+	void CloseBoard(BrokerBoard& board);
+
+	bool HasBoardFor(SilegoPart part) const;
+
+	static void DescribeMetrics();
+	void UpdateMetrics();
+	static void CountUSBStatistics(const BrokerBoard& board, const USBStatistics& stats);
+	static string BoardMetric(const string& family, const BrokerBoard& board);
+
+	static bool SendLine(int fd, const char* format, ...) __attribute__((format(printf, 2, 3)));
+
+	//The socket we're listening on
+	int m_listenFd;
+
+	vector<BrokerBoard> m_boards;
+
+	//Every open connection, by file descriptor
+	map<int, BrokerClient> m_clients;
+
+	//Clients waiting for a board, in the order they asked
+	deque<int> m_waiting;
+};
+
+BoardBroker::BoardBroker()
+	: m_listenFd(-1)
+{
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Main loop
+
+/**
+	@brief Leases boards out until we get SIGINT or SIGTERM
+
+	@return True on a clean shutdown, false if we couldn't start
+ */
+bool BoardBroker::Run(const string& path, const string& metrics_address)
+{
+	DescribeMetrics();
+	if(!FindBoards())
+		return false;
+	if(!Listen(path))
+		return false;
+	if( (metrics_address != "") && !StartMetricsServer(metrics_address) )
+	{
+		close(m_listenFd);
+		unlink(path.c_str());
+		for(auto& board : m_boards)
+			CloseBoard(board);
+		return false;
+	}
+	UpdateMetrics();
+
+	//Clients that hang up are noticed next time we try to talk to them, not by killing us
+	signal(SIGPIPE, SIG_IGN);
+	signal(SIGINT, OnBrokerSignal);
+	signal(SIGTERM, OnBrokerSignal);
+
+	LogNotice("\nListening on %s (%zu boards)\n", path.c_str(), m_boards.size());
+
+	while(!g_brokerStop)
+		Poll();
+
+	LogNotice("\nShutting down...\n");
+	close(m_listenFd);
+	unlink(path.c_str());
+
+	//Leased boards belong to their clients until they're done, so only put back the ones we have
+	for(auto& it : m_clients)
+		close(it.first);
+	for(auto& board : m_boards)
+		CloseBoard(board);
+
+	return true;
+}
+
+/**
+	@brief Opens every board, works out which part is in it and makes sure its socket works
+
+	Boards are opened one at a time, since a board in bootloader mode re-enumerates once we switch it over. Working
+	out the part takes several bitstream uploads (and a test bitstream for a SLG4662x), so that then happens on every
+	board at once, and bringing up a rack of boards takes as long as the slowest one rather than all of them together.
+ */
+bool BoardBroker::FindBoards()
+{
+	int count = CountBoards();
+	if(count < 0)
+		return false;
+
+	struct BoardCheck
+	{
+		BrokerBoard board;
+		vector<pair<Severity, string>> log;
+		bool ok;
+	};
+	vector<BoardCheck> checks;
+
+	LogNotice("Opening %d boards...\n", count);
+	for(int i=0; i<count; i++)
+	{
+		LogIndenter li;
+
+		BoardCheck check;
+		check.board.index = i;
+		check.board.hdev = OpenBoard(i);
+		check.ok = false;
+		if(!check.board.hdev)
+		{
+			LogWarning("Couldn't open board %d, skipping it\n", i);
+			continue;
+		}
+		checks.push_back(check);
+	}
+
+	LogNotice("Checking %zu boards...\n", checks.size());
+	vector<thread> threads;
+	for(auto& check : checks)
+	{
+		threads.push_back(thread([this, &check]()
+		{
+			BoardLogSink::m_boardLog = &check.log;
+			vector<uint8_t> programmedBitstream;
+			BitstreamKind bitstreamKind;
+			check.ok =
+				GetBoardSerial(check.board.hdev, check.board.serial) &&
+				DetectPart(check.board.hdev, check.board.part, programmedBitstream, bitstreamKind) &&
+				CheckBoard(check.board);
+			BoardLogSink::m_boardLog = NULL;
+		}));
+	}
+	for(auto& t : threads)
+		t.join();
+
+	for(auto& check : checks)
+	{
+		LogIndenter li;
+
+		auto& board = check.board;
+		LogNotice("Board %d:\n", board.index);
+		{
+			LogIndenter li2;
+			g_boardLogSink->Replay(check.log);
+		}
+
+		if(!check.ok)
+		{
+			LogWarning("Board %d failed its checks, skipping it\n", board.index);
+			CloseBoard(board);
+			continue;
+		}
+
+		LogNotice("Board %d (%s) has a %s\n", board.index, board.serial.c_str(), PartName(board.part));
+		m_boards.push_back(board);
+	}
+
+	if(m_boards.empty())
+	{
+		LogError("No usable developer boards found\n");
+		return false;
+	}
+	return true;
+}
+
+/**
+	@brief Creates the listening socket, replacing any stale socket left behind by a broker that's no longer running
+ */
+bool BoardBroker::Listen(const string& path)
+{
+	m_listenFd = ListenUnixSocket(path);
+	return (m_listenFd >= 0);
+}
+
+/**
+	@brief Waits a little while for new connections, requests, and clients hanging up (which ends their lease)
+ */
+void BoardBroker::Poll()
+{
+	vector<pollfd> fds;
+	fds.push_back({m_listenFd, POLLIN, 0});
+	for(auto& it : m_clients)
+		fds.push_back({it.first, POLLIN | POLLRDHUP, 0});
+
+	//Time out now and then so we notice shutdown requests
+	if(poll(&fds[0], fds.size(), 100) <= 0)
+		return;
+
+	for(size_t i=1; i<fds.size(); i++)
+	{
+		if(fds[i].revents & (POLLIN | POLLRDHUP | POLLHUP | POLLERR))
+			OnReadable(fds[i].fd);
+	}
+
+	if(fds[0].revents & POLLIN)
+	{
+		int fd = accept4(m_listenFd, NULL, NULL, SOCK_CLOEXEC);
+		if(fd >= 0)
+			m_clients[fd] = BrokerClient();
+	}
+
+	UpdateMetrics();
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Requests
+
+/**
+	@brief Reads whatever a client has sent, handling each request once it's a whole line
+ */
+void BoardBroker::OnReadable(int fd)
+{
+	char buf[256];
+	ssize_t len = recv(fd, buf, sizeof(buf), MSG_DONTWAIT);
+	if( (len < 0) && ( (errno == EAGAIN) || (errno == EWOULDBLOCK) || (errno == EINTR) ) )
+		return;
+	if(len <= 0)
+	{
+		Disconnect(fd);
+		return;
+	}
+
+	auto& client = m_clients[fd];
+	client.buffer.append(buf, len);
+	while(true)
+	{
+		size_t end = client.buffer.find('\n');
+		if(end == string::npos)
+			break;
+		string request = client.buffer.substr(0, end);
+		client.buffer.erase(0, end + 1);
+		HandleRequest(fd, request);
+
+		//The request may have ended the connection
+		if(m_clients.find(fd) == m_clients.end())
+			return;
+	}
+
+	if(m_clients[fd].buffer.length() > MAX_REQUEST_LINE)
+	{
+		SendLine(fd, "error request is too long\n");
+		Disconnect(fd);
+	}
+}
+
+/**
+	@brief Handles "lease <part>", "session <session>", "usage <counters>", "release" and "status"
+ */
+void BoardBroker::HandleRequest(int fd, const string& request)
+{
+	string command = request.substr(0, request.find(' '));
+	string arg = (command.length() < request.length()) ? request.substr(command.length() + 1) : "";
+	auto& client = m_clients[fd];
+
+	if(command == "lease")
+	{
+		if(client.part != SilegoPart::UNRECOGNIZED)
+		{
+			SendLine(fd, "error only one lease per connection\n");
+			return;
+		}
+
+		SilegoPart parts[] = { SLG46620V, SLG46621V, SLG46140V };
+		for(auto part : parts)
+		{
+			if(arg == PartName(part))
+				client.part = part;
+		}
+		if(client.part == SilegoPart::UNRECOGNIZED)
+		{
+			SendLine(fd, "error unknown part \"%s\"\n", arg.c_str());
+			Disconnect(fd);
+			return;
+		}
+		if(!HasBoardFor(client.part))
+		{
+			SendLine(fd, "error no usable board has a %s\n", arg.c_str());
+			Disconnect(fd);
+			return;
+		}
+
+		client.waitStart = chrono::steady_clock::now();
+		m_waiting.push_back(fd);
+		GrantWaitingLeases();
+	}
+	else if(command == "session")
+	{
+		//Only the client holding a board can tell us about it, and only in a form the next client will understand
+		BoardSession session;
+		if(!session.Parse(arg))
+		{
+			SendLine(fd, "error bad session\n");
+			return;
+		}
+		for(auto& board : m_boards)
+		{
+			if( (board.leaseFd == fd) && (session.part == board.part) )
+				board.session = session.Serialize();
+		}
+	}
+	else if(command == "usage")
+	{
+		//Counters are only taken from the client holding the board, like sessions
+		USBStatistics stats;
+		unsigned long long bytes;
+		if(4 != sscanf(arg.c_str(), "%u %u %llu %lf", &stats.retries, &stats.errors, &bytes, &stats.downloadSeconds))
+		{
+			SendLine(fd, "error bad usage\n");
+			return;
+		}
+		stats.downloadBytes = bytes;
+		for(auto& board : m_boards)
+		{
+			if(board.leaseFd == fd)
+				CountUSBStatistics(board, stats);
+		}
+	}
+	else if(command == "release")
+		Disconnect(fd);
+	else if(command == "status")
+	{
+		HandleStatus(fd);
+		Disconnect(fd);
+	}
+	else
+	{
+		SendLine(fd, "error unknown request\n");
+		Disconnect(fd);
+	}
+}
+
+/**
+	@brief Sends one line for every board, saying what it is and whether it's free, then "end"
+ */
+void BoardBroker::HandleStatus(int fd)
+{
+	for(auto& board : m_boards)
+	{
+		const char* state = "free";
+		if(board.faulty)
+			state = "faulty";
+		else if(board.leaseFd >= 0)
+			state = "leased";
+		SendLine(fd, "board %d %s %s %s %u\n", board.index, board.serial.c_str(), PartName(board.part), state,
+			board.leases);
+	}
+	SendLine(fd, "waiting %zu\n", m_waiting.size());
+	SendLine(fd, "end\n");
+}
+
+/**
+	@brief Forgets about a client, taking back its board if it had one
+ */
+void BoardBroker::Disconnect(int fd)
+{
+	for(auto it = m_waiting.begin(); it != m_waiting.end(); it++)
+	{
+		if(*it == fd)
+		{
+			m_waiting.erase(it);
+			break;
+		}
+	}
+
+	m_clients.erase(fd);
+	close(fd);
+
+	for(auto& board : m_boards)
+	{
+		if(board.leaseFd == fd)
+		{
+			LogVerbose("Board %d returned\n", board.index);
+			IncrementMetric(BoardMetric("gp4broker_board_leased_seconds_total", board),
+				chrono::duration<double>(chrono::steady_clock::now() - board.leaseStart).count());
+			board.leaseFd = -1;
+			ReturnBoard(board);
+			GrantWaitingLeases();
+		}
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Boards
+
+/**
+	@brief Hands out every free board that somebody is waiting for, first come first served
+ */
+void BoardBroker::GrantWaitingLeases()
+{
+	for(size_t i=0; i<m_waiting.size(); )
+	{
+		int fd = m_waiting[i];
+		SilegoPart part = m_clients[fd].part;
+
+		BrokerBoard* found = NULL;
+		for(auto& board : m_boards)
+		{
+			if( board.faulty || (board.leaseFd >= 0) || (board.part != part) )
+				continue;
+
+			//Make sure the board is still good before anybody gets it; if not, try the next one
+			if(!CheckBoard(board))
+			{
+				LogError("Board %d failed its check, not leasing it any more\n", board.index);
+				board.faulty = true;
+				CloseBoard(board);
+				continue;
+			}
+			found = &board;
+			break;
+		}
+
+		if(!found)
+		{
+			//If the last board for this part just failed, the client would wait forever
+			if(!HasBoardFor(part))
+			{
+				SendLine(fd, "error no usable board has a %s\n", PartName(part));
+				Disconnect(fd);
+				continue;
+			}
+			i ++;
+			continue;
+		}
+
+		//Let go of the board so the client can open it
+		m_waiting.erase(m_waiting.begin() + i);
+		SetStatusLED(found->hdev, 1);
+		CountUSBStatistics(*found, GetUSBStatistics(found->hdev));
+		USBCleanup(found->hdev);
+		found->hdev = NULL;
+		found->leaseFd = fd;
+		found->leases ++;
+		found->leaseStart = chrono::steady_clock::now();
+		IncrementMetric(BoardMetric("gp4broker_board_leases_total", *found));
+		ObserveMetric("gp4broker_lease_wait_seconds",
+			chrono::duration<double>(found->leaseStart - m_clients[fd].waitStart).count());
+		LogVerbose("Leasing board %d (%s)\n", found->index, PartName(found->part));
+
+		string session = found->session.empty() ? "" : (" " + found->session);
+		if(!SendLine(fd, "board %d %s%s\n", found->index, found->serial.c_str(), session.c_str()))
+			Disconnect(fd);
+	}
+}
+
+/**
+	@brief Checks a board we have open is still fit for use: nothing faulty, and the socket works
+
+	The socket test is cached (see CachedSocketTest()), so this is usually only the quick check.
+ */
+bool BoardBroker::CheckBoard(BrokerBoard& board)
+{
+	if(!CheckStatus(board.hdev) || !CachedSocketTest(board.hdev, board.part))
+		return false;
+	return Reset(board.hdev) && ResetAllSiggens(board.hdev) && SetStatusLED(board.hdev, 0);
+}
+
+/**
+	@brief Opens a board again once its lease is over, and resets it for the next client
+ */
+void BoardBroker::ReturnBoard(BrokerBoard& board)
+{
+	LogIndenter li;
+
+	board.hdev = OpenBoard(board.index, true);
+	if(!board.hdev)
+	{
+		LogError("Couldn't open board %d again, not leasing it any more\n", board.index);
+		board.faulty = true;
+		return;
+	}
+
+	string serial;
+	if(!GetBoardSerial(board.hdev, serial) || (serial != board.serial))
+	{
+		LogError("Board %d isn't %s any more, not leasing it\n", board.index, board.serial.c_str());
+		board.faulty = true;
+		CloseBoard(board);
+		return;
+	}
+
+	if(!Reset(board.hdev) || !ResetAllSiggens(board.hdev) || !SetStatusLED(board.hdev, 0))
+	{
+		LogError("Couldn't reset board %d, not leasing it any more\n", board.index);
+		board.faulty = true;
+		CloseBoard(board);
+	}
+}
+
+/**
+	@brief Leaves a board we have open in a safe state, and closes it
+ */
+void BoardBroker::CloseBoard(BrokerBoard& board)
+{
+	if(!board.hdev)
+		return;
+
+	Reset(board.hdev);
+	ResetAllSiggens(board.hdev);
+	SetStatusLED(board.hdev, 0);
+	CountUSBStatistics(board, GetUSBStatistics(board.hdev));
+	USBCleanup(board.hdev);
+	board.hdev = NULL;
+}
+
+/**
+	@brief Checks if any board that's still in service has a part
+ */
+bool BoardBroker::HasBoardFor(SilegoPart part) const
+{
+	for(auto& board : m_boards)
+	{
+		if(!board.faulty && (board.part == part))
+			return true;
+	}
+	return false;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Metrics
+
+/**
+	@brief Describes everything the broker counts, so it all shows up on the metrics endpoint even before it happens
+ */
+void BoardBroker::DescribeMetrics()
+{
+	DescribeMetric("gp4broker_boards", MetricType::GAUGE, "Boards in service, by whether they're free or leased");
+	DescribeMetric("gp4broker_clients_waiting", MetricType::GAUGE, "Clients waiting for a board");
+	DescribeMetric("gp4broker_lease_wait_seconds", MetricType::HISTOGRAM, "Time clients waited for a board",
+		{0.01, 0.1, 1, 5, 10, 30, 60, 300, 900});
+	DescribeMetric("gp4broker_board_leased", MetricType::GAUGE, "1 if the board is leased right now");
+	DescribeMetric("gp4broker_board_leases_total", MetricType::COUNTER, "Leases handed out");
+	DescribeMetric("gp4broker_board_leased_seconds_total", MetricType::COUNTER,
+		"Time spent leased (finished leases only), for utilization");
+	DescribeMetric("gp4broker_board_usb_retries_total", MetricType::COUNTER, "USB commands that had to be resent");
+	DescribeMetric("gp4broker_board_usb_errors_total", MetricType::COUNTER, "USB transfers that failed outright");
+	DescribeMetric("gp4broker_board_download_bytes_total", MetricType::COUNTER, "Bitstream bytes downloaded");
+	DescribeMetric("gp4broker_board_download_seconds_total", MetricType::COUNTER,
+		"Time spent downloading bitstreams, for throughput");
+}
+
+/**
+	@brief Updates the gauges that say what the boards and clients are doing right now
+ */
+void BoardBroker::UpdateMetrics()
+{
+	unsigned int states[3] = {0, 0, 0};
+	for(auto& board : m_boards)
+	{
+		bool leased = !board.faulty && (board.leaseFd >= 0);
+		if(board.faulty)
+			states[2] ++;
+		else
+			states[leased ? 1 : 0] ++;
+		SetMetric(BoardMetric("gp4broker_board_leased", board), leased ? 1 : 0);
+	}
+
+	SetMetric(MetricName("gp4broker_boards", "state", "free"), states[0]);
+	SetMetric(MetricName("gp4broker_boards", "state", "leased"), states[1]);
+	SetMetric(MetricName("gp4broker_boards", "state", "faulty"), states[2]);
+	SetMetric("gp4broker_clients_waiting", m_waiting.size());
+}
+
+/**
+	@brief Adds what a board's USB link did while one handle or client had it to the board's counters
+ */
+void BoardBroker::CountUSBStatistics(const BrokerBoard& board, const USBStatistics& stats)
+{
+	IncrementMetric(BoardMetric("gp4broker_board_usb_retries_total", board), stats.retries);
+	IncrementMetric(BoardMetric("gp4broker_board_usb_errors_total", board), stats.errors);
+	IncrementMetric(BoardMetric("gp4broker_board_download_bytes_total", board), stats.downloadBytes);
+	IncrementMetric(BoardMetric("gp4broker_board_download_seconds_total", board), stats.downloadSeconds);
+}
+
+/**
+	@brief Names the series of a per-board metric
+ */
+string BoardBroker::BoardMetric(const string& family, const BrokerBoard& board)
+{
+	return MetricName(MetricName(family, "board", to_string(board.index)), "serial", board.serial);
+}
+
+bool BoardBroker::SendLine(int fd, const char* format, ...)
+{
+	char buf[512];
+	va_list list;
+	va_start(list, format);
+	int len = vsnprintf(buf, sizeof(buf), format, list);
+	va_end(list);
+	if( (len < 0) || ((size_t)len >= sizeof(buf)) )
+		return false;
+	return send(fd, buf, len, MSG_NOSIGNAL) == len;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Entry point
+
+int main(int argc, char* argv[])
+{
+	Severity console_verbosity = Severity::NOTICE;
+
+	string path = GetBrokerSocketPath();
+	string metricsAddress = "";
+
+	//Parse command-line arguments
+	for(int i=1; i<argc; i++)
+	{
+		string s(argv[i]);
+
+		//Let the logger eat its args first
+		if(ParseLoggerArguments(i, argc, argv, console_verbosity))
+			continue;
+
+		else if(s == "--help")
+		{
+			ShowUsage();
+			return 0;
+		}
+		else if(s == "--version")
+		{
+			ShowVersion();
+			return 0;
+		}
+		else if(s == "-s" || s == "--socket")
+		{
+			if(i+1 < argc)
+				path = argv[++i];
+			else
+			{
+				printf("--socket requires an argument\n");
+				return 1;
+			}
+		}
+		else if(s == "--metrics")
+		{
+			if(i+1 < argc)
+				metricsAddress = argv[++i];
+			else
+			{
+				printf("--metrics requires an argument\n");
+				return 1;
+			}
+		}
+		else
+		{
+			printf("Unrecognized command-line argument \"%s\", use --help\n", s.c_str());
+			return 1;
+		}
+	}
+
+	//Set up logging
+	//Set up logging (through a BoardLogSink, so boards being checked at once don't interleave their messages)
+	g_boardLogSink = new BoardLogSink(new STDLogSink(console_verbosity));
+	g_log_sinks.emplace(g_log_sinks.begin(), g_boardLogSink);
+	SetDebugLogging(console_verbosity >= Severity::DEBUG);
+
+	if(console_verbosity >= Severity::NOTICE)
+		ShowVersion();
+
+	BoardBroker broker;
+	return broker.Run(path, metricsAddress) ? 0 : 1;
+}
+
+void ShowUsage()
+{
+	printf(//                                                                               v 80th column
+		"Usage: gp4broker [options]\n"
+		"    Takes charge of every developer board on the machine, and leases them out to\n"
+		"    HIL tests (through MultiBoardTestSetup()), so the tests can run in parallel.\n"
+		"    Each board is identified and checked once, here, rather than by every test.\n"
+		"    -q, --quiet\n"
+		"        Causes only warnings and errors to be written to the console.\n"
+		"        Specify twice to also silence warnings.\n"
+		"    --metrics            [host:]<port>\n"
+		"        Serves board utilization, lease waits, USB retries and errors, and\n"
+		"        download throughput per board over HTTP at /metrics, in the Prometheus\n"
+		"        text format. Listens on every interface unless a host is given.\n"
+		"    --verbose\n"
+		"        Prints every lease as it's handed out and returned.\n"
+		"    --debug\n"
+		"        Prints lots of internal debugging information.\n"
+		"    -s, --socket         <path>\n"
+		"        Specifies the socket to listen on (default $GP4BROKER_SOCKET, or\n"
+		"        /tmp/gp4broker.sock). Tests find the broker the same way.\n"
+		"\n"
+		"    Requests are one line each:\n"
+		"    lease <part>\n"
+		"        Waits for a board with the part to be free, then replies\n"
+		"        \"board <index> <serial> [session]\". The lease lasts until the connection\n"
+		"        closes.\n"
+		"    session <session>\n"
+		"        Remembers what the client holding a board found out about it (such as its\n"
+		"        oscillator trim), to pass on to the next client that leases it.\n"
+		"    usage <retries> <errors> <bytes> <seconds>\n"
+		"        Adds the USB retries and errors, and bitstream bytes downloaded and the\n"
+		"        time it took, of the client holding a board to the board's metrics.\n"
+		"    status\n"
+		"        Replies with a line for every board, then \"end\".\n");
+}
+
+void ShowVersion()
+{
+	printf(
+		"GreenPAK 4 board broker by Andrew D. Zonenberg.\n"
+		"\n"
+		"License: LGPL v2.1+\n"
+		"This is free software: you are free to change and redistribute it.\n"
+		"There is NO WARRANTY, to the extent permitted by law.\n");
+}
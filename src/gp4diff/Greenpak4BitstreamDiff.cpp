@@ -0,0 +1,307 @@
+/***********************************************************************************************************************
+ * Copyright (C) 2016 Andrew Zonenberg and contributors                                                                *
+ *                                                                                                                     *
+ * This program is free software; you can redistribute it and/or modify it under the terms of the GNU Lesser General   *
+ * Public License as published by the Free Software Foundation; either version 2.1 of the License, or (at your option) *
+ * any later version.                                                                                                  *
+ *                                                                                                                     *
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied  *
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for     *
+ * more details.                                                                                                       *
+ *                                                                                                                     *
+ * You should have received a copy of the GNU Lesser General Public License along with this program; if not, you may   *
+ * find one here:                                                                                                      *
+ * https://www.gnu.org/licenses/old-licenses/lgpl-2.1.txt                                                              *
+ * or you may search the http://www.gnu.org website for the version 2.1 license, or you may write to the Free Software *
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA                                      *
+ **********************************************************************************************************************/
+
+#include <log.h>
+#include <algorithm>
+#include <cinttypes>
+#include <memory>
+#include "Greenpak4BitstreamDiff.h"
+
+using namespace std;
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Construction
+
+/**
+	@brief Maps out the fields of the device's bitstream
+
+	This reconfigures the inputs of every entity while it's probing them, so the device should be a fresh one that's
+	only used for diffing.
+ */
+Greenpak4BitstreamDiff::Greenpak4BitstreamDiff(Greenpak4Device* device)
+	: m_device(device)
+	, m_fieldAt(device->GetBitLength(), NO_FIELD)
+	, m_generation(0)
+{
+	//Entities first, so anything a block writes is reported as part of that block.
+	//Probing routes signals to inputs that can't all take them, so keep the resulting complaints off the console.
+	vector<unique_ptr<LogSink>> sinks;
+	sinks.swap(g_log_sinks);
+	for(unsigned int i=0; i<device->GetEntityCount(); i++)
+		MapEntity(device->GetEntity(i));
+	sinks.swap(g_log_sinks);
+
+	//Then the chip-wide fields, in whatever bits are left
+	auto& layout = device->GetBitstreamLayout();
+	for(size_t i=0; i<layout.GetFieldCount(); i++)
+	{
+		auto& f = layout.GetFields()[i];
+		vector<bool> bits(m_fieldAt.size(), false);
+		for(unsigned int bit = f.start; bit < f.End(); bit++)
+			bits[bit] = true;
+
+		//Reserved bits aren't a value, so give each one a field of its own
+		if(f.description)
+		{
+			//Don't repeat the owner if the description already names it
+			string name = f.description;
+			if(name.find(f.owner) != 0)
+				name = string(f.owner) + " " + name;
+			AddRuns(FIELD_GLOBAL, bits, name, MAX_FIELD_WIDTH);
+		}
+		else
+			AddRuns(FIELD_GLOBAL, bits, "reserved", 1);
+	}
+
+	//and finally the bits nothing writes at all
+	AddRuns(FIELD_UNOWNED, vector<bool>(m_fieldAt.size(), true), "unowned", 1);
+
+	m_reported.resize(m_fields.size(), 0);
+}
+
+/**
+	@brief Finds the bits an entity writes, and splits them up into its input selectors and its configuration
+ */
+void Greenpak4BitstreamDiff::MapEntity(Greenpak4BitstreamEntity* entity)
+{
+	unsigned int bitlen = m_device->GetBitLength();
+	vector<uint8_t> ff((bitlen + 7) / 8, 0xff);
+	Greenpak4Bitstream zeros(bitlen);
+	Greenpak4Bitstream ones(bitlen);
+	ones.SetBytes(&ff[0], ff.size());
+
+	//If it can't even save in its default state, its bits are left to show up as unowned
+	if(!entity->Save(zeros) || !entity->Save(ones))
+		return;
+
+	vector<bool> written(bitlen, false);
+	for(unsigned int bit=0; bit<bitlen; bit++)
+		written[bit] = (zeros[bit] == ones[bit]) && (m_fieldAt[bit] == NO_FIELD);
+
+	for(auto port : entity->GetInputPorts())
+		FindSelector(entity, port, written);
+
+	//LUTs don't have anything but the truth table
+	string name = entity->GetDescription();
+	if(dynamic_cast<Greenpak4LUT*>(entity) != NULL)
+		AddRuns(FIELD_CONFIG, written, name + " truth table", MAX_FIELD_WIDTH);
+	else
+		AddRuns(FIELD_CONFIG, written, name + " config", MAX_FIELD_WIDTH);
+}
+
+/**
+	@brief Works out which matrix selector drives an input port, by routing a signal to it and seeing what changes
+
+	Nothing but the power rails is routed anywhere in a fresh device, so the selector is the word that ends up with the
+	net number of the signal we routed. Some inputs only take power rails, so VDD is tried as well. Routing something
+	to one input can change other words too (a DFF that's no longer unused takes itself out of reset, for example), so
+	a probe only counts if exactly one word picked up its net number.
+
+	@return True if a selector was found. Its bits are cleared in written.
+ */
+bool Greenpak4BitstreamDiff::FindSelector(Greenpak4BitstreamEntity* entity, string port, vector<bool>& written)
+{
+	unsigned int matrix = entity->GetInputMatrix();
+	unsigned int nbits = m_device->GetMatrixBits();
+	unsigned int base = m_device->GetMatrixBase(matrix);
+	unsigned int bitlen = m_device->GetBitLength();
+
+	//The first real signal in the matrix, and VDD
+	vector<unsigned int> probes;
+	for(unsigned int net = 1; net < (1u << nbits); net++)
+	{
+		auto signal = m_device->GetNetByNumber(matrix, net);
+		if( (signal.m_src != NULL) && (signal.m_src != entity) && !signal.IsPowerRail() )
+		{
+			probes.push_back(net);
+			break;
+		}
+	}
+	for(unsigned int net = 0; net < (1u << nbits); net++)
+	{
+		auto signal = m_device->GetNetByNumber(matrix, net);
+		if( (signal.m_src != NULL) && signal.IsPowerRail() && signal.GetPowerRailValue() )
+		{
+			probes.push_back(net);
+			break;
+		}
+	}
+
+	for(auto net : probes)
+	{
+		Greenpak4Bitstream before(bitlen);
+		Greenpak4Bitstream after(bitlen);
+		bool ok = entity->Save(before);
+		entity->SetInput(port, m_device->GetNetByNumber(matrix, net));
+		ok &= entity->Save(after);
+		entity->SetInput(port, m_device->GetGround());
+		if(!ok)
+			continue;
+
+		unsigned int found = 0;
+		unsigned int start = 0;
+		for(unsigned int w = base; w + nbits <= bitlen; w += nbits)
+		{
+			if( (after.GetField(w, nbits) == net) && (before.GetField(w, nbits) != net) )
+			{
+				found++;
+				start = w;
+			}
+		}
+		if(found != 1)
+			continue;
+
+		//Already claimed (by another name for the same input, like a DFF's CLK and nCLK)
+		for(unsigned int bit = start; bit < start + nbits; bit++)
+		{
+			if(!written[bit])
+				return false;
+		}
+		for(unsigned int bit = start; bit < start + nbits; bit++)
+			written[bit] = false;
+
+		char name[128];
+		snprintf(name, sizeof(name), "matrix %u selector %u for %s.%s",
+			matrix, (start - base) / nbits, entity->GetDescription().c_str(), port.c_str());
+		AddField(FIELD_SELECTOR, start, nbits, name, matrix);
+		return true;
+	}
+
+	return false;
+}
+
+/**
+	@brief Adds a field for each run of unclaimed bits set in bits, splitting runs longer than maxWidth
+ */
+void Greenpak4BitstreamDiff::AddRuns(FieldType type, const vector<bool>& bits, string name, unsigned int maxWidth)
+{
+	for(unsigned int bit=0; bit<bits.size(); )
+	{
+		if(!bits[bit] || (m_fieldAt[bit] != NO_FIELD))
+		{
+			bit++;
+			continue;
+		}
+
+		unsigned int start = bit;
+		while( (bit < bits.size()) && bits[bit] && (m_fieldAt[bit] == NO_FIELD) && (bit - start < maxWidth) )
+			bit++;
+
+		char range[64];
+		if(bit - start == 1)
+			snprintf(range, sizeof(range), " (bit %u)", start);
+		else
+			snprintf(range, sizeof(range), " (bits %u-%u)", start, bit - 1);
+		AddField(type, start, bit - start, name + range);
+	}
+}
+
+void Greenpak4BitstreamDiff::AddField(
+	FieldType type,
+	unsigned int start,
+	unsigned int width,
+	string name,
+	unsigned int matrix)
+{
+	Field f;
+	f.m_type = type;
+	f.m_start = start;
+	f.m_width = width;
+	f.m_matrix = matrix;
+	f.m_name = name;
+
+	for(unsigned int bit = start; bit < start + width; bit++)
+		m_fieldAt[bit] = m_fields.size();
+	m_fields.push_back(f);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Comparison
+
+/**
+	@brief Lists the fields that differ between two bitstreams, in bitstream order
+ */
+void Greenpak4BitstreamDiff::Compare(const Greenpak4Bitstream& a, const Greenpak4Bitstream& b, vector<Change>& changes)
+{
+	changes.clear();
+
+	//Stamp the fields we've reported rather than clearing a flag for every field each time
+	if(++m_generation == 0)
+	{
+		fill(m_reported.begin(), m_reported.end(), 0);
+		m_generation = 1;
+	}
+
+	auto& wa = a.GetWords();
+	auto& wb = b.GetWords();
+	vector<uint16_t> fields;
+	for(size_t i=0; i<wa.size() && i<wb.size(); i++)
+	{
+		for(uint64_t diff = wa[i] ^ wb[i]; diff != 0; diff &= diff - 1)
+		{
+			uint16_t f = m_fieldAt[i*64 + __builtin_ctzll(diff)];
+			if(m_reported[f] == m_generation)
+				continue;
+			m_reported[f] = m_generation;
+			fields.push_back(f);
+		}
+	}
+
+	//Fields are numbered in the order they were found, not by address
+	sort(fields.begin(), fields.end(), [&](uint16_t x, uint16_t y)
+		{ return m_fields[x].m_start < m_fields[y].m_start; });
+
+	for(auto f : fields)
+	{
+		Change c;
+		c.m_field = m_fields[f].m_name;
+		c.m_old = FormatValue(m_fields[f], a);
+		c.m_new = FormatValue(m_fields[f], b);
+		changes.push_back(c);
+	}
+}
+
+/**
+	@brief Decodes a field: selectors as the signal they route, everything else as a number
+ */
+string Greenpak4BitstreamDiff::FormatValue(const Field& field, const Greenpak4Bitstream& bitstream)
+{
+	uint64_t value = bitstream.GetField(field.m_start, field.m_width);
+	char buf[128];
+
+	if(field.m_type == FIELD_SELECTOR)
+	{
+		auto signal = m_device->GetNetByNumber(field.m_matrix, value);
+		if(signal.m_src == NULL)
+			snprintf(buf, sizeof(buf), "net %u (undriven)", static_cast<unsigned int>(value));
+		else if(signal.IsPowerRail())
+			snprintf(buf, sizeof(buf), "%s", signal.GetPowerRailValue() ? "VDD" : "GND");
+		else
+		{
+			snprintf(buf, sizeof(buf), "%s.%s",
+				signal.GetDescription().c_str(), signal.GetPortName().c_str());
+		}
+	}
+
+	else if(field.m_width == 1)
+		snprintf(buf, sizeof(buf), "%d", static_cast<int>(value));
+	else
+		snprintf(buf, sizeof(buf), "0x%0*" PRIx64, static_cast<int>((field.m_width + 3) / 4), value);
+
+	return buf;
+}
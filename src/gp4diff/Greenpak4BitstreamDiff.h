@@ -0,0 +1,101 @@
+/***********************************************************************************************************************
+ * Copyright (C) 2016 Andrew Zonenberg and contributors                                                                *
+ *                                                                                                                     *
+ * This program is free software; you can redistribute it and/or modify it under the terms of the GNU Lesser General   *
+ * Public License as published by the Free Software Foundation; either version 2.1 of the License, or (at your option) *
+ * any later version.                                                                                                  *
+ *                                                                                                                     *
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied  *
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for     *
+ * more details.                                                                                                       *
+ *                                                                                                                     *
+ * You should have received a copy of the GNU Lesser General Public License along with this program; if not, you may   *
+ * find one here:                                                                                                      *
+ * https://www.gnu.org/licenses/old-licenses/lgpl-2.1.txt                                                              *
+ * or you may search the http://www.gnu.org website for the version 2.1 license, or you may write to the Free Software *
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA                                      *
+ **********************************************************************************************************************/
+
+#ifndef Greenpak4BitstreamDiff_h
+#define Greenpak4BitstreamDiff_h
+
+#include <Greenpak4.h>
+
+/**
+	@brief Compares bitstreams for one part field by field, naming what each changed field configures
+
+	The constructor maps every bit of the bitstream to a field. Each entity is saved on top of an all-zeros and an
+	all-ones bitstream, and the bits that come out the same both times are the ones it writes. Routing a real signal
+	to each input port in turn then picks out which of those are the matrix selector for that port, and whatever is
+	left over is the entity's configuration. Chip-wide fields come from the part's Greenpak4BitstreamLayout.
+
+	That's only done once per part. Compare() then XORs the packed words, and only looks up the fields under the bits
+	that actually differ, so diffing a pair of identical bitstreams costs a few dozen word compares.
+ */
+class Greenpak4BitstreamDiff
+{
+public:
+	Greenpak4BitstreamDiff(Greenpak4Device* device);
+
+	///A field that differs between two bitstreams
+	class Change
+	{
+	public:
+		std::string m_field;
+		std::string m_old;
+		std::string m_new;
+	};
+
+	void Compare(const Greenpak4Bitstream& a, const Greenpak4Bitstream& b, std::vector<Change>& changes);
+
+	unsigned int GetFieldCount()
+	{ return m_fields.size(); }
+
+protected:
+
+	enum FieldType
+	{
+		FIELD_SELECTOR,		//Matrix selector for an entity input
+		FIELD_CONFIG,		//Other bits an entity writes
+		FIELD_GLOBAL,		//Chip-wide field from the layout table
+		FIELD_UNOWNED		//Bits nothing writes
+	};
+
+	class Field
+	{
+	public:
+		FieldType m_type;
+		unsigned int m_start;
+		unsigned int m_width;
+		unsigned int m_matrix;
+		std::string m_name;
+	};
+
+	void AddField(FieldType type, unsigned int start, unsigned int width, std::string name, unsigned int matrix = 0);
+	void AddRuns(FieldType type, const std::vector<bool>& bits, std::string name, unsigned int maxWidth);
+	void MapEntity(Greenpak4BitstreamEntity* entity);
+	bool FindSelector(Greenpak4BitstreamEntity* entity, std::string port, std::vector<bool>& written);
+	std::string FormatValue(const Field& field, const Greenpak4Bitstream& bitstream);
+
+	enum
+	{
+		NO_FIELD = 0xffff,
+
+		//Widest field GetField() can return
+		MAX_FIELD_WIDTH = 64
+	};
+
+	Greenpak4Device* m_device;
+
+	///The fields, in the order they were found
+	std::vector<Field> m_fields;
+
+	///Index into m_fields of the field each bit belongs to
+	std::vector<uint16_t> m_fieldAt;
+
+	///Value of m_generation when each field was last reported, so a field with several changed bits is listed once
+	std::vector<unsigned int> m_reported;
+	unsigned int m_generation;
+};
+
+#endif
@@ -0,0 +1,257 @@
+/***********************************************************************************************************************
+ * Copyright (C) 2016 Andrew Zonenberg and contributors                                                                *
+ *                                                                                                                     *
+ * This program is free software; you can redistribute it and/or modify it under the terms of the GNU Lesser General   *
+ * Public License as published by the Free Software Foundation; either version 2.1 of the License, or (at your option) *
+ * any later version.                                                                                                  *
+ *                                                                                                                     *
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied  *
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for     *
+ * more details.                                                                                                       *
+ *                                                                                                                     *
+ * You should have received a copy of the GNU Lesser General Public License along with this program; if not, you may   *
+ * find one here:                                                                                                      *
+ * https://www.gnu.org/licenses/old-licenses/lgpl-2.1.txt                                                              *
+ * or you may search the http://www.gnu.org website for the version 2.1 license, or you may write to the Free Software *
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA                                      *
+ **********************************************************************************************************************/
+
+#include <log.h>
+#include <chrono>
+#include <algorithm>
+#include <dirent.h>
+#include <sys/stat.h>
+#include "Greenpak4BitstreamDiff.h"
+
+using namespace std;
+
+void ShowUsage();
+void ShowVersion();
+
+bool IsDirectory(string path);
+bool ListFiles(string dir, vector<string>& names);
+bool DiffFiles(Greenpak4Device& device, Greenpak4BitstreamDiff& diff, string oldFile, string newFile, bool& differ);
+bool DiffDirectories(Greenpak4Device& device, Greenpak4BitstreamDiff& diff, string oldDir, string newDir,
+	unsigned int& count, bool& differ);
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Entry point
+
+int main(int argc, char* argv[])
+{
+	Severity console_verbosity = Severity::NOTICE;
+
+	string oldPath;
+	string newPath;
+	Greenpak4Device::GREENPAK4_PART part = Greenpak4Device::GREENPAK4_SLG46620;
+
+	//Parse command-line arguments
+	for(int i=1; i<argc; i++)
+	{
+		string s(argv[i]);
+
+		//Let the logger eat its args first
+		if(ParseLoggerArguments(i, argc, argv, console_verbosity))
+			continue;
+
+		else if(s == "--help")
+		{
+			ShowUsage();
+			return 0;
+		}
+		else if(s == "--version")
+		{
+			ShowVersion();
+			return 0;
+		}
+		else if(s == "-p" || s == "--part")
+		{
+			if(i+1 >= argc)
+			{
+				printf("--part requires an argument\n");
+				return 2;
+			}
+
+			string partname = argv[++i];
+			if(partname == "SLG46620V")
+				part = Greenpak4Device::GREENPAK4_SLG46620;
+			else if(partname == "SLG46621V")
+				part = Greenpak4Device::GREENPAK4_SLG46621;
+			else if(partname == "SLG46140V")
+				part = Greenpak4Device::GREENPAK4_SLG46140;
+			else
+			{
+				printf("invalid part (supported: SLG46620V, SLG46621V, SLG46140V)\n");
+				return 2;
+			}
+		}
+
+		//The files, in order
+		else if( (s[0] != '-') && (oldPath == "") )
+			oldPath = s;
+		else if( (s[0] != '-') && (newPath == "") )
+			newPath = s;
+
+		else
+		{
+			printf("Unrecognized command-line argument \"%s\", use --help\n", s.c_str());
+			return 2;
+		}
+	}
+
+	if(newPath == "")
+	{
+		ShowUsage();
+		return 2;
+	}
+
+	//Set up logging
+	g_log_sinks.emplace(g_log_sinks.begin(), new STDLogSink(console_verbosity));
+
+	auto start = chrono::steady_clock::now();
+
+	//Map out the bitstream once, then every pair of files is just a word compare plus the fields that differ
+	Greenpak4Device device(part);
+	Greenpak4BitstreamDiff diff(&device);
+	LogVerbose("Bitstream has %u fields\n", diff.GetFieldCount());
+
+	bool differ = false;
+	unsigned int count = 1;
+	bool ok;
+	if(IsDirectory(oldPath) && IsDirectory(newPath))
+		ok = DiffDirectories(device, diff, oldPath, newPath, count, differ);
+	else
+		ok = DiffFiles(device, diff, oldPath, newPath, differ);
+
+	double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+	LogVerbose("Compared %u bitstreams in %.3f s\n", count, seconds);
+
+	if(!ok)
+		return 2;
+	return differ ? 1 : 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Diffing
+
+/**
+	@brief Compares two bitstream files and lists the fields that differ
+ */
+bool DiffFiles(Greenpak4Device& device, Greenpak4BitstreamDiff& diff, string oldFile, string newFile, bool& differ)
+{
+	Greenpak4Bitstream a(device.GetBitLength());
+	Greenpak4Bitstream b(device.GetBitLength());
+	if(!device.ReadBitstream(oldFile, a) || !device.ReadBitstream(newFile, b))
+		return false;
+
+	vector<Greenpak4BitstreamDiff::Change> changes;
+	diff.Compare(a, b, changes);
+	if(changes.empty())
+		return true;
+
+	differ = true;
+	LogNotice("%s -> %s: %zu fields differ\n", oldFile.c_str(), newFile.c_str(), changes.size());
+	LogIndenter li;
+	for(auto& c : changes)
+		LogNotice("%s: %s -> %s\n", c.m_field.c_str(), c.m_old.c_str(), c.m_new.c_str());
+	return true;
+}
+
+/**
+	@brief Compares every file in one directory with the file of the same name in the other
+ */
+bool DiffDirectories(Greenpak4Device& device, Greenpak4BitstreamDiff& diff, string oldDir, string newDir,
+	unsigned int& count, bool& differ)
+{
+	vector<string> oldNames;
+	vector<string> newNames;
+	if(!ListFiles(oldDir, oldNames) || !ListFiles(newDir, newNames))
+		return false;
+
+	count = 0;
+	bool ok = true;
+	for(auto& name : oldNames)
+	{
+		if(!binary_search(newNames.begin(), newNames.end(), name))
+		{
+			LogNotice("Only in %s: %s\n", oldDir.c_str(), name.c_str());
+			differ = true;
+			continue;
+		}
+
+		count++;
+		ok &= DiffFiles(device, diff, oldDir + "/" + name, newDir + "/" + name, differ);
+	}
+
+	for(auto& name : newNames)
+	{
+		if(!binary_search(oldNames.begin(), oldNames.end(), name))
+		{
+			LogNotice("Only in %s: %s\n", newDir.c_str(), name.c_str());
+			differ = true;
+		}
+	}
+
+	return ok;
+}
+
+bool IsDirectory(string path)
+{
+	struct stat st;
+	return (0 == stat(path.c_str(), &st)) && S_ISDIR(st.st_mode);
+}
+
+/**
+	@brief Gets the names of the regular files in a directory, sorted
+ */
+bool ListFiles(string dir, vector<string>& names)
+{
+	DIR* d = opendir(dir.c_str());
+	if(!d)
+	{
+		LogError("Couldn't open directory %s\n", dir.c_str());
+		return false;
+	}
+
+	while(dirent* ent = readdir(d))
+	{
+		string name = ent->d_name;
+		struct stat st;
+		if( (0 == stat((dir + "/" + name).c_str(), &st)) && S_ISREG(st.st_mode) )
+			names.push_back(name);
+	}
+	closedir(d);
+
+	sort(names.begin(), names.end());
+	return true;
+}
+
+void ShowUsage()
+{
+	printf(//                                                                               v 80th column
+		"Usage: gp4diff [options] old new\n"
+		"    Lists the fields that differ between two bitstreams, by the entity they\n"
+		"    configure. If old and new are both directories, every file in old is\n"
+		"    compared with the file of the same name in new. Exits with status 0 if\n"
+		"    there are no differences, 1 if there are, and 2 on errors.\n"
+		"    -q, --quiet\n"
+		"        Causes only warnings and errors to be written to the console.\n"
+		"        Specify twice to also silence warnings.\n"
+		"    --verbose\n"
+		"        Prints additional information about the design.\n"
+		"    --debug\n"
+		"        Prints lots of internal debugging information.\n"
+		"    -p, --part           <part>\n"
+		"        Specifies the part the bitstreams are for (default SLG46620V).\n"
+		"        Supported: SLG46620V, SLG46621V, SLG46140V.\n");
+}
+
+void ShowVersion()
+{
+	printf(
+		"GreenPAK 4 bitstream diff by Andrew D. Zonenberg.\n"
+		"\n"
+		"License: LGPL v2.1+\n"
+		"This is free software: you are free to change and redistribute it.\n"
+		"There is NO WARRANTY, to the extent permitted by law.\n");
+}
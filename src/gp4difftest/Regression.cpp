@@ -0,0 +1,419 @@
+/***********************************************************************************************************************
+ * Copyright (C) 2016 Andrew Zonenberg and contributors                                                                *
+ *                                                                                                                     *
+ * This program is free software; you can redistribute it and/or modify it under the terms of the GNU Lesser General   *
+ * Public License as published by the Free Software Foundation; either version 2.1 of the License, or (at your option) *
+ * any later version.                                                                                                  *
+ *                                                                                                                     *
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied  *
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for     *
+ * more details.                                                                                                       *
+ *                                                                                                                     *
+ * You should have received a copy of the GNU Lesser General Public License along with this program; if not, you may   *
+ * find one here:                                                                                                      *
+ * https://www.gnu.org/licenses/old-licenses/lgpl-2.1.txt                                                              *
+ * or you may search the http://www.gnu.org website for the version 2.1 license, or you may write to the Free Software *
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA                                      *
+ **********************************************************************************************************************/
+
+#include <Greenpak4Simulator.h>
+#include <Greenpak4CompiledModel.h>
+#include <log.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <map>
+#include <thread>
+#include "Regression.h"
+
+using namespace std;
+
+/**
+	@brief One design in a regression, loaded once and shared by every test that runs on it
+ */
+class RegressionDesign
+{
+public:
+	RegressionDesign()
+		: part(Greenpak4Device::GREENPAK4_SLG46620)
+		, device(NULL)
+		, model(NULL)
+	{}
+
+	std::string fname;
+	Greenpak4Device::GREENPAK4_PART part;
+
+	///The device loaded from the bitstream (NULL for a compiled model)
+	Greenpak4Device* device;
+
+	///The model each thread clones its own from
+	Greenpak4SimulationModel* model;
+
+	///Copies of the model already run through power-up, by settle time, which tests start from snapshots of
+	std::map<uint64_t, Greenpak4SimulationModel*> settled;
+};
+
+/**
+	@brief One test in a regression, and how it went
+ */
+class RegressionTest
+{
+public:
+	RegressionTest(size_t d, const StimulusTest& t, bool o)
+		: design(d)
+		, test(t)
+		, onChip(o)
+		, duration(0)
+		, ran(false)
+		, passed(false)
+		, seconds(0)
+	{
+		for(auto& step : test.steps)
+			duration += step.delay;
+	}
+
+	size_t design;
+	StimulusTest test;
+	bool onChip;
+
+	///Simulated time the test covers, in ps (how we guess which tests are slowest)
+	uint64_t duration;
+
+	//Results
+	bool ran;
+	bool passed;
+	double seconds;
+};
+
+static bool ReadRegressionList(
+	const string& fname,
+	Greenpak4Device::GREENPAK4_PART part,
+	uint64_t settle,
+	vector<RegressionDesign>& designs,
+	vector<RegressionTest>& tests);
+static bool LoadDesign(RegressionDesign& design);
+static bool WriteReport(
+	const string& fname,
+	const vector<RegressionDesign>& designs,
+	const vector<RegressionTest>& tests,
+	double seconds);
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Running the regression
+
+/**
+	@brief Runs every test in a regression list in simulation, on a pool of threads
+
+	Each design is loaded once, and each thread clones its own copy of the model the first time it runs one of that
+	design's tests. Tests are started slowest first (by the simulated time they cover), and an idle thread always takes
+	the next one waiting, so with enough threads the whole run takes about as long as the slowest test.
+
+	Tests with a settle time don't simulate it themselves: each design is run up to each settle time its tests use once,
+	before the threads start, and each test runs on its own snapshot of that.
+
+	@param fname		The regression list (see ReadRegressionList())
+	@param part			Part for designs that don't say
+	@param jobs			Number of threads
+	@param settle		Settle time (ps) for lines that don't say
+	@param report_fname	Where to write the report (a line per test), or empty for none
+
+	@return True if every test passed
+ */
+bool RunRegression(
+	string fname,
+	Greenpak4Device::GREENPAK4_PART part,
+	unsigned int jobs,
+	uint64_t settle,
+	string report_fname)
+{
+	auto start = chrono::steady_clock::now();
+
+	vector<RegressionDesign> designs;
+	vector<RegressionTest> tests;
+	if(!ReadRegressionList(fname, part, settle, designs, tests))
+		return false;
+
+	for(auto& design : designs)
+	{
+		if(!LoadDesign(design))
+			return false;
+	}
+
+	//Settle each design once for every settle time its tests use (the threads only ever read these)
+	for(auto& t : tests)
+	{
+		auto& design = designs[t.design];
+		uint64_t time = t.test.settle;
+		if( (time == 0) || (design.settled.find(time) != design.settled.end()) )
+			continue;
+		design.settled[time] = SettleModel(design.model, time);
+	}
+
+	vector<size_t> order;
+	for(size_t i=0; i<tests.size(); i++)
+		order.push_back(i);
+	stable_sort(order.begin(), order.end(), [&tests](size_t a, size_t b)
+		{ return tests[a].duration > tests[b].duration; });
+
+	unsigned int nthreads = max<size_t>(min<size_t>(jobs, tests.size()), 1);
+	LogNotice("Simulating %zu tests of %zu designs (%u threads)\n", tests.size(), designs.size(), nthreads);
+
+	atomic<size_t> next_test(0);
+	auto worker = [&]()
+	{
+		vector<Greenpak4SimulationModel*> models(designs.size(), NULL);
+		while(true)
+		{
+			size_t n = next_test ++;
+			if(n >= order.size())
+				break;
+			RegressionTest& t = tests[order[n]];
+			auto tstart = chrono::steady_clock::now();
+			readingvec readings;
+
+			if(t.test.settle != 0)
+			{
+				auto settled = designs[t.design].settled.find(t.test.settle)->second;
+				if( (settled == NULL) || !RunFromSnapshot(settled, t.test, t.onChip, readings) )
+					continue;
+			}
+			else
+			{
+				auto& model = models[t.design];
+				if(model == NULL)
+					model = designs[t.design].model->Clone();
+				if(model == NULL)
+					continue;
+				RunOnModel(model, t.test, t.onChip, readings);
+			}
+
+			t.passed = t.test.CheckExpected(readings, "in simulation");
+			t.seconds = chrono::duration<double>(chrono::steady_clock::now() - tstart).count();
+			t.ran = true;
+		}
+
+		for(auto m : models)
+			delete m;
+	};
+
+	vector<thread> threads;
+	for(unsigned int i=0; i<nthreads; i++)
+		threads.push_back(thread(worker));
+	for(auto& t : threads)
+		t.join();
+
+	double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+	unsigned int npassed = 0;
+	double slowest = 0;
+	double total = 0;
+	for(auto& t : tests)
+	{
+		if(t.passed)
+			npassed ++;
+		slowest = max(slowest, t.seconds);
+		total += t.seconds;
+	}
+
+	for(auto& design : designs)
+	{
+		for(auto& it : design.settled)
+			delete it.second;
+		delete design.model;
+		delete design.device;
+	}
+
+	bool ok = true;
+	if( (report_fname != "") && !WriteReport(report_fname, designs, tests, seconds) )
+		ok = false;
+
+	LogNotice("%u of %zu tests passed in %.2f s (slowest test %.2f s, %.2f s of simulation in all)\n",
+		npassed, tests.size(), seconds, slowest, total);
+	return ok && (npassed == tests.size());
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Loading
+
+/**
+	@brief Reads a regression list, and the stimulus scripts it names
+
+	Each line is a design, given as a bitstream or a model compiled by gp4simgen (a .so), followed by the scripts to run
+	on it. Before the design, "--part <part>" overrides the part (for a bitstream), "--on-chip" says the bitstream
+	makes its own drives, and "--settle <time>" overrides the settle time. # starts a comment. A design can appear on
+	more than one line, and is only loaded once.
+ */
+static bool ReadRegressionList(
+	const string& fname,
+	Greenpak4Device::GREENPAK4_PART part,
+	uint64_t settle,
+	vector<RegressionDesign>& designs,
+	vector<RegressionTest>& tests)
+{
+	FILE* fp = fopen(fname.c_str(), "r");
+	if(!fp)
+	{
+		LogError("Couldn't open regression list %s\n", fname.c_str());
+		return false;
+	}
+
+	map<pair<string, Greenpak4Device::GREENPAK4_PART>, size_t> loaded;
+	bool ok = true;
+	char line[4096];
+	for(unsigned int nline = 1; ok && fgets(line, sizeof(line), fp); nline++)
+	{
+		char* comment = strchr(line, '#');
+		if(comment)
+			*comment = '\0';
+
+		vector<string> words;
+		for(char* w = strtok(line, " \t\r\n"); w; w = strtok(NULL, " \t\r\n"))
+			words.push_back(w);
+		if(words.empty())
+			continue;
+
+		RegressionDesign design;
+		design.part = part;
+		bool on_chip = false;
+		uint64_t line_settle = settle;
+		size_t i = 0;
+		for(; (i < words.size()) && (words[i][0] == '-'); i++)
+		{
+			if(words[i] == "--on-chip")
+				on_chip = true;
+			else if( (words[i] == "--settle") && (i+1 < words.size()) )
+			{
+				if(!ParseDelay(words[++i].c_str(), line_settle))
+				{
+					LogError("%s:%u: invalid settle time %s\n", fname.c_str(), nline, words[i].c_str());
+					ok = false;
+				}
+			}
+			else if( (words[i] == "--part") && (i+1 < words.size()) )
+			{
+				string partname = words[++i];
+				if(partname == "SLG46620V")
+					design.part = Greenpak4Device::GREENPAK4_SLG46620;
+				else if(partname == "SLG46621V")
+					design.part = Greenpak4Device::GREENPAK4_SLG46621;
+				else if(partname == "SLG46140V")
+					design.part = Greenpak4Device::GREENPAK4_SLG46140;
+				else
+				{
+					LogError("%s:%u: invalid part %s\n", fname.c_str(), nline, partname.c_str());
+					ok = false;
+				}
+			}
+			else
+			{
+				LogError("%s:%u: unrecognized option %s\n", fname.c_str(), nline, words[i].c_str());
+				ok = false;
+			}
+		}
+		if(i + 2 > words.size())
+		{
+			LogError("%s:%u: expected a design and at least one stimulus script\n", fname.c_str(), nline);
+			ok = false;
+		}
+		if(!ok)
+			break;
+
+		design.fname = words[i++];
+		auto key = make_pair(design.fname, design.part);
+		auto it = loaded.find(key);
+		size_t index = designs.size();
+		if(it != loaded.end())
+			index = it->second;
+		else
+		{
+			loaded[key] = index;
+			designs.push_back(design);
+		}
+
+		for(; i < words.size(); i++)
+		{
+			vector<StimulusTest> script;
+			if(!ReadStimulusFile(words[i], script))
+			{
+				ok = false;
+				break;
+			}
+			for(auto& test : script)
+			{
+				test.settle = line_settle;
+				tests.push_back(RegressionTest(index, test, on_chip));
+			}
+		}
+	}
+
+	fclose(fp);
+	return ok;
+}
+
+/**
+	@brief Loads the model of a design (a bitstream, or a .so compiled from one)
+ */
+static bool LoadDesign(RegressionDesign& design)
+{
+	const string& fname = design.fname;
+	if( (fname.length() > 3) && (fname.compare(fname.length() - 3, 3, ".so") == 0) )
+	{
+		LogVerbose("Loading compiled simulation model \"%s\"\n", fname.c_str());
+		Greenpak4CompiledModel* model = new Greenpak4CompiledModel;
+		design.model = model;
+		return model->Load(fname);
+	}
+
+	LogVerbose("Loading bitstream \"%s\"\n", fname.c_str());
+	LogIndenter li;
+	design.device = new Greenpak4Device(design.part);
+	uint8_t userid;
+	bool readProtect;
+	if(!design.device->LoadFromFile(fname, userid, readProtect))
+		return false;
+
+	Greenpak4Simulator* sim = new Greenpak4Simulator(design.device);
+	design.model = sim;
+	return sim->Build();
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Report
+
+/**
+	@brief Writes the results of a regression, one "pass|fail seconds design script:line name" line per test
+
+	Tests are in the order of the regression list. One whose model couldn't be cloned (or snapshotted) is "error".
+ */
+static bool WriteReport(
+	const string& fname,
+	const vector<RegressionDesign>& designs,
+	const vector<RegressionTest>& tests,
+	double seconds)
+{
+	FILE* fp = fopen(fname.c_str(), "w");
+	if(!fp)
+	{
+		LogError("Couldn't open %s for writing\n", fname.c_str());
+		return false;
+	}
+
+	unsigned int npassed = 0;
+	for(auto& t : tests)
+	{
+		if(t.passed)
+			npassed ++;
+	}
+	fprintf(fp, "# %u of %zu tests passed, %zu designs, %.3f s\n", npassed, tests.size(), designs.size(), seconds);
+
+	for(auto& t : tests)
+	{
+		const char* verdict = !t.ran ? "error" : (t.passed ? "pass" : "fail");
+		fprintf(fp, "%-5s %8.3f %s %s:%u %s\n", verdict, t.seconds, designs[t.design].fname.c_str(),
+			t.test.fname.c_str(), t.test.line, t.test.name.c_str());
+	}
+
+	fclose(fp);
+	return true;
+}
@@ -0,0 +1,39 @@
+/***********************************************************************************************************************
+ * Copyright (C) 2016 Andrew Zonenberg and contributors                                                                *
+ *                                                                                                                     *
+ * This program is free software; you can redistribute it and/or modify it under the terms of the GNU Lesser General   *
+ * Public License as published by the Free Software Foundation; either version 2.1 of the License, or (at your option) *
+ * any later version.                                                                                                  *
+ *                                                                                                                     *
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied  *
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for     *
+ * more details.                                                                                                       *
+ *                                                                                                                     *
+ * You should have received a copy of the GNU Lesser General Public License along with this program; if not, you may   *
+ * find one here:                                                                                                      *
+ * https://www.gnu.org/licenses/old-licenses/lgpl-2.1.txt                                                              *
+ * or you may search the http://www.gnu.org website for the version 2.1 license, or you may write to the Free Software *
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA                                      *
+ **********************************************************************************************************************/
+
+#ifndef Regression_h
+#define Regression_h
+
+#include "StimulusScript.h"
+#include <Greenpak4.h>
+#include <string>
+
+void RunOnModel(Greenpak4SimulationModel* model, const StimulusTest& test, bool on_chip, readingvec& readings);
+bool RunFromSnapshot(Greenpak4SimulationModel* settled, const StimulusTest& test, bool on_chip, readingvec& readings);
+Greenpak4SimulationModel* SettleModel(Greenpak4SimulationModel* model, uint64_t settle);
+void PowerUp(Greenpak4SimulationModel* model, uint64_t settle);
+void RunSteps(Greenpak4SimulationModel* model, const StimulusTest& test, bool on_chip, readingvec& readings);
+
+bool RunRegression(
+	std::string fname,
+	Greenpak4Device::GREENPAK4_PART part,
+	unsigned int jobs,
+	uint64_t settle,
+	std::string report_fname);
+
+#endif
@@ -0,0 +1,323 @@
+/***********************************************************************************************************************
+ * Copyright (C) 2016 Andrew Zonenberg and contributors                                                                *
+ *                                                                                                                     *
+ * This program is free software; you can redistribute it and/or modify it under the terms of the GNU Lesser General   *
+ * Public License as published by the Free Software Foundation; either version 2.1 of the License, or (at your option) *
+ * any later version.                                                                                                  *
+ *                                                                                                                     *
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied  *
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for     *
+ * more details.                                                                                                       *
+ *                                                                                                                     *
+ * You should have received a copy of the GNU Lesser General Public License along with this program; if not, you may   *
+ * find one here:                                                                                                      *
+ * https://www.gnu.org/licenses/old-licenses/lgpl-2.1.txt                                                              *
+ * or you may search the http://www.gnu.org website for the version 2.1 license, or you may write to the Free Software *
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA                                      *
+ **********************************************************************************************************************/
+
+#include "StimulusCompiler.h"
+#include <log.h>
+#include <cctype>
+#include <cinttypes>
+#include <map>
+
+using namespace std;
+
+/**
+	@brief One speed the RC oscillator can clock the counters at
+ */
+class StimulusClock
+{
+public:
+	const char* freq;
+	unsigned int div;
+
+	///Length of a cycle, in ps
+	uint64_t period;
+};
+
+//Fastest first, so the edges come as close to where the script puts them as the counters allow
+static const StimulusClock g_stimulusClocks[] =
+{
+	{ "2M",		1,	500000ULL },
+	{ "2M",		8,	4000000ULL },
+	{ "25k",	1,	40000000ULL },
+	{ "25k",	8,	320000000ULL }
+};
+
+//Largest COUNT_TO of the 8- and 14-bit counters
+static const uint64_t COUNT8_MAX = 0xff;
+static const uint64_t COUNT14_MAX = 0x3fff;
+
+//Steps in the pattern generator
+static const uint64_t PGEN_MAX_LEN = 16;
+
+/**
+	@brief What one pin does over the course of a test
+ */
+class StimulusPin
+{
+public:
+	StimulusPin()
+		: initial(false)
+		, first(0)
+	{}
+
+	///Value from power-up
+	bool initial;
+
+	///When the test first drives the pin, in ps
+	uint64_t first;
+
+	///When it changes after that, in ps
+	vector<uint64_t> edges;
+};
+
+static uint64_t GreatestCommonDivisor(uint64_t a, uint64_t b);
+static bool FitsClock(const map<unsigned int, StimulusPin>& pins, uint64_t end, const StimulusClock& clock);
+static void WriteCounter(FILE* fp, const string& name, uint64_t count, const string& out);
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Stimulus modules
+
+/**
+	@brief Writes a Verilog module that makes a test's drives on-chip, so the board only has to read back the checks
+
+	Each pin the test drives becomes an output of the module, named p<pin>, to be connected to the design in place of
+	that input. A pin that's only ever driven one way is tied off, one that changes once is a flipflop clocked by a
+	counter, and one that changes more often than that is played back by the pattern generator (there's only one, so
+	only one pin can do that). A pin has its first value from power-up, and can't be left floating.
+
+	The counters are clocked by the RC oscillator, at the highest speed that lets them reach the last edge, so the
+	edges are within a cycle or so of where the script puts them. The pattern generator plays the test through once,
+	and starts over after its last step.
+
+	@return False if the test needs more than the device has
+ */
+bool WriteStimulusModule(FILE* fp, const StimulusTest& test)
+{
+	//Find out when each pin changes (counting from power-up, so including the settle time)
+	map<unsigned int, StimulusPin> pins;
+	uint64_t now = test.settle;
+	for(auto& step : test.steps)
+	{
+		if(step.op == StimulusStep::WAIT)
+			now += step.delay;
+		if(step.op != StimulusStep::DRIVE)
+			continue;
+
+		if(step.state == Greenpak4SimulationModel::PIN_FLOAT)
+		{
+			LogError("%s:%u: P%u can't be left floating by on-chip stimulus\n",
+				test.fname.c_str(), step.line, step.pin);
+			return false;
+		}
+		bool value = (step.state == Greenpak4SimulationModel::PIN_HIGH);
+
+		auto it = pins.find(step.pin);
+		if(it == pins.end())
+		{
+			pins[step.pin].initial = value;
+			pins[step.pin].first = now;
+			continue;
+		}
+
+		StimulusPin& pin = it->second;
+		if(now == pin.first)
+			pin.initial = value;
+		else if(value != (pin.initial ^ (pin.edges.size() & 1)))
+		{
+			//Driving a value back before any time has passed cancels out
+			if(!pin.edges.empty() && (pin.edges.back() == now))
+				pin.edges.pop_back();
+			else
+				pin.edges.push_back(now);
+		}
+	}
+
+	if(pins.empty())
+	{
+		LogError("%s:%u: Test %s doesn't drive anything\n", test.fname.c_str(), test.line, test.name.c_str());
+		return false;
+	}
+
+	unsigned int npatterns = 0;
+	for(auto& it : pins)
+	{
+		if(it.second.edges.size() > 1)
+			npatterns ++;
+	}
+	if(npatterns > 1)
+	{
+		LogError("%s:%u: Test %s has %u pins that change more than once, but there's only one pattern generator\n",
+			test.fname.c_str(), test.line, test.name.c_str(), npatterns);
+		return false;
+	}
+
+	const StimulusClock* clock = NULL;
+	for(auto& c : g_stimulusClocks)
+	{
+		if(FitsClock(pins, now, c))
+		{
+			clock = &c;
+			break;
+		}
+	}
+	if(!clock)
+	{
+		LogError("%s:%u: Test %s can't be timed by the counters: its edges need to be within %" PRIu64
+			" cycles of the RC oscillator, and the pattern generator's on no more than %" PRIu64 " equal steps\n",
+			test.fname.c_str(), test.line, test.name.c_str(), COUNT14_MAX, PGEN_MAX_LEN);
+		return false;
+	}
+
+	//Module names can only have some characters in them
+	string name = "stim_";
+	for(auto ch : test.name)
+		name += isalnum(ch) ? ch : '_';
+
+	fprintf(fp, "//Stimulus for test %s (%s:%u), from gp4difftest --emit-stimulus\n",
+		test.name.c_str(), test.fname.c_str(), test.line);
+	fprintf(fp, "module %s(", name.c_str());
+	for(auto it = pins.begin(); it != pins.end(); it++)
+		fprintf(fp, "%sp%u", (it == pins.begin()) ? "" : ", ", it->first);
+	fprintf(fp, ");\n\n");
+	for(auto& it : pins)
+		fprintf(fp, "\toutput wire p%u;\n", it.first);
+	fprintf(fp, "\n");
+
+	fprintf(fp, "\t//%.3f us per cycle\n", clock->period / 1e6);
+	fprintf(fp, "\twire clk;\n");
+	fprintf(fp, "\tGP_RCOSC #(\n");
+	fprintf(fp, "\t\t.PWRDN_EN(0),\n");
+	fprintf(fp, "\t\t.AUTO_PWRDN(0),\n");
+	fprintf(fp, "\t\t.OSC_FREQ(\"%s\"),\n", clock->freq);
+	fprintf(fp, "\t\t.HARDIP_DIV(%u),\n", clock->div);
+	fprintf(fp, "\t\t.FABRIC_DIV(1)\n");
+	fprintf(fp, "\t) rcosc (\n");
+	fprintf(fp, "\t\t.PWRDN(1'b0),\n");
+	fprintf(fp, "\t\t.CLKOUT_HARDIP(clk),\n");
+	fprintf(fp, "\t\t.CLKOUT_FABRIC()\n");
+	fprintf(fp, "\t);\n");
+
+	uint64_t end = (now + clock->period/2) / clock->period;
+	for(auto& it : pins)
+	{
+		unsigned int npin = it.first;
+		const StimulusPin& pin = it.second;
+		fprintf(fp, "\n");
+
+		if(pin.edges.empty())
+			fprintf(fp, "\tassign p%u = 1'b%d;\n", npin, pin.initial);
+
+		//The counter reaches zero once the edge is due, which clocks the final value into the flipflop
+		else if(pin.edges.size() == 1)
+		{
+			uint64_t count = (pin.edges[0] + clock->period/2) / clock->period;
+			fprintf(fp, "\t//P%u changes at %.3f us\n", npin, pin.edges[0] / 1e6);
+			fprintf(fp, "\twire p%u_due;\n", npin);
+			WriteCounter(fp, "p" + to_string(npin) + "_count", count, "p" + to_string(npin) + "_due");
+			fprintf(fp, "\tGP_DFF #(\n");
+			fprintf(fp, "\t\t.INIT(1'b%d)\n", pin.initial);
+			fprintf(fp, "\t) p%u_ff (\n", npin);
+			fprintf(fp, "\t\t.D(1'b%d),\n", !pin.initial);
+			fprintf(fp, "\t\t.CLK(p%u_due),\n", npin);
+			fprintf(fp, "\t\t.Q(p%u)\n", npin);
+			fprintf(fp, "\t);\n");
+		}
+
+		//The pattern generator steps every time the counter reaches zero
+		else
+		{
+			uint64_t step = 0;
+			for(auto t : pin.edges)
+				step = GreatestCommonDivisor(step, (t + clock->period/2) / clock->period);
+			uint64_t len = max<uint64_t>(2, end/step + 1);
+
+			unsigned int pattern = 0;
+			size_t nedge = 0;
+			bool value = pin.initial;
+			for(uint64_t i=0; i<len; i++)
+			{
+				while( (nedge < pin.edges.size()) &&
+					((pin.edges[nedge] + clock->period/2) / clock->period <= i*step) )
+				{
+					value = !value;
+					nedge ++;
+				}
+				pattern |= value << i;
+			}
+
+			fprintf(fp, "\t//P%u changes %zu times, on %" PRIu64 " steps of %.3f us\n",
+				npin, pin.edges.size(), len, step * clock->period / 1e6);
+			fprintf(fp, "\twire pgen_step;\n");
+			WriteCounter(fp, "pgen_count", step - 1, "pgen_step");
+			fprintf(fp, "\tGP_PGEN #(\n");
+			fprintf(fp, "\t\t.PATTERN_DATA(16'h%04x),\n", pattern);
+			fprintf(fp, "\t\t.PATTERN_LEN(5'd%" PRIu64 ")\n", len);
+			fprintf(fp, "\t) pgen (\n");
+			fprintf(fp, "\t\t.nRST(1'b1),\n");
+			fprintf(fp, "\t\t.CLK(pgen_step),\n");
+			fprintf(fp, "\t\t.OUT(p%u)\n", npin);
+			fprintf(fp, "\t);\n");
+		}
+	}
+
+	fprintf(fp, "\nendmodule\n\n");
+	return true;
+}
+
+/**
+	@brief Checks if a clock speed can time every edge of a test that ends at the given time (ps)
+ */
+static bool FitsClock(const map<unsigned int, StimulusPin>& pins, uint64_t end, const StimulusClock& clock)
+{
+	for(auto& it : pins)
+	{
+		auto& edges = it.second.edges;
+		if(edges.empty())
+			continue;
+
+		//Every edge has to be at least one cycle in, and within a counter's reach
+		uint64_t step = 0;
+		for(auto t : edges)
+		{
+			uint64_t count = (t + clock.period/2) / clock.period;
+			if( (count == 0) || (count > COUNT14_MAX) )
+				return false;
+			step = GreatestCommonDivisor(step, count);
+		}
+
+		//A pattern generator step is a count to zero and back, which takes two cycles at least
+		if(edges.size() == 1)
+			continue;
+		if( (step < 2) || ( (end + clock.period/2) / clock.period / step + 1 > PGEN_MAX_LEN) )
+			return false;
+	}
+	return true;
+}
+
+static void WriteCounter(FILE* fp, const string& name, uint64_t count, const string& out)
+{
+	fprintf(fp, "\tGP_COUNT%s #(\n", (count > COUNT8_MAX) ? "14" : "8");
+	fprintf(fp, "\t\t.CLKIN_DIVIDE(1),\n");
+	fprintf(fp, "\t\t.COUNT_TO(%" PRIu64 "),\n", count);
+	fprintf(fp, "\t\t.RESET_MODE(\"RISING\")\n");
+	fprintf(fp, "\t) %s (\n", name.c_str());
+	fprintf(fp, "\t\t.CLK(clk),\n");
+	fprintf(fp, "\t\t.RST(1'b0),\n");
+	fprintf(fp, "\t\t.OUT(%s)\n", out.c_str());
+	fprintf(fp, "\t);\n");
+}
+
+static uint64_t GreatestCommonDivisor(uint64_t a, uint64_t b)
+{
+	while(b)
+	{
+		uint64_t t = a % b;
+		a = b;
+		b = t;
+	}
+	return a;
+}
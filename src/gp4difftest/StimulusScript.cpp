@@ -0,0 +1,286 @@
+/***********************************************************************************************************************
+ * Copyright (C) 2016 Andrew Zonenberg and contributors                                                                *
+ *                                                                                                                     *
+ * This program is free software; you can redistribute it and/or modify it under the terms of the GNU Lesser General   *
+ * Public License as published by the Free Software Foundation; either version 2.1 of the License, or (at your option) *
+ * any later version.                                                                                                  *
+ *                                                                                                                     *
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied  *
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for     *
+ * more details.                                                                                                       *
+ *                                                                                                                     *
+ * You should have received a copy of the GNU Lesser General Public License along with this program; if not, you may   *
+ * find one here:                                                                                                      *
+ * https://www.gnu.org/licenses/old-licenses/lgpl-2.1.txt                                                              *
+ * or you may search the http://www.gnu.org website for the version 2.1 license, or you may write to the Free Software *
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA                                      *
+ **********************************************************************************************************************/
+
+#include "StimulusScript.h"
+#include <log.h>
+#include <Greenpak4.h>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+using namespace std;
+
+static bool ParsePin(const char* s, unsigned int& pin);
+static bool ParseState(const char* s, Greenpak4SimulationModel::PinState& state);
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Parsing
+
+/**
+	@brief Reads the tests in a stimulus script and appends them to a list
+
+	A script is one command per line, and # starts a comment:
+
+		test <name>					Starts a new test (run from power-up)
+		drive <pin> <0|1|z>			Drives a pin from the test board, or leaves it floating
+		wait <time><ps|ns|us|ms|s>	Lets time pass
+		check <pin> [0|1]			Reads a pin back, and if a value is given, checks it
+
+	Pins are numbered as on the package, with or without a leading P. The board applies all of the drives between two
+	waits or checks at once, so if their order matters, put a wait between them.
+ */
+bool ReadStimulusFile(string fname, vector<StimulusTest>& tests)
+{
+	FILE* fp = fopen(fname.c_str(), "r");
+	if(!fp)
+	{
+		LogError("Couldn't open stimulus file %s\n", fname.c_str());
+		return false;
+	}
+
+	size_t first = tests.size();
+	bool ok = true;
+	char line[1024];
+	for(unsigned int nline = 1; ok && fgets(line, sizeof(line), fp); nline++)
+	{
+		char* comment = strchr(line, '#');
+		if(comment)
+			*comment = '\0';
+
+		//Split the line into at most four words, so we notice trailing junk
+		char* words[4] = {NULL};
+		unsigned int nwords = 0;
+		for(char* w = strtok(line, " \t\r\n"); w; w = strtok(NULL, " \t\r\n"))
+		{
+			if(nwords == 4)
+				break;
+			words[nwords++] = w;
+		}
+		if(nwords == 0)
+			continue;
+
+		string cmd = words[0];
+		if(cmd == "test")
+		{
+			if(nwords != 2)
+			{
+				LogError("%s:%u: usage: test <name>\n", fname.c_str(), nline);
+				ok = false;
+				break;
+			}
+			for(size_t i=first; i<tests.size(); i++)
+			{
+				if(tests[i].name == words[1])
+				{
+					LogError("%s:%u: there's already a test called \"%s\" (on line %u)\n",
+						fname.c_str(), nline, words[1], tests[i].line);
+					ok = false;
+				}
+			}
+			tests.push_back(StimulusTest(words[1], fname, nline));
+			continue;
+		}
+
+		if(tests.size() == first)
+		{
+			LogError("%s:%u: \"%s\" before the first test\n", fname.c_str(), nline, words[0]);
+			ok = false;
+			break;
+		}
+		vector<StimulusStep>& steps = tests.back().steps;
+
+		if(cmd == "drive")
+		{
+			StimulusStep step(StimulusStep::DRIVE, nline);
+			if( (nwords != 3) || !ParsePin(words[1], step.pin) || !ParseState(words[2], step.state) )
+			{
+				LogError("%s:%u: usage: drive <pin> <0|1|z>\n", fname.c_str(), nline);
+				ok = false;
+			}
+			steps.push_back(step);
+		}
+		else if(cmd == "wait")
+		{
+			StimulusStep step(StimulusStep::WAIT, nline);
+			if( (nwords != 2) || !ParseDelay(words[1], step.delay) )
+			{
+				LogError("%s:%u: usage: wait <time><ps|ns|us|ms|s>\n", fname.c_str(), nline);
+				ok = false;
+			}
+			steps.push_back(step);
+		}
+		else if(cmd == "check")
+		{
+			StimulusStep step(StimulusStep::CHECK, nline);
+			bool valid = ( (nwords == 2) || (nwords == 3) ) && ParsePin(words[1], step.pin);
+			if(valid && (nwords == 3) )
+			{
+				step.expected = true;
+				valid = ParseState(words[2], step.state) && (step.state != Greenpak4SimulationModel::PIN_FLOAT);
+			}
+			if(!valid)
+			{
+				LogError("%s:%u: usage: check <pin> [0|1]\n", fname.c_str(), nline);
+				ok = false;
+			}
+			steps.push_back(step);
+		}
+		else
+		{
+			LogError("%s:%u: unknown command \"%s\"\n", fname.c_str(), nline, words[0]);
+			ok = false;
+		}
+	}
+
+	fclose(fp);
+	return ok;
+}
+
+/**
+	@brief Parses a test point number (P2...P20, except ground on P11)
+ */
+static bool ParsePin(const char* s, unsigned int& pin)
+{
+	if( (*s == 'P') || (*s == 'p') )
+		s++;
+
+	char* end;
+	unsigned long n = strtoul(s, &end, 10);
+	if( (end == s) || (*end != '\0') || (n < 2) || (n > 20) || (n == 11) )
+		return false;
+
+	pin = n;
+	return true;
+}
+
+static bool ParseState(const char* s, Greenpak4SimulationModel::PinState& state)
+{
+	if(!strcmp(s, "0"))
+		state = Greenpak4SimulationModel::PIN_LOW;
+	else if(!strcmp(s, "1"))
+		state = Greenpak4SimulationModel::PIN_HIGH;
+	else if(!strcmp(s, "z") || !strcmp(s, "Z"))
+		state = Greenpak4SimulationModel::PIN_FLOAT;
+	else
+		return false;
+	return true;
+}
+
+/**
+	@brief Parses a time with a unit suffix into ps
+ */
+bool ParseDelay(const char* s, uint64_t& delay)
+{
+	char* end;
+	uint64_t n = strtoull(s, &end, 10);
+	if(end == s)
+		return false;
+
+	string unit = end;
+	uint64_t scale;
+	if(unit == "ps")
+		scale = 1;
+	else if(unit == "ns")
+		scale = 1000;
+	else if(unit == "us")
+		scale = 1000000;
+	else if(unit == "ms")
+		scale = 1000000000;
+	else if(unit == "s")
+		scale = 1000000000000LL;
+	else
+		return false;
+
+	if(n > UINT64_MAX / scale)
+		return false;
+	delay = n * scale;
+	return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Results
+
+/**
+	@brief Hashes the test's steps together with the readings they produced (FNV-1a)
+
+	Two runs with the same signature did the same thing to the pins and saw the same values come back, so if the board
+	agreed with the simulation last time it will this time too.
+ */
+uint64_t StimulusTest::GetSignature(const readingvec& readings) const
+{
+	uint64_t hash = Greenpak4Netlist::HashBytes(NULL, 0);
+	auto mix = [&hash](uint64_t value)
+	{
+		uint8_t bytes[8];
+		for(int i=0; i<8; i++)
+			bytes[i] = value >> (i*8);
+		hash = Greenpak4Netlist::HashBytes(bytes, sizeof(bytes), hash);
+	};
+
+	for(auto c : name)
+		mix(c);
+	if(settle != 0)
+		mix(settle);
+	for(auto& step : steps)
+	{
+		mix(step.op);
+		mix(step.pin);
+		mix(step.state);
+		mix(step.expected);
+		mix(step.delay);
+	}
+	for(auto r : readings)
+		mix(r);
+	return hash;
+}
+
+/**
+	@brief Checks readings against the values the script expects, and logs any that don't match
+ */
+bool StimulusTest::CheckExpected(const readingvec& readings, const char* where) const
+{
+	bool ok = true;
+	size_t n = 0;
+	for(auto& step : steps)
+	{
+		if(step.op != StimulusStep::CHECK)
+			continue;
+
+		auto actual = readings[n++];
+		if(step.expected && (actual != step.state) )
+		{
+			LogError("%s:%u: P%u should be %s, but is %s %s\n",
+				fname.c_str(), step.line, step.pin, PinStateName(step.state), PinStateName(actual), where);
+			ok = false;
+		}
+	}
+	return ok;
+}
+
+const char* PinStateName(Greenpak4SimulationModel::PinState state)
+{
+	switch(state)
+	{
+		case Greenpak4SimulationModel::PIN_LOW:
+			return "0";
+		case Greenpak4SimulationModel::PIN_HIGH:
+			return "1";
+		default:
+			return "z";
+	}
+}
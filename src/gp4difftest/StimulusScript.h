@@ -0,0 +1,99 @@
+/***********************************************************************************************************************
+ * Copyright (C) 2016 Andrew Zonenberg and contributors                                                                *
+ *                                                                                                                     *
+ * This program is free software; you can redistribute it and/or modify it under the terms of the GNU Lesser General   *
+ * Public License as published by the Free Software Foundation; either version 2.1 of the License, or (at your option) *
+ * any later version.                                                                                                  *
+ *                                                                                                                     *
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied  *
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for     *
+ * more details.                                                                                                       *
+ *                                                                                                                     *
+ * You should have received a copy of the GNU Lesser General Public License along with this program; if not, you may   *
+ * find one here:                                                                                                      *
+ * https://www.gnu.org/licenses/old-licenses/lgpl-2.1.txt                                                              *
+ * or you may search the http://www.gnu.org website for the version 2.1 license, or you may write to the Free Software *
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA                                      *
+ **********************************************************************************************************************/
+
+#ifndef StimulusScript_h
+#define StimulusScript_h
+
+#include <Greenpak4SimulationModel.h>
+#include <string>
+#include <vector>
+
+/**
+	@brief One line of a stimulus script
+ */
+class StimulusStep
+{
+public:
+	enum Op
+	{
+		DRIVE,		//Drive a pin from the test board (or leave it floating)
+		WAIT,		//Let time pass
+		CHECK		//Read a pin back, and compare it to the expected value if there is one
+	};
+
+	StimulusStep(Op o, unsigned int l)
+		: op(o)
+		, line(l)
+		, pin(0)
+		, state(Greenpak4SimulationModel::PIN_FLOAT)
+		, expected(false)
+		, delay(0)
+	{}
+
+	Op op;
+	unsigned int line;
+
+	///Pin number, for DRIVE and CHECK
+	unsigned int pin;
+
+	///What a DRIVE drives, or the value a CHECK expects if expected is set
+	Greenpak4SimulationModel::PinState state;
+	bool expected;
+
+	///How long a WAIT is, in ps
+	uint64_t delay;
+};
+
+typedef std::vector<Greenpak4SimulationModel::PinState> readingvec;
+
+/**
+	@brief A named sequence of steps, run from power-up
+
+	The readings a test produces are one PinState per CHECK step, in order. PIN_FLOAT means the pin was left floating
+	at both ends, so its value on the board is whatever the test point's pullup makes it, and isn't compared.
+ */
+class StimulusTest
+{
+public:
+	StimulusTest(std::string n, std::string f, unsigned int l)
+		: name(n)
+		, fname(f)
+		, line(l)
+		, settle(0)
+	{}
+
+	uint64_t GetSignature(const readingvec& readings) const;
+
+	bool CheckExpected(const readingvec& readings, const char* where) const;
+
+	std::string name;
+	std::string fname;
+	unsigned int line;
+	std::vector<StimulusStep> steps;
+
+	///How long the device runs after power-up with nothing driving its pins before the first step, in ps (set by
+	///gp4difftest --settle rather than the script). Tests with the same settle time start from one snapshot.
+	uint64_t settle;
+};
+
+bool ReadStimulusFile(std::string fname, std::vector<StimulusTest>& tests);
+bool ParseDelay(const char* s, uint64_t& delay);
+
+const char* PinStateName(Greenpak4SimulationModel::PinState state);
+
+#endif
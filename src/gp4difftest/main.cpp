@@ -0,0 +1,682 @@
+/***********************************************************************************************************************
+ * Copyright (C) 2016 Andrew Zonenberg and contributors                                                                *
+ *                                                                                                                     *
+ * This program is free software; you can redistribute it and/or modify it under the terms of the GNU Lesser General   *
+ * Public License as published by the Free Software Foundation; either version 2.1 of the License, or (at your option) *
+ * any later version.                                                                                                  *
+ *                                                                                                                     *
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied  *
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for     *
+ * more details.                                                                                                       *
+ *                                                                                                                     *
+ * You should have received a copy of the GNU Lesser General Public License along with this program; if not, you may   *
+ * find one here:                                                                                                      *
+ * https://www.gnu.org/licenses/old-licenses/lgpl-2.1.txt                                                              *
+ * or you may search the http://www.gnu.org website for the version 2.1 license, or you may write to the Free Software *
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA                                      *
+ **********************************************************************************************************************/
+
+#include <Greenpak4Simulator.h>
+#include <gpdevboard.h>
+#include <log.h>
+#include <debuglog.h>
+#include <unistd.h>
+#include <cinttypes>
+#include <cstdlib>
+#include <map>
+#include <thread>
+#include "Regression.h"
+#include "StimulusCompiler.h"
+
+using namespace std;
+
+void ShowUsage();
+void ShowVersion();
+
+bool RunOnBoard(hdevice hdev, const StimulusTest& test, bool on_chip, readingvec& readings);
+void WaitOnBoard(uint64_t delay);
+bool EmitStimulus(string fname, const vector<StimulusTest>& tests);
+bool CompareReadings(const StimulusTest& test, const readingvec& sim, const readingvec& board);
+
+//Signature of each test's last board run, and whether it passed
+typedef map<string, pair<uint64_t, bool> > resultmap;
+
+bool ReadResults(string fname, resultmap& results);
+bool WriteResults(string fname, const resultmap& results);
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Entry point
+
+int main(int argc, char* argv[])
+{
+	Severity console_verbosity = Severity::NOTICE;
+
+	string fname;
+	vector<string> scripts;
+	string results_fname;
+	string stimulus_fname;
+	vector<string> only_tests;
+	string regress_fname;
+	string report_fname;
+	unsigned int jobs = max(thread::hardware_concurrency(), 1u);
+	uint64_t settle = 0;
+	bool sim_only = false;
+	bool run_all = false;
+	bool on_chip = false;
+	Greenpak4Device::GREENPAK4_PART part = Greenpak4Device::GREENPAK4_SLG46620;
+	SilegoPart board_part = SLG46620V;
+
+	//Parse command-line arguments
+	for(int i=1; i<argc; i++)
+	{
+		string s(argv[i]);
+
+		//Let the logger eat its args first
+		if(ParseLoggerArguments(i, argc, argv, console_verbosity))
+			continue;
+
+		else if(s == "--help")
+		{
+			ShowUsage();
+			return 0;
+		}
+		else if(s == "--version")
+		{
+			ShowVersion();
+			return 0;
+		}
+		else if(s == "-p" || s == "--part")
+		{
+			if(i+1 >= argc)
+			{
+				printf("--part requires an argument\n");
+				return 1;
+			}
+
+			string partname = argv[++i];
+			if(partname == "SLG46620V")
+			{
+				part = Greenpak4Device::GREENPAK4_SLG46620;
+				board_part = SLG46620V;
+			}
+			else if(partname == "SLG46621V")
+			{
+				part = Greenpak4Device::GREENPAK4_SLG46621;
+				board_part = SLG46621V;
+			}
+			else if(partname == "SLG46140V")
+			{
+				part = Greenpak4Device::GREENPAK4_SLG46140;
+				board_part = SLG46140V;
+			}
+			else
+			{
+				printf("invalid part (supported: SLG46620V, SLG46621V, SLG46140V)\n");
+				return 1;
+			}
+		}
+		else if(s == "--results")
+		{
+			if(i+1 < argc)
+				results_fname = argv[++i];
+			else
+			{
+				printf("--results requires an argument\n");
+				return 1;
+			}
+		}
+		else if(s == "--emit-stimulus")
+		{
+			if(i+1 < argc)
+				stimulus_fname = argv[++i];
+			else
+			{
+				printf("--emit-stimulus requires an argument\n");
+				return 1;
+			}
+		}
+		else if(s == "--test")
+		{
+			if(i+1 < argc)
+				only_tests.push_back(argv[++i]);
+			else
+			{
+				printf("--test requires an argument\n");
+				return 1;
+			}
+		}
+		else if(s == "--regress")
+		{
+			if(i+1 < argc)
+				regress_fname = argv[++i];
+			else
+			{
+				printf("--regress requires an argument\n");
+				return 1;
+			}
+		}
+		else if(s == "--report")
+		{
+			if(i+1 < argc)
+				report_fname = argv[++i];
+			else
+			{
+				printf("--report requires an argument\n");
+				return 1;
+			}
+		}
+		else if(s == "-j" || s == "--jobs")
+		{
+			if( (i+1 >= argc) || (atoi(argv[i+1]) < 1) )
+			{
+				printf("--jobs requires a number of threads (at least 1)\n");
+				return 1;
+			}
+			jobs = atoi(argv[++i]);
+		}
+		else if(s == "--settle")
+		{
+			if( (i+1 >= argc) || !ParseDelay(argv[i+1], settle) )
+			{
+				printf("--settle requires a time (e.g. 10us)\n");
+				return 1;
+			}
+			i++;
+		}
+		else if(s == "--sim-only")
+			sim_only = true;
+		else if(s == "--all")
+			run_all = true;
+		else if(s == "--on-chip")
+			on_chip = true;
+
+		//The first non-switch argument is the bitstream (unless we're only writing stimulus), and the rest are scripts
+		else if(s[0] != '-')
+		{
+			if( (fname == "") && (stimulus_fname == "") )
+				fname = s;
+			else
+				scripts.push_back(s);
+		}
+
+		else
+		{
+			printf("Unrecognized command-line argument \"%s\", use --help\n", s.c_str());
+			return 1;
+		}
+	}
+
+	if( ( ( (fname == "") && (stimulus_fname == "") ) || scripts.empty() ) && (regress_fname == "") )
+	{
+		ShowUsage();
+		return 1;
+	}
+
+	//Set up logging
+	g_log_sinks.emplace(g_log_sinks.begin(), new STDLogSink(console_verbosity));
+	SetDebugLogging(console_verbosity >= Severity::DEBUG);
+
+	if(regress_fname != "")
+		return RunRegression(regress_fname, part, jobs, settle, report_fname) ? 0 : 1;
+
+	vector<StimulusTest> tests;
+	for(auto script : scripts)
+	{
+		if(!ReadStimulusFile(script, tests))
+			return 1;
+	}
+
+	if(!only_tests.empty())
+	{
+		vector<StimulusTest> selected;
+		for(auto name : only_tests)
+		{
+			bool found = false;
+			for(auto& test : tests)
+			{
+				if(test.name != name)
+					continue;
+				selected.push_back(test);
+				found = true;
+			}
+			if(!found)
+			{
+				LogError("No test named %s\n", name.c_str());
+				return 1;
+			}
+		}
+		tests = selected;
+	}
+	for(auto& test : tests)
+		test.settle = settle;
+
+	if(stimulus_fname != "")
+		return EmitStimulus(stimulus_fname, tests) ? 0 : 1;
+
+	Greenpak4Device device(part);
+	uint8_t userid;
+	bool readProtect;
+	LogNotice("Loading bitstream \"%s\"\n", fname.c_str());
+	if(!device.LoadFromFile(fname, userid, readProtect))
+		return 1;
+
+	Greenpak4Simulator sim(&device);
+	if(!sim.Build())
+		return 1;
+
+	//Every test settles for the same time, so they can all start from one snapshot of the settled device
+	Greenpak4SimulationModel* settled = NULL;
+	if(settle != 0)
+	{
+		settled = SettleModel(&sim, settle);
+		if(settled == NULL)
+			return 1;
+	}
+
+	//Run everything through the simulator first, since that doesn't cost any USB round trips
+	LogNotice("Simulating %zu tests\n", tests.size());
+	vector<readingvec> sim_readings(tests.size());
+	vector<bool> passed(tests.size());
+	unsigned int sim_passed = 0;
+	for(size_t i=0; i<tests.size(); i++)
+	{
+		if(settled == NULL)
+			RunOnModel(&sim, tests[i], on_chip, sim_readings[i]);
+		else if(!RunFromSnapshot(settled, tests[i], on_chip, sim_readings[i]))
+			return 1;
+		passed[i] = tests[i].CheckExpected(sim_readings[i], "in simulation");
+		if(passed[i])
+			sim_passed ++;
+	}
+	delete settled;
+	LogNotice("%u of %zu tests passed in simulation\n", sim_passed, tests.size());
+
+	if(sim_only)
+		return (sim_passed == tests.size()) ? 0 : 1;
+
+	//A test only needs the board if it does something different from the last time the board agreed with it
+	resultmap results;
+	if( (results_fname != "") && !ReadResults(results_fname, results) )
+		return 1;
+	vector<size_t> board_tests;
+	for(size_t i=0; i<tests.size(); i++)
+	{
+		auto it = results.find(tests[i].name);
+		uint64_t signature = tests[i].GetSignature(sim_readings[i]);
+		if(run_all || (it == results.end()) || (it->second.first != signature) || !it->second.second)
+			board_tests.push_back(i);
+		else
+			LogVerbose("Skipping %s, nothing has changed since it passed on the board\n", tests[i].name.c_str());
+	}
+
+	if(!board_tests.empty())
+	{
+		LogNotice("Running %zu tests on the board\n", board_tests.size());
+
+		vector<uint8_t> bitstream;
+		hdevice hdev = MultiBoardTestSetup(fname, 25000, 3.3, board_part, &bitstream);
+		if(!hdev)
+		{
+			LogError("Failed to open board\n");
+			return 1;
+		}
+
+		bool board_ok = true;
+		for(auto i : board_tests)
+		{
+			StimulusTest& test = tests[i];
+			LogVerbose("Running %s\n", test.name.c_str());
+			LogIndenter li;
+
+			readingvec board_readings;
+			if(!RestartTest(hdev, bitstream) || !RunOnBoard(hdev, test, on_chip, board_readings))
+			{
+				board_ok = false;
+				break;
+			}
+
+			bool ok = test.CheckExpected(board_readings, "on the board");
+			ok &= CompareReadings(test, sim_readings[i], board_readings);
+			results[test.name] = make_pair(test.GetSignature(sim_readings[i]), ok && passed[i]);
+			passed[i] = passed[i] && ok;
+		}
+
+		SetStatusLED(hdev, 0);
+		ResetAllSiggens(hdev);
+		Reset(hdev);
+		USBCleanup(hdev);
+
+		if(!board_ok)
+			return 1;
+	}
+
+	if( (results_fname != "") && !WriteResults(results_fname, results) )
+		return 1;
+
+	unsigned int npassed = 0;
+	for(auto p : passed)
+	{
+		if(p)
+			npassed ++;
+	}
+	LogNotice("%u of %zu tests passed (%zu run on the board, %zu skipped there)\n",
+		npassed, tests.size(), board_tests.size(), tests.size() - board_tests.size());
+	return (npassed == tests.size()) ? 0 : 1;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Running tests
+
+/**
+	@brief Runs a test on a simulation model from power-up
+
+	Pins the device isn't driving read back as whatever the test drives onto them. If the stimulus is on-chip, the
+	bitstream makes the drives itself and the pins are left floating.
+ */
+void RunOnModel(Greenpak4SimulationModel* model, const StimulusTest& test, bool on_chip, readingvec& readings)
+{
+	PowerUp(model, test.settle);
+	RunSteps(model, test, on_chip, readings);
+}
+
+/**
+	@brief Runs a test on a snapshot of a model that SettleModel() has already brought up to the test's settle time
+
+	@return False if the snapshot couldn't be taken
+ */
+bool RunFromSnapshot(Greenpak4SimulationModel* settled, const StimulusTest& test, bool on_chip, readingvec& readings)
+{
+	Greenpak4SimulationModel* model = settled->Snapshot();
+	if(model == NULL)
+		return false;
+	RunSteps(model, test, on_chip, readings);
+	delete model;
+	return true;
+}
+
+/**
+	@brief Makes a copy of a model that has been powered up and left to settle, to take snapshots of
+
+	@return The settled model, or NULL if it couldn't be cloned
+ */
+Greenpak4SimulationModel* SettleModel(Greenpak4SimulationModel* model, uint64_t settle)
+{
+	Greenpak4SimulationModel* settled = model->Clone();
+	if(settled != NULL)
+		PowerUp(settled, settle);
+	return settled;
+}
+
+/**
+	@brief Powers a model up with all of its pins floating, and runs it until the settle time
+ */
+void PowerUp(Greenpak4SimulationModel* model, uint64_t settle)
+{
+	for(unsigned int pin=0; pin<21; pin++)
+		model->SetPinInput(pin, Greenpak4SimulationModel::PIN_FLOAT);
+	model->Reset();
+	if(settle != 0)
+		model->RunUntil(settle);
+}
+
+/**
+	@brief Runs the steps of a test on a model that PowerUp() has brought up to the test's settle time
+ */
+void RunSteps(Greenpak4SimulationModel* model, const StimulusTest& test, bool on_chip, readingvec& readings)
+{
+	readingvec driven(21, Greenpak4SimulationModel::PIN_FLOAT);
+	uint64_t now = test.settle;
+	readings.clear();
+	for(auto& step : test.steps)
+	{
+		switch(step.op)
+		{
+			case StimulusStep::DRIVE:
+				if(on_chip)
+					break;
+				model->SetPinInput(step.pin, step.state);
+				driven[step.pin] = step.state;
+				break;
+
+			case StimulusStep::WAIT:
+				now += step.delay;
+				model->RunUntil(now);
+				break;
+
+			case StimulusStep::CHECK:
+				{
+					auto state = model->GetPinOutput(step.pin);
+					if(state == Greenpak4SimulationModel::PIN_FLOAT)
+						state = driven[step.pin];
+					readings.push_back(state);
+				}
+				break;
+		}
+	}
+}
+
+/**
+	@brief Runs a test on the board, which RestartTest() has just put back in its power-up state
+
+	Drives are collected up and sent in one SetIOConfig() when something needs them to have taken effect, so a block of
+	them costs one USB round trip (and they all change at once). Floating pins are left on the board's weak pullup.
+
+	With on-chip stimulus there's nothing to drive, so the only round trips are for the checks, and the edges happen
+	when the bitstream's counters say (each check is no earlier than the script puts it, but may be later).
+ */
+bool RunOnBoard(hdevice hdev, const StimulusTest& test, bool on_chip, readingvec& readings)
+{
+	IOConfig config;
+	for(size_t i = 2; i <= 20; i++)
+		config.driverConfigs[i] = TP_RESET;
+	bool dirty = false;
+
+	WaitOnBoard(test.settle);
+	readings.clear();
+	for(auto& step : test.steps)
+	{
+		if(step.op == StimulusStep::DRIVE)
+		{
+			if(on_chip)
+				continue;
+			if(step.state == Greenpak4SimulationModel::PIN_LOW)
+				config.driverConfigs[step.pin] = TP_GND;
+			else if(step.state == Greenpak4SimulationModel::PIN_HIGH)
+				config.driverConfigs[step.pin] = TP_VDD;
+			else
+				config.driverConfigs[step.pin] = TP_RESET;
+			dirty = true;
+			continue;
+		}
+
+		if(dirty)
+		{
+			if(!SetIOConfig(hdev, config))
+				return false;
+			dirty = false;
+		}
+
+		if(step.op == StimulusStep::WAIT)
+			WaitOnBoard(step.delay);
+		else
+		{
+			double v;
+			if(!SingleReadADC(hdev, step.pin, v))
+				return false;
+			LogDebug("P%u = %.3f V\n", step.pin, v);
+			readings.push_back( (v > 0.5) ? Greenpak4SimulationModel::PIN_HIGH : Greenpak4SimulationModel::PIN_LOW );
+		}
+	}
+
+	return true;
+}
+
+/**
+	@brief Lets the board run for a delay in ps (anything under a microsecond is lost in the USB latency anyway)
+ */
+void WaitOnBoard(uint64_t delay)
+{
+	uint64_t us = (delay + 999999) / 1000000;
+	sleep(us / 1000000);
+	usleep(us % 1000000);
+}
+
+/**
+	@brief Compares what the board read back with what the simulation did, and logs every difference
+ */
+bool CompareReadings(const StimulusTest& test, const readingvec& sim, const readingvec& board)
+{
+	bool ok = true;
+	size_t n = 0;
+	for(auto& step : test.steps)
+	{
+		if(step.op != StimulusStep::CHECK)
+			continue;
+
+		//Nobody drives the pin in simulation, so the board reads its own pullup
+		auto expected = sim[n];
+		auto actual = board[n++];
+		if( (expected == Greenpak4SimulationModel::PIN_FLOAT) || (expected == actual) )
+			continue;
+
+		LogError("%s:%u: P%u is %s on the board, but %s in simulation\n",
+			test.fname.c_str(), step.line, step.pin, PinStateName(actual), PinStateName(expected));
+		ok = false;
+	}
+	return ok;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// On-chip stimulus
+
+/**
+	@brief Writes a stimulus module for each test (see WriteStimulusModule())
+ */
+bool EmitStimulus(string fname, const vector<StimulusTest>& tests)
+{
+	FILE* fp = fopen(fname.c_str(), "w");
+	if(!fp)
+	{
+		LogError("Couldn't open %s for writing\n", fname.c_str());
+		return false;
+	}
+
+	fprintf(fp, "`default_nettype none\n\n");
+	bool ok = true;
+	for(auto& test : tests)
+		ok &= WriteStimulusModule(fp, test);
+	fclose(fp);
+
+	if(ok)
+		LogNotice("Wrote stimulus for %zu tests to %s\n", tests.size(), fname.c_str());
+	return ok;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Results file
+
+/**
+	@brief Reads the results of earlier board runs, one "signature pass|fail name" line per test
+
+	A file that doesn't exist yet is the same as an empty one.
+ */
+bool ReadResults(string fname, resultmap& results)
+{
+	FILE* fp = fopen(fname.c_str(), "r");
+	if(!fp)
+		return true;
+
+	uint64_t signature;
+	char verdict[8];
+	char name[256];
+	while(fscanf(fp, "%" SCNx64 " %7s %255s", &signature, verdict, name) == 3)
+		results[name] = make_pair(signature, string(verdict) == "pass");
+
+	bool ok = feof(fp);
+	fclose(fp);
+	if(!ok)
+		LogError("Couldn't read results file %s\n", fname.c_str());
+	return ok;
+}
+
+bool WriteResults(string fname, const resultmap& results)
+{
+	FILE* fp = fopen(fname.c_str(), "w");
+	if(!fp)
+	{
+		LogError("Couldn't open %s for writing\n", fname.c_str());
+		return false;
+	}
+
+	for(auto& it : results)
+		fprintf(fp, "%016" PRIx64 " %s %s\n", it.second.first, it.second.second ? "pass" : "fail", it.first.c_str());
+	fclose(fp);
+	return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Help
+
+void ShowUsage()
+{
+	printf(//                                                                               v 80th column
+		"Usage: gp4difftest [options] bitstream.txt script.stim [script.stim...]\n"
+		"       gp4difftest --emit-stimulus stim.v script.stim [script.stim...]\n"
+		"       gp4difftest --regress list.txt [--jobs n] [--report report.txt]\n"
+		"    Runs the tests in stimulus scripts against the simulation model of a\n"
+		"    bitstream, then against a dev board, and reports anywhere they disagree.\n"
+		"    All of the simulation runs first; only tests whose simulated behavior has\n"
+		"    changed since they last passed on the board go to the board.\n"
+		"    Inputs should be driven explicitly, since the board's test points have\n"
+		"    weak pullups and the simulation model doesn't.\n"
+		"    With --emit-stimulus, writes a Verilog module for each test instead that\n"
+		"    makes its drives from counters and the pattern generator, to be built\n"
+		"    into the bitstream in place of those inputs and run with --on-chip.\n"
+		"    With --regress, simulates every test of every design in a list (each\n"
+		"    line is [--part P] [--on-chip] [--settle T] design script.stim...; a\n"
+		"    design is a bitstream or a gp4simgen model) on a pool of threads, and\n"
+		"    exits.\n"
+		"    -q, --quiet\n"
+		"        Causes only warnings and errors to be written to the console.\n"
+		"        Specify twice to also silence warnings.\n"
+		"    --verbose\n"
+		"        Prints additional information about the design.\n"
+		"    --debug\n"
+		"        Prints lots of internal debugging information.\n"
+		"    --all\n"
+		"        Runs every test on the board, even ones that passed there before.\n"
+		"    --emit-stimulus      <file>\n"
+		"        Writes on-chip stimulus for the tests to <file>, and exits.\n"
+		"    -j, --jobs           <n>\n"
+		"        Number of threads for --regress (default: one per CPU).\n"
+		"    --on-chip\n"
+		"        The bitstream makes the drives itself, so the board only reads back.\n"
+		"    -p, --part           <part>\n"
+		"        Specifies the part the bitstream is for (default SLG46620V).\n"
+		"        Supported: SLG46620V, SLG46621V, SLG46140V.\n"
+		"    --regress            <list>\n"
+		"        Runs the regression in <list> in simulation, and exits.\n"
+		"    --report             <file>\n"
+		"        Writes a line per --regress test to <file>.\n"
+		"    --results            <file>\n"
+		"        Remembers which tests passed on the board in <file>. Without it,\n"
+		"        every test runs on the board.\n"
+		"    --settle             <time>\n"
+		"        Lets the device run for <time> (e.g. 10us) after power-up before each\n"
+		"        test starts. It only runs once in simulation; every test starts from\n"
+		"        a snapshot of it. Default for --regress lines too.\n"
+		"    --sim-only\n"
+		"        Only runs the simulation, checking the values the scripts expect.\n"
+		"    --test               <name>\n"
+		"        Only runs the named test (may be given more than once).\n");
+}
+
+void ShowVersion()
+{
+	printf(
+		"GreenPAK 4 differential test runner by Andrew D. Zonenberg.\n"
+		"\n"
+		"License: LGPL v2.1+\n"
+		"This is free software: you are free to change and redistribute it.\n"
+		"There is NO WARRANTY, to the extent permitted by law.\n");
+}
@@ -0,0 +1,988 @@
+/***********************************************************************************************************************
+ * Copyright (C) 2016 Andrew Zonenberg and contributors                                                                *
+ *                                                                                                                     *
+ * This program is free software; you can redistribute it and/or modify it under the terms of the GNU Lesser General   *
+ * Public License as published by the Free Software Foundation; either version 2.1 of the License, or (at your option) *
+ * any later version.                                                                                                  *
+ *                                                                                                                     *
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied  *
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for     *
+ * more details.                                                                                                       *
+ *                                                                                                                     *
+ * You should have received a copy of the GNU Lesser General Public License along with this program; if not, you may   *
+ * find one here:                                                                                                      *
+ * https://www.gnu.org/licenses/old-licenses/lgpl-2.1.txt                                                              *
+ * or you may search the http://www.gnu.org website for the version 2.1 license, or you may write to the Free Software *
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA                                      *
+ **********************************************************************************************************************/
+
+#include "Greenpak4EquivalenceChecker.h"
+#include "SATSolver.h"
+
+using namespace std;
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Construction
+
+Greenpak4EquivalenceChecker::Greenpak4EquivalenceChecker(
+	Greenpak4Netlist* netlist,
+	Greenpak4Device* device,
+	const Greenpak4Bitstream& bitstream,
+	const placementmap& placement)
+	: m_netlist(netlist)
+	, m_device(device)
+	, m_bitstream(bitstream)
+	, m_placement(placement)
+	, m_checks(0)
+	, m_exhaustiveChecks(0)
+	, m_satChecks(0)
+	, m_unchecked(0)
+	, m_failures(0)
+{
+	m_nodes.push_back(LogicNode(0));
+	m_nodes.push_back(LogicNode(1));
+
+	for(unsigned int i=0; i<m_device->GetEntityCount(); i++)
+	{
+		Greenpak4BitstreamEntity* entity = GetActiveEntity(m_device->GetEntity(i));
+		m_sites[entity->GetDescription()] = entity;
+	}
+}
+
+/**
+	@brief A paired entity is whichever of its two blocks the bitstream configures it as
+ */
+Greenpak4BitstreamEntity* Greenpak4EquivalenceChecker::GetActiveEntity(Greenpak4BitstreamEntity* entity)
+{
+	entity = entity->GetRealEntity();
+	if(auto pair = dynamic_cast<Greenpak4PairedEntity*>(entity))
+		return pair->GetActiveEntity();
+	return entity;
+}
+
+/**
+	@brief Adds a LUT to the graph, or finds the same LUT of the same inputs if it's already there
+
+	gp4par usually implements the netlist logic as it is, so most of the time this makes both sides of a check the
+	same node and there's nothing left to prove.
+ */
+uint32_t Greenpak4EquivalenceChecker::AddLUT(uint32_t table, const vector<uint32_t>& inputs)
+{
+	//A one-input LUT that passes its input through is just a wire
+	if( (inputs.size() == 1) && (table == 2) )
+		return inputs[0];
+
+	auto key = pair<uint32_t, vector<uint32_t> >(table, inputs);
+	auto it = m_luts.find(key);
+	if(it != m_luts.end())
+		return it->second;
+
+	LogicNode node(table);
+	node.m_inputs = inputs;
+	m_nodes.push_back(node);
+	m_luts[key] = m_nodes.size() - 1;
+	return m_nodes.size() - 1;
+}
+
+/**
+	@brief Gets the variable for an output of a cut point (the same one whichever side asks)
+ */
+uint32_t Greenpak4EquivalenceChecker::GetOutputVariable(Greenpak4BitstreamEntity* entity, string port)
+{
+	//A flipflop only has one output, its state. Callers invert it for nQ, or for an output-inverted flipflop.
+	if( (dynamic_cast<Greenpak4Flipflop*>(entity) != NULL) && (port == "nQ") )
+		port = "Q";
+
+	//GP_DCMP and GP_PWM names for the same two outputs
+	if(dynamic_cast<Greenpak4DigitalComparator*>(entity) != NULL)
+	{
+		if(port == "GREATER")
+			port = "OUTP";
+		else if(port == "EQUAL")
+			port = "OUTN";
+	}
+
+	return GetVariable(entity->GetDescription() + "." + port);
+}
+
+/**
+	@brief Gets a variable by name, making it if it's not there yet
+ */
+uint32_t Greenpak4EquivalenceChecker::GetVariable(string name)
+{
+	auto it = m_variables.find(name);
+	if(it != m_variables.end())
+		return it->second;
+
+	LogicNode node(0, name);
+	node.m_variable = true;
+	m_nodes.push_back(node);
+	m_variables[name] = m_nodes.size() - 1;
+	return m_nodes.size() - 1;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// The netlist side
+
+/**
+	@brief Finds out whether a port of a netlist cell is an output, from the module it's an instance of
+
+	@return False if we can't tell
+ */
+bool Greenpak4EquivalenceChecker::IsOutput(Greenpak4NetlistCell* cell, string port, bool& output)
+{
+	if( (cell->m_type == "GP_VDD") || (cell->m_type == "GP_VSS") )
+	{
+		output = true;
+		return true;
+	}
+
+	Greenpak4NetlistModule* module = m_netlist->GetModule(cell->m_type);
+	if(module == NULL)
+		return false;
+	Greenpak4NetlistPort* mport = module->GetPort(port);
+	if( (mport == NULL) || (mport->m_direction == Greenpak4NetlistPort::DIR_INOUT) )
+		return false;
+
+	output = (mport->m_direction == Greenpak4NetlistPort::DIR_OUTPUT);
+	return true;
+}
+
+/**
+	@brief Finds the one cell output driving a net
+
+	@return False (after complaining) if there isn't exactly one
+ */
+bool Greenpak4EquivalenceChecker::GetDriver(Greenpak4NetlistNode* net, Greenpak4NetlistCell*& cell, string& port)
+{
+	cell = NULL;
+	for(auto& point : net->m_nodeports)
+	{
+		bool output;
+		if(!IsOutput(point.m_cell, point.m_portname, output) || !output)
+			continue;
+
+		if(cell != NULL)
+		{
+			LogError("Net %s has more than one driver\n", net->m_name.c_str());
+			return false;
+		}
+		cell = point.m_cell;
+		port = point.m_portname;
+	}
+
+	if(cell == NULL)
+	{
+		LogError("Net %s isn't driven by any cell\n", net->m_name.c_str());
+		return false;
+	}
+	return true;
+}
+
+/**
+	@brief Finds the site a netlist cell was placed at
+
+	@return The site, or NULL (after complaining) if the placement doesn't have the cell
+ */
+Greenpak4BitstreamEntity* Greenpak4EquivalenceChecker::GetSite(Greenpak4NetlistCell* cell)
+{
+	auto it = m_placement.find(cell->m_name);
+	if(it == m_placement.end())
+	{
+		LogError("Cell %s isn't in the placement\n", cell->m_name.c_str());
+		return NULL;
+	}
+	if(it->second.second != cell->m_type)
+	{
+		LogError("Cell %s is a %s, but the placement has it as a %s (is the placement from another netlist?)\n",
+			cell->m_name.c_str(), cell->m_type.c_str(), it->second.second.c_str());
+		return NULL;
+	}
+
+	auto jt = m_sites.find(it->second.first);
+	if(jt == m_sites.end())
+	{
+		LogError("Cell %s is placed at %s, which this device doesn't have\n",
+			cell->m_name.c_str(), it->second.first.c_str());
+		return NULL;
+	}
+	return jt->second;
+}
+
+/**
+	@brief Builds the logic driving a netlist net, back to the cut points
+ */
+bool Greenpak4EquivalenceChecker::GetNetNode(Greenpak4NetlistNode* net, uint32_t& node)
+{
+	auto it = m_netNodes.find(net);
+	if(it != m_netNodes.end())
+	{
+		node = it->second;
+		return true;
+	}
+	if(m_netsVisiting.find(net) != m_netsVisiting.end())
+	{
+		LogError("Combinational loop through net %s in the netlist\n", net->m_name.c_str());
+		return false;
+	}
+
+	Greenpak4NetlistCell* cell;
+	string port;
+	if(!GetDriver(net, cell, port))
+		return false;
+
+	if(cell->m_type == "GP_VDD")
+		node = GetConstant(true);
+	else if(cell->m_type == "GP_VSS")
+		node = GetConstant(false);
+
+	//LUTs and inverters are the logic we're checking, anything else is a cut point.
+	//This deliberately doesn't share code with gp4par, so a bug there can't hide itself.
+	else if( (cell->m_type == "GP_INV") || (cell->m_type == "GP_2LUT") || (cell->m_type == "GP_3LUT") ||
+		(cell->m_type == "GP_4LUT") )
+	{
+		vector<string> ports;
+		uint32_t table;
+		if(cell->m_type == "GP_INV")
+		{
+			ports.push_back("IN");
+			table = 1;
+		}
+		else
+		{
+			//No INIT is all zeroes, same as an unused LUT in the bitstream
+			unsigned int order = cell->m_type[3] - '0';
+			for(unsigned int k=0; k<order; k++)
+				ports.push_back("IN" + to_string(k));
+			table = cell->GetParameter(PARAM_INIT) & ((1 << (1 << order)) - 1);
+		}
+
+		m_netsVisiting.insert(net);
+		vector<uint32_t> inputs;
+		for(auto p : ports)
+		{
+			auto jt = cell->m_connections.find(p);
+			if( (jt == cell->m_connections.end()) || (jt->second.size() != 1) || (jt->second[0] == NULL) )
+			{
+				LogError("Cell %s input %s isn't connected\n", cell->m_name.c_str(), p.c_str());
+				m_netsVisiting.erase(net);
+				return false;
+			}
+
+			uint32_t input;
+			if(!GetNetNode(jt->second[0], input))
+			{
+				m_netsVisiting.erase(net);
+				return false;
+			}
+			inputs.push_back(input);
+		}
+		m_netsVisiting.erase(net);
+		node = AddLUT(table, inputs);
+	}
+
+	//gp4par removes cells nothing uses, so they aren't placed. Their outputs are variables the bitstream can't have,
+	//which leaves it to the proofs to decide whether anything observable really depends on them.
+	else if(m_placement.find(cell->m_name) == m_placement.end())
+	{
+		node = GetVariable(cell->m_name + "." + ((port == "nQ") ? "Q" : port) + " (not placed)");
+		if(port == "nQ")
+			node = AddLUT(1, {node});
+	}
+
+	else
+	{
+		unsigned int stage;
+		Greenpak4BitstreamEntity* site;
+		if(auto shreg = GetPackedSite(cell, stage))
+			node = GetStageNode(shreg, stage);
+		else if( (site = GetSite(cell)) == NULL )
+			return false;
+		else
+		{
+			node = GetOutputVariable(site, port);
+			if( (dynamic_cast<Greenpak4Flipflop*>(site) != NULL) && (port == "nQ") )
+				node = AddLUT(1, {node});
+		}
+	}
+
+	m_netNodes[net] = node;
+	return true;
+}
+
+/**
+	@brief Finds the shift register gp4par packed a flipflop into, if it did
+
+	The placement has packed flipflops at the shift register's site and their stage, e.g. SHREG_1:2 for the flipflop
+	fed by the first stage of SHREG_1.
+
+	@return The shift register, or NULL if the flipflop wasn't packed (or the placement makes no sense, which
+			GetSite() complains about)
+ */
+Greenpak4ShiftRegister* Greenpak4EquivalenceChecker::GetPackedSite(Greenpak4NetlistCell* cell, unsigned int& stage)
+{
+	auto it = m_placement.find(cell->m_name);
+	if( (it == m_placement.end()) || (cell->m_type != "GP_DFF") )
+		return NULL;
+	string site = it->second.first;
+	size_t colon = site.find(':');
+	if(colon == string::npos)
+		return NULL;
+
+	auto jt = m_sites.find(site.substr(0, colon));
+	if(jt == m_sites.end())
+		return NULL;
+	stage = atoi(site.c_str() + colon + 1);
+	if( (stage < 1) || (stage > 16) )
+		return NULL;
+	return dynamic_cast<Greenpak4ShiftRegister*>(jt->second);
+}
+
+/**
+	@brief Gets the node for one stage of a shift register
+
+	That's whichever tap is that many stages along. Stages with no tap can't be seen outside the shift register, so
+	they're variables only the netlist has (like the outputs of removed cells).
+ */
+uint32_t Greenpak4EquivalenceChecker::GetStageNode(Greenpak4ShiftRegister* shreg, unsigned int stage)
+{
+	if(shreg->GetDelayB() == (int)stage)
+		return GetOutputVariable(shreg, "OUTB");
+	if(shreg->GetDelayA() == (int)stage)
+	{
+		uint32_t node = GetOutputVariable(shreg, "OUTA");
+		return shreg->IsInvertA() ? AddLUT(1, {node}) : node;
+	}
+	return GetVariable(shreg->GetDescription() + " stage " + to_string(stage));
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// The bitstream side
+
+/**
+	@brief Builds the logic driving a signal in the bitstream, back to the cut points
+ */
+bool Greenpak4EquivalenceChecker::GetSignalNode(Greenpak4EntityOutput signal, uint32_t& node)
+{
+	if(signal.m_src == NULL)
+	{
+		LogError("Bitstream has an input connected to nothing\n");
+		return false;
+	}
+	if(signal.IsPowerRail())
+	{
+		node = GetConstant(signal.GetPowerRailValue());
+		return true;
+	}
+
+	Greenpak4BitstreamEntity* entity = GetActiveEntity(signal.m_src);
+	auto key = pair<Greenpak4BitstreamEntity*, string>(entity, signal.m_port);
+	auto it = m_signalNodes.find(key);
+	if(it != m_signalNodes.end())
+	{
+		node = it->second;
+		return true;
+	}
+	if(m_signalsVisiting.find(key) != m_signalsVisiting.end())
+	{
+		LogError("Combinational loop through %s in the bitstream\n", entity->GetDescription().c_str());
+		return false;
+	}
+
+	vector<Greenpak4EntityOutput> inputs;
+	uint32_t table = 0;
+	bool logic = true;
+	bool wire = false;
+	//The truth table comes straight from the bits, not from what Greenpak4LUT decoded
+	if(auto lut = dynamic_cast<Greenpak4LUT*>(entity))
+	{
+		for(unsigned int i=0; i<lut->GetOrder(); i++)
+			inputs.push_back(lut->GetInput(i));
+		table = m_bitstream.GetField(lut->GetConfigBase(), 1 << lut->GetOrder());
+	}
+	else if(auto inv = dynamic_cast<Greenpak4Inverter*>(entity))
+	{
+		inputs.push_back(inv->GetInput());
+		table = 1;
+	}
+
+	//Cross connections are just wires to the other matrix
+	else if(auto xconn = dynamic_cast<Greenpak4CrossConnection*>(entity))
+	{
+		inputs.push_back(xconn->GetInput());
+		wire = true;
+	}
+	else
+		logic = false;
+
+	if(!logic)
+	{
+		node = GetOutputVariable(entity, signal.m_port);
+		auto ff = dynamic_cast<Greenpak4Flipflop*>(entity);
+		if( (ff != NULL) && ff->IsOutputInverted() )
+			node = AddLUT(1, {node});
+	}
+	else
+	{
+		m_signalsVisiting.insert(key);
+		vector<uint32_t> nodes;
+		for(auto input : inputs)
+		{
+			uint32_t n;
+			if(!GetSignalNode(input, n))
+			{
+				m_signalsVisiting.erase(key);
+				return false;
+			}
+			nodes.push_back(n);
+		}
+		m_signalsVisiting.erase(key);
+		node = wire ? nodes[0] : AddLUT(table, nodes);
+	}
+
+	m_signalNodes[key] = node;
+	return true;
+}
+
+/**
+	@brief Gets the signal the bitstream connects to one bit of a (netlist) input port of a cut point
+
+	@return False if we don't know how to read that input back
+ */
+bool Greenpak4EquivalenceChecker::GetEntityInput(
+	Greenpak4BitstreamEntity* entity,
+	string port,
+	unsigned int bit,
+	Greenpak4EntityOutput& signal)
+{
+	//Digital comparators are the only cut points with bus inputs, everything else only has bit 0
+	if(auto dcmp = dynamic_cast<Greenpak4DigitalComparator*>(entity))
+	{
+		if(bit >= 8)
+			return false;
+		if(port == "INP")
+			signal = dcmp->GetInputP(bit);
+		else if(port == "INN")
+			signal = dcmp->GetInputN(bit);
+		else
+			return false;
+	}
+	else if(bit != 0)
+		return false;
+
+	else if(auto ff = dynamic_cast<Greenpak4Flipflop*>(entity))
+	{
+		if(port == "D")
+			signal = ff->GetInput();
+		else if( (port == "CLK") || (port == "nCLK") )
+			signal = ff->GetClock();
+		else if( (port == "nSR") || (port == "nRST") || (port == "nSET") )
+			signal = ff->HasSetReset() ? ff->GetSetReset() : m_device->GetPower();
+		else
+			return false;
+	}
+
+	else if(auto count = dynamic_cast<Greenpak4Counter*>(entity))
+	{
+		if(port == "CLK")
+			signal = count->GetClock();
+		else if(port == "RST")
+			signal = count->GetReset();
+		else if(port == "UP")
+			signal = count->HasFSM() ? count->GetUp() : m_device->GetGround();
+		else if(port == "KEEP")
+			signal = count->HasFSM() ? count->GetKeep() : m_device->GetGround();
+		else
+			return false;
+	}
+
+	else if(auto shreg = dynamic_cast<Greenpak4ShiftRegister*>(entity))
+	{
+		if(port == "CLK")
+			signal = shreg->GetClock();
+		else if(port == "IN")
+			signal = shreg->GetInput();
+		else if(port == "nRST")
+			signal = shreg->GetReset();
+		else
+			return false;
+	}
+
+	else if(auto delay = dynamic_cast<Greenpak4Delay*>(entity))
+	{
+		if(port != "IN")
+			return false;
+		signal = delay->GetInput();
+	}
+
+	else if(auto iob = dynamic_cast<Greenpak4IOB*>(entity))
+	{
+		if(port == "IN")
+			signal = iob->GetOutputSignal();
+		else if(port == "OE")
+			signal = iob->GetOutputEnable();
+		else
+			return false;
+	}
+
+	else if(auto lfosc = dynamic_cast<Greenpak4LFOscillator*>(entity))
+	{
+		if(port != "PWRDN")
+			return false;
+		signal = lfosc->GetPowerDown();
+	}
+	else if(auto ringosc = dynamic_cast<Greenpak4RingOscillator*>(entity))
+	{
+		if(port != "PWRDN")
+			return false;
+		signal = ringosc->GetPowerDown();
+	}
+	else if(auto rcosc = dynamic_cast<Greenpak4RCOscillator*>(entity))
+	{
+		if(port != "PWRDN")
+			return false;
+		signal = rcosc->GetPowerDown();
+	}
+
+	else
+		return false;
+
+	return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Proofs
+
+/**
+	@brief Checks every connection the netlist makes to a cut point, and that pins it doesn't use aren't driven
+
+	@return True if the bitstream matches the netlist everywhere we could check
+ */
+bool Greenpak4EquivalenceChecker::Check()
+{
+	auto module = m_netlist->GetTopModule();
+	for(auto it = module->cell_begin(); it != module->cell_end(); it ++)
+	{
+		if(!CheckCell(it->second))
+			m_failures ++;
+	}
+
+	for(unsigned int i=0; i<m_device->GetEntityCount(); i++)
+	{
+		auto iob = dynamic_cast<Greenpak4IOB*>(m_device->GetEntity(i));
+		if( (iob == NULL) || (m_usedSites.find(iob) != m_usedSites.end()) )
+			continue;
+
+		uint32_t oe;
+		char what[64];
+		snprintf(what, sizeof(what), "Output enable of unused pin %u", iob->GetPinNumber());
+		if(!GetSignalNode(iob->GetOutputEnable(), oe) || !Prove(GetConstant(false), oe, what))
+			m_failures ++;
+	}
+
+	LogNotice("Checked %u connections (%u by simulation, %u with SAT)\n",
+		m_checks, m_exhaustiveChecks, m_satChecks);
+	if(m_unchecked)
+		LogWarning("%u inputs of hard IP blocks couldn't be checked\n", m_unchecked);
+	if(m_failures)
+	{
+		LogError("The netlist and the bitstream differ in %u places\n", m_failures);
+		return false;
+	}
+	return true;
+}
+
+/**
+	@brief Checks everything driving the inputs of one netlist cell (if it's a cut point)
+ */
+bool Greenpak4EquivalenceChecker::CheckCell(Greenpak4NetlistCell* cell)
+{
+	string type = cell->m_type;
+	if( (type == "GP_VDD") || (type == "GP_VSS") || (type == "GP_INV") || (type == "GP_2LUT") ||
+		(type == "GP_3LUT") || (type == "GP_4LUT") )
+	{
+		return true;
+	}
+
+	//Cells gp4par removed have nothing to check their inputs against (see GetNetNode() for their outputs)
+	if(m_placement.find(cell->m_name) == m_placement.end())
+	{
+		LogVerbose("Not checking %s, which gp4par removed\n", cell->m_name.c_str());
+		return true;
+	}
+
+	unsigned int stage;
+	if(auto shreg = GetPackedSite(cell, stage))
+		return CheckPackedFlipflop(cell, shreg, stage);
+
+	Greenpak4BitstreamEntity* site = GetSite(cell);
+	if(site == NULL)
+		return false;
+	m_usedSites.insert(site);
+
+	LogDebug("Checking %s (%s at %s)\n", cell->m_name.c_str(), type.c_str(), site->GetDescription().c_str());
+	LogIndenter li;
+
+	bool ok = true;
+	for(auto it : cell->m_connections)
+	{
+		//Pads of I/O buffers are the pins, not logic
+		string port = it.first;
+		if( ((type == "GP_IBUF") && (port == "IN")) || (port == "IO") )
+			continue;
+
+		bool output;
+		if(!IsOutput(cell, port, output) || output)
+			continue;
+
+		for(unsigned int bit=0; bit<it.second.size(); bit++)
+		{
+			string name = port;
+			if(it.second.size() > 1)
+				name += "[" + to_string(bit) + "]";
+
+			Greenpak4EntityOutput signal;
+			if( (it.second[bit] == NULL) || !GetEntityInput(site, port, bit, signal) )
+			{
+				LogVerbose("Not checking %s input %s\n", cell->m_name.c_str(), name.c_str());
+				m_unchecked ++;
+				continue;
+			}
+
+			uint32_t a;
+			uint32_t b;
+			string what = "Input " + name + " of " + cell->m_name + " (" + site->GetDescription() + ")";
+			if(!GetNetNode(it.second[bit], a) || !GetSignalNode(signal, b) || !Prove(a, b, what))
+				ok = false;
+		}
+	}
+
+	//Output buffers without an enable are always on
+	auto iob = dynamic_cast<Greenpak4IOB*>(site);
+	if( (iob != NULL) && (type == "GP_OBUF") )
+	{
+		uint32_t oe;
+		string what = "Output enable of " + cell->m_name + " (" + site->GetDescription() + ")";
+		if(!GetSignalNode(iob->GetOutputEnable(), oe) || !Prove(GetConstant(true), oe, what))
+			ok = false;
+	}
+
+	if(auto ff = dynamic_cast<Greenpak4Flipflop*>(site))
+	{
+		if(!CheckFlipflop(cell, ff))
+			ok = false;
+	}
+
+	return ok;
+}
+
+/**
+	@brief Checks a flipflop is configured as the type and parameters of its netlist cell say
+
+	The output polarity is also part of the logic (nQ and output-inverted flipflops are the inverse of the state), but
+	checking it here as well catches a flipflop whose output doesn't go anywhere we prove.
+ */
+bool Greenpak4EquivalenceChecker::CheckFlipflop(Greenpak4NetlistCell* cell, Greenpak4Flipflop* ff)
+{
+	string type = cell->m_type;
+	string where = cell->m_name + " (" + ff->GetDescription() + ")";
+
+	bool ok = true;
+	bool latch = (type.find("LATCH") != string::npos);
+	if(latch != ff->IsLatch())
+	{
+		LogError("%s is a %s in the netlist, but a %s in the bitstream\n",
+			where.c_str(), latch ? "latch" : "flipflop", ff->IsLatch() ? "latch" : "flipflop");
+		ok = false;
+	}
+
+	bool inverted = (type[type.length() - 1] == 'I');
+	if(inverted != ff->IsOutputInverted())
+	{
+		LogError("%s output is %sinverted in the netlist, but %sinverted in the bitstream\n",
+			where.c_str(), inverted ? "" : "not ", ff->IsOutputInverted() ? "" : "not ");
+		ok = false;
+	}
+
+	bool init = cell->HasParameter(PARAM_INIT) && cell->GetParameter(PARAM_INIT);
+	if(init != ff->GetInitValue())
+	{
+		LogError("%s powers up as %d in the netlist, but %d in the bitstream\n",
+			where.c_str(), init, ff->GetInitValue());
+		ok = false;
+	}
+
+	//Set/reset mode only means anything if the netlist uses it. nSET and nRST say which, nSR needs SRMODE.
+	auto& conns = cell->m_connections;
+	bool nset = (conns.find("nSET") != conns.end());
+	if(ff->HasSetReset() && (nset || (conns.find("nRST") != conns.end()) || (conns.find("nSR") != conns.end())) )
+	{
+		bool srmode = nset;
+		if(cell->HasParameter(PARAM_SRMODE))
+			srmode = cell->GetParameter(PARAM_SRMODE);
+		if(srmode != ff->GetSetResetMode())
+		{
+			LogError("%s %s in the netlist, but %s in the bitstream\n",
+				where.c_str(), srmode ? "sets" : "resets", ff->GetSetResetMode() ? "sets" : "resets");
+			ok = false;
+		}
+	}
+
+	return ok;
+}
+
+/**
+	@brief Checks a flipflop gp4par packed into a shift register is clocked and fed the same way
+
+	The first stage is fed by the shift register's input, and every other one by the stage before. Shift registers
+	power up as all zeroes, and gp4par holds them out of reset.
+ */
+bool Greenpak4EquivalenceChecker::CheckPackedFlipflop(
+	Greenpak4NetlistCell* cell,
+	Greenpak4ShiftRegister* shreg,
+	unsigned int stage)
+{
+	string where = " of " + cell->m_name + " (stage " + to_string(stage) + " of " + shreg->GetDescription() + ")";
+	LogDebug("Checking %s (GP_DFF at stage %u of %s)\n", cell->m_name.c_str(), stage, shreg->GetDescription().c_str());
+	LogIndenter li;
+
+	bool ok = true;
+	if(cell->GetParameter(PARAM_INIT))
+	{
+		LogError("%s powers up as 1 in the netlist, but it's packed into %s, which powers up as 0\n",
+			cell->m_name.c_str(), shreg->GetDescription().c_str());
+		ok = false;
+	}
+
+	uint32_t clk;
+	uint32_t d;
+	if(!GetSignalNode(shreg->GetClock(), clk))
+		ok = false;
+	if(stage > 1)
+		d = GetStageNode(shreg, stage - 1);
+	else if(!GetSignalNode(shreg->GetInput(), d))
+		ok = false;
+	if(!ok)
+		return false;
+
+	vector<pair<string, uint32_t> > inputs;
+	inputs.push_back(pair<string, uint32_t>("CLK", clk));
+	inputs.push_back(pair<string, uint32_t>("D", d));
+	for(auto& input : inputs)
+	{
+		auto it = cell->m_connections.find(input.first);
+		if( (it == cell->m_connections.end()) || (it->second.size() != 1) || (it->second[0] == NULL) )
+		{
+			LogError("Cell %s input %s isn't connected\n", cell->m_name.c_str(), input.first.c_str());
+			ok = false;
+			continue;
+		}
+
+		uint32_t node;
+		if(!GetNetNode(it->second[0], node) || !Prove(node, input.second, "Input " + input.first + where))
+			ok = false;
+	}
+
+	uint32_t reset;
+	if(stage == 1)
+	{
+		if(!GetSignalNode(shreg->GetReset(), reset) || !Prove(GetConstant(true), reset, "Reset" + where))
+			ok = false;
+	}
+
+	return ok;
+}
+
+/**
+	@brief Proves two nodes compute the same function of the cut point variables
+
+	@return True if they do, false (after showing an input pattern where they differ) if they don't
+ */
+bool Greenpak4EquivalenceChecker::Prove(uint32_t a, uint32_t b, string what)
+{
+	m_checks ++;
+	if(a == b)
+		return true;
+
+	vector<uint32_t> cone;
+	vector<bool> visited(m_nodes.size(), false);
+	GetCone(a, cone, visited);
+	GetCone(b, cone, visited);
+
+	vector<uint32_t> support;
+	for(auto n : cone)
+	{
+		if(m_nodes[n].m_variable)
+			support.push_back(n);
+	}
+
+	vector<bool> counterexample;
+	bool equivalent;
+	if(support.size() <= EXHAUSTIVE_LIMIT)
+	{
+		m_exhaustiveChecks ++;
+		equivalent = ProveExhaustive(a, b, cone, support, counterexample);
+	}
+	else
+	{
+		m_satChecks ++;
+		equivalent = ProveSAT(a, b, cone, support, counterexample);
+	}
+	if(equivalent)
+		return true;
+
+	if(support.empty())
+	{
+		LogError("%s differs between the netlist and the bitstream (they're different constants)\n", what.c_str());
+		return false;
+	}
+
+	string when;
+	for(size_t i=0; i<support.size(); i++)
+	{
+		if(i)
+			when += ", ";
+		when += m_nodes[support[i]].m_name + (counterexample[i] ? "=1" : "=0");
+	}
+	LogError("%s differs between the netlist and the bitstream, e.g. when %s\n", what.c_str(), when.c_str());
+	return false;
+}
+
+/**
+	@brief Collects the nodes a node depends on (inputs before the nodes that use them)
+ */
+void Greenpak4EquivalenceChecker::GetCone(uint32_t node, vector<uint32_t>& cone, vector<bool>& visited)
+{
+	if(visited[node])
+		return;
+	visited[node] = true;
+	for(auto input : m_nodes[node].m_inputs)
+		GetCone(input, cone, visited);
+	cone.push_back(node);
+}
+
+/**
+	@brief Simulates both nodes on every combination of the variables, with one bit of each word per combination
+ */
+bool Greenpak4EquivalenceChecker::ProveExhaustive(
+	uint32_t a,
+	uint32_t b,
+	const vector<uint32_t>& cone,
+	const vector<uint32_t>& support,
+	vector<bool>& counterexample)
+{
+	static const uint64_t patterns[6] =
+	{
+		0xaaaaaaaaaaaaaaaaULL,
+		0xccccccccccccccccULL,
+		0xf0f0f0f0f0f0f0f0ULL,
+		0xff00ff00ff00ff00ULL,
+		0xffff0000ffff0000ULL,
+		0xffffffff00000000ULL
+	};
+
+	//Variable k is bit k of the combination number, which is 64 times the word number plus the bit number
+	size_t words = (support.size() > 6) ? (1 << (support.size() - 6)) : 1;
+	map<uint32_t, vector<uint64_t> > values;
+	for(size_t k=0; k<support.size(); k++)
+	{
+		vector<uint64_t>& value = values[support[k]];
+		value.resize(words);
+		for(size_t w=0; w<words; w++)
+		{
+			if(k < 6)
+				value[w] = patterns[k];
+			else
+				value[w] = ((w >> (k - 6)) & 1) ? ~0ULL : 0;
+		}
+	}
+
+	//A LUT is the OR of the minterms in its table
+	for(auto n : cone)
+	{
+		LogicNode& node = m_nodes[n];
+		if(node.m_variable)
+			continue;
+
+		vector<uint64_t>& value = values[n];
+		value.assign(words, 0);
+		for(uint32_t m=0; m < (1u << node.m_inputs.size()); m++)
+		{
+			if(!((node.m_table >> m) & 1))
+				continue;
+			for(size_t w=0; w<words; w++)
+			{
+				uint64_t term = ~0ULL;
+				for(size_t j=0; j<node.m_inputs.size(); j++)
+				{
+					uint64_t in = values[node.m_inputs[j]][w];
+					term &= ((m >> j) & 1) ? in : ~in;
+				}
+				value[w] |= term;
+			}
+		}
+	}
+
+	vector<uint64_t>& va = values[a];
+	vector<uint64_t>& vb = values[b];
+	for(size_t w=0; w<words; w++)
+	{
+		uint64_t diff = va[w] ^ vb[w];
+		if(diff == 0)
+			continue;
+
+		unsigned int bit = 0;
+		while(!((diff >> bit) & 1))
+			bit ++;
+		uint64_t combination = w*64 + bit;
+		for(size_t k=0; k<support.size(); k++)
+			counterexample.push_back((combination >> k) & 1);
+		return false;
+	}
+	return true;
+}
+
+/**
+	@brief Asks the SAT solver for an assignment where the two nodes differ
+
+	Each LUT gets one clause per row of its truth table (if the inputs match the row, the output is the table bit).
+ */
+bool Greenpak4EquivalenceChecker::ProveSAT(
+	uint32_t a,
+	uint32_t b,
+	const vector<uint32_t>& cone,
+	const vector<uint32_t>& support,
+	vector<bool>& counterexample)
+{
+	SATSolver solver;
+	map<uint32_t, uint32_t> vars;
+	for(auto n : cone)
+	{
+		vars[n] = solver.NewVariable();
+		LogicNode& node = m_nodes[n];
+		if(node.m_variable)
+			continue;
+
+		for(uint32_t m=0; m < (1u << node.m_inputs.size()); m++)
+		{
+			vector<uint32_t> clause;
+			for(size_t j=0; j<node.m_inputs.size(); j++)
+				clause.push_back(SATSolver::Literal(vars[node.m_inputs[j]], (m >> j) & 1));
+			clause.push_back(SATSolver::Literal(vars[n], !((node.m_table >> m) & 1)));
+			solver.AddClause(clause);
+		}
+	}
+
+	//a != b
+	solver.AddClause({SATSolver::Literal(vars[a]), SATSolver::Literal(vars[b])});
+	solver.AddClause({SATSolver::Literal(vars[a], true), SATSolver::Literal(vars[b], true)});
+	if(!solver.Solve())
+	{
+		LogDebug("Proved in %u conflicts\n", solver.GetConflictCount());
+		return true;
+	}
+
+	for(auto n : support)
+		counterexample.push_back(solver.GetValue(vars[n]));
+	return false;
+}
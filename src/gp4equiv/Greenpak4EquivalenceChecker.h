@@ -0,0 +1,155 @@
+/***********************************************************************************************************************
+ * Copyright (C) 2016 Andrew Zonenberg and contributors                                                                *
+ *                                                                                                                     *
+ * This program is free software; you can redistribute it and/or modify it under the terms of the GNU Lesser General   *
+ * Public License as published by the Free Software Foundation; either version 2.1 of the License, or (at your option) *
+ * any later version.                                                                                                  *
+ *                                                                                                                     *
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied  *
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for     *
+ * more details.                                                                                                       *
+ *                                                                                                                     *
+ * You should have received a copy of the GNU Lesser General Public License along with this program; if not, you may   *
+ * find one here:                                                                                                      *
+ * https://www.gnu.org/licenses/old-licenses/lgpl-2.1.txt                                                              *
+ * or you may search the http://www.gnu.org website for the version 2.1 license, or you may write to the Free Software *
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA                                      *
+ **********************************************************************************************************************/
+
+#ifndef Greenpak4EquivalenceChecker_h
+#define Greenpak4EquivalenceChecker_h
+
+#include <Greenpak4.h>
+#include <gp4par.h>
+
+/**
+	@brief Proves that a bitstream implements a netlist
+
+	Placed cells other than LUTs and inverters are treated as cut points. Their outputs become variables shared by the
+	netlist and the bitstream, and each of their inputs is checked: the logic driving it in the netlist must compute
+	the same function of those variables as the logic driving it in the bitstream. Cones with up to EXHAUSTIVE_LIMIT
+	variables are simulated on every input pattern, 64 at a time, and bigger ones go to a SAT solver.
+
+	Flipflops gp4par packed into a shift register are placed at one of its stages. Their outputs are its taps, and
+	their inputs are checked against the stage before.
+	Cells gp4par removed as unused aren't in the placement. They're skipped, and their outputs are variables only the
+	netlist has, so a proof only fails on them if something observable really does depend on them.
+
+	This is combinational equivalence only. Flipflops are the one cut point whose configuration is compared (mode,
+	output polarity, init value and set/reset mode). Other hard IP configuration (counter lengths and so on) isn't,
+	and inputs of hard IP the bitstream decoder has no accessors for aren't checked.
+ */
+class Greenpak4EquivalenceChecker
+{
+public:
+	Greenpak4EquivalenceChecker(
+		Greenpak4Netlist* netlist,
+		Greenpak4Device* device,
+		const Greenpak4Bitstream& bitstream,
+		const placementmap& placement);
+
+	bool Check();
+
+	enum
+	{
+		EXHAUSTIVE_LIMIT = 16
+	};
+
+protected:
+
+	/**
+		@brief A node in the logic graph both sides are built in: a variable, or a LUT of other nodes.
+
+		Bit i of the table is the output when each input k has the value of bit k of i. Constants are LUTs with no
+		inputs.
+	 */
+	class LogicNode
+	{
+	public:
+		LogicNode(uint32_t table = 0, std::string name = "")
+		: m_variable(false)
+		, m_table(table)
+		, m_name(name)
+		{}
+
+		bool m_variable;
+		uint32_t m_table;
+		std::vector<uint32_t> m_inputs;
+
+		//Variables only: the site and port it's the output of
+		std::string m_name;
+	};
+
+	uint32_t GetConstant(bool value)
+	{ return value ? 1 : 0; }
+
+	uint32_t AddLUT(uint32_t table, const std::vector<uint32_t>& inputs);
+	uint32_t GetOutputVariable(Greenpak4BitstreamEntity* entity, std::string port);
+	uint32_t GetVariable(std::string name);
+
+	//The netlist side
+	bool GetNetNode(Greenpak4NetlistNode* net, uint32_t& node);
+	bool GetDriver(Greenpak4NetlistNode* net, Greenpak4NetlistCell*& cell, std::string& port);
+	bool IsOutput(Greenpak4NetlistCell* cell, std::string port, bool& output);
+	Greenpak4BitstreamEntity* GetSite(Greenpak4NetlistCell* cell);
+	Greenpak4ShiftRegister* GetPackedSite(Greenpak4NetlistCell* cell, unsigned int& stage);
+	uint32_t GetStageNode(Greenpak4ShiftRegister* shreg, unsigned int stage);
+
+	//The bitstream side
+	bool GetSignalNode(Greenpak4EntityOutput signal, uint32_t& node);
+	bool GetEntityInput(
+		Greenpak4BitstreamEntity* entity,
+		std::string port,
+		unsigned int bit,
+		Greenpak4EntityOutput& signal);
+	static Greenpak4BitstreamEntity* GetActiveEntity(Greenpak4BitstreamEntity* entity);
+
+	//Proofs
+	bool CheckCell(Greenpak4NetlistCell* cell);
+	bool CheckFlipflop(Greenpak4NetlistCell* cell, Greenpak4Flipflop* ff);
+	bool CheckPackedFlipflop(Greenpak4NetlistCell* cell, Greenpak4ShiftRegister* shreg, unsigned int stage);
+	bool Prove(uint32_t a, uint32_t b, std::string what);
+	void GetCone(uint32_t node, std::vector<uint32_t>& cone, std::vector<bool>& visited);
+	bool ProveExhaustive(uint32_t a, uint32_t b, const std::vector<uint32_t>& cone,
+		const std::vector<uint32_t>& support, std::vector<bool>& counterexample);
+	bool ProveSAT(uint32_t a, uint32_t b, const std::vector<uint32_t>& cone,
+		const std::vector<uint32_t>& support, std::vector<bool>& counterexample);
+
+	Greenpak4Netlist* m_netlist;
+	Greenpak4Device* m_device;
+
+	///The raw bits the device was loaded from
+	const Greenpak4Bitstream& m_bitstream;
+
+	const placementmap& m_placement;
+
+	///Every block in the device, by the site name placement files use
+	std::map<std::string, Greenpak4BitstreamEntity*> m_sites;
+
+	///The logic graph. Nodes 0 and 1 are the constants.
+	std::vector<LogicNode> m_nodes;
+
+	///Nodes already built for each cut point output, netlist net and bitstream signal
+	std::map<std::string, uint32_t> m_variables;
+	std::map<Greenpak4NetlistNode*, uint32_t> m_netNodes;
+	std::map<std::pair<Greenpak4BitstreamEntity*, std::string>, uint32_t> m_signalNodes;
+
+	///LUT nodes by truth table and inputs, so identical logic on both sides is one node
+	std::map<std::pair<uint32_t, std::vector<uint32_t> >, uint32_t> m_luts;
+
+	///Nets and signals we're in the middle of building nodes for (if we get back to one, it's a loop)
+	std::set<Greenpak4NetlistNode*> m_netsVisiting;
+	std::set<std::pair<Greenpak4BitstreamEntity*, std::string> > m_signalsVisiting;
+
+	///Sites the netlist has put something on
+	std::set<Greenpak4BitstreamEntity*> m_usedSites;
+
+	//Statistics
+	unsigned int m_checks;
+	unsigned int m_exhaustiveChecks;
+	unsigned int m_satChecks;
+	unsigned int m_unchecked;
+	unsigned int m_failures;
+};
+
+#endif
@@ -0,0 +1,304 @@
+/***********************************************************************************************************************
+ * Copyright (C) 2016 Andrew Zonenberg and contributors                                                                *
+ *                                                                                                                     *
+ * This program is free software; you can redistribute it and/or modify it under the terms of the GNU Lesser General   *
+ * Public License as published by the Free Software Foundation; either version 2.1 of the License, or (at your option) *
+ * any later version.                                                                                                  *
+ *                                                                                                                     *
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied  *
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for     *
+ * more details.                                                                                                       *
+ *                                                                                                                     *
+ * You should have received a copy of the GNU Lesser General Public License along with this program; if not, you may   *
+ * find one here:                                                                                                      *
+ * https://www.gnu.org/licenses/old-licenses/lgpl-2.1.txt                                                              *
+ * or you may search the http://www.gnu.org website for the version 2.1 license, or you may write to the Free Software *
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA                                      *
+ **********************************************************************************************************************/
+
+#include "SATSolver.h"
+#include <algorithm>
+
+using namespace std;
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Construction
+
+SATSolver::SATSolver()
+	: m_activityIncrement(1)
+	, m_propagated(0)
+	, m_unsatisfiable(false)
+	, m_conflicts(0)
+{
+}
+
+uint32_t SATSolver::NewVariable()
+{
+	m_values.push_back(VALUE_UNASSIGNED);
+	m_levels.push_back(0);
+	m_reasons.push_back(-1);
+	m_activity.push_back(0);
+	m_watches.resize(m_watches.size() + 2);
+	return m_values.size() - 1;
+}
+
+/**
+	@brief Adds a clause (true if any of its literals are). Must be called before Solve().
+ */
+void SATSolver::AddClause(vector<uint32_t> literals)
+{
+	//Repeated literals don't matter, and a literal and its complement make the clause always true
+	sort(literals.begin(), literals.end());
+	literals.erase(unique(literals.begin(), literals.end()), literals.end());
+	for(size_t i=1; i<literals.size(); i++)
+	{
+		if( (literals[i] ^ 1) == literals[i-1] )
+			return;
+	}
+
+	if(literals.empty())
+		m_unsatisfiable = true;
+
+	//Units are assigned right away, at the top level
+	else if(literals.size() == 1)
+	{
+		Value value = GetLiteralValue(literals[0]);
+		if(value == VALUE_FALSE)
+			m_unsatisfiable = true;
+		else if(value == VALUE_UNASSIGNED)
+			Assign(literals[0], -1);
+	}
+
+	else
+		AddWatchedClause(literals);
+}
+
+uint32_t SATSolver::AddWatchedClause(const vector<uint32_t>& literals)
+{
+	uint32_t index = m_clauses.size();
+	m_clauses.push_back(literals);
+	m_watches[literals[0]].push_back(index);
+	m_watches[literals[1]].push_back(index);
+	return index;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Search
+
+/**
+	@brief Finds out whether there's an assignment that makes every clause true
+
+	@return True if there is (see GetValue()), false if the clauses contradict each other
+ */
+bool SATSolver::Solve()
+{
+	if(m_unsatisfiable)
+		return false;
+
+	while(true)
+	{
+		int32_t conflict = Propagate();
+		if(conflict >= 0)
+		{
+			m_conflicts ++;
+
+			//A conflict without any decisions means there's no way out
+			if(m_trailLimits.empty())
+				return false;
+
+			//Learn why, and go back to the point where that forces a different choice
+			vector<uint32_t> learnt;
+			unsigned int level = Analyze(conflict, learnt);
+			Backtrack(level);
+			if(learnt.size() == 1)
+				Assign(learnt[0], -1);
+			else
+				Assign(learnt[0], AddWatchedClause(learnt));
+
+			m_activityIncrement /= 0.95;
+		}
+
+		else
+		{
+			int32_t var = PickBranch();
+			if(var < 0)
+				return true;
+
+			m_trailLimits.push_back(m_trail.size());
+			Assign(Literal(var, true), -1);
+		}
+	}
+}
+
+void SATSolver::Assign(uint32_t lit, int32_t reason)
+{
+	uint32_t var = lit >> 1;
+	m_values[var] = (lit & 1) ? VALUE_FALSE : VALUE_TRUE;
+	m_levels[var] = m_trailLimits.size();
+	m_reasons[var] = reason;
+	m_trail.push_back(lit);
+}
+
+/**
+	@brief Assigns everything the current assignments imply
+
+	@return The clause that can't be satisfied, or -1 if there's no conflict
+ */
+int32_t SATSolver::Propagate()
+{
+	while(m_propagated < m_trail.size())
+	{
+		uint32_t falselit = m_trail[m_propagated++] ^ 1;
+		vector<uint32_t>& watches = m_watches[falselit];
+
+		size_t keep = 0;
+		for(size_t i=0; i<watches.size(); i++)
+		{
+			uint32_t index = watches[i];
+			vector<uint32_t>& clause = m_clauses[index];
+
+			//Keep the false literal second, so the first is the one we might imply
+			if(clause[0] == falselit)
+				swap(clause[0], clause[1]);
+			if(GetLiteralValue(clause[0]) == VALUE_TRUE)
+			{
+				watches[keep++] = index;
+				continue;
+			}
+
+			//Watch something that isn't false instead, if there is anything
+			bool moved = false;
+			for(size_t k=2; k<clause.size(); k++)
+			{
+				if(GetLiteralValue(clause[k]) != VALUE_FALSE)
+				{
+					swap(clause[1], clause[k]);
+					m_watches[clause[1]].push_back(index);
+					moved = true;
+					break;
+				}
+			}
+			if(moved)
+				continue;
+
+			//Otherwise the clause is unit (or in conflict, in which case we stop here)
+			watches[keep++] = index;
+			if(GetLiteralValue(clause[0]) == VALUE_FALSE)
+			{
+				for(i++; i<watches.size(); i++)
+					watches[keep++] = watches[i];
+				watches.resize(keep);
+				return index;
+			}
+			Assign(clause[0], index);
+		}
+		watches.resize(keep);
+	}
+
+	return -1;
+}
+
+/**
+	@brief Works out a clause explaining a conflict, with exactly one literal from the current decision level (the
+	first-UIP scheme). That literal goes first, and the one from the next highest level second.
+
+	@return The decision level to go back to
+ */
+unsigned int SATSolver::Analyze(int32_t conflict, vector<uint32_t>& learnt)
+{
+	vector<bool> seen(m_values.size(), false);
+	unsigned int level = m_trailLimits.size();
+	learnt.push_back(0);
+
+	int pending = 0;
+	bool first = true;
+	uint32_t lit = 0;
+	size_t index = m_trail.size();
+	int32_t clause = conflict;
+	do
+	{
+		//A reason clause's first literal is the one it implied, which we're already looking at
+		const vector<uint32_t>& literals = m_clauses[clause];
+		for(size_t k = (first ? 0 : 1); k<literals.size(); k++)
+		{
+			uint32_t var = literals[k] >> 1;
+			if(seen[var] || (m_levels[var] == 0))
+				continue;
+
+			seen[var] = true;
+			BumpActivity(var);
+			if(m_levels[var] == level)
+				pending ++;
+			else
+				learnt.push_back(literals[k]);
+		}
+		first = false;
+
+		//Walk back to the most recent assignment involved in the conflict
+		do
+		{
+			lit = m_trail[--index];
+		} while(!seen[lit >> 1]);
+		seen[lit >> 1] = false;
+		clause = m_reasons[lit >> 1];
+		pending --;
+	} while(pending > 0);
+	learnt[0] = lit ^ 1;
+
+	unsigned int target = 0;
+	for(size_t k=1; k<learnt.size(); k++)
+	{
+		if(m_levels[learnt[k] >> 1] > target)
+		{
+			target = m_levels[learnt[k] >> 1];
+			swap(learnt[1], learnt[k]);
+		}
+	}
+	return target;
+}
+
+void SATSolver::Backtrack(unsigned int level)
+{
+	if(m_trailLimits.size() <= level)
+		return;
+
+	size_t start = m_trailLimits[level];
+	for(size_t i=start; i<m_trail.size(); i++)
+	{
+		uint32_t var = m_trail[i] >> 1;
+		m_values[var] = VALUE_UNASSIGNED;
+		m_reasons[var] = -1;
+	}
+	m_trail.resize(start);
+	m_trailLimits.resize(level);
+	m_propagated = start;
+}
+
+/**
+	@brief Picks the unassigned variable that's been in the most conflicts lately, or -1 if everything is assigned
+ */
+int32_t SATSolver::PickBranch()
+{
+	int32_t best = -1;
+	for(size_t var=0; var<m_values.size(); var++)
+	{
+		if(m_values[var] != VALUE_UNASSIGNED)
+			continue;
+		if( (best < 0) || (m_activity[var] > m_activity[best]) )
+			best = var;
+	}
+	return best;
+}
+
+void SATSolver::BumpActivity(uint32_t var)
+{
+	m_activity[var] += m_activityIncrement;
+
+	//Scale everything down before it overflows (only the order matters)
+	if(m_activity[var] > 1e100)
+	{
+		for(auto& activity : m_activity)
+			activity *= 1e-100;
+		m_activityIncrement *= 1e-100;
+	}
+}
@@ -0,0 +1,105 @@
+/***********************************************************************************************************************
+ * Copyright (C) 2016 Andrew Zonenberg and contributors                                                                *
+ *                                                                                                                     *
+ * This program is free software; you can redistribute it and/or modify it under the terms of the GNU Lesser General   *
+ * Public License as published by the Free Software Foundation; either version 2.1 of the License, or (at your option) *
+ * any later version.                                                                                                  *
+ *                                                                                                                     *
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied  *
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for     *
+ * more details.                                                                                                       *
+ *                                                                                                                     *
+ * You should have received a copy of the GNU Lesser General Public License along with this program; if not, you may   *
+ * find one here:                                                                                                      *
+ * https://www.gnu.org/licenses/old-licenses/lgpl-2.1.txt                                                              *
+ * or you may search the http://www.gnu.org website for the version 2.1 license, or you may write to the Free Software *
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA                                      *
+ **********************************************************************************************************************/
+
+#ifndef SATSolver_h
+#define SATSolver_h
+
+#include <cstddef>
+#include <stdint.h>
+#include <vector>
+
+/**
+	@brief A small CDCL SAT solver, for proving the bigger logic cones equivalent
+
+	Clauses are lists of literals, made with Literal(). Add all of them, then call Solve() once. There are no restarts
+	or clause deletion, so it's only meant for the few hundred variables of a GreenPAK logic cone.
+ */
+class SATSolver
+{
+public:
+	SATSolver();
+
+	uint32_t NewVariable();
+
+	static uint32_t Literal(uint32_t var, bool negated = false)
+	{ return (var << 1) | (negated ? 1 : 0); }
+
+	void AddClause(std::vector<uint32_t> literals);
+
+	bool Solve();
+
+	/**
+		@brief Value of a variable in the satisfying assignment Solve() found
+	 */
+	bool GetValue(uint32_t var)
+	{ return m_values[var] == VALUE_TRUE; }
+
+	uint32_t GetConflictCount()
+	{ return m_conflicts; }
+
+protected:
+	enum Value
+	{
+		VALUE_FALSE,
+		VALUE_TRUE,
+		VALUE_UNASSIGNED
+	};
+
+	Value GetLiteralValue(uint32_t lit)
+	{
+		Value value = static_cast<Value>(m_values[lit >> 1]);
+		if( (value == VALUE_UNASSIGNED) || !(lit & 1) )
+			return value;
+		return (value == VALUE_TRUE) ? VALUE_FALSE : VALUE_TRUE;
+	}
+
+	uint32_t AddWatchedClause(const std::vector<uint32_t>& literals);
+	void Assign(uint32_t lit, int32_t reason);
+	int32_t Propagate();
+	unsigned int Analyze(int32_t conflict, std::vector<uint32_t>& learnt);
+	void Backtrack(unsigned int level);
+	int32_t PickBranch();
+	void BumpActivity(uint32_t var);
+
+	///Every clause with at least two literals, original and learnt
+	std::vector< std::vector<uint32_t> > m_clauses;
+
+	///Clauses watching each literal (the first two literals of a clause are the ones watched)
+	std::vector< std::vector<uint32_t> > m_watches;
+
+	///Per variable: current value, decision level it was assigned at, and the clause that implied it (-1 if none)
+	std::vector<uint8_t> m_values;
+	std::vector<unsigned int> m_levels;
+	std::vector<int32_t> m_reasons;
+
+	///Per variable: how often it's been in recent conflicts, so we branch on those first
+	std::vector<double> m_activity;
+	double m_activityIncrement;
+
+	///Literals in the order they were made true, where each decision level starts, and how far we've propagated
+	std::vector<uint32_t> m_trail;
+	std::vector<size_t> m_trailLimits;
+	size_t m_propagated;
+
+	///Set if an empty clause (or two contradictory units) was added
+	bool m_unsatisfiable;
+
+	uint32_t m_conflicts;
+};
+
+#endif
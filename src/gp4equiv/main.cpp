@@ -0,0 +1,165 @@
+/***********************************************************************************************************************
+ * Copyright (C) 2016 Andrew Zonenberg and contributors                                                                *
+ *                                                                                                                     *
+ * This program is free software; you can redistribute it and/or modify it under the terms of the GNU Lesser General   *
+ * Public License as published by the Free Software Foundation; either version 2.1 of the License, or (at your option) *
+ * any later version.                                                                                                  *
+ *                                                                                                                     *
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied  *
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for     *
+ * more details.                                                                                                       *
+ *                                                                                                                     *
+ * You should have received a copy of the GNU Lesser General Public License along with this program; if not, you may   *
+ * find one here:                                                                                                      *
+ * https://www.gnu.org/licenses/old-licenses/lgpl-2.1.txt                                                              *
+ * or you may search the http://www.gnu.org website for the version 2.1 license, or you may write to the Free Software *
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA                                      *
+ **********************************************************************************************************************/
+
+#include "Greenpak4EquivalenceChecker.h"
+
+using namespace std;
+
+void ShowUsage();
+void ShowVersion();
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Entry point
+
+int main(int argc, char* argv[])
+{
+	Severity console_verbosity = Severity::NOTICE;
+
+	string netlistFile;
+	string bitstreamFile;
+	string placementFile;
+	Greenpak4Device::GREENPAK4_PART part = Greenpak4Device::GREENPAK4_SLG46620;
+
+	//Parse command-line arguments
+	for(int i=1; i<argc; i++)
+	{
+		string s(argv[i]);
+
+		//Let the logger eat its args first
+		if(ParseLoggerArguments(i, argc, argv, console_verbosity))
+			continue;
+
+		else if(s == "--help")
+		{
+			ShowUsage();
+			return 0;
+		}
+		else if(s == "--version")
+		{
+			ShowVersion();
+			return 0;
+		}
+		else if(s == "-p" || s == "--part")
+		{
+			if(i+1 >= argc)
+			{
+				printf("--part requires an argument\n");
+				return 1;
+			}
+
+			string partname = argv[++i];
+			if(partname == "SLG46620V")
+				part = Greenpak4Device::GREENPAK4_SLG46620;
+			else if(partname == "SLG46621V")
+				part = Greenpak4Device::GREENPAK4_SLG46621;
+			else if(partname == "SLG46140V")
+				part = Greenpak4Device::GREENPAK4_SLG46140;
+			else
+			{
+				printf("invalid part (supported: SLG46620V, SLG46621V, SLG46140V)\n");
+				return 1;
+			}
+		}
+
+		//The files, in order
+		else if( (s[0] != '-') && (netlistFile == "") )
+			netlistFile = s;
+		else if( (s[0] != '-') && (bitstreamFile == "") )
+			bitstreamFile = s;
+		else if( (s[0] != '-') && (placementFile == "") )
+			placementFile = s;
+
+		else
+		{
+			printf("Unrecognized command-line argument \"%s\", use --help\n", s.c_str());
+			return 1;
+		}
+	}
+
+	if(placementFile == "")
+	{
+		ShowUsage();
+		return 1;
+	}
+
+	//Set up logging
+	g_log_sinks.emplace(g_log_sinks.begin(), new STDLogSink(console_verbosity));
+	SetDebugLogging(console_verbosity >= Severity::DEBUG);
+
+	auto start = chrono::steady_clock::now();
+
+	LogNotice("Loading netlist \"%s\"\n", netlistFile.c_str());
+	Greenpak4Netlist netlist(netlistFile);
+	if(!netlist.Validate())
+		return 1;
+
+	LogNotice("Loading bitstream \"%s\"\n", bitstreamFile.c_str());
+	Greenpak4Device device(part);
+	uint8_t userid;
+	bool readProtect;
+	if(!device.LoadFromFile(bitstreamFile, userid, readProtect))
+		return 1;
+
+	//The checker reads LUT contents from the raw bits itself
+	Greenpak4Bitstream bitstream(device.GetBitLength());
+	if(!device.ReadBitstream(bitstreamFile, bitstream))
+		return 1;
+
+	placementmap placement;
+	if(!ReadPlacementFile(placementFile, placement))
+		return 1;
+
+	LogNotice("Checking equivalence\n");
+	Greenpak4EquivalenceChecker checker(&netlist, &device, bitstream, placement);
+	bool ok = checker.Check();
+
+	double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+	if(ok)
+		LogNotice("Bitstream is equivalent to the netlist (%.3f s)\n", seconds);
+	return ok ? 0 : 1;
+}
+
+void ShowUsage()
+{
+	printf(//                                                                               v 80th column
+		"Usage: gp4equiv [options] netlist.json bitstream.txt placement.txt\n"
+		"    Proves that a bitstream implements a netlist. The placement is the one gp4par\n"
+		"    wrote with --write-placement when it compiled the bitstream. Exits with\n"
+		"    status 0 if they're equivalent, and 1 (after listing the differences) if\n"
+		"    they aren't.\n"
+		"    -q, --quiet\n"
+		"        Causes only warnings and errors to be written to the console.\n"
+		"        Specify twice to also silence warnings.\n"
+		"    --verbose\n"
+		"        Prints additional information about the design.\n"
+		"    --debug\n"
+		"        Prints lots of internal debugging information.\n"
+		"    -p, --part           <part>\n"
+		"        Specifies the part the bitstream is for (default SLG46620V).\n"
+		"        Supported: SLG46620V, SLG46621V, SLG46140V.\n");
+}
+
+void ShowVersion()
+{
+	printf(
+		"GreenPAK 4 equivalence checker by Andrew D. Zonenberg.\n"
+		"\n"
+		"License: LGPL v2.1+\n"
+		"This is free software: you are free to change and redistribute it.\n"
+		"There is NO WARRANTY, to the extent permitted by law.\n");
+}
@@ -0,0 +1,157 @@
+/***********************************************************************************************************************
+ * Copyright (C) 2016 Andrew Zonenberg and contributors                                                                *
+ *                                                                                                                     *
+ * This program is free software; you can redistribute it and/or modify it under the terms of the GNU Lesser General   *
+ * Public License as published by the Free Software Foundation; either version 2.1 of the License, or (at your option) *
+ * any later version.                                                                                                  *
+ *                                                                                                                     *
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied  *
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for     *
+ * more details.                                                                                                       *
+ *                                                                                                                     *
+ * You should have received a copy of the GNU Lesser General Public License along with this program; if not, you may   *
+ * find one here:                                                                                                      *
+ * https://www.gnu.org/licenses/old-licenses/lgpl-2.1.txt                                                              *
+ * or you may search the http://www.gnu.org website for the version 2.1 license, or you may write to the Free Software *
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA                                      *
+ **********************************************************************************************************************/
+
+#include <chrono>
+#include "gp4par.h"
+
+using namespace std;
+
+/**
+	@brief Starts writing to a file (which we close when we're done with it)
+
+	@param fp				The file to write to
+	@param min_severity		Don't write messages less important than this
+	@param max_buffered		Maximum size of the messages waiting to be written, in bytes
+ */
+AsyncFileLogSink::AsyncFileLogSink(FILE* fp, Severity min_severity, size_t max_buffered)
+	: m_fp(fp)
+	, m_minSeverity(min_severity)
+	, m_maxBuffered(max_buffered)
+	, m_writing(false)
+	, m_stopping(false)
+{
+	m_writer = thread(&AsyncFileLogSink::WriterThread, this);
+}
+
+AsyncFileLogSink::~AsyncFileLogSink()
+{
+	{
+		lock_guard<mutex> guard(m_lock);
+		m_stopping = true;
+	}
+	m_wake.notify_all();
+	m_writer.join();
+
+	fclose(m_fp);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Logging
+
+void AsyncFileLogSink::Log(Severity severity, const string& msg)
+{
+	if(severity > m_minSeverity)
+		return;
+	Append(msg.c_str(), msg.size(), severity == Severity::FATAL);
+}
+
+void AsyncFileLogSink::Log(Severity severity, const char* format, va_list va)
+{
+	if(severity > m_minSeverity)
+		return;
+
+	//Format into a buffer of our own thread's, so we hold the lock only long enough to copy the result
+	static thread_local vector<char> buf(256);
+	va_list va2;
+	va_copy(va2, va);
+	int len = vsnprintf(&buf[0], buf.size(), format, va2);
+	va_end(va2);
+	if(len < 0)
+		return;
+	if(static_cast<size_t>(len) >= buf.size())
+	{
+		buf.resize(len + 1);
+		vsnprintf(&buf[0], buf.size(), format, va);
+	}
+
+	Append(&buf[0], len, severity == Severity::FATAL);
+}
+
+/**
+	@brief Queues a message for the writer, waiting for it to catch up first if too much is queued already
+ */
+void AsyncFileLogSink::Append(const char* msg, size_t len, bool fatal)
+{
+	unique_lock<mutex> guard(m_lock);
+	while( (m_pending.size() + len > m_maxBuffered) && !m_pending.empty() && !m_stopping)
+	{
+		m_wake.notify_one();
+		m_written.wait(guard);
+	}
+	m_pending.append(msg, len);
+
+	//We're about to die, so the writer won't get another chance
+	if(fatal)
+	{
+		WritePending(guard);
+		return;
+	}
+
+	if(m_pending.size() >= FLUSH_SIZE)
+		m_wake.notify_one();
+}
+
+/**
+	@brief Waits until everything logged so far has been written to the file
+ */
+void AsyncFileLogSink::Flush()
+{
+	unique_lock<mutex> guard(m_lock);
+	WritePending(guard);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Writing
+
+void AsyncFileLogSink::WriterThread()
+{
+	unique_lock<mutex> guard(m_lock);
+	while(true)
+	{
+		m_wake.wait_for(guard, chrono::milliseconds(FLUSH_INTERVAL_MS));
+		WritePending(guard);
+		if(m_stopping)
+			break;
+	}
+}
+
+/**
+	@brief Writes out everything that's queued, without holding the lock while we do it.
+
+	If another thread is already writing, waits for it to finish instead, then writes whatever's been queued since:
+	when this returns, everything queued before the call has been written.
+ */
+void AsyncFileLogSink::WritePending(unique_lock<mutex>& guard)
+{
+	while(m_writing)
+		m_written.wait(guard);
+	if(m_pending.empty())
+		return;
+
+	string batch;
+	batch.swap(m_pending);
+	m_writing = true;
+	guard.unlock();
+
+	fwrite(batch.c_str(), 1, batch.size(), m_fp);
+	fflush(m_fp);
+
+	guard.lock();
+	m_writing = false;
+	m_written.notify_all();
+}
@@ -0,0 +1,77 @@
+/***********************************************************************************************************************
+ * Copyright (C) 2016 Andrew Zonenberg and contributors                                                                *
+ *                                                                                                                     *
+ * This program is free software; you can redistribute it and/or modify it under the terms of the GNU Lesser General   *
+ * Public License as published by the Free Software Foundation; either version 2.1 of the License, or (at your option) *
+ * any later version.                                                                                                  *
+ *                                                                                                                     *
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied  *
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for     *
+ * more details.                                                                                                       *
+ *                                                                                                                     *
+ * You should have received a copy of the GNU Lesser General Public License along with this program; if not, you may   *
+ * find one here:                                                                                                      *
+ * https://www.gnu.org/licenses/old-licenses/lgpl-2.1.txt                                                              *
+ * or you may search the http://www.gnu.org website for the version 2.1 license, or you may write to the Free Software *
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA                                      *
+ **********************************************************************************************************************/
+
+#ifndef AsyncFileLogSink_h
+#define AsyncFileLogSink_h
+
+#include <condition_variable>
+#include <cstdarg>
+#include <cstdio>
+#include <mutex>
+#include <thread>
+
+/**
+	@brief Writes log messages to a file from a background thread, so logging threads never wait on the disk.
+
+	Messages are formatted on the logging thread, then queued in memory; the writer thread picks them up
+	every FLUSH_INTERVAL_MS milliseconds, or as soon as FLUSH_SIZE bytes are waiting. If more than max_buffered bytes
+	pile up, logging threads wait for the writer to catch up, so memory use stays bounded.
+
+	Fatal messages are written out (along with everything before them) before Log() returns, since the logger doesn't
+	come back from LogFatal(). Everything else is written by the time the sink is destroyed.
+ */
+class AsyncFileLogSink : public LogSink
+{
+public:
+	AsyncFileLogSink(FILE* fp, Severity min_severity, size_t max_buffered = 4 * 1024 * 1024);
+	virtual ~AsyncFileLogSink();
+
+	virtual void Log(Severity severity, const std::string& msg);
+	virtual void Log(Severity severity, const char* format, va_list va);
+
+	void Flush();
+
+protected:
+	void Append(const char* msg, size_t len, bool fatal);
+	void WriterThread();
+	void WritePending(std::unique_lock<std::mutex>& guard);
+
+	enum
+	{
+		FLUSH_INTERVAL_MS = 100,
+		FLUSH_SIZE = 64 * 1024
+	};
+
+	FILE* m_fp;
+	Severity m_minSeverity;
+	size_t m_maxBuffered;
+
+	//Messages waiting to be written, and whether the writer is in the middle of writing the last batch
+	std::mutex m_lock;
+	std::string m_pending;
+	bool m_writing;
+	bool m_stopping;
+
+	//Signalled when there's a lot to write (or we're stopping), and when a batch has been written
+	std::condition_variable m_wake;
+	std::condition_variable m_written;
+
+	std::thread m_writer;
+};
+
+#endif
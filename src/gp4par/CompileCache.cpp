@@ -0,0 +1,335 @@
+/***********************************************************************************************************************
+ * Copyright (C) 2016 Andrew Zonenberg and contributors                                                                *
+ *                                                                                                                     *
+ * This program is free software; you can redistribute it and/or modify it under the terms of the GNU Lesser General   *
+ * Public License as published by the Free Software Foundation; either version 2.1 of the License, or (at your option) *
+ * any later version.                                                                                                  *
+ *                                                                                                                     *
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied  *
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for     *
+ * more details.                                                                                                       *
+ *                                                                                                                     *
+ * You should have received a copy of the GNU Lesser General Public License along with this program; if not, you may   *
+ * find one here:                                                                                                      *
+ * https://www.gnu.org/licenses/old-licenses/lgpl-2.1.txt                                                              *
+ * or you may search the http://www.gnu.org website for the version 2.1 license, or you may write to the Free Software *
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA                                      *
+ **********************************************************************************************************************/
+
+#include <algorithm>
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <unistd.h>
+#include "gp4par.h"
+
+using namespace std;
+
+/*
+	Entry layout (all integers little endian, strings are a u32 length then the bytes)
+
+		"GP4R", u32 format version, u64 key
+		string options key, u64 netlist size
+		u32 part, string bitstream, string stamping template, u32 critical path delay, u32 has timing report,
+			string timing report, string placement
+		u32 violation count, then for each: u32 severity, string rule, string object, string message,
+			u32 count, strings details
+		u64 HashNetlist() of everything before this (with no salt)
+
+	Bump RESULT_CACHE_VERSION whenever this changes.
+ */
+#define RESULT_CACHE_VERSION 4
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Construction / destruction
+
+/**
+	@brief Works out where the result of compiling the given netlist with the given options would be cached
+ */
+CompileCache::CompileCache(const CompileOptions& options, const char* json, size_t len)
+	: m_dir(options.resultCache)
+	, m_options(GetOptionsKey(options))
+	, m_netlistSize(len)
+	, m_maxSize(static_cast<uint64_t>(options.resultCacheSize) * 1024 * 1024)
+	, m_needTimingReport(!options.par.timingReportFile.empty())
+{
+	//The placement we start from and the annealing profile change the result too, so their contents are part of
+	//the key.
+	//If it can't be read, the compile will fail and never be stored, so it doesn't matter what we use.
+	if(!options.par.reusePlacementFile.empty())
+	{
+		string previous;
+		ReadInputFile(options.par.reusePlacementFile, previous);
+		char tmp[32];
+		snprintf(tmp, sizeof(tmp), " reuse=%016llx",
+			static_cast<unsigned long long>(Greenpak4Netlist::HashNetlist(previous.c_str(), previous.size(), "")));
+		m_options += tmp;
+	}
+	if(!options.par.annealProfileFile.empty())
+	{
+		string profile;
+		ReadInputFile(options.par.annealProfileFile, profile);
+		char tmp[32];
+		snprintf(tmp, sizeof(tmp), " profile=%016llx",
+			static_cast<unsigned long long>(Greenpak4Netlist::HashNetlist(profile.c_str(), profile.size(), "")));
+		m_options += tmp;
+	}
+
+	m_key = Greenpak4Netlist::HashNetlist(json, len, GetNetlistCacheSalt() + "\n" + m_options + "\n");
+
+	char tmp[32];
+	snprintf(tmp, sizeof(tmp), "/%016llx.gp4r", static_cast<unsigned long long>(m_key));
+	m_fname = m_dir + tmp;
+}
+
+/**
+	@brief Describes every option that can change the result of a compile.
+
+	File names don't (the reports are stored in the entry), and neither does the number of threads. The contents of
+	the --reuse-placement and --anneal-profile files do, but the constructor adds those. Anything that's added to
+	CompileOptions or PAROptions and changes the output has to be added here too.
+ */
+string CompileCache::GetOptionsKey(const CompileOptions& options)
+{
+	const PAROptions& p = options.par;
+	char buf[512];
+	snprintf(buf, sizeof(buf),
+		"part=%d auto=%d pull=%d drive=%d precharge=%d chargepump=%d ldo=%d retry=%d userid=%u protect=%d format=%d "
+		"optimize=%d seeds=%u candidates=%u seed=%u timing=%u batch=%u exact=%.6f multilevel=%d timelimit=%.6f",
+		static_cast<int>(options.part),
+		options.autoPart,
+		static_cast<int>(options.unusedPull),
+		static_cast<int>(options.unusedDrive),
+		options.ioPrecharge,
+		options.disableChargePump,
+		options.ldoBypass,
+		options.bootRetry,
+		options.userid,
+		options.readProtect,
+		static_cast<int>(options.format),
+		p.optimize,
+		p.seeds,
+		p.candidates,
+		p.seed,
+		p.timingTarget,
+		p.batchMoves,
+		p.exactTime,
+		p.multilevel,
+		p.timeLimit);
+	return buf;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Lookup
+
+/**
+	@brief Loads the cached result for this compile, if there is one
+
+	@return True on a hit. False if there's no entry, or it's unusable (warnings are printed if it's corrupted).
+ */
+bool CompileCache::Load(CompileResult& result)
+{
+	vector<uint8_t> buf;
+	bool ok = ReadCacheFile(m_fname, "GP4R", buf);
+
+	CompileResult cached;
+	if(ok)
+	{
+		Greenpak4CacheReader reader(buf);
+		reader.m_pos = 4;
+		ok =
+			(reader.ReadU32() == RESULT_CACHE_VERSION) &&
+			(reader.ReadU64() == m_key) &&
+			(reader.ReadString() == m_options) &&
+			(reader.ReadU64() == m_netlistSize);
+
+		if(ok)
+		{
+			cached.part = static_cast<Greenpak4Device::GREENPAK4_PART>(reader.ReadU32());
+			cached.bitstream = reader.ReadString();
+			cached.stampTemplate = reader.ReadString();
+			cached.criticalPathDelay = reader.ReadU32();
+			bool has_timing = reader.ReadU32();
+			cached.timingReport = reader.ReadString();
+			cached.placement = reader.ReadString();
+
+			//Entries from runs that didn't ask for a timing report can't stand in for ones that do
+			if(m_needTimingReport && !has_timing)
+				ok = false;
+
+			uint32_t count = reader.ReadU32();
+			for(uint32_t i=0; (i<count) && reader.m_ok; i++)
+			{
+				auto severity = static_cast<Greenpak4DRCViolation::Severity>(reader.ReadU32());
+				Greenpak4DRCReport report(reader.ReadString());
+				string object = reader.ReadString();
+				string message = reader.ReadString();
+				auto& v = (severity == Greenpak4DRCViolation::SEVERITY_ERROR) ?
+					report.Error(object, "%s", message.c_str()) :
+					report.Warning(object, "%s", message.c_str());
+				uint32_t ndetails = reader.ReadU32();
+				for(uint32_t j=0; (j<ndetails) && reader.m_ok; j++)
+					v.m_details.push_back(reader.ReadString());
+				cached.drc.Append(report);
+			}
+		}
+
+		ok = ok && reader.m_ok && reader.AtEnd();
+	}
+
+	UpdateStatistics(ok, false);
+	if(!ok)
+		return false;
+
+	//Bump the timestamp, so eviction sees it as recently used
+	utimes(m_fname.c_str(), NULL);
+
+	//Only the statistics are about this run rather than the one that stored the entry
+	cached.cached = true;
+	cached.stats = result.stats;
+	result = cached;
+	return true;
+}
+
+/**
+	@brief Saves the result of a successful compile, evicting old entries if the cache gets too big
+ */
+void CompileCache::Store(const CompileResult& result)
+{
+	vector<uint8_t> buf;
+	buf.push_back('G');
+	buf.push_back('P');
+	buf.push_back('4');
+	buf.push_back('R');
+	CacheWriteU32(buf, RESULT_CACHE_VERSION);
+	CacheWriteU64(buf, m_key);
+	CacheWriteString(buf, m_options);
+	CacheWriteU64(buf, m_netlistSize);
+
+	CacheWriteU32(buf, result.part);
+	CacheWriteString(buf, result.bitstream);
+	CacheWriteString(buf, result.stampTemplate);
+	CacheWriteU32(buf, result.criticalPathDelay);
+	CacheWriteU32(buf, m_needTimingReport);
+	CacheWriteString(buf, result.timingReport);
+	CacheWriteString(buf, result.placement);
+
+	auto& violations = result.drc.GetViolations();
+	CacheWriteU32(buf, violations.size());
+	for(auto& v : violations)
+	{
+		CacheWriteU32(buf, v.m_severity);
+		CacheWriteString(buf, v.m_rule);
+		CacheWriteString(buf, v.m_object);
+		CacheWriteString(buf, v.m_message);
+		CacheWriteU32(buf, v.m_details.size());
+		for(auto& d : v.m_details)
+			CacheWriteString(buf, d);
+	}
+
+	if(!WriteCacheFile(m_fname, buf))
+		return;
+
+	LogVerbose("Wrote result cache file %s\n", m_fname.c_str());
+	UpdateStatistics(false, true);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Bookkeeping
+
+/**
+	@brief Counts a lookup or store in the statistics file, and prints the totals so far.
+
+	The statistics file doubles as the lock that keeps concurrent evictions from tripping over each other.
+ */
+void CompileCache::UpdateStatistics(bool hit, bool store)
+{
+	string fname = m_dir + "/stats";
+	int fd = open(fname.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+	if(fd < 0)
+	{
+		LogWarning("Couldn't open result cache statistics %s\n", fname.c_str());
+		return;
+	}
+	flock(fd, LOCK_EX);
+
+	char buf[256] = {0};
+	ssize_t len = pread(fd, buf, sizeof(buf) - 1, 0);
+	unsigned long long hits = 0;
+	unsigned long long misses = 0;
+	unsigned long long evictions = 0;
+	if(len > 0)
+		sscanf(buf, "hits %llu misses %llu evictions %llu", &hits, &misses, &evictions);
+
+	if(store)
+		evictions += Evict();
+	else if(hit)
+		hits ++;
+	else
+		misses ++;
+
+	len = snprintf(buf, sizeof(buf), "hits %llu misses %llu evictions %llu\n", hits, misses, evictions);
+	if( (0 != ftruncate(fd, 0)) || (len != pwrite(fd, buf, len, 0)) )
+		LogWarning("Couldn't update result cache statistics %s\n", fname.c_str());
+	close(fd);
+
+	if(!store)
+	{
+		LogNotice("Result cache %s (%llu hits, %llu misses, %llu evictions so far)\n",
+			hit ? "hit" : "miss", hits, misses, evictions);
+	}
+}
+
+/**
+	@brief Deletes the least recently used entries until the cache fits in its size limit
+
+	Must be called with the statistics file locked.
+
+	@return Number of entries deleted
+ */
+unsigned int CompileCache::Evict()
+{
+	DIR* dir = opendir(m_dir.c_str());
+	if(!dir)
+		return 0;
+
+	//Find all of the entries (not temporary files, they're about to be renamed or deleted anyway)
+	vector< pair<time_t, string> > entries;
+	map<string, uint64_t> sizes;
+	uint64_t total = 0;
+	while(dirent* ent = readdir(dir))
+	{
+		string name = ent->d_name;
+		if( (name.length() < 5) || (name.compare(name.length() - 5, 5, ".gp4r") != 0) )
+			continue;
+
+		string path = m_dir + "/" + name;
+		struct stat st;
+		if(0 != stat(path.c_str(), &st))
+			continue;
+		entries.push_back(pair<time_t, string>(st.st_mtime, path));
+		sizes[path] = st.st_size;
+		total += st.st_size;
+	}
+	closedir(dir);
+
+	//Oldest first
+	sort(entries.begin(), entries.end());
+	unsigned int evicted = 0;
+	for(size_t i=0; (i<entries.size()) && (total > m_maxSize); i++)
+	{
+		auto& path = entries[i].second;
+		if(path == m_fname)
+			continue;
+		if(0 == unlink(path.c_str()))
+		{
+			LogVerbose("Evicted result cache file %s\n", path.c_str());
+			total -= sizes[path];
+			evicted ++;
+		}
+	}
+
+	return evicted;
+}
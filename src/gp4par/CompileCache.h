@@ -0,0 +1,63 @@
+/***********************************************************************************************************************
+ * Copyright (C) 2016 Andrew Zonenberg and contributors                                                                *
+ *                                                                                                                     *
+ * This program is free software; you can redistribute it and/or modify it under the terms of the GNU Lesser General   *
+ * Public License as published by the Free Software Foundation; either version 2.1 of the License, or (at your option) *
+ * any later version.                                                                                                  *
+ *                                                                                                                     *
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied  *
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for     *
+ * more details.                                                                                                       *
+ *                                                                                                                     *
+ * You should have received a copy of the GNU Lesser General Public License along with this program; if not, you may   *
+ * find one here:                                                                                                      *
+ * https://www.gnu.org/licenses/old-licenses/lgpl-2.1.txt                                                              *
+ * or you may search the http://www.gnu.org website for the version 2.1 license, or you may write to the Free Software *
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA                                      *
+ **********************************************************************************************************************/
+
+#ifndef CompileCache_h
+#define CompileCache_h
+
+class CompileOptions;
+class CompileResult;
+
+/**
+	@brief On-disk cache of compile results, keyed by everything that affects them.
+
+	The key covers the netlist contents, every option that changes the bitstream or reports, and the build of gp4par.
+	Only successful compiles are stored. Entries are written under a temporary name and renamed, so any number of
+	processes can share a cache directory. Once the directory grows past its size limit, the least recently used
+	entries are deleted.
+ */
+class CompileCache
+{
+public:
+	CompileCache(const CompileOptions& options, const char* json, size_t len);
+
+	bool Load(CompileResult& result);
+	void Store(const CompileResult& result);
+
+protected:
+	static std::string GetOptionsKey(const CompileOptions& options);
+
+	void UpdateStatistics(bool hit, bool store);
+	unsigned int Evict();
+
+	//The cache directory and entry for this compile
+	std::string m_dir;
+	std::string m_fname;
+
+	//Everything that went into the key (stored in the entry too, to catch hash collisions)
+	std::string m_options;
+	uint64_t m_netlistSize;
+	uint64_t m_key;
+
+	//Size limit, in bytes
+	uint64_t m_maxSize;
+
+	//True if the compile wants a timing report (entries stored without one can't be used then)
+	bool m_needTimingReport;
+};
+
+#endif
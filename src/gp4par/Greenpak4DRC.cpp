@@ -0,0 +1,680 @@
+/***********************************************************************************************************************
+ * Copyright (C) 2016 Andrew Zonenberg and contributors                                                                *
+ *                                                                                                                     *
+ * This program is free software; you can redistribute it and/or modify it under the terms of the GNU Lesser General   *
+ * Public License as published by the Free Software Foundation; either version 2.1 of the License, or (at your option) *
+ * any later version.                                                                                                  *
+ *                                                                                                                     *
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied  *
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for     *
+ * more details.                                                                                                       *
+ *                                                                                                                     *
+ * You should have received a copy of the GNU Lesser General Public License along with this program; if not, you may   *
+ * find one here:                                                                                                      *
+ * https://www.gnu.org/licenses/old-licenses/lgpl-2.1.txt                                                              *
+ * or you may search the http://www.gnu.org website for the version 2.1 license, or you may write to the Free Software *
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA                                      *
+ **********************************************************************************************************************/
+
+#include <atomic>
+#include <cstdarg>
+#include <thread>
+#include "gp4par.h"
+
+using namespace std;
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Reports
+
+/**
+	@brief Formats a printf-style message into a string
+ */
+static string FormatMessage(const char* format, va_list args)
+{
+	va_list copy;
+	va_copy(copy, args);
+	int len = vsnprintf(NULL, 0, format, copy);
+	va_end(copy);
+	if(len <= 0)
+		return "";
+
+	vector<char> buf(len + 1);
+	vsnprintf(&buf[0], buf.size(), format, args);
+	return string(&buf[0], len);
+}
+
+Greenpak4DRCViolation& Greenpak4DRCReport::Error(string object, const char* format, ...)
+{
+	va_list args;
+	va_start(args, format);
+	string message = FormatMessage(format, args);
+	va_end(args);
+	return Add(Greenpak4DRCViolation::SEVERITY_ERROR, object, message);
+}
+
+Greenpak4DRCViolation& Greenpak4DRCReport::Warning(string object, const char* format, ...)
+{
+	va_list args;
+	va_start(args, format);
+	string message = FormatMessage(format, args);
+	va_end(args);
+	return Add(Greenpak4DRCViolation::SEVERITY_WARNING, object, message);
+}
+
+Greenpak4DRCViolation& Greenpak4DRCReport::Add(
+	Greenpak4DRCViolation::Severity severity,
+	string object,
+	string message)
+{
+	if(severity == Greenpak4DRCViolation::SEVERITY_ERROR)
+		m_errorCount ++;
+	else
+		m_warningCount ++;
+
+	m_violations.push_back(Greenpak4DRCViolation(severity, m_rule, object, message));
+	return m_violations.back();
+}
+
+/**
+	@brief Adds all of the violations in another report to the end of this one
+ */
+void Greenpak4DRCReport::Append(const Greenpak4DRCReport& report)
+{
+	m_violations.insert(m_violations.end(), report.m_violations.begin(), report.m_violations.end());
+	m_errorCount += report.m_errorCount;
+	m_warningCount += report.m_warningCount;
+}
+
+/**
+	@brief Logs every violation, in order
+ */
+void Greenpak4DRCReport::Print() const
+{
+	for(auto& v : m_violations)
+	{
+		if(v.m_severity == Greenpak4DRCViolation::SEVERITY_ERROR)
+			LogError("%s\n", v.m_message.c_str());
+		else
+			LogWarning("%s\n", v.m_message.c_str());
+
+		LogIndenter li;
+		for(auto& d : v.m_details)
+			LogNotice("%s\n", d.c_str());
+	}
+}
+
+/**
+	@brief Writes every violation to a JSON file, so scripts can check designs without scraping the log
+ */
+bool Greenpak4DRCReport::WriteJSON(string fname) const
+{
+	FILE* fp = fopen(fname.c_str(), "w");
+	if(!fp)
+	{
+		LogError("Couldn't open %s for writing\n", fname.c_str());
+		return false;
+	}
+
+	fprintf(fp, "{\n");
+	fprintf(fp, "    \"errors\": %u,\n", m_errorCount);
+	fprintf(fp, "    \"warnings\": %u,\n", m_warningCount);
+	fprintf(fp, "    \"violations\": [");
+	for(size_t i=0; i<m_violations.size(); i++)
+	{
+		auto& v = m_violations[i];
+		fprintf(fp, "%s\n        {\n", (i == 0) ? "" : ",");
+		fprintf(fp, "            \"severity\": \"%s\",\n",
+			(v.m_severity == Greenpak4DRCViolation::SEVERITY_ERROR) ? "error" : "warning");
+		fprintf(fp, "            \"rule\": ");
+		WriteJSONString(fp, v.m_rule);
+		fprintf(fp, ",\n            \"object\": ");
+		WriteJSONString(fp, v.m_object);
+		fprintf(fp, ",\n            \"message\": ");
+		WriteJSONString(fp, v.m_message);
+		fprintf(fp, ",\n            \"details\": [");
+		for(size_t j=0; j<v.m_details.size(); j++)
+		{
+			fprintf(fp, "%s", (j == 0) ? "" : ", ");
+			WriteJSONString(fp, v.m_details[j]);
+		}
+		fprintf(fp, "]\n");
+		fprintf(fp, "        }");
+	}
+	fprintf(fp, "\n    ]\n");
+	fprintf(fp, "}\n");
+
+	fclose(fp);
+	return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Index
+
+Greenpak4DRCIndex::Greenpak4DRCIndex(PARGraph* netlist, PARGraph* dgraph, Greenpak4Device* device)
+	: m_device(device)
+	, m_loads(dgraph->GetNumNodes())
+{
+	//Where everything went, and what each site drives
+	uint32_t nnodes = netlist->GetNumNodes();
+	m_nodes.resize(nnodes);
+	for(uint32_t i=0; i<nnodes; i++)
+	{
+		Node& n = m_nodes[i];
+		n.m_node = netlist->GetNodeByIndex(i);
+		n.m_entity = static_cast<Greenpak4NetlistEntity*>(n.m_node->GetData());
+		n.m_cell = dynamic_cast<Greenpak4NetlistCell*>(n.m_entity);
+
+		auto mate = n.m_node->GetMate();
+		n.m_site = (mate != NULL) ? static_cast<Greenpak4BitstreamEntity*>(mate->GetData()) : NULL;
+		if(mate == NULL)
+			continue;
+
+		auto& loads = m_loads[mate->GetIndex()];
+		for(uint32_t j=0; j<n.m_node->GetEdgeCount(); j++)
+		{
+			auto dest = n.m_node->GetEdgeByIndex(j)->m_destnode->GetMate();
+			if(dest != NULL)
+				loads.push_back(static_cast<Greenpak4BitstreamEntity*>(dest->GetData())->GetRealEntity());
+		}
+	}
+
+	//Pointers into m_nodes are only safe once it's done growing
+	for(auto& n : m_nodes)
+	{
+		if(n.m_site == NULL)
+			m_unplaced.push_back(&n);
+	}
+
+	for(auto it = device->iobbegin(); it != device->iobend(); it ++)
+	{
+		Greenpak4IOB* iob = it->second;
+		auto mate = iob->GetPARNode()->GetMate();
+		if(mate == NULL)
+			continue;
+		Greenpak4NetlistCell* cell = static_cast<Greenpak4NetlistCell*>(mate->GetData());
+		if(cell != NULL)
+			m_usedIOBs.push_back(pair<Greenpak4IOB*, Greenpak4NetlistCell*>(iob, cell));
+	}
+
+	//Comparators that could possibly use the ACMP0 (shared) mux
+	if(device->GetPart() == Greenpak4Device::GREENPAK4_SLG46620)
+	{
+		auto pin6 = device->GetIOB(6)->GetOutput("");
+		auto vdd = device->GetPower();
+		for(unsigned int i=0; i<device->GetAcmpCount(); i++)
+		{
+			auto acmp = device->GetAcmp(i);
+			auto input = acmp->GetInput();
+
+			//If this comparator is not using one of ACMP0's inputs, we don't care
+			//TODO: buffered pin 6 is a candidate too
+			if((input != pin6) && (input != vdd) )
+				continue;
+
+			//Look up the instance name of the comparator. Sanity check that it's used.
+			auto mate = acmp->GetPARNode()->GetMate();
+			if(mate == NULL)
+				continue;
+			auto node = static_cast<Greenpak4NetlistEntity*>(mate->GetData());
+			m_sharedMuxRequests.push_back(MuxRequest(node->m_name, input));
+		}
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Rules
+
+Greenpak4DRCRule::~Greenpak4DRCRule()
+{
+}
+
+/**
+	@brief Every netlist node must be mapped to a site in the device
+ */
+class Greenpak4UnplacedNodeRule : public Greenpak4DRCRule
+{
+public:
+	virtual const char* GetName() const
+	{ return "unplaced"; }
+
+	virtual void Check(const Greenpak4DRCIndex& index, Greenpak4DRCReport& report) const
+	{
+		for(auto n : index.GetUnplacedNodes())
+		{
+			report.Error(n->m_entity->m_name,
+				"Node \"%s\" is not mapped to any site in the device", n->m_entity->m_name.c_str());
+		}
+	}
+};
+
+/**
+	@brief Warn about nodes whose outputs don't go anywhere
+ */
+class Greenpak4NoLoadRule : public Greenpak4DRCRule
+{
+public:
+	virtual const char* GetName() const
+	{ return "no-load"; }
+
+	virtual void Check(const Greenpak4DRCIndex& index, Greenpak4DRCReport& report) const
+	{
+		for(auto& n : index.GetNodes())
+		{
+			//Unplaced nodes are already an error
+			if(n.m_site == NULL)
+				continue;
+
+			//Do not warn if power rails have no load, that's perfectly normal
+			if(dynamic_cast<Greenpak4PowerRail*>(n.m_site) != NULL)
+				continue;
+
+			//If the node has no output ports, of course it won't have any loads
+			if(n.m_site->GetOutputPortIDs().empty())
+				continue;
+
+			//If the node is an IOB configured as an output, there's no internal load for its output.
+			//This is perfectly normal, obviously.
+			auto cell = n.m_cell;
+			if( (cell != NULL) &&  ( (cell->m_type == "GP_IOBUF") || (cell->m_type == "GP_OBUF") ) )
+				continue;
+
+			//If we have a magic attribute set, it's OK
+			//(for example, inferred ACMP for a VREF we used for another purpose)
+			if( (cell != NULL) && cell->HasAttribute("__IGNORE__NOLOAD__") )
+				continue;
+
+			//If we have no loads, warn
+			if(n.m_node->GetEdgeCount() == 0)
+				report.Warning(n.m_entity->m_name, "Node \"%s\" has no load", n.m_entity->m_name.c_str());
+		}
+	}
+};
+
+/**
+	@brief Warn about IOBs that are not LOC'd
+
+	This is not an error because sometimes a user may want to let PAR find a placement for a complex netlist before
+	laying out the board, to improve routability. We warn because it's easy to forget to add LOC constraints
+	afterwards, causing a future ECO to break the pinout.
+ */
+class Greenpak4UnlockedIOBRule : public Greenpak4DRCRule
+{
+public:
+	virtual const char* GetName() const
+	{ return "unlocked-iob"; }
+
+	virtual void Check(const Greenpak4DRCIndex& index, Greenpak4DRCReport& report) const
+	{
+		for(auto p : index.GetUsedIOBs())
+		{
+			if(p.second->HasLOC())
+				continue;
+
+			report.Warning(p.second->m_name,
+				"IOB cell %s was placed at location %s, but was not locked with a LOC constraint.\n"
+				"This can lead to unexpected pinout changes if the netlist is modified.",
+				p.second->m_name.c_str(), p.first->GetDescription().c_str());
+		}
+	}
+};
+
+/**
+	@brief Analog outputs can only drive pins configured as analog
+
+	TODO: driving an input-only pin etc - is this possible?
+ */
+class Greenpak4AnalogPinDriveRule : public Greenpak4DRCRule
+{
+public:
+	virtual const char* GetName() const
+	{ return "analog-pin-drive"; }
+
+	virtual void Check(const Greenpak4DRCIndex& index, Greenpak4DRCReport& report) const
+	{
+		auto device = index.GetDevice();
+		for(auto it = device->iobbegin(); it != device->iobend(); it ++)
+		{
+			Greenpak4IOB* iob = it->second;
+			if(iob->IsAnalogIbuf())
+				continue;
+
+			auto signal = iob->GetOutputSignal();
+			auto src = signal.GetRealEntity();
+			if(	(dynamic_cast<Greenpak4VoltageReference*>(src) != NULL) ||
+				(dynamic_cast<Greenpak4PGA*>(src) != NULL) )
+			{
+				report.Error(iob->GetDescription(),
+					"Pin %d is driven by an analog source (%s) but does not have IBUF_TYPE = ANALOG",
+					it->first,
+					signal.GetOutputName().c_str());
+			}
+		}
+	}
+};
+
+/**
+	@brief Analog inputs (ACMP, ABUF, PGA) can only be driven by pins configured as analog
+
+	TODO: Check for VREF with inputs driven from non-analog IOs
+ */
+class Greenpak4AnalogIbufRule : public Greenpak4DRCRule
+{
+public:
+	virtual const char* GetName() const
+	{ return "analog-ibuf"; }
+
+	virtual void Check(const Greenpak4DRCIndex& index, Greenpak4DRCReport& report) const
+	{
+		auto device = index.GetDevice();
+		for(unsigned int i=0; i<device->GetAcmpCount(); i++)
+		{
+			auto acmp = device->GetAcmp(i);
+			CheckInput(report, acmp, acmp->GetInput());
+		}
+
+		auto abuf = device->GetAbuf();
+		if(abuf)
+			CheckInput(report, abuf, abuf->GetInput());
+
+		auto pga = device->GetPGA();
+		if(pga)
+		{
+			CheckInput(report, pga, pga->GetInputP());
+			CheckInput(report, pga, pga->GetInputN());
+		}
+	}
+
+protected:
+	static void CheckInput(Greenpak4DRCReport& report, Greenpak4BitstreamEntity* load, Greenpak4EntityOutput input)
+	{
+		auto iob = dynamic_cast<Greenpak4IOB*>(input.GetRealEntity());
+		if(!iob || iob->IsAnalogIbuf())
+			return;
+
+		report.Error(load->GetDescription(),
+			"%s is driven by IOB %s, which does not have IBUF_TYPE = ANALOG",
+			load->GetDescription().c_str(),
+			iob->GetDescription().c_str());
+	}
+};
+
+/**
+	@brief All comparators using ACMP0's input mux have to agree on its setting
+ */
+class Greenpak4SharedAcmpMuxRule : public Greenpak4DRCRule
+{
+public:
+	virtual const char* GetName() const
+	{ return "acmp-shared-mux"; }
+
+	virtual void Check(const Greenpak4DRCIndex& index, Greenpak4DRCReport& report) const
+	{
+		auto& inputs = index.GetSharedMuxRequests();
+		if(inputs.empty())
+			return;
+
+		//If the shared input is used, but has the same value everywhere, we're good - the sharing did its job
+		bool conflict = false;
+		for(auto s : inputs)
+		{
+			if(s.second != inputs[0].second)
+				conflict = true;
+		}
+		if(!conflict)
+			return;
+
+		//Problem! Incompatible mux settings
+		auto& v = report.Error("",
+			"Multiple comparators tried to simultaneously use different outputs from the ACMP0 input mux");
+		for(auto p : inputs)
+		{
+			char buf[256];
+			snprintf(buf, sizeof(buf), "Comparator %10s requested %s",
+				p.first.c_str(), p.second.GetOutputName().c_str());
+			v.m_details.push_back(buf);
+		}
+	}
+};
+
+/**
+	@brief Multiple oscillators with power-down enabled must share the same power-down signal
+ */
+class Greenpak4OscillatorPowerDownRule : public Greenpak4DRCRule
+{
+public:
+	virtual const char* GetName() const
+	{ return "osc-powerdown"; }
+
+	virtual void Check(const Greenpak4DRCIndex& index, Greenpak4DRCReport& report) const
+	{
+		auto device = index.GetDevice();
+		Greenpak4LFOscillator* lfosc = device->GetLFOscillator();
+		Greenpak4RingOscillator* rosc = device->GetRingOscillator();
+		Greenpak4RCOscillator* rcosc = device->GetRCOscillator();
+
+		typedef pair<string, Greenpak4EntityOutput> spair;
+		vector<spair> powerdowns;
+		if(lfosc && lfosc->IsUsed() && lfosc->GetPowerDownEn() && !lfosc->IsConstantPowerDown())
+			powerdowns.push_back(spair(lfosc->GetDescription(), lfosc->GetPowerDown()));
+		if(rosc && rosc->IsUsed() && rosc->GetPowerDownEn() && !rosc->IsConstantPowerDown())
+			powerdowns.push_back(spair(rosc->GetDescription(), rosc->GetPowerDown()));
+		if(rcosc && rcosc->IsUsed() && rcosc->GetPowerDownEn() && !rcosc->IsConstantPowerDown())
+			powerdowns.push_back(spair(rcosc->GetDescription(), rcosc->GetPowerDown()));
+		if(powerdowns.empty())
+			return;
+
+		Greenpak4EntityOutput src = device->GetGround();
+		bool ok = true;
+		for(auto p : powerdowns)
+		{
+			if(src.IsPowerRail())
+				src = p.second;
+			if(src != p.second)
+				ok = false;
+		}
+		if(ok)
+			return;
+
+		auto& v = report.Error("",
+			"Multiple oscillators have power-down enabled, but do not share the same power-down signal");
+		for(auto p : powerdowns)
+		{
+			char buf[256];
+			snprintf(buf, sizeof(buf), "Oscillator %10s powerdown is %s",
+				p.first.c_str(), p.second.GetOutputName().c_str());
+			v.m_details.push_back(buf);
+		}
+	}
+};
+
+/**
+	@brief The DACs share hardware with the PGA and ADC on the SLG4662x
+
+	TODO: Cannot use DAC1 when ADC is used
+	TODO: Check for PGA driving an IOB when ADC is enabled (we do not yet implement the ADC)
+ */
+class Greenpak4DACConflictRule : public Greenpak4DRCRule
+{
+public:
+	virtual const char* GetName() const
+	{ return "dac-conflict"; }
+
+	virtual void Check(const Greenpak4DRCIndex& index, Greenpak4DRCReport& report) const
+	{
+		auto device = index.GetDevice();
+		if( (device->GetPart() != Greenpak4Device::GREENPAK4_SLG46620) &&
+			(device->GetPart() != Greenpak4Device::GREENPAK4_SLG46621))
+		{
+			return;
+		}
+
+		//null check on pga is unnecessary for the 4662x, but necessary to avoid false positive from static analysis
+		auto pga = device->GetPGA();
+		if(!pga || !pga->IsUsed())
+			return;
+
+		if(device->GetDAC(1)->IsUsed())
+		{
+			report.Error("DAC1",
+				"Both DAC1 and the PGA are used. This is illegal due to a poorly documented control hazard.\n"
+				"Enabling the PGA turns on the SAR ADC, forcing DAC1 to emit a sawtooth waveform instead of the "
+				"desired signal.");
+		}
+
+		if(device->GetDAC(0)->IsUsed() && (pga->GetInputMode() == Greenpak4PGA::MODE_PDIFF) )
+		{
+			report.Error("DAC0",
+				"DAC0 is used while the PGA is in pseudo-differential mode. This is illegal since the "
+				"PGA uses DAC0 to provide the pseudo-differential offset voltage.");
+		}
+	}
+};
+
+/**
+	@brief If POR is driven to an IOB, it should use dedicated routing. If not, warn about timing
+ */
+class Greenpak4PORRoutingRule : public Greenpak4DRCRule
+{
+public:
+	virtual const char* GetName() const
+	{ return "por-routing"; }
+
+	virtual void Check(const Greenpak4DRCIndex& index, Greenpak4DRCReport& report) const
+	{
+		auto device = index.GetDevice();
+		auto por = device->GetPowerOnReset();
+		if(!por->IsUsed())
+			return;
+
+		//Find the dedicated reset pin
+		Greenpak4IOB* reset_iob = NULL;
+		switch(device->GetPart())
+		{
+			case Greenpak4Device::GREENPAK4_SLG46620:
+			case Greenpak4Device::GREENPAK4_SLG46621:
+				reset_iob = device->GetIOB(8);
+				break;
+
+			case Greenpak4Device::GREENPAK4_SLG46140:
+				reset_iob = device->GetIOB(13);
+				break;
+
+			default:
+				report.Error("", "unrecognized device, cannot DRC POR routing");
+		}
+
+		//Look for IOBs driven by the POR
+		for(auto n : index.GetLoads(por))
+		{
+			if(dynamic_cast<Greenpak4IOB*>(n) == NULL)
+				continue;
+
+			if(n != reset_iob)
+			{
+				report.Warning(n->GetDescription(),
+					"Pin %s is driven by the power-on reset, but does not have dedicated reset routing available.\n"
+					"This may lead to synchronization issues or glitches if this pin is used to drive resets on "
+					"external logic.",
+					n->GetDescription().c_str());
+			}
+		}
+	}
+};
+
+/**
+	@brief Charge pump must be ENABLED for brownout detector to work
+ */
+class Greenpak4PowerDetectorRule : public Greenpak4DRCRule
+{
+public:
+	virtual const char* GetName() const
+	{ return "pwrdet-charge-pump"; }
+
+	virtual void Check(const Greenpak4DRCIndex& index, Greenpak4DRCReport& report) const
+	{
+		auto device = index.GetDevice();
+		auto pwrdet = device->GetPowerDetector();
+		if(pwrdet && pwrdet->IsUsed() && device->IsChargePumpDisabled())
+		{
+			report.Error(pwrdet->GetDescription(),
+				"The power detector is being used, but the charge pump is disabled.\n"
+				"Enable the charge pump to use the power detector.");
+		}
+	}
+};
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// The DRC engine
+
+/**
+	@brief Creates a DRC engine with all of the built-in rules
+ */
+Greenpak4DRC::Greenpak4DRC()
+{
+	AddRule(new Greenpak4UnplacedNodeRule);
+	AddRule(new Greenpak4NoLoadRule);
+	AddRule(new Greenpak4UnlockedIOBRule);
+	AddRule(new Greenpak4AnalogPinDriveRule);
+	AddRule(new Greenpak4AnalogIbufRule);
+	AddRule(new Greenpak4SharedAcmpMuxRule);
+	AddRule(new Greenpak4OscillatorPowerDownRule);
+	AddRule(new Greenpak4DACConflictRule);
+	AddRule(new Greenpak4PORRoutingRule);
+	AddRule(new Greenpak4PowerDetectorRule);
+}
+
+Greenpak4DRC::~Greenpak4DRC()
+{
+	for(auto r : m_rules)
+		delete r;
+	m_rules.clear();
+}
+
+/**
+	@brief Adds a rule (the engine takes ownership of it)
+ */
+void Greenpak4DRC::AddRule(Greenpak4DRCRule* rule)
+{
+	m_rules.push_back(rule);
+}
+
+/**
+	@brief Checks a design against every rule, using up to the given number of threads.
+
+	Violations are added to the report grouped by rule, in the order the rules were added, regardless of which
+	thread ran what.
+ */
+void Greenpak4DRC::Run(const Greenpak4DRCIndex& index, Greenpak4DRCReport& report, unsigned int jobs) const
+{
+	vector<Greenpak4DRCReport> results;
+	for(auto r : m_rules)
+		results.push_back(Greenpak4DRCReport(r->GetName()));
+
+	atomic<unsigned int> next_rule(0);
+	auto worker = [&]()
+	{
+		while(true)
+		{
+			unsigned int i = next_rule ++;
+			if(i >= m_rules.size())
+				break;
+			m_rules[i]->Check(index, results[i]);
+		}
+	};
+
+	if(jobs > m_rules.size())
+		jobs = m_rules.size();
+	if(jobs <= 1)
+		worker();
+	else
+	{
+		vector<thread> threads;
+		for(unsigned int i=0; i<jobs; i++)
+			threads.push_back(thread(worker));
+		for(auto& t : threads)
+			t.join();
+	}
+
+	for(auto& r : results)
+		report.Append(r);
+}
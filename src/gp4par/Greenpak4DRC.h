@@ -0,0 +1,215 @@
+/***********************************************************************************************************************
+ * Copyright (C) 2016 Andrew Zonenberg and contributors                                                                *
+ *                                                                                                                     *
+ * This program is free software; you can redistribute it and/or modify it under the terms of the GNU Lesser General   *
+ * Public License as published by the Free Software Foundation; either version 2.1 of the License, or (at your option) *
+ * any later version.                                                                                                  *
+ *                                                                                                                     *
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied  *
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for     *
+ * more details.                                                                                                       *
+ *                                                                                                                     *
+ * You should have received a copy of the GNU Lesser General Public License along with this program; if not, you may   *
+ * find one here:                                                                                                      *
+ * https://www.gnu.org/licenses/old-licenses/lgpl-2.1.txt                                                              *
+ * or you may search the http://www.gnu.org website for the version 2.1 license, or you may write to the Free Software *
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA                                      *
+ **********************************************************************************************************************/
+
+#ifndef Greenpak4DRC_h
+#define Greenpak4DRC_h
+
+#include <vector>
+
+/**
+	@brief A single design rule violation
+ */
+class Greenpak4DRCViolation
+{
+public:
+	enum Severity
+	{
+		SEVERITY_WARNING,
+		SEVERITY_ERROR
+	};
+
+	Greenpak4DRCViolation(Severity severity, std::string rule, std::string object, std::string message)
+		: m_severity(severity)
+		, m_rule(rule)
+		, m_object(object)
+		, m_message(message)
+	{}
+
+	Severity m_severity;
+
+	//Name of the rule that found the problem
+	std::string m_rule;
+
+	//The netlist cell or device site the problem is about (may be empty if it's a whole-design problem)
+	std::string m_object;
+
+	//Human readable description (no trailing newline, may span several lines)
+	std::string m_message;
+
+	//Extra lines of detail (for example, everything involved in a conflict)
+	std::vector<std::string> m_details;
+};
+
+/**
+	@brief The results of running some or all of the DRC rules
+ */
+class Greenpak4DRCReport
+{
+public:
+	Greenpak4DRCReport(std::string rule = "")
+		: m_rule(rule)
+		, m_errorCount(0)
+		, m_warningCount(0)
+	{}
+
+	Greenpak4DRCViolation& Error(std::string object, const char* format, ...)
+		__attribute__((format(printf, 3, 4)));
+	Greenpak4DRCViolation& Warning(std::string object, const char* format, ...)
+		__attribute__((format(printf, 3, 4)));
+
+	void Append(const Greenpak4DRCReport& report);
+
+	void Print() const;
+	bool WriteJSON(std::string fname) const;
+
+	const std::vector<Greenpak4DRCViolation>& GetViolations() const
+	{ return m_violations; }
+
+	unsigned int GetErrorCount() const
+	{ return m_errorCount; }
+
+	unsigned int GetWarningCount() const
+	{ return m_warningCount; }
+
+protected:
+	Greenpak4DRCViolation& Add(Greenpak4DRCViolation::Severity severity, std::string object, std::string message);
+
+	//Rule new violations are reported against
+	std::string m_rule;
+
+	std::vector<Greenpak4DRCViolation> m_violations;
+	unsigned int m_errorCount;
+	unsigned int m_warningCount;
+};
+
+/**
+	@brief Everything the DRC rules need to know about the routed design, gathered in one pass over the netlist
+	graph and device so that each rule only has to look at the handful of nodes or sites it actually cares about.
+
+	Read-only once built, so all of the rules can share it while running in parallel.
+ */
+class Greenpak4DRCIndex
+{
+public:
+	Greenpak4DRCIndex(PARGraph* netlist, PARGraph* dgraph, Greenpak4Device* device);
+
+	/**
+		@brief A netlist node and where it ended up
+	 */
+	class Node
+	{
+	public:
+		PARGraphNode* m_node;
+
+		Greenpak4NetlistEntity* m_entity;
+
+		//Same as m_entity, or NULL if the node isn't a cell (e.g. a power rail)
+		Greenpak4NetlistCell* m_cell;
+
+		//The site the node was placed at, or NULL if it wasn't placed
+		Greenpak4BitstreamEntity* m_site;
+	};
+
+	Greenpak4Device* GetDevice() const
+	{ return m_device; }
+
+	/**
+		@brief Returns every netlist node, indexed like the netlist graph
+	 */
+	const std::vector<Node>& GetNodes() const
+	{ return m_nodes; }
+
+	/**
+		@brief Returns the netlist nodes that aren't mapped to any site
+	 */
+	const std::vector<const Node*>& GetUnplacedNodes() const
+	{ return m_unplaced; }
+
+	/**
+		@brief Returns the IOBs the netlist uses, along with the cell placed at each
+	 */
+	const std::vector< std::pair<Greenpak4IOB*, Greenpak4NetlistCell*> >& GetUsedIOBs() const
+	{ return m_usedIOBs; }
+
+	/**
+		@brief Returns the (real) device entities driven by a site, one per netlist edge
+	 */
+	const std::vector<Greenpak4BitstreamEntity*>& GetLoads(Greenpak4BitstreamEntity* site) const
+	{ return m_loads[site->GetPARNode()->GetIndex()]; }
+
+	typedef std::pair<std::string, Greenpak4EntityOutput> MuxRequest;
+
+	/**
+		@brief Returns the comparators using ACMP0's shared input mux, and the input each one wants
+	 */
+	const std::vector<MuxRequest>& GetSharedMuxRequests() const
+	{ return m_sharedMuxRequests; }
+
+protected:
+	Greenpak4Device* m_device;
+
+	std::vector<Node> m_nodes;
+	std::vector<const Node*> m_unplaced;
+	std::vector< std::pair<Greenpak4IOB*, Greenpak4NetlistCell*> > m_usedIOBs;
+
+	//Loads of each site, indexed by device node index
+	std::vector< std::vector<Greenpak4BitstreamEntity*> > m_loads;
+
+	std::vector<MuxRequest> m_sharedMuxRequests;
+};
+
+/**
+	@brief A single design rule
+ */
+class Greenpak4DRCRule
+{
+public:
+	virtual ~Greenpak4DRCRule();
+
+	/**
+		@brief Short name of the rule, used to tag its violations in reports
+	 */
+	virtual const char* GetName() const =0;
+
+	/**
+		@brief Checks the design against this rule.
+
+		Called from a worker thread, so this must not modify the design or log anything, only add to the report.
+	 */
+	virtual void Check(const Greenpak4DRCIndex& index, Greenpak4DRCReport& report) const =0;
+};
+
+/**
+	@brief Runs a set of design rules against a routed design
+ */
+class Greenpak4DRC
+{
+public:
+	Greenpak4DRC();
+	virtual ~Greenpak4DRC();
+
+	void AddRule(Greenpak4DRCRule* rule);
+
+	void Run(const Greenpak4DRCIndex& index, Greenpak4DRCReport& report, unsigned int jobs) const;
+
+protected:
+	//The rules, in the order their violations are reported
+	std::vector<Greenpak4DRCRule*> m_rules;
+};
+
+#endif
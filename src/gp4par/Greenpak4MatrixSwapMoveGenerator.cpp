@@ -0,0 +1,139 @@
+/***********************************************************************************************************************
+ * Copyright (C) 2016 Andrew Zonenberg and contributors                                                                *
+ *                                                                                                                     *
+ * This program is free software; you can redistribute it and/or modify it under the terms of the GNU Lesser General   *
+ * Public License as published by the Free Software Foundation; either version 2.1 of the License, or (at your option) *
+ * any later version.                                                                                                  *
+ *                                                                                                                     *
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied  *
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for     *
+ * more details.                                                                                                       *
+ *                                                                                                                     *
+ * You should have received a copy of the GNU Lesser General Public License along with this program; if not, you may   *
+ * find one here:                                                                                                      *
+ * https://www.gnu.org/licenses/old-licenses/lgpl-2.1.txt                                                              *
+ * or you may search the http://www.gnu.org website for the version 2.1 license, or you may write to the Free Software *
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA                                      *
+ **********************************************************************************************************************/
+
+#include "gp4par.h"
+
+using namespace std;
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Construction / destruction
+
+Greenpak4MatrixSwapMoveGenerator::Greenpak4MatrixSwapMoveGenerator(uint32_t samples)
+	: PARMoveGenerator("matrix swap")
+	, m_samples(samples)
+{
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Move generation
+
+bool Greenpak4MatrixSwapMoveGenerator::ProposeMove(
+	PAREngine* engine,
+	vector<PARGraphNode*>& badnodes,
+	const PARLabelRegistry& labels,
+	PARMove& move)
+{
+	PARGraphNode* node;
+	PARGraphNode* site;
+	if(!ProposeStep(engine, badnodes, node, site))
+		return false;
+	return static_cast<Greenpak4PAREngine*>(engine)->TryMoveStep(move, node, site, labels);
+}
+
+bool Greenpak4MatrixSwapMoveGenerator::ProposeStep(
+	PAREngine* engine,
+	vector<PARGraphNode*>& badnodes,
+	PARGraphNode*& node,
+	PARGraphNode*& site)
+{
+	//We're only ever registered by Greenpak4PAREngine
+	auto gp = static_cast<Greenpak4PAREngine*>(engine);
+	if(gp->m_matrixCount < 2)
+		return false;
+
+	PARGraphNode* pivot = badnodes[gp->m_random.NextBelow(badnodes.size())];
+	PARGraphNode* here = pivot->GetMate();
+	uint32_t matrix = gp->GetSiteMatrix(here);
+
+	//Pick another matrix to swap into
+	if(gp->m_siteBuckets.empty())
+		gp->BuildSiteBuckets();
+	uint32_t other = (matrix + 1 + gp->m_random.NextBelow(gp->m_matrixCount - 1)) % gp->m_matrixCount;
+	auto& bucket = gp->m_siteBuckets[other][pivot->GetLabel()];
+	if(bucket.empty())
+		return false;
+
+	//Find the partner which needs the fewest extra cross connections in our old site.
+	//Empty sites are as good as it gets (nothing else moves).
+	PARGraphNode* best = NULL;
+	int32_t best_change = 0;
+	for(uint32_t i=0; i<m_samples; i++)
+	{
+		PARGraphNode* candidate = bucket[gp->m_random.NextBelow(bucket.size())];
+		PARGraphNode* partner = candidate->GetMate();
+		if(partner == pivot)
+			continue;
+
+		int32_t change = 0;
+		if(partner != NULL)
+		{
+			if(!gp->CanMoveNode(pivot, here, candidate))
+				continue;
+			change = GetCrossingChange(gp, partner, here, pivot);
+		}
+
+		if( (best == NULL) || (change < best_change) )
+		{
+			best = candidate;
+			best_change = change;
+		}
+	}
+	node = pivot;
+	site = best;
+	return (best != NULL);
+}
+
+/**
+	@brief Counts how many more of a node's routes would need cross connections if it moved to a given site.
+
+	Edges to the ignored node (the one we're swapping with, which is about to move too) aren't counted.
+ */
+int32_t Greenpak4MatrixSwapMoveGenerator::GetCrossingChange(
+	Greenpak4PAREngine* engine,
+	PARGraphNode* node,
+	PARGraphNode* site,
+	PARGraphNode* ignore)
+{
+	const Greenpak4SiteTable* sites = engine->m_sites;
+	uint32_t here = node->GetMate()->GetIndex();
+	uint32_t there = site->GetIndex();
+
+	int32_t change = 0;
+	for(auto i : engine->m_nodeEdges[node->GetIndex()])
+	{
+		PARGraphEdge* edge = engine->m_netlistEdges[i];
+		bool outgoing = (edge->m_sourcenode == node);
+		PARGraphNode* other = outgoing ? edge->m_destnode : edge->m_sourcenode;
+		if( (other == ignore) || (other->GetMate() == NULL) )
+			continue;
+
+		uint32_t elsewhere = other->GetMate()->GetIndex();
+		uint16_t port = edge->m_destport;
+		if(outgoing)
+		{
+			change += sites->NeedsCrossConnection(there, elsewhere, port);
+			change -= sites->NeedsCrossConnection(here, elsewhere, port);
+		}
+		else
+		{
+			change += sites->NeedsCrossConnection(elsewhere, there, port);
+			change -= sites->NeedsCrossConnection(elsewhere, here, port);
+		}
+	}
+	return change;
+}
@@ -0,0 +1,66 @@
+/***********************************************************************************************************************
+ * Copyright (C) 2016 Andrew Zonenberg and contributors                                                                *
+ *                                                                                                                     *
+ * This program is free software; you can redistribute it and/or modify it under the terms of the GNU Lesser General   *
+ * Public License as published by the Free Software Foundation; either version 2.1 of the License, or (at your option) *
+ * any later version.                                                                                                  *
+ *                                                                                                                     *
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied  *
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for     *
+ * more details.                                                                                                       *
+ *                                                                                                                     *
+ * You should have received a copy of the GNU Lesser General Public License along with this program; if not, you may   *
+ * find one here:                                                                                                      *
+ * https://www.gnu.org/licenses/old-licenses/lgpl-2.1.txt                                                              *
+ * or you may search the http://www.gnu.org website for the version 2.1 license, or you may write to the Free Software *
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA                                      *
+ **********************************************************************************************************************/
+
+#ifndef Greenpak4MatrixSwapMoveGenerator_h
+#define Greenpak4MatrixSwapMoveGenerator_h
+
+class Greenpak4PAREngine;
+
+/**
+	@brief Swaps a bad node with a node of the same type in another matrix, choosing the partner which minds the move
+	least.
+
+	A node whose neighbors are dual-capable (outputs available in both matrices), or only use dedicated routing,
+	doesn't need any extra cross connections in either matrix, so swapping it with a node which does is nearly free.
+	We sample a few candidate partners and pick the one whose own routes need the fewest extra cross connections after
+	the swap.
+ */
+class Greenpak4MatrixSwapMoveGenerator : public PARMoveGenerator
+{
+public:
+	Greenpak4MatrixSwapMoveGenerator(uint32_t samples = 8);
+
+	virtual bool ProposeMove(
+		PAREngine* engine,
+		std::vector<PARGraphNode*>& badnodes,
+		const PARLabelRegistry& labels,
+		PARMove& move);
+
+	virtual bool IsSingleStep()
+	{ return true; }
+
+	virtual bool ProposeStep(
+		PAREngine* engine,
+		std::vector<PARGraphNode*>& badnodes,
+		PARGraphNode*& node,
+		PARGraphNode*& site);
+
+protected:
+	int32_t GetCrossingChange(
+		Greenpak4PAREngine* engine,
+		PARGraphNode* node,
+		PARGraphNode* site,
+		PARGraphNode* ignore);
+
+	/**
+		@brief Number of candidate partners to look at
+	 */
+	uint32_t m_samples;
+};
+
+#endif
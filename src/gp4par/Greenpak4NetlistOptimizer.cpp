@@ -0,0 +1,776 @@
+/***********************************************************************************************************************
+ * Copyright (C) 2016 Andrew Zonenberg and contributors                                                                *
+ *                                                                                                                     *
+ * This program is free software; you can redistribute it and/or modify it under the terms of the GNU Lesser General   *
+ * Public License as published by the Free Software Foundation; either version 2.1 of the License, or (at your option) *
+ * any later version.                                                                                                  *
+ *                                                                                                                     *
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied  *
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for     *
+ * more details.                                                                                                       *
+ *                                                                                                                     *
+ * You should have received a copy of the GNU Lesser General Public License along with this program; if not, you may   *
+ * find one here:                                                                                                      *
+ * https://www.gnu.org/licenses/old-licenses/lgpl-2.1.txt                                                              *
+ * or you may search the http://www.gnu.org website for the version 2.1 license, or you may write to the Free Software *
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA                                      *
+ **********************************************************************************************************************/
+
+#include <algorithm>
+#include "gp4par.h"
+
+using namespace std;
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Construction / destruction
+
+Greenpak4NetlistOptimizer::Greenpak4NetlistOptimizer(Greenpak4Netlist* netlist, Greenpak4Device* device)
+	: m_netlist(netlist)
+	, m_module(netlist->GetTopModule())
+	, m_device(device)
+	, m_constantsFolded(0)
+	, m_inputsRemoved(0)
+	, m_invertersAbsorbed(0)
+	, m_cellsRemoved(0)
+	, m_flipflopsPacked(0)
+	, m_shiftRegistersInferred(0)
+{
+	m_vdd = m_module->GetNet("GP_VDD");
+	m_vss = m_module->GetNet("GP_VSS");
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Truth tables
+
+/**
+	@brief Returns true if the output of the LUT depends on input k
+ */
+bool Greenpak4NetlistOptimizer::LUT::DependsOn(unsigned int k) const
+{
+	uint32_t nbits = 1 << m_inputs.size();
+	for(uint32_t i=0; i<nbits; i++)
+	{
+		if(i & (1 << k))
+			continue;
+		bool a = (m_table >> i) & 1;
+		bool b = (m_table >> (i | (1 << k))) & 1;
+		if(a != b)
+			return true;
+	}
+	return false;
+}
+
+/**
+	@brief Ties input k to a constant value and removes it (inputs above it move down one)
+ */
+void Greenpak4NetlistOptimizer::LUT::FixInput(unsigned int k, bool value)
+{
+	uint32_t nbits = 1 << (m_inputs.size() - 1);
+	uint32_t table = 0;
+	for(uint32_t j=0; j<nbits; j++)
+	{
+		uint32_t low = j & ((1 << k) - 1);
+		uint32_t i = ((j >> k) << (k + 1)) | (value << k) | low;
+		if(m_table & (1 << i))
+			table |= (1 << j);
+	}
+
+	m_table = table;
+	m_inputs.erase(m_inputs.begin() + k);
+}
+
+/**
+	@brief Drops input k, which is driven by the same net as input j (j must be less than k)
+ */
+void Greenpak4NetlistOptimizer::LUT::MergeInputs(unsigned int j, unsigned int k)
+{
+	uint32_t nbits = 1 << (m_inputs.size() - 1);
+	uint32_t table = 0;
+	for(uint32_t x=0; x<nbits; x++)
+	{
+		uint32_t low = x & ((1 << k) - 1);
+		uint32_t value = (x >> j) & 1;
+		uint32_t i = ((x >> k) << (k + 1)) | (value << k) | low;
+		if(m_table & (1 << i))
+			table |= (1 << x);
+	}
+
+	m_table = table;
+	m_inputs.erase(m_inputs.begin() + k);
+}
+
+/**
+	@brief Changes the table so it gives the same output with input k inverted
+ */
+void Greenpak4NetlistOptimizer::LUT::InvertInput(unsigned int k)
+{
+	uint32_t nbits = 1 << m_inputs.size();
+	uint32_t table = 0;
+	for(uint32_t i=0; i<nbits; i++)
+	{
+		if(m_table & (1 << (i ^ (1 << k))))
+			table |= (1 << i);
+	}
+	m_table = table;
+}
+
+void Greenpak4NetlistOptimizer::LUT::InvertOutput()
+{
+	m_table = ~m_table & GetMask();
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Netlist queries
+
+/**
+	@brief Gets a copy of the top-level cell list (so we can change it while going over it)
+ */
+vector<Greenpak4NetlistCell*> Greenpak4NetlistOptimizer::GetCells()
+{
+	vector<Greenpak4NetlistCell*> cells;
+	for(auto it = m_module->cell_begin(); it != m_module->cell_end(); it ++)
+		cells.push_back(it->second);
+	return cells;
+}
+
+/**
+	@brief Figures out whether a cell port drives or is driven by the net it's on
+
+	@return False if we don't know (no module for the cell type, or it's an inout)
+ */
+bool Greenpak4NetlistOptimizer::IsOutput(const Greenpak4NetlistNodePoint& point, bool& output)
+{
+	Greenpak4NetlistModule* module = m_netlist->GetModule(point.m_cell->m_type);
+	if(module == NULL)
+		return false;
+	Greenpak4NetlistPort* port = module->GetPort(point.m_portname);
+	if(port == NULL)
+		return false;
+
+	if(port->m_direction == Greenpak4NetlistPort::DIR_INPUT)
+		output = false;
+	else if(port->m_direction == Greenpak4NetlistPort::DIR_OUTPUT)
+		output = true;
+	else
+		return false;
+	return true;
+}
+
+/**
+	@brief Finds all of the cell inputs a net drives
+
+	@return False if we can't safely change anything about the net (it's connected to a top-level port, or to
+	something we can't tell the direction of, or it or anything on it was changed this round)
+ */
+bool Greenpak4NetlistOptimizer::GetLoads(Greenpak4NetlistNode* net, vector<Greenpak4NetlistNodePoint>& loads)
+{
+	loads.clear();
+	if( (net == NULL) || !net->m_ports.empty() || (m_dirtyNets.find(net) != m_dirtyNets.end()) )
+		return false;
+
+	for(auto& p : net->m_nodeports)
+	{
+		bool output;
+		if( (m_dirtyCells.find(p.m_cell) != m_dirtyCells.end()) || !IsOutput(p, output) )
+			return false;
+		if(!output)
+			loads.push_back(p);
+	}
+	return true;
+}
+
+/**
+	@brief Finds the cell driving a net
+
+	@return The cell, or NULL if there isn't exactly one or we can't tell
+ */
+Greenpak4NetlistCell* Greenpak4NetlistOptimizer::GetDriver(Greenpak4NetlistNode* net)
+{
+	Greenpak4NetlistCell* driver = NULL;
+	for(auto& p : net->m_nodeports)
+	{
+		bool output;
+		if(!IsOutput(p, output))
+			return NULL;
+		if(!output)
+			continue;
+		if(driver != NULL)
+			return NULL;
+		driver = p.m_cell;
+	}
+	return driver;
+}
+
+bool Greenpak4NetlistOptimizer::IsLUT(Greenpak4NetlistCell* cell)
+{
+	return (cell->m_type == "GP_2LUT") || (cell->m_type == "GP_3LUT") || (cell->m_type == "GP_4LUT");
+}
+
+/**
+	@brief Returns true if we're allowed to change a cell this round
+ */
+bool Greenpak4NetlistOptimizer::CanModify(Greenpak4NetlistCell* cell)
+{
+	return !cell->HasAttribute("keep") && (m_dirtyCells.find(cell) == m_dirtyCells.end());
+}
+
+/**
+	@brief Returns true if a cell is a flipflop we could move into a shift register
+
+	It has to be a plain GP_DFF that starts at 0 (the shift register powers up cleared), with every pin connected.
+ */
+bool Greenpak4NetlistOptimizer::IsChainDFF(Greenpak4NetlistCell* cell)
+{
+	if( (cell->m_type != "GP_DFF") || !CanModify(cell) || cell->HasLOC() || cell->GetParameter(PARAM_INIT) )
+		return false;
+
+	static const char* ports[] = { "D", "CLK", "Q" };
+	for(auto port : ports)
+	{
+		auto it = cell->m_connections.find(port);
+		if( (it == cell->m_connections.end()) || (it->second.size() != 1) || (it->second[0] == NULL) )
+			return false;
+	}
+	return true;
+}
+
+/**
+	@brief Gets the inputs and truth table of a LUT or inverter
+
+	@return False if it isn't one, or isn't fully connected
+ */
+bool Greenpak4NetlistOptimizer::ReadLUT(Greenpak4NetlistCell* cell, LUT& lut)
+{
+	lut.m_inputs.clear();
+
+	vector<string> ports;
+	if(!cell->GetLogicFunction(ports, lut.m_table))
+		return false;
+
+	for(auto port : ports)
+	{
+		if(cell->m_connections.find(port) == cell->m_connections.end())
+			return false;
+		auto& net = cell->m_connections[port];
+		if( (net.size() != 1) || (net[0] == NULL) )
+			return false;
+		lut.m_inputs.push_back(net[0]);
+	}
+
+	auto it = cell->m_connections.find("OUT");
+	if( (it == cell->m_connections.end()) || (it->second.size() != 1) || (it->second[0] == NULL) )
+		return false;
+
+	return true;
+}
+
+/**
+	@brief Changes a cell to implement a LUT, picking the smallest cell type that fits
+
+	Must have at least one input. With only one, it has to be an inverter.
+
+	@return False (and the cell is left alone) if the netlist has no module for the new cell type, so PAR wouldn't
+	know its ports
+ */
+bool Greenpak4NetlistOptimizer::WriteLUT(Greenpak4NetlistCell* cell, const LUT& lut)
+{
+	char tmp[16];
+	if(lut.m_inputs.size() == 1)
+		snprintf(tmp, sizeof(tmp), "GP_INV");
+	else
+		snprintf(tmp, sizeof(tmp), "GP_%uLUT", static_cast<unsigned int>(lut.m_inputs.size()));
+	if(m_netlist->GetModule(tmp) == NULL)
+		return false;
+	cell->m_type = tmp;
+
+	cell->m_connections.erase("IN");
+	for(unsigned int k=0; k<4; k++)
+		cell->m_connections.erase("IN" + to_string(k));
+
+	if(lut.m_inputs.size() == 1)
+	{
+		cell->m_parameters.erase("INIT");
+		cell->m_connections["IN"].push_back(lut.m_inputs[0]);
+		cell->ParseParameters();
+		return true;
+	}
+
+	for(unsigned int k=0; k<lut.m_inputs.size(); k++)
+		cell->m_connections["IN" + to_string(k)].push_back(lut.m_inputs[k]);
+	snprintf(tmp, sizeof(tmp), "%u", lut.m_table);
+	cell->m_parameters["INIT"] = tmp;
+
+	//Can't fail, the table is masked to the new cell type's size
+	cell->ParseParameters();
+	return true;
+}
+
+/**
+	@brief Reconnects a set of cell inputs to a different net
+ */
+void Greenpak4NetlistOptimizer::MoveLoads(const vector<Greenpak4NetlistNodePoint>& loads, Greenpak4NetlistNode* net)
+{
+	for(auto& p : loads)
+	{
+		p.m_cell->m_connections[p.m_portname][p.m_nbit] = net;
+		m_dirtyCells.insert(p.m_cell);
+	}
+	m_dirtyNets.insert(net);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// The passes
+
+/**
+	@brief Runs all of the passes until the netlist stops changing, leaving it indexed
+ */
+void Greenpak4NetlistOptimizer::Optimize()
+{
+	LogNotice("\nOptimizing netlist...\n");
+	LogIndenter li;
+
+	size_t ncells = distance(m_module->cell_begin(), m_module->cell_end());
+	while(true)
+	{
+		m_dirtyCells.clear();
+		m_dirtyNets.clear();
+
+		bool changed = PropagateConstants();
+		if(AbsorbInverters())
+			changed = true;
+		if(changed)
+			m_netlist->Reindex(false);
+
+		if(RemoveDeadCells())
+			changed = true;
+
+		if(!changed)
+			break;
+	}
+
+	//Only worth doing once the logic is as small as it's going to get
+	if(InferShiftRegisters())
+		m_netlist->Reindex(false);
+
+	LogNotice("Folded %u constant LUT inputs, removed %u redundant LUT inputs, absorbed %u inverters, "
+		"removed %u unused cells\n",
+		m_constantsFolded, m_inputsRemoved, m_invertersAbsorbed, m_cellsRemoved);
+	LogNotice("Packed %u flipflops into %u shift registers\n", m_flipflopsPacked, m_shiftRegistersInferred);
+	LogNotice("%zu cells before optimizing, %zu after\n",
+		ncells, static_cast<size_t>(distance(m_module->cell_begin(), m_module->cell_end())));
+}
+
+/**
+	@brief Folds constant inputs into LUTs and inverters, and removes inputs that are duplicates or don't matter.
+
+	A LUT left with no inputs that matter is a constant, and one left with a single input is a buffer or inverter.
+	Loads of constants and buffers are moved to the power rail or buffer input, which leaves the cell unused.
+ */
+bool Greenpak4NetlistOptimizer::PropagateConstants()
+{
+	bool changed = false;
+
+	for(auto cell : GetCells())
+	{
+		LUT lut;
+		if(!CanModify(cell) || cell->HasLOC() || !ReadLUT(cell, lut))
+			continue;
+
+		//Fix the constant inputs
+		unsigned int nconst = 0;
+		for(int k=lut.m_inputs.size()-1; k>=0; k--)
+		{
+			if( (lut.m_inputs[k] == m_vdd) || (lut.m_inputs[k] == m_vss) )
+			{
+				lut.FixInput(k, lut.m_inputs[k] == m_vdd);
+				nconst ++;
+			}
+		}
+
+		//Any pin is as good as any other (they're all driven from the routing matrix), so a net on two pins only
+		//needs one of them, and pins the output doesn't depend on aren't needed at all. What's left is packed into
+		//the low pins, and the cell shrinks to fit.
+		unsigned int nredundant = 0;
+		for(int k=lut.m_inputs.size()-1; k>=0; k--)
+		{
+			for(int j=0; j<k; j++)
+			{
+				if(lut.m_inputs[j] == lut.m_inputs[k])
+				{
+					lut.MergeInputs(j, k);
+					nredundant ++;
+					break;
+				}
+			}
+		}
+		for(int k=lut.m_inputs.size()-1; k>=0; k--)
+		{
+			if(!lut.DependsOn(k))
+			{
+				lut.FixInput(k, false);
+				nredundant ++;
+			}
+		}
+
+		if( (nconst == 0) && (nredundant == 0) )
+			continue;
+
+		//Constant or buffer: hook the loads up to the source instead
+		Greenpak4NetlistNode* out = cell->m_connections["OUT"][0];
+		if( lut.m_inputs.empty() || ( (lut.m_inputs.size() == 1) && (lut.m_table == 2) ) )
+		{
+			Greenpak4NetlistNode* source;
+			if(lut.m_inputs.empty())
+				source = (lut.m_table & 1) ? m_vdd : m_vss;
+			else
+				source = lut.m_inputs[0];
+
+			vector<Greenpak4NetlistNodePoint> loads;
+			if(!GetLoads(out, loads))
+				continue;
+
+			LogVerbose("Cell %s is equivalent to %s, bypassing it\n", cell->m_name.c_str(), source->m_name.c_str());
+			MoveLoads(loads, source);
+		}
+
+		//Anything else becomes a smaller LUT or an inverter
+		else
+		{
+			if(!WriteLUT(cell, lut))
+				continue;
+			LogVerbose("Removed %u constant and %u redundant inputs from cell %s\n",
+				nconst, nredundant, cell->m_name.c_str());
+		}
+
+		m_dirtyCells.insert(cell);
+		m_dirtyNets.insert(out);
+		m_constantsFolded += nconst;
+		m_inputsRemoved += nredundant;
+		changed = true;
+	}
+
+	return changed;
+}
+
+/**
+	@brief Gets rid of inverters by merging them into LUTs
+
+	* An inverter driven by a LUT that drives nothing else is folded into that LUT
+	* LUT inputs driven by an inverter take the inverter's input instead, with the truth table changed to match
+	* The loads of an inverter driven by another inverter are moved to the first inverter's input
+
+	The inverters are left with no loads, and removed later.
+ */
+bool Greenpak4NetlistOptimizer::AbsorbInverters()
+{
+	bool changed = false;
+
+	for(auto cell : GetCells())
+	{
+		LUT inv;
+		if( (cell->m_type != "GP_INV") || !CanModify(cell) || !ReadLUT(cell, inv) )
+			continue;
+		Greenpak4NetlistNode* in = inv.m_inputs[0];
+		Greenpak4NetlistNode* out = cell->m_connections["OUT"][0];
+		if( (in == m_vdd) || (in == m_vss) || (in == out) || (m_dirtyNets.find(in) != m_dirtyNets.end()) )
+			continue;
+
+		vector<Greenpak4NetlistNodePoint> loads;
+		if(!GetLoads(out, loads))
+			continue;
+
+		//If we're the only load of a LUT, invert its output and take over our loads
+		vector<Greenpak4NetlistNodePoint> inLoads;
+		Greenpak4NetlistCell* driver = GetDriver(in);
+		LUT lut;
+		if( (driver != NULL) && IsLUT(driver) && CanModify(driver) && ReadLUT(driver, lut) &&
+			GetLoads(in, inLoads) && (inLoads.size() == 1) )
+		{
+			LogVerbose("Absorbing inverter %s into LUT %s\n", cell->m_name.c_str(), driver->m_name.c_str());
+			lut.InvertOutput();
+			WriteLUT(driver, lut);
+			MoveLoads(loads, in);
+
+			m_dirtyCells.insert(cell);
+			m_dirtyCells.insert(driver);
+			m_dirtyNets.insert(out);
+			m_invertersAbsorbed ++;
+			changed = true;
+			continue;
+		}
+
+		//Otherwise, push the inversion into whatever loads we can
+		bool absorbed = false;
+		for(auto& p : loads)
+		{
+			Greenpak4NetlistCell* load = p.m_cell;
+			if( (load == cell) || !CanModify(load) )
+				continue;
+
+			//LUT input: invert that input in the truth table
+			if(IsLUT(load) && ReadLUT(load, lut))
+			{
+				string port = p.m_portname;
+				if( (port.length() != 3) || (port.compare(0, 2, "IN") != 0) )
+					continue;
+				unsigned int k = port[2] - '0';
+				if(k >= lut.m_inputs.size())
+					continue;
+
+				LogVerbose("Absorbing inverter %s into LUT %s\n", cell->m_name.c_str(), load->m_name.c_str());
+				lut.InvertInput(k);
+				lut.m_inputs[k] = in;
+				WriteLUT(load, lut);
+				m_dirtyCells.insert(load);
+				absorbed = true;
+			}
+
+			//Second inverter: its loads get our input
+			else if( (load->m_type == "GP_INV") && !load->HasLOC() )
+			{
+				Greenpak4NetlistNode* out2 = load->m_connections["OUT"][0];
+				vector<Greenpak4NetlistNodePoint> loads2;
+				if( (out2 == in) || !GetLoads(out2, loads2) )
+					continue;
+
+				LogVerbose("Inverters %s and %s cancel out\n", cell->m_name.c_str(), load->m_name.c_str());
+				MoveLoads(loads2, in);
+				m_dirtyCells.insert(load);
+				m_dirtyNets.insert(out2);
+				absorbed = true;
+			}
+		}
+
+		if(absorbed)
+		{
+			m_dirtyCells.insert(cell);
+			m_dirtyNets.insert(in);
+			m_dirtyNets.insert(out);
+			m_invertersAbsorbed ++;
+			changed = true;
+		}
+	}
+
+	return changed;
+}
+
+/**
+	@brief Deletes logic cells (LUTs, inverters, flipflops and latches) with no loads, then reindexes
+
+	Needs up-to-date index data, so this runs on its own after the other passes.
+ */
+bool Greenpak4NetlistOptimizer::RemoveDeadCells()
+{
+	m_dirtyCells.clear();
+	m_dirtyNets.clear();
+
+	vector<Greenpak4NetlistCell*> dead;
+	for(auto cell : GetCells())
+	{
+		bool logic =
+			IsLUT(cell) ||
+			(cell->m_type == "GP_INV") ||
+			(cell->m_type.find("GP_DFF") == 0) ||
+			(cell->m_type.find("GP_DLATCH") == 0);
+		if(!logic || !CanModify(cell) || cell->HasLOC())
+			continue;
+
+		//Every output has to go nowhere
+		bool unused = true;
+		for(auto it : cell->m_connections)
+		{
+			for(unsigned int i=0; (i<it.second.size()) && unused; i++)
+			{
+				Greenpak4NetlistNodePoint point(cell, m_netlist->GetSymbols().Intern(it.first), i, false);
+				bool output;
+				if(!IsOutput(point, output))
+				{
+					unused = false;
+					break;
+				}
+				if(!output || (it.second[i] == NULL) )
+					continue;
+
+				vector<Greenpak4NetlistNodePoint> loads;
+				if(!GetLoads(it.second[i], loads) || !loads.empty())
+					unused = false;
+			}
+		}
+
+		if(unused)
+			dead.push_back(cell);
+	}
+
+	for(auto cell : dead)
+	{
+		LogVerbose("Removing unused cell %s\n", cell->m_name.c_str());
+		m_module->RemoveCell(cell);
+		m_cellsRemoved ++;
+	}
+
+	if(dead.empty())
+		return false;
+
+	m_netlist->Reindex(false);
+	return true;
+}
+
+/**
+	@brief Packs chains of flipflops into unused shift registers
+
+	A chain is a run of GP_DFFs on the same clock, each driven by the one before it, with nothing else on the nets in
+	between. It becomes a GP_SHREG with the chain's input on IN and the last flipflop's output on OUTB. One net partway
+	along may have other loads too, and is driven from OUTA. A GP_SHREG is 16 stages long, so longer chains are split.
+
+	Each packed chain frees that many flipflop sites (and the routing between them), but there are only a couple of
+	shift registers, so the longest chains go first. Chains of one flipflop are left alone since they'd free nothing
+	but a flipflop for a shift register.
+
+	Needs up-to-date index data, so this runs after the other passes, and the netlist has to be reindexed after.
+ */
+bool Greenpak4NetlistOptimizer::InferShiftRegisters()
+{
+	m_dirtyCells.clear();
+	m_dirtyNets.clear();
+
+	//See how many shift registers the design leaves free
+	vector<Greenpak4NetlistCell*> cells = GetCells();
+	unsigned int nfree = m_device->GetShiftRegisterCount();
+	for(auto cell : cells)
+	{
+		if( (cell->m_type == "GP_SHREG") && (nfree > 0) )
+			nfree --;
+	}
+	if(nfree == 0)
+		return false;
+
+	//Find the flipflop each one drives, if it's the only one on the same clock. Note which outputs have other loads.
+	map<Greenpak4NetlistCell*, Greenpak4NetlistCell*> next;
+	set<Greenpak4NetlistCell*> driven;
+	set<Greenpak4NetlistCell*> tapped;
+	for(auto cell : cells)
+	{
+		if(!IsChainDFF(cell))
+			continue;
+
+		vector<Greenpak4NetlistNodePoint> loads;
+		if(!GetLoads(cell->m_connections["Q"][0], loads))
+			continue;
+
+		Greenpak4NetlistCell* succ = NULL;
+		unsigned int nsucc = 0;
+		for(auto& p : loads)
+		{
+			if( (p.m_cell == cell) || (p.m_portname != "D") || !IsChainDFF(p.m_cell) )
+				continue;
+			if(p.m_cell->m_connections["CLK"][0] != cell->m_connections["CLK"][0])
+				continue;
+			succ = p.m_cell;
+			nsucc ++;
+		}
+		if(nsucc != 1)
+			continue;
+
+		next[cell] = succ;
+		driven.insert(succ);
+		if(loads.size() > 1)
+			tapped.insert(cell);
+	}
+
+	//Walk each chain from its start (rings of flipflops have no start, and are left alone)
+	vector<Greenpak4NetlistCell*> heads;
+	for(auto cell : cells)
+	{
+		if(IsChainDFF(cell) && (driven.find(cell) == driven.end()))
+			heads.push_back(cell);
+	}
+
+	vector< vector<Greenpak4NetlistCell*> > chains;
+	vector<int> taps;
+	for(size_t i=0; i<heads.size(); i++)
+	{
+		vector<Greenpak4NetlistCell*> chain;
+		int tap = -1;
+		Greenpak4NetlistCell* cell = heads[i];
+		while(true)
+		{
+			chain.push_back(cell);
+			auto it = next.find(cell);
+			if(it == next.end())
+				break;
+
+			//Out of stages, or a second net that has to be visible: end here and start a new chain after
+			if( (chain.size() == 16) || ( (tapped.find(cell) != tapped.end()) && (tap >= 0) ) )
+			{
+				heads.push_back(it->second);
+				break;
+			}
+			if(tapped.find(cell) != tapped.end())
+				tap = chain.size() - 1;
+			cell = it->second;
+		}
+
+		if(chain.size() < 2)
+			continue;
+		chains.push_back(chain);
+		taps.push_back(tap);
+	}
+	if(chains.empty())
+		return false;
+
+	vector<size_t> order;
+	for(size_t i=0; i<chains.size(); i++)
+		order.push_back(i);
+	stable_sort(order.begin(), order.end(),
+		[&chains](size_t a, size_t b) { return chains[a].size() > chains[b].size(); });
+	if(order.size() > nfree)
+		order.resize(nfree);
+
+	//The netlist only has modules for the cell types the design used
+	vector<string> inputs = { "nRST", "CLK", "IN" };
+	vector<string> outputs = { "OUTA", "OUTB" };
+	m_netlist->AddBlackbox("GP_SHREG", inputs, outputs);
+
+	for(auto i : order)
+	{
+		auto& chain = chains[i];
+		int tap = taps[i];
+
+		Greenpak4NetlistCell* shreg = new Greenpak4NetlistCell(m_module);
+		char tmp[128];
+		snprintf(tmp, sizeof(tmp), "$auto$Greenpak4NetlistOptimizer.cpp:%d:shreg$%u",
+			__LINE__,
+			m_shiftRegistersInferred + 1);
+		shreg->m_name = tmp;
+		shreg->m_type = "GP_SHREG";
+		shreg->m_connections["nRST"].push_back(m_vdd);
+		shreg->m_connections["CLK"].push_back(chain[0]->m_connections["CLK"][0]);
+		shreg->m_connections["IN"].push_back(chain[0]->m_connections["D"][0]);
+		shreg->m_connections["OUTB"].push_back(chain.back()->m_connections["Q"][0]);
+		snprintf(tmp, sizeof(tmp), "%zu", chain.size());
+		shreg->m_parameters["OUTB_TAP"] = tmp;
+		if(tap >= 0)
+		{
+			shreg->m_connections["OUTA"].push_back(chain[tap]->m_connections["Q"][0]);
+			snprintf(tmp, sizeof(tmp), "%d", tap + 1);
+			shreg->m_parameters["OUTA_TAP"] = tmp;
+		}
+
+		//Can't fail, the taps are in range by construction
+		shreg->ParseParameters();
+
+		LogVerbose("Packing %zu flipflops from %s to %s into shift register %s\n",
+			chain.size(), chain[0]->m_name.c_str(), chain.back()->m_name.c_str(), shreg->m_name.c_str());
+		m_module->AddCell(shreg);
+		for(auto cell : chain)
+		{
+			shreg->m_packedCells.push_back(pair<string, string>(cell->m_name, cell->m_type));
+			m_module->RemoveCell(cell);
+		}
+
+		m_flipflopsPacked += chain.size();
+		m_shiftRegistersInferred ++;
+	}
+
+	return true;
+}
@@ -0,0 +1,115 @@
+/***********************************************************************************************************************
+ * Copyright (C) 2016 Andrew Zonenberg and contributors                                                                *
+ *                                                                                                                     *
+ * This program is free software; you can redistribute it and/or modify it under the terms of the GNU Lesser General   *
+ * Public License as published by the Free Software Foundation; either version 2.1 of the License, or (at your option) *
+ * any later version.                                                                                                  *
+ *                                                                                                                     *
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied  *
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for     *
+ * more details.                                                                                                       *
+ *                                                                                                                     *
+ * You should have received a copy of the GNU Lesser General Public License along with this program; if not, you may   *
+ * find one here:                                                                                                      *
+ * https://www.gnu.org/licenses/old-licenses/lgpl-2.1.txt                                                              *
+ * or you may search the http://www.gnu.org website for the version 2.1 license, or you may write to the Free Software *
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA                                      *
+ **********************************************************************************************************************/
+
+#ifndef Greenpak4NetlistOptimizer_h
+#define Greenpak4NetlistOptimizer_h
+
+#include <set>
+#include <vector>
+
+/**
+	@brief Simplifies the top-level netlist before it's turned into PAR graphs
+
+	Three kinds of changes are made, over and over until nothing changes:
+	* LUT inputs driven by constants are folded into the truth table, so the LUT shrinks (or goes away entirely).
+	  So are inputs the output doesn't depend on, and pins driven by the same net as another pin.
+	* Inverters are absorbed into the LUTs they drive or are driven by, and pairs of inverters cancel out
+	* Logic cells whose outputs don't go anywhere are deleted
+
+	Once that's done, chains of flipflops are packed into shift registers the design isn't using (see
+	InferShiftRegisters()), which frees up flipflop sites.
+
+	Cells with a "keep" attribute are never touched. Cells with a LOC constraint may get a new truth table, but are
+	never deleted or changed to another type. Nets connected to top-level ports are left alone.
+ */
+class Greenpak4NetlistOptimizer
+{
+public:
+	Greenpak4NetlistOptimizer(Greenpak4Netlist* netlist, Greenpak4Device* device);
+
+	void Optimize();
+
+protected:
+
+	/**
+		@brief A LUT (or inverter) as a list of input nets and a truth table.
+
+		Bit i of the table is the output when each input k has the value of bit k of i (same as the INIT parameter).
+	 */
+	class LUT
+	{
+	public:
+		std::vector<Greenpak4NetlistNode*> m_inputs;
+		uint32_t m_table;
+
+		uint32_t GetMask() const
+		{ return (1 << (1 << m_inputs.size())) - 1; }
+
+		bool DependsOn(unsigned int k) const;
+		void FixInput(unsigned int k, bool value);
+		void MergeInputs(unsigned int j, unsigned int k);
+		void InvertInput(unsigned int k);
+		void InvertOutput();
+	};
+
+	//The passes (each returns true if it changed anything)
+	bool PropagateConstants();
+	bool AbsorbInverters();
+	bool RemoveDeadCells();
+	bool InferShiftRegisters();
+
+	//Netlist queries
+	std::vector<Greenpak4NetlistCell*> GetCells();
+	bool GetLoads(Greenpak4NetlistNode* net, std::vector<Greenpak4NetlistNodePoint>& loads);
+	Greenpak4NetlistCell* GetDriver(Greenpak4NetlistNode* net);
+	bool IsOutput(const Greenpak4NetlistNodePoint& point, bool& output);
+
+	static bool IsLUT(Greenpak4NetlistCell* cell);
+	bool CanModify(Greenpak4NetlistCell* cell);
+	bool IsChainDFF(Greenpak4NetlistCell* cell);
+
+	static bool ReadLUT(Greenpak4NetlistCell* cell, LUT& lut);
+	bool WriteLUT(Greenpak4NetlistCell* cell, const LUT& lut);
+
+	void MoveLoads(const std::vector<Greenpak4NetlistNodePoint>& loads, Greenpak4NetlistNode* net);
+
+	Greenpak4Netlist* m_netlist;
+	Greenpak4NetlistModule* m_module;
+
+	//The device we're placing for (to see how much hard IP is free)
+	Greenpak4Device* m_device;
+
+	//Constant nets
+	Greenpak4NetlistNode* m_vdd;
+	Greenpak4NetlistNode* m_vss;
+
+	//Cells and nets changed since the last reindex. The index data for them is stale, so we leave them alone until
+	//the next round.
+	std::set<Greenpak4NetlistCell*> m_dirtyCells;
+	std::set<Greenpak4NetlistNode*> m_dirtyNets;
+
+	//Statistics
+	unsigned int m_constantsFolded;
+	unsigned int m_inputsRemoved;
+	unsigned int m_invertersAbsorbed;
+	unsigned int m_cellsRemoved;
+	unsigned int m_flipflopsPacked;
+	unsigned int m_shiftRegistersInferred;
+};
+
+#endif
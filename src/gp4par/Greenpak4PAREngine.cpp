@@ -16,7 +16,11 @@
  * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA                                      *
  **********************************************************************************************************************/
 
+#include <algorithm>
+#include <cstdint>
 #include <cmath>
+#include <deque>
+#include <functional>
 #include "gp4par.h"
 
 using namespace std;
@@ -24,11 +28,33 @@ using namespace std;
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 // Construction / destruction
 
-Greenpak4PAREngine::Greenpak4PAREngine(PARGraph* netlist, PARGraph* device, labelmap& lmap)
-	: PAREngine(netlist, device)
-	, m_lmap(lmap)
+Greenpak4PAREngine::Greenpak4PAREngine(
+	PARGraph* netlist,
+	PARGraph* device,
+	Greenpak4Device* pdev,
+	const Greenpak4SiteTable* sites,
+	const PARLabelRegistry* labels)
+	: PARModelEngine<Greenpak4PAREngine>(netlist, device)
+	, m_pdev(pdev)
+	, m_sites(sites)
+	, m_matrixCount(pdev->GetMatrixCount())
+	, m_congestionHistory(m_matrixCount * m_matrixCount, 0)
+	, m_previousPlacement(NULL)
+	, m_labels(labels)
 {
+	//Save the cross connection topology, since the congestion cost needs it all the time
+	for(uint32_t src=0; src<m_matrixCount; src++)
+	{
+		for(uint32_t dst=0; dst<m_matrixCount; dst++)
+			m_crossCapacity.push_back(pdev->GetCrossConnectionCount(src, dst));
+	}
 
+	//Moves between matrices only make sense if there's more than one
+	if(m_matrixCount > 1)
+	{
+		AddMoveGenerator(new PARClusterMoveGenerator);
+		AddMoveGenerator(new Greenpak4MatrixSwapMoveGenerator);
+	}
 }
 
 Greenpak4PAREngine::~Greenpak4PAREngine()
@@ -36,19 +62,191 @@ Greenpak4PAREngine::~Greenpak4PAREngine()
 
 }
 
+/**
+	@brief Creates an engine for the same device, with the same congestion history, working on a copy of our graphs
+ */
+PAREngine* Greenpak4PAREngine::CreateReplica(PARGraph* netlist, PARGraph* device)
+{
+	Greenpak4PAREngine* replica = new Greenpak4PAREngine(netlist, device, m_pdev, m_sites, m_labels);
+	replica->m_congestionHistory = m_congestionHistory;
+	return replica;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Feasibility checks
+
+/**
+	@brief Generic checks, plus a lower bound on the cross connections the design needs
+ */
+bool Greenpak4PAREngine::SanityCheck(const PARLabelRegistry& labels)
+{
+	if(!CheckMatrixConstraints())
+		return false;
+
+	if(!PAREngine::SanityCheck(labels))
+		return false;
+
+	LogIndenter li;
+	return CheckCrossConnectionBound();
+}
+
+/**
+	@brief Checks that every MATRIX constraint names a matrix of the device, and agrees with the cell's LOC
+	constraint if it has one too
+ */
+bool Greenpak4PAREngine::CheckMatrixConstraints()
+{
+	bool ok = true;
+	for(uint32_t i=0; i<m_netlist->GetNumNodes(); i++)
+	{
+		int32_t matrix = m_sites->GetMatrixConstraint(i);
+		if(matrix == Greenpak4SiteTable::ANY_MATRIX)
+			continue;
+
+		auto node = m_netlist->GetNodeByIndex(i);
+		auto cell = static_cast<Greenpak4NetlistCell*>(static_cast<Greenpak4NetlistEntity*>(node->GetData()));
+		if(matrix == Greenpak4SiteTable::BAD_MATRIX)
+		{
+			LogError("Cell %s has invalid MATRIX constraint %s (device has matrices 0 to %u)\n",
+				cell->m_name.c_str(), cell->m_attributes["MATRIX"].c_str(), m_matrixCount - 1);
+			ok = false;
+			continue;
+		}
+
+		auto pin = GetPinnedSite(node);
+		if( (pin != NULL) && (GetSiteMatrix(pin) != static_cast<uint32_t>(matrix)) )
+		{
+			LogError("Cell %s has MATRIX constraint %d, but its LOC constraint %s is in matrix %u\n",
+				cell->m_name.c_str(), matrix, cell->GetLOC().c_str(), GetSiteMatrix(pin));
+			ok = false;
+		}
+	}
+	return ok;
+}
+
+/**
+	@brief Counts the cross connections we'll need no matter how the design is placed, and fails if there are
+	too few in the device.
+
+	Only nodes whose matrix is already decided (by a LOC or MATRIX constraint, or by every legal site being in the
+	same matrix) are considered, so this is a lower bound.
+ */
+bool Greenpak4PAREngine::CheckCrossConnectionBound()
+{
+	const uint32_t NONE = 0xffffffff;
+	uint32_t nnodes = m_netlist->GetNumNodes();
+
+	//Figure out the matrix of every node we can, and pick one site to speak for its port types
+	vector<uint32_t> matrix(nnodes, NONE);
+	vector<Greenpak4BitstreamEntity*> site(nnodes, NULL);
+	vector<bool> has_dual(nnodes, false);
+	for(uint32_t i=0; i<nnodes; i++)
+	{
+		auto node = m_netlist->GetNodeByIndex(i);
+		auto pin = GetPinnedSite(node);
+		if(pin != NULL)
+		{
+			site[i] = static_cast<Greenpak4BitstreamEntity*>(pin->GetData());
+			matrix[i] = site[i]->GetMatrix();
+			has_dual[i] = (site[i]->GetDual() != NULL);
+			continue;
+		}
+
+		uint32_t label = node->GetLabel();
+		for(uint32_t j=0; j<m_device->GetNumNodesWithLabel(label); j++)
+		{
+			auto dsite = m_device->GetNodeByLabelAndIndex(label, j);
+			if(!IsSiteInNodeRegion(node, dsite))
+				continue;
+			auto entity = static_cast<Greenpak4BitstreamEntity*>(dsite->GetData());
+			if(entity->GetDual() != NULL)
+				has_dual[i] = true;
+
+			if(site[i] == NULL)
+			{
+				site[i] = entity;
+				matrix[i] = entity->GetMatrix();
+			}
+			else if(entity->GetMatrix() != matrix[i])
+				matrix[i] = NONE;
+		}
+	}
+
+	//Each signal crossing from one matrix to another uses one cross connection (see CommitRouting())
+	vector< set< pair<uint32_t, uint16_t> > > signals(m_matrixCount * m_matrixCount);
+	for(uint32_t i=0; i<nnodes; i++)
+	{
+		if( (matrix[i] == NONE) || has_dual[i] )
+			continue;
+
+		auto node = m_netlist->GetNodeByIndex(i);
+		for(uint32_t j=0; j<node->GetEdgeCount(); j++)
+		{
+			auto edge = node->GetEdgeByIndex(j);
+			uint32_t k = edge->m_destnode->GetIndex();
+			if( (matrix[k] == NONE) || (matrix[k] == matrix[i]) )
+				continue;
+			if(!site[k]->IsGeneralFabricInput(edge->m_destport))
+				continue;
+
+			signals[matrix[i]*m_matrixCount + matrix[k]].insert(pair<uint32_t, uint16_t>(i, edge->m_sourceport));
+		}
+	}
+
+	bool ok = true;
+	for(uint32_t i=0; i<signals.size(); i++)
+	{
+		if(signals[i].size() > m_crossCapacity[i])
+		{
+			LogError("Design needs at least %zu cross connections from matrix %u to %u, but the device only has %u\n",
+				signals[i].size(), i / m_matrixCount, i % m_matrixCount, m_crossCapacity[i]);
+			ok = false;
+		}
+	}
+	return ok;
+}
+
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 // Initial placement
 
-bool Greenpak4PAREngine::InitialPlacement_core()
+/**
+	@brief Looks up a device site by its name (as used in LOC constraints), or returns NULL if there's no such site.
+
+	Uses our own graph rather than the entities' PAR nodes, since we may be running on a copy of the graph.
+ */
+PARGraphNode* Greenpak4PAREngine::GetSiteByName(const string& name)
 {
-	//Make a map of all nodes to their names
-	map<string, Greenpak4BitstreamEntity*> nmap;
-	for(size_t i=0; i<m_device->GetNumNodes(); i++)
+	if(m_siteNames.empty())
 	{
-		auto entity = static_cast<Greenpak4BitstreamEntity*>(m_device->GetNodeByIndex(i)->GetData());
-		nmap[entity->GetDescription()] = entity;
+		for(size_t i=0; i<m_device->GetNumNodes(); i++)
+		{
+			auto node = m_device->GetNodeByIndex(i);
+			auto entity = static_cast<Greenpak4BitstreamEntity*>(node->GetData());
+			m_siteNames[entity->GetDescription()] = node;
+		}
 	}
 
+	auto it = m_siteNames.find(name);
+	if(it == m_siteNames.end())
+		return NULL;
+	return it->second;
+}
+
+/**
+	@brief Returns the site a netlist node is LOC'd to, if any.
+
+	Invalid LOC constraints are ignored here, InitialPlacement_core() reports them.
+ */
+PARGraphNode* Greenpak4PAREngine::GetPinnedSite(PARGraphNode* node)
+{
+	auto cell = dynamic_cast<Greenpak4NetlistCell*>(static_cast<Greenpak4NetlistEntity*>(node->GetData()));
+	if( (cell == NULL) || !cell->HasLOC() )
+		return NULL;
+	return GetSiteByName(cell->GetLOC());
+}
+
+bool Greenpak4PAREngine::InitialPlacement_core()
+{
 	//Go over the netlist nodes, see if any have LOC constraints.
 	//If so, place those at the constrained locations
 	for(size_t i=0; i<m_netlist->GetNumNodes(); i++)
@@ -68,7 +266,8 @@ bool Greenpak4PAREngine::InitialPlacement_core()
 		string loc = cell->GetLOC();
 
 		//Verify that the constrained location exists
-		if(nmap.find(loc) == nmap.end())
+		auto spnode = GetSiteByName(loc);
+		if(spnode == NULL)
 		{
 			LogError("Cell %s has invalid LOC constraint %s (no matching site in device)\n",
 				cell->m_name.c_str(), loc.c_str());
@@ -76,16 +275,14 @@ bool Greenpak4PAREngine::InitialPlacement_core()
 		}
 
 		//If it exists, is it a legal site?
-		auto site = nmap[loc];
-		auto spnode = site->GetPARNode();
 		if(!spnode->MatchesLabel(node->GetLabel()))
 		{
 			LogError(
 				"Cell %s has invalid LOC constraint %s (site is of type %s, instance is of type %s)\n",
 				cell->m_name.c_str(),
 				loc.c_str(),
-				m_lmap[site->GetPARNode()->GetLabel()].c_str(),
-				m_lmap[node->GetLabel()].c_str()
+				m_labels->GetName(spnode->GetLabel()).c_str(),
+				m_labels->GetName(node->GetLabel()).c_str()
 				);
 			return false;
 		}
@@ -105,102 +302,743 @@ bool Greenpak4PAREngine::InitialPlacement_core()
 		node->MateWith(spnode);
 	}
 
-	//For each label, mate each node in the netlist with the first legal mate in the device.
-	//Simple and deterministic.
-	uint32_t nmax_net = m_netlist->GetMaxLabel();
-	for(uint32_t label = 0; label <= nmax_net; label ++)
+	//Put everything that hasn't changed since the previous run back where it was, and place the rest around it.
+	//If that leaves no room for the new cells, forget about the previous placement.
+	vector<uint32_t> preferred;
+	bool placed = false;
+	if(m_previousPlacement != NULL)
+	{
+		vector<PARGraphNode*> reused;
+		ApplyPreviousPlacement(reused);
+		ChoosePreferredMatrices(preferred);
+		AssignUnconstrainedPins(preferred, reused);
+		placed = MatchUnplacedNodes(preferred, true);
+		if(!placed)
+		{
+			LogNotice("Previous placement leaves no room for the changed cells, placing everything from scratch\n");
+			for(auto node : reused)
+				node->MateWith(NULL);
+		}
+	}
+
+	//Decide which matrix each remaining node would like to be in, pick pins for the top-level ports to suit that,
+	//then find a legal site for everything else
+	if(!placed)
 	{
-		uint32_t nnet = m_netlist->GetNumNodesWithLabel(label);
-		uint32_t nsites = m_device->GetNumNodesWithLabel(label);
+		vector<PARGraphNode*> pins;
+		ChoosePreferredMatrices(preferred);
+		AssignUnconstrainedPins(preferred, pins);
+		if(!MatchUnplacedNodes(preferred))
+			return false;
+	}
 
-		uint32_t nsite = 0;
-		for(uint32_t net = 0; net<nnet; net++)
+	//Report how good a starting point we have
+	uint32_t crossings = 0;
+	for(size_t i=0; i<m_netlist->GetNumNodes(); i++)
+	{
+		auto node = m_netlist->GetNodeByIndex(i);
+		auto src = static_cast<Greenpak4BitstreamEntity*>(node->GetMate()->GetData());
+		for(uint32_t j=0; j<node->GetEdgeCount(); j++)
 		{
-			PARGraphNode* netnode = m_netlist->GetNodeByLabelAndIndex(label, net);
+			auto edge = node->GetEdgeByIndex(j);
+			if(edge->m_free)
+				continue;
+			auto dst = static_cast<Greenpak4BitstreamEntity*>(edge->m_destnode->GetMate()->GetData());
+			if(src->GetMatrix() != dst->GetMatrix())
+				crossings ++;
+		}
+	}
+	LogVerbose("Initial placement has %u cross-matrix nets\n", crossings);
+
+	return true;
+}
+
+/**
+	@brief Places each cell which is unconstrained and hasn't changed type since the previous run at its old site,
+	if that site is still free.
 
-			//If the netlist node is already constrained, don't auto-place it
-			if(netnode->GetMate() != NULL)
+	@param reused	Filled with the netlist nodes we placed
+ */
+void Greenpak4PAREngine::ApplyPreviousPlacement(vector<PARGraphNode*>& reused)
+{
+	uint32_t unconstrained = 0;
+	for(size_t i=0; i<m_netlist->GetNumNodes(); i++)
+	{
+		auto node = m_netlist->GetNodeByIndex(i);
+		if(node->GetMate() != NULL)
+			continue;
+		unconstrained ++;
+
+		//New cells, and ones that were replaced by something else with the same name, get placed from scratch
+		auto cell = static_cast<Greenpak4NetlistCell*>(static_cast<Greenpak4NetlistEntity*>(node->GetData()));
+		auto it = m_previousPlacement->find(cell->m_name);
+		if( (it == m_previousPlacement->end()) || (it->second.second != cell->m_type) )
+			continue;
+
+		//The site may not exist (different part), may have been taken by a new LOC constraint, or may be outside a
+		//new MATRIX constraint
+		auto site = GetSiteByName(it->second.first);
+		if( (site == NULL) || !site->MatchesLabel(node->GetLabel()) || (site->GetMate() != NULL) )
+			continue;
+		if(!IsSiteInNodeRegion(node, site))
+			continue;
+
+		node->MateWith(site);
+		reused.push_back(node);
+	}
+
+	LogNotice("Reusing previous placement of %zu out of %u unconstrained cells\n", reused.size(), unconstrained);
+}
+
+/**
+	@brief Picks a matrix for each unplaced netlist node, trying to keep connected nodes in the same matrix.
+
+	Greedy: nodes are visited in breadth-first order from the most connected ones, and each goes in whichever matrix
+	most of its already-decided neighbors are in, as long as that matrix still has room for another node of its type.
+	This is only a hint for MatchUnplacedNodes(), so it doesn't need to be exact.
+
+	With --multilevel, PARMultilevelPlacer decides instead (clustering before it partitions, rather than one node at
+	a time).
+
+	@param preferred	Filled with the preferred matrix of each netlist node, by node index
+ */
+void Greenpak4PAREngine::ChoosePreferredMatrices(vector<uint32_t>& preferred)
+{
+	if(m_multilevel)
+	{
+		PARMultilevelPlacer placer(this);
+		placer.AssignRegions(preferred);
+		LogVerbose("Multi-level placement: %u levels, %u nets between matrices\n",
+			placer.GetLevelCount(), placer.GetCutNets());
+		return;
+	}
+
+	uint32_t nnodes = m_netlist->GetNumNodes();
+
+	//Undirected adjacency lists, and the matrix of everything that's already placed (LOC constraints) or can only go
+	//in one matrix (MATRIX constraints)
+	vector< vector<uint32_t> > neighbors(nnodes);
+	for(uint32_t i=0; i<nnodes; i++)
+	{
+		auto node = m_netlist->GetNodeByIndex(i);
+		for(uint32_t j=0; j<node->GetEdgeCount(); j++)
+		{
+			auto edge = node->GetEdgeByIndex(j);
+			uint32_t k = edge->m_destnode->GetIndex();
+			if( (k == i) || edge->m_free )
 				continue;
+			neighbors[i].push_back(k);
+			neighbors[k].push_back(i);
+		}
+	}
+	const uint32_t UNDECIDED = 0xffffffff;
+	preferred.assign(nnodes, UNDECIDED);
+	for(uint32_t i=0; i<nnodes; i++)
+	{
+		auto node = m_netlist->GetNodeByIndex(i);
+		auto mate = node->GetMate();
+		if(mate != NULL)
+			preferred[i] = static_cast<Greenpak4BitstreamEntity*>(mate->GetData())->GetMatrix();
+		else if(GetNodeRegion(node) != ANY_REGION)
+			preferred[i] = GetNodeRegion(node);
+	}
+
+	//Count the free sites for each label in each matrix
+	uint32_t nlabels = m_netlist->GetMaxLabel() + 1;
+	vector< vector<uint32_t> > capacity(m_matrixCount, vector<uint32_t>(nlabels, 0));
+	for(uint32_t label=0; label<nlabels; label++)
+	{
+		for(uint32_t i=0; i<m_device->GetNumNodesWithLabel(label); i++)
+		{
+			auto site = m_device->GetNodeByLabelAndIndex(label, i);
+			if(site->GetMate() == NULL)
+				capacity[static_cast<Greenpak4BitstreamEntity*>(site->GetData())->GetMatrix()][label] ++;
+		}
+	}
+	for(uint32_t i=0; i<nnodes; i++)
+	{
+		auto node = m_netlist->GetNodeByIndex(i);
+		uint32_t label = node->GetLabel();
+		if( (node->GetMate() == NULL) && (preferred[i] != UNDECIDED) && (capacity[preferred[i]][label] > 0) )
+			capacity[preferred[i]][label] --;
+	}
+
+	//Visit the most connected nodes first, pulling in their neighbors breadth-first
+	vector<uint32_t> order(nnodes);
+	for(uint32_t i=0; i<nnodes; i++)
+		order[i] = i;
+	stable_sort(order.begin(), order.end(),
+		[&](uint32_t a, uint32_t b) { return neighbors[a].size() > neighbors[b].size(); });
+
+	vector<bool> queued(nnodes, false);
+	vector<uint32_t> votes(m_matrixCount);
+	for(auto root : order)
+	{
+		if(queued[root])
+			continue;
 
-			//Try to find a legal site
-			bool found = false;
-			while(nsite < nsites)
+		deque<uint32_t> queue;
+		queue.push_back(root);
+		queued[root] = true;
+		while(!queue.empty())
+		{
+			uint32_t i = queue.front();
+			queue.pop_front();
+			for(auto k : neighbors[i])
 			{
-				PARGraphNode* devnode = m_device->GetNodeByLabelAndIndex(label, nsite);
-				nsite ++;
+				if(!queued[k])
+				{
+					queued[k] = true;
+					queue.push_back(k);
+				}
+			}
 
-				//If the site is used, we don't want to disturb what's already there
-				//because it was probably LOC'd
-				if(devnode->GetMate() != NULL)
-					continue;
+			if(preferred[i] != UNDECIDED)
+				continue;
 
-				//Site is unused, mate with it
-				netnode->MateWith(devnode);
-				found = true;
-				break;
+			//Go with the majority of our neighbors, or failing that wherever there's more room
+			uint32_t label = m_netlist->GetNodeByIndex(i)->GetLabel();
+			votes.assign(m_matrixCount, 0);
+			for(auto k : neighbors[i])
+			{
+				if(preferred[k] != UNDECIDED)
+					votes[preferred[k]] ++;
+			}
+			uint32_t m = 0;
+			for(uint32_t j=1; j<m_matrixCount; j++)
+			{
+				if( (votes[j] > votes[m]) || ( (votes[j] == votes[m]) && (capacity[j][label] > capacity[m][label]) ) )
+					m = j;
 			}
 
-			//This can happen in rare cases
-			//(for example, we constrained all of the 8-bit counters to COUNT14 sites and now have a COUNT14).
-			if(!found)
+			//If that one is full, go wherever has the most room
+			if(capacity[m][label] == 0)
 			{
-				auto cell = static_cast<Greenpak4NetlistEntity*>(netnode->GetData());
-
-				LogError(
-					"Could not place netlist cell \"%s\" because we ran out of sites with type \"%s\"\n"
-					"       This can happen if you have overly restrictive LOC constraints.\n",
-					cell->m_name.c_str(),
-					m_lmap[label].c_str()
-					);
-				return false;
+				for(uint32_t j=0; j<m_matrixCount; j++)
+				{
+					if(capacity[j][label] > capacity[m][label])
+						m = j;
+				}
 			}
+
+			preferred[i] = m;
+			if(capacity[m][label] > 0)
+				capacity[m][label] --;
 		}
 	}
+}
 
-	return true;
+/**
+	@brief Picks pins for the IOB cells which don't have a LOC constraint, before anything else is placed.
+
+	The pin decides which matrix a signal starts in and which dedicated routes (to comparators, references, the
+	PGA, etc) it can use, so rather than leaving this to annealing we solve it as a weighted bipartite matching
+	between the unplaced IOB cells and the free pins (Hungarian algorithm; there are only a couple of dozen of
+	each). Each cell scores every pin it could go on by looking at the other end of each of its edges:
+		* Unroutable from this pin (to an already placed node, or to every site an unplaced one could use): penalty
+		* Dedicated routing available: big bonus, since only a few pins have it
+		* Same matrix as the placed node, or as the unplaced node's preferred matrix: small bonus
+	plus a tiny penalty for using a pin which only accepts the cell's type as an alternate (so plain inputs don't
+	take bidirectional pins from cells that need them).
+
+	If the cells can't all be given a pin this way, nothing is placed and MatchUnplacedNodes() handles them like
+	any other cell.
+
+	@param preferred	Preferred matrix of each netlist node, by node index (see ChoosePreferredMatrices())
+	@param placed		The IOB cells we placed are appended to this
+ */
+void Greenpak4PAREngine::AssignUnconstrainedPins(const vector<uint32_t>& preferred, vector<PARGraphNode*>& placed)
+{
+	const int32_t UNROUTABLE_PENALTY	= 16;
+	const int32_t DEDICATED_BONUS		= 4;
+	const int32_t SAME_MATRIX_BONUS		= 2;
+	const int32_t ALTERNATE_PENALTY		= 1;
+
+	//Find the unplaced IOB cells, and the edges going in and out of each
+	uint32_t nnodes = m_netlist->GetNumNodes();
+	vector<PARGraphNode*> ports;
+	vector<int32_t> portIndex(nnodes, -1);
+	for(uint32_t i=0; i<nnodes; i++)
+	{
+		auto node = m_netlist->GetNodeByIndex(i);
+		auto cell = static_cast<Greenpak4NetlistCell*>(static_cast<Greenpak4NetlistEntity*>(node->GetData()));
+		if( (node->GetMate() != NULL) || !cell->IsIOB() )
+			continue;
+		portIndex[i] = ports.size();
+		ports.push_back(node);
+	}
+	if(ports.empty())
+		return;
+
+	vector< vector<PARGraphEdge*> > edges(ports.size());
+	for(uint32_t i=0; i<nnodes; i++)
+	{
+		auto node = m_netlist->GetNodeByIndex(i);
+		for(uint32_t j=0; j<node->GetEdgeCount(); j++)
+		{
+			auto edge = node->GetEdgeByIndex(j);
+			if(edge->m_free)
+				continue;
+			if(portIndex[i] >= 0)
+				edges[portIndex[i]].push_back(edge);
+			int32_t d = portIndex[edge->m_destnode->GetIndex()];
+			if( (d >= 0) && (edge->m_destnode != node) )
+				edges[d].push_back(edge);
+		}
+	}
+
+	//The free pins (every IOB site accepts one of the IOB labels)
+	vector<PARGraphNode*> pins;
+	for(uint32_t i=0; i<m_device->GetNumNodes(); i++)
+	{
+		auto site = m_device->GetNodeByIndex(i);
+		if( (site->GetMate() == NULL) && (dynamic_cast<Greenpak4IOB*>(
+			static_cast<Greenpak4BitstreamEntity*>(site->GetData())) != NULL) )
+		{
+			pins.push_back(site);
+		}
+	}
+	if(pins.size() < ports.size())
+		return;
+
+	//Free sites each unplaced non-IOB neighbor could go on, found as we need them
+	map<PARGraphNode*, vector<PARGraphNode*> > neighborSites;
+	auto sitesFor = [&](PARGraphNode* node) -> const vector<PARGraphNode*>&
+	{
+		auto it = neighborSites.find(node);
+		if(it != neighborSites.end())
+			return it->second;
+		auto& sites = neighborSites[node];
+		uint32_t label = node->GetLabel();
+		for(uint32_t j=0; j<m_device->GetNumNodesWithLabel(label); j++)
+		{
+			auto site = m_device->GetNodeByLabelAndIndex(label, j);
+			if( (site->GetMate() == NULL) && IsSiteInNodeRegion(node, site) )
+				sites.push_back(site);
+		}
+		return sites;
+	};
+
+	//Cost of putting each cell on each pin (lower is better, FORBIDDEN if the pin doesn't accept the cell)
+	const int64_t FORBIDDEN = 1000000;
+	vector< vector<int64_t> > cost(ports.size(), vector<int64_t>(pins.size(), FORBIDDEN));
+	for(size_t i=0; i<ports.size(); i++)
+	{
+		auto port = ports[i];
+		for(size_t j=0; j<pins.size(); j++)
+		{
+			auto pin = pins[j];
+			if(!pin->MatchesLabel(port->GetLabel()) || !IsSiteInNodeRegion(port, pin))
+				continue;
+
+			int32_t score = (pin->GetLabel() != port->GetLabel()) ? -ALTERNATE_PENALTY : 0;
+			for(auto edge : edges[i])
+			{
+				bool outgoing = (edge->m_sourcenode == port);
+				PARGraphNode* other = outgoing ? edge->m_destnode : edge->m_sourcenode;
+
+				//Other IOBs are being placed along with us, so we can't say anything about them
+				if(portIndex[other->GetIndex()] >= 0)
+					continue;
+
+				vector<PARGraphNode*> mate;
+				if(other->GetMate() != NULL)
+					mate.push_back(other->GetMate());
+				const vector<PARGraphNode*>& sites = (other->GetMate() != NULL) ? mate : sitesFor(other);
+
+				bool routable = false;
+				bool dedicated = false;
+				for(auto site : sites)
+				{
+					PARGraphNode* src = outgoing ? pin : site;
+					PARGraphNode* dst = outgoing ? site : pin;
+					if(!m_device->HasEdge(src, edge->m_sourceport, dst, edge->m_destport))
+						continue;
+					routable = true;
+					if(!src->HasFabricOutput(edge->m_sourceport) || !dst->HasFabricInput(edge->m_destport))
+					{
+						dedicated = true;
+						break;
+					}
+				}
+
+				uint32_t matrix = (other->GetMate() != NULL) ?
+					GetSiteMatrix(other->GetMate()) : preferred[other->GetIndex()];
+				if(!routable)
+					score -= UNROUTABLE_PENALTY;
+				else if(dedicated)
+					score += DEDICATED_BONUS;
+				else if(GetSiteMatrix(pin) == matrix)
+					score += SAME_MATRIX_BONUS;
+			}
+
+			cost[i][j] = -score;
+		}
+	}
+
+	//Hungarian algorithm (rows are cells, columns are pins, both 1-based with 0 as the sentinel)
+	size_t n = ports.size();
+	size_t m = pins.size();
+	const int64_t INF = INT64_MAX / 4;
+	vector<int64_t> u(n+1, 0);
+	vector<int64_t> v(m+1, 0);
+	vector<size_t> rowOfColumn(m+1, 0);
+	vector<size_t> way(m+1, 0);
+	for(size_t row=1; row<=n; row++)
+	{
+		rowOfColumn[0] = row;
+		size_t col0 = 0;
+		vector<int64_t> minv(m+1, INF);
+		vector<bool> used(m+1, false);
+		do
+		{
+			used[col0] = true;
+			size_t row0 = rowOfColumn[col0];
+			int64_t delta = INF;
+			size_t col1 = 0;
+			for(size_t col=1; col<=m; col++)
+			{
+				if(used[col])
+					continue;
+				int64_t cur = cost[row0-1][col-1] - u[row0] - v[col];
+				if(cur < minv[col])
+				{
+					minv[col] = cur;
+					way[col] = col0;
+				}
+				if(minv[col] < delta)
+				{
+					delta = minv[col];
+					col1 = col;
+				}
+			}
+			for(size_t col=0; col<=m; col++)
+			{
+				if(used[col])
+				{
+					u[rowOfColumn[col]] += delta;
+					v[col] -= delta;
+				}
+				else
+					minv[col] -= delta;
+			}
+			col0 = col1;
+		} while(rowOfColumn[col0] != 0);
+
+		do
+		{
+			size_t col1 = way[col0];
+			rowOfColumn[col0] = rowOfColumn[col1];
+			col0 = col1;
+		} while(col0 != 0);
+	}
+
+	//If anything ended up on a pin it can't use, there's no room for every cell, so leave them all alone
+	for(size_t col=1; col<=m; col++)
+	{
+		if( (rowOfColumn[col] != 0) && (cost[rowOfColumn[col]-1][col-1] >= FORBIDDEN) )
+			return;
+	}
+
+	for(size_t col=1; col<=m; col++)
+	{
+		if(rowOfColumn[col] == 0)
+			continue;
+		auto port = ports[rowOfColumn[col]-1];
+		auto pin = pins[col-1];
+		port->MateWith(pin);
+		placed.push_back(port);
+
+		auto cell = static_cast<Greenpak4NetlistEntity*>(port->GetData());
+		LogDebug("Assigned unconstrained port cell %s to %s (score %d)\n",
+			cell->m_name.c_str(),
+			static_cast<Greenpak4BitstreamEntity*>(pin->GetData())->GetDescription().c_str(),
+			static_cast<int>(-cost[rowOfColumn[col]-1][col-1]));
+	}
+	LogVerbose("Assigned pins to %zu unconstrained top-level port cells\n", ports.size());
 }
 
-////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
-// Congestion metrics
+/**
+	@brief Finds a legal site for every netlist node that isn't already placed.
+
+	This is a bipartite matching between netlist nodes and free sites which accept their label (primary or
+	alternate), so it always succeeds if any legal placement exists. Each node tries sites it can route to its
+	already placed neighbors (LOC constraints and pins from AssignUnconstrainedPins()) first, then sites in its
+	preferred matrix, and sites of its own type before ones that merely accept it as an alternate.
 
-uint32_t Greenpak4PAREngine::ComputeCongestionCost()
+	@param preferred	Preferred matrix of each netlist node, by node index
+	@param quiet		Don't print an error if some node can't be placed
+
+	@return True on success. On failure, no nodes are placed.
+ */
+bool Greenpak4PAREngine::MatchUnplacedNodes(const vector<uint32_t>& preferred, bool quiet)
 {
-	uint32_t costs[2] = {0};
+	uint32_t nnodes = m_netlist->GetNumNodes();
 
-	for(uint32_t i=0; i<m_device->GetNumNodes(); i++)
+	//Edges between each unplaced node and a placed one
+	vector< vector<PARGraphEdge*> > placedEdges(nnodes);
+	for(uint32_t i=0; i<nnodes; i++)
+	{
+		auto node = m_netlist->GetNodeByIndex(i);
+		for(uint32_t j=0; j<node->GetEdgeCount(); j++)
+		{
+			auto edge = node->GetEdgeByIndex(j);
+			if(edge->m_free)
+				continue;
+			bool srcPlaced = (node->GetMate() != NULL);
+			bool dstPlaced = (edge->m_destnode->GetMate() != NULL);
+			if(srcPlaced && !dstPlaced)
+				placedEdges[edge->m_destnode->GetIndex()].push_back(edge);
+			else if(!srcPlaced && dstPlaced)
+				placedEdges[i].push_back(edge);
+		}
+	}
+
+	//Candidate sites for each unplaced node, best first
+	vector< vector<PARGraphNode*> > candidates(nnodes);
+	for(uint32_t i=0; i<nnodes; i++)
 	{
-		//If no node in the netlist is assigned to us, nothing to do
-		PARGraphNode* node = m_device->GetNodeByIndex(i);
-		PARGraphNode* netnode = node->GetMate();
-		if(netnode == NULL)
+		auto node = m_netlist->GetNodeByIndex(i);
+		if(node->GetMate() != NULL)
 			continue;
 
-		//Find all edges crossing the central routing matrix
-		for(uint32_t i=0; i<netnode->GetEdgeCount(); i++)
+		uint32_t label = node->GetLabel();
+		auto& sites = candidates[i];
+		for(uint32_t j=0; j<m_device->GetNumNodesWithLabel(label); j++)
 		{
-			auto edge = netnode->GetEdgeByIndex(i);
-			auto src = static_cast<Greenpak4BitstreamEntity*>(edge->m_sourcenode->GetMate()->GetData());
-			auto dst = static_cast<Greenpak4BitstreamEntity*>(edge->m_destnode->GetMate()->GetData());
-			uint32_t sm = src->GetMatrix();
-			uint32_t dm = dst->GetMatrix();
+			//If the site is used, we don't want to disturb what's already there because it was LOC'd
+			auto site = m_device->GetNodeByLabelAndIndex(label, j);
+			if( (site->GetMate() == NULL) && IsSiteInNodeRegion(node, site) )
+				sites.push_back(site);
+		}
 
-			//If we're driving a port that isn't general fabric routing, then it doesn't compete for cross connections
-			if(!dst->IsGeneralFabricInput(edge->m_destport))
-				continue;
+		map<PARGraphNode*, uint32_t> rank;
+		for(auto site : sites)
+		{
+			uint32_t unroutable = 0;
+			for(auto edge : placedEdges[i])
+			{
+				bool outgoing = (edge->m_sourcenode == node);
+				PARGraphNode* src = outgoing ? site : edge->m_sourcenode->GetMate();
+				PARGraphNode* dst = outgoing ? edge->m_destnode->GetMate() : site;
+				if(!m_device->HasEdge(src, edge->m_sourceport, dst, edge->m_destport))
+					unroutable ++;
+			}
 
-			//If the source has a dual, don't count this in the cost since it can route anywhere
-			if(src->GetDual() != NULL)
+			rank[site] =
+				(unroutable * 4) +
+				( (GetSiteMatrix(site) != preferred[i]) ? 2 : 0 ) +
+				( (site->GetLabel() != label) ? 1 : 0 );
+		}
+		stable_sort(sites.begin(), sites.end(),
+			[&](PARGraphNode* a, PARGraphNode* b) { return rank[a] < rank[b]; });
+	}
+
+	//Kuhn's algorithm: place each node in turn, bumping earlier nodes along augmenting paths if we have to
+	vector<PARGraphNode*> owner(m_device->GetNumNodes(), NULL);
+	vector<uint32_t> visited(m_device->GetNumNodes(), 0);
+	uint32_t stamp = 0;
+	function<bool(PARGraphNode*)> augment = [&](PARGraphNode* node)
+	{
+		for(auto site : candidates[node->GetIndex()])
+		{
+			uint32_t s = site->GetIndex();
+			if(visited[s] == stamp)
 				continue;
+			visited[s] = stamp;
 
-			//If matrices don't match, bump cost
-			if(sm != dm)
-				costs[sm] ++;
+			if( (owner[s] == NULL) || augment(owner[s]) )
+			{
+				owner[s] = node;
+				return true;
+			}
 		}
+		return false;
+	};
+
+	for(uint32_t i=0; i<nnodes; i++)
+	{
+		auto node = m_netlist->GetNodeByIndex(i);
+		if(node->GetMate() != NULL)
+			continue;
+
+		stamp ++;
+		if(augment(node))
+			continue;
+		if(quiet)
+			return false;
+
+		//This can happen if constraints leave too few sites
+		//(for example, we constrained all of the 8-bit counters to COUNT14 sites and now have a COUNT14).
+		auto cell = static_cast<Greenpak4NetlistEntity*>(node->GetData());
+		LogError(
+			"Could not place netlist cell \"%s\" because we ran out of sites with type \"%s\"\n"
+			"       This can happen if you have overly restrictive LOC or MATRIX constraints.\n",
+			cell->m_name.c_str(),
+			m_labels->GetName(node->GetLabel()).c_str()
+			);
+		return false;
+	}
+
+	//Apply the matching
+	for(uint32_t s=0; s<owner.size(); s++)
+	{
+		if(owner[s] != NULL)
+			owner[s]->MateWith(m_device->GetNodeByIndex(s));
 	}
 
-	//Squaring each half makes minimizing the larger one more important
+	return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Congestion metrics
+
+uint32_t Greenpak4PAREngine::GetCongestionBinCount()
+{
+	//One bin per (source, destination) pair of matrices, counting the edges that need a cross connection between them
+	return m_matrixCount * m_matrixCount;
+}
+
+/**
+	@brief Each routing matrix is a region for multi-level placement
+ */
+uint32_t Greenpak4PAREngine::GetRegionCount()
+{
+	return m_matrixCount;
+}
+
+uint32_t Greenpak4PAREngine::GetSiteRegion(PARGraphNode* site)
+{
+	return GetSiteMatrix(site);
+}
+
+/**
+	@brief Nodes with a MATRIX constraint have to stay in that matrix
+ */
+int32_t Greenpak4PAREngine::GetNodeRegion(PARGraphNode* node)
+{
+	int32_t matrix = m_sites->GetMatrixConstraint(node->GetIndex());
+	return (matrix >= 0) ? matrix : ANY_REGION;
+}
+
+/**
+	@brief Finds the cross connection an edge needs (called from the innermost cost loop, see PARModelEngine)
+ */
+int32_t Greenpak4PAREngine::EdgeCongestionBin(PARGraphEdge* edge)
+{
+	uint32_t src = edge->m_sourcenode->GetMate()->GetIndex();
+	uint32_t dst = edge->m_destnode->GetMate()->GetIndex();
+
+	//Dedicated routing, same matrix, or a dual in the destination matrix we can use instead don't compete for cross
+	//connections
+	if(!m_sites->NeedsCrossConnection(src, dst, edge->m_destport))
+		return -1;
+	return m_sites->GetMatrix(src)*m_matrixCount + m_sites->GetMatrix(dst);
+}
+
+/**
+	@brief All edges of the same netlist net share one cross connection (CommitRouting() reuses them), so count each
+	net once
+ */
+uint32_t Greenpak4PAREngine::EdgeCongestionNet(PARGraphEdge* edge)
+{
+	return edge->m_net;
+}
+
+/**
+	@brief Converts the number of cross connections used between each pair of matrices into a cost
+ */
+uint32_t Greenpak4PAREngine::ComputeCongestionCostFromBins(const vector<uint32_t>& bins)
+{
+	//Squaring each bin makes minimizing the larger ones more important
 	//vs if we just summed
-	return sqrt(costs[0]*costs[0] + costs[1]*costs[1]);
+	uint32_t sum = 0;
+	for(auto b : bins)
+		sum += b*b;
+	uint32_t cost = sqrt(sum);
+
+	//Going over capacity fails at commit time, so weight each extra net like an unroutable edge.
+	//Includes pairs of matrices with no direct connection at all, since those nets can never be routed.
+	//Bins which overflowed in earlier routing attempts get progressively more expensive.
+	for(size_t i=0; i<bins.size(); i++)
+	{
+		if(bins[i] > m_crossCapacity[i])
+			cost += (bins[i] - m_crossCapacity[i]) * 10 * (1 + m_congestionHistory[i]);
+	}
+	return cost;
+}
+
+uint32_t Greenpak4PAREngine::GetCongestionBinCapacity(uint32_t bin)
+{
+	return m_crossCapacity[bin];
+}
+
+/**
+	@brief Checks the current placement's cross connection usage against capacity, and makes any over-used pair of
+	matrices more expensive for future annealing runs.
+
+	This is the history term of PathFinder-style negotiated congestion: since all cross connections between two
+	matrices are interchangeable, the only way to resolve overflow is to move logic, so the placer does the rip-up.
+
+	@return Total number of nets over capacity (zero if the current placement will commit)
+ */
+uint32_t Greenpak4PAREngine::UpdateCongestionHistory()
+{
+	//Make sure the bins reflect the current placement
+	InitCostCache();
+
+	uint32_t overflow = 0;
+	for(uint32_t i=0; i<m_congestionBins.size(); i++)
+	{
+		if(m_congestionBins[i] <= m_crossCapacity[i])
+			continue;
+
+		uint32_t over = m_congestionBins[i] - m_crossCapacity[i];
+		LogVerbose("Matrix %u to %u needs %u cross connections, %u over capacity\n",
+			i / m_matrixCount, i % m_matrixCount, m_congestionBins[i], over);
+		m_congestionHistory[i] += over;
+		overflow += over;
+	}
+	return overflow;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Timing model
+
+uint32_t Greenpak4PAREngine::GetNodeDelay(PARGraphNode* node)
+{
+	auto site = static_cast<Greenpak4BitstreamEntity*>(node->GetMate()->GetData());
+	return site->GetPropagationDelay(static_cast<Greenpak4NetlistEntity*>(node->GetData()));
+}
+
+/**
+	@brief Routing delay, including any cross connection CommitRouting() would have to use
+ */
+uint32_t Greenpak4PAREngine::GetEdgeDelay(PARGraphEdge* edge)
+{
+	auto src = static_cast<Greenpak4BitstreamEntity*>(edge->m_sourcenode->GetMate()->GetData());
+	auto dst = static_cast<Greenpak4BitstreamEntity*>(edge->m_destnode->GetMate()->GetData());
+	return m_pdev->GetRoutingDelay(src, dst, edge->m_destport);
+}
+
+/**
+	@brief Registers, counters and the like. Every site a cell can go to agrees on this, so it doesn't depend on
+	placement.
+ */
+bool Greenpak4PAREngine::IsTimingBoundary(PARGraphNode* node)
+{
+	auto site = static_cast<Greenpak4BitstreamEntity*>(node->GetMate()->GetData());
+	return site->IsSequential(static_cast<Greenpak4NetlistEntity*>(node->GetData()));
+}
+
+/**
+	@brief Clocks and constants aren't data paths
+ */
+bool Greenpak4PAREngine::IsTimingEdge(PARGraphEdge* edge)
+{
+	auto src = static_cast<Greenpak4BitstreamEntity*>(edge->m_sourcenode->GetMate()->GetData());
+	auto dst = static_cast<Greenpak4BitstreamEntity*>(edge->m_destnode->GetMate()->GetData());
+	return m_pdev->IsDataRoute(src, dst, edge->m_destport);
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -225,7 +1063,7 @@ void Greenpak4PAREngine::PrintUnroutes(vector<PARGraphEdge*>& unroutes)
 			Log(Severity::ERROR, "from cell %s (mapped to %s) port %s ",
 				scell->m_name.c_str(),
 				entity->GetDescription().c_str(),
-				edge->m_sourceport.c_str()
+				edge->GetSourcePortName().c_str()
 				);
 		}
 		else if(sport != NULL)
@@ -244,7 +1082,7 @@ void Greenpak4PAREngine::PrintUnroutes(vector<PARGraphEdge*>& unroutes)
 				"cell %s (mapped to %s) pin %s\n",
 				dcell->m_name.c_str(),
 				entity->GetDescription().c_str(),
-				edge->m_destport.c_str()
+				edge->GetDestPortName().c_str()
 				);
 		}
 		else if(dport != NULL)
@@ -260,101 +1098,217 @@ void Greenpak4PAREngine::PrintUnroutes(vector<PARGraphEdge*>& unroutes)
 // Optimization helpers
 
 /**
-	@brief Find all nodes that are not optimally placed.
-
-	This means that the node contributes in some nonzero fashion to the overall score of the system.
+	@brief Returns the netlist nodes worth moving: those with a cross-matrix route we could avoid, or on either end
+	of an unroutable edge.
 
 	Nodes are in the NETLIST graph, not the DEVICE graph.
+
+	The set is kept up to date incrementally by UpdateBadNodeCache(), so this doesn't depend on the netlist size.
  */
 void Greenpak4PAREngine::FindSubOptimalPlacements(std::vector<PARGraphNode*>& bad_nodes)
 {
-	std::set<PARGraphNode*> nodes;
+	bad_nodes = m_badNodes;
 
-	//Find all nodes that have at least one cross-spine route
-	for(uint32_t i=0; i<m_device->GetNumNodes(); i++)
-	{
-		//If no node in the netlist is assigned to us, nothing to do
-		PARGraphNode* node = m_device->GetNodeByIndex(i);
-		PARGraphNode* netnode = node->GetMate();
-		if(netnode == NULL)
-			continue;
+	//DEBUG
+	/*
+	LogVerbose("Optimizing (%d bad nodes, %d unroutes)\n", bad_nodes.size(), m_unroutableCost);
+	LogIndenter li;
+	for(auto x : bad_nodes)
+		LogVerbose("* %s\n",
+			static_cast<Greenpak4BitstreamEntity*>(x->GetMate()->GetData())->GetDescription().c_str());
+	*/
+}
 
-		for(uint32_t i=0; i<netnode->GetEdgeCount(); i++)
-		{
-			auto edge = netnode->GetEdgeByIndex(i);
-			auto src = static_cast<Greenpak4BitstreamEntity*>(edge->m_sourcenode->GetMate()->GetData());
-			auto dst = static_cast<Greenpak4BitstreamEntity*>(edge->m_destnode->GetMate()->GetData());
+/**
+	@brief Rebuilds the bad node set from scratch
+ */
+void Greenpak4PAREngine::InitBadNodeCache()
+{
+	m_edgeBadness.assign(m_netlistEdges.size(), 0);
+	m_nodeBadReasons.assign(m_netlist->GetNumNodes(), 0);
+	m_nodeUnroutableReasons.assign(m_netlist->GetNumNodes(), 0);
+	m_badNodes.clear();
+	m_badNodeSlots.assign(m_netlist->GetNumNodes(), -1);
+
+	for(uint32_t i=0; i<m_netlistEdges.size(); i++)
+		UpdateEdgeBadness(i);
+}
 
-			//Cross connections
-			unsigned int srcmatrix = src->GetMatrix();
-			if(srcmatrix != dst->GetMatrix())
-			{
-				//If there's nothing we can do about it, skip
-				if(CantMoveSrc(src))
-					continue;
-				if(CantMoveDst(dst))
-					continue;
-				if(!dst->IsGeneralFabricInput(edge->m_destport))
-					continue;
+/**
+	@brief Updates the bad node set after a and b (either may be NULL) were moved.
 
-				//Anything with a dual is always in an optimal location as far as congestion goes
-				if(src->GetDual() != NULL)
-					continue;
+	Whether an edge makes a node bad only depends on where its two endpoints are, so only the edges touching the moved
+	nodes need to be looked at.
+ */
+void Greenpak4PAREngine::UpdateBadNodeCache(PARGraphNode* a, PARGraphNode* b)
+{
+	//An edge between a and b gets updated twice, which is harmless
+	if(a != NULL)
+	{
+		for(auto i : m_nodeEdges[a->GetIndex()])
+			UpdateEdgeBadness(i);
+	}
+	if( (b != NULL) && (b != a) )
+	{
+		for(auto i : m_nodeEdges[b->GetIndex()])
+			UpdateEdgeBadness(i);
+	}
+}
 
-				//Add the node
-				nodes.insert(edge->m_sourcenode);
-			}
+/**
+	@brief Checks the incrementally maintained bad node set against one computed from scratch
+ */
+void Greenpak4PAREngine::VerifyBadNodeCache()
+{
+	vector<uint32_t> reasons(m_netlist->GetNumNodes(), 0);
+	for(uint32_t i=0; i<m_netlistEdges.size(); i++)
+	{
+		uint8_t flags = ComputeEdgeBadness(i);
+		if(flags != m_edgeBadness[i])
+			LogFatal("Bad node cache mismatch: flags for edge %u are %u, should be %u\n", i, m_edgeBadness[i], flags);
+
+		PARGraphEdge* edge = m_netlistEdges[i];
+		if(flags & BAD_SRC_CROSSING)
+			reasons[edge->m_sourcenode->GetIndex()] ++;
+		if(flags & BAD_SRC_UNROUTABLE)
+			reasons[edge->m_sourcenode->GetIndex()] ++;
+		if(flags & BAD_DST_UNROUTABLE)
+			reasons[edge->m_destnode->GetIndex()] ++;
+	}
+
+	uint32_t nbad = 0;
+	for(uint32_t i=0; i<reasons.size(); i++)
+	{
+		if(reasons[i] != m_nodeBadReasons[i])
+		{
+			LogFatal("Bad node cache mismatch: node %u has %u reasons, should be %u\n",
+				i, m_nodeBadReasons[i], reasons[i]);
 		}
+		if(reasons[i] == 0)
+			continue;
+
+		nbad ++;
+		int32_t slot = m_badNodeSlots[i];
+		if( (slot < 0) || (m_badNodes[slot] != m_netlist->GetNodeByIndex(i)) )
+			LogFatal("Bad node cache mismatch: node %u is missing from the bad node list\n", i);
 	}
+	if(nbad != m_badNodes.size())
+		LogFatal("Bad node cache mismatch: list has %zu nodes, should be %u\n", m_badNodes.size(), nbad);
+}
 
-	//Find all nodes that are on one end of an unroutable edge
-	m_unroutableNodes.clear();
-	std::vector<PARGraphEdge*> unroutes;
-	ComputeUnroutableCost(unroutes);
-	for(auto edge : unroutes)
+/**
+	@brief Removes the reasons a single edge gave for moving its endpoints, then re-adds them based on the current
+	placement.
+ */
+void Greenpak4PAREngine::UpdateEdgeBadness(uint32_t index)
+{
+	PARGraphEdge* edge = m_netlistEdges[index];
+
+	//Remove the old contribution
+	uint8_t old_flags = m_edgeBadness[index];
+	if(old_flags & BAD_SRC_CROSSING)
+		RemoveBadReason(edge->m_sourcenode, false);
+	if(old_flags & BAD_SRC_UNROUTABLE)
+		RemoveBadReason(edge->m_sourcenode, true);
+	if(old_flags & BAD_DST_UNROUTABLE)
+		RemoveBadReason(edge->m_destnode, true);
+
+	//Add the new contribution
+	uint8_t flags = ComputeEdgeBadness(index);
+	m_edgeBadness[index] = flags;
+	if(flags & BAD_SRC_CROSSING)
+		AddBadReason(edge->m_sourcenode, false);
+	if(flags & BAD_SRC_UNROUTABLE)
+		AddBadReason(edge->m_sourcenode, true);
+	if(flags & BAD_DST_UNROUTABLE)
+		AddBadReason(edge->m_destnode, true);
+}
+
+/**
+	@brief Figures out which reasons a netlist edge gives for moving its endpoints, under the current placement.
+
+	Relies on m_edgeUnroutable being up to date for this edge.
+ */
+uint8_t Greenpak4PAREngine::ComputeEdgeBadness(uint32_t index)
+{
+	PARGraphEdge* edge = m_netlistEdges[index];
+
+	uint8_t flags = 0;
+	PARGraphNode* srcmate = edge->m_sourcenode->GetMate();
+	PARGraphNode* dstmate = edge->m_destnode->GetMate();
+	if( (srcmate != NULL) && (dstmate != NULL) )
 	{
-		if(!CantMoveSrc(static_cast<Greenpak4BitstreamEntity*>(edge->m_sourcenode->GetMate()->GetData())))
+		//Cross connections, unless there's nothing we can do about them.
+		//Anything with a dual in the destination's matrix is in an optimal location as far as congestion goes.
+		if( m_sites->NeedsCrossConnection(srcmate->GetIndex(), dstmate->GetIndex(), edge->m_destport) &&
+			!CantMoveSrc(srcmate) &&
+			!CantMoveDst(dstmate) )
 		{
-			m_unroutableNodes.insert(edge->m_sourcenode);
-			nodes.insert(edge->m_sourcenode);
+			flags |= BAD_SRC_CROSSING;
 		}
-		if(!CantMoveDst(static_cast<Greenpak4BitstreamEntity*>(edge->m_destnode->GetMate()->GetData())))
+
+		//Both ends of an unroutable edge
+		if(m_edgeUnroutable[index])
 		{
-			m_unroutableNodes.insert(edge->m_destnode);
-			nodes.insert(edge->m_destnode);
+			if(!CantMoveSrc(srcmate))
+				flags |= BAD_SRC_UNROUTABLE;
+			if(!CantMoveDst(dstmate))
+				flags |= BAD_DST_UNROUTABLE;
 		}
 	}
 
-	//Push into the final output list
-	for(auto x : nodes)
-		bad_nodes.push_back(x);
+	return flags;
+}
 
-	//DEBUG
-	/*
-	LogVerbose("Optimizing (%d bad nodes, %d unroutes)\n", bad_nodes.size(), unroutes.size());
-	LogIndenter li;
-	for(auto x : bad_nodes)
-		LogVerbose("* %s\n",
-			static_cast<Greenpak4BitstreamEntity*>(x->GetMate()->GetData())->GetDescription().c_str());
-	*/
+/**
+	@brief Records one more reason to move a node, adding it to the bad node set if it wasn't there already
+ */
+void Greenpak4PAREngine::AddBadReason(PARGraphNode* node, bool unroutable)
+{
+	uint32_t index = node->GetIndex();
+	if(unroutable)
+		m_nodeUnroutableReasons[index] ++;
+	if(m_nodeBadReasons[index] ++ != 0)
+		return;
+
+	m_badNodeSlots[index] = m_badNodes.size();
+	m_badNodes.push_back(node);
+}
+
+/**
+	@brief Removes one reason to move a node, taking it out of the bad node set if none are left
+ */
+void Greenpak4PAREngine::RemoveBadReason(PARGraphNode* node, bool unroutable)
+{
+	uint32_t index = node->GetIndex();
+	if(unroutable)
+		m_nodeUnroutableReasons[index] --;
+	if(-- m_nodeBadReasons[index] != 0)
+		return;
+
+	//Swap the last node into our slot so the list stays dense
+	int32_t slot = m_badNodeSlots[index];
+	PARGraphNode* last = m_badNodes.back();
+	m_badNodes[slot] = last;
+	m_badNodeSlots[last->GetIndex()] = slot;
+	m_badNodes.pop_back();
+	m_badNodeSlots[index] = -1;
 }
 
 /**
 	@brief Returns true if the given source node cannot be moved
  */
-bool Greenpak4PAREngine::CantMoveSrc(Greenpak4BitstreamEntity* src)
+bool Greenpak4PAREngine::CantMoveSrc(PARGraphNode* pn)
 {
 	//If we have only one node of this type, we can't move it because there's nowhere to go
-	auto pn = src->GetPARNode();
 	if(pn == NULL)
 		return true;
-	if(m_device->GetNumNodesWithLabel(pn->GetLabel()) == 1)
+	if(m_sites->IsUnique(pn->GetIndex()))
 		return true;
 
 	//If it has a LOC constraint, don't move it
-	auto se = static_cast<Greenpak4NetlistEntity*>(pn->GetMate()->GetData());
-	auto netnode = dynamic_cast<Greenpak4NetlistCell*>(se);
-	if( (netnode != NULL) && netnode->HasLOC() )
+	PARGraphNode* mate = pn->GetMate();
+	if( (mate != NULL) && m_sites->IsLocked(mate->GetIndex()) )
 		return true;
 
 	//nope, it's movable
@@ -373,12 +1327,8 @@ bool Greenpak4PAREngine::CanMoveNode(PARGraphNode* node, PARGraphNode* old_mate,
 		return true;
 
 	//If the displaced node has a LOC constraint, don't use that site
-	auto netnode = dynamic_cast<Greenpak4NetlistCell*>(static_cast<Greenpak4NetlistEntity*>(displaced->GetData()));
-	if( (netnode != NULL) && netnode->HasLOC() )
-	{
-		//LogDebug("Tried to move cell %s\n", netnode->m_name.c_str());
+	if(m_sites->IsLocked(displaced->GetIndex()))
 		return false;
-	}
 
 	return true;
 }
@@ -386,19 +1336,17 @@ bool Greenpak4PAREngine::CanMoveNode(PARGraphNode* node, PARGraphNode* old_mate,
 /**
 	@brief Returns true if the given destination node cannot be moved
  */
-bool Greenpak4PAREngine::CantMoveDst(Greenpak4BitstreamEntity* dst)
+bool Greenpak4PAREngine::CantMoveDst(PARGraphNode* pn)
 {
 	//If we have only one node of this type, we can't move it because there's nowhere to go
-	auto pn = dst->GetPARNode();
 	if(pn == NULL)
 		return true;
-	if(m_device->GetNumNodesWithLabel(pn->GetLabel()) == 1)
+	if(m_sites->IsUnique(pn->GetIndex()))
 		return true;
 
 	//If it has a LOC constraint, don't move it
-	auto se = static_cast<Greenpak4NetlistEntity*>(pn->GetMate()->GetData());
-	auto netnode = dynamic_cast<Greenpak4NetlistCell*>(se);
-	if( (netnode != NULL) && netnode->HasLOC() )
+	PARGraphNode* mate = pn->GetMate();
+	if( (mate != NULL) && m_sites->IsLocked(mate->GetIndex()) )
 		return true;
 
 	//nope, it's movable
@@ -413,69 +1361,123 @@ PARGraphNode* Greenpak4PAREngine::GetNewPlacementForNode(PARGraphNode* pivot)
 	//Find which matrix we were assigned to
 	PARGraphNode* current_node = pivot->GetMate();
 	auto current_site = static_cast<Greenpak4BitstreamEntity*>(current_node->GetData());
-	uint32_t current_matrix = current_site->GetMatrix();
+	uint32_t current_matrix = GetSiteMatrix(current_node);
 
 	//BUGFIX: Use the netlist node's label, not the PAR node
 	uint32_t label = pivot->GetLabel();
 
-	//Debug log
-	bool unroutable = (m_unroutableNodes.find(pivot) != m_unroutableNodes.end());
-	Greenpak4NetlistEntity* ne = static_cast<Greenpak4NetlistEntity*>(pivot->GetData());
-	LogDebug("Seeking new placement for node %s (at %s, unroutable = %d)\n",
-		ne->m_name.c_str(),
-		current_site->GetDescription().c_str(), unroutable);
-
-	//Default to trying the opposite matrix
-	uint32_t target_matrix = 1 - current_matrix;
-
-	//Make the list of candidate placements
-	std::set<PARGraphNode*> temp_candidates;
-	for(uint32_t i=0; i<m_device->GetNumNodesWithLabel(label); i++)
+	//Debug log (this runs for every move, so don't even build the site names unless they'll be printed)
+	bool debug = !m_quiet && IsDebugLogging();
+	if(debug)
 	{
-		PARGraphNode* node = m_device->GetNodeByLabelAndIndex(label, i);
-		Greenpak4BitstreamEntity* entity = static_cast<Greenpak4BitstreamEntity*>(node->GetData());
-
-		//Do not consider unroutable positions at this time
-		if(0 != ComputeNodeUnroutableCost(pivot, node))
-			continue;
+		bool unroutable = (m_nodeUnroutableReasons[pivot->GetIndex()] != 0);
+		Greenpak4NetlistEntity* ne = static_cast<Greenpak4NetlistEntity*>(pivot->GetData());
+		LogDebug("Seeking new placement for node %s (at %s, unroutable = %d)\n",
+			ne->m_name.c_str(),
+			current_site->GetDescription().c_str(), unroutable);
+	}
 
-		if(entity->GetMatrix() == target_matrix)
-			temp_candidates.insert(node);
+	//Try to find a routable site in one of the other matrices (visited round robin from a random one),
+	//and failing that, in ours. A MATRIX constraint leaves only ours to look in.
+	if(m_siteBuckets.empty())
+		BuildSiteBuckets();
+	PARGraphNode* c = NULL;
+	int32_t region = GetNodeRegion(pivot);
+	if(region != ANY_REGION)
+		current_matrix = region;
+	uint32_t others = (region != ANY_REGION) ? 0 : (m_matrixCount - 1);
+	uint32_t first = (others > 1) ? m_random.NextBelow(others) : 0;
+	for(uint32_t i=0; (c == NULL) && (i < others); i++)
+	{
+		uint32_t m = (current_matrix + 1 + (first + i) % others) % m_matrixCount;
+		c = SampleRoutableSite(pivot, m_siteBuckets[m][label]);
 	}
+	if(c == NULL)
+		c = SampleRoutableSite(pivot, m_siteBuckets[current_matrix][label]);
 
-	//If no routable candidates found in the opposite matrix, check all matrices
-	if(temp_candidates.empty())
+	//If no routable candidates found anywhere, consider the entire chip (or our matrix) and hope we can patch
+	//things up later
+	if(c == NULL)
 	{
-		for(uint32_t i=0; i<m_device->GetNumNodesWithLabel(label); i++)
+		if(debug)
+			LogDebug("No routable candidates found\n");
+		if(region != ANY_REGION)
 		{
-			PARGraphNode* node = m_device->GetNodeByLabelAndIndex(label, i);
-
-			if(0 != ComputeNodeUnroutableCost(pivot, node))
-				continue;
-
-			temp_candidates.insert(node);
+			auto& bucket = m_siteBuckets[region][label];
+			if(bucket.empty())
+				return NULL;
+			c = bucket[m_random.NextBelow(bucket.size())];
+		}
+		else
+		{
+			uint32_t ncandidates = m_device->GetNumNodesWithLabel(label);
+			if(ncandidates == 0)
+				return NULL;
+			c = m_device->GetNodeByLabelAndIndex(label, m_random.NextBelow(ncandidates));
 		}
 	}
 
-	//If no routable candidates found anywhere, consider the entire chip and hope we can patch things up later
-	if(temp_candidates.empty())
+	if(debug)
 	{
-		LogDebug("No routable candidates found\n");
-		for(uint32_t i=0; i<m_device->GetNumNodesWithLabel(label); i++)
-			temp_candidates.insert(m_device->GetNodeByLabelAndIndex(label, i));
+		LogDebug("Selected %s\n",
+			static_cast<Greenpak4BitstreamEntity*>(c->GetData())->GetDescription().c_str());
 	}
+	return c;
+}
+
+/**
+	@brief Finds a routable site for a node in the same matrix as another site (for moving clusters between matrices)
+
+	@return The new site, or NULL if the node is already in that matrix, can't move, or has nowhere routable to go
+ */
+PARGraphNode* Greenpak4PAREngine::GetNewPlacementNear(PARGraphNode* node, PARGraphNode* site)
+{
+	if(CantMoveSrc(node->GetMate()))
+		return NULL;
 
-	//Move to a vector for random access
-	std::vector<PARGraphNode*> candidates;
-	for(auto x : temp_candidates)
-		candidates.push_back(x);
-	uint32_t ncandidates = candidates.size();
-	if(ncandidates == 0)
+	uint32_t matrix = GetSiteMatrix(site);
+	if( (GetSiteMatrix(node->GetMate()) == matrix) || !IsSiteInNodeRegion(node, site) )
 		return NULL;
 
-	//Pick one at random
-	auto c = candidates[rand() % ncandidates];
-	LogDebug("Selected %s\n",
-		static_cast<Greenpak4BitstreamEntity*>(c->GetData())->GetDescription().c_str());
-	return c;
+	if(m_siteBuckets.empty())
+		BuildSiteBuckets();
+	return SampleRoutableSite(node, m_siteBuckets[matrix][node->GetLabel()]);
+}
+
+/**
+	@brief Sorts the device sites into buckets by label and matrix, so candidate placements can be drawn quickly
+ */
+void Greenpak4PAREngine::BuildSiteBuckets()
+{
+	//The label registry already has them sorted, we just need copies of our own to shuffle
+	uint32_t nlabels = m_device->GetMaxLabel() + 1;
+	m_siteBuckets.assign(m_matrixCount, vector< vector<PARGraphNode*> >(nlabels));
+	for(uint32_t matrix=0; matrix<m_matrixCount; matrix++)
+	{
+		for(uint32_t label=0; label<nlabels; label++)
+		{
+			for(auto i : m_labels->GetSites(label, matrix))
+				m_siteBuckets[matrix][label].push_back(m_device->GetNodeByIndex(i));
+		}
+	}
+}
+
+/**
+	@brief Picks a uniformly random site from a bucket where the pivot's edges would all be routable.
+
+	Sites are visited in random order (a Fisher-Yates shuffle done lazily, in place) and the first routable one is
+	returned, so we usually only check a few sites rather than the whole bucket.
+
+	@return The chosen site, or NULL if no site in the bucket is routable
+ */
+PARGraphNode* Greenpak4PAREngine::SampleRoutableSite(PARGraphNode* pivot, vector<PARGraphNode*>& bucket)
+{
+	uint32_t n = bucket.size();
+	for(uint32_t i=0; i<n; i++)
+	{
+		swap(bucket[i], bucket[i + m_random.NextBelow(n - i)]);
+		if(0 == ComputeNodeUnroutableCost(pivot, bucket[i]))
+			return bucket[i];
+	}
+	return NULL;
 }
@@ -22,31 +22,129 @@
 /**
 	@brief The place-and-route engine for Greenpak4
  */
-class Greenpak4PAREngine : public PAREngine
+class Greenpak4PAREngine : public PARModelEngine<Greenpak4PAREngine>
 {
 public:
-	Greenpak4PAREngine(PARGraph* netlist, PARGraph* device, labelmap& lmap);
+	Greenpak4PAREngine(
+		PARGraph* netlist,
+		PARGraph* device,
+		Greenpak4Device* pdev,
+		const Greenpak4SiteTable* sites,
+		const PARLabelRegistry* labels);
 	virtual ~Greenpak4PAREngine();
 
+	uint32_t UpdateCongestionHistory();
+
+	/**
+		@brief Sets the placement of a previous run, to start from instead of placing everything from scratch
+		(NULL = don't)
+	 */
+	void SetPreviousPlacement(const placementmap* placement)
+	{ m_previousPlacement = placement; }
+
 protected:
+	friend class Greenpak4MatrixSwapMoveGenerator;
+	friend class PARModelEngine<Greenpak4PAREngine>;
+
 	virtual void PrintUnroutes(std::vector<PARGraphEdge*>& unroutes);
 
 	virtual void FindSubOptimalPlacements(std::vector<PARGraphNode*>& bad_nodes);
+	virtual void InitBadNodeCache();
+	virtual void UpdateBadNodeCache(PARGraphNode* a, PARGraphNode* b);
+	void UpdateEdgeBadness(uint32_t index);
+	uint8_t ComputeEdgeBadness(uint32_t index);
+	virtual void VerifyBadNodeCache();
+	void AddBadReason(PARGraphNode* node, bool unroutable);
+	void RemoveBadReason(PARGraphNode* node, bool unroutable);
 	virtual PARGraphNode* GetNewPlacementForNode(PARGraphNode* pivot);
+	virtual PARGraphNode* GetNewPlacementNear(PARGraphNode* node, PARGraphNode* site);
+	virtual PAREngine* CreateReplica(PARGraph* netlist, PARGraph* device);
+	void BuildSiteBuckets();
+	PARGraphNode* SampleRoutableSite(PARGraphNode* pivot, std::vector<PARGraphNode*>& bucket);
+
+	virtual uint32_t GetCongestionBinCount();
+	int32_t EdgeCongestionBin(PARGraphEdge* edge);
+	uint32_t EdgeCongestionNet(PARGraphEdge* edge);
+	virtual uint32_t ComputeCongestionCostFromBins(const std::vector<uint32_t>& bins);
+	virtual uint32_t GetCongestionBinCapacity(uint32_t bin);
+
+	virtual uint32_t GetRegionCount();
+	virtual uint32_t GetSiteRegion(PARGraphNode* site);
+	virtual int32_t GetNodeRegion(PARGraphNode* node);
+
+	virtual uint32_t GetNodeDelay(PARGraphNode* node);
+	virtual uint32_t GetEdgeDelay(PARGraphEdge* edge);
+	virtual bool IsTimingBoundary(PARGraphNode* node);
+	virtual bool IsTimingEdge(PARGraphEdge* edge);
+
+	virtual bool SanityCheck(const PARLabelRegistry& labels);
+	virtual PARGraphNode* GetPinnedSite(PARGraphNode* node);
+	bool CheckMatrixConstraints();
+	bool CheckCrossConnectionBound();
+	PARGraphNode* GetSiteByName(const std::string& name);
 
-	virtual uint32_t ComputeCongestionCost();
 	virtual bool InitialPlacement_core();
+	void ChoosePreferredMatrices(std::vector<uint32_t>& preferred);
+	void AssignUnconstrainedPins(const std::vector<uint32_t>& preferred, std::vector<PARGraphNode*>& placed);
+	bool MatchUnplacedNodes(const std::vector<uint32_t>& preferred, bool quiet = false);
+	void ApplyPreviousPlacement(std::vector<PARGraphNode*>& reused);
 
 	virtual bool CanMoveNode(PARGraphNode* node, PARGraphNode* old_mate, PARGraphNode* new_mate);
 
-	bool CantMoveSrc(Greenpak4BitstreamEntity* src);
-	bool CantMoveDst(Greenpak4BitstreamEntity* dst);
+	bool CantMoveSrc(PARGraphNode* src);
+	bool CantMoveDst(PARGraphNode* dst);
+
+	/**
+		@brief Returns the routing matrix a device site is in
+	 */
+	uint32_t GetSiteMatrix(PARGraphNode* site)
+	{ return m_sites->GetMatrix(site->GetIndex()); }
+
+	//Reasons each netlist edge gives for moving its endpoints (bitmask of BAD_* flags, indexed like m_netlistEdges)
+	enum
+	{
+		BAD_SRC_CROSSING	= 1,
+		BAD_SRC_UNROUTABLE	= 2,
+		BAD_DST_UNROUTABLE	= 4
+	};
+	std::vector<uint8_t> m_edgeBadness;
+
+	//Number of reasons each netlist node (by index) is bad, and how many of those are unroutable edges
+	std::vector<uint32_t> m_nodeBadReasons;
+	std::vector<uint32_t> m_nodeUnroutableReasons;
+
+	//The current bad nodes (in no particular order), and the position of each netlist node in it (-1 if absent)
+	std::vector<PARGraphNode*> m_badNodes;
+	std::vector<int32_t> m_badNodeSlots;
+
+	//Device sites for each label in each matrix (indexed [matrix][label]), built on first use.
+	//Sampling shuffles these in place, so the order is meaningless.
+	std::vector< std::vector< std::vector<PARGraphNode*> > > m_siteBuckets;
+
+	//Device sites by name, for LOC constraints (built on first use)
+	std::map<std::string, PARGraphNode*> m_siteNames;
+
+	//The device we're placing into (only used for read-only queries, so it can be shared between engines)
+	Greenpak4Device* m_pdev;
+
+	//Cached attributes of the device sites and netlist nodes (also shared)
+	const Greenpak4SiteTable* m_sites;
+
+	//Number of routing matrices in the device
+	uint32_t m_matrixCount;
+
+	//Number of cross connections from each matrix to each other one, indexed [src*m_matrixCount + dst].
+	//These are also our congestion bins (see CommitRouting()).
+	std::vector<uint32_t> m_crossCapacity;
+
+	//Accumulated overflow of each bin over past routing attempts (PathFinder history cost)
+	std::vector<uint32_t> m_congestionHistory;
 
-	//Cached list of unroutable nodes for the current iteration
-	std::set<PARGraphNode*> m_unroutableNodes;
+	//Placement of the previous run (NULL if we're not reusing one)
+	const placementmap* m_previousPlacement;
 
-	//used for error messages only
-	labelmap m_lmap;
+	//Names and site tables of our labels (shared, like the site table)
+	const PARLabelRegistry* m_labels;
 };
 
 #endif
@@ -0,0 +1,67 @@
+/***********************************************************************************************************************
+ * Copyright (C) 2016 Andrew Zonenberg and contributors                                                                *
+ *                                                                                                                     *
+ * This program is free software; you can redistribute it and/or modify it under the terms of the GNU Lesser General   *
+ * Public License as published by the Free Software Foundation; either version 2.1 of the License, or (at your option) *
+ * any later version.                                                                                                  *
+ *                                                                                                                     *
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied  *
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for     *
+ * more details.                                                                                                       *
+ *                                                                                                                     *
+ * You should have received a copy of the GNU Lesser General Public License along with this program; if not, you may   *
+ * find one here:                                                                                                      *
+ * https://www.gnu.org/licenses/old-licenses/lgpl-2.1.txt                                                              *
+ * or you may search the http://www.gnu.org website for the version 2.1 license, or you may write to the Free Software *
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA                                      *
+ **********************************************************************************************************************/
+
+
+#include "gp4par.h"
+#include <set>
+
+using namespace std;
+
+const int32_t Greenpak4SiteTable::NO_DUAL;
+const int32_t Greenpak4SiteTable::ANY_MATRIX;
+const int32_t Greenpak4SiteTable::BAD_MATRIX;
+
+Greenpak4SiteTable::Greenpak4SiteTable(PARGraph* netlist, PARGraph* device)
+	: m_portCount(PARGraph::GetNumPorts())
+{
+	uint32_t nsites = device->GetNumNodes();
+	m_matrix.resize(nsites);
+	m_dualMatrix.resize(nsites);
+	m_unique.resize(nsites);
+	m_fabricInput.assign(nsites * m_portCount, 0);
+	for(uint32_t i=0; i<nsites; i++)
+	{
+		PARGraphNode* site = device->GetNodeByIndex(i);
+		auto entity = static_cast<Greenpak4BitstreamEntity*>(site->GetData());
+		m_matrix[i] = entity->GetMatrix();
+		m_dualMatrix[i] = (entity->GetDual() != NULL) ? entity->GetDual()->GetMatrix() : NO_DUAL;
+		m_unique[i] = (device->GetNumNodesWithLabel(site->GetLabel()) == 1);
+
+		//The device graph already has the fabric ports (see MakeDeviceEdges()), just unpack them
+		for(uint32_t port=0; port<m_portCount; port++)
+			m_fabricInput[i*m_portCount + port] = site->HasFabricInput(port);
+	}
+
+	uint32_t nnodes = netlist->GetNumNodes();
+	m_locked.resize(nnodes);
+	m_matrixConstraint.assign(nnodes, ANY_MATRIX);
+	set<uint32_t> matrices(m_matrix.begin(), m_matrix.end());
+	for(uint32_t i=0; i<nnodes; i++)
+	{
+		auto entity = static_cast<Greenpak4NetlistEntity*>(netlist->GetNodeByIndex(i)->GetData());
+		auto cell = dynamic_cast<Greenpak4NetlistCell*>(entity);
+		m_locked[i] = (cell != NULL) && cell->HasLOC();
+
+		if( (cell != NULL) && cell->HasMatrixConstraint() )
+		{
+			int matrix = cell->GetMatrixConstraint();
+			bool valid = (matrix >= 0) && (matrices.find(matrix) != matrices.end());
+			m_matrixConstraint[i] = valid ? matrix : BAD_MATRIX;
+		}
+	}
+}
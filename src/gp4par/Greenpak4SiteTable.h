@@ -0,0 +1,106 @@
+/***********************************************************************************************************************
+ * Copyright (C) 2016 Andrew Zonenberg and contributors                                                                *
+ *                                                                                                                     *
+ * This program is free software; you can redistribute it and/or modify it under the terms of the GNU Lesser General   *
+ * Public License as published by the Free Software Foundation; either version 2.1 of the License, or (at your option) *
+ * any later version.                                                                                                  *
+ *                                                                                                                     *
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied  *
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for     *
+ * more details.                                                                                                       *
+ *                                                                                                                     *
+ * You should have received a copy of the GNU Lesser General Public License along with this program; if not, you may   *
+ * find one here:                                                                                                      *
+ * https://www.gnu.org/licenses/old-licenses/lgpl-2.1.txt                                                              *
+ * or you may search the http://www.gnu.org website for the version 2.1 license, or you may write to the Free Software *
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA                                      *
+ **********************************************************************************************************************/
+
+
+#ifndef Greenpak4SiteTable_h
+#define Greenpak4SiteTable_h
+
+/**
+	@brief Attributes of every device site (and netlist node) that the cost model and router look at all the time,
+	in flat arrays indexed by device node index (and port ID).
+
+	Built once the graphs are complete, and read-only from then on, so it can be shared between all engines working
+	on clones of the same graphs.
+ */
+class Greenpak4SiteTable
+{
+public:
+	Greenpak4SiteTable(PARGraph* netlist, PARGraph* device);
+
+	/**
+		@brief Returns the routing matrix a site is in
+	 */
+	uint32_t GetMatrix(uint32_t site) const
+	{ return m_matrix[site]; }
+
+	/**
+		@brief Returns the routing matrix a site's dual is in, or NO_DUAL if it has none
+	 */
+	int32_t GetDualMatrix(uint32_t site) const
+	{ return m_dualMatrix[site]; }
+
+	/**
+		@brief Returns true if a site is the only one with its label (so whatever is there can't go anywhere else)
+	 */
+	bool IsUnique(uint32_t site) const
+	{ return m_unique[site]; }
+
+	/**
+		@brief Returns true if a netlist node has a LOC constraint
+	 */
+	bool IsLocked(uint32_t node) const
+	{ return m_locked[node]; }
+
+	/**
+		@brief Returns the routing matrix a netlist node is constrained to by a MATRIX attribute, ANY_MATRIX if it
+		doesn't have one, or BAD_MATRIX if the value isn't a matrix number
+	 */
+	int32_t GetMatrixConstraint(uint32_t node) const
+	{ return m_matrixConstraint[node]; }
+
+	/**
+		@brief Returns true if the given input port of a site is driven from general fabric routing (same as
+		Greenpak4BitstreamEntity::IsGeneralFabricInput())
+	 */
+	bool IsGeneralFabricInput(uint32_t site, uint16_t port) const
+	{ return (port < m_portCount) && m_fabricInput[site*m_portCount + port]; }
+
+	/**
+		@brief Returns true if a route from src to the given input port of dst has to go through a cross connection
+		(same as Greenpak4Device::NeedsCrossConnection())
+	 */
+	bool NeedsCrossConnection(uint32_t src, uint32_t dst, uint16_t port) const
+	{
+		uint32_t dm = m_matrix[dst];
+		return
+			(m_matrix[src] != dm) &&
+			(m_dualMatrix[src] != static_cast<int32_t>(dm)) &&
+			IsGeneralFabricInput(dst, port);
+	}
+
+	static const int32_t NO_DUAL = -1;
+	static const int32_t ANY_MATRIX = -1;
+	static const int32_t BAD_MATRIX = -2;
+
+protected:
+
+	//Per site attributes
+	std::vector<uint32_t> m_matrix;
+	std::vector<int32_t> m_dualMatrix;
+	std::vector<uint8_t> m_unique;
+
+	//Per netlist node attributes
+	std::vector<uint8_t> m_locked;
+	std::vector<int32_t> m_matrixConstraint;
+
+	//General fabric input flags, indexed [site*m_portCount + port]
+	uint32_t m_portCount;
+	std::vector<uint8_t> m_fabricInput;
+};
+
+#endif
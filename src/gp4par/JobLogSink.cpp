@@ -0,0 +1,56 @@
+/***********************************************************************************************************************
+ * Copyright (C) 2016 Andrew Zonenberg and contributors                                                                *
+ *                                                                                                                     *
+ * This program is free software; you can redistribute it and/or modify it under the terms of the GNU Lesser General   *
+ * Public License as published by the Free Software Foundation; either version 2.1 of the License, or (at your option) *
+ * any later version.                                                                                                  *
+ *                                                                                                                     *
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied  *
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for     *
+ * more details.                                                                                                       *
+ *                                                                                                                     *
+ * You should have received a copy of the GNU Lesser General Public License along with this program; if not, you may   *
+ * find one here:                                                                                                      *
+ * https://www.gnu.org/licenses/old-licenses/lgpl-2.1.txt                                                              *
+ * or you may search the http://www.gnu.org website for the version 2.1 license, or you may write to the Free Software *
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA                                      *
+ **********************************************************************************************************************/
+
+#include "gp4par.h"
+
+using namespace std;
+
+thread_local LogSink* JobLogSink::m_jobSink = NULL;
+
+void JobLogBuffer::Log(Severity severity, const string& msg)
+{
+	m_messages.push_back(pair<Severity, string>(severity, msg));
+}
+
+void JobLogBuffer::Log(Severity severity, const char* format, va_list va)
+{
+	va_list va2;
+	va_copy(va2, va);
+	int len = vsnprintf(NULL, 0, format, va2);
+	va_end(va2);
+	if(len < 0)
+		return;
+
+	vector<char> buf(len + 1);
+	vsnprintf(&buf[0], buf.size(), format, va);
+	Log(severity, string(&buf[0], len));
+}
+
+/**
+	@brief Logs everything we kept again, as if it was being logged now
+
+	@param max_severity		Skip messages less important than this
+ */
+void JobLogBuffer::Replay(Severity max_severity) const
+{
+	for(auto& m : m_messages)
+	{
+		if(m.first <= max_severity)
+			::Log(m.first, "%s", m.second.c_str());
+	}
+}
@@ -0,0 +1,72 @@
+/***********************************************************************************************************************
+ * Copyright (C) 2016 Andrew Zonenberg and contributors                                                                *
+ *                                                                                                                     *
+ * This program is free software; you can redistribute it and/or modify it under the terms of the GNU Lesser General   *
+ * Public License as published by the Free Software Foundation; either version 2.1 of the License, or (at your option) *
+ * any later version.                                                                                                  *
+ *                                                                                                                     *
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied  *
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for     *
+ * more details.                                                                                                       *
+ *                                                                                                                     *
+ * You should have received a copy of the GNU Lesser General Public License along with this program; if not, you may   *
+ * find one here:                                                                                                      *
+ * https://www.gnu.org/licenses/old-licenses/lgpl-2.1.txt                                                              *
+ * or you may search the http://www.gnu.org website for the version 2.1 license, or you may write to the Free Software *
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA                                      *
+ **********************************************************************************************************************/
+
+#ifndef JobLogSink_h
+#define JobLogSink_h
+
+#include <cstdarg>
+#include <memory>
+#include <vector>
+
+/**
+	@brief Sends log messages from each worker thread to the log of the job it's running, and everything else to the
+	console.
+
+	Sinks are global, so this is the only way to keep jobs running on different threads out of each other's logs.
+ */
+class JobLogSink : public LogSink
+{
+public:
+	JobLogSink(LogSink* console)
+		: m_console(console)
+	{}
+
+	virtual void Log(Severity severity, const std::string& msg)
+	{ GetTarget()->Log(severity, msg); }
+
+	virtual void Log(Severity severity, const char* format, va_list va)
+	{ GetTarget()->Log(severity, format, va); }
+
+	//Sink for the job running on this thread (NULL if none)
+	static thread_local LogSink* m_jobSink;
+
+protected:
+	LogSink* GetTarget()
+	{ return (m_jobSink != NULL) ? m_jobSink : m_console.get(); }
+
+	std::unique_ptr<LogSink> m_console;
+};
+
+/**
+	@brief Keeps every message logged to it, so a job's log can be printed later (or not at all).
+
+	Used to run several attempts at once and only show the log of the one we end up using.
+ */
+class JobLogBuffer : public LogSink
+{
+public:
+	virtual void Log(Severity severity, const std::string& msg);
+	virtual void Log(Severity severity, const char* format, va_list va);
+
+	void Replay(Severity max_severity = Severity::DEBUG) const;
+
+protected:
+	std::vector< std::pair<Severity, std::string> > m_messages;
+};
+
+#endif
@@ -0,0 +1,210 @@
+/***********************************************************************************************************************
+ * Copyright (C) 2016 Andrew Zonenberg and contributors                                                                *
+ *                                                                                                                     *
+ * This program is free software; you can redistribute it and/or modify it under the terms of the GNU Lesser General   *
+ * Public License as published by the Free Software Foundation; either version 2.1 of the License, or (at your option) *
+ * any later version.                                                                                                  *
+ *                                                                                                                     *
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied  *
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for     *
+ * more details.                                                                                                       *
+ *                                                                                                                     *
+ * You should have received a copy of the GNU Lesser General Public License along with this program; if not, you may   *
+ * find one here:                                                                                                      *
+ * https://www.gnu.org/licenses/old-licenses/lgpl-2.1.txt                                                              *
+ * or you may search the http://www.gnu.org website for the version 2.1 license, or you may write to the Free Software *
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA                                      *
+ **********************************************************************************************************************/
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include "gp4par.h"
+
+using namespace std;
+
+/**
+	@brief One netlist to compile in batch mode
+ */
+class BatchJob
+{
+public:
+	BatchJob()
+		: line(0)
+		, ok(false)
+		, seconds(0)
+	{}
+
+	//Line of the job list the job came from
+	unsigned int line;
+
+	CompileOptions options;
+
+	//The netlist, or the template with --stamp (for the console summary)
+	std::string input;
+
+	//Where the job's log messages go
+	std::string logFile;
+
+	//Results
+	bool ok;
+	double seconds;
+};
+
+/**
+	@brief Applies the options from one job on top of the ones already set, with the same syntax as the command line
+
+	@return False (after printing why) if any of them are malformed
+ */
+bool ParseJobOptions(vector<string> args, CompileOptions& options)
+{
+	vector<char*> argv;
+	for(auto& a : args)
+		argv.push_back(&a[0]);
+
+	OptionResult result = OPTION_OK;
+	for(int i=0; (i<static_cast<int>(argv.size())) && (result == OPTION_OK); i++)
+	{
+		result = ParseOption(i, argv.size(), &argv[0], options);
+		if(result == OPTION_UNKNOWN)
+			printf("Unrecognized argument \"%s\"\n", argv[i]);
+	}
+	return (result == OPTION_OK);
+}
+
+/**
+	@brief Reads the job list, starting each job from the given defaults
+
+	@return True on success, false (after printing why) if any line is malformed
+ */
+static bool ReadJobList(const string& fname, const CompileOptions& defaults, vector<BatchJob>& jobs)
+{
+	FILE* fp = fopen(fname.c_str(), "r");
+	if(!fp)
+	{
+		printf("Couldn't open job list %s\n", fname.c_str());
+		return false;
+	}
+
+	bool ok = true;
+	char buf[4096];
+	unsigned int nline = 0;
+	while(fgets(buf, sizeof(buf), fp))
+	{
+		nline ++;
+		vector<string> args = SplitJobLine(buf);
+		if(args.empty())
+			continue;
+
+		BatchJob job;
+		job.line = nline;
+		job.options = defaults;
+
+		//--jobs on the command line is the number of jobs to run at once, so each job is single threaded
+		//unless its own line says otherwise
+		job.options.par.jobs = 1;
+
+		if(!ParseJobOptions(args, job.options))
+		{
+			printf("(in %s line %u)\n", fname.c_str(), nline);
+			ok = false;
+			continue;
+		}
+
+		auto& o = job.options;
+		bool has_input = (o.stampFile != "") || ( (o.netlistFile != "") && (o.netlistFile != "-") );
+		if(!has_input || (o.outputFile == ""))
+		{
+			printf("%s line %u: every job needs a netlist file (or --stamp) and --output\n", fname.c_str(), nline);
+			ok = false;
+			continue;
+		}
+
+		job.input = (o.stampFile != "") ? o.stampFile : o.netlistFile;
+		job.logFile = o.outputFile + ".log";
+		jobs.push_back(job);
+	}
+
+	fclose(fp);
+	return ok;
+}
+
+/**
+	@brief Compiles every netlist in a job list, in one process.
+
+	Jobs run on a pool of threads (the number given by --jobs). Options on the command line are the defaults for every
+	job, and each line of the job list adds the netlist, the output, and any other options exactly as they would be
+	given on the command line. Each job's log goes to its output file name plus ".log", and only a one-line summary of
+	each job is printed to the console.
+
+	@return True if every job succeeded
+ */
+bool RunBatch(const string& fname, const CompileOptions& defaults, Severity console_verbosity)
+{
+	vector<BatchJob> jobs;
+	if(!ReadJobList(fname, defaults, jobs))
+		return false;
+
+	JobLogSink* sink = new JobLogSink(new STDLogSink(console_verbosity));
+	g_log_sinks.emplace(g_log_sinks.begin(), sink);
+
+	unsigned int nthreads = min<size_t>(defaults.par.jobs, jobs.size());
+	LogNotice("\nRunning %zu jobs from %s (%u threads)...\n", jobs.size(), fname.c_str(), nthreads);
+
+	atomic<unsigned int> next_job(0);
+	atomic<unsigned int> done(0);
+	auto worker = [&]()
+	{
+		while(true)
+		{
+			unsigned int i = next_job ++;
+			if(i >= jobs.size())
+				break;
+			auto& job = jobs[i];
+
+			auto start = chrono::steady_clock::now();
+			FILE* fp = fopen(job.logFile.c_str(), "w");
+			if(fp)
+			{
+				//The sink closes the file when it's done
+				FILELogSink log(fp, false, Severity::VERBOSE);
+				JobLogSink::m_jobSink = &log;
+				job.ok = Compile(job.options);
+				JobLogSink::m_jobSink = NULL;
+			}
+			job.seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+			unsigned int n = ++done;
+			if(!fp)
+				LogError("[%u/%zu] %s: couldn't open log file %s\n", n, jobs.size(), job.input.c_str(),
+					job.logFile.c_str());
+			else if(job.ok)
+				LogNotice("[%u/%zu] %s -> %s (%.2f s)\n", n, jobs.size(), job.input.c_str(),
+					job.options.outputFile.c_str(), job.seconds);
+			else
+				LogError("[%u/%zu] %s failed, see %s\n", n, jobs.size(), job.input.c_str(),
+					job.logFile.c_str());
+		}
+	};
+
+	vector<thread> threads;
+	for(unsigned int i=0; i<nthreads; i++)
+		threads.push_back(thread(worker));
+	for(auto& t : threads)
+		t.join();
+
+	unsigned int failed = 0;
+	for(auto& job : jobs)
+	{
+		if(!job.ok)
+			failed ++;
+	}
+	if(failed)
+	{
+		LogError("%u of %zu jobs failed\n", failed, jobs.size());
+		return false;
+	}
+
+	LogNotice("All %zu jobs succeeded\n", jobs.size());
+	return true;
+}
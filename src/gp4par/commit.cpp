@@ -16,6 +16,9 @@
  * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA                                      *
  **********************************************************************************************************************/
 
+#include <algorithm>
+#include <atomic>
+#include <thread>
 #include "gp4par.h"
 
 using namespace std;
@@ -23,7 +26,12 @@ using namespace std;
 /**
 	@brief After a successful PAR, copy all of the data from the unplaced to placed nodes
  */
-bool CommitChanges(PARGraph* device, Greenpak4Device* pdev, unsigned int* num_routes_used)
+bool CommitChanges(
+	PARGraph* netlist,
+	PARGraph* device,
+	Greenpak4Device* pdev,
+	const Greenpak4SiteTable& sites,
+	vector<unsigned int>& num_routes_used)
 {
 	LogNotice("\nBuilding post-route netlist...\n");
 
@@ -50,24 +58,152 @@ bool CommitChanges(PARGraph* device, Greenpak4Device* pdev, unsigned int* num_ro
 
 	//Done configuring all of the nodes!
 	//Configure routes between them
-	if(!CommitRouting(device, pdev, num_routes_used))
+	if(!CommitRouting(netlist, device, pdev, sites, num_routes_used))
 		return false;
 
 	return true;
 }
 
+/**
+	@brief Commits several placements of the same design at once and runs the post-route DRC on each, to find the
+	first one that will actually work.
+
+	Each candidate is committed to its own configuration layer of pdev (see Greenpak4Device::CreateConfigLayer()) on
+	its own copy of the graphs, so pdev and the candidates' graphs aren't touched and up to options.jobs candidates
+	run concurrently. Their logs are thrown away; only a one-line result for each is printed.
+
+	@param candidates	Netlist and device graph of each placement, best first. The device graphs point to pdev.
+
+	@return Index of the first candidate that commits and passes DRC, or -1 if none of them do
+ */
+int CommitCandidates(
+	const vector< pair<PARGraph*, PARGraph*> >& candidates,
+	Greenpak4Device* pdev,
+	const Greenpak4SiteTable& sites,
+	const PAROptions& options)
+{
+	LogNotice("\nChecking %zu candidate placements...\n", candidates.size());
+	LogIndenter li;
+
+	//Result of each candidate: 0 = passed, 1 = routing failed, 2 = DRC failed
+	vector<int> results(candidates.size(), 0);
+
+	atomic<unsigned int> next(0);
+	auto worker = [&]()
+	{
+		while(true)
+		{
+			unsigned int i = next ++;
+			if(i >= candidates.size())
+				break;
+
+			Greenpak4Device* layer = pdev->CreateConfigLayer();
+			PARGraph* netlist;
+			PARGraph* device;
+			PARGraph::ClonePair(candidates[i].first, candidates[i].second, netlist, device);
+			RebindDeviceGraph(device, pdev, layer);
+
+			//The DRC report only goes to the real device's files, and we're already running in parallel
+			PAROptions drc_options = options;
+			drc_options.drcReportFile = "";
+			drc_options.jobs = 1;
+
+			JobLogBuffer log;
+			JobLogSink::m_jobSink = &log;
+			{
+				vector<unsigned int> num_routes_used;
+				Greenpak4DRCReport drc;
+				if(!CommitChanges(netlist, device, layer, sites, num_routes_used))
+					results[i] = 1;
+				else if(!PostPARDRC(netlist, device, layer, drc_options, drc))
+					results[i] = 2;
+			}
+			JobLogSink::m_jobSink = NULL;
+
+			delete netlist;
+			delete device;
+			delete layer;
+		}
+	};
+
+	unsigned int jobs = min<size_t>(max(1u, options.jobs), candidates.size());
+	vector<thread> threads;
+	for(unsigned int i=0; i<jobs; i++)
+		threads.push_back(thread(worker));
+	for(auto& t : threads)
+		t.join();
+
+	const char* names[] = { "passed", "routing failed", "DRC failed" };
+	int winner = -1;
+	for(size_t i=0; i<candidates.size(); i++)
+	{
+		LogVerbose("Candidate %zu: %s\n", i, names[results[i]]);
+		if( (winner < 0) && (results[i] == 0) )
+			winner = i;
+	}
+	return winner;
+}
+
+/**
+	@brief One signal that has to cross from one routing matrix to another, and everything it drives there
+ */
+struct CrossDemand
+{
+	CrossDemand(Greenpak4EntityOutput n, unsigned int src, unsigned int dst)
+		: net(n)
+		, srcmatrix(src)
+		, dstmatrix(dst)
+	{}
+
+	Greenpak4EntityOutput net;
+	unsigned int srcmatrix;
+	unsigned int dstmatrix;
+
+	//The netlist edges it drives in the destination matrix
+	vector<PARGraphEdge*> edges;
+};
+
+/**
+	@brief Names the netlist cell or port driving an edge, for error messages
+ */
+static string GetSourceName(PARGraphEdge* edge)
+{
+	auto source = static_cast<Greenpak4NetlistEntity*>(edge->m_sourcenode->GetData());
+	auto sport = dynamic_cast<Greenpak4NetlistPort*>(source);
+	auto scell = dynamic_cast<Greenpak4NetlistCell*>(source);
+	if(scell != NULL)
+		return "cell " + scell->m_name + " port " + edge->GetSourcePortName();
+	else if(sport != NULL)
+		return "port " + sport->m_name;
+	return "[invalid]";
+}
+
 /**
 	@brief Commit post-PAR results from the netlist to the routing matrix
+
+	We find every signal that has to cross between matrices before allocating anything, so that each one only uses one
+	cross connection however many loads it has, and so if we run out we can say exactly which signals didn't fit.
+	Signals whose source has a dual in the destination matrix are taken from the dual instead, and need no cross
+	connection at all.
  */
-bool CommitRouting(PARGraph* device, Greenpak4Device* pdev, unsigned int* num_routes_used)
+bool CommitRouting(
+	PARGraph* netlist,
+	PARGraph* device,
+	Greenpak4Device* pdev,
+	const Greenpak4SiteTable& sites,
+	vector<unsigned int>& num_routes_used)
 {
-	num_routes_used[0] = 0;
-	num_routes_used[1] = 0;
+	//Cross connections needed between each pair of matrices, indexed [src*nmatrix + dst]
+	unsigned int nmatrix = pdev->GetMatrixCount();
+	num_routes_used.assign(nmatrix * nmatrix, 0);
 
-	//Map of source net to cross-connection output
-	map<Greenpak4EntityOutput, Greenpak4EntityOutput> nodemap;
+	//Signals that need cross connections, in the order we found them, and the index of each (plus one, zero if we
+	//haven't seen it yet) by netlist net and destination matrix, indexed [net*nmatrix + dst]
+	vector<CrossDemand> demands;
+	vector<size_t> demandindex(static_cast<size_t>(netlist->GetNumNets()) * nmatrix, 0);
 
-	bool ran_out = false;
+	//Routes within one matrix (or over dedicated routing), which we can make straight away
+	vector< pair<PARGraphEdge*, Greenpak4EntityOutput> > direct;
 
 	for(uint32_t i=0; i<device->GetNumNodes(); i++)
 	{
@@ -77,75 +213,107 @@ bool CommitRouting(PARGraph* device, Greenpak4Device* pdev, unsigned int* num_ro
 		if(netnode == NULL)
 			continue;
 
-		//Commit changes to all edges.
 		//Iterate over the NETLIST graph, not the DEVICE graph, but then transfer to the device graph
 		for(uint32_t i=0; i<netnode->GetEdgeCount(); i++)
 		{
 			auto edge = netnode->GetEdgeByIndex(i);
-			auto src = static_cast<Greenpak4BitstreamEntity*>(edge->m_sourcenode->GetMate()->GetData());
-			auto dst = static_cast<Greenpak4BitstreamEntity*>(edge->m_destnode->GetMate()->GetData());
+			PARGraphNode* srcsite = edge->m_sourcenode->GetMate();
+			PARGraphNode* dstsite = edge->m_destnode->GetMate();
+			auto src = static_cast<Greenpak4BitstreamEntity*>(srcsite->GetData());
 
 			//If the source node has a dual, use the secondary output if needed
-			//so we don't waste cross connections
-			if(src->GetDual())
+			//so we don't waste cross connections (this is also how constants get tied to the local rail)
+			unsigned int dstmatrix = sites.GetMatrix(dstsite->GetIndex());
+			if( (sites.GetMatrix(srcsite->GetIndex()) != dstmatrix) &&
+				(sites.GetDualMatrix(srcsite->GetIndex()) == static_cast<int32_t>(dstmatrix)) )
 			{
-				if(dst->GetMatrix() != src->GetMatrix())
-					src = src->GetDual();
+				src = src->GetDual();
 			}
 
 			//Look up the actual NET (not just the entity) for the source.
 			//If we don't do this we risk merging cross-connections that should not be (see github issue #13)
-			Greenpak4EntityOutput srcnet = src->GetOutput(edge->m_sourceport);
+			Greenpak4EntityOutput srcnet = src->GetOutputByID(edge->m_sourceport);
 
 			//Cross connections
 			//Only use these if destination node is general fabric routing; dedicated routing can cross between
 			//the matrices freely
 			unsigned int srcmatrix = src->GetMatrix();
-			if( (srcmatrix != dst->GetMatrix()) && dst->IsGeneralFabricInput(edge->m_destport) )
+			if( (srcmatrix == dstmatrix) || !sites.IsGeneralFabricInput(dstsite->GetIndex(), edge->m_destport) )
 			{
-				//Reuse existing connections, if any
-				if(nodemap.find(srcnet) != nodemap.end())
-					srcnet = nodemap[srcnet];
-
-				//Allocate a new cross-connection
-				else
-				{
-					//We need to jump from one matrix to another!
-					//Make sure we have a free cross-connection to use
-					if(num_routes_used[srcmatrix] >= 10)
-						ran_out = true;
-
-					else
-					{
-						//Save our cross-connection and mark it as used
-						auto xconn = pdev->GetCrossConnection(srcmatrix, num_routes_used[srcmatrix]);
-
-
-						//Insert the cross-connection into the path
-						xconn->SetInput("I", srcnet);
-						Greenpak4EntityOutput newsrc = xconn->GetOutput("O");
-						nodemap[srcnet] = newsrc;
-						srcnet = newsrc;
-					}
-
-					num_routes_used[srcmatrix] ++;
-				}
+				direct.push_back(pair<PARGraphEdge*, Greenpak4EntityOutput>(edge, srcnet));
+				continue;
 			}
 
-			//Yay virtual functions - we can set the input without caring about the node type
-			if(!ran_out)
-				dst->SetInput(edge->m_destport, srcnet);
+			//All loads of one net in the same matrix share a cross connection (the same grouping the PAR congestion
+			//cost assumes, see Greenpak4PAREngine::EdgeCongestionNet())
+			size_t& index = demandindex[static_cast<size_t>(edge->m_net)*nmatrix + dstmatrix];
+			if(index == 0)
+			{
+				demands.push_back(CrossDemand(srcnet, srcmatrix, dstmatrix));
+				index = demands.size();
+				num_routes_used[srcmatrix*nmatrix + dstmatrix] ++;
+			}
+			demands[index - 1].edges.push_back(edge);
 		}
 	}
 
-	//Don't fail until we attempt full routing.
-	//This lets us see how much over the limit we went
-	if(ran_out)
+	//Make sure every pair of matrices has enough cross connections before we allocate any.
+	//Check them all so the user sees everything that's over the limit, not just the first
+	bool ran_out = false;
+	for(unsigned int srcmatrix=0; srcmatrix<nmatrix; srcmatrix++)
 	{
-		LogError(
-			"More than 100%% of device resources are used "
-			"(cross connections)\n");
+		for(unsigned int dstmatrix=0; dstmatrix<nmatrix; dstmatrix++)
+		{
+			unsigned int needed = num_routes_used[srcmatrix*nmatrix + dstmatrix];
+			unsigned int available = pdev->GetCrossConnectionCount(srcmatrix, dstmatrix);
+			if(needed <= available)
+				continue;
+
+			if(!ran_out)
+			{
+				LogError(
+					"More than 100%% of device resources are used "
+					"(cross connections)\n");
+			}
+			ran_out = true;
+
+			LogError("%u signals need to cross from matrix %u to matrix %u, but there are only %u cross connections:\n",
+				needed, srcmatrix, dstmatrix, available);
+			LogIndenter li;
+			for(auto& demand : demands)
+			{
+				if( (demand.srcmatrix != srcmatrix) || (demand.dstmatrix != dstmatrix) )
+					continue;
+				LogError("%s (mapped to %s, %zu loads)\n",
+					GetSourceName(demand.edges[0]).c_str(),
+					demand.net.GetOutputName().c_str(),
+					demand.edges.size());
+			}
+		}
+	}
+	if(ran_out)
 		return false;
+
+	//Everything fits, so hand out the cross connections in the order we found the signals
+	vector<unsigned int> next(nmatrix * nmatrix, 0);
+	for(auto& demand : demands)
+	{
+		unsigned int& index = next[demand.srcmatrix*nmatrix + demand.dstmatrix];
+		auto xconn = pdev->GetCrossConnection(demand.srcmatrix, demand.dstmatrix, index);
+		index ++;
+
+		//Insert the cross-connection into the path
+		xconn->SetInput("I", demand.net);
+		Greenpak4EntityOutput newsrc = xconn->GetOutput("O");
+		for(auto edge : demand.edges)
+			direct.push_back(pair<PARGraphEdge*, Greenpak4EntityOutput>(edge, newsrc));
+	}
+
+	//Yay virtual functions - we can set the input without caring about the node type
+	for(auto& route : direct)
+	{
+		auto dst = static_cast<Greenpak4BitstreamEntity*>(route.first->m_destnode->GetMate()->GetData());
+		dst->SetInputByID(route.first->m_destport, route.second);
 	}
 
 	return true;
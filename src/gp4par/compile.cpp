@@ -0,0 +1,784 @@
+/***********************************************************************************************************************
+ * Copyright (C) 2016 Andrew Zonenberg and contributors                                                                *
+ *                                                                                                                     *
+ * This program is free software; you can redistribute it and/or modify it under the terms of the GNU Lesser General   *
+ * Public License as published by the Free Software Foundation; either version 2.1 of the License, or (at your option) *
+ * any later version.                                                                                                  *
+ *                                                                                                                     *
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied  *
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for     *
+ * more details.                                                                                                       *
+ *                                                                                                                     *
+ * You should have received a copy of the GNU Lesser General Public License along with this program; if not, you may   *
+ * find one here:                                                                                                      *
+ * https://www.gnu.org/licenses/old-licenses/lgpl-2.1.txt                                                              *
+ * or you may search the http://www.gnu.org website for the version 2.1 license, or you may write to the Free Software *
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA                                      *
+ **********************************************************************************************************************/
+
+#include <sys/stat.h>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include "gp4par.h"
+
+using namespace std;
+
+static bool PrintConfiguration(const CompileOptions& options);
+static DeviceModelPreloader* StartPreload(const CompileOptions& options);
+static bool CompileBuffer(const char* json, size_t len, const CompileOptions& options, CompileResult& result);
+static bool CompileUncached(const char* json, size_t len, const CompileOptions& options, CompileResult& result);
+static bool CompileAutoPart(const char* json, size_t len, const CompileOptions& options, CompileResult& result);
+static void KeepAttempt(CompileResult& result, const CompileResult& attempt);
+static bool CompileLoadedNetlist(Greenpak4Netlist& netlist, const CompileOptions& options, CompileResult& result);
+static string FormatStatistics(const CompileResult& result, bool ok);
+
+//The parts --part auto tries, cheapest first. The SLG46621 is left out since dual supplies are a board-level decision.
+static const Greenpak4Device::GREENPAK4_PART g_autoParts[] =
+{
+	Greenpak4Device::GREENPAK4_SLG46140,
+	Greenpak4Device::GREENPAK4_SLG46620
+};
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Top level flow
+
+/**
+	@brief Compiles one netlist file to a bitstream file
+
+	@return True on success, false (after logging why) on failure
+ */
+bool Compile(const CompileOptions& options)
+{
+	if(!options.stampFile.empty())
+		return StampTemplate(options);
+
+	CompileResult result;
+	bool ok = CompileFile(options, result);
+
+	//Write the final bitstream
+	if(ok)
+	{
+		LogNotice("\nWriting final bitstream to output file \"%s\", using ID code 0x%x.\n",
+			options.outputFile.c_str(), (int)options.userid);
+		LogIndenter li;
+		TraceSpan span("Write bitstream");
+		auto start = chrono::steady_clock::now();
+		ok = WriteOutputFile(options.outputFile, result.bitstream, options.format == Greenpak4Device::FORMAT_BINARY);
+		if(ok && !options.templateFile.empty())
+			ok = WriteOutputFile(options.templateFile, result.stampTemplate, true);
+		result.stats.EndPhase("write_bitstream", start);
+	}
+
+	//Say where the time went (even if we failed, that's when it's most interesting)
+	if(!options.statsFile.empty())
+	{
+		if(!WriteOutputFile(options.statsFile, FormatStatistics(result, ok)))
+			return false;
+	}
+
+	return ok;
+}
+
+/**
+	@brief Compiles one netlist file, without writing the bitstream anywhere
+
+	options.outputFile is ignored; the bitstream ends up in result.bitstream instead.
+
+	@return True on success, false (after logging why) on failure. The DRC report is filled in even if the DRC fails.
+ */
+bool CompileFile(const CompileOptions& options, CompileResult& result)
+{
+	TraceSpan span("Compile");
+	if(!PrintConfiguration(options))
+		return false;
+
+	LogNotice("\nLoading Yosys JSON file \"%s\".\n", options.netlistFile.c_str());
+	unique_ptr<DeviceModelPreloader> preload(StartPreload(options));
+
+	//Test multiplexing: merge all of the netlists and compile them as one
+	auto start = chrono::steady_clock::now();
+	if(!options.mergeFiles.empty())
+	{
+		vector<string> files = options.mergeFiles;
+		files.insert(files.begin(), options.netlistFile);
+		string json;
+		vector<MergedPort> ports;
+		bool ok = MergeNetlists(files, json, ports);
+		result.stats.EndPhase("merge_netlists", start);
+		if(!ok || !CompileBuffer(json.c_str(), json.size(), options, result))
+			return false;
+
+		if(options.manifestFile.empty())
+			return true;
+		LogNotice("\nWriting merged netlist manifest to \"%s\".\n", options.manifestFile.c_str());
+		return WriteOutputFile(options.manifestFile, FormatMergeManifest(ports, result.placement));
+	}
+
+	//The result cache key covers the whole netlist, --part auto parses it once per part, and remote seed sweeps send
+	//it to other servers, so they all need all of it in memory
+	bool remote = !options.par.remoteServers.empty() && (options.par.seeds > 1);
+	if( (options.resultCache != "") || options.autoPart || remote)
+	{
+		string json;
+		bool ok = ReadInputFile(options.netlistFile, json);
+		result.stats.EndPhase("read_netlist", start);
+		if(!ok)
+			return false;
+		return CompileBuffer(json.c_str(), json.size(), options, result);
+	}
+
+	//Otherwise, let the netlist map the file (or use its own cache)
+	Greenpak4Netlist netlist(options.netlistFile, options.netlistCache, GetNetlistCacheSalt());
+	result.stats.EndPhase("load_netlist", start);
+	if(!netlist.Validate())
+		return false;
+
+	return CompileLoadedNetlist(netlist, options, result);
+}
+
+/**
+	@brief Compiles a yosys JSON netlist that's already in memory
+
+	options.netlistFile and options.outputFile are ignored; the bitstream ends up in result.bitstream instead.
+
+	@param json		The netlist (copied, so it doesn't have to outlive the call)
+	@param len		Size of the netlist, in bytes
+	@param options	Device and PAR settings
+	@param result	Set to the bitstream and reports
+
+	@return True on success, false (after logging why) on failure. The DRC report is filled in even if the DRC fails.
+ */
+bool CompileJSON(const char* json, size_t len, const CompileOptions& options, CompileResult& result)
+{
+	TraceSpan span("Compile");
+	if(!PrintConfiguration(options))
+		return false;
+
+	LogNotice("\nLoading Yosys JSON netlist (%zu bytes).\n", len);
+	unique_ptr<DeviceModelPreloader> preload(StartPreload(options));
+	return CompileBuffer(json, len, options, result);
+}
+
+/**
+	@brief Compiles a netlist the caller has already loaded
+
+	PAR optimizes the netlist in place, so it can't be compiled again afterwards. options.netlistFile and
+	options.outputFile are ignored.
+
+	@return True on success, false (after logging why) on failure. The DRC report is filled in even if the DRC fails.
+ */
+bool CompileNetlist(Greenpak4Netlist& netlist, const CompileOptions& options, CompileResult& result)
+{
+	TraceSpan span("Compile");
+	if(!PrintConfiguration(options))
+		return false;
+
+	if(!netlist.Validate())
+	{
+		LogError("Can't compile a netlist that failed to load\n");
+		return false;
+	}
+	if(options.autoPart)
+	{
+		LogError("--part auto needs to load the netlist once per part, use CompileJSON() or CompileFile() instead\n");
+		return false;
+	}
+
+	return CompileLoadedNetlist(netlist, options, result);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Helpers
+
+/**
+	@brief Starts building the device model while the netlist loads, if it's going to be needed
+
+	@return The preloader (to be deleted once the netlist is loaded, or later), or NULL if we aren't preloading
+ */
+static DeviceModelPreloader* StartPreload(const CompileOptions& options)
+{
+	//With --part auto we don't know which part yet. With a result cache, a hit doesn't need the model at all and
+	//shouldn't have to wait for it to be built.
+	if(options.autoPart || (options.resultCache != ""))
+		return NULL;
+	return new DeviceModelPreloader(options.part);
+}
+
+/**
+	@brief Prints the device settings we're about to use
+
+	@return False if the settings are invalid
+ */
+static bool PrintConfiguration(const CompileOptions& options)
+{
+	LogNotice("\nDevice configuration:\n");
+	{
+		LogIndenter li;
+
+		string dev = options.autoPart ? "auto (smallest that fits)" : GetPartName(options.part);
+		LogNotice("Target device:   %s\n", dev.c_str());
+		LogNotice("VCC range:       not yet implemented\n");
+
+		string pull;
+		string drive;
+
+		switch(options.unusedPull)
+		{
+			case Greenpak4IOB::PULL_NONE:
+				pull = "float";
+				break;
+
+			case Greenpak4IOB::PULL_DOWN:
+				pull = "pull down with ";
+				break;
+
+			case Greenpak4IOB::PULL_UP:
+				pull = "pull up with ";
+				break;
+
+			default:
+				LogError("Invalid pull direction\n");
+				return false;
+		}
+
+		if(options.unusedPull != Greenpak4IOB::PULL_NONE)
+		{
+			switch(options.unusedDrive)
+			{
+				case Greenpak4IOB::PULL_10K:
+					drive = "10K";
+					break;
+
+				case Greenpak4IOB::PULL_100K:
+					drive = "100K";
+					break;
+
+				case Greenpak4IOB::PULL_1M:
+					drive = "1M";
+					break;
+
+				default:
+					LogError("Invalid pull strength\n");
+					return false;
+			}
+		}
+
+		LogNotice("Unused pins:     %s %s\n", pull.c_str(), drive.c_str());
+
+		LogNotice("User ID code:    %02x\n", options.userid);
+		LogNotice("Read protection: %s\n", options.readProtect ? "enabled" : "disabled");
+		LogNotice("I/O precharge:   %s\n", options.ioPrecharge ? "enabled" : "disabled");
+		LogNotice("Charge pump:     %s\n", options.disableChargePump ? "off" : "auto");
+		LogNotice("LDO:             %s\n", options.ldoBypass ? "bypassed" : "enabled");
+		LogNotice("Boot retry:      %d times\n", options.bootRetry);
+	}
+
+	return true;
+}
+
+/**
+	@brief Gets the full name of a part, as printed on the package
+ */
+string GetPartName(Greenpak4Device::GREENPAK4_PART part)
+{
+	switch(part)
+	{
+		case Greenpak4Device::GREENPAK4_SLG46620:
+			return "SLG46620V";
+
+		case Greenpak4Device::GREENPAK4_SLG46621:
+			return "SLG46621V";
+
+		case Greenpak4Device::GREENPAK4_SLG46140:
+			return "SLG46140V";
+	}
+
+	return "<invalid>";
+}
+
+/**
+	@brief Reads an entire netlist or other input file into memory ("-" for stdin)
+ */
+bool ReadInputFile(string fname, string& data)
+{
+	FILE* fp = (fname == "-") ? stdin : fopen(fname.c_str(), "rb");
+	if(!fp)
+	{
+		LogError("Failed to open input file %s\n", fname.c_str());
+		return false;
+	}
+
+	char chunk[65536];
+	size_t len;
+	while( (len = fread(chunk, 1, sizeof(chunk), fp)) > 0)
+		data.append(chunk, len);
+
+	bool ok = !ferror(fp);
+	if(fp != stdin)
+		fclose(fp);
+	if(!ok)
+		LogError("Failed to read input file %s\n", fname.c_str());
+	return ok;
+}
+
+/**
+	@brief Compiles a netlist that's in memory, reusing the cached result if we've compiled it before
+ */
+static bool CompileBuffer(const char* json, size_t len, const CompileOptions& options, CompileResult& result)
+{
+	//A cached result doesn't run PAR, so there'd be no moves to record or replay
+	bool log_moves = !options.par.recordMovesFile.empty() || !options.par.replayMovesFile.empty();
+	if( (options.resultCache == "") || log_moves)
+		return CompileUncached(json, len, options, result);
+
+	auto start = chrono::steady_clock::now();
+	CompileCache cache(options, json, len);
+	bool hit = cache.Load(result);
+	result.stats.EndPhase("result_cache", start);
+	if(hit)
+	{
+		//Repeat the DRC results, and write out the reports, just like a real compile would
+		if(!result.drc.GetViolations().empty())
+		{
+			LogNotice("\nDesign rule violations found when the cached result was compiled:\n");
+			LogIndenter li;
+			result.drc.Print();
+		}
+		if(!options.par.drcReportFile.empty())
+		{
+			if(!result.drc.WriteJSON(options.par.drcReportFile))
+				return false;
+		}
+		if(!options.par.timingReportFile.empty())
+		{
+			if(!WriteOutputFile(options.par.timingReportFile, result.timingReport))
+				return false;
+		}
+		if(!options.par.placementFile.empty())
+		{
+			if(!WriteOutputFile(options.par.placementFile, result.placement))
+				return false;
+		}
+		return true;
+	}
+
+	if(!CompileUncached(json, len, options, result))
+		return false;
+
+	cache.Store(result);
+	return true;
+}
+
+/**
+	@brief Compiles a netlist that's in memory, without looking in the result cache
+ */
+static bool CompileUncached(const char* json, size_t len, const CompileOptions& options, CompileResult& result)
+{
+	if(options.autoPart)
+		return CompileAutoPart(json, len, options, result);
+
+	//Run the seeds on the remote servers if we can, and then all that's left to do here is commit the winner
+	CompileOptions local = options;
+	if(!options.par.remoteServers.empty() && (options.par.seeds > 1))
+	{
+		auto start = chrono::steady_clock::now();
+		RemoteSeedSweep(json, len, options, local.par.fixedPlacement);
+		result.stats.EndPhase("remote_seeds", start);
+		if( (options.par.cancel != NULL) && *options.par.cancel )
+		{
+			LogError("PAR cancelled\n");
+			return false;
+		}
+	}
+
+	auto start = chrono::steady_clock::now();
+	Greenpak4Netlist netlist(json, len, options.netlistCache, GetNetlistCacheSalt());
+	result.stats.EndPhase("load_netlist", start);
+	if(!netlist.Validate())
+		return false;
+	return CompileLoadedNetlist(netlist, local, result);
+}
+
+/**
+	@brief Compiles a netlist for every part --part auto can pick at once, and keeps the cheapest one that works.
+
+	Each attempt has its own copy of the netlist (PAR modifies it). Parts the design is too big for fail the
+	feasibility checks before placement starts, so they cost little more than parsing. As soon as a part works, the
+	attempts on more expensive parts are cancelled.
+
+	Only the log of the attempt we keep is printed (for the others, just their errors). The logs are kept apart by
+	JobLogSink, so if the caller hasn't installed one they'll be mixed together instead.
+ */
+static bool CompileAutoPart(const char* json, size_t len, const CompileOptions& options, CompileResult& result)
+{
+	const size_t count = sizeof(g_autoParts) / sizeof(g_autoParts[0]);
+	LogNotice("\nTrying %zu parts in parallel...\n", count);
+
+	class Attempt
+	{
+	public:
+		Attempt()
+			: ok(false)
+			, done(false)
+			, cancel(false)
+		{}
+
+		CompileOptions options;
+		CompileResult result;
+		JobLogBuffer log;
+		bool ok;
+		bool done;
+		atomic<bool> cancel;
+	};
+	vector<Attempt> attempts(count);
+
+	mutex lock;
+	condition_variable finished;
+	vector<thread> threads;
+	for(size_t i=0; i<count; i++)
+	{
+		auto& attempt = attempts[i];
+		attempt.options = options;
+		attempt.options.autoPart = false;
+		attempt.options.part = g_autoParts[i];
+		attempt.options.par.cancel = &attempt.cancel;
+
+		threads.push_back(thread([&, i]()
+		{
+			auto& me = attempts[i];
+			JobLogSink::m_jobSink = &me.log;
+			LogNotice("\nTrying %s...\n", GetPartName(me.options.part).c_str());
+			{
+				auto start = chrono::steady_clock::now();
+				Greenpak4Netlist netlist(json, len, me.options.netlistCache, GetNetlistCacheSalt());
+				me.result.stats.EndPhase("load_netlist", start);
+				me.ok = netlist.Validate() && CompileLoadedNetlist(netlist, me.options, me.result);
+			}
+			JobLogSink::m_jobSink = NULL;
+
+			//Bigger parts aren't any use to us now
+			lock_guard<mutex> guard(lock);
+			me.done = true;
+			if(me.ok)
+			{
+				for(size_t j=i+1; j<count; j++)
+					attempts[j].cancel = true;
+			}
+			finished.notify_all();
+		}));
+	}
+
+	//Wait for everything to finish, passing on any request to cancel the whole compile
+	{
+		unique_lock<mutex> guard(lock);
+		while(true)
+		{
+			bool all_done = true;
+			for(auto& a : attempts)
+				all_done = all_done && a.done;
+			if(all_done)
+				break;
+
+			if( (options.par.cancel != NULL) && *options.par.cancel)
+			{
+				for(auto& a : attempts)
+					a.cancel = true;
+			}
+			finished.wait_for(guard, chrono::milliseconds(100));
+		}
+	}
+	for(auto& t : threads)
+		t.join();
+
+	//Use the cheapest part that worked
+	for(auto& a : attempts)
+	{
+		if(!a.ok)
+			continue;
+
+		a.log.Replay();
+		KeepAttempt(result, a.result);
+		LogNotice("\nUsing %s, the smallest part the design fits in\n", GetPartName(a.options.part).c_str());
+		return true;
+	}
+
+	//Nothing worked, say why
+	for(auto& a : attempts)
+	{
+		LogNotice("\n%s:\n", GetPartName(a.options.part).c_str());
+		LogIndenter li;
+		a.log.Replay(Severity::WARNING);
+	}
+	if( (options.par.cancel == NULL) || !*options.par.cancel)
+		LogError("Design doesn't fit in any of the parts --part auto can choose from\n");
+	KeepAttempt(result, attempts[count - 1].result);
+	return false;
+}
+
+/**
+	@brief Replaces a result with that of one --part auto attempt, keeping the timings of what came before it
+ */
+static void KeepAttempt(CompileResult& result, const CompileResult& attempt)
+{
+	CompileStatistics stats = result.stats;
+	result = attempt;
+	result.stats.phases.insert(result.stats.phases.begin(), stats.phases.begin(), stats.phases.end());
+	result.stats.allocations.insert(
+		result.stats.allocations.begin(), stats.allocations.begin(), stats.allocations.end());
+}
+
+/**
+	@brief Runs PAR on a loaded netlist and generates the bitstream
+ */
+static bool CompileLoadedNetlist(Greenpak4Netlist& netlist, const CompileOptions& options, CompileResult& result)
+{
+	//Create the device and initialize all IO pins
+	Greenpak4Device device(options.part, options.unusedPull, options.unusedDrive);
+	device.SetIOPrecharge(options.ioPrecharge);
+	device.SetDisableChargePump(options.disableChargePump);
+	device.SetLDOBypass(options.ldoBypass);
+	device.SetNVMRetryCount(options.bootRetry);
+
+	//Do the actual P&R
+	LogNotice("\nSynthesizing top-level module \"%s\".\n", netlist.GetTopModule()->GetName().c_str());
+	result.part = options.part;
+	if(!DoPAR(&netlist, &device, options.par, &result))
+		return false;
+	if(options.par.placementOnly)
+		return true;
+
+	//Generate the final bitstream
+	TraceSpan span("Generate bitstream");
+	auto start = chrono::steady_clock::now();
+	Greenpak4Bitstream bitstream(device.GetBitLength());
+	bool ok = device.SaveBitstream(bitstream, options.userid, options.readProtect);
+	if(ok)
+	{
+		Greenpak4Device::FormatBitstream(
+			result.bitstream, bitstream, options.part, options.userid, options.readProtect, options.format);
+
+		//Keep the image around with the per-unit fields blanked too, so variants can be stamped without PAR
+		Greenpak4BitstreamTemplate stamp;
+		ok = stamp.Capture(options.part, bitstream);
+		stamp.Serialize(result.stampTemplate);
+	}
+	result.stats.EndPhase("generate_bitstream", start);
+	return ok;
+}
+
+/**
+	@brief Fills in the per-unit fields of a template written by --write-template, and writes the result out
+
+	No netlist, no device model and no PAR, so this takes microseconds rather than seconds.
+ */
+bool StampTemplate(const CompileOptions& options)
+{
+	string data;
+	if(!ReadInputFile(options.stampFile, data))
+		return false;
+
+	Greenpak4BitstreamTemplate stamp;
+	if(!stamp.Parse(data, options.stampFile))
+		return false;
+
+	Greenpak4Bitstream bitstream(0);
+	if(!stamp.Stamp(bitstream, options.userid, options.readProtect, options.rcTrim))
+		return false;
+
+	LogNotice("Stamping %s into \"%s\", using ID code 0x%x.\n",
+		options.stampFile.c_str(), options.outputFile.c_str(), (int)options.userid);
+
+	Greenpak4Device::FormatBitstream(
+		data, bitstream, stamp.GetPart(), options.userid, options.readProtect, options.format);
+	return WriteOutputFile(options.outputFile, data, options.format == Greenpak4Device::FORMAT_BINARY);
+}
+
+CompileStatistics::CompileStatistics()
+{
+	if(IsAllocationTracking())
+	{
+		ResetAllocationPeak();
+		m_allocationMark = GetAllocationCounters();
+	}
+}
+
+/**
+	@brief Adds the time since start to one of the phases, and the memory allocated since the last phase ended
+ */
+void CompileStatistics::EndPhase(const string& name, chrono::steady_clock::time_point start)
+{
+	double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+	bool found = false;
+	for(auto& phase : phases)
+	{
+		if(phase.first == name)
+		{
+			phase.second += seconds;
+			found = true;
+			break;
+		}
+	}
+	if(!found)
+		phases.push_back(pair<string, double>(name, seconds));
+
+	if(!IsAllocationTracking())
+		return;
+
+	//Start a new high-water mark for the next phase
+	AllocationCounters now = GetAllocationCounters();
+	ResetAllocationPeak();
+
+	AllocationCounters used;
+	used.allocated = now.allocated - m_allocationMark.allocated;
+	used.freed = now.freed - m_allocationMark.freed;
+	used.allocations = now.allocations - m_allocationMark.allocations;
+	used.peak = now.peak;
+	m_allocationMark = now;
+
+	for(auto& phase : allocations)
+	{
+		if(phase.first == name)
+		{
+			phase.second.allocated += used.allocated;
+			phase.second.freed += used.freed;
+			phase.second.allocations += used.allocations;
+			phase.second.peak = max(phase.second.peak, used.peak);
+			return;
+		}
+	}
+	allocations.push_back(pair<string, AllocationCounters>(name, used));
+}
+
+/**
+	@brief Formats the phase timings and PAR counters of a compile as JSON, for profiling.
+
+	Times are in seconds. The cost trajectory of each annealing run only has the iterations where the cost changed.
+ */
+static string FormatStatistics(const CompileResult& result, bool ok)
+{
+	char* buf = NULL;
+	size_t len = 0;
+	FILE* fp = open_memstream(&buf, &len);
+	if(!fp)
+		LogFatal("Couldn't allocate statistics report\n");
+
+	const CompileStatistics& stats = result.stats;
+	const PARStatistics& par = stats.par;
+	fprintf(fp, "{\n");
+	fprintf(fp, "    \"part\": \"%s\",\n", GetPartName(result.part).c_str());
+	fprintf(fp, "    \"ok\": %s,\n", ok ? "true" : "false");
+	fprintf(fp, "    \"cached\": %s,\n", result.cached ? "true" : "false");
+
+	double total = 0;
+	fprintf(fp, "    \"phases\": {");
+	for(size_t i=0; i<stats.phases.size(); i++)
+	{
+		fprintf(fp, "%s\n        ", (i == 0) ? "" : ",");
+		WriteJSONString(fp, stats.phases[i].first);
+		fprintf(fp, ": %.6f", stats.phases[i].second);
+		total += stats.phases[i].second;
+	}
+	fprintf(fp, "\n    },\n");
+	fprintf(fp, "    \"total\": %.6f,\n", total);
+
+	//Bytes allocated and freed in each phase, and the most that was live at once
+	if(!stats.allocations.empty())
+	{
+		uint64_t peak = 0;
+		fprintf(fp, "    \"allocations\": {");
+		for(size_t i=0; i<stats.allocations.size(); i++)
+		{
+			auto& used = stats.allocations[i].second;
+			fprintf(fp, "%s\n        ", (i == 0) ? "" : ",");
+			WriteJSONString(fp, stats.allocations[i].first);
+			fprintf(fp, ": { \"allocated\": %llu, \"freed\": %llu, \"count\": %llu, \"peak_live\": %llu }",
+				static_cast<unsigned long long>(used.allocated),
+				static_cast<unsigned long long>(used.freed),
+				static_cast<unsigned long long>(used.allocations),
+				static_cast<unsigned long long>(used.peak));
+			peak = max(peak, used.peak);
+		}
+		fprintf(fp, "\n    },\n");
+		fprintf(fp, "    \"peak_live\": %llu,\n", static_cast<unsigned long long>(peak));
+	}
+
+	fprintf(fp, "    \"par\": {\n");
+	fprintf(fp, "        \"initial_placement\": %.6f,\n", par.initialPlacementTime);
+	fprintf(fp, "        \"cost_evaluations\": %llu,\n", static_cast<unsigned long long>(par.costEvaluations));
+	fprintf(fp, "        \"moves\": { \"proposed\": %llu, \"accepted\": %llu, \"rejected\": %llu },\n",
+		static_cast<unsigned long long>(par.movesProposed),
+		static_cast<unsigned long long>(par.movesAccepted),
+		static_cast<unsigned long long>(par.GetMovesRejected()));
+	fprintf(fp, "        \"candidates\": { \"sets\": %llu, \"min\": %u, \"max\": %u, \"mean\": %.3f },\n",
+		static_cast<unsigned long long>(par.candidateSets),
+		par.candidateMin,
+		par.candidateMax,
+		par.candidateSets ? static_cast<double>(par.candidateTotal) / par.candidateSets : 0.0);
+	fprintf(fp, "        \"anneals\": [");
+	for(size_t i=0; i<par.anneals.size(); i++)
+	{
+		auto& run = par.anneals[i];
+		fprintf(fp, "%s\n            {\n", (i == 0) ? "" : ",");
+		fprintf(fp, "                \"seed\": %u,\n", run.seed);
+		fprintf(fp, "                \"iterations\": %u,\n", run.iterations);
+		fprintf(fp, "                \"seconds\": %.6f,\n", run.seconds);
+		fprintf(fp, "                \"timed_out\": %s,\n", run.timedOut ? "true" : "false");
+		fprintf(fp, "                \"cost\": [");
+		for(size_t j=0; j<run.cost.size(); j++)
+			fprintf(fp, "%s[%u, %u]", (j == 0) ? "" : ", ", run.cost[j].first, run.cost[j].second);
+		fprintf(fp, "]\n");
+		fprintf(fp, "            }");
+	}
+	fprintf(fp, "\n        ]\n");
+	fprintf(fp, "    }\n");
+	fprintf(fp, "}\n");
+
+	fclose(fp);
+	string report(buf, len);
+	free(buf);
+	return report;
+}
+
+/**
+	@brief Writes a generated bitstream or report out to disk
+ */
+bool WriteOutputFile(string fname, const string& data, bool binary)
+{
+	FILE* fp = fopen(fname.c_str(), binary ? "wb" : "w");
+	if(!fp)
+	{
+		LogError("Couldn't open %s for writing\n", fname.c_str());
+		return false;
+	}
+
+	bool ok = (1 == fwrite(data.c_str(), data.size(), 1, fp));
+	if(fclose(fp) != 0)
+		ok = false;
+	if(!ok)
+		LogError("Couldn't write %s\n", fname.c_str());
+	return ok;
+}
+
+/**
+	@brief Identifies this build of gp4par, so netlists cached by a different build are never used
+
+	The size and timestamp of the executable we're linked into change every time it's rebuilt, which catches changes to
+	the netlist code in the libraries as well as here.
+ */
+string GetNetlistCacheSalt()
+{
+	string salt = "gp4par " __DATE__ " " __TIME__;
+
+	struct stat st;
+	if(0 == stat("/proc/self/exe", &st))
+	{
+		char tmp[64];
+		snprintf(tmp, sizeof(tmp), " %lld %lld",
+			static_cast<long long>(st.st_size), static_cast<long long>(st.st_mtime));
+		salt += tmp;
+	}
+
+	return salt;
+}
@@ -19,46 +19,442 @@
 #ifndef gp4par_h
 #define gp4par_h
 
+#include <chrono>
 #include <cstdio>
 #include <string>
 #include <map>
+#include <thread>
 #include <log.h>
+#include <allocstats.h>
+#include <debuglog.h>
+#include <trace.h>
 #include <xbpar.h>
 #include <Greenpak4.h>
 
-typedef std::map<uint32_t, std::string> labelmap;
 typedef std::map<std::string, uint32_t> ilabelmap;
 
+//Site and cell type of each netlist cell in a placement file, by cell name
+typedef std::map<std::string, std::pair<std::string, std::string> > placementmap;
+
+#include "AsyncFileLogSink.h"
+#include "CompileCache.h"
+#include "Greenpak4NetlistOptimizer.h"
+#include "Greenpak4SiteTable.h"
+#include "Greenpak4DRC.h"
+#include "Greenpak4MatrixSwapMoveGenerator.h"
 #include "Greenpak4PAREngine.h"
+#include "JobLogSink.h"
+
+/**
+	@brief Place-and-route settings from the command line
+ */
+class PAROptions
+{
+public:
+	PAROptions()
+		: verifyCost(false)
+		, optimize(true)
+		, jobs(1)
+		, seeds(1)
+		, candidates(1)
+		, seed(1)
+		, timingTarget(0)
+		, batchMoves(1)
+		, exactTime(0)
+		, multilevel(false)
+		, timeLimit(0)
+		, placementOnly(false)
+		, cancel(NULL)
+	{
+	}
+
+	//Check every incremental cost update against a full recompute
+	bool verifyCost;
+
+	//Simplify the netlist (constant propagation, inverter absorption, unused cell removal) before PAR
+	bool optimize;
+
+	//Number of threads to use for multi-seed PAR
+	unsigned int jobs;
+
+	//Number of independent annealing runs to try (1 = classic single-seed PAR)
+	unsigned int seeds;
+
+	//Number of the best --seeds placements to commit and DRC check at once, falling back from the best to the next
+	//if it fails (1 = only ever try the best one)
+	unsigned int candidates;
+
+	//Random seed for the first annealing run (run N uses seed+N)
+	uint32_t seed;
+
+	//Longest path delay (in ps) to optimize placement for (0 = don't care about timing)
+	uint32_t timingTarget;
+
+	//Path to write the post-PAR critical path report to (empty = don't write one)
+	std::string timingReportFile;
+
+	//Path to write the DRC violations to (empty = don't write them)
+	std::string drcReportFile;
+
+	//Path to write the final placement to (empty = don't write it)
+	std::string placementFile;
+
+	//Placement file from a previous run to start from (empty = place everything from scratch)
+	std::string reusePlacementFile;
+
+	//Annealing profile to use (empty = the built-in one for the part)
+	std::string annealProfileFile;
+
+	//Path to record every annealing move and the time spent in each phase to (empty = don't record them)
+	std::string recordMovesFile;
+
+	//Move log from a previous run to check this run's moves against, reporting the first one that differs (empty =
+	//don't check)
+	std::string replayMovesFile;
+
+	//Number of candidate moves to evaluate in parallel at each annealing step (1 = one at a time)
+	unsigned int batchMoves;
+
+	//Time limit (in seconds) for searching for an optimal placement before falling back to annealing (0 = don't)
+	double exactTime;
+
+	//Pick the initial matrix of each cell by multi-level clustering (see PARMultilevelPlacer), then anneal cooler
+	bool multilevel;
+
+	//Time limit (in seconds) for PAR, after which the best placement found so far is used (0 = no limit)
+	double timeLimit;
+
+	//Compile servers to run --seeds on instead of this host, by socket path or host:port (empty = run them here).
+	//Only set by the compile server's --remote; see RemoteSeedSweep().
+	std::vector<std::string> remoteServers;
+
+	//Placement to use as is, instead of searching for one (empty = search). Set to the winner of a remote seed sweep.
+	std::string fixedPlacement;
+
+	//Stop once the placement is found, routable or not, without committing it (for servers running another server's
+	//seeds). Only CompileResult::placement and placementCost are filled in.
+	bool placementOnly;
+
+	//Set to true by another thread to abandon PAR (NULL = can't be cancelled)
+	const std::atomic<bool>* cancel;
+
+	//Called after every annealing iteration (empty = don't). Never called from two threads at once, even with
+	//several seeds.
+	PARProgressCallback progress;
+};
+
+/**
+	@brief Everything needed to turn one netlist into a bitstream
+ */
+class CompileOptions
+{
+public:
+	CompileOptions()
+		: resultCacheSize(256)
+		, unusedPull(Greenpak4IOB::PULL_NONE)
+		, unusedDrive(Greenpak4IOB::PULL_1M)
+		, ioPrecharge(false)
+		, disableChargePump(false)
+		, ldoBypass(false)
+		, bootRetry(1)
+		, part(Greenpak4Device::GREENPAK4_SLG46620)
+		, autoPart(false)
+		, userid(0)
+		, readProtect(false)
+		, format(Greenpak4Device::FORMAT_TEXT)
+		, rcTrim(-1)
+	{
+	}
+
+	//Netlist file ("-" = stdin)
+	std::string netlistFile;
+
+	//More netlists to merge with it and compile as one (see MergeNetlists()), and where to write which pins each one's
+	//ports ended up on (empty = don't)
+	std::vector<std::string> mergeFiles;
+	std::string manifestFile;
+
+	//Directory for cached copies of parsed netlists (empty = no caching)
+	std::string netlistCache;
+
+	//Directory for cached compile results (empty = no caching), and how big it can get (in MB)
+	std::string resultCache;
+	unsigned int resultCacheSize;
+
+	//Output file
+	std::string outputFile;
+
+	//File to write timing and PAR statistics to, as JSON (empty = don't)
+	std::string statsFile;
+
+	//File to write the per-unit stamping template to (empty = don't)
+	std::string templateFile;
+
+	//Template to stamp into the output file instead of compiling a netlist (empty = compile as usual)
+	std::string stampFile;
+
+	//Action to take with unused pins
+	Greenpak4IOB::PullDirection unusedPull;
+	Greenpak4IOB::PullStrength unusedDrive;
+
+	//Specifies whether we should increase drive current of pullups/downs during boot to reach a stable state faster
+	bool ioPrecharge;
+
+	//Specifies that we should disable the on-die charge pump for the analog IP
+	bool disableChargePump;
+
+	//Turns off the internal LDO and connects Vdd directly to Vcore
+	bool ldoBypass;
+
+	//Number of times to re-try the boot process
+	int bootRetry;
+
+	//Target chip, or if autoPart is set, the smallest one the design fits in (part is ignored then)
+	Greenpak4Device::GREENPAK4_PART part;
+	bool autoPart;
+
+	//Bitstream metadata
+	unsigned int userid;
+	bool readProtect;
+	Greenpak4Device::BitstreamFormat format;
+
+	//RC oscillator trim code to stamp (-1 = leave it for gp4prog to fill in)
+	int rcTrim;
+
+	//Place-and-route settings
+	PAROptions par;
+};
+
+/**
+	@brief Where the time went during a compile
+ */
+class CompileStatistics
+{
+public:
+	CompileStatistics();
+
+	void EndPhase(const std::string& name, std::chrono::steady_clock::time_point start);
+
+	//Wall time (in seconds) spent in each phase, in the order they were first entered
+	std::vector< std::pair<std::string, double> > phases;
+
+	//Heap memory used by each phase, in the same order (only if allocation tracking is on, see allocstats.h).
+	//Each phase is charged for everything since the end of the one before it.
+	std::vector< std::pair<std::string, AllocationCounters> > allocations;
+
+	//What the PAR engine did (summed over all the engines, if there was more than one)
+	PARStatistics par;
+
+protected:
+	//The allocation counters at the end of the last phase
+	AllocationCounters m_allocationMark;
+};
+
+/**
+	@brief Everything a compile produces (other than log messages)
+ */
+class CompileResult
+{
+public:
+	CompileResult()
+		: part(Greenpak4Device::GREENPAK4_SLG46620)
+		, criticalPathDelay(0)
+		, placementCost(0)
+		, cached(false)
+	{
+	}
+
+	//The part the bitstream is for (the one picked, with --part auto)
+	Greenpak4Device::GREENPAK4_PART part;
+
+	//The bitstream, in the requested format
+	std::string bitstream;
+
+	//The bitstream as a Greenpak4BitstreamTemplate, for --write-template
+	std::string stampTemplate;
+
+	//Everything the post-PAR DRC found
+	Greenpak4DRCReport drc;
+
+	//Estimated delay (in ps) of the longest path through the final placement
+	uint32_t criticalPathDelay;
+
+	//The JSON critical path report, if the options asked for one
+	std::string timingReport;
+
+	//The final placement, in the format --reuse-placement reads
+	std::string placement;
+
+	//Cost of the placement, as the placer measures it (only with PAROptions::placementOnly)
+	uint32_t placementCost;
+
+	//True if all of this came from the result cache, rather than running PAR
+	bool cached;
+
+	//Phase timings and PAR counters (only for the work done this time, so mostly empty if cached is set)
+	CompileStatistics stats;
+};
+
+/**
+	@brief Where one port bit of one of the designs merged by MergeNetlists() goes
+ */
+class MergedPort
+{
+public:
+	//Design the port belongs to, and its name there (with the bit index, for vectors)
+	std::string design;
+	std::string port;
+
+	//"input", "output" or "inout"
+	std::string direction;
+
+	//Name of the IOB cell on the port in the merged netlist (empty if it isn't connected to one)
+	std::string iob;
+};
 
 //Console help
 void ShowUsage();
 void ShowVersion();
+std::string GetNetlistCacheSalt();
+std::string GetPartName(Greenpak4Device::GREENPAK4_PART part);
+
+//Command line parsing
+enum OptionResult
+{
+	OPTION_OK,
+	OPTION_UNKNOWN,
+	OPTION_ERROR
+};
+OptionResult ParseOption(int& i, int argc, char* argv[], CompileOptions& options);
+bool ParseJobOptions(std::vector<std::string> args, CompileOptions& options);
+
+//Top level flow
+bool Compile(const CompileOptions& options);
+bool StampTemplate(const CompileOptions& options);
+bool CompileFile(const CompileOptions& options, CompileResult& result);
+bool CompileJSON(const char* json, size_t len, const CompileOptions& options, CompileResult& result);
+bool CompileNetlist(Greenpak4Netlist& netlist, const CompileOptions& options, CompileResult& result);
+bool ReadInputFile(std::string fname, std::string& data);
+bool WriteOutputFile(std::string fname, const std::string& data, bool binary = false);
+bool RunBatch(const std::string& fname, const CompileOptions& defaults, Severity console_verbosity);
+bool RunServer(
+	const std::string& path,
+	const CompileOptions& defaults,
+	unsigned int queue_depth,
+	const std::string& metrics_address,
+	Severity console_verbosity);
+
+//Remote seed sweeps
+bool IsTCPAddress(const std::string& address);
+void SplitTCPAddress(const std::string& address, std::string& host, std::string& port);
+std::vector<std::string> SplitJobLine(const std::string& line);
+int ConnectToServer(const std::string& address, std::string& error);
+int ListenUnixSocket(const std::string& path);
+bool SocketReadLine(int fd, std::string& line);
+bool SocketReadAll(int fd, char* buf, size_t len);
+bool SocketSendAll(int fd, const char* buf, size_t len);
+bool SocketSendLine(int fd, const char* format, ...) __attribute__((format(printf, 2, 3)));
+bool RemoteSeedSweep(const char* json, size_t len, const CompileOptions& options, std::string& placement);
 
 //Setup
 uint32_t AllocateLabel(
 	PARGraph*& ngraph,
 	PARGraph*& dgraph,
-	labelmap& lmap,
+	PARLabelRegistry& lmap,
 	std::string description);
 bool BuildGraphs(
 	Greenpak4Netlist* netlist,
 	Greenpak4Device* device,
 	PARGraph*& ngraph,
 	PARGraph*& dgraph,
-	labelmap& lmap);
+	PARLabelRegistry& lmap);
+PARGraph* MakeDeviceGraph(Greenpak4Device* device, PARGraph* ngraph, PARLabelRegistry& lmap);
+void MakeDeviceNodes(
+	Greenpak4Device* device,
+	PARGraph*& ngraph,
+	PARGraph*& dgraph,
+	PARLabelRegistry& lmap);
+void MakeDeviceEdges(Greenpak4Device* device);
 void ApplyLocConstraints(Greenpak4Netlist* netlist, PARGraph* ngraph, PARGraph* dgraph);
+void RebindDeviceGraph(PARGraph* dgraph, Greenpak4Device* from, Greenpak4Device* to);
+void PreloadDeviceModel(Greenpak4Device::GREENPAK4_PART part);
+
+/**
+	@brief Builds the device model for a part in the background, waiting for it on destruction
+ */
+class DeviceModelPreloader
+{
+public:
+	DeviceModelPreloader(Greenpak4Device::GREENPAK4_PART part);
+	~DeviceModelPreloader();
+
+protected:
+	std::thread m_thread;
+};
 
 //PAR core
-bool DoPAR(Greenpak4Netlist* netlist, Greenpak4Device* device);
+bool DoPAR(Greenpak4Netlist* netlist, Greenpak4Device* device, const PAROptions& options, CompileResult* result = NULL);
+bool MultiSeedPAR(
+	Greenpak4PAREngine& engine,
+	PARGraph* ngraph,
+	PARGraph* dgraph,
+	Greenpak4Device* device,
+	const Greenpak4SiteTable* sites,
+	PARLabelRegistry& lmap,
+	const PAROptions& options,
+	std::vector< std::pair<PARGraph*, PARGraph*> >* runners_up = NULL);
+bool ExactPAR(Greenpak4PAREngine& engine, PARLabelRegistry& lmap, const PAROptions& options);
 
 //DRC
-bool PostPARDRC(PARGraph* netlist, Greenpak4Device* device);
+bool PostPARDRC(
+	PARGraph* netlist,
+	PARGraph* device,
+	Greenpak4Device* pdev,
+	const PAROptions& options,
+	Greenpak4DRCReport& report);
+void ConfigureSharedAcmpMux(Greenpak4Device* device, const Greenpak4DRCIndex& index);
 
 //Committing
-bool CommitChanges(PARGraph* device, Greenpak4Device* pdev, unsigned int* num_routes_used);
-bool CommitRouting(PARGraph* device, Greenpak4Device* pdev, unsigned int* num_routes_used);
-void PrintUtilizationReport(PARGraph* netlist, Greenpak4Device* device, unsigned int* num_routes_used);
+bool CommitChanges(
+	PARGraph* netlist,
+	PARGraph* device,
+	Greenpak4Device* pdev,
+	const Greenpak4SiteTable& sites,
+	std::vector<unsigned int>& num_routes_used);
+int CommitCandidates(
+	const std::vector< std::pair<PARGraph*, PARGraph*> >& candidates,
+	Greenpak4Device* pdev,
+	const Greenpak4SiteTable& sites,
+	const PAROptions& options);
+bool CommitRouting(
+	PARGraph* netlist,
+	PARGraph* device,
+	Greenpak4Device* pdev,
+	const Greenpak4SiteTable& sites,
+	std::vector<unsigned int>& num_routes_used);
+void PrintUtilizationReport(
+	PARGraph* netlist,
+	Greenpak4Device* device,
+	const std::vector<unsigned int>& num_routes_used);
 void PrintPlacementReport(PARGraph* netlist, Greenpak4Device* device);
 
+//Placement files
+std::string FormatPlacement(PARGraph* netlist);
+bool ReadPlacementFile(std::string fname, placementmap& placement);
+bool ParsePlacement(const std::string& data, const std::string& source, placementmap& placement);
+
+//Test multiplexing
+bool MergeNetlists(const std::vector<std::string>& files, std::string& json, std::vector<MergedPort>& ports);
+std::string FormatMergeManifest(const std::vector<MergedPort>& ports, const std::string& placement);
+
+//Annealing profiles
+std::string FormatAnnealProfile(const PARAnnealOptions& options, const std::string& comment = "");
+bool ParseAnnealProfile(const std::string& data, const std::string& source, PARAnnealOptions& options);
+bool GetAnnealProfile(Greenpak4Device::GREENPAK4_PART part, const std::string& fname, PARAnnealOptions& options);
+
+//Timing analysis
+void PrintTimingReport(PARGraph* netlist, Greenpak4Device* device, uint32_t target);
+std::string FormatTimingReport(PARGraph* netlist, Greenpak4Device* device, uint32_t target);
+void WriteJSONString(FILE* fp, const std::string& str);
+
 #endif
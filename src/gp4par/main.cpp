@@ -24,42 +24,46 @@ int main(int argc, char* argv[])
 {
 	Severity console_verbosity = Severity::NOTICE;
 
-	//Netlist file
-	string fname = "";
+	//Settings for the design (in batch mode, the defaults for every job)
+	CompileOptions options;
 
-	//Output file
-	string ofname = "";
+	//List of jobs to run (empty = just compile one netlist)
+	string batchFile = "";
 
-	//Action to take with unused pins;
-	Greenpak4IOB::PullDirection unused_pull = Greenpak4IOB::PULL_NONE;
-	Greenpak4IOB::PullStrength  unused_drive = Greenpak4IOB::PULL_1M;
+	//Socket to serve compile requests on (empty = don't), and how many can wait for a thread
+	string serverSocket = "";
+	unsigned int queueDepth = 16;
 
-	//Specifies whether we should increase drive current of pullups/downs during boot to reach a stable state faster
-	bool ioPrecharge = false;
+	//Address to serve the server's metrics on over HTTP (empty = don't)
+	string metricsAddress = "";
 
-	//Specifies that we should disable the on-die charge pump for the analog IP
-	bool disableChargePump = false;
+	//Chrome trace of where the time went (empty = don't record one)
+	string traceFile = "";
 
-	//Turns off the internal LDO and connects Vdd directly to Vcore
-	bool ldoBypass = false;
-
-	//Number of times to re-try the boot process
-	int bootRetry = 1;
-
-	//Target chip
-	Greenpak4Device::GREENPAK4_PART part = Greenpak4Device::GREENPAK4_SLG46620;
-
-	//Bitstream metadata
-	unsigned int userid = 0;
-	bool readProtect = false;
+	//Log files to write in the background (see AsyncFileLogSink)
+	vector<string> logFiles;
 
 	//Parse command-line arguments
 	for(int i=1; i<argc; i++)
 	{
 		string s(argv[i]);
 
+		//With --debug, PAR logs enough that writing each message to the log file as it comes slows it down, so
+		//we handle --logfile ourselves instead of letting the logger do it. --logfile-lines still goes to the logger,
+		//since the whole point of it is to get each line out straight away.
+		if( (s == "-l") || (s == "--logfile") )
+		{
+			if(i+1 < argc)
+				logFiles.push_back(argv[++i]);
+			else
+			{
+				printf("%s requires an argument\n", s.c_str());
+				return 1;
+			}
+		}
+
 		//Let the logger eat its args first
-		if(ParseLoggerArguments(i, argc, argv, console_verbosity))
+		else if(ParseLoggerArguments(i, argc, argv, console_verbosity))
 			continue;
 
 		else if(s == "--help")
@@ -72,272 +76,652 @@ int main(int argc, char* argv[])
 			ShowVersion();
 			return 0;
 		}
-		else if(s == "--unused-pull")
+		else if(s == "--batch")
 		{
 			if(i+1 < argc)
-			{
-				string pull = argv[++i];
-				if(pull == "down")
-					unused_pull = Greenpak4IOB::PULL_DOWN;
-				else if(pull == "up")
-					unused_pull = Greenpak4IOB::PULL_UP;
-				else if( (pull == "none") || (pull == "float") )
-					unused_pull = Greenpak4IOB::PULL_NONE;
-				else
-				{
-					printf("--unused-pull must be one of up, down, float, none\n");
-					return 1;
-				}
-			}
+				batchFile = argv[++i];
 			else
 			{
-				printf("--unused-pull requires an argument\n");
+				printf("--batch requires an argument\n");
 				return 1;
 			}
 		}
-		else if(s == "--unused-drive")
+		else if(s == "--server")
 		{
 			if(i+1 < argc)
-			{
-				string drive = argv[++i];
-				if(drive == "10k")
-					unused_drive = Greenpak4IOB::PULL_10K;
-				else if(drive == "100k")
-					unused_drive = Greenpak4IOB::PULL_100K;
-				else if(drive == "1M")
-					unused_drive = Greenpak4IOB::PULL_1M;
-				else
-				{
-					printf("--unused-drive must be one of 10k, 100k, 1M\n");
-					return 1;
-				}
-			}
+				serverSocket = argv[++i];
 			else
 			{
-				printf("--unused-drive requires an argument\n");
+				printf("--server requires an argument\n");
 				return 1;
 			}
 		}
-		else if(s == "--usercode")
+		else if(s == "--remote")
 		{
 			if(i+1 < argc)
-				sscanf(argv[++i], "%x", &userid);
+				options.par.remoteServers.push_back(argv[++i]);
 			else
 			{
-				printf("--usercode requires an argument\n");
+				printf("--remote requires an argument\n");
 				return 1;
 			}
 		}
-		else if( (s == "--part") || (s == "-p") )
+		else if(s == "--metrics")
 		{
 			if(i+1 < argc)
-			{
-				int p;
-				sscanf(argv[++i], "SLG%d", &p);
-
-				switch(p)
-				{
-					case 46620:
-						part = Greenpak4Device::GREENPAK4_SLG46620;
-						break;
-
-					case 46621:
-						part = Greenpak4Device::GREENPAK4_SLG46621;
-						break;
-
-					case 46140:
-						part = Greenpak4Device::GREENPAK4_SLG46140;
-						break;
-
-					default:
-						printf("invalid part (supported: 46620, 46621, 46140)\n");
-						return 1;
-				}
-			}
+				metricsAddress = argv[++i];
 			else
 			{
-				printf("--usercode requires an argument\n");
+				printf("--metrics requires an argument\n");
 				return 1;
 			}
 		}
-		else if(s == "--read-protect")
-			readProtect = true;
-		else if(s == "--io-precharge")
-			ioPrecharge = true;
-		else if(s == "--disable-charge-pump")
-			disableChargePump = true;
-		else if(s == "--ldo-bypass")
-			ldoBypass = true;
-		else if(s == "--boot-retry")
+		else if(s == "--alloc-stats")
+		{
+			if(!StartAllocationTracking())
+				return 1;
+		}
+		else if(s == "--trace")
 		{
 			if(i+1 < argc)
-				bootRetry = atoi(argv[++i]);
+				traceFile = argv[++i];
 			else
 			{
-				printf("--boot-retry requires an argument\n");
+				printf("--trace requires an argument\n");
 				return 1;
 			}
 		}
-		else if(s == "-o" || s == "--output")
+		else if(s == "--queue-depth")
 		{
 			if(i+1 < argc)
-				ofname = argv[++i];
+				queueDepth = strtoul(argv[++i], NULL, 10);
 			else
 			{
-				printf("--output requires an argument\n");
+				printf("--queue-depth requires an argument\n");
 				return 1;
 			}
 		}
-
-		//assume it's the netlist file if it'[s the first non-switch argument
-		else if( (s[0] != '-') && (fname == "") )
-			fname = s;
-
 		else
 		{
-			printf("Unrecognized command-line argument \"%s\", use --help\n", s.c_str());
-			return 1;
+			OptionResult result = ParseOption(i, argc, argv, options);
+			if(result == OPTION_ERROR)
+				return 1;
+			if(result == OPTION_UNKNOWN)
+			{
+				printf("Unrecognized command-line argument \"%s\", use --help\n", s.c_str());
+				return 1;
+			}
 		}
 	}
 
-	//Netlist filenames must be specified
-	if( (fname == "") || (ofname == "") )
+	//In batch mode the netlists and outputs come from the job list, and in server mode from the clients.
+	//Otherwise, netlist filenames must be specified
+	if( (batchFile != "") && (serverSocket != "") )
+	{
+		printf("--batch and --server can't be used together\n");
+		return 1;
+	}
+	else if( (metricsAddress != "") && (serverSocket == "") )
+	{
+		printf("--metrics needs --server\n");
+		return 1;
+	}
+	else if(!options.par.remoteServers.empty() && (serverSocket == "") )
+	{
+		printf("--remote needs --server\n");
+		return 1;
+	}
+	else if(batchFile != "")
+	{
+		if( (options.netlistFile != "") || (options.outputFile != "") )
+		{
+			printf("--batch can't be combined with a netlist or --output, put them in the job list\n");
+			return 1;
+		}
+	}
+	else if(serverSocket != "")
+	{
+		if( (options.netlistFile != "") || (options.outputFile != "") )
+		{
+			printf("--server can't be combined with a netlist or --output, clients send them\n");
+			return 1;
+		}
+	}
+	else if(options.stampFile != "")
+	{
+		if( (options.netlistFile != "") || (options.outputFile == "") || (options.templateFile != "") )
+		{
+			printf("--stamp needs --output, and can't be combined with a netlist or --write-template\n");
+			return 1;
+		}
+	}
+	else if( (options.netlistFile == "") || (options.outputFile == "") )
 	{
 		ShowUsage();
 		return 1;
 	}
 
-	//Set up logging
-	g_log_sinks.emplace(g_log_sinks.begin(), new STDLogSink(console_verbosity));
+	SetDebugLogging(console_verbosity >= Severity::DEBUG);
+
+	//Log files get everything the console does, and verbose messages even if the console doesn't.
+	//The sinks are destroyed on the way out of the program, which writes out whatever's left.
+	Severity file_verbosity = max(console_verbosity, Severity::VERBOSE);
+	for(auto fname : logFiles)
+	{
+		FILE* fp = fopen(fname.c_str(), "w");
+		if(!fp)
+		{
+			printf("Couldn't open log file %s\n", fname.c_str());
+			return 1;
+		}
+		g_log_sinks.emplace_back(new AsyncFileLogSink(fp, file_verbosity));
+	}
+
+	//The trace is written when we exit, however that happens
+	if( (traceFile != "") && !StartTracing(traceFile) )
+		return 1;
 
 	//Print header
 	if(console_verbosity >= Severity::NOTICE)
 		ShowVersion();
 
-	//Print configuration
-	LogNotice("\nDevice configuration:\n");
-	{
-		LogIndenter li;
+	if(batchFile != "")
+		return RunBatch(batchFile, options, console_verbosity) ? 0 : 1;
+	if(serverSocket != "")
+		return RunServer(serverSocket, options, queueDepth, metricsAddress, console_verbosity) ? 0 : 1;
 
-		string dev = "<invalid>";
-		switch(part)
-		{
-			case Greenpak4Device::GREENPAK4_SLG46620:
-				dev = "SLG46620V";
-				break;
+	//Set up logging (through a JobLogSink, so --part auto can keep the log of each part it tries apart)
+	g_log_sinks.emplace(g_log_sinks.begin(), new JobLogSink(new STDLogSink(console_verbosity)));
 
-			case Greenpak4Device::GREENPAK4_SLG46621:
-				dev = "SLG46621V";
-				break;
+	return Compile(options) ? 0 : 1;
+}
 
-			case Greenpak4Device::GREENPAK4_SLG46140:
-				dev = "SLG46140V";
-				break;
-		}
+/**
+	@brief Parses a command-line option that changes how a design is compiled
 
-		LogNotice("Target device:   %s\n", dev.c_str());
-		LogNotice("VCC range:       not yet implemented\n");
+	@param i		Index of the option in argv, advanced past any values it takes
+	@param argc		Number of arguments
+	@param argv		The arguments
+	@param options	Settings to update
 
-		string pull;
-		string drive;
+	@return OPTION_UNKNOWN if this isn't a compile option, or OPTION_ERROR (after printing why) if it's malformed
+ */
+OptionResult ParseOption(int& i, int argc, char* argv[], CompileOptions& options)
+{
+	string s(argv[i]);
 
-		switch(unused_pull)
+	if(s == "--unused-pull")
+	{
+		if(i+1 < argc)
 		{
-			case Greenpak4IOB::PULL_NONE:
-				pull = "float";
-				break;
-
-			case Greenpak4IOB::PULL_DOWN:
-				pull = "pull down with ";
-				break;
-
-			case Greenpak4IOB::PULL_UP:
-				pull = "pull up with ";
-				break;
-
-			default:
-				LogError("Invalid pull direction\n");
-				return 1;
+			string pull = argv[++i];
+			if(pull == "down")
+				options.unusedPull = Greenpak4IOB::PULL_DOWN;
+			else if(pull == "up")
+				options.unusedPull = Greenpak4IOB::PULL_UP;
+			else if( (pull == "none") || (pull == "float") )
+				options.unusedPull = Greenpak4IOB::PULL_NONE;
+			else
+			{
+				printf("--unused-pull must be one of up, down, float, none\n");
+				return OPTION_ERROR;
+			}
 		}
-
-		if(unused_pull != Greenpak4IOB::PULL_NONE)
+		else
+		{
+			printf("--unused-pull requires an argument\n");
+			return OPTION_ERROR;
+		}
+	}
+	else if(s == "--unused-drive")
+	{
+		if(i+1 < argc)
 		{
-			switch(unused_drive)
+			string drive = argv[++i];
+			if(drive == "10k")
+				options.unusedDrive = Greenpak4IOB::PULL_10K;
+			else if(drive == "100k")
+				options.unusedDrive = Greenpak4IOB::PULL_100K;
+			else if(drive == "1M")
+				options.unusedDrive = Greenpak4IOB::PULL_1M;
+			else
 			{
-				case Greenpak4IOB::PULL_10K:
-					drive = "10K";
+				printf("--unused-drive must be one of 10k, 100k, 1M\n");
+				return OPTION_ERROR;
+			}
+		}
+		else
+		{
+			printf("--unused-drive requires an argument\n");
+			return OPTION_ERROR;
+		}
+	}
+	else if(s == "--usercode")
+	{
+		if(i+1 < argc)
+			sscanf(argv[++i], "%x", &options.userid);
+		else
+		{
+			printf("--usercode requires an argument\n");
+			return OPTION_ERROR;
+		}
+	}
+	else if( (s == "--part") || (s == "-p") )
+	{
+		if( (i+1 < argc) && (string(argv[i+1]) == "auto") )
+		{
+			options.autoPart = true;
+			i++;
+		}
+		else if(i+1 < argc)
+		{
+			int p;
+			sscanf(argv[++i], "SLG%d", &p);
+			options.autoPart = false;
+
+			switch(p)
+			{
+				case 46620:
+					options.part = Greenpak4Device::GREENPAK4_SLG46620;
 					break;
 
-				case Greenpak4IOB::PULL_100K:
-					drive = "100K";
+				case 46621:
+					options.part = Greenpak4Device::GREENPAK4_SLG46621;
 					break;
 
-				case Greenpak4IOB::PULL_1M:
-					drive = "1M";
+				case 46140:
+					options.part = Greenpak4Device::GREENPAK4_SLG46140;
 					break;
 
 				default:
-					LogError("Invalid pull strength\n");
-					return 1;
+					printf("invalid part (supported: 46620, 46621, 46140)\n");
+					return OPTION_ERROR;
 			}
 		}
+		else
+		{
+			printf("--usercode requires an argument\n");
+			return OPTION_ERROR;
+		}
+	}
+	else if(s == "--read-protect")
+		options.readProtect = true;
+	else if(s == "--rc-trim")
+	{
+		if(i+1 < argc)
+			options.rcTrim = strtol(argv[++i], NULL, 0);
+		else
+		{
+			printf("--rc-trim requires an argument\n");
+			return OPTION_ERROR;
+		}
+	}
+	else if(s == "--stamp")
+	{
+		if(i+1 < argc)
+			options.stampFile = argv[++i];
+		else
+		{
+			printf("--stamp requires an argument\n");
+			return OPTION_ERROR;
+		}
+	}
+	else if(s == "--write-template")
+	{
+		if(i+1 < argc)
+			options.templateFile = argv[++i];
+		else
+		{
+			printf("--write-template requires an argument\n");
+			return OPTION_ERROR;
+		}
+	}
+	else if(s == "--io-precharge")
+		options.ioPrecharge = true;
+	else if(s == "--disable-charge-pump")
+		options.disableChargePump = true;
+	else if(s == "--ldo-bypass")
+		options.ldoBypass = true;
+	else if(s == "--verify-cost")
+		options.par.verifyCost = true;
+	else if(s == "--no-optimize")
+		options.par.optimize = false;
+	else if(s == "--multilevel")
+		options.par.multilevel = true;
+	else if(s == "-j" || s == "--jobs")
+	{
+		if(i+1 < argc)
+			options.par.jobs = atoi(argv[++i]);
+		else
+		{
+			printf("--jobs requires an argument\n");
+			return OPTION_ERROR;
+		}
 
-		LogNotice("Unused pins:     %s %s\n", pull.c_str(), drive.c_str());
-
-		LogNotice("User ID code:    %02x\n", userid);
-		LogNotice("Read protection: %s\n", readProtect ? "enabled" : "disabled");
-		LogNotice("I/O precharge:   %s\n", ioPrecharge ? "enabled" : "disabled");
-		LogNotice("Charge pump:     %s\n", disableChargePump ? "off" : "auto");
-		LogNotice("LDO:             %s\n", ldoBypass ? "bypassed" : "enabled");
-		LogNotice("Boot retry:      %d times\n", bootRetry);
+		if(options.par.jobs < 1)
+		{
+			printf("--jobs must be at least 1\n");
+			return OPTION_ERROR;
+		}
 	}
+	else if(s == "--batch-moves")
+	{
+		if(i+1 < argc)
+			options.par.batchMoves = atoi(argv[++i]);
+		else
+		{
+			printf("--batch-moves requires an argument\n");
+			return OPTION_ERROR;
+		}
 
-	//Parse the unplaced netlist
-	LogNotice("\nLoading Yosys JSON file \"%s\".\n", fname.c_str());
-	Greenpak4Netlist netlist(fname);
-	if(!netlist.Validate())
-		return 1;
+		if(options.par.batchMoves < 1)
+		{
+			printf("--batch-moves must be at least 1\n");
+			return OPTION_ERROR;
+		}
+	}
+	else if(s == "--drc-report")
+	{
+		if(i+1 < argc)
+			options.par.drcReportFile = argv[++i];
+		else
+		{
+			printf("--drc-report requires an argument\n");
+			return OPTION_ERROR;
+		}
+	}
+	else if(s == "--anneal-profile")
+	{
+		if(i+1 < argc)
+			options.par.annealProfileFile = argv[++i];
+		else
+		{
+			printf("--anneal-profile requires an argument\n");
+			return OPTION_ERROR;
+		}
+	}
+	else if(s == "--exact")
+	{
+		if(i+1 < argc)
+			options.par.exactTime = atof(argv[++i]);
+		else
+		{
+			printf("--exact requires an argument\n");
+			return OPTION_ERROR;
+		}
+	}
+	else if(s == "--seed")
+	{
+		if(i+1 < argc)
+			options.par.seed = strtoul(argv[++i], NULL, 0);
+		else
+		{
+			printf("--seed requires an argument\n");
+			return OPTION_ERROR;
+		}
+	}
+	else if(s == "--seeds")
+	{
+		if(i+1 < argc)
+			options.par.seeds = atoi(argv[++i]);
+		else
+		{
+			printf("--seeds requires an argument\n");
+			return OPTION_ERROR;
+		}
 
-	//Create the device and initialize all IO pins
-	Greenpak4Device device(part, unused_pull, unused_drive);
-	device.SetIOPrecharge(ioPrecharge);
-	device.SetDisableChargePump(disableChargePump);
-	device.SetLDOBypass(ldoBypass);
-	device.SetNVMRetryCount(bootRetry);
+		if(options.par.seeds < 1)
+		{
+			printf("--seeds must be at least 1\n");
+			return OPTION_ERROR;
+		}
+	}
+	else if(s == "--candidates")
+	{
+		if(i+1 < argc)
+			options.par.candidates = atoi(argv[++i]);
+		else
+		{
+			printf("--candidates requires an argument\n");
+			return OPTION_ERROR;
+		}
 
-	//Do the actual P&R
-	LogNotice("\nSynthesizing top-level module \"%s\".\n", netlist.GetTopModule()->GetName().c_str());
-	if(!DoPAR(&netlist, &device))
-		return 1;
+		if(options.par.candidates < 1)
+		{
+			printf("--candidates must be at least 1\n");
+			return OPTION_ERROR;
+		}
+	}
+	else if(s == "--netlist-cache")
+	{
+		if(i+1 < argc)
+			options.netlistCache = argv[++i];
+		else
+		{
+			printf("--netlist-cache requires an argument\n");
+			return OPTION_ERROR;
+		}
+	}
+	else if(s == "--result-cache")
+	{
+		if(i+1 < argc)
+			options.resultCache = argv[++i];
+		else
+		{
+			printf("--result-cache requires an argument\n");
+			return OPTION_ERROR;
+		}
+	}
+	else if(s == "--result-cache-size")
+	{
+		if(i+1 < argc)
+			options.resultCacheSize = atoi(argv[++i]);
+		else
+		{
+			printf("--result-cache-size requires an argument\n");
+			return OPTION_ERROR;
+		}
 
-	//Write the final bitstream
-	LogNotice("\nWriting final bitstream to output file \"%s\", using ID code 0x%x.\n",
-		ofname.c_str(), (int)userid);
+		if(options.resultCacheSize < 1)
+		{
+			printf("--result-cache-size must be at least 1\n");
+			return OPTION_ERROR;
+		}
+	}
+	else if(s == "--stats-file")
 	{
-		LogIndenter li;
-		if(!device.WriteToFile(ofname, userid, readProtect))
-			return 1;
+		if(i+1 < argc)
+			options.statsFile = argv[++i];
+		else
+		{
+			printf("--stats-file requires an argument\n");
+			return OPTION_ERROR;
+		}
+	}
+	else if(s == "--timing-report")
+	{
+		if(i+1 < argc)
+			options.par.timingReportFile = argv[++i];
+		else
+		{
+			printf("--timing-report requires an argument\n");
+			return OPTION_ERROR;
+		}
+	}
+	else if(s == "--time-limit")
+	{
+		if(i+1 < argc)
+			options.par.timeLimit = atof(argv[++i]);
+		else
+		{
+			printf("--time-limit requires an argument\n");
+			return OPTION_ERROR;
+		}
+	}
+	else if(s == "--timing-target")
+	{
+		if(i+1 < argc)
+			options.par.timingTarget = static_cast<uint32_t>(strtod(argv[++i], NULL) * 1000);
+		else
+		{
+			printf("--timing-target requires an argument\n");
+			return OPTION_ERROR;
+		}
+	}
+	else if(s == "--merge")
+	{
+		if(i+1 < argc)
+			options.mergeFiles.push_back(argv[++i]);
+		else
+		{
+			printf("--merge requires an argument\n");
+			return OPTION_ERROR;
+		}
+	}
+	else if(s == "--merge-manifest")
+	{
+		if(i+1 < argc)
+			options.manifestFile = argv[++i];
+		else
+		{
+			printf("--merge-manifest requires an argument\n");
+			return OPTION_ERROR;
+		}
+	}
+	else if(s == "--write-placement")
+	{
+		if(i+1 < argc)
+			options.par.placementFile = argv[++i];
+		else
+		{
+			printf("--write-placement requires an argument\n");
+			return OPTION_ERROR;
+		}
+	}
+	else if(s == "--record-moves")
+	{
+		if(i+1 < argc)
+			options.par.recordMovesFile = argv[++i];
+		else
+		{
+			printf("--record-moves requires an argument\n");
+			return OPTION_ERROR;
+		}
 	}
+	else if(s == "--replay-moves")
+	{
+		if(i+1 < argc)
+			options.par.replayMovesFile = argv[++i];
+		else
+		{
+			printf("--replay-moves requires an argument\n");
+			return OPTION_ERROR;
+		}
+	}
+	else if(s == "--reuse-placement")
+	{
+		if(i+1 < argc)
+			options.par.reusePlacementFile = argv[++i];
+		else
+		{
+			printf("--reuse-placement requires an argument\n");
+			return OPTION_ERROR;
+		}
+	}
+	else if(s == "--boot-retry")
+	{
+		if(i+1 < argc)
+			options.bootRetry = atoi(argv[++i]);
+		else
+		{
+			printf("--boot-retry requires an argument\n");
+			return OPTION_ERROR;
+		}
+	}
+	else if(s == "-o" || s == "--output")
+	{
+		if(i+1 < argc)
+			options.outputFile = argv[++i];
+		else
+		{
+			printf("--output requires an argument\n");
+			return OPTION_ERROR;
+		}
+	}
+	else if(s == "--output-format")
+	{
+		if(i+1 < argc)
+		{
+			string fmt = argv[++i];
+			if(fmt == "text")
+				options.format = Greenpak4Device::FORMAT_TEXT;
+			else if(fmt == "binary")
+				options.format = Greenpak4Device::FORMAT_BINARY;
+			else
+			{
+				printf("--output-format must be one of text, binary\n");
+				return OPTION_ERROR;
+			}
+		}
+		else
+		{
+			printf("--output-format requires an argument\n");
+			return OPTION_ERROR;
+		}
+	}
+
+	//assume it's the netlist file if it'[s the first non-switch argument ("-" means stdin)
+	else if( ( (s[0] != '-') || (s == "-") ) && (options.netlistFile == "") )
+		options.netlistFile = s;
 
-	//TODO: Static timing analysis
-	LogNotice("\nStatic timing analysis: not yet implemented\n");
+	else
+		return OPTION_UNKNOWN;
 
-	return 0;
+	return OPTION_OK;
 }
 
 void ShowUsage()
 {
 	printf(//                                                                               v 80th column
 		"Usage: gp4par -p part -o bitstream.txt netlist.json\n"
+		"    (use - as the netlist file name to read it from stdin)\n"
+		"       gp4par --stamp design.gp4t -o bitstream.txt [--usercode id]\n"
+		"       gp4par --batch jobs.txt [options]\n"
+		"       gp4par --server socket [options]\n"
+		"    --alloc-stats\n"
+		"        Adds how much heap memory each step of the compile allocated, and the\n"
+		"        most it had in use at once, to the --stats-file. Slows the compile down.\n"
+		"    --anneal-profile     <file>\n"
+		"        Uses the annealing schedule in <file> (see gp4bench --tune) instead of\n"
+		"        the one built in for the part.\n"
+		"    --batch              <file>\n"
+		"        Compiles every netlist in the job list <file>, one job per line, each\n"
+		"        given as a netlist, -o output and options. Each job logs to output.log\n"
+		"        and up to --jobs jobs run at once.\n"
+		"    --batch-moves        <count>\n"
+		"        Evaluates <count> candidate moves at once at each placement step, using\n"
+		"        the threads given by --jobs (default 1). Same seed, same result.\n"
+		"    --candidates         <count>\n"
+		"        With --seeds, keeps the best <count> placements (default 1) and checks\n"
+		"        them all at once, using the next best if the best fails routing or DRC.\n"
 		"    --debug\n"
 		"        Prints lots of internal debugging information.\n"
 		"    --disable-charge-pump\n"
 		"        Disables the on-die charge pump which powers the analog hard IP when the\n"
 		"        supply voltage drops below 2.7V. Provided for completeness since the\n"
 		"        Silego GUI lets you specify it; there's no obvious reason to use it.\n"
+		"    --drc-report         <file>\n"
+		"        Writes the design rule violations found after routing to <file> in JSON\n"
+		"        format.\n"
+		"    --exact              <seconds>\n"
+		"        Searches up to <seconds> for a placement using the fewest cross\n"
+		"        connections before falling back to annealing. Slow; for small designs.\n"
 		"    --io-precharge\n"
 		"        Hooks a 2K resistor in parallel with pullup/down resistors during POR.\n"
 		"        This can help external capacitive loads to reach a stable voltage faster.\n"
+		"    -j, --jobs           <count>\n"
+		"        Number of threads to use for --seeds and --batch-moves (default 1).\n"
+		"        With --batch or --server, the number of jobs to run at once.\n"
 		"    -l, --logfile        <file>\n"
 		"        Causes verbose log messages to be written to <file>.\n"
 		"    -L, --logfile-lines  <file>\n"
@@ -346,19 +730,109 @@ void ShowUsage()
 		"    --ldo-bypass\n"
 		"        Disable the on-die LDO and use an external 1.8V Vdd as Vcore.\n"
 		"        May cause device damage if set with higher Vdd supply.\n"
+		"    --merge              <netlist>\n"
+		"        Merges <netlist> into the main one, so several small test designs can\n"
+		"        share one device. Names are prefixed with each netlist's file name.\n"
+		"        Can be given more than once.\n"
+		"    --merge-manifest     <file>\n"
+		"        With --merge, writes which pin each port of each design is on to <file>.\n"
+		"    --metrics            [host:]<port>\n"
+		"        With --server, serves queue depth, job latency, PAR and cache counters\n"
+		"        over HTTP at /metrics, in the Prometheus text format. Listens on every\n"
+		"        interface unless a host is given.\n"
+		"    --multilevel\n"
+		"        Clusters tightly connected cells before spreading them over the routing\n"
+		"        matrices, then anneals from there at a lower temperature. Can help large\n"
+		"        designs place faster.\n"
+		"    --netlist-cache      <dir>\n"
+		"        Keeps parsed netlists in <dir>, so running again on the same netlist\n"
+		"        skips parsing it. The directory must already exist.\n"
+		"    --no-optimize\n"
+		"        Places the netlist as is, without shrinking LUTs with constant or unused\n"
+		"        inputs, merging inverters into LUTs, removing cells that drive nothing,\n"
+		"        or packing chains of flipflops into unused shift registers.\n"
 		"    -o, --output         <bitstream>\n"
 		"        Writes bitstream into the specified file.\n"
+		"    --output-format      [text|binary]\n"
+		"        Format of the output bitstream (default text). Binary bitstreams are\n"
+		"        smaller, checksummed, and can be downloaded by gp4prog directly.\n"
 		"    -p, --part\n"
-		"        Specifies the part to target (SLG46620V, SLG46621V, or SLG46140V)\n"
+		"        Specifies the part to target (SLG46620V, SLG46621V, or SLG46140V), or\n"
+		"        auto to try the SLG46140V and SLG46620V at once and use the smallest\n"
+		"        one the design fits in.\n"
+		"    --queue-depth        <count>\n"
+		"        With --server, how many jobs can wait for a thread before new ones are\n"
+		"        turned away as busy (default 16).\n"
 		"    -q, --quiet\n"
 		"        Causes only warnings and errors to be written to the console.\n"
 		"        Specify twice to also silence warnings.\n"
+		"    --rc-trim            <code>\n"
+		"        With --stamp, the RC oscillator trim code to write (SLG4662x only). By\n"
+		"        default it's left zero, for gp4prog to measure and fill in.\n"
+		"    --record-moves       <file>\n"
+		"        Records every placement move, and the time spent in each phase of the\n"
+		"        moves, to <file>. Can't be used with --seeds.\n"
+		"    --remote             <server>\n"
+		"        With --server, runs the --seeds of each job on the compile server at\n"
+		"        <server> (a socket or host:port) and only commits the best placement\n"
+		"        here. Give it once per server; the seeds are split evenly between them.\n"
+		"    --replay-moves       <file>\n"
+		"        Checks every placement move against the ones in <file> (see\n"
+		"        --record-moves), then reports the first one that's different and how\n"
+		"        the time spent in each phase changed. Use the same netlist and options.\n"
+		"    --result-cache       <dir>\n"
+		"        Keeps compile results in <dir>, so compiling the same netlist with the\n"
+		"        same options again skips parsing and PAR. The directory must exist.\n"
+		"    --result-cache-size  <MB>\n"
+		"        Deletes the least recently used results once the --result-cache grows\n"
+		"        past <MB> megabytes (default 256).\n"
+		"    --reuse-placement    <file>\n"
+		"        Starts from the placement in <file> (see --write-placement), so cells that\n"
+		"        haven't changed stay where they were and only new ones are placed.\n"
+		"    --seed               <value>\n"
+		"        Random seed for placement (default 1). The same seed and input always\n"
+		"        give the same result.\n"
+		"    --seeds              <count>\n"
+		"        Runs <count> independent placement attempts and keeps the best one.\n"
+		"        Stops early as soon as any attempt finds a perfect placement.\n"
+		"    --server             <socket>\n"
+		"        Listens on the Unix socket <socket> (or TCP port, given host:port or\n"
+		"        :port) and compiles netlists sent to it, keeping device models loaded\n"
+		"        between jobs. Up to --jobs jobs run at once. Runs until interrupted.\n"
+		"        A TCP port only takes --remote seeds, from any client that can reach\n"
+		"        it; :port only listens on localhost, 0.0.0.0:port on every interface.\n"
+		"    --stamp              <template>\n"
+		"        Makes a bitstream from a --write-template template, filling in only the\n"
+		"        --usercode, --read-protect and --rc-trim fields. Doesn't run PAR, and\n"
+		"        checks that nothing else in the bitstream changed.\n"
+		"    --stats-file         <file>\n"
+		"        Writes the time taken by each step of the compile, and what the placer\n"
+		"        did, to <file> in JSON format.\n"
+		"    --time-limit         <seconds>\n"
+		"        Stops placing after <seconds> and uses the best placement found so far,\n"
+		"        which may not route. Bounds latency at some cost in quality.\n"
+		"    --timing-report      <file>\n"
+		"        Writes the critical path of each type to <file> in JSON format.\n"
+		"    --timing-target      <ns>\n"
+		"        Tries to place the design so no path is slower than <ns> nanoseconds,\n"
+		"        using typical delays. By default timing is ignored.\n"
+		"    --trace              <file>\n"
+		"        Writes a timeline of every phase of PAR to <file>, in Chrome trace format\n"
+		"        (open in chrome://tracing or ui.perfetto.dev).\n"
 		"    --unused-pull        [down|up|float]\n"
 		"        Specifies direction to pull unused pins.\n"
 		"    --unused-drive       [10k|100k|1m]\n"
 		"        Specifies strength of pullup/down resistor on unused pins.\n"
 		"    --verbose\n"
-		"        Prints additional information about the design.\n");
+		"        Prints additional information about the design.\n"
+		"    --verify-cost\n"
+		"        Checks every incremental placement cost update against a full recompute.\n"
+		"        Very slow; intended for debugging the placer.\n"
+		"    --write-placement    <file>\n"
+		"        Writes the site of every cell to <file>, for --reuse-placement.\n"
+		"    --write-template     <file>\n"
+		"        Also writes the bitstream to <file> as a template, with the user ID, read\n"
+		"        protection and RC oscillator trim left blank for --stamp to fill in.\n");
 }
 
 void ShowVersion()
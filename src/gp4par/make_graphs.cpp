@@ -16,30 +16,27 @@
  * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA                                      *
  **********************************************************************************************************************/
 
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
 #include "gp4par.h"
 
 using namespace std;
 
 bool MakeNetlistEdges(Greenpak4Netlist* netlist);
-void MakeDeviceEdges(Greenpak4Device* device);
 
 bool MakeNetlistNodes(
 	Greenpak4Netlist* netlist,
 	PARGraph*& ngraph,
 	ilabelmap& ilmap);
 
-void MakeDeviceNodes(
-	Greenpak4Device* device,
-	PARGraph*& ngraph,
-	PARGraph*& dgraph,
-	labelmap& lmap);
-
 void MakeSingleNode(
 	string type,
 	Greenpak4BitstreamEntity* entity,
 	PARGraph* ngraph,
 	PARGraph* dgraph,
-	labelmap& lmap);
+	PARLabelRegistry& lmap);
 
 PARGraphNode* MakeNode(
 	uint32_t label,
@@ -60,6 +57,12 @@ void ReplicateVREF(
 	PARGraph*& ngraph,
 	ilabelmap& ilmap);
 
+void MarkConstantEdges(
+	Greenpak4Device* device,
+	PARGraph* ngraph,
+	PARGraph* dgraph,
+	ilabelmap& ilmap);
+
 /**
 	@brief Build the graphs
  */
@@ -68,23 +71,21 @@ bool BuildGraphs(
 	Greenpak4Device* device,
 	PARGraph*& ngraph,
 	PARGraph*& dgraph,
-	labelmap& lmap)
+	PARLabelRegistry& lmap)
 {
 	LogIndenter li;
-
-	//Create the graphs
-	ngraph = new PARGraph;
-	dgraph = new PARGraph;
+	TraceSpan span("Build graphs");
 
 	//Create the device graph.
-	//This is independent of the final netlist and has to be done first to assign graph labels
-	MakeDeviceNodes(device, ngraph, dgraph, lmap);
-	MakeDeviceEdges(device);
+	//This is independent of the final netlist and has to be done first to assign graph labels.
+	//It only depends on the part number, so it's built once and copied for every design targeting that part.
+	ngraph = new PARGraph;
+	dgraph = MakeDeviceGraph(device, ngraph, lmap);
 
 	//Build inverse label map
 	ilabelmap ilmap;
-	for(auto it : lmap)
-		ilmap[it.second] = it.first;
+	for(uint32_t label=0; label<lmap.GetNumLabels(); label++)
+		ilmap[lmap.GetName(label)] = label;
 
 	//Create all of the nodes for the netlist, then connect with edges.
 	//This requires breaking point-to-multipoint nets into multiple point-to-point links.
@@ -96,9 +97,72 @@ bool BuildGraphs(
 	//Infer extra support nodes for things that use hidden functions of others
 	InferExtraNodes(netlist, device, ngraph, ilmap);
 
+	//Both graphs are final now, pack their edges for fast iteration during PAR.
+	//Index the labels too, since the site table needs the label counts before the engine gets to them.
+	ngraph->Freeze();
+	dgraph->Freeze();
+	ngraph->IndexNodesByLabel();
+	dgraph->IndexNodesByLabel();
+
+	//Tied-off inputs don't need to be placed around
+	MarkConstantEdges(device, ngraph, dgraph, ilmap);
+
 	return true;
 }
 
+/**
+	@brief Flags the power rail edges PAR doesn't need to look at (see PARGraphEdge::m_free)
+
+	Every matrix can make VDD and VSS itself, so a rail driving a general fabric input never needs a cross connection
+	and is routable wherever the load goes. CommitRouting() ties each such load to the rail in its own matrix.
+	Dedicated inputs (e.g. a comparator's VIN) only reach the rails from some sites, so those edges still count.
+ */
+void MarkConstantEdges(
+	Greenpak4Device* device,
+	PARGraph* ngraph,
+	PARGraph* dgraph,
+	ilabelmap& ilmap)
+{
+	uint32_t nfree = 0;
+	const char* rails[] = { "GP_VDD", "GP_VSS" };
+	for(auto name : rails)
+	{
+		uint32_t label = ilmap[name];
+		if(dgraph->GetNumNodesWithLabel(label) != 1)
+			continue;
+
+		//The rail has to be in every matrix for the route to be free
+		PARGraphNode* dnode = dgraph->GetNodeByLabelAndIndex(label, 0);
+		auto rail = static_cast<Greenpak4BitstreamEntity*>(dnode->GetData());
+		if( (rail->GetDual() == NULL) && (device->GetMatrixCount() > 1) )
+			continue;
+
+		for(uint32_t i=0; i<ngraph->GetNumNodesWithLabel(label); i++)
+		{
+			PARGraphNode* nnode = ngraph->GetNodeByLabelAndIndex(label, i);
+			for(uint32_t j=0; j<nnode->GetEdgeCount(); j++)
+			{
+				PARGraphEdge* edge = nnode->GetEdgeByIndex(j);
+				if(!dnode->HasFabricOutput(edge->m_sourceport))
+					continue;
+
+				//Every site the load may go in has to take the rail from the fabric
+				uint32_t dlabel = edge->m_destnode->GetLabel();
+				uint32_t nsites = dgraph->GetNumNodesWithLabel(dlabel);
+				bool fabric = (nsites > 0);
+				for(uint32_t k=0; fabric && (k<nsites); k++)
+					fabric = dgraph->GetNodeByLabelAndIndex(dlabel, k)->HasFabricInput(edge->m_destport);
+				edge->m_free = fabric;
+				if(fabric)
+					nfree ++;
+			}
+		}
+	}
+
+	if(nfree)
+		LogVerbose("%u loads are tied to a power rail and don't need placing around\n", nfree);
+}
+
 /**
 	@brief Replicate a voltage reference
  */
@@ -120,6 +184,7 @@ void ReplicateVREF(
 	vref->m_type = "GP_VREF";
 	vref->m_connections["VIN"].push_back(cell->m_connections["VIN"][0]);
 	vref->m_parameters = cell->m_parameters;
+	vref->m_typedParameters = cell->m_typedParameters;
 	vref->m_attributes = cell->m_attributes;
 
 	//Give it a name
@@ -162,9 +227,8 @@ void ReplicateVREF(
 	cell->m_parnode->RemoveEdge("VOUT", load->m_parnode, "VREF");
 
 	//Create the PAR node for it
-	PARGraphNode* nnode = new PARGraphNode(ilmap[vref->m_type], vref);
+	PARGraphNode* nnode = ngraph->CreateNode(ilmap[vref->m_type], vref);
 	vref->m_parnode = nnode;
-	ngraph->AddNode(nnode);
 
 	//Copy the netlist edges to the PAR graph
 	//TODO: automate this somehow? Seems error-prone to do it twice
@@ -194,12 +258,15 @@ void InferExtraNodes(
 	auto vdd = top->GetNet("GP_VDD");
 	auto vddn = device->GetPowerRail(true)->GetPARNode();
 
-	//Look for IOBs driven by GP_VREF cells
+	//Look for IOBs driven by GP_VREF cells.
+	//Adding cells invalidates the module's iterators, so work from a copy of the cell list.
 	Greenpak4NetlistModule* module = netlist->GetTopModule();
+	vector<Greenpak4NetlistCell*> cells;
 	for(auto it = module->cell_begin(); it != module->cell_end(); it ++)
+		cells.push_back(it->second);
+	for(auto cell : cells)
 	{
 		//See if we're an IOB
-		Greenpak4NetlistCell* cell = it->second;
 		if(!cell->IsIOB())
 			continue;
 
@@ -260,9 +327,8 @@ void InferExtraNodes(
 			module->AddCell(acmp);
 
 			//Create the PAR node for it
-			PARGraphNode* nnode = new PARGraphNode(ilmap[acmp->m_type], acmp);
+			PARGraphNode* nnode = ngraph->CreateNode(ilmap[acmp->m_type], acmp);
 			acmp->m_parnode = nnode;
-			ngraph->AddNode(nnode);
 
 			//Copy the netlist edges to the PAR graph
 			//TODO: automate this somehow? Seems error-prone to do it twice
@@ -289,10 +355,12 @@ void InferExtraNodes(
 
 	//If one GP_VREF drives multiple GP_ACMP/GP_DAC blocks, split it
 	//This must come after the IOB pass since that might infer GP_ACMPs we need to contend with
+	cells.clear();
 	for(auto it = module->cell_begin(); it != module->cell_end(); it ++)
+		cells.push_back(it->second);
+	for(auto cell : cells)
 	{
 		//See if we're a VREF
-		Greenpak4NetlistCell* cell = it->second;
 		if(cell->m_type != "GP_VREF")
 			continue;
 		//LogDebug("vref %s\n", cell->m_name.c_str());
@@ -384,9 +452,8 @@ bool MakeNetlistNodes(
 		}
 
 		//Create a node for the cell
-		PARGraphNode* nnode = new PARGraphNode(label, cell);
+		PARGraphNode* nnode = ngraph->CreateNode(label, cell);
 		cell->m_parnode = nnode;
-		ngraph->AddNode(nnode);
 	}
 
 	return true;
@@ -399,7 +466,7 @@ void MakeDeviceNodes(
 	Greenpak4Device* device,
 	PARGraph*& ngraph,
 	PARGraph*& dgraph,
-	labelmap& lmap)
+	PARLabelRegistry& lmap)
 {
 	//Create device entries for the IOBs
 	uint32_t ibuf_label = AllocateLabel(ngraph, dgraph, lmap, "GP_IBUF");
@@ -730,7 +797,7 @@ void MakeSingleNode(
 	Greenpak4BitstreamEntity* entity,
 	PARGraph* ngraph,
 	PARGraph* dgraph,
-	labelmap& lmap)
+	PARLabelRegistry& lmap)
 {
 	uint32_t label = AllocateLabel(ngraph, dgraph, lmap, type);
 
@@ -753,12 +820,193 @@ PARGraphNode* MakeNode(
 	Greenpak4BitstreamEntity* entity,
 	PARGraph* dgraph)
 {
-	PARGraphNode* node = new PARGraphNode(label, entity);
+	PARGraphNode* node = dgraph->CreateNode(label, entity);
 	entity->SetPARNode(node);
-	dgraph->AddNode(node);
 	return node;
 }
 
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Dedicated routing tables
+
+/**
+	@brief Kinds of hard IP block which can be the end of a dedicated route
+ */
+enum RouteSiteType
+{
+	SITE_IOB,		//index is the pin number
+	SITE_VDD,
+	SITE_GND,
+	SITE_LFOSC,
+	SITE_RINGOSC,
+	SITE_RCOSC,
+	SITE_COUNTER,
+	SITE_SYSRST,
+	SITE_VREF,
+	SITE_ACMP,
+	SITE_PGA,
+	SITE_ABUF,
+	SITE_SPI,
+	SITE_CLKBUF,
+	SITE_DCMP,
+	SITE_DCMPREF,
+	SITE_DCMPMUX,
+	SITE_DAC
+};
+
+/**
+	@brief A dedicated route from one block to one or more others of the same type
+ */
+class DedicatedRoute
+{
+public:
+	RouteSiteType	m_srcType;
+	uint8_t			m_srcIndex;
+	const char*		m_srcPort;
+
+	RouteSiteType	m_dstType;
+	uint8_t			m_dstIndex;
+
+	//Number of consecutive destination blocks, starting at m_dstIndex, to route to
+	uint8_t			m_dstCount;
+
+	const char*		m_dstPort;
+
+	//If nonzero, m_dstPort is a bus this wide, and we route to every bit of it
+	uint8_t			m_dstWidth;
+};
+
+/**
+	@brief Dedicated routing for the SLG46620/1 (the SLG46621 doesn't have pin 14, so routes to it are skipped)
+ */
+static const DedicatedRoute g_slg4662xRoutes[] =
+{
+	//Clock inputs to counters
+	//TODO: other clock sources
+	{ SITE_LFOSC,	0,	"CLKOUT",			SITE_COUNTER,	0,	10,	"CLK",		0 },
+	{ SITE_RINGOSC,	0,	"CLKOUT_HARDIP",	SITE_COUNTER,	0,	10,	"CLK",		0 },
+	{ SITE_RCOSC,	0,	"CLKOUT_HARDIP",	SITE_COUNTER,	0,	10,	"CLK",		0 },
+
+	//Can drive reset with ground or pin 2 only
+	{ SITE_IOB,		2,	"OUT",				SITE_SYSRST,	0,	1,	"RST",		0 },
+	{ SITE_GND,		0,	"OUT",				SITE_SYSRST,	0,	1,	"RST",		0 },
+
+	//VREF0/1 can drive pin 19, VREF2/3 can drive pin 18
+	{ SITE_VREF,	0,	"VOUT",				SITE_IOB,		19,	1,	"IN",		0 },
+	{ SITE_VREF,	1,	"VOUT",				SITE_IOB,		19,	1,	"IN",		0 },
+	{ SITE_VREF,	2,	"VOUT",				SITE_IOB,		18,	1,	"IN",		0 },
+	{ SITE_VREF,	3,	"VOUT",				SITE_IOB,		18,	1,	"IN",		0 },
+
+	//All comparator references can be driven by Vdd (for Vdd/3 and Vdd/4) and Vss (for constant voltages).
+	//DAC references (VREF6/7) can be driven by Vss only.
+	{ SITE_VDD,		0,	"OUT",				SITE_VREF,		0,	6,	"VIN",		0 },
+	{ SITE_GND,		0,	"OUT",				SITE_VREF,		0,	8,	"VIN",		0 },
+
+	//External pins to references
+	{ SITE_IOB,		7,	"OUT",				SITE_VREF,		0,	2,	"VIN",		0 },
+	{ SITE_IOB,		10,	"OUT",				SITE_VREF,		0,	6,	"VIN",		0 },
+	{ SITE_IOB,		14,	"OUT",				SITE_VREF,		2,	3,	"VIN",		0 },
+	{ SITE_IOB,		5,	"OUT",				SITE_VREF,		5,	1,	"VIN",		0 },
+
+	//Only allow one VREF to drive its attached comparator
+	{ SITE_VREF,	0,	"VOUT",				SITE_ACMP,		0,	1,	"VREF",		0 },
+	{ SITE_VREF,	1,	"VOUT",				SITE_ACMP,		1,	1,	"VREF",		0 },
+	{ SITE_VREF,	2,	"VOUT",				SITE_ACMP,		2,	1,	"VREF",		0 },
+	{ SITE_VREF,	3,	"VOUT",				SITE_ACMP,		3,	1,	"VREF",		0 },
+	{ SITE_VREF,	4,	"VOUT",				SITE_ACMP,		4,	1,	"VREF",		0 },
+	{ SITE_VREF,	5,	"VOUT",				SITE_ACMP,		5,	1,	"VREF",		0 },
+
+	//Input to buffer
+	{ SITE_IOB,		6,	"OUT",				SITE_ABUF,		0,	1,	"IN",		0 },
+
+	//Dedicated inputs for each comparator (none for ACMP0)
+	{ SITE_IOB,		12,	"OUT",				SITE_ACMP,		1,	1,	"VIN",		0 },
+	{ SITE_PGA,		0,	"VOUT",				SITE_ACMP,		1,	1,	"VIN",		0 },
+	{ SITE_IOB,		13,	"OUT",				SITE_ACMP,		2,	2,	"VIN",		0 },
+	{ SITE_IOB,		15,	"OUT",				SITE_ACMP,		3,	2,	"VIN",		0 },
+	{ SITE_IOB,		3,	"OUT",				SITE_ACMP,		4,	1,	"VIN",		0 },
+	{ SITE_IOB,		4,	"OUT",				SITE_ACMP,		5,	1,	"VIN",		0 },
+
+	//ACMP0 input before gain stage is fed to everything but ACMP5
+	{ SITE_IOB,		6,	"OUT",				SITE_ACMP,		0,	5,	"VIN",		0 },
+	{ SITE_VDD,		0,	"OUT",				SITE_ACMP,		0,	5,	"VIN",		0 },
+	{ SITE_ABUF,	0,	"OUT",				SITE_ACMP,		0,	5,	"VIN",		0 },
+
+	//Pin 10 IOB can drive SPI as MOSI, and SPI can drive it as MISO
+	//TODO: Disable clock outputs to dedicated routing in matrix 1 if SPI slave is enabled?
+	{ SITE_IOB,		10,	"OUT",				SITE_SPI,		0,	1,	"SDAT",		0 },
+	{ SITE_SPI,		0,	"SDAT",				SITE_IOB,		10,	1,	"IN",		0 },
+
+	//TX data is tied to ground when unused (RX mode)
+	{ SITE_GND,		0,	"OUT",				SITE_SPI,		0,	1,	"TXD_LOW",	8 },
+	{ SITE_GND,		0,	"OUT",				SITE_SPI,		0,	1,	"TXD_HIGH",	8 },
+
+	//SPI SCK comes from clkbuf4
+	{ SITE_CLKBUF,	4,	"OUT",				SITE_SPI,		0,	1,	"SCK",		0 },
+
+	//Inputs to DCMPMUX
+	{ SITE_DCMPREF,	0,	"OUT",				SITE_DCMPMUX,	0,	1,	"IN0",		8 },
+	{ SITE_DCMPREF,	1,	"OUT",				SITE_DCMPMUX,	0,	1,	"IN1",		8 },
+	{ SITE_DCMPREF,	2,	"OUT",				SITE_DCMPMUX,	0,	1,	"IN2",		8 },
+	{ SITE_DCMPREF,	3,	"OUT",				SITE_DCMPMUX,	0,	1,	"IN3",		8 },
+
+	//Mux driving DCMP0/1
+	{ SITE_DCMPMUX,	0,	"OUTA",				SITE_DCMP,		0,	1,	"INP",		8 },
+	{ SITE_DCMPMUX,	0,	"OUTB",				SITE_DCMP,		1,	1,	"INN",		8 },
+
+	//Constant inputs from DCREF to DCMP
+	{ SITE_DCMPREF,	0,	"OUT",				SITE_DCMP,		0,	1,	"INN",		8 },
+	{ SITE_DCMPREF,	2,	"OUT",				SITE_DCMP,		2,	1,	"INN",		8 },
+	{ SITE_DCMPREF,	1,	"OUT",				SITE_DCMP,		1,	1,	"INP",		8 },
+	{ SITE_DCMPREF,	3,	"OUT",				SITE_DCMP,		2,	1,	"INP",		8 },
+
+	//SPI data lines
+	//TODO: Other inputs: ADC, counters
+	{ SITE_SPI,		0,	"RXD_HIGH",			SITE_DCMP,		0,	2,	"INP",		8 },
+	{ SITE_SPI,		0,	"RXD_LOW",			SITE_DCMP,		0,	3,	"INN",		8 },
+
+	//ADC/DCMP clock mux routing (clkbuf5 is the muxed one)
+	{ SITE_RINGOSC,	0,	"CLKOUT_HARDIP",	SITE_CLKBUF,	5,	1,	"IN",		0 },
+	{ SITE_RCOSC,	0,	"CLKOUT_HARDIP",	SITE_CLKBUF,	5,	1,	"IN",		0 },
+	{ SITE_CLKBUF,	2,	"OUT",				SITE_CLKBUF,	5,	1,	"IN",		0 },
+	{ SITE_CLKBUF,	4,	"OUT",				SITE_CLKBUF,	5,	1,	"IN",		0 },
+
+	//Clock inputs to DCMP
+	{ SITE_CLKBUF,	1,	"OUT",				SITE_DCMP,		0,	3,	"CLK",		0 },
+	{ SITE_CLKBUF,	5,	"OUT",				SITE_DCMP,		0,	3,	"CLK",		0 },
+
+	//Inputs to PGA
+	//TODO: DAC output
+	{ SITE_VDD,		0,	"OUT",				SITE_PGA,		0,	1,	"VIN_P",	0 },
+	{ SITE_IOB,		8,	"OUT",				SITE_PGA,		0,	1,	"VIN_P",	0 },
+	{ SITE_IOB,		9,	"OUT",				SITE_PGA,		0,	1,	"VIN_N",	0 },
+	{ SITE_GND,		0,	"OUT",				SITE_PGA,		0,	1,	"VIN_N",	0 },
+	{ SITE_IOB,		16,	"OUT",				SITE_PGA,		0,	1,	"VIN_SEL",	0 },
+	{ SITE_VDD,		0,	"OUT",				SITE_PGA,		0,	1,	"VIN_SEL",	0 },
+
+	//PGA to IOB
+	//TODO: Output to ADC
+	{ SITE_PGA,		0,	"VOUT",				SITE_IOB,		7,	1,	"IN",		0 },
+
+	//DAC voltage references driving DAC inputs
+	{ SITE_VREF,	6,	"VOUT",				SITE_DAC,		0,	1,	"VREF",		0 },
+	{ SITE_VREF,	7,	"VOUT",				SITE_DAC,		1,	1,	"VREF",		0 },
+
+	//Static 1/0 for DAC register configuration
+	//TODO: Direct inputs from counters
+	{ SITE_VDD,		0,	"OUT",				SITE_DAC,		0,	2,	"DIN",		8 },
+	{ SITE_GND,		0,	"OUT",				SITE_DAC,		0,	2,	"DIN",		8 },
+
+	//Both DACs can drive every comparator vref
+	{ SITE_DAC,		0,	"VOUT",				SITE_VREF,		0,	6,	"VIN",		0 },
+	{ SITE_DAC,		1,	"VOUT",				SITE_VREF,		0,	6,	"VIN",		0 },
+
+	//DACs can drive I/O pins directly without going through a GP_VREF
+	{ SITE_DAC,		0,	"VOUT",				SITE_IOB,		19,	1,	"IN",		0 },
+	{ SITE_DAC,		1,	"VOUT",				SITE_IOB,		18,	1,	"IN",		0 },
+};
+
+PARGraphNode* GetRouteSite(Greenpak4Device* device, RouteSiteType type, unsigned int index);
+
 /**
 	@brief Make all of the edges for the device graph (list of all possible connections)
 
@@ -775,449 +1023,325 @@ void MakeDeviceEdges(Greenpak4Device* device)
 			device_nodes.push_back(pnode);
 	}
 
-	//Add the O(n^2) edges between the main fabric nodes
+	//Every output can reach every input through the main fabric.
+	//Rather than adding O(n^2) edges for this, just mark the ports as fabric-connected.
 	for(auto x : device_nodes)
 	{
-		auto oports = static_cast<Greenpak4BitstreamEntity*>(x->GetData())->GetOutputPorts();
-		for(auto srcport : oports)
-		{
-			for(auto y : device_nodes)
-			{
-				//Add paths to each cell input
-				auto iports = static_cast<Greenpak4BitstreamEntity*>(y->GetData())->GetInputPorts();
-				for(auto ip : iports)
-					x->AddEdge(srcport, y, ip);
-			}
-		}
+		auto entity = static_cast<Greenpak4BitstreamEntity*>(x->GetData());
+		for(auto srcport : entity->GetOutputPortIDs())
+			x->AddFabricOutput(srcport);
+		for(auto ip : entity->GetInputPortIDs())
+			x->AddFabricInput(ip);
 	}
 
 	//Add dedicated routing between hard IP
+	const DedicatedRoute* routes = NULL;
+	size_t nroutes = 0;
 	if( (device->GetPart() == Greenpak4Device::GREENPAK4_SLG46620) ||
 		(device->GetPart() == Greenpak4Device::GREENPAK4_SLG46621) )
 	{
-		auto lfosc = device->GetLFOscillator()->GetPARNode();
-		auto rosc = device->GetRingOscillator()->GetPARNode();
-		auto rcosc = device->GetRCOscillator()->GetPARNode();
-
-		//TODO: Disable clock outputs to dedicated routing in matrix 1 if SPI slave is enabled?
-
-		////////////////////////////////////////////////////////////////////////////////////////////////////////////////
-		// Cache some commonly used stuff
-
-		auto pin2 = device->GetIOB(2)->GetPARNode();
-		auto pin3 = device->GetIOB(3)->GetPARNode();
-		auto pin4 = device->GetIOB(4)->GetPARNode();
-		auto pin5 = device->GetIOB(5)->GetPARNode();
-		auto pin6 = device->GetIOB(6)->GetPARNode();
-		auto pin7 = device->GetIOB(7)->GetPARNode();
-		auto pin8 = device->GetIOB(8)->GetPARNode();
-		auto pin9 = device->GetIOB(9)->GetPARNode();
-		auto pin10 = device->GetIOB(10)->GetPARNode();
-		auto pin12 = device->GetIOB(12)->GetPARNode();
-		auto pin13 = device->GetIOB(13)->GetPARNode();
-		auto pin15 = device->GetIOB(15)->GetPARNode();
-		auto pin16 = device->GetIOB(16)->GetPARNode();
-		auto pin18 = device->GetIOB(18)->GetPARNode();
-		auto pin19 = device->GetIOB(19)->GetPARNode();
-
-		//SLG46621 is missing pin 14 so don't die if it's not there
-		PARGraphNode* pin14 = NULL;
-		if(device->GetPart() == Greenpak4Device::GREENPAK4_SLG46620)
-			pin14 = device->GetIOB(14)->GetPARNode();
-
-		auto vdd = device->GetPowerRail(true)->GetPARNode();
-		auto gnd = device->GetPowerRail(false)->GetPARNode();
-
-		////////////////////////////////////////////////////////////////////////////////////////////////////////////////
-		// CLOCK INPUTS TO COUNTERS
-
-		PARGraphNode* cnodes[] =
-		{
-			device->GetCounter(0)->GetPARNode(),
-			device->GetCounter(1)->GetPARNode(),
-			device->GetCounter(2)->GetPARNode(),
-			device->GetCounter(3)->GetPARNode(),
-			device->GetCounter(4)->GetPARNode(),
-			device->GetCounter(5)->GetPARNode(),
-			device->GetCounter(6)->GetPARNode(),
-			device->GetCounter(7)->GetPARNode(),
-			device->GetCounter(8)->GetPARNode(),
-			device->GetCounter(9)->GetPARNode()
-		};
-
-		//TODO: other clock sources
-		lfosc->AddEdge("CLKOUT", cnodes[0], "CLK");
-		rosc->AddEdge("CLKOUT_HARDIP", cnodes[0], "CLK");
-		rcosc->AddEdge("CLKOUT_HARDIP", cnodes[0], "CLK");
-
-		//TODO: other clock sources
-		lfosc->AddEdge("CLKOUT", cnodes[1], "CLK");
-		rosc->AddEdge("CLKOUT_HARDIP", cnodes[1], "CLK");
-		rcosc->AddEdge("CLKOUT_HARDIP", cnodes[1], "CLK");
-
-		//TODO: other clock sources
-		lfosc->AddEdge("CLKOUT", cnodes[2], "CLK");
-		rosc->AddEdge("CLKOUT_HARDIP", cnodes[2], "CLK");
-		rcosc->AddEdge("CLKOUT_HARDIP", cnodes[2], "CLK");
-
-		//TODO: other clock sources
-		lfosc->AddEdge("CLKOUT", cnodes[3], "CLK");
-		rosc->AddEdge("CLKOUT_HARDIP", cnodes[3], "CLK");
-		rcosc->AddEdge("CLKOUT_HARDIP", cnodes[3], "CLK");
-
-		//TODO: other clock sources
-		lfosc->AddEdge("CLKOUT", cnodes[4], "CLK");
-		rosc->AddEdge("CLKOUT_HARDIP", cnodes[4], "CLK");
-		rcosc->AddEdge("CLKOUT_HARDIP", cnodes[4], "CLK");
-
-		//TODO: other clock sources
-		lfosc->AddEdge("CLKOUT", cnodes[5], "CLK");
-		rosc->AddEdge("CLKOUT_HARDIP", cnodes[5], "CLK");
-		rcosc->AddEdge("CLKOUT_HARDIP", cnodes[5], "CLK");
-
-		//TODO: other clock sources
-		lfosc->AddEdge("CLKOUT", cnodes[6], "CLK");
-		rosc->AddEdge("CLKOUT_HARDIP", cnodes[6], "CLK");
-		rcosc->AddEdge("CLKOUT_HARDIP", cnodes[6], "CLK");
-
-		//TODO: other clock sources
-		lfosc->AddEdge("CLKOUT", cnodes[7], "CLK");
-		rosc->AddEdge("CLKOUT_HARDIP", cnodes[7], "CLK");
-		rcosc->AddEdge("CLKOUT_HARDIP", cnodes[7], "CLK");
-
-		//TODO: other clock sources
-		lfosc->AddEdge("CLKOUT", cnodes[8], "CLK");
-		rosc->AddEdge("CLKOUT_HARDIP", cnodes[8], "CLK");
-		rcosc->AddEdge("CLKOUT_HARDIP", cnodes[8], "CLK");
-
-		//TODO: other clock sources
-		lfosc->AddEdge("CLKOUT", cnodes[9], "CLK");
-		rosc->AddEdge("CLKOUT_HARDIP", cnodes[9], "CLK");
-		rcosc->AddEdge("CLKOUT_HARDIP", cnodes[9], "CLK");
-
-		////////////////////////////////////////////////////////////////////////////////////////////////////////////////
-		// SYSTEM RESET
-
-		//Can drive reset with ground or pin 2 only
-		auto sysrst = device->GetSystemReset()->GetPARNode();
-		pin2->AddEdge("OUT", sysrst, "RST");
-		gnd->AddEdge("OUT", sysrst, "RST");
-
-		////////////////////////////////////////////////////////////////////////////////////////////////////////////////
-		// REFERENCE OUT
-
-		PARGraphNode* vrefs[] =
-		{
-			device->GetVref(0)->GetPARNode(),
-			device->GetVref(1)->GetPARNode(),
-			device->GetVref(2)->GetPARNode(),
-			device->GetVref(3)->GetPARNode(),
-			device->GetVref(4)->GetPARNode(),
-			device->GetVref(5)->GetPARNode(),
-
-			//DAC references
-			device->GetVref(6)->GetPARNode(),
-			device->GetVref(7)->GetPARNode()
-		};
-
-		//VREF0/1 can drive pin 19
-		vrefs[0]->AddEdge("VOUT", pin19, "IN");
-		vrefs[1]->AddEdge("VOUT", pin19, "IN");
-
-		//VREF2/3 can drive pin 18
-		vrefs[2]->AddEdge("VOUT", pin18, "IN");
-		vrefs[3]->AddEdge("VOUT", pin18, "IN");
-
-		////////////////////////////////////////////////////////////////////////////////////////////////////////////////
-		// INPUTS TO REFERENCES
-
-		//All comparator references can be driven by Vdd (for Vdd/3 and Vdd/4) and Vss (for constant voltages)
-		for(auto i=0; i<=5; i++)
-		{
-			vdd->AddEdge("OUT", vrefs[i], "VIN");
-			gnd->AddEdge("OUT", vrefs[i], "VIN");
-		}
-
-		//DAC references can be driven by Vss only
-		gnd->AddEdge("OUT", vrefs[6], "VIN");
-		gnd->AddEdge("OUT", vrefs[7], "VIN");
-
-		//External pins
-		pin7->AddEdge("OUT", vrefs[0], "VIN");
-		pin10->AddEdge("OUT", vrefs[0], "VIN");
-
-		pin7->AddEdge("OUT", vrefs[1], "VIN");
-		pin10->AddEdge("OUT", vrefs[1], "VIN");
-
-		pin10->AddEdge("OUT", vrefs[2], "VIN");
-		if(pin14)
-			pin14->AddEdge("OUT", vrefs[2], "VIN");
-
-		pin10->AddEdge("OUT", vrefs[3], "VIN");
-		if(pin14)
-			pin14->AddEdge("OUT", vrefs[3], "VIN");
-
-		pin10->AddEdge("OUT", vrefs[4], "VIN");
-		if(pin14)
-			pin14->AddEdge("OUT", vrefs[4], "VIN");
+		routes = g_slg4662xRoutes;
+		nroutes = sizeof(g_slg4662xRoutes) / sizeof(g_slg4662xRoutes[0]);
+	}
 
-		pin10->AddEdge("OUT", vrefs[5], "VIN");
-		pin5->AddEdge("OUT", vrefs[5], "VIN");
+	char dstport[32];
+	for(size_t i=0; i<nroutes; i++)
+	{
+		const DedicatedRoute& r = routes[i];
 
-		////////////////////////////////////////////////////////////////////////////////////////////////////////////////
-		// REFERENCE TO COMPARATORS
+		//Skip routes to or from blocks this part doesn't have (e.g. pin 14 on the SLG46621)
+		PARGraphNode* src = GetRouteSite(device, r.m_srcType, r.m_srcIndex);
+		if(src == NULL)
+			continue;
 
-		PARGraphNode* acmps[] =
+		for(unsigned int j=0; j<r.m_dstCount; j++)
 		{
-			device->GetAcmp(0)->GetPARNode(),
-			device->GetAcmp(1)->GetPARNode(),
-			device->GetAcmp(2)->GetPARNode(),
-			device->GetAcmp(3)->GetPARNode(),
-			device->GetAcmp(4)->GetPARNode(),
-			device->GetAcmp(5)->GetPARNode()
-		};
+			PARGraphNode* dst = GetRouteSite(device, r.m_dstType, r.m_dstIndex + j);
+			if(dst == NULL)
+				continue;
 
-		//Only allow one VREF to drive its attached comparator.
-		for(unsigned int i=0; i<6; i++)
-			vrefs[i]->AddEdge("VOUT", acmps[i], "VREF");
+			if(r.m_dstWidth == 0)
+				src->AddEdge(r.m_srcPort, dst, r.m_dstPort);
+			for(unsigned int k=0; k<r.m_dstWidth; k++)
+			{
+				snprintf(dstport, sizeof(dstport), "%s[%u]", r.m_dstPort, k);
+				src->AddEdge(r.m_srcPort, dst, dstport);
+			}
+		}
+	}
+}
 
-		////////////////////////////////////////////////////////////////////////////////////////////////////////////////
-		// INPUTS TO COMPARATORS
+/**
+	@brief Looks up the graph node for one of the hard IP blocks in a dedicated routing table
 
-		auto pga = device->GetPGA()->GetPARNode();
-		auto abuf = device->GetAbuf()->GetPARNode();
+	@return The node, or NULL if this part doesn't have that block
+ */
+PARGraphNode* GetRouteSite(Greenpak4Device* device, RouteSiteType type, unsigned int index)
+{
+	Greenpak4BitstreamEntity* entity = NULL;
+	switch(type)
+	{
+		case SITE_IOB:
+			entity = device->GetIOB(index);
+			break;
 
-		//Input to buffer
-		pin6->AddEdge("OUT", abuf, "IN");
+		case SITE_VDD:
+			entity = device->GetPowerRail(true);
+			break;
 
-		//Dedicated inputs for ACMP0 (none)
+		case SITE_GND:
+			entity = device->GetPowerRail(false);
+			break;
 
-		//Dedicated inputs for acmps[1]
-		pin12->AddEdge("OUT", acmps[1], "VIN");
-		pga->AddEdge("VOUT", acmps[1], "VIN");
+		case SITE_LFOSC:
+			entity = device->GetLFOscillator();
+			break;
 
-		//Dedicated inputs for acmps[2]
-		pin13->AddEdge("OUT", acmps[2], "VIN");
+		case SITE_RINGOSC:
+			entity = device->GetRingOscillator();
+			break;
 
-		//Dedicated inputs for acmps[3]
-		pin15->AddEdge("OUT", acmps[3], "VIN");
-		pin13->AddEdge("OUT", acmps[3], "VIN");
+		case SITE_RCOSC:
+			entity = device->GetRCOscillator();
+			break;
 
-		//Dedicated inputs for acmps[4]
-		pin3->AddEdge("OUT", acmps[4], "VIN");
-		pin15->AddEdge("OUT", acmps[4], "VIN");
+		case SITE_COUNTER:
+			if(index < device->GetCounterCount())
+				entity = device->GetCounter(index);
+			break;
 
-		//Dedicated inputs for acmps[5]
-		pin4->AddEdge("OUT", acmps[5], "VIN");
+		case SITE_SYSRST:
+			entity = device->GetSystemReset();
+			break;
 
-		//acmps[0] input before gain stage is fed to everything but acmps[5]
-		pin6->AddEdge("OUT", acmps[0], "VIN");
-		vdd->AddEdge("OUT", acmps[0], "VIN");
-		abuf->AddEdge("OUT", acmps[0], "VIN");
+		case SITE_VREF:
+			if(index < device->GetVrefCount())
+				entity = device->GetVref(index);
+			break;
 
-		pin6->AddEdge("OUT", acmps[1], "VIN");
-		vdd->AddEdge("OUT", acmps[1], "VIN");
-		abuf->AddEdge("OUT", acmps[1], "VIN");
+		case SITE_ACMP:
+			if(index < device->GetAcmpCount())
+				entity = device->GetAcmp(index);
+			break;
 
-		pin6->AddEdge("OUT", acmps[2], "VIN");
-		vdd->AddEdge("OUT", acmps[2], "VIN");
-		abuf->AddEdge("OUT", acmps[2], "VIN");
+		case SITE_PGA:
+			entity = device->GetPGA();
+			break;
 
-		pin6->AddEdge("OUT", acmps[3], "VIN");
-		vdd->AddEdge("OUT", acmps[3], "VIN");
-		abuf->AddEdge("OUT", acmps[3], "VIN");
+		case SITE_ABUF:
+			entity = device->GetAbuf();
+			break;
 
-		pin6->AddEdge("OUT", acmps[4], "VIN");
-		vdd->AddEdge("OUT", acmps[4], "VIN");
-		abuf->AddEdge("OUT", acmps[4], "VIN");
+		case SITE_SPI:
+			entity = device->GetSPI();
+			break;
 
-		////////////////////////////////////////////////////////////////////////////////////////////////////////////////
-		// SPI
+		case SITE_CLKBUF:
+			if(index < device->GetClockBufferCount())
+				entity = device->GetClockBuffer(index);
+			break;
 
-		auto spi = device->GetSPI()->GetPARNode();
+		case SITE_DCMP:
+			if(index < device->GetDcmpCount())
+				entity = device->GetDcmp(index);
+			break;
 
-		PARGraphNode* clkbufs[]=
-		{
-			device->GetClockBuffer(0)->GetPARNode(),
-			device->GetClockBuffer(1)->GetPARNode(),
-			device->GetClockBuffer(2)->GetPARNode(),
-			device->GetClockBuffer(3)->GetPARNode(),
-			device->GetClockBuffer(4)->GetPARNode(),
-		};
-
-		//Pin 10 IOB can drive SPI as MOSI
-		pin10->AddEdge("OUT", spi, "SDAT");
-
-		//SPI can drive pin 10 IOB as MISO
-		spi->AddEdge("SDAT", pin10, "IN");
-
-		//Routes to TX data:
-		//* ground (unused, for RX mode)
-		char txname[16];
-		for(int i=0; i<8; i++)
-		{
-			snprintf(txname, sizeof(txname), "TXD_LOW[%d]", i);
-			gnd->AddEdge("OUT", spi, txname);
+		case SITE_DCMPREF:
+			if(index < device->GetDcmpRefCount())
+				entity = device->GetDcmpRef(index);
+			break;
 
-			snprintf(txname, sizeof(txname), "TXD_HIGH[%d]", i);
-			gnd->AddEdge("OUT", spi, txname);
-		}
+		case SITE_DCMPMUX:
+			entity = device->GetDCMPMux();
+			break;
 
-		//Routes to SPI SCK: dedicated routing from clkbuf4
-		clkbufs[4]->AddEdge("OUT", spi, "SCK");
+		case SITE_DAC:
+			if(index < device->GetDACCount())
+				entity = device->GetDAC(index);
+			break;
+	}
 
-		////////////////////////////////////////////////////////////////////////////////////////////////////////////////
-		// INPUTS TO DIGITAL COMPARATORS
+	if(entity == NULL)
+		return NULL;
+	return entity->GetPARNode();
+}
 
-		PARGraphNode* dcmps[]=
-		{
-			device->GetDcmp(0)->GetPARNode(),
-			device->GetDcmp(1)->GetPARNode(),
-			device->GetDcmp(2)->GetPARNode()
-		};
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Prebuilt device models
 
-		PARGraphNode* dcrefs[]=
-		{
-			device->GetDcmpRef(0)->GetPARNode(),
-			device->GetDcmpRef(1)->GetPARNode(),
-			device->GetDcmpRef(2)->GetPARNode(),
-			device->GetDcmpRef(3)->GetPARNode()
-		};
+/**
+	@brief The device graph for one part, built once and then copied for every design targeting that part
 
-		auto dcmux = device->GetDCMPMux()->GetPARNode();
+	Nothing in here is modified after construction, so a single model can be shared by any number of designs. Each
+	design still gets its own Greenpak4Device (which holds all of the configuration state) and a Clone() of the graph,
+	which shares the edge index and adjacency matrices with the original rather than rebuilding them.
+ */
+class DeviceModel
+{
+public:
+	DeviceModel(Greenpak4Device::GREENPAK4_PART part);
+	~DeviceModel();
 
-		//Inputs to DCMPMUX
-		char inname[16];
-		for(int j=0; j<4; j++)
-		{
-			for(int i=0; i<8; i++)
-			{
-				snprintf(inname, sizeof(inname), "IN%d[%d]", j, i);
-				dcrefs[j]->AddEdge("OUT", dcmux, inname);
-			}
-		}
+	PARGraph* Instantiate(Greenpak4Device* device, PARGraph* ngraph, PARLabelRegistry& lmap) const;
 
-		//Mux driving DCMP0/1
-		for(int i=0; i<8; i++)
-		{
-			snprintf(inname, sizeof(inname), "INP[%d]", i);
-			dcmux->AddEdge("OUTA", dcmps[0], inname);
-			snprintf(inname, sizeof(inname), "INN[%d]", i);
-			dcmux->AddEdge("OUTB", dcmps[1], inname);
-		}
+protected:
+	//The device the graph was built from (the graph nodes point to its entities)
+	Greenpak4Device m_device;
 
-		//Constant inputs from DCREF to DCMP
-		for(int i=0; i<8; i++)
-		{
-			snprintf(inname, sizeof(inname), "INN[%d]", i);
-			dcrefs[0]->AddEdge("OUT", dcmps[0], inname);
-			dcrefs[2]->AddEdge("OUT", dcmps[2], inname);
+	//Position of each entity in m_device's entity list, for finding the same entity in another device
+	unordered_map<void*, uint32_t> m_entityIndex;
 
-			snprintf(inname, sizeof(inname), "INP[%d]", i);
-			dcrefs[1]->AddEdge("OUT", dcmps[1], inname);
-			dcrefs[3]->AddEdge("OUT", dcmps[2], inname);
-		}
+	//The device graph, with edges indexed
+	PARGraph* m_graph;
 
-		//SPI data lines
-		for(int i=0; i<8; i++)
-		{
-			snprintf(inname, sizeof(inname), "INP[%d]", i);
-			spi->AddEdge("RXD_HIGH", dcmps[0], inname);
-			spi->AddEdge("RXD_HIGH", dcmps[1], inname);
-
-			snprintf(inname, sizeof(inname), "INN[%d]", i);
-			spi->AddEdge("RXD_LOW", dcmps[0], inname);
-			spi->AddEdge("RXD_LOW", dcmps[1], inname);
-			spi->AddEdge("RXD_LOW", dcmps[2], inname);
-		}
+	//Names and site tables of the labels allocated in m_graph
+	PARLabelRegistry m_lmap;
+};
 
-		//TODO: Other inputs: ADC, counters
+DeviceModel::DeviceModel(Greenpak4Device::GREENPAK4_PART part)
+	: m_device(part, Greenpak4IOB::PULL_NONE, Greenpak4IOB::PULL_10K)
+	, m_graph(new PARGraph)
+{
+	//Labels have to be allocated in lockstep with a netlist graph, so use a scratch one
+	PARGraph* ngraph = new PARGraph;
+	MakeDeviceNodes(&m_device, ngraph, m_graph, m_lmap);
+	MakeDeviceEdges(&m_device);
+	delete ngraph;
+
+	//The device graph is now final, so index its edges for fast routability checks during PAR.
+	//Greenpak devices are small enough that the bit matrices are tiny, so build those too.
+	m_graph->IndexEdges();
+	m_graph->BuildAdjacency();
+
+	//Sort the sites by label and matrix once, for every engine placing any design into the part
+	m_graph->IndexNodesByLabel();
+	m_lmap.IndexSites(m_graph, m_device.GetMatrixCount(), [](PARGraphNode* site)
+	{
+		return static_cast<Greenpak4BitstreamEntity*>(site->GetData())->GetMatrix();
+	});
 
-		//ADC/DCMP Clock mux routing
-		auto mbuf = dynamic_cast<Greenpak4MuxedClockBuffer*>(device->GetClockBuffer(5))->GetPARNode();
-		rosc->AddEdge("CLKOUT_HARDIP", mbuf, "IN");
-		rcosc->AddEdge("CLKOUT_HARDIP", mbuf, "IN");
-		clkbufs[2]->AddEdge("OUT", mbuf, "IN");
-		clkbufs[4]->AddEdge("OUT", mbuf, "IN");
+	for(unsigned int i=0; i<m_device.GetEntityCount(); i++)
+		m_entityIndex[m_device.GetEntity(i)] = i;
+}
 
-		//Clock inputs to DCMP
-		for(int i=0; i<3; i++)
-		{
-			clkbufs[1]->AddEdge("OUT", dcmps[i], "CLK");
-			mbuf->AddEdge("OUT", dcmps[i], "CLK");
-		}
+DeviceModel::~DeviceModel()
+{
+	delete m_graph;
+	m_graph = NULL;
+}
 
-		////////////////////////////////////////////////////////////////////////////////////////////////////////////////
-		// INPUTS TO PGA
+/**
+	@brief Makes a copy of the device graph for one design
 
-		vdd->AddEdge("OUT", pga, "VIN_P");
-		pin8->AddEdge("OUT", pga, "VIN_P");
+	@param device	The device being configured (must be the same part as the model)
+	@param ngraph	Empty netlist graph for the design. The same labels are allocated in it.
+	@param lmap		Label registry for the design (a copy of the model's is stored here)
 
-		pin9->AddEdge("OUT", pga, "VIN_N");
-		gnd->AddEdge("OUT", pga, "VIN_N");
-		//TODO: DAC output
+	@return The new device graph, whose nodes point to the entities of the provided device
+ */
+PARGraph* DeviceModel::Instantiate(Greenpak4Device* device, PARGraph* ngraph, PARLabelRegistry& lmap) const
+{
+	if(device->GetEntityCount() != m_entityIndex.size())
+		LogFatal("Device doesn't match the model it's being instantiated from\n");
 
-		pin16->AddEdge("OUT", pga, "VIN_SEL");
-		vdd->AddEdge("OUT", pga, "VIN_SEL");
+	//Entity lists are built in the same order for every instance of a part, so map by position
+	PARGraph* dgraph = m_graph->Clone();
+	for(uint32_t i=0; i<dgraph->GetNumNodes(); i++)
+	{
+		auto node = dgraph->GetNodeByIndex(i);
+		auto entity = device->GetEntity(m_entityIndex.at(node->GetData()));
+		node->SetData(entity);
+		entity->SetPARNode(node);
+	}
 
-		//TODO: Output to ADC
+	for(uint32_t i=0; i<m_lmap.GetNumLabels(); i++)
+		ngraph->AllocateLabel();
+	lmap = m_lmap;
 
-		////////////////////////////////////////////////////////////////////////////////////////////////////////////////
-		// PGA to IOB
+	return dgraph;
+}
 
-		pga->AddEdge("VOUT", pin7, "IN");
+//Models built so far, by part
+static mutex g_deviceModelMutex;
+static map<Greenpak4Device::GREENPAK4_PART, unique_ptr<DeviceModel> > g_deviceModels;
 
-		////////////////////////////////////////////////////////////////////////////////////////////////////////////////
-		// INPUTS TO DAC
+/**
+	@brief Gets the model for a part, building it if this is the first time it's needed
 
-		PARGraphNode* dacs[] =
-		{
-			device->GetDAC(0)->GetPARNode(),
-			device->GetDAC(1)->GetPARNode()
-		};
+	Must be called with g_deviceModelMutex held.
+ */
+static const DeviceModel* GetDeviceModel(Greenpak4Device::GREENPAK4_PART part)
+{
+	auto& model = g_deviceModels[part];
+	if(!model)
+		model.reset(new DeviceModel(part));
+	return model.get();
+}
 
-		//DAC voltage references driving DAC inputs
-		vrefs[6]->AddEdge("VOUT", dacs[0], "VREF");
-		vrefs[7]->AddEdge("VOUT", dacs[1], "VREF");
+/**
+	@brief Creates the device graph for a design, building the model for its part if this is the first one
+ */
+PARGraph* MakeDeviceGraph(Greenpak4Device* device, PARGraph* ngraph, PARLabelRegistry& lmap)
+{
+	lock_guard<mutex> lock(g_deviceModelMutex);
+	return GetDeviceModel(device->GetPart())->Instantiate(device, ngraph, lmap);
+}
 
-		//Static 1/0 for register configuration
-		for(size_t i=0; i<device->GetDACCount(); i++)
-		{
-			auto dac = device->GetDAC(i)->GetPARNode();
-
-			vdd->AddEdge("OUT", dac, "DIN[0]");
-			vdd->AddEdge("OUT", dac, "DIN[1]");
-			vdd->AddEdge("OUT", dac, "DIN[2]");
-			vdd->AddEdge("OUT", dac, "DIN[3]");
-			vdd->AddEdge("OUT", dac, "DIN[4]");
-			vdd->AddEdge("OUT", dac, "DIN[5]");
-			vdd->AddEdge("OUT", dac, "DIN[6]");
-			vdd->AddEdge("OUT", dac, "DIN[7]");
-
-			gnd->AddEdge("OUT", dac, "DIN[0]");
-			gnd->AddEdge("OUT", dac, "DIN[1]");
-			gnd->AddEdge("OUT", dac, "DIN[2]");
-			gnd->AddEdge("OUT", dac, "DIN[3]");
-			gnd->AddEdge("OUT", dac, "DIN[4]");
-			gnd->AddEdge("OUT", dac, "DIN[5]");
-			gnd->AddEdge("OUT", dac, "DIN[6]");
-			gnd->AddEdge("OUT", dac, "DIN[7]");
-		}
+/**
+	@brief Points a copy of a device graph at another device of the same part, such as a configuration layer (see
+	Greenpak4Device::CreateConfigLayer())
 
-		//TODO: Direct inputs from counters
+	@param dgraph	The device graph, whose nodes point to the entities of from
+	@param from		The device the graph was made for
+	@param to		The device to use instead
+ */
+void RebindDeviceGraph(PARGraph* dgraph, Greenpak4Device* from, Greenpak4Device* to)
+{
+	if(from->GetEntityCount() != to->GetEntityCount())
+		LogFatal("Can't rebind a device graph to a different part\n");
+
+	//Same trick as DeviceModel::Instantiate()
+	unordered_map<void*, uint32_t> index;
+	for(unsigned int i=0; i<from->GetEntityCount(); i++)
+		index[from->GetEntity(i)] = i;
+	for(uint32_t i=0; i<dgraph->GetNumNodes(); i++)
+	{
+		auto node = dgraph->GetNodeByIndex(i);
+		auto entity = to->GetEntity(index.at(node->GetData()));
+		node->SetData(entity);
+		entity->SetPARNode(node);
+	}
+}
 
-		////////////////////////////////////////////////////////////////////////////////////////////////////////////////
-		// OUTPUTS FROM DAC
+/**
+	@brief Builds the model for a part ahead of time, so the first design targeting it doesn't have to wait
+ */
+void PreloadDeviceModel(Greenpak4Device::GREENPAK4_PART part)
+{
+	lock_guard<mutex> lock(g_deviceModelMutex);
+	GetDeviceModel(part);
+}
 
-		// Both DACs can drive to every comparator vref
-		for(int i=0; i<2; i++)
-		{
-			for(int j=0; j<6; j++)
-				dacs[i]->AddEdge("VOUT", vrefs[j], "VIN");
-		}
+/**
+	@brief Starts building the model for a part on a background thread, unless it's already built.
 
-		//DACs can drive I/O pins directly without going through a GP_VREF
-		dacs[0]->AddEdge("VOUT", pin19, "IN");
-		dacs[1]->AddEdge("VOUT", pin18, "IN");
+	Create one of these before loading the netlist, so the two overlap. If BuildGraphs() gets there first, it waits
+	for the model to be finished.
+ */
+DeviceModelPreloader::DeviceModelPreloader(Greenpak4Device::GREENPAK4_PART part)
+{
+	{
+		lock_guard<mutex> lock(g_deviceModelMutex);
+		auto it = g_deviceModels.find(part);
+		if( (it != g_deviceModels.end()) && it->second )
+			return;
 	}
+
+	m_thread = thread(PreloadDeviceModel, part);
+}
+
+DeviceModelPreloader::~DeviceModelPreloader()
+{
+	if(m_thread.joinable())
+		m_thread.join();
 }
@@ -0,0 +1,714 @@
+/***********************************************************************************************************************
+ * Copyright (C) 2016 Andrew Zonenberg and contributors                                                                *
+ *                                                                                                                     *
+ * This program is free software; you can redistribute it and/or modify it under the terms of the GNU Lesser General   *
+ * Public License as published by the Free Software Foundation; either version 2.1 of the License, or (at your option) *
+ * any later version.                                                                                                  *
+ *                                                                                                                     *
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied  *
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for     *
+ * more details.                                                                                                       *
+ *                                                                                                                     *
+ * You should have received a copy of the GNU Lesser General Public License along with this program; if not, you may   *
+ * find one here:                                                                                                      *
+ * https://www.gnu.org/licenses/old-licenses/lgpl-2.1.txt                                                              *
+ * or you may search the http://www.gnu.org website for the version 2.1 license, or you may write to the Free Software *
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA                                      *
+ **********************************************************************************************************************/
+
+#include "gp4par.h"
+
+using namespace std;
+
+/*
+	Test multiplexing: most hardware-in-loop test designs only use a small part of the chip, so several of them are
+	merged into one netlist and compiled (and downloaded to the test board) together.
+
+	Each netlist's top module goes into the merged top module with its port, cell and net names prefixed by the design
+	name (the file name, less directory and extension), and its nets renumbered so they don't collide with the other
+	designs'. Cell library modules are copied over once. Power rails and the power-on reset are shared, since there's
+	only one of each in the chip. Pins that more than one design has a LOC constraint for are an error; the rest of
+	the IOBs are split up between the designs by PAR.
+
+	The manifest says which pin each port of each design ended up on, so the test harness knows where to find them.
+ */
+
+/**
+	@brief A port, cell or named net from one of the netlists being merged
+ */
+class MergeObject
+{
+public:
+	std::string name;
+
+	//Members we don't change, as JSON text
+	std::vector< std::pair<std::string, std::string> > members;
+
+	//Nets of a port or named net (numbers as decimal, constants as quoted strings)
+	std::vector<std::string> bits;
+
+	//Nets of each cell port, in the same format
+	std::vector< std::pair<std::string, std::vector<std::string> > > connections;
+
+	//Cell type, parameters (as JSON text) and LOC constraint (empty if none)
+	std::string type;
+	std::string parameters;
+	std::string loc;
+};
+
+/**
+	@brief The top module of one of the netlists being merged
+ */
+class MergeDesign
+{
+public:
+	MergeDesign()
+		: offset(0)
+		, maxNet(1)
+	{}
+
+	std::string name;
+
+	std::vector<MergeObject> ports;
+	std::vector<MergeObject> cells;
+	std::vector<MergeObject> netnames;
+
+	//Set for each cell that's shared with another design (see IsSharedCell())
+	std::vector<bool> shared;
+
+	//Added to every net number (other than the reserved 0 and 1) to make it unique in the merged netlist
+	int32_t offset;
+
+	//Highest net number used
+	int32_t maxNet;
+
+	//Nets of shared cells, mapped to the merged net numbers of the copy that's kept
+	std::map<int32_t, int32_t> aliases;
+
+	std::string MapNet(const std::string& bit) const;
+};
+
+/**
+	@brief Converts one net from a design's numbering to the merged netlist's
+ */
+string MergeDesign::MapNet(const string& bit) const
+{
+	if(bit[0] == '\"')
+		return bit;
+
+	int32_t net = atoi(bit.c_str());
+	auto it = aliases.find(net);
+	if(it != aliases.end())
+		net = it->second;
+	else if(net > 1)
+		net += offset;
+
+	char tmp[16];
+	snprintf(tmp, sizeof(tmp), "%d", net);
+	return tmp;
+}
+
+/**
+	@brief Returns true for cells there's only one of in the chip, so designs that both have one have to share it
+ */
+static bool IsSharedCell(const MergeObject& cell)
+{
+	return (cell.type == "GP_VDD") || (cell.type == "GP_VSS") || (cell.type == "GP_POR");
+}
+
+/**
+	@brief Quotes a string for JSON
+ */
+static string QuoteJSON(const string& str)
+{
+	string ret = "\"";
+	for(auto c : str)
+	{
+		if( (c == '\"') || (c == '\\') )
+		{
+			ret += '\\';
+			ret += c;
+		}
+		else if(static_cast<unsigned char>(c) < 0x20)
+		{
+			char tmp[8];
+			snprintf(tmp, sizeof(tmp), "\\u%04x", c);
+			ret += tmp;
+		}
+		else
+			ret += c;
+	}
+	return ret + "\"";
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Reading
+
+/**
+	@brief Reads any value as JSON text
+ */
+static bool ReadRaw(Greenpak4JSONReader& reader, string& raw)
+{
+	if(reader.PeekType() != Greenpak4JSONReader::TYPE_STRING)
+		return reader.ReadScalar(raw);
+
+	string value;
+	if(!reader.ReadString(value))
+		return false;
+	raw = QuoteJSON(value);
+	return true;
+}
+
+/**
+	@brief Reads an array of nets, noting the highest net number
+ */
+static bool ReadBits(Greenpak4JSONReader& reader, vector<string>& bits, MergeDesign& design)
+{
+	if(!reader.BeginArray())
+		return false;
+	while(reader.NextElement())
+	{
+		string bit;
+		if(reader.PeekType() == Greenpak4JSONReader::TYPE_NUMBER)
+		{
+			int32_t net;
+			if(!reader.ReadInt(net) || (net < 0))
+				return false;
+			design.maxNet = max(design.maxNet, net);
+			bits.push_back(to_string(net));
+		}
+		else if(reader.PeekType() == Greenpak4JSONReader::TYPE_STRING)
+		{
+			if(!reader.ReadString(bit))
+				return false;
+			bits.push_back(QuoteJSON(bit));
+		}
+		else
+			return false;
+	}
+	return reader.Validate();
+}
+
+/**
+	@brief Reads a cell's LOC constraint out of its attributes (given as JSON text)
+ */
+static bool ReadLOC(const string& attributes, string& loc)
+{
+	Greenpak4JSONReader reader(attributes.c_str(), attributes.length());
+	string name;
+	reader.BeginObject();
+	while(reader.NextMember(name))
+	{
+		if( (name == "LOC") && (reader.PeekType() == Greenpak4JSONReader::TYPE_STRING) )
+			reader.ReadString(loc);
+		else
+			reader.SkipValue();
+	}
+	return reader.Validate();
+}
+
+/**
+	@brief Reads one of the objects ("ports", "cells" or "netnames") of a top module, given as JSON text
+ */
+static bool ReadObjects(const string& json, vector<MergeObject>& objects, MergeDesign& design)
+{
+	Greenpak4JSONReader reader(json.c_str(), json.length());
+	string name;
+	if(!reader.BeginObject())
+		return false;
+	while(reader.NextMember(name))
+	{
+		objects.push_back(MergeObject());
+		MergeObject& obj = objects.back();
+		obj.name = name;
+
+		string mname;
+		if(!reader.BeginObject())
+			return false;
+		while(reader.NextMember(mname))
+		{
+			if(mname == "bits")
+			{
+				if(!ReadBits(reader, obj.bits, design))
+					return false;
+			}
+
+			else if(mname == "connections")
+			{
+				string port;
+				if(!reader.BeginObject())
+					return false;
+				while(reader.NextMember(port))
+				{
+					obj.connections.push_back(pair<string, vector<string> >(port, vector<string>()));
+					if(!ReadBits(reader, obj.connections.back().second, design))
+						return false;
+				}
+			}
+
+			else if( (mname == "type") && (reader.PeekType() == Greenpak4JSONReader::TYPE_STRING) )
+			{
+				if(!reader.ReadString(obj.type))
+					return false;
+				obj.members.push_back(pair<string, string>(mname, QuoteJSON(obj.type)));
+			}
+
+			else
+			{
+				string raw;
+				if(!ReadRaw(reader, raw))
+					return false;
+				obj.members.push_back(pair<string, string>(mname, raw));
+
+				if(mname == "parameters")
+					obj.parameters = raw;
+				else if( (mname == "attributes") && !ReadLOC(raw, obj.loc) )
+					return false;
+			}
+		}
+	}
+	return reader.Validate();
+}
+
+/**
+	@brief Reads the parts of a module we need (given as JSON text)
+
+	@return True if it's the top module
+ */
+static bool ReadModule(const string& json, MergeDesign& design, bool& ok)
+{
+	bool top = false;
+	string ports;
+	string cells;
+	string netnames;
+
+	Greenpak4JSONReader reader(json.c_str(), json.length());
+	string name;
+	reader.BeginObject();
+	while(reader.NextMember(name))
+	{
+		if( (name == "attributes") && (reader.PeekType() == Greenpak4JSONReader::TYPE_OBJECT) )
+		{
+			string aname;
+			reader.BeginObject();
+			while(reader.NextMember(aname))
+			{
+				if(aname == "top")
+					top = true;
+				reader.SkipValue();
+			}
+		}
+		else if(name == "ports")
+			reader.ReadScalar(ports);
+		else if(name == "cells")
+			reader.ReadScalar(cells);
+		else if(name == "netnames")
+			reader.ReadScalar(netnames);
+		else
+			reader.SkipValue();
+	}
+
+	ok = reader.Validate();
+	if(!ok || !top)
+		return top;
+
+	ok =
+		( ports.empty() || ReadObjects(ports, design.ports, design) ) &&
+		( cells.empty() || ReadObjects(cells, design.cells, design) ) &&
+		( netnames.empty() || ReadObjects(netnames, design.netnames, design) );
+	return true;
+}
+
+/**
+	@brief Loads the top module of a netlist, and any cell library modules we don't have yet
+
+	@return True on success, false (after logging why) if the file can't be read or has no top module
+ */
+static bool ReadDesign(const string& fname, MergeDesign& design, vector< pair<string, string> >& libraries)
+{
+	string data;
+	if(!ReadInputFile(fname, data))
+		return false;
+
+	bool found = false;
+	bool ok = true;
+	Greenpak4JSONReader reader(data.c_str(), data.length());
+	string name;
+	reader.BeginObject();
+	while(ok && reader.NextMember(name))
+	{
+		if(name != "modules")
+		{
+			reader.SkipValue();
+			continue;
+		}
+
+		string mname;
+		reader.BeginObject();
+		while(ok && reader.NextMember(mname))
+		{
+			string module;
+			if(!reader.ReadScalar(module))
+				break;
+
+			if(ReadModule(module, design, ok))
+			{
+				if(found)
+				{
+					LogError("Netlist %s has more than one top module\n", fname.c_str());
+					return false;
+				}
+				found = true;
+				continue;
+			}
+
+			bool have = false;
+			for(auto& lib : libraries)
+				have |= (lib.first == mname);
+			if(!have)
+				libraries.push_back(pair<string, string>(mname, module));
+		}
+	}
+
+	if(!ok || !reader.Validate())
+	{
+		LogError("Netlist %s is malformed\n", fname.c_str());
+		return false;
+	}
+	if(!found)
+	{
+		LogError("Netlist %s has no top module\n", fname.c_str());
+		return false;
+	}
+	return true;
+}
+
+/**
+	@brief Gets the design name for a netlist: the file name, less directory and extension
+ */
+static string GetDesignName(const string& fname)
+{
+	size_t slash = fname.rfind('/');
+	string name = (slash == string::npos) ? fname : fname.substr(slash + 1);
+	size_t dot = name.rfind('.');
+	if( (dot != string::npos) && (dot > 0) )
+		name = name.substr(0, dot);
+	return name;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Merging
+
+/**
+	@brief Shares cells there's only one of in the chip, and checks the designs don't want the same pins
+
+	@return True on success, false (after logging why) if two designs have a LOC constraint for the same site
+ */
+static bool ResolveConflicts(vector<MergeDesign>& designs)
+{
+	//The first copy of each shared cell (by type and parameters), as design and cell index
+	map<string, pair<size_t, size_t> > sharedCells;
+
+	//Who's LOC'd onto each site
+	map<string, string> sites;
+
+	for(size_t i=0; i<designs.size(); i++)
+	{
+		MergeDesign& design = designs[i];
+		design.shared.resize(design.cells.size(), false);
+		for(size_t j=0; j<design.cells.size(); j++)
+		{
+			MergeObject& cell = design.cells[j];
+
+			if(IsSharedCell(cell))
+			{
+				string key = cell.type + "\n" + cell.parameters;
+				auto it = sharedCells.find(key);
+				if(it == sharedCells.end())
+				{
+					sharedCells[key] = pair<size_t, size_t>(i, j);
+					continue;
+				}
+
+				//Connect our nets to the first copy's, and drop our copy
+				const MergeDesign& first = designs[it->second.first];
+				const MergeObject& kept = first.cells[it->second.second];
+				for(auto& c : cell.connections)
+				{
+					for(auto& k : kept.connections)
+					{
+						if(k.first != c.first)
+							continue;
+						for(size_t b=0; (b<c.second.size()) && (b<k.second.size()); b++)
+						{
+							if( (c.second[b][0] != '\"') && (k.second[b][0] != '\"') )
+								design.aliases[atoi(c.second[b].c_str())] = atoi(first.MapNet(k.second[b]).c_str());
+						}
+					}
+				}
+				design.shared[j] = true;
+				continue;
+			}
+
+			//Vector IOBs have one LOC per bit, separated by spaces
+			size_t pos = 0;
+			while(pos < cell.loc.length())
+			{
+				size_t end = cell.loc.find(' ', pos);
+				if(end == string::npos)
+					end = cell.loc.length();
+				string site = cell.loc.substr(pos, end - pos);
+				pos = end + 1;
+				if(site.empty())
+					continue;
+
+				auto it = sites.find(site);
+				if( (it != sites.end()) && (it->second != design.name) )
+				{
+					LogError("Designs \"%s\" and \"%s\" are both constrained to %s, can't merge them\n",
+						it->second.c_str(), design.name.c_str(), site.c_str());
+					return false;
+				}
+				sites[site] = design.name;
+			}
+		}
+	}
+
+	return true;
+}
+
+/**
+	@brief Writes a list of nets, renumbered for the merged netlist
+ */
+static void WriteBits(FILE* fp, const MergeDesign& design, const vector<string>& bits)
+{
+	fprintf(fp, "[");
+	for(size_t i=0; i<bits.size(); i++)
+		fprintf(fp, "%s%s", (i == 0) ? " " : ", ", design.MapNet(bits[i]).c_str());
+	fprintf(fp, " ]");
+}
+
+/**
+	@brief Writes the ports, cells or named nets of every design into the merged top module
+ */
+static void WriteObjects(FILE* fp, const vector<MergeDesign>& designs, vector<MergeObject> MergeDesign::*list)
+{
+	bool first = true;
+	for(auto& design : designs)
+	{
+		const vector<MergeObject>& objects = design.*list;
+		for(size_t i=0; i<objects.size(); i++)
+		{
+			if( (list == &MergeDesign::cells) && design.shared[i] )
+				continue;
+			const MergeObject& obj = objects[i];
+
+			fprintf(fp, "%s\n        ", first ? "" : ",");
+			first = false;
+			WriteJSONString(fp, design.name + "/" + obj.name);
+			fprintf(fp, ": {");
+
+			//The netlist loader applies net attributes to the bits it has already seen, so those go first
+			const char* sep = "\n";
+			if(list != &MergeDesign::cells)
+			{
+				fprintf(fp, "\n            \"bits\": ");
+				WriteBits(fp, design, obj.bits);
+				sep = ",\n";
+			}
+			for(auto& m : obj.members)
+			{
+				fprintf(fp, "%s            ", sep);
+				WriteJSONString(fp, m.first);
+				fprintf(fp, ": %s", m.second.c_str());
+				sep = ",\n";
+			}
+
+			if(list == &MergeDesign::cells)
+			{
+				fprintf(fp, "%s            \"connections\": {", sep);
+				for(size_t j=0; j<obj.connections.size(); j++)
+				{
+					fprintf(fp, "%s\n                ", (j == 0) ? "" : ",");
+					WriteJSONString(fp, obj.connections[j].first);
+					fprintf(fp, ": ");
+					WriteBits(fp, design, obj.connections[j].second);
+				}
+				fprintf(fp, "\n            }");
+			}
+			fprintf(fp, "\n        }");
+		}
+	}
+}
+
+/**
+	@brief Lists every port bit of every design, and the IOB cell on its pad
+ */
+static void ListPorts(const vector<MergeDesign>& designs, vector<MergedPort>& ports)
+{
+	for(auto& design : designs)
+	{
+		//Find the cell on each pad net
+		map<string, string> pads;
+		for(auto& cell : design.cells)
+		{
+			string pad;
+			if(cell.type == "GP_IBUF")
+				pad = "IN";
+			else if( (cell.type == "GP_OBUF") || (cell.type == "GP_OBUFT") )
+				pad = "OUT";
+			else if(cell.type == "GP_IOBUF")
+				pad = "IO";
+			else
+				continue;
+
+			for(auto& c : cell.connections)
+			{
+				if( (c.first == pad) && (c.second.size() == 1) )
+					pads[c.second[0]] = design.name + "/" + cell.name;
+			}
+		}
+
+		for(auto& port : design.ports)
+		{
+			string direction;
+			for(auto& m : port.members)
+			{
+				if(m.first == "direction")
+					direction = m.second.substr(1, m.second.length() - 2);
+			}
+
+			for(size_t i=0; i<port.bits.size(); i++)
+			{
+				MergedPort p;
+				p.design = design.name;
+				p.port = port.name;
+				if(port.bits.size() > 1)
+					p.port += "[" + to_string(i) + "]";
+				p.direction = direction;
+				auto it = pads.find(port.bits[i]);
+				if(it != pads.end())
+					p.iob = it->second;
+				ports.push_back(p);
+			}
+		}
+	}
+}
+
+/**
+	@brief Merges several independent netlists into one, for compiling into a single bitstream
+
+	@param files	The netlists
+	@param json		Set to the merged netlist
+	@param ports	Set to the ports of every design, for FormatMergeManifest()
+
+	@return True on success, false (after logging why) if a netlist can't be read, or the designs conflict
+ */
+bool MergeNetlists(const vector<string>& files, string& json, vector<MergedPort>& ports)
+{
+	LogNotice("\nMerging %zu netlists...\n", files.size());
+	LogIndenter li;
+
+	vector<MergeDesign> designs(files.size());
+	vector< pair<string, string> > libraries;
+	set<string> names;
+	int32_t offset = 0;
+	for(size_t i=0; i<files.size(); i++)
+	{
+		MergeDesign& design = designs[i];
+		if(!ReadDesign(files[i], design, libraries))
+			return false;
+
+		//Names have to be unique, so add a number if two files have the same name
+		design.name = GetDesignName(files[i]);
+		for(unsigned int n=2; names.find(design.name) != names.end(); n++)
+			design.name = GetDesignName(files[i]) + "_" + to_string(n);
+		names.insert(design.name);
+
+		design.offset = offset;
+		offset += design.maxNet;
+
+		LogVerbose("%s: %zu ports, %zu cells\n", design.name.c_str(), design.ports.size(), design.cells.size());
+	}
+
+	if(!ResolveConflicts(designs))
+		return false;
+
+	char* buf = NULL;
+	size_t len = 0;
+	FILE* fp = open_memstream(&buf, &len);
+	if(!fp)
+		LogFatal("Couldn't allocate merged netlist\n");
+
+	fprintf(fp, "{\n");
+	fprintf(fp, "    \"creator\": \"gp4par --merge\",\n");
+	fprintf(fp, "    \"modules\": {\n");
+	for(auto& lib : libraries)
+	{
+		fprintf(fp, "    ");
+		WriteJSONString(fp, lib.first);
+		fprintf(fp, ": %s,\n", lib.second.c_str());
+	}
+	fprintf(fp, "    \"merged\": {\n");
+	fprintf(fp, "    \"attributes\": { \"top\": 1 },\n");
+	fprintf(fp, "    \"ports\": {");
+	WriteObjects(fp, designs, &MergeDesign::ports);
+	fprintf(fp, "\n    },\n");
+	fprintf(fp, "    \"cells\": {");
+	WriteObjects(fp, designs, &MergeDesign::cells);
+	fprintf(fp, "\n    },\n");
+	fprintf(fp, "    \"netnames\": {");
+	WriteObjects(fp, designs, &MergeDesign::netnames);
+	fprintf(fp, "\n    }\n");
+	fprintf(fp, "    }\n");
+	fprintf(fp, "    }\n");
+	fprintf(fp, "}\n");
+
+	fclose(fp);
+	json = string(buf, len);
+	free(buf);
+
+	ListPorts(designs, ports);
+	return true;
+}
+
+/**
+	@brief Formats the manifest for a merged netlist: which pin each port of each design is on
+
+	One line per port bit: design, port, direction and pin (or - for a port without an IOB), separated by tabs.
+
+	@param ports		The ports, from MergeNetlists()
+	@param placement	The placement of the merged netlist (see FormatPlacement())
+ */
+string FormatMergeManifest(const vector<MergedPort>& ports, const string& placement)
+{
+	//Site of each cell
+	map<string, string> sites;
+	size_t pos = 0;
+	while(pos < placement.length())
+	{
+		size_t end = placement.find('\n', pos);
+		if(end == string::npos)
+			end = placement.length();
+		string line = placement.substr(pos, end - pos);
+		pos = end + 1;
+		if(line.empty() || (line[0] == '#'))
+			continue;
+
+		size_t tab1 = line.find('\t');
+		size_t tab2 = (tab1 == string::npos) ? string::npos : line.find('\t', tab1 + 1);
+		if(tab2 != string::npos)
+			sites[line.substr(tab2 + 1)] = line.substr(0, tab1);
+	}
+
+	string manifest = "# gp4par merged netlist: design, port, direction, pin\n";
+	for(auto& p : ports)
+	{
+		string pin = "-";
+		auto it = sites.find(p.iob);
+		if(it != sites.end())
+			pin = it->second;
+		manifest += p.design + "\t" + p.port + "\t" + p.direction + "\t" + pin + "\n";
+	}
+	return manifest;
+}
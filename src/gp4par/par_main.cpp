@@ -16,29 +16,239 @@
  * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA                                      *
  **********************************************************************************************************************/
 
+#include <algorithm>
+#include <chrono>
+#include <thread>
+#include <mutex>
 #include "gp4par.h"
 
 using namespace std;
 
-bool CheckAnalogIbuf(Greenpak4BitstreamEntity* load, Greenpak4IOB* iob);
+//Every nanosecond over the timing target costs as much as one unit of congestion
+static const uint32_t TIMING_COST_SCALE = 1000;
+
+//When starting from a previous placement, start annealing cold enough that few uphill moves are accepted, so we
+//mostly just fix up the changed cells instead of scrambling everything, and don't trade the old placement for an
+//equally good one at the end
+static const double REUSE_INITIAL_ACCEPTANCE = 0.1;
+
+//After multi-level placement the clusters are already in sensible matrices, so annealing only needs to refine it
+//locally rather than start from a random walk
+static const double MULTILEVEL_INITIAL_ACCEPTANCE = 0.3;
 
 /**
 	@brief The main place-and-route logic
+
+	@param result	If not NULL, the DRC report, critical path delay, placement, timing report (if --timing-report
+					asked for one) and statistics are stored here
  */
-bool DoPAR(Greenpak4Netlist* netlist, Greenpak4Device* device)
+bool DoPAR(Greenpak4Netlist* netlist, Greenpak4Device* device, const PAROptions& options, CompileResult* result)
 {
-	labelmap lmap;
+	PARLabelRegistry lmap;
+	CompileStatistics unused_stats;
+	CompileStatistics& stats = result ? result->stats : unused_stats;
+	auto start = chrono::steady_clock::now();
+
+	//The time limit covers everything, not just annealing
+	auto deadline = start + chrono::duration_cast<chrono::steady_clock::duration>(
+		chrono::duration<double>(options.timeLimit));
+
+	//Load the previous placement, if we're starting from one (or have been given the placement to use)
+	placementmap previous;
+	bool fixed = !options.fixedPlacement.empty();
+	if(fixed)
+	{
+		if(!ParsePlacement(options.fixedPlacement, "the remote sweep result", previous))
+			return false;
+	}
+	else if(!options.reusePlacementFile.empty())
+	{
+		if(!ReadPlacementFile(options.reusePlacementFile, previous))
+			return false;
+	}
+
+	//and the annealing schedule
+	PARAnnealOptions profile;
+	if(!GetAnnealProfile(device->GetPart(), options.annealProfileFile, profile))
+		return false;
+
+	//and the move log to check against, if we're replaying one. Seeds run in parallel on other engines, so their
+	//moves can't be recorded.
+	bool log_moves = !options.recordMovesFile.empty() || !options.replayMovesFile.empty();
+	if(log_moves && (options.seeds > 1))
+	{
+		LogError("--record-moves and --replay-moves can't be used with --seeds\n");
+		return false;
+	}
+	PARMoveLog move_log;
+	if(!options.replayMovesFile.empty() && !move_log.LoadReference(options.replayMovesFile))
+		return false;
+
+	//Clean up the netlist first so there's less to place
+	if(options.optimize)
+	{
+		TraceSpan span("Optimize netlist");
+		Greenpak4NetlistOptimizer optimizer(netlist, device);
+		optimizer.Optimize();
+		stats.EndPhase("optimize", start);
+	}
 
 	//Create the graphs
 	LogNotice("\nCreating netlist graphs...\n");
+	start = chrono::steady_clock::now();
 	PARGraph* ngraph = NULL;
 	PARGraph* dgraph = NULL;
-	if(!BuildGraphs(netlist, device, ngraph, dgraph, lmap))
+	bool built = BuildGraphs(netlist, device, ngraph, dgraph, lmap);
+	stats.EndPhase("build_graphs", start);
+	if(!built)
 		return false;
 
+	//Now that the graphs are final, cache the site attributes everything from here on needs
+	start = chrono::steady_clock::now();
+	Greenpak4SiteTable sites(ngraph, dgraph);
+
 	//Create and run the PAR engine
-	Greenpak4PAREngine engine(ngraph, dgraph, lmap);
-	if(!engine.PlaceAndRoute(lmap, true))
+	Greenpak4PAREngine engine(ngraph, dgraph, device, &sites, &lmap);
+	engine.SetVerifyIncrementalCost(options.verifyCost);
+	engine.SetTimingTarget(options.timingTarget, TIMING_COST_SCALE);
+	engine.SetMoveBatch(options.batchMoves, options.jobs);
+	engine.SetCancelFlag(options.cancel);
+	engine.SetMultilevel(options.multilevel);
+	engine.SetAnnealOptions(profile);
+	engine.SetProgressCallback(options.progress);
+	if(log_moves)
+		engine.SetMoveLog(&move_log);
+	if(options.timeLimit > 0)
+		engine.SetDeadline(deadline);
+	if(fixed)
+		engine.SetPreviousPlacement(&previous);
+	else if(!options.reusePlacementFile.empty())
+	{
+		engine.SetPreviousPlacement(&previous);
+		PARAnnealOptions anneal = engine.GetAnnealOptions();
+		anneal.initialAcceptance = REUSE_INITIAL_ACCEPTANCE;
+		anneal.keepFirstBest = true;
+		engine.SetAnnealOptions(anneal);
+	}
+	else if(options.multilevel)
+	{
+		PARAnnealOptions anneal = engine.GetAnnealOptions();
+		anneal.initialAcceptance = MULTILEVEL_INITIAL_ACCEPTANCE;
+		engine.SetAnnealOptions(anneal);
+	}
+	bool ok;
+	vector< pair<PARGraph*, PARGraph*> > runners_up;
+	if(fixed)
+	{
+		//Someone else already found the placement (see RemoteSeedSweep()), so all that's left is to check it
+		LogVerbose("\nXBPAR initializing...\n");
+		ok = engine.Initialize(lmap) && engine.CheckRouting();
+	}
+	else if(options.exactTime > 0)
+		ok = ExactPAR(engine, lmap, options);
+	else if(options.seeds > 1)
+	{
+		bool fallback = (options.candidates > 1) && !options.placementOnly;
+		ok = MultiSeedPAR(engine, ngraph, dgraph, device, &sites, lmap, options, fallback ? &runners_up : NULL);
+	}
+	else
+		ok = engine.PlaceAndRoute(lmap, options.seed);
+
+	//If we're using more cross connections than exist, penalize the overloaded matrices and re-place until they fit
+	//(or we give up and let CommitRouting report the failure)
+	const unsigned int negotiation_passes = 5;
+	for(unsigned int pass=0; ok && !fixed && (pass < negotiation_passes) && !engine.IsPastDeadline(); pass++)
+	{
+		if(engine.UpdateCongestionHistory() == 0)
+			break;
+
+		LogNotice("\nCross connections over capacity, re-optimizing placement (pass %u)...\n", pass + 1);
+		LogIndenter li;
+		ok = engine.Anneal(lmap, options.seed + options.seeds + pass);
+	}
+
+	//If the best placement won't commit or fails DRC, fall back to the best runner-up that does. They're all
+	//committed to configuration layers of the device at once, so this costs about as much as committing one.
+	if(!runners_up.empty())
+	{
+		if(ok && !engine.IsCancelled())
+		{
+			vector< pair<PARGraph*, PARGraph*> > candidates(1, pair<PARGraph*, PARGraph*>(ngraph, dgraph));
+			candidates.insert(candidates.end(), runners_up.begin(), runners_up.end());
+			int winner = CommitCandidates(candidates, device, sites, options);
+			if(winner > 0)
+			{
+				LogNotice("Best placement doesn't pass, using candidate %d instead\n", winner);
+				PARGraph::CopyPlacement(candidates[winner].first, ngraph, dgraph);
+				ok = engine.CheckRouting();
+			}
+		}
+
+		for(auto& r : runners_up)
+		{
+			delete r.first;
+			delete r.second;
+		}
+	}
+	stats.EndPhase("placement", start);
+
+	//Save the moves we made, and compare them to the ones we were asked to replay
+	if(!options.recordMovesFile.empty() && !move_log.Write(options.recordMovesFile))
+	{
+		delete ngraph;
+		delete dgraph;
+		return false;
+	}
+	if(!options.replayMovesFile.empty())
+		move_log.PrintReplayReport();
+	stats.par = engine.GetStatistics();
+	bool timed_out = false;
+	for(auto& run : stats.par.anneals)
+		timed_out |= run.timedOut;
+	if(timed_out && !engine.IsCancelled())
+		LogNotice("Stopped at the %.1f sec time limit, using the best placement found\n", options.timeLimit);
+
+	//Let the user know if we didn't make timing (this is only as good as the delay model)
+	if(ok && (options.timingTarget != 0))
+	{
+		uint32_t delay = engine.ComputeCriticalPathDelay();
+		if(delay > options.timingTarget)
+		{
+			LogWarning("Estimated critical path is %.1f ns, which misses the %.1f ns target\n",
+				delay / 1000.0, options.timingTarget / 1000.0);
+		}
+		else
+		{
+			LogNotice("Estimated critical path is %.1f ns (target %.1f ns)\n",
+				delay / 1000.0, options.timingTarget / 1000.0);
+		}
+	}
+
+	if(engine.IsCancelled())
+	{
+		LogError("PAR cancelled\n");
+		delete ngraph;
+		delete dgraph;
+		return false;
+	}
+
+	//A server running seeds for another one only sends back the placement, so stop here (see RemoteSeedSweep())
+	if(options.placementOnly)
+	{
+		if(result)
+		{
+			result->placementCost = engine.ComputeCost();
+			result->placement = FormatPlacement(ngraph);
+		}
+		delete ngraph;
+		delete dgraph;
+		return ok;
+	}
+
+	if(ok && result)
+		result->criticalPathDelay = engine.ComputeCriticalPathDelay();
+
+	if(!ok)
 	{
 		//Print the placement we have so far
 		PrintPlacementReport(ngraph, device);
@@ -48,8 +258,16 @@ bool DoPAR(Greenpak4Netlist* netlist, Greenpak4Device* device)
 	}
 
 	//Copy the netlist over
-	unsigned int num_routes_used[2];
-	if(!CommitChanges(dgraph, device, num_routes_used))
+	//(cross connections used between each pair of matrices, indexed [src*matrix_count + dst])
+	vector<unsigned int> num_routes_used(device->GetMatrixCount() * device->GetMatrixCount(), 0);
+	start = chrono::steady_clock::now();
+	bool committed;
+	{
+		TraceSpan span("Commit placement");
+		committed = CommitChanges(ngraph, dgraph, device, sites, num_routes_used);
+	}
+	stats.EndPhase("commit", start);
+	if(!committed)
 	{
 		LogNotice("Final routing failed\n");
 
@@ -60,12 +278,41 @@ bool DoPAR(Greenpak4Netlist* netlist, Greenpak4Device* device)
 	}
 
 	//Final DRC to make sure the placement is sane
-	if(!PostPARDRC(ngraph, device))
+	Greenpak4DRCReport drc;
+	start = chrono::steady_clock::now();
+	bool drc_ok;
+	{
+		TraceSpan span("DRC");
+		drc_ok = PostPARDRC(ngraph, dgraph, device, options, drc);
+	}
+	stats.EndPhase("drc", start);
+	if(result)
+		result->drc = drc;
+	if(!drc_ok)
 		return false;
 
 	//Print reports
+	start = chrono::steady_clock::now();
 	PrintUtilizationReport(ngraph, device, num_routes_used);
 	PrintPlacementReport(ngraph, device);
+	PrintTimingReport(ngraph, device, options.timingTarget);
+	if(!options.timingReportFile.empty())
+	{
+		string report = FormatTimingReport(ngraph, device, options.timingTarget);
+		if(result)
+			result->timingReport = report;
+		if(!WriteOutputFile(options.timingReportFile, report))
+			return false;
+	}
+	string placement = FormatPlacement(ngraph);
+	if(result)
+		result->placement = placement;
+	if(!options.placementFile.empty())
+	{
+		if(!WriteOutputFile(options.placementFile, placement))
+			return false;
+	}
+	stats.EndPhase("reports", start);
 
 	//Final cleanup
 	delete ngraph;
@@ -74,369 +321,264 @@ bool DoPAR(Greenpak4Netlist* netlist, Greenpak4Device* device)
 }
 
 /**
-	@brief Do various sanity checks after the design is routed
+	@brief Searches for a placement using as few cross connections as possible, and falls back to annealing if the
+	search runs out of time before finding anything.
 
-	Also do a couple of tweaks to the bitstream that we can't find any other good spot for
-	TODO: this really should be done somewhere else?
+	@return true if the placement is routable
  */
-bool PostPARDRC(PARGraph* netlist, Greenpak4Device* device)
+bool ExactPAR(Greenpak4PAREngine& engine, PARLabelRegistry& lmap, const PAROptions& options)
 {
-	LogNotice("\nChecking post-route design rules...\n");
-	LogIndenter li;
-
-	bool ok = true;
+	LogVerbose("\nXBPAR initializing...\n");
+	if(!engine.Initialize(lmap))
+		return false;
 
-	//Check for nodes in the netlist that have no load
-	for(uint32_t i=0; i<netlist->GetNumNodes(); i++)
+	LogNotice("\nSearching for optimal placement (%.1f sec time limit)...\n", options.exactTime);
+	LogIndenter li;
+	if(!engine.PlaceExactly(lmap, options.exactTime))
 	{
-		auto node = netlist->GetNodeByIndex(i);
-		auto src = static_cast<Greenpak4NetlistEntity*>(node->GetData());
-		auto mate = node->GetMate();
-		auto dst = static_cast<Greenpak4BitstreamEntity*>(mate->GetData());
-
-		//Sanity check - must be fully PAR'd
-		if(mate == NULL)
-		{
-			LogError(
-				"Node \"%s\" is not mapped to any site in the device\n",
-				src->m_name.c_str());
-			ok = false;
-		}
-
-		//Do not warn if power rails have no load, that's perfectly normal
-		if(dynamic_cast<Greenpak4PowerRail*>(dst) != NULL)
-			continue;
-
-		//If the node has no output ports, of course it won't have any loads
-		if(dst->GetOutputPorts().size() == 0)
-			continue;
-
-		//If the node is an IOB configured as an output, there's no internal load for its output.
-		//This is perfectly normal, obviously.
-		Greenpak4NetlistCell* cell = dynamic_cast<Greenpak4NetlistCell*>(src);
-		if( (cell != NULL) &&  ( (cell->m_type == "GP_IOBUF") || (cell->m_type == "GP_OBUF") ) )
-			continue;
-
-		//If we have a magic attribute set, it's OK
-		//(for example, inferred ACMP for a VREF we used for another purpose)
-		if(cell->HasAttribute("__IGNORE__NOLOAD__"))
-			continue;
-
-		//If we have no loads, warn
-		if(node->GetEdgeCount() == 0)
-		{
-			LogWarning(
-				"Node \"%s\" has no load\n",
-				src->m_name.c_str());
-		}
-
+		LogNotice("No placement found, falling back to annealing\n");
+		engine.Anneal(lmap, options.seed);
 	}
 
-	//Check for IOBs that are not LOC'd
-	for(auto it = device->iobbegin(); it != device->iobend(); it ++)
-	{
-		Greenpak4IOB* iob = it->second;
-
-		//Get the netlist cell for this IOB
-		//If no cell found we're unused so no point in looking
-		auto npnode = iob->GetPARNode()->GetMate();
-		if(npnode == NULL)
-			continue;
-		Greenpak4NetlistCell* ncell = static_cast<Greenpak4NetlistCell*>(npnode->GetData());
-		if(ncell == NULL)
-			continue;
+	return engine.CheckRouting();
+}
 
-		//If we are not LOC'd, warn.
-		//This is not an error because sometimes a user may want to let PAR find a placement for a complex
-		//netlist before laying out the board, to improve routability. We warn because it's easy to forget
-		//to add LOC constraints afterwards, causing a future ECO to break the pinout.
-		if(!ncell->HasLOC())
-		{
-			LogWarning(
-				"IOB cell %s was placed at location %s, but was not locked with a LOC constraint.\n"
-				"This can lead to unexpected pinout changes if the netlist is modified.\n",
-				ncell->m_name.c_str(), iob->GetDescription().c_str()
-				);
-		}
-	}
+/**
+	@brief Runs several independent annealing passes from the same initial placement, and keeps the best one.
 
-	//TODO: check floating inputs etc
+	Each pass runs on its own copy of the graphs, so passes can run concurrently. We stop as soon as any pass finds a
+	zero-cost placement. The winning placement is copied back to ngraph/dgraph.
 
-	//Check invalid IOB configuration
-	//TODO: driving an input-only pin etc - is this possible?
-	for(auto it = device->iobbegin(); it != device->iobend(); it ++)
-	{
-		Greenpak4IOB* iob = it->second;
+	@param runners_up	If not NULL, filled in with the graphs of the next best placements (up to
+						options.candidates - 1 of them, best first), to fall back to if the winner doesn't commit.
+						The caller has to delete them.
 
-		auto signal = iob->GetOutputSignal();
-		auto src = signal.GetRealEntity();
+	@return true if the winning placement is routable
+ */
+bool MultiSeedPAR(
+	Greenpak4PAREngine& engine,
+	PARGraph* ngraph,
+	PARGraph* dgraph,
+	Greenpak4Device* device,
+	const Greenpak4SiteTable* sites,
+	PARLabelRegistry& lmap,
+	const PAROptions& options,
+	vector< pair<PARGraph*, PARGraph*> >* runners_up)
+{
+	LogVerbose("\nXBPAR initializing...\n");
+	if(!engine.Initialize(lmap))
+		return false;
 
-		if(!iob->IsAnalogIbuf())
-		{
-			//Check for analog output driving a pin not configured as analog for the input
-			if(	(dynamic_cast<Greenpak4VoltageReference*>(src) != NULL) ||
-				(dynamic_cast<Greenpak4PGA*>(src) != NULL) )
-			{
-				LogError("Pin %d is driven by an analog source (%s) but does not have IBUF_TYPE = ANALOG\n",
-					it->first,
-					signal.GetOutputName().c_str()
-					);
-				ok = false;
-			}
-		}
-	}
+	unsigned int jobs = options.jobs;
+	if(jobs > options.seeds)
+		jobs = options.seeds;
+	LogNotice("\nOptimizing placement (%u seeds, %u threads)...\n", options.seeds, jobs);
 
-	//Check for ACMPs with inputs driven from non-analog IOs
-	for(unsigned int i=0; i<device->GetAcmpCount(); i++)
-	{
-		auto acmp = device->GetAcmp(i);
-		if(!CheckAnalogIbuf(acmp, dynamic_cast<Greenpak4IOB*>(acmp->GetInput().GetRealEntity())))
-			ok = false;
-	}
-
-	//Check for ABUF with inputs driven from non-analog IOs
-	auto abuf = device->GetAbuf();
-	if(abuf && !CheckAnalogIbuf(abuf, dynamic_cast<Greenpak4IOB*>(abuf->GetInput().GetRealEntity())))
-		return false;
+	//Threads we don't need for running seeds in parallel can evaluate moves in parallel within each seed
+	unsigned int spare_jobs = max(1u, options.jobs / jobs);
+	LogIndenter li;
 
-	//Check for PGA with inputs driven from non-analog IOs
-	auto pga = device->GetPGA();
-	if(pga)
-	{
-		if(!CheckAnalogIbuf(abuf, dynamic_cast<Greenpak4IOB*>(pga->GetInputP().GetRealEntity())))
-			ok = false;
-		if(!CheckAnalogIbuf(abuf, dynamic_cast<Greenpak4IOB*>(pga->GetInputN().GetRealEntity())))
-			ok = false;
-	}
+	//Result of each pass, for reporting
+	vector<uint32_t> costs(options.seeds, 0);
+	vector<bool> routed(options.seeds, false);
+	vector<bool> ran(options.seeds, false);
 
-	//TODO: Check for VREF with inputs driven from non-analog IOs
+	//State shared between the workers
+	mutex lock;
+	mutex progress_lock;
+	atomic<bool> stop(false);
+	atomic<unsigned int> next_pass(0);
 
-	//TODO: Check for PGA driving an IOB when ADC is enabled
-	//auto adc = device->GetADC();
-	if(pga /*&& adc*/)
+	//The best passes so far (graphs and pass number), best first
+	class KeptPass
 	{
-		//We do not yet implement the ADC
-		//so nothing to do here
-	}
-
-	//Check for multiple ACMPs using different settings of ACMP0's output mux
-	typedef pair<string, Greenpak4EntityOutput> spair;
-	switch(device->GetPart())
+	public:
+		KeptPass(PARGraph* n, PARGraph* d, unsigned int p)
+			: ngraph(n)
+			, dgraph(d)
+			, pass(p)
+		{}
+
+		PARGraph* ngraph;
+		PARGraph* dgraph;
+		unsigned int pass;
+	};
+	vector<KeptPass> kept;
+	size_t keep = (runners_up != NULL) ? max(1u, options.candidates) : 1;
+
+	auto worker = [&]()
 	{
-		case Greenpak4Device::GREENPAK4_SLG46620:
-			{
-				auto pin6 = device->GetIOB(6)->GetOutput("");
-				auto vdd = device->GetPower();
-				auto gnd = device->GetGround();
-
-				vector<spair> inputs;
+		while(!stop && !engine.IsCancelled())
+		{
+			unsigned int pass = next_pass ++;
+			if(pass >= options.seeds)
+				break;
 
-				//Loop over each ACMP that could possibly use the ACMP0 (shared) mux
-				for(unsigned int i=0; i<device->GetAcmpCount(); i++)
-				{
-					auto acmp = device->GetAcmp(i);
-					auto input = acmp->GetInput();
-
-					//If this comparator is not using one of ACMP0's inputs, we don't care
-					//TODO: buffered pin 6 is a candidate too
-					if((input != pin6) && (input != vdd) )
-						continue;
-
-					//Look up the instance name of the comparator. Sanity check that it's used.
-					auto mate = acmp->GetPARNode()->GetMate();
-					if(mate == NULL)
-						continue;
-					auto node = static_cast<Greenpak4NetlistEntity*>(mate->GetData());
-					inputs.push_back(spair(node->m_name, input));
-				}
+			//Start from the shared initial placement, on a private copy of everything we might modify
+			PARGraph* pass_ngraph;
+			PARGraph* pass_dgraph;
+			PARGraph::ClonePair(ngraph, dgraph, pass_ngraph, pass_dgraph);
 
-				//Check the active inputs and make sure they're the same
-				Greenpak4EntityOutput shared_input = gnd;
-				for(auto s : inputs)
+			bool ok;
+			uint32_t cost;
+			PARStatistics pass_stats;
+			{
+				Greenpak4PAREngine pass_engine(pass_ngraph, pass_dgraph, device, sites, &lmap);
+				pass_engine.SetQuiet(true);
+				pass_engine.SetStopFlag(&stop);
+				pass_engine.SetCancelFlag(options.cancel);
+				pass_engine.SetAnnealOptions(engine.GetAnnealOptions());
+				pass_engine.SetVerifyIncrementalCost(options.verifyCost);
+				pass_engine.SetTimingTarget(options.timingTarget, TIMING_COST_SCALE);
+				pass_engine.SetMoveBatch(options.batchMoves, spare_jobs);
+				if(engine.HasDeadline())
+					pass_engine.SetDeadline(engine.GetDeadline());
+				if(options.progress)
 				{
-					//If the shared input isn't used, this is the new value for the mux
-					if(shared_input == gnd)
-						shared_input = s.second;
-
-					//If the shared input is used, but has the same value, we're good - the sharing did its job
-					if(shared_input == s.second)
-						continue;
-
-					//Problem! Incompatible mux settings
-					LogError(
-						"Multiple comparators tried to simultaneously use different outputs from "
-						"the ACMP0 input mux\n");
-					LogIndenter li;
-					for(auto p : inputs)
+					pass_engine.SetProgressCallback([&](const PARProgress& progress)
 					{
-						LogNotice("Comparator %10s requested %s\n",
-							p.first.c_str(), p.second.GetOutputName().c_str());
-					}
-					ok = false;
+						lock_guard<mutex> guard(progress_lock);
+						options.progress(progress);
+					});
 				}
+				ok = pass_engine.Anneal(lmap, options.seed + pass);
+				cost = pass_engine.ComputeCost();
+				pass_stats = pass_engine.GetStatistics();
+			}
 
-				//If ACMP0 is not used, but we use its output, configure it
-				//TODO: for better power efficiency, turn on only when a downstream comparator is on?
-				//TODO: This really should not be done in the DRC
-				if( (device->GetAcmp(0)->GetInput() == gnd) && (inputs.size() > 0) )
-				{
-					LogNotice(
-						"Enabling ACMP0 and configuring input mux, since output of mux "
-						"is used but ACMP0 is not instantiated\n");
+			lock_guard<mutex> guard(lock);
+			engine.AddStatistics(pass_stats);
+			costs[pass] = cost;
+			routed[pass] = ok;
+			ran[pass] = true;
 
-					auto acmp0 = device->GetAcmp(0);
-					acmp0->SetInput(shared_input);
-					acmp0->SetPowerEn(device->GetPowerOnReset()->GetOutput("RST_DONE"));
+			//Keep this result if it's one of the best so far (anything routable beats anything that isn't).
+			//Ties go to the pass that finished first.
+			size_t pos = 0;
+			for(; pos < kept.size(); pos++)
+			{
+				unsigned int other = kept[pos].pass;
+				if( (ok && !routed[other]) || ( (ok == routed[other]) && (cost < costs[other]) ) )
+					break;
+			}
+			if(pos < keep)
+			{
+				kept.insert(kept.begin() + pos, KeptPass(pass_ngraph, pass_dgraph, pass));
+				if(kept.size() > keep)
+				{
+					delete kept.back().ngraph;
+					delete kept.back().dgraph;
+					kept.pop_back();
 				}
 			}
-			break;
-
-		default:
-			break;
-	}
+			else
+			{
+				delete pass_ngraph;
+				delete pass_dgraph;
+			}
 
-	//Check for multiple oscillators with power-down enabled but not the same source
-	Greenpak4LFOscillator* lfosc = device->GetLFOscillator();
-	Greenpak4RingOscillator* rosc = device->GetRingOscillator();
-	Greenpak4RCOscillator* rcosc = device->GetRCOscillator();
-	vector<spair> powerdowns;
-	if(lfosc && lfosc->IsUsed() && lfosc->GetPowerDownEn() && !lfosc->IsConstantPowerDown())
-		powerdowns.push_back(spair(lfosc->GetDescription(), lfosc->GetPowerDown()));
-	if(rosc && rosc->IsUsed() && rosc->GetPowerDownEn() && !rosc->IsConstantPowerDown())
-		powerdowns.push_back(spair(rosc->GetDescription(), rosc->GetPowerDown()));
-	if(rcosc && rcosc->IsUsed() && rcosc->GetPowerDownEn() && !rcosc->IsConstantPowerDown())
-		powerdowns.push_back(spair(rcosc->GetDescription(), rcosc->GetPowerDown()));
-	if(!powerdowns.empty())
-	{
-		Greenpak4EntityOutput src = device->GetGround();
-		bool xok = true;
-		for(auto p : powerdowns)
-		{
-			if(src.IsPowerRail())
-				src = p.second;
-			if(src != p.second)
-				xok = false;
+			//Can't do better than zero, so tell everyone else to stop
+			if(ok && (cost == 0))
+				stop = true;
 		}
+	};
 
-		if(!xok)
-		{
-			LogError(
-				"Multiple oscillators have power-down enabled, but do not share the same power-down signal\n");
-			for(auto p : powerdowns)
-				LogNotice("    Oscillator %10s powerdown is %s\n", p.first.c_str(), p.second.GetOutputName().c_str());
-
-			ok = false;
-		}
-	}
+	vector<thread> threads;
+	for(unsigned int i=0; i<jobs; i++)
+		threads.push_back(thread(worker));
+	for(auto& t : threads)
+		t.join();
 
-	//ADC/DAC conflicts
-	if( (device->GetPart() == Greenpak4Device::GREENPAK4_SLG46620) ||
-		(device->GetPart() == Greenpak4Device::GREENPAK4_SLG46621))
+	//If we were cancelled there may not be any results at all
+	if(engine.IsCancelled())
 	{
-		//null check on pga is unnecessary for the 4662x, but necessary to avoid false positive from static analysis
-		auto dac1 = device->GetDAC(1);
-		if(pga && pga->IsUsed() && dac1->IsUsed())
+		for(auto& k : kept)
 		{
-			LogError(
-				"Both DAC1 and the PGA are used. This is illegal due to a poorly documented control hazard.\n"
-				"Enabling the PGA turns on the SAR ADC, forcing DAC1 to emit a sawtooth waveform instead of the "
-				"desired signal.\n");
-			ok = false;
+			delete k.ngraph;
+			delete k.dgraph;
 		}
-
-		//null check to avoid false positive on static analysis
-		auto dac0 = device->GetDAC(0);
-		if(pga && pga->IsUsed() && dac0->IsUsed() && (pga->GetInputMode() == Greenpak4PGA::MODE_PDIFF) )
-		{
-			LogError(
-				"DAC0 is used while the PGA is in pseudo-differential mode. This is illegal since the "
-				"PGA uses DAC0 to provide the pseudo-differential offset voltage.\n");
-		}
-
-		//TODO: Cannot use DAC1 when ADC is used
+		return false;
 	}
 
-	//If POR is driven to an IOB, it should use dedicated routing
-	//If not, warn about timing
-	auto por = device->GetPowerOnReset()->GetPARNode()->GetMate();
-	if(por)
+	//Report results
+	for(unsigned int i=0; i<options.seeds; i++)
 	{
-		Greenpak4IOB* reset_iob = NULL;
-
-		//Find the dedicated reset pin
-		auto part = device->GetPart();
-		switch(part)
-		{
-			case Greenpak4Device::GREENPAK4_SLG46620:
-			case Greenpak4Device::GREENPAK4_SLG46621:
-				reset_iob = device->GetIOB(8);
-				break;
-
-			case Greenpak4Device::GREENPAK4_SLG46140:
-				reset_iob = device->GetIOB(13);
-				break;
+		if(!ran[i])
+			continue;
+		LogVerbose("Seed %u: cost %u (%s)\n", options.seed + i, costs[i], routed[i] ? "routable" : "unroutable");
+	}
+	unsigned int best_pass = kept[0].pass;
+	LogNotice("Using placement from seed %u (cost %u)\n", options.seed + best_pass, costs[best_pass]);
 
-			default:
-				LogError("unrecognized device, cannot DRC POR routing\n");
-		}
+	//Apply the winning placement to the original graphs, and hand the rest back
+	PARGraph::CopyPlacement(kept[0].ngraph, ngraph, dgraph);
+	delete kept[0].ngraph;
+	delete kept[0].dgraph;
+	for(size_t i=1; i<kept.size(); i++)
+		runners_up->push_back(pair<PARGraph*, PARGraph*>(kept[i].ngraph, kept[i].dgraph));
 
-		//Look for IOBs driven by the PAR
-		for(uint32_t i=0; i<por->GetEdgeCount(); i++)
-		{
-			auto dest = por->GetEdgeByIndex(i)->m_destnode->GetMate();
-			auto n = static_cast<Greenpak4BitstreamEntity*>(dest->GetData())->GetRealEntity();
+	return engine.CheckRouting();
+}
 
-			auto ioba = dynamic_cast<Greenpak4IOBTypeA*>(n);
-			auto iobb = dynamic_cast<Greenpak4IOBTypeB*>(n);
+/**
+	@brief Do various sanity checks after the design is routed
 
-			if( (ioba == NULL) && (iobb == NULL) )
-				continue;
+	Also do a couple of tweaks to the bitstream that we can't find any other good spot for
+	TODO: this really should be done somewhere else?
 
-			if(n != reset_iob)
-			{
-				LogWarning(
-					"Pin %s is driven by the power-on reset, but does not have dedicated reset routing available.\n"
-					"This may lead to synchronization issues or glitches if this pin is used to drive resets on "
-					"external logic.\n",
-					n->GetDescription().c_str());
-			}
-		}
-	}
+	@param report	Filled in with everything the DRC found
+ */
+bool PostPARDRC(
+	PARGraph* netlist,
+	PARGraph* device,
+	Greenpak4Device* pdev,
+	const PAROptions& options,
+	Greenpak4DRCReport& report)
+{
+	LogNotice("\nChecking post-route design rules...\n");
+	LogIndenter li;
 
-	//Charge pump must be ENABLED for brownout detector to work
-	auto pwrdet = device->GetPowerDetector();
-	if(pwrdet && (pwrdet->GetPARNode()->GetMate() != NULL) & device->IsChargePumpDisabled())
+	Greenpak4DRCIndex index(netlist, device, pdev);
+	Greenpak4DRC drc;
+	drc.Run(index, report, options.jobs);
+	report.Print();
+	if(!options.drcReportFile.empty())
 	{
-		LogError(
-			"The power detector is being used, but the charge pump is disabled.\n"
-			"Enable the charge pump to use the power detector.\n"
-			);
-		ok = false;
+		if(!report.WriteJSON(options.drcReportFile))
+			return false;
 	}
 
-	//Done
-	return ok;
-}
+	ConfigureSharedAcmpMux(pdev, index);
 
-bool CheckAnalogIbuf(Greenpak4BitstreamEntity* load, Greenpak4IOB* iob)
-{
-	if(!iob)
-		return true;
-	if(iob->IsAnalogIbuf())
-		return true;
+	return (report.GetErrorCount() == 0);
+}
 
-	LogError("%s is driven by IOB %s, which does not have IBUF_TYPE = ANALOG\n",
-		load->GetDescription().c_str(),
-		iob->GetDescription().c_str()
-		);
+/**
+	@brief If ACMP0 is not used, but other comparators use the output of its input mux, configure it
 
-	return false;
+	TODO: for better power efficiency, turn on only when a downstream comparator is on?
+ */
+void ConfigureSharedAcmpMux(Greenpak4Device* device, const Greenpak4DRCIndex& index)
+{
+	auto& inputs = index.GetSharedMuxRequests();
+	if(inputs.empty())
+		return;
+
+	auto acmp0 = device->GetAcmp(0);
+	if(acmp0->GetInput() != device->GetGround())
+		return;
+
+	LogNotice(
+		"Enabling ACMP0 and configuring input mux, since output of mux "
+		"is used but ACMP0 is not instantiated\n");
+	acmp0->SetInput(inputs[0].second);
+	acmp0->SetPowerEn(device->GetPowerOnReset()->GetOutput("RST_DONE"));
 }
 
 /**
 	@brief Allocate and name a graph label
  */
-uint32_t AllocateLabel(PARGraph*& ngraph, PARGraph*& dgraph, labelmap& lmap, std::string description)
+uint32_t AllocateLabel(PARGraph*& ngraph, PARGraph*& dgraph, PARLabelRegistry& lmap, std::string description)
 {
 	uint32_t nlabel = ngraph->AllocateLabel();
 	uint32_t dlabel = dgraph->AllocateLabel();
@@ -445,7 +587,7 @@ uint32_t AllocateLabel(PARGraph*& ngraph, PARGraph*& dgraph, labelmap& lmap, std
 		LogFatal("Labels were allocated at the same time but don't match up\n");
 	}
 
-	lmap[nlabel] = description;
+	lmap.SetName(nlabel, description);
 
 	return nlabel;
 }
@@ -0,0 +1,112 @@
+/***********************************************************************************************************************
+ * Copyright (C) 2016 Andrew Zonenberg and contributors                                                                *
+ *                                                                                                                     *
+ * This program is free software; you can redistribute it and/or modify it under the terms of the GNU Lesser General   *
+ * Public License as published by the Free Software Foundation; either version 2.1 of the License, or (at your option) *
+ * any later version.                                                                                                  *
+ *                                                                                                                     *
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied  *
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for     *
+ * more details.                                                                                                       *
+ *                                                                                                                     *
+ * You should have received a copy of the GNU Lesser General Public License along with this program; if not, you may   *
+ * find one here:                                                                                                      *
+ * https://www.gnu.org/licenses/old-licenses/lgpl-2.1.txt                                                              *
+ * or you may search the http://www.gnu.org website for the version 2.1 license, or you may write to the Free Software *
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA                                      *
+ **********************************************************************************************************************/
+
+#include "gp4par.h"
+
+using namespace std;
+
+/*
+	A placement file has one line per netlist cell: the site it's placed at, the cell type and the cell name,
+	separated by tabs (neither sites nor types have spaces, but cell names from yosys can). Blank lines and lines
+	starting with # are ignored.
+
+	Flipflops the optimizer packed into a shift register are listed at its site and their stage (SHREG_1:2 is the
+	second stage of SHREG_1), so gp4equiv can find them.
+ */
+
+/**
+	@brief Describes where every netlist cell ended up, in the format ReadPlacementFile() expects
+ */
+string FormatPlacement(PARGraph* netlist)
+{
+	string placement = "# gp4par placement: site, cell type, cell name\n";
+	for(uint32_t i=0; i<netlist->GetNumNodes(); i++)
+	{
+		auto nnode = netlist->GetNodeByIndex(i);
+		auto cell = dynamic_cast<Greenpak4NetlistCell*>(static_cast<Greenpak4NetlistEntity*>(nnode->GetData()));
+		auto dnode = nnode->GetMate();
+		if( (cell == NULL) || (dnode == NULL) )
+			continue;
+
+		auto site = static_cast<Greenpak4BitstreamEntity*>(dnode->GetData());
+		placement += site->GetDescription() + "\t" + cell->m_type + "\t" + cell->m_name + "\n";
+		for(size_t j=0; j<cell->m_packedCells.size(); j++)
+		{
+			auto& packed = cell->m_packedCells[j];
+			placement += site->GetDescription() + ":" + to_string(j+1) + "\t" + packed.second + "\t" +
+				packed.first + "\n";
+		}
+	}
+	return placement;
+}
+
+/**
+	@brief Loads a placement file written by a previous run
+
+	@return True on success, false (after logging why) if the file can't be read or is malformed
+ */
+bool ReadPlacementFile(string fname, placementmap& placement)
+{
+	string data;
+	if(!ReadInputFile(fname, data))
+		return false;
+	if(!ParsePlacement(data, fname, placement))
+		return false;
+
+	LogVerbose("Loaded previous placement of %zu cells from %s\n", placement.size(), fname.c_str());
+	return true;
+}
+
+/**
+	@brief Parses a placement in the format FormatPlacement() writes
+
+	@param source	Where the placement came from, for error messages
+
+	@return True on success, false (after logging why) if it's malformed
+ */
+bool ParsePlacement(const string& data, const string& source, placementmap& placement)
+{
+	unsigned int lineno = 0;
+	size_t pos = 0;
+	while(pos < data.length())
+	{
+		size_t end = data.find('\n', pos);
+		if(end == string::npos)
+			end = data.length();
+		string line = data.substr(pos, end - pos);
+		pos = end + 1;
+		lineno ++;
+
+		if(line.empty() || (line[0] == '#'))
+			continue;
+
+		size_t tab1 = line.find('\t');
+		size_t tab2 = (tab1 == string::npos) ? string::npos : line.find('\t', tab1 + 1);
+		if( (tab2 == string::npos) || (tab1 == 0) || (tab2 == tab1 + 1) || (tab2 + 1 == line.length()) )
+		{
+			LogError("Malformed placement in %s (line %u should be site, cell type and cell name)\n",
+				source.c_str(), lineno);
+			return false;
+		}
+
+		string site = line.substr(0, tab1);
+		string type = line.substr(tab1 + 1, tab2 - tab1 - 1);
+		placement[line.substr(tab2 + 1)] = pair<string, string>(site, type);
+	}
+	return true;
+}
@@ -0,0 +1,214 @@
+/***********************************************************************************************************************
+ * Copyright (C) 2016 Andrew Zonenberg and contributors                                                                *
+ *                                                                                                                     *
+ * This program is free software; you can redistribute it and/or modify it under the terms of the GNU Lesser General   *
+ * Public License as published by the Free Software Foundation; either version 2.1 of the License, or (at your option) *
+ * any later version.                                                                                                  *
+ *                                                                                                                     *
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied  *
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for     *
+ * more details.                                                                                                       *
+ *                                                                                                                     *
+ * You should have received a copy of the GNU Lesser General Public License along with this program; if not, you may   *
+ * find one here:                                                                                                      *
+ * https://www.gnu.org/licenses/old-licenses/lgpl-2.1.txt                                                              *
+ * or you may search the http://www.gnu.org website for the version 2.1 license, or you may write to the Free Software *
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA                                      *
+ **********************************************************************************************************************/
+
+#include "gp4par.h"
+
+using namespace std;
+
+/*
+	An annealing profile has one line per PARAnnealOptions field: its name and value, separated by a tab. Fields that
+	aren't listed keep their defaults. Blank lines and lines starting with # are ignored.
+
+	gp4bench --tune writes these. The best profile found for each part goes in g_defaultProfiles, so it's what
+	gp4par uses unless --anneal-profile says otherwise.
+ */
+
+/**
+	@brief The fields a profile can set (keepFirstBest isn't one, it depends on how PAR is run rather than the part)
+ */
+static const struct
+{
+	const char* m_name;
+	double PARAnnealOptions::* m_double;
+	uint32_t PARAnnealOptions::* m_uint;
+} g_profileFields[] =
+{
+	{ "initial_acceptance", &PARAnnealOptions::initialAcceptance, NULL },
+	{ "initial_samples", NULL, &PARAnnealOptions::initialSamples },
+	{ "moves_per_temperature", NULL, &PARAnnealOptions::movesPerTemperature },
+	{ "final_temperature", &PARAnnealOptions::finalTemperature, NULL },
+	{ "high_acceptance", &PARAnnealOptions::highAcceptance, NULL },
+	{ "low_acceptance", &PARAnnealOptions::lowAcceptance, NULL },
+	{ "fast_cooling", &PARAnnealOptions::fastCooling, NULL },
+	{ "normal_cooling", &PARAnnealOptions::normalCooling, NULL },
+	{ "slow_cooling", &PARAnnealOptions::slowCooling, NULL },
+	{ "stagnation_limit", NULL, &PARAnnealOptions::stagnationLimit },
+	{ "max_reheats", NULL, &PARAnnealOptions::maxReheats },
+	{ "reheat_temperature", &PARAnnealOptions::reheatTemperature, NULL },
+	{ "move_weight_floor", &PARAnnealOptions::moveWeightFloor, NULL },
+	{ "move_weight_smoothing", &PARAnnealOptions::moveWeightSmoothing, NULL }
+};
+
+/**
+	@brief Built-in profile for each part (none of them have been tuned yet, so these are the PARAnnealOptions
+	defaults)
+ */
+static const struct
+{
+	Greenpak4Device::GREENPAK4_PART m_part;
+	const char* m_profile;
+} g_defaultProfiles[] =
+{
+	{
+		Greenpak4Device::GREENPAK4_SLG46620,
+		"initial_acceptance\t0.8\n"
+		"initial_samples\t50\n"
+		"final_temperature\t0.1\n"
+		"stagnation_limit\t10\n"
+		"max_reheats\t3\n"
+	},
+	{
+		Greenpak4Device::GREENPAK4_SLG46621,
+		"initial_acceptance\t0.8\n"
+		"initial_samples\t50\n"
+		"final_temperature\t0.1\n"
+		"stagnation_limit\t10\n"
+		"max_reheats\t3\n"
+	},
+	{
+		Greenpak4Device::GREENPAK4_SLG46140,
+		"initial_acceptance\t0.8\n"
+		"initial_samples\t50\n"
+		"final_temperature\t0.1\n"
+		"stagnation_limit\t10\n"
+		"max_reheats\t3\n"
+	}
+};
+
+/**
+	@brief Describes an annealing schedule, in the format ParseAnnealProfile() expects
+ */
+string FormatAnnealProfile(const PARAnnealOptions& options, const string& comment)
+{
+	string profile = "# gp4par annealing profile";
+	if(!comment.empty())
+		profile += ": " + comment;
+	profile += "\n";
+
+	char line[128];
+	for(auto& f : g_profileFields)
+	{
+		if(f.m_double)
+			snprintf(line, sizeof(line), "%s\t%.6g\n", f.m_name, options.*f.m_double);
+		else
+			snprintf(line, sizeof(line), "%s\t%u\n", f.m_name, options.*f.m_uint);
+		profile += line;
+	}
+	return profile;
+}
+
+/**
+	@brief Applies an annealing profile on top of the options we already have
+
+	@param data		The profile
+	@param source	Where it came from, for error messages
+
+	@return True on success, false (after logging why) if it's malformed
+ */
+bool ParseAnnealProfile(const string& data, const string& source, PARAnnealOptions& options)
+{
+	unsigned int lineno = 0;
+	size_t pos = 0;
+	while(pos < data.length())
+	{
+		size_t end = data.find('\n', pos);
+		if(end == string::npos)
+			end = data.length();
+		string line = data.substr(pos, end - pos);
+		pos = end + 1;
+		lineno ++;
+
+		if(line.empty() || (line[0] == '#'))
+			continue;
+
+		size_t tab = line.find('\t');
+		if( (tab == string::npos) || (tab == 0) || (tab + 1 == line.length()) )
+		{
+			LogError("Malformed annealing profile %s (line %u should be a name and a value)\n", source.c_str(), lineno);
+			return false;
+		}
+		string name = line.substr(0, tab);
+		const char* value = line.c_str() + tab + 1;
+
+		bool found = false;
+		for(auto& f : g_profileFields)
+		{
+			if(name != f.m_name)
+				continue;
+			found = true;
+
+			char* vend;
+			bool ok;
+			if(f.m_double)
+			{
+				double d = strtod(value, &vend);
+				ok = (d > 0);
+				options.*f.m_double = d;
+			}
+			else
+			{
+				unsigned long u = strtoul(value, &vend, 10);
+				ok = (value[0] != '-');
+				options.*f.m_uint = u;
+			}
+			if(!ok || (*vend != '\0') || (vend == value))
+			{
+				LogError("Malformed annealing profile %s (bad value \"%s\" for %s on line %u)\n",
+					source.c_str(), value, name.c_str(), lineno);
+				return false;
+			}
+			break;
+		}
+		if(!found)
+		{
+			LogError("Malformed annealing profile %s (unknown field \"%s\" on line %u)\n",
+				source.c_str(), name.c_str(), lineno);
+			return false;
+		}
+	}
+	return true;
+}
+
+/**
+	@brief Works out the annealing schedule to use: the profile file if there is one, otherwise the part's built-in
+	profile
+
+	@return True on success, false (after logging why) if the profile file can't be read or is malformed
+ */
+bool GetAnnealProfile(Greenpak4Device::GREENPAK4_PART part, const string& fname, PARAnnealOptions& options)
+{
+	options = PARAnnealOptions();
+
+	if(!fname.empty())
+	{
+		string data;
+		if(!ReadInputFile(fname, data))
+			return false;
+		if(!ParseAnnealProfile(data, fname, options))
+			return false;
+		LogVerbose("Loaded annealing profile from %s\n", fname.c_str());
+		return true;
+	}
+
+	for(auto& p : g_defaultProfiles)
+	{
+		if(p.m_part == part)
+			return ParseAnnealProfile(p.m_profile, "(built in)", options);
+	}
+	return true;
+}
@@ -33,7 +33,7 @@ static void PrintRow(string kind, int used, int total)
 /**
 	@brief Print the report showing how many resources were used
  */
-void PrintUtilizationReport(PARGraph* netlist, Greenpak4Device* device, unsigned int* num_routes_used)
+void PrintUtilizationReport(PARGraph* netlist, Greenpak4Device* device, const vector<unsigned int>& num_routes_used)
 {
 	//Get resource counts from the whole device
 	unsigned int lut_counts[5] =
@@ -159,7 +159,17 @@ void PrintUtilizationReport(PARGraph* netlist, Greenpak4Device* device, unsigned
 	unsigned int total_counters_used = counters_8_used + counters_8_adv_used +
 									    counters_14_used + counters_14_adv_used;
 	unsigned int total_luts_count = lut_counts[2] + lut_counts[3] + lut_counts[4];
-	unsigned int total_routes_used = num_routes_used[0] + num_routes_used[1];
+	unsigned int nmatrix = device->GetMatrixCount();
+	unsigned int total_routes_used = 0;
+	unsigned int total_routes_count = 0;
+	for(unsigned int src=0; src<nmatrix; src++)
+	{
+		for(unsigned int dst=0; dst<nmatrix; dst++)
+		{
+			total_routes_used += num_routes_used[src*nmatrix + dst];
+			total_routes_count += device->GetCrossConnectionCount(src, dst);
+		}
+	}
 	PrintRow("ABUF:",			abuf_used,				1);
 	PrintRow("ACMP:",			acmp_used,				device->GetAcmpCount());
 	PrintRow("BANDGAP:",		bandgap_used,			1);
@@ -193,9 +203,18 @@ void PrintUtilizationReport(PARGraph* netlist, Greenpak4Device* device, unsigned
 	PrintRow("SPI:",			spi_used,				1);
 	PrintRow("SYSRST:",			sysrst_used,			1);
 	PrintRow("VREF:",			vref_used,				device->GetVrefCount());
-	PrintRow("X-conn:",			total_routes_used,		20);
-	PrintRow("  East:",			num_routes_used[0],		10);
-	PrintRow("  West:",			num_routes_used[1],		10);
+	PrintRow("X-conn:",			total_routes_used,		total_routes_count);
+	for(unsigned int src=0; src<nmatrix; src++)
+	{
+		for(unsigned int dst=0; dst<nmatrix; dst++)
+		{
+			//Two matrices are east and west of each other, anything bigger just gets numbered
+			string name = "  " + std::to_string(src) + " to " + std::to_string(dst) + ":";
+			if(nmatrix == 2)
+				name = (src == 0) ? "  East:" : "  West:";
+			PrintRow(name,		num_routes_used[src*nmatrix + dst],	device->GetCrossConnectionCount(src, dst));
+		}
+	}
 }
 
 /**
@@ -0,0 +1,413 @@
+/***********************************************************************************************************************
+ * Copyright (C) 2016 Andrew Zonenberg and contributors                                                                *
+ *                                                                                                                     *
+ * This program is free software; you can redistribute it and/or modify it under the terms of the GNU Lesser General   *
+ * Public License as published by the Free Software Foundation; either version 2.1 of the License, or (at your option) *
+ * any later version.                                                                                                  *
+ *                                                                                                                     *
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied  *
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for     *
+ * more details.                                                                                                       *
+ *                                                                                                                     *
+ * You should have received a copy of the GNU Lesser General Public License along with this program; if not, you may   *
+ * find one here:                                                                                                      *
+ * https://www.gnu.org/licenses/old-licenses/lgpl-2.1.txt                                                              *
+ * or you may search the http://www.gnu.org website for the version 2.1 license, or you may write to the Free Software *
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA                                      *
+ **********************************************************************************************************************/
+
+#include <algorithm>
+#include "gp4par.h"
+
+using namespace std;
+
+/**
+	@brief One step along a timing path
+ */
+class TimingHop
+{
+public:
+	///The netlist node we arrive at
+	PARGraphNode* m_node;
+
+	///The edge we arrived on (NULL at the start of the path)
+	PARGraphEdge* m_edge;
+
+	///Delay of m_edge
+	unsigned int m_routeDelay;
+
+	///Delay through m_node (zero at the end of a path into a register)
+	unsigned int m_cellDelay;
+
+	///Total path delay so far, including this hop
+	unsigned int m_arrival;
+};
+
+enum TimingPathType
+{
+	PATH_REG_TO_REG,
+	PATH_PIN_TO_PIN,
+	PATH_CLOCK_TO_OUT,
+
+	PATH_TYPE_COUNT
+};
+
+static const char* g_pathTypeNames[PATH_TYPE_COUNT] =
+{
+	"register to register",
+	"pin to pin",
+	"clock to out"
+};
+
+static const char* g_pathTypeIDs[PATH_TYPE_COUNT] =
+{
+	"reg2reg",
+	"pin2pin",
+	"clk2out"
+};
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Analysis
+
+static Greenpak4BitstreamEntity* GetSite(PARGraphNode* node)
+{
+	return static_cast<Greenpak4BitstreamEntity*>(node->GetMate()->GetData());
+}
+
+/**
+	@brief Returns true if a netlist edge carries data (not a clock or constant)
+ */
+static bool IsDataEdge(Greenpak4Device* device, PARGraphEdge* edge)
+{
+	return device->IsDataRoute(GetSite(edge->m_sourcenode), GetSite(edge->m_destnode), edge->m_destport);
+}
+
+/**
+	@brief Finds the worst path of each type in the placed netlist.
+
+	This uses the same delay model and timing graph as the placer's timing cost (see PAREngine::ComputeTimingOrder()):
+	paths stop at register inputs and start over at register outputs, and combinational loops are cut where a
+	depth-first search first closes them.
+
+	@param paths	Filled with the worst path of each type, indexed by TimingPathType (empty if there is none)
+ */
+static void FindWorstPaths(PARGraph* netlist, Greenpak4Device* device, vector< vector<TimingHop> >& paths)
+{
+	uint32_t nnodes = netlist->GetNumNodes();
+	paths.assign(PATH_TYPE_COUNT, vector<TimingHop>());
+
+	//Classify every node
+	vector<bool> reg(nnodes);
+	vector<bool> pin(nnodes);
+	vector<unsigned int> celldelay(nnodes);
+	for(uint32_t i=0; i<nnodes; i++)
+	{
+		auto node = netlist->GetNodeByIndex(i);
+		auto cell = static_cast<Greenpak4NetlistEntity*>(node->GetData());
+		auto site = GetSite(node);
+		reg[i] = site->IsSequential(cell);
+		pin[i] = (dynamic_cast<Greenpak4IOB*>(site) != NULL);
+		celldelay[i] = site->GetPropagationDelay(cell);
+	}
+
+	//Topological order: reverse postorder of a DFS over the data edges into combinational nodes
+	vector<bool> visited(nnodes, false);
+	vector<uint32_t> order;
+	vector< pair<uint32_t, uint32_t> > stack;
+	for(uint32_t root=0; root<nnodes; root++)
+	{
+		if(visited[root])
+			continue;
+		visited[root] = true;
+		stack.push_back(pair<uint32_t, uint32_t>(root, 0));
+
+		while(!stack.empty())
+		{
+			uint32_t i = stack.back().first;
+			auto node = netlist->GetNodeByIndex(i);
+			if(stack.back().second < node->GetEdgeCount())
+			{
+				auto edge = node->GetEdgeByIndex(stack.back().second ++);
+				uint32_t k = edge->m_destnode->GetIndex();
+				if(!visited[k] && !reg[k] && IsDataEdge(device, edge))
+				{
+					visited[k] = true;
+					stack.push_back(pair<uint32_t, uint32_t>(k, 0));
+				}
+				continue;
+			}
+
+			order.push_back(i);
+			stack.pop_back();
+		}
+	}
+	reverse(order.begin(), order.end());
+	vector<uint32_t> rank(nnodes);
+	for(uint32_t i=0; i<nnodes; i++)
+		rank[order[i]] = i;
+
+	//Edges in the timing graph, and which nodes have any timed fan-in or fan-out
+	auto timed = [&](PARGraphEdge* edge)
+	{
+		uint32_t src = edge->m_sourcenode->GetIndex();
+		uint32_t dst = edge->m_destnode->GetIndex();
+		if(!reg[dst] && (rank[src] >= rank[dst]))
+			return false;
+		return IsDataEdge(device, edge);
+	};
+	vector<bool> fanin(nnodes, false);
+	vector<bool> fanout(nnodes, false);
+	for(uint32_t i=0; i<nnodes; i++)
+	{
+		auto node = netlist->GetNodeByIndex(i);
+		for(uint32_t j=0; j<node->GetEdgeCount(); j++)
+		{
+			auto edge = node->GetEdgeByIndex(j);
+			if(!timed(edge))
+				continue;
+			fanout[i] = true;
+			fanin[edge->m_destnode->GetIndex()] = true;
+		}
+	}
+
+	//One forward pass for paths launched by registers, then one for paths from input pins
+	vector<unsigned int> worst(PATH_TYPE_COUNT, 0);
+	for(int from_pins=0; from_pins<2; from_pins++)
+	{
+		auto starts = [&](uint32_t i)
+		{ return from_pins ? (pin[i] && !fanin[i]) : reg[i]; };
+
+		//Latest arrival at each node's inputs and outputs (-1 if no path of this kind gets there),
+		//and the edge the latest input arrival came in on
+		vector<int64_t> input(nnodes, -1);
+		vector<int64_t> output(nnodes, -1);
+		vector<PARGraphEdge*> pred(nnodes, NULL);
+		for(auto i : order)
+		{
+			if(starts(i))
+				output[i] = celldelay[i];
+			else if(!reg[i] && (input[i] >= 0))
+				output[i] = input[i] + celldelay[i];
+			else
+				continue;
+
+			auto node = netlist->GetNodeByIndex(i);
+			for(uint32_t j=0; j<node->GetEdgeCount(); j++)
+			{
+				auto edge = node->GetEdgeByIndex(j);
+				if(!timed(edge))
+					continue;
+
+				uint32_t k = edge->m_destnode->GetIndex();
+				int64_t arrival = output[i] + device->GetRoutingDelay(
+					GetSite(node), GetSite(edge->m_destnode), edge->m_destport);
+				if(arrival > input[k])
+				{
+					input[k] = arrival;
+					pred[k] = edge;
+				}
+			}
+		}
+
+		//Find the worst endpoint of each type
+		for(uint32_t i=0; i<nnodes; i++)
+		{
+			int type;
+			int64_t delay;
+			if(!from_pins && reg[i] && (input[i] >= 0))
+			{
+				type = PATH_REG_TO_REG;
+				delay = input[i];
+			}
+			else if(pin[i] && !reg[i] && !fanout[i] && (input[i] >= 0))
+			{
+				type = from_pins ? PATH_PIN_TO_PIN : PATH_CLOCK_TO_OUT;
+				delay = output[i];
+			}
+			else
+				continue;
+
+			if(!paths[type].empty() && (delay <= worst[type]))
+				continue;
+			worst[type] = delay;
+
+			//Walk back to the start of the path
+			vector<TimingHop>& hops = paths[type];
+			hops.clear();
+			uint32_t k = i;
+			bool at_input = reg[i];
+			while(true)
+			{
+				TimingHop hop;
+				hop.m_node = netlist->GetNodeByIndex(k);
+				if(!at_input && starts(k))
+				{
+					hop.m_edge = NULL;
+					hop.m_routeDelay = 0;
+					hop.m_cellDelay = celldelay[k];
+					hop.m_arrival = output[k];
+					hops.push_back(hop);
+					break;
+				}
+
+				hop.m_edge = pred[k];
+				hop.m_routeDelay = device->GetRoutingDelay(
+					GetSite(hop.m_edge->m_sourcenode), GetSite(hop.m_node), hop.m_edge->m_destport);
+				hop.m_cellDelay = at_input ? 0 : celldelay[k];
+				hop.m_arrival = at_input ? input[k] : output[k];
+				hops.push_back(hop);
+
+				k = hop.m_edge->m_sourcenode->GetIndex();
+				at_input = false;
+			}
+			reverse(hops.begin(), hops.end());
+		}
+	}
+}
+
+/**
+	@brief Describes how a hop was routed
+ */
+static const char* GetRouteType(Greenpak4Device* device, const TimingHop& hop)
+{
+	if(hop.m_edge == NULL)
+		return "start";
+
+	auto src = GetSite(hop.m_edge->m_sourcenode);
+	auto dst = GetSite(hop.m_node);
+	uint16_t port = hop.m_edge->m_destport;
+	if(!dst->IsGeneralFabricInput(port))
+		return "dedicated";
+	if(device->NeedsCrossConnection(src, dst, port))
+		return "xconn";
+	return "fabric";
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Reporting
+
+/**
+	@brief Print the static timing report: the worst path of each type, hop by hop
+ */
+void PrintTimingReport(PARGraph* netlist, Greenpak4Device* device, uint32_t target)
+{
+	vector< vector<TimingHop> > paths;
+	FindWorstPaths(netlist, device, paths);
+
+	LogNotice("\nTiming report (typical delays):\n");
+	LogIndenter li;
+
+	for(int type=0; type<PATH_TYPE_COUNT; type++)
+	{
+		auto& hops = paths[type];
+		if(hops.empty())
+		{
+			LogVerbose("No %s paths\n", g_pathTypeNames[type]);
+			continue;
+		}
+
+		double delay = hops.back().m_arrival / 1000.0;
+		if( (target != 0) && (hops.back().m_arrival > target) )
+		{
+			LogWarning("Worst %s path: %.1f ns (misses %.1f ns target)\n",
+				g_pathTypeNames[type], delay, target / 1000.0);
+		}
+		else
+			LogNotice("Worst %s path: %.1f ns\n", g_pathTypeNames[type], delay);
+
+		LogIndenter li2;
+		LogVerbose("+------------------------------+-----------------+-----------+----------+----------+----------+\n");
+		LogVerbose("| %-28s | %-15s | %-9s | %8s | %8s | %8s |\n",
+			"Node", "Site", "Via", "Route", "Cell", "Total");
+		for(auto& hop : hops)
+		{
+			auto cell = static_cast<Greenpak4NetlistEntity*>(hop.m_node->GetData());
+			LogVerbose("| %-28s | %-15s | %-9s | %5.1f ns | %5.1f ns | %5.1f ns |\n",
+				cell->m_name.c_str(),
+				GetSite(hop.m_node)->GetDescription().c_str(),
+				GetRouteType(device, hop),
+				hop.m_routeDelay / 1000.0,
+				hop.m_cellDelay / 1000.0,
+				hop.m_arrival / 1000.0);
+		}
+		LogVerbose("+------------------------------+-----------------+-----------+----------+----------+----------+\n");
+	}
+}
+
+/**
+	@brief Writes a string to a JSON file, with quotes and escaping
+ */
+void WriteJSONString(FILE* fp, const string& str)
+{
+	fputc('\"', fp);
+	for(auto c : str)
+	{
+		if( (c == '\"') || (c == '\\') )
+			fprintf(fp, "\\%c", c);
+		else if(static_cast<unsigned char>(c) < 0x20)
+			fprintf(fp, "\\u%04x", c);
+		else
+			fputc(c, fp);
+	}
+	fputc('\"', fp);
+}
+
+/**
+	@brief Formats the worst path of each type as JSON, for tracking design speed over time.
+
+	Delays are in ns. Each path is a list of hops from the start point to the endpoint.
+ */
+string FormatTimingReport(PARGraph* netlist, Greenpak4Device* device, uint32_t target)
+{
+	vector< vector<TimingHop> > paths;
+	FindWorstPaths(netlist, device, paths);
+
+	char* buf = NULL;
+	size_t len = 0;
+	FILE* fp = open_memstream(&buf, &len);
+	if(!fp)
+		LogFatal("Couldn't allocate timing report\n");
+
+	fprintf(fp, "{\n");
+	fprintf(fp, "    \"target\": %.3f,\n", target / 1000.0);
+	fprintf(fp, "    \"paths\": [");
+	bool first_path = true;
+	for(int type=0; type<PATH_TYPE_COUNT; type++)
+	{
+		auto& hops = paths[type];
+		if(hops.empty())
+			continue;
+
+		fprintf(fp, "%s\n        {\n", first_path ? "" : ",");
+		first_path = false;
+		fprintf(fp, "            \"type\": \"%s\",\n", g_pathTypeIDs[type]);
+		fprintf(fp, "            \"delay\": %.3f,\n", hops.back().m_arrival / 1000.0);
+		fprintf(fp, "            \"hops\": [\n");
+		for(size_t i=0; i<hops.size(); i++)
+		{
+			auto& hop = hops[i];
+			auto cell = static_cast<Greenpak4NetlistEntity*>(hop.m_node->GetData());
+			fprintf(fp, "                { \"node\": ");
+			WriteJSONString(fp, cell->m_name);
+			fprintf(fp, ", \"site\": ");
+			WriteJSONString(fp, GetSite(hop.m_node)->GetDescription());
+			fprintf(fp, ", \"port\": ");
+			WriteJSONString(fp, (hop.m_edge == NULL) ? "" : hop.m_edge->GetDestPortName());
+			fprintf(fp, ", \"via\": \"%s\", \"route\": %.3f, \"cell\": %.3f, \"arrival\": %.3f }%s\n",
+				GetRouteType(device, hop),
+				hop.m_routeDelay / 1000.0,
+				hop.m_cellDelay / 1000.0,
+				hop.m_arrival / 1000.0,
+				(i + 1 < hops.size()) ? "," : "");
+		}
+		fprintf(fp, "            ]\n");
+		fprintf(fp, "        }");
+	}
+	fprintf(fp, "\n    ]\n");
+	fprintf(fp, "}\n");
+
+	fclose(fp);
+	string report(buf, len);
+	free(buf);
+	return report;
+}
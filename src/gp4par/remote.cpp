@@ -0,0 +1,548 @@
+/***********************************************************************************************************************
+ * Copyright (C) 2016 Andrew Zonenberg and contributors                                                                *
+ *                                                                                                                     *
+ * This program is free software; you can redistribute it and/or modify it under the terms of the GNU Lesser General   *
+ * Public License as published by the Free Software Foundation; either version 2.1 of the License, or (at your option) *
+ * any later version.                                                                                                  *
+ *                                                                                                                     *
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied  *
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for     *
+ * more details.                                                                                                       *
+ *                                                                                                                     *
+ * You should have received a copy of the GNU Lesser General Public License along with this program; if not, you may   *
+ * find one here:                                                                                                      *
+ * https://www.gnu.org/licenses/old-licenses/lgpl-2.1.txt                                                              *
+ * or you may search the http://www.gnu.org website for the version 2.1 license, or you may write to the Free Software *
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA                                      *
+ **********************************************************************************************************************/
+
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <mutex>
+#include <thread>
+#include <netdb.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include "gp4par.h"
+
+using namespace std;
+
+//Longest line we'll accept from the other end of a socket
+static const size_t MAX_SOCKET_LINE = 64 * 1024;
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Socket I/O, for the compile server, the board broker, and the servers a seed sweep runs on
+
+/**
+	@brief Checks whether a server address is host:port (TCP), rather than the path of a Unix socket
+
+	Anything with a slash in it is a path, so ./host:1234 is a Unix socket in the current directory.
+ */
+bool IsTCPAddress(const string& address)
+{
+	return (address.find('/') == string::npos) && (address.find(':') != string::npos);
+}
+
+/**
+	@brief Splits host:port into its parts, removing the brackets from [ipv6]:port
+ */
+void SplitTCPAddress(const string& address, string& host, string& port)
+{
+	size_t colon = address.rfind(':');
+	host = address.substr(0, colon);
+	port = address.substr(colon + 1);
+	if( (host.length() >= 2) && (host[0] == '[') && (host[host.length() - 1] == ']') )
+		host = host.substr(1, host.length() - 2);
+}
+
+/**
+	@brief Splits a line of a job list, or a request or reply on a server socket, into arguments.
+
+	Arguments are separated by whitespace and may be double-quoted to include spaces. Everything from a # outside
+	of quotes to the end of the line is a comment.
+ */
+vector<string> SplitJobLine(const string& line)
+{
+	vector<string> args;
+	string arg;
+	bool in_arg = false;
+	bool quoted = false;
+	for(auto c : line)
+	{
+		if(quoted)
+		{
+			if(c == '\"')
+				quoted = false;
+			else
+				arg += c;
+		}
+		else if(c == '\"')
+		{
+			quoted = true;
+			in_arg = true;
+		}
+		else if(c == '#')
+			break;
+		else if(isspace(static_cast<unsigned char>(c)))
+		{
+			if(in_arg)
+				args.push_back(arg);
+			arg = "";
+			in_arg = false;
+		}
+		else
+		{
+			arg += c;
+			in_arg = true;
+		}
+	}
+	if(in_arg)
+		args.push_back(arg);
+
+	return args;
+}
+
+/**
+	@brief Connects to a compile server, given the path of its Unix socket or its host:port
+
+	Doesn't log anything, so it can be used from threads with no job log to write to.
+
+	@param error	Set to why we couldn't connect, on failure
+
+	@return The socket, or -1 on failure
+ */
+int ConnectToServer(const string& address, string& error)
+{
+	if(!IsTCPAddress(address))
+	{
+		sockaddr_un addr;
+		memset(&addr, 0, sizeof(addr));
+		addr.sun_family = AF_UNIX;
+		if(address.length() >= sizeof(addr.sun_path))
+		{
+			error = "socket path is too long";
+			return -1;
+		}
+		strncpy(addr.sun_path, address.c_str(), sizeof(addr.sun_path) - 1);
+
+		int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+		if( (fd >= 0) && (0 == connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr))) )
+			return fd;
+
+		error = strerror(errno);
+		if(fd >= 0)
+			close(fd);
+		return -1;
+	}
+
+	string host;
+	string port;
+	SplitTCPAddress(address, host, port);
+
+	addrinfo hints;
+	memset(&hints, 0, sizeof(hints));
+	hints.ai_family = AF_UNSPEC;
+	hints.ai_socktype = SOCK_STREAM;
+	addrinfo* addrs = NULL;
+	int err = getaddrinfo(host.c_str(), port.c_str(), &hints, &addrs);
+	if(err != 0)
+	{
+		error = gai_strerror(err);
+		return -1;
+	}
+
+	int fd = -1;
+	for(addrinfo* a = addrs; a != NULL; a = a->ai_next)
+	{
+		fd = socket(a->ai_family, a->ai_socktype | SOCK_CLOEXEC, a->ai_protocol);
+		if(fd < 0)
+			continue;
+		if(0 == connect(fd, a->ai_addr, a->ai_addrlen))
+			break;
+
+		error = strerror(errno);
+		close(fd);
+		fd = -1;
+	}
+	freeaddrinfo(addrs);
+	return fd;
+}
+
+/**
+	@brief Creates a listening Unix socket, replacing any stale socket left behind by a server that's no longer running
+
+	@return The socket, or -1 (having logged why) if we couldn't listen
+ */
+int ListenUnixSocket(const string& path)
+{
+	sockaddr_un addr;
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	if(path.length() >= sizeof(addr.sun_path))
+	{
+		LogError("Socket path %s is too long\n", path.c_str());
+		return -1;
+	}
+	strncpy(addr.sun_path, path.c_str(), sizeof(addr.sun_path) - 1);
+
+	int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	if(fd < 0)
+	{
+		LogError("Couldn't create socket: %s\n", strerror(errno));
+		return -1;
+	}
+
+	if(0 != ::bind(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)))
+	{
+		//If nobody's listening on the old socket, it's safe to replace
+		bool stale = false;
+		if(errno == EADDRINUSE)
+		{
+			int probe = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+			if( (probe >= 0) && (0 != connect(probe, reinterpret_cast<sockaddr*>(&addr), sizeof(addr))) )
+				stale = (errno == ECONNREFUSED);
+			if(probe >= 0)
+				close(probe);
+		}
+
+		if( !stale || (0 != unlink(path.c_str())) ||
+			(0 != ::bind(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr))) )
+		{
+			LogError("Couldn't listen on %s: %s\n", path.c_str(), strerror(errno));
+			close(fd);
+			return -1;
+		}
+	}
+
+	if(0 != listen(fd, 64))
+	{
+		LogError("Couldn't listen on %s: %s\n", path.c_str(), strerror(errno));
+		close(fd);
+		unlink(path.c_str());
+		return -1;
+	}
+
+	return fd;
+}
+
+/**
+	@brief Reads a newline-terminated line (without the newline), a byte at a time so we don't eat into what follows
+ */
+bool SocketReadLine(int fd, string& line)
+{
+	line = "";
+	while(line.length() < MAX_SOCKET_LINE)
+	{
+		char c;
+		ssize_t n = recv(fd, &c, 1, 0);
+		if( (n < 0) && (errno == EINTR) )
+			continue;
+		if(n <= 0)
+			return false;
+
+		if(c == '\n')
+			return true;
+		line += c;
+	}
+	return false;
+}
+
+bool SocketReadAll(int fd, char* buf, size_t len)
+{
+	while(len > 0)
+	{
+		ssize_t n = recv(fd, buf, len, 0);
+		if( (n < 0) && (errno == EINTR) )
+			continue;
+		if(n <= 0)
+			return false;
+
+		buf += n;
+		len -= n;
+	}
+	return true;
+}
+
+bool SocketSendAll(int fd, const char* buf, size_t len)
+{
+	while(len > 0)
+	{
+		ssize_t n = send(fd, buf, len, MSG_NOSIGNAL);
+		if( (n < 0) && (errno == EINTR) )
+			continue;
+		if(n <= 0)
+			return false;
+
+		buf += n;
+		len -= n;
+	}
+	return true;
+}
+
+bool SocketSendLine(int fd, const char* format, ...)
+{
+	char buf[256];
+	va_list va;
+	va_start(va, format);
+	int len = vsnprintf(buf, sizeof(buf), format, va);
+	va_end(va);
+
+	return SocketSendAll(fd, buf, min<size_t>(len, sizeof(buf) - 1));
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Seed sweeps
+
+/**
+	@brief Describes every option that changes the placement, as job options for a remote server.
+
+	Anything that's added to PAROptions and changes the placement has to be added here too (the same things as in
+	CompileCache::GetOptionsKey(), less the ones that only affect the bitstream).
+ */
+static string FormatSweepOptions(const CompileOptions& options)
+{
+	const PAROptions& p = options.par;
+	string args = "--part " + GetPartName(options.part);
+	if(!p.optimize)
+		args += " --no-optimize";
+	if(p.verifyCost)
+		args += " --verify-cost";
+	if(p.multilevel)
+		args += " --multilevel";
+
+	char tmp[128];
+	snprintf(tmp, sizeof(tmp), " --timing-target %.3f --batch-moves %u --time-limit %.6f",
+		p.timingTarget / 1000.0, p.batchMoves, p.timeLimit);
+	args += tmp;
+	return args;
+}
+
+/**
+	@brief The seeds one remote server is running, and what came back
+ */
+class RemoteSweep
+{
+public:
+	RemoteSweep()
+		: first(0)
+		, count(0)
+		, fd(-1)
+		, done(false)
+		, routable(false)
+		, cost(0)
+	{}
+
+	string server;
+	uint32_t first;
+	uint32_t count;
+
+	//Connection to the server (protected by the sweep's lock, so it can be disconnected to cancel the job)
+	int fd;
+
+	//Set once we're finished with the server, whether or not it sent a placement
+	bool done;
+
+	//What came back: an empty placement means we didn't get one, and error says why
+	bool routable;
+	uint32_t cost;
+	string placement;
+	string error;
+};
+
+/**
+	@brief Sends one server its seeds and waits for the result
+
+	Runs on a thread with no job log, so errors are kept in the sweep for the caller to report.
+ */
+static void RunRemoteSweep(RemoteSweep& sweep, const string& args, const char* json, size_t len, mutex& lock)
+{
+	int fd = ConnectToServer(sweep.server, sweep.error);
+	{
+		lock_guard<mutex> guard(lock);
+		sweep.fd = fd;
+	}
+	if(fd < 0)
+		return;
+
+	if(!SocketSendLine(fd, "seeds %zu %u %u ", len, sweep.first, sweep.count) ||
+		!SocketSendAll(fd, args.c_str(), args.length()) ||
+		!SocketSendAll(fd, "\n", 1) ||
+		!SocketSendAll(fd, json, len) )
+	{
+		sweep.error = "couldn't send the netlist";
+		return;
+	}
+
+	//We get "busy" or an error instead of a job number if the server won't run it
+	string line;
+	if(!SocketReadLine(fd, line))
+	{
+		sweep.error = "disconnected";
+		return;
+	}
+	if(line.find("job ") != 0)
+	{
+		sweep.error = line;
+		return;
+	}
+
+	//then "done <status> <cost> <placement size>" and the placement
+	if(!SocketReadLine(fd, line))
+	{
+		sweep.error = "disconnected";
+		return;
+	}
+	vector<string> reply = SplitJobLine(line);
+	if( (reply.size() != 4) || (reply[0] != "done") )
+	{
+		sweep.error = line;
+		return;
+	}
+	if( (reply[1] != "ok") && (reply[1] != "unroutable") )
+	{
+		sweep.error = reply[1];
+		return;
+	}
+
+	size_t size = strtoull(reply[3].c_str(), NULL, 10);
+	vector<char> buf(size);
+	if( (size != 0) && !SocketReadAll(fd, &buf[0], size) )
+	{
+		sweep.error = "placement was cut short";
+		return;
+	}
+	sweep.routable = (reply[1] == "ok");
+	sweep.cost = strtoul(reply[2].c_str(), NULL, 10);
+	sweep.placement.assign(buf.begin(), buf.end());
+}
+
+/**
+	@brief Runs the seeds of a --seeds compile on other compile servers, and fetches the placement of the best one.
+
+	The seeds are split into one contiguous range per server (see PAROptions::remoteServers), and each server sends
+	back only the cost and placement of the best seed in its range, so the network cost is a few KB. As soon as
+	any server finds a perfect placement the others are disconnected, which cancels their jobs.
+
+	The caller commits the winning placement itself (see PAROptions::fixedPlacement). If none of the servers could be
+	reached, or they all failed, the caller should run the seeds itself: that either works, or fails with a more
+	useful error than a remote server can send.
+
+	Options the remote servers can't use (files on this host, and --exact, which ignores the seeds anyway) mean the
+	seeds have to run here.
+
+	@param json			The netlist, as sent to the servers
+	@param len			Size of the netlist, in bytes
+	@param options		Device and PAR settings
+	@param placement	Set to the winning placement, in the format FormatPlacement() writes
+
+	@return True if we got a placement back
+ */
+bool RemoteSeedSweep(const char* json, size_t len, const CompileOptions& options, string& placement)
+{
+	const PAROptions& p = options.par;
+	if(!p.annealProfileFile.empty() || !p.reusePlacementFile.empty() || (p.exactTime > 0))
+	{
+		LogNotice("\n--anneal-profile, --reuse-placement and --exact can't be sent to remote servers, "
+			"running the seeds here\n");
+		return false;
+	}
+
+	unsigned int count = min<size_t>(p.remoteServers.size(), p.seeds);
+	LogNotice("\nOptimizing placement (%u seeds, on %u remote servers)...\n", p.seeds, count);
+	LogIndenter li;
+
+	vector<RemoteSweep> sweeps(count);
+
+	//Hand out the seeds as evenly as possible
+	uint32_t next_seed = p.seed;
+	for(unsigned int i=0; i<count; i++)
+	{
+		sweeps[i].server = p.remoteServers[i];
+		sweeps[i].first = next_seed;
+		sweeps[i].count = p.seeds / count + ( (i < p.seeds % count) ? 1 : 0 );
+		next_seed += sweeps[i].count;
+	}
+
+	string args = FormatSweepOptions(options);
+	mutex lock;
+	condition_variable finished;
+	vector<thread> threads;
+	for(unsigned int i=0; i<count; i++)
+	{
+		threads.push_back(thread([&, i]()
+		{
+			RunRemoteSweep(sweeps[i], args, json, len, lock);
+
+			lock_guard<mutex> guard(lock);
+			sweeps[i].done = true;
+			finished.notify_all();
+		}));
+	}
+
+	//Wait for everything to finish, disconnecting from everyone once nobody can do better (or we're cancelled)
+	{
+		unique_lock<mutex> guard(lock);
+		while(true)
+		{
+			bool all_done = true;
+			bool stop = (p.cancel != NULL) && *p.cancel;
+			for(auto& s : sweeps)
+			{
+				all_done = all_done && s.done;
+				stop = stop || (s.done && s.routable && (s.cost == 0));
+			}
+			if(all_done)
+				break;
+
+			if(stop)
+			{
+				for(auto& s : sweeps)
+				{
+					if(!s.done && (s.fd >= 0))
+						shutdown(s.fd, SHUT_RDWR);
+				}
+			}
+			finished.wait_for(guard, chrono::milliseconds(100));
+		}
+	}
+	for(auto& t : threads)
+		t.join();
+
+	//Report results, and keep the best (anything routable beats anything that isn't)
+	RemoteSweep* best = NULL;
+	for(auto& s : sweeps)
+	{
+		if(s.fd >= 0)
+			close(s.fd);
+
+		if(s.placement.empty())
+		{
+			LogVerbose("Seeds %u-%u on %s: %s\n", s.first, s.first + s.count - 1, s.server.c_str(), s.error.c_str());
+			continue;
+		}
+		LogVerbose("Seeds %u-%u on %s: cost %u (%s)\n", s.first, s.first + s.count - 1, s.server.c_str(),
+			s.cost, s.routable ? "routable" : "unroutable");
+
+		bool better =
+			(best == NULL) ||
+			(s.routable && !best->routable) ||
+			( (s.routable == best->routable) && (s.cost < best->cost) );
+		if(better)
+			best = &s;
+	}
+
+	if( (p.cancel != NULL) && *p.cancel )
+		return false;
+	if(best == NULL)
+	{
+		LogWarning("None of the remote servers found a placement, running the seeds here\n");
+		return false;
+	}
+
+	LogNotice("Using placement from %s (cost %u)\n", best->server.c_str(), best->cost);
+	placement = best->placement;
+	return true;
+}
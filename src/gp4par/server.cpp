@@ -0,0 +1,829 @@
+/***********************************************************************************************************************
+ * Copyright (C) 2016 Andrew Zonenberg and contributors                                                                *
+ *                                                                                                                     *
+ * This program is free software; you can redistribute it and/or modify it under the terms of the GNU Lesser General   *
+ * Public License as published by the Free Software Foundation; either version 2.1 of the License, or (at your option) *
+ * any later version.                                                                                                  *
+ *                                                                                                                     *
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied  *
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for     *
+ * more details.                                                                                                       *
+ *                                                                                                                     *
+ * You should have received a copy of the GNU Lesser General Public License along with this program; if not, you may   *
+ * find one here:                                                                                                      *
+ * https://www.gnu.org/licenses/old-licenses/lgpl-2.1.txt                                                              *
+ * or you may search the http://www.gnu.org website for the version 2.1 license, or you may write to the Free Software *
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA                                      *
+ **********************************************************************************************************************/
+
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <csignal>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <netdb.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <metrics.h>
+#include "gp4par.h"
+
+using namespace std;
+
+//Largest netlist we'll accept over the socket
+static const size_t MAX_NETLIST_SIZE = 256 * 1024 * 1024;
+
+//How long a client can take to send its request before we give up on it
+static const int REQUEST_TIMEOUT = 30;
+
+//Set by SIGINT/SIGTERM
+static volatile sig_atomic_t g_serverStop = 0;
+
+static void OnServerSignal(int /*sig*/)
+{
+	g_serverStop = 1;
+}
+
+/**
+	@brief One compile request being handled by the server
+ */
+class ServerJob
+{
+public:
+	ServerJob(unsigned int id, int fd)
+		: id(id)
+		, fd(fd)
+		, cancel(false)
+		, running(false)
+	{}
+
+	unsigned int id;
+
+	//Connection to the client that asked for the job
+	int fd;
+
+	//Set when the client hangs up or another client cancels the job
+	atomic<bool> cancel;
+
+	//True once the job has a thread to compile on (protected by the server's mutex)
+	bool running;
+};
+
+/**
+	@brief Compiles netlists sent to it over a Unix socket, until it's told to stop
+ */
+class CompileServer
+{
+public:
+	CompileServer(const CompileOptions& defaults, unsigned int queue_depth);
+
+	bool Run(const string& path, const string& metrics_address);
+
+protected:
+	bool Listen(const string& path);
+	bool ListenTCP(const string& address);
+	void StopListening(const string& path);
+	void WatchForHangups();
+
+	void HandleConnection(int fd);
+	void HandleCompile(int fd, const string& request);
+	void HandleSeeds(int fd, const string& request);
+	void HandleCancel(int fd, const string& request);
+	void HandleStatus(int fd);
+
+	bool RunJob(
+		int fd,
+		const string& name,
+		CompileOptions& options,
+		const vector<char>& netlist,
+		CompileResult& result,
+		string& status,
+		string& log);
+	bool Admit(shared_ptr<ServerJob> job);
+	bool WaitForThread(shared_ptr<ServerJob> job);
+	void Finish(shared_ptr<ServerJob> job);
+	void Cancel(shared_ptr<ServerJob> job);
+	void UpdateQueueMetrics();
+
+	static void DescribeMetrics();
+	static void RecordJobMetrics(
+		const CompileOptions& options,
+		const CompileResult& result,
+		const string& status,
+		double seconds);
+
+	//Options for every job, before the request's own options are applied
+	CompileOptions m_defaults;
+
+	//Number of jobs allowed to compile at once, and to wait for a free thread
+	unsigned int m_threads;
+	unsigned int m_queueDepth;
+
+	//The socket we're listening on, and whether it's a TCP port (so the other end could be anyone)
+	int m_listenFd;
+	bool m_tcp;
+
+	//Everything below here is protected by m_mutex
+	mutex m_mutex;
+
+	//Signalled when a job finishes or is cancelled, or a connection is closed
+	condition_variable m_changed;
+
+	//Jobs that have been admitted but not finished, by ID
+	map<unsigned int, shared_ptr<ServerJob> > m_jobs;
+	unsigned int m_nextJob;
+	unsigned int m_running;
+	unsigned int m_completed;
+
+	//Connections still being handled
+	unsigned int m_connections;
+};
+
+CompileServer::CompileServer(const CompileOptions& defaults, unsigned int queue_depth)
+	: m_defaults(defaults)
+	, m_threads(max(1u, defaults.par.jobs))
+	, m_queueDepth(queue_depth)
+	, m_listenFd(-1)
+	, m_tcp(false)
+	, m_nextJob(1)
+	, m_running(0)
+	, m_completed(0)
+	, m_connections(0)
+{
+	//--jobs is the number of jobs to run at once, so each job is single threaded unless it asks otherwise
+	m_defaults.par.jobs = 1;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Main loop
+
+/**
+	@brief Serves requests until we get SIGINT or SIGTERM
+
+	@return True on a clean shutdown, false if we couldn't start
+ */
+bool CompileServer::Run(const string& path, const string& metrics_address)
+{
+	if(!Listen(path))
+		return false;
+	DescribeMetrics();
+	if( (metrics_address != "") && !StartMetricsServer(metrics_address) )
+	{
+		StopListening(path);
+		return false;
+	}
+
+	//Build the model for the default part now, so the first job doesn't wait for it.
+	//Models for any other parts are built by the first job that needs them, and kept from then on.
+	PreloadDeviceModel(m_defaults.part);
+
+	//Clients that hang up are noticed next time we try to talk to them, not by killing us
+	signal(SIGPIPE, SIG_IGN);
+	signal(SIGINT, OnServerSignal);
+	signal(SIGTERM, OnServerSignal);
+
+	LogNotice("\nListening on %s (%u threads, up to %u jobs queued)\n", path.c_str(), m_threads, m_queueDepth);
+
+	while(!g_serverStop)
+		WatchForHangups();
+
+	LogNotice("\nShutting down...\n");
+	StopListening(path);
+
+	//Stop anything still running, then wait for every connection to wrap up
+	unique_lock<mutex> lock(m_mutex);
+	for(auto it : m_jobs)
+		it.second->cancel = true;
+	m_changed.notify_all();
+	while(m_connections != 0)
+		m_changed.wait(lock);
+
+	return true;
+}
+
+/**
+	@brief Creates the listening socket, on a TCP port if the address is host:port and a Unix socket otherwise
+ */
+bool CompileServer::Listen(const string& path)
+{
+	m_tcp = IsTCPAddress(path);
+	if(m_tcp)
+		return ListenTCP(path);
+
+	m_listenFd = ListenUnixSocket(path);
+	return (m_listenFd >= 0);
+}
+
+/**
+	@brief Closes the listening socket, and removes it if it's a Unix socket
+ */
+void CompileServer::StopListening(const string& path)
+{
+	close(m_listenFd);
+	if(!IsTCPAddress(path))
+		unlink(path.c_str());
+}
+
+/**
+	@brief Listens on a TCP port, so servers on other hosts can send us seeds to run (see RemoteSeedSweep())
+
+	With no host (":port") we listen on localhost only; other hosts can only connect if we're given the address of an
+	interface to listen on (or 0.0.0.0 or [::] for all of them). There's no authentication, so TCP clients can only send
+	seeds, and can't name any files here (see HandleConnection()).
+ */
+bool CompileServer::ListenTCP(const string& address)
+{
+	string host;
+	string port;
+	SplitTCPAddress(address, host, port);
+
+	addrinfo hints;
+	memset(&hints, 0, sizeof(hints));
+	hints.ai_family = AF_UNSPEC;
+	hints.ai_socktype = SOCK_STREAM;
+	addrinfo* addrs = NULL;
+	int err = getaddrinfo(host.empty() ? "localhost" : host.c_str(), port.c_str(), &hints, &addrs);
+	if(err != 0)
+	{
+		LogError("Couldn't look up %s: %s\n", address.c_str(), gai_strerror(err));
+		return false;
+	}
+
+	m_listenFd = -1;
+	for(addrinfo* a = addrs; a != NULL; a = a->ai_next)
+	{
+		m_listenFd = socket(a->ai_family, a->ai_socktype | SOCK_CLOEXEC, a->ai_protocol);
+		if(m_listenFd < 0)
+			continue;
+
+		//A restarted server shouldn't have to wait for the old one's connections to time out
+		int yes = 1;
+		setsockopt(m_listenFd, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(yes));
+		if( (0 == ::bind(m_listenFd, a->ai_addr, a->ai_addrlen)) && (0 == listen(m_listenFd, 64)) )
+			break;
+
+		err = errno;
+		close(m_listenFd);
+		m_listenFd = -1;
+		errno = err;
+	}
+	freeaddrinfo(addrs);
+
+	if(m_listenFd < 0)
+	{
+		LogError("Couldn't listen on %s: %s\n", address.c_str(), strerror(errno));
+		return false;
+	}
+	return true;
+}
+
+/**
+	@brief Waits a little while for new connections, and for clients of running jobs to hang up (which cancels them)
+ */
+void CompileServer::WatchForHangups()
+{
+	//Check the listening socket plus every job being compiled
+	vector<pollfd> fds;
+	vector< shared_ptr<ServerJob> > jobs;
+	fds.push_back({m_listenFd, POLLIN, 0});
+	{
+		lock_guard<mutex> lock(m_mutex);
+		for(auto it : m_jobs)
+		{
+			fds.push_back({it.second->fd, POLLRDHUP, 0});
+			jobs.push_back(it.second);
+		}
+	}
+
+	//Time out now and then so we notice new jobs and shutdown requests
+	if(poll(&fds[0], fds.size(), 100) <= 0)
+		return;
+
+	for(size_t i=0; i<jobs.size(); i++)
+	{
+		if(fds[i+1].revents & (POLLRDHUP | POLLHUP | POLLERR))
+			Cancel(jobs[i]);
+	}
+
+	if(fds[0].revents & POLLIN)
+	{
+		int fd = accept4(m_listenFd, NULL, NULL, SOCK_CLOEXEC);
+		if(fd < 0)
+			return;
+
+		//Don't let a client that never finishes its request tie up a thread forever
+		timeval timeout = {REQUEST_TIMEOUT, 0};
+		setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+		{
+			lock_guard<mutex> lock(m_mutex);
+			m_connections ++;
+		}
+		thread(&CompileServer::HandleConnection, this, fd).detach();
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Requests
+
+/**
+	@brief Reads one request from a client and answers it
+
+	Anyone who can reach a TCP port can connect, so only seeds requests are taken over TCP. Those send the netlist with
+	the request, and can't name files (see NamesAnyFile()), so a TCP client can't read or write anything here.
+ */
+void CompileServer::HandleConnection(int fd)
+{
+	string request;
+	if(SocketReadLine(fd, request))
+	{
+		string command = request.substr(0, request.find(' '));
+		if(m_tcp && (command != "seeds"))
+			SocketSendLine(fd, "error only seeds requests are accepted over TCP\n");
+		else if(command == "compile")
+			HandleCompile(fd, request);
+		else if(command == "seeds")
+			HandleSeeds(fd, request);
+		else if(command == "cancel")
+			HandleCancel(fd, request);
+		else if(command == "status")
+			HandleStatus(fd);
+		else
+			SocketSendLine(fd, "error unknown request\n");
+	}
+
+	close(fd);
+
+	lock_guard<mutex> lock(m_mutex);
+	m_connections --;
+	m_changed.notify_all();
+}
+
+/**
+	@brief Handles "compile <size> [options]", followed by <size> bytes of netlist
+ */
+void CompileServer::HandleCompile(int fd, const string& request)
+{
+	vector<string> args = SplitJobLine(request);
+	char* end = NULL;
+	unsigned long long len = (args.size() < 2) ? 0 : strtoull(args[1].c_str(), &end, 10);
+	if( (args.size() < 2) || (*end != '\0') )
+	{
+		SocketSendLine(fd, "error expected compile <netlist size> [options]\n");
+		return;
+	}
+	if(len > MAX_NETLIST_SIZE)
+	{
+		SocketSendLine(fd, "error netlist is too big (limit is %zu bytes)\n", MAX_NETLIST_SIZE);
+		return;
+	}
+
+	vector<char> netlist(len);
+	if( (len != 0) && !SocketReadAll(fd, &netlist[0], len) )
+	{
+		SocketSendLine(fd, "error netlist was cut short\n");
+		return;
+	}
+
+	//Same options as the command line, except that the bitstream always comes back to the client
+	CompileOptions options = m_defaults;
+	args.erase(args.begin(), args.begin() + 2);
+	if(!ParseJobOptions(args, options))
+	{
+		SocketSendLine(fd, "error invalid options, see the server console for details\n");
+		return;
+	}
+	options.par.jobs = min(options.par.jobs, m_threads);
+	if(options.outputFile != "")
+	{
+		SocketSendLine(fd, "error --output isn't allowed, the bitstream is sent back instead\n");
+		return;
+	}
+	if( (options.stampFile != "") || (options.templateFile != "") )
+	{
+		SocketSendLine(fd, "error --stamp and --write-template aren't supported by the server\n");
+		return;
+	}
+	if( (len == 0) && ( (options.netlistFile == "") || (options.netlistFile == "-") ) )
+	{
+		SocketSendLine(fd, "error expected a netlist, or the name of a netlist file\n");
+		return;
+	}
+
+	string name = (len == 0) ? options.netlistFile : string("(") + to_string(len) + " byte netlist)";
+	CompileResult result;
+	string status;
+	string log;
+	if(!RunJob(fd, name, options, netlist, result, status, log))
+		return;
+
+	//Send back the results (if the client hung up, this just fails)
+	if(status != "ok")
+		result.bitstream = "";
+	if(SocketSendLine(fd, "done %s %zu %zu %u %u %u\n",
+		status.c_str(),
+		result.bitstream.size(),
+		log.size(),
+		result.drc.GetErrorCount(),
+		result.drc.GetWarningCount(),
+		result.criticalPathDelay))
+	{
+		if(SocketSendAll(fd, result.bitstream.c_str(), result.bitstream.size()))
+			SocketSendAll(fd, log.c_str(), log.size());
+	}
+}
+
+/**
+	@brief Checks if a request's options name any file on this host, other than the ones in the server's defaults
+ */
+static bool NamesAnyFile(const CompileOptions& options, const CompileOptions& defaults)
+{
+	const PAROptions& p = options.par;
+	const PAROptions& d = defaults.par;
+	return (options.netlistFile != defaults.netlistFile) ||
+		(options.mergeFiles != defaults.mergeFiles) ||
+		(options.manifestFile != defaults.manifestFile) ||
+		(options.netlistCache != defaults.netlistCache) ||
+		(options.resultCache != defaults.resultCache) ||
+		(options.outputFile != defaults.outputFile) ||
+		(options.statsFile != defaults.statsFile) ||
+		(options.templateFile != defaults.templateFile) ||
+		(options.stampFile != defaults.stampFile) ||
+		(p.timingReportFile != d.timingReportFile) ||
+		(p.drcReportFile != d.drcReportFile) ||
+		(p.placementFile != d.placementFile) ||
+		(p.reusePlacementFile != d.reusePlacementFile) ||
+		(p.annealProfileFile != d.annealProfileFile) ||
+		(p.recordMovesFile != d.recordMovesFile) ||
+		(p.replayMovesFile != d.replayMovesFile);
+}
+
+/**
+	@brief Handles "seeds <size> <first seed> <count> [options]", followed by <size> bytes of netlist
+
+	Runs some of the seeds of another server's job (see RemoteSeedSweep()), and sends back only the cost and
+	placement of the best one. Unlike a compile job, a seed sweep uses all of our threads (but no more). The options
+	can't name any files, since the other server may be on another host.
+ */
+void CompileServer::HandleSeeds(int fd, const string& request)
+{
+	vector<string> args = SplitJobLine(request);
+	vector<unsigned long long> values;
+	for(size_t i=1; (i<4) && (i<args.size()); i++)
+	{
+		char* end = NULL;
+		values.push_back(strtoull(args[i].c_str(), &end, 10));
+		if(*end != '\0')
+			break;
+	}
+	if( (values.size() != 3) || (values[0] == 0) || (values[2] == 0) )
+	{
+		SocketSendLine(fd, "error expected seeds <netlist size> <first seed> <count> [options]\n");
+		return;
+	}
+	size_t len = values[0];
+	if(len > MAX_NETLIST_SIZE)
+	{
+		SocketSendLine(fd, "error netlist is too big (limit is %zu bytes)\n", MAX_NETLIST_SIZE);
+		return;
+	}
+
+	vector<char> netlist(len);
+	if(!SocketReadAll(fd, &netlist[0], len))
+	{
+		SocketSendLine(fd, "error netlist was cut short\n");
+		return;
+	}
+
+	CompileOptions options = m_defaults;
+	options.par.jobs = m_threads;
+	args.erase(args.begin(), args.begin() + 4);
+	if(!ParseJobOptions(args, options))
+	{
+		SocketSendLine(fd, "error invalid options, see the server console for details\n");
+		return;
+	}
+	if(NamesAnyFile(options, m_defaults))
+	{
+		SocketSendLine(fd, "error options naming files aren't allowed in seeds requests\n");
+		return;
+	}
+	options.par.jobs = min(options.par.jobs, m_threads);
+	options.par.seed = values[1];
+	options.par.seeds = values[2];
+	options.par.placementOnly = true;
+
+	//Everything goes back to the other server, so nothing is written here (and not to our result cache either,
+	//since what we make isn't a complete result). We don't pass the seeds on to our own remote servers.
+	options.resultCache = "";
+	options.statsFile = "";
+	options.manifestFile = "";
+	options.par.timingReportFile = "";
+	options.par.drcReportFile = "";
+	options.par.placementFile = "";
+	options.par.remoteServers.clear();
+
+	char name[64];
+	snprintf(name, sizeof(name), "seeds %u-%u", options.par.seed, options.par.seed + options.par.seeds - 1);
+	CompileResult result;
+	string status;
+	string log;
+	if(!RunJob(fd, name, options, netlist, result, status, log))
+		return;
+
+	//A placement that doesn't route is still worth sending back, in case nobody does better
+	if( (status == "failed") && !result.placement.empty() )
+		status = "unroutable";
+	if(SocketSendLine(fd, "done %s %u %zu\n", status.c_str(), result.placementCost, result.placement.size()))
+		SocketSendAll(fd, result.placement.c_str(), result.placement.size());
+}
+
+/**
+	@brief Queues a job, runs it once there's a thread for it, and reports how it went.
+
+	Answers "busy" or "job <id>" for the caller, who sends back the results.
+
+	@param fd		Connection to the client
+	@param name		What the job is compiling, for the console
+	@param options	What to compile (the cancel flag is set to the job's)
+	@param netlist	The netlist, or empty to compile options.netlistFile
+	@param result	Set to what the compile made
+	@param status	Set to "ok", "failed" or "cancelled"
+	@param log		Set to the job's log
+
+	@return False if the job was turned away because the queue was full
+ */
+bool CompileServer::RunJob(
+	int fd,
+	const string& name,
+	CompileOptions& options,
+	const vector<char>& netlist,
+	CompileResult& result,
+	string& status,
+	string& log)
+{
+	shared_ptr<ServerJob> job;
+	{
+		lock_guard<mutex> lock(m_mutex);
+		job = make_shared<ServerJob>(m_nextJob ++, fd);
+	}
+	if(!Admit(job))
+	{
+		IncrementMetric("gp4par_jobs_rejected_total");
+		SocketSendLine(fd, "busy\n");
+		return false;
+	}
+	SocketSendLine(fd, "job %u\n", job->id);
+	options.par.cancel = &job->cancel;
+	auto start = chrono::steady_clock::now();
+
+	//Run the job, with its log going to a buffer we can send back
+	bool ok = false;
+	bool started = WaitForThread(job);
+	ObserveMetric("gp4par_queue_wait_seconds", chrono::duration<double>(chrono::steady_clock::now() - start).count());
+	if(started)
+	{
+		char* buf = NULL;
+		size_t buflen = 0;
+		FILE* fp = open_memstream(&buf, &buflen);
+		if(fp)
+		{
+			//The sink closes the stream when it's done, which finalizes the buffer
+			{
+				FILELogSink sink(fp, false, Severity::VERBOSE);
+				JobLogSink::m_jobSink = &sink;
+				if(!netlist.empty())
+					ok = CompileJSON(&netlist[0], netlist.size(), options, result);
+				else
+					ok = CompileFile(options, result);
+				JobLogSink::m_jobSink = NULL;
+			}
+			log.assign(buf, buflen);
+			free(buf);
+		}
+	}
+	bool cancelled = job->cancel && !ok;
+	Finish(job);
+
+	double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+	if(cancelled)
+		LogNotice("[job %u] %s cancelled (%.2f s)\n", job->id, name.c_str(), seconds);
+	else if(ok)
+		LogNotice("[job %u] %s ok (%.2f s)\n", job->id, name.c_str(), seconds);
+	else
+		LogNotice("[job %u] %s failed (%.2f s)\n", job->id, name.c_str(), seconds);
+
+	status = cancelled ? "cancelled" : (ok ? "ok" : "failed");
+	RecordJobMetrics(options, result, status, seconds);
+	return true;
+}
+
+/**
+	@brief Handles "cancel <job>"
+ */
+void CompileServer::HandleCancel(int fd, const string& request)
+{
+	vector<string> args = SplitJobLine(request);
+	unsigned int id = (args.size() == 2) ? strtoul(args[1].c_str(), NULL, 10) : 0;
+
+	shared_ptr<ServerJob> job;
+	{
+		lock_guard<mutex> lock(m_mutex);
+		auto it = m_jobs.find(id);
+		if(it != m_jobs.end())
+			job = it->second;
+	}
+
+	if(job)
+	{
+		Cancel(job);
+		SocketSendLine(fd, "ok\n");
+	}
+	else
+		SocketSendLine(fd, "error no such job\n");
+}
+
+/**
+	@brief Handles "status"
+ */
+void CompileServer::HandleStatus(int fd)
+{
+	unsigned int running;
+	unsigned int queued;
+	unsigned int completed;
+	{
+		lock_guard<mutex> lock(m_mutex);
+		running = m_running;
+		queued = m_jobs.size() - m_running;
+		completed = m_completed;
+	}
+	SocketSendLine(fd, "status %u %u %u\n", running, queued, completed);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Scheduling
+
+/**
+	@brief Admits a job, unless there are already as many waiting as we're allowed to queue
+
+	@return True if the job was admitted
+ */
+bool CompileServer::Admit(shared_ptr<ServerJob> job)
+{
+	lock_guard<mutex> lock(m_mutex);
+	if(m_jobs.size() >= m_threads + m_queueDepth)
+		return false;
+
+	m_jobs[job->id] = job;
+	UpdateQueueMetrics();
+	return true;
+}
+
+/**
+	@brief Waits until there's a free thread for an admitted job
+
+	@return False if the job was cancelled while it was waiting
+ */
+bool CompileServer::WaitForThread(shared_ptr<ServerJob> job)
+{
+	unique_lock<mutex> lock(m_mutex);
+	while( (m_running >= m_threads) && !job->cancel )
+		m_changed.wait(lock);
+
+	if(job->cancel)
+		return false;
+
+	m_running ++;
+	job->running = true;
+	UpdateQueueMetrics();
+	return true;
+}
+
+/**
+	@brief Retires a job, and frees up its thread if it had one
+ */
+void CompileServer::Finish(shared_ptr<ServerJob> job)
+{
+	lock_guard<mutex> lock(m_mutex);
+	m_jobs.erase(job->id);
+	if(job->running)
+		m_running --;
+	m_completed ++;
+	UpdateQueueMetrics();
+	m_changed.notify_all();
+}
+
+/**
+	@brief Tells a job to stop, whether it's compiling or still waiting for a thread
+ */
+void CompileServer::Cancel(shared_ptr<ServerJob> job)
+{
+	lock_guard<mutex> lock(m_mutex);
+	job->cancel = true;
+	m_changed.notify_all();
+}
+
+/**
+	@brief Updates the queue gauges (m_mutex has to be held)
+ */
+void CompileServer::UpdateQueueMetrics()
+{
+	SetMetric("gp4par_jobs_running", m_running);
+	SetMetric("gp4par_jobs_queued", m_jobs.size() - m_running);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Metrics
+
+/**
+	@brief Describes everything the server counts, so it all shows up on the metrics endpoint even before the first job
+ */
+void CompileServer::DescribeMetrics()
+{
+	DescribeMetric("gp4par_jobs_running", MetricType::GAUGE, "Jobs compiling right now");
+	DescribeMetric("gp4par_jobs_queued", MetricType::GAUGE, "Jobs admitted but waiting for a thread");
+	DescribeMetric("gp4par_jobs_total", MetricType::COUNTER, "Jobs finished, by how they ended");
+	DescribeMetric("gp4par_jobs_rejected_total", MetricType::COUNTER, "Jobs turned away because the queue was full");
+	DescribeMetric("gp4par_queue_wait_seconds", MetricType::HISTOGRAM, "Time jobs waited for a thread",
+		{0.01, 0.1, 0.5, 1, 5, 10, 30, 60, 300});
+	DescribeMetric("gp4par_job_seconds", MetricType::HISTOGRAM, "Time from admitting a job to finishing it",
+		{0.1, 0.25, 0.5, 1, 2.5, 5, 10, 30, 60, 120, 300});
+	DescribeMetric("gp4par_phase_seconds_total", MetricType::COUNTER, "Time spent in each phase of a compile");
+	DescribeMetric("gp4par_par_iterations", MetricType::HISTOGRAM, "Annealing iterations per job, over all seeds",
+		{10, 100, 1000, 10000, 100000, 1000000});
+	DescribeMetric("gp4par_par_moves_total", MetricType::COUNTER, "Annealing moves, by whether they were kept");
+	DescribeMetric("gp4par_par_cost_evaluations_total", MetricType::COUNTER, "Trial move costs measured");
+	DescribeMetric("gp4par_result_cache_total", MetricType::COUNTER, "Jobs with --result-cache, by hit or miss");
+
+	//Make the job outcomes show up as zero, rather than missing, until they happen
+	const char* statuses[] = { "ok", "failed", "cancelled" };
+	for(auto status : statuses)
+		IncrementMetric(MetricName("gp4par_jobs_total", "status", status), 0);
+	IncrementMetric("gp4par_jobs_rejected_total", 0);
+	SetMetric("gp4par_jobs_running", 0);
+	SetMetric("gp4par_jobs_queued", 0);
+}
+
+/**
+	@brief Feeds what a finished job did (the same counters as --stats-file) into the metrics
+ */
+void CompileServer::RecordJobMetrics(
+	const CompileOptions& options,
+	const CompileResult& result,
+	const string& status,
+	double seconds)
+{
+	IncrementMetric(MetricName("gp4par_jobs_total", "status", status));
+	ObserveMetric("gp4par_job_seconds", seconds);
+
+	for(auto& phase : result.stats.phases)
+		IncrementMetric(MetricName("gp4par_phase_seconds_total", "phase", phase.first), phase.second);
+
+	//A cached result didn't run PAR, so it doesn't count towards the iterations
+	auto& par = result.stats.par;
+	if(!result.cached && !par.anneals.empty())
+	{
+		uint64_t iterations = 0;
+		for(auto& run : par.anneals)
+			iterations += run.iterations;
+		ObserveMetric("gp4par_par_iterations", iterations);
+	}
+	IncrementMetric(MetricName("gp4par_par_moves_total", "result", "accepted"), par.movesAccepted);
+	IncrementMetric(MetricName("gp4par_par_moves_total", "result", "rejected"), par.GetMovesRejected());
+	IncrementMetric("gp4par_par_cost_evaluations_total", par.costEvaluations);
+
+	if(options.resultCache != "")
+		IncrementMetric(MetricName("gp4par_result_cache_total", "result", result.cached ? "hit" : "miss"));
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Entry point
+
+/**
+	@brief Runs a compile server on the Unix socket at path, until we get SIGINT or SIGTERM.
+
+	Options on the command line are the defaults for every job, and up to --jobs jobs compile at once. Up to
+	queue_depth more can wait for a thread; anything past that is turned away, so a busy server answers right away
+	rather than building up a backlog. The protocol is described in the manual.
+
+	If metrics_address isn't empty, the server's counters are served over HTTP there too (see StartMetricsServer()).
+
+	@return True on a clean shutdown
+ */
+bool RunServer(
+	const string& path,
+	const CompileOptions& defaults,
+	unsigned int queue_depth,
+	const string& metrics_address,
+	Severity console_verbosity)
+{
+	JobLogSink* sink = new JobLogSink(new STDLogSink(console_verbosity));
+	g_log_sinks.emplace(g_log_sinks.begin(), sink);
+
+	CompileServer server(defaults, queue_depth);
+	return server.Run(path, metrics_address);
+}
@@ -0,0 +1,85 @@
+/***********************************************************************************************************************
+ * Copyright (C) 2016 Andrew Zonenberg and contributors                                                                *
+ *                                                                                                                     *
+ * This program is free software; you can redistribute it and/or modify it under the terms of the GNU Lesser General   *
+ * Public License as published by the Free Software Foundation; either version 2.1 of the License, or (at your option) *
+ * any later version.                                                                                                  *
+ *                                                                                                                     *
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied  *
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for     *
+ * more details.                                                                                                       *
+ *                                                                                                                     *
+ * You should have received a copy of the GNU Lesser General Public License along with this program; if not, you may   *
+ * find one here:                                                                                                      *
+ * https://www.gnu.org/licenses/old-licenses/lgpl-2.1.txt                                                              *
+ * or you may search the http://www.gnu.org website for the version 2.1 license, or you may write to the Free Software *
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA                                      *
+ **********************************************************************************************************************/
+
+#ifndef gp4prog_h
+#define gp4prog_h
+
+#include <string>
+#include <vector>
+#include <log.h>
+#include <debuglog.h>
+#include <trace.h>
+#include <gpdevboard.h>
+#include <Greenpak4BitstreamLayout.h>
+
+/**
+	@brief Everything the command line asked us to do to each board
+ */
+class ProgramOptions
+{
+public:
+	ProgramOptions()
+		: reset(false)
+		, test(false)
+		, rcOscFreq(0)
+		, fastTrim(false)
+		, programNvram(false)
+		, force(false)
+		, patternId(0)
+		, readProtect(false)
+		, voltage(0)
+		, voltage2(0)
+		, hexdump(false)
+		, blink(false)
+		, idle(false)
+	{}
+
+	bool reset;
+	bool test;
+	unsigned rcOscFreq;
+	bool fastTrim;
+	std::string downloadFilename;
+	std::string uploadFilename;
+	bool programNvram;
+	bool force;
+	uint8_t patternId;
+	bool readProtect;
+	double voltage;
+	double voltage2;
+	std::vector<int> nets;
+	bool hexdump;
+	bool blink;
+
+	//Set when nothing but part detection was asked for
+	bool idle;
+};
+
+bool ProgramBoard(hdevice hdev, const ProgramOptions& opts);
+bool VerifyBitstream(hdevice hdev, SilegoPart part, const std::vector<uint8_t>& expected, bool& matched);
+bool UnstickPins(hdevice hdev);
+
+bool RunProduction(hdevice hdev, const ProgramOptions& opts, const std::string& csvFile);
+bool RunWatch(hdevice hdev, const ProgramOptions& opts);
+
+bool DecodeUSBTrace(const std::string& fname);
+
+const char *BitFunction(SilegoPart part, size_t bitno);
+
+void WriteBitstream(const std::string& fname, const std::vector<uint8_t>& bitstream);
+
+#endif
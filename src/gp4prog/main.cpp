@@ -18,19 +18,51 @@
 
 #include <cstring>
 #include <cmath>
+#include <chrono>
+#include <memory>
+#include <thread>
 #include <unistd.h>
-#include <log.h>
-#include <gpdevboard.h>
 #include <termios.h>
+#include "gp4prog.h"
 
 using namespace std;
 
+/**
+	@brief Sends log messages from each board's worker thread to that board's log, and everything else to the console
+
+	Sinks are global, so this is the only way to keep boards running on different threads out of each other's logs.
+ */
+class BoardLogSink : public LogSink
+{
+public:
+	BoardLogSink(LogSink* console)
+		: m_console(console)
+	{}
+
+	virtual void Log(Severity severity, const string& msg)
+	{ GetTarget()->Log(severity, msg); }
+
+	virtual void Log(Severity severity, const char* format, va_list va)
+	{ GetTarget()->Log(severity, format, va); }
+
+	//Sink for the board being driven by this thread (NULL if none)
+	static thread_local LogSink* m_boardSink;
+
+protected:
+	LogSink* GetTarget()
+	{ return (m_boardSink != NULL) ? m_boardSink : m_console.get(); }
+
+	unique_ptr<LogSink> m_console;
+};
+
+thread_local LogSink* BoardLogSink::m_boardSink = NULL;
+
 void ShowUsage();
 void ShowVersion();
 
-const char *BitFunction(SilegoPart part, size_t bitno);
-
-void WriteBitstream(string fname, vector<uint8_t> bitstream);
+int ProgramBoards(const ProgramOptions& opts, const vector<int>& boards, const string& logDir,
+	Severity log_verbosity, bool lock);
+void HoldLock(const vector<hdevice>& hdevs);
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 // Entry point
@@ -39,21 +71,17 @@ int main(int argc, char* argv[])
 {
 	Severity console_verbosity = Severity::NOTICE;
 
-	bool reset = false;
-	bool test = false;
-	unsigned rcOscFreq = 0;
-	string downloadFilename, uploadFilename;
-	bool programNvram = false;
-	bool force = false;
-	uint8_t patternId = 0;
-	bool readProtect = false;
-	double voltage = 0.0;
-	double voltage2 = 0.0;
-	vector<int> nets;
-	bool hexdump = false;
-	bool blink = false;
-	int nboard = 0;
+	ProgramOptions opts;
+	vector<int> boards;
+	bool allBoards = false;
+	bool multipleBoards = false;
+	string logDir = ".";
+	string productionFile;
+	bool watch = false;
 	bool lock = false;
+	string traceFilename;
+	string usbTraceFilename;
+	string decodeFilename;
 
 	//Parse command-line arguments
 	for(int i=1; i<argc; i++)
@@ -76,13 +104,43 @@ int main(int argc, char* argv[])
 		}
 		else if(s == "-r" || s == "--reset")
 		{
-			reset = true;
+			opts.reset = true;
+		}
+		else if(s == "--trace")
+		{
+			if(i+1 < argc)
+				traceFilename = argv[++i];
+			else
+			{
+				printf("--trace requires an argument\n");
+				return 1;
+			}
+		}
+		else if(s == "--usb-trace")
+		{
+			if(i+1 < argc)
+				usbTraceFilename = argv[++i];
+			else
+			{
+				printf("--usb-trace requires an argument\n");
+				return 1;
+			}
+		}
+		else if(s == "--decode-usb-trace")
+		{
+			if(i+1 < argc)
+				decodeFilename = argv[++i];
+			else
+			{
+				printf("--decode-usb-trace requires an argument\n");
+				return 1;
+			}
 		}
 		else if(s == "-R" || s == "--read")
 		{
 			if(i+1 < argc)
 			{
-				uploadFilename = argv[++i];
+				opts.uploadFilename = argv[++i];
 			}
 			else
 			{
@@ -91,16 +149,16 @@ int main(int argc, char* argv[])
 			}
 		}
 		else if(s == "-t" || s == "--test-socket")
-			test = true;
+			opts.test = true;
 		else if(s == "-T" || s == "--trim")
 		{
 			if(i+1 < argc)
 			{
 				const char *value = argv[++i];
 				if(!strcmp(value, "25k"))
-					rcOscFreq = 25000;
+					opts.rcOscFreq = 25000;
 				else if(!strcmp(value, "2M"))
-					rcOscFreq = 2000000;
+					opts.rcOscFreq = 2000000;
 				else
 				{
 					printf("--trim argument must be 25k or 2M\n");
@@ -113,16 +171,18 @@ int main(int argc, char* argv[])
 				return 1;
 			}
 		}
+		else if(s == "--fast-trim")
+			opts.fastTrim = true;
 		else if(s == "-e" || s == "--emulate")
 		{
-			if(!downloadFilename.empty())
+			if(!opts.downloadFilename.empty())
 			{
 				printf("only one --emulate or --program option can be specified\n");
 				return 1;
 			}
 			if(i+1 < argc)
 			{
-				downloadFilename = argv[++i];
+				opts.downloadFilename = argv[++i];
 			}
 			else
 			{
@@ -132,15 +192,15 @@ int main(int argc, char* argv[])
 		}
 		else if(s == "--program")
 		{
-			if(!downloadFilename.empty())
+			if(!opts.downloadFilename.empty())
 			{
 				printf("only one --emulate or --program option can be specified\n");
 				return 1;
 			}
 			if(i+1 < argc)
 			{
-				downloadFilename = argv[++i];
-				programNvram = true;
+				opts.downloadFilename = argv[++i];
+				opts.programNvram = true;
 			}
 			else
 			{
@@ -148,25 +208,79 @@ int main(int argc, char* argv[])
 				return 1;
 			}
 		}
+		else if(s == "--watch")
+		{
+			if(!opts.downloadFilename.empty())
+			{
+				printf("only one --emulate, --program or --watch option can be specified\n");
+				return 1;
+			}
+			if(i+1 < argc)
+			{
+				opts.downloadFilename = argv[++i];
+				watch = true;
+			}
+			else
+			{
+				printf("--watch requires an argument\n");
+				return 1;
+			}
+		}
+		else if(s == "--production")
+		{
+			if(i+1 < argc)
+				productionFile = argv[++i];
+			else
+			{
+				printf("--production requires an argument\n");
+				return 1;
+			}
+		}
 		else if(s == "--force")
-			force = true;
+			opts.force = true;
 		else if( (s == "-l") || (s == "--lock") )
 			lock = true;
 		else if(s == "--hexdump")
-			hexdump = true;
+			opts.hexdump = true;
 		else if((s == "-b") || (s == "--blink") )
-			blink = true;
-		else if((s == "--device") || (s == "--device") )
+			opts.blink = true;
+		else if((s == "-d") || (s == "--device") )
 		{
 			if(i+1 < argc)
-				nboard = atoi(argv[++i]);
-
+			{
+				char *arg = argv[++i];
+				boards.clear();
+				allBoards = !strcmp(arg, "all");
+				multipleBoards = allBoards || (strchr(arg, ',') != NULL);
+				while(!allBoards)
+				{
+					long n = strtol(arg, &arg, 10);
+					if( (*arg && *arg != ',') || (n < 0) )
+					{
+						printf("--device must be a board index, a comma-separated list of them, or \"all\"\n");
+						return 1;
+					}
+					boards.push_back(n);
+					if(!*arg++)
+						break;
+				}
+			}
 			else
 			{
 				printf("--device requires an argument\n");
 				return 1;
 			}
 		}
+		else if(s == "--log-dir")
+		{
+			if(i+1 < argc)
+				logDir = argv[++i];
+			else
+			{
+				printf("--log-dir requires an argument\n");
+				return 1;
+			}
+		}
 		else if(s == "--pattern-id")
 		{
 			if(i+1 < argc)
@@ -174,7 +288,7 @@ int main(int argc, char* argv[])
 				char *arg = argv[++i];
 				long id = strtol(arg, &arg, 10);
 				if(*arg == '\0' && id >= 0 && id <= 255)
-					patternId = id;
+					opts.patternId = id;
 				else
 				{
 					printf("--pattern-id argument must be a number between 0 and 255\n");
@@ -188,21 +302,21 @@ int main(int argc, char* argv[])
 			}
 		}
 		else if(s == "--read-protect")
-			readProtect = true;
+			opts.readProtect = true;
 		else if(s == "-v" || s == "--voltage")
 		{
 			if(i+1 < argc)
 			{
 				char *endptr;
-				voltage = strtod(argv[++i], &endptr);
+				opts.voltage = strtod(argv[++i], &endptr);
 				if(*endptr)
 				{
 					printf("--voltage must be a decimal value\n");
 					return 1;
 				}
-				if(!(voltage == 0.0 || (voltage >= 1.71 && voltage <= 5.5)))
+				if(!(opts.voltage == 0.0 || (opts.voltage >= 1.71 && opts.voltage <= 5.5)))
 				{
-					printf("--voltage %.3g outside of valid range\n", voltage);
+					printf("--voltage %.3g outside of valid range\n", opts.voltage);
 					return 1;
 				}
 			}
@@ -217,20 +331,21 @@ int main(int argc, char* argv[])
 			if(i+1 < argc)
 			{
 				char *endptr;
-				voltage2 = strtod(argv[++i], &endptr);
+				opts.voltage2 = strtod(argv[++i], &endptr);
 				if(*endptr)
 				{
 					printf("--voltage-2 must be a decimal value\n");
 					return 1;
 				}
-				if(!(voltage2 == 0.0 || (voltage2 >= 1.71 && voltage2 <= 5.5)))
+				if(!(opts.voltage2 == 0.0 || (opts.voltage2 >= 1.71 && opts.voltage2 <= 5.5)))
 				{
-					printf("--voltage-2 %.3g outside of valid range\n", voltage2);
+					printf("--voltage-2 %.3g outside of valid range\n", opts.voltage2);
 					return 1;
 				}
-				if(!(voltage2 == 0.0 || (voltage2 <= voltage)))
+				if(!(opts.voltage2 == 0.0 || (opts.voltage2 <= opts.voltage)))
 				{
-					printf("--voltage-2 %.3g must be less than or equal to --voltage %.3g\n", voltage2, voltage);
+					printf("--voltage-2 %.3g must be less than or equal to --voltage %.3g\n",
+						opts.voltage2, opts.voltage);
 					return 1;
 				}
 			}
@@ -258,7 +373,7 @@ int main(int argc, char* argv[])
 						printf("--nets used with an invalid net %ld\n", net);
 						return 1;
 					}
-					nets.push_back(net);
+					opts.nets.push_back(net);
 				} while(*arg++);
 			}
 			else
@@ -269,9 +384,9 @@ int main(int argc, char* argv[])
 		}
 
 		//assume it's the bitstream file if it's the first non-switch argument
-		else if( (s[0] != '-') && (downloadFilename == "") )
+		else if( (s[0] != '-') && (opts.downloadFilename == "") )
 		{
-			downloadFilename = s;
+			opts.downloadFilename = s;
 		}
 
 		else
@@ -281,34 +396,151 @@ int main(int argc, char* argv[])
 		}
 	}
 
-	//Set up logging
-	g_log_sinks.emplace(g_log_sinks.begin(), new STDLogSink(console_verbosity));
+	//Production runs program blank parts one after another on a single board
+	if(!productionFile.empty())
+	{
+		if(!opts.programNvram)
+		{
+			printf("--production requires --program\n");
+			return 1;
+		}
+		if(multipleBoards)
+		{
+			printf("--production can only be used with a single board\n");
+			return 1;
+		}
+		if( (opts.rcOscFreq != 0) && (opts.voltage == 0.0) )
+		{
+			printf("--production with --trim requires --voltage\n");
+			return 1;
+		}
+	}
+
+	//Watching keeps a single board open, running whatever the file holds
+	if(watch)
+	{
+		if(!productionFile.empty() || multipleBoards)
+		{
+			printf("--watch can't be used with --production or several boards\n");
+			return 1;
+		}
+		if(opts.voltage == 0.0)
+		{
+			printf("--watch requires --voltage; chip must be powered for emulation\n");
+			return 1;
+		}
+	}
+
+	//Set up logging (through a BoardLogSink, so each board driven with --device all gets a log of its own)
+	g_log_sinks.emplace(g_log_sinks.begin(), new BoardLogSink(new STDLogSink(console_verbosity)));
+	SetDebugLogging(console_verbosity >= Severity::DEBUG);
+
+	//Record where the time goes, if asked to (the trace is written when we exit)
+	if(!traceFilename.empty() && !StartTracing(traceFilename))
+		return 1;
+
+	//Decoding a USB trace doesn't need a board
+	if(!decodeFilename.empty())
+		return DecodeUSBTrace(decodeFilename) ? 0 : 1;
+
+	//Keep the most recent USB frames, if asked to (written when a transfer fails, and when we exit)
+	if(!usbTraceFilename.empty() && !StartUSBTrace(usbTraceFilename))
+		return 1;
 
 	//Print header
 	if(console_verbosity >= Severity::NOTICE)
 		ShowVersion();
 
+	//With no bitstream and no reset flag, we only detect the part, without changing board configuration
+	opts.idle = opts.downloadFilename.empty() && opts.uploadFilename.empty() && opts.voltage == 0.0 &&
+		opts.nets.empty() && opts.rcOscFreq == 0 && !opts.test && !opts.reset;
+
+	//Several boards get a worker thread each
+	if(multipleBoards)
+	{
+		if(allBoards)
+		{
+			int count = CountBoards();
+			if(count < 0)
+				return 1;
+			for(int i=0; i<count; i++)
+				boards.push_back(i);
+		}
+
+		//The board logs get everything the console would, and at least the verbose messages
+		Severity log_verbosity = (console_verbosity >= Severity::VERBOSE) ? console_verbosity : Severity::VERBOSE;
+		return ProgramBoards(opts, boards, logDir, log_verbosity, lock);
+	}
+
 	//Open the dev board
-	hdevice hdev = OpenBoard(nboard);
+	int nboard = boards.empty() ? 0 : boards[0];
+	hdevice hdev;
+	{
+		TraceSpan span("Open board");
+		hdev = OpenBoard(nboard);
+	}
 	if(!hdev)
 		return 1;
 
+	if(!productionFile.empty())
+	{
+		bool ok = RunProduction(hdev, opts, productionFile);
+		SetStatusLED(hdev, 0);
+		USBCleanup(hdev);
+		return ok ? 0 : 1;
+	}
+
+	if(watch)
+	{
+		bool ok = RunWatch(hdev, opts);
+		SetStatusLED(hdev, 0);
+		USBCleanup(hdev);
+		return ok ? 0 : 1;
+	}
+
+	if(!ProgramBoard(hdev, opts))
+		return 1;
+	if(opts.idle)
+		return 0;
+
+	//Hold the lock until something happens
+	if(lock)
+		HoldLock(vector<hdevice>(1, hdev));
+
+	//Done
+	LogNotice("Done\n");
+	SetStatusLED(hdev, 0);
+	USBCleanup(hdev);
+
+	return 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Board actions
+
+/**
+	@brief Does everything that was asked for on the command line to one board, in the order ShowUsage() lists it
+
+	@return True if everything worked. The status LED is left on, for the caller to turn off when it's done.
+ */
+bool ProgramBoard(hdevice hdev, const ProgramOptions& opts)
+{
 	//Light up the status LED
 	if(!SetStatusLED(hdev, 1))
-		return 1;
+		return false;
 
 	//If we're blinking, run 5 seconds of blinking at 2 Hz
-	if(blink)
+	if(opts.blink)
 	{
 		for(int i=0; i<5; i++)
 		{
 			usleep(500 * 1000);
 			if(!SetStatusLED(hdev, 0))
-				return 1;
+				return false;
 
 			usleep(500 * 1000);
 			if(!SetStatusLED(hdev, 1))
-				return 1;
+				return false;
 		}
 	}
 
@@ -316,66 +548,67 @@ int main(int argc, char* argv[])
 	SilegoPart detectedPart = SilegoPart::UNRECOGNIZED;
 	vector<uint8_t> programmedBitstream;
 	BitstreamKind bitstreamKind;
-	if(!DetectPart(hdev, detectedPart, programmedBitstream, bitstreamKind))
+	bool detected;
+	{
+		TraceSpan span("Detect part");
+		detected = DetectPart(hdev, detectedPart, programmedBitstream, bitstreamKind);
+	}
+	if(!detected)
 	{
 		SetStatusLED(hdev, 0);
-		return 1;
+		return false;
 	}
 
 	//If we're run with no bitstream and no reset flag, stop now without changing board configuration
-	if(downloadFilename.empty() && uploadFilename.empty() && voltage == 0.0 && nets.empty() &&
-	   rcOscFreq == 0 && !test && !reset)
+	if(opts.idle)
 	{
 		LogNotice("No actions requested, exiting (use --help for help)\n");
 		SetStatusLED(hdev, 0);
-		return 0;
+		return true;
 	}
 
 	//It makes no sense to emulate without applying any Vdd
-	if(voltage == 0.0 && !downloadFilename.empty() && !programNvram)
+	if(opts.voltage == 0.0 && !opts.downloadFilename.empty() && !opts.programNvram)
 	{
 		LogError("--emulate is specified but --voltage isn't; chip must be powered for emulation\n");
-		return 1;
+		return false;
 	}
 
 	//It makes no sense to apply vccio to a single-rail part
-	if(voltage2 != 0.0 && detectedPart != SilegoPart::SLG46621V)
+	if(opts.voltage2 != 0.0 && detectedPart != SilegoPart::SLG46621V)
 	{
 		LogError("Part %s is detected, but --voltage-2 can only be used with dual-supply parts (SLG46621V)\n",
 		         PartName(detectedPart));
 		SetStatusLED(hdev, 0);
-		return 1;
+		return false;
 	}
 
-	if(programNvram && bitstreamKind != BitstreamKind::EMPTY)
+	//A non-empty part is only programmed again with --force. Without it, we go on as long as the part already holds
+	//the bitstream (which we can only tell once we've read it), and then leave the part alone.
+	if(opts.programNvram && bitstreamKind != BitstreamKind::EMPTY)
 	{
-		if(!force)
-		{
-			LogError("Non-empty part detected; refusing to program without --force\n");
-			SetStatusLED(hdev, 0);
-			return 1;
-		}
+		if(!opts.force)
+			LogNotice("Non-empty part detected; it will only be used if it already holds the bitstream\n");
 		else
-		{
 			LogNotice("Non-empty part detected and --force is specified; proceeding\n");
-		}
 	}
 
 	//We already have the programmed bitstream, so simply write it to a file
-	if(!uploadFilename.empty())
+	if(!opts.uploadFilename.empty())
 	{
-		LogNotice("Writing programmed bitstream to %s\n", uploadFilename.c_str());
-		WriteBitstream(uploadFilename, programmedBitstream);
+		LogNotice("Writing programmed bitstream to %s\n", opts.uploadFilename.c_str());
+		WriteBitstream(opts.uploadFilename, programmedBitstream);
 	}
 
 	//Do a socket test before doing anything else, to catch failures early
-	if(test)
+	if(opts.test)
 	{
+		TraceSpan span("Socket test");
 		if(!SocketTest(hdev, detectedPart))
 		{
 			LogError("Socket test has failed\n");
 			SetStatusLED(hdev, 0);
-			return 1;
+			return false;
 		}
 		else
 		{
@@ -384,46 +617,51 @@ int main(int argc, char* argv[])
 	}
 
 	//If we're resetting, do that
-	if(reset)
+	if(opts.reset)
 	{
 		LogNotice("Resetting board I/O and signal generators\n");
+		TraceSpan span("Reset");
 		if(!Reset(hdev))
-			return 1;
+			return false;
 	}
 
 	//If we need to trim oscillator, do that before programming
 	uint8_t rcFtw = 0;
-	if(rcOscFreq != 0)
+	if(opts.rcOscFreq != 0)
 	{
-		if(voltage == 0.0)
+		if(opts.voltage == 0.0)
 		{
 			LogError("Trimming oscillator requires specifying target voltage\n");
-			return 1;
+			return false;
 		}
 
-		LogNotice("Trimming oscillator for %d Hz at %.3g V\n", rcOscFreq, voltage);
+		LogNotice("Trimming oscillator for %d Hz at %.3g V\n", opts.rcOscFreq, opts.voltage);
 		LogIndenter li;
-		if(!TrimOscillator(hdev, detectedPart, voltage, rcOscFreq, rcFtw))
-			return 1;
+		TraceSpan span("Trim oscillator");
+		OscillatorCalibration calibration;
+		if(!TrimOscillator(hdev, detectedPart, opts.voltage, opts.rcOscFreq, rcFtw,
+			opts.fastTrim ? &calibration : NULL))
+			return false;
 	}
 
 	//If we're programming, do that first
-	if(!downloadFilename.empty())
+	bool verified = true;
+	if(!opts.downloadFilename.empty())
 	{
 		//Read the bitstream and check that it's the right size
 		vector<uint8_t> newBitstream;
-		if(!ReadBitstream(downloadFilename, newBitstream, detectedPart))
+		if(!ReadBitstream(opts.downloadFilename, newBitstream, detectedPart))
 		{
 			SetStatusLED(hdev, 0);
-			return 1;
+			return false;
 		}
 
 		//Tweak the bitstream to apply all of the changes specified on the command line
-		if(!TweakBitstream(newBitstream, detectedPart, rcFtw, patternId, readProtect))
-			return 1;
+		if(!TweakBitstream(newBitstream, detectedPart, rcFtw, opts.patternId, opts.readProtect))
+			return false;
 
 		//Dump to the console if requested
-		if(hexdump)
+		if(opts.hexdump)
 		{
 			LogNotice("Dumping bitstream as hex\n");
 			LogIndenter li;
@@ -435,132 +673,333 @@ int main(int argc, char* argv[])
 			}
 		}
 
-		if(!programNvram)
+		if(!opts.programNvram)
 		{
 			//Load bitstream into SRAM
 			LogNotice("Downloading bitstream into SRAM\n");
 			LogIndenter li;
+			TraceSpan span("Download bitstream");
 			if(!DownloadBitstream(hdev, newBitstream, DownloadMode::EMULATION))
-				return 1;
+				return false;
+		}
+		else if(!opts.force && (bitstreamKind != BitstreamKind::EMPTY))
+		{
+			//NVM writes are slow and can only be done once, so don't bother if the part is already right
+			if(!HoldsBitstream(detectedPart, programmedBitstream, newBitstream))
+			{
+				LogError("Part holds a different bitstream; refusing to program without --force\n");
+				SetStatusLED(hdev, 0);
+				return false;
+			}
+			LogNotice("Part already holds this bitstream, not programming it again\n");
 		}
 		else
 		{
 			//Program bitstream into NVM
 			LogNotice("Programming bitstream into NVM\n");
 			LogIndenter li;
-			if(!DownloadBitstream(hdev, newBitstream, DownloadMode::PROGRAMMING))
-				return 1;
-
-			//TODO: Figure out how to make this play nicely with read protection?
-			LogNotice("Verifying programmed bitstream\n");
-			size_t bitstreamLength = BitstreamLength(detectedPart) / 8;
-			vector<uint8_t> bitstreamToVerify;
-			if(!UploadBitstream(hdev, bitstreamLength, bitstreamToVerify))
-				return 1;
-			bool failed = false;
-			for(size_t i = 0; i < bitstreamLength * 8; i++)
 			{
-				bool expectedBit = ((newBitstream     [i/8] >> (i%8)) & 1) == 1;
-				bool actualBit   = ((bitstreamToVerify[i/8] >> (i%8)) & 1) == 1;
-				if(expectedBit != actualBit)
-				{
-					LogNotice("Bit %4zd differs: expected %d, actual %d",
-					          i, (int)expectedBit, (int)actualBit);
-					failed = true;
-
-					//Explain what undocumented bits do; most of these are also trimming values, and so
-					//it is normal for them to vary even if flashing the exact same bitstream many times.
-					const char *bitFunction = BitFunction(detectedPart, i);
-					if(bitFunction)
-						LogNotice(" (bit meaning: %s)\n", bitFunction);
-					else
-						LogNotice("\n");
-				}
+				TraceSpan span("Program bitstream");
+				if(!DownloadBitstream(hdev, newBitstream, DownloadMode::PROGRAMMING))
+					return false;
 			}
 
-			if(failed)
-				LogError("Verification failed\n");
-			else
-				LogNotice("Verification passed\n");
+			//TODO: Figure out how to make this play nicely with read protection?
+			LogNotice("Verifying programmed bitstream\n");
+			TraceSpan span("Verify bitstream");
+			if(!VerifyBitstream(hdev, detectedPart, newBitstream, verified))
+				return false;
 		}
 
-		//Developer board I/O pins become stuck after both SRAM and NVM programming;
-		//resetting them explicitly makes LEDs and outputs work again.
-		LogDebug("Unstucking I/O pins after programming\n");
-		IOConfig ioConfig;
-		for(size_t i = 2; i <= 20; i++)
-			ioConfig.driverConfigs[i] = TP_RESET;
-		if(!SetIOConfig(hdev, ioConfig))
-			return 1;
+		if(!UnstickPins(hdev))
+			return false;
 	}
 
 	//Reset all signal generators we may have used during setup
 	if(!ResetAllSiggens(hdev))
-		return 1;
+		return false;
 
-	if(voltage != 0.0)
+	if(opts.voltage != 0.0)
 	{
 		//Configure the signal generator for Vdd
-		LogNotice("Setting Vdd to %.3g V\n", voltage);
-		if(!ConfigureSiggen(hdev, 1, voltage))
-			return 1;
+		LogNotice("Setting Vdd to %.3g V\n", opts.voltage);
+		if(!ConfigureSiggen(hdev, 1, opts.voltage))
+			return false;
 	}
 
-	if(voltage2 != 0.0)
+	if(opts.voltage2 != 0.0)
 	{
 		//Configure the signal generator for Vdd2
-		LogNotice("Setting Vdd2 to %.3g V\n", voltage2);
-		if(!ConfigureSiggen(hdev, 14, voltage2))
-			return 1;
+		LogNotice("Setting Vdd2 to %.3g V\n", opts.voltage2);
+		if(!ConfigureSiggen(hdev, 14, opts.voltage2))
+			return false;
 	}
 
-	if(!nets.empty())
+	if(!opts.nets.empty())
 	{
 		//Set the I/O configuration on the test points
 		LogNotice("Setting I/O configuration\n");
 
 		IOConfig config;
-		for(int net : nets)
+		for(int net : opts.nets)
 		{
 			config.driverConfigs[net] = TP_FLOAT;
 			config.ledEnabled[net] = true;
 			config.expansionEnabled[net] = true;
 		}
+		TraceSpan span("Configure I/O");
 		if(!SetIOConfig(hdev, config))
-			return 1;
+			return false;
 	}
 
 	//Check that we didn't break anything
-	if(!CheckStatus(hdev))
+	bool status_ok;
+	{
+		TraceSpan span("Check status");
+		status_ok = CheckStatus(hdev);
+	}
+	if(!status_ok)
 	{
 		LogError("Fault condition detected during final check, exiting\n");
 		SetStatusLED(hdev, 0);
+		return false;
+	}
+
+	//A board that didn't verify is still left in a usable state, but it hasn't passed
+	return verified;
+}
+
+/**
+	@brief Reads back the bitstream programmed into NVM and compares it to the one we meant to program
+
+	@param hdev			Board to read from
+	@param part			Part in the socket
+	@param expected		Bitstream that should be there
+	@param matched		Set false if any bit differs (left alone otherwise)
+
+	@return False if the bitstream couldn't be read back at all
+ */
+bool VerifyBitstream(hdevice hdev, SilegoPart part, const vector<uint8_t>& expected, bool& matched)
+{
+	size_t bitstreamLength = BitstreamLength(part) / 8;
+	vector<uint8_t> bitstreamToVerify;
+	if(!UploadBitstream(hdev, bitstreamLength, bitstreamToVerify))
+		return false;
+
+	//Usually everything matches, and there's nothing to explain
+	if(bitstreamToVerify == expected)
+	{
+		LogNotice("Verification passed\n");
+		return true;
+	}
+
+	//Otherwise, say which bits differ
+	bool failed = false;
+	for(size_t i = 0; i < bitstreamLength * 8; i++)
+	{
+		bool expectedBit = ((expected         [i/8] >> (i%8)) & 1) == 1;
+		bool actualBit   = ((bitstreamToVerify[i/8] >> (i%8)) & 1) == 1;
+		if(expectedBit != actualBit)
+		{
+			LogNotice("Bit %4zd differs: expected %d, actual %d",
+			          i, (int)expectedBit, (int)actualBit);
+			failed = true;
+
+			//Explain what undocumented bits do; most of these are also trimming values, and so
+			//it is normal for them to vary even if flashing the exact same bitstream many times.
+			const char *bitFunction = BitFunction(part, i);
+			if(bitFunction)
+				LogNotice(" (bit meaning: %s)\n", bitFunction);
+			else
+				LogNotice("\n");
+		}
+	}
+
+	if(failed)
+	{
+		LogError("Verification failed\n");
+		matched = false;
+	}
+	else
+		LogNotice("Verification passed\n");
+	return true;
+}
+
+/**
+	@brief Puts the I/O pins back to normal after programming
+
+	Developer board I/O pins become stuck after both SRAM and NVM programming;
+	resetting them explicitly makes LEDs and outputs work again.
+ */
+bool UnstickPins(hdevice hdev)
+{
+	LogDebug("Unstucking I/O pins after programming\n");
+	IOConfig ioConfig;
+	for(size_t i = 2; i <= 20; i++)
+		ioConfig.driverConfigs[i] = TP_RESET;
+	return SetIOConfig(hdev, ioConfig);
+}
+
+/**
+	@brief Runs ProgramBoard() on several boards at once, one thread per board, and sums up how each one went
+
+	Every board gets its own log file, so the console only shows which boards passed.
+
+	@param opts				What to do to each board
+	@param boards			Indices of the boards to open
+	@param logDir			Directory to write the board logs to
+	@param log_verbosity	Least important messages that go in the board logs
+	@param lock				Set to hold every board once they're all done, as --lock does for one
+
+	@return Exit code for the process (zero if every board passed)
+ */
+int ProgramBoards(const ProgramOptions& opts, const vector<int>& boards, const string& logDir,
+	Severity log_verbosity, bool lock)
+{
+	if(boards.empty())
+	{
+		LogError("No developer boards found\n");
 		return 1;
 	}
 
-	//Hold the lock until something happens
-	if(lock)
+	struct BoardJob
 	{
-		LogNotice("Holding lock on board, press any key to exit...\n");
-		SetStatusLED(hdev, 1);
+		int index;
+		string logFile;
+		unique_ptr<LogSink> log;
+		ProgramOptions opts;
+		hdevice hdev;
+		bool ok;
+	};
+	vector<BoardJob> jobs(boards.size());
+
+	//Boards are opened one at a time, since a board in bootloader mode re-enumerates once we switch it over,
+	//which would get in the way of other threads looking for their boards
+	LogNotice("Opening %zu boards...\n", boards.size());
+	for(size_t i=0; i<boards.size(); i++)
+	{
+		auto& job = jobs[i];
+		job.index = boards[i];
+		job.logFile = logDir + "/gp4prog-board" + to_string(job.index) + ".log";
+		job.hdev = NULL;
+		job.ok = false;
 
-		struct termios oldt, newt;
-		tcgetattr ( STDIN_FILENO, &oldt );
-		newt = oldt;
-		newt.c_lflag &= ~( ICANON | ECHO );
-		tcsetattr ( STDIN_FILENO, TCSANOW, &newt );
-		getchar();
-		tcsetattr ( STDIN_FILENO, TCSANOW, &oldt );
+		//Bitstreams read back from each board go to separate files
+		job.opts = opts;
+		if(!opts.uploadFilename.empty())
+		{
+			size_t dot = opts.uploadFilename.rfind('.');
+			if( (dot == string::npos) || (opts.uploadFilename.find('/', dot) != string::npos) )
+				dot = opts.uploadFilename.length();
+			job.opts.uploadFilename = opts.uploadFilename.substr(0, dot) + "-board" + to_string(job.index) +
+				opts.uploadFilename.substr(dot);
+		}
+
+		//The sink closes the file when it's done
+		FILE* fp = fopen(job.logFile.c_str(), "w");
+		if(!fp)
+		{
+			LogError("[board %d] couldn't open log file %s\n", job.index, job.logFile.c_str());
+			continue;
+		}
+		job.log.reset(new FILELogSink(fp, false, log_verbosity));
+
+		BoardLogSink::m_boardSink = job.log.get();
+		{
+			TraceSpan span("Open board");
+			job.hdev = OpenBoard(job.index);
+		}
+		BoardLogSink::m_boardSink = NULL;
+
+		if(!job.hdev)
+			LogError("[board %d] couldn't be opened, see %s\n", job.index, job.logFile.c_str());
 	}
 
+	//Everything else happens on every board at once, since they spend nearly all of their time waiting on USB
+	LogNotice("Programming boards...\n");
+	vector<thread> threads;
+	for(auto& job : jobs)
+	{
+		if(!job.hdev)
+			continue;
+
+		threads.push_back(thread([&job]()
+		{
+			auto start = chrono::steady_clock::now();
+			BoardLogSink::m_boardSink = job.log.get();
+			job.ok = ProgramBoard(job.hdev, job.opts);
+			BoardLogSink::m_boardSink = NULL;
+			double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+			if(job.ok)
+				LogNotice("[board %d] passed (%.2f s)\n", job.index, seconds);
+			else
+				LogError("[board %d] failed, see %s\n", job.index, job.logFile.c_str());
+		}));
+	}
+	for(auto& t : threads)
+		t.join();
+
+	//Hold the lock on every board that's still ours until something happens
+	vector<hdevice> held;
+	for(auto& job : jobs)
+	{
+		if(job.ok && !opts.idle)
+			held.push_back(job.hdev);
+	}
+	if(lock && !held.empty())
+		HoldLock(held);
+
 	//Done
-	LogNotice("Done\n");
-	SetStatusLED(hdev, 0);
-	USBCleanup(hdev);
+	unsigned int failed = 0;
+	for(auto& job : jobs)
+	{
+		if(!job.ok)
+			failed ++;
+		if(!job.hdev)
+			continue;
+
+		BoardLogSink::m_boardSink = job.log.get();
+		if(job.ok && !opts.idle)
+		{
+			LogNotice("Done\n");
+			SetStatusLED(job.hdev, 0);
+		}
+		USBCleanup(job.hdev);
+		BoardLogSink::m_boardSink = NULL;
+	}
 
+	if(failed)
+	{
+		LogError("%u of %zu boards failed\n", failed, jobs.size());
+		return 1;
+	}
+
+	LogNotice("All %zu boards passed\n", jobs.size());
 	return 0;
 }
 
+/**
+	@brief Keeps the boards open (so nothing else can use them) until a key is pressed
+ */
+void HoldLock(const vector<hdevice>& hdevs)
+{
+	LogNotice("Holding lock on %s, press any key to exit...\n", (hdevs.size() == 1) ? "board" : "boards");
+	for(auto hdev : hdevs)
+		SetStatusLED(hdev, 1);
+
+	struct termios oldt, newt;
+	tcgetattr ( STDIN_FILENO, &oldt );
+	newt = oldt;
+	newt.c_lflag &= ~( ICANON | ECHO );
+	tcsetattr ( STDIN_FILENO, TCSANOW, &newt );
+	getchar();
+	tcsetattr ( STDIN_FILENO, TCSANOW, &oldt );
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Usage
+
 void ShowUsage()
 {
 	printf(//                                                                               v 80th column
@@ -575,9 +1014,35 @@ void ShowUsage()
 		"        Prints lots of internal debugging information.\n"
 		"    --force\n"
 		"        Perform actions that may be potentially inadvisable.\n"
-		"    -d, --device <board index>\n"
+		"    --production         <CSV filename>\n"
+		"        Programs the --program bitstream into one blank part after another,\n"
+		"        prompting for each part to be inserted, until q is entered. Every part\n"
+		"        is reset, socket tested (with -t), trimmed (with -T), programmed and\n"
+		"        verified, and gets the next pattern ID, starting from --pattern-id.\n"
+		"        The full socket test only runs once an hour or every 100 parts, or\n"
+		"        when the quick check run on the other parts finds a problem.\n"
+		"        Writes the result and timing of every step for each part to the\n"
+		"        specified file.\n"
+		"    -d, --device <board index>|<board index list>|all\n"
 		"        Specifies which board to connect to, if multiple units are plugged in.\n"
-		"        The first board is index 0.\n"
+		"        The first board is index 0. Given a comma-separated list of indices, or\n"
+		"        \"all\", does everything requested to all of those boards at once, writes\n"
+		"        the log of each board to gp4prog-board<index>.log and prints which ones\n"
+		"        passed. --read then writes e.g. bitstream-board<index>.txt.\n"
+		"    --log-dir            <directory>\n"
+		"        Writes the board logs of --device all to the specified directory.\n"
+		"    --trace              <trace filename>\n"
+		"        Writes a timeline of every step and USB transfer to the specified file,\n"
+		"        in Chrome trace format (open in chrome://tracing or ui.perfetto.dev).\n"
+		"    --usb-trace          <trace filename>\n"
+		"        Keeps the last 4096 USB frames to and from the boards, with timestamps\n"
+		"        and libusb status, and writes them to the specified file if a transfer\n"
+		"        fails and when gp4prog exits. Much cheaper than --debug, so it doesn't\n"
+		"        change the timing.\n"
+		"    --decode-usb-trace   <trace filename>\n"
+		"        Prints every frame in a --usb-trace file (packet type, sequence numbers,\n"
+		"        payload size and status), and how long each command took to be\n"
+		"        answered, then exits.\n"
 		"\n"
 		"    The following options are instructions for the developer board. They are\n"
 		"    executed in the order listed here, regardless of their order on command line.\n"
@@ -599,17 +1064,26 @@ void ShowUsage()
 		"        Verifies that every connection between socket and device is intact.\n"
 		"    -T, --trim           [25k|2M]\n"
 		"        Trims the RC oscillator to achieve the specified frequency.\n"
+		"    --fast-trim\n"
+		"        Predicts the trim value from a model of the oscillator rather than\n"
+		"        searching for it, which takes about half as many measurements. With\n"
+		"        --production, the model is refined with every part.\n"
 		"    --hexdump\n"
 		"         Prints a hex dump of the bitstream (after patching trim values)\n"
 		"         suitable for passing to BitstreamToHex()\n"
 		"    -e, --emulate        <bitstream filename>\n"
 		"        Downloads the specified bitstream into volatile memory.\n"
 		"        Implies --reset.\n"
+		"    --watch              <bitstream filename>\n"
+		"        Like --emulate, but keeps the board open and downloads the bitstream\n"
+		"        again every time the file changes, until interrupted with Ctrl-C.\n"
+		"        The part is only detected and trimmed once. Requires --voltage.\n"
 		"    --program            <bitstream filename>\n"
 		"        Programs the specified bitstream into non-volatile memory.\n"
 		"        THIS CAN BE DONE ONLY ONCE FOR EVERY INTEGRATED CIRCUIT.\n"
-		"        Attempts to program non-empty parts will be rejected unless --force\n"
-		"        is specified.\n"
+		"        A part that already holds the bitstream (apart from its trim) is left\n"
+		"        alone. Attempts to program other non-empty parts will be rejected\n"
+		"        unless --force is specified.\n"
 		"    -v, --voltage        <voltage>\n"
 		"        Adjusts Vdd to the specified value in volts (0V to 5.5V), ±70mV.\n"
 		"    -n, --nets           <net list>\n"
@@ -631,71 +1105,38 @@ void ShowVersion()
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 // Part database
 
+/**
+	@brief Explains what a bit does, as far as the datasheet says (see Greenpak4BitstreamLayout.h)
+ */
 const char *BitFunction(SilegoPart part, size_t bitno)
 {
-	//The conditionals in this function are structured to resemble the structure of the datasheet.
-	//This is because the datasheet accurately *groups* reserved bits according to function;
-	//they simply black out the parts that aren't meant to be public, but do not mash them together.
-
-	const char *bitFunction = NULL;
-
+	const Greenpak4BitstreamField* field = NULL;
 	switch(part)
 	{
 		case SLG46620V:
 		case SLG46621V:
-			if(bitno >= 570 && bitno <= 575)
-				bitFunction = NULL;
-			else if(bitno == 833)
-				bitFunction = "ACMP5 speed double";
-			else if(bitno == 835)
-				bitFunction = "ACMP4 speed double";
-			else if(bitno == 881)
-				bitFunction = NULL;
-			else if(bitno >= 887 && bitno <= 891)
-				bitFunction = "Vref value fine tune";
-			else if(bitno == 922)
-				bitFunction = "bandgap 1x buffer enable";
-			else if(bitno == 937)
-				bitFunction = "Vref op amp chopper frequency select";
-			else if(bitno == 938)
-				bitFunction = "bandgap op amp offset chopper enable";
-			else if(bitno == 939)
-				bitFunction = "Vref op amp offset chopper enable";
-			else if((bitno >= 1003 && bitno <= 1015) ||
-			        (bitno >= 1594 && bitno <= 1599))
-				bitFunction = NULL;
-			else if(bitno >= 1975 && bitno <= 1981)
-				bitFunction = "RC oscillator trimming value";
-			else if((bitno >= 1982 && bitno <= 1987) ||
-			        (bitno >= 1988 && bitno <= 1995) ||
-			        (bitno >= 1996 && bitno <= 2001) ||
-			        (bitno >= 2002 && bitno <= 2007) ||
-			        (bitno >= 2013 && bitno <= 2014) ||
-			        (bitno >= 2021 && bitno <= 2027) ||
-			        (bitno >= 2028 && bitno <= 2029) ||
-			        bitno == 2030)
-				bitFunction = NULL;
-			else if(bitno >= 2031 && bitno <= 2038)
-				bitFunction = "pattern ID";
-			else if(bitno == 2039)
-				bitFunction = "read protection";
-			else
-				bitFunction = "see datasheet";
+			field = Greenpak4BitstreamLayout::ForSLG4662X().GetFieldAt(bitno);
+			break;
+
+		case SLG46140V:
+			field = Greenpak4BitstreamLayout::ForSLG46140().GetFieldAt(bitno);
 			break;
 
 		default: LogFatal("Unknown part\n");
 	}
 
-	if(bitFunction == NULL)
-		bitFunction = "unknown--reserved";
-
-	return bitFunction;
+	//Anything that isn't chip-wide belongs to one of the entities the datasheet describes
+	if(field == NULL)
+		return "see datasheet";
+	if(field->description == NULL)
+		return "unknown--reserved";
+	return field->description;
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 // Bitstream input/output
 
-void WriteBitstream(string fname, vector<uint8_t> bitstream)
+void WriteBitstream(const string& fname, const vector<uint8_t>& bitstream)
 {
 	FILE* fp = fopen(fname.c_str(), "wt");
 	if(!fp)
@@ -0,0 +1,335 @@
+/***********************************************************************************************************************
+ * Copyright (C) 2016 Andrew Zonenberg and contributors                                                                *
+ *                                                                                                                     *
+ * This program is free software; you can redistribute it and/or modify it under the terms of the GNU Lesser General   *
+ * Public License as published by the Free Software Foundation; either version 2.1 of the License, or (at your option) *
+ * any later version.                                                                                                  *
+ *                                                                                                                     *
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied  *
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for     *
+ * more details.                                                                                                       *
+ *                                                                                                                     *
+ * You should have received a copy of the GNU Lesser General Public License along with this program; if not, you may   *
+ * find one here:                                                                                                      *
+ * https://www.gnu.org/licenses/old-licenses/lgpl-2.1.txt                                                              *
+ * or you may search the http://www.gnu.org website for the version 2.1 license, or you may write to the Free Software *
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA                                      *
+ **********************************************************************************************************************/
+
+#include <chrono>
+#include <cstdio>
+#include <functional>
+#include "gp4prog.h"
+
+using namespace std;
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Production programming
+
+/**
+	@brief Steps every part goes through on the line, in the order they happen
+ */
+enum ProductionStep
+{
+	STEP_DETECT,
+	STEP_RESET,
+	STEP_SOCKET_TEST,
+	STEP_TRIM,
+	STEP_PREPARE,
+	STEP_PROGRAM,
+	STEP_VERIFY,
+
+	STEP_COUNT
+};
+
+//Column names of the steps in the CSV log
+static const char* g_stepNames[STEP_COUNT] =
+{
+	"detect",
+	"reset",
+	"socket_test",
+	"trim",
+	"prepare",
+	"program",
+	"verify"
+};
+
+/**
+	@brief How programming one part went
+ */
+class PartResult
+{
+public:
+	PartResult()
+		: failedStep(STEP_COUNT)
+		, rcFtw(0)
+	{
+		for(auto& t : seconds)
+			t = 0;
+	}
+
+	bool Passed() const
+	{ return failedStep == STEP_COUNT; }
+
+	//The step that failed (STEP_COUNT if none did)
+	ProductionStep failedStep;
+
+	//Time spent in each step (zero for the ones we didn't get to, or skipped)
+	double seconds[STEP_COUNT];
+
+	//Oscillator trim value programmed into the part
+	uint8_t rcFtw;
+};
+
+/**
+	@brief The bitstream being programmed, as read from the file
+
+	Reading and parsing the file is the only real work the host does per part, so it's done once per kind of part
+	rather than every time; each part then only needs its own copy patched with its trim value and pattern ID.
+ */
+class ProductionImage
+{
+public:
+	ProductionImage()
+		: part(SilegoPart::UNRECOGNIZED)
+	{}
+
+	SilegoPart part;
+	vector<uint8_t> bitstream;
+};
+
+/**
+	@brief Runs every step for the part in the socket, stopping at the first one that fails
+
+	@return False if the board itself has stopped working, so there's no point asking for more parts
+ */
+static bool ProgramPart(
+	hdevice hdev,
+	const ProgramOptions& opts,
+	uint8_t patternId,
+	ProductionImage& image,
+	OscillatorCalibration& calibration,
+	PartResult& result)
+{
+	SilegoPart part = SilegoPart::UNRECOGNIZED;
+	vector<uint8_t> bitstream;
+	bool matched = true;
+
+	//Runs one step, timing it and noting if it failed
+	auto step = [&](ProductionStep s, const function<bool()>& body) -> bool
+	{
+		if(!result.Passed())
+			return false;
+
+		TraceSpan span(g_stepNames[s]);
+		auto start = chrono::steady_clock::now();
+		bool ok = body();
+		result.seconds[s] = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+		if(!ok)
+			result.failedStep = s;
+		return ok;
+	};
+
+	step(STEP_DETECT, [&]()
+	{
+		BitstreamKind kind;
+		vector<uint8_t> programmed;
+		if(!DetectPart(hdev, part, programmed, kind))
+			return false;
+		if( (kind != BitstreamKind::EMPTY) && !opts.force )
+		{
+			LogError("Non-empty part detected; refusing to program without --force\n");
+			return false;
+		}
+		return true;
+	});
+
+	step(STEP_RESET, [&]()
+	{
+		LogNotice("Resetting board I/O and signal generators\n");
+		return Reset(hdev);
+	});
+
+	if(opts.test)
+	{
+		step(STEP_SOCKET_TEST, [&]()
+		{
+			//Only every so often in full, a quick check is enough to catch a badly seated part
+			if(!CachedSocketTest(hdev, part))
+			{
+				LogError("Socket test has failed\n");
+				return false;
+			}
+			LogNotice("Socket test has passed\n");
+			return true;
+		});
+	}
+
+	if(opts.rcOscFreq != 0)
+	{
+		step(STEP_TRIM, [&]()
+		{
+			LogNotice("Trimming oscillator for %d Hz at %.3g V\n", opts.rcOscFreq, opts.voltage);
+			LogIndenter li;
+			return TrimOscillator(hdev, part, opts.voltage, opts.rcOscFreq, result.rcFtw,
+				opts.fastTrim ? &calibration : NULL);
+		});
+	}
+
+	step(STEP_PREPARE, [&]()
+	{
+		if(image.part != part)
+		{
+			image.part = SilegoPart::UNRECOGNIZED;
+			if(!ReadBitstream(opts.downloadFilename, image.bitstream, part))
+				return false;
+			image.part = part;
+		}
+		bitstream = image.bitstream;
+		return TweakBitstream(bitstream, part, result.rcFtw, patternId, opts.readProtect);
+	});
+
+	step(STEP_PROGRAM, [&]()
+	{
+		LogNotice("Programming bitstream into NVM\n");
+		LogIndenter li;
+		return DownloadBitstream(hdev, bitstream, DownloadMode::PROGRAMMING);
+	});
+
+	step(STEP_VERIFY, [&]()
+	{
+		LogNotice("Verifying programmed bitstream\n");
+		LogIndenter li;
+		return VerifyBitstream(hdev, part, bitstream, matched) && matched;
+	});
+
+	//Whatever happened, leave the socket unpowered so the part can be swapped
+	bool ok = UnstickPins(hdev) && ResetAllSiggens(hdev);
+	if(!ok || !CheckStatus(hdev))
+	{
+		LogError("Fault condition detected after programming part, stopping\n");
+		return false;
+	}
+	return true;
+}
+
+/**
+	@brief Asks for the next part to be put in the socket
+
+	@return False if the operator has finished (or there's nobody left to ask, at the end of a scripted stdin)
+ */
+static bool WaitForPart(unsigned int n, uint8_t patternId)
+{
+	LogNotice("\nInsert part %u (pattern ID 0x%02x) and press Enter, or enter q to finish\n", n, patternId);
+
+	char line[64];
+	if(!fgets(line, sizeof(line), stdin))
+		return false;
+	return (line[0] != 'q') && (line[0] != 'Q');
+}
+
+/**
+	@brief Programs blank parts one after another, keeping the board open throughout
+
+	Each part that passes gets the next pattern ID, so the IDs of the good parts off the line have no gaps.
+	A row for every part goes to the CSV file as soon as the part is done, so an interrupted run still has its log.
+
+	@param hdev		Board with the socket the parts go in
+	@param opts		What to do to each part (--program, -t, -T, --pattern-id etc.)
+	@param csvFile	Where to log the result and step times of every part
+
+	@return True if every part passed
+ */
+bool RunProduction(hdevice hdev, const ProgramOptions& opts, const string& csvFile)
+{
+	FILE* fp = fopen(csvFile.c_str(), "w");
+	if(!fp)
+	{
+		LogError("Couldn't open %s for writing\n", csvFile.c_str());
+		return false;
+	}
+	fprintf(fp, "part,time_s,pattern_id,result,failed_step,trim_ftw");
+	for(auto name : g_stepNames)
+		fprintf(fp, ",%s_ms", name);
+	fprintf(fp, ",total_ms\n");
+	fflush(fp);
+
+	LogNotice("Production run: programming %s, results logged to %s\n",
+		opts.downloadFilename.c_str(), csvFile.c_str());
+
+	ProductionImage image;
+	OscillatorCalibration calibration;
+	unsigned int patternId = opts.patternId;
+	unsigned int parts = 0;
+	unsigned int passed = 0;
+	double stepTotals[STEP_COUNT] = {0};
+	auto runStart = chrono::steady_clock::now();
+	bool boardOk = true;
+	while(true)
+	{
+		if(patternId > 255)
+		{
+			LogWarning("Every pattern ID has been used, stopping\n");
+			break;
+		}
+
+		//The status LED is on while a part is being worked on, so the operator knows not to touch it
+		SetStatusLED(hdev, 0);
+		if(!WaitForPart(parts + 1, patternId))
+			break;
+		SetStatusLED(hdev, 1);
+		parts ++;
+
+		PartResult result;
+		{
+			LogIndenter li;
+			boardOk = ProgramPart(hdev, opts, patternId, image, calibration, result);
+		}
+
+		double total = 0;
+		for(int i=0; i<STEP_COUNT; i++)
+		{
+			total += result.seconds[i];
+			stepTotals[i] += result.seconds[i];
+		}
+		double now = chrono::duration<double>(chrono::steady_clock::now() - runStart).count();
+
+		fprintf(fp, "%u,%.3f,%u,%s,%s,%u", parts, now, patternId, result.Passed() ? "pass" : "fail",
+			result.Passed() ? "" : g_stepNames[result.failedStep], result.rcFtw);
+		for(auto t : result.seconds)
+			fprintf(fp, ",%.1f", t * 1000);
+		fprintf(fp, ",%.1f\n", total * 1000);
+		fflush(fp);
+
+		if(result.Passed())
+		{
+			LogNotice("Part %u passed (pattern ID 0x%02x, %.2f s)\n", parts, patternId, total);
+			passed ++;
+			patternId ++;
+		}
+		else
+			LogError("Part %u FAILED at %s step\n", parts, g_stepNames[result.failedStep]);
+
+		if(!boardOk)
+			break;
+	}
+	fclose(fp);
+
+	//Sum up yield and throughput (the wall clock time includes handling the parts, so it's the real rate)
+	double hours = chrono::duration<double>(chrono::steady_clock::now() - runStart).count() / 3600;
+	LogNotice("\nProduction run finished: %u of %u parts passed", passed, parts);
+	if(parts)
+		LogNotice(" (%.1f%% yield, %.0f parts per hour)", passed * 100.0 / parts, parts / hours);
+	LogNotice("\n");
+	if(parts)
+	{
+		LogIndenter li;
+		for(int i=0; i<STEP_COUNT; i++)
+		{
+			if(stepTotals[i] > 0)
+				LogNotice("%-12s %8.1f ms per part\n", g_stepNames[i], stepTotals[i] * 1000 / parts);
+		}
+	}
+
+	return boardOk && (passed == parts);
+}
@@ -0,0 +1,156 @@
+/***********************************************************************************************************************
+ * Copyright (C) 2016 Andrew Zonenberg and contributors                                                                *
+ *                                                                                                                     *
+ * This program is free software; you can redistribute it and/or modify it under the terms of the GNU Lesser General   *
+ * Public License as published by the Free Software Foundation; either version 2.1 of the License, or (at your option) *
+ * any later version.                                                                                                  *
+ *                                                                                                                     *
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied  *
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for     *
+ * more details.                                                                                                       *
+ *                                                                                                                     *
+ * You should have received a copy of the GNU Lesser General Public License along with this program; if not, you may   *
+ * find one here:                                                                                                      *
+ * https://www.gnu.org/licenses/old-licenses/lgpl-2.1.txt                                                              *
+ * or you may search the http://www.gnu.org website for the version 2.1 license, or you may write to the Free Software *
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA                                      *
+ **********************************************************************************************************************/
+
+#include <algorithm>
+#include <map>
+#include "gp4prog.h"
+
+using namespace std;
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// USB trace decoding
+
+/**
+	@brief A command sent to a board that hasn't been answered yet
+ */
+struct UnansweredFrame
+{
+	uint8_t type;
+	uint8_t sequenceA;
+
+	///When it went out, in ns
+	uint64_t sent;
+};
+
+/**
+	@brief Prints every frame in a trace written by --usb-trace, then how long each kind of command took to answer
+
+	Replies are matched to the oldest unanswered command on the same board with the same sequence number A, as
+	FramePipeline does. A command that's sent again before it's answered is counted as unanswered.
+ */
+bool DecodeUSBTrace(const string& fname)
+{
+	vector<USBTraceRecord> records;
+	if(!ReadUSBTrace(fname, records))
+		return false;
+
+	LogNotice("Decoding %zu USB frames from %s\n", records.size(), fname.c_str());
+	if(records.empty())
+		return true;
+
+	map<uint16_t, vector<UnansweredFrame>> unanswered;
+	map<uint8_t, vector<double>> latencies;
+	map<uint8_t, unsigned int> sent;
+	map<uint8_t, unsigned int> lost;
+	unsigned int failed = 0;
+	uint64_t epoch = records[0].timestamp;
+
+	{
+		LogNotice("   Time (ms)  Board  Dir  SeqA  SeqB  Len  Latency (ms)  Type\n");
+		LogIndenter li;
+		for(auto& record : records)
+		{
+			DataFrame frame;
+			memcpy(frame.GetData(), record.data, DataFrame::FRAME_SIZE);
+
+			//Work out which command this answers before printing it, so the latency can go on the same line
+			char latency[32] = "";
+			auto& pending = unanswered[record.board];
+			if(record.status != 0)
+				failed ++;
+			else if(record.in)
+			{
+				for(auto it = pending.begin(); it != pending.end(); ++it)
+				{
+					if(it->sequenceA != frame.GetSequenceA())
+						continue;
+
+					double ms = (record.timestamp + record.duration - it->sent) * 1e-6;
+					latencies[it->type].push_back(ms);
+					snprintf(latency, sizeof(latency), "%12.3f", ms);
+					pending.erase(it);
+					break;
+				}
+			}
+			else
+			{
+				for(auto it = pending.begin(); it != pending.end(); ++it)
+				{
+					if(it->sequenceA == frame.GetSequenceA())
+					{
+						lost[it->type] ++;
+						pending.erase(it);
+						break;
+					}
+				}
+				pending.push_back(UnansweredFrame{frame.GetType(), frame.GetSequenceA(), record.timestamp});
+				sent[frame.GetType()] ++;
+			}
+
+			LogNotice("%12.3f  %5u  %s    %02x    %02x  %3zu  %12s  %s (0x%02x)%s%s\n",
+				(record.timestamp - epoch) * 1e-6,
+				record.board,
+				record.in ? "D→H" : "H→D",
+				frame.GetSequenceA(),
+				frame.GetSequenceB(),
+				frame.GetPayloadSize(),
+				latency,
+				DataFrame::GetTypeName(frame.GetType()),
+				frame.GetType(),
+				(record.status != 0) ? "  " : "",
+				(record.status != 0) ? GetUSBErrorName(record.status) : "");
+		}
+	}
+
+	//Anything still waiting at the end of the trace never got an answer (or the trace stopped first)
+	for(auto& it : unanswered)
+	{
+		for(auto& f : it.second)
+			lost[f.type] ++;
+	}
+
+	LogNotice("Command latencies (%u transfers failed):\n", failed);
+	LogIndenter li;
+	LogNotice("%-48s  %6s  %10s  %10s  %10s  %10s\n", "Type", "Sent", "Unanswered", "Mean (ms)", "Median", "Max");
+	for(auto& it : sent)
+	{
+		char type[64];
+		snprintf(type, sizeof(type), "%s (0x%02x)", DataFrame::GetTypeName(it.first), it.first);
+
+		vector<double>& times = latencies[it.first];
+		if(times.empty())
+		{
+			LogNotice("%-48s  %6u  %10u\n", type, it.second, lost[it.first]);
+			continue;
+		}
+
+		sort(times.begin(), times.end());
+		double total = 0;
+		for(auto t : times)
+			total += t;
+		LogNotice("%-48s  %6u  %10u  %10.3f  %10.3f  %10.3f\n",
+			type,
+			it.second,
+			lost[it.first],
+			total / times.size(),
+			times[times.size() / 2],
+			times.back());
+	}
+
+	return true;
+}
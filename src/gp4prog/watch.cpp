@@ -0,0 +1,196 @@
+/***********************************************************************************************************************
+ * Copyright (C) 2016 Andrew Zonenberg and contributors                                                                *
+ *                                                                                                                     *
+ * This program is free software; you can redistribute it and/or modify it under the terms of the GNU Lesser General   *
+ * Public License as published by the Free Software Foundation; either version 2.1 of the License, or (at your option) *
+ * any later version.                                                                                                  *
+ *                                                                                                                     *
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied  *
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for     *
+ * more details.                                                                                                       *
+ *                                                                                                                     *
+ * You should have received a copy of the GNU Lesser General Public License along with this program; if not, you may   *
+ * find one here:                                                                                                      *
+ * https://www.gnu.org/licenses/old-licenses/lgpl-2.1.txt                                                              *
+ * or you may search the http://www.gnu.org website for the version 2.1 license, or you may write to the Free Software *
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA                                      *
+ **********************************************************************************************************************/
+
+#include <cerrno>
+#include <chrono>
+#include <csignal>
+#include <cstring>
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#include "gp4prog.h"
+
+using namespace std;
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Watch mode
+
+//Set by SIGINT/SIGTERM
+static volatile sig_atomic_t g_watchStop = 0;
+
+static void OnWatchSignal(int /*sig*/)
+{
+	g_watchStop = 1;
+}
+
+/**
+	@brief Reads the bitstream file and downloads it into SRAM, putting the design back in its power-up state
+
+	Vdd is left as it is, and the pins are only reconfigured as far as a download needs (see RestartTest()).
+ */
+static bool LoadWatchedBitstream(hdevice hdev, const ProgramOptions& opts, SilegoPart part, uint8_t rcFtw)
+{
+	auto start = chrono::steady_clock::now();
+
+	vector<uint8_t> bitstream;
+	if(!ReadBitstream(opts.downloadFilename, bitstream, part))
+		return false;
+	if(!TweakBitstream(bitstream, part, rcFtw, opts.patternId, opts.readProtect))
+		return false;
+
+	{
+		TraceSpan span("Download bitstream");
+		if(!RestartTest(hdev, bitstream))
+			return false;
+	}
+
+	if(!opts.nets.empty())
+	{
+		IOConfig config;
+		for(int net : opts.nets)
+		{
+			config.driverConfigs[net] = TP_FLOAT;
+			config.ledEnabled[net] = true;
+			config.expansionEnabled[net] = true;
+		}
+		if(!SetIOConfig(hdev, config))
+			return false;
+	}
+
+	if(!CheckStatus(hdev))
+	{
+		LogError("Fault condition detected after download\n");
+		return false;
+	}
+
+	double ms = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+	LogNotice("Downloaded %s in %.1f ms\n", opts.downloadFilename.c_str(), ms);
+	return true;
+}
+
+/**
+	@brief Keeps the board open and downloads the bitstream into SRAM again every time the file changes
+
+	The part is detected, reset and trimmed once, and Vdd is set once, at the start. After that, a change only costs
+	reading the file and downloading it, so a design is running on the board moments after gp4par writes it out.
+
+	We watch the directory rather than the file, since tools that write the file by renaming a new one over it would
+	otherwise leave us watching the old one. A bitstream that can't be read (say, because gp4par failed halfway) is
+	reported, and the board keeps running the last one that could.
+
+	@return True if we stopped because of SIGINT or SIGTERM, false if the board or file couldn't be set up
+ */
+bool RunWatch(hdevice hdev, const ProgramOptions& opts)
+{
+	if(!SetStatusLED(hdev, 1))
+		return false;
+
+	//One-time setup
+	SilegoPart part = SilegoPart::UNRECOGNIZED;
+	vector<uint8_t> programmedBitstream;
+	BitstreamKind bitstreamKind;
+	if(!DetectPart(hdev, part, programmedBitstream, bitstreamKind))
+		return false;
+	if(!Reset(hdev))
+		return false;
+
+	uint8_t rcFtw = 0;
+	if(opts.rcOscFreq != 0)
+	{
+		LogNotice("Trimming oscillator for %d Hz at %.3g V\n", opts.rcOscFreq, opts.voltage);
+		LogIndenter li;
+		if(!TrimOscillator(hdev, part, opts.voltage, opts.rcOscFreq, rcFtw))
+			return false;
+	}
+
+	if(!LoadWatchedBitstream(hdev, opts, part, rcFtw))
+		return false;
+	if(!ResetAllSiggens(hdev))
+		return false;
+	LogNotice("Setting Vdd to %.3g V\n", opts.voltage);
+	if(!ConfigureSiggen(hdev, 1, opts.voltage))
+		return false;
+	if(opts.voltage2 != 0.0)
+	{
+		LogNotice("Setting Vdd2 to %.3g V\n", opts.voltage2);
+		if(!ConfigureSiggen(hdev, 14, opts.voltage2))
+			return false;
+	}
+
+	//Watch for the file being written or replaced
+	size_t slash = opts.downloadFilename.rfind('/');
+	string dir = (slash == string::npos) ? "." : opts.downloadFilename.substr(0, slash + 1);
+	string name = (slash == string::npos) ? opts.downloadFilename : opts.downloadFilename.substr(slash + 1);
+
+	int fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	if(fd < 0)
+	{
+		LogError("Couldn't start watching %s: %s\n", opts.downloadFilename.c_str(), strerror(errno));
+		return false;
+	}
+	if(inotify_add_watch(fd, dir.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO) < 0)
+	{
+		LogError("Couldn't watch %s: %s\n", dir.c_str(), strerror(errno));
+		close(fd);
+		return false;
+	}
+
+	signal(SIGINT, OnWatchSignal);
+	signal(SIGTERM, OnWatchSignal);
+	LogNotice("Watching %s for changes (press Ctrl-C to stop)\n", opts.downloadFilename.c_str());
+
+	while(!g_watchStop)
+	{
+		//Time out now and then so we notice Ctrl-C
+		pollfd pfd = {fd, POLLIN, 0};
+		if(poll(&pfd, 1, 250) <= 0)
+			continue;
+
+		//Several events may come at once (e.g. other files in the same directory), but one download covers them all
+		bool changed = false;
+		alignas(inotify_event) char buf[4096];
+		ssize_t len;
+		while( (len = read(fd, buf, sizeof(buf))) > 0 )
+		{
+			for(ssize_t off = 0; off < len; )
+			{
+				auto ev = reinterpret_cast<const inotify_event*>(buf + off);
+				if( (ev->len > 0) && (name == ev->name) )
+					changed = true;
+				off += sizeof(inotify_event) + ev->len;
+			}
+		}
+		if(!changed)
+			continue;
+
+		//A bad file leaves the last good design running, but a board that stops answering is fatal
+		if(!LoadWatchedBitstream(hdev, opts, part, rcFtw))
+		{
+			if(!CheckStatus(hdev))
+			{
+				close(fd);
+				return false;
+			}
+			LogWarning("Couldn't load the bitstream, waiting for it to change again\n");
+		}
+	}
+
+	LogNotice("Stopped watching\n");
+	close(fd);
+	return true;
+}
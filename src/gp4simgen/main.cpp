@@ -0,0 +1,170 @@
+/***********************************************************************************************************************
+ * Copyright (C) 2016 Andrew Zonenberg and contributors                                                                *
+ *                                                                                                                     *
+ * This program is free software; you can redistribute it and/or modify it under the terms of the GNU Lesser General   *
+ * Public License as published by the Free Software Foundation; either version 2.1 of the License, or (at your option) *
+ * any later version.                                                                                                  *
+ *                                                                                                                     *
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied  *
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for     *
+ * more details.                                                                                                       *
+ *                                                                                                                     *
+ * You should have received a copy of the GNU Lesser General Public License along with this program; if not, you may   *
+ * find one here:                                                                                                      *
+ * https://www.gnu.org/licenses/old-licenses/lgpl-2.1.txt                                                              *
+ * or you may search the http://www.gnu.org website for the version 2.1 license, or you may write to the Free Software *
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA                                      *
+ **********************************************************************************************************************/
+
+#include <Greenpak4ModelGenerator.h>
+#include <log.h>
+#include <debuglog.h>
+#include <cstring>
+
+using namespace std;
+
+void ShowUsage();
+void ShowVersion();
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Entry point
+
+int main(int argc, char* argv[])
+{
+	Severity console_verbosity = Severity::NOTICE;
+
+	string fname;
+	string ofname;
+	Greenpak4Device::GREENPAK4_PART part = Greenpak4Device::GREENPAK4_SLG46620;
+	string partname = "SLG46620V";
+
+	//Parse command-line arguments
+	for(int i=1; i<argc; i++)
+	{
+		string s(argv[i]);
+
+		//Let the logger eat its args first
+		if(ParseLoggerArguments(i, argc, argv, console_verbosity))
+			continue;
+
+		else if(s == "--help")
+		{
+			ShowUsage();
+			return 0;
+		}
+		else if(s == "--version")
+		{
+			ShowVersion();
+			return 0;
+		}
+		else if(s == "-o" || s == "--output")
+		{
+			if(i+1 < argc)
+				ofname = argv[++i];
+			else
+			{
+				printf("--output requires an argument\n");
+				return 1;
+			}
+		}
+		else if(s == "-p" || s == "--part")
+		{
+			if(i+1 < argc)
+				partname = argv[++i];
+			else
+			{
+				printf("--part requires an argument\n");
+				return 1;
+			}
+
+			if(partname == "SLG46620V")
+				part = Greenpak4Device::GREENPAK4_SLG46620;
+			else if(partname == "SLG46621V")
+				part = Greenpak4Device::GREENPAK4_SLG46621;
+			else if(partname == "SLG46140V")
+				part = Greenpak4Device::GREENPAK4_SLG46140;
+			else
+			{
+				printf("invalid part (supported: SLG46620V, SLG46621V, SLG46140V)\n");
+				return 1;
+			}
+		}
+
+		//assume it's the bitstream file if it's the first non-switch argument
+		else if( (s[0] != '-') && (fname == "") )
+			fname = s;
+
+		else
+		{
+			printf("Unrecognized command-line argument \"%s\", use --help\n", s.c_str());
+			return 1;
+		}
+	}
+
+	if( (fname == "") || (ofname == "") )
+	{
+		ShowUsage();
+		return 1;
+	}
+
+	//Set up logging
+	g_log_sinks.emplace(g_log_sinks.begin(), new STDLogSink(console_verbosity));
+	SetDebugLogging(console_verbosity >= Severity::DEBUG);
+
+	Greenpak4Device device(part);
+	uint8_t userid;
+	bool readProtect;
+	LogNotice("Loading bitstream \"%s\"\n", fname.c_str());
+	if(!device.LoadFromFile(fname, userid, readProtect))
+		return 1;
+
+	FILE* fp = fopen(ofname.c_str(), "w");
+	if(!fp)
+	{
+		LogError("Couldn't open %s for writing\n", ofname.c_str());
+		return 1;
+	}
+
+	LogNotice("Writing simulation model to \"%s\"\n", ofname.c_str());
+	Greenpak4ModelGenerator generator(&device);
+	bool ok = generator.Generate(fp, "\"" + fname + "\" (" + partname + ")");
+	fclose(fp);
+	if(!ok)
+	{
+		remove(ofname.c_str());
+		return 1;
+	}
+
+	return 0;
+}
+
+void ShowUsage()
+{
+	printf(//                                                                               v 80th column
+		"Usage: gp4simgen [options] bitstream.txt -o model.cpp\n"
+		"    Writes a simulation model of a bitstream as C++. Once it's built as a shared\n"
+		"    object (c++ -O2 -shared -fPIC model.cpp -o model.so), pass it to GP4_COSIM as\n"
+		"    the bitstream to run it at native speed.\n"
+		"    -q, --quiet\n"
+		"        Causes only warnings and errors to be written to the console.\n"
+		"        Specify twice to also silence warnings.\n"
+		"    --verbose\n"
+		"        Prints additional information about the design.\n"
+		"    --debug\n"
+		"        Prints lots of internal debugging information.\n"
+		"    -o, --output         <model.cpp>\n"
+		"        Specifies the file to write the model to (required).\n"
+		"    -p, --part           <part>\n"
+		"        Specifies the part the bitstream is for (default SLG46620V).\n"
+		"        Supported: SLG46620V, SLG46621V, SLG46140V.\n");
+}
+
+void ShowVersion()
+{
+	printf(
+		"GreenPAK 4 simulation model generator by Andrew D. Zonenberg.\n"
+		"\n"
+		"License: LGPL v2.1+\n"
+		"This is free software: you are free to change and redistribute it.\n"
+		"There is NO WARRANTY, to the extent permitted by law.\n");
+}
@@ -0,0 +1,51 @@
+/***********************************************************************************************************************
+ * Copyright (C) 2016 Andrew Zonenberg and contributors                                                                *
+ *                                                                                                                     *
+ * This program is free software; you can redistribute it and/or modify it under the terms of the GNU Lesser General   *
+ * Public License as published by the Free Software Foundation; either version 2.1 of the License, or (at your option) *
+ * any later version.                                                                                                  *
+ *                                                                                                                     *
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied  *
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for     *
+ * more details.                                                                                                       *
+ *                                                                                                                     *
+ * You should have received a copy of the GNU Lesser General Public License along with this program; if not, you may   *
+ * find one here:                                                                                                      *
+ * https://www.gnu.org/licenses/old-licenses/lgpl-2.1.txt                                                              *
+ * or you may search the http://www.gnu.org website for the version 2.1 license, or you may write to the Free Software *
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA                                      *
+ **********************************************************************************************************************/
+
+`default_nettype none
+`timescale 1ps/1ps
+
+/**
+	@brief Drop-in simulation model of a configured GreenPAK4, running the bitstream in gpcosim.vpi
+
+	Run vvp with -M pointing at the directory gpcosim.vpi is in, and -m gpcosim. Unused pins float, and pins the
+	device drives win over whatever else is on the net.
+
+	BITSTREAM can also be a model compiled by gp4simgen (a .so file), which runs much faster.
+
+	The model only runs when a pin changes or when it has something to do on its own (an oscillator edge, say), and
+	all 20 pins are exchanged with it at once.
+ */
+module GP4_COSIM #(
+	parameter PART		= "SLG46620V",
+	parameter BITSTREAM	= ""
+) (
+	inout wire[20:1] pins
+);
+
+	reg[20:1] drive = {20{1'bz}};
+	assign pins = drive;
+
+	integer sim = -1;
+	initial begin
+		sim = $gp4_load(PART, BITSTREAM);
+		if(sim < 0)
+			$finish;
+		$gp4_attach(sim, pins, drive);
+	end
+
+endmodule
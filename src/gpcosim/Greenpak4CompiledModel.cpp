@@ -0,0 +1,164 @@
+/***********************************************************************************************************************
+ * Copyright (C) 2016 Andrew Zonenberg and contributors                                                                *
+ *                                                                                                                     *
+ * This program is free software; you can redistribute it and/or modify it under the terms of the GNU Lesser General   *
+ * Public License as published by the Free Software Foundation; either version 2.1 of the License, or (at your option) *
+ * any later version.                                                                                                  *
+ *                                                                                                                     *
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied  *
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for     *
+ * more details.                                                                                                       *
+ *                                                                                                                     *
+ * You should have received a copy of the GNU Lesser General Public License along with this program; if not, you may   *
+ * find one here:                                                                                                      *
+ * https://www.gnu.org/licenses/old-licenses/lgpl-2.1.txt                                                              *
+ * or you may search the http://www.gnu.org website for the version 2.1 license, or you may write to the Free Software *
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA                                      *
+ **********************************************************************************************************************/
+
+#include "Greenpak4CompiledModel.h"
+#include "Greenpak4ModelGenerator.h"
+#include <log.h>
+#include <dlfcn.h>
+
+using namespace std;
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Construction / destruction
+
+Greenpak4CompiledModel::Greenpak4CompiledModel()
+	: m_library(NULL)
+	, m_model(NULL)
+	, m_create(NULL)
+	, m_copy(NULL)
+	, m_destroy(NULL)
+	, m_reset(NULL)
+	, m_setPin(NULL)
+	, m_getPin(NULL)
+	, m_runUntil(NULL)
+	, m_nextEvent(NULL)
+{
+}
+
+Greenpak4CompiledModel::~Greenpak4CompiledModel()
+{
+	if(m_model)
+		m_destroy(m_model);
+	if(m_library)
+		dlclose(m_library);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Loading
+
+/**
+	@brief Loads a model and powers it up
+
+	@return False if the file isn't a model we can use (after saying why)
+ */
+bool Greenpak4CompiledModel::Load(const string& fname)
+{
+	//dlopen() only looks at the search path for bare names, so make sure a model in the current directory is found
+	string path = fname;
+	if(path.find('/') == string::npos)
+		path = "./" + path;
+
+	m_library = dlopen(path.c_str(), RTLD_NOW | RTLD_LOCAL);
+	if(m_library == NULL)
+	{
+		LogError("Couldn't load simulation model: %s\n", dlerror());
+		return false;
+	}
+	m_fname = fname;
+
+	auto version = reinterpret_cast<unsigned int (*)()>(FindSymbol("gp4model_version"));
+	if(version == NULL)
+		return false;
+	if(version() != Greenpak4ModelGenerator::MODEL_VERSION)
+	{
+		LogError("Simulation model \"%s\" is version %u, but we need version %u (regenerate it)\n",
+			fname.c_str(), version(), Greenpak4ModelGenerator::MODEL_VERSION);
+		return false;
+	}
+
+	m_create = reinterpret_cast<void* (*)()>(FindSymbol("gp4model_create"));
+	m_copy = reinterpret_cast<void* (*)(const void*)>(FindSymbol("gp4model_copy"));
+	m_destroy = reinterpret_cast<void (*)(void*)>(FindSymbol("gp4model_destroy"));
+	m_reset = reinterpret_cast<void (*)(void*)>(FindSymbol("gp4model_reset"));
+	m_setPin = reinterpret_cast<void (*)(void*, unsigned int, int)>(FindSymbol("gp4model_set_pin"));
+	m_getPin = reinterpret_cast<int (*)(void*, unsigned int)>(FindSymbol("gp4model_get_pin"));
+	m_runUntil = reinterpret_cast<void (*)(void*, uint64_t)>(FindSymbol("gp4model_run_until"));
+	m_nextEvent = reinterpret_cast<uint64_t (*)(void*)>(FindSymbol("gp4model_next_event"));
+	if(!m_create || !m_copy || !m_destroy || !m_reset || !m_setPin || !m_getPin || !m_runUntil || !m_nextEvent)
+		return false;
+
+	m_model = m_create();
+	return true;
+}
+
+/**
+	@brief Makes a new instance of the model (see Greenpak4SimulationModel::Clone())
+
+	Opening a library that's already loaded only bumps its reference count, so the code is shared, and each instance
+	has its own state.
+ */
+Greenpak4CompiledModel* Greenpak4CompiledModel::Clone()
+{
+	Greenpak4CompiledModel* model = new Greenpak4CompiledModel;
+	if(!model->Load(m_fname))
+	{
+		delete model;
+		return NULL;
+	}
+	return model;
+}
+
+/**
+	@brief Makes a new instance of the model with a copy of our state (see Greenpak4SimulationModel::Snapshot())
+ */
+Greenpak4CompiledModel* Greenpak4CompiledModel::Snapshot()
+{
+	Greenpak4CompiledModel* model = Clone();
+	if(model == NULL)
+		return NULL;
+
+	model->m_destroy(model->m_model);
+	model->m_model = m_copy(m_model);
+	return model;
+}
+
+void* Greenpak4CompiledModel::FindSymbol(const char* name)
+{
+	void* sym = dlsym(m_library, name);
+	if(sym == NULL)
+		LogError("Simulation model doesn't have %s(), is it really a model?\n", name);
+	return sym;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Simulation
+
+void Greenpak4CompiledModel::Reset()
+{
+	m_reset(m_model);
+}
+
+void Greenpak4CompiledModel::SetPinInput(unsigned int pin, PinState state)
+{
+	m_setPin(m_model, pin, state);
+}
+
+Greenpak4SimulationModel::PinState Greenpak4CompiledModel::GetPinOutput(unsigned int pin)
+{
+	return static_cast<PinState>(m_getPin(m_model, pin));
+}
+
+void Greenpak4CompiledModel::RunUntil(uint64_t time)
+{
+	m_runUntil(m_model, time);
+}
+
+uint64_t Greenpak4CompiledModel::GetNextEventTime()
+{
+	return m_nextEvent(m_model);
+}
@@ -0,0 +1,72 @@
+/***********************************************************************************************************************
+ * Copyright (C) 2016 Andrew Zonenberg and contributors                                                                *
+ *                                                                                                                     *
+ * This program is free software; you can redistribute it and/or modify it under the terms of the GNU Lesser General   *
+ * Public License as published by the Free Software Foundation; either version 2.1 of the License, or (at your option) *
+ * any later version.                                                                                                  *
+ *                                                                                                                     *
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied  *
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for     *
+ * more details.                                                                                                       *
+ *                                                                                                                     *
+ * You should have received a copy of the GNU Lesser General Public License along with this program; if not, you may   *
+ * find one here:                                                                                                      *
+ * https://www.gnu.org/licenses/old-licenses/lgpl-2.1.txt                                                              *
+ * or you may search the http://www.gnu.org website for the version 2.1 license, or you may write to the Free Software *
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA                                      *
+ **********************************************************************************************************************/
+
+#ifndef Greenpak4CompiledModel_h
+#define Greenpak4CompiledModel_h
+
+#include "Greenpak4SimulationModel.h"
+
+#include <string>
+
+/**
+	@brief A model generated by gp4simgen (see Greenpak4ModelGenerator), loaded from a shared object
+
+	The library stays loaded for as long as this object exists.
+ */
+class Greenpak4CompiledModel : public Greenpak4SimulationModel
+{
+public:
+	Greenpak4CompiledModel();
+	virtual ~Greenpak4CompiledModel();
+
+	bool Load(const std::string& fname);
+
+	virtual void Reset();
+	virtual Greenpak4CompiledModel* Clone();
+	virtual Greenpak4CompiledModel* Snapshot();
+
+	virtual void SetPinInput(unsigned int pin, PinState state);
+	virtual PinState GetPinOutput(unsigned int pin);
+
+	virtual void RunUntil(uint64_t time);
+	virtual uint64_t GetNextEventTime();
+
+protected:
+	void* FindSymbol(const char* name);
+
+	///What we were loaded from
+	std::string m_fname;
+
+	///Handle from dlopen()
+	void* m_library;
+
+	///The model's state
+	void* m_model;
+
+	//Entry points
+	void* (*m_create)();
+	void* (*m_copy)(const void*);
+	void (*m_destroy)(void*);
+	void (*m_reset)(void*);
+	void (*m_setPin)(void*, unsigned int, int);
+	int (*m_getPin)(void*, unsigned int);
+	void (*m_runUntil)(void*, uint64_t);
+	uint64_t (*m_nextEvent)(void*);
+};
+
+#endif
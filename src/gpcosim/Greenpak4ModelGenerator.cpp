@@ -0,0 +1,856 @@
+/***********************************************************************************************************************
+ * Copyright (C) 2016 Andrew Zonenberg and contributors                                                                *
+ *                                                                                                                     *
+ * This program is free software; you can redistribute it and/or modify it under the terms of the GNU Lesser General   *
+ * Public License as published by the Free Software Foundation; either version 2.1 of the License, or (at your option) *
+ * any later version.                                                                                                  *
+ *                                                                                                                     *
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied  *
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for     *
+ * more details.                                                                                                       *
+ *                                                                                                                     *
+ * You should have received a copy of the GNU Lesser General Public License along with this program; if not, you may   *
+ * find one here:                                                                                                      *
+ * https://www.gnu.org/licenses/old-licenses/lgpl-2.1.txt                                                              *
+ * or you may search the http://www.gnu.org website for the version 2.1 license, or you may write to the Free Software *
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA                                      *
+ **********************************************************************************************************************/
+
+#include "Greenpak4ModelGenerator.h"
+#include <log.h>
+
+using namespace std;
+
+//Give up settling after this many passes over the logic (something must be oscillating)
+static const unsigned int SETTLE_PASSES = 1000;
+
+//Number of transitions a delay line can have in flight (any more and the oldest comes out early)
+static const unsigned int DELAY_QUEUE = 32;
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Construction / destruction
+
+Greenpak4ModelGenerator::Greenpak4ModelGenerator(Greenpak4Device* device)
+	: Greenpak4Simulator(device, false)
+	, m_pinCount(0)
+{
+}
+
+Greenpak4ModelGenerator::~Greenpak4ModelGenerator()
+{
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Code generation
+
+/**
+	@brief Writes the model out as a C++ source file
+
+	@param fp			File to write to
+	@param description	What the model was generated from (goes in a comment at the top)
+
+	@return False if the device can't be compiled (after saying why)
+ */
+bool Greenpak4ModelGenerator::Generate(FILE* fp, const string& description)
+{
+	if(!Build())
+		return false;
+
+	vector<uint32_t> order;
+	if(!SortCells(order))
+		return false;
+
+	m_pinCount = m_pinCells.size();
+
+	fprintf(fp, "//Simulation model of %s, generated by gp4simgen. Don't edit it, regenerate it.\n",
+		description.c_str());
+	fprintf(fp, "//Build it with something like: c++ -O2 -shared -fPIC model.cpp -o model.so\n");
+	fprintf(fp, "\n");
+	fprintf(fp, "#include <cstdint>\n");
+	fprintf(fp, "#include <cstring>\n");
+	fprintf(fp, "\n");
+	fprintf(fp, "namespace\n");
+	fprintf(fp, "{\n");
+	fprintf(fp, "\n");
+	fprintf(fp, "const uint64_t NO_EVENT = UINT64_MAX;\n");
+	fprintf(fp, "const unsigned int PIN_COUNT = %u;\n", m_pinCount);
+	fprintf(fp, "const unsigned int DELAY_QUEUE = %u;\n", DELAY_QUEUE);
+	fprintf(fp, "enum { PIN_LOW, PIN_HIGH, PIN_FLOAT };\n");
+	fprintf(fp, "\n");
+
+	WriteState(fp);
+	WriteDelayQueue(fp);
+	WriteCombinational(fp, order);
+	WriteClock(fp);
+	WriteOutputs(fp);
+
+	fprintf(fp, "void Settle(State* m)\n");
+	fprintf(fp, "{\n");
+	fprintf(fp, "\tfor(unsigned int pass=0; pass<%u; pass++)\n", SETTLE_PASSES);
+	fprintf(fp, "\t{\n");
+	fprintf(fp, "\t\tCombinational(m);\n");
+	fprintf(fp, "\t\tClock(m);\n");
+	fprintf(fp, "\t\tif(!Outputs(m))\n");
+	fprintf(fp, "\t\t\treturn;\n");
+	fprintf(fp, "\t}\n");
+	fprintf(fp, "}\n");
+	fprintf(fp, "\n");
+
+	WriteEvents(fp);
+	WriteReset(fp);
+
+	fprintf(fp, "}\n");
+	fprintf(fp, "\n");
+
+	WriteInterface(fp);
+	return true;
+}
+
+/**
+	@brief Puts the combinational cells in dependency order (see Greenpak4SimulationNetlist::SortCombinational())
+
+	@return False if there's a combinational loop
+ */
+bool Greenpak4ModelGenerator::SortCells(vector<uint32_t>& order)
+{
+	vector<bool> sequential(m_cells.size(), false);
+	for(size_t i=0; i<m_cells.size(); i++)
+		sequential[i] = IsSequential(m_cells[i]);
+
+	int32_t loop = SortCombinational(m_cells, sequential, order);
+	if(loop >= 0)
+	{
+		LogError("Combinational loop through %s, which can't be compiled\n",
+			m_cells[loop].entity->GetDescription().c_str());
+		return false;
+	}
+
+	return true;
+}
+
+string Greenpak4ModelGenerator::Name(uint32_t cell)
+{
+	return string("c") + to_string(cell);
+}
+
+string Greenpak4ModelGenerator::Signal(uint32_t signal)
+{
+	return string("m->s[") + to_string(signal) + "]";
+}
+
+/**
+	@brief Writes the struct holding all of the model's state
+
+	Every sequential cell gets its own fields, named after the cell, plus a copy of each input it finds edges on (and of
+	the data a flipflop or shift register samples on them).
+ */
+void Greenpak4ModelGenerator::WriteState(FILE* fp)
+{
+	fprintf(fp, "struct State\n");
+	fprintf(fp, "{\n");
+	fprintf(fp, "\tuint64_t time;\n");
+	fprintf(fp, "\n");
+
+	//Timed cells first, to keep the 64-bit fields together
+	for(size_t i=0; i<m_cells.size(); i++)
+	{
+		if(IsTimed(m_cells[i]))
+		{
+			fprintf(fp, "\tuint64_t %s_next;\t//%s\n",
+				Name(i).c_str(), m_cells[i].entity->GetDescription().c_str());
+		}
+	}
+	fprintf(fp, "\n");
+
+	for(size_t i=0; i<m_cells.size(); i++)
+	{
+		const Cell& cell = m_cells[i];
+		string name = Name(i);
+		string desc = cell.entity->GetDescription();
+		switch(cell.type)
+		{
+			case CELL_DFF:
+			case CELL_LATCH:
+				fprintf(fp, "\tuint8_t %s_q;\t//%s\n", name.c_str(), desc.c_str());
+				fprintf(fp, "\tuint8_t %s_clk;\n", name.c_str());
+				if(cell.type == CELL_DFF)
+					fprintf(fp, "\tuint8_t %s_d;\n", name.c_str());
+				break;
+
+			case CELL_COUNTER:
+				fprintf(fp, "\tuint32_t %s_count;\t//%s\n", name.c_str(), desc.c_str());
+				fprintf(fp, "\tuint32_t %s_phase;\n", name.c_str());
+				fprintf(fp, "\tuint8_t %s_clk;\n", name.c_str());
+				fprintf(fp, "\tuint8_t %s_rst;\n", name.c_str());
+				break;
+
+			case CELL_SHREG:
+				fprintf(fp, "\tuint16_t %s_bits;\t//%s\n", name.c_str(), desc.c_str());
+				fprintf(fp, "\tuint8_t %s_clk;\n", name.c_str());
+				fprintf(fp, "\tuint8_t %s_d;\n", name.c_str());
+				break;
+
+			case CELL_PGEN:
+				fprintf(fp, "\tuint8_t %s_step;\t//%s\n", name.c_str(), desc.c_str());
+				fprintf(fp, "\tuint8_t %s_clk;\n", name.c_str());
+				break;
+
+			case CELL_OSCILLATOR:
+				fprintf(fp, "\tuint32_t %s_edges;\t//%s\n", name.c_str(), desc.c_str());
+				fprintf(fp, "\tuint8_t %s_running;\n", name.c_str());
+				break;
+
+			case CELL_POR:
+				fprintf(fp, "\tuint8_t %s_done;\t//%s\n", name.c_str(), desc.c_str());
+				break;
+
+			//Delay lines keep a queue of the transitions on their way through
+			case CELL_DELAY:
+				fprintf(fp, "\tuint8_t %s_in;\t//%s\n", name.c_str(), desc.c_str());
+				fprintf(fp, "\tuint8_t %s_out;\n", name.c_str());
+				if(static_cast<Greenpak4Delay*>(cell.entity)->GetMode() == Greenpak4Delay::DELAY)
+				{
+					fprintf(fp, "\tuint8_t %s_head;\n", name.c_str());
+					fprintf(fp, "\tuint8_t %s_count;\n", name.c_str());
+					fprintf(fp, "\tuint8_t %s_values[DELAY_QUEUE];\n", name.c_str());
+					fprintf(fp, "\tuint64_t %s_times[DELAY_QUEUE];\n", name.c_str());
+				}
+				break;
+
+			default:
+				break;
+		}
+	}
+	fprintf(fp, "\n");
+
+	fprintf(fp, "\tuint8_t s[%zu];\t//Signal values\n", m_values.size());
+	fprintf(fp, "\tuint8_t pinIn[PIN_COUNT];\t//What the outside world is driving onto each pin\n");
+	fprintf(fp, "\tuint8_t pinOut[PIN_COUNT];\t//What we're driving onto each pin\n");
+	fprintf(fp, "};\n");
+	fprintf(fp, "\n");
+
+	fprintf(fp, "const bool HAS_PIN[PIN_COUNT] = {");
+	for(unsigned int pin=0; pin<m_pinCount; pin++)
+		fprintf(fp, "%s%s", pin ? ", " : "", (m_pinCells[pin] >= 0) ? "true" : "false");
+	fprintf(fp, "};\n");
+	fprintf(fp, "\n");
+}
+
+/**
+	@brief Writes the function that evaluates all of the combinational logic, in dependency order
+ */
+void Greenpak4ModelGenerator::WriteCombinational(FILE* fp, const vector<uint32_t>& order)
+{
+	fprintf(fp, "void Combinational(State* m)\n");
+	fprintf(fp, "{\n");
+	for(auto i : order)
+	{
+		const Cell& cell = m_cells[i];
+		string out = Signal(cell.outputs[0]);
+		fprintf(fp, "\t//%s\n", cell.entity->GetDescription().c_str());
+		switch(cell.type)
+		{
+			case CELL_LUT:
+				{
+					auto lut = static_cast<Greenpak4LUT*>(cell.entity);
+					uint32_t table = 0;
+					for(unsigned int j=0; j < (1u << cell.inputs.size()); j++)
+						table |= lut->GetTruthTableBit(j) << j;
+
+					fprintf(fp, "\t%s = (0x%x >> (", out.c_str(), table);
+					for(size_t j=0; j<cell.inputs.size(); j++)
+					{
+						fprintf(fp, "%s(%s << %zu)",
+							j ? " | " : "", Signal(cell.inputs[j]).c_str(), j);
+					}
+					fprintf(fp, ")) & 1;\n");
+				}
+				break;
+
+			case CELL_INVERTER:
+				fprintf(fp, "\t%s = !%s;\n", out.c_str(), Signal(cell.inputs[0]).c_str());
+				break;
+
+			case CELL_BUFFER:
+				fprintf(fp, "\t%s = %s;\n", out.c_str(), Signal(cell.inputs[0]).c_str());
+				break;
+
+			//We win over the outside world, and the outside world wins over the pull resistor
+			case CELL_IOB:
+				{
+					auto iob = static_cast<Greenpak4IOB*>(cell.entity);
+					unsigned int pin = iob->GetPinNumber();
+					string in = Signal(cell.inputs[0]);
+
+					const char* driven = "";
+					switch(iob->GetDriveType())
+					{
+						case Greenpak4IOB::DRIVE_PUSHPULL:
+							driven = "(%s ? PIN_HIGH : PIN_LOW)";
+							break;
+
+						case Greenpak4IOB::DRIVE_NMOS_OPENDRAIN:
+							driven = "(%s ? PIN_FLOAT : PIN_LOW)";
+							break;
+
+						case Greenpak4IOB::DRIVE_PMOS_OPENDRAIN:
+							driven = "(%s ? PIN_HIGH : PIN_FLOAT)";
+							break;
+					}
+					char value[128];
+					snprintf(value, sizeof(value), driven, in.c_str());
+
+					fprintf(fp, "\tm->pinOut[%u] = %s ? %s : PIN_FLOAT;\n",
+						pin, Signal(cell.inputs[1]).c_str(), value);
+					fprintf(fp, "\t%s = (m->pinOut[%u] != PIN_FLOAT) ? (m->pinOut[%u] == PIN_HIGH) :\n",
+						out.c_str(), pin, pin);
+					fprintf(fp, "\t\t(m->pinIn[%u] != PIN_FLOAT) ? (m->pinIn[%u] == PIN_HIGH) : %d;\n",
+						pin, pin, iob->GetPullDirection() == Greenpak4IOB::PULL_UP);
+				}
+				break;
+
+			default:
+				break;
+		}
+	}
+	fprintf(fp, "}\n");
+	fprintf(fp, "\n");
+}
+
+/**
+	@brief Writes the function that updates every sequential cell from the current signal values
+
+	None of their outputs change until Outputs() runs, so everything clocked by the same edge sees the values from
+	before it. Combinational() has already run with the new clock by now, so an edge clocks in the data input from the
+	previous pass (kept in _d), as Greenpak4Simulator does, not what it has just been recomputed to.
+ */
+void Greenpak4ModelGenerator::WriteClock(FILE* fp)
+{
+	fprintf(fp, "void Clock(State* m)\n");
+	fprintf(fp, "{\n");
+	for(size_t i=0; i<m_cells.size(); i++)
+	{
+		const Cell& cell = m_cells[i];
+		string name = Name(i);
+		const char* c = name.c_str();
+		vector<string> in;
+		for(auto signal : cell.inputs)
+			in.push_back(Signal(signal));
+
+		switch(cell.type)
+		{
+			//Inputs are D, CLK (nCLK for a latch), nSR
+			case CELL_DFF:
+			case CELL_LATCH:
+				{
+					auto ff = static_cast<Greenpak4Flipflop*>(cell.entity);
+					fprintf(fp, "\t//%s\n", cell.entity->GetDescription().c_str());
+					fprintf(fp, "\tif(!%s)\n", in[2].c_str());
+					fprintf(fp, "\t\tm->%s_q = %d;\n", c, ff->GetSetResetMode());
+					if(cell.type == CELL_DFF)
+					{
+						fprintf(fp, "\telse if(%s && !m->%s_clk)\n", in[1].c_str(), c);
+						fprintf(fp, "\t\tm->%s_q = m->%s_d;\n", c, c);
+						fprintf(fp, "\tm->%s_d = %s;\n", c, in[0].c_str());
+					}
+					else
+					{
+						fprintf(fp, "\telse if(!%s)\n", in[1].c_str());
+						fprintf(fp, "\t\tm->%s_q = %s;\n", c, in[0].c_str());
+					}
+					fprintf(fp, "\tm->%s_clk = %s;\n", c, in[1].c_str());
+				}
+				break;
+
+			//Inputs are CLK, RST, UP, KEEP
+			case CELL_COUNTER:
+				{
+					auto count = static_cast<Greenpak4Counter*>(cell.entity);
+					uint32_t max = (1 << count->GetDepth()) - 1;
+					uint32_t reload = count->GetCountValue();
+
+					const char* reset = "";
+					switch(count->GetResetMode())
+					{
+						case Greenpak4Counter::HIGH_LEVEL:
+							reset = "%s";
+							break;
+
+						case Greenpak4Counter::RISING_EDGE:
+							reset = "(%s && !m->%s_rst)";
+							break;
+
+						case Greenpak4Counter::FALLING_EDGE:
+							reset = "(!%s && m->%s_rst)";
+							break;
+
+						case Greenpak4Counter::BOTH_EDGE:
+							reset = "(%s != m->%s_rst)";
+							break;
+					}
+					char condition[128];
+					snprintf(condition, sizeof(condition), reset, in[1].c_str(), c);
+
+					fprintf(fp, "\t//%s\n", cell.entity->GetDescription().c_str());
+					fprintf(fp, "\tif(%s)\n", condition);
+					fprintf(fp, "\t{\n");
+					fprintf(fp, "\t\tm->%s_count = %u;\n", c,
+						(count->GetResetValue() == Greenpak4Counter::ZERO) ? 0 : reload);
+					fprintf(fp, "\t\tm->%s_phase = 0;\n", c);
+					fprintf(fp, "\t}\n");
+					fprintf(fp, "\telse if(%s && !m->%s_clk && (++m->%s_phase >= %u))\n",
+						in[0].c_str(), c, c, count->GetPreDivide());
+					fprintf(fp, "\t{\n");
+					fprintf(fp, "\t\tm->%s_phase = 0;\n", c);
+					fprintf(fp, "\t\tif(%s)\n", in[3].c_str());
+					fprintf(fp, "\t\t\t{}\t//KEEP holds the count\n");
+					fprintf(fp, "\t\telse if(%s)\n", in[2].c_str());
+					fprintf(fp, "\t\t\tm->%s_count = (m->%s_count == %u) ? %u : m->%s_count + 1;\n",
+						c, c, max, reload, c);
+					fprintf(fp, "\t\telse\n");
+					fprintf(fp, "\t\t\tm->%s_count = (m->%s_count == 0) ? %u : m->%s_count - 1;\n", c, c, reload, c);
+					fprintf(fp, "\t}\n");
+					fprintf(fp, "\tm->%s_clk = %s;\n", c, in[0].c_str());
+					fprintf(fp, "\tm->%s_rst = %s;\n", c, in[1].c_str());
+				}
+				break;
+
+			//Inputs are CLK, IN, nRST
+			case CELL_SHREG:
+				fprintf(fp, "\t//%s\n", cell.entity->GetDescription().c_str());
+				fprintf(fp, "\tif(!%s)\n", in[2].c_str());
+				fprintf(fp, "\t\tm->%s_bits = 0;\n", c);
+				fprintf(fp, "\telse if(%s && !m->%s_clk)\n", in[0].c_str(), c);
+				fprintf(fp, "\t\tm->%s_bits = (m->%s_bits << 1) | m->%s_d;\n", c, c, c);
+				fprintf(fp, "\tm->%s_clk = %s;\n", c, in[0].c_str());
+				fprintf(fp, "\tm->%s_d = %s;\n", c, in[1].c_str());
+				break;
+
+			//Inputs are CLK, nRST
+			case CELL_PGEN:
+				fprintf(fp, "\t//%s\n", cell.entity->GetDescription().c_str());
+				fprintf(fp, "\tif(!%s)\n", in[1].c_str());
+				fprintf(fp, "\t\tm->%s_step = 0;\n", c);
+				fprintf(fp, "\telse if(%s && !m->%s_clk)\n", in[0].c_str(), c);
+				fprintf(fp, "\t\tm->%s_step = (m->%s_step + 1) %% %d;\n", c, c,
+					static_cast<Greenpak4PatternGenerator*>(cell.entity)->GetPatternLength());
+				fprintf(fp, "\tm->%s_clk = %s;\n", c, in[0].c_str());
+				break;
+
+			case CELL_DELAY:
+				WriteDelayClock(fp, i);
+				break;
+
+			//Input is the power-down signal, so we run while it's low. Stopping cancels the next edge, and the
+			//outputs go low.
+			case CELL_OSCILLATOR:
+				fprintf(fp, "\t//%s\n", cell.entity->GetDescription().c_str());
+				fprintf(fp, "\tif(%s == m->%s_running)\n", in[0].c_str(), c);
+				fprintf(fp, "\t{\n");
+				fprintf(fp, "\t\tm->%s_running = !m->%s_running;\n", c, c);
+				fprintf(fp, "\t\tm->%s_edges = 0;\n", c);
+				fprintf(fp, "\t\tm->%s_next = m->%s_running ? (m->time + %lluULL) : NO_EVENT;\n",
+					c, c, static_cast<unsigned long long>(cell.delay));
+				fprintf(fp, "\t}\n");
+				break;
+
+			default:
+				break;
+		}
+	}
+	fprintf(fp, "}\n");
+	fprintf(fp, "\n");
+}
+
+/**
+	@brief Writes the part of Clock() for a delay line or edge detector (input IN)
+
+	Delay lines queue every transition to come out after the delay. Edge detectors put out a pulse as long as the
+	delay, starting over on each edge.
+ */
+void Greenpak4ModelGenerator::WriteDelayClock(FILE* fp, uint32_t index)
+{
+	const Cell& cell = m_cells[index];
+	string name = Name(index);
+	const char* c = name.c_str();
+	string in = Signal(cell.inputs[0]);
+	auto delay = static_cast<unsigned long long>(cell.delay);
+
+	fprintf(fp, "\t//%s\n", cell.entity->GetDescription().c_str());
+	fprintf(fp, "\tif(%s != m->%s_in)\n", in.c_str(), c);
+	fprintf(fp, "\t{\n");
+	fprintf(fp, "\t\tm->%s_in = %s;\n", c, in.c_str());
+
+	auto mode = static_cast<Greenpak4Delay*>(cell.entity)->GetMode();
+	if(mode == Greenpak4Delay::DELAY)
+	{
+		fprintf(fp, "\t\tPushDelay(m->%s_in, m->time + %lluULL, m->%s_out, m->%s_next, m->%s_head, m->%s_count, "
+			"m->%s_values, m->%s_times);\n", c, delay, c, c, c, c, c, c);
+	}
+	else
+	{
+		const char* edge = "1";
+		if(mode == Greenpak4Delay::RISING_EDGE)
+			edge = "m->%s_in";
+		else if(mode == Greenpak4Delay::FALLING_EDGE)
+			edge = "!m->%s_in";
+		char condition[64];
+		snprintf(condition, sizeof(condition), edge, c);
+
+		fprintf(fp, "\t\tif(%s)\n", condition);
+		fprintf(fp, "\t\t{\n");
+		fprintf(fp, "\t\t\tm->%s_out = 1;\n", c);
+		fprintf(fp, "\t\t\tm->%s_next = m->time + %lluULL;\n", c, delay);
+		fprintf(fp, "\t\t}\n");
+	}
+	fprintf(fp, "\t}\n");
+}
+
+/**
+	@brief Writes the helpers for the delay line transition queues
+ */
+void Greenpak4ModelGenerator::WriteDelayQueue(FILE* fp)
+{
+	fprintf(fp, "void PopDelay(uint8_t& out, uint64_t& next, uint8_t& head, uint8_t& count, uint8_t* values, "
+		"uint64_t* times)\n");
+	fprintf(fp, "{\n");
+	fprintf(fp, "\tout = values[head];\n");
+	fprintf(fp, "\thead = (head + 1) %% DELAY_QUEUE;\n");
+	fprintf(fp, "\tcount --;\n");
+	fprintf(fp, "\tnext = count ? times[head] : NO_EVENT;\n");
+	fprintf(fp, "}\n");
+	fprintf(fp, "\n");
+	fprintf(fp, "void PushDelay(uint8_t value, uint64_t time, uint8_t& out, uint64_t& next, uint8_t& head, "
+		"uint8_t& count, uint8_t* values, uint64_t* times)\n");
+	fprintf(fp, "{\n");
+	fprintf(fp, "\tif(count == DELAY_QUEUE)\n");
+	fprintf(fp, "\t\tPopDelay(out, next, head, count, values, times);\n");
+	fprintf(fp, "\tunsigned int tail = (head + count) %% DELAY_QUEUE;\n");
+	fprintf(fp, "\tvalues[tail] = value;\n");
+	fprintf(fp, "\ttimes[tail] = time;\n");
+	fprintf(fp, "\tcount ++;\n");
+	fprintf(fp, "\tnext = times[head];\n");
+	fprintf(fp, "}\n");
+	fprintf(fp, "\n");
+}
+
+/**
+	@brief Writes the function that drives the outputs of every sequential cell from its state
+
+	It returns true if any of them changed, in which case the logic needs another pass.
+ */
+void Greenpak4ModelGenerator::WriteOutputs(FILE* fp)
+{
+	fprintf(fp, "bool Drive(uint8_t& signal, bool value)\n");
+	fprintf(fp, "{\n");
+	fprintf(fp, "\tif(signal == value)\n");
+	fprintf(fp, "\t\treturn false;\n");
+	fprintf(fp, "\tsignal = value;\n");
+	fprintf(fp, "\treturn true;\n");
+	fprintf(fp, "}\n");
+	fprintf(fp, "\n");
+
+	fprintf(fp, "bool Outputs(State* m)\n");
+	fprintf(fp, "{\n");
+	fprintf(fp, "\tbool changed = false;\n");
+	for(size_t i=0; i<m_cells.size(); i++)
+	{
+		const Cell& cell = m_cells[i];
+		string name = Name(i);
+		const char* c = name.c_str();
+		vector<string> out;
+		for(auto signal : cell.outputs)
+			out.push_back(Signal(signal));
+
+		switch(cell.type)
+		{
+			case CELL_DFF:
+			case CELL_LATCH:
+				fprintf(fp, "\tchanged |= Drive(%s, m->%s_q%s);\n", out[0].c_str(), c,
+					static_cast<Greenpak4Flipflop*>(cell.entity)->IsOutputInverted() ? " ^ 1" : "");
+				break;
+
+			//High at the end of the count: zero counting down, or the maximum value counting up
+			case CELL_COUNTER:
+				{
+					auto count = static_cast<Greenpak4Counter*>(cell.entity);
+					fprintf(fp, "\tchanged |= Drive(%s, %s ? (m->%s_count == %u) : (m->%s_count == 0));\n",
+						out[0].c_str(), Signal(cell.inputs[2]).c_str(), c, (1 << count->GetDepth()) - 1, c);
+				}
+				break;
+
+			case CELL_SHREG:
+				{
+					auto shreg = static_cast<Greenpak4ShiftRegister*>(cell.entity);
+					fprintf(fp, "\tchanged |= Drive(%s, ((m->%s_bits >> %u) & 1)%s);\n",
+						out[0].c_str(), c, shreg->GetDelayA() - 1, shreg->IsInvertA() ? " ^ 1" : "");
+					fprintf(fp, "\tchanged |= Drive(%s, (m->%s_bits >> %u) & 1);\n",
+						out[1].c_str(), c, shreg->GetDelayB() - 1);
+				}
+				break;
+
+			case CELL_PGEN:
+				{
+					auto pgen = static_cast<Greenpak4PatternGenerator*>(cell.entity);
+					unsigned int pattern = 0;
+					for(unsigned int j=0; j<16; j++)
+						pattern |= pgen->GetPatternBit(j) << j;
+					fprintf(fp, "\tchanged |= Drive(%s, (0x%04x >> m->%s_step) & 1);\n", out[0].c_str(), pattern, c);
+				}
+				break;
+
+			//The hard IP output toggles every half period, and the fabric output every postdiv of those
+			case CELL_OSCILLATOR:
+				fprintf(fp, "\tchanged |= Drive(%s, m->%s_edges & 1);\n", out[0].c_str(), c);
+				if(out.size() > 1)
+				{
+					fprintf(fp, "\tchanged |= Drive(%s, (m->%s_edges / %u) & 1);\n",
+						out[1].c_str(), c, cell.divide);
+				}
+				break;
+
+			case CELL_POR:
+				fprintf(fp, "\tchanged |= Drive(%s, m->%s_done);\n", out[0].c_str(), c);
+				break;
+
+			case CELL_DELAY:
+				fprintf(fp, "\tchanged |= Drive(%s, m->%s_out);\n", out[0].c_str(), c);
+				break;
+
+			default:
+				break;
+		}
+	}
+	fprintf(fp, "\treturn changed;\n");
+	fprintf(fp, "}\n");
+	fprintf(fp, "\n");
+}
+
+/**
+	@brief Writes the functions that find and fire timed events (oscillator edges and the end of power-on reset)
+ */
+void Greenpak4ModelGenerator::WriteEvents(FILE* fp)
+{
+	vector<uint32_t> timed;
+	for(size_t i=0; i<m_cells.size(); i++)
+	{
+		if(IsTimed(m_cells[i]))
+			timed.push_back(i);
+	}
+
+	fprintf(fp, "uint64_t NextEvent(State* m)\n");
+	fprintf(fp, "{\n");
+	fprintf(fp, "\tuint64_t next = NO_EVENT;\n");
+	for(auto i : timed)
+	{
+		string name = Name(i);
+		fprintf(fp, "\tif(m->%s_next < next)\n", name.c_str());
+		fprintf(fp, "\t\tnext = m->%s_next;\n", name.c_str());
+	}
+	fprintf(fp, "\treturn next;\n");
+	fprintf(fp, "}\n");
+	fprintf(fp, "\n");
+
+	fprintf(fp, "void RunUntil(State* m, uint64_t time)\n");
+	fprintf(fp, "{\n");
+	fprintf(fp, "\tfor(uint64_t next = NextEvent(m); next <= time; next = NextEvent(m))\n");
+	fprintf(fp, "\t{\n");
+	fprintf(fp, "\t\tm->time = next;\n");
+	for(auto i : timed)
+	{
+		string name = Name(i);
+		const char* c = name.c_str();
+		fprintf(fp, "\t\tif(m->%s_next == next)\n", c);
+		fprintf(fp, "\t\t{\n");
+		switch(m_cells[i].type)
+		{
+			case CELL_OSCILLATOR:
+				fprintf(fp, "\t\t\tm->%s_edges ++;\n", c);
+				fprintf(fp, "\t\t\tm->%s_next += %lluULL;\n", c,
+					static_cast<unsigned long long>(m_cells[i].delay));
+				break;
+
+			case CELL_POR:
+				fprintf(fp, "\t\t\tm->%s_done = 1;\n", c);
+				fprintf(fp, "\t\t\tm->%s_next = NO_EVENT;\n", c);
+				break;
+
+			//Delay lines put out the oldest queued transition, edge detectors end their pulse
+			default:
+				if(static_cast<Greenpak4Delay*>(m_cells[i].entity)->GetMode() == Greenpak4Delay::DELAY)
+					fprintf(fp, "\t\t\tPopDelay(m->%s_out, m->%s_next, m->%s_head, m->%s_count, m->%s_values, "
+						"m->%s_times);\n", c, c, c, c, c, c);
+				else
+				{
+					fprintf(fp, "\t\t\tm->%s_out = 0;\n", c);
+					fprintf(fp, "\t\t\tm->%s_next = NO_EVENT;\n", c);
+				}
+				break;
+		}
+		fprintf(fp, "\t\t}\n");
+	}
+	fprintf(fp, "\t\tSettle(m);\n");
+	fprintf(fp, "\t}\n");
+	fprintf(fp, "\n");
+	fprintf(fp, "\tif(time > m->time)\n");
+	fprintf(fp, "\t\tm->time = time;\n");
+	fprintf(fp, "}\n");
+	fprintf(fp, "\n");
+}
+
+/**
+	@brief Writes the function that powers the device back up (leaving the pin inputs alone)
+ */
+void Greenpak4ModelGenerator::WriteReset(FILE* fp)
+{
+	fprintf(fp, "void Reset(State* m)\n");
+	fprintf(fp, "{\n");
+	fprintf(fp, "\tuint8_t pinIn[PIN_COUNT];\n");
+	fprintf(fp, "\tmemcpy(pinIn, m->pinIn, sizeof(pinIn));\n");
+	fprintf(fp, "\tmemset(m, 0, sizeof(*m));\n");
+	fprintf(fp, "\tmemcpy(m->pinIn, pinIn, sizeof(pinIn));\n");
+	fprintf(fp, "\tmemset(m->pinOut, PIN_FLOAT, sizeof(m->pinOut));\n");
+	fprintf(fp, "\t%s = 1;\n", Signal(m_power).c_str());
+
+	for(size_t i=0; i<m_cells.size(); i++)
+	{
+		const Cell& cell = m_cells[i];
+		string name = Name(i);
+		const char* c = name.c_str();
+		switch(cell.type)
+		{
+			case CELL_OSCILLATOR:
+			case CELL_DELAY:
+				fprintf(fp, "\tm->%s_next = NO_EVENT;\n", c);
+				break;
+
+			case CELL_POR:
+				fprintf(fp, "\tm->%s_next = %lluULL;\n", c, static_cast<unsigned long long>(cell.delay));
+				break;
+
+			case CELL_DFF:
+			case CELL_LATCH:
+				if(static_cast<Greenpak4Flipflop*>(cell.entity)->GetInitValue())
+					fprintf(fp, "\tm->%s_q = 1;\n", c);
+				break;
+
+			case CELL_COUNTER:
+				fprintf(fp, "\tm->%s_count = %u;\n", c, static_cast<Greenpak4Counter*>(cell.entity)->GetCountValue());
+				break;
+
+			default:
+				break;
+		}
+	}
+	fprintf(fp, "\n");
+
+	//Same as Greenpak4Simulator::Reset(): find the power-up values without clocking anything, then let the
+	//asynchronous resets take effect
+	fprintf(fp, "\tfor(unsigned int pass=0; pass<%u; pass++)\n", SETTLE_PASSES);
+	fprintf(fp, "\t{\n");
+	fprintf(fp, "\t\tCombinational(m);\n");
+	for(size_t i=0; i<m_cells.size(); i++)
+	{
+		const Cell& cell = m_cells[i];
+		if( (cell.type == CELL_DELAY) &&
+			(static_cast<Greenpak4Delay*>(cell.entity)->GetMode() == Greenpak4Delay::DELAY) )
+		{
+			fprintf(fp, "\t\tm->%s_out = %s;\n", Name(i).c_str(), Signal(cell.inputs[0]).c_str());
+		}
+	}
+	fprintf(fp, "\t\tif(!Outputs(m))\n");
+	fprintf(fp, "\t\t\tbreak;\n");
+	fprintf(fp, "\t}\n");
+	for(size_t i=0; i<m_cells.size(); i++)
+	{
+		const Cell& cell = m_cells[i];
+		string name = Name(i);
+		const char* c = name.c_str();
+		switch(cell.type)
+		{
+			case CELL_DFF:
+			case CELL_LATCH:
+				fprintf(fp, "\tm->%s_clk = %s;\n", c, Signal(cell.inputs[1]).c_str());
+				if(cell.type == CELL_DFF)
+					fprintf(fp, "\tm->%s_d = %s;\n", c, Signal(cell.inputs[0]).c_str());
+				break;
+
+			case CELL_COUNTER:
+				fprintf(fp, "\tm->%s_clk = %s;\n", c, Signal(cell.inputs[0]).c_str());
+				fprintf(fp, "\tm->%s_rst = %s;\n", c, Signal(cell.inputs[1]).c_str());
+				break;
+
+			case CELL_SHREG:
+				fprintf(fp, "\tm->%s_clk = %s;\n", c, Signal(cell.inputs[0]).c_str());
+				fprintf(fp, "\tm->%s_d = %s;\n", c, Signal(cell.inputs[1]).c_str());
+				break;
+
+			case CELL_PGEN:
+				fprintf(fp, "\tm->%s_clk = %s;\n", c, Signal(cell.inputs[0]).c_str());
+				break;
+
+			case CELL_DELAY:
+				fprintf(fp, "\tm->%s_in = %s;\n", c, Signal(cell.inputs[0]).c_str());
+				break;
+
+			default:
+				break;
+		}
+	}
+	fprintf(fp, "\tSettle(m);\n");
+	fprintf(fp, "}\n");
+	fprintf(fp, "\n");
+}
+
+/**
+	@brief Writes the C interface Greenpak4CompiledModel looks for
+ */
+void Greenpak4ModelGenerator::WriteInterface(FILE* fp)
+{
+	fprintf(fp, "extern \"C\"\n");
+	fprintf(fp, "{\n");
+	fprintf(fp, "\n");
+	fprintf(fp, "unsigned int gp4model_version()\n");
+	fprintf(fp, "{ return %u; }\n", MODEL_VERSION);
+	fprintf(fp, "\n");
+	fprintf(fp, "void* gp4model_create()\n");
+	fprintf(fp, "{\n");
+	fprintf(fp, "\tState* m = new State;\n");
+	fprintf(fp, "\tmemset(m->pinIn, PIN_FLOAT, sizeof(m->pinIn));\n");
+	fprintf(fp, "\tReset(m);\n");
+	fprintf(fp, "\treturn m;\n");
+	fprintf(fp, "}\n");
+	fprintf(fp, "\n");
+	fprintf(fp, "void* gp4model_copy(const void* model)\n");
+	fprintf(fp, "{ return new State(*static_cast<const State*>(model)); }\n");
+	fprintf(fp, "\n");
+	fprintf(fp, "void gp4model_destroy(void* model)\n");
+	fprintf(fp, "{ delete static_cast<State*>(model); }\n");
+	fprintf(fp, "\n");
+	fprintf(fp, "void gp4model_reset(void* model)\n");
+	fprintf(fp, "{ Reset(static_cast<State*>(model)); }\n");
+	fprintf(fp, "\n");
+	fprintf(fp, "void gp4model_set_pin(void* model, unsigned int pin, int state)\n");
+	fprintf(fp, "{\n");
+	fprintf(fp, "\tState* m = static_cast<State*>(model);\n");
+	fprintf(fp, "\tif( (pin >= PIN_COUNT) || !HAS_PIN[pin] || (m->pinIn[pin] == state) )\n");
+	fprintf(fp, "\t\treturn;\n");
+	fprintf(fp, "\tm->pinIn[pin] = state;\n");
+	fprintf(fp, "\tSettle(m);\n");
+	fprintf(fp, "}\n");
+	fprintf(fp, "\n");
+	fprintf(fp, "int gp4model_get_pin(void* model, unsigned int pin)\n");
+	fprintf(fp, "{\n");
+	fprintf(fp, "\tif(pin >= PIN_COUNT)\n");
+	fprintf(fp, "\t\treturn PIN_FLOAT;\n");
+	fprintf(fp, "\treturn static_cast<State*>(model)->pinOut[pin];\n");
+	fprintf(fp, "}\n");
+	fprintf(fp, "\n");
+	fprintf(fp, "void gp4model_run_until(void* model, uint64_t time)\n");
+	fprintf(fp, "{ RunUntil(static_cast<State*>(model), time); }\n");
+	fprintf(fp, "\n");
+	fprintf(fp, "uint64_t gp4model_next_event(void* model)\n");
+	fprintf(fp, "{ return NextEvent(static_cast<State*>(model)); }\n");
+	fprintf(fp, "\n");
+	fprintf(fp, "}\n");
+}
@@ -0,0 +1,79 @@
+/***********************************************************************************************************************
+ * Copyright (C) 2016 Andrew Zonenberg and contributors                                                                *
+ *                                                                                                                     *
+ * This program is free software; you can redistribute it and/or modify it under the terms of the GNU Lesser General   *
+ * Public License as published by the Free Software Foundation; either version 2.1 of the License, or (at your option) *
+ * any later version.                                                                                                  *
+ *                                                                                                                     *
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied  *
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for     *
+ * more details.                                                                                                       *
+ *                                                                                                                     *
+ * You should have received a copy of the GNU Lesser General Public License along with this program; if not, you may   *
+ * find one here:                                                                                                      *
+ * https://www.gnu.org/licenses/old-licenses/lgpl-2.1.txt                                                              *
+ * or you may search the http://www.gnu.org website for the version 2.1 license, or you may write to the Free Software *
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA                                      *
+ **********************************************************************************************************************/
+
+#ifndef Greenpak4ModelGenerator_h
+#define Greenpak4ModelGenerator_h
+
+#include "Greenpak4Simulator.h"
+
+#include <cstdio>
+
+/**
+	@brief Turns a configured Greenpak4Device into straight-line C++, which Greenpak4CompiledModel can load once it's
+	been built as a shared object
+
+	This builds the same cells as Greenpak4Simulator, then puts the combinational ones in dependency order so each
+	settling pass is one sweep over them, with no event queue or dirty lists. All of the state lives in one struct, with
+	a few fields per flipflop, counter, shift register, delay line and oscillator. The generated code behaves like the
+	interpreted model, except that events at the same time all fire before anything settles, and a delay line can only
+	have a limited number of transitions in flight.
+
+	Combinational loops can't be compiled; use Greenpak4Simulator for those.
+ */
+class Greenpak4ModelGenerator : public Greenpak4Simulator
+{
+public:
+	Greenpak4ModelGenerator(Greenpak4Device* device);
+	virtual ~Greenpak4ModelGenerator();
+
+	bool Generate(FILE* fp, const std::string& description);
+
+	//Version of the interface generated models export (see Greenpak4CompiledModel)
+	static const unsigned int MODEL_VERSION = 2;
+
+protected:
+	bool SortCells(std::vector<uint32_t>& order);
+
+	void WriteState(FILE* fp);
+	void WriteCombinational(FILE* fp, const std::vector<uint32_t>& order);
+	void WriteClock(FILE* fp);
+	void WriteDelayClock(FILE* fp, uint32_t index);
+	void WriteDelayQueue(FILE* fp);
+	void WriteOutputs(FILE* fp);
+	void WriteEvents(FILE* fp);
+	void WriteReset(FILE* fp);
+	void WriteInterface(FILE* fp);
+
+	bool IsSequential(const Cell& cell)
+	{
+		return (cell.type != CELL_LUT) && (cell.type != CELL_INVERTER) &&
+			(cell.type != CELL_BUFFER) && (cell.type != CELL_IOB);
+	}
+
+	///True for cells that schedule things for later
+	bool IsTimed(const Cell& cell)
+	{ return (cell.type == CELL_OSCILLATOR) || (cell.type == CELL_POR) || (cell.type == CELL_DELAY); }
+
+	std::string Name(uint32_t cell);
+	std::string Signal(uint32_t signal);
+
+	///Number of pins (the highest pin number plus one)
+	unsigned int m_pinCount;
+};
+
+#endif
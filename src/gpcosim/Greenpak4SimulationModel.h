@@ -0,0 +1,92 @@
+/***********************************************************************************************************************
+ * Copyright (C) 2016 Andrew Zonenberg and contributors                                                                *
+ *                                                                                                                     *
+ * This program is free software; you can redistribute it and/or modify it under the terms of the GNU Lesser General   *
+ * Public License as published by the Free Software Foundation; either version 2.1 of the License, or (at your option) *
+ * any later version.                                                                                                  *
+ *                                                                                                                     *
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied  *
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for     *
+ * more details.                                                                                                       *
+ *                                                                                                                     *
+ * You should have received a copy of the GNU Lesser General Public License along with this program; if not, you may   *
+ * find one here:                                                                                                      *
+ * https://www.gnu.org/licenses/old-licenses/lgpl-2.1.txt                                                              *
+ * or you may search the http://www.gnu.org website for the version 2.1 license, or you may write to the Free Software *
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA                                      *
+ **********************************************************************************************************************/
+
+#ifndef Greenpak4SimulationModel_h
+#define Greenpak4SimulationModel_h
+
+#include <cstdint>
+
+/**
+	@brief Something that simulates a GreenPAK from its pins: the interpreted Greenpak4Simulator, or a model compiled
+	from a bitstream by gp4simgen and loaded with Greenpak4CompiledModel
+
+	All times are in picoseconds since power-up.
+ */
+class Greenpak4SimulationModel
+{
+public:
+	virtual ~Greenpak4SimulationModel()
+	{}
+
+	enum PinState
+	{
+		PIN_LOW,
+		PIN_HIGH,
+		PIN_FLOAT
+	};
+
+	virtual void Reset() =0;
+
+	/**
+		@brief Makes another instance of the same model, powered up with nothing driving its pins
+
+		The copy shares everything that doesn't change as the model runs (the device, or the loaded library) with this
+		one, so each thread of a parallel run can have its own without loading the design again.
+
+		@return The copy, or NULL (after saying why) if it couldn't be made
+	 */
+	virtual Greenpak4SimulationModel* Clone() =0;
+
+	/**
+		@brief Makes a copy of the model exactly as it is now: the time, everything scheduled, and the pin inputs
+
+		Like Clone(), the copy shares everything that doesn't change as the model runs, so taking one costs about as
+		much as copying the state. Run a model through power-on reset and start-up once, and each test can start from
+		a snapshot of it instead of simulating all of that again.
+
+		@return The copy, or NULL (after saying why) if it couldn't be made
+	 */
+	virtual Greenpak4SimulationModel* Snapshot() =0;
+
+	/**
+		@brief Sets what the outside world is driving onto a pin (nonexistent pins are ignored)
+	 */
+	virtual void SetPinInput(unsigned int pin, PinState state) =0;
+
+	/**
+		@brief Gets what the device is driving onto a pin (PIN_FLOAT if it isn't, or there's no such pin)
+	 */
+	virtual PinState GetPinOutput(unsigned int pin) =0;
+
+	/**
+		@brief Runs everything scheduled up to and including the given time
+	 */
+	virtual void RunUntil(uint64_t time) =0;
+
+	/**
+		@brief Gets when the next scheduled event is (NO_EVENT if nothing is scheduled)
+
+		Nothing changes between now and then unless the pin inputs do.
+	 */
+	virtual uint64_t GetNextEventTime() =0;
+
+	//Returned by GetNextEventTime() if nothing is scheduled
+	static const uint64_t NO_EVENT = UINT64_MAX;
+};
+
+#endif
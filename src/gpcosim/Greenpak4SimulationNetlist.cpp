@@ -0,0 +1,170 @@
+/***********************************************************************************************************************
+ * Copyright (C) 2016 Andrew Zonenberg and contributors                                                                *
+ *                                                                                                                     *
+ * This program is free software; you can redistribute it and/or modify it under the terms of the GNU Lesser General   *
+ * Public License as published by the Free Software Foundation; either version 2.1 of the License, or (at your option) *
+ * any later version.                                                                                                  *
+ *                                                                                                                     *
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied  *
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for     *
+ * more details.                                                                                                       *
+ *                                                                                                                     *
+ * You should have received a copy of the GNU Lesser General Public License along with this program; if not, you may   *
+ * find one here:                                                                                                      *
+ * https://www.gnu.org/licenses/old-licenses/lgpl-2.1.txt                                                              *
+ * or you may search the http://www.gnu.org website for the version 2.1 license, or you may write to the Free Software *
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA                                      *
+ **********************************************************************************************************************/
+
+
+#include "Greenpak4SimulationNetlist.h"
+#include <log.h>
+#include <set>
+
+using namespace std;
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Construction / destruction
+
+Greenpak4SimulationNetlist::Greenpak4SimulationNetlist(Greenpak4Device* device)
+	: m_device(device)
+{
+	m_ground = GetSignalIndex(device->GetGround());
+	m_power = GetSignalIndex(device->GetPower());
+	m_driven[m_ground] = true;
+	m_driven[m_power] = true;
+}
+
+Greenpak4SimulationNetlist::~Greenpak4SimulationNetlist()
+{
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Blocks
+
+/**
+	@brief Gets the block a device entity is simulated as
+
+	A paired entity is whichever of its two blocks it's configured as, but the matrix sees it as the pair (so we
+	remember which pair the block belongs to, for GetSignalIndex()).
+ */
+Greenpak4BitstreamEntity* Greenpak4SimulationNetlist::GetSimulatedEntity(Greenpak4BitstreamEntity* entity)
+{
+	if(auto pair = dynamic_cast<Greenpak4PairedEntity*>(entity))
+	{
+		entity = pair->GetActiveEntity();
+		m_pairs[entity] = pair;
+	}
+	return entity;
+}
+
+/**
+	@brief Gets what a LUT, inverter, cross connection, flipflop or latch reads and drives
+
+	The inputs are in the order the simulators keep them: a LUT's inputs from IN0 up, and D, CLK (nCLK for a latch)
+	and nSR for a flipflop (nSR is the power rail if it doesn't have one).
+
+	@return False for any other kind of block
+ */
+bool Greenpak4SimulationNetlist::GetLogicCell(
+	Greenpak4BitstreamEntity* entity,
+	CellType& type,
+	vector<Greenpak4EntityOutput>& inputs,
+	Greenpak4EntityOutput& output)
+{
+	inputs.clear();
+
+	if(auto lut = dynamic_cast<Greenpak4LUT*>(entity))
+	{
+		type = CELL_LUT;
+		for(unsigned int j=0; j<lut->GetOrder(); j++)
+			inputs.push_back(lut->GetInput(j));
+		output = lut->GetOutput("OUT");
+	}
+
+	else if(auto inv = dynamic_cast<Greenpak4Inverter*>(entity))
+	{
+		type = CELL_INVERTER;
+		inputs.push_back(inv->GetInput());
+		output = inv->GetOutput("OUT");
+	}
+
+	else if(auto xconn = dynamic_cast<Greenpak4CrossConnection*>(entity))
+	{
+		type = CELL_BUFFER;
+		inputs.push_back(xconn->GetInput());
+		output = xconn->GetOutput("O");
+	}
+
+	else if(auto ff = dynamic_cast<Greenpak4Flipflop*>(entity))
+	{
+		type = ff->IsLatch() ? CELL_LATCH : CELL_DFF;
+		inputs.push_back(ff->GetInput());
+		inputs.push_back(ff->GetClock());
+		inputs.push_back(ff->HasSetReset() ? ff->GetSetReset() : m_device->GetPower());
+		output = ff->GetOutput("Q");
+	}
+
+	else
+		return false;
+
+	return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Signals
+
+/**
+	@brief Gets the index of a signal, numbering it if we haven't seen it before
+
+	New signals get the next index up, so the simulators can grow their arrays to GetSignalCount().
+
+	Both outputs of a dual are the same signal. A block that isn't connected to anything is reading ground.
+ */
+uint32_t Greenpak4SimulationNetlist::GetSignalIndex(Greenpak4EntityOutput signal)
+{
+	if(signal.m_src == NULL)
+		return m_ground;
+
+	//Ports that go to the same net (like Q and nQ of a flipflop) are the same signal
+	Greenpak4BitstreamEntity* entity = signal.m_src->GetRealEntity();
+	auto pit = m_pairs.find(entity);
+	if(pit != m_pairs.end())
+		entity = pit->second;
+	unsigned int net = entity->GetOutputNetNumber(signal.m_port);
+	string name = (net != static_cast<unsigned int>(-1)) ? to_string(net) : signal.m_port;
+
+	auto key = pair<Greenpak4BitstreamEntity*, string>(entity, name);
+	auto it = m_signals.find(key);
+	if(it != m_signals.end())
+		return it->second;
+
+	uint32_t index = m_driven.size();
+	m_signals[key] = index;
+	m_driven.push_back(false);
+	m_loaded.push_back(false);
+	return index;
+}
+
+/**
+	@brief Warns about blocks we don't simulate that drive something we do
+
+	@param how	How this model simulates things, for the message ("" or " lane-parallel", say)
+ */
+void Greenpak4SimulationNetlist::WarnUnsimulated(const char* how)
+{
+	set<Greenpak4BitstreamEntity*> warned;
+	for(auto it : m_signals)
+	{
+		uint32_t signal = it.second;
+		if(m_driven[signal] || !m_loaded[signal])
+			continue;
+
+		Greenpak4BitstreamEntity* entity = it.first.first;
+		if(warned.find(entity) != warned.end())
+			continue;
+		warned.insert(entity);
+
+		LogWarning("%s isn't simulated%s, so its outputs will read as 0\n", entity->GetDescription().c_str(), how);
+	}
+}
@@ -0,0 +1,168 @@
+/***********************************************************************************************************************
+ * Copyright (C) 2016 Andrew Zonenberg and contributors                                                                *
+ *                                                                                                                     *
+ * This program is free software; you can redistribute it and/or modify it under the terms of the GNU Lesser General   *
+ * Public License as published by the Free Software Foundation; either version 2.1 of the License, or (at your option) *
+ * any later version.                                                                                                  *
+ *                                                                                                                     *
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied  *
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for     *
+ * more details.                                                                                                       *
+ *                                                                                                                     *
+ * You should have received a copy of the GNU Lesser General Public License along with this program; if not, you may   *
+ * find one here:                                                                                                      *
+ * https://www.gnu.org/licenses/old-licenses/lgpl-2.1.txt                                                              *
+ * or you may search the http://www.gnu.org website for the version 2.1 license, or you may write to the Free Software *
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA                                      *
+ **********************************************************************************************************************/
+
+
+#ifndef Greenpak4SimulationNetlist_h
+#define Greenpak4SimulationNetlist_h
+
+#include <Greenpak4.h>
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+/**
+	@brief The signals of a configured Greenpak4Device, numbered the way the simulators see them, and the blocks they
+	all simulate the same way
+
+	Greenpak4Simulator and Greenpak4VectorSimulator keep the value of each signal in an array, by the index this gives
+	it. It also remembers which signals something reads and drives, so they can warn about blocks they don't simulate.
+ */
+class Greenpak4SimulationNetlist
+{
+public:
+	Greenpak4SimulationNetlist(Greenpak4Device* device);
+	virtual ~Greenpak4SimulationNetlist();
+
+protected:
+	//Greenpak4VectorSimulator only has the ones up to CELL_LATCH
+	enum CellType
+	{
+		CELL_LUT,
+		CELL_INVERTER,
+		CELL_BUFFER,
+		CELL_IOB,
+		CELL_DFF,
+		CELL_LATCH,
+		CELL_COUNTER,
+		CELL_SHREG,
+		CELL_PGEN,
+		CELL_DELAY,
+		CELL_OSCILLATOR,
+		CELL_POR,
+		CELL_COMPARATOR,
+		CELL_BANDGAP
+	};
+
+	Greenpak4BitstreamEntity* GetSimulatedEntity(Greenpak4BitstreamEntity* entity);
+	bool GetLogicCell(
+		Greenpak4BitstreamEntity* entity,
+		CellType& type,
+		std::vector<Greenpak4EntityOutput>& inputs,
+		Greenpak4EntityOutput& output);
+
+	uint32_t GetSignalIndex(Greenpak4EntityOutput signal);
+
+	uint32_t GetSignalCount()
+	{ return m_driven.size(); }
+
+	void WarnUnsimulated(const char* how);
+
+	template<class Cell> int32_t SortCombinational(
+		const std::vector<Cell>& cells,
+		const std::vector<bool>& sequential,
+		std::vector<uint32_t>& order);
+
+	///The device we're simulating
+	Greenpak4Device* m_device;
+
+	///True for each signal some cell (or a power rail) drives
+	std::vector<bool> m_driven;
+
+	///True for each signal some cell reads
+	std::vector<bool> m_loaded;
+
+	///Index of each signal, by (real) source entity and net name
+	std::map<std::pair<Greenpak4BitstreamEntity*, std::string>, uint32_t> m_signals;
+
+	///The paired entity each active half of one belongs to
+	std::map<Greenpak4BitstreamEntity*, Greenpak4BitstreamEntity*> m_pairs;
+
+	///Index of the ground and power rails
+	uint32_t m_ground;
+	uint32_t m_power;
+};
+
+/**
+	@brief Puts the combinational cells in dependency order, so one pass over them settles all the logic
+
+	A combinational cell drives its first output straight from its inputs. Sequential cells (flipflops, oscillators and
+	so on) and the pins start new paths, so the only thing that can stop this is a loop of combinational cells.
+
+	@param cells		Every cell (anything with inputs and outputs, by signal index)
+	@param sequential	True for each cell that isn't combinational
+	@param order		The combinational cells, each one after everything that drives it
+
+	@return Index of a cell on a combinational loop, or -1 if there isn't one
+ */
+template<class Cell> int32_t Greenpak4SimulationNetlist::SortCombinational(
+	const std::vector<Cell>& cells,
+	const std::vector<bool>& sequential,
+	std::vector<uint32_t>& order)
+{
+	//Which combinational cells read each signal, and how many of each cell's inputs come from combinational cells
+	std::vector< std::vector<uint32_t> > loads(GetSignalCount());
+	std::vector<uint32_t> waiting(cells.size(), 0);
+	std::vector<bool> combinational(GetSignalCount(), false);
+	for(size_t i=0; i<cells.size(); i++)
+	{
+		if(!sequential[i])
+			combinational[cells[i].outputs[0]] = true;
+	}
+
+	std::vector<uint32_t> ready;
+	for(size_t i=0; i<cells.size(); i++)
+	{
+		if(sequential[i])
+			continue;
+
+		for(auto signal : cells[i].inputs)
+		{
+			if(!combinational[signal])
+				continue;
+			loads[signal].push_back(i);
+			waiting[i] ++;
+		}
+		if(waiting[i] == 0)
+			ready.push_back(i);
+	}
+
+	//Kahn's algorithm: a cell is ready once everything driving it has been evaluated
+	while(!ready.empty())
+	{
+		uint32_t c = ready.back();
+		ready.pop_back();
+		order.push_back(c);
+
+		for(auto load : loads[cells[c].outputs[0]])
+		{
+			if(--waiting[load] == 0)
+				ready.push_back(load);
+		}
+	}
+
+	for(size_t i=0; i<cells.size(); i++)
+	{
+		if(waiting[i] != 0)
+			return i;
+	}
+	return -1;
+}
+
+#endif
@@ -0,0 +1,1228 @@
+/***********************************************************************************************************************
+ * Copyright (C) 2016 Andrew Zonenberg and contributors                                                                *
+ *                                                                                                                     *
+ * This program is free software; you can redistribute it and/or modify it under the terms of the GNU Lesser General   *
+ * Public License as published by the Free Software Foundation; either version 2.1 of the License, or (at your option) *
+ * any later version.                                                                                                  *
+ *                                                                                                                     *
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied  *
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for     *
+ * more details.                                                                                                       *
+ *                                                                                                                     *
+ * You should have received a copy of the GNU Lesser General Public License along with this program; if not, you may   *
+ * find one here:                                                                                                      *
+ * https://www.gnu.org/licenses/old-licenses/lgpl-2.1.txt                                                              *
+ * or you may search the http://www.gnu.org website for the version 2.1 license, or you may write to the Free Software *
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA                                      *
+ **********************************************************************************************************************/
+
+#include "Greenpak4Simulator.h"
+#include <log.h>
+#include <cmath>
+
+using namespace std;
+
+//Nominal oscillator frequencies, in Hz
+static const double LFOSC_FREQUENCY = 1730;
+static const double RINGOSC_FREQUENCY = 27e6;
+static const double RCOSC_FAST_FREQUENCY = 2e6;
+static const double RCOSC_SLOW_FREQUENCY = 25e3;
+
+//Delay of each tap of a delay line, and the fixed part (same as the timing model uses), in ps
+static const uint64_t DELAY_TAP_TIME = 125000;
+static const uint64_t DELAY_BASE_TIME = 10000;
+
+//Supply voltage until told otherwise, in volts
+static const double DEFAULT_VDD = 3.3;
+
+//Give up settling after this many cell evaluations per cell (something must be oscillating)
+static const uint32_t SETTLE_LIMIT = 1000;
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Construction / destruction
+
+Greenpak4Simulator::Greenpak4Simulator(Greenpak4Device* device, bool analog)
+	: Greenpak4SimulationNetlist(device)
+	, m_analog(analog)
+	, m_vdd(DEFAULT_VDD)
+	, m_time(0)
+	, m_values(GetSignalCount(), false)
+	, m_loads(GetSignalCount())
+	, m_nextSeq(0)
+	, m_initializing(false)
+{
+}
+
+Greenpak4Simulator::~Greenpak4Simulator()
+{
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Building the model
+
+/**
+	@brief Creates a cell for every block in the device we know how to simulate, then resets it
+
+	@return False if there's nothing to simulate
+ */
+bool Greenpak4Simulator::Build()
+{
+	for(unsigned int i=0; i<m_device->GetEntityCount(); i++)
+	{
+		Greenpak4BitstreamEntity* entity = GetSimulatedEntity(m_device->GetEntity(i));
+
+		CellType type;
+		vector<Greenpak4EntityOutput> inputs;
+		Greenpak4EntityOutput output;
+		if(GetLogicCell(entity, type, inputs, output))
+		{
+			uint32_t c = AddCell(type, entity);
+			for(auto input : inputs)
+				AddInput(c, input);
+			AddOutput(c, output);
+		}
+
+		else if(auto iob = dynamic_cast<Greenpak4IOB*>(entity))
+		{
+			//An analog output floats the digital driver
+			bool analog = m_analog && !iob->GetAnalogOutput().IsPowerRail();
+
+			uint32_t c = AddCell(CELL_IOB, iob);
+			AddInput(c, analog ? m_device->GetGround() : iob->GetOutputSignal());
+			AddInput(c, analog ? m_device->GetGround() : iob->GetOutputEnable());
+			AddOutput(c, iob->GetOutput("OUT"));
+			m_cells[c].state = PIN_FLOAT;
+
+			unsigned int pin = iob->GetPinNumber();
+			if(pin >= m_pinCells.size())
+			{
+				m_pinCells.resize(pin + 1, -1);
+				m_pinInputs.resize(pin + 1, PIN_FLOAT);
+				m_pinVoltages.resize(pin + 1, NAN);
+				m_pinAnalog.resize(pin + 1, false);
+			}
+			m_pinCells[pin] = c;
+			m_pinAnalog[pin] = analog;
+		}
+
+		else if(auto count = dynamic_cast<Greenpak4Counter*>(entity))
+		{
+			uint32_t c = AddCell(CELL_COUNTER, count);
+			AddInput(c, count->GetClock());
+			AddInput(c, count->GetReset());
+			AddInput(c, count->HasFSM() ? count->GetUp() : m_device->GetGround());
+			AddInput(c, count->HasFSM() ? count->GetKeep() : m_device->GetGround());
+			AddOutput(c, count->GetOutput("OUT"));
+		}
+
+		else if(auto shreg = dynamic_cast<Greenpak4ShiftRegister*>(entity))
+		{
+			uint32_t c = AddCell(CELL_SHREG, shreg);
+			AddInput(c, shreg->GetClock());
+			AddInput(c, shreg->GetInput());
+			AddInput(c, shreg->GetReset());
+			AddOutput(c, shreg->GetOutput("OUTA"));
+			AddOutput(c, shreg->GetOutput("OUTB"));
+		}
+
+		else if(auto pgen = dynamic_cast<Greenpak4PatternGenerator*>(entity))
+		{
+			uint32_t c = AddCell(CELL_PGEN, pgen);
+			AddInput(c, pgen->GetClock());
+			AddInput(c, pgen->GetReset());
+			AddOutput(c, pgen->GetOutput("OUT"));
+		}
+
+		else if(auto delay = dynamic_cast<Greenpak4Delay*>(entity))
+		{
+			uint32_t c = AddCell(CELL_DELAY, delay);
+			AddInput(c, delay->GetInput());
+			AddOutput(c, delay->GetOutput("OUT"));
+			m_cells[c].delay = DELAY_BASE_TIME + DELAY_TAP_TIME*delay->GetDelayTap();
+		}
+
+		else if(auto lfosc = dynamic_cast<Greenpak4LFOscillator*>(entity))
+			AddOscillator(lfosc, LFOSC_FREQUENCY, lfosc->GetOutputDivider(), 1, "CLKOUT", NULL);
+
+		else if(auto ringosc = dynamic_cast<Greenpak4RingOscillator*>(entity))
+		{
+			AddOscillator(ringosc, RINGOSC_FREQUENCY, ringosc->GetPreDivider(), ringosc->GetPostDivider(),
+				"CLKOUT_HARDIP", "CLKOUT_FABRIC");
+		}
+
+		else if(auto rcosc = dynamic_cast<Greenpak4RCOscillator*>(entity))
+		{
+			AddOscillator(rcosc, rcosc->IsFastClock() ? RCOSC_FAST_FREQUENCY : RCOSC_SLOW_FREQUENCY,
+				rcosc->GetPreDivider(), rcosc->GetPostDivider(), "CLKOUT_HARDIP", "CLKOUT_FABRIC");
+		}
+
+		else if(auto por = dynamic_cast<Greenpak4PowerOnReset*>(entity))
+		{
+			uint32_t c = AddCell(CELL_POR, por);
+			AddOutput(c, por->GetOutput("RST_DONE"));
+			m_cells[c].delay = por->GetResetDelay() * 1000000ULL;
+		}
+
+		else if(auto acmp = dynamic_cast<Greenpak4Comparator*>(entity))
+		{
+			if(m_analog)
+				AddComparator(acmp);
+		}
+
+		else if(auto bandgap = dynamic_cast<Greenpak4Bandgap*>(entity))
+		{
+			if(m_analog)
+			{
+				uint32_t c = AddCell(CELL_BANDGAP, bandgap);
+				AddOutput(c, bandgap->GetOutput("OK"));
+				m_cells[c].delay = bandgap->GetOutputDelay() * 1000000ULL;
+			}
+		}
+
+		//Power rails are constants, and everything else isn't simulated
+	}
+
+	if(m_cells.empty())
+	{
+		LogError("Nothing to simulate in this device\n");
+		return false;
+	}
+
+	WarnUnsimulated("");
+	FindFastForwards();
+	Reset();
+	return true;
+}
+
+/**
+	@brief Finds the oscillators that only clock counters
+
+	Between the edges where one of its counters' outputs changes, nothing can see what such an oscillator is doing, so
+	we don't simulate those edges one by one (see FastForward()). This is what makes it practical to simulate a slow
+	clock divided down by a long counter for seconds at a time.
+ */
+void Greenpak4Simulator::FindFastForwards()
+{
+	for(size_t i=0; i<m_cells.size(); i++)
+	{
+		Cell& osc = m_cells[i];
+		if(osc.type != CELL_OSCILLATOR)
+			continue;
+
+		bool counters_only = true;
+		for(auto output : osc.outputs)
+		{
+			for(auto load : m_loads[output])
+			{
+				const Cell& cell = m_cells[load];
+				if(cell.type != CELL_COUNTER)
+					counters_only = false;
+				for(size_t j=1; j<cell.inputs.size(); j++)
+				{
+					if(cell.inputs[j] == output)
+						counters_only = false;
+				}
+			}
+		}
+		if(!counters_only)
+			continue;
+
+		osc.fastForward = true;
+		for(size_t j=0; j<osc.outputs.size(); j++)
+		{
+			for(auto load : m_loads[osc.outputs[j]])
+			{
+				m_cells[load].clockedBy = i;
+				m_cells[load].clockDivide = (j == 0) ? 1 : osc.divide;
+			}
+		}
+	}
+}
+
+/**
+	@brief Gets the index of a signal (see Greenpak4SimulationNetlist::GetSignalIndex())
+ */
+uint32_t Greenpak4Simulator::GetSignal(Greenpak4EntityOutput signal)
+{
+	uint32_t index = GetSignalIndex(signal);
+	if(index >= m_values.size())
+	{
+		m_values.resize(index + 1, false);
+		m_loads.resize(index + 1);
+	}
+	return index;
+}
+
+uint32_t Greenpak4Simulator::AddCell(CellType type, Greenpak4BitstreamEntity* entity)
+{
+	m_cells.push_back(Cell(type, entity));
+	m_queued.push_back(false);
+	return m_cells.size() - 1;
+}
+
+void Greenpak4Simulator::AddInput(uint32_t cell, Greenpak4EntityOutput signal)
+{
+	uint32_t index = GetSignal(signal);
+	m_loaded[index] = true;
+	m_loads[index].push_back(cell);
+	m_cells[cell].inputs.push_back(index);
+	m_cells[cell].lastInputs.push_back(false);
+}
+
+void Greenpak4Simulator::AddOutput(uint32_t cell, Greenpak4EntityOutput signal)
+{
+	AddOutput(cell, GetSignal(signal));
+}
+
+void Greenpak4Simulator::AddOutput(uint32_t cell, uint32_t signal)
+{
+	m_driven[signal] = true;
+	m_cells[cell].outputs.push_back(signal);
+}
+
+/**
+	@brief Adds an oscillator, whose hard IP output runs at frequency/prediv and fabric output at that over postdiv
+ */
+void Greenpak4Simulator::AddOscillator(
+	Greenpak4BitstreamEntity* entity,
+	double frequency,
+	int prediv,
+	int postdiv,
+	const char* hardport,
+	const char* fabricport)
+{
+	//All of the oscillators have the same power-down interface, but no common base class
+	Greenpak4EntityOutput powerdown = m_device->GetGround();
+	if(auto lfosc = dynamic_cast<Greenpak4LFOscillator*>(entity))
+	{
+		if(lfosc->GetPowerDownEn())
+			powerdown = lfosc->GetPowerDown();
+	}
+	else if(auto ringosc = dynamic_cast<Greenpak4RingOscillator*>(entity))
+	{
+		if(ringosc->GetPowerDownEn())
+			powerdown = ringosc->GetPowerDown();
+	}
+	else if(auto rcosc = dynamic_cast<Greenpak4RCOscillator*>(entity))
+	{
+		if(rcosc->GetPowerDownEn())
+			powerdown = rcosc->GetPowerDown();
+	}
+
+	uint32_t c = AddCell(CELL_OSCILLATOR, entity);
+	AddInput(c, powerdown);
+	AddOutput(c, entity->GetOutput(hardport));
+	if(fabricport != NULL)
+		AddOutput(c, entity->GetOutput(fabricport));
+
+	m_cells[c].delay = static_cast<uint64_t>(1e12 / (2 * frequency / prediv) + 0.5);
+	m_cells[c].divide = postdiv;
+}
+
+/**
+	@brief Adds a comparator, which reads PWREN and everything digital its VIN and VREF depend on
+ */
+void Greenpak4Simulator::AddComparator(Greenpak4Comparator* acmp)
+{
+	uint32_t c = AddCell(CELL_COMPARATOR, acmp);
+	AddInput(c, acmp->GetPowerEn());
+	AddAnalogInputs(c, acmp->GetInput());
+	AddAnalogInputs(c, acmp->GetVref());
+	AddOutput(c, acmp->GetOutput("OUT"));
+	m_comparators.push_back(c);
+}
+
+/**
+	@brief Adds the digital signals an analog voltage depends on as inputs of a cell, so it's evaluated when they change
+
+	That's the pins the voltage comes from (whose digital state is their voltage, unless we've been given one), the
+	DAC codes and the PGA input selector.
+ */
+void Greenpak4Simulator::AddAnalogInputs(uint32_t cell, Greenpak4EntityOutput source)
+{
+	if( (source.m_src == NULL) || source.IsPowerRail() )
+		return;
+
+	Greenpak4BitstreamEntity* entity = source.GetRealEntity();
+	if(auto iob = dynamic_cast<Greenpak4IOB*>(entity))
+	{
+		AddInput(cell, iob->GetOutput("OUT"));
+		AddAnalogInputs(cell, iob->GetAnalogOutput());
+	}
+	else if(auto vref = dynamic_cast<Greenpak4VoltageReference*>(entity))
+		AddAnalogInputs(cell, vref->GetInput());
+	else if(auto dac = dynamic_cast<Greenpak4DAC*>(entity))
+	{
+		for(unsigned int i=0; i<8; i++)
+			AddInput(cell, dac->GetDataInput(i));
+		AddAnalogInputs(cell, dac->GetVref());
+	}
+	else if(auto pga = dynamic_cast<Greenpak4PGA*>(entity))
+	{
+		AddInput(cell, pga->GetInputSel());
+		AddAnalogInputs(cell, pga->GetInputP());
+		AddAnalogInputs(cell, pga->GetInputN());
+	}
+	else if(auto abuf = dynamic_cast<Greenpak4Abuf*>(entity))
+		AddAnalogInputs(cell, abuf->GetInput());
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Stimulus and results
+
+/**
+	@brief Copies a built model (the device is shared, and only read while simulating)
+ */
+Greenpak4Simulator* Greenpak4Simulator::Clone()
+{
+	Greenpak4Simulator* sim = new Greenpak4Simulator(*this);
+	sim->m_pinInputs.assign(m_pinInputs.size(), PIN_FLOAT);
+	sim->m_pinVoltages.assign(m_pinVoltages.size(), NAN);
+	sim->Reset();
+	return sim;
+}
+
+/**
+	@brief Makes a copy of the simulation in its current state (see Greenpak4SimulationModel::Snapshot())
+ */
+Greenpak4Simulator* Greenpak4Simulator::Snapshot()
+{
+	return new Greenpak4Simulator(*this);
+}
+
+/**
+	@brief Powers the device back up: every block goes back to its initial state, and time goes back to zero
+ */
+void Greenpak4Simulator::Reset()
+{
+	m_time = 0;
+	m_events = priority_queue<Event>();
+	m_nextSeq = 0;
+	m_dirty.clear();
+	m_pending.clear();
+
+	m_values.assign(m_values.size(), false);
+	m_values[m_power] = true;
+
+	for(size_t i=0; i<m_cells.size(); i++)
+	{
+		Cell& cell = m_cells[i];
+		cell.lastInputs.assign(cell.inputs.size(), false);
+		cell.phase = 0;
+		cell.generation ++;
+		m_queued[i] = false;
+
+		switch(cell.type)
+		{
+			case CELL_DFF:
+			case CELL_LATCH:
+				cell.state = static_cast<Greenpak4Flipflop*>(cell.entity)->GetInitValue();
+				break;
+
+			case CELL_COUNTER:
+				cell.state = static_cast<Greenpak4Counter*>(cell.entity)->GetCountValue();
+				break;
+
+			case CELL_POR:
+			case CELL_BANDGAP:
+				Schedule(i, cell.delay, true);
+				cell.state = 0;
+				break;
+
+			case CELL_IOB:
+				cell.state = PIN_FLOAT;
+				break;
+
+			default:
+				cell.state = 0;
+				break;
+		}
+
+		m_dirty.push_back(i);
+		m_queued[i] = true;
+	}
+
+	//Find the power-up value of everything without clocking anything...
+	m_initializing = true;
+	Settle();
+	m_initializing = false;
+
+	//...then let the asynchronous resets take effect
+	for(size_t i=0; i<m_cells.size(); i++)
+	{
+		m_dirty.push_back(i);
+		m_queued[i] = true;
+	}
+	Settle();
+}
+
+/**
+	@brief Sets what the outside world is driving onto a pin
+
+	If the device is driving the pin itself, that wins. Nonexistent pins are ignored. Any voltage set by
+	SetPinVoltage() is forgotten, so the pin's voltage follows the state from now on.
+ */
+void Greenpak4Simulator::SetPinInput(unsigned int pin, PinState state)
+{
+	if( (pin >= m_pinCells.size()) || (m_pinCells[pin] < 0) )
+		return;
+	if(!std::isnan(m_pinVoltages[pin]))
+	{
+		m_pinVoltages[pin] = NAN;
+		DirtyComparators();
+	}
+	if(m_pinInputs[pin] == state)
+	{
+		Settle();
+		return;
+	}
+
+	m_pinInputs[pin] = state;
+	uint32_t cell = m_pinCells[pin];
+	if(!m_queued[cell])
+	{
+		m_dirty.push_back(cell);
+		m_queued[cell] = true;
+	}
+	Settle();
+}
+
+/**
+	@brief Gets what the device is driving onto a pin (PIN_FLOAT if it isn't, or there's no such pin)
+ */
+Greenpak4Simulator::PinState Greenpak4Simulator::GetPinOutput(unsigned int pin)
+{
+	if( (pin >= m_pinCells.size()) || (m_pinCells[pin] < 0) )
+		return PIN_FLOAT;
+	return static_cast<PinState>(m_cells[m_pinCells[pin]].state);
+}
+
+/**
+	@brief Gets the current value of a signal (false for anything we don't simulate)
+ */
+bool Greenpak4Simulator::GetValue(Greenpak4EntityOutput signal)
+{
+	FastForwardAll();
+	Settle();
+	return m_values[GetSignal(signal)];
+}
+
+/**
+	@brief Sets the voltage the outside world is driving onto a pin
+
+	The digital input buffer sees it as high above Vdd/2. If the device is driving the pin itself, that still wins.
+ */
+void Greenpak4Simulator::SetPinVoltage(unsigned int pin, double voltage)
+{
+	if( (pin >= m_pinCells.size()) || (m_pinCells[pin] < 0) )
+		return;
+
+	SetPinInput(pin, (voltage > m_vdd / 2) ? PIN_HIGH : PIN_LOW);
+	m_pinVoltages[pin] = voltage;
+	DirtyComparators();
+	Settle();
+}
+
+/**
+	@brief Gets the voltage on a pin, from whatever is driving it (0 if there's no such pin)
+ */
+double Greenpak4Simulator::GetPinVoltage(unsigned int pin)
+{
+	FastForwardAll();
+	Settle();
+	return EvaluatePinVoltage(pin);
+}
+
+/**
+	@brief Gets the current voltage of an analog signal (or a digital one, as 0 V or Vdd)
+ */
+double Greenpak4Simulator::GetVoltage(Greenpak4EntityOutput signal)
+{
+	FastForwardAll();
+	Settle();
+	return EvaluateVoltage(signal);
+}
+
+/**
+	@brief Changes the supply voltage, which the Vdd dividers and anything reading a digital signal as a voltage use
+ */
+void Greenpak4Simulator::SetSupplyVoltage(double vdd)
+{
+	m_vdd = vdd;
+	DirtyComparators();
+	Settle();
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Time
+
+/**
+	@brief Runs everything scheduled up to and including the given time
+ */
+void Greenpak4Simulator::RunUntil(uint64_t time)
+{
+	while(GetNextEventTime() <= time)
+	{
+		Event event = m_events.top();
+		m_events.pop();
+
+		m_time = event.time;
+		FireEvent(event);
+		Settle();
+	}
+
+	if(time > m_time)
+		m_time = time;
+}
+
+/**
+	@brief Gets when the next scheduled event is (NO_EVENT if nothing is scheduled)
+
+	Nothing changes between now and then unless the pin inputs do.
+ */
+uint64_t Greenpak4Simulator::GetNextEventTime()
+{
+	//Drop anything that's been cancelled
+	while(!m_events.empty())
+	{
+		const Event& event = m_events.top();
+		if(event.generation == m_cells[event.cell].generation)
+			return event.time;
+		m_events.pop();
+	}
+	return NO_EVENT;
+}
+
+void Greenpak4Simulator::Schedule(uint32_t cell, uint64_t delay, bool value)
+{
+	m_events.push(Event(m_time + delay, m_nextSeq++, cell, m_cells[cell].generation, value));
+}
+
+void Greenpak4Simulator::FireEvent(const Event& event)
+{
+	Cell& cell = m_cells[event.cell];
+	switch(cell.type)
+	{
+		//Oscillators toggle the hard IP output every half period, and the fabric output every postdiv of those
+		case CELL_OSCILLATOR:
+			if(cell.fastForward)
+			{
+				FastForward(event.cell);
+				ScheduleFastForward(event.cell);
+				break;
+			}
+			cell.state ++;
+			SetSignal(cell.outputs[0], cell.state & 1);
+			if(cell.outputs.size() > 1)
+				SetSignal(cell.outputs[1], (cell.state / cell.divide) & 1);
+			Schedule(event.cell, cell.delay, false);
+			break;
+
+		//Delay lines, edge detectors, the power-on reset and the bandgap just change their output
+		default:
+			SetSignal(cell.outputs[0], event.value);
+			break;
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Evaluation
+
+/**
+	@brief Changes a signal at the end of the current delta cycle (see Settle())
+ */
+void Greenpak4Simulator::SetSignal(uint32_t signal, bool value)
+{
+	m_pending.push_back(pair<uint32_t, bool>(signal, value));
+}
+
+/**
+	@brief Evaluates cells until nothing changes any more
+
+	This goes in delta cycles: every cell whose inputs changed is evaluated against the same values, and only then do
+	their outputs change. That way everything clocked by the same edge sees the values from before it, as in hardware.
+ */
+void Greenpak4Simulator::Settle()
+{
+	uint64_t limit = static_cast<uint64_t>(SETTLE_LIMIT) * m_cells.size();
+	uint64_t evaluations = 0;
+	vector<uint32_t> batch;
+	while(!m_pending.empty() || !m_dirty.empty())
+	{
+		//Apply the last delta's changes, and queue everything they affect
+		for(auto change : m_pending)
+		{
+			if(m_values[change.first] == change.second)
+				continue;
+			m_values[change.first] = change.second;
+
+			for(auto load : m_loads[change.first])
+			{
+				if(!m_queued[load])
+				{
+					m_dirty.push_back(load);
+					m_queued[load] = true;
+				}
+			}
+		}
+		m_pending.clear();
+
+		if(evaluations > limit)
+		{
+			LogWarning("Combinational loop didn't settle at %.3f us, giving up\n", m_time / 1e6);
+			for(auto cell : m_dirty)
+				m_queued[cell] = false;
+			m_dirty.clear();
+			return;
+		}
+
+		batch.swap(m_dirty);
+		for(auto cell : batch)
+			m_queued[cell] = false;
+		for(auto cell : batch)
+			Evaluate(cell);
+		evaluations += batch.size();
+		batch.clear();
+	}
+}
+
+void Greenpak4Simulator::Evaluate(uint32_t index)
+{
+	Cell& cell = m_cells[index];
+	switch(cell.type)
+	{
+		case CELL_LUT:
+			{
+				unsigned int row = 0;
+				for(size_t i=0; i<cell.inputs.size(); i++)
+					row |= Input(cell, i) << i;
+				SetSignal(cell.outputs[0], static_cast<Greenpak4LUT*>(cell.entity)->GetTruthTableBit(row));
+			}
+			break;
+
+		case CELL_INVERTER:
+			SetSignal(cell.outputs[0], !Input(cell, 0));
+			break;
+
+		case CELL_BUFFER:
+			SetSignal(cell.outputs[0], Input(cell, 0));
+			break;
+
+		case CELL_IOB:
+			EvaluateIOB(cell);
+			break;
+
+		//Inputs are D, CLK (nCLK for a latch), nSR
+		case CELL_DFF:
+		case CELL_LATCH:
+			{
+				auto ff = static_cast<Greenpak4Flipflop*>(cell.entity);
+				if(!m_initializing)
+				{
+					if(!Input(cell, 2))
+						cell.state = ff->GetSetResetMode();
+					else if( (cell.type == CELL_DFF) ? Rose(cell, 1) : !Input(cell, 1) )
+						cell.state = Input(cell, 0);
+				}
+				SetSignal(cell.outputs[0], cell.state ^ ff->IsOutputInverted());
+			}
+			break;
+
+		case CELL_COUNTER:
+			EvaluateCounter(cell);
+			break;
+
+		//Inputs are CLK, IN, nRST
+		case CELL_SHREG:
+			{
+				auto shreg = static_cast<Greenpak4ShiftRegister*>(cell.entity);
+				if(!m_initializing)
+				{
+					if(!Input(cell, 2))
+						cell.state = 0;
+					else if(Rose(cell, 0))
+						cell.state = ((cell.state << 1) | Input(cell, 1)) & 0xffff;
+				}
+				bool a = (cell.state >> (shreg->GetDelayA() - 1)) & 1;
+				SetSignal(cell.outputs[0], a ^ shreg->IsInvertA());
+				SetSignal(cell.outputs[1], (cell.state >> (shreg->GetDelayB() - 1)) & 1);
+			}
+			break;
+
+		//Inputs are CLK, nRST. Each clock moves on to the next bit of the pattern, starting from bit 0
+		case CELL_PGEN:
+			{
+				auto pgen = static_cast<Greenpak4PatternGenerator*>(cell.entity);
+				if(!m_initializing)
+				{
+					if(!Input(cell, 1))
+						cell.state = 0;
+					else if(Rose(cell, 0))
+						cell.state = (cell.state + 1) % pgen->GetPatternLength();
+				}
+				SetSignal(cell.outputs[0], pgen->GetPatternBit(cell.state));
+			}
+			break;
+
+		case CELL_DELAY:
+			{
+				bool value = Input(cell, 0);
+				auto mode = static_cast<Greenpak4Delay*>(cell.entity)->GetMode();
+				if(mode == Greenpak4Delay::DELAY)
+				{
+					if(m_initializing)
+						SetSignal(cell.outputs[0], value);
+					else if(value != cell.lastInputs[0])
+						Schedule(index, cell.delay, value);
+				}
+
+				//Edge detectors put out a pulse as long as the delay, starting over on each edge
+				else if(!m_initializing)
+				{
+					bool rose = Rose(cell, 0);
+					bool fell = Fell(cell, 0);
+					if( (rose && (mode != Greenpak4Delay::FALLING_EDGE)) ||
+						(fell && (mode != Greenpak4Delay::RISING_EDGE)) )
+					{
+						cell.generation ++;
+						SetSignal(cell.outputs[0], true);
+						Schedule(index, cell.delay, false);
+					}
+				}
+			}
+			break;
+
+		//Input is the power-down signal
+		case CELL_OSCILLATOR:
+			EvaluateOscillator(index);
+			break;
+
+		case CELL_COMPARATOR:
+			EvaluateComparator(cell);
+			break;
+
+		case CELL_POR:
+		case CELL_BANDGAP:
+			break;
+	}
+
+	for(size_t i=0; i<cell.inputs.size(); i++)
+		cell.lastInputs[i] = Input(cell, i);
+	//A counter's new inputs can change when its fast-forwarded clock next needs to stop
+	if( (cell.type == CELL_COUNTER) && (cell.clockedBy >= 0) )
+		ScheduleFastForward(cell.clockedBy);
+}
+
+/**
+	@brief Works out what an IOB is driving onto its pin, and what its input buffer sees
+
+	Inputs are IN (what to drive) and OE.
+ */
+void Greenpak4Simulator::EvaluateIOB(Cell& cell)
+{
+	auto iob = static_cast<Greenpak4IOB*>(cell.entity);
+
+	PinState driven = PIN_FLOAT;
+	if(Input(cell, 1))
+	{
+		bool value = Input(cell, 0);
+		switch(iob->GetDriveType())
+		{
+			case Greenpak4IOB::DRIVE_PUSHPULL:
+				driven = value ? PIN_HIGH : PIN_LOW;
+				break;
+
+			case Greenpak4IOB::DRIVE_NMOS_OPENDRAIN:
+				driven = value ? PIN_FLOAT : PIN_LOW;
+				break;
+
+			case Greenpak4IOB::DRIVE_PMOS_OPENDRAIN:
+				driven = value ? PIN_HIGH : PIN_FLOAT;
+				break;
+		}
+	}
+	cell.state = driven;
+
+	//We win over the outside world, and the outside world wins over the pull resistor
+	PinState pin = driven;
+	if(pin == PIN_FLOAT)
+		pin = m_pinInputs[iob->GetPinNumber()];
+	if(pin == PIN_FLOAT)
+		pin = (iob->GetPullDirection() == Greenpak4IOB::PULL_UP) ? PIN_HIGH : PIN_LOW;
+
+	SetSignal(cell.outputs[0], pin == PIN_HIGH);
+}
+
+/**
+	@brief Compares a comparator's attenuated VIN against VREF
+
+	Input 0 is PWREN (the others just tell us VIN or VREF may have changed). With hysteresis, the output goes high once
+	VIN is above VREF, and only goes low again once VIN is below VREF minus the hysteresis.
+ */
+void Greenpak4Simulator::EvaluateComparator(Cell& cell)
+{
+	auto acmp = static_cast<Greenpak4Comparator*>(cell.entity);
+	if(!Input(cell, 0))
+		cell.state = 0;
+	else
+	{
+		double vin = EvaluateVoltage(acmp->GetInput()) / acmp->GetAttenuation();
+		double vref = EvaluateVoltage(acmp->GetVref());
+		if(cell.state)
+			vref -= acmp->GetHysteresis() / 1000.0;
+		cell.state = (vin > vref);
+	}
+	SetSignal(cell.outputs[0], cell.state);
+}
+
+/**
+	@brief Works out the voltage of an analog signal from the current digital state, and the pin voltages
+
+	Everything is ideal: references are exact, the DAC's full scale code is VREF, and the PGA clips at the rails.
+ */
+double Greenpak4Simulator::EvaluateVoltage(Greenpak4EntityOutput signal)
+{
+	if(signal.m_src == NULL)
+		return 0;
+	if(signal.IsPowerRail())
+		return signal.GetPowerRailValue() ? m_vdd : 0;
+
+	Greenpak4BitstreamEntity* entity = signal.GetRealEntity();
+	if(auto iob = dynamic_cast<Greenpak4IOB*>(entity))
+		return EvaluatePinVoltage(iob->GetPinNumber());
+
+	else if(auto vref = dynamic_cast<Greenpak4VoltageReference*>(entity))
+	{
+		if(vref->IsConstantVoltage())
+			return vref->GetOutputVoltage() / 1000.0;
+		return EvaluateVoltage(vref->GetInput()) / vref->GetDivisor();
+	}
+
+	else if(auto dac = dynamic_cast<Greenpak4DAC*>(entity))
+	{
+		unsigned int code = 0;
+		for(unsigned int i=0; i<8; i++)
+		{
+			if(m_values[GetSignal(dac->GetDataInput(i))])
+				code |= 1 << i;
+		}
+		return EvaluateVoltage(dac->GetVref()) * code / 255;
+	}
+
+	//Single ended, VIN_SEL picks VIN_P (high) or VIN_N (low)
+	else if(auto pga = dynamic_cast<Greenpak4PGA*>(entity))
+	{
+		double vin;
+		double vp = EvaluateVoltage(pga->GetInputP());
+		double vn = EvaluateVoltage(pga->GetInputN());
+		if(pga->GetInputMode() == Greenpak4PGA::MODE_SINGLE)
+			vin = m_values[GetSignal(pga->GetInputSel())] ? vp : vn;
+		else
+			vin = vp - vn;
+
+		double vout = vin * pga->GetGain() / 100;
+		if(vout < 0)
+			return 0;
+		if(vout > m_vdd)
+			return m_vdd;
+		return vout;
+	}
+
+	else if(auto abuf = dynamic_cast<Greenpak4Abuf*>(entity))
+		return EvaluateVoltage(abuf->GetInput());
+
+	//Anything else is digital
+	return m_values[GetSignal(signal)] ? m_vdd : 0;
+}
+
+/**
+	@brief Works out the voltage on a pin: an analog block driving it, then the device's digital driver, then what the
+	outside world is driving (which is its digital state, unless SetPinVoltage() gave a voltage)
+ */
+double Greenpak4Simulator::EvaluatePinVoltage(unsigned int pin)
+{
+	if( (pin >= m_pinCells.size()) || (m_pinCells[pin] < 0) )
+		return 0;
+
+	const Cell& cell = m_cells[m_pinCells[pin]];
+	if(m_pinAnalog[pin])
+		return EvaluateVoltage(static_cast<Greenpak4IOB*>(cell.entity)->GetAnalogOutput());
+	if( (cell.state == PIN_FLOAT) && !std::isnan(m_pinVoltages[pin]) )
+		return m_pinVoltages[pin];
+	return m_values[cell.outputs[0]] ? m_vdd : 0;
+}
+
+/**
+	@brief Queues every comparator to be evaluated, after a voltage changed without any digital signal changing
+ */
+void Greenpak4Simulator::DirtyComparators()
+{
+	for(auto c : m_comparators)
+	{
+		if(!m_queued[c])
+		{
+			m_dirty.push_back(c);
+			m_queued[c] = true;
+		}
+	}
+}
+
+/**
+	@brief Steps a counter on its clock, and handles its reset
+
+	Inputs are CLK (from an oscillator), RST, UP and KEEP (ground if the counter has no FSM). Counting down, we reload
+	COUNT_TO after reaching zero, and the output is high while the count is zero. Counting up, we reload after reaching
+	the maximum value, and the output is high while the count is at the maximum.
+ */
+void Greenpak4Simulator::EvaluateCounter(Cell& cell)
+{
+	auto count = static_cast<Greenpak4Counter*>(cell.entity);
+	uint32_t max = (1 << count->GetDepth()) - 1;
+	bool up = Input(cell, 2);
+
+	//Catch up on the clock edges we skipped, before anything changes
+	if(cell.clockedBy >= 0)
+		FastForward(cell.clockedBy);
+
+	if(!m_initializing)
+	{
+		bool reset = false;
+		switch(count->GetResetMode())
+		{
+			case Greenpak4Counter::HIGH_LEVEL:
+				reset = Input(cell, 1);
+				break;
+
+			case Greenpak4Counter::RISING_EDGE:
+				reset = Rose(cell, 1);
+				break;
+
+			case Greenpak4Counter::FALLING_EDGE:
+				reset = Fell(cell, 1);
+				break;
+
+			case Greenpak4Counter::BOTH_EDGE:
+				reset = Rose(cell, 1) || Fell(cell, 1);
+				break;
+		}
+
+		if(reset)
+		{
+			cell.state = (count->GetResetValue() == Greenpak4Counter::ZERO) ? 0 : count->GetCountValue();
+			cell.phase = 0;
+		}
+
+		else if(Rose(cell, 0) && (++cell.phase >= count->GetPreDivide()))
+		{
+			cell.phase = 0;
+			if(Input(cell, 3))
+			{
+				//KEEP holds the count
+			}
+			else if(up)
+				cell.state = (cell.state == max) ? count->GetCountValue() : cell.state + 1;
+			else
+				cell.state = (cell.state == 0) ? count->GetCountValue() : cell.state - 1;
+		}
+	}
+
+	SetSignal(cell.outputs[0], up ? (cell.state == max) : (cell.state == 0));
+}
+
+/**
+	@brief Starts or stops an oscillator when its power-down input changes
+ */
+void Greenpak4Simulator::EvaluateOscillator(uint32_t index)
+{
+	Cell& cell = m_cells[index];
+	bool running = !Input(cell, 0);
+	if(running == static_cast<bool>(cell.phase))
+		return;
+
+	//Counters we're clocking need to count the edges up to now
+	if(cell.fastForward)
+		FastForward(index);
+	cell.phase = running;
+
+	//Stopping cancels the next edge, and the outputs go low
+	cell.generation ++;
+	cell.state = 0;
+	for(auto output : cell.outputs)
+		SetSignal(output, false);
+
+	if(running && cell.fastForward)
+	{
+		cell.origin = m_time;
+		ScheduleFastForward(index);
+	}
+	else if(running)
+		Schedule(index, cell.delay, false);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Fast-forwarding oscillators that only clock counters
+
+/**
+	@brief Gets how many rising edges of a clock toggling every divide half cycles there are in half cycles 1 to n
+ */
+static uint64_t RisingEdges(uint64_t n, uint64_t divide)
+{
+	if(n < divide)
+		return 0;
+	return (n - divide) / (2 * divide) + 1;
+}
+
+/**
+	@brief Brings a fast-forwarded oscillator, and the counters it clocks, up to the current time
+
+	The counters count the rising edges they missed using the inputs they had when they were last evaluated, which are
+	the ones they've had since (or they'd have been evaluated again, and this would have been called first).
+ */
+void Greenpak4Simulator::FastForward(uint32_t index)
+{
+	Cell& osc = m_cells[index];
+	if(!osc.phase)
+		return;
+
+	uint64_t edges = (m_time - osc.origin) / osc.delay;
+	if(edges == osc.state)
+		return;
+
+	for(auto output : osc.outputs)
+	{
+		for(auto load : m_loads[output])
+		{
+			Cell& cell = m_cells[load];
+			AdvanceCounter(cell, RisingEdges(edges, cell.clockDivide) - RisingEdges(osc.state, cell.clockDivide));
+			cell.lastInputs[0] = (edges / cell.clockDivide) & 1;
+			if(!m_queued[load])
+			{
+				m_dirty.push_back(load);
+				m_queued[load] = true;
+			}
+		}
+	}
+
+	//Move the origin up to keep the count small, in whole cycles of the fabric output so neither output changes phase
+	uint64_t period = 2 * osc.divide;
+	uint64_t whole = edges - (edges % period);
+	osc.origin += whole * osc.delay;
+	osc.state = edges - whole;
+
+	//Only our counters read these, and they've just been told the new values
+	m_values[osc.outputs[0]] = osc.state & 1;
+	if(osc.outputs.size() > 1)
+		m_values[osc.outputs[1]] = (osc.state / osc.divide) & 1;
+}
+
+void Greenpak4Simulator::FastForwardAll()
+{
+	for(size_t i=0; i<m_cells.size(); i++)
+	{
+		if(m_cells[i].fastForward)
+			FastForward(i);
+	}
+}
+
+/**
+	@brief Schedules a fast-forwarded oscillator to stop at the first edge that changes one of its counters' outputs
+	(and cancels any earlier plan). It must be up to date first (see FastForward()).
+ */
+void Greenpak4Simulator::ScheduleFastForward(uint32_t index)
+{
+	Cell& osc = m_cells[index];
+	osc.generation ++;
+	if(!osc.phase)
+		return;
+
+	uint64_t first = NO_EVENT;
+	for(auto output : osc.outputs)
+	{
+		for(auto load : m_loads[output])
+		{
+			Cell& cell = m_cells[load];
+			uint64_t edges = EdgesUntilCounterOutput(cell);
+			if(edges == NO_EVENT)
+				continue;
+
+			//Rising edges of the counter's clock are the half cycles that are an odd multiple of its divider
+			uint64_t period = 2 * cell.clockDivide;
+			uint64_t offset = (osc.state + period - cell.clockDivide) % period;
+			uint64_t edge = osc.state + (period - offset) + (edges - 1) * period;
+			first = min(first, edge);
+		}
+	}
+
+	if(first != NO_EVENT)
+		Schedule(index, osc.origin + first * osc.delay - m_time, false);
+}
+
+/**
+	@brief Steps a counter on a number of rising edges of its clock at once, as EvaluateCounter() would one at a time
+ */
+void Greenpak4Simulator::AdvanceCounter(Cell& cell, uint64_t edges)
+{
+	auto count = static_cast<Greenpak4Counter*>(cell.entity);
+	if(edges == 0)
+		return;
+
+	//A level reset holds the count
+	if( (count->GetResetMode() == Greenpak4Counter::HIGH_LEVEL) && cell.lastInputs[1] )
+		return;
+
+	uint64_t prediv = max(count->GetPreDivide(), 1u);
+	uint64_t total = cell.phase + edges;
+	uint64_t steps = total / prediv;
+	cell.phase = total % prediv;
+
+	//KEEP holds the count, but not the pre-divider
+	if(cell.lastInputs[3] || (steps == 0) )
+		return;
+
+	//Count as far as the end, then around the cycle from the reload value
+	uint64_t top = (1 << count->GetDepth()) - 1;
+	uint64_t reload = count->GetCountValue();
+	if(cell.lastInputs[2])
+	{
+		if(steps <= top - cell.state)
+			cell.state += steps;
+		else
+			cell.state = reload + (steps - (top - cell.state) - 1) % (top - reload + 1);
+	}
+	else
+	{
+		if(steps <= cell.state)
+			cell.state -= steps;
+		else
+			cell.state = reload - (steps - cell.state - 1) % (reload + 1);
+	}
+}
+
+/**
+	@brief Gets how many more rising clock edges it takes for a counter's output to change (NO_EVENT if it never will)
+ */
+uint64_t Greenpak4Simulator::EdgesUntilCounterOutput(Cell& cell)
+{
+	auto count = static_cast<Greenpak4Counter*>(cell.entity);
+
+	//Held in reset, or by KEEP
+	if( (count->GetResetMode() == Greenpak4Counter::HIGH_LEVEL) && cell.lastInputs[1] )
+		return NO_EVENT;
+	if(cell.lastInputs[3])
+		return NO_EVENT;
+
+	//The output is high at the end of the count, and goes low on the next step unless that reloads the same value
+	uint32_t top = (1 << count->GetDepth()) - 1;
+	uint32_t end = cell.lastInputs[2] ? top : 0;
+	uint64_t steps;
+	if(cell.state == end)
+	{
+		if(count->GetCountValue() == end)
+			return NO_EVENT;
+		steps = 1;
+	}
+	else
+		steps = cell.lastInputs[2] ? (top - cell.state) : cell.state;
+
+	return steps * max(count->GetPreDivide(), 1u) - cell.phase;
+}
@@ -0,0 +1,251 @@
+/***********************************************************************************************************************
+ * Copyright (C) 2016 Andrew Zonenberg and contributors                                                                *
+ *                                                                                                                     *
+ * This program is free software; you can redistribute it and/or modify it under the terms of the GNU Lesser General   *
+ * Public License as published by the Free Software Foundation; either version 2.1 of the License, or (at your option) *
+ * any later version.                                                                                                  *
+ *                                                                                                                     *
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied  *
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for     *
+ * more details.                                                                                                       *
+ *                                                                                                                     *
+ * You should have received a copy of the GNU Lesser General Public License along with this program; if not, you may   *
+ * find one here:                                                                                                      *
+ * https://www.gnu.org/licenses/old-licenses/lgpl-2.1.txt                                                              *
+ * or you may search the http://www.gnu.org website for the version 2.1 license, or you may write to the Free Software *
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA                                      *
+ **********************************************************************************************************************/
+
+#ifndef Greenpak4Simulator_h
+#define Greenpak4Simulator_h
+
+#include "Greenpak4SimulationModel.h"
+#include "Greenpak4SimulationNetlist.h"
+
+#include <cstdint>
+#include <queue>
+#include <string>
+#include <vector>
+
+/**
+	@brief A digital simulation of a configured Greenpak4Device
+
+	The model is built from the device's configuration, so it works on a device that has just been through PAR as well
+	as one loaded from a bitstream with Greenpak4Device::LoadFromFile().
+
+	Combinational logic (LUTs, inverters and cross connections) has no delay, and settles before time moves on (in delta
+	cycles, like a Verilog simulator). Flipflops, latches, shift registers, counters and the pattern generator update on
+	the edges of their clocks, and delay lines, edge detectors, the oscillators, the power-on reset and the bandgap are
+	scheduled using their nominal timing. The SPI slave and the other hard IP aren't simulated, so anything they drive
+	reads as 0 (Build() warns about them).
+
+	The analog blocks have ideal, instantaneous models of their configuration: comparators (with their attenuation and
+	hysteresis), voltage references, DACs, the PGA and the analog buffer. Pins read as 0 V or Vdd from their digital
+	state unless SetPinVoltage() says otherwise, and a pin driven by an analog block floats its digital driver. The
+	input current source, comparator bandwidth and DAC1's offset aren't modelled.
+
+	All times are in picoseconds since power-up.
+ */
+class Greenpak4Simulator : public Greenpak4SimulationModel, protected Greenpak4SimulationNetlist
+{
+public:
+	Greenpak4Simulator(Greenpak4Device* device, bool analog = true);
+	virtual ~Greenpak4Simulator();
+
+	bool Build();
+	virtual void Reset();
+	virtual Greenpak4Simulator* Clone();
+	virtual Greenpak4Simulator* Snapshot();
+
+	virtual void SetPinInput(unsigned int pin, PinState state);
+	virtual PinState GetPinOutput(unsigned int pin);
+
+	virtual void RunUntil(uint64_t time);
+	virtual uint64_t GetNextEventTime();
+
+	uint64_t GetTime()
+	{ return m_time; }
+
+	bool GetValue(Greenpak4EntityOutput signal);
+
+	void SetPinVoltage(unsigned int pin, double voltage);
+	double GetPinVoltage(unsigned int pin);
+	double GetVoltage(Greenpak4EntityOutput signal);
+
+	void SetSupplyVoltage(double vdd);
+
+	double GetSupplyVoltage()
+	{ return m_vdd; }
+
+	Greenpak4Device* GetDevice()
+	{ return m_device; }
+
+protected:
+	/**
+		@brief One simulated block, and its state
+	 */
+	class Cell
+	{
+	public:
+		Cell(CellType t, Greenpak4BitstreamEntity* e)
+			: type(t)
+			, entity(e)
+			, state(0)
+			, phase(0)
+			, delay(0)
+			, divide(1)
+			, generation(0)
+			, fastForward(false)
+			, origin(0)
+			, clockedBy(-1)
+			, clockDivide(1)
+		{}
+
+		CellType type;
+		Greenpak4BitstreamEntity* entity;
+
+		//Signals we read and drive (the meaning of each slot depends on the type)
+		std::vector<uint32_t> inputs;
+		std::vector<uint32_t> outputs;
+
+		//Input values the last time we were evaluated, for finding edges
+		std::vector<bool> lastInputs;
+
+		//FF value, counter value, shift register contents, pattern generator step, oscillator half cycle count, or
+		//comparator output
+		uint32_t state;
+
+		//Counter pre-divider position, or true if an oscillator is running
+		uint32_t phase;
+
+		//Delay line delay, edge detector pulse width, oscillator half period, or reset/bandgap startup time
+		uint64_t delay;
+
+		//Oscillator post-divider (on the fabric output only)
+		uint32_t divide;
+
+		//Bumped to cancel timed events that are still in the queue (when an oscillator stops, say)
+		uint32_t generation;
+
+		//True for an oscillator that only clocks counters, so we only stop at the edges that change their outputs
+		bool fastForward;
+
+		//When a fast-forwarded oscillator started (its half cycle count is worked out from this)
+		uint64_t origin;
+
+		//The fast-forwarded oscillator clocking a counter (-1 if none), and how many of its half cycles make one of
+		//the counter's clock half cycles (1 for the hard IP output, or the post-divider for the fabric output)
+		int32_t clockedBy;
+		uint32_t clockDivide;
+	};
+
+	/**
+		@brief Something scheduled for later: an oscillator edge, a delay line output, or the end of power-on reset
+	 */
+	class Event
+	{
+	public:
+		Event(uint64_t t, uint64_t s, uint32_t c, uint32_t g, bool v)
+			: time(t)
+			, seq(s)
+			, cell(c)
+			, generation(g)
+			, value(v)
+		{}
+
+		//Earliest first, then in the order they were scheduled (for std::priority_queue)
+		bool operator<(const Event& rhs) const
+		{ return (time != rhs.time) ? (time > rhs.time) : (seq > rhs.seq); }
+
+		uint64_t time;
+		uint64_t seq;
+		uint32_t cell;
+		uint32_t generation;
+		bool value;
+	};
+
+	uint32_t GetSignal(Greenpak4EntityOutput signal);
+	uint32_t AddCell(CellType type, Greenpak4BitstreamEntity* entity);
+	void AddInput(uint32_t cell, Greenpak4EntityOutput signal);
+	void AddOutput(uint32_t cell, Greenpak4EntityOutput signal);
+	void AddOutput(uint32_t cell, uint32_t signal);
+	void AddOscillator(Greenpak4BitstreamEntity* entity, double frequency, int prediv, int postdiv,
+		const char* hardport, const char* fabricport);
+	void AddComparator(Greenpak4Comparator* acmp);
+	void AddAnalogInputs(uint32_t cell, Greenpak4EntityOutput source);
+
+	void SetSignal(uint32_t signal, bool value);
+	void Schedule(uint32_t cell, uint64_t delay, bool value);
+	void Settle();
+	void Evaluate(uint32_t cell);
+	void EvaluateIOB(Cell& cell);
+	void EvaluateComparator(Cell& cell);
+	double EvaluateVoltage(Greenpak4EntityOutput signal);
+	double EvaluatePinVoltage(unsigned int pin);
+	void DirtyComparators();
+	void EvaluateCounter(Cell& cell);
+	void EvaluateOscillator(uint32_t index);
+	void FindFastForwards();
+	void FastForward(uint32_t index);
+	void FastForwardAll();
+	void ScheduleFastForward(uint32_t index);
+	void AdvanceCounter(Cell& cell, uint64_t edges);
+	uint64_t EdgesUntilCounterOutput(Cell& cell);
+	void FireEvent(const Event& event);
+
+	bool Input(const Cell& cell, unsigned int i)
+	{ return m_values[cell.inputs[i]]; }
+
+	bool Rose(const Cell& cell, unsigned int i)
+	{ return Input(cell, i) && !cell.lastInputs[i]; }
+
+	bool Fell(const Cell& cell, unsigned int i)
+	{ return !Input(cell, i) && cell.lastInputs[i]; }
+
+	///True to simulate the analog blocks (the model generator can't)
+	bool m_analog;
+
+	///Supply voltage, in volts
+	double m_vdd;
+
+	///Current time
+	uint64_t m_time;
+
+	///Value of each signal, by index
+	std::vector<bool> m_values;
+
+	///Cells to evaluate when each signal changes, by signal index
+	std::vector< std::vector<uint32_t> > m_loads;
+
+	std::vector<Cell> m_cells;
+
+	///Index of the IOB cell for each pin (-1 if there's no such pin)
+	std::vector<int32_t> m_pinCells;
+
+	///What the outside world is driving onto each pin
+	std::vector<PinState> m_pinInputs;
+
+	///Voltage the outside world is driving onto each pin (NAN if it's only the digital state)
+	std::vector<double> m_pinVoltages;
+
+	///True for each pin an analog block drives
+	std::vector<bool> m_pinAnalog;
+
+	///Index of every comparator cell, for re-evaluating them when a voltage changes
+	std::vector<uint32_t> m_comparators;
+
+	///Cells waiting to be evaluated (and a flag for each cell, so they're only queued once)
+	std::vector<uint32_t> m_dirty;
+	std::vector<bool> m_queued;
+
+	///Signal changes made by the cells evaluated so far, which take effect once they've all been evaluated
+	std::vector< std::pair<uint32_t, bool> > m_pending;
+
+	std::priority_queue<Event> m_events;
+	uint64_t m_nextSeq;
+
+	///True while Reset() is finding the power-up values, so sequential cells don't see edges
+	bool m_initializing;
+};
+
+#endif
@@ -0,0 +1,390 @@
+/***********************************************************************************************************************
+ * Copyright (C) 2016 Andrew Zonenberg and contributors                                                                *
+ *                                                                                                                     *
+ * This program is free software; you can redistribute it and/or modify it under the terms of the GNU Lesser General   *
+ * Public License as published by the Free Software Foundation; either version 2.1 of the License, or (at your option) *
+ * any later version.                                                                                                  *
+ *                                                                                                                     *
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied  *
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for     *
+ * more details.                                                                                                       *
+ *                                                                                                                     *
+ * You should have received a copy of the GNU Lesser General Public License along with this program; if not, you may   *
+ * find one here:                                                                                                      *
+ * https://www.gnu.org/licenses/old-licenses/lgpl-2.1.txt                                                              *
+ * or you may search the http://www.gnu.org website for the version 2.1 license, or you may write to the Free Software *
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA                                      *
+ **********************************************************************************************************************/
+
+#include "Greenpak4VectorSimulator.h"
+#include <log.h>
+
+using namespace std;
+
+//Every lane set, or clear
+static const Greenpak4VectorSimulator::lanes ALL_LANES = ~static_cast<Greenpak4VectorSimulator::lanes>(0);
+static const Greenpak4VectorSimulator::lanes NO_LANES = 0;
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Construction / destruction
+
+Greenpak4VectorSimulator::Greenpak4VectorSimulator(Greenpak4Device* device)
+	: Greenpak4SimulationNetlist(device)
+	, m_values(GetSignalCount(), NO_LANES)
+{
+	m_high.push_back(m_power);
+}
+
+Greenpak4VectorSimulator::~Greenpak4VectorSimulator()
+{
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Building the model
+
+/**
+	@brief Creates a cell for every block in the device we know how to simulate, then resets it
+
+	@return False if there's nothing to simulate, or the logic can't be put in order
+ */
+bool Greenpak4VectorSimulator::Build()
+{
+	for(unsigned int i=0; i<m_device->GetEntityCount(); i++)
+	{
+		Greenpak4BitstreamEntity* entity = GetSimulatedEntity(m_device->GetEntity(i));
+
+		CellType type;
+		vector<Greenpak4EntityOutput> inputs;
+		Greenpak4EntityOutput output;
+		if(GetLogicCell(entity, type, inputs, output))
+		{
+			uint32_t c = AddCell(type, entity);
+			for(auto input : inputs)
+				AddInput(c, input);
+			AddOutput(c, output);
+
+			if(auto lut = dynamic_cast<Greenpak4LUT*>(entity))
+			{
+				for(unsigned int j=0; j < (1u << lut->GetOrder()); j++)
+					m_cells[c].table |= lut->GetTruthTableBit(j) << j;
+			}
+		}
+
+		else if(auto iob = dynamic_cast<Greenpak4IOB*>(entity))
+		{
+			uint32_t c = AddCell(CELL_IOB, iob);
+			AddInput(c, iob->GetOutputSignal());
+			AddInput(c, iob->GetOutputEnable());
+			AddOutput(c, iob->GetOutput("OUT"));
+
+			//Until we're told otherwise, the only thing on the pin is the pull resistor
+			unsigned int pin = iob->GetPinNumber();
+			if(pin >= m_pinCells.size())
+			{
+				m_pinCells.resize(pin + 1, -1);
+				m_pinInputs.resize(pin + 1, NO_LANES);
+			}
+			m_pinCells[pin] = c;
+			m_pinInputs[pin] = (iob->GetPullDirection() == Greenpak4IOB::PULL_UP) ? ALL_LANES : NO_LANES;
+		}
+
+		//We start after power-on reset
+		else if(auto por = dynamic_cast<Greenpak4PowerOnReset*>(entity))
+		{
+			uint32_t signal = GetSignal(por->GetOutput("RST_DONE"));
+			m_driven[signal] = true;
+			m_high.push_back(signal);
+		}
+
+		//Power rails are constants, and everything else isn't simulated
+	}
+
+	if(m_cells.empty())
+	{
+		LogError("Nothing to simulate in this device\n");
+		return false;
+	}
+
+	if(!SortCells())
+		return false;
+
+	WarnUnsimulated(" lane-parallel");
+	Reset();
+	return true;
+}
+
+/**
+	@brief Puts the combinational cells in dependency order (see Greenpak4SimulationNetlist::SortCombinational())
+
+	@return False if there's a combinational loop
+ */
+bool Greenpak4VectorSimulator::SortCells()
+{
+	vector<bool> sequential(m_cells.size(), false);
+	for(size_t i=0; i<m_cells.size(); i++)
+	{
+		if( (m_cells[i].type == CELL_DFF) || (m_cells[i].type == CELL_LATCH) )
+		{
+			sequential[i] = true;
+			m_sequential.push_back(i);
+		}
+	}
+
+	int32_t loop = SortCombinational(m_cells, sequential, m_combinational);
+	if(loop >= 0)
+	{
+		LogError("Combinational loop through %s, which can't be simulated lane-parallel\n",
+			m_cells[loop].entity->GetDescription().c_str());
+		return false;
+	}
+
+	return true;
+}
+
+/**
+	@brief Gets the index of a signal (see Greenpak4SimulationNetlist::GetSignalIndex())
+ */
+uint32_t Greenpak4VectorSimulator::GetSignal(Greenpak4EntityOutput signal)
+{
+	uint32_t index = GetSignalIndex(signal);
+	if(index >= m_values.size())
+		m_values.resize(index + 1, NO_LANES);
+	return index;
+}
+
+uint32_t Greenpak4VectorSimulator::AddCell(CellType type, Greenpak4BitstreamEntity* entity)
+{
+	m_cells.push_back(Cell(type, entity));
+	return m_cells.size() - 1;
+}
+
+void Greenpak4VectorSimulator::AddInput(uint32_t cell, Greenpak4EntityOutput signal)
+{
+	uint32_t index = GetSignal(signal);
+	m_loaded[index] = true;
+	m_cells[cell].inputs.push_back(index);
+}
+
+void Greenpak4VectorSimulator::AddOutput(uint32_t cell, Greenpak4EntityOutput signal)
+{
+	uint32_t index = GetSignal(signal);
+	m_driven[index] = true;
+	m_cells[cell].outputs.push_back(index);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Stimulus and results
+
+/**
+	@brief Puts every lane back in its power-up state (the pin inputs stay as they are)
+ */
+void Greenpak4VectorSimulator::Reset()
+{
+	m_values.assign(m_values.size(), NO_LANES);
+	for(auto signal : m_high)
+		m_values[signal] = ALL_LANES;
+
+	//Find the power-up value of everything without clocking anything...
+	for(auto c : m_sequential)
+	{
+		Cell& cell = m_cells[c];
+		auto ff = static_cast<Greenpak4Flipflop*>(cell.entity);
+		cell.state = ff->GetInitValue() ? ALL_LANES : NO_LANES;
+		m_values[cell.outputs[0]] = ff->IsOutputInverted() ? ~cell.state : cell.state;
+	}
+	for(auto c : m_combinational)
+		EvaluateCombinational(m_cells[c]);
+	for(auto c : m_sequential)
+	{
+		m_cells[c].lastClock = m_values[m_cells[c].inputs[1]];
+		m_cells[c].lastD = m_values[m_cells[c].inputs[0]];
+	}
+
+	//...then let the asynchronous resets (and transparent latches) take effect
+	Settle();
+}
+
+/**
+	@brief Sets what the outside world is driving onto a pin (bit N is the value in lane N)
+
+	If the device is driving the pin itself, that wins. Nonexistent pins are ignored. Nothing happens until Settle().
+ */
+void Greenpak4VectorSimulator::SetPinInputs(unsigned int pin, lanes values)
+{
+	if( (pin >= m_pinCells.size()) || (m_pinCells[pin] < 0) )
+		return;
+	m_pinInputs[pin] = values;
+}
+
+/**
+	@brief Gets the value the device is driving onto a pin, in every lane (0 where it isn't driving)
+ */
+Greenpak4VectorSimulator::lanes Greenpak4VectorSimulator::GetPinOutputs(unsigned int pin)
+{
+	if( (pin >= m_pinCells.size()) || (m_pinCells[pin] < 0) )
+		return NO_LANES;
+	const Cell& cell = m_cells[m_pinCells[pin]];
+	return cell.state & cell.driving;
+}
+
+/**
+	@brief Gets the lanes in which the device is driving a pin
+ */
+Greenpak4VectorSimulator::lanes Greenpak4VectorSimulator::GetPinOutputEnables(unsigned int pin)
+{
+	if( (pin >= m_pinCells.size()) || (m_pinCells[pin] < 0) )
+		return NO_LANES;
+	return m_cells[m_pinCells[pin]].driving;
+}
+
+/**
+	@brief Gets the current value of a signal in every lane (0 for anything we don't simulate)
+ */
+Greenpak4VectorSimulator::lanes Greenpak4VectorSimulator::GetValue(Greenpak4EntityOutput signal)
+{
+	return m_values[GetSignal(signal)];
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Evaluation
+
+/**
+	@brief Brings every lane up to date with the pin inputs
+
+	Each pass evaluates all of the logic, then clocks the flipflops and latches against what it settled to. A flipflop
+	clocked by another one may need another pass, so we keep going until a pass doesn't change anything.
+
+	@return False if the design never settles (a transparent latch feeding back on itself, say)
+ */
+bool Greenpak4VectorSimulator::Settle()
+{
+	//A chain of N flipflops or latches takes N passes to ripple through, plus one to see that it's done
+	for(size_t pass = 0; pass <= m_sequential.size() + 1; pass++)
+	{
+		for(auto c : m_combinational)
+			EvaluateCombinational(m_cells[c]);
+		if(!ClockSequential())
+			return true;
+	}
+
+	LogWarning("Lane-parallel simulation didn't settle, giving up\n");
+	return false;
+}
+
+void Greenpak4VectorSimulator::EvaluateCombinational(Cell& cell)
+{
+	switch(cell.type)
+	{
+		case CELL_LUT:
+			m_values[cell.outputs[0]] = EvaluateLUT(cell);
+			break;
+
+		case CELL_INVERTER:
+			m_values[cell.outputs[0]] = ~m_values[cell.inputs[0]];
+			break;
+
+		case CELL_BUFFER:
+			m_values[cell.outputs[0]] = m_values[cell.inputs[0]];
+			break;
+
+		//Inputs are IN (what to drive) and OE. We win over the outside world where we're driving.
+		case CELL_IOB:
+			{
+				auto iob = static_cast<Greenpak4IOB*>(cell.entity);
+				lanes value = m_values[cell.inputs[0]];
+				lanes enable = m_values[cell.inputs[1]];
+				switch(iob->GetDriveType())
+				{
+					case Greenpak4IOB::DRIVE_PUSHPULL:
+						cell.driving = enable;
+						break;
+
+					case Greenpak4IOB::DRIVE_NMOS_OPENDRAIN:
+						cell.driving = enable & ~value;
+						break;
+
+					case Greenpak4IOB::DRIVE_PMOS_OPENDRAIN:
+						cell.driving = enable & value;
+						break;
+				}
+				cell.state = value;
+
+				lanes outside = m_pinInputs[iob->GetPinNumber()];
+				m_values[cell.outputs[0]] = (cell.driving & value) | (~cell.driving & outside);
+			}
+			break;
+
+		default:
+			break;
+	}
+}
+
+/**
+	@brief Evaluates a LUT in every lane at once
+
+	The truth table is folded one input at a time: each pair of entries that only differ in that input becomes a mux
+	selected by it, until one word is left.
+ */
+Greenpak4VectorSimulator::lanes Greenpak4VectorSimulator::EvaluateLUT(const Cell& cell)
+{
+	lanes rows[16];
+	unsigned int count = 1 << cell.inputs.size();
+	for(unsigned int i=0; i<count; i++)
+		rows[i] = ((cell.table >> i) & 1) ? ALL_LANES : NO_LANES;
+
+	for(size_t i=0; i<cell.inputs.size(); i++)
+	{
+		lanes select = m_values[cell.inputs[i]];
+		count /= 2;
+		for(unsigned int j=0; j<count; j++)
+			rows[j] = (select & rows[2*j + 1]) | (~select & rows[2*j]);
+	}
+
+	return rows[0];
+}
+
+/**
+	@brief Updates every flipflop and latch from the current signal values
+
+	All of them see the values from before any of them change, as in hardware. Inputs are D, CLK (nCLK for a latch) and
+	nSR. A flipflop clocks in the D it had on the previous pass, since this pass's D may already have been recomputed
+	from the edge that's clocking it.
+
+	@return True if any of their outputs changed
+ */
+bool Greenpak4VectorSimulator::ClockSequential()
+{
+	for(auto c : m_sequential)
+	{
+		Cell& cell = m_cells[c];
+		lanes d = m_values[cell.inputs[0]];
+		lanes clk = m_values[cell.inputs[1]];
+		lanes nsr = m_values[cell.inputs[2]];
+
+		if(cell.type == CELL_DFF)
+		{
+			lanes rose = clk & ~cell.lastClock;
+			cell.state = (rose & cell.lastD) | (~rose & cell.state);
+			cell.lastClock = clk;
+			cell.lastD = d;
+		}
+		else
+			cell.state = (~clk & d) | (clk & cell.state);
+
+		lanes srvalue = static_cast<Greenpak4Flipflop*>(cell.entity)->GetSetResetMode() ? ALL_LANES : NO_LANES;
+		cell.state = (nsr & cell.state) | (~nsr & srvalue);
+	}
+
+	bool changed = false;
+	for(auto c : m_sequential)
+	{
+		Cell& cell = m_cells[c];
+		lanes q = static_cast<Greenpak4Flipflop*>(cell.entity)->IsOutputInverted() ? ~cell.state : cell.state;
+		if(m_values[cell.outputs[0]] != q)
+		{
+			m_values[cell.outputs[0]] = q;
+			changed = true;
+		}
+	}
+	return changed;
+}
@@ -0,0 +1,139 @@
+/***********************************************************************************************************************
+ * Copyright (C) 2016 Andrew Zonenberg and contributors                                                                *
+ *                                                                                                                     *
+ * This program is free software; you can redistribute it and/or modify it under the terms of the GNU Lesser General   *
+ * Public License as published by the Free Software Foundation; either version 2.1 of the License, or (at your option) *
+ * any later version.                                                                                                  *
+ *                                                                                                                     *
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied  *
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for     *
+ * more details.                                                                                                       *
+ *                                                                                                                     *
+ * You should have received a copy of the GNU Lesser General Public License along with this program; if not, you may   *
+ * find one here:                                                                                                      *
+ * https://www.gnu.org/licenses/old-licenses/lgpl-2.1.txt                                                              *
+ * or you may search the http://www.gnu.org website for the version 2.1 license, or you may write to the Free Software *
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA                                      *
+ **********************************************************************************************************************/
+
+#ifndef Greenpak4VectorSimulator_h
+#define Greenpak4VectorSimulator_h
+
+#include "Greenpak4SimulationNetlist.h"
+
+#include <cstdint>
+#include <vector>
+
+/**
+	@brief A bit-sliced simulation of a configured Greenpak4Device, for running lots of test vectors at once
+
+	Every signal is a 64-bit word, and each bit of it (a lane) is an independent copy of the device. LUTs are
+	evaluated as boolean expressions over whole words, and flipflops and latches update lane by lane, so one Settle()
+	does the work of 64 runs of Greenpak4Simulator.
+
+	There's no notion of time: set the pin inputs for every lane, call Settle(), and read the outputs back. Flipflops
+	are clocked by any rising edge of their clock since the last Settle() (including edges caused by other flipflops).
+	Like Greenpak4Simulator, a flipflop samples D as it was before the edge: the value it had at the end of the
+	previous settling pass, not the one its logic works out once the new clock has gone through it.
+	Only the digital fabric is simulated (LUTs, inverters, cross connections, IOBs, flipflops and latches), and the
+	power-on reset has already finished. Counters, shift registers, delay lines, oscillators and the hard IP aren't,
+	so anything they drive reads as 0 (Build() warns about them).
+ */
+class Greenpak4VectorSimulator : protected Greenpak4SimulationNetlist
+{
+public:
+	Greenpak4VectorSimulator(Greenpak4Device* device);
+	virtual ~Greenpak4VectorSimulator();
+
+	///One bit per lane
+	typedef uint64_t lanes;
+
+	///Number of lanes in each word
+	static const unsigned int LANES = 64;
+
+	bool Build();
+	void Reset();
+
+	void SetPinInputs(unsigned int pin, lanes values);
+	lanes GetPinOutputs(unsigned int pin);
+	lanes GetPinOutputEnables(unsigned int pin);
+
+	bool Settle();
+
+	lanes GetValue(Greenpak4EntityOutput signal);
+
+	Greenpak4Device* GetDevice()
+	{ return m_device; }
+
+protected:
+	/**
+		@brief One simulated block, and its state in every lane
+	 */
+	class Cell
+	{
+	public:
+		Cell(CellType t, Greenpak4BitstreamEntity* e)
+			: type(t)
+			, entity(e)
+			, table(0)
+			, state(0)
+			, lastClock(0)
+			, lastD(0)
+			, driving(0)
+		{}
+
+		CellType type;
+		Greenpak4BitstreamEntity* entity;
+
+		//Signals we read and drive (the meaning of each slot depends on the type)
+		std::vector<uint32_t> inputs;
+		std::vector<uint32_t> outputs;
+
+		//LUT truth table (bit N is the output for input value N)
+		uint32_t table;
+
+		//Flipflop value, or what an IOB is driving onto its pin
+		lanes state;
+
+		//Flipflop clock the last time we looked at it, for finding edges
+		lanes lastClock;
+
+		//Flipflop D the last time we looked at it, which is what an edge samples
+		lanes lastD;
+
+		//Lanes in which an IOB is driving its pin
+		lanes driving;
+	};
+
+	uint32_t GetSignal(Greenpak4EntityOutput signal);
+	uint32_t AddCell(CellType type, Greenpak4BitstreamEntity* entity);
+	void AddInput(uint32_t cell, Greenpak4EntityOutput signal);
+	void AddOutput(uint32_t cell, Greenpak4EntityOutput signal);
+	bool SortCells();
+
+	void EvaluateCombinational(Cell& cell);
+	lanes EvaluateLUT(const Cell& cell);
+	bool ClockSequential();
+
+	///Value of each signal in every lane, by index
+	std::vector<lanes> m_values;
+
+	///Signals that are always high (the power rail, and the power-on reset once it's done)
+	std::vector<uint32_t> m_high;
+
+	std::vector<Cell> m_cells;
+
+	///Combinational cells in the order they need evaluating (each one after everything that drives it)
+	std::vector<uint32_t> m_combinational;
+
+	///Flipflops and latches
+	std::vector<uint32_t> m_sequential;
+
+	///Index of the IOB cell for each pin (-1 if there's no such pin)
+	std::vector<int32_t> m_pinCells;
+
+	///What the outside world is driving onto each pin, in every lane
+	std::vector<lanes> m_pinInputs;
+};
+
+#endif
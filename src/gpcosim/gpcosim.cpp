@@ -16,13 +16,94 @@
  * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA                                      *
  **********************************************************************************************************************/
 
+/**
+	@file
+	@brief VPI glue exposing Greenpak4Simulator (or a model compiled by gp4simgen) to Icarus Verilog
+
+	See GP4_COSIM.v for a drop-in model built on these. The system functions are:
+
+	$gp4_load(part, bitstream)	Loads a bitstream for a part ("SLG46620V", "SLG46621V" or "SLG46140V") and powers it
+								up, returning a handle to pass to the others (or -1 on failure). If the file name
+								ends in .so it's a compiled model instead, and the part is ignored.
+	$gp4_pin(handle, pin, value)	Sets what the testbench drives onto a pin (z or x means nothing)
+	$gp4_out(handle, pin)		What the device drives onto a pin (0, 1 or z)
+	$gp4_next(handle)			Time until the device next does something on its own, in ps
+	$gp4_attach(handle, pins, drive)
+								Connects the device to a vector of pins (bit 0 is pin 1) and a reg of the same
+								width it drives them through, and keeps them in sync from then on
+	$gp4_vin(handle, pin, volts)	Sets the voltage the testbench drives onto a pin, for the analog blocks to see
+								($gp4_pin goes back to a digital value)
+	$gp4_vout(handle, pin)		The voltage on a pin, as a real
+
+	The voltage functions need a bitstream, since compiled models don't simulate the analog blocks.
+
+	Each call first runs the model up to the current simulation time.
+
+	The per-pin functions cost a few VPI calls per pin every time anything changes, which is most of the run time for a
+	small design. $gp4_attach looks up its nets once, when it's compiled, and then only runs the model when the pins
+	change or the model has something to do, reading all the pins in one call and driving them all in another.
+ */
+
+#include "Greenpak4Simulator.h"
+#include "Greenpak4CompiledModel.h"
 #include <log.h>
 #include <vpi_user.h>
+#include <cmath>
+#include <cstring>
+
+using namespace std;
 
 void cosim_register();
 
-int hello_compiletf(char* data);
-int hello_calltf(char* data);
+PLI_INT32 load_compiletf(PLI_BYTE8* data);
+PLI_INT32 load_calltf(PLI_BYTE8* data);
+PLI_INT32 pin_compiletf(PLI_BYTE8* data);
+PLI_INT32 pin_calltf(PLI_BYTE8* data);
+PLI_INT32 out_compiletf(PLI_BYTE8* data);
+PLI_INT32 out_sizetf(PLI_BYTE8* data);
+PLI_INT32 out_calltf(PLI_BYTE8* data);
+PLI_INT32 next_compiletf(PLI_BYTE8* data);
+PLI_INT32 next_calltf(PLI_BYTE8* data);
+PLI_INT32 attach_compiletf(PLI_BYTE8* data);
+PLI_INT32 attach_calltf(PLI_BYTE8* data);
+PLI_INT32 vin_compiletf(PLI_BYTE8* data);
+PLI_INT32 vin_calltf(PLI_BYTE8* data);
+PLI_INT32 vout_compiletf(PLI_BYTE8* data);
+PLI_INT32 vout_calltf(PLI_BYTE8* data);
+
+//Every device loaded so far, indexed by handle (they live until the simulator exits)
+static vector<Greenpak4SimulationModel*> g_simulators;
+
+//A call to $gp4_attach, and the device it connects once it's been run (these live until the simulator exits too)
+struct Attachment
+{
+	Attachment()
+	: pins(NULL)
+	, drive(NULL)
+	, width(0)
+	, sim(NULL)
+	, wakeup(NULL)
+	, wakeupTime(0)
+	{}
+
+	///The pins, and the reg the device drives them through
+	vpiHandle pins;
+	vpiHandle drive;
+
+	///Number of pins
+	int width;
+
+	///The device, once attached
+	Greenpak4SimulationModel* sim;
+
+	///What the pins were, and what we drove onto them, last time we looked (packed as VPI vectors)
+	vector<s_vpi_vecval> lastPins;
+	vector<s_vpi_vecval> lastDrive;
+
+	///Callback for the next thing the device does on its own, and when that is (in ps)
+	vpiHandle wakeup;
+	uint64_t wakeupTime;
+};
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 // Table of functions used by iverilog
@@ -39,30 +120,570 @@ extern "C"
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 // Exported stuff called by iverilog
 
+static void RegisterFunction(
+	const char* name,
+	PLI_INT32 type,
+	PLI_INT32 functype,
+	PLI_INT32 (*compiletf)(PLI_BYTE8*),
+	PLI_INT32 (*calltf)(PLI_BYTE8*),
+	PLI_INT32 (*sizetf)(PLI_BYTE8*) = NULL)
+{
+	s_vpi_systf_data tf_data;
+	memset(&tf_data, 0, sizeof(tf_data));
+	tf_data.type        = type;
+	tf_data.sysfunctype = functype;
+	tf_data.tfname      = const_cast<PLI_BYTE8*>(name);
+	tf_data.calltf      = calltf;
+	tf_data.compiletf   = compiletf;
+	tf_data.sizetf      = sizetf;
+	tf_data.user_data   = 0;
+	vpi_register_systf(&tf_data);
+}
+
 void cosim_register()
 {
 	//Set up logging
 	g_log_sinks.emplace(g_log_sinks.begin(), new STDLogSink(Severity::VERBOSE));
 
 	//Register stuff
-	s_vpi_systf_data tf_data;
-	tf_data.type      = vpiSysFunc;
-	tf_data.tfname    = "$hello";
-	tf_data.calltf    = hello_calltf;
-	tf_data.compiletf = hello_compiletf;
-	tf_data.sizetf    = 0;
-	tf_data.user_data = 0;
-	vpi_register_systf(&tf_data);
+	RegisterFunction("$gp4_load", vpiSysFunc, vpiIntFunc, load_compiletf, load_calltf);
+	RegisterFunction("$gp4_pin", vpiSysTask, 0, pin_compiletf, pin_calltf);
+	RegisterFunction("$gp4_out", vpiSysFunc, vpiSizedFunc, out_compiletf, out_calltf, out_sizetf);
+	RegisterFunction("$gp4_next", vpiSysFunc, vpiRealFunc, next_compiletf, next_calltf);
+	RegisterFunction("$gp4_attach", vpiSysTask, 0, attach_compiletf, attach_calltf);
+	RegisterFunction("$gp4_vin", vpiSysTask, 0, vin_compiletf, vin_calltf);
+	RegisterFunction("$gp4_vout", vpiSysFunc, vpiRealFunc, vout_compiletf, vout_calltf);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Helpers
+
+/**
+	@brief Gets the arguments of the system function being called or compiled
+ */
+static vector<vpiHandle> GetArguments()
+{
+	vector<vpiHandle> args;
+	vpiHandle call = vpi_handle(vpiSysTfCall, NULL);
+	vpiHandle it = vpi_iterate(vpiArgument, call);
+	if(it == NULL)
+		return args;
+
+	//The iterator is freed once vpi_scan() runs off the end
+	vpiHandle arg;
+	while( (arg = vpi_scan(it)) != NULL )
+		args.push_back(arg);
+	return args;
 }
 
-int hello_compiletf(char* /*data*/)
+/**
+	@brief Makes sure a system function has the right number of arguments, and stops the simulation if it doesn't
+ */
+static PLI_INT32 CheckArgumentCount(const char* name, size_t count)
 {
+	if(GetArguments().size() != count)
+	{
+		LogError("%s takes %zu arguments\n", name, count);
+		vpi_control(vpiFinish, 1);
+	}
 	return 0;
 }
 
-int hello_calltf(char* /*data*/)
+static int GetIntArgument(vpiHandle arg)
+{
+	s_vpi_value value;
+	value.format = vpiIntVal;
+	vpi_get_value(arg, &value);
+	return value.value.integer;
+}
+
+static string GetStringArgument(vpiHandle arg)
+{
+	s_vpi_value value;
+	value.format = vpiStringVal;
+	vpi_get_value(arg, &value);
+	return value.value.str;
+}
+
+/**
+	@brief Gets the current simulation time, in ps
+ */
+static uint64_t GetSimulationTime()
 {
-	LogNotice("function called!!!\n");
+	s_vpi_time now;
+	now.type = vpiSimTime;
+	vpi_get_time(NULL, &now);
+	uint64_t ticks = (static_cast<uint64_t>(now.high) << 32) | now.low;
+
+	//Ticks are in units of the simulation precision (10^precision seconds)
+	int precision = vpi_get(vpiTimePrecision, NULL);
+	if(precision >= -12)
+		return ticks * static_cast<uint64_t>(pow(10, precision + 12) + 0.5);
+	return ticks / static_cast<uint64_t>(pow(10, -12 - precision) + 0.5);
+}
+
+/**
+	@brief Converts a delay in ps to simulation ticks, rounding up so we never wake up early
+ */
+static uint64_t GetSimulationTicks(uint64_t ps)
+{
+	int precision = vpi_get(vpiTimePrecision, NULL);
+	if(precision >= -12)
+	{
+		uint64_t scale = static_cast<uint64_t>(pow(10, precision + 12) + 0.5);
+		return (ps + scale - 1) / scale;
+	}
+	return ps * static_cast<uint64_t>(pow(10, -12 - precision) + 0.5);
+}
+
+/**
+	@brief Looks up the simulator for a handle argument, and brings it up to the current time
+
+	@return The simulator, or NULL (after complaining) if the handle is bad
+ */
+static Greenpak4SimulationModel* GetSimulator(vpiHandle arg)
+{
+	int handle = GetIntArgument(arg);
+	if( (handle < 0) || (static_cast<size_t>(handle) >= g_simulators.size()) )
+	{
+		LogError("Invalid GreenPAK simulator handle %d\n", handle);
+		return NULL;
+	}
+
+	Greenpak4SimulationModel* sim = g_simulators[handle];
+	sim->RunUntil(GetSimulationTime());
+	return sim;
+}
+
+/**
+	@brief Looks up the simulator for a handle argument like GetSimulator(), for a function that needs the analog models
+
+	@return The simulator, or NULL (after complaining) if the handle is bad or it's a compiled model
+ */
+static Greenpak4Simulator* GetAnalogSimulator(const char* name, vpiHandle arg)
+{
+	Greenpak4SimulationModel* model = GetSimulator(arg);
+	if(model == NULL)
+		return NULL;
+
+	Greenpak4Simulator* sim = dynamic_cast<Greenpak4Simulator*>(model);
+	if(sim == NULL)
+		LogError("%s: compiled models don't simulate the analog blocks\n", name);
+	return sim;
+}
+
+static double GetRealArgument(vpiHandle arg)
+{
+	s_vpi_value value;
+	value.format = vpiRealVal;
+	vpi_get_value(arg, &value);
+	return value.value.real;
+}
+
+static void PutResult(s_vpi_value& value)
+{
+	vpi_put_value(vpi_handle(vpiSysTfCall, NULL), &value, NULL, vpiNoDelay);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// $gp4_load(part, bitstream)
+
+PLI_INT32 load_compiletf(PLI_BYTE8* /*data*/)
+{
+	return CheckArgumentCount("$gp4_load", 2);
+}
+
+PLI_INT32 load_calltf(PLI_BYTE8* /*data*/)
+{
+	vector<vpiHandle> args = GetArguments();
+	string part = GetStringArgument(args[0]);
+	string fname = GetStringArgument(args[1]);
+
+	s_vpi_value result;
+	result.format = vpiIntVal;
+	result.value.integer = -1;
+
+	if( (fname.length() > 3) && (fname.compare(fname.length() - 3, 3, ".so") == 0) )
+	{
+		LogNotice("Loading compiled simulation model \"%s\"\n", fname.c_str());
+		Greenpak4CompiledModel* model = new Greenpak4CompiledModel;
+		if(!model->Load(fname))
+		{
+			delete model;
+			PutResult(result);
+			return 0;
+		}
+		model->RunUntil(GetSimulationTime());
+
+		result.value.integer = g_simulators.size();
+		g_simulators.push_back(model);
+		PutResult(result);
+		return 0;
+	}
+
+	Greenpak4Device::GREENPAK4_PART device_part;
+	if(part == "SLG46620V")
+		device_part = Greenpak4Device::GREENPAK4_SLG46620;
+	else if(part == "SLG46621V")
+		device_part = Greenpak4Device::GREENPAK4_SLG46621;
+	else if(part == "SLG46140V")
+		device_part = Greenpak4Device::GREENPAK4_SLG46140;
+	else
+	{
+		LogError("$gp4_load: unknown part \"%s\"\n", part.c_str());
+		PutResult(result);
+		return 0;
+	}
+
+	LogNotice("Loading bitstream \"%s\" into simulated %s\n", fname.c_str(), part.c_str());
+	LogIndenter li;
+	Greenpak4Device* device = new Greenpak4Device(device_part);
+	uint8_t userid;
+	bool readProtect;
+	if(!device->LoadFromFile(fname, userid, readProtect))
+	{
+		delete device;
+		PutResult(result);
+		return 0;
+	}
+
+	//The device powers up at time zero, so catch up if we're being loaded later
+	Greenpak4Simulator* sim = new Greenpak4Simulator(device);
+	if(!sim->Build())
+	{
+		delete sim;
+		delete device;
+		PutResult(result);
+		return 0;
+	}
+	sim->RunUntil(GetSimulationTime());
+
+	result.value.integer = g_simulators.size();
+	g_simulators.push_back(sim);
+	PutResult(result);
+	return 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// $gp4_pin(handle, pin, value)
+
+PLI_INT32 pin_compiletf(PLI_BYTE8* /*data*/)
+{
+	return CheckArgumentCount("$gp4_pin", 3);
+}
+
+PLI_INT32 pin_calltf(PLI_BYTE8* /*data*/)
+{
+	vector<vpiHandle> args = GetArguments();
+	Greenpak4SimulationModel* sim = GetSimulator(args[0]);
+	if(sim == NULL)
+		return 0;
+
+	s_vpi_value value;
+	value.format = vpiScalarVal;
+	vpi_get_value(args[2], &value);
+
+	Greenpak4SimulationModel::PinState state = Greenpak4SimulationModel::PIN_FLOAT;
+	if(value.value.scalar == vpi0)
+		state = Greenpak4SimulationModel::PIN_LOW;
+	else if(value.value.scalar == vpi1)
+		state = Greenpak4SimulationModel::PIN_HIGH;
+	sim->SetPinInput(GetIntArgument(args[1]), state);
+	return 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// $gp4_out(handle, pin)
+
+PLI_INT32 out_compiletf(PLI_BYTE8* /*data*/)
+{
+	return CheckArgumentCount("$gp4_out", 2);
+}
+
+PLI_INT32 out_sizetf(PLI_BYTE8* /*data*/)
+{
+	return 1;
+}
+
+PLI_INT32 out_calltf(PLI_BYTE8* /*data*/)
+{
+	vector<vpiHandle> args = GetArguments();
+	s_vpi_value result;
+	result.format = vpiScalarVal;
+	result.value.scalar = vpiX;
+
+	Greenpak4SimulationModel* sim = GetSimulator(args[0]);
+	if(sim != NULL)
+	{
+		switch(sim->GetPinOutput(GetIntArgument(args[1])))
+		{
+			case Greenpak4SimulationModel::PIN_LOW:
+				result.value.scalar = vpi0;
+				break;
+
+			case Greenpak4SimulationModel::PIN_HIGH:
+				result.value.scalar = vpi1;
+				break;
+
+			case Greenpak4SimulationModel::PIN_FLOAT:
+				result.value.scalar = vpiZ;
+				break;
+		}
+	}
+
+	PutResult(result);
+	return 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// $gp4_next(handle)
+
+PLI_INT32 next_compiletf(PLI_BYTE8* /*data*/)
+{
+	return CheckArgumentCount("$gp4_next", 1);
+}
+
+PLI_INT32 next_calltf(PLI_BYTE8* /*data*/)
+{
+	vector<vpiHandle> args = GetArguments();
+	s_vpi_value result;
+	result.format = vpiRealVal;
+	result.value.real = HUGE_VAL;
+
+	Greenpak4SimulationModel* sim = GetSimulator(args[0]);
+	if(sim != NULL)
+	{
+		uint64_t next = sim->GetNextEventTime();
+		if(next != Greenpak4SimulationModel::NO_EVENT)
+			result.value.real = next - GetSimulationTime();
+	}
+
+	PutResult(result);
+	return 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// $gp4_attach(handle, pins, drive)
+
+static void Exchange(Attachment* att);
+
+static PLI_INT32 attach_pins_changed(p_cb_data data)
+{
+	Exchange(reinterpret_cast<Attachment*>(data->user_data));
+	return 0;
+}
+
+static PLI_INT32 attach_wakeup(p_cb_data data)
+{
+	Attachment* att = reinterpret_cast<Attachment*>(data->user_data);
+	att->wakeup = NULL;
+	Exchange(att);
+	return 0;
+}
+
+/**
+	@brief Makes sure we get called back at the device's next event, if that's sooner than we would be anyway
+ */
+static void ScheduleWakeup(Attachment* att)
+{
+	uint64_t next = att->sim->GetNextEventTime();
+	if(next == Greenpak4SimulationModel::NO_EVENT)
+		return;
+	if( (att->wakeup != NULL) && (att->wakeupTime <= next) )
+		return;
+	if(att->wakeup != NULL)
+		vpi_remove_cb(att->wakeup);
+
+	uint64_t ticks = max(GetSimulationTicks(next - GetSimulationTime()), static_cast<uint64_t>(1));
+	s_vpi_time delay;
+	delay.type = vpiSimTime;
+	delay.high = ticks >> 32;
+	delay.low = ticks & 0xffffffff;
+
+	s_cb_data cb;
+	memset(&cb, 0, sizeof(cb));
+	cb.reason = cbAfterDelay;
+	cb.cb_rtn = attach_wakeup;
+	cb.time = &delay;
+	cb.user_data = reinterpret_cast<PLI_BYTE8*>(att);
+	att->wakeup = vpi_register_cb(&cb);
+	att->wakeupTime = next;
+}
+
+/**
+	@brief Runs an attached device up to now, tells it about any pins that changed, and drives its outputs
+ */
+static void Exchange(Attachment* att)
+{
+	Greenpak4SimulationModel* sim = att->sim;
+	sim->RunUntil(GetSimulationTime());
+
+	//Only look at the pins that changed
+	s_vpi_value value;
+	value.format = vpiVectorVal;
+	vpi_get_value(att->pins, &value);
+	for(size_t word = 0; word < att->lastPins.size(); word++)
+	{
+		s_vpi_vecval now = value.value.vector[word];
+		s_vpi_vecval& last = att->lastPins[word];
+		uint32_t changed = (now.aval ^ last.aval) | (now.bval ^ last.bval);
+		for(unsigned bit = 0; changed != 0; bit++, changed >>= 1)
+		{
+			if(!(changed & 1))
+				continue;
+
+			//z and x (bval set) mean nothing is driving the pin
+			Greenpak4SimulationModel::PinState state;
+			if((now.bval >> bit) & 1)
+				state = Greenpak4SimulationModel::PIN_FLOAT;
+			else if((now.aval >> bit) & 1)
+				state = Greenpak4SimulationModel::PIN_HIGH;
+			else
+				state = Greenpak4SimulationModel::PIN_LOW;
+			sim->SetPinInput(word*32 + bit + 1, state);
+		}
+		last = now;
+	}
+
+	//Drive all the pins in one go, if any of them changed
+	vector<s_vpi_vecval> drive(att->lastDrive.size());
+	for(int pin = 1; pin <= att->width; pin++)
+	{
+		s_vpi_vecval& bits = drive[(pin - 1) / 32];
+		uint32_t mask = 1u << ((pin - 1) % 32);
+		switch(sim->GetPinOutput(pin))
+		{
+			case Greenpak4SimulationModel::PIN_LOW:
+				break;
+
+			case Greenpak4SimulationModel::PIN_HIGH:
+				bits.aval |= mask;
+				break;
+
+			case Greenpak4SimulationModel::PIN_FLOAT:
+				bits.bval |= mask;
+				break;
+		}
+	}
+	for(size_t word = 0; word < drive.size(); word++)
+	{
+		if( (drive[word].aval != att->lastDrive[word].aval) || (drive[word].bval != att->lastDrive[word].bval) )
+		{
+			att->lastDrive = drive;
+			value.format = vpiVectorVal;
+			value.value.vector = &drive[0];
+			vpi_put_value(att->drive, &value, NULL, vpiNoDelay);
+			break;
+		}
+	}
+
+	ScheduleWakeup(att);
+}
+
+PLI_INT32 attach_compiletf(PLI_BYTE8* /*data*/)
+{
+	vector<vpiHandle> args = GetArguments();
+	if(args.size() != 3)
+	{
+		LogError("$gp4_attach takes 3 arguments\n");
+		vpi_control(vpiFinish, 1);
+		return 0;
+	}
+
+	Attachment* att = new Attachment;
+	att->pins = args[1];
+	att->drive = args[2];
+	att->width = vpi_get(vpiSize, att->pins);
+	if(vpi_get(vpiSize, att->drive) != att->width)
+	{
+		LogError("$gp4_attach: pins and drive must be the same width\n");
+		vpi_control(vpiFinish, 1);
+		delete att;
+		return 0;
+	}
+
+	vpi_put_userdata(vpi_handle(vpiSysTfCall, NULL), att);
+	return 0;
+}
+
+PLI_INT32 attach_calltf(PLI_BYTE8* /*data*/)
+{
+	vector<vpiHandle> args = GetArguments();
+	Attachment* att = reinterpret_cast<Attachment*>(vpi_get_userdata(vpi_handle(vpiSysTfCall, NULL)));
+	if(att == NULL)
+		return 0;
+	if(att->sim != NULL)
+	{
+		LogError("$gp4_attach: this call has already attached a device\n");
+		return 0;
+	}
+
+	att->sim = GetSimulator(args[0]);
+	if(att->sim == NULL)
+		return 0;
+
+	//Start out thinking everything is x, which we never drive, so the first exchange sends everything
+	s_vpi_vecval unknown;
+	unknown.aval = ~0;
+	unknown.bval = ~0;
+	att->lastPins.assign((att->width + 31) / 32, unknown);
+	att->lastDrive = att->lastPins;
+
+	s_vpi_value value;
+	value.format = vpiSuppressVal;
+	s_vpi_time time;
+	time.type = vpiSuppressTime;
+
+	s_cb_data cb;
+	memset(&cb, 0, sizeof(cb));
+	cb.reason = cbValueChange;
+	cb.cb_rtn = attach_pins_changed;
+	cb.obj = att->pins;
+	cb.time = &time;
+	cb.value = &value;
+	cb.user_data = reinterpret_cast<PLI_BYTE8*>(att);
+	vpi_register_cb(&cb);
+
+	Exchange(att);
+	return 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// $gp4_vin(handle, pin, volts)
+
+PLI_INT32 vin_compiletf(PLI_BYTE8* /*data*/)
+{
+	return CheckArgumentCount("$gp4_vin", 3);
+}
+
+PLI_INT32 vin_calltf(PLI_BYTE8* /*data*/)
+{
+	vector<vpiHandle> args = GetArguments();
+	Greenpak4Simulator* sim = GetAnalogSimulator("$gp4_vin", args[0]);
+	if(sim != NULL)
+		sim->SetPinVoltage(GetIntArgument(args[1]), GetRealArgument(args[2]));
+	return 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// $gp4_vout(handle, pin)
+
+PLI_INT32 vout_compiletf(PLI_BYTE8* /*data*/)
+{
+	return CheckArgumentCount("$gp4_vout", 2);
+}
+
+PLI_INT32 vout_calltf(PLI_BYTE8* /*data*/)
+{
+	vector<vpiHandle> args = GetArguments();
+	s_vpi_value result;
+	result.format = vpiRealVal;
+	result.value.real = 0;
+
+	Greenpak4Simulator* sim = GetAnalogSimulator("$gp4_vout", args[0]);
+	if(sim != NULL)
+		result.value.real = sim->GetPinVoltage(GetIntArgument(args[1]));
 
+	PutResult(result);
 	return 0;
 }
@@ -0,0 +1,257 @@
+/***********************************************************************************************************************
+ * Copyright (C) 2016 Andrew Zonenberg and contributors                                                                *
+ *                                                                                                                     *
+ * This program is free software; you can redistribute it and/or modify it under the terms of the GNU Lesser General   *
+ * Public License as published by the Free Software Foundation; either version 2.1 of the License, or (at your option) *
+ * any later version.                                                                                                  *
+ *                                                                                                                     *
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied  *
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for     *
+ * more details.                                                                                                       *
+ *                                                                                                                     *
+ * You should have received a copy of the GNU Lesser General Public License along with this program; if not, you may   *
+ * find one here:                                                                                                      *
+ * https://www.gnu.org/licenses/old-licenses/lgpl-2.1.txt                                                              *
+ * or you may search the http://www.gnu.org website for the version 2.1 license, or you may write to the Free Software *
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA                                      *
+ **********************************************************************************************************************/
+
+#include <cerrno>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <log.h>
+#include "gpdevboard.h"
+
+using namespace std;
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Board sessions
+
+/**
+	@brief Checks if we have a trim for a part, frequency and voltage
+ */
+bool BoardSession::HasTrim(SilegoPart targetPart, int freq, double voltage) const
+{
+	return (part == targetPart) && (trimFreq == freq) && (fabs(trimVoltage - voltage) < 0.001);
+}
+
+/**
+	@brief Converts the session to the text the broker keeps (which is empty if there's nothing to keep)
+ */
+string BoardSession::Serialize() const
+{
+	if(part == SilegoPart::UNRECOGNIZED)
+		return "";
+
+	char buf[128];
+	snprintf(buf, sizeof(buf), "trim %s %d %.3f %d", PartName(part), trimFreq, trimVoltage, trimFtw);
+	return buf;
+}
+
+/**
+	@brief Loads a session from the output of Serialize()
+
+	@return False if the text isn't a session we understand (which leaves the session empty)
+ */
+bool BoardSession::Parse(const string& text)
+{
+	*this = BoardSession();
+	if(text.empty())
+		return true;
+
+	char name[32];
+	int freq;
+	double voltage;
+	int ftw;
+	if(4 != sscanf(text.c_str(), "trim %31s %d %lf %d", name, &freq, &voltage, &ftw))
+		return false;
+	if( (freq <= 0) || (voltage <= 0) || (ftw < 0) || (ftw > 0x7f) )
+		return false;
+
+	SilegoPart parts[] = { SLG46620V, SLG46621V, SLG46140V };
+	for(auto p : parts)
+	{
+		if(!strcmp(name, PartName(p)))
+			part = p;
+	}
+	if(part == SilegoPart::UNRECOGNIZED)
+		return false;
+
+	trimFreq = freq;
+	trimVoltage = voltage;
+	trimFtw = ftw;
+	return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Board broker client
+
+/**
+	@brief Gets the path of the socket gp4broker listens on ($GP4BROKER_SOCKET, if set)
+ */
+string GetBrokerSocketPath()
+{
+	const char* path = getenv("GP4BROKER_SOCKET");
+	if(path && *path)
+		return path;
+	return "/tmp/gp4broker.sock";
+}
+
+/**
+	@brief Connects to the board broker, if one is running
+
+	@return The connection, or -1 if there's no broker (which isn't an error: the caller can look for boards itself)
+ */
+int ConnectToBroker(const string& path)
+{
+	sockaddr_un addr;
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	if(path.length() >= sizeof(addr.sun_path))
+	{
+		LogError("Socket path %s is too long\n", path.c_str());
+		return -1;
+	}
+	strncpy(addr.sun_path, path.c_str(), sizeof(addr.sun_path) - 1);
+
+	int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	if(fd < 0)
+		return -1;
+	if(0 != connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)))
+	{
+		LogDebug("No board broker at %s (%s)\n", path.c_str(), strerror(errno));
+		close(fd);
+		return -1;
+	}
+	return fd;
+}
+
+/**
+	@brief Reads one line of a reply from the broker (without the newline)
+ */
+static bool ReadBrokerLine(int fd, string& line)
+{
+	line.clear();
+	while(true)
+	{
+		char c;
+		ssize_t len = recv(fd, &c, 1, 0);
+		if( (len < 0) && (errno == EINTR) )
+			continue;
+		if(len <= 0)
+			return false;
+		if(c == '\n')
+			return true;
+		line += c;
+	}
+}
+
+/**
+	@brief Asks the broker for a board with a given part in its socket, waiting until one is free, and opens it
+
+	The broker has already checked the part and the socket, so the board is ready to use. The lease lasts for as long
+	as the connection to the broker stays open, which is usually until the process exits (so a test that crashes can't
+	keep a board forever). Close the connection to give the board back early, once it's been closed with USBCleanup().
+
+	@param fd		Connection from ConnectToBroker()
+	@param part		Part we want
+	@param session	If not NULL, gets what the broker remembers about the board from earlier leases
+
+	@return The board, or NULL if the broker has no board with that part (or it couldn't be opened)
+ */
+hdevice LeaseBoard(int fd, SilegoPart part, BoardSession* session)
+{
+	LogNotice("Asking the board broker for a board with a %s installed...\n", PartName(part));
+	LogIndenter li;
+
+	string request = string("lease ") + PartName(part) + "\n";
+	if(send(fd, request.c_str(), request.length(), MSG_NOSIGNAL) != (ssize_t)request.length())
+	{
+		LogError("Couldn't send request to the board broker\n");
+		return NULL;
+	}
+
+	//The reply only comes once a board is free, which may be a while if every one is leased
+	string reply;
+	if(!ReadBrokerLine(fd, reply))
+	{
+		LogError("Board broker hung up without leasing us a board\n");
+		return NULL;
+	}
+
+	int index;
+	char serial[128];
+	int sessionStart = 0;
+	if(2 != sscanf(reply.c_str(), "board %d %127s %n", &index, serial, &sessionStart))
+	{
+		LogError("Board broker couldn't lease us a board: %s\n", reply.c_str());
+		return NULL;
+	}
+	LogVerbose("Leased board %d (%s)\n", index, serial);
+
+	//A session we don't understand (from a newer broker, say) just means setting up from scratch
+	if(session && !session->Parse(reply.substr(sessionStart)))
+		LogDebug("Ignoring board session \"%s\"\n", reply.c_str() + sessionStart);
+
+	hdevice hdev = OpenBoard(index);
+	if(!hdev)
+		return NULL;
+
+	//Boards are numbered in enumeration order, so make sure nothing has been plugged in or out since
+	string actual;
+	if(!GetBoardSerial(hdev, actual))
+	{
+		USBCleanup(hdev);
+		return NULL;
+	}
+	if(actual != serial)
+	{
+		LogError("Board %d is %s, but board broker leased us %s\n", index, actual.c_str(), serial);
+		USBCleanup(hdev);
+		return NULL;
+	}
+
+	return hdev;
+}
+
+/**
+	@brief Tells the broker what we've found out about a leased board, to pass on with the board's next lease
+ */
+bool UpdateLease(int fd, const BoardSession& session)
+{
+	string request = "session " + session.Serialize() + "\n";
+	if(send(fd, request.c_str(), request.length(), MSG_NOSIGNAL) != (ssize_t)request.length())
+	{
+		LogWarning("Couldn't send board session to the board broker\n");
+		return false;
+	}
+	return true;
+}
+
+/**
+	@brief Tells the broker how a leased board's USB link has behaved so far (see USBStatistics), for its metrics
+ */
+bool ReportLeaseUsage(int fd, hdevice hdev)
+{
+	USBStatistics stats = GetUSBStatistics(hdev);
+
+	char request[128];
+	snprintf(request, sizeof(request), "usage %u %u %llu %.6f\n",
+		stats.retries,
+		stats.errors,
+		static_cast<unsigned long long>(stats.downloadBytes),
+		stats.downloadSeconds);
+	ssize_t len = strlen(request);
+	if(send(fd, request, len, MSG_NOSIGNAL) != len)
+	{
+		LogWarning("Couldn't send board usage to the board broker\n");
+		return false;
+	}
+	return true;
+}
@@ -22,6 +22,8 @@
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 // System / library headers
 
+#include <cstring>
+#include <deque>
 #include <string>
 #include <vector>
 
@@ -33,10 +35,93 @@ typedef struct libusb_device_handle* hdevice;
 bool USBSetup();
 void USBCleanup(hdevice hdev);
 
+int CountDevices(uint16_t idVendor);
 hdevice OpenDevice(uint16_t idVendor, uint16_t idProduct, int nboard);
 bool GetStringDescriptor(hdevice hdev, uint8_t index, std::string &desc);
-bool SendInterruptTransfer(hdevice hdev, const uint8_t* buf, size_t size);
-bool ReceiveInterruptTransfer(hdevice hdev, uint8_t* buf, size_t size);
+bool GetBoardSerial(hdevice hdev, std::string& serial);
+unsigned int CountDeviceArrivals(uint16_t idVendor, uint16_t idProduct);
+bool WaitForDeviceArrival(uint16_t idVendor, uint16_t idProduct, unsigned int since, unsigned int timeoutMs);
+bool SendInterruptTransfer(hdevice hdev, const uint8_t* buf, size_t size, unsigned int timeoutMs = 250,
+	bool* timedOut = NULL);
+bool ReceiveInterruptTransfer(hdevice hdev, uint8_t* buf, size_t size, unsigned int timeoutMs = 250,
+	bool* timedOut = NULL);
+
+/**
+	@brief How quickly a board has been answering commands, and how often it's needed a second try
+ */
+class USBStatistics
+{
+public:
+	///Round-trips timed so far (only ones that worked first time, and only for commands the board answers at once)
+	unsigned int roundtrips = 0;
+
+	///Commands that had to be sent again
+	unsigned int retries = 0;
+
+	///Transfers that failed outright (rather than timing out and being retried)
+	unsigned int errors = 0;
+
+	///Bitstream bytes downloaded, and the time it took
+	uint64_t downloadBytes = 0;
+	double downloadSeconds = 0;
+
+	///Smoothed round-trip time and its mean deviation (as TCP keeps them), in ms
+	double meanRoundtrip = 0;
+	double roundtripDeviation = 0;
+
+	///Slowest round-trip so far, in ms
+	double maxRoundtrip = 0;
+};
+
+unsigned int GetUSBTimeout(hdevice hdev, unsigned int minTimeoutMs);
+void RecordUSBRoundtrip(hdevice hdev, double ms);
+void RecordUSBRetry(hdevice hdev);
+void RecordUSBError(hdevice hdev);
+void RecordUSBDownload(hdevice hdev, size_t bytes, double seconds);
+USBStatistics GetUSBStatistics(hdevice hdev);
+
+/**
+	@brief One frame in a USB trace, as it went over the wire
+
+	Trace files start with "GP4USBTR", then the version and record count (32 bits each), then the records oldest
+	first, each written as these fields in order (little-endian, 84 bytes in all). The layout mustn't change without
+	bumping USB_TRACE_VERSION.
+ */
+class USBTraceRecord
+{
+public:
+	///When the transfer started, in ns since StartUSBTrace() (pipelined transfers are only seen when they finish)
+	uint64_t timestamp;
+
+	///How long the transfer took, in ns (0 for pipelined transfers)
+	uint32_t duration;
+
+	///libusb error code (0 if the transfer went through, LIBUSB_ERROR_INTERRUPTED for cancelled pipelined transfers)
+	int32_t status;
+
+	///Which board it was, numbered in the order they first showed up in the trace
+	uint16_t board;
+
+	///1 for device to host, 0 for host to device
+	uint8_t in;
+
+	///Bytes actually transferred
+	uint8_t length;
+
+	///The frame (all of it going out, only as much as was transferred coming in; the rest is zero)
+	uint8_t data[64];
+};
+
+enum
+{
+	USB_TRACE_VERSION = 1
+};
+
+bool StartUSBTrace(const std::string& fname, size_t frames = 4096);
+bool IsUSBTracing();
+bool WriteUSBTrace();
+bool ReadUSBTrace(const std::string& fname, std::vector<USBTraceRecord>& records);
+const char* GetUSBErrorName(int err);
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 // Board protocol stuff
@@ -131,23 +216,21 @@ public:
 	double voltageB = 0.0;
 };
 
-//Logical view of a data packet on the wire
-//Not actual bitstream ordering, but contains all the data
+//A data packet, stored exactly as it goes over the wire so it can be handed straight to libusb:
+//sequence number A, type, length (0 if there's no payload, otherwise 3 + payload size), sequence number B, payload
 class DataFrame
 {
 public:
 	DataFrame()
-		: m_type(0)
-		, m_sequenceA(0)
-		, m_sequenceB(0)
 	{
+		memset(m_data, 0, sizeof(m_data));
 	}
 
 	DataFrame(uint8_t type)
-		: m_type(type)
-		, m_sequenceA(1)
-		, m_sequenceB(0)
 	{
+		memset(m_data, 0, sizeof(m_data));
+		m_data[0] = 1;
+		m_data[1] = type;
 	}
 
 	DataFrame(const char *ascii);
@@ -177,33 +260,154 @@ public:
 		TRIM_OSC					= 0x49
 	};
 
+	enum
+	{
+		FRAME_SIZE = 64,
+		MAX_PAYLOAD = 60
+	};
+
+	///Shortest time each kind of command is given, in ms (GetUSBTimeout() stretches them on a slow link)
+	enum
+	{
+		TIMEOUT_COMMAND = 250,		//anything the board answers straight away
+		TIMEOUT_MEASURE = 1000,		//oscillator trims and frequency measurements
+		TIMEOUT_NVRAM = 2000		//NVRAM writes, which wait for the flash
+	};
+
+	///Most times a command that's safe to repeat is sent before giving up
+	enum
+	{
+		MAX_ATTEMPTS = 3
+	};
+
 	bool Send(hdevice hdev);
 	bool Receive(hdevice hdev);
 	bool Roundtrip(hdevice hdev);
 	bool Roundtrip(hdevice hdev, uint8_t ack_type);
+	bool Query(hdevice hdev, DataFrame& reply);
+
+	unsigned int GetMinTimeout() const;
+	bool IsIdempotent() const;
+
+	void OnReceived();
+	void Log(const char* direction) const;
+	static const char* GetTypeName(uint8_t type);
+	bool IsAck(const DataFrame& ack_frame, uint8_t ack_type) const;
+
+	uint8_t GetSequenceA() const
+	{ return m_data[0]; }
+
+	uint8_t GetType() const
+	{ return m_data[1]; }
+
+	uint8_t GetSequenceB() const
+	{ return m_data[3]; }
+
+	void SetType(uint8_t type)
+	{ m_data[1] = type; }
+
+	void SetSequenceB(uint8_t seq)
+	{ m_data[3] = seq; }
 
-	bool IsEmpty()
-	{ return m_payload.size() == 0; }
+	size_t GetPayloadSize() const
+	{ return (m_data[2] > 3) ? (m_data[2] - 3) : 0; }
 
-	bool IsFull()
-	{ return m_payload.size() == 60; }
+	const uint8_t* GetPayload() const
+	{ return m_data + 4; }
+
+	///The whole frame, ready to go over the wire (or to receive into)
+	uint8_t* GetData()
+	{ return m_data; }
+
+	const uint8_t* GetData() const
+	{ return m_data; }
+
+	bool IsEmpty() const
+	{ return GetPayloadSize() == 0; }
+
+	bool IsFull() const
+	{ return GetPayloadSize() == MAX_PAYLOAD; }
+
+	size_t GetFreeSpace() const
+	{ return MAX_PAYLOAD - GetPayloadSize(); }
+
+	void Append(const uint8_t* data, size_t len);
 
 	void push_back(uint8_t b)
-	{ m_payload.push_back(b); }
+	{ Append(&b, 1); }
 
-	DataFrame Next()
+	DataFrame Next() const
 	{
-		DataFrame next_frame(m_type);
-		next_frame.m_sequenceA = m_sequenceA + 1;
-		next_frame.m_sequenceB = m_sequenceB - 1;
+		DataFrame next_frame(GetType());
+		next_frame.m_data[0] = GetSequenceA() + 1;
+		next_frame.m_data[3] = GetSequenceB() - 1;
 		return next_frame;
 	}
 
+protected:
+	uint8_t m_data[FRAME_SIZE];
+};
+
+struct PendingFrame;
+struct PendingRead;
+
+/**
+	@brief Keeps several frames in flight to a board at once, rather than waiting for each acknowledgement in turn
+
+	While a pipeline exists, DataFrame::Send() and DataFrame::Roundtrip() on its board queue the frame and return
+	straight away, so true only means nothing has failed yet. Acknowledgements are matched to their frames by sequence
+	number as they come back. Flush() waits for everything in flight and says whether it all worked. The destructor
+	flushes too, but can't report errors, so callers that care have to Flush() themselves.
+
+	DataFrame::Receive() flushes first, so a command that reads a reply still sees the reply to its own request.
+	A pipeline created while another is active on the same board just adds its frames to the outer one.
+
+	Different boards can be driven from different threads, but each board's pipeline belongs to one thread.
+ */
+class FramePipeline
+{
 public:
-	uint8_t m_type;
-	uint8_t m_sequenceA;
-	uint8_t m_sequenceB;
-	std::vector<uint8_t> m_payload;
+	FramePipeline(hdevice hdev, unsigned int depth = DEFAULT_DEPTH);
+	~FramePipeline();
+
+	bool Send(const DataFrame& frame);
+	bool Roundtrip(const DataFrame& frame, uint8_t ack_type);
+	bool Request(const DataFrame& frame, uint8_t reply_type);
+	bool NextReply(DataFrame& reply);
+	bool Flush();
+
+	static FramePipeline* Get(hdevice hdev);
+
+	enum
+	{
+		DEFAULT_DEPTH = 4
+	};
+
+protected:
+	bool Queue(const DataFrame& frame, int ack_type, bool keep_reply);
+	bool Complete();
+	void CancelAll();
+
+	///The board we're talking to
+	hdevice m_hdev;
+
+	///Most frames allowed in flight at once
+	unsigned int m_depth;
+
+	///Frames in flight, oldest first
+	std::deque<PendingFrame*> m_pending;
+
+	///Reads posted for acknowledgements that haven't come back yet, oldest first
+	std::deque<PendingRead*> m_reads;
+
+	///Replies to frames sent with Request() that NextReply() hasn't returned yet, oldest first
+	std::deque<DataFrame> m_replies;
+
+	///False once anything has failed
+	bool m_ok;
+
+	///The pipeline that was already active on this board when we were created, which we add our frames to
+	FramePipeline* m_outer;
 };
 
 bool SwitchMode(hdevice hdev);
@@ -214,6 +418,7 @@ bool Reset(hdevice hdev);
 
 bool SetStatusLED(hdevice hdev, bool status);
 bool SetIOConfig(hdevice hdev, IOConfig& config);
+void ForgetBoardConfig(hdevice hdev);
 
 enum class SiggenCommand
 {
@@ -227,6 +432,7 @@ enum class SiggenCommand
 bool ConfigureSiggen(hdevice hdev, uint8_t channel, double voltage);
 bool ResetAllSiggens(hdevice hdev);
 bool ControlSiggen(hdevice hdev, unsigned int chan, SiggenCommand cmd);
+bool ControlSiggens(hdevice hdev, const std::vector<unsigned int>& chans, SiggenCommand cmd);
 
 enum class DownloadMode
 {
@@ -236,11 +442,32 @@ enum class DownloadMode
 };
 
 bool UploadBitstream(hdevice hdev, size_t octets, std::vector<uint8_t> &bitstream);
-bool DownloadBitstream(hdevice hdev, std::vector<uint8_t> bitstream, DownloadMode mode);
+bool DownloadBitstream(hdevice hdev, const std::vector<uint8_t>& bitstream, DownloadMode mode);
+bool DownloadBitstream(hdevice hdev, const uint8_t* bitstream, size_t len, DownloadMode mode);
 
 bool SelectADCChannel(hdevice hdev, unsigned int chan);
 bool ReadADC(hdevice hdev, double &value);
 bool SingleReadADC(hdevice hdev, unsigned int chan, double &value);
+bool BurstReadADC(
+	hdevice hdev,
+	const std::vector<unsigned int>& channels,
+	unsigned int samples,
+	std::vector<double>& values);
+
+/**
+	@brief Statistics for one channel of a burst from BurstReadADC()
+ */
+class ADCStatistics
+{
+public:
+	unsigned int count = 0;
+	double mean = 0.0;
+	double min = 0.0;
+	double max = 0.0;
+	double stddev = 0.0;
+};
+
+void GetADCStatistics(const std::vector<double>& values, size_t nchannels, std::vector<ADCStatistics>& stats);
 
 bool TrimOscillator(hdevice hdev, uint8_t ftw);
 bool MeasureOscillatorFrequency(hdevice hdev, unsigned &freq);
@@ -258,13 +485,16 @@ enum class BitstreamKind
 };
 
 bool CheckStatus(hdevice hdev);
+int CountBoards();
 hdevice OpenBoard(int nboard, bool test = false);
 bool DetectPart(
 	hdevice hdev,
 	SilegoPart& detectedPart,
 	std::vector<uint8_t>& programmedBitstream,
 	BitstreamKind& bitstreamKind);
-BitstreamKind ClassifyBitstream(SilegoPart part, std::vector<uint8_t> bitstream, uint8_t &patternId);
+BitstreamKind ClassifyBitstream(SilegoPart part, const std::vector<uint8_t>& bitstream, uint8_t &patternId);
+uint64_t BitstreamContentHash(SilegoPart part, const std::vector<uint8_t>& bitstream);
+bool HoldsBitstream(SilegoPart part, const std::vector<uint8_t>& programmed, const std::vector<uint8_t>& expected);
 bool DistinguishSLG4662X(hdevice hdev, SilegoPart& detectedPart);
 
 bool VerifyDevicePresent(hdevice hdev, SilegoPart expectedPart);
@@ -272,11 +502,91 @@ bool VerifyDevicePresent(hdevice hdev, SilegoPart expectedPart);
 const char *PartName(SilegoPart part);
 size_t BitstreamLength(SilegoPart part);
 
-bool TrimOscillator(hdevice hdev, SilegoPart part, double voltage, unsigned freq, uint8_t &ftw);
-bool SocketTest(hdevice hdev, SilegoPart part);
+/**
+	@brief What a board's RC oscillator frequency looks like as a function of the trim value
+
+	TrimOscillator() keeps one of these up to date when given one, and uses it to guess the trim value of the next part
+	rather than searching for it from scratch. Parts differ a little, but the slope barely changes from one part to the
+	next, so a guess is usually within a step or two. The model only holds for the target frequency and voltage it was
+	measured at, and for parts trimmed on the same board.
+ */
+class OscillatorCalibration
+{
+public:
+	OscillatorCalibration()
+		: m_freq(0)
+		, m_voltage(0)
+		, m_slope(0)
+		, m_offset(0)
+		, m_parts(0)
+	{}
+
+	bool IsValidFor(unsigned freq, double voltage) const
+	{ return (m_parts > 0) && (m_freq == freq) && (m_voltage == voltage); }
+
+	int Predict(unsigned freq) const;
+	bool Update(unsigned freq, double voltage, const std::vector<std::pair<int, unsigned> >& measurements);
+
+	double GetSlope() const
+	{ return m_slope; }
+
+	unsigned int GetParts() const
+	{ return m_parts; }
+
+protected:
+	///Target frequency and Vdd the model was measured for
+	unsigned m_freq;
+	double m_voltage;
+
+	///Frequency in Hz is m_offset + m_slope * FTW
+	double m_slope;
+	double m_offset;
+
+	///Number of parts the model has been fitted to so far
+	unsigned int m_parts;
+};
+
+bool TrimOscillator(
+	hdevice hdev,
+	SilegoPart part,
+	double voltage,
+	unsigned freq,
+	uint8_t &ftw,
+	OscillatorCalibration* calibration = NULL);
+bool SocketTest(hdevice hdev, SilegoPart part, bool quick = false);
+
+/**
+	@brief How often CachedSocketTest() runs the full socket test, with only the quick check in between
+ */
+class SocketTestPolicy
+{
+public:
+	SocketTestPolicy()
+		: maxAge(3600)
+		, maxParts(100)
+		, cacheFile("/tmp/gpdevboard-socket-health")
+	{}
+
+	//Seconds since the last full test before another is needed
+	double maxAge;
+
+	//Parts since the last full test before another is needed
+	unsigned int maxParts;
+
+	//Where the time of each board's last full test is kept, so it carries over between processes
+	std::string cacheFile;
+};
+
+bool CachedSocketTest(hdevice hdev, SilegoPart part, const SocketTestPolicy& policy = SocketTestPolicy());
 
 std::vector<uint8_t> BitstreamFromHex(std::string hex);
 bool ReadBitstream(std::string fname, std::vector<uint8_t>& bitstream, SilegoPart part);
+bool ReadBinaryBitstream(
+	std::string fname,
+	const uint8_t* data,
+	size_t len,
+	std::vector<uint8_t>& bitstream,
+	SilegoPart part);
 
 bool TweakBitstream(
 	std::vector<uint8_t>& bitstream,
@@ -285,8 +595,60 @@ bool TweakBitstream(
 	uint8_t patternID,
 	bool readProtect);
 
-bool TestSetup(hdevice hdev, std::string fname, int rcOscFreq, double voltage, SilegoPart targetPart);
+/**
+	@brief What gp4broker remembers about a board from one lease to the next, so TestSetup() can skip work
+
+	The broker resets each board when its lease ends, so the only setup worth remembering is what survives a reset.
+	That's the oscillator trim: the slowest part of TestSetup() (a download and a measurement for each step), yet it
+	only depends on the part in the socket and the frequency and voltage it was trimmed for.
+ */
+class BoardSession
+{
+public:
+	BoardSession()
+		: part(SilegoPart::UNRECOGNIZED)
+		, trimFreq(0)
+		, trimVoltage(0)
+		, trimFtw(0)
+	{}
+
+	bool HasTrim(SilegoPart targetPart, int freq, double voltage) const;
 
-hdevice MultiBoardTestSetup(std::string fname, int rcOscFreq, double voltage, SilegoPart targetPart);
+	std::string Serialize() const;
+	bool Parse(const std::string& text);
+
+	//Part the trim was found for (UNRECOGNIZED if there isn't one yet)
+	SilegoPart part;
+
+	//Frequency and voltage the oscillator was trimmed for, and the trim value found
+	int trimFreq;
+	double trimVoltage;
+	uint8_t trimFtw;
+};
+
+std::string GetBrokerSocketPath();
+int ConnectToBroker(const std::string& path = GetBrokerSocketPath());
+hdevice LeaseBoard(int fd, SilegoPart part, BoardSession* session = NULL);
+bool UpdateLease(int fd, const BoardSession& session);
+bool ReportLeaseUsage(int fd, hdevice hdev);
+
+bool TestSetup(
+	hdevice hdev,
+	std::string fname,
+	int rcOscFreq,
+	double voltage,
+	SilegoPart targetPart,
+	std::vector<uint8_t>* downloadedBitstream = NULL,
+	bool checked = false,
+	BoardSession* session = NULL);
+
+hdevice MultiBoardTestSetup(
+	std::string fname,
+	int rcOscFreq,
+	double voltage,
+	SilegoPart targetPart,
+	std::vector<uint8_t>* downloadedBitstream = NULL);
+
+bool RestartTest(hdevice hdev, const std::vector<uint8_t>& downloadedBitstream);
 
 #endif
@@ -16,7 +16,13 @@
  * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA                                      *
  **********************************************************************************************************************/
 
+#include <chrono>
+#include <cstdio>
+#include <map>
+#include <mutex>
 #include <log.h>
+#include <debuglog.h>
+#include <trace.h>
 #include <gpdevboard.h>
 
 using namespace std;
@@ -67,112 +73,388 @@ probe process("/usr/lib/libSilegoUSB-2.0.so.1").
 }
 
 */
+static uint8_t HexDigit(char c)
+{
+	if( (c >= '0') && (c <= '9') )
+		return c - '0';
+	if( (c >= 'a') && (c <= 'f') )
+		return c - 'a' + 10;
+	if( (c >= 'A') && (c <= 'F') )
+		return c - 'A' + 10;
+	return 0;
+}
+
+/**
+	@brief Parses a frame as printed by the systemtap script above (or Log()): four header bytes separated by _,
+	then 60 bytes of payload, all in hex
+ */
 DataFrame::DataFrame(const char *ascii)
 {
-	uint8_t size;
-	sscanf(ascii, "%02hhx_%02hhx_%02hhx_%02hhx_", &m_sequenceA, &m_type, &size, &m_sequenceB);
-	for(size_t i=0; i<60; i++)
+	memset(m_data, 0, sizeof(m_data));
+	const char* p = ascii;
+	for(size_t i=0; i<FRAME_SIZE; i++)
 	{
-		uint8_t byte;
-		sscanf(ascii+12+i*2, "%02hhx", &byte);
-		m_payload.push_back(byte);
+		if(!p[0] || !p[1])
+			break;
+		m_data[i] = (HexDigit(p[0]) << 4) | HexDigit(p[1]);
+		p += 2;
+
+		//Header bytes are followed by a separator
+		if(i < 4)
+		{
+			if(*p != '_')
+				break;
+			p++;
+		}
 	}
-	if(size > 3)
-		m_payload.resize(size - 3);
 }
 
-bool DataFrame::Send(hdevice hdev)
+/**
+	@brief Prints a raw frame in hex, as one message so it costs one call to the logger rather than one per byte
+ */
+void DataFrame::Log(const char* direction) const
 {
-	uint8_t data[64] = {};
-
-	//Packet header
-	data[0] = m_sequenceA;
-	data[1] = m_type;
-	if(m_payload.size() == 0)
-		data[2] = 0x00;
-	else
-		data[2] = 3 + m_payload.size();
-	data[3] = m_sequenceB;
-
-	//Packet body
-	for(size_t i=0; i<m_payload.size(); i++)
-		data[4+i] = m_payload[i];
-
-	LogDebug("H→D: ");
+	//Two digits per byte, plus a separator after each header byte
+	static const char digits[] = "0123456789abcdef";
+	char hex[64*2 + 4 + 1];
+	char* p = hex;
 	for(int i=0; i<64; i++)
 	{
-		LogDebug("%02x", data[i] & 0xff);
-		if(i < 4) LogDebug("_");
+		*(p++) = digits[m_data[i] >> 4];
+		*(p++) = digits[m_data[i] & 0xf];
+		if(i < 4)
+			*(p++) = '_';
 	}
-	LogDebug("\n");
+	*p = '\0';
+	LogDebug("%s: %s\n", direction, hex);
+}
 
-	return SendInterruptTransfer(hdev, data, sizeof(data));
+/**
+	@brief Gets the name of a packet type, for decoding traces
+ */
+const char* DataFrame::GetTypeName(uint8_t type)
+{
+	switch(type)
+	{
+		case WRITE_BITSTREAM_NVRAM:			return "WRITE_BITSTREAM_NVRAM";
+		case READ_BITSTREAM_START:			return "READ_BITSTREAM_START";
+		case WRITE_BITSTREAM_SRAM:			return "WRITE_BITSTREAM_SRAM";
+		case CONFIG_IO:						return "CONFIG_IO";
+		case RESET:							return "RESET";
+
+		//Shared by several packets, so we can't tell which one this is from the type alone
+		case READ_BITSTREAM_CONT:			return "READ_BITSTREAM_CONT/WRITE_BITSTREAM_ACK1";
+
+		case CONFIG_SIGGEN:					return "CONFIG_SIGGEN";
+		case ENABLE_SIGGEN:					return "ENABLE_SIGGEN";
+		case GET_STATUS:					return "GET_STATUS";
+		case WRITE_BITSTREAM_NVRAM_ACK2:	return "WRITE_BITSTREAM_NVRAM_ACK2";
+		case READ_BITSTREAM_ACK:			return "READ_BITSTREAM_ACK";
+		case WRITE_BITSTREAM_SRAM_ACK2:		return "WRITE_BITSTREAM_SRAM_ACK2";
+		case SET_STATUS_LED:				return "SET_STATUS_LED";
+		case SET_PART:						return "SET_PART";
+		case CONFIG_ADC_MUX:				return "CONFIG_ADC_MUX";
+		case GET_OSC_FREQ:					return "GET_OSC_FREQ";
+		case READ_ADC:						return "READ_ADC";
+		case TRIM_OSC:						return "TRIM_OSC";
+		default:							return "unknown";
+	}
+}
+
+/**
+	@brief Adds bytes to the end of the payload
+ */
+void DataFrame::Append(const uint8_t* data, size_t len)
+{
+	size_t size = GetPayloadSize();
+	if(size + len > MAX_PAYLOAD)
+		LogFatal("DataFrame payload overflow (%zu + %zu bytes)\n", size, len);
+
+	memcpy(m_data + 4 + size, data, len);
+	m_data[2] = 3 + size + len;
+}
+
+bool DataFrame::Send(hdevice hdev)
+{
+	FramePipeline* pipeline = FramePipeline::Get(hdev);
+	if(pipeline)
+		return pipeline->Send(*this);
+
+	if(IsDebugLogging())
+		Log("H→D");
+
+	return SendInterruptTransfer(hdev, m_data, sizeof(m_data), GetUSBTimeout(hdev, GetMinTimeout()));
 }
 
 bool DataFrame::Receive(hdevice hdev)
 {
-	uint8_t data[64];
+	//Anything still in flight has to be out of the way before our reply can come back
+	FramePipeline* pipeline = FramePipeline::Get(hdev);
+	if(pipeline && !pipeline->Flush())
+		return false;
 
-	if(!ReceiveInterruptTransfer(hdev, data, sizeof(data)))
+	if(!ReceiveInterruptTransfer(hdev, m_data, sizeof(m_data), GetUSBTimeout(hdev, TIMEOUT_COMMAND)))
 		return false;
 
-	LogDebug("D→H: ");
-	for(int i=0; i<64; i++)
+	OnReceived();
+	return true;
+}
+
+/**
+	@brief Gets the shortest time a frame of our type is given to go out and be answered
+ */
+unsigned int DataFrame::GetMinTimeout() const
+{
+	switch(GetType())
 	{
-		LogDebug("%02x", data[i] & 0xff);
-		if(i < 4) LogDebug("_");
+		case WRITE_BITSTREAM_NVRAM:
+			return TIMEOUT_NVRAM;
+
+		case GET_OSC_FREQ:
+		case TRIM_OSC:
+			return TIMEOUT_MEASURE;
+
+		default:
+			return TIMEOUT_COMMAND;
 	}
-	LogDebug("\n");
-
-	//Packet header
-	uint8_t size;
-	m_sequenceA = data[0];
-	m_type = data[1];
-	if(data[2] == 0x00)
-		size = 0;
-	else if(data[2] > 3)
-		size = data[2] - 3;
-	else
-		LogFatal("Unexpected size %d\n", data[2]);
-	m_sequenceB = data[3];
+}
 
-	//Packet body
-	m_payload.resize(size);
-	for(size_t i=0; i<m_payload.size(); i++)
-		m_payload[i] = data[4+i];
+/**
+	@brief Checks if sending a frame of our type twice does the same as sending it once, so it's safe to try again if
+	it or its answer goes missing
 
-	return true;
+	Bitstream transfers aren't, since the board keeps track of how far through one it is, and neither are oscillator
+	trims, which are part of a search that depends on each step.
+ */
+bool DataFrame::IsIdempotent() const
+{
+	switch(GetType())
+	{
+		case CONFIG_IO:
+		case RESET:
+		case CONFIG_SIGGEN:
+		case GET_STATUS:
+		case SET_STATUS_LED:
+		case SET_PART:
+		case CONFIG_ADC_MUX:
+		case GET_OSC_FREQ:
+		case READ_ADC:
+			return true;
+
+		default:
+			return false;
+	}
 }
 
-bool DataFrame::Roundtrip(hdevice hdev, uint8_t ack_type)
+/**
+	@brief Checks a frame that's just been received into GetData()
+ */
+void DataFrame::OnReceived()
 {
-	if(!Send(hdev))
-		return false;
+	if(IsDebugLogging())
+		Log("D→H");
 
-	// Receive an acknowledgement frame
-	DataFrame ack_frame;
-	if(!ack_frame.Receive(hdev))
-		return false;
+	if( (m_data[2] != 0x00) && (m_data[2] <= 3) )
+		LogFatal("Unexpected size %d\n", m_data[2]);
+	if(GetPayloadSize() > MAX_PAYLOAD)
+		LogFatal("Unexpected size %d\n", m_data[2]);
+}
 
-	// Compare the two frames.
+/**
+	@brief Checks whether a frame we received is the acknowledgement of this one
+ */
+bool DataFrame::IsAck(const DataFrame& ack_frame, uint8_t ack_type) const
+{
 	// Received frame will usually have length 0x3f; it is unimportant.
 	// Received frame will sometimes have the same sequence number B, sometimes not. It is unimportant.
-	if(!(m_sequenceA == ack_frame.m_sequenceA &&
-	     ack_type == ack_frame.m_type &&
-	     m_payload.size() <= ack_frame.m_payload.size() &&
-	     std::equal(m_payload.begin(), m_payload.end(),
-	                ack_frame.m_payload.begin())))
+	size_t size = GetPayloadSize();
+	return GetSequenceA() == ack_frame.GetSequenceA() &&
+	       ack_type == ack_frame.GetType() &&
+	       size <= ack_frame.GetPayloadSize() &&
+	       !memcmp(GetPayload(), ack_frame.GetPayload(), size);
+}
+
+/**
+	@brief Sends a frame and waits for the frame that answers it, trying again if it's safe to and something went
+	missing
+
+	Frames don't carry anything that tells one attempt from the next, so once we've had to try again the answer
+	to an earlier attempt may still turn up. Frames that don't answer us are skipped, and after a retry works we wait
+	a little for a second answer, so neither is left in the pipe to be mistaken for the answer to the next command.
+
+	@param request		Frame to send
+	@param reply		Gets the answer
+	@param reply_type	Type of the answer
+	@param echo			True if the answer echoes the request (DataFrame::IsAck()) rather than carrying data
+ */
+static bool Exchange(hdevice hdev, const DataFrame& request, DataFrame& reply, uint8_t reply_type, bool echo)
+{
+	unsigned int minTimeout = request.GetMinTimeout();
+	unsigned int attempts = request.IsIdempotent() ? DataFrame::MAX_ATTEMPTS : 1;
+	const unsigned int maxStale = 2;
+
+	for(unsigned int attempt=0; attempt<attempts; attempt++)
 	{
-		LogError("Unexpected acknowledgement frame\n");
-		return false;
+		unsigned int timeout = GetUSBTimeout(hdev, minTimeout);
+		bool last = (attempt + 1 == attempts);
+		bool timedOut = false;
+		if(attempt > 0)
+		{
+			LogVerbose("USB command 0x%02x went unanswered, trying again (attempt %u of %u)\n",
+				request.GetType(), attempt + 1, attempts);
+			RecordUSBRetry(hdev);
+		}
+
+		if(IsDebugLogging())
+			request.Log("H→D");
+		auto start = chrono::steady_clock::now();
+		if(!SendInterruptTransfer(hdev, request.GetData(), DataFrame::FRAME_SIZE, timeout, last ? NULL : &timedOut))
+		{
+			if(timedOut)
+				continue;
+			return false;
+		}
+
+		for(unsigned int stale=0; ; stale++)
+		{
+			if(!ReceiveInterruptTransfer(hdev, reply.GetData(), DataFrame::FRAME_SIZE, timeout,
+				last ? NULL : &timedOut))
+			{
+				break;
+			}
+			reply.OnReceived();
+
+			bool answered = echo ? request.IsAck(reply, reply_type) : (reply.GetType() == reply_type);
+			if(answered)
+			{
+				if(attempt == 0)
+				{
+					if(minTimeout == DataFrame::TIMEOUT_COMMAND)
+					{
+						RecordUSBRoundtrip(hdev,
+							chrono::duration<double, milli>(chrono::steady_clock::now() - start).count());
+					}
+					return true;
+				}
+
+				//Catch the answer to whichever attempt this wasn't
+				DataFrame duplicate;
+				bool drained = false;
+				if(ReceiveInterruptTransfer(hdev, duplicate.GetData(), DataFrame::FRAME_SIZE, timeout, &drained))
+				{
+					if(IsDebugLogging())
+						duplicate.Log("D→H (duplicate, dropped)");
+				}
+				return true;
+			}
+
+			if( (attempts == 1) || (stale >= maxStale) )
+			{
+				LogError(echo ? "Unexpected acknowledgement frame\n" : "Unexpected reply\n");
+				return false;
+			}
+			if(IsDebugLogging())
+				reply.Log("D→H (stale, skipped)");
+		}
+
+		if(!timedOut)
+			return false;
 	}
 
-	return true;
+	//The last attempt reports its own failure
+	return false;
+}
+
+bool DataFrame::Roundtrip(hdevice hdev, uint8_t ack_type)
+{
+	FramePipeline* pipeline = FramePipeline::Get(hdev);
+	if(pipeline)
+		return pipeline->Roundtrip(*this, ack_type);
+
+	TraceSpan span("USB roundtrip");
+
+	DataFrame ack_frame;
+	return Exchange(hdev, *this, ack_frame, ack_type, true);
 }
 
 bool DataFrame::Roundtrip(hdevice hdev)
 {
-	return Roundtrip(hdev, m_type);
+	return Roundtrip(hdev, GetType());
+}
+
+/**
+	@brief Sends a request and gets the reply carrying its data, which has the same type as the request
+ */
+bool DataFrame::Query(hdevice hdev, DataFrame& reply)
+{
+	//Anything already in flight has to be out of the way first, so take the slow path
+	if(FramePipeline::Get(hdev))
+		return Send(hdev) && reply.Receive(hdev);
+
+	TraceSpan span("USB roundtrip");
+	return Exchange(hdev, *this, reply, GetType(), false);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Configuration cache
+
+/*
+	The I/O and signal generator configuration last sent to each board, so settings that haven't changed aren't sent
+	again. Entries are kept as the payload of the frame that set them: key 0 is the CONFIG_IO frame, and keys 1-20 are
+	the CONFIG_SIGGEN frame for that channel.
+
+	Only commands that configure I/O or signal generators, read the ADC, or check status leave the cache alone.
+	Anything else (a reset, a bitstream download, an oscillator trim...) may change the board's configuration behind
+	our back, so it forgets the whole board.
+ */
+static map<hdevice, map<int, vector<uint8_t>>> g_configCache;
+static mutex g_configCacheMutex;
+
+static const int IO_CONFIG_KEY = 0;
+
+/**
+	@brief Checks if a configuration frame would set exactly what the board was last set to
+ */
+static bool ConfigUnchanged(hdevice hdev, int key, const DataFrame& frame)
+{
+	lock_guard<mutex> lock(g_configCacheMutex);
+	auto& cache = g_configCache[hdev];
+	auto it = cache.find(key);
+	if(it == cache.end())
+		return false;
+	return it->second == vector<uint8_t>(frame.GetPayload(), frame.GetPayload() + frame.GetPayloadSize());
+}
+
+/**
+	@brief Remembers the configuration a frame set, or forgets it if the frame couldn't be sent
+ */
+static void RememberConfig(hdevice hdev, int key, const DataFrame& frame, bool sent)
+{
+	lock_guard<mutex> lock(g_configCacheMutex);
+	auto& cache = g_configCache[hdev];
+	if(sent)
+		cache[key] = vector<uint8_t>(frame.GetPayload(), frame.GetPayload() + frame.GetPayloadSize());
+	else
+		cache.erase(key);
+}
+
+static void ForgetConfig(hdevice hdev, int key)
+{
+	lock_guard<mutex> lock(g_configCacheMutex);
+	g_configCache[hdev].erase(key);
+}
+
+/**
+	@brief Forgets everything we know about a board's configuration, so the next SetIOConfig() and ConfigureSiggen()
+	calls are sent whatever they're set to
+
+	Called whenever the board may have changed behind our back, and by USBCleanup() since a new handle may be given
+	the same address.
+ */
+void ForgetBoardConfig(hdevice hdev)
+{
+	lock_guard<mutex> lock(g_configCacheMutex);
+	g_configCache.erase(hdev);
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -180,6 +462,8 @@ bool DataFrame::Roundtrip(hdevice hdev)
 
 bool SwitchMode(hdevice hdev)
 {
+	ForgetBoardConfig(hdev);
+
 	uint8_t data[64] = {};
 	data[60] = 0x09;
 	return SendInterruptTransfer(hdev, data, sizeof(data));
@@ -187,6 +471,8 @@ bool SwitchMode(hdevice hdev)
 
 bool SetPart(hdevice hdev, SilegoPart part)
 {
+	ForgetBoardConfig(hdev);
+
 	DataFrame frame(DataFrame::SET_PART);
 	frame.push_back((uint8_t)(part >> 4));
 	frame.push_back(0x00);
@@ -197,6 +483,8 @@ bool SetPart(hdevice hdev, SilegoPart part)
 
 bool Reset(hdevice hdev)
 {
+	ForgetBoardConfig(hdev);
+
 	DataFrame frame(DataFrame::RESET);
 	return frame.Roundtrip(hdev);
 }
@@ -208,6 +496,12 @@ bool SetStatusLED(hdevice hdev, bool status)
 	return frame.Roundtrip(hdev);
 }
 
+/**
+	@brief Configures the test point drivers, LEDs and expansion connector
+
+	Only sent if the configuration differs from what the board was last set to (see ForgetBoardConfig()), so callers
+	can change a pin or two and set the whole configuration again as often as they like.
+ */
 bool SetIOConfig(hdevice hdev, IOConfig& config)
 {
 	DataFrame frame(DataFrame::CONFIG_IO);
@@ -306,13 +600,21 @@ bool SetIOConfig(hdevice hdev, IOConfig& config)
 	frame.push_back(0x0);
 	frame.push_back(0x0);
 
-	//Done, send it
-	return frame.Send(hdev);
+	//Done, send it (unless it wouldn't change anything)
+	if(ConfigUnchanged(hdev, IO_CONFIG_KEY, frame))
+	{
+		LogDebug("I/O configuration unchanged, not sending it\n");
+		return true;
+	}
+	bool ok = frame.Send(hdev);
+	RememberConfig(hdev, IO_CONFIG_KEY, frame, ok);
+	return ok;
 }
 
 static const double VOLTAGE_FACTOR = 0.001362; //mV/LSB
 
 //ch1 = Vdd, CH2...20 = TP2...20
+//Not sent if the channel is already set to the same voltage, and hasn't been started, stopped or reset since
 bool ConfigureSiggen(hdevice hdev, uint8_t channel, double voltage)
 {
 	DataFrame frame(DataFrame::CONFIG_SIGGEN);
@@ -333,11 +635,21 @@ bool ConfigureSiggen(hdevice hdev, uint8_t channel, double voltage)
 	// frame.push_back(0);					//step sign and fractional step part
 	// frame.push_back(0);
 
-	return frame.Roundtrip(hdev);
+	if(ConfigUnchanged(hdev, channel, frame))
+	{
+		LogDebug("Signal generator %d unchanged, not sending it\n", channel);
+		return true;
+	}
+	bool ok = frame.Roundtrip(hdev);
+	RememberConfig(hdev, channel, frame, ok);
+	return ok;
 }
 
 bool ResetAllSiggens(hdevice hdev)
 {
+	for(int i=1; i<=20; i++)
+		ForgetConfig(hdev, i);
+
 	DataFrame frame(DataFrame::ENABLE_SIGGEN);
 
 	for(unsigned int i=1; i<=19; i++)
@@ -349,13 +661,31 @@ bool ResetAllSiggens(hdevice hdev)
 }
 
 bool ControlSiggen(hdevice hdev, unsigned int chan, SiggenCommand cmd)
+{
+	return ControlSiggens(hdev, vector<unsigned int>{chan}, cmd);
+}
+
+/**
+	@brief Sends the same command to several signal generators at once, in a single frame
+ */
+bool ControlSiggens(hdevice hdev, const vector<unsigned int>& chans, SiggenCommand cmd)
 {
 	DataFrame frame(DataFrame::ENABLE_SIGGEN);
 
 	for(unsigned int i=1; i<=19; i++)
 	{
-		if(i == chan)					//apply our status
+		bool selected = false;
+		for(auto chan : chans)
+		{
+			if(i == chan)
+				selected = true;
+		}
+
+		if(selected)					//apply our status
+		{
 			frame.push_back((int)cmd);
+			ForgetConfig(hdev, i);
+		}
 
 		else
 			frame.push_back((int)SiggenCommand::NOP);	//no change
@@ -364,8 +694,19 @@ bool ControlSiggen(hdevice hdev, unsigned int chan, SiggenCommand cmd)
 	return frame.Send(hdev);
 }
 
-bool DownloadBitstream(hdevice hdev, std::vector<uint8_t> bitstream, DownloadMode mode)
+bool DownloadBitstream(hdevice hdev, const std::vector<uint8_t>& bitstream, DownloadMode mode)
+{
+	return DownloadBitstream(hdev, bitstream.data(), bitstream.size(), mode);
+}
+
+/**
+	@brief Downloads a raw bitstream image, e.g. straight out of a memory-mapped binary bitstream file
+ */
+bool DownloadBitstream(hdevice hdev, const uint8_t* bitstream, size_t len, DownloadMode mode)
 {
+	//Developer board I/O pins get stuck after programming, whatever we last set them to
+	ForgetBoardConfig(hdev);
+
 	DataFrame::PacketType reqType, ack1Type, ack2Type;
 	if(mode == DownloadMode::PROGRAMMING)
 	{
@@ -386,15 +727,20 @@ bool DownloadBitstream(hdevice hdev, std::vector<uint8_t> bitstream, DownloadMod
 	frame.push_back(0x00);
 	frame.push_back(0x00);
 
-	uint16_t cycles = bitstream.size() * 8 + 34;
+	uint16_t cycles = len * 8 + 34;
 	frame.push_back(cycles >> 8);
 	frame.push_back(cycles & 0xff);
 
-	frame.m_sequenceB = (bitstream.size() + 3) / 60;
+	frame.SetSequenceB((len + 3) / 60);
 
-	for(size_t i = 0; i < bitstream.size(); i++)
+	//Keep several frames in flight rather than waiting for each one's acknowledgement before sending the next
+	auto start = chrono::steady_clock::now();
+	FramePipeline pipeline(hdev);
+	for(size_t i = 0; i < len; )
 	{
-		frame.push_back(bitstream[i]);
+		size_t chunk = min(len - i, frame.GetFreeSpace());
+		frame.Append(bitstream + i, chunk);
+		i += chunk;
 
 		if(frame.IsFull())
 		{
@@ -410,11 +756,16 @@ bool DownloadBitstream(hdevice hdev, std::vector<uint8_t> bitstream, DownloadMod
 			return false;
 	}
 
+	if(!pipeline.Flush())
+		return false;
+	RecordUSBDownload(hdev, len, chrono::duration<double>(chrono::steady_clock::now() - start).count());
 	return true;
 }
 
 bool UploadBitstream(hdevice hdev, size_t octets, vector<uint8_t> &bitstream)
 {
+	ForgetBoardConfig(hdev);
+
 	DataFrame reqFrame(DataFrame::READ_BITSTREAM_START);
 	reqFrame.push_back(0xc0);
 	reqFrame.push_back(0x07);
@@ -424,29 +775,32 @@ bool UploadBitstream(hdevice hdev, size_t octets, vector<uint8_t> &bitstream)
 	reqFrame.push_back(cycles >> 8);
 	reqFrame.push_back(cycles & 0xff);
 
+	//Keep requests in flight for as much of the bitstream as is left, if every reply is full. Asking for more than
+	//that could leave the board a request it never answers.
+	FramePipeline pipeline(hdev);
+	size_t inflight = 0;
 	bitstream = {};
 	while(true)
 	{
-		if(!reqFrame.Send(hdev))
-			return false;
+		while( (inflight == 0) ||
+		       ( (inflight < FramePipeline::DEFAULT_DEPTH) && (bitstream.size() + inflight*60 < octets) ) )
+		{
+			if(!pipeline.Request(reqFrame, DataFrame::READ_BITSTREAM_ACK))
+				return false;
+			reqFrame.SetType(DataFrame::READ_BITSTREAM_CONT);
+			inflight ++;
+		}
 
 		DataFrame repFrame;
-		if(!repFrame.Receive(hdev))
-			return false;
-		if(!(repFrame.m_sequenceA == reqFrame.m_sequenceA &&
-		     repFrame.m_type == DataFrame::READ_BITSTREAM_ACK))
-		{
-			LogError("Unexpected reply\n");
+		if(!pipeline.NextReply(repFrame))
 			return false;
-		}
+		inflight --;
 
-		bitstream.insert(bitstream.end(), repFrame.m_payload.begin(), repFrame.m_payload.end());
-		if(repFrame.m_sequenceB == 0)
+		bitstream.insert(bitstream.end(), repFrame.GetPayload(), repFrame.GetPayload() + repFrame.GetPayloadSize());
+		if(repFrame.GetSequenceB() == 0)
 		{
 			break;
 		}
-
-		reqFrame.m_type = DataFrame::READ_BITSTREAM_CONT;
 	}
 
 	if(bitstream.size() != octets)
@@ -472,25 +826,22 @@ bool SelectADCChannel(hdevice hdev, unsigned int chan)
 	return frame.Send(hdev);
 }
 
-bool ReadADC(hdevice hdev, double &value)
+/**
+	@brief Converts the reply to a READ_ADC frame to volts
+ */
+static bool DecodeADCReading(const DataFrame& frame, double &value)
 {
-	DataFrame frame(DataFrame::READ_ADC);
-	frame.push_back(0x01); // conversion time
-	if(!frame.Send(hdev))
-		return false;
-
-	if(!frame.Receive(hdev))
-		return false;
-	if(!(frame.m_type == DataFrame::READ_ADC))
+	if(!(frame.GetType() == DataFrame::READ_ADC))
 	{
 		LogError("Unexpected reply\n");
 		return false;
 	}
+	const uint8_t* payload = frame.GetPayload();
 	uint32_t intValue =
-		(frame.m_payload[0] << 24) |
-		(frame.m_payload[1] << 16) |
-		(frame.m_payload[2] <<  8) |
-		(frame.m_payload[3] <<  0);
+		(payload[0] << 24) |
+		(payload[1] << 16) |
+		(payload[2] <<  8) |
+		(payload[3] <<  0);
 	value = (double)(((int32_t)intValue) >> 8) / 0x90000;
 
 	//Datasheet comes back as a fraction of full scale
@@ -500,8 +851,76 @@ bool ReadADC(hdevice hdev, double &value)
 	return true;
 }
 
+bool ReadADC(hdevice hdev, double &value)
+{
+	DataFrame frame(DataFrame::READ_ADC);
+	frame.push_back(0x01); // conversion time
+
+	DataFrame reply;
+	if(!frame.Query(hdev, reply))
+		return false;
+	return DecodeADCReading(reply, value);
+}
+
+/**
+	@brief Reads a number of samples from each of several ADC channels in one go
+
+	Every channel select and conversion request is queued in a FramePipeline, so the whole burst costs about as much
+	as a few round-trips rather than two for every sample. The channels are sampled in turn, all of them once, then all
+	of them again, and so on. With only one channel it's selected once up front.
+
+	@param channels		Test points to sample (2-10, 12-20)
+	@param samples		Number of samples to take on each channel
+	@param values		Gets the samples in volts, channels.size() for each round in turn: the sample from channel c in
+						round n is values[n*channels.size() + c]. GetADCStatistics() boils them down per channel.
+ */
+bool BurstReadADC(
+	hdevice hdev,
+	const vector<unsigned int>& channels,
+	unsigned int samples,
+	vector<double>& values)
+{
+	values.clear();
+	if(channels.empty() || (samples == 0))
+		return true;
+	values.reserve(channels.size() * samples);
+
+	DataFrame request(DataFrame::READ_ADC);
+	request.push_back(0x01); // conversion time
+
+	FramePipeline pipeline(hdev);
+	size_t total = channels.size() * samples;
+	size_t inflight = 0;
+	for(size_t i=0; i<total; i++)
+	{
+		if( (channels.size() > 1) || (i == 0) )
+		{
+			if(!SelectADCChannel(hdev, channels[i % channels.size()]))
+				return false;
+		}
+		if(!pipeline.Request(request, DataFrame::READ_ADC))
+			return false;
+		inflight ++;
+
+		//Collect replies as we go, so they don't pile up in the pipeline
+		while( (inflight >= FramePipeline::DEFAULT_DEPTH) || ( (i+1 == total) && (inflight > 0) ) )
+		{
+			DataFrame reply;
+			double value;
+			if(!pipeline.NextReply(reply) || !DecodeADCReading(reply, value))
+				return false;
+			values.push_back(value);
+			inflight --;
+		}
+	}
+
+	return pipeline.Flush();
+}
+
 bool TrimOscillator(hdevice hdev, uint8_t ftw)
 {
+	ForgetBoardConfig(hdev);
+
 	DataFrame reqFrame = DataFrame(DataFrame::TRIM_OSC);
 	reqFrame.push_back(0x00);
 	reqFrame.push_back(ftw);
@@ -511,13 +930,11 @@ bool TrimOscillator(hdevice hdev, uint8_t ftw)
 	reqFrame.push_back(0x11);
 	reqFrame.push_back(0x02);
 	reqFrame.push_back(0x01);
-	if(!reqFrame.Send(hdev))
-		return false;
 
 	DataFrame repFrame;
-	if(!repFrame.Receive(hdev))
+	if(!reqFrame.Query(hdev, repFrame))
 		return false;
-	if(!(repFrame.m_type == reqFrame.m_type))
+	if(!(repFrame.GetType() == reqFrame.GetType()))
 	{
 		LogError("Unexpected reply\n");
 		return false;
@@ -527,51 +944,52 @@ bool TrimOscillator(hdevice hdev, uint8_t ftw)
 
 bool MeasureOscillatorFrequency(hdevice hdev, unsigned &freq)
 {
+	ForgetBoardConfig(hdev);
+
 	DataFrame reqFrame = DataFrame(DataFrame::GET_OSC_FREQ);
 	reqFrame.push_back(0x00);
-	if(!reqFrame.Send(hdev))
-		return false;
 
 	DataFrame repFrame;
-	if(!repFrame.Receive(hdev))
+	if(!reqFrame.Query(hdev, repFrame))
 		return false;
-	if(!(repFrame.m_type == reqFrame.m_type))
+	if(!(repFrame.GetType() == reqFrame.GetType()))
 	{
 		LogError("Unexpected reply\n");
 		return false;
 	}
 
+	const uint8_t* payload = repFrame.GetPayload();
 	freq =
-		(repFrame.m_payload[0] << 24) |
-		(repFrame.m_payload[1] << 16) |
-		(repFrame.m_payload[2] <<  8) |
-		(repFrame.m_payload[3] <<  0);
+		(payload[0] << 24) |
+		(payload[1] << 16) |
+		(payload[2] <<  8) |
+		(payload[3] <<  0);
 	return true;
 }
 
 bool GetStatus(hdevice hdev, BoardStatus &status)
 {
-	DataFrame frame(DataFrame::GET_STATUS);
-	if(!frame.Send(hdev))
-		return false;
+	DataFrame request(DataFrame::GET_STATUS);
 
 	// FIXME: we don't get any nonzero measurements here. It seems we are missing some sort of enable
 	// command for this feature. I haven't a faintest clue as to which.
-	if(!frame.Receive(hdev))
+	DataFrame frame;
+	if(!request.Query(hdev, frame))
 		return false;
-	if(!(frame.m_type == DataFrame::GET_STATUS))
+	if(!(frame.GetType() == DataFrame::GET_STATUS))
 	{
 		LogError("Unexpected reply\n");
 		return false;
 	}
 
-	// uint16_t rawCurrent  = (frame.m_payload[10] << 8) | frame.m_payload[11];
-	uint16_t rawVoltageA = (frame.m_payload[12] << 8) | frame.m_payload[13];
-	uint16_t rawVoltageB = (frame.m_payload[14] << 8) | frame.m_payload[15];
+	const uint8_t* payload = frame.GetPayload();
+	// uint16_t rawCurrent  = (payload[10] << 8) | payload[11];
+	uint16_t rawVoltageA = (payload[12] << 8) | payload[13];
+	uint16_t rawVoltageB = (payload[14] << 8) | payload[15];
 
-	status.externalOverCurrent  = (frame.m_payload[7] == 0x01);
-	status.internalUnderVoltage = (frame.m_payload[8] == 0x01);
-	status.internalOverCurrent  = (frame.m_payload[9] == 0x02);
+	status.externalOverCurrent  = (payload[7] == 0x01);
+	status.internalUnderVoltage = (payload[8] == 0x01);
+	status.internalOverCurrent  = (payload[9] == 0x02);
 	status.voltageA = rawVoltageA * VOLTAGE_FACTOR / 2;
 	status.voltageB = rawVoltageB * VOLTAGE_FACTOR / 2;
 	return true;
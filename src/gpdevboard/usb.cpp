@@ -25,40 +25,1094 @@
 #endif
 
 #include <log.h>
+#include <debuglog.h>
+#include <trace.h>
 #include <gpdevboard.h>
 #include <unistd.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <map>
+#include <mutex>
 
 using namespace std;
 
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Frame trace
+
+/*
+	The most recent frames to and from every board, kept in a ring buffer once StartUSBTrace() has been called, and
+	written out when a transfer fails and again when we exit. Nothing is kept (and no time is spent) otherwise.
+ */
+static const char USB_TRACE_MAGIC[8] = {'G', 'P', '4', 'U', 'S', 'B', 'T', 'R'};
+static const size_t USB_TRACE_RECORD_SIZE = 84;
+
+static atomic<bool> g_usbTracing(false);
+static chrono::steady_clock::time_point g_usbTraceEpoch;
+static string g_usbTraceFilename;
+static vector<USBTraceRecord> g_usbTrace;
+static size_t g_usbTraceNext = 0;
+static bool g_usbTraceWrapped = false;
+static map<hdevice, uint16_t> g_usbTraceBoards;
+static mutex g_usbTraceMutex;
+
+static void WriteUSBTraceAtExit()
+{
+	WriteUSBTrace();
+}
+
+/**
+	@brief Starts keeping the most recent frames, and arranges for them to be written to fname when the program exits
+
+	Should be called once, at startup, before any boards are opened.
+
+	@param fname	Trace file to write
+	@param frames	How many of the most recent frames (in both directions, on all boards) to keep
+ */
+bool StartUSBTrace(const string& fname, size_t frames)
+{
+	if(IsUSBTracing())
+	{
+		LogError("Tracing USB frames to %s already\n", g_usbTraceFilename.c_str());
+		return false;
+	}
+	if(frames == 0)
+	{
+		LogError("USB trace buffer must have room for at least one frame\n");
+		return false;
+	}
+
+	g_usbTraceFilename = fname;
+	g_usbTrace.resize(frames);
+	g_usbTraceEpoch = chrono::steady_clock::now();
+	g_usbTracing = true;
+
+	atexit(WriteUSBTraceAtExit);
+	return true;
+}
+
+bool IsUSBTracing()
+{
+	return g_usbTracing.load(memory_order_relaxed);
+}
+
+/**
+	@brief Adds one frame to the trace
+
+	@param start	When the transfer was started, or when it finished for pipelined transfers
+	@param timed	Set if the transfer was timed, i.e. start is when it started
+ */
+static void RecordUSBFrame(hdevice hdev, bool in, const uint8_t* buf, int size, int transferred, int status,
+	chrono::steady_clock::time_point start, bool timed)
+{
+	auto now = chrono::steady_clock::now();
+
+	lock_guard<mutex> lock(g_usbTraceMutex);
+	USBTraceRecord& record = g_usbTrace[g_usbTraceNext];
+	record.timestamp = chrono::duration_cast<chrono::nanoseconds>(start - g_usbTraceEpoch).count();
+	record.duration = timed ? chrono::duration_cast<chrono::nanoseconds>(now - start).count() : 0;
+	record.status = status;
+	auto it = g_usbTraceBoards.find(hdev);
+	if(it == g_usbTraceBoards.end())
+		it = g_usbTraceBoards.emplace(hdev, g_usbTraceBoards.size()).first;
+	record.board = it->second;
+	record.in = in;
+	record.length = max(0, min(transferred, (int)sizeof(record.data)));
+
+	//Keep the whole of what we tried to send, but only what actually came back
+	int len = max(0, min(in ? transferred : size, (int)sizeof(record.data)));
+	memset(record.data, 0, sizeof(record.data));
+	memcpy(record.data, buf, len);
+
+	if(++g_usbTraceNext == g_usbTrace.size())
+	{
+		g_usbTraceNext = 0;
+		g_usbTraceWrapped = true;
+	}
+}
+
+/**
+	@brief Adds a pipelined transfer that has just finished to the trace
+ */
+static void RecordUSBFrame(libusb_transfer* transfer)
+{
+	//Report the status as the libusb error a blocking transfer would have given
+	int err;
+	switch(transfer->status)
+	{
+		case LIBUSB_TRANSFER_COMPLETED:
+			err = 0;
+			break;
+
+		case LIBUSB_TRANSFER_TIMED_OUT:
+			err = LIBUSB_ERROR_TIMEOUT;
+			break;
+
+		case LIBUSB_TRANSFER_CANCELLED:
+			err = LIBUSB_ERROR_INTERRUPTED;
+			break;
+
+		case LIBUSB_TRANSFER_STALL:
+			err = LIBUSB_ERROR_PIPE;
+			break;
+
+		case LIBUSB_TRANSFER_NO_DEVICE:
+			err = LIBUSB_ERROR_NO_DEVICE;
+			break;
+
+		case LIBUSB_TRANSFER_OVERFLOW:
+			err = LIBUSB_ERROR_OVERFLOW;
+			break;
+
+		default:
+			err = LIBUSB_ERROR_IO;
+			break;
+	}
+
+	RecordUSBFrame(transfer->dev_handle, (transfer->endpoint & LIBUSB_ENDPOINT_IN) != 0, transfer->buffer,
+		transfer->length, transfer->actual_length, err, chrono::steady_clock::now(), false);
+}
+
+static void WriteLE(vector<uint8_t>& out, uint64_t value, size_t bytes)
+{
+	for(size_t i=0; i<bytes; i++)
+		out.push_back(value >> (8*i));
+}
+
+static uint64_t ReadLE(const uint8_t* p, size_t bytes)
+{
+	uint64_t value = 0;
+	for(size_t i=0; i<bytes; i++)
+		value |= (uint64_t)p[i] << (8*i);
+	return value;
+}
+
+/**
+	@brief Writes the frames kept so far to the trace file given to StartUSBTrace(), oldest first
+
+	Called when a transfer fails and when we exit, and may be called at any other time to get a snapshot.
+ */
+bool WriteUSBTrace()
+{
+	if(!IsUSBTracing())
+		return false;
+
+	vector<uint8_t> out(USB_TRACE_MAGIC, USB_TRACE_MAGIC + sizeof(USB_TRACE_MAGIC));
+	string fname;
+	{
+		lock_guard<mutex> lock(g_usbTraceMutex);
+		fname = g_usbTraceFilename;
+
+		size_t count = g_usbTraceWrapped ? g_usbTrace.size() : g_usbTraceNext;
+		size_t first = g_usbTraceWrapped ? g_usbTraceNext : 0;
+		WriteLE(out, USB_TRACE_VERSION, 4);
+		WriteLE(out, count, 4);
+		for(size_t i=0; i<count; i++)
+		{
+			const USBTraceRecord& record = g_usbTrace[(first + i) % g_usbTrace.size()];
+			WriteLE(out, record.timestamp, 8);
+			WriteLE(out, record.duration, 4);
+			WriteLE(out, (uint32_t)record.status, 4);
+			WriteLE(out, record.board, 2);
+			WriteLE(out, record.in, 1);
+			WriteLE(out, record.length, 1);
+			out.insert(out.end(), record.data, record.data + sizeof(record.data));
+		}
+	}
+
+	FILE* fp = fopen(fname.c_str(), "wb");
+	if(!fp)
+	{
+		LogError("Couldn't open USB trace file %s\n", fname.c_str());
+		return false;
+	}
+	bool ok = (fwrite(&out[0], 1, out.size(), fp) == out.size());
+	ok &= (fclose(fp) == 0);
+	if(!ok)
+	{
+		LogError("Couldn't write USB trace file %s\n", fname.c_str());
+		return false;
+	}
+
+	LogVerbose("Wrote %zu USB frames to %s\n", (out.size() - 16) / USB_TRACE_RECORD_SIZE, fname.c_str());
+	return true;
+}
+
+/**
+	@brief Reads a trace file written by WriteUSBTrace()
+ */
+bool ReadUSBTrace(const string& fname, vector<USBTraceRecord>& records)
+{
+	FILE* fp = fopen(fname.c_str(), "rb");
+	if(!fp)
+	{
+		LogError("Couldn't open USB trace file %s\n", fname.c_str());
+		return false;
+	}
+	vector<uint8_t> data;
+	uint8_t buf[4096];
+	size_t len;
+	while( (len = fread(buf, 1, sizeof(buf), fp)) > 0)
+		data.insert(data.end(), buf, buf + len);
+	fclose(fp);
+
+	if( (data.size() < 16) || (0 != memcmp(&data[0], USB_TRACE_MAGIC, sizeof(USB_TRACE_MAGIC))) )
+	{
+		LogError("%s is not a USB trace file\n", fname.c_str());
+		return false;
+	}
+	uint32_t version = ReadLE(&data[8], 4);
+	if(version != USB_TRACE_VERSION)
+	{
+		LogError("%s is a version %u USB trace, but only version %d is supported\n",
+			fname.c_str(), version, USB_TRACE_VERSION);
+		return false;
+	}
+	uint32_t count = ReadLE(&data[12], 4);
+	if(data.size() != 16 + count * USB_TRACE_RECORD_SIZE)
+	{
+		LogError("USB trace file %s is truncated (should have %u frames)\n", fname.c_str(), count);
+		return false;
+	}
+
+	records.resize(count);
+	for(uint32_t i=0; i<count; i++)
+	{
+		const uint8_t* p = &data[16 + i*USB_TRACE_RECORD_SIZE];
+		USBTraceRecord& record = records[i];
+		record.timestamp = ReadLE(p, 8);
+		record.duration = ReadLE(p + 8, 4);
+		record.status = (int32_t)ReadLE(p + 12, 4);
+		record.board = ReadLE(p + 16, 2);
+		record.in = p[18];
+		record.length = p[19];
+		memcpy(record.data, p + 20, sizeof(record.data));
+	}
+	return true;
+}
+
+/**
+	@brief Gets the name of a libusb error code, as kept in USBTraceRecord::status
+ */
+const char* GetUSBErrorName(int err)
+{
+	return libusb_error_name(err);
+}
+
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 // USB command helpers
 
-bool SendInterruptTransfer(hdevice hdev, const uint8_t* buf, size_t size)
+/**
+	@brief Sends one frame
+
+	@param timedOut		If not NULL, gets set on a timeout, which is then left to the caller to report (e.g. because
+						it's going to try again)
+ */
+bool SendInterruptTransfer(hdevice hdev, const uint8_t* buf, size_t size, unsigned int timeoutMs, bool* timedOut)
 {
-	int transferred;
-	int err = 0;
-	if(0 != (err = libusb_interrupt_transfer(hdev, 2|LIBUSB_ENDPOINT_OUT,
-	                                         const_cast<uint8_t*>(buf), size, &transferred, 250)))
+	bool tracing = IsUSBTracing();
+	chrono::steady_clock::time_point start;
+	if(tracing)
+		start = chrono::steady_clock::now();
+
+	int transferred = 0;
+	int err = libusb_interrupt_transfer(hdev, 2|LIBUSB_ENDPOINT_OUT,
+	                                    const_cast<uint8_t*>(buf), size, &transferred, timeoutMs);
+	if(tracing)
+		RecordUSBFrame(hdev, false, buf, size, transferred, err, start, true);
+	if(err != 0)
 	{
-		LogError("libusb_interrupt_transfer failed (%s)\n", libusb_error_name(err));
+		if(timedOut && (err == LIBUSB_ERROR_TIMEOUT))
+			*timedOut = true;
+		else
+		{
+			LogError("libusb_interrupt_transfer failed (%s)\n", libusb_error_name(err));
+			RecordUSBError(hdev);
+		}
 		return false;
 	}
 	return true;
 }
 
-bool ReceiveInterruptTransfer(hdevice hdev, uint8_t* buf, size_t size)
+/**
+	@brief Receives one frame
+
+	@param timedOut		If not NULL, gets set on a timeout, which is then left to the caller to report
+ */
+bool ReceiveInterruptTransfer(hdevice hdev, uint8_t* buf, size_t size, unsigned int timeoutMs, bool* timedOut)
 {
-	int transferred;
-	int err = 0;
-	if(0 != (err = libusb_interrupt_transfer(hdev, 1|LIBUSB_ENDPOINT_IN,
-	                                         buf, size, &transferred, 250)))
+	bool tracing = IsUSBTracing();
+	chrono::steady_clock::time_point start;
+	if(tracing)
+		start = chrono::steady_clock::now();
+
+	int transferred = 0;
+	int err = libusb_interrupt_transfer(hdev, 1|LIBUSB_ENDPOINT_IN,
+	                                    buf, size, &transferred, timeoutMs);
+	if(tracing)
+		RecordUSBFrame(hdev, true, buf, size, transferred, err, start, true);
+	if(err != 0)
 	{
-		LogError("libusb_interrupt_transfer failed (%s)\n", libusb_error_name(err));
+		if(timedOut && (err == LIBUSB_ERROR_TIMEOUT))
+			*timedOut = true;
+		else
+		{
+			LogError("libusb_interrupt_transfer failed (%s)\n", libusb_error_name(err));
+			RecordUSBError(hdev);
+		}
 		return false;
 	}
 	return true;
 }
 
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Round-trip statistics
+
+//How each board has been answering (boards may be driven from different threads, so the map needs a lock)
+static map<hdevice, USBStatistics> g_usbStatistics;
+static mutex g_usbStatisticsMutex;
+
+/**
+	@brief Gets how long to give a command on a board
+
+	Most boards answer in a millisecond or two, so this is normally just the command's minimum. A board behind a slow
+	hub or a busy host gets longer, the same way TCP sets its retransmit timeout: the smoothed round-trip time plus
+	four times its deviation, up to four times the minimum.
+
+	@param minTimeoutMs		The command's timeout class (DataFrame::GetMinTimeout())
+ */
+unsigned int GetUSBTimeout(hdevice hdev, unsigned int minTimeoutMs)
+{
+	lock_guard<mutex> lock(g_usbStatisticsMutex);
+	auto it = g_usbStatistics.find(hdev);
+	if(it == g_usbStatistics.end())
+		return minTimeoutMs;
+
+	auto& stats = it->second;
+	unsigned int timeout = stats.meanRoundtrip + 4 * stats.roundtripDeviation;
+	return max(minTimeoutMs, min(timeout, 4 * minTimeoutMs));
+}
+
+/**
+	@brief Records how long a command took to be answered
+ */
+void RecordUSBRoundtrip(hdevice hdev, double ms)
+{
+	lock_guard<mutex> lock(g_usbStatisticsMutex);
+	auto& stats = g_usbStatistics[hdev];
+	if(stats.roundtrips == 0)
+	{
+		stats.meanRoundtrip = ms;
+		stats.roundtripDeviation = ms / 2;
+	}
+	else
+	{
+		stats.roundtripDeviation += (fabs(ms - stats.meanRoundtrip) - stats.roundtripDeviation) / 4;
+		stats.meanRoundtrip += (ms - stats.meanRoundtrip) / 8;
+	}
+	stats.maxRoundtrip = max(stats.maxRoundtrip, ms);
+	stats.roundtrips ++;
+}
+
+void RecordUSBRetry(hdevice hdev)
+{
+	lock_guard<mutex> lock(g_usbStatisticsMutex);
+	g_usbStatistics[hdev].retries ++;
+}
+
+void RecordUSBError(hdevice hdev)
+{
+	{
+		lock_guard<mutex> lock(g_usbStatisticsMutex);
+		g_usbStatistics[hdev].errors ++;
+	}
+
+	//Keep the frames leading up to the failure, in case we don't get as far as exiting cleanly
+	WriteUSBTrace();
+}
+
+/**
+	@brief Records a bitstream download, for working out how fast a board takes them
+ */
+void RecordUSBDownload(hdevice hdev, size_t bytes, double seconds)
+{
+	lock_guard<mutex> lock(g_usbStatisticsMutex);
+	auto& stats = g_usbStatistics[hdev];
+	stats.downloadBytes += bytes;
+	stats.downloadSeconds += seconds;
+}
+
+USBStatistics GetUSBStatistics(hdevice hdev)
+{
+	lock_guard<mutex> lock(g_usbStatisticsMutex);
+	auto it = g_usbStatistics.find(hdev);
+	if(it == g_usbStatistics.end())
+		return USBStatistics();
+	return it->second;
+}
+
+/**
+	@brief Logs how a board has been answering and forgets it, since a new handle may be given the same address
+ */
+static void ForgetUSBStatistics(hdevice hdev)
+{
+	lock_guard<mutex> lock(g_usbStatisticsMutex);
+	auto it = g_usbStatistics.find(hdev);
+	if(it == g_usbStatistics.end())
+		return;
+
+	auto& stats = it->second;
+	LogDebug("USB round-trips: %u timed, mean %.2f ms, max %.2f ms, %u retries, %u errors\n",
+		stats.roundtrips, stats.meanRoundtrip, stats.maxRoundtrip, stats.retries, stats.errors);
+	g_usbStatistics.erase(it);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Pipelined transfers
+
+/**
+	@brief One frame going out through a FramePipeline
+ */
+struct PendingFrame
+{
+	DataFrame frame;
+
+	///Type of the acknowledgement we're waiting for, or -1 if the frame doesn't get one
+	int ackType;
+
+	///Keep the acknowledgement in m_replies, rather than checking that it echoes the frame
+	bool keepReply;
+
+	///Set once the acknowledgement has come back
+	bool acked;
+
+	libusb_transfer* transfer;
+	int done;
+};
+
+/**
+	@brief One interrupt IN transfer posted by a FramePipeline, to catch whichever acknowledgement comes back next
+ */
+struct PendingRead
+{
+	DataFrame frame;
+	libusb_transfer* transfer;
+	int done;
+};
+
+//The active pipeline on each board (boards may be driven from different threads, so the map needs a lock)
+static map<hdevice, FramePipeline*> g_pipelines;
+static mutex g_pipelinesMutex;
+
+static void LIBUSB_CALL OnTransferDone(libusb_transfer* transfer)
+{
+	if(IsUSBTracing())
+		RecordUSBFrame(transfer);
+	*static_cast<int*>(transfer->user_data) = 1;
+}
+
+/**
+	@brief Handles libusb events until an asynchronous transfer has finished, then checks how it went
+ */
+static bool WaitForTransfer(libusb_transfer* transfer, int& done)
+{
+	while(!done)
+	{
+		int err = libusb_handle_events_completed(NULL, &done);
+		if( (err != 0) && (err != LIBUSB_ERROR_INTERRUPTED) )
+		{
+			LogError("libusb_handle_events_completed failed (%s)\n", libusb_error_name(err));
+			return false;
+		}
+	}
+
+	switch(transfer->status)
+	{
+		case LIBUSB_TRANSFER_COMPLETED:
+			return true;
+
+		case LIBUSB_TRANSFER_TIMED_OUT:
+			LogError("libusb interrupt transfer timed out\n");
+			WriteUSBTrace();
+			return false;
+
+		case LIBUSB_TRANSFER_CANCELLED:
+			return false;
+
+		default:
+			LogError("libusb interrupt transfer failed (status %d)\n", transfer->status);
+			WriteUSBTrace();
+			return false;
+	}
+}
+
+FramePipeline::FramePipeline(hdevice hdev, unsigned int depth)
+	: m_hdev(hdev)
+	, m_depth(depth)
+	, m_ok(true)
+	, m_outer(Get(hdev))
+{
+	//If there's already a pipeline on this board, we just add to it, so e.g. a whole DownloadBitstream() can overlap
+	//with whatever else the caller sends
+	if(!m_outer)
+	{
+		lock_guard<mutex> lock(g_pipelinesMutex);
+		g_pipelines[hdev] = this;
+	}
+}
+
+FramePipeline::~FramePipeline()
+{
+	if(!m_outer)
+	{
+		Flush();
+		lock_guard<mutex> lock(g_pipelinesMutex);
+		g_pipelines.erase(m_hdev);
+	}
+}
+
+/**
+	@brief Gets the pipeline that's currently active on a board, if any
+ */
+FramePipeline* FramePipeline::Get(hdevice hdev)
+{
+	lock_guard<mutex> lock(g_pipelinesMutex);
+	auto it = g_pipelines.find(hdev);
+	if(it == g_pipelines.end())
+		return NULL;
+	return it->second;
+}
+
+/**
+	@brief Queues a frame that doesn't get an acknowledgement
+ */
+bool FramePipeline::Send(const DataFrame& frame)
+{
+	return Queue(frame, -1, false);
+}
+
+/**
+	@brief Queues a frame whose acknowledgement echoes it back, as DataFrame::Roundtrip() expects
+ */
+bool FramePipeline::Roundtrip(const DataFrame& frame, uint8_t ack_type)
+{
+	return Queue(frame, ack_type, false);
+}
+
+/**
+	@brief Queues a frame whose reply carries data, for NextReply() to return once it comes back
+ */
+bool FramePipeline::Request(const DataFrame& frame, uint8_t reply_type)
+{
+	return Queue(frame, reply_type, true);
+}
+
+/**
+	@brief Gets the reply to the oldest frame sent with Request() that we haven't returned the reply to yet
+
+	Waits for it if it's still in flight. Frames queued behind it stay in flight.
+ */
+bool FramePipeline::NextReply(DataFrame& reply)
+{
+	if(m_outer)
+		return m_outer->NextReply(reply);
+
+	while(m_ok && m_replies.empty() && !m_pending.empty())
+		Complete();
+
+	if(!m_ok)
+		return false;
+	if(m_replies.empty())
+	{
+		LogError("No reply is on its way\n");
+		return false;
+	}
+
+	reply = m_replies.front();
+	m_replies.pop_front();
+	return true;
+}
+
+bool FramePipeline::Queue(const DataFrame& frame, int ack_type, bool keep_reply)
+{
+	if(m_outer)
+		return m_outer->Queue(frame, ack_type, keep_reply);
+
+	if(!m_ok)
+		return false;
+
+	//Make room (returning a frame may take several reads, so this can free up more than one)
+	while(m_pending.size() >= m_depth)
+	{
+		if(!Complete())
+			return false;
+	}
+
+	//The stages ahead of us in the pipe eat into our timeout, so scale it with the depth
+	unsigned int timeout = GetUSBTimeout(m_hdev, frame.GetMinTimeout()) * m_depth;
+
+	PendingFrame* p = new PendingFrame;
+	p->frame = frame;
+	p->ackType = ack_type;
+	p->keepReply = keep_reply;
+	p->acked = false;
+	p->done = 0;
+	if(IsDebugLogging())
+		p->frame.Log("H→D");
+	p->transfer = libusb_alloc_transfer(0);
+	libusb_fill_interrupt_transfer(p->transfer, m_hdev, 2|LIBUSB_ENDPOINT_OUT,
+		p->frame.GetData(), DataFrame::FRAME_SIZE, OnTransferDone, &p->done, timeout);
+
+	int err = libusb_submit_transfer(p->transfer);
+	if(err != 0)
+	{
+		LogError("libusb_submit_transfer failed (%s)\n", libusb_error_name(err));
+		libusb_free_transfer(p->transfer);
+		delete p;
+		m_ok = false;
+		return false;
+	}
+	m_pending.push_back(p);
+
+	//Post a read for the acknowledgement straight away, so it's picked up as soon as the board sends it
+	if(ack_type >= 0)
+	{
+		PendingRead* r = new PendingRead;
+		r->done = 0;
+		r->transfer = libusb_alloc_transfer(0);
+		libusb_fill_interrupt_transfer(r->transfer, m_hdev, 1|LIBUSB_ENDPOINT_IN,
+			r->frame.GetData(), DataFrame::FRAME_SIZE, OnTransferDone, &r->done, timeout);
+
+		err = libusb_submit_transfer(r->transfer);
+		if(err != 0)
+		{
+			LogError("libusb_submit_transfer failed (%s)\n", libusb_error_name(err));
+			libusb_free_transfer(r->transfer);
+			delete r;
+			m_ok = false;
+			return false;
+		}
+		m_reads.push_back(r);
+	}
+
+	return true;
+}
+
+/**
+	@brief Waits for the oldest frame in flight to be sent and acknowledged, and retires it
+
+	Acknowledgements are matched to the oldest unacknowledged frame with the same sequence number, so one that comes
+	back for a frame behind the oldest is still accounted for.
+ */
+bool FramePipeline::Complete()
+{
+	PendingFrame* p = m_pending.front();
+	if(!WaitForTransfer(p->transfer, p->done))
+	{
+		m_ok = false;
+		return false;
+	}
+
+	while( (p->ackType >= 0) && !p->acked )
+	{
+		if(m_reads.empty())
+		{
+			LogError("No acknowledgement frame\n");
+			m_ok = false;
+			return false;
+		}
+
+		PendingRead* r = m_reads.front();
+		bool ok = WaitForTransfer(r->transfer, r->done);
+		DataFrame ack_frame = r->frame;
+		if(ok)
+			ack_frame.OnReceived();
+		m_reads.pop_front();
+		libusb_free_transfer(r->transfer);
+		delete r;
+		if(!ok)
+		{
+			m_ok = false;
+			return false;
+		}
+
+		PendingFrame* match = NULL;
+		for(auto q : m_pending)
+		{
+			if( (q->ackType >= 0) && !q->acked && (q->frame.GetSequenceA() == ack_frame.GetSequenceA()) )
+			{
+				match = q;
+				break;
+			}
+		}
+
+		if(match && match->keepReply && (ack_frame.GetType() == match->ackType) )
+			m_replies.push_back(ack_frame);
+		else if(!match || match->keepReply || !match->frame.IsAck(ack_frame, match->ackType) )
+		{
+			LogError("Unexpected acknowledgement frame\n");
+			m_ok = false;
+			return false;
+		}
+		match->acked = true;
+	}
+
+	m_pending.pop_front();
+	libusb_free_transfer(p->transfer);
+	delete p;
+	return true;
+}
+
+/**
+	@brief Waits for everything in flight, and says whether it all went through
+
+	A pipeline nested in another one doesn't wait, and only says whether anything has failed so far.
+ */
+bool FramePipeline::Flush()
+{
+	if(m_outer)
+		return m_outer->m_ok;
+
+	TraceSpan span("USB pipeline flush");
+
+	while(m_ok && !m_pending.empty())
+		Complete();
+
+	if(!m_ok)
+		CancelAll();
+	return m_ok;
+}
+
+/**
+	@brief Cancels every transfer still in flight after a failure, and waits for libusb to be done with them
+ */
+void FramePipeline::CancelAll()
+{
+	for(auto p : m_pending)
+	{
+		if(!p->done)
+			libusb_cancel_transfer(p->transfer);
+	}
+	for(auto r : m_reads)
+	{
+		if(!r->done)
+			libusb_cancel_transfer(r->transfer);
+	}
+
+	for(auto p : m_pending)
+	{
+		WaitForTransfer(p->transfer, p->done);
+		libusb_free_transfer(p->transfer);
+		delete p;
+	}
+	for(auto r : m_reads)
+	{
+		WaitForTransfer(r->transfer, r->done);
+		libusb_free_transfer(r->transfer);
+		delete r;
+	}
+	m_pending.clear();
+	m_reads.clear();
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Device registry
+
+/**
+	@brief Every USB device from each vendor we've been asked about, so boards can be counted and looked up without
+	walking the bus every time
+
+	Devices are listed in the order libusb_get_device_list() returns them, which is what board indices count in, so
+	every process numbers the boards the same way. Where libusb supports hotplug, the list is kept until a device from
+	that vendor arrives or leaves, and is then read again the next time it's needed. Without hotplug, it's read again
+	every time, as it always used to be.
+
+	The registry holds its own reference to libusb's default context, so the list outlives the USBSetup() and
+	USBCleanup() calls around each use of it.
+ */
+class DeviceRegistry
+{
+public:
+	static DeviceRegistry& Get();
+
+	bool GetDevices(uint16_t idVendor, vector<libusb_device*>& devices);
+	unsigned int CountArrivals(uint16_t idVendor, uint16_t idProduct);
+	bool WaitForArrival(uint16_t idVendor, uint16_t idProduct, unsigned int since, unsigned int timeoutMs);
+
+	bool LookupSerial(libusb_device* device, string& serial);
+	void RememberSerial(libusb_device* device, const string& serial);
+
+protected:
+	DeviceRegistry();
+
+	void HandleEvents();
+	void Forget(uint16_t idVendor);
+	bool Watch(uint16_t idVendor);
+
+	static int LIBUSB_CALL OnHotplug(
+		libusb_context* ctx, libusb_device* device, libusb_hotplug_event event, void* data);
+
+	///Set if libusb was set up and can tell us about devices coming and going
+	bool m_hotplug;
+
+	///Devices from each vendor we have a current list for, each holding a reference
+	map<uint16_t, vector<libusb_device*>> m_devices;
+
+	///Vendors we've registered a hotplug callback for
+	map<uint16_t, libusb_hotplug_callback_handle> m_callbacks;
+
+	///Number of devices that have arrived with each VID:PID since we started watching their vendor
+	map<uint32_t, unsigned int> m_arrivals;
+
+	///Serial numbers of listed devices (see GetBoardSerial())
+	map<libusb_device*, string> m_serials;
+
+	mutex m_mutex;
+};
+
+DeviceRegistry::DeviceRegistry()
+	: m_hotplug(false)
+{
+	if(0 == libusb_init(NULL))
+		m_hotplug = libusb_has_capability(LIBUSB_CAP_HAS_HOTPLUG);
+}
+
+/**
+	@brief Gets the registry, which is created the first time it's needed and stays until the process exits
+ */
+DeviceRegistry& DeviceRegistry::Get()
+{
+	static DeviceRegistry registry;
+	return registry;
+}
+
+/**
+	@brief Processes hotplug events that have happened since we last looked, without waiting for any
+ */
+void DeviceRegistry::HandleEvents()
+{
+	if(!m_hotplug)
+		return;
+	timeval zero = {0, 0};
+	libusb_handle_events_timeout_completed(NULL, &zero, NULL);
+}
+
+/**
+	@brief Drops our list of a vendor's devices, so it's read again next time (call with m_mutex held)
+ */
+void DeviceRegistry::Forget(uint16_t idVendor)
+{
+	auto it = m_devices.find(idVendor);
+	if(it == m_devices.end())
+		return;
+	for(auto device : it->second)
+	{
+		m_serials.erase(device);
+		libusb_unref_device(device);
+	}
+	m_devices.erase(it);
+}
+
+/**
+	@brief Starts following a vendor's devices coming and going, if we aren't already (call with m_mutex held)
+
+	@return True if the list of the vendor's devices can be kept, false if it has to be read every time
+ */
+bool DeviceRegistry::Watch(uint16_t idVendor)
+{
+	if(!m_hotplug)
+		return false;
+	if(m_callbacks.find(idVendor) != m_callbacks.end())
+		return true;
+
+	libusb_hotplug_callback_handle handle;
+	int err = libusb_hotplug_register_callback(
+		NULL,
+		(libusb_hotplug_event)(LIBUSB_HOTPLUG_EVENT_DEVICE_ARRIVED | LIBUSB_HOTPLUG_EVENT_DEVICE_LEFT),
+		(libusb_hotplug_flag)0,
+		idVendor,
+		LIBUSB_HOTPLUG_MATCH_ANY,
+		LIBUSB_HOTPLUG_MATCH_ANY,
+		OnHotplug,
+		this,
+		&handle);
+	if(err != LIBUSB_SUCCESS)
+	{
+		LogDebug("Couldn't register hotplug callback (%s), rescanning the bus every time\n", libusb_error_name(err));
+		m_hotplug = false;
+		return false;
+	}
+	m_callbacks[idVendor] = handle;
+	return true;
+}
+
+/**
+	@brief Called by libusb, from whichever thread is handling events, when a device we're watching comes or goes
+ */
+int LIBUSB_CALL DeviceRegistry::OnHotplug(
+	libusb_context* /*ctx*/,
+	libusb_device* device,
+	libusb_hotplug_event event,
+	void* data)
+{
+	auto registry = static_cast<DeviceRegistry*>(data);
+
+	libusb_device_descriptor desc;
+	if(0 != libusb_get_device_descriptor(device, &desc))
+		return 0;
+
+	lock_guard<mutex> lock(registry->m_mutex);
+	LogDebug("USB device %04x:%04x %s\n", desc.idVendor, desc.idProduct,
+		(event == LIBUSB_HOTPLUG_EVENT_DEVICE_ARRIVED) ? "arrived" : "left");
+	if(event == LIBUSB_HOTPLUG_EVENT_DEVICE_ARRIVED)
+		registry->m_arrivals[(desc.idVendor << 16) | desc.idProduct] ++;
+
+	//Where the device sits in the new list depends on where it's plugged in, so the list has to come from libusb
+	registry->Forget(desc.idVendor);
+
+	//Keep the callback
+	return 0;
+}
+
+/**
+	@brief Gets the devices from a vendor, in libusb_get_device_list() order
+
+	@param idVendor		USB VID
+	@param devices		Gets the devices, each with a reference the caller must drop with libusb_unref_device()
+ */
+bool DeviceRegistry::GetDevices(uint16_t idVendor, vector<libusb_device*>& devices)
+{
+	HandleEvents();
+
+	lock_guard<mutex> lock(m_mutex);
+	if(!Watch(idVendor))
+		Forget(idVendor);
+
+	if(m_devices.find(idVendor) == m_devices.end())
+	{
+		libusb_device** list;
+		ssize_t devcount = libusb_get_device_list(NULL, &list);
+		if(devcount < 0)
+		{
+			LogError("libusb_get_device_list failed\n");
+			return false;
+		}
+
+		vector<libusb_device*>& found = m_devices[idVendor];
+		for(ssize_t i=0; i<devcount; i++)
+		{
+			libusb_device_descriptor desc;
+			if(0 != libusb_get_device_descriptor(list[i], &desc))
+				continue;
+			if(desc.idVendor == idVendor)
+				found.push_back(libusb_ref_device(list[i]));
+		}
+		libusb_free_device_list(list, 1);
+	}
+
+	devices.clear();
+	for(auto device : m_devices[idVendor])
+		devices.push_back(libusb_ref_device(device));
+	return true;
+}
+
+/**
+	@brief Gets how many devices with a VID:PID have arrived so far, to pass to WaitForArrival() later
+ */
+unsigned int DeviceRegistry::CountArrivals(uint16_t idVendor, uint16_t idProduct)
+{
+	HandleEvents();
+
+	lock_guard<mutex> lock(m_mutex);
+	Watch(idVendor);
+	return m_arrivals[(idVendor << 16) | idProduct];
+}
+
+/**
+	@brief Waits for a device with a VID:PID to arrive, e.g. a board re-enumerating after switching mode
+
+	@param idVendor		USB VID
+	@param idProduct	USB PID
+	@param since		What CountArrivals() said before the device went away
+	@param timeoutMs	How long to give it
+
+	@return True if one arrived, false if it didn't or we can't tell (libusb has no hotplug support)
+ */
+bool DeviceRegistry::WaitForArrival(uint16_t idVendor, uint16_t idProduct, unsigned int since, unsigned int timeoutMs)
+{
+	{
+		lock_guard<mutex> lock(m_mutex);
+		if(!Watch(idVendor))
+			return false;
+	}
+
+	auto deadline = chrono::steady_clock::now() + chrono::milliseconds(timeoutMs);
+	while(chrono::steady_clock::now() < deadline)
+	{
+		{
+			lock_guard<mutex> lock(m_mutex);
+			if(m_arrivals[(idVendor << 16) | idProduct] != since)
+				return true;
+		}
+
+		timeval poll = {0, 50 * 1000};
+		libusb_handle_events_timeout_completed(NULL, &poll, NULL);
+	}
+	return false;
+}
+
+/**
+	@brief Gets a listed device's serial number, if we've read it before
+ */
+bool DeviceRegistry::LookupSerial(libusb_device* device, string& serial)
+{
+	lock_guard<mutex> lock(m_mutex);
+	auto it = m_serials.find(device);
+	if(it == m_serials.end())
+		return false;
+	serial = it->second;
+	return true;
+}
+
+/**
+	@brief Remembers a device's serial number for as long as the device stays listed, so its address can't be reused
+	by another device in the meantime
+ */
+void DeviceRegistry::RememberSerial(libusb_device* device, const string& serial)
+{
+	lock_guard<mutex> lock(m_mutex);
+	for(auto& it : m_devices)
+	{
+		for(auto listed : it.second)
+		{
+			if(listed == device)
+				m_serials[device] = serial;
+		}
+	}
+}
+
+/**
+	@brief Gets how many devices with a VID:PID have arrived so far, to pass to WaitForDeviceArrival() later
+ */
+unsigned int CountDeviceArrivals(uint16_t idVendor, uint16_t idProduct)
+{
+	return DeviceRegistry::Get().CountArrivals(idVendor, idProduct);
+}
+
+/**
+	@brief Waits for a device with a VID:PID to arrive, e.g. a board re-enumerating after switching mode
+
+	@param since		What CountDeviceArrivals() said before the device went away
+	@param timeoutMs	How long to give it
+
+	@return True if one arrived, false if it didn't or we can't tell (libusb has no hotplug support)
+ */
+bool WaitForDeviceArrival(uint16_t idVendor, uint16_t idProduct, unsigned int since, unsigned int timeoutMs)
+{
+	return DeviceRegistry::Get().WaitForArrival(idVendor, idProduct, since, timeoutMs);
+}
+
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 // Enumeration / setup helpers
 
@@ -75,10 +1129,61 @@ bool USBSetup()
 
 void USBCleanup(hdevice hdev)
 {
-	libusb_close(hdev);
+	if(hdev)
+	{
+		ForgetBoardConfig(hdev);
+		ForgetUSBStatistics(hdev);
+		libusb_close(hdev);
+	}
 	libusb_exit(NULL);
 }
 
+/**
+	@brief Counts the devices from a vendor, so the caller knows which indices OpenDevice() will accept
+
+	@param idVendor		USB VID
+ */
+int CountDevices(uint16_t idVendor)
+{
+	vector<libusb_device*> devices;
+	if(!DeviceRegistry::Get().GetDevices(idVendor, devices))
+		return -1;
+	for(auto device : devices)
+		libusb_unref_device(device);
+	return devices.size();
+}
+
+/**
+	@brief Gets something that tells one board from another: its serial number if it has one, or else where it's
+	plugged in
+ */
+bool GetBoardSerial(hdevice hdev, string& serial)
+{
+	libusb_device* device = libusb_get_device(hdev);
+	libusb_device_descriptor desc;
+	if(0 != libusb_get_device_descriptor(device, &desc))
+	{
+		LogError("libusb_get_device_descriptor failed\n");
+		return false;
+	}
+	if(desc.iSerialNumber != 0)
+	{
+		if(DeviceRegistry::Get().LookupSerial(device, serial))
+			return true;
+		if(!GetStringDescriptor(hdev, desc.iSerialNumber, serial))
+			return false;
+		DeviceRegistry::Get().RememberSerial(device, serial);
+		return true;
+	}
+
+	char location[32];
+	snprintf(location, sizeof(location), "bus%d-port%d",
+		libusb_get_bus_number(device),
+		libusb_get_port_number(device));
+	serial = location;
+	return true;
+}
+
 /**
 	@brief Gets the device handle
 
@@ -97,16 +1202,13 @@ hdevice OpenDevice(uint16_t idVendor, uint16_t idProduct, int nboard)
 		return NULL;
 	}
 
-	libusb_device** list;
-	ssize_t devcount = libusb_get_device_list(NULL, &list);
-	if(devcount < 0)
-	{
-		LogError("libusb_get_device_list failed\n");
+	//Everything from the right vendor
+	vector<libusb_device*> list;
+	if(!DeviceRegistry::Get().GetDevices(idVendor, list))
 		return NULL;
-	}
 	libusb_device* device = NULL;
 	bool found = false;
-	for(ssize_t i=0; i<devcount; i++)
+	for(size_t i=0; i<list.size(); i++)
 	{
 		device = list[i];
 
@@ -114,10 +1216,6 @@ hdevice OpenDevice(uint16_t idVendor, uint16_t idProduct, int nboard)
 		if(0 != libusb_get_device_descriptor(device, &desc))
 			continue;
 
-		//Skip anything from the wrong vendor
-		if(desc.idVendor != idVendor)
-			continue;
-
 		LogDebug("Found Silego device at bus %d, port %d\n",
 			libusb_get_bus_number(device),
 			libusb_get_port_number(device));
@@ -148,7 +1246,8 @@ hdevice OpenDevice(uint16_t idVendor, uint16_t idProduct, int nboard)
 			return NULL;
 		}
 	}
-	libusb_free_device_list(list, 1);
+	for(auto d : list)
+		libusb_unref_device(d);
 	if(!found)
 	{
 		return NULL;
@@ -19,11 +19,17 @@
 #include <unistd.h>
 #include <cmath>
 #include <cstring>
+#include <ctime>
+#include <map>
 
 #include <log.h>
+#include <Greenpak4.h>
 #include "gpdevboard.h"
 
+#include <fcntl.h>
 #include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 using namespace std;
 
@@ -54,6 +60,20 @@ bool CheckStatus(hdevice hdev)
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 // Initialization
 
+/**
+	@brief Counts the developer boards plugged in (in either mode), i.e. how many indices OpenBoard() can be given
+
+	@return The number of boards, or -1 if USB couldn't be set up
+ */
+int CountBoards()
+{
+	if(!USBSetup())
+		return -1;
+	int count = CountDevices(0x0f0f);
+	USBCleanup(NULL);
+	return count;
+}
+
 /**
 	@brief Connect to the board, but don't change anything
 
@@ -73,20 +93,31 @@ hdevice OpenBoard(int nboard, bool test)
 	//Try opening the board in "white" mode first
 	hdevice hdev = OpenDevice(0x0f0f, 0x8006, nboard);
 	bool switching = false;
+	bool arrived = false;
 	if(hdev)
 	{
 		//Change the board into "orange" mode
 		LogVerbose("Switching developer board from bootloader mode\n");
+		unsigned int arrivals = CountDeviceArrivals(0x0f0f, 0x0006);
 		if(!SwitchMode(hdev))
 			return NULL;
 
-		//Takes a while to switch and re-enumerate
-		usleep(1200 * 1000);
+		//Takes a while to switch and re-enumerate.
+		//If libusb can tell us when it's back, wait for that, otherwise allow long enough it always is.
+		arrived = WaitForDeviceArrival(0x0f0f, 0x0006, arrivals, 3000);
+		if(!arrived)
+			usleep(1200 * 1000);
 		switching = true;
 	}
 
-	//By this point, it should be in "orange" mode
+	//By this point, it should be in "orange" mode.
+	//If it's only just arrived, udev may not have given us permission to open it yet, so allow it a moment.
 	hdev = OpenDevice(0x0f0f, 0x0006, nboard);
+	for(int i=0; arrived && !hdev && i<10; i++)
+	{
+		usleep(100 * 1000);
+		hdev = OpenDevice(0x0f0f, 0x0006, nboard);
+	}
 	if(!hdev)
 	{
 		if(switching)
@@ -278,7 +309,7 @@ bool VerifyDevicePresent(hdevice hdev, SilegoPart expectedPart)
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 // Bitstream classification
 
-BitstreamKind ClassifyBitstream(SilegoPart part, vector<uint8_t> bitstream, uint8_t &patternId)
+BitstreamKind ClassifyBitstream(SilegoPart part, const vector<uint8_t>& bitstream, uint8_t &patternId)
 {
 	vector<uint8_t> emptyBitstream(BitstreamLength(part) / 8);
 	vector<uint8_t> factoryMask(BitstreamLength(part) / 8);
@@ -288,19 +319,17 @@ BitstreamKind ClassifyBitstream(SilegoPart part, vector<uint8_t> bitstream, uint
 		case SLG46620V:
 		case SLG46621V:
 		case SLG4662XV:
-			emptyBitstream[0x7f] = 0x5a;
-			emptyBitstream[0xff] = 0xa5;
+			Greenpak4BitstreamLayout::SetField(emptyBitstream, SLG4662X_DEVICE_ID, 0x5a);
+			Greenpak4BitstreamLayout::SetField(emptyBitstream, SLG4662X_END_MARKER, 0xa5);
 			//TODO: RC oscillator trim value, why is it factory programmed?
-			factoryMask[0xf7] = 0xff;
-			factoryMask[0xf8] = 0xff;
+			Greenpak4BitstreamLayout::SetField(factoryMask, SLG4662X_FACTORY_TRIM, ~0ULL);
 			break;
 
 		case SLG46140V:
-			emptyBitstream[0x7b] = 0x5a;
-			emptyBitstream[0x7f] = 0xa5;
+			Greenpak4BitstreamLayout::SetField(emptyBitstream, SLG46140_DEVICE_ID, 0x5a);
+			Greenpak4BitstreamLayout::SetField(emptyBitstream, SLG46140_END_MARKER, 0xa5);
 			//TODO: RC oscillator trim value, why is it factory programmed?
-			factoryMask[0x77] = 0xff;
-			factoryMask[0x78] = 0xff;
+			Greenpak4BitstreamLayout::SetField(factoryMask, SLG46140_FACTORY_TRIM, ~0ULL);
 			break;
 
 		default:
@@ -337,11 +366,11 @@ BitstreamKind ClassifyBitstream(SilegoPart part, vector<uint8_t> bitstream, uint
 		case SLG46620V:
 		case SLG46621V:
 		case SLG4662XV:
-			patternId = (bitstream[0xfd] >> 7) | (bitstream[0xfe] << 1);
+			patternId = Greenpak4BitstreamLayout::GetField(bitstream, SLG4662X_PATTERN_ID);
 			break;
 
 		case SLG46140V:
-			patternId = (bitstream[0x7d] >> 7) | (bitstream[0x7e] << 1);
+			patternId = Greenpak4BitstreamLayout::GetField(bitstream, SLG46140_PATTERN_ID);
 			break;
 
 		default:
@@ -356,6 +385,72 @@ BitstreamKind ClassifyBitstream(SilegoPart part, vector<uint8_t> bitstream, uint
 		return BitstreamKind::UNRECOGNIZED;
 }
 
+/**
+	@brief Hashes what a bitstream configures the part to do, leaving out the fields that gp4prog fills in per part
+
+	The oscillator trim and the other factory-programmed trim values differ from part to part (and from one trim to
+	the next), and the pattern ID is usually given on the command line, so none of them are hashed. Two bitstreams
+	with the same hash are the same design.
+
+	@return 64-bit FNV-1a hash of the bitstream with those fields cleared
+ */
+uint64_t BitstreamContentHash(SilegoPart part, const vector<uint8_t>& bitstream)
+{
+	vector<uint8_t> mask(bitstream.size());
+	auto maskField = [&](const Greenpak4BitstreamField& field)
+	{
+		Greenpak4BitstreamLayout::SetField(mask, field, ~0ULL);
+	};
+
+	switch(part)
+	{
+		case SLG46620V:
+		case SLG46621V:
+		case SLG4662XV:
+			maskField(SLG4662X_OSC_TRIM);
+			maskField(SLG4662X_FACTORY_TRIM);
+			maskField(SLG4662X_PATTERN_ID);
+			break;
+
+		case SLG46140V:
+			maskField(SLG46140_FACTORY_TRIM);
+			maskField(SLG46140_PATTERN_ID);
+			break;
+
+		default:
+			LogFatal("Unknown part\n");
+	}
+
+	for(size_t i=0; i<bitstream.size(); i++)
+		mask[i] = bitstream[i] & ~mask[i];
+	return Greenpak4Netlist::HashBytes(mask.data(), mask.size());
+}
+
+/**
+	@brief Checks if a part already holds a bitstream, so there's no need to program it again
+
+	@param part			Part in the socket
+	@param programmed	Bitstream read back from the part
+	@param expected		Bitstream we would program, with the pattern ID already applied
+
+	@return True if the designs are the same (see BitstreamContentHash()) and so are their pattern IDs. The trim isn't
+			compared, so a part that was trimmed when it was programmed keeps its trim.
+ */
+bool HoldsBitstream(SilegoPart part, const vector<uint8_t>& programmed, const vector<uint8_t>& expected)
+{
+	if(programmed.size() != expected.size())
+		return false;
+
+	uint8_t programmedId = 0;
+	uint8_t expectedId = 0;
+	ClassifyBitstream(part, programmed, programmedId);
+	ClassifyBitstream(part, expected, expectedId);
+	if(programmedId != expectedId)
+		return false;
+
+	return BitstreamContentHash(part, programmed) == BitstreamContentHash(part, expected);
+}
+
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 // Part database
 
@@ -388,9 +483,15 @@ size_t BitstreamLength(SilegoPart part)
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 // Socket test
 
-bool SocketTest(hdevice hdev, SilegoPart part)
+/**
+	@brief Checks every connection between the socket and the part, using a loopback bitstream
+
+	@param quick	Set to only check the pins can be driven low, which is half the work. That's enough to find pins
+					that aren't making contact, but not ones shorted to ground.
+ */
+bool SocketTest(hdevice hdev, SilegoPart part, bool quick)
 {
-	LogVerbose("Running electrical loopback test on socket\n");
+	LogVerbose("Running %selectrical loopback test on socket\n", quick ? "quick " : "");
 	LogIndenter li;
 
 	vector<uint8_t> loopbackBitstream;
@@ -475,8 +576,10 @@ bool SocketTest(hdevice hdev, SilegoPart part)
 		make_tuple(TP_VDD, TP_FLIMSY_PULLDOWN, 1.024),
 	};
 
-	for(auto config : sequence)
+	size_t levels = quick ? 1 : 2;
+	for(size_t n = 0; n < levels; n++)
 	{
+		auto config = sequence[n];
 		if(get<0>(config) == TP_GND)
 			LogVerbose("Testing logical low output\n");
 		else
@@ -531,10 +634,363 @@ bool SocketTest(hdevice hdev, SilegoPart part)
 	return ok;
 }
 
+/**
+	@brief When a socket last passed the full test
+ */
+class SocketHealth
+{
+public:
+	SocketHealth()
+		: lastFullTest(0)
+		, partsSince(0)
+	{}
+
+	//Time of the last full test that passed
+	time_t lastFullTest;
+
+	//Number of quick checks since then
+	unsigned int partsSince;
+};
+
+/**
+	@brief Reads, and optionally changes, one socket's entry in the socket health cache
+
+	Other processes may be testing other boards at the same time, so the file is locked for as long as we're using it.
+	The test itself happens with the lock released, though, or they'd all have to wait for each other.
+
+	@param fname	Path to the cache
+	@param key		Which board and package the entry is for
+	@param health	Set to the entry, if it's there
+	@param update	What to change the entry to (NULL to only read it)
+	@param erase	Set to remove the entry rather than changing it
+
+	@return True if the entry was in the cache
+ */
+static bool AccessSocketHealth(
+	const string& fname,
+	const string& key,
+	SocketHealth& health,
+	const SocketHealth* update,
+	bool erase)
+{
+	int fd = open(fname.c_str(), O_RDWR | O_CREAT, 0666);
+	if(fd < 0)
+	{
+		LogWarning("Couldn't open socket health cache %s, running full socket tests\n", fname.c_str());
+		return false;
+	}
+	flock(fd, LOCK_EX);
+	FILE* fp = fdopen(fd, "r+");
+
+	//Each line is a key, the time of the last full test and the number of parts since
+	map<string, SocketHealth> entries;
+	char line[256];
+	while(fgets(line, sizeof(line), fp))
+	{
+		char name[200];
+		long long when;
+		SocketHealth entry;
+		if(3 != sscanf(line, "%199s %lld %u", name, &when, &entry.partsSince))
+			continue;
+		entry.lastFullTest = when;
+		entries[name] = entry;
+	}
+
+	bool found = (entries.find(key) != entries.end());
+	if(found)
+		health = entries[key];
+
+	if(update || erase)
+	{
+		if(erase)
+			entries.erase(key);
+		else
+			entries[key] = *update;
+
+		rewind(fp);
+		for(auto& it : entries)
+			fprintf(fp, "%s %lld %u\n", it.first.c_str(), (long long)it.second.lastFullTest, it.second.partsSince);
+		fflush(fp);
+		if(0 != ftruncate(fd, ftell(fp)))
+			LogWarning("Couldn't truncate socket health cache %s\n", fname.c_str());
+	}
+
+	//Closing the file releases the lock
+	fclose(fp);
+	return found;
+}
+
+/**
+	@brief Runs the full socket test only if it hasn't passed on this board recently, and a quick check otherwise
+
+	The cache is keyed by board serial number (and package), so it carries over between processes and doesn't care
+	which index a board happens to enumerate at. The full test runs if the last one was too long ago, or too many parts
+	ago, or if the quick check finds anything wrong. A board whose full test fails loses its cache entry, so it gets
+	fully tested until it passes again.
+ */
+bool CachedSocketTest(hdevice hdev, SilegoPart part, const SocketTestPolicy& policy)
+{
+	string serial;
+	if(!GetBoardSerial(hdev, serial))
+		return false;
+	string key = serial + "/" + PartName(part);
+
+	SocketHealth health;
+	time_t now = time(NULL);
+	if(AccessSocketHealth(policy.cacheFile, key, health, NULL, false))
+	{
+		double age = difftime(now, health.lastFullTest);
+		if( (age >= 0) && (age < policy.maxAge) && (health.partsSince < policy.maxParts) )
+		{
+			LogVerbose("Socket passed full test %.0f s and %u parts ago, running quick check\n",
+				age, health.partsSince);
+			if(SocketTest(hdev, part, true))
+			{
+				SocketHealth checked = health;
+				checked.partsSince ++;
+				AccessSocketHealth(policy.cacheFile, key, health, &checked, false);
+				return true;
+			}
+
+			LogWarning("Quick socket check failed, running full socket test\n");
+		}
+	}
+
+	if(!SocketTest(hdev, part))
+	{
+		AccessSocketHealth(policy.cacheFile, key, health, NULL, true);
+		return false;
+	}
+
+	SocketHealth passed;
+	passed.lastFullTest = now;
+	AccessSocketHealth(policy.cacheFile, key, health, &passed, false);
+	return true;
+}
+
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 // Oscillator trimming
 
-bool TrimOscillator(hdevice hdev, SilegoPart part, double voltage, unsigned freq, uint8_t &ftw)
+/**
+	@brief Finds the trim value for a frequency by bisection, measuring the oscillator at every step
+ */
+static bool TrimBisect(hdevice hdev, unsigned freq, uint8_t &ftw)
+{
+	uint8_t low = 0, high = 0x7f, mid;
+	unsigned actualFreq;
+	while(low < high)
+	{
+		mid = low + (high - low) / 2;
+		LogDebug("Trimming with FTW %d\n", mid);
+		if(!TrimOscillator(hdev, mid))
+			return false;
+		if(!MeasureOscillatorFrequency(hdev, actualFreq))
+			return false;
+		LogDebug("Oscillator frequency is %.3f kHz\n", actualFreq/1000.0f);
+		if(actualFreq > freq)
+		{
+			high = mid;
+		}
+		else if(actualFreq < freq)
+		{
+			low = mid + 1;
+		}
+		else
+			break;
+	}
+	LogNotice("Trimmed RC oscillator to %.3f kHz\n", actualFreq/1000.0f);
+	ftw = mid;
+
+	return true;
+}
+
+/**
+	@brief Guesses the trim value that gives a frequency
+ */
+int OscillatorCalibration::Predict(unsigned freq) const
+{
+	int ftw = lround((freq - m_offset) / m_slope);
+	return min(max(ftw, 0), 0x7f);
+}
+
+/**
+	@brief Refits the model to the measurements made while trimming one more part
+
+	The slope is averaged over every part so far. The offset is what varies from part to part, so it's just the
+	latest part's.
+
+	@param freq				Target frequency the part was trimmed for
+	@param voltage			Vdd the part was trimmed at
+	@param measurements		Frequency measured at each trim value tried
+
+	@return False if the measurements don't say anything about the slope (the model is then left alone)
+ */
+bool OscillatorCalibration::Update(unsigned freq, double voltage, const vector<pair<int, unsigned> >& measurements)
+{
+	//A model for some other target is no use
+	if(!IsValidFor(freq, voltage))
+		m_parts = 0;
+	m_freq = freq;
+	m_voltage = voltage;
+
+	//Least-squares line through the measurements
+	double n = measurements.size();
+	double sx = 0, sy = 0, sxx = 0, sxy = 0;
+	for(auto& m : measurements)
+	{
+		sx += m.first;
+		sy += m.second;
+		sxx += m.first * (double)m.first;
+		sxy += m.first * (double)m.second;
+	}
+	double det = n*sxx - sx*sx;
+
+	//If all the measurements are at one trim value, we can only refit the offset
+	double slope;
+	if(det > 0)
+		slope = (n*sxy - sx*sy) / det;
+	else if(m_parts > 0)
+		slope = m_slope;
+	else
+		return false;
+	if(slope <= 0)
+		return false;
+
+	m_slope = (m_slope * m_parts + slope) / (m_parts + 1);
+	m_offset = (sy - m_slope*sx) / n;
+	m_parts ++;
+	return true;
+}
+
+/**
+	@brief Finds the trim value closest to a frequency by predicting it from a model of the oscillator
+
+	The guess comes from the calibration if it has one for this target, or else from a line through two measurements.
+	Each guess is measured and corrected by the model's slope until the two trim values either side of the target are
+	known. Measurements outside those two are never needed, so a bad guess can only cost a few extra round trips.
+	This typically takes three measurements, or two with a calibration, rather than the seven bisection needs.
+ */
+static bool TrimPredictive(
+	hdevice hdev,
+	double voltage,
+	unsigned freq,
+	uint8_t &ftw,
+	OscillatorCalibration& calibration)
+{
+	vector<pair<int, unsigned> > measurements;
+
+	//Closest trim values known to be below and above the target
+	int below = -1;
+	int above = 0x80;
+	unsigned belowFreq = 0;
+	unsigned aboveFreq = 0;
+
+	//Measures the frequency at one trim value, and says whether it's exactly on target
+	unsigned actualFreq = 0;
+	bool exact = false;
+	auto measure = [&](int value) -> bool
+	{
+		LogDebug("Trimming with FTW %d\n", value);
+		if(!TrimOscillator(hdev, value))
+			return false;
+		if(!MeasureOscillatorFrequency(hdev, actualFreq))
+			return false;
+		LogDebug("Oscillator frequency is %.3f kHz\n", actualFreq/1000.0f);
+		measurements.push_back(pair<int, unsigned>(value, actualFreq));
+
+		if(actualFreq == freq)
+		{
+			exact = true;
+			ftw = value;
+		}
+		else if( (actualFreq < freq) && (value > below) )
+		{
+			below = value;
+			belowFreq = actualFreq;
+		}
+		else if( (actualFreq > freq) && (value < above) )
+		{
+			above = value;
+			aboveFreq = actualFreq;
+		}
+		return true;
+	};
+
+	int guess;
+	double slope;
+	if(calibration.IsValidFor(freq, voltage))
+	{
+		guess = calibration.Predict(freq);
+		slope = calibration.GetSlope();
+		LogDebug("Calibration from %u parts predicts FTW %d\n", calibration.GetParts(), guess);
+	}
+	else
+	{
+		//Far enough apart to see the slope clearly, and between them they cover most parts
+		if(!measure(0x20))
+			return false;
+		unsigned lowFreq = actualFreq;
+		if(!exact && !measure(0x60))
+			return false;
+		slope = (actualFreq - (double)lowFreq) / 0x40;
+		if(!exact && (slope <= 0) )
+		{
+			LogError("Oscillator frequency doesn't go up with the trim value\n");
+			return false;
+		}
+		guess = exact ? ftw : 0x60 + lround((freq - (double)actualFreq) / slope);
+	}
+
+	while(!exact && (above - below > 1) )
+	{
+		//Anything outside the trim values known to be either side of the target is no use
+		guess = min(max(guess, below + 1), above - 1);
+		if(!measure(guess))
+			return false;
+
+		//Correct by the model's slope. Even a perfect model can be out by one, since the measurements are quantized,
+		//so if it says to stay put, step towards the target instead
+		int next = guess + lround((freq - (double)actualFreq) / slope);
+		if(next == guess)
+			next += (actualFreq < freq) ? 1 : -1;
+		guess = next;
+	}
+
+	//Pick whichever side of the target is closer (or the only one there is, at the ends of the range)
+	if(!exact)
+	{
+		if(below < 0)
+			ftw = above;
+		else if(above > 0x7f)
+			ftw = below;
+		else
+			ftw = (freq - belowFreq <= aboveFreq - freq) ? below : above;
+	}
+	for(auto& m : measurements)
+	{
+		if(m.first == ftw)
+			actualFreq = m.second;
+	}
+	LogNotice("Trimmed RC oscillator to %.3f kHz\n", actualFreq/1000.0f);
+	LogVerbose("Predictive trim took %zu measurements\n", measurements.size());
+
+	calibration.Update(freq, voltage, measurements);
+	return true;
+}
+
+/**
+	@brief Trims the RC oscillator of the part in the socket to a frequency
+
+	@param calibration	Model of the board's oscillator to predict the trim value from, and to update with this part's
+						measurements, rather than searching by bisection (NULL to bisect)
+ */
+bool TrimOscillator(
+	hdevice hdev,
+	SilegoPart part,
+	double voltage,
+	unsigned freq,
+	uint8_t &ftw,
+	OscillatorCalibration* calibration)
 {
 	LogVerbose("Trimming RC oscillator for %.3f kHz\n", freq/1000.0f);
 	LogIndenter li;
@@ -599,30 +1055,13 @@ bool TrimOscillator(hdevice hdev, SilegoPart part, double voltage, unsigned freq
 		return false;
 
 	//The frequency tuning word is 7-bit
-	uint8_t low = 0, high = 0x7f, mid;
-	unsigned actualFreq;
-	while(low < high)
+	if(calibration)
 	{
-		mid = low + (high - low) / 2;
-		LogDebug("Trimming with FTW %d\n", mid);
-		if(!TrimOscillator(hdev, mid))
-			return false;
-		if(!MeasureOscillatorFrequency(hdev, actualFreq))
+		if(!TrimPredictive(hdev, voltage, freq, ftw, *calibration))
 			return false;
-		LogDebug("Oscillator frequency is %.3f kHz\n", actualFreq/1000.0f);
-		if(actualFreq > freq)
-		{
-			high = mid;
-		}
-		else if(actualFreq < freq)
-		{
-			low = mid + 1;
-		}
-		else
-			break;
 	}
-	LogNotice("Trimmed RC oscillator to %.3f kHz\n", actualFreq/1000.0f);
-	ftw = mid;
+	else if(!TrimBisect(hdev, freq, ftw))
+		return false;
 
 	LogVerbose("Resetting board after oscillator trimming\n");
 	if(!Reset(hdev))
@@ -646,8 +1085,63 @@ vector<uint8_t> BitstreamFromHex(string hex)
 	return bitstream;
 }
 
+/**
+	@brief Validates a binary bitstream file (as written by gp4par --output-format binary) and extracts the image
+
+	The header is checked by greenpak4, we only check that it suits the part we're programming.
+ */
+bool ReadBinaryBitstream(string fname, const uint8_t* data, size_t len, vector<uint8_t>& bitstream, SilegoPart part)
+{
+	uint16_t filePart;
+	const uint8_t* image;
+	unsigned int imageLen;
+	if(!Greenpak4Device::ParseBinaryHeader(data, len, fname, filePart, image, imageLen))
+		return false;
+
+	//Only the bitstream coding has to match, the low 4 bits are ours
+	if( (filePart >> 4) != ((unsigned int)part >> 4) )
+	{
+		LogError("Provided bitstream is for part code %03x, not a %s\n", filePart, PartName(part));
+		return false;
+	}
+
+	if(imageLen != BitstreamLength(part) / 8)
+	{
+		LogError("Provided bitstream has incorrect length for selected part\n");
+		return false;
+	}
+
+	bitstream.assign(image, image + imageLen);
+	return true;
+}
+
 bool ReadBitstream(string fname, vector<uint8_t>& bitstream, SilegoPart part)
 {
+	//Binary bitstreams get mapped and validated in place
+	int fd = open(fname.c_str(), O_RDONLY);
+	if(fd >= 0)
+	{
+		struct stat st;
+		if( (fstat(fd, &st) == 0) && (st.st_size >= 16) )
+		{
+			void* map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+			if(map != MAP_FAILED)
+			{
+				const uint8_t* data = static_cast<const uint8_t*>(map);
+				if(!memcmp(data, "GP4B", 4))
+				{
+					bool ok = ReadBinaryBitstream(fname, data, st.st_size, bitstream, part);
+					munmap(map, st.st_size);
+					close(fd);
+					return ok;
+				}
+				munmap(map, st.st_size);
+			}
+		}
+		close(fd);
+	}
+
+	//Otherwise it had better be text
 	FILE* fp = fopen(fname.c_str(), "rt");
 	if(!fp)
 	{
@@ -712,27 +1206,21 @@ bool TweakBitstream(vector<uint8_t>& bitstream, SilegoPart part, uint8_t oscTrim
 	if( (part == SLG46621V) || (part == SLG46620V) || (part == SLG4662XV) )
 	{
 		//Set trim value reg<1981:1975>
-		bitstream[246] &= 0xFE;
-		bitstream[247] &= 0x01;
-		bitstream[246] |= oscTrim << 7;
-		bitstream[247] |= oscTrim >> 1;
+		Greenpak4BitstreamLayout::SetField(bitstream, SLG4662X_OSC_TRIM, oscTrim);
 		LogVerbose("Oscillator trim value: %d\n", oscTrim);
 
-		//Set pattern ID reg<2031:2038>
+		//Set pattern ID reg<2031:2038> (zero leaves the one gp4par set)
 		if(patternID != 0)
-		{
-			bitstream[253] &= 0xFE;
-			bitstream[254] &= 0x01;
-		}
-		bitstream[253] |= patternID << 7;
-		bitstream[254] |= patternID >> 1;
-		LogNotice("Bitstream ID code: 0x%02x\n", patternID);
+			Greenpak4BitstreamLayout::SetField(bitstream, SLG4662X_PATTERN_ID, patternID);
+		LogNotice("Bitstream ID code: 0x%02x\n",
+			(unsigned int)Greenpak4BitstreamLayout::GetField(bitstream, SLG4662X_PATTERN_ID));
 
 		//Set read protection reg<2039>
 		//OR with the existing value: we can set the read protect bit here, but not overwrite the bit if
 		//it was set by gp4par. If you REALLY need to unprotect a bitstream, do it by hand in a text editor.
-		bitstream[254] |= ((uint8_t)readProtect) << 7;
-		if(bitstream[254] & 0x80)
+		if(readProtect)
+			Greenpak4BitstreamLayout::SetField(bitstream, SLG4662X_READ_PROTECT, 1);
+		if(Greenpak4BitstreamLayout::GetField(bitstream, SLG4662X_READ_PROTECT))
 			LogNotice("Read protection: enabled\n");
 		else
 			LogNotice("Read protection: disabled\n");
@@ -742,29 +1230,15 @@ bool TweakBitstream(vector<uint8_t>& bitstream, SilegoPart part, uint8_t oscTrim
 	{
 		LogWarning("Oscillator trim value: NOT IMPLEMENTED\n");
 
-		//Set pattern ID reg<1014:1007>
+		//Set pattern ID reg<1014:1007> (zero leaves the one gp4par set)
 		if(patternID != 0)
-		{
-			bitstream[125] &= 0xFE;
-			bitstream[126] &= 0x01;
-		}
-		bitstream[125] |= patternID << 7;
-		bitstream[126] |= patternID >> 1;
-		LogNotice("Bitstream ID code: 0x%02x\n", patternID);
+			Greenpak4BitstreamLayout::SetField(bitstream, SLG46140_PATTERN_ID, patternID);
+		LogNotice("Bitstream ID code: 0x%02x\n",
+			(unsigned int)Greenpak4BitstreamLayout::GetField(bitstream, SLG46140_PATTERN_ID));
 
 		//Set read protection... 1015 probably, but not sure?
 		LogWarning("Read protection: NOT IMPLEMENTED\n");
 
-		/*
-		//Set read protection reg<2039>
-		//OR with the existing value: we can set the read protect bit here, but not overwrite the bit if
-		//it was set by gp4par. If you REALLY need to unprotect a bitstream, do it by hand in a text editor.
-		bitstream[254] |= ((uint8_t)readProtect) << 7;
-		if(bitstream[254] & 0x80)
-			LogNotice("Read protection: enabled\n");
-		else
-			LogNotice("Read protection: disabled\n");
-		*/
 	}
 
 	else
@@ -782,17 +1256,55 @@ bool TweakBitstream(vector<uint8_t>& bitstream, SilegoPart part, uint8_t oscTrim
 /**
 	@brief Test helper for running tests when we have one or more dev boards attached.
 
-	NO CONFLICT AVOIDANCE! Assumes the following:
+	If gp4broker is running, it leases us a board with the right part, so tests can run in parallel and nobody else
+	can use the board while we have it. Otherwise there's NO CONFLICT AVOIDANCE! We then assume the following:
 	1) Test cases are run sequentially, not in parallel
 	2) No developer is currently running an interactive debug job on the node in question
+
+	The broker also remembers each board's oscillator trim between leases (see BoardSession), so after the first test
+	on a board, setup is little more than downloading the bitstream.
+
+	If downloadedBitstream isn't NULL, it gets the bitstream as downloaded (with the oscillator trim applied) so the
+	caller can restart the test from power-up later with RestartTest().
  */
-hdevice MultiBoardTestSetup(string fname, int rcOscFreq, double voltage, SilegoPart targetPart)
+hdevice MultiBoardTestSetup(
+	string fname,
+	int rcOscFreq,
+	double voltage,
+	SilegoPart targetPart,
+	vector<uint8_t>* downloadedBitstream)
 {
+	//The broker already knows which part is in which board, and has checked them
+	int broker = ConnectToBroker();
+	if(broker >= 0)
+	{
+		BoardSession session;
+		hdevice hdev = LeaseBoard(broker, targetPart, &session);
+		if(hdev && !TestSetup(hdev, fname, rcOscFreq, voltage, targetPart, downloadedBitstream, true, &session))
+		{
+			USBCleanup(hdev);
+			hdev = NULL;
+		}
+		if(!hdev)
+		{
+			close(broker);
+			return NULL;
+		}
+
+		//Let the broker pass the trim on to whoever gets the board next, and count what setting up took
+		UpdateLease(broker, session);
+		ReportLeaseUsage(broker, hdev);
+
+		//The connection stays open until we exit, holding the lease
+		SetStatusLED(hdev, 1);
+		return hdev;
+	}
+
 	LogNotice("Searching for a board with a %s installed...\n", PartName(targetPart));
 	LogIndenter li;
 
-	//TODO: pick reasonable max
-	for(int i=0; i<10; i++)
+	int nboards = CountBoards();
+	for(int i=0; i<nboards; i++)
 	{
 		//Try to open the next dev board.
 		//Failure is not fatal, we may have a perms error on one board but the next might be OK
@@ -801,7 +1313,7 @@ hdevice MultiBoardTestSetup(string fname, int rcOscFreq, double voltage, SilegoP
 			continue;
 
 		//Try to set up the test case on it
-		if(!TestSetup(hdev, fname, rcOscFreq, voltage, targetPart))
+		if(!TestSetup(hdev, fname, rcOscFreq, voltage, targetPart, downloadedBitstream))
 		{
 			SetStatusLED(hdev, 0);
 			Reset(hdev);
@@ -834,39 +1346,106 @@ bool SingleReadADC(hdevice hdev, unsigned int chan, double &value)
 	return true;
 }
 
+/**
+	@brief Works out the mean, range and standard deviation of each channel in a burst from BurstReadADC()
+
+	@param values		Samples from BurstReadADC()
+	@param nchannels	Number of channels the burst sampled
+	@param stats		Gets the statistics for each channel, in the order they were given to BurstReadADC()
+ */
+void GetADCStatistics(const vector<double>& values, size_t nchannels, vector<ADCStatistics>& stats)
+{
+	stats.assign(nchannels, ADCStatistics());
+	for(size_t i=0; i<values.size(); i++)
+	{
+		auto& s = stats[i % nchannels];
+		if( (s.count == 0) || (values[i] < s.min) )
+			s.min = values[i];
+		if( (s.count == 0) || (values[i] > s.max) )
+			s.max = values[i];
+		s.count ++;
+
+		//Welford's method, so a small spread on top of a large offset doesn't get lost to rounding
+		double delta = values[i] - s.mean;
+		s.mean += delta / s.count;
+		s.stddev += delta * (values[i] - s.mean);
+	}
+
+	for(auto& s : stats)
+	{
+		if(s.count > 1)
+			s.stddev = sqrt(s.stddev / (s.count - 1));
+		else
+			s.stddev = 0;
+	}
+}
+
 /**
 	@brief Wrapper around the test to do some board setup etc
+
+	@param checked	Set if the part and socket are already known to be good (because gp4broker checked them), so we
+					don't need to check them again
+	@param session	If not NULL, a trim it holds for the same part, frequency and voltage is used rather than trimming
+					again, and it's updated with the trim otherwise
  */
-bool TestSetup(hdevice hdev, string fname, int rcOscFreq, double voltage, SilegoPart targetPart)
+bool TestSetup(
+	hdevice hdev,
+	string fname,
+	int rcOscFreq,
+	double voltage,
+	SilegoPart targetPart,
+	vector<uint8_t>* downloadedBitstream,
+	bool checked,
+	BoardSession* session)
 {
 	//Clear signal generators when we start up
 	if(!ResetAllSiggens(hdev))
 		return false;
 
 	//Make sure we have the right part
-	if(!VerifyDevicePresent(hdev, targetPart))
+	if(!checked && !VerifyDevicePresent(hdev, targetPart))
 	{
 		LogNotice("Couldn't find the expected part, giving up\n");
 		return false;
 	}
 
 	//Make sure the board is electrically functional
-	if(!SocketTest(hdev, targetPart))
+	if(!checked && !CachedSocketTest(hdev, targetPart))
 	{
 		LogError("Target board self-test failed\n");
 		return false;
 	}
 
-	//Clear signal generators again before we go further
-	if(!ResetAllSiggens(hdev))
+	//Clear signal generators again before we go further (only the socket test could have touched them)
+	if(!checked && !ResetAllSiggens(hdev))
 		return false;
 
-	//Trim the oscillator
+	//Trim the oscillator, unless we already know the answer
 	uint8_t rcFtw = 0;
-	if(!TrimOscillator(hdev, targetPart, voltage, rcOscFreq, rcFtw))
-		return false;
+	if(session && session->HasTrim(targetPart, rcOscFreq, voltage))
+	{
+		rcFtw = session->trimFtw;
+		LogVerbose("Reusing oscillator trim 0x%02x from the last lease\n", rcFtw);
+
+		//The trim would have reset the board for us
+		if(!Reset(hdev))
+			return false;
+	}
+	else
+	{
+		if(!TrimOscillator(hdev, targetPart, voltage, rcOscFreq, rcFtw))
+			return false;
+
+		//No need to reset board, the trim does that for us
 
-	//No need to reset board, the trim does that for us
+		if(session)
+		{
+			session->part = targetPart;
+			session->trimFreq = rcOscFreq;
+			session->trimVoltage = voltage;
+			session->trimFtw = rcFtw;
+		}
+	}
 
 	//Read the bitstream
 	vector<uint8_t> bitstream;
@@ -879,17 +1458,10 @@ bool TestSetup(hdevice hdev, string fname, int rcOscFreq, double voltage, Silego
 
 	//Program the device
 	LogNotice("Downloading bitstream to board\n");
-	if(!DownloadBitstream(hdev, bitstream, DownloadMode::EMULATION))
-		return false;
-
-	//Developer board I/O pins become stuck after both SRAM and NVM programming;
-	//resetting them explicitly makes LEDs and outputs work again.
-	LogDebug("Resetting board I/O pins after programming\n");
-	IOConfig ioConfig;
-	for(size_t i = 2; i <= 20; i++)
-		ioConfig.driverConfigs[i] = TP_RESET;
-	if(!SetIOConfig(hdev, ioConfig))
+	if(!RestartTest(hdev, bitstream))
 		return false;
+	if(downloadedBitstream)
+		*downloadedBitstream = bitstream;
 
 	//Configure the signal generator for Vdd
 	LogNotice("Setting Vdd to %.3g V\n", voltage);
@@ -906,3 +1478,25 @@ bool TestSetup(hdevice hdev, string fname, int rcOscFreq, double voltage, Silego
 	LogNotice("Test setup complete\n");
 	return true;
 }
+
+/**
+	@brief Puts the device back in its power-up state, by downloading the bitstream from TestSetup() again
+
+	Cheaper than a whole new TestSetup(), since the socket test and oscillator trim don't have to be redone.
+ */
+bool RestartTest(hdevice hdev, const vector<uint8_t>& downloadedBitstream)
+{
+	FramePipeline pipeline(hdev);
+	if(!DownloadBitstream(hdev, downloadedBitstream, DownloadMode::EMULATION))
+		return false;
+
+	//Developer board I/O pins become stuck after both SRAM and NVM programming;
+	//resetting them explicitly makes LEDs and outputs work again.
+	LogDebug("Resetting board I/O pins after programming\n");
+	IOConfig ioConfig;
+	for(size_t i = 2; i <= 20; i++)
+		ioConfig.driverConfigs[i] = TP_RESET;
+	if(!SetIOConfig(hdev, ioConfig))
+		return false;
+	return pipeline.Flush();
+}
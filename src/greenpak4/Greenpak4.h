@@ -24,6 +24,7 @@
 	@brief Master include file for all Greenpak4 related stuff
  */
 
+#include "Greenpak4Bitstream.h"
 #include "Greenpak4BitstreamEntity.h"
 #include "Greenpak4EntityOutput.h"
 #include "Greenpak4DualEntity.h"
@@ -60,6 +61,10 @@
 #include "Greenpak4SystemReset.h"
 #include "Greenpak4VoltageReference.h"
 
+#include "Greenpak4CacheFile.h"
+#include "Greenpak4CellParameters.h"
+#include "Greenpak4JSONReader.h"
+#include "Greenpak4NetlistSymbol.h"
 #include "Greenpak4NetlistNode.h"
 #include "Greenpak4NetlistCell.h"
 #include "Greenpak4NetlistModule.h"
@@ -67,5 +72,6 @@
 #include "Greenpak4Netlist.h"
 
 #include "Greenpak4Device.h"
+#include "Greenpak4BitstreamTemplate.h"
 
 #endif
@@ -81,21 +81,30 @@ bool Greenpak4Abuf::CommitChanges()
 	if(ncell == NULL)
 		return true;
 
-	if(ncell->HasParameter("BANDWIDTH_KHZ"))
-		m_bufferBandwidth = atoi(ncell->m_parameters["BANDWIDTH_KHZ"].c_str());
+	if(ncell->HasParameter(PARAM_BANDWIDTH_KHZ))
+		m_bufferBandwidth = ncell->GetParameter(PARAM_BANDWIDTH_KHZ);
 
 	//No configuration
 	return true;
 }
 
-bool Greenpak4Abuf::Load(bool* /*bitstream*/)
+bool Greenpak4Abuf::Load(Greenpak4Bitstream& bitstream)
 {
-	//TODO: Do our inputs
-	LogError("Unimplemented\n");
-	return false;
+	////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+	// INPUT BUS
+
+	//none
+
+	////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+	// CONFIGURATION
+
+	static const int bandwidths[4] = {1, 5, 20, 50};
+	m_bufferBandwidth = bandwidths[bitstream.GetField(m_configBase, 2)];
+
+	return true;
 }
 
-bool Greenpak4Abuf::Save(bool* bitstream)
+bool Greenpak4Abuf::Save(Greenpak4Bitstream& bitstream)
 {
 	////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 	// INPUT BUS
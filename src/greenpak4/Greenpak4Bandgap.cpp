@@ -92,49 +92,30 @@ bool Greenpak4Bandgap::CommitChanges()
 	if(ncell == NULL)
 		return true;
 
-	if(ncell->HasParameter("AUTO_PWRDN"))
-	{
-		string p = ncell->m_parameters["AUTO_PWRDN"];
-		if(p == "1")
-			m_autoPowerDown = true;
-		else
-			m_autoPowerDown = false;
-	}
+	if(ncell->HasParameter(PARAM_AUTO_PWRDN))
+		m_autoPowerDown = ncell->GetParameter(PARAM_AUTO_PWRDN);
 
-	if(ncell->HasParameter("CHOPPER_EN"))
-	{
-		string p = ncell->m_parameters["CHOPPER_EN"];
-		if(p == "1")
-			m_chopperEn = true;
-		else
-			m_chopperEn = false;
-	}
+	if(ncell->HasParameter(PARAM_CHOPPER_EN))
+		m_chopperEn = ncell->GetParameter(PARAM_CHOPPER_EN);
 
-	if(ncell->HasParameter("OUT_DELAY"))
-	{
-		string p = ncell->m_parameters["OUT_DELAY"];
-		if(p == "100")
-			m_outDelay = 100;
-		else if(p == "550")
-			m_outDelay = 550;
-		else
-		{
-			LogError("Bandgap has illegal reset delay \"%s\" (must be 100 or 550)\n",
-				p.c_str());
-			return false;
-		}
-	}
+	//Legal values (100 or 550) were checked when the netlist was loaded
+	if(ncell->HasParameter(PARAM_OUT_DELAY))
+		m_outDelay = ncell->GetParameter(PARAM_OUT_DELAY);
 
 	return true;
 }
 
-bool Greenpak4Bandgap::Load(bool* /*bitstream*/)
+bool Greenpak4Bandgap::Load(Greenpak4Bitstream& bitstream)
 {
-	LogError("Unimplemented\n");
-	return false;
+	m_outDelay = bitstream[m_configBase] ? 100 : 550;
+	m_autoPowerDown = !bitstream[m_cbasePowerEn];
+	if(m_cbaseChopper)
+		m_chopperEn = bitstream[m_cbaseChopper];
+
+	return true;
 }
 
-bool Greenpak4Bandgap::Save(bool* bitstream)
+bool Greenpak4Bandgap::Save(Greenpak4Bitstream& bitstream)
 {
 	//Startup delay
 	if(m_outDelay == 100)
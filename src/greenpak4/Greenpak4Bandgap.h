@@ -38,8 +38,8 @@ public:
 	virtual ~Greenpak4Bandgap();
 
 	//Serialization
-	virtual bool Load(bool* bitstream);
-	virtual bool Save(bool* bitstream);
+	virtual bool Load(Greenpak4Bitstream& bitstream);
+	virtual bool Save(Greenpak4Bitstream& bitstream);
 
 	virtual std::string GetDescription();
 
@@ -51,6 +51,10 @@ public:
 
 	virtual bool CommitChanges();
 
+	///Delay from startup to OK going high, in us
+	int GetOutputDelay()
+	{ return m_outDelay; }
+
 protected:
 
 	///Auto power-down
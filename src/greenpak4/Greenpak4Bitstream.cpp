@@ -0,0 +1,112 @@
+/***********************************************************************************************************************
+ * Copyright (C) 2016 Andrew Zonenberg and contributors                                                                *
+ *                                                                                                                     *
+ * This program is free software; you can redistribute it and/or modify it under the terms of the GNU Lesser General   *
+ * Public License as published by the Free Software Foundation; either version 2.1 of the License, or (at your option) *
+ * any later version.                                                                                                  *
+ *                                                                                                                     *
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied  *
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for     *
+ * more details.                                                                                                       *
+ *                                                                                                                     *
+ * You should have received a copy of the GNU Lesser General Public License along with this program; if not, you may   *
+ * find one here:                                                                                                      *
+ * https://www.gnu.org/licenses/old-licenses/lgpl-2.1.txt                                                              *
+ * or you may search the http://www.gnu.org website for the version 2.1 license, or you may write to the Free Software *
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA                                      *
+ **********************************************************************************************************************/
+
+
+#include <Greenpak4.h>
+
+using namespace std;
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Construction / destruction
+
+/**
+	@brief Creates a bitstream of the given length, with every bit zero
+ */
+Greenpak4Bitstream::Greenpak4Bitstream(unsigned int bitlen)
+	: m_bitlen(bitlen)
+	, m_words((bitlen + 63) / 64, 0)
+{
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Field access
+
+/**
+	@brief Reads a multi-bit field
+
+	@param start	Index of the field's LSB in the bitstream
+	@param width	Number of bits in the field (1...64)
+ */
+uint64_t Greenpak4Bitstream::GetField(unsigned int start, unsigned int width) const
+{
+	unsigned int word = start / 64;
+	unsigned int shift = start % 64;
+
+	//Low part comes from the first word, and the rest (if any) from the next one
+	uint64_t value = m_words[word] >> shift;
+	if(shift + width > 64)
+		value |= m_words[word + 1] << (64 - shift);
+
+	if(width < 64)
+		value &= (1ULL << width) - 1;
+	return value;
+}
+
+/**
+	@brief Writes a multi-bit field. Any bits of the value above the field width are ignored.
+
+	@param start	Index of the field's LSB in the bitstream
+	@param width	Number of bits in the field (1...64)
+	@param value	The value to write
+ */
+void Greenpak4Bitstream::SetField(unsigned int start, unsigned int width, uint64_t value)
+{
+	uint64_t mask = (width < 64) ? ((1ULL << width) - 1) : ~0ULL;
+	value &= mask;
+
+	unsigned int word = start / 64;
+	unsigned int shift = start % 64;
+
+	m_words[word] = (m_words[word] & ~(mask << shift)) | (value << shift);
+	if(shift + width > 64)
+	{
+		unsigned int rshift = 64 - shift;
+		m_words[word + 1] = (m_words[word + 1] & ~(mask >> rshift)) | (value >> rshift);
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Raw image conversion
+
+/**
+	@brief Gets the bitstream as the byte image the device (and the dev board) uses
+ */
+void Greenpak4Bitstream::GetBytes(vector<uint8_t>& bytes) const
+{
+	unsigned int len = (m_bitlen + 7) / 8;
+	bytes.resize(len);
+	for(unsigned int i=0; i<len; i++)
+		bytes[i] = m_words[i / 8] >> (8 * (i % 8));
+}
+
+/**
+	@brief Replaces the bitstream with a byte image. Bytes past the end of the bitstream are ignored.
+ */
+void Greenpak4Bitstream::SetBytes(const uint8_t* bytes, unsigned int len)
+{
+	for(auto& w : m_words)
+		w = 0;
+
+	len = min(len, (m_bitlen + 7) / 8);
+	for(unsigned int i=0; i<len; i++)
+		m_words[i / 8] |= static_cast<uint64_t>(bytes[i]) << (8 * (i % 8));
+
+	//Keep the bits past the end zero, so comparisons work
+	if(m_bitlen % 64)
+		m_words.back() &= (1ULL << (m_bitlen % 64)) - 1;
+}
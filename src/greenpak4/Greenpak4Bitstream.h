@@ -0,0 +1,119 @@
+/***********************************************************************************************************************
+ * Copyright (C) 2016 Andrew Zonenberg and contributors                                                                *
+ *                                                                                                                     *
+ * This program is free software; you can redistribute it and/or modify it under the terms of the GNU Lesser General   *
+ * Public License as published by the Free Software Foundation; either version 2.1 of the License, or (at your option) *
+ * any later version.                                                                                                  *
+ *                                                                                                                     *
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied  *
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for     *
+ * more details.                                                                                                       *
+ *                                                                                                                     *
+ * You should have received a copy of the GNU Lesser General Public License along with this program; if not, you may   *
+ * find one here:                                                                                                      *
+ * https://www.gnu.org/licenses/old-licenses/lgpl-2.1.txt                                                              *
+ * or you may search the http://www.gnu.org website for the version 2.1 license, or you may write to the Free Software *
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA                                      *
+ **********************************************************************************************************************/
+
+
+#ifndef Greenpak4Bitstream_h
+#define Greenpak4Bitstream_h
+
+#include <cstdint>
+#include <vector>
+#include "Greenpak4BitstreamLayout.h"
+
+/**
+	@brief A device bitstream, packed 64 bits to a word
+
+	Bit N of the bitstream is bit (N % 64) of word (N / 64). Multi-bit fields are stored LSB first, so field bit i
+	lives at bitstream bit (start + i); this matches the bit ordering of every multi-bit value in the device.
+ */
+class Greenpak4Bitstream
+{
+public:
+	Greenpak4Bitstream(unsigned int bitlen);
+
+	/**
+		@brief Reference to a single bit, so entities can treat the bitstream like an array of bools
+	 */
+	class BitRef
+	{
+	public:
+		operator bool() const
+		{ return m_bitstream.GetBit(m_bit); }
+
+		BitRef& operator=(bool value)
+		{
+			m_bitstream.SetBit(m_bit, value);
+			return *this;
+		}
+
+		BitRef& operator=(const BitRef& rhs)
+		{ return (*this = static_cast<bool>(rhs)); }
+
+	protected:
+		friend class Greenpak4Bitstream;
+
+		BitRef(Greenpak4Bitstream& bitstream, unsigned int bit)
+		: m_bitstream(bitstream)
+		, m_bit(bit)
+		{}
+
+		Greenpak4Bitstream& m_bitstream;
+		unsigned int m_bit;
+	};
+
+	BitRef operator[](unsigned int bit)
+	{ return BitRef(*this, bit); }
+
+	bool operator[](unsigned int bit) const
+	{ return GetBit(bit); }
+
+	bool GetBit(unsigned int bit) const
+	{ return (m_words[bit / 64] >> (bit % 64)) & 1; }
+
+	void SetBit(unsigned int bit, bool value)
+	{
+		uint64_t mask = 1ULL << (bit % 64);
+		if(value)
+			m_words[bit / 64] |= mask;
+		else
+			m_words[bit / 64] &= ~mask;
+	}
+
+	uint64_t GetField(unsigned int start, unsigned int width) const;
+	void SetField(unsigned int start, unsigned int width, uint64_t value);
+
+	uint64_t GetField(const Greenpak4BitstreamField& field) const
+	{ return GetField(field.start, field.width); }
+
+	void SetField(const Greenpak4BitstreamField& field, uint64_t value)
+	{ SetField(field.start, field.width, value); }
+
+	//Raw device image, bit N in bit (N % 8) of byte (N / 8)
+	void GetBytes(std::vector<uint8_t>& bytes) const;
+	void SetBytes(const uint8_t* bytes, unsigned int len);
+
+	unsigned int GetLength() const
+	{ return m_bitlen; }
+
+	/**
+		@brief Gets the packed words (bits past the end of the bitstream in the last word are always zero)
+	 */
+	const std::vector<uint64_t>& GetWords() const
+	{ return m_words; }
+
+	bool operator==(const Greenpak4Bitstream& rhs) const
+	{ return (m_bitlen == rhs.m_bitlen) && (m_words == rhs.m_words); }
+
+	bool operator!=(const Greenpak4Bitstream& rhs) const
+	{ return !(*this == rhs); }
+
+protected:
+	unsigned int m_bitlen;
+	std::vector<uint64_t> m_words;
+};
+
+#endif
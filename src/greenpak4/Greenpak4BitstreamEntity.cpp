@@ -16,6 +16,7 @@
  * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA                                      *
  **********************************************************************************************************************/
 
+#include <algorithm>
 #include <log.h>
 #include <xbpar.h>
 #include <Greenpak4.h>
@@ -112,15 +113,84 @@ Greenpak4NetlistEntity* Greenpak4BitstreamEntity::GetNetlistEntity()
  */
 bool Greenpak4BitstreamEntity::IsGeneralFabricInput(string port) const
 {
-	auto ports = GetInputPorts();
-	for(auto p : ports)
+	for(auto id : m_inputPortIDs)
 	{
-		if(p == port)
+		if(PARGraph::GetPortName(id) == port)
 			return true;
 	}
 	return false;
 }
 
+/**
+	@brief Returns true if the given port is general fabric routing
+ */
+bool Greenpak4BitstreamEntity::IsGeneralFabricInput(uint16_t port) const
+{
+	return find(m_inputPortIDs.begin(), m_inputPortIDs.end(), port) != m_inputPortIDs.end();
+}
+
+/**
+	@brief Connects an input, given its port ID rather than its name
+ */
+void Greenpak4BitstreamEntity::SetInputByID(uint16_t port, Greenpak4EntityOutput src)
+{
+	SetInput(PARGraph::GetPortName(port), src);
+}
+
+/**
+	@brief Gets the net number for an output, given its port ID rather than its name
+ */
+Greenpak4EntityOutput Greenpak4BitstreamEntity::GetOutputByID(uint16_t port)
+{
+	return GetOutput(PARGraph::GetPortName(port));
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Port tables
+
+void Greenpak4BitstreamEntity::BuildPortTables()
+{
+	m_inputPortIDs.clear();
+	for(auto p : GetInputPorts())
+		m_inputPortIDs.push_back(PARGraph::InternPort(p));
+
+	m_outputPortIDs.clear();
+	for(auto p : GetOutputPorts())
+		m_outputPortIDs.push_back(PARGraph::InternPort(p));
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Timing model
+
+/**
+	@brief Returns the typical delay, in ps, from any of our inputs (or from the clock, if we're sequential) to any of
+	our outputs if the given netlist entity were placed on us.
+
+	The placer asks about hypothetical placements, so this must not depend on what is currently assigned to us.
+	Default is zero, for things that aren't on any meaningful timing path (analog blocks, oscillators etc).
+ */
+unsigned int Greenpak4BitstreamEntity::GetPropagationDelay(Greenpak4NetlistEntity* /*entity*/)
+{
+	return 0;
+}
+
+/**
+	@brief Returns true if our outputs only change on a clock edge when the given netlist entity is placed on us, so
+	timing paths end at our inputs and start over at our outputs.
+ */
+bool Greenpak4BitstreamEntity::IsSequential(Greenpak4NetlistEntity* /*entity*/)
+{
+	return false;
+}
+
+/**
+	@brief Returns true if the given input port is a clock (which is not part of any data path)
+ */
+bool Greenpak4BitstreamEntity::IsClockInput(string port) const
+{
+	return (port == "CLK") || (port == "nCLK");
+}
+
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 // Debug log helpers
 
@@ -162,7 +232,7 @@ Greenpak4BitstreamEntity* Greenpak4BitstreamEntity::GetRealEntity()
 }
 
 bool Greenpak4BitstreamEntity::WriteMatrixSelector(
-	bool* bitstream,
+	Greenpak4Bitstream& bitstream,
 	unsigned int wordpos,
 	Greenpak4EntityOutput signal,
 	bool cross_matrix)
@@ -207,20 +277,34 @@ bool Greenpak4BitstreamEntity::WriteMatrixSelector(
 	unsigned int sel = signal.GetNetNumber();
 
 	//Calculate right matrix for cross connections etc
-	unsigned int matrix = m_matrix;
-	if(cross_matrix)
-		matrix = 1 - matrix;
+	unsigned int matrix = GetInputMatrix();
 
 	unsigned int nbits = m_device->GetMatrixBits();
 	unsigned int startbit = m_device->GetMatrixBase(matrix) + wordpos * nbits;
 
-	//Need to flip bit ordering since lowest array index is the MSB
-	for(unsigned int i=0; i<nbits; i++)
+	//Selectors are stored LSB first, like every other field
+	bitstream.SetField(startbit, nbits, sel);
+
+	return true;
+}
+
+bool Greenpak4BitstreamEntity::ReadMatrixSelector(
+	Greenpak4Bitstream& bitstream,
+	unsigned int wordpos,
+	Greenpak4EntityOutput& signal)
+{
+	//Same addressing as WriteMatrixSelector()
+	unsigned int matrix = GetInputMatrix();
+	unsigned int nbits = m_device->GetMatrixBits();
+	unsigned int startbit = m_device->GetMatrixBase(matrix) + wordpos * nbits;
+	unsigned int sel = bitstream.GetField(startbit, nbits);
+
+	signal = m_device->GetNetByNumber(matrix, sel);
+	if(signal.m_src == NULL)
 	{
-		if( (sel >> i) & 1 )
-			bitstream[startbit + i] = true;
-		else
-			bitstream[startbit + i] = false;
+		LogError("%s: input selects net %u of matrix %u, which nothing drives\n",
+			GetDescription().c_str(), sel, matrix);
+		return false;
 	}
 
 	return true;
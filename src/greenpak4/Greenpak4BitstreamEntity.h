@@ -48,10 +48,10 @@ public:
 	//TODO: Print for debugging
 
 	///Deserialize from an external bitstream
-	virtual bool Load(bool* bitstream) =0;
+	virtual bool Load(Greenpak4Bitstream& bitstream) =0;
 
 	///Serialize to an external bitstream
-	virtual bool Save(bool* bitstream) =0;
+	virtual bool Save(Greenpak4Bitstream& bitstream) =0;
 
 	/**
 		@brief Returns the index of the routing matrix our OUTPUT is attached to
@@ -59,6 +59,14 @@ public:
 	unsigned int GetMatrix()
 	{ return m_matrix; }
 
+	/**
+		@brief Returns the index of the routing matrix our INPUT selectors are in
+
+		This is the same as GetMatrix() for everything but cross connections.
+	 */
+	virtual unsigned int GetInputMatrix()
+	{ return m_matrix; }
+
 	/**
 		@brief Sets the input with the given name to the specified net
 	 */
@@ -126,10 +134,36 @@ public:
 	//Commit changes from the assigned PAR graph node to us
 	virtual bool CommitChanges() =0;
 
+	/**
+		@brief Caches GetInputPorts() and GetOutputPorts() as port IDs (the IDs interned by PARGraph)
+
+		The port lists only depend on how the entity was constructed, so the device does this for every entity once
+		it's done creating them. Past netlist binding, everything should use the IDs rather than the names.
+	 */
+	void BuildPortTables();
+
+	const std::vector<uint16_t>& GetInputPortIDs() const
+	{ return m_inputPortIDs; }
+
+	const std::vector<uint16_t>& GetOutputPortIDs() const
+	{ return m_outputPortIDs; }
+
 	bool IsGeneralFabricInput(std::string port) const;
+	bool IsGeneralFabricInput(uint16_t port) const;
+
+	void SetInputByID(uint16_t port, Greenpak4EntityOutput src);
+	Greenpak4EntityOutput GetOutputByID(uint16_t port);
 
 	bool HasLoadsOnPort(std::string port);
 
+	//Timing model (typical delays in ps, good enough to compare placements but not for signoff)
+	virtual unsigned int GetPropagationDelay(Greenpak4NetlistEntity* entity);
+	virtual bool IsSequential(Greenpak4NetlistEntity* entity);
+	virtual bool IsClockInput(std::string port) const;
+
+	bool IsClockInput(uint16_t port) const
+	{ return IsClockInput(PARGraph::GetPortName(port)); }
+
 protected:
 
 	///Return our assigned netlist entity, if we have one (or NULL if not)
@@ -141,11 +175,19 @@ protected:
 		Set cross_matrix for cross connections only
 	 */
 	bool WriteMatrixSelector(
-		bool* bitstream,
+		Greenpak4Bitstream& bitstream,
 		unsigned int wordpos,
 		Greenpak4EntityOutput signal,
 		bool cross_matrix = false);
 
+	/**
+		@brief Reads a matrix select value back from the bitstream, and looks up the signal driving that net
+	 */
+	bool ReadMatrixSelector(
+		Greenpak4Bitstream& bitstream,
+		unsigned int wordpos,
+		Greenpak4EntityOutput& signal);
+
 	///The device we're attached to
 	Greenpak4Device* m_device;
 
@@ -171,6 +213,10 @@ protected:
 	///The graph node used for place-and-route
 	PARGraphNode* m_parnode;
 
+	//Port IDs of GetInputPorts() and GetOutputPorts(), in the same order (see BuildPortTables())
+	std::vector<uint16_t> m_inputPortIDs;
+	std::vector<uint16_t> m_outputPortIDs;
+
 	///Our dual entity (if we have one). Dual points back to us.
 	Greenpak4BitstreamEntity* m_dual;
 
@@ -0,0 +1,72 @@
+/***********************************************************************************************************************
+ * Copyright (C) 2016 Andrew Zonenberg and contributors                                                                *
+ *                                                                                                                     *
+ * This program is free software; you can redistribute it and/or modify it under the terms of the GNU Lesser General   *
+ * Public License as published by the Free Software Foundation; either version 2.1 of the License, or (at your option) *
+ * any later version.                                                                                                  *
+ *                                                                                                                     *
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied  *
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for     *
+ * more details.                                                                                                       *
+ *                                                                                                                     *
+ * You should have received a copy of the GNU Lesser General Public License along with this program; if not, you may   *
+ * find one here:                                                                                                      *
+ * https://www.gnu.org/licenses/old-licenses/lgpl-2.1.txt                                                              *
+ * or you may search the http://www.gnu.org website for the version 2.1 license, or you may write to the Free Software *
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA                                      *
+ **********************************************************************************************************************/
+
+#include "Greenpak4BitstreamLayout.h"
+
+using namespace std;
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Tables
+
+const Greenpak4BitstreamLayout& Greenpak4BitstreamLayout::ForSLG4662X()
+{
+	static const Greenpak4BitstreamLayout layout(SLG4662X_FIELDS, SLG4662X_BITLEN);
+	return layout;
+}
+
+const Greenpak4BitstreamLayout& Greenpak4BitstreamLayout::ForSLG46140()
+{
+	static const Greenpak4BitstreamLayout layout(SLG46140_FIELDS, SLG46140_BITLEN);
+	return layout;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Field access on raw device images
+
+/**
+	@brief Reads a field from a raw device image (bit N in bit (N % 8) of byte (N / 8))
+ */
+uint64_t Greenpak4BitstreamLayout::GetField(const vector<uint8_t>& bytes, const Greenpak4BitstreamField& field)
+{
+	uint64_t value = 0;
+	for(unsigned int i=0; i<field.width; i++)
+	{
+		unsigned int bit = field.start + i;
+		if( (bit / 8 < bytes.size()) && ((bytes[bit / 8] >> (bit % 8)) & 1) )
+			value |= 1ULL << i;
+	}
+	return value;
+}
+
+/**
+	@brief Writes a field into a raw device image, leaving every other bit alone
+ */
+void Greenpak4BitstreamLayout::SetField(vector<uint8_t>& bytes, const Greenpak4BitstreamField& field, uint64_t value)
+{
+	for(unsigned int i=0; i<field.width; i++)
+	{
+		unsigned int bit = field.start + i;
+		if(bit / 8 >= bytes.size())
+			break;
+		uint8_t mask = 1 << (bit % 8);
+		if((value >> i) & 1)
+			bytes[bit / 8] |= mask;
+		else
+			bytes[bit / 8] &= ~mask;
+	}
+}
@@ -0,0 +1,227 @@
+/***********************************************************************************************************************
+ * Copyright (C) 2016 Andrew Zonenberg and contributors                                                                *
+ *                                                                                                                     *
+ * This program is free software; you can redistribute it and/or modify it under the terms of the GNU Lesser General   *
+ * Public License as published by the Free Software Foundation; either version 2.1 of the License, or (at your option) *
+ * any later version.                                                                                                  *
+ *                                                                                                                     *
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied  *
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for     *
+ * more details.                                                                                                       *
+ *                                                                                                                     *
+ * You should have received a copy of the GNU Lesser General Public License along with this program; if not, you may   *
+ * find one here:                                                                                                      *
+ * https://www.gnu.org/licenses/old-licenses/lgpl-2.1.txt                                                              *
+ * or you may search the http://www.gnu.org website for the version 2.1 license, or you may write to the Free Software *
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA                                      *
+ **********************************************************************************************************************/
+
+#ifndef Greenpak4BitstreamLayout_h
+#define Greenpak4BitstreamLayout_h
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/**
+	@brief A chip-wide bitstream field: a run of bits, LSB first, that isn't part of any one entity's configuration
+
+	Entities find their own bits from the base addresses they're constructed with. Everything else the bitstream
+	writer sets, gp4prog patches or the programmer has to explain lives in the tables below.
+ */
+struct Greenpak4BitstreamField
+{
+	///Bitstream index of the LSB
+	unsigned int start;
+
+	///Number of bits
+	unsigned int width;
+
+	///Block the datasheet lists the field under
+	const char* owner;
+
+	///What the field does, or NULL if the datasheet has it reserved
+	const char* description;
+
+	constexpr unsigned int End() const
+	{ return start + width; }
+};
+
+/**
+	@brief Checks at compile time that a table is in order and no two fields share a bit
+ */
+constexpr bool Greenpak4FieldsDisjoint(const Greenpak4BitstreamField* fields, size_t count, unsigned int bitlen)
+{
+	return (count == 0) ||
+		( (fields[0].width > 0) &&
+		  ( (count == 1) ? (fields[0].End() <= bitlen) : (fields[0].End() <= fields[1].start) ) &&
+		  Greenpak4FieldsDisjoint(fields + 1, count - 1, bitlen) );
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// SLG46620V / SLG46621V
+
+constexpr unsigned int SLG4662X_BITLEN = 2048;
+
+constexpr Greenpak4BitstreamField SLG4662X_ADC_DISABLE			= { 486,  6, "ADC", "ADC disable" };
+constexpr Greenpak4BitstreamField SLG4662X_ACMP5_SPEED			= { 833,  1, "ACMP5", "ACMP5 speed double" };
+constexpr Greenpak4BitstreamField SLG4662X_ACMP4_SPEED			= { 835,  1, "ACMP4", "ACMP4 speed double" };
+constexpr Greenpak4BitstreamField SLG4662X_ADC_SPEED			= { 838,  2, "ADC", "ADC speed" };
+constexpr Greenpak4BitstreamField SLG4662X_VREF_FINE_TUNE		= { 887,  5, "Vref", "Vref value fine tune" };
+constexpr Greenpak4BitstreamField SLG4662X_BANDGAP_BUFFER		= { 922,  1, "Bandgap", "bandgap 1x buffer enable" };
+constexpr Greenpak4BitstreamField SLG4662X_VREF_CHOPPER_FREQ	= { 937,  1, "Vref",
+	"Vref op amp chopper frequency select" };
+constexpr Greenpak4BitstreamField SLG4662X_BANDGAP_CHOPPER		= { 938,  1, "Bandgap",
+	"bandgap op amp offset chopper enable" };
+constexpr Greenpak4BitstreamField SLG4662X_VREF_CHOPPER		= { 939,  1, "Vref",
+	"Vref op amp offset chopper enable" };
+constexpr Greenpak4BitstreamField SLG4662X_IO_PRECHARGE		= { 940,  1, "IOB", "I/O precharge" };
+constexpr Greenpak4BitstreamField SLG4662X_DEVICE_ID			= { 1016, 8, "NVM", "device ID (0x5a)" };
+constexpr Greenpak4BitstreamField SLG4662X_OSC_TRIM			= { 1975, 7, "RC oscillator",
+	"RC oscillator trimming value" };
+constexpr Greenpak4BitstreamField SLG4662X_LDO_BYPASS			= { 2008, 1, "Power", "internal LDO disable" };
+constexpr Greenpak4BitstreamField SLG4662X_CHARGE_PUMP_DISABLE	= { 2010, 1, "Power", "charge pump disable" };
+constexpr Greenpak4BitstreamField SLG4662X_PATTERN_ID			= { 2031, 8, "NVM", "pattern ID" };
+constexpr Greenpak4BitstreamField SLG4662X_READ_PROTECT		= { 2039, 1, "NVM", "read protection" };
+constexpr Greenpak4BitstreamField SLG4662X_END_MARKER			= { 2040, 8, "NVM", "end of bitstream (0xa5)" };
+
+//Programmed at the factory and different in every part (overlaps the oscillator trim, so it isn't in the table)
+constexpr Greenpak4BitstreamField SLG4662X_FACTORY_TRIM		= { 1976, 16, "NVM", "factory trim" };
+
+//Every chip-wide field, in bitstream order. Reserved runs are grouped the way the datasheet groups them.
+constexpr Greenpak4BitstreamField SLG4662X_FIELDS[] =
+{
+	SLG4662X_ADC_DISABLE,
+	{ 570,  6, "Reserved", NULL },
+	SLG4662X_ACMP5_SPEED,
+	SLG4662X_ACMP4_SPEED,
+	SLG4662X_ADC_SPEED,
+	{ 881,  1, "Reserved", NULL },
+	SLG4662X_VREF_FINE_TUNE,
+	SLG4662X_BANDGAP_BUFFER,
+	SLG4662X_VREF_CHOPPER_FREQ,
+	SLG4662X_BANDGAP_CHOPPER,
+	SLG4662X_VREF_CHOPPER,
+	SLG4662X_IO_PRECHARGE,
+	{ 1003, 13, "Reserved", NULL },
+	SLG4662X_DEVICE_ID,
+	{ 1594, 6, "Reserved", NULL },
+	SLG4662X_OSC_TRIM,
+	{ 1982, 6, "Reserved", NULL },
+	{ 1988, 8, "Reserved", NULL },
+	{ 1996, 6, "Reserved", NULL },
+	{ 2002, 6, "Reserved", NULL },
+	SLG4662X_LDO_BYPASS,
+	SLG4662X_CHARGE_PUMP_DISABLE,
+	{ 2013, 2, "Reserved", NULL },
+	{ 2021, 7, "Reserved", NULL },
+	{ 2028, 2, "Reserved", NULL },
+	{ 2030, 1, "Reserved", NULL },
+	SLG4662X_PATTERN_ID,
+	SLG4662X_READ_PROTECT,
+	SLG4662X_END_MARKER
+};
+
+static_assert(
+	Greenpak4FieldsDisjoint(SLG4662X_FIELDS, sizeof(SLG4662X_FIELDS) / sizeof(SLG4662X_FIELDS[0]), SLG4662X_BITLEN),
+	"SLG4662x bitstream fields overlap");
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// SLG46140V
+
+constexpr unsigned int SLG46140_BITLEN = 1024;
+
+//Bit 382 has always been left clear, in the middle of this field; nobody knows why
+constexpr Greenpak4BitstreamField SLG46140_ADC_DISABLE			= { 378,  6, "ADC", "ADC disable" };
+constexpr Greenpak4BitstreamField SLG46140_VREF_FINE_TUNE		= { 491,  5, "Vref", "Vref value fine tune" };
+constexpr Greenpak4BitstreamField SLG46140_ADC_SPEED			= { 542,  2, "ADC", "ADC speed" };
+constexpr Greenpak4BitstreamField SLG46140_IO_PRECHARGE		= { 760,  1, "IOB", "I/O precharge" };
+constexpr Greenpak4BitstreamField SLG46140_FACTORY_TRIM		= { 952, 16, "NVM", "factory trim" };
+constexpr Greenpak4BitstreamField SLG46140_DEVICE_ID			= { 984,  8, "NVM", "device ID (0x5a)" };
+constexpr Greenpak4BitstreamField SLG46140_NVM_RETRY			= { 994,  2, "NVM", "NVM boot retry count, minus one" };
+constexpr Greenpak4BitstreamField SLG46140_LDO_BYPASS			= { 1003, 1, "Power", "internal LDO disable" };
+constexpr Greenpak4BitstreamField SLG46140_CHARGE_PUMP_DISABLE	= { 1005, 1, "Power", "charge pump disable" };
+constexpr Greenpak4BitstreamField SLG46140_PATTERN_ID			= { 1007, 8, "NVM", "pattern ID" };
+constexpr Greenpak4BitstreamField SLG46140_END_MARKER			= { 1016, 8, "NVM", "end of bitstream (0xa5)" };
+
+//Every chip-wide field, in bitstream order
+constexpr Greenpak4BitstreamField SLG46140_FIELDS[] =
+{
+	SLG46140_ADC_DISABLE,
+	SLG46140_VREF_FINE_TUNE,
+	SLG46140_ADC_SPEED,
+	SLG46140_IO_PRECHARGE,
+	SLG46140_FACTORY_TRIM,
+	SLG46140_DEVICE_ID,
+	SLG46140_NVM_RETRY,
+	SLG46140_LDO_BYPASS,
+	SLG46140_CHARGE_PUMP_DISABLE,
+	SLG46140_PATTERN_ID,
+	SLG46140_END_MARKER
+};
+
+static_assert(
+	Greenpak4FieldsDisjoint(SLG46140_FIELDS, sizeof(SLG46140_FIELDS) / sizeof(SLG46140_FIELDS[0]), SLG46140_BITLEN),
+	"SLG46140 bitstream fields overlap");
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Lookup
+
+/**
+	@brief One part's table of chip-wide fields, indexed by bit
+ */
+class Greenpak4BitstreamLayout
+{
+public:
+	template<size_t N>
+	Greenpak4BitstreamLayout(const Greenpak4BitstreamField (&fields)[N], unsigned int bitlen)
+		: m_fields(fields)
+		, m_count(N)
+		, m_fieldAt(bitlen, NO_FIELD)
+	{
+		for(size_t i=0; i<N; i++)
+		{
+			for(unsigned int bit = fields[i].start; bit < fields[i].End(); bit++)
+				m_fieldAt[bit] = i;
+		}
+	}
+
+	static const Greenpak4BitstreamLayout& ForSLG4662X();
+	static const Greenpak4BitstreamLayout& ForSLG46140();
+
+	/**
+		@brief Gets the field a bit belongs to, or NULL if it belongs to an entity (or to nothing we know of)
+	 */
+	const Greenpak4BitstreamField* GetFieldAt(unsigned int bit) const
+	{
+		if( (bit >= m_fieldAt.size()) || (m_fieldAt[bit] == NO_FIELD) )
+			return NULL;
+		return &m_fields[m_fieldAt[bit]];
+	}
+
+	const Greenpak4BitstreamField* GetFields() const
+	{ return m_fields; }
+
+	size_t GetFieldCount() const
+	{ return m_count; }
+
+	unsigned int GetLength() const
+	{ return m_fieldAt.size(); }
+
+	static uint64_t GetField(const std::vector<uint8_t>& bytes, const Greenpak4BitstreamField& field);
+	static void SetField(std::vector<uint8_t>& bytes, const Greenpak4BitstreamField& field, uint64_t value);
+
+protected:
+	enum
+	{
+		NO_FIELD = 0xffff
+	};
+
+	const Greenpak4BitstreamField* m_fields;
+	size_t m_count;
+
+	///Index into m_fields of the field each bit belongs to, or NO_FIELD
+	std::vector<uint16_t> m_fieldAt;
+};
+
+#endif
@@ -0,0 +1,283 @@
+/***********************************************************************************************************************
+ * Copyright (C) 2016 Andrew Zonenberg and contributors                                                                *
+ *                                                                                                                     *
+ * This program is free software; you can redistribute it and/or modify it under the terms of the GNU Lesser General   *
+ * Public License as published by the Free Software Foundation; either version 2.1 of the License, or (at your option) *
+ * any later version.                                                                                                  *
+ *                                                                                                                     *
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied  *
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for     *
+ * more details.                                                                                                       *
+ *                                                                                                                     *
+ * You should have received a copy of the GNU Lesser General Public License along with this program; if not, you may   *
+ * find one here:                                                                                                      *
+ * https://www.gnu.org/licenses/old-licenses/lgpl-2.1.txt                                                              *
+ * or you may search the http://www.gnu.org website for the version 2.1 license, or you may write to the Free Software *
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA                                      *
+ **********************************************************************************************************************/
+
+#include <log.h>
+#include <cstring>
+#include "Greenpak4.h"
+
+using namespace std;
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Construction
+
+Greenpak4BitstreamTemplate::Greenpak4BitstreamTemplate()
+	: m_part(Greenpak4Device::GREENPAK4_SLG46620)
+	, m_image(0)
+	, m_fixedHash(0)
+{
+}
+
+/**
+	@brief Gets the fields that can be stamped on a part, in bitstream order
+ */
+vector<Greenpak4BitstreamTemplate::VariableField> Greenpak4BitstreamTemplate::GetVariableFields(
+	Greenpak4Device::GREENPAK4_PART part)
+{
+	vector<VariableField> fields;
+	switch(part)
+	{
+		case Greenpak4Device::GREENPAK4_SLG46620:
+		case Greenpak4Device::GREENPAK4_SLG46621:
+			fields.push_back(VariableField(ROLE_RC_TRIM, SLG4662X_OSC_TRIM));
+			fields.push_back(VariableField(ROLE_USERID, SLG4662X_PATTERN_ID));
+			fields.push_back(VariableField(ROLE_READ_PROTECT, SLG4662X_READ_PROTECT));
+			break;
+
+		//No read protection or trim in the bitstream
+		case Greenpak4Device::GREENPAK4_SLG46140:
+			fields.push_back(VariableField(ROLE_USERID, SLG46140_PATTERN_ID));
+			break;
+
+		default:
+			break;
+	}
+	return fields;
+}
+
+/**
+	@brief Makes a template out of a finished bitstream, by clearing its variable fields
+ */
+bool Greenpak4BitstreamTemplate::Capture(Greenpak4Device::GREENPAK4_PART part, const Greenpak4Bitstream& bitstream)
+{
+	m_part = part;
+	m_fields = GetVariableFields(part);
+	if(m_fields.empty())
+	{
+		LogError("Greenpak4BitstreamTemplate: unknown device\n");
+		return false;
+	}
+
+	m_image = bitstream;
+	for(auto& f : m_fields)
+		m_image.SetField(f.m_field, 0);
+
+	Greenpak4Bitstream mask(m_image.GetLength());
+	for(auto& f : m_fields)
+		mask.SetField(f.m_field, ~0ULL);
+	m_fixedMask = mask.GetWords();
+	for(auto& w : m_fixedMask)
+		w = ~w;
+
+	m_fixedHash = HashFixedBits(m_image);
+	return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Serialization
+
+void Greenpak4BitstreamTemplate::Serialize(string& data) const
+{
+	vector<uint8_t> image;
+	m_image.GetBytes(image);
+	uint16_t part = Greenpak4Device::GetPartCode(m_part);
+	uint16_t len = image.size();
+
+	uint8_t header[16] =
+	{
+		'G', 'P', '4', 'T',
+		1,
+		static_cast<uint8_t>(m_fields.size()),
+		static_cast<uint8_t>(part & 0xff), static_cast<uint8_t>(part >> 8),
+		static_cast<uint8_t>(len & 0xff), static_cast<uint8_t>(len >> 8),
+		0, 0,
+		static_cast<uint8_t>(m_fixedHash & 0xff), static_cast<uint8_t>(m_fixedHash >> 8),
+		static_cast<uint8_t>(m_fixedHash >> 16), static_cast<uint8_t>(m_fixedHash >> 24)
+	};
+
+	data.assign(reinterpret_cast<const char*>(header), sizeof(header));
+	for(auto& f : m_fields)
+	{
+		data += static_cast<char>(f.m_field.start & 0xff);
+		data += static_cast<char>(f.m_field.start >> 8);
+		data += static_cast<char>(f.m_field.width);
+		data += static_cast<char>(f.m_role);
+	}
+	data.append(reinterpret_cast<const char*>(&image[0]), len);
+}
+
+/**
+	@brief Reads a template back, checking it against this build's idea of where the variable fields are
+ */
+bool Greenpak4BitstreamTemplate::Parse(const string& data, string fname)
+{
+	const uint8_t* p = reinterpret_cast<const uint8_t*>(data.c_str());
+	if( (data.size() < 16) || memcmp(p, "GP4T", 4) )
+	{
+		LogError("%s is not a bitstream template\n", fname.c_str());
+		return false;
+	}
+	if(p[4] != 1)
+	{
+		LogError("%s: unsupported bitstream template version %d\n", fname.c_str(), p[4]);
+		return false;
+	}
+
+	Greenpak4Device::GREENPAK4_PART part;
+	uint16_t code = p[6] | (p[7] << 8);
+	if(!Greenpak4Device::GetPartFromCode(code, part))
+	{
+		LogError("%s: unknown part code %x\n", fname.c_str(), code);
+		return false;
+	}
+
+	//A template from a build that puts the fields somewhere else can't be stamped safely
+	unsigned int nfields = p[5];
+	vector<VariableField> fields = GetVariableFields(part);
+	bool match = (nfields == fields.size()) && (data.size() >= 16 + 4*nfields);
+	for(unsigned int i=0; match && (i<nfields); i++)
+	{
+		const uint8_t* f = p + 16 + 4*i;
+		match =
+			( static_cast<unsigned int>(f[0] | (f[1] << 8)) == fields[i].m_field.start ) &&
+			( f[2] == fields[i].m_field.width ) &&
+			( f[3] == fields[i].m_role );
+	}
+	if(!match)
+	{
+		LogError("%s: variable fields don't match this version's bitstream layout\n", fname.c_str());
+		return false;
+	}
+
+	unsigned int bitlen = ( (part == Greenpak4Device::GREENPAK4_SLG46140) ?
+		Greenpak4BitstreamLayout::ForSLG46140() : Greenpak4BitstreamLayout::ForSLG4662X() ).GetLength();
+	unsigned int len = p[8] | (p[9] << 8);
+	unsigned int offset = 16 + 4*nfields;
+	if( (len != (bitlen + 7) / 8) || (data.size() != offset + len) )
+	{
+		LogError("%s: image is %u bytes, expected %u\n", fname.c_str(), len, (bitlen + 7) / 8);
+		return false;
+	}
+
+	Greenpak4Bitstream image(bitlen);
+	image.SetBytes(p + offset, len);
+	if(!Capture(part, image))
+		return false;
+	if(m_image != image)
+	{
+		LogError("%s: variable fields aren't blank\n", fname.c_str());
+		return false;
+	}
+
+	uint32_t hash = p[12] | (p[13] << 8) | (p[14] << 16) | (static_cast<uint32_t>(p[15]) << 24);
+	if(hash != m_fixedHash)
+	{
+		LogError("%s: bitstream template is corrupted (hash mismatch)\n", fname.c_str());
+		return false;
+	}
+
+	return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Stamping
+
+/**
+	@brief Fills in the variable fields of a copy of the template
+
+	@param bitstream	Set to the stamped image
+	@param userid		ID code for the "user ID" area of the bitstream
+	@param readProtect	True to disable readout of the design
+	@param trim			RC oscillator trim code, or -1 to leave it zero for gp4prog to fill in at download time
+ */
+bool Greenpak4BitstreamTemplate::Stamp(Greenpak4Bitstream& bitstream, uint8_t userid, bool readProtect, int trim) const
+{
+	if(m_fields.empty())
+	{
+		LogError("Greenpak4BitstreamTemplate: nothing to stamp (template wasn't captured or parsed)\n");
+		return false;
+	}
+
+	auto rp = GetField(ROLE_READ_PROTECT);
+	if(readProtect && !rp)
+		LogWarning("Read protection isn't supported on this part, ignoring it\n");
+
+	auto rctrim = GetField(ROLE_RC_TRIM);
+	if( (trim >= 0) && !rctrim )
+	{
+		LogError("RC oscillator trim isn't in the bitstream on this part\n");
+		return false;
+	}
+	if( (trim >= 0) && (static_cast<unsigned int>(trim) >= (1u << rctrim->m_field.width)) )
+	{
+		LogError("RC oscillator trim must be 0...%u\n", (1u << rctrim->m_field.width) - 1);
+		return false;
+	}
+
+	bitstream = m_image;
+	bitstream.SetField(GetField(ROLE_USERID)->m_field, userid);
+	if(rp)
+		bitstream.SetField(rp->m_field, readProtect);
+	if(trim >= 0)
+		bitstream.SetField(rctrim->m_field, trim);
+
+	//Make sure nothing else moved, first bit by bit and then against the hash stored with the template
+	auto& words = bitstream.GetWords();
+	auto& original = m_image.GetWords();
+	for(size_t i=0; i<words.size(); i++)
+	{
+		if( (words[i] ^ original[i]) & m_fixedMask[i] )
+		{
+			LogError("Stamping changed bits outside the variable fields (word %zu)\n", i);
+			return false;
+		}
+	}
+	if(HashFixedBits(bitstream) != m_fixedHash)
+	{
+		LogError("Stamped bitstream doesn't match the template's hash\n");
+		return false;
+	}
+
+	return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Helpers
+
+const Greenpak4BitstreamTemplate::VariableField* Greenpak4BitstreamTemplate::GetField(FieldRole role) const
+{
+	for(auto& f : m_fields)
+	{
+		if(f.m_role == role)
+			return &f;
+	}
+	return NULL;
+}
+
+/**
+	@brief Hashes a bitstream with its variable fields masked off
+ */
+uint32_t Greenpak4BitstreamTemplate::HashFixedBits(const Greenpak4Bitstream& bitstream) const
+{
+	Greenpak4Bitstream fixed(bitstream);
+	for(auto& f : m_fields)
+		fixed.SetField(f.m_field, 0);
+
+	vector<uint8_t> image;
+	fixed.GetBytes(image);
+	return Greenpak4Device::HashBitstreamImage(&image[0], image.size());
+}
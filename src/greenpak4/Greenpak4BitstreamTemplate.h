@@ -0,0 +1,92 @@
+/***********************************************************************************************************************
+ * Copyright (C) 2016 Andrew Zonenberg and contributors                                                                *
+ *                                                                                                                     *
+ * This program is free software; you can redistribute it and/or modify it under the terms of the GNU Lesser General   *
+ * Public License as published by the Free Software Foundation; either version 2.1 of the License, or (at your option) *
+ * any later version.                                                                                                  *
+ *                                                                                                                     *
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied  *
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for     *
+ * more details.                                                                                                       *
+ *                                                                                                                     *
+ * You should have received a copy of the GNU Lesser General Public License along with this program; if not, you may   *
+ * find one here:                                                                                                      *
+ * https://www.gnu.org/licenses/old-licenses/lgpl-2.1.txt                                                              *
+ * or you may search the http://www.gnu.org website for the version 2.1 license, or you may write to the Free Software *
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA                                      *
+ **********************************************************************************************************************/
+
+#ifndef Greenpak4BitstreamTemplate_h
+#define Greenpak4BitstreamTemplate_h
+
+#include <string>
+#include <vector>
+
+/**
+	@brief A compiled bitstream with the fields that vary from unit to unit left blank
+
+	gp4par --write-template saves one of these after PAR, and --stamp fills in the user ID, read protection and RC
+	oscillator trim to make each unit's bitstream without going anywhere near PAR. Nothing else can change: the rest
+	of the image is covered by a hash, which is checked when the template is read and again on every stamped image.
+
+	File layout (all integers little endian):
+		"GP4T", u8 format version (currently 1), u8 variable field count, u16 part code, u16 image length in bytes,
+			u16 reserved, u32 HashBitstreamImage() of the image
+		for each variable field: u16 start bit, u8 width, u8 role
+		the image, with every variable field zero
+ */
+class Greenpak4BitstreamTemplate
+{
+public:
+	Greenpak4BitstreamTemplate();
+
+	///What each variable field is
+	enum FieldRole
+	{
+		ROLE_USERID			= 1,
+		ROLE_READ_PROTECT	= 2,
+		ROLE_RC_TRIM		= 3
+	};
+
+	bool Capture(Greenpak4Device::GREENPAK4_PART part, const Greenpak4Bitstream& bitstream);
+	void Serialize(std::string& data) const;
+	bool Parse(const std::string& data, std::string fname);
+
+	bool Stamp(Greenpak4Bitstream& bitstream, uint8_t userid, bool readProtect, int trim = -1) const;
+
+	Greenpak4Device::GREENPAK4_PART GetPart() const
+	{ return m_part; }
+
+protected:
+
+	class VariableField
+	{
+	public:
+		VariableField(FieldRole role, const Greenpak4BitstreamField& field)
+		: m_role(role)
+		, m_field(field)
+		{}
+
+		FieldRole m_role;
+		Greenpak4BitstreamField m_field;
+	};
+
+	static std::vector<VariableField> GetVariableFields(Greenpak4Device::GREENPAK4_PART part);
+	uint32_t HashFixedBits(const Greenpak4Bitstream& bitstream) const;
+	const VariableField* GetField(FieldRole role) const;
+
+	Greenpak4Device::GREENPAK4_PART m_part;
+
+	///The bitstream, with the variable fields cleared
+	Greenpak4Bitstream m_image;
+
+	std::vector<VariableField> m_fields;
+
+	///Bits outside the variable fields, packed like Greenpak4Bitstream::GetWords()
+	std::vector<uint64_t> m_fixedMask;
+
+	///Hash of m_image, which is the same as the hash of the fixed bits of any correctly stamped image
+	uint32_t m_fixedHash;
+};
+
+#endif
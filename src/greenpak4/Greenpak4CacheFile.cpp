@@ -0,0 +1,122 @@
+/***********************************************************************************************************************
+ * Copyright (C) 2016 Andrew Zonenberg and contributors                                                                *
+ *                                                                                                                     *
+ * This program is free software; you can redistribute it and/or modify it under the terms of the GNU Lesser General   *
+ * Public License as published by the Free Software Foundation; either version 2.1 of the License, or (at your option) *
+ * any later version.                                                                                                  *
+ *                                                                                                                     *
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied  *
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for     *
+ * more details.                                                                                                       *
+ *                                                                                                                     *
+ * You should have received a copy of the GNU Lesser General Public License along with this program; if not, you may   *
+ * find one here:                                                                                                      *
+ * https://www.gnu.org/licenses/old-licenses/lgpl-2.1.txt                                                              *
+ * or you may search the http://www.gnu.org website for the version 2.1 license, or you may write to the Free Software *
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA                                      *
+ **********************************************************************************************************************/
+
+#include <atomic>
+#include <cstring>
+#include <unistd.h>
+#include <log.h>
+#include <Greenpak4.h>
+
+using namespace std;
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Serialization
+
+void CacheWriteU32(vector<uint8_t>& buf, uint32_t value)
+{
+	for(int i=0; i<4; i++)
+		buf.push_back(value >> (8*i));
+}
+
+void CacheWriteU64(vector<uint8_t>& buf, uint64_t value)
+{
+	CacheWriteU32(buf, value);
+	CacheWriteU32(buf, value >> 32);
+}
+
+void CacheWriteString(vector<uint8_t>& buf, const string& value)
+{
+	CacheWriteU32(buf, value.length());
+	buf.insert(buf.end(), value.begin(), value.end());
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// File I/O
+
+/**
+	@brief Reads a whole cache file, checking the magic number and the hash at the end before anything trusts it
+
+	@param fname	File to read
+	@param magic	The four characters it has to start with
+	@param buf		Contents of the file, less the hash
+
+	@return True on success. False if there's no file, or it's corrupted (a warning is printed in that case).
+ */
+bool ReadCacheFile(const string& fname, const char* magic, vector<uint8_t>& buf)
+{
+	//Read the whole thing, it's small
+	buf.clear();
+	FILE* fp = fopen(fname.c_str(), "rb");
+	if(!fp)
+		return false;
+	uint8_t chunk[4096];
+	size_t len;
+	while( (len = fread(chunk, 1, sizeof(chunk), fp)) > 0)
+		buf.insert(buf.end(), chunk, chunk + len);
+	fclose(fp);
+
+	bool ok = (buf.size() >= 12) && !memcmp(&buf[0], magic, 4);
+	if(ok)
+	{
+		Greenpak4CacheReader trailer(buf);
+		trailer.m_pos = buf.size() - 8;
+		uint64_t hash = trailer.ReadU64();
+		buf.resize(buf.size() - 8);
+		ok = (hash == Greenpak4Netlist::HashNetlist(reinterpret_cast<const char*>(&buf[0]), buf.size(), ""));
+	}
+	if(!ok)
+	{
+		LogWarning("Cache file %s is corrupted, ignoring it\n", fname.c_str());
+		return false;
+	}
+	return true;
+}
+
+/**
+	@brief Appends the hash to a cache file's contents and writes it out
+
+	The file is written under a temporary name and then renamed, so concurrent runs never see half of one.
+	The temporary name is unique per process and per call, since several caches may be written at once.
+
+	@return True on success. False if it couldn't be written (a warning is printed in that case).
+ */
+bool WriteCacheFile(const string& fname, vector<uint8_t>& buf)
+{
+	CacheWriteU64(buf, Greenpak4Netlist::HashNetlist(reinterpret_cast<const char*>(&buf[0]), buf.size(), ""));
+
+	static atomic<unsigned int> serial(0);
+	char tmp[32];
+	snprintf(tmp, sizeof(tmp), ".tmp%d.%u", static_cast<int>(getpid()), serial++);
+	string tmpname = fname + tmp;
+	FILE* fp = fopen(tmpname.c_str(), "wb");
+	if(!fp)
+	{
+		LogWarning("Couldn't write cache file %s\n", tmpname.c_str());
+		return false;
+	}
+	bool ok = (1 == fwrite(&buf[0], buf.size(), 1, fp));
+	if(0 != fclose(fp))
+		ok = false;
+	if(!ok || (0 != rename(tmpname.c_str(), fname.c_str())) )
+	{
+		LogWarning("Couldn't write cache file %s\n", fname.c_str());
+		unlink(tmpname.c_str());
+		return false;
+	}
+	return true;
+}
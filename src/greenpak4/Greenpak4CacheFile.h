@@ -0,0 +1,91 @@
+/***********************************************************************************************************************
+ * Copyright (C) 2016 Andrew Zonenberg and contributors                                                                *
+ *                                                                                                                     *
+ * This program is free software; you can redistribute it and/or modify it under the terms of the GNU Lesser General   *
+ * Public License as published by the Free Software Foundation; either version 2.1 of the License, or (at your option) *
+ * any later version.                                                                                                  *
+ *                                                                                                                     *
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied  *
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for     *
+ * more details.                                                                                                       *
+ *                                                                                                                     *
+ * You should have received a copy of the GNU Lesser General Public License along with this program; if not, you may   *
+ * find one here:                                                                                                      *
+ * https://www.gnu.org/licenses/old-licenses/lgpl-2.1.txt                                                              *
+ * or you may search the http://www.gnu.org website for the version 2.1 license, or you may write to the Free Software *
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA                                      *
+ **********************************************************************************************************************/
+
+#ifndef Greenpak4CacheFile_h
+#define Greenpak4CacheFile_h
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/*
+	Cache files (netlist snapshots and compile results) are a four-character magic number, then whatever the cache
+	puts in them, then a u64 HashNetlist() of everything before it (with no salt). All integers are little endian,
+	strings are a u32 length then the bytes.
+ */
+
+void CacheWriteU32(std::vector<uint8_t>& buf, uint32_t value);
+void CacheWriteU64(std::vector<uint8_t>& buf, uint64_t value);
+void CacheWriteString(std::vector<uint8_t>& buf, const std::string& value);
+
+bool ReadCacheFile(const std::string& fname, const char* magic, std::vector<uint8_t>& buf);
+bool WriteCacheFile(const std::string& fname, std::vector<uint8_t>& buf);
+
+/**
+	@brief Cursor over a cache file being loaded. Reading past the end gives zeros and clears m_ok.
+ */
+class Greenpak4CacheReader
+{
+public:
+	Greenpak4CacheReader(const std::vector<uint8_t>& buf)
+		: m_buf(buf)
+		, m_pos(0)
+		, m_ok(true)
+	{}
+
+	uint32_t ReadU32()
+	{
+		if(m_pos + 4 > m_buf.size())
+		{
+			m_ok = false;
+			return 0;
+		}
+		uint32_t value = 0;
+		for(int i=0; i<4; i++)
+			value |= static_cast<uint32_t>(m_buf[m_pos++]) << (8*i);
+		return value;
+	}
+
+	uint64_t ReadU64()
+	{
+		uint64_t value = ReadU32();
+		return value | (static_cast<uint64_t>(ReadU32()) << 32);
+	}
+
+	std::string ReadString()
+	{
+		uint32_t len = ReadU32();
+		if(m_pos + len > m_buf.size())
+		{
+			m_ok = false;
+			return "";
+		}
+		std::string value(reinterpret_cast<const char*>(&m_buf[m_pos]), len);
+		m_pos += len;
+		return value;
+	}
+
+	bool AtEnd()
+	{ return m_pos == m_buf.size(); }
+
+	const std::vector<uint8_t>& m_buf;
+	size_t m_pos;
+	bool m_ok;
+};
+
+#endif
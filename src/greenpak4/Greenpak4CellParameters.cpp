@@ -0,0 +1,418 @@
+/***********************************************************************************************************************
+ * Copyright (C) 2016 Andrew Zonenberg and contributors                                                                *
+ *                                                                                                                     *
+ * This program is free software; you can redistribute it and/or modify it under the terms of the GNU Lesser General   *
+ * Public License as published by the Free Software Foundation; either version 2.1 of the License, or (at your option) *
+ * any later version.                                                                                                  *
+ *                                                                                                                     *
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied  *
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for     *
+ * more details.                                                                                                       *
+ *                                                                                                                     *
+ * You should have received a copy of the GNU Lesser General Public License along with this program; if not, you may   *
+ * find one here:                                                                                                      *
+ * https://www.gnu.org/licenses/old-licenses/lgpl-2.1.txt                                                              *
+ * or you may search the http://www.gnu.org website for the version 2.1 license, or you may write to the Free Software *
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA                                      *
+ **********************************************************************************************************************/
+
+#include <cerrno>
+#include <climits>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <log.h>
+#include <Greenpak4.h>
+
+using namespace std;
+
+/**
+	@brief Names of the parameters, in Greenpak4Parameter order
+ */
+static const char* g_parameterNames[PARAM_COUNT] =
+{
+	"AUTO_PWRDN",
+	"BANDWIDTH",
+	"BANDWIDTH_KHZ",
+	"CHOPPER_EN",
+	"CLK_EDGE",
+	"CLKIN_DIVIDE",
+	"COUNT_TO",
+	"DATA_WIDTH",
+	"DELAY_STEPS",
+	"DIRECTION",
+	"EDGE_DIRECTION",
+	"EDGE_SPEED",
+	"FABRIC_DIV",
+	"GAIN",
+	"GLITCH_FILTER",
+	"GREATER_OR_EQUAL",
+	"HARDIP_DIV",
+	"HYSTERESIS",
+	"INIT",
+	"INPUT_MODE",
+	"OSC_FREQ",
+	"OUT_DELAY",
+	"OUT_DIV",
+	"OUTA_INVERT",
+	"OUTA_TAP",
+	"OUTB_TAP",
+	"PATTERN_DATA",
+	"PATTERN_LEN",
+	"POR_TIME",
+	"PWRDN_EN",
+	"PWRDN_SYNC",
+	"REF_VAL",
+	"RESET_MODE",
+	"RESET_VALUE",
+	"SPI_CPHA",
+	"SPI_CPOL",
+	"SRMODE",
+	"VIN_ATTEN",
+	"VIN_DIV",
+	"VIN_ISRC_EN",
+	"VREF"
+};
+
+/**
+	@brief Keywords, and the value each one is stored as
+ */
+static const struct
+{
+	const char* m_name;
+	Greenpak4ParameterChoice m_value;
+} g_choiceNames[] =
+{
+	{ "RISING", CHOICE_RISING },
+	{ "FALLING", CHOICE_FALLING },
+	{ "BOTH", CHOICE_BOTH },
+	{ "LEVEL", CHOICE_LEVEL },
+	{ "ZERO", CHOICE_ZERO },
+	{ "COUNT_TO", CHOICE_COUNT_TO },
+	{ "LOW", CHOICE_LOW },
+	{ "HIGH", CHOICE_HIGH },
+	{ "25k", CHOICE_25K },
+	{ "2M", CHOICE_2M },
+	{ "SINGLE", CHOICE_SINGLE },
+	{ "DIFF", CHOICE_DIFF },
+	{ "PDIFF", CHOICE_PDIFF },
+	{ "INPUT", CHOICE_INPUT },
+	{ "OUTPUT", CHOICE_OUTPUT }
+};
+
+/**
+	@brief How a parameter's value is written
+ */
+enum ParameterKind
+{
+	//Any integer from m_min to m_max
+	KIND_INT,
+
+	//0 or 1
+	KIND_FLAG,
+
+	//One of the integers in m_values
+	KIND_ONE_OF,
+
+	//One of the keywords in m_values
+	KIND_CHOICE,
+
+	//One of the numbers in m_values (which may have up to two decimal places), stored in hundredths
+	KIND_HUNDREDTHS
+};
+
+/**
+	@brief The parameters each cell type accepts. A type ending in * matches every type starting with the rest.
+ */
+static const struct
+{
+	const char* m_type;
+	Greenpak4Parameter m_param;
+	ParameterKind m_kind;
+	int32_t m_min;
+	int32_t m_max;
+	const char* m_values;
+} g_parameterSpecs[] =
+{
+	{ "GP_2LUT", PARAM_INIT, KIND_INT, 0, 0xf, NULL },
+	{ "GP_3LUT", PARAM_INIT, KIND_INT, 0, 0xff, NULL },
+	{ "GP_4LUT", PARAM_INIT, KIND_INT, 0, 0xffff, NULL },
+
+	{ "GP_DFF*", PARAM_INIT, KIND_FLAG, 0, 0, NULL },
+	{ "GP_DFF*", PARAM_SRMODE, KIND_FLAG, 0, 0, NULL },
+	{ "GP_DLATCH*", PARAM_INIT, KIND_FLAG, 0, 0, NULL },
+	{ "GP_DLATCH*", PARAM_SRMODE, KIND_FLAG, 0, 0, NULL },
+
+	{ "GP_COUNT8*", PARAM_RESET_MODE, KIND_CHOICE, 0, 0, "RISING FALLING BOTH LEVEL" },
+	{ "GP_COUNT8*", PARAM_RESET_VALUE, KIND_CHOICE, 0, 0, "ZERO COUNT_TO" },
+	{ "GP_COUNT8*", PARAM_COUNT_TO, KIND_INT, 0, 0xff, NULL },
+	{ "GP_COUNT8*", PARAM_CLKIN_DIVIDE, KIND_INT, 1, INT32_MAX, NULL },
+	{ "GP_COUNT14*", PARAM_RESET_MODE, KIND_CHOICE, 0, 0, "RISING FALLING BOTH LEVEL" },
+	{ "GP_COUNT14*", PARAM_RESET_VALUE, KIND_CHOICE, 0, 0, "ZERO COUNT_TO" },
+	{ "GP_COUNT14*", PARAM_COUNT_TO, KIND_INT, 0, 0x3fff, NULL },
+	{ "GP_COUNT14*", PARAM_CLKIN_DIVIDE, KIND_INT, 1, INT32_MAX, NULL },
+
+	{ "GP_PGEN", PARAM_PATTERN_DATA, KIND_INT, 0, 0xffff, NULL },
+	{ "GP_PGEN", PARAM_PATTERN_LEN, KIND_INT, 2, 16, NULL },
+
+	{ "GP_SHREG", PARAM_OUTA_TAP, KIND_INT, 1, 16, NULL },
+	{ "GP_SHREG", PARAM_OUTB_TAP, KIND_INT, 1, 16, NULL },
+	{ "GP_SHREG", PARAM_OUTA_INVERT, KIND_FLAG, 0, 0, NULL },
+
+	{ "GP_DELAY", PARAM_DELAY_STEPS, KIND_INT, INT32_MIN, INT32_MAX, NULL },
+	{ "GP_DELAY", PARAM_GLITCH_FILTER, KIND_FLAG, 0, 0, NULL },
+	{ "GP_EDGEDET", PARAM_EDGE_DIRECTION, KIND_CHOICE, 0, 0, "RISING FALLING BOTH" },
+	{ "GP_EDGEDET", PARAM_DELAY_STEPS, KIND_INT, INT32_MIN, INT32_MAX, NULL },
+	{ "GP_EDGEDET", PARAM_GLITCH_FILTER, KIND_FLAG, 0, 0, NULL },
+
+	{ "GP_DCMP", PARAM_CLK_EDGE, KIND_CHOICE, 0, 0, "RISING FALLING" },
+	{ "GP_DCMP", PARAM_PWRDN_SYNC, KIND_FLAG, 0, 0, NULL },
+	{ "GP_DCMP", PARAM_GREATER_OR_EQUAL, KIND_FLAG, 0, 0, NULL },
+	{ "GP_PWM", PARAM_CLK_EDGE, KIND_CHOICE, 0, 0, "RISING FALLING" },
+	{ "GP_PWM", PARAM_PWRDN_SYNC, KIND_FLAG, 0, 0, NULL },
+	{ "GP_PWM", PARAM_GREATER_OR_EQUAL, KIND_FLAG, 0, 0, NULL },
+	{ "GP_DCMPREF", PARAM_REF_VAL, KIND_INT, 0, 0xff, NULL },
+
+	{ "GP_ABUF", PARAM_BANDWIDTH_KHZ, KIND_INT, INT32_MIN, INT32_MAX, NULL },
+	{ "GP_ACMP", PARAM_BANDWIDTH, KIND_CHOICE, 0, 0, "LOW HIGH" },
+	{ "GP_ACMP", PARAM_VIN_ATTEN, KIND_INT, INT32_MIN, INT32_MAX, NULL },
+	{ "GP_ACMP", PARAM_VIN_ISRC_EN, KIND_FLAG, 0, 0, NULL },
+	{ "GP_ACMP", PARAM_HYSTERESIS, KIND_INT, INT32_MIN, INT32_MAX, NULL },
+	{ "GP_BANDGAP", PARAM_AUTO_PWRDN, KIND_FLAG, 0, 0, NULL },
+	{ "GP_BANDGAP", PARAM_CHOPPER_EN, KIND_FLAG, 0, 0, NULL },
+	{ "GP_BANDGAP", PARAM_OUT_DELAY, KIND_ONE_OF, 0, 0, "100 550" },
+	{ "GP_PGA", PARAM_GAIN, KIND_HUNDREDTHS, 0, 0, "0.25 0.5 1 2 4 8 16" },
+	{ "GP_PGA", PARAM_INPUT_MODE, KIND_CHOICE, 0, 0, "SINGLE DIFF PDIFF" },
+	{ "GP_VREF", PARAM_VIN_DIV, KIND_INT, INT32_MIN, INT32_MAX, NULL },
+	{ "GP_VREF", PARAM_VREF, KIND_INT, INT32_MIN, INT32_MAX, NULL },
+
+	{ "GP_LFOSC", PARAM_PWRDN_EN, KIND_FLAG, 0, 0, NULL },
+	{ "GP_LFOSC", PARAM_AUTO_PWRDN, KIND_FLAG, 0, 0, NULL },
+	{ "GP_LFOSC", PARAM_OUT_DIV, KIND_ONE_OF, 0, 0, "1 2 4 16" },
+	{ "GP_RCOSC", PARAM_PWRDN_EN, KIND_FLAG, 0, 0, NULL },
+	{ "GP_RCOSC", PARAM_AUTO_PWRDN, KIND_FLAG, 0, 0, NULL },
+	{ "GP_RCOSC", PARAM_HARDIP_DIV, KIND_ONE_OF, 0, 0, "1 2 4 8" },
+	{ "GP_RCOSC", PARAM_FABRIC_DIV, KIND_ONE_OF, 0, 0, "1 2 3 4 8 12 24 64" },
+	{ "GP_RCOSC", PARAM_OSC_FREQ, KIND_CHOICE, 0, 0, "25k 2M" },
+	{ "GP_RINGOSC", PARAM_PWRDN_EN, KIND_FLAG, 0, 0, NULL },
+	{ "GP_RINGOSC", PARAM_AUTO_PWRDN, KIND_FLAG, 0, 0, NULL },
+	{ "GP_RINGOSC", PARAM_HARDIP_DIV, KIND_ONE_OF, 0, 0, "1 4 8 16" },
+	{ "GP_RINGOSC", PARAM_FABRIC_DIV, KIND_ONE_OF, 0, 0, "1 2 3 4 8 12 24 64" },
+
+	{ "GP_POR", PARAM_POR_TIME, KIND_ONE_OF, 0, 0, "4 500" },
+	{ "GP_SYSRESET", PARAM_RESET_MODE, KIND_CHOICE, 0, 0, "RISING LEVEL" },
+	{ "GP_SYSRESET", PARAM_EDGE_SPEED, KIND_ONE_OF, 0, 0, "4 500" },
+
+	{ "GP_SPI", PARAM_DATA_WIDTH, KIND_ONE_OF, 0, 0, "8 16" },
+	{ "GP_SPI", PARAM_SPI_CPHA, KIND_FLAG, 0, 0, NULL },
+	{ "GP_SPI", PARAM_SPI_CPOL, KIND_FLAG, 0, 0, NULL },
+	{ "GP_SPI", PARAM_DIRECTION, KIND_CHOICE, 0, 0, "INPUT OUTPUT" }
+};
+
+/**
+	@brief Checks if a cell type matches a spec's type (which may end in a * wildcard)
+ */
+static bool TypeMatches(const char* pattern, const string& type)
+{
+	size_t len = strlen(pattern);
+	if( (len > 0) && (pattern[len-1] == '*') )
+		return type.compare(0, len-1, pattern, len-1) == 0;
+	return type == pattern;
+}
+
+/**
+	@brief Parses a whole string as a decimal integer
+
+	@return True if it's an integer that fits in an int32_t
+ */
+static bool ParseInt(const string& s, int32_t& value)
+{
+	if(s.empty())
+		return false;
+
+	char* end;
+	errno = 0;
+	long v = strtol(s.c_str(), &end, 10);
+	if( (*end != '\0') || (errno != 0) || (v < INT32_MIN) || (v > INT32_MAX) )
+		return false;
+	value = v;
+	return true;
+}
+
+/**
+	@brief Parses a number with up to two decimal places into hundredths
+ */
+static bool ParseHundredths(const string& s, int32_t& value)
+{
+	if(s.empty())
+		return false;
+
+	char* end;
+	double v = strtod(s.c_str(), &end);
+	if( (*end != '\0') || !(fabs(v) < INT32_MAX / 100) )
+		return false;
+	value = lround(v * 100);
+	return fabs(v * 100 - value) < 1e-6;
+}
+
+/**
+	@brief Parses one value in the format a spec asks for
+
+	@param allowed	Filled with a description of the legal values if it isn't one
+ */
+template<class T>
+static bool ParseValue(const T& spec, const string& s, int32_t& value, string& allowed)
+{
+	char tmp[64];
+	switch(spec.m_kind)
+	{
+		case KIND_INT:
+			if(ParseInt(s, value) && (value >= spec.m_min) && (value <= spec.m_max))
+				return true;
+			if( (spec.m_min == INT32_MIN) && (spec.m_max == INT32_MAX) )
+				allowed = "an integer";
+			else if(spec.m_max == INT32_MAX)
+			{
+				snprintf(tmp, sizeof(tmp), "an integer of at least %d", spec.m_min);
+				allowed = tmp;
+			}
+			else
+			{
+				snprintf(tmp, sizeof(tmp), "an integer from %d to %d", spec.m_min, spec.m_max);
+				allowed = tmp;
+			}
+			return false;
+
+		case KIND_FLAG:
+			if(ParseInt(s, value) && ( (value == 0) || (value == 1) ))
+				return true;
+			allowed = "0 or 1";
+			return false;
+
+		default:
+			break;
+	}
+
+	//The rest pick from a list
+	int32_t parsed = 0;
+	bool ok = false;
+	if(spec.m_kind == KIND_ONE_OF)
+		ok = ParseInt(s, parsed);
+	else if(spec.m_kind == KIND_HUNDREDTHS)
+		ok = ParseHundredths(s, parsed);
+	else
+	{
+		for(auto& c : g_choiceNames)
+		{
+			if(s == c.m_name)
+			{
+				parsed = c.m_value;
+				ok = true;
+			}
+		}
+	}
+
+	string list = spec.m_values;
+	size_t pos = 0;
+	allowed = "one of";
+	while(pos < list.length())
+	{
+		size_t end = list.find(' ', pos);
+		if(end == string::npos)
+			end = list.length();
+		string option = list.substr(pos, end - pos);
+		pos = end + 1;
+		allowed += " " + option;
+
+		if(!ok)
+			continue;
+		int32_t v = 0;
+		if(spec.m_kind == KIND_ONE_OF)
+			ParseInt(option, v);
+		else if(spec.m_kind == KIND_HUNDREDTHS)
+			ParseHundredths(option, v);
+		else if(option != s)
+			continue;
+		else
+			v = parsed;
+
+		if(v == parsed)
+		{
+			value = parsed;
+			return true;
+		}
+	}
+	return false;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Parsing
+
+/**
+	@brief Parses a cell's parameters, replacing anything we had before
+
+	Parameters the cell type doesn't take are ignored (with a warning), since the cell library sometimes has parameters
+	we don't implement yet.
+
+	@param type		Cell type
+	@param cell		Cell name, for error messages
+	@param params	The parameters, as written in the netlist
+
+	@return True on success, false (after logging why) if a parameter has an illegal value
+ */
+bool Greenpak4CellParameters::Parse(const string& type, const string& cell, const map<string, string>& params)
+{
+	m_present = 0;
+	m_values.clear();
+
+	//Only check our own primitives, not yosys cells or user modules
+	if(type.compare(0, 3, "GP_") != 0)
+		return true;
+
+	for(auto& it : params)
+	{
+		bool found = false;
+		for(auto& spec : g_parameterSpecs)
+		{
+			if( (it.first != g_parameterNames[spec.m_param]) || !TypeMatches(spec.m_type, type) )
+				continue;
+			found = true;
+
+			int32_t value = 0;
+			string allowed;
+			if(!ParseValue(spec, it.second, value, allowed))
+			{
+				LogError("Cell \"%s\" (%s) has illegal %s \"%s\" (must be %s)\n",
+					cell.c_str(), type.c_str(), it.first.c_str(), it.second.c_str(), allowed.c_str());
+				return false;
+			}
+			Set(spec.m_param, value);
+			break;
+		}
+
+		if(!found)
+		{
+			LogWarning("Cell \"%s\" (%s) has unrecognized parameter %s, ignoring\n",
+				cell.c_str(), type.c_str(), it.first.c_str());
+		}
+	}
+
+	return true;
+}
+
+/**
+	@brief Sets a parameter (for netlist passes that change cells after they're loaded)
+ */
+void Greenpak4CellParameters::Set(Greenpak4Parameter param, int32_t value)
+{
+	m_present |= (1ull << param);
+	for(auto& v : m_values)
+	{
+		if(v.first == param)
+		{
+			v.second = value;
+			return;
+		}
+	}
+	m_values.push_back(pair<Greenpak4Parameter, int32_t>(param, value));
+}
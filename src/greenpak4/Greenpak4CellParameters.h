@@ -0,0 +1,151 @@
+/***********************************************************************************************************************
+ * Copyright (C) 2016 Andrew Zonenberg and contributors                                                                *
+ *                                                                                                                     *
+ * This program is free software; you can redistribute it and/or modify it under the terms of the GNU Lesser General   *
+ * Public License as published by the Free Software Foundation; either version 2.1 of the License, or (at your option) *
+ * any later version.                                                                                                  *
+ *                                                                                                                     *
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied  *
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for     *
+ * more details.                                                                                                       *
+ *                                                                                                                     *
+ * You should have received a copy of the GNU Lesser General Public License along with this program; if not, you may   *
+ * find one here:                                                                                                      *
+ * https://www.gnu.org/licenses/old-licenses/lgpl-2.1.txt                                                              *
+ * or you may search the http://www.gnu.org website for the version 2.1 license, or you may write to the Free Software *
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA                                      *
+ **********************************************************************************************************************/
+
+#ifndef Greenpak4CellParameters_h
+#define Greenpak4CellParameters_h
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+/**
+	@brief Every cell parameter we know what to do with (see g_parameterSpecs for which cells take which)
+ */
+enum Greenpak4Parameter
+{
+	PARAM_AUTO_PWRDN,
+	PARAM_BANDWIDTH,
+	PARAM_BANDWIDTH_KHZ,
+	PARAM_CHOPPER_EN,
+	PARAM_CLK_EDGE,
+	PARAM_CLKIN_DIVIDE,
+	PARAM_COUNT_TO,
+	PARAM_DATA_WIDTH,
+	PARAM_DELAY_STEPS,
+	PARAM_DIRECTION,
+	PARAM_EDGE_DIRECTION,
+	PARAM_EDGE_SPEED,
+	PARAM_FABRIC_DIV,
+	PARAM_GAIN,
+	PARAM_GLITCH_FILTER,
+	PARAM_GREATER_OR_EQUAL,
+	PARAM_HARDIP_DIV,
+	PARAM_HYSTERESIS,
+	PARAM_INIT,
+	PARAM_INPUT_MODE,
+	PARAM_OSC_FREQ,
+	PARAM_OUT_DELAY,
+	PARAM_OUT_DIV,
+	PARAM_OUTA_INVERT,
+	PARAM_OUTA_TAP,
+	PARAM_OUTB_TAP,
+	PARAM_PATTERN_DATA,
+	PARAM_PATTERN_LEN,
+	PARAM_POR_TIME,
+	PARAM_PWRDN_EN,
+	PARAM_PWRDN_SYNC,
+	PARAM_REF_VAL,
+	PARAM_RESET_MODE,
+	PARAM_RESET_VALUE,
+	PARAM_SPI_CPHA,
+	PARAM_SPI_CPOL,
+	PARAM_SRMODE,
+	PARAM_VIN_ATTEN,
+	PARAM_VIN_DIV,
+	PARAM_VIN_ISRC_EN,
+	PARAM_VREF,
+
+	PARAM_COUNT
+};
+
+/**
+	@brief Values of the parameters which take a keyword rather than a number
+ */
+enum Greenpak4ParameterChoice
+{
+	CHOICE_RISING,
+	CHOICE_FALLING,
+	CHOICE_BOTH,
+	CHOICE_LEVEL,
+
+	CHOICE_ZERO,
+	CHOICE_COUNT_TO,
+
+	CHOICE_LOW,
+	CHOICE_HIGH,
+
+	CHOICE_25K,
+	CHOICE_2M,
+
+	CHOICE_SINGLE,
+	CHOICE_DIFF,
+	CHOICE_PDIFF,
+
+	CHOICE_INPUT,
+	CHOICE_OUTPUT
+};
+
+/**
+	@brief The parameters of one netlist cell, parsed and checked against what its cell type accepts.
+
+	Numbers are stored as is, flags as 0 or 1, keywords as a Greenpak4ParameterChoice, and fractional values (the PGA
+	gain) in hundredths.
+ */
+class Greenpak4CellParameters
+{
+public:
+	Greenpak4CellParameters()
+		: m_present(0)
+	{}
+
+	bool Parse(const std::string& type, const std::string& cell, const std::map<std::string, std::string>& params);
+
+	bool Has(Greenpak4Parameter param) const
+	{ return (m_present >> param) & 1; }
+
+	/**
+		@brief Gets the value of a parameter (zero if the cell doesn't have it)
+	 */
+	int32_t Get(Greenpak4Parameter param) const
+	{
+		for(auto& v : m_values)
+		{
+			if(v.first == param)
+				return v.second;
+		}
+		return 0;
+	}
+
+	void Set(Greenpak4Parameter param, int32_t value);
+
+protected:
+
+	/**
+		@brief Bitmask of the parameters we have (bit N set = we have parameter N)
+	 */
+	uint64_t m_present;
+
+	/**
+		@brief Values of the parameters we have (cells only have a handful, so a search is fine)
+	 */
+	std::vector< std::pair<Greenpak4Parameter, int32_t> > m_values;
+};
+
+#endif
@@ -87,14 +87,15 @@ bool Greenpak4ClockBuffer::CommitChanges()
 	return true;
 }
 
-bool Greenpak4ClockBuffer::Load(bool* /*bitstream*/)
+bool Greenpak4ClockBuffer::Load(Greenpak4Bitstream& bitstream)
 {
-	//TODO: Do our inputs
-	LogError("Unimplemented\n");
-	return false;
+	if(!ReadMatrixSelector(bitstream, m_inputBaseWord, m_input))
+		return false;
+
+	return true;
 }
 
-bool Greenpak4ClockBuffer::Save(bool* bitstream)
+bool Greenpak4ClockBuffer::Save(Greenpak4Bitstream& bitstream)
 {
 	////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 	// INPUT BUS
@@ -114,29 +114,80 @@ bool Greenpak4Comparator::CommitChanges()
 	if(ncell == NULL)
 		return true;
 
-	if(ncell->HasParameter("BANDWIDTH"))
-		m_bandwidthHigh = (ncell->m_parameters["BANDWIDTH"] == "HIGH") ? true : false;
+	if(ncell->HasParameter(PARAM_BANDWIDTH))
+		m_bandwidthHigh = (ncell->GetParameter(PARAM_BANDWIDTH) == CHOICE_HIGH);
 
-	if(ncell->HasParameter("VIN_ATTEN"))
-		m_vinAtten = (atoi(ncell->m_parameters["VIN_ATTEN"].c_str()));
+	if(ncell->HasParameter(PARAM_VIN_ATTEN))
+		m_vinAtten = ncell->GetParameter(PARAM_VIN_ATTEN);
 
-	if(ncell->HasParameter("VIN_ISRC_EN"))
-		m_isrcEn = (ncell->m_parameters["VIN_ISRC_EN"] == "1") ? true : false;
+	if(ncell->HasParameter(PARAM_VIN_ISRC_EN))
+		m_isrcEn = ncell->GetParameter(PARAM_VIN_ISRC_EN);
 
-	if(ncell->HasParameter("HYSTERESIS"))
-		m_hysteresis = (atoi(ncell->m_parameters["HYSTERESIS"].c_str()));
+	if(ncell->HasParameter(PARAM_HYSTERESIS))
+		m_hysteresis = ncell->GetParameter(PARAM_HYSTERESIS);
 
 	return true;
 }
 
-bool Greenpak4Comparator::Load(bool* /*bitstream*/)
+bool Greenpak4Comparator::Load(Greenpak4Bitstream& bitstream)
 {
-	//TODO: Do our inputs
-	LogError("Unimplemented\n");
-	return false;
+	////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+	// INPUT BUS
+
+	if(!ReadMatrixSelector(bitstream, m_inputBaseWord, m_pwren))
+		return false;
+
+	////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+	// CONFIGURATION
+
+	if(m_cbaseIsrc > 0)
+		m_isrcEn = bitstream[m_cbaseIsrc];
+	if(m_cbaseBw > 0)
+		m_bandwidthHigh = !bitstream[m_cbaseBw];
+
+	m_vinAtten = 1;
+	if(m_cbaseGain > 0)
+		m_vinAtten = bitstream.GetField(m_cbaseGain, 2) + 1;
+
+	static const int hysteresis[4] = {0, 25, 50, 200};
+	m_hysteresis = 0;
+	if(m_cbaseHyst > 0)
+		m_hysteresis = hysteresis[bitstream.GetField(m_cbaseHyst, 2)];
+
+	//A grounded input leaves the mux selectors zero, so only trust them if we're powered
+	//(the input selector is only two bits wide if some input needs the high bit)
+	m_vin = m_device->GetGround();
+	m_vref = m_device->GetGround();
+	if( !m_pwren.IsPowerRail() || m_pwren.GetPowerRailValue() )
+	{
+		unsigned int width = 1;
+		for(auto it : m_muxsels)
+		{
+			if(it.second & 2)
+				width = 2;
+		}
+
+		unsigned int sel = bitstream.GetField(m_cbaseVin, width);
+		for(auto it : m_muxsels)
+		{
+			if(it.second == sel)
+				m_vin = it.first;
+		}
+
+		//Our GP_VREF's settings only live in our reference selector
+		if(m_cmpNum < m_device->GetVrefCount())
+		{
+			auto vref = m_device->GetVref(m_cmpNum);
+			if(!vref->SetACMPMuxSel(bitstream.GetField(m_cbaseVref, 5)))
+				return false;
+			m_vref = vref->GetOutput("VOUT");
+		}
+	}
+
+	return true;
 }
 
-bool Greenpak4Comparator::Save(bool* bitstream)
+bool Greenpak4Comparator::Save(Greenpak4Bitstream& bitstream)
 {
 	////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 	// INPUT BUS
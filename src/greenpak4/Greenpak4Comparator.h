@@ -41,8 +41,8 @@ public:
 		);
 
 	//Serialization
-	virtual bool Load(bool* bitstream);
-	virtual bool Save(bool* bitstream);
+	virtual bool Load(Greenpak4Bitstream& bitstream);
+	virtual bool Save(Greenpak4Bitstream& bitstream);
 
 	virtual ~Greenpak4Comparator();
 
@@ -63,6 +63,20 @@ public:
 	Greenpak4EntityOutput GetInput()
 	{ return m_vin; }
 
+	Greenpak4EntityOutput GetPowerEn()
+	{ return m_pwren; }
+
+	Greenpak4EntityOutput GetVref()
+	{ return m_vref; }
+
+	//VIN is divided by this before it's compared
+	int GetAttenuation()
+	{ return m_vinAtten; }
+
+	//in mV
+	int GetHysteresis()
+	{ return m_hysteresis; }
+
 	//Helper used by DRC to poke ACMP0's config if necessary
 	void SetInput(Greenpak4EntityOutput input)
 	{ m_vin = input; }
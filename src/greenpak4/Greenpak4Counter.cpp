@@ -83,51 +83,37 @@ bool Greenpak4Counter::CommitChanges()
 	if(ncell == NULL)
 		return true;
 
-	if(ncell->HasParameter("RESET_MODE"))
+	//Keywords were checked when the netlist was loaded
+	if(ncell->HasParameter(PARAM_RESET_MODE))
 	{
-		string p = ncell->m_parameters["RESET_MODE"];
-		if(p == "RISING")
-			m_resetMode = Greenpak4Counter::RISING_EDGE;
-		else if(p == "FALLING")
-			m_resetMode = Greenpak4Counter::FALLING_EDGE;
-		else if(p == "BOTH")
-			m_resetMode = Greenpak4Counter::BOTH_EDGE;
-		else if(p == "LEVEL")
-			m_resetMode = Greenpak4Counter::HIGH_LEVEL;
-		else
+		switch(ncell->GetParameter(PARAM_RESET_MODE))
 		{
-			LogError(
-				"Counter \"%s\" has illegal reset mode \"%s\" "
-				"(must be RISING, FALLING, BOTH, or LEVEL)\n",
-				ncell->m_name.c_str(),
-				p.c_str());
-			return false;
-		}
-	}
+			case CHOICE_FALLING:
+				m_resetMode = Greenpak4Counter::FALLING_EDGE;
+				break;
 
-	if(ncell->HasParameter("RESET_VALUE"))
-	{
-		string p = ncell->m_parameters["RESET_VALUE"];
-		if(p == "ZERO")
-			m_resetValue = ZERO;
-		else if(p == "COUNT_TO")
-			m_resetValue = COUNT_TO;
-		else
-		{
-			LogError(
-				"Counter \"%s\" has illegal reset value \"%s\" "
-				"(must be ZERO or COUNT_TO)\n",
-				ncell->m_name.c_str(),
-				p.c_str());
-			return false;
+			case CHOICE_BOTH:
+				m_resetMode = Greenpak4Counter::BOTH_EDGE;
+				break;
+
+			case CHOICE_LEVEL:
+				m_resetMode = Greenpak4Counter::HIGH_LEVEL;
+				break;
+
+			default:
+				m_resetMode = Greenpak4Counter::RISING_EDGE;
+				break;
 		}
 	}
 
-	if(ncell->HasParameter("COUNT_TO"))
-		m_countVal = (atoi(ncell->m_parameters["COUNT_TO"].c_str()));
+	if(ncell->HasParameter(PARAM_RESET_VALUE))
+		m_resetValue = (ncell->GetParameter(PARAM_RESET_VALUE) == CHOICE_COUNT_TO) ? COUNT_TO : ZERO;
+
+	if(ncell->HasParameter(PARAM_COUNT_TO))
+		m_countVal = ncell->GetParameter(PARAM_COUNT_TO);
 
-	if(ncell->HasParameter("CLKIN_DIVIDE"))
-		m_preDivide = (atoi(ncell->m_parameters["CLKIN_DIVIDE"].c_str()));
+	if(ncell->HasParameter(PARAM_CLKIN_DIVIDE))
+		m_preDivide = ncell->GetParameter(PARAM_CLKIN_DIVIDE);
 
 	return true;
 }
@@ -172,13 +158,101 @@ unsigned int Greenpak4Counter::GetOutputNetNumber(string port)
 		return -1;
 }
 
-bool Greenpak4Counter::Load(bool* /*bitstream*/)
+bool Greenpak4Counter::Load(Greenpak4Bitstream& bitstream)
 {
-	LogError("Unimplemented\n");
-	return false;
+	////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+	// INPUT BUS
+
+	if(!ReadMatrixSelector(bitstream, m_inputBaseWord + 0, m_reset))
+		return false;
+	if(m_hasFSM)
+	{
+		if(!ReadMatrixSelector(bitstream, m_inputBaseWord + 1, m_keep))
+			return false;
+		if(!ReadMatrixSelector(bitstream, m_inputBaseWord + 2, m_up))
+			return false;
+	}
+
+	////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+	// Configuration
+
+	//Count value
+	m_countVal = bitstream.GetField(m_configBase, (m_depth > 8) ? 14 : 8);
+	uint32_t nbase = m_configBase + m_depth;
+
+	//Input clock selector (decoded once we know if we're used)
+	unsigned int clksel;
+	bool wide_clksel = (m_hasFSM || m_hasPWM);
+	if(wide_clksel)
+	{
+		clksel = bitstream.GetField(nbase, 4);
+		nbase += 4;
+	}
+	else
+	{
+		clksel = bitstream.GetField(nbase, 3);
+		nbase += 3;
+	}
+
+	//Reset mode
+	m_resetMode = static_cast<ResetMode>(bitstream.GetField(nbase, 2));
+
+	//Block function (Save() puts unused counters in delay mode)
+	bool used;
+	if(m_hasFSM)
+	{
+		nbase += 2;
+		if(m_hasEdgeDetect)
+		{
+			used = (bitstream.GetField(nbase, 2) == 1);
+			nbase += 2;
+		}
+		else
+		{
+			used = bitstream[nbase];
+			nbase ++;
+		}
+
+		m_resetValue = bitstream[nbase + 2] ? COUNT_TO : ZERO;
+	}
+	else if(m_hasPWM)
+		used = bitstream[nbase + 2];
+	else
+		used = (bitstream.GetField(nbase + 2, 2) == 1);
+
+	////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+	// Input clock
+
+	m_preDivide = 1;
+	m_clock = m_device->GetGround();
+	if(!used)
+		return true;
+
+	//LF and ring oscillator selectors have no pre-divider; everything below them is the RC oscillator
+	unsigned int lfsel = wide_clksel ? 10 : 4;
+	unsigned int ringsel = wide_clksel ? 8 : 6;
+	static const unsigned int rcdivs_wide[5] = {1, 4, 12, 24, 64};
+	static const unsigned int rcdivs[4] = {1, 4, 24, 64};
+
+	if( (clksel == lfsel) && m_device->GetLFOscillator() )
+		m_clock = m_device->GetLFOscillator()->GetOutput("CLKOUT");
+	else if( (clksel == ringsel) && m_device->GetRingOscillator() )
+		m_clock = m_device->GetRingOscillator()->GetOutput("CLKOUT_HARDIP");
+	else if( (clksel < (wide_clksel ? 5u : 4u)) && m_device->GetRCOscillator() )
+	{
+		m_clock = m_device->GetRCOscillator()->GetOutput("CLKOUT_HARDIP");
+		m_preDivide = wide_clksel ? rcdivs_wide[clksel] : rcdivs[clksel];
+	}
+	else
+	{
+		LogError("Counter %d clock selector %u not implemented\n", m_countnum, clksel);
+		return false;
+	}
+
+	return true;
 }
 
-bool Greenpak4Counter::Save(bool* bitstream)
+bool Greenpak4Counter::Save(Greenpak4Bitstream& bitstream)
 {
 	////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 	// INPUT BUS
@@ -215,23 +289,7 @@ bool Greenpak4Counter::Save(bool* bitstream)
 	// Configuration
 
 	//Count value (the same in all modes, just varies with depth)
-	if(m_depth > 8)
-	{
-		bitstream[m_configBase + 13] = (m_countVal & 0x2000) ? true : false;
-		bitstream[m_configBase + 12] = (m_countVal & 0x1000) ? true : false;
-		bitstream[m_configBase + 11] = (m_countVal & 0x0800) ? true : false;
-		bitstream[m_configBase + 10] = (m_countVal & 0x0400) ? true : false;
-		bitstream[m_configBase + 9]  = (m_countVal & 0x0200) ? true : false;
-		bitstream[m_configBase + 8]  = (m_countVal & 0x0100) ? true : false;
-	}
-	bitstream[m_configBase + 7] = (m_countVal & 0x80) ? true : false;
-	bitstream[m_configBase + 6] = (m_countVal & 0x40) ? true : false;
-	bitstream[m_configBase + 5] = (m_countVal & 0x20) ? true : false;
-	bitstream[m_configBase + 4] = (m_countVal & 0x10) ? true : false;
-	bitstream[m_configBase + 3] = (m_countVal & 0x08) ? true : false;
-	bitstream[m_configBase + 2] = (m_countVal & 0x04) ? true : false;
-	bitstream[m_configBase + 1] = (m_countVal & 0x02) ? true : false;
-	bitstream[m_configBase + 0] = (m_countVal & 0x01) ? true : false;
+	bitstream.SetField(m_configBase, (m_depth > 8) ? 14 : 8, m_countVal);
 
 	//Base for remaining configuration data
 	uint32_t nbase = m_configBase + m_depth;
@@ -579,3 +637,19 @@ bool Greenpak4Counter::Save(bool* bitstream)
 
 	return true;
 }
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Timing model
+
+/**
+	@brief Clock to output delay
+ */
+unsigned int Greenpak4Counter::GetPropagationDelay(Greenpak4NetlistEntity* /*entity*/)
+{
+	return 12000;
+}
+
+bool Greenpak4Counter::IsSequential(Greenpak4NetlistEntity* /*entity*/)
+{
+	return true;
+}
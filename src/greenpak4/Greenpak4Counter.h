@@ -42,8 +42,8 @@ public:
 	virtual ~Greenpak4Counter();
 
 	//Serialization
-	virtual bool Load(bool* bitstream);
-	virtual bool Save(bool* bitstream);
+	virtual bool Load(Greenpak4Bitstream& bitstream);
+	virtual bool Save(Greenpak4Bitstream& bitstream);
 
 	virtual std::string GetDescription();
 
@@ -70,6 +70,31 @@ public:
 		COUNT_TO = 1
 	};
 
+	//Configuration (for simulation)
+	Greenpak4EntityOutput GetReset()
+	{ return m_reset; }
+
+	Greenpak4EntityOutput GetClock()
+	{ return m_clock; }
+
+	Greenpak4EntityOutput GetUp()
+	{ return m_up; }
+
+	Greenpak4EntityOutput GetKeep()
+	{ return m_keep; }
+
+	unsigned int GetCountValue()
+	{ return m_countVal; }
+
+	unsigned int GetPreDivide()
+	{ return m_preDivide; }
+
+	ResetMode GetResetMode()
+	{ return m_resetMode; }
+
+	ResetValue GetResetValue()
+	{ return m_resetValue; }
+
 	virtual void SetInput(std::string port, Greenpak4EntityOutput src);
 	virtual unsigned int GetOutputNetNumber(std::string port);
 
@@ -78,6 +103,9 @@ public:
 
 	virtual bool CommitChanges();
 
+	virtual unsigned int GetPropagationDelay(Greenpak4NetlistEntity* entity);
+	virtual bool IsSequential(Greenpak4NetlistEntity* entity);
+
 protected:
 
 	///Bit depth of this counter
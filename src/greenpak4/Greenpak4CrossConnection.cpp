@@ -27,11 +27,13 @@ using namespace std;
 Greenpak4CrossConnection::Greenpak4CrossConnection(
 		Greenpak4Device* device,
 		unsigned int matrix,
+		unsigned int src_matrix,
 		unsigned int ibase,
 		unsigned int oword,
 		unsigned int cbase)
 		: Greenpak4BitstreamEntity(device, matrix, ibase, oword, cbase)
 		, m_input(device->GetGround())
+		, m_srcMatrix(src_matrix)
 {
 }
 
@@ -63,7 +65,7 @@ void Greenpak4CrossConnection::SetInput(std::string /*port*/, Greenpak4EntityOut
 		return;
 	}
 
-	else if(input.GetMatrix() == m_matrix)
+	else if(input.GetMatrix() != m_srcMatrix)
 	{
 		LogError("Tried to set cross-connection input from wrong matrix. This is probably a bug.\n");
 		return;
@@ -101,14 +103,15 @@ unsigned int Greenpak4CrossConnection::GetOutputNetNumber(string /*port*/)
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 // Load/save logic
 
-bool Greenpak4CrossConnection::Load(bool* /*bitstream*/)
+bool Greenpak4CrossConnection::Load(Greenpak4Bitstream& bitstream)
 {
-	//TODO: Do our inputs
-	LogError("Unimplemented\n");
-	return false;
+	if(!ReadMatrixSelector(bitstream, m_inputBaseWord, m_input))
+		return false;
+
+	return true;
 }
 
-bool Greenpak4CrossConnection::Save(bool* bitstream)
+bool Greenpak4CrossConnection::Save(Greenpak4Bitstream& bitstream)
 {
 	if(!WriteMatrixSelector(bitstream, m_inputBaseWord, m_input, true))
 		return false;
@@ -29,18 +29,22 @@ public:
 	Greenpak4CrossConnection(
 		Greenpak4Device* device,
 		unsigned int matrix,
+		unsigned int src_matrix,
 		unsigned int ibase,
 		unsigned int oword,
 		unsigned int cbase);
 
 	//Serialization
-	virtual bool Load(bool* bitstream);
-	virtual bool Save(bool* bitstream);
+	virtual bool Load(Greenpak4Bitstream& bitstream);
+	virtual bool Save(Greenpak4Bitstream& bitstream);
 
 	virtual ~Greenpak4CrossConnection();
 
 	virtual std::string GetDescription();
 
+	Greenpak4EntityOutput GetInput()
+	{ return m_input; }
+
 	virtual void SetInput(std::string port, Greenpak4EntityOutput src);
 	virtual unsigned int GetOutputNetNumber(std::string port);
 
@@ -49,8 +53,14 @@ public:
 
 	virtual bool CommitChanges();
 
+	virtual unsigned int GetInputMatrix()
+	{ return m_srcMatrix; }
+
 protected:
 	Greenpak4EntityOutput m_input;
+
+	///The matrix we take our input from (m_matrix is the one we drive)
+	unsigned int m_srcMatrix;
 };
 
 #endif	//Greenpak4CrossConnection_h
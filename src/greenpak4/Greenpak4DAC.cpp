@@ -121,14 +121,29 @@ bool Greenpak4DAC::CommitChanges()
 	return true;
 }
 
-bool Greenpak4DAC::Load(bool* /*bitstream*/)
+bool Greenpak4DAC::Load(Greenpak4Bitstream& bitstream)
 {
-	//TODO: Do our inputs
-	LogError("Unimplemented\n");
-	return false;
+	//If we're powered down, we're unused
+	m_vref = m_device->GetGround();
+	if(!bitstream[m_cbasePwr])
+		return true;
+
+	//Save() only knows how to write a constant 1000 mV reference, from our own GP_VREF
+	if(m_dacnum + 6 < m_device->GetVrefCount())
+	{
+		auto vref = m_device->GetVref(m_dacnum + 6);
+		vref->SetConstantVoltage(1000);
+		m_vref = vref->GetOutput("VOUT");
+	}
+
+	//Constant input voltage (the only input source Save() knows how to write)
+	for(unsigned int i=0; i<8; i++)
+		m_din[i] = bitstream[m_cbaseReg + i] ? m_device->GetPower() : m_device->GetGround();
+
+	return true;
 }
 
-bool Greenpak4DAC::Save(bool* bitstream)
+bool Greenpak4DAC::Save(Greenpak4Bitstream& bitstream)
 {
 	////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 	// INPUT BUS
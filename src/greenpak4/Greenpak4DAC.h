@@ -35,8 +35,8 @@ public:
 		unsigned int dacnum);
 
 	//Serialization
-	virtual bool Load(bool* bitstream);
-	virtual bool Save(bool* bitstream);
+	virtual bool Load(Greenpak4Bitstream& bitstream);
+	virtual bool Save(Greenpak4Bitstream& bitstream);
 
 	virtual ~Greenpak4DAC();
 
@@ -53,6 +53,12 @@ public:
 	unsigned int GetDACNum()
 	{ return m_dacnum; }
 
+	Greenpak4EntityOutput GetVref()
+	{ return m_vref; }
+
+	Greenpak4EntityOutput GetDataInput(unsigned int i)
+	{ return m_din[i]; }
+
 	bool IsUsed();
 
 protected:
@@ -87,13 +87,20 @@ bool Greenpak4DCMPMux::CommitChanges()
 	return true;
 }
 
-bool Greenpak4DCMPMux::Load(bool* /*bitstream*/)
+bool Greenpak4DCMPMux::Load(Greenpak4Bitstream& bitstream)
 {
-	LogError("Unimplemented\n");
-	return false;
+	////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+	// INPUT BUS
+
+	if(!ReadMatrixSelector(bitstream, m_inputBaseWord, m_sel0))
+		return false;
+	if(!ReadMatrixSelector(bitstream, m_inputBaseWord + 1, m_sel1))
+		return false;
+
+	return true;
 }
 
-bool Greenpak4DCMPMux::Save(bool* bitstream)
+bool Greenpak4DCMPMux::Save(Greenpak4Bitstream& bitstream)
 {
 	////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 	// INPUT BUS
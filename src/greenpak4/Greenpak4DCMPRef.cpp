@@ -84,19 +84,22 @@ bool Greenpak4DCMPRef::CommitChanges()
 	if(ncell == NULL)
 		return true;
 
-	if(ncell->HasParameter("REF_VAL"))
-		m_referenceValue = (atoi(ncell->m_parameters["REF_VAL"].c_str()));
+	if(ncell->HasParameter(PARAM_REF_VAL))
+		m_referenceValue = ncell->GetParameter(PARAM_REF_VAL);
 
 	return true;
 }
 
-bool Greenpak4DCMPRef::Load(bool* /*bitstream*/)
+bool Greenpak4DCMPRef::Load(Greenpak4Bitstream& bitstream)
 {
-	LogError("Unimplemented\n");
-	return false;
+	////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+	// CONFIGURATION
+
+	m_referenceValue = bitstream.GetField(m_configBase, 8);
+	return true;
 }
 
-bool Greenpak4DCMPRef::Save(bool* bitstream)
+bool Greenpak4DCMPRef::Save(Greenpak4Bitstream& bitstream)
 {
 	////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 	// CONFIGURATION
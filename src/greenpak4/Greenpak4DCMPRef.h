@@ -34,8 +34,8 @@ public:
 	virtual ~Greenpak4DCMPRef();
 
 	//Serialization
-	virtual bool Load(bool* bitstream);
-	virtual bool Save(bool* bitstream);
+	virtual bool Load(Greenpak4Bitstream& bitstream);
+	virtual bool Save(Greenpak4Bitstream& bitstream);
 
 	virtual std::string GetDescription();
 
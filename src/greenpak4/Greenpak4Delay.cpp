@@ -102,40 +102,63 @@ bool Greenpak4Delay::CommitChanges()
 	{
 		m_mode = RISING_EDGE;
 
-		if(ncell->HasParameter("EDGE_DIRECTION"))
+		if(ncell->HasParameter(PARAM_EDGE_DIRECTION))
 		{
-			string dir = ncell->m_parameters["EDGE_DIRECTION"];
-			if(dir == "RISING")
-				m_mode = RISING_EDGE;
-			else if(dir == "FALLING")
+			int dir = ncell->GetParameter(PARAM_EDGE_DIRECTION);
+			if(dir == CHOICE_FALLING)
 				m_mode = FALLING_EDGE;
-			else if(dir == "BOTH")
+			else if(dir == CHOICE_BOTH)
 				m_mode = BOTH_EDGE;
-			else
-			{
-				LogError("Invalid delay specifier %s (must be one of RISING, FALLING, BOTH)\n", dir.c_str());
-				return false;
-			}
 		}
 	}
 
-	if(ncell->HasParameter("DELAY_STEPS"))
-		m_delayTap = atoi(ncell->m_parameters["DELAY_STEPS"].c_str());
+	if(ncell->HasParameter(PARAM_DELAY_STEPS))
+		m_delayTap = ncell->GetParameter(PARAM_DELAY_STEPS);
 
-	if(ncell->HasParameter("GLITCH_FILTER"))
-		m_glitchFilter = atoi(ncell->m_parameters["GLITCH_FILTER"].c_str()) ? true : false;
+	if(ncell->HasParameter(PARAM_GLITCH_FILTER))
+		m_glitchFilter = ncell->GetParameter(PARAM_GLITCH_FILTER);
 
 	return true;
 }
 
-bool Greenpak4Delay::Load(bool* /*bitstream*/)
+bool Greenpak4Delay::Load(Greenpak4Bitstream& bitstream)
 {
-	//TODO: Do our inputs
-	LogError("Unimplemented\n");
-	return false;
+	////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+	// INPUT BUS
+
+	if(!ReadMatrixSelector(bitstream, m_inputBaseWord, m_input))
+		return false;
+
+	////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+	// CONFIGURATION
+
+	//Mode selector
+	switch(bitstream.GetField(m_configBase + 0, 2))
+	{
+		case 0:
+			m_mode = RISING_EDGE;
+			break;
+
+		case 1:
+			m_mode = FALLING_EDGE;
+			break;
+
+		case 2:
+			m_mode = BOTH_EDGE;
+			break;
+
+		default:
+			m_mode = DELAY;
+			break;
+	}
+
+	m_delayTap = bitstream.GetField(m_configBase + 2, 2) + 1;
+	m_glitchFilter = bitstream[m_configBase + 4];
+
+	return true;
 }
 
-bool Greenpak4Delay::Save(bool* bitstream)
+bool Greenpak4Delay::Save(Greenpak4Bitstream& bitstream)
 {
 	////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 	// INPUT BUS
@@ -187,3 +210,20 @@ bool Greenpak4Delay::Save(bool* bitstream)
 
 	return true;
 }
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Timing model
+
+/**
+	@brief The delay line dominates, at roughly 125 ns per step (edge detectors use it for their pulse width too)
+ */
+unsigned int Greenpak4Delay::GetPropagationDelay(Greenpak4NetlistEntity* entity)
+{
+	//Look at the cell's parameters rather than ours, since we may not be committed (or even assigned) yet
+	unsigned int steps = 1;
+	auto ncell = dynamic_cast<Greenpak4NetlistCell*>(entity);
+	if( (ncell != NULL) && ncell->HasParameter(PARAM_DELAY_STEPS) )
+		steps = ncell->GetParameter(PARAM_DELAY_STEPS);
+
+	return 10000 + 125000*steps;
+}
@@ -34,13 +34,31 @@ public:
 		unsigned int cbase);
 
 	//Serialization
-	virtual bool Load(bool* bitstream);
-	virtual bool Save(bool* bitstream);
+	virtual bool Load(Greenpak4Bitstream& bitstream);
+	virtual bool Save(Greenpak4Bitstream& bitstream);
 
 	virtual ~Greenpak4Delay();
 
 	virtual std::string GetDescription();
 
+	enum modes
+	{
+		DELAY,
+		RISING_EDGE,
+		FALLING_EDGE,
+		BOTH_EDGE
+	};
+
+	//Configuration (for simulation)
+	Greenpak4EntityOutput GetInput()
+	{ return m_input; }
+
+	modes GetMode()
+	{ return m_mode; }
+
+	int GetDelayTap()
+	{ return m_delayTap; }
+
 	virtual void SetInput(std::string port, Greenpak4EntityOutput src);
 	virtual unsigned int GetOutputNetNumber(std::string port);
 
@@ -49,18 +67,14 @@ public:
 
 	virtual bool CommitChanges();
 
+	virtual unsigned int GetPropagationDelay(Greenpak4NetlistEntity* entity);
+
 protected:
 	Greenpak4EntityOutput m_input;
 
 	int m_delayTap;
 
-	enum modes
-	{
-		DELAY,
-		RISING_EDGE,
-		FALLING_EDGE,
-		BOTH_EDGE
-	} m_mode;
+	modes m_mode;
 
 	bool m_glitchFilter;
 };
@@ -17,6 +17,7 @@
  **********************************************************************************************************************/
 
 #include <cassert>
+#include <cstring>
 #include <log.h>
 #include <Greenpak4.h>
 
@@ -34,6 +35,11 @@ Greenpak4Device::Greenpak4Device(
 	, m_disableChargePump(false)
 	, m_ldoBypass(false)
 	, m_nvmLoadRetryCount(1)
+	, m_defaultPull(default_pull)
+	, m_defaultDrive(default_drive)
+	, m_fabricRoutingDelay(1000)
+	, m_crossConnectionDelay(1500)
+	, m_dedicatedRoutingDelay(300)
 {
 	//Create power rails
 	//These have to come first, since all other nodes will refer to these during construction
@@ -52,11 +58,6 @@ Greenpak4Device::Greenpak4Device(
 	m_pwrdet = NULL;
 	m_dcmpmux = NULL;
 	m_spi = NULL;
-	for(int i=0; i<2; i++)
-	{
-		for(int j=0; j<10; j++)
-			m_crossConnections[i][j] = NULL;
-	}
 
 	//Initialize everything
 	switch(part)
@@ -78,6 +79,15 @@ Greenpak4Device::Greenpak4Device(
 		break;
 	}
 
+	//Port lists are final now that everything exists, so number the ports once up front
+	for(auto x : m_bitstuff)
+	{
+		x->BuildPortTables();
+		if(x->GetDual())
+			x->GetDual()->BuildPortTables();
+	}
+	BuildNetTable();
+
 	//Set up pullups/downs on every IOB by default
 	for(auto x : m_iobs)
 	{
@@ -325,8 +335,10 @@ void Greenpak4Device::CreateDevice_SLG46140()
 	m_bitlen = 1024;
 
 	//Initialize matrix base addresses
-	m_matrixBase[0] = 0;
-	m_matrixBase[1] = 0;		//initialize for completeness's sake, but there is no matrix 1
+	//There is only one matrix, so no cross connections
+	m_matrixCount = 1;
+	m_matrixBase.push_back(0);
+	m_crossConnections.resize(1);
 
 	//no cross connections
 
@@ -782,22 +794,25 @@ void Greenpak4Device::CreateDevice_SLG4662x(bool dual_rail)
 	m_bitlen = 2048;
 
 	//Initialize matrix base addresses
-	m_matrixBase[0] = 0;
-	m_matrixBase[1] = 1024;
+	m_matrixCount = 2;
+	m_matrixBase.push_back(0);
+	m_matrixBase.push_back(1024);
 
-	//Create cross connections
+	//Create cross connections, ten each way between the two matrices
+	m_crossConnections.resize(m_matrixCount * m_matrixCount);
 	for(unsigned int matrix=0; matrix<2; matrix++)
 	{
 		for(unsigned int i=0; i<10; i++)
 		{
 			auto cc = new Greenpak4CrossConnection(
 				this,
-				1 - matrix,	//invert, since matrix is OUTPUT location
+				1 - matrix,	//output goes to the other matrix
+				matrix,		//input comes from this one
 				85 + i,		//ibase
 				52 + i,		//oword
 				0			//cbase is invalid, we have no configuration at all
 				);
-			m_crossConnections[matrix][i] = cc;
+			m_crossConnections[matrix*m_matrixCount + (1 - matrix)].push_back(cc);
 		}
 	}
 
@@ -882,11 +897,10 @@ void Greenpak4Device::CreateDevice_common()
 		m_bitstuff.push_back(m_spi);
 
 	//Add cross connections iff we have them
-	if(m_matrixBase[0] != m_matrixBase[1])
+	for(auto& v : m_crossConnections)
 	{
-		for(unsigned int matrix=0; matrix<2; matrix++)
-			for(unsigned int i=0; i<10; i++)
-				m_bitstuff.push_back(m_crossConnections[matrix][i]);
+		for(auto cc : v)
+			m_bitstuff.push_back(cc);
 	}
 }
 
@@ -938,12 +952,138 @@ Greenpak4BitstreamEntity* Greenpak4Device::GetLUT4(unsigned int i)
 
 unsigned int Greenpak4Device::GetMatrixBase(unsigned int matrix)
 {
-	if(matrix > 1)
+	if(matrix >= m_matrixCount)
 		return 0;
 
 	return m_matrixBase[matrix];
 }
 
+/**
+	@brief Returns the table of chip-wide bitstream fields for this part
+ */
+const Greenpak4BitstreamLayout& Greenpak4Device::GetBitstreamLayout()
+{
+	if(m_part == GREENPAK4_SLG46140)
+		return Greenpak4BitstreamLayout::ForSLG46140();
+	return Greenpak4BitstreamLayout::ForSLG4662X();
+}
+
+/**
+	@brief Returns the number of cross connections from one matrix to another (zero if they aren't directly connected)
+ */
+unsigned int Greenpak4Device::GetCrossConnectionCount(unsigned int src_matrix, unsigned int dst_matrix)
+{
+	if( (src_matrix >= m_matrixCount) || (dst_matrix >= m_matrixCount) )
+		return 0;
+
+	return m_crossConnections[src_matrix*m_matrixCount + dst_matrix].size();
+}
+
+/**
+	@brief Returns true if a route from src to the given input port of dst has to go through a cross connection
+	(the way CommitRouting() would do it)
+ */
+bool Greenpak4Device::NeedsCrossConnection(Greenpak4BitstreamEntity* src, Greenpak4BitstreamEntity* dst, uint16_t port)
+{
+	//Dedicated routing doesn't go through the matrices at all
+	if(!dst->IsGeneralFabricInput(port))
+		return false;
+
+	//Same matrix, or a dual we can use instead?
+	if(src->GetMatrix() == dst->GetMatrix())
+		return false;
+	if( (src->GetDual() != NULL) && (src->GetDual()->GetMatrix() == dst->GetMatrix()) )
+		return false;
+
+	return true;
+}
+
+/**
+	@brief Returns false if a route from src to the given input port of dst isn't part of any data path (clocks and
+	constants)
+ */
+bool Greenpak4Device::IsDataRoute(Greenpak4BitstreamEntity* src, Greenpak4BitstreamEntity* dst, uint16_t port)
+{
+	if(dynamic_cast<Greenpak4PowerRail*>(src) != NULL)
+		return false;
+	return !dst->IsClockInput(port);
+}
+
+/**
+	@brief Returns the typical delay (in ps) of a route from src to the given input port of dst
+ */
+unsigned int Greenpak4Device::GetRoutingDelay(
+	Greenpak4BitstreamEntity* src,
+	Greenpak4BitstreamEntity* dst,
+	uint16_t port)
+{
+	if(!dst->IsGeneralFabricInput(port))
+		return m_dedicatedRoutingDelay;
+
+	//Out through one matrix, across, and in through the other
+	if(NeedsCrossConnection(src, dst, port))
+		return 2*m_fabricRoutingDelay + m_crossConnectionDelay;
+
+	return m_fabricRoutingDelay;
+}
+
+Greenpak4CrossConnection* Greenpak4Device::GetCrossConnection(
+	unsigned int src_matrix,
+	unsigned int dst_matrix,
+	unsigned int index)
+{
+	if(index >= GetCrossConnectionCount(src_matrix, dst_matrix))
+		return NULL;
+
+	return m_crossConnections[src_matrix*m_matrixCount + dst_matrix][index];
+}
+
+/**
+	@brief Returns the signal driving a given net of a routing matrix, or one with a NULL source if nothing does
+ */
+Greenpak4EntityOutput Greenpak4Device::GetNetByNumber(unsigned int matrix, unsigned int net)
+{
+	if( (matrix >= m_nets.size()) || (net >= m_nets[matrix].size()) )
+		return Greenpak4EntityOutput();
+
+	return m_nets[matrix][net];
+}
+
+/**
+	@brief Builds the reverse mapping from net numbers to the signals driving them, for reading bitstreams back
+ */
+void Greenpak4Device::BuildNetTable()
+{
+	m_nets.clear();
+	m_nets.resize(m_matrixCount, vector<Greenpak4EntityOutput>(1 << m_matrixBits));
+
+	for(auto x : m_bitstuff)
+	{
+		AddNets(x);
+		if(x->GetDual())
+			AddNets(x->GetDual());
+	}
+}
+
+void Greenpak4Device::AddNets(Greenpak4BitstreamEntity* entity)
+{
+	unsigned int matrix = entity->GetMatrix();
+	if(matrix >= m_matrixCount)
+		return;
+
+	for(auto p : entity->GetOutputPorts())
+	{
+		auto signal = entity->GetOutput(p);
+		unsigned int net = signal.GetNetNumber();
+		if(net >= m_nets[matrix].size())
+			continue;
+
+		//Outputs sharing a net (like Q/nQ of a flipflop) are the same signal, so keep the first
+		if(m_nets[matrix][net].m_src == NULL)
+			m_nets[matrix][net] = signal;
+	}
+}
+
 void Greenpak4Device::SetIOPrecharge(bool precharge)
 {
 	m_ioPrecharge = precharge;
@@ -964,6 +1104,28 @@ void Greenpak4Device::SetNVMRetryCount(int count)
 	m_nvmLoadRetryCount = count;
 }
 
+/**
+	@brief Creates a new configuration layer over this device, for configuring it several ways at once (for example,
+	committing candidate placements in parallel).
+
+	The layer is a device of the same part, with the same global settings and IOB defaults, whose entities are at
+	their power-on defaults. That's the state this device is in until something is committed to it, so nothing else
+	has to be copied. The structure (entity list, routing topology, bitstream layout) is identical, so an entity of
+	the layer can be found at the same index in GetEntity() as ours. Layers share nothing mutable with this device or
+	each other, and may be used from another thread.
+
+	The caller owns the new device.
+ */
+Greenpak4Device* Greenpak4Device::CreateConfigLayer()
+{
+	auto layer = new Greenpak4Device(m_part, m_defaultPull, m_defaultDrive);
+	layer->m_ioPrecharge = m_ioPrecharge;
+	layer->m_disableChargePump = m_disableChargePump;
+	layer->m_ldoBypass = m_ldoBypass;
+	layer->m_nvmLoadRetryCount = m_nvmLoadRetryCount;
+	return layer;
+}
+
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 // File I/O
 
@@ -973,31 +1135,61 @@ void Greenpak4Device::SetNVMRetryCount(int count)
 	@param fname		Name of the file to write to
 	@param userid		ID code to write to the "user ID" area of the bitstream
 	@param readProtect	True to disable readout of the design
+	@param format		Text (one line per bit, for humans) or binary (raw image plus a small header)
  */
-bool Greenpak4Device::WriteToFile(string fname, uint8_t userid, bool readProtect)
+bool Greenpak4Device::WriteToFile(string fname, uint8_t userid, bool readProtect, BitstreamFormat format)
 {
-	//Open the file
-	FILE* fp = fopen(fname.c_str(), "w");
+	string data;
+	if(!WriteToBuffer(data, userid, readProtect, format))
+		return false;
+
+	FILE* fp = fopen(fname.c_str(), (format == FORMAT_BINARY) ? "wb" : "w");
 	if(!fp)
 	{
 		LogError("Couldn't open %s for writing\n", fname.c_str());
 		return false;
 	}
 
+	bool ok = (1 == fwrite(data.c_str(), data.size(), 1, fp));
+	if(fclose(fp) != 0)
+		ok = false;
+	if(!ok)
+		LogError("Couldn't write %s\n", fname.c_str());
+	return ok;
+}
+
+/**
+	@brief Generates the bitstream in memory, in the same format WriteToFile() would write
+
+	@param data			Set to the file contents
+	@param userid		ID code to write to the "user ID" area of the bitstream
+	@param readProtect	True to disable readout of the design
+	@param format		Text (one line per bit, for humans) or binary (raw image plus a small header)
+ */
+bool Greenpak4Device::WriteToBuffer(string& data, uint8_t userid, bool readProtect, BitstreamFormat format)
+{
 	//Allocate the bitstream and initialize to zero
 	//According to phone conversation w Silego FAE, 0 is legal default state for everything incl reserved bits
 	//All IOs will be floating digital inputs
-	bool* bitstream = new bool[m_bitlen];
-	for(unsigned int i=0; i<m_bitlen; i++)
-		bitstream[i] = false;
+	Greenpak4Bitstream bitstream(m_bitlen);
+	if(!SaveBitstream(bitstream, userid, readProtect))
+		return false;
+
+	FormatBitstream(data, bitstream, m_part, userid, readProtect, format);
+	return true;
+}
 
+/**
+	@brief Saves every block, and the chip-wide config, into a bitstream that starts out all zeros
+ */
+bool Greenpak4Device::SaveBitstream(Greenpak4Bitstream& bitstream, uint8_t userid, bool readProtect)
+{
 	//Get the config data from each of our blocks
 	for(auto x : m_bitstuff)
 	{
 		if(!x->Save(bitstream))
 		{
 			LogError("Bitstream node %s failed to save\n", x->GetDescription().c_str());
-			fclose(fp);
 			return false;
 		}
 	}
@@ -1017,175 +1209,448 @@ bool Greenpak4Device::WriteToFile(string fname, uint8_t userid, bool readProtect
 		case GREENPAK4_SLG46620:
 
 			//FIXME: Disable ADC block (until we have the logic for that implemented)
-			bitstream[486] = true;
-			bitstream[487] = true;
-			bitstream[488] = true;
-			bitstream[489] = true;
-			bitstream[490] = true;
-			bitstream[491] = true;
+			bitstream.SetField(SLG4662X_ADC_DISABLE, 0x3f);
 
 			//Force ADC block speed to 100 kHz (all other speeds not supported according to GreenPAK Designer)
 			//TODO: Do this in the ADC class once that exists
-			bitstream[838] = 0;
-			bitstream[839] = 1;
+			bitstream.SetField(SLG4662X_ADC_SPEED, 2);
 
 			//Vref fine tune, magic value from datasheet (TODO do calibration?)
 			//Seems to have been removed from most recent datasheet
-			bitstream[891] = true;
-			bitstream[890] = false;
-			bitstream[889] = false;
-			bitstream[888] = true;
-			bitstream[887] = false;
+			bitstream.SetField(SLG4662X_VREF_FINE_TUNE, 0x12);
 
 			//I/O precharge
-			bitstream[940] = m_ioPrecharge;
+			bitstream.SetField(SLG4662X_IO_PRECHARGE, m_ioPrecharge);
 
 			//Device ID; immutable on the device but added to aid verification
 			//5A: more data to follow
-			bitstream[1016] = false;
-			bitstream[1017] = true;
-			bitstream[1018] = false;
-			bitstream[1019] = true;
-			bitstream[1020] = true;
-			bitstream[1021] = false;
-			bitstream[1022] = true;
-			bitstream[1023] = false;
+			bitstream.SetField(SLG4662X_DEVICE_ID, 0x5a);
 
 			if(m_nvmLoadRetryCount != 1)
 				LogWarning("NVM retry count values other than 1 are not currently supported for SLG4662x\n");
 
 			//Internal LDO disable
-			bitstream[2008] = m_ldoBypass;
+			bitstream.SetField(SLG4662X_LDO_BYPASS, m_ldoBypass);
 
 			//Charge pump disable
-			bitstream[2010] = m_disableChargePump;
+			bitstream.SetField(SLG4662X_CHARGE_PUMP_DISABLE, m_disableChargePump);
 
 			//User ID of the bitstream
-			bitstream[2031] = (userid & 0x01) ? true : false;
-			bitstream[2032] = (userid & 0x02) ? true : false;
-			bitstream[2033] = (userid & 0x04) ? true : false;
-			bitstream[2034] = (userid & 0x08) ? true : false;
-			bitstream[2035] = (userid & 0x10) ? true : false;
-			bitstream[2036] = (userid & 0x20) ? true : false;
-			bitstream[2037] = (userid & 0x40) ? true : false;
-			bitstream[2038] = (userid & 0x80) ? true : false;
+			bitstream.SetField(SLG4662X_PATTERN_ID, userid);
 
 			//Read protection flag
-			bitstream[2039] = readProtect;
+			bitstream.SetField(SLG4662X_READ_PROTECT, readProtect);
 
 			//A5: end of bitstream
-			bitstream[2040] = true;
-			bitstream[2041] = false;
-			bitstream[2042] = true;
-			bitstream[2043] = false;
-			bitstream[2044] = false;
-			bitstream[2045] = true;
-			bitstream[2046] = false;
-			bitstream[2047] = true;
+			bitstream.SetField(SLG4662X_END_MARKER, 0xa5);
 
 			break;
 
 		case GREENPAK4_SLG46140:
 
 			//FIXME: Disable ADC block (until we have the logic for that implemented)
-			bitstream[378] = true;
-			bitstream[379] = true;
-			bitstream[380] = true;
-			bitstream[381] = true;
-			bitstream[383] = true;
-			bitstream[383] = true;
+			bitstream.SetField(SLG46140_ADC_DISABLE, 0x2f);
 
 			//Force ADC block speed to 100 kHz (all other speeds not supported according to GreenPAK Designer)
 			//Note that the SLG46140V datasheet r100 still lists the other speed values, but SLG46620 rev 100 does not.
 			//Furthermore, GreenPAK Designer v6.02 complains about bitstreams generated using 2'b11.
 			//It says "setting speed to 100 kHz" and writes to 2'b10 instead. One of these is wrong, need to ask Silego.
 			//TODO: Do this in the ADC class once that exists
-			bitstream[542] = 1;
-			bitstream[543] = 1;
+			bitstream.SetField(SLG46140_ADC_SPEED, 3);
 
 			//Vref fine tune, magic value from datasheet (TODO do calibration?)
 			//Seems to have been removed from most recent datasheet, used rev 079 for this
-			bitstream[495] = true;
-			bitstream[494] = false;
-			bitstream[493] = false;
-			bitstream[492] = true;
-			bitstream[491] = false;
+			bitstream.SetField(SLG46140_VREF_FINE_TUNE, 0x12);
 
 			//I/O precharge
-			bitstream[760] = m_ioPrecharge;
+			bitstream.SetField(SLG46140_IO_PRECHARGE, m_ioPrecharge);
 
 			//NVM boot retry
-			switch(m_nvmLoadRetryCount)
+			if( (m_nvmLoadRetryCount < 1) || (m_nvmLoadRetryCount > 4) )
 			{
-				case 1:
-					bitstream[995] = false;
-					bitstream[994] = false;
-					break;
-
-				case 2:
-					bitstream[995] = false;
-					bitstream[994] = true;
-					break;
-
-				case 3:
-					bitstream[995] = true;
-					bitstream[994] = false;
-					break;
-
-				case 4:
-					bitstream[995] = true;
-					bitstream[994] = true;
-					break;
-
-				default:
-					LogError("NVM retry count for SLG46140 must be 1...4\n");
-					return false;
+				LogError("NVM retry count for SLG46140 must be 1...4\n");
+				return false;
 			}
+			bitstream.SetField(SLG46140_NVM_RETRY, m_nvmLoadRetryCount - 1);
 
 			//Internal LDO disable
-			bitstream[1003] = m_ldoBypass;
+			bitstream.SetField(SLG46140_LDO_BYPASS, m_ldoBypass);
 
 			//Charge pump disable
-			bitstream[1005] = m_disableChargePump;
+			bitstream.SetField(SLG46140_CHARGE_PUMP_DISABLE, m_disableChargePump);
 
 			//User ID of the bitstream
-			bitstream[1007] = (userid & 0x01) ? true : false;
-			bitstream[1008] = (userid & 0x02) ? true : false;
-			bitstream[1009] = (userid & 0x04) ? true : false;
-			bitstream[1010] = (userid & 0x08) ? true : false;
-			bitstream[1011] = (userid & 0x10) ? true : false;
-			bitstream[1012] = (userid & 0x20) ? true : false;
-			bitstream[1013] = (userid & 0x40) ? true : false;
-			bitstream[1014] = (userid & 0x80) ? true : false;
+			bitstream.SetField(SLG46140_PATTERN_ID, userid);
 
 			//Device ID; immutable on the device but added to aid verification
 			//A5: end of bitstream
-			bitstream[1016] = true;
-			bitstream[1017] = false;
-			bitstream[1018] = true;
-			bitstream[1019] = false;
-			bitstream[1020] = false;
-			bitstream[1021] = true;
-			bitstream[1022] = false;
-			bitstream[1023] = true;
+			bitstream.SetField(SLG46140_END_MARKER, 0xa5);
 
 			break;
 
 		//Invalid device
 		default:
-			LogError("Greenpak4Device: WriteToFile(): unknown device\n");
-			fclose(fp);
-			delete[] bitstream;
+			LogError("Greenpak4Device: SaveBitstream(): unknown device\n");
 			return false;
 	}
 
-	//Write the bitfile
-	fprintf(fp, "index\t\tvalue\t\tcomment\n");
-	for(unsigned int i=0; i<m_bitlen; i++)
-		fprintf(fp, "%u\t\t%d\t\t//\n", i, (int)bitstream[i]);
+	return true;
+}
+
+/**
+	@brief Formats a bitstream as the contents of a bitfile
+
+	The user ID and read protect flag only go in the binary header, the bitstream must already have them set.
+ */
+void Greenpak4Device::FormatBitstream(
+	string& data,
+	const Greenpak4Bitstream& bitstream,
+	GREENPAK4_PART part,
+	uint8_t userid,
+	bool readProtect,
+	BitstreamFormat format)
+{
+	data.clear();
+	if(format == FORMAT_BINARY)
+		WriteBinary(data, bitstream, part, userid, readProtect);
+	else
+	{
+		data = "index\t\tvalue\t\tcomment\n";
+		for(unsigned int i=0; i<bitstream.GetLength(); i++)
+		{
+			char line[64];
+			snprintf(line, sizeof(line), "%u\t\t%d\t\t//\n", i, (int)bitstream.GetBit(i));
+			data += line;
+		}
+	}
+}
+
+/**
+	@brief Returns the part code used in binary bitstream headers
+
+	This is the bitstream coding of the part number, which is also what gpdevboard uses.
+ */
+uint16_t Greenpak4Device::GetPartCode(GREENPAK4_PART part)
+{
+	switch(part)
+	{
+		case GREENPAK4_SLG46140:
+			return 0x140;
+
+		case GREENPAK4_SLG46620:
+			return 0x620;
+
+		case GREENPAK4_SLG46621:
+			return 0x621;
+
+		default:
+			return 0xfff;
+	}
+}
+
+/**
+	@brief Looks up the part a binary bitstream header's part code is for
+
+	@return False if it isn't one we know
+ */
+bool Greenpak4Device::GetPartFromCode(uint16_t code, GREENPAK4_PART& part)
+{
+	for(auto p : { GREENPAK4_SLG46140, GREENPAK4_SLG46620, GREENPAK4_SLG46621 })
+	{
+		if(GetPartCode(p) == code)
+		{
+			part = p;
+			return true;
+		}
+	}
+	return false;
+}
 
-	//Done
-	delete[] bitstream;
+/**
+	@brief Computes the content hash stored in binary bitstream headers (32-bit FNV-1a of the image)
+ */
+uint32_t Greenpak4Device::HashBitstreamImage(const uint8_t* image, unsigned int len)
+{
+	uint32_t hash = 0x811c9dc5;
+	for(unsigned int i=0; i<len; i++)
+		hash = (hash ^ image[i]) * 0x01000193;
+	return hash;
+}
+
+/**
+	@brief Formats a binary bitstream: a 16-byte header followed by the raw device image
+
+	All multi-byte header fields are little endian.
+		0	"GP4B"
+		4	Format version (currently 1)
+		5	Flags (bit 0 = read protect)
+		6	Part code (see GetPartCode())
+		8	Image length in bytes
+		10	User ID
+		11	Reserved, always zero
+		12	Hash of the image (see HashBitstreamImage())
+		16	Image (bit N in bit N%8 of byte N/8, the same order the device and dev board use)
+ */
+void Greenpak4Device::WriteBinary(
+	string& data,
+	const Greenpak4Bitstream& bitstream,
+	GREENPAK4_PART devpart,
+	uint8_t userid,
+	bool readProtect)
+{
+	vector<uint8_t> image;
+	bitstream.GetBytes(image);
+
+	uint16_t part = GetPartCode(devpart);
+	uint16_t len = image.size();
+	uint32_t hash = HashBitstreamImage(&image[0], len);
+
+	uint8_t header[16] =
+	{
+		'G', 'P', '4', 'B',
+		1,
+		static_cast<uint8_t>(readProtect ? 1 : 0),
+		static_cast<uint8_t>(part & 0xff), static_cast<uint8_t>(part >> 8),
+		static_cast<uint8_t>(len & 0xff), static_cast<uint8_t>(len >> 8),
+		userid,
+		0,
+		static_cast<uint8_t>(hash & 0xff), static_cast<uint8_t>(hash >> 8),
+		static_cast<uint8_t>(hash >> 16), static_cast<uint8_t>(hash >> 24)
+	};
+
+	data.append(reinterpret_cast<const char*>(header), sizeof(header));
+	data.append(reinterpret_cast<const char*>(&image[0]), len);
+}
+
+
+/**
+	@brief Reads a bitstream from a file, and configures every block in the device to match it
+
+	This is the inverse of WriteToFile(). Routing is restored by pointing each input at whatever drives the selected
+	net, so entities end up connected exactly as they would be right before Save().
+
+	@param fname		Name of the file to read from
+	@param userid		Set to the ID code in the "user ID" area of the bitstream
+	@param readProtect	Set to true if readout of the design is disabled
+ */
+bool Greenpak4Device::LoadFromFile(string fname, uint8_t& userid, bool& readProtect)
+{
+	Greenpak4Bitstream bitstream(m_bitlen);
+	if(!ReadBitstream(fname, bitstream))
+		return false;
+
+	//Decode chip-wide config, and make sure the bitstream is actually for this part
+	if(!LoadGlobalConfig(bitstream, userid, readProtect))
+		return false;
+
+	//Configure each of our blocks
+	bool ok = true;
+	for(auto x : m_bitstuff)
+	{
+		if(!x->Load(bitstream))
+		{
+			LogError("Bitstream node %s failed to load\n", x->GetDescription().c_str());
+			ok = false;
+		}
+	}
+
+	return ok;
+}
+
+/**
+	@brief Reads a bitfile (text or binary, going by its magic number) into a bitstream
+ */
+bool Greenpak4Device::ReadBitstream(string fname, Greenpak4Bitstream& bitstream)
+{
+	//Open the file
+	FILE* fp = fopen(fname.c_str(), "rb");
+	if(!fp)
+	{
+		LogError("Couldn't open %s for reading\n", fname.c_str());
+		return false;
+	}
+
+	//Binary bitstreams start with a magic number, anything else had better be text
+	char magic[4] = {0};
+	bool binary = (fread(magic, 1, 4, fp) == 4) && !memcmp(magic, "GP4B", 4);
+	rewind(fp);
+
+	bool ok = binary ? LoadBinaryFile(fp, fname, bitstream) : LoadTextFile(fp, fname, bitstream);
 	fclose(fp);
+	return ok;
+}
+
+/**
+	@brief Reads a text bitstream (one "index value" line per bit, after a header line)
+ */
+bool Greenpak4Device::LoadTextFile(FILE* fp, string fname, Greenpak4Bitstream& bitstream)
+{
+	//Skip the header line
+	char line[256];
+	if(!fgets(line, sizeof(line), fp))
+	{
+		LogError("%s is empty\n", fname.c_str());
+		return false;
+	}
+
+	//Read the bits. Every bit starts out zero, so missing lines are OK
+	while(fgets(line, sizeof(line), fp))
+	{
+		unsigned int index;
+		int value;
+		if(2 != sscanf(line, "%u %d", &index, &value))
+			continue;
+
+		if(index >= m_bitlen)
+		{
+			LogError("%s: bit index %u is out of range (bitstream is %u bits long)\n",
+				fname.c_str(), index, m_bitlen);
+			return false;
+		}
+
+		bitstream[index] = (value != 0);
+	}
+
+	return true;
+}
+
+/**
+	@brief Validates a binary bitstream (see WriteBinary() for the format) and finds the image in it
+
+	Only the header and the image hash are checked, it's up to the caller whether the part and image length suit it.
+	gpdevboard uses this too, so what gp4par writes and what gets programmed always agree on the format.
+
+	@param data		The whole file
+	@param len		Length of the file
+	@param fname	Name of the file, for error messages
+	@param part		Part code from the header
+	@param image	Set to point at the image, within data
+	@param imagelen	Length of the image
+
+	@return True if it's a valid binary bitstream
+ */
+bool Greenpak4Device::ParseBinaryHeader(
+	const uint8_t* data,
+	size_t len,
+	string fname,
+	uint16_t& part,
+	const uint8_t*& image,
+	unsigned int& imagelen)
+{
+	if( (len < 16) || memcmp(data, "GP4B", 4) )
+	{
+		LogError("%s: not a binary GreenPAK bitstream\n", fname.c_str());
+		return false;
+	}
+
+	if(data[4] != 1)
+	{
+		LogError("%s: unsupported binary bitstream version %d\n", fname.c_str(), data[4]);
+		return false;
+	}
+
+	part = data[6] | (data[7] << 8);
+	imagelen = data[8] | (data[9] << 8);
+	if(len < 16 + imagelen)
+	{
+		LogError("%s: truncated bitstream image\n", fname.c_str());
+		return false;
+	}
+
+	image = data + 16;
+	uint32_t hash = data[12] | (data[13] << 8) | (data[14] << 16) | (static_cast<uint32_t>(data[15]) << 24);
+	if(hash != HashBitstreamImage(image, imagelen))
+	{
+		LogError("%s: bitstream image is corrupted (hash mismatch)\n", fname.c_str());
+		return false;
+	}
+
+	return true;
+}
+
+/**
+	@brief Reads a binary bitstream (see WriteBinary() for the format)
+
+	The user ID and read protect flag in the header are only informational, the copies in the image itself win.
+ */
+bool Greenpak4Device::LoadBinaryFile(FILE* fp, string fname, Greenpak4Bitstream& bitstream)
+{
+	//Read the whole thing, it's small
+	vector<uint8_t> data;
+	uint8_t chunk[4096];
+	size_t len;
+	while( (len = fread(chunk, 1, sizeof(chunk), fp)) > 0)
+		data.insert(data.end(), chunk, chunk + len);
+
+	uint16_t part;
+	const uint8_t* image;
+	unsigned int imagelen;
+	if(!ParseBinaryHeader(&data[0], data.size(), fname, part, image, imagelen))
+		return false;
+
+	if(part != GetPartCode())
+	{
+		LogError("%s: bitstream is for part code %x, not %x\n", fname.c_str(), part, GetPartCode());
+		return false;
+	}
+
+	if(imagelen != (m_bitlen + 7) / 8)
+	{
+		LogError("%s: image is %u bytes, expected %u\n", fname.c_str(), imagelen, (m_bitlen + 7) / 8);
+		return false;
+	}
+
+	bitstream.SetBytes(image, imagelen);
+	return true;
+}
+
+/**
+	@brief Reads back the chip-wide tuning data and ID codes written by WriteToFile()
+ */
+bool Greenpak4Device::LoadGlobalConfig(Greenpak4Bitstream& bitstream, uint8_t& userid, bool& readProtect)
+{
+	switch(m_part)
+	{
+		case GREENPAK4_SLG46620:
+		case GREENPAK4_SLG46621:
+
+			if( (bitstream.GetField(SLG4662X_DEVICE_ID) != 0x5a) || (bitstream.GetField(SLG4662X_END_MARKER) != 0xa5) )
+			{
+				LogError("Bitstream is not for a SLG4662x (bad device ID)\n");
+				return false;
+			}
+
+			m_ioPrecharge = bitstream.GetField(SLG4662X_IO_PRECHARGE);
+			m_nvmLoadRetryCount = 1;
+			m_ldoBypass = bitstream.GetField(SLG4662X_LDO_BYPASS);
+			m_disableChargePump = bitstream.GetField(SLG4662X_CHARGE_PUMP_DISABLE);
+			userid = bitstream.GetField(SLG4662X_PATTERN_ID);
+			readProtect = bitstream.GetField(SLG4662X_READ_PROTECT);
+			break;
+
+		case GREENPAK4_SLG46140:
+
+			if(bitstream.GetField(SLG46140_END_MARKER) != 0xa5)
+			{
+				LogError("Bitstream is not for a SLG46140 (bad device ID)\n");
+				return false;
+			}
+
+			m_ioPrecharge = bitstream.GetField(SLG46140_IO_PRECHARGE);
+			m_nvmLoadRetryCount = 1 + bitstream.GetField(SLG46140_NVM_RETRY);
+			m_ldoBypass = bitstream.GetField(SLG46140_LDO_BYPASS);
+			m_disableChargePump = bitstream.GetField(SLG46140_CHARGE_PUMP_DISABLE);
+			userid = bitstream.GetField(SLG46140_PATTERN_ID);
+
+			//no read protection on this part
+			readProtect = false;
+			break;
+
+		//Invalid device
+		default:
+			LogError("Greenpak4Device: LoadFromFile(): unknown device\n");
+			return false;
+	}
+
 	return true;
 }
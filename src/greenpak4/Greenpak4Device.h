@@ -44,8 +44,48 @@ public:
 
 	virtual ~Greenpak4Device();
 
-	//Write to a bitfile
-	bool WriteToFile(std::string fname, uint8_t userid, bool readProtect);
+	enum BitstreamFormat
+	{
+		FORMAT_TEXT,
+		FORMAT_BINARY
+	};
+
+	//Write to a bitfile (or a buffer containing what the file would)
+	bool WriteToFile(std::string fname, uint8_t userid, bool readProtect, BitstreamFormat format = FORMAT_TEXT);
+	bool WriteToBuffer(std::string& data, uint8_t userid, bool readProtect, BitstreamFormat format = FORMAT_TEXT);
+
+	//Read back from a bitfile
+	bool LoadFromFile(std::string fname, uint8_t& userid, bool& readProtect);
+
+	//Save the device into a bitstream, and format a bitstream as a bitfile
+	bool SaveBitstream(Greenpak4Bitstream& bitstream, uint8_t userid, bool readProtect);
+	static void FormatBitstream(
+		std::string& data,
+		const Greenpak4Bitstream& bitstream,
+		GREENPAK4_PART part,
+		uint8_t userid,
+		bool readProtect,
+		BitstreamFormat format);
+
+	//Read the raw bits of a bitfile without decoding them
+	bool ReadBitstream(std::string fname, Greenpak4Bitstream& bitstream);
+
+	unsigned int GetBitLength()
+	{ return m_bitlen; }
+
+	const Greenpak4BitstreamLayout& GetBitstreamLayout();
+
+	//Binary bitstream header fields
+	static uint16_t GetPartCode(GREENPAK4_PART part);
+	static bool GetPartFromCode(uint16_t code, GREENPAK4_PART& part);
+	static uint32_t HashBitstreamImage(const uint8_t* image, unsigned int len);
+	static bool ParseBinaryHeader(
+		const uint8_t* data,
+		size_t len,
+		std::string fname,
+		uint16_t& part,
+		const uint8_t*& image,
+		unsigned int& imagelen);
 
 	GREENPAK4_PART GetPart()
 	{ return m_part; }
@@ -88,10 +128,19 @@ public:
 	unsigned int GetMatrixBits()
 	{ return m_matrixBits; }
 
+	unsigned int GetMatrixCount()
+	{ return m_matrixCount; }
+
 	unsigned int GetMatrixBase(unsigned int matrix);
 
-	Greenpak4CrossConnection* GetCrossConnection(unsigned int src_matrix, unsigned int index)
-	{ return m_crossConnections[src_matrix][index]; }
+	unsigned int GetCrossConnectionCount(unsigned int src_matrix, unsigned int dst_matrix);
+	Greenpak4CrossConnection* GetCrossConnection(unsigned int src_matrix, unsigned int dst_matrix, unsigned int index);
+
+	bool NeedsCrossConnection(Greenpak4BitstreamEntity* src, Greenpak4BitstreamEntity* dst, uint16_t port);
+	bool IsDataRoute(Greenpak4BitstreamEntity* src, Greenpak4BitstreamEntity* dst, uint16_t port);
+	unsigned int GetRoutingDelay(Greenpak4BitstreamEntity* src, Greenpak4BitstreamEntity* dst, uint16_t port);
+
+	Greenpak4EntityOutput GetNetByNumber(unsigned int matrix, unsigned int net);
 
 	////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 	// LUTS
@@ -323,11 +372,27 @@ public:
 
 	void SetNVMRetryCount(int count);
 
+	Greenpak4Device* CreateConfigLayer();
+
 protected:
 
 	void CreateDevice_SLG46140();
 	void CreateDevice_SLG4662x(bool dual_rail);
 	void CreateDevice_common();
+	void BuildNetTable();
+	void AddNets(Greenpak4BitstreamEntity* entity);
+	bool LoadGlobalConfig(Greenpak4Bitstream& bitstream, uint8_t& userid, bool& readProtect);
+	static void WriteBinary(
+		std::string& data,
+		const Greenpak4Bitstream& bitstream,
+		GREENPAK4_PART part,
+		uint8_t userid,
+		bool readProtect);
+	bool LoadBinaryFile(FILE* fp, std::string fname, Greenpak4Bitstream& bitstream);
+	bool LoadTextFile(FILE* fp, std::string fname, Greenpak4Bitstream& bitstream);
+
+	uint16_t GetPartCode()
+	{ return GetPartCode(m_part); }
 
 	///The part number
 	GREENPAK4_PART m_part;
@@ -441,18 +506,29 @@ protected:
 	///Power detector
 	Greenpak4PowerDetector* m_pwrdet;
 
+	///Number of routing matrices
+	unsigned int m_matrixCount;
+
 	/**
 		@brief Cross-connections between our matrices
 
-		connections[i][j] is the j'th connection from matrix i to (i+1) mod 2
+		m_crossConnections[src*m_matrixCount + dst][j] is the j'th connection from matrix src to matrix dst.
+		Pairs of matrices with no direct connections (including each matrix to itself) have an empty list.
 	 */
-	Greenpak4CrossConnection* m_crossConnections[2][10];
+	std::vector< std::vector<Greenpak4CrossConnection*> > m_crossConnections;
 
 	//Total bitfile length
 	unsigned int m_bitlen;
 
 	//Base address of each routing matrix
-	unsigned int m_matrixBase[2];
+	std::vector<unsigned int> m_matrixBase;
+
+	/**
+		@brief The signal driving each net of each routing matrix, indexed [matrix][net]
+
+		Only used for reading bitstreams back. Nets nothing drives have a NULL source.
+	 */
+	std::vector< std::vector<Greenpak4EntityOutput> > m_nets;
 
 	/**
 		@brief Indicates whether I/O pin precharge should be enabled.
@@ -481,6 +557,19 @@ protected:
 		@brief Number of times to attempt re-reading NVM in case of boot failure
 	 */
 	int m_nvmLoadRetryCount;
+
+	///Pull direction and strength every IOB starts out with
+	Greenpak4IOB::PullDirection m_defaultPull;
+	Greenpak4IOB::PullStrength m_defaultDrive;
+
+	///Typical delay (in ps) through one routing matrix
+	unsigned int m_fabricRoutingDelay;
+
+	///Typical extra delay (in ps) of going through a cross connection, on top of both matrices
+	unsigned int m_crossConnectionDelay;
+
+	///Typical delay (in ps) of dedicated routing, which bypasses the matrices
+	unsigned int m_dedicatedRoutingDelay;
 };
 
 #endif
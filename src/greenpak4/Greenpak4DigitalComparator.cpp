@@ -140,25 +140,83 @@ bool Greenpak4DigitalComparator::CommitChanges()
 		return false;
 	}
 
-	if(ncell->HasParameter("CLK_EDGE"))
-		m_clockInvert = (ncell->m_parameters["CLK_EDGE"] == "FALLING") ? true : false;
+	if(ncell->HasParameter(PARAM_CLK_EDGE))
+		m_clockInvert = (ncell->GetParameter(PARAM_CLK_EDGE) == CHOICE_FALLING);
 
-	if(ncell->HasParameter("PWRDN_SYNC"))
-		m_pdSync = atoi(ncell->m_parameters["PWRDN_SYNC"].c_str()) ? true : false;
+	if(ncell->HasParameter(PARAM_PWRDN_SYNC))
+		m_pdSync = ncell->GetParameter(PARAM_PWRDN_SYNC);
 
-	if(ncell->HasParameter("GREATER_OR_EQUAL"))
-		m_compareGreaterEqual = atoi(ncell->m_parameters["GREATER_OR_EQUAL"].c_str()) ? true : false;
+	if(ncell->HasParameter(PARAM_GREATER_OR_EQUAL))
+		m_compareGreaterEqual = ncell->GetParameter(PARAM_GREATER_OR_EQUAL);
 
 	return true;
 }
 
-bool Greenpak4DigitalComparator::Load(bool* /*bitstream*/)
+bool Greenpak4DigitalComparator::Load(Greenpak4Bitstream& bitstream)
 {
-	LogError("Unimplemented\n");
-	return false;
+	////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+	// INPUT BUS
+
+	if(!ReadMatrixSelector(bitstream, m_inputBaseWord, m_powerDown))
+		return false;
+
+	////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+	// CONFIGURATION
+
+	m_pwmDeadband = (bitstream.GetField(m_configBase + 0, 3) + 1) * 10;
+	m_compareGreaterEqual = bitstream[m_configBase + 3];
+	m_dcmpMode = bitstream[m_configBase + 4];
+	m_clockInvert = bitstream[m_configBase + 6];
+
+	unsigned int cbase = m_configBase + 7;
+	if(m_cmpNum == 0)
+	{
+		m_pdSync = bitstream[m_configBase + 7];
+		cbase ++;
+	}
+
+	//Save() leaves the clock and input selectors zero if we're unused, which is also a legal configuration.
+	//Only decode them if the enable bit says we're actually doing something.
+	m_clock = m_device->GetGround();
+	for(int i=0; i<8; i++)
+	{
+		m_inp[i] = m_device->GetGround();
+		m_inn[i] = m_device->GetGround();
+	}
+	if(!bitstream[cbase + 0])
+		return true;
+
+	//Input clock source (clkbuf5 = 0, clkbuf2 = 1)
+	unsigned int nbuf = bitstream[m_configBase + 5] ? 2 : 5;
+	for(unsigned int i=0; i<m_device->GetClockBufferCount(); i++)
+	{
+		auto ck = m_device->GetClockBuffer(i);
+		if(ck->GetBufferNumber() == nbuf)
+			m_clock = ck->GetOutput("OUT");
+	}
+
+	//The mux tables only have one entry per source, and Save() wants all 8 bits to come from it
+	unsigned int psel = bitstream.GetField(cbase + 1, 2);
+	for(auto it : m_inpsels)
+	{
+		if(it.second != psel)
+			continue;
+		for(int i=0; i<8; i++)
+			m_inp[i] = it.first;
+	}
+	unsigned int nsel = bitstream.GetField(cbase + 3, 2);
+	for(auto it : m_innsels)
+	{
+		if(it.second != nsel)
+			continue;
+		for(int i=0; i<8; i++)
+			m_inn[i] = it.first;
+	}
+
+	return true;
 }
 
-bool Greenpak4DigitalComparator::Save(bool* bitstream)
+bool Greenpak4DigitalComparator::Save(Greenpak4Bitstream& bitstream)
 {
 	////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 	// INPUT BUS
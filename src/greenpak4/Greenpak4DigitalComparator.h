@@ -37,8 +37,8 @@ public:
 	virtual ~Greenpak4DigitalComparator();
 
 	//Serialization
-	virtual bool Load(bool* bitstream);
-	virtual bool Save(bool* bitstream);
+	virtual bool Load(Greenpak4Bitstream& bitstream);
+	virtual bool Save(Greenpak4Bitstream& bitstream);
 
 	virtual std::string GetDescription();
 
@@ -56,6 +56,12 @@ public:
 	void AddInputNMuxEntry(Greenpak4EntityOutput net, unsigned int sel)
 	{ m_innsels[net] = sel; }
 
+	Greenpak4EntityOutput GetInputP(unsigned int i)
+	{ return m_inp[i]; }
+
+	Greenpak4EntityOutput GetInputN(unsigned int i)
+	{ return m_inn[i]; }
+
 protected:
 	Greenpak4EntityOutput m_powerDown;
 	Greenpak4EntityOutput m_inp[8];
@@ -82,12 +82,12 @@ bool Greenpak4DualEntity::CommitChanges()
 	return true;
 }
 
-bool Greenpak4DualEntity::Load(bool* /*bitstream*/)
+bool Greenpak4DualEntity::Load(Greenpak4Bitstream& /*bitstream*/)
 {
 	return true;
 }
 
-bool Greenpak4DualEntity::Save(bool* /*bitstream*/)
+bool Greenpak4DualEntity::Save(Greenpak4Bitstream& /*bitstream*/)
 {
 	return true;
 }
@@ -129,22 +129,64 @@ bool Greenpak4Flipflop::CommitChanges()
 	if(ncell->m_type[ncell->m_type.length()-1] == 'I')
 		m_outputInvert = true;
 
-	if(ncell->HasParameter("SRMODE"))
-		m_srmode = (ncell->m_parameters["SRMODE"] == "1");
+	if(ncell->HasParameter(PARAM_SRMODE))
+		m_srmode = ncell->GetParameter(PARAM_SRMODE);
 
-	if(ncell->HasParameter("INIT"))
-		m_initValue = (ncell->m_parameters["INIT"] == "1");
+	if(ncell->HasParameter(PARAM_INIT))
+		m_initValue = ncell->GetParameter(PARAM_INIT);
 
 	return true;
 }
 
-bool Greenpak4Flipflop::Load(bool* /*bitstream*/)
+bool Greenpak4Flipflop::Load(Greenpak4Bitstream& bitstream)
 {
-	LogError("Unimplemented\n");
-	return false;
+	////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+	// INPUT BUS
+
+	if(m_hasSR)
+	{
+		Greenpak4EntityOutput sr;
+		if(!ReadMatrixSelector(bitstream, m_inputBaseWord + 0, sr))
+			return false;
+		if(!ReadMatrixSelector(bitstream, m_inputBaseWord + 1, m_input))
+			return false;
+		if(!ReadMatrixSelector(bitstream, m_inputBaseWord + 2, m_clock))
+			return false;
+
+		//Save() ties set/reset to a constant when it's not used (ground if we're totally unused, otherwise power).
+		//Either way, that means no set/reset.
+		if(sr.IsPowerRail())
+			m_nsr = m_device->GetPower();
+		else
+			m_nsr = sr;
+	}
+
+	else
+	{
+		if(!ReadMatrixSelector(bitstream, m_inputBaseWord + 0, m_input))
+			return false;
+		if(!ReadMatrixSelector(bitstream, m_inputBaseWord + 1, m_clock))
+			return false;
+	}
+
+	////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+	// Configuration
+
+	m_latchMode = bitstream[m_configBase + 0];
+	m_outputInvert = bitstream[m_configBase + 1];
+
+	if(m_hasSR)
+	{
+		m_srmode = bitstream[m_configBase + 2];
+		m_initValue = bitstream[m_configBase + 3];
+	}
+	else
+		m_initValue = bitstream[m_configBase + 2];
+
+	return true;
 }
 
-bool Greenpak4Flipflop::Save(bool* bitstream)
+bool Greenpak4Flipflop::Save(Greenpak4Bitstream& bitstream)
 {
 	//Sanity check: cannot have set/reset on a DFF, only a DFFSR
 	bool has_sr = !m_nsr.IsPowerRail();
@@ -215,3 +257,18 @@ bool Greenpak4Flipflop::Save(bool* bitstream)
 	return true;
 }
 
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Timing model
+
+/**
+	@brief Clock to output delay
+ */
+unsigned int Greenpak4Flipflop::GetPropagationDelay(Greenpak4NetlistEntity* /*entity*/)
+{
+	return 9000;
+}
+
+bool Greenpak4Flipflop::IsSequential(Greenpak4NetlistEntity* /*entity*/)
+{
+	return true;
+}
@@ -41,8 +41,8 @@ public:
 	{ return m_hasSR; }
 
 	//Serialization
-	virtual bool Load(bool* bitstream);
-	virtual bool Save(bool* bitstream);
+	virtual bool Load(Greenpak4Bitstream& bitstream);
+	virtual bool Save(Greenpak4Bitstream& bitstream);
 
 	//Set inputs
 
@@ -51,6 +51,28 @@ public:
 
 	virtual std::string GetDescription();
 
+	//Configuration (for simulation)
+	Greenpak4EntityOutput GetInput()
+	{ return m_input; }
+
+	Greenpak4EntityOutput GetClock()
+	{ return m_clock; }
+
+	Greenpak4EntityOutput GetSetReset()
+	{ return m_nsr; }
+
+	bool GetInitValue()
+	{ return m_initValue; }
+
+	bool GetSetResetMode()
+	{ return m_srmode; }
+
+	bool IsOutputInverted()
+	{ return m_outputInvert; }
+
+	bool IsLatch()
+	{ return m_latchMode; }
+
 	virtual void SetInput(std::string port, Greenpak4EntityOutput src);
 	virtual unsigned int GetOutputNetNumber(std::string port);
 
@@ -59,6 +81,9 @@ public:
 
 	virtual bool CommitChanges();
 
+	virtual unsigned int GetPropagationDelay(Greenpak4NetlistEntity* entity);
+	virtual bool IsSequential(Greenpak4NetlistEntity* entity);
+
 protected:
 
 	///Index of our flipflop
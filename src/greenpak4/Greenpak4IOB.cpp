@@ -44,6 +44,7 @@ Greenpak4IOB::Greenpak4IOB(
 	, m_outputSignal(device->GetGround())
 	, m_flags(flags)
 	, m_analogConfigBase(0)
+	, m_analogOutput(device->GetGround())
 {
 
 }
@@ -219,6 +220,16 @@ void Greenpak4IOB::SetInput(string port, Greenpak4EntityOutput src)
 	//ignore anything else silently (should not be possible since synthesis would error out)
 }
 
+/**
+	@brief Gets the analog block driving our pin (ground if it's a digital output)
+ */
+Greenpak4EntityOutput Greenpak4IOB::GetAnalogOutput()
+{
+	if(m_outputSignal.IsVoltageReference() || m_outputSignal.IsDAC() || m_outputSignal.IsPGA())
+		return m_outputSignal;
+	return m_analogOutput;
+}
+
 unsigned int Greenpak4IOB::GetOutputNetNumber(string port)
 {
 	if(port == "OUT")
@@ -241,3 +252,87 @@ vector<string> Greenpak4IOB::GetOutputPorts() const
 	r.push_back("OUT");
 	return r;
 }
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Load helpers
+
+/**
+	@brief Reads the 2-bit input threshold field (and the Schmitt trigger flag sharing it) starting at base
+ */
+void Greenpak4IOB::LoadInputThreshold(Greenpak4Bitstream& bitstream, unsigned int base)
+{
+	m_schmittTrigger = false;
+
+	if(!bitstream[base + 1])
+	{
+		m_inputThreshold = THRESHOLD_NORMAL;
+		m_schmittTrigger = bitstream[base + 0];
+	}
+	else if(bitstream[base + 0])
+		m_inputThreshold = THRESHOLD_ANALOG;
+	else
+		m_inputThreshold = THRESHOLD_LOW;
+}
+
+/**
+	@brief Reads the 2-bit pull strength field starting at base, and the direction bit after it
+ */
+void Greenpak4IOB::LoadPull(Greenpak4Bitstream& bitstream, unsigned int base)
+{
+	switch(bitstream.GetField(base, 2))
+	{
+		case 0:
+			m_pullDirection = PULL_NONE;
+			return;
+
+		case 1:
+			m_pullStrength = PULL_10K;
+			break;
+
+		case 2:
+			m_pullStrength = PULL_100K;
+			break;
+
+		default:
+			m_pullStrength = PULL_1M;
+			break;
+	}
+
+	m_pullDirection = bitstream[base + 2] ? PULL_UP : PULL_DOWN;
+}
+
+/**
+	@brief Reads the 2-bit analog output selector (if we have one), and finds the block it selects
+ */
+void Greenpak4IOB::LoadAnalogOutput(Greenpak4Bitstream& bitstream)
+{
+	m_analogOutput = m_device->GetGround();
+	if(m_analogConfigBase == 0)
+		return;
+
+	//SLG4662x: pin 19 is fed by VREF0/1 and DAC0, pin 18 by VREF2/3 and DAC1
+	unsigned int side = (m_pinNumber == 19) ? 0 : 1;
+	unsigned int sel = bitstream.GetField(m_analogConfigBase, 2);
+	if(sel == 3)
+	{
+		if(side < m_device->GetDACCount())
+			m_analogOutput = m_device->GetDAC(side)->GetOutput("VOUT");
+	}
+	else if(sel != 0)
+	{
+		unsigned int ref = side*2 + sel - 1;
+		if(ref < m_device->GetVrefCount())
+			m_analogOutput = m_device->GetVref(ref)->GetOutput("VOUT");
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Timing model
+
+/**
+	@brief Delay through the input or output buffer (we don't distinguish, they're about the same)
+ */
+unsigned int Greenpak4IOB::GetPropagationDelay(Greenpak4NetlistEntity* /*entity*/)
+{
+	return 10000;
+}
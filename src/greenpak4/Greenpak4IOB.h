@@ -115,6 +115,8 @@ public:
 
 	virtual bool CommitChanges();
 
+	virtual unsigned int GetPropagationDelay(Greenpak4NetlistEntity* entity);
+
 	//Used to set defaults in Greenpak4Device constructor
 	void SetPullDirection(PullDirection dir)
 	{ m_pullDirection = dir; }
@@ -129,11 +131,27 @@ public:
 	Greenpak4EntityOutput GetOutputSignal()
 	{ return m_outputSignal; }
 
+	Greenpak4EntityOutput GetOutputEnable()
+	{ return m_outputEnable; }
+
+	Greenpak4EntityOutput GetAnalogOutput();
+
+	PullDirection GetPullDirection()
+	{ return m_pullDirection; }
+
+	DriveType GetDriveType()
+	{ return m_driveType; }
+
 	bool IsAnalogIbuf()
 	{ return (m_inputThreshold == THRESHOLD_ANALOG); }
 
 protected:
 
+	//Decoders for the fields both IOB types lay out the same way
+	void LoadInputThreshold(Greenpak4Bitstream& bitstream, unsigned int base);
+	void LoadPull(Greenpak4Bitstream& bitstream, unsigned int base);
+	void LoadAnalogOutput(Greenpak4Bitstream& bitstream);
+
 	////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 	// Abstracted version of format-dependent bitstream state
 
@@ -169,6 +187,9 @@ protected:
 
 	///Second configuration base for analog output
 	unsigned int m_analogConfigBase;
+
+	///Analog block driving our pin, as recovered from a bitstream (m_outputSignal is ground then)
+	Greenpak4EntityOutput m_analogOutput;
 };
 
 #endif
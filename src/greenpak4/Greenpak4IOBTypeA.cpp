@@ -55,14 +55,52 @@ string Greenpak4IOBTypeA::GetDescription()
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 // Serialization
 
-bool Greenpak4IOBTypeA::Load(bool* /*bitstream*/)
+bool Greenpak4IOBTypeA::Load(Greenpak4Bitstream& bitstream)
 {
-	//TODO
-	LogError("Unimplemented\n");
-	return false;
+	////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+	// INPUT BUS
+
+	//Input-only pins have no driver inputs, and must have OE tied low
+	m_outputEnable = m_device->GetGround();
+	m_outputSignal = m_device->GetGround();
+
+	//Analog outputs float the digital driver, so they read back as a grounded digital output
+	//(see LoadAnalogOutput() for the analog side)
+	if(! (m_flags & IOB_FLAG_INPUTONLY) )
+	{
+		if(!ReadMatrixSelector(bitstream, m_inputBaseWord, m_outputSignal))
+			return false;
+		if(!ReadMatrixSelector(bitstream, m_inputBaseWord+1, m_outputEnable))
+			return false;
+	}
+
+	////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+	// CONFIGURATION
+
+	LoadInputThreshold(bitstream, m_configBase);
+	LoadAnalogOutput(bitstream);
+
+	unsigned int base = m_configBase + 2;
+	if(! (m_flags & IOB_FLAG_INPUTONLY) )
+	{
+		if(!bitstream[m_configBase+2])
+			m_driveStrength = DRIVE_1X;
+		else if( (m_flags & IOB_FLAG_X4DRIVE) && bitstream[m_configBase+7] )
+			m_driveStrength = DRIVE_4X;
+		else
+			m_driveStrength = DRIVE_2X;
+
+		m_driveType = bitstream[m_configBase+3] ? DRIVE_NMOS_OPENDRAIN : DRIVE_PUSHPULL;
+
+		base += 2;
+	}
+
+	LoadPull(bitstream, base);
+
+	return true;
 }
 
-bool Greenpak4IOBTypeA::Save(bool* bitstream)
+bool Greenpak4IOBTypeA::Save(Greenpak4Bitstream& bitstream)
 {
 	////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 	// INPUT BUS
@@ -87,7 +125,8 @@ bool Greenpak4IOBTypeA::Save(bool* bitstream)
 	else
 	{
 		//If our output is from a Vref, special processing needed
-		if(m_outputSignal.IsVoltageReference())
+		Greenpak4EntityOutput analog = GetAnalogOutput();
+		if(analog.IsVoltageReference())
 		{
 			//Float the digital output buffer
 			Greenpak4EntityOutput gnd = m_device->GetGround();
@@ -97,14 +136,14 @@ bool Greenpak4IOBTypeA::Save(bool* bitstream)
 				return false;
 
 			//Configure the analog output
-			auto vref = dynamic_cast<Greenpak4VoltageReference*>(m_outputSignal.GetRealEntity());
+			auto vref = dynamic_cast<Greenpak4VoltageReference*>(analog.GetRealEntity());
 			unsigned int sel = vref->GetMuxSel();
 			bitstream[m_analogConfigBase + 1] = (sel & 2) ? true : false;
 			bitstream[m_analogConfigBase + 0] = (sel & 1) ? true : false;
 		}
 
 		//If our output is from a DAC, special processing needed
-		else if(m_outputSignal.IsDAC())
+		else if(analog.IsDAC())
 		{
 			//Float the digital output buffer
 			Greenpak4EntityOutput gnd = m_device->GetGround();
@@ -128,7 +167,7 @@ bool Greenpak4IOBTypeA::Save(bool* bitstream)
 		}
 
 		//If our output is from a PGA, special processing needed
-		else if(m_outputSignal.IsPGA())
+		else if(analog.IsPGA())
 		{
 			//Float the digital output buffer
 			Greenpak4EntityOutput gnd = m_device->GetGround();
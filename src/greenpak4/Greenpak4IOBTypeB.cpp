@@ -55,14 +55,51 @@ string Greenpak4IOBTypeB::GetDescription()
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 // Serialization
 
-bool Greenpak4IOBTypeB::Load(bool* /*bitstream*/)
+bool Greenpak4IOBTypeB::Load(Greenpak4Bitstream& bitstream)
 {
-	//TODO
-	LogError("Unimplemented\n");
-	return false;
+	////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+	// INPUT BUS
+
+	//If the POR drives us over dedicated routing, the fabric selector still points at it
+	if(!ReadMatrixSelector(bitstream, m_inputBaseWord, m_outputSignal))
+		return false;
+
+	////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+	// CONFIGURATION
+
+	//MODE CONTROL 2:0. 2 is direction, 1:0 is type
+	if(bitstream[m_configBase + 2])
+	{
+		m_outputEnable = m_device->GetPower();
+
+		if(bitstream[m_configBase + 1])
+			m_driveType = DRIVE_PMOS_OPENDRAIN;
+		else if(bitstream[m_configBase + 0])
+			m_driveType = DRIVE_NMOS_OPENDRAIN;
+		else
+			m_driveType = DRIVE_PUSHPULL;
+	}
+	else
+	{
+		m_outputEnable = m_device->GetGround();
+		LoadInputThreshold(bitstream, m_configBase);
+	}
+
+	//Pullup/down resistor strength 4:3, direction 5
+	LoadPull(bitstream, m_configBase + 3);
+
+	//Output drive strength 6
+	if(!bitstream[m_configBase + 6])
+		m_driveStrength = DRIVE_1X;
+	else if( (m_flags & IOB_FLAG_X4DRIVE) && bitstream[m_configBase + 7] )
+		m_driveStrength = DRIVE_4X;
+	else
+		m_driveStrength = DRIVE_2X;
+
+	return true;
 }
 
-bool Greenpak4IOBTypeB::Save(bool* bitstream)
+bool Greenpak4IOBTypeB::Save(Greenpak4Bitstream& bitstream)
 {
 	//See if we're an input or output.
 	//Throw an error if OE isn't tied to a power rail, because we don't have runtime adjustable direction
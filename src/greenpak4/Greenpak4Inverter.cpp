@@ -88,17 +88,26 @@ bool Greenpak4Inverter::CommitChanges()
 	return true;
 }
 
-bool Greenpak4Inverter::Load(bool* /*bitstream*/)
+bool Greenpak4Inverter::Load(Greenpak4Bitstream& bitstream)
 {
-	//TODO: Do our inputs
-	LogError("Unimplemented\n");
-	return false;
+	if(!ReadMatrixSelector(bitstream, m_inputBaseWord, m_input))
+		return false;
+
+	return true;
 }
 
-bool Greenpak4Inverter::Save(bool* bitstream)
+bool Greenpak4Inverter::Save(Greenpak4Bitstream& bitstream)
 {
 	if(!WriteMatrixSelector(bitstream, m_inputBaseWord, m_input))
 		return false;
 
 	return true;
 }
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Timing model
+
+unsigned int Greenpak4Inverter::GetPropagationDelay(Greenpak4NetlistEntity* /*entity*/)
+{
+	return 5000;
+}
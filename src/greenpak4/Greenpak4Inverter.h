@@ -33,13 +33,16 @@ public:
 		unsigned int oword);
 
 	//Serialization
-	virtual bool Load(bool* bitstream);
-	virtual bool Save(bool* bitstream);
+	virtual bool Load(Greenpak4Bitstream& bitstream);
+	virtual bool Save(Greenpak4Bitstream& bitstream);
 
 	virtual ~Greenpak4Inverter();
 
 	virtual std::string GetDescription();
 
+	Greenpak4EntityOutput GetInput()
+	{ return m_input; }
+
 	virtual void SetInput(std::string port, Greenpak4EntityOutput src);
 	virtual unsigned int GetOutputNetNumber(std::string port);
 
@@ -48,6 +51,8 @@ public:
 
 	virtual bool CommitChanges();
 
+	virtual unsigned int GetPropagationDelay(Greenpak4NetlistEntity* entity);
+
 protected:
 	Greenpak4EntityOutput m_input;
 };
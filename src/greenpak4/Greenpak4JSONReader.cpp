@@ -0,0 +1,461 @@
+/***********************************************************************************************************************
+ * Copyright (C) 2016 Andrew Zonenberg and contributors                                                                *
+ *                                                                                                                     *
+ * This program is free software; you can redistribute it and/or modify it under the terms of the GNU Lesser General   *
+ * Public License as published by the Free Software Foundation; either version 2.1 of the License, or (at your option) *
+ * any later version.                                                                                                  *
+ *                                                                                                                     *
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied  *
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for     *
+ * more details.                                                                                                       *
+ *                                                                                                                     *
+ * You should have received a copy of the GNU Lesser General Public License along with this program; if not, you may   *
+ * find one here:                                                                                                      *
+ * https://www.gnu.org/licenses/old-licenses/lgpl-2.1.txt                                                              *
+ * or you may search the http://www.gnu.org website for the version 2.1 license, or you may write to the Free Software *
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA                                      *
+ **********************************************************************************************************************/
+
+#include <cstdlib>
+#include <log.h>
+#include "Greenpak4JSONReader.h"
+
+using namespace std;
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Construction / destruction
+
+/**
+	@brief Reads JSON from a file (or pipe), a buffer at a time
+ */
+Greenpak4JSONReader::Greenpak4JSONReader(FILE* fp)
+	: m_fp(fp)
+	, m_buffer(65536)
+	, m_data(&m_buffer[0])
+	, m_pos(0)
+	, m_len(0)
+	, m_line(1)
+	, m_capture(NULL)
+	, m_ok(true)
+{
+}
+
+/**
+	@brief Reads JSON from memory. The data is not copied, so it has to stay around until we're done.
+
+	@param line		Line number the data starts at (if it's a piece of a larger file), for error messages
+ */
+Greenpak4JSONReader::Greenpak4JSONReader(const char* data, size_t len, unsigned int line)
+	: m_fp(NULL)
+	, m_data(data)
+	, m_pos(0)
+	, m_len(len)
+	, m_line(line)
+	, m_capture(NULL)
+	, m_ok(true)
+{
+}
+
+Greenpak4JSONReader::~Greenpak4JSONReader()
+{
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Low-level input
+
+/**
+	@brief Reads the next chunk of the file into the buffer. Returns false at end of file.
+ */
+bool Greenpak4JSONReader::Fill()
+{
+	//Nothing more to read if it's all in memory already
+	if(m_fp == NULL)
+		return false;
+
+	m_pos = 0;
+	m_len = fread(&m_buffer[0], 1, m_buffer.size(), m_fp);
+	if(m_len == 0)
+	{
+		if(ferror(m_fp))
+			Fail("read error");
+		return false;
+	}
+	return true;
+}
+
+/**
+	@brief Returns the next character without consuming it, or EOF
+ */
+int Greenpak4JSONReader::PeekChar()
+{
+	if( (m_pos >= m_len) && !Fill() )
+		return EOF;
+	return static_cast<unsigned char>(m_data[m_pos]);
+}
+
+/**
+	@brief Consumes and returns the next character, or EOF
+ */
+int Greenpak4JSONReader::GetChar()
+{
+	int c = PeekChar();
+	if(c == EOF)
+		return EOF;
+
+	m_pos ++;
+	if(c == '\n')
+		m_line ++;
+	if(m_capture)
+		m_capture->push_back(c);
+	return c;
+}
+
+/**
+	@brief Reports a syntax error. Only the first one is logged, since everything after it is garbage anyway.
+ */
+bool Greenpak4JSONReader::Fail(const char* what)
+{
+	if(m_ok)
+		LogError("JSON parsing failed at line %u (%s)\n", m_line, what);
+	m_ok = false;
+	return false;
+}
+
+/**
+	@brief Skips whitespace and figures out what kind of value comes next
+ */
+Greenpak4JSONReader::ValueType Greenpak4JSONReader::PeekType()
+{
+	if(!m_ok)
+		return TYPE_INVALID;
+
+	int c = PeekChar();
+	while( (c == ' ') || (c == '\t') || (c == '\r') || (c == '\n') )
+	{
+		GetChar();
+		c = PeekChar();
+	}
+
+	switch(c)
+	{
+		case EOF:	return TYPE_END;
+		case '{':	return TYPE_OBJECT;
+		case '[':	return TYPE_ARRAY;
+		case '\"':	return TYPE_STRING;
+
+		case 't':
+		case 'f':
+		case 'n':
+			return TYPE_LITERAL;
+
+		default:
+			if( (c == '-') || ( (c >= '0') && (c <= '9') ) )
+				return TYPE_NUMBER;
+			return TYPE_INVALID;
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Compound values
+
+bool Greenpak4JSONReader::BeginObject()
+{
+	if(PeekType() != TYPE_OBJECT)
+		return Fail("expected an object");
+
+	GetChar();
+	m_first.push_back(true);
+	return true;
+}
+
+bool Greenpak4JSONReader::BeginArray()
+{
+	if(PeekType() != TYPE_ARRAY)
+		return Fail("expected an array");
+
+	GetChar();
+	m_first.push_back(true);
+	return true;
+}
+
+/**
+	@brief Moves on to the next member/element of the innermost open object/array
+
+	@return True if there's another one, false if we hit the closing bracket (which is consumed) or an error
+ */
+bool Greenpak4JSONReader::NextItem(char close)
+{
+	if(m_first.empty())
+		return Fail("not inside an object or array");
+
+	//Skip whitespace, then see if we're done
+	if(PeekType() == TYPE_INVALID)
+	{
+		if(!m_ok)
+			return false;
+		if(PeekChar() == close)
+		{
+			GetChar();
+			m_first.pop_back();
+			return false;
+		}
+	}
+
+	//Everything but the first item needs a comma before it
+	if(m_first.back())
+		m_first.back() = false;
+	else if(PeekChar() != ',')
+		return Fail("expected a comma");
+	else
+		GetChar();
+
+	return true;
+}
+
+/**
+	@brief Moves on to the next member of the innermost open object
+
+	@param name		Set to the name of the member. The caller must then read or skip its value.
+
+	@return True if there's another member, false at the end of the object or on error
+ */
+bool Greenpak4JSONReader::NextMember(string& name)
+{
+	if(!NextItem('}'))
+		return false;
+
+	if(PeekType() != TYPE_STRING)
+		return Fail("expected a member name");
+	if(!ReadStringContents(&name))
+		return false;
+
+	if( (PeekType() != TYPE_INVALID) || (PeekChar() != ':') )
+		return Fail("expected a colon");
+	GetChar();
+	return true;
+}
+
+/**
+	@brief Moves on to the next element of the innermost open array
+
+	@return True if there's another element (the caller must then read or skip it), false at the end of the array
+	or on error
+ */
+bool Greenpak4JSONReader::NextElement()
+{
+	return NextItem(']');
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Scalar values
+
+bool Greenpak4JSONReader::ReadString(string& value)
+{
+	if(PeekType() != TYPE_STRING)
+		return Fail("expected a string");
+	return ReadStringContents(&value);
+}
+
+/**
+	@brief Reads an integer (with no fractional part or exponent)
+ */
+bool Greenpak4JSONReader::ReadInt(int32_t& value)
+{
+	if(PeekType() != TYPE_NUMBER)
+		return Fail("expected an integer");
+
+	string text;
+	if(!ReadBareword(text))
+		return false;
+
+	char* end;
+	long l = strtol(text.c_str(), &end, 10);
+	if( (*end != '\0') || (l < INT32_MIN) || (l > INT32_MAX) )
+		return Fail("expected an integer");
+
+	value = l;
+	return true;
+}
+
+/**
+	@brief Reads any value and converts it to a string
+
+	Strings are unescaped, anything else comes back as the JSON text it was written as (so 42 becomes "42").
+ */
+bool Greenpak4JSONReader::ReadScalar(string& value)
+{
+	switch(PeekType())
+	{
+		case TYPE_STRING:
+			return ReadStringContents(&value);
+
+		case TYPE_NUMBER:
+		case TYPE_LITERAL:
+			value = "";
+			return ReadBareword(value);
+
+		case TYPE_OBJECT:
+		case TYPE_ARRAY:
+			{
+				value = "";
+				m_capture = &value;
+				bool ok = SkipValue();
+				m_capture = NULL;
+				return ok;
+			}
+
+		default:
+			return Fail("expected a value");
+	}
+}
+
+/**
+	@brief Reads a number or true/false/null
+ */
+bool Greenpak4JSONReader::ReadBareword(string& value)
+{
+	while(true)
+	{
+		int c = PeekChar();
+		if( (c == EOF) || (c == ',') || (c == '}') || (c == ']') || (c == ' ') || (c == '\t') ||
+			(c == '\r') || (c == '\n') )
+		{
+			break;
+		}
+		value.push_back(GetChar());
+	}
+
+	//Sanity check the literals. Numbers are checked by whoever converts them.
+	if( (value[0] >= 'a') && (value[0] <= 'z') && (value != "true") && (value != "false") && (value != "null") )
+		return Fail("unknown literal");
+	return true;
+}
+
+/**
+	@brief Reads a string, starting at the opening quote
+
+	@param value	The unescaped string, or NULL to throw it away
+ */
+bool Greenpak4JSONReader::ReadStringContents(string* value)
+{
+	GetChar();
+	if(value)
+		*value = "";
+
+	while(true)
+	{
+		int c = GetChar();
+		if(c == EOF)
+			return Fail("unterminated string");
+		if(c == '\"')
+			return true;
+
+		if(c == '\\')
+		{
+			c = GetChar();
+			switch(c)
+			{
+				case '\"':
+				case '\\':
+				case '/':
+					break;
+
+				case 'b':	c = '\b';	break;
+				case 'f':	c = '\f';	break;
+				case 'n':	c = '\n';	break;
+				case 'r':	c = '\r';	break;
+				case 't':	c = '\t';	break;
+
+				//Unicode escapes: convert to UTF-8. Surrogate pairs aren't handled, yosys doesn't write them.
+				case 'u':
+					{
+						unsigned int code = 0;
+						for(int i=0; i<4; i++)
+						{
+							int h = GetChar();
+							code <<= 4;
+							if( (h >= '0') && (h <= '9') )
+								code |= h - '0';
+							else if( (h >= 'a') && (h <= 'f') )
+								code |= h - 'a' + 10;
+							else if( (h >= 'A') && (h <= 'F') )
+								code |= h - 'A' + 10;
+							else
+								return Fail("bad unicode escape");
+						}
+
+						if(!value)
+							continue;
+						if(code < 0x80)
+							value->push_back(code);
+						else if(code < 0x800)
+						{
+							value->push_back(0xc0 | (code >> 6));
+							value->push_back(0x80 | (code & 0x3f));
+						}
+						else
+						{
+							value->push_back(0xe0 | (code >> 12));
+							value->push_back(0x80 | ((code >> 6) & 0x3f));
+							value->push_back(0x80 | (code & 0x3f));
+						}
+						continue;
+					}
+
+				default:
+					return Fail("bad escape sequence");
+			}
+		}
+
+		if(value)
+			value->push_back(c);
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Skipping
+
+/**
+	@brief Skips over the next value (including everything inside it, if it's an object or array)
+ */
+bool Greenpak4JSONReader::SkipValue()
+{
+	switch(PeekType())
+	{
+		case TYPE_STRING:
+			return ReadStringContents(NULL);
+
+		case TYPE_NUMBER:
+		case TYPE_LITERAL:
+			{
+				string dummy;
+				return ReadBareword(dummy);
+			}
+
+		case TYPE_OBJECT:
+			{
+				BeginObject();
+				string name;
+				while(NextMember(name))
+					SkipValue();
+				return m_ok;
+			}
+
+		case TYPE_ARRAY:
+			BeginArray();
+			while(NextElement())
+				SkipValue();
+			return m_ok;
+
+		default:
+			return Fail("expected a value");
+	}
+}
+
+/**
+	@brief Returns true if there's nothing but whitespace left in the input
+ */
+bool Greenpak4JSONReader::AtEnd()
+{
+	return PeekType() == TYPE_END;
+}
@@ -0,0 +1,128 @@
+/***********************************************************************************************************************
+ * Copyright (C) 2016 Andrew Zonenberg and contributors                                                                *
+ *                                                                                                                     *
+ * This program is free software; you can redistribute it and/or modify it under the terms of the GNU Lesser General   *
+ * Public License as published by the Free Software Foundation; either version 2.1 of the License, or (at your option) *
+ * any later version.                                                                                                  *
+ *                                                                                                                     *
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied  *
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for     *
+ * more details.                                                                                                       *
+ *                                                                                                                     *
+ * You should have received a copy of the GNU Lesser General Public License along with this program; if not, you may   *
+ * find one here:                                                                                                      *
+ * https://www.gnu.org/licenses/old-licenses/lgpl-2.1.txt                                                              *
+ * or you may search the http://www.gnu.org website for the version 2.1 license, or you may write to the Free Software *
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA                                      *
+ **********************************************************************************************************************/
+
+#ifndef Greenpak4JSONReader_h
+#define Greenpak4JSONReader_h
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+/**
+	@brief A streaming (pull style) reader for the JSON netlists written by yosys
+
+	Tokens are read straight out of memory (normally a mapping of the file), or out of a file through a small buffer
+	if it can't be mapped (pipes etc). The caller asks for exactly the values it wants. Anything it doesn't care about
+	(huge "src" attributes, port_directions, etc) can be skipped with SkipValue() without ever being stored, so memory
+	use doesn't depend on the size of the file.
+
+	Objects are walked like this:
+
+		reader.BeginObject();
+		std::string name;
+		while(reader.NextMember(name))
+			... read or skip exactly one value ...
+		if(!reader.Validate())
+			... syntax error, already logged ...
+
+	Once a syntax error is found every call returns false, so loops like the above terminate cleanly.
+ */
+class Greenpak4JSONReader
+{
+public:
+	Greenpak4JSONReader(FILE* fp);
+	Greenpak4JSONReader(const char* data, size_t len, unsigned int line = 1);
+	virtual ~Greenpak4JSONReader();
+
+	enum ValueType
+	{
+		TYPE_OBJECT,
+		TYPE_ARRAY,
+		TYPE_STRING,
+		TYPE_NUMBER,
+		TYPE_LITERAL,		//true, false, or null
+		TYPE_END,			//end of the input
+		TYPE_INVALID
+	};
+
+	ValueType PeekType();
+
+	//Compound values
+	bool BeginObject();
+	bool NextMember(std::string& name);
+	bool BeginArray();
+	bool NextElement();
+
+	//Scalar values
+	bool ReadString(std::string& value);
+	bool ReadInt(int32_t& value);
+	bool ReadScalar(std::string& value);
+
+	bool SkipValue();
+	bool AtEnd();
+
+	//Returns true if we're good, false if the JSON was malformed or the file couldn't be read
+	bool Validate()
+	{ return m_ok; }
+
+	//Returns true if we're reading from memory, so GetOffset() can be used to come back to a value later
+	bool IsInMemory()
+	{ return (m_fp == NULL); }
+
+	//Position of the next character in the data (only meaningful when reading from memory)
+	size_t GetOffset()
+	{ return m_pos; }
+
+	unsigned int GetLine()
+	{ return m_line; }
+
+protected:
+	bool Fill();
+	int PeekChar();
+	int GetChar();
+	bool Fail(const char* what);
+
+	bool ReadStringContents(std::string* value);
+	bool ReadBareword(std::string& value);
+	bool NextItem(char close);
+
+	//The file we're reading from (NULL if reading from memory)
+	FILE* m_fp;
+
+	//Buffer for chunks of the file
+	std::vector<char> m_buffer;
+
+	//The data we're currently reading (the buffer, or the caller's memory), and our position in it
+	const char* m_data;
+	size_t m_pos;
+	size_t m_len;
+
+	//Line number of the current position (for error messages)
+	unsigned int m_line;
+
+	//One entry per open object or array: true if we haven't seen its first member/element yet
+	std::vector<bool> m_first;
+
+	//If not NULL, every character consumed gets appended here (see ReadScalar())
+	std::string* m_capture;
+
+	bool m_ok;
+};
+
+#endif
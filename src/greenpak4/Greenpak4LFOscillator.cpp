@@ -99,39 +99,45 @@ bool Greenpak4LFOscillator::CommitChanges()
 	if(ncell == NULL)
 		return true;
 
-	if(ncell->HasParameter("PWRDN_EN"))
-		m_powerDownEn = (ncell->m_parameters["PWRDN_EN"] == "1");
+	if(ncell->HasParameter(PARAM_PWRDN_EN))
+		m_powerDownEn = ncell->GetParameter(PARAM_PWRDN_EN);
 
 	//If auto-powerdown is not specified, but the cell is instantiated, default to always running the osc
-	if(ncell->HasParameter("AUTO_PWRDN"))
-		m_autoPowerDown = (ncell->m_parameters["AUTO_PWRDN"] == "1");
-	else
-		m_autoPowerDown = false;
+	m_autoPowerDown = ncell->GetParameter(PARAM_AUTO_PWRDN);
 
-	if(ncell->HasParameter("OUT_DIV"))
-	{
-		int div = atoi(ncell->m_parameters["OUT_DIV"].c_str());
+	//Legal dividers (1, 2, 4, 16) were checked when the netlist was loaded
+	if(ncell->HasParameter(PARAM_OUT_DIV))
+		m_outDiv = ncell->GetParameter(PARAM_OUT_DIV);
 
-		if(	(div == 1) || (div == 2) || (div == 4) || (div == 16) )
-			m_outDiv = div;
+	return true;
+}
 
-		else
-		{
-			LogError("GP4_LFOSC output divider must be 1, 2, 4, or 16\n");
+bool Greenpak4LFOscillator::Load(Greenpak4Bitstream& bitstream)
+{
+	////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+	// INPUT BUS
+
+	//The power-down input is only meaningful if power-down is enabled
+	m_powerDownEn = bitstream[m_configBase + 0];
+	m_powerDown = m_device->GetGround();
+	if(m_powerDownEn)
+	{
+		if(!ReadMatrixSelector(bitstream, m_inputBaseWord, m_powerDown))
 			return false;
-		}
 	}
 
-	return true;
-}
+	////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+	// Configuration
 
-bool Greenpak4LFOscillator::Load(bool* /*bitstream*/)
-{
-	LogError("Unimplemented\n");
-	return false;
+	m_autoPowerDown = !bitstream[m_configBase + 1];
+
+	static const int divs[4] = {1, 2, 4, 16};
+	m_outDiv = divs[bitstream.GetField(m_cbaseClkdiv, 2)];
+
+	return true;
 }
 
-bool Greenpak4LFOscillator::Save(bool* bitstream)
+bool Greenpak4LFOscillator::Save(Greenpak4Bitstream& bitstream)
 {
 	//Optimize PWRDN = 1'b0 and PWRDN_EN = 1 to PWRDN = dontcare and PWRDN_EN = 0
 	bool real_pwrdn_en = m_powerDownEn;
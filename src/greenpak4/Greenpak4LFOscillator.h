@@ -39,11 +39,14 @@ public:
 	virtual ~Greenpak4LFOscillator();
 
 	//Serialization
-	virtual bool Load(bool* bitstream);
-	virtual bool Save(bool* bitstream);
+	virtual bool Load(Greenpak4Bitstream& bitstream);
+	virtual bool Save(Greenpak4Bitstream& bitstream);
 
 	virtual std::string GetDescription();
 
+	int GetOutputDivider()
+	{ return m_outDiv; }
+
 	//Get the power-down input (used for DRC)
 	Greenpak4EntityOutput GetPowerDown()
 	{ return m_powerDown; }
@@ -51,19 +51,29 @@ Greenpak4LUT::~Greenpak4LUT()
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 // Serialization of the truth table
 
-bool Greenpak4LUT::Load(bool* bitstream)
+bool Greenpak4LUT::Load(Greenpak4Bitstream& bitstream)
 {
-	//TODO: Do our inputs
+	////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+	// INPUT BUS
+
+	for(unsigned int i=0; i<m_order; i++)
+	{
+		if(!ReadMatrixSelector(bitstream, m_inputBaseWord + i, m_inputs[i]))
+			return false;
+	}
+
+	////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+	// LUT CONTENTS
 
-	//Do the LUT
 	unsigned int nmax = 1 << m_order;
+	uint32_t table = bitstream.GetField(m_configBase, nmax);
 	for(unsigned int i=0; i<nmax; i++)
-		m_truthtable[i] = bitstream[m_configBase + i];
+		m_truthtable[i] = (table >> i) & 1;
 
 	return true;
 }
 
-bool Greenpak4LUT::Save(bool* bitstream)
+bool Greenpak4LUT::Save(Greenpak4Bitstream& bitstream)
 {
 	////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 	// INPUT BUS
@@ -78,8 +88,10 @@ bool Greenpak4LUT::Save(bool* bitstream)
 	// LUT CONTENTS
 
 	unsigned int nmax = 1 << m_order;
+	uint32_t table = 0;
 	for(unsigned int i=0; i<nmax; i++)
-		bitstream[m_configBase + i] = m_truthtable[i];
+		table |= m_truthtable[i] << i;
+	bitstream.SetField(m_configBase, nmax, table);
 
 	return true;
 }
@@ -110,28 +122,19 @@ bool Greenpak4LUT::CommitChanges()
 	//Not an inverter, treat it as a LUT
 	else
 	{
-		for(auto x : ncell->m_parameters)
+		//LUT initialization value (unknown parameters were reported when the netlist was loaded)
+		if(ncell->HasParameter(PARAM_INIT))
 		{
-			//LUT initialization value, as decimal
-			if(x.first == "INIT")
-			{
-				//convert to bit array format for the bitstream library
-				uint32_t truth_table = atoi(x.second.c_str());
-				unsigned int nbits = 1 << m_order;
-				for(unsigned int i=0; i<nbits; i++)
-				{
-					bool a3 = (i & 8) ? true : false;
-					bool a2 = (i & 4) ? true : false;
-					bool a1 = (i & 2) ? true : false;
-					bool a0 = (i & 1) ? true : false;
-					m_truthtable[a3*8 | a2*4 | a1*2 | a0] = (truth_table & (1 << i)) ? true : false;
-				}
-			}
-
-			else
+			//convert to bit array format for the bitstream library
+			uint32_t truth_table = ncell->GetParameter(PARAM_INIT);
+			unsigned int nbits = 1 << m_order;
+			for(unsigned int i=0; i<nbits; i++)
 			{
-				LogWarning("Cell\"%s\" has unrecognized parameter %s, ignoring\n",
-					ncell->m_name.c_str(), x.first.c_str());
+				bool a3 = (i & 8) ? true : false;
+				bool a2 = (i & 4) ? true : false;
+				bool a1 = (i & 2) ? true : false;
+				bool a0 = (i & 1) ? true : false;
+				m_truthtable[a3*8 | a2*4 | a1*2 | a0] = (truth_table & (1 << i)) ? true : false;
 			}
 		}
 	}
@@ -192,3 +195,11 @@ string Greenpak4LUT::GetDescription()
 	snprintf(buf, sizeof(buf), "LUT%u_%u", m_order, m_lutnum);
 	return string(buf);
 }
+
+/**
+	@brief Bigger LUTs have a deeper mux tree, so they're a bit slower
+ */
+unsigned int Greenpak4LUT::GetPropagationDelay(Greenpak4NetlistEntity* /*entity*/)
+{
+	return 5000 + 1000*m_order;
+}
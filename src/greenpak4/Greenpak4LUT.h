@@ -38,8 +38,8 @@ public:
 	virtual ~Greenpak4LUT();
 
 	//Serialization
-	virtual bool Load(bool* bitstream);
-	virtual bool Save(bool* bitstream);
+	virtual bool Load(Greenpak4Bitstream& bitstream);
+	virtual bool Save(Greenpak4Bitstream& bitstream);
 
 	unsigned int GetOrder()
 	{ return m_order; }
@@ -49,6 +49,13 @@ public:
 
 	virtual std::string GetDescription();
 
+	//Configuration (for simulation)
+	Greenpak4EntityOutput GetInput(unsigned int i)
+	{ return m_inputs[i]; }
+
+	bool GetTruthTableBit(unsigned int i)
+	{ return m_truthtable[i]; }
+
 	virtual void SetInput(std::string port, Greenpak4EntityOutput src);
 	virtual unsigned int GetOutputNetNumber(std::string port);
 
@@ -57,6 +64,8 @@ public:
 
 	virtual bool CommitChanges();
 
+	virtual unsigned int GetPropagationDelay(Greenpak4NetlistEntity* entity);
+
 protected:
 
 	///Index of our LUT
@@ -41,14 +41,25 @@ Greenpak4MuxedClockBuffer::~Greenpak4MuxedClockBuffer()
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 // Serialization
 
-bool Greenpak4MuxedClockBuffer::Load(bool* /*bitstream*/)
+bool Greenpak4MuxedClockBuffer::Load(Greenpak4Bitstream& bitstream)
 {
-	//TODO: Do our inputs
-	LogError("Unimplemented\n");
-	return false;
+	unsigned int muxsel = bitstream.GetField(m_configBase, 2);
+
+	for(auto it : m_inputs)
+	{
+		if(it.second == muxsel)
+		{
+			m_input = it.first;
+			return true;
+		}
+	}
+
+	//Not a valid muxsel, so Save() must have left it alone for a grounded input
+	m_input = m_device->GetGround();
+	return true;
 }
 
-bool Greenpak4MuxedClockBuffer::Save(bool* bitstream)
+bool Greenpak4MuxedClockBuffer::Save(Greenpak4Bitstream& bitstream)
 {
 	////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 	// INPUT BUS
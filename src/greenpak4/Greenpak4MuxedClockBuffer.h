@@ -29,8 +29,8 @@ public:
 	Greenpak4MuxedClockBuffer(Greenpak4Device* device, unsigned int bufnum, unsigned int matrix, unsigned int cbase);
 
 	//Serialization
-	virtual bool Load(bool* bitstream);
-	virtual bool Save(bool* bitstream);
+	virtual bool Load(Greenpak4Bitstream& bitstream);
+	virtual bool Save(Greenpak4Bitstream& bitstream);
 
 	virtual ~Greenpak4MuxedClockBuffer();
 
@@ -16,7 +16,13 @@
  * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA                                      *
  **********************************************************************************************************************/
 
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include <log.h>
+#include <trace.h>
 #include <Greenpak4.h>
 
 using namespace std;
@@ -28,80 +34,157 @@ Greenpak4NetlistEntity::~Greenpak4NetlistEntity()
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 // Construction / destruction
 
-Greenpak4Netlist::Greenpak4Netlist(std::string fname)
-	: m_topModule(NULL)
+/**
+	@brief Loads a netlist from a yosys JSON file
+
+	@param fname		Name of the file, or "-" for stdin
+	@param cacheDir		If not empty, directory to keep binary snapshots of parsed netlists in. If we find one for a
+						file with the same contents (and salt), it's loaded instead of parsing the JSON.
+	@param cacheSalt	Extra data for the cache key (the tool version, so snapshots from old builds aren't used)
+ */
+Greenpak4Netlist::Greenpak4Netlist(std::string fname, std::string cacheDir, std::string cacheSalt)
+	: m_data(NULL)
+	, m_dataLength(0)
+	, m_topModule(NULL)
 	, m_parseOK(true)
 {
-	//Read the netlist
-	FILE* fp = fopen(fname.c_str(), "rb");
-	if(fp == NULL)
+	//Read from stdin if asked (so yosys can pipe straight into us)
+	if(fname == "-")
 	{
-		LogError("Failed to open netlist file %s\n", fname.c_str());
-		m_parseOK = false;
+		Greenpak4JSONReader reader(stdin);
+		Load(reader);
 		return;
 	}
-	if(0 != fseek(fp, 0, SEEK_END))
+
+	//Open the netlist
+	int fd = open(fname.c_str(), O_RDONLY);
+	if(fd < 0)
 	{
-		LogError("Failed to seek to end of netlist file %s\n", fname.c_str());
+		LogError("Failed to open netlist file %s\n", fname.c_str());
 		m_parseOK = false;
-		fclose(fp);
 		return;
 	}
-	size_t len = ftell(fp);
-	if(0 != fseek(fp, 0, SEEK_SET))
+
+	//If it's a regular file, map it and parse it in place
+	struct stat st;
+	if( (0 == fstat(fd, &st)) && S_ISREG(st.st_mode) && (st.st_size > 0) )
 	{
-		LogError("Failed to seek to start of netlist file %s\n", fname.c_str());
-		m_parseOK = false;
-		fclose(fp);
-		return;
+		void* map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+		if(map != MAP_FAILED)
+		{
+			close(fd);
+
+			//We go over it front to back, except for the few modules we come back for later
+			madvise(map, st.st_size, MADV_SEQUENTIAL);
+
+			//Keep it mapped so we can load modules from it on demand
+			m_data = static_cast<const char*>(map);
+			m_dataLength = st.st_size;
+
+			LoadData(cacheDir, cacheSalt);
+			return;
+		}
 	}
-	char* json_string = new char[len + 1];
-	json_string[len] = '\0';
-	if(len != fread(json_string, 1, len, fp))
+
+	//Pipes, FIFOs, etc can't be mapped, so fall back to reading a buffer at a time.
+	//We'd need the whole thing to hash it, so these are never cached.
+	FILE* fp = fdopen(fd, "rb");
+	if(fp == NULL)
 	{
-		LogError("Failed read contents of netlist file %s\n", fname.c_str());
+		LogError("Failed to open netlist file %s\n", fname.c_str());
 		m_parseOK = false;
-		delete[] json_string;
-		fclose(fp);
+		close(fd);
 		return;
 	}
+	Greenpak4JSONReader reader(fp);
+	Load(reader);
 	fclose(fp);
+}
 
-	//Parse the JSON
-	json_tokener* tok = json_tokener_new();
-	if(!tok)
+/**
+	@brief Loads a netlist from a yosys JSON file that's already in memory
+
+	@param data			The JSON text. It's copied, so the caller doesn't have to keep it around.
+	@param len			Size of the JSON text, in bytes
+	@param cacheDir		Directory for parsed netlist snapshots (see the file constructor)
+	@param cacheSalt	Extra data for the cache key
+ */
+Greenpak4Netlist::Greenpak4Netlist(const char* data, size_t len, std::string cacheDir, std::string cacheSalt)
+	: m_data(NULL)
+	, m_dataLength(0)
+	, m_topModule(NULL)
+	, m_parseOK(true)
+{
+	if(len == 0)
 	{
-		LogError("Failed to create JSON tokenizer object\n");
+		LogError("Netlist is empty\n");
 		m_parseOK = false;
-		delete[] json_string;
 		return;
 	}
-	json_tokener_error err;
-	json_object* object = json_tokener_parse_verbose(json_string, &err);
-	if(NULL == object)
+
+	//Modules are loaded from it on demand, so we need our own copy
+	m_buffer.assign(data, data + len);
+	m_data = &m_buffer[0];
+	m_dataLength = len;
+
+	LoadData(cacheDir, cacheSalt);
+}
+
+/**
+	@brief Loads the netlist from m_data, or from the cache if we've parsed the same JSON before
+ */
+void Greenpak4Netlist::LoadData(std::string cacheDir, std::string cacheSalt)
+{
+	TraceSpan span("Load netlist");
+
+	//See if we've parsed this exact netlist before
+	uint64_t key = 0;
+	string cacheFile;
+	if(cacheDir != "")
 	{
-		const char* desc = json_tokener_error_desc(err);
-		LogError("JSON parsing failed (err = %s)\n", desc);
-		m_parseOK = false;
-		delete[] json_string;
-		return;
+		key = HashNetlist(m_data, m_dataLength, cacheSalt);
+		char tmp[32];
+		snprintf(tmp, sizeof(tmp), "/%016llx.gp4nl", static_cast<unsigned long long>(key));
+		cacheFile = cacheDir + tmp;
+
+		if(LoadCache(cacheFile, key))
+		{
+			LogNotice("Loaded cached netlist %s\n", cacheFile.c_str());
+			LogNotice("Netlist creator: %s\n", m_creator.c_str());
+			return;
+		}
 	}
 
-	//Read stuff from it
-	Load(object);
+	Greenpak4JSONReader reader(m_data, m_dataLength);
+	Load(reader);
 
-	//Clean up
-	json_object_put(object);
-	json_tokener_free(tok);
-	delete[] json_string;
+	if(m_parseOK && (cacheFile != "") )
+		SaveCache(cacheFile, key);
 }
 
 Greenpak4Netlist::~Greenpak4Netlist()
+{
+	Clear();
+
+	if(m_data && m_buffer.empty())
+		munmap(const_cast<char*>(m_data), m_dataLength);
+}
+
+/**
+	@brief Deletes everything in the netlist
+ */
+void Greenpak4Netlist::Clear()
 {
 	//Delete modules
 	for(auto x : m_modules)
 		delete x.second;
 	m_modules.clear();
+	m_moduleLocations.clear();
+
+	m_topModule = NULL;
+	m_nodes.clear();
+	m_symbols.clear();
+	m_creator = "";
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -112,34 +195,29 @@ Greenpak4Netlist::~Greenpak4Netlist()
 
 	Should only have creator and modules
  */
-void Greenpak4Netlist::Load(json_object* object)
+void Greenpak4Netlist::Load(Greenpak4JSONReader& reader)
 {
-	json_object_iterator end = json_object_iter_end(object);
-	for(json_object_iterator it = json_object_iter_begin(object);
-		!json_object_iter_equal(&it, &end);
-		json_object_iter_next(&it))
+	string name;
+	reader.BeginObject();
+	while(reader.NextMember(name))
 	{
-		//See what we got
-		string name = json_object_iter_peek_name(&it);
-		json_object* child = json_object_iter_peek_value(&it);
-
 		//Creator of the file (expecting a string)
 		if(name == "creator")
 		{
-			if(!json_object_is_type(child, json_type_string))
+			if(reader.PeekType() != Greenpak4JSONReader::TYPE_STRING)
 			{
 				LogError("netlist creator should be of type string but isn't\n");
 				m_parseOK = false;
 				return;
 			}
-			m_creator = json_object_get_string(child);
+			reader.ReadString(m_creator);
 			LogNotice("Netlist creator: %s\n", m_creator.c_str());
 		}
 
 		//Modules in the file (expecting an object)
 		else if(name == "modules")
 		{
-			if(!json_object_is_type(child, json_type_object))
+			if(reader.PeekType() != Greenpak4JSONReader::TYPE_OBJECT)
 			{
 				LogError("netlist modules should be of type object but isn't\n");
 				m_parseOK = false;
@@ -147,16 +225,44 @@ void Greenpak4Netlist::Load(json_object* object)
 			}
 
 			//Load them
-			LoadModules(child);
+			LoadModules(reader);
+			if(!m_parseOK)
+				return;
 		}
 
-		//Something bad
+		//Anything else isn't used for anything, don't bother storing it
 		else
-		{
-			LogError("Unknown top-level JSON object \"%s\"\n", name.c_str());
-			m_parseOK = false;
+			reader.SkipValue();
+	}
+
+	//Make sure we got the whole thing
+	if(!reader.Validate())
+	{
+		m_parseOK = false;
+		return;
+	}
+	if(!reader.AtEnd())
+	{
+		LogError("Garbage after end of netlist\n");
+		m_parseOK = false;
+		return;
+	}
+
+	//Verify we got the top-level module we expected
+	if(m_topModule == NULL)
+	{
+		LogError("Unable to find a top-level module in netlist\n");
+		m_parseOK = false;
+		return;
+	}
+
+	//Load everything the top level instantiates too, since PAR needs their port directions.
+	//Cell types that aren't modules in the netlist (GP_VDD etc) are fine.
+	for(auto it = m_topModule->cell_begin(); it != m_topModule->cell_end(); it ++)
+	{
+		GetModule(it->second->m_type);
+		if(!m_parseOK)
 			return;
-		}
 	}
 
 	IndexNets(true);
@@ -225,7 +331,7 @@ void Greenpak4Netlist::IndexNets(bool verbose)
 		LogIndenter li;
 		for(auto jt : cell->m_connections)
 		{
-			string cellname = jt.first;
+			auto cellname = m_symbols.Intern(jt.first);
 			auto net = jt.second;
 			bool vector = false;
 			if(net.size() != 1)
@@ -247,11 +353,13 @@ void Greenpak4Netlist::IndexNets(bool verbose)
 
 	//Make a set of the nodes to avoid duplication.
 	//Note that NULL is legal in vector nets if some bits were optimized out
+	set<Greenpak4NetlistNode*> nodes;
 	for(auto it = m_topModule->net_begin(); it != m_topModule->net_end(); it ++)
 	{
 		if(it->second != NULL)
-			m_nodes.insert(it->second);
+			nodes.insert(it->second);
 	}
+	m_nodes.assign(nodes.begin(), nodes.end());
 
 	//Print them out
 	if(verbose)
@@ -268,44 +376,163 @@ void Greenpak4Netlist::IndexNets(bool verbose)
 	}
 }
 
+/**
+	@brief Looks up a module by name, loading it if we haven't already
+
+	@return The module, or NULL if there isn't one by that name (or it failed to load)
+ */
+Greenpak4NetlistModule* Greenpak4Netlist::GetModule(string name)
+{
+	Greenpak4NetlistSymbol sym;
+	if(!m_symbols.Find(name, sym))
+		return NULL;
+	auto it = m_modules.find(sym);
+	if(it != m_modules.end())
+		return it->second;
+	return LoadModule(sym);
+}
+
+/**
+	@brief Creates an empty module with the given ports, unless there's already one by that name
+
+	@param name		Module name
+	@param inputs	Input port names
+	@param outputs	Output port names
+ */
+Greenpak4NetlistModule* Greenpak4Netlist::AddBlackbox(
+	string name,
+	const vector<string>& inputs,
+	const vector<string>& outputs)
+{
+	Greenpak4NetlistModule* module = GetModule(name);
+	if(module != NULL)
+		return module;
+
+	auto sym = m_symbols.Intern(name);
+	module = new Greenpak4NetlistModule(this, name);
+	module->m_attributes["blackbox"] = "1";
+	for(auto& p : inputs)
+		module->m_ports[m_symbols.Intern(p)] = new Greenpak4NetlistPort(module, p);
+	for(auto& p : outputs)
+	{
+		auto port = new Greenpak4NetlistPort(module, p);
+		port->m_direction = Greenpak4NetlistPort::DIR_OUTPUT;
+		module->m_ports[m_symbols.Intern(p)] = port;
+	}
+	m_modules[sym] = module;
+	return module;
+}
+
+/**
+	@brief Parses a module we skipped over in LoadModules()
+
+	@return The module, or NULL if we don't know where one by that name is, or it failed to load
+ */
+Greenpak4NetlistModule* Greenpak4Netlist::LoadModule(Greenpak4NetlistSymbol name)
+{
+	auto it = m_moduleLocations.find(name);
+	if(it == m_moduleLocations.end())
+		return NULL;
+	ModuleLocation loc = it->second;
+	m_moduleLocations.erase(it);
+
+	Greenpak4JSONReader reader(m_data + loc.m_offset, m_dataLength - loc.m_offset, loc.m_line);
+	Greenpak4NetlistModule *module = new Greenpak4NetlistModule(this, name, reader);
+	if(!module->Validate())
+	{
+		delete module;
+		m_parseOK = false;
+		return NULL;
+	}
+	m_modules[name] = module;
+	return module;
+}
+
+/**
+	@brief Skips over a module, checking if it's the top level
+
+	@return True if the module has the "top" attribute
+ */
+bool Greenpak4Netlist::ScanModule(Greenpak4JSONReader& reader)
+{
+	bool top = false;
+
+	string name;
+	reader.BeginObject();
+	while(reader.NextMember(name))
+	{
+		if( (name == "attributes") && (reader.PeekType() == Greenpak4JSONReader::TYPE_OBJECT) )
+		{
+			string aname;
+			reader.BeginObject();
+			while(reader.NextMember(aname))
+			{
+				if(aname == "top")
+					top = true;
+				reader.SkipValue();
+			}
+		}
+		else
+			reader.SkipValue();
+	}
+
+	return top;
+}
+
 /**
 	@brief Module parsing routine
 
-	Loads all of the modules in the netlist
+	Finds all of the modules in the netlist and loads the top level one. If the netlist is in memory the others
+	(mostly cell library blackboxes we never look at) are only skimmed, and GetModule() parses them if they're needed.
+	Otherwise we can't come back to them, so they're all loaded now.
  */
-void Greenpak4Netlist::LoadModules(json_object* object)
+void Greenpak4Netlist::LoadModules(Greenpak4JSONReader& reader)
 {
 	LogNotice("\nLoading modules...\n");
 	LogIndenter li;
 
-	json_object_iterator end = json_object_iter_end(object);
-	for(json_object_iterator it = json_object_iter_begin(object);
-		!json_object_iter_equal(&it, &end);
-		json_object_iter_next(&it))
-	{
-		//See what we got
-		string name = json_object_iter_peek_name(&it);
-		json_object* child = json_object_iter_peek_value(&it);
+	Greenpak4NetlistSymbol topName;
 
+	string name;
+	reader.BeginObject();
+	while(reader.NextMember(name))
+	{
 		//Verify it's an object
-		if(!json_object_is_type(child, json_type_object))
+		if(reader.PeekType() != Greenpak4JSONReader::TYPE_OBJECT)
 		{
 			LogError("netlist module entry should be of type object but isn't\n");
 			m_parseOK = false;
 			return;
 		}
 
-		//TODO: If the child object is a standard library cell, don't bother parsing it?
+		auto sym = m_symbols.Intern(name);
+
+		//Note where it is so we can load it later
+		if(reader.IsInMemory())
+		{
+			m_moduleLocations[sym] = ModuleLocation(reader.GetOffset(), reader.GetLine());
+			if(ScanModule(reader))
+			{
+				if(!topName.IsNull())
+				{
+					LogError("More than one top-level module in netlist\n");
+					m_parseOK = false;
+					return;
+				}
+				topName = sym;
+			}
+			continue;
+		}
 
 		//Load it
-		Greenpak4NetlistModule *module = new Greenpak4NetlistModule(this, name, child);
+		Greenpak4NetlistModule *module = new Greenpak4NetlistModule(this, name, reader);
 		if(!module->Validate())
 		{
 			delete module;
 			m_parseOK = false;
 			return;
 		}
-		m_modules[name] = module;
+		m_modules[sym] = module;
 
 		//Did we get a top-level module?
 		if(module->m_attributes.find("top") != module->m_attributes.end())
@@ -320,11 +547,496 @@ void Greenpak4Netlist::LoadModules(json_object* object)
 		}
 	}
 
-	//Verify we got the top-level module we expected
-	if(m_topModule == NULL)
+	if(!reader.Validate())
 	{
-		LogError("Unable to find a top-level module in netlist\n");
 		m_parseOK = false;
 		return;
 	}
+
+	if(!topName.IsNull())
+		m_topModule = LoadModule(topName);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Binary cache
+
+/*
+	Cache file layout (all integers little endian, strings are a u32 length then the bytes)
+
+		"GP4N", u32 format version, u64 key
+		u32 symbol count, strings symbols (in ID order)
+		string creator, u32 top module name
+		u32 module count (only the ones that have been loaded), then for each module:
+			u32 name, u32 attribute count, (string name, string value) attributes, u32 next net number
+			u32 node count, then for each node: u32 net number, string name, attributes, u32 count, strings src
+			u32 net count, then for each net: u32 name, u32 node index (or 0xffffffff for NULL)
+			u32 port count, then for each port: u32 name, u32 direction, u32 net, u32 count, u32 nodes
+			u32 cell count, then for each cell: u32 name, string type, parameters, attributes,
+				u32 connection count, (string port, u32 count, u32 nodes) connections
+			for each node: u32 count, (u32 cell, u32 port, u32 bit, u32 vector) points, u32 count, u32 ports
+		u32 count, u32 nodes (of the top module): the netlist's node list, in order
+		u32 count, then for each module not loaded yet: u32 name, u64 offset in the JSON, u32 line
+		u64 HashNetlist() of everything before this (with no salt)
+
+	Names of modules, nets, ports and cells are symbol IDs. The symbol table is restored first, so the IDs (and thus
+	iteration order) come out the same as when the JSON was parsed. Nodes, ports and cells are referred to by their
+	position in the module's lists.
+
+	Bump NETLIST_CACHE_VERSION whenever this changes, or whenever anything about parsing/indexing changes that would
+	make an old snapshot different from what we get from the JSON today.
+ */
+#define NETLIST_CACHE_VERSION 3
+#define NETLIST_CACHE_NULL 0xffffffff
+
+static void CacheWriteMap(vector<uint8_t>& buf, const map<string, string>& value)
+{
+	CacheWriteU32(buf, value.size());
+	for(auto it : value)
+	{
+		CacheWriteString(buf, it.first);
+		CacheWriteString(buf, it.second);
+	}
+}
+
+/**
+	@brief Cursor over a netlist cache file being loaded, which can also read references to things already loaded
+ */
+class Greenpak4NetlistCacheReader : public Greenpak4CacheReader
+{
+public:
+	Greenpak4NetlistCacheReader(const vector<uint8_t>& buf)
+		: Greenpak4CacheReader(buf)
+	{}
+
+	void ReadMap(map<string, string>& value)
+	{
+		uint32_t count = ReadU32();
+		for(uint32_t i=0; (i<count) && m_ok; i++)
+		{
+			string name = ReadString();
+			value[name] = ReadString();
+		}
+	}
+
+	//Reads a symbol ID, checking it's in the table
+	Greenpak4NetlistSymbol ReadSymbol(const Greenpak4NetlistSymbolTable& symbols)
+	{
+		uint32_t id = ReadU32();
+		if(id >= symbols.size())
+		{
+			m_ok = false;
+			return Greenpak4NetlistSymbol();
+		}
+		return symbols.Get(id);
+	}
+
+	//Reads an index into a list, checking it's in range (NULL if it's the null index)
+	template<class T> T* ReadRef(const vector<T*>& list)
+	{
+		uint32_t i = ReadU32();
+		if(i == NETLIST_CACHE_NULL)
+			return NULL;
+		if(i >= list.size())
+		{
+			m_ok = false;
+			return NULL;
+		}
+		return list[i];
+	}
+};
+
+/**
+	@brief Computes the cache key for a netlist (64-bit FNV-1a of the salt, then the file contents)
+ */
+uint64_t Greenpak4Netlist::HashNetlist(const char* data, size_t len, string salt)
+{
+	uint64_t hash = HashBytes(salt.c_str(), salt.length());
+
+	//Separate the salt from the data, and include the format version so a format change invalidates everything
+	uint8_t version = NETLIST_CACHE_VERSION;
+	hash = HashBytes(&version, 1, hash);
+
+	return HashBytes(data, len, hash);
+}
+
+/**
+	@brief Adds bytes to a 64-bit FNV-1a hash. Everything in the tools that wants a 64-bit content hash uses this one.
+ */
+uint64_t Greenpak4Netlist::HashBytes(const void* data, size_t len, uint64_t hash)
+{
+	auto bytes = static_cast<const uint8_t*>(data);
+	for(size_t i=0; i<len; i++)
+	{
+		hash ^= bytes[i];
+		hash *= 1099511628211ULL;
+	}
+	return hash;
+}
+
+/**
+	@brief Writes a snapshot of the (indexed) netlist to a cache file
+
+	WriteCacheFile() renames it into place, so concurrent runs never see half of one.
+ */
+bool Greenpak4Netlist::SaveCache(string fname, uint64_t key)
+{
+	vector<uint8_t> buf;
+	buf.push_back('G');
+	buf.push_back('P');
+	buf.push_back('4');
+	buf.push_back('N');
+	CacheWriteU32(buf, NETLIST_CACHE_VERSION);
+	CacheWriteU64(buf, key);
+	CacheWriteU32(buf, m_symbols.size());
+	for(uint32_t i=0; i<m_symbols.size(); i++)
+		CacheWriteString(buf, m_symbols.Get(i));
+	CacheWriteString(buf, m_creator);
+	CacheWriteU32(buf, m_symbols.Intern(m_topModule->m_name).GetID());
+	map<Greenpak4NetlistNode*, uint32_t> topNodeIDs;
+
+	CacheWriteU32(buf, m_modules.size());
+	for(auto mt : m_modules)
+	{
+		Greenpak4NetlistModule* module = mt.second;
+		CacheWriteU32(buf, mt.first.GetID());
+		CacheWriteMap(buf, module->m_attributes);
+		CacheWriteU32(buf, module->m_nextNetNumber);
+
+		//Number everything so we can refer to it
+		map<Greenpak4NetlistNode*, uint32_t> nodeIDs;
+		map<Greenpak4NetlistPort*, uint32_t> portIDs;
+		map<Greenpak4NetlistCell*, uint32_t> cellIDs;
+		uint32_t id = 0;
+		for(auto it : module->m_nodes)
+			nodeIDs[it.second] = id++;
+		id = 0;
+		for(auto it : module->m_ports)
+			portIDs[it.second] = id++;
+		id = 0;
+		for(auto it : module->m_cells)
+			cellIDs[it.second] = id++;
+
+		//Anything we can't find means something got added that we don't know how to save
+		bool ok = true;
+		auto noderef = [&](Greenpak4NetlistNode* node)
+		{
+			if(node == NULL)
+				CacheWriteU32(buf, NETLIST_CACHE_NULL);
+			else if(nodeIDs.find(node) == nodeIDs.end())
+				ok = false;
+			else
+				CacheWriteU32(buf, nodeIDs[node]);
+		};
+
+		CacheWriteU32(buf, module->m_nodes.size());
+		for(auto it : module->m_nodes)
+		{
+			Greenpak4NetlistNode* node = it.second;
+			CacheWriteU32(buf, it.first);
+			CacheWriteString(buf, node->m_name);
+			CacheWriteMap(buf, node->m_attributes);
+			CacheWriteU32(buf, node->m_src_locations.size());
+			for(auto s : node->m_src_locations)
+				CacheWriteString(buf, s);
+		}
+
+		CacheWriteU32(buf, module->m_nets.size());
+		for(auto it : module->m_nets)
+		{
+			CacheWriteU32(buf, it.first.GetID());
+			noderef(it.second);
+		}
+
+		CacheWriteU32(buf, module->m_ports.size());
+		for(auto it : module->m_ports)
+		{
+			Greenpak4NetlistPort* port = it.second;
+			CacheWriteU32(buf, it.first.GetID());
+			CacheWriteU32(buf, port->m_direction);
+			noderef(port->m_net);
+			CacheWriteU32(buf, port->m_nodes.size());
+			for(auto node : port->m_nodes)
+				noderef(node);
+		}
+
+		CacheWriteU32(buf, module->m_cells.size());
+		for(auto it : module->m_cells)
+		{
+			Greenpak4NetlistCell* cell = it.second;
+			CacheWriteU32(buf, it.first.GetID());
+			CacheWriteString(buf, cell->m_type);
+			CacheWriteMap(buf, cell->m_parameters);
+			CacheWriteMap(buf, cell->m_attributes);
+			CacheWriteU32(buf, cell->m_connections.size());
+			for(auto jt : cell->m_connections)
+			{
+				CacheWriteString(buf, jt.first);
+				CacheWriteU32(buf, jt.second.size());
+				for(auto node : jt.second)
+					noderef(node);
+			}
+		}
+
+		//Index data
+		for(auto it : module->m_nodes)
+		{
+			Greenpak4NetlistNode* node = it.second;
+			CacheWriteU32(buf, node->m_nodeports.size());
+			for(auto& p : node->m_nodeports)
+			{
+				if(cellIDs.find(p.m_cell) == cellIDs.end())
+					ok = false;
+				CacheWriteU32(buf, cellIDs[p.m_cell]);
+				CacheWriteU32(buf, p.m_portname.GetID());
+				CacheWriteU32(buf, p.m_nbit);
+				CacheWriteU32(buf, p.m_vector);
+			}
+			CacheWriteU32(buf, node->m_ports.size());
+			for(auto p : node->m_ports)
+			{
+				if(portIDs.find(p) == portIDs.end())
+					ok = false;
+				CacheWriteU32(buf, portIDs[p]);
+			}
+		}
+
+		if(!ok)
+		{
+			LogWarning("Netlist refers to something outside its module, not caching it\n");
+			return false;
+		}
+
+		if(module == m_topModule)
+			topNodeIDs = nodeIDs;
+	}
+
+	//The node list, so we iterate over it in the same order next time
+	CacheWriteU32(buf, m_nodes.size());
+	for(auto node : m_nodes)
+	{
+		if(topNodeIDs.find(node) == topNodeIDs.end())
+		{
+			LogWarning("Netlist refers to something outside its module, not caching it\n");
+			return false;
+		}
+		CacheWriteU32(buf, topNodeIDs[node]);
+	}
+
+	//Where to find the rest of the modules (the key covers the JSON, so it'll be the same file next time)
+	CacheWriteU32(buf, m_moduleLocations.size());
+	for(auto it : m_moduleLocations)
+	{
+		CacheWriteU32(buf, it.first.GetID());
+		CacheWriteU64(buf, it.second.m_offset);
+		CacheWriteU32(buf, it.second.m_line);
+	}
+
+	if(!WriteCacheFile(fname, buf))
+		return false;
+
+	LogVerbose("Wrote netlist cache file %s\n", fname.c_str());
+	return true;
+}
+
+/**
+	@brief Loads a snapshot written by SaveCache()
+
+	@return True on success. False if there's no snapshot, or it's for a different key or out of date (warnings are
+	printed for anything other than a missing file); the netlist is left empty in that case.
+ */
+bool Greenpak4Netlist::LoadCache(string fname, uint64_t key)
+{
+	vector<uint8_t> buf;
+	if(!ReadCacheFile(fname, "GP4N", buf))
+		return false;
+
+	Greenpak4NetlistCacheReader reader(buf);
+	reader.m_pos = 4;
+	if(reader.ReadU32() != NETLIST_CACHE_VERSION)
+		return false;
+	if(reader.ReadU64() != key)
+	{
+		LogWarning("Netlist cache file %s is for a different netlist, ignoring it\n", fname.c_str());
+		return false;
+	}
+
+	uint32_t nsymbols = reader.ReadU32();
+	for(uint32_t i=0; (i<nsymbols) && reader.m_ok; i++)
+	{
+		//Duplicates would shift every ID after them
+		if(m_symbols.Intern(reader.ReadString()).GetID() != i)
+			reader.m_ok = false;
+	}
+
+	m_creator = reader.ReadString();
+	auto top = reader.ReadSymbol(m_symbols);
+	vector<Greenpak4NetlistNode*> topNodes;
+
+	uint32_t nmodules = reader.ReadU32();
+	for(uint32_t i=0; (i<nmodules) && reader.m_ok; i++)
+	{
+		auto name = reader.ReadSymbol(m_symbols);
+		if(!reader.m_ok || (m_modules.find(name) != m_modules.end()) )
+		{
+			reader.m_ok = false;
+			break;
+		}
+		Greenpak4NetlistModule* module = new Greenpak4NetlistModule(this, name);
+		m_modules[name] = module;
+		reader.ReadMap(module->m_attributes);
+		module->m_nextNetNumber = reader.ReadU32();
+
+		vector<Greenpak4NetlistNode*> nodes;
+		uint32_t count = reader.ReadU32();
+		for(uint32_t j=0; (j<count) && reader.m_ok; j++)
+		{
+			int32_t netnum = reader.ReadU32();
+			if(module->m_nodes.find(netnum) != module->m_nodes.end())
+			{
+				reader.m_ok = false;
+				break;
+			}
+			Greenpak4NetlistNode* node = new Greenpak4NetlistNode;
+			module->m_nodes[netnum] = node;
+			nodes.push_back(node);
+
+			node->m_name = reader.ReadString();
+			reader.ReadMap(node->m_attributes);
+			uint32_t nsrc = reader.ReadU32();
+			for(uint32_t k=0; (k<nsrc) && reader.m_ok; k++)
+				node->m_src_locations.push_back(reader.ReadString());
+		}
+
+		count = reader.ReadU32();
+		for(uint32_t j=0; (j<count) && reader.m_ok; j++)
+		{
+			auto name = reader.ReadSymbol(m_symbols);
+			module->m_nets[name] = reader.ReadRef(nodes);
+		}
+
+		vector<Greenpak4NetlistPort*> ports;
+		count = reader.ReadU32();
+		for(uint32_t j=0; (j<count) && reader.m_ok; j++)
+		{
+			auto name = reader.ReadSymbol(m_symbols);
+			if(!reader.m_ok || (module->m_ports.find(name) != module->m_ports.end()) )
+			{
+				reader.m_ok = false;
+				break;
+			}
+			Greenpak4NetlistPort* port = new Greenpak4NetlistPort(module, name);
+			module->m_ports[name] = port;
+			ports.push_back(port);
+
+			uint32_t dir = reader.ReadU32();
+			if(dir > Greenpak4NetlistPort::DIR_INOUT)
+				reader.m_ok = false;
+			port->m_direction = static_cast<Greenpak4NetlistPort::Direction>(dir);
+			port->m_net = reader.ReadRef(nodes);
+			uint32_t nbits = reader.ReadU32();
+			for(uint32_t k=0; (k<nbits) && reader.m_ok; k++)
+			{
+				port->m_nodes.push_back(reader.ReadRef(nodes));
+				if(port->m_nodes.back() == NULL)
+					reader.m_ok = false;
+			}
+		}
+
+		vector<Greenpak4NetlistCell*> cells;
+		count = reader.ReadU32();
+		for(uint32_t j=0; (j<count) && reader.m_ok; j++)
+		{
+			auto name = reader.ReadSymbol(m_symbols);
+			if(!reader.m_ok || (module->m_cells.find(name) != module->m_cells.end()) )
+			{
+				reader.m_ok = false;
+				break;
+			}
+			Greenpak4NetlistCell* cell = new Greenpak4NetlistCell(module);
+			cell->m_name = name;
+			module->m_cells[name] = cell;
+			cells.push_back(cell);
+
+			cell->m_type = reader.ReadString();
+			reader.ReadMap(cell->m_parameters);
+			reader.ReadMap(cell->m_attributes);
+			if(reader.m_ok && !cell->ParseParameters())
+				reader.m_ok = false;
+			uint32_t nconns = reader.ReadU32();
+			for(uint32_t k=0; (k<nconns) && reader.m_ok; k++)
+			{
+				auto& net = cell->m_connections[reader.ReadString()];
+				uint32_t nbits = reader.ReadU32();
+				for(uint32_t b=0; (b<nbits) && reader.m_ok; b++)
+					net.push_back(reader.ReadRef(nodes));
+			}
+		}
+
+		for(uint32_t j=0; (j<nodes.size()) && reader.m_ok; j++)
+		{
+			Greenpak4NetlistNode* node = nodes[j];
+			uint32_t npoints = reader.ReadU32();
+			for(uint32_t k=0; (k<npoints) && reader.m_ok; k++)
+			{
+				Greenpak4NetlistCell* cell = reader.ReadRef(cells);
+				auto portname = reader.ReadSymbol(m_symbols);
+				uint32_t nbit = reader.ReadU32();
+				bool vector = reader.ReadU32();
+				if(cell == NULL)
+					reader.m_ok = false;
+				node->m_nodeports.push_back(Greenpak4NetlistNodePoint(cell, portname, nbit, vector));
+			}
+
+			uint32_t nports = reader.ReadU32();
+			for(uint32_t k=0; (k<nports) && reader.m_ok; k++)
+			{
+				node->m_ports.push_back(reader.ReadRef(ports));
+				if(node->m_ports.back() == NULL)
+					reader.m_ok = false;
+			}
+		}
+
+		if(name == top)
+		{
+			m_topModule = module;
+			topNodes = nodes;
+		}
+
+		module->m_vdd = module->GetNet("GP_VDD");
+		module->m_vss = module->GetNet("GP_VSS");
+		if( (module->m_vdd == NULL) || (module->m_vss == NULL) )
+			reader.m_ok = false;
+	}
+
+	uint32_t count = reader.ReadU32();
+	for(uint32_t i=0; (i<count) && reader.m_ok; i++)
+	{
+		m_nodes.push_back(reader.ReadRef(topNodes));
+		if(m_nodes.back() == NULL)
+			reader.m_ok = false;
+	}
+
+	count = reader.ReadU32();
+	for(uint32_t i=0; (i<count) && reader.m_ok; i++)
+	{
+		auto name = reader.ReadSymbol(m_symbols);
+		uint64_t offset = reader.ReadU64();
+		unsigned int line = reader.ReadU32();
+		if( (offset >= m_dataLength) || (m_modules.find(name) != m_modules.end()) )
+			reader.m_ok = false;
+		else
+			m_moduleLocations[name] = ModuleLocation(offset, line);
+	}
+
+	if(!reader.m_ok || !reader.AtEnd())
+		m_topModule = NULL;
+
+	if(m_topModule == NULL)
+	{
+		LogWarning("Netlist cache file %s is corrupted, ignoring it\n", fname.c_str());
+		Clear();
+		return false;
+	}
+
+	return true;
 }
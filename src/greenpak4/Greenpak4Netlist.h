@@ -22,9 +22,9 @@
 #include <string>
 #include <map>
 #include <set>
+#include <vector>
 
-#include <json-c/json.h>
-
+#include "Greenpak4JSONReader.h"
 #include "Greenpak4NetlistModule.h"
 
 /**
@@ -33,13 +33,15 @@
 class Greenpak4Netlist
 {
 public:
-	Greenpak4Netlist(std::string fname);
+	Greenpak4Netlist(std::string fname, std::string cacheDir = "", std::string cacheSalt = "");
+	Greenpak4Netlist(const char* data, size_t len, std::string cacheDir = "", std::string cacheSalt = "");
 	virtual ~Greenpak4Netlist();
 
 	Greenpak4NetlistModule* GetTopModule()
 	{ return m_topModule; }
 
-	typedef std::set<Greenpak4NetlistNode*> nodeset;
+	//Each node exactly once. The order is arbitrary, but stays the same when loading from the cache.
+	typedef std::vector<Greenpak4NetlistNode*> nodeset;
 
 	nodeset::iterator nodebegin()
 	{ return m_nodes.begin(); }
@@ -47,11 +49,27 @@ public:
 	nodeset::iterator nodeend()
 	{ return m_nodes.end(); }
 
-	Greenpak4NetlistModule* GetModule(std::string name)
-	{ return m_modules[name]; }
+	//Modules other than the top level (and whatever it instantiates) are only parsed when asked for
+	Greenpak4NetlistModule* GetModule(std::string name);
+
+	//Declares a cell library module the netlist doesn't have (yosys only writes out the ones the design uses), so
+	//cells of that type can be added. Returns the existing module if there is one.
+	Greenpak4NetlistModule* AddBlackbox(
+		std::string name,
+		const std::vector<std::string>& inputs,
+		const std::vector<std::string>& outputs);
+
+	Greenpak4NetlistSymbolTable& GetSymbols()
+	{ return m_symbols; }
 
 	void Reindex(bool verbose = true);
 
+	//Identifies netlist contents for caching (also used by anything else that caches results per netlist)
+	static uint64_t HashNetlist(const char* data, size_t len, std::string salt);
+
+	//64-bit FNV-1a, continuing from a previous hash if one is given
+	static uint64_t HashBytes(const void* data, size_t len, uint64_t hash = 14695981039346656037ULL);
+
 	//Returns true if we're good, false if parsing failed for some reason
 	bool Validate()
 	{ return m_parseOK; }
@@ -62,13 +80,46 @@ protected:
 	void ClearIndexes();
 
 	//Init helpers
-	void Load(json_object* object);
-	void LoadModules(json_object* object);
+	void LoadData(std::string cacheDir, std::string cacheSalt);
+	void Load(Greenpak4JSONReader& reader);
+	void LoadModules(Greenpak4JSONReader& reader);
+	bool ScanModule(Greenpak4JSONReader& reader);
+	Greenpak4NetlistModule* LoadModule(Greenpak4NetlistSymbol name);
+
+	//Binary snapshots of the indexed netlist, so we don't have to parse the same JSON over and over
+	bool LoadCache(std::string fname, uint64_t key);
+	bool SaveCache(std::string fname, uint64_t key);
+	void Clear();
 
 	std::string m_creator;
 
-	//All of the modules in the netlist
-	std::map<std::string, Greenpak4NetlistModule*> m_modules;
+	//Every module, cell, net, and port name in the netlist
+	Greenpak4NetlistSymbolTable m_symbols;
+
+	//All of the modules in the netlist we've loaded so far
+	Greenpak4NetlistSymbolMap<Greenpak4NetlistModule*> m_modules;
+
+	//Where to find a module we haven't loaded yet
+	class ModuleLocation
+	{
+	public:
+		ModuleLocation(size_t offset = 0, unsigned int line = 0)
+			: m_offset(offset)
+			, m_line(line)
+		{}
+
+		size_t m_offset;
+		unsigned int m_line;
+	};
+	Greenpak4NetlistSymbolMap<ModuleLocation> m_moduleLocations;
+
+	//The mapped netlist file, or our copy of an in-memory one (NULL if it wasn't mapped, or we loaded from the
+	//cache). Kept around for as long as there are modules still to load from it.
+	const char* m_data;
+	size_t m_dataLength;
+
+	//Backing store for m_data when we were given the JSON in memory (empty if it's mapped)
+	std::vector<char> m_buffer;
 
 	//The top-level module
 	Greenpak4NetlistModule* m_topModule;
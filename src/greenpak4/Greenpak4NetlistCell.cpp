@@ -18,6 +18,8 @@
 
 #include <log.h>
 #include <Greenpak4.h>
+#include <climits>
+#include <cstdlib>
 
 using namespace std;
 
@@ -98,3 +100,52 @@ string Greenpak4NetlistCell::GetLOC()
 	else
 		return loc;
 }
+
+/**
+	@brief Returns the routing matrix a cell is constrained to by its MATRIX attribute, or -1 if the value isn't a
+	matrix number.
+
+	Yosys writes integer attributes as 32-digit binary strings, and string ones as they are, so both
+	(* MATRIX = 1 *) and (* MATRIX = "1" *) work.
+ */
+int Greenpak4NetlistCell::GetMatrixConstraint()
+{
+	string value = m_attributes.at("MATRIX");
+	if(value.empty())
+		return -1;
+	int base = ( (value.length() == 32) && (value.find_first_not_of("01") == string::npos) ) ? 2 : 10;
+
+	char* end;
+	long matrix = strtol(value.c_str(), &end, base);
+	if( (*end != '\0') || (matrix < 0) || (matrix > INT_MAX) )
+		return -1;
+	return matrix;
+}
+
+/**
+	@brief Gets the input ports and truth table of a LUT or inverter, the same way Greenpak4LUT::CommitChanges() does
+	(so a LUT without an INIT is all zeroes).
+
+	Bit i of the table is the output when input port k of the list is bit k of i.
+
+	@return False if the cell isn't a LUT or inverter
+ */
+bool Greenpak4NetlistCell::GetLogicFunction(vector<string>& inputs, uint32_t& table)
+{
+	inputs.clear();
+	if(m_type == "GP_INV")
+	{
+		inputs.push_back("IN");
+		table = 1;
+		return true;
+	}
+
+	if( (m_type != "GP_2LUT") && (m_type != "GP_3LUT") && (m_type != "GP_4LUT") )
+		return false;
+
+	unsigned int order = m_type[3] - '0';
+	for(unsigned int k=0; k<order; k++)
+		inputs.push_back("IN" + to_string(k));
+	table = HasParameter(PARAM_INIT) ? (GetParameter(PARAM_INIT) & ((1 << (1 << order)) - 1)) : 0;
+	return true;
+}
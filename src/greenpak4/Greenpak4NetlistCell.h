@@ -47,6 +47,15 @@ public:
 	bool HasParameter(std::string att)
 	{ return m_parameters.find(att) != m_parameters.end(); }
 
+	bool HasParameter(Greenpak4Parameter param)
+	{ return m_typedParameters.Has(param); }
+
+	int32_t GetParameter(Greenpak4Parameter param)
+	{ return m_typedParameters.Get(param); }
+
+	bool ParseParameters()
+	{ return m_typedParameters.Parse(m_type, m_name, m_parameters); }
+
 	bool HasAttribute(std::string att)
 	{ return m_attributes.find(att) != m_attributes.end(); }
 
@@ -59,12 +68,26 @@ public:
 	bool HasLOC()
 	{ return (m_attributes.find("LOC") != m_attributes.end()); }
 
+	int GetMatrixConstraint();
+
+	bool GetLogicFunction(std::vector<std::string>& inputs, uint32_t& table);
+
+	bool HasMatrixConstraint()
+	{ return (m_attributes.find("MATRIX") != m_attributes.end()); }
+
 	///Module name
 	std::string m_type;
 
 	std::map<std::string, std::string> m_parameters;
 	std::map<std::string, std::string> m_attributes;
 
+	/**
+		@brief m_parameters, parsed and checked against the cell type at load time (see ParseParameters()).
+
+		Anything that changes m_parameters after loading must change these too.
+	 */
+	Greenpak4CellParameters m_typedParameters;
+
 	typedef std::vector<Greenpak4NetlistNode*> cellnet;
 
 	/**
@@ -74,6 +97,9 @@ public:
 	 */
 	std::map<std::string, cellnet > m_connections;
 
+	///Names and types of the cells gp4par packed into this one, in order (they aren't in the netlist any more)
+	std::vector< std::pair<std::string, std::string> > m_packedCells;
+
 	PARGraphNode* m_parnode;
 
 	//Parent module of the cell, not the module we're an instance of
@@ -27,7 +27,7 @@ using namespace std;
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 // Construction / destruction
 
-Greenpak4NetlistModule::Greenpak4NetlistModule(Greenpak4Netlist* parent, std::string name, json_object* object)
+Greenpak4NetlistModule::Greenpak4NetlistModule(Greenpak4Netlist* parent, std::string name, Greenpak4JSONReader& reader)
 	: m_parent(parent)
 	, m_name(name)
 	, m_nextNetNumber(0)
@@ -37,84 +37,55 @@ Greenpak4NetlistModule::Greenpak4NetlistModule(Greenpak4Netlist* parent, std::st
 
 	LogVerbose("%s\n", name.c_str());
 
-	json_object_iterator end = json_object_iter_end(object);
-	for(json_object_iterator it = json_object_iter_begin(object);
-		!json_object_iter_equal(&it, &end);
-		json_object_iter_next(&it))
+	string cname;
+	reader.BeginObject();
+	while(reader.NextMember(cname))
 	{
-		//See what we got
-		string name = json_object_iter_peek_name(&it);
-		json_object* child = json_object_iter_peek_value(&it);
-
 		//Whatever it is, it should be an object
-		if(!json_object_is_type(child, json_type_object))
+		if(reader.PeekType() != Greenpak4JSONReader::TYPE_OBJECT)
 		{
 			LogError("module child should be of type object but isn't\n");
 			m_parseOK = false;
 			return;
 		}
 
-		if(name == "attributes")
-			LoadAttributes(child);
-
-		else
-		{
-			//Go over the children's children and process it
-			json_object_iterator end = json_object_iter_end(child);
-			for(json_object_iterator it2 = json_object_iter_begin(child);
-				!json_object_iter_equal(&it2, &end);
-				json_object_iter_next(&it2))
-			{
-				//See what we got
-				string cname = json_object_iter_peek_name(&it2);
-				json_object* cobject = json_object_iter_peek_value(&it2);
+		if(cname == "attributes")
+			LoadAttributes(reader);
 
-				//Whatever it is, it should be an object
-				if(!json_object_is_type(cobject, json_type_object))
-				{
-					LogError("module child should be of type object but isn't\n");
-					m_parseOK = false;
-					return;
-				}
+		//Load ports
+		else if(cname == "ports")
+			LoadPorts(reader);
 
-				//Load ports
-				if(name == "ports")
-				{
-					//Make sure it doesn't exist
-					if(m_ports.find(cname) != m_ports.end())
-					{
-						LogError("Attempted redeclaration of module port \"%s\"\n", name.c_str());
-						m_parseOK = false;
-						return;
-					}
+		//Load cells
+		else if(cname == "cells")
+		{
+			string name;
+			reader.BeginObject();
+			while(m_parseOK && reader.NextMember(name))
+				LoadCell(name, reader);
+		}
 
-					//Create the port
-					Greenpak4NetlistPort* port = new Greenpak4NetlistPort(this, cname, cobject);
-					if(!port->Validate())
-					{
-						m_parseOK = false;
-						return;
-					}
-					m_ports[cname] = port;
-				}
+		//Load net names
+		else if(cname == "netnames")
+		{
+			string name;
+			reader.BeginObject();
+			while(m_parseOK && reader.NextMember(name))
+				LoadNetName(name, reader);
+		}
 
-				//Load cells
-				else if(name == "cells")
-					LoadCell(cname, cobject);
+		//Whatever it is, we don't want it (parameter defaults, memories, etc)
+		else
+			reader.SkipValue();
 
-				//Load net names
-				else if(name == "netnames")
-					LoadNetName(cname, cobject);
+		if(!m_parseOK)
+			return;
+	}
 
-				//Whatever it is, we don't want it
-				else
-				{
-					LogError("Unknown top-level JSON object \"%s\"\n", name.c_str());
-					m_parseOK = false;
-					return;
-				}
-			}
-		}
+	if(!reader.Validate())
+	{
+		m_parseOK = false;
+		return;
 	}
 
 	//Assign port nets
@@ -122,6 +93,16 @@ Greenpak4NetlistModule::Greenpak4NetlistModule(Greenpak4Netlist* parent, std::st
 		it.second->m_net = m_nets[it.first];
 }
 
+Greenpak4NetlistModule::Greenpak4NetlistModule(Greenpak4Netlist* parent, std::string name)
+	: m_parent(parent)
+	, m_vdd(NULL)
+	, m_vss(NULL)
+	, m_name(name)
+	, m_nextNetNumber(0)
+	, m_parseOK(true)
+{
+}
+
 Greenpak4NetlistModule::~Greenpak4NetlistModule()
 {
 	//Clean up in reverse order
@@ -159,36 +140,96 @@ void Greenpak4NetlistModule::CreatePowerNets()
 	m_nodes[VDD_NETNUM] = m_vdd;
 	m_nodes[VSS_NETNUM] = m_vss;
 
-	m_nets[vdd] = m_vdd;
-	m_nets[vss] = m_vss;
+	m_nets[Intern(vdd)] = m_vdd;
+	m_nets[Intern(vss)] = m_vss;
 
 	//Create driver cells for them
 	Greenpak4NetlistCell* vcell = new Greenpak4NetlistCell(this);
 	vcell->m_name = vdd;
 	vcell->m_type = vdd;
 	vcell->m_connections["OUT"].push_back(m_vdd);
-	m_cells[vdd] = vcell;
+	m_cells[Intern(vdd)] = vcell;
 
 	Greenpak4NetlistCell* gcell = new Greenpak4NetlistCell(this);
 	gcell->m_name = vss;
 	gcell->m_type = vss;
 	gcell->m_connections["OUT"].push_back(m_vss);
-	m_cells[vss] = gcell;
+	m_cells[Intern(vss)] = gcell;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Accessors
+
+Greenpak4NetlistSymbol Greenpak4NetlistModule::Intern(const string& name)
+{
+	return m_parent->GetSymbols().Intern(name);
+}
+
+bool Greenpak4NetlistModule::HasNet(string name)
+{
+	Greenpak4NetlistSymbol sym;
+	if(!m_parent->GetSymbols().Find(name, sym))
+		return false;
+	return (m_nets.find(sym) != m_nets.end());
+}
+
+Greenpak4NetlistNode* Greenpak4NetlistModule::GetNet(string name)
+{
+	Greenpak4NetlistSymbol sym;
+	if(!m_parent->GetSymbols().Find(name, sym))
+		return NULL;
+	auto it = m_nets.find(sym);
+	if(it == m_nets.end())
+		return NULL;
+	return it->second;
+}
+
+Greenpak4NetlistPort* Greenpak4NetlistModule::GetPort(string name)
+{
+	Greenpak4NetlistSymbol sym;
+	if(!m_parent->GetSymbols().Find(name, sym))
+		return NULL;
+	return GetPort(sym);
+}
+
+Greenpak4NetlistPort* Greenpak4NetlistModule::GetPort(const Greenpak4NetlistSymbol& name)
+{
+	auto it = m_ports.find(name);
+	if(it == m_ports.end())
+		return NULL;
+	return it->second;
+}
+
+void Greenpak4NetlistModule::AddCell(Greenpak4NetlistCell* cell)
+{
+	m_cells[Intern(cell->m_name)] = cell;
+}
+
+void Greenpak4NetlistModule::AddNet(Greenpak4NetlistNode* net)
+{
+	m_nets[Intern(net->m_name)] = net;
+	m_nodes[m_nextNetNumber ++] = net;
+}
+
+void Greenpak4NetlistModule::RemoveCell(Greenpak4NetlistCell* cell)
+{
+	auto it = m_cells.find(Intern(cell->m_name));
+	if( (it == m_cells.end()) || (it->second != cell) )
+		return;
+
+	m_cells.erase(it);
+	delete cell;
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 // Loading
 
-void Greenpak4NetlistModule::LoadAttributes(json_object* object)
+void Greenpak4NetlistModule::LoadAttributes(Greenpak4JSONReader& reader)
 {
-	json_object_iterator end = json_object_iter_end(object);
-	for(json_object_iterator it = json_object_iter_begin(object);
-		!json_object_iter_equal(&it, &end);
-		json_object_iter_next(&it))
+	string cname;
+	reader.BeginObject();
+	while(reader.NextMember(cname))
 	{
-		string cname = json_object_iter_peek_name(&it);
-		json_object* child = json_object_iter_peek_value(&it);
-
 		//Make sure we don't have it already
 		if(m_attributes.find(cname) != m_attributes.end())
 		{
@@ -198,8 +239,49 @@ void Greenpak4NetlistModule::LoadAttributes(json_object* object)
 		}
 
 		//Save the attribute
-		m_attributes[cname] = json_object_get_string(child);
+		reader.ReadScalar(m_attributes[cname]);
+	}
+
+	if(!reader.Validate())
+		m_parseOK = false;
+}
+
+void Greenpak4NetlistModule::LoadPorts(Greenpak4JSONReader& reader)
+{
+	string cname;
+	reader.BeginObject();
+	while(reader.NextMember(cname))
+	{
+		//Make sure it doesn't exist
+		auto sym = Intern(cname);
+		if(m_ports.find(sym) != m_ports.end())
+		{
+			LogError("Attempted redeclaration of module port \"%s\"\n", cname.c_str());
+			m_parseOK = false;
+			return;
+		}
+
+		//Whatever it is, it should be an object
+		if(reader.PeekType() != Greenpak4JSONReader::TYPE_OBJECT)
+		{
+			LogError("module child should be of type object but isn't\n");
+			m_parseOK = false;
+			return;
+		}
+
+		//Create the port
+		Greenpak4NetlistPort* port = new Greenpak4NetlistPort(this, cname, reader);
+		if(!port->Validate())
+		{
+			delete port;
+			m_parseOK = false;
+			return;
+		}
+		m_ports[sym] = port;
 	}
+
+	if(!reader.Validate())
+		m_parseOK = false;
 }
 
 Greenpak4NetlistNode* Greenpak4NetlistModule::GetNode(int32_t netnum)
@@ -218,68 +300,76 @@ Greenpak4NetlistNode* Greenpak4NetlistModule::GetNode(int32_t netnum)
 	return m_nodes[netnum];
 }
 
-void Greenpak4NetlistModule::LoadCell(std::string name, json_object* object)
+void Greenpak4NetlistModule::LoadCell(std::string name, Greenpak4JSONReader& reader)
 {
+	//Whatever it is, it should be an object
+	if(reader.PeekType() != Greenpak4JSONReader::TYPE_OBJECT)
+	{
+		LogError("module child should be of type object but isn't\n");
+		m_parseOK = false;
+		return;
+	}
+
 	Greenpak4NetlistCell* cell = new Greenpak4NetlistCell(this);
 	cell->m_name = name;
-	m_cells[name] = cell;
+	m_cells[Intern(name)] = cell;
 
-	json_object_iterator end = json_object_iter_end(object);
-	for(json_object_iterator it = json_object_iter_begin(object);
-		!json_object_iter_equal(&it, &end);
-		json_object_iter_next(&it))
+	string cname;
+	reader.BeginObject();
+	while(reader.NextMember(cname))
 	{
-		//See what we got
-		string cname = json_object_iter_peek_name(&it);
-		json_object* child = json_object_iter_peek_value(&it);
-
-		//Ignore hide_name request for now
-		if(cname == "hide_name")
-		{
-
-		}
-
 		//Type of cell
-		else if(cname == "type")
+		if(cname == "type")
 		{
-			if(!json_object_is_type(child, json_type_string))
+			if(reader.PeekType() != Greenpak4JSONReader::TYPE_STRING)
 			{
 				LogError("Cell type should be of type string but isn't\n");
 				m_parseOK = false;
 				return;
 			}
 
-			cell->m_type = json_object_get_string(child);
+			reader.ReadString(cell->m_type);
 		}
 
 		else if(cname == "attributes")
-			LoadCellAttributes(cell, child);
+			LoadCellAttributes(cell, reader);
 
 		else if(cname == "parameters")
-			LoadCellParameters(cell, child);
+			LoadCellParameters(cell, reader);
 
 		else if(cname == "connections")
-			LoadCellConnections(cell, child);
+			LoadCellConnections(cell, reader);
 
-		//redundant, we can look this up from the module
-		else if(cname == "port_directions")
-		{
-		}
-
-		//Unsupported
+		//Ignore hide_name request for now.
+		//port_directions is redundant, we can look this up from the module.
+		//Anything else we don't use either.
 		else
-		{
-			LogError("Unknown cell child object \"%s\"\n", cname.c_str());
-			m_parseOK = false;
+			reader.SkipValue();
+
+		if(!m_parseOK)
 			return;
-		}
 	}
+
+	if(!reader.Validate())
+		m_parseOK = false;
+
+	//Check the parameters now so nothing downstream has to
+	else if(!cell->ParseParameters())
+		m_parseOK = false;
 }
 
-void Greenpak4NetlistModule::LoadNetName(std::string name, json_object* object)
+void Greenpak4NetlistModule::LoadNetName(std::string name, Greenpak4JSONReader& reader)
 {
+	//Whatever it is, it should be an object
+	if(reader.PeekType() != Greenpak4JSONReader::TYPE_OBJECT)
+	{
+		LogError("module child should be of type object but isn't\n");
+		m_parseOK = false;
+		return;
+	}
+
 	//Create the named net
-	if(m_nets.find(name) != m_nets.end())
+	if(m_nets.find(Intern(name)) != m_nets.end())
 	{
 		LogError("Attempted redeclaration of net \"%s\" \n", name.c_str());
 		m_parseOK = false;
@@ -288,41 +378,32 @@ void Greenpak4NetlistModule::LoadNetName(std::string name, json_object* object)
 
 	vector<Greenpak4NetlistNode*> nodes;
 
-	json_object_iterator end = json_object_iter_end(object);
-	for(json_object_iterator it = json_object_iter_begin(object);
-		!json_object_iter_equal(&it, &end);
-		json_object_iter_next(&it))
+	string cname;
+	reader.BeginObject();
+	while(reader.NextMember(cname))
 	{
-		string cname = json_object_iter_peek_name(&it);
-		json_object* child = json_object_iter_peek_value(&it);
-
-		//Ignore hide_name request for now
-		if(cname == "hide_name")
-		{
-		}
-
 		//Bits - list of nets this name is assigned to
-		else if(cname == "bits")
+		if(cname == "bits")
 		{
-			if(!json_object_is_type(child, json_type_array))
+			if(reader.PeekType() != Greenpak4JSONReader::TYPE_ARRAY)
 			{
 				LogError("Net name bits should be of type array but isn't\n");
 				m_parseOK = false;
 				return;
 			}
 
-			//Walk the array
-			int len = json_object_array_length(child);
-			for(int i=0; i<len; i++)
+			//Read the array. We need the length to name the bits, so grab it all first.
+			vector<int32_t> netnums;
+			reader.BeginArray();
+			while(reader.NextElement())
 			{
-				json_object* jnode = json_object_array_get_idx(child, i);
-
-				int netnum = -1;
+				int32_t netnum = -1;
 
 				//If it's the string "x", the remaining bits of the signal are unused
-				if(json_object_is_type(jnode, json_type_string))
+				if(reader.PeekType() == Greenpak4JSONReader::TYPE_STRING)
 				{
-					string value = json_object_get_string(jnode);
+					string value;
+					reader.ReadString(value);
 					if(value != "x")
 					{
 						LogError("Net number in module should be of type integer, or \"x\", but isn't\n");
@@ -332,30 +413,40 @@ void Greenpak4NetlistModule::LoadNetName(std::string name, json_object* object)
 				}
 
 				//Should be an integer if we get here
-				else
+				else if(reader.PeekType() != Greenpak4JSONReader::TYPE_NUMBER)
 				{
-					if(!json_object_is_type(jnode, json_type_int))
-					{
-						LogError("Net number in module should be of type integer but isn't\n");
-						m_parseOK = false;
-						return;
-					}
-
-					netnum = json_object_get_int(jnode);
+					LogError("Net number in module should be of type integer but isn't\n");
+					m_parseOK = false;
+					return;
 				}
 
+				else
+					reader.ReadInt(netnum);
+
+				netnums.push_back(netnum);
+			}
+			if(!reader.Validate())
+			{
+				m_parseOK = false;
+				return;
+			}
+
+			for(size_t i=0; i<netnums.size(); i++)
+			{
+				int32_t netnum = netnums[i];
+
 				//Look up net number and name
 				string bname = name;
-				if(len > 1)
+				if(netnums.size() > 1)
 				{
 					char tmp[256];
-					snprintf(tmp, sizeof(tmp), "%s[%d]", name.c_str(), i);
+					snprintf(tmp, sizeof(tmp), "%s[%d]", name.c_str(), (int)i);
 					bname = tmp;
 				}
 
 				//Special checking needed for unconnected nets in a vector
 				if(netnum < 0)
-					m_nets[bname] = NULL;
+					m_nets[Intern(bname)] = NULL;
 
 				else
 				{
@@ -365,7 +456,7 @@ void Greenpak4NetlistModule::LoadNetName(std::string name, json_object* object)
 
 					//Set up name etc
 					node->m_name = bname;
-					m_nets[bname] = node;
+					m_nets[Intern(bname)] = node;
 				}
 			}
 		}
@@ -373,7 +464,7 @@ void Greenpak4NetlistModule::LoadNetName(std::string name, json_object* object)
 		//Attributes - array of name-value pairs
 		else if(cname == "attributes")
 		{
-			if(!json_object_is_type(child, json_type_object))
+			if(reader.PeekType() != Greenpak4JSONReader::TYPE_OBJECT)
 			{
 				LogError("Net attributes should be of type object but isn't\n");
 				m_parseOK = false;
@@ -381,64 +472,68 @@ void Greenpak4NetlistModule::LoadNetName(std::string name, json_object* object)
 			}
 
 			//Same attributes for all nodes in the vector net
-			for(auto node : nodes)
-				LoadNetAttributes(node, child);
+			LoadNetAttributes(nodes, reader);
+			if(!m_parseOK)
+				return;
 		}
 
-		//Unsupported
+		//Ignore hide_name request for now, and anything else we don't use
 		else
-		{
-			LogError("Unknown netname child object \"%s\"\n", cname.c_str());
-			m_parseOK = false;
-			return;
-		}
+			reader.SkipValue();
 	}
+
+	if(!reader.Validate())
+		m_parseOK = false;
 }
 
-void Greenpak4NetlistModule::LoadNetAttributes(Greenpak4NetlistNode* net, json_object* object)
+void Greenpak4NetlistModule::LoadNetAttributes(vector<Greenpak4NetlistNode*>& nets, Greenpak4JSONReader& reader)
 {
-	json_object_iterator end = json_object_iter_end(object);
-	for(json_object_iterator it = json_object_iter_begin(object);
-		!json_object_iter_equal(&it, &end);
-		json_object_iter_next(&it))
+	string cname;
+	reader.BeginObject();
+	while(reader.NextMember(cname))
 	{
-		string cname = json_object_iter_peek_name(&it);
-		json_object* child = json_object_iter_peek_value(&it);
-
 		//no type check, convert whatever it is to a string
-		string value = json_object_get_string(child);
-
-		//We can have multiple source locations for a single net
-		if(cname == "src")
-		{
-			net->m_src_locations.push_back(value);
-			continue;
-		}
+		string value;
+		reader.ReadScalar(value);
 
-		//Make sure we don't have it already
-		if(net->m_attributes.find(cname) != net->m_attributes.end())
+		for(auto net : nets)
 		{
-			LogError("Attempted redeclaration of net attribute \"%s\"\n", cname.c_str());
-			m_parseOK = false;
-			return;
-		}
+			//We can have multiple source locations for a single net
+			if(cname == "src")
+			{
+				net->m_src_locations.push_back(value);
+				continue;
+			}
 
-		//LogNotice("    net %s attribute %s = %s\n", net->m_name.c_str(), cname.c_str(), json_object_get_string(child));
+			//Make sure we don't have it already
+			if(net->m_attributes.find(cname) != net->m_attributes.end())
+			{
+				LogError("Attempted redeclaration of net attribute \"%s\"\n", cname.c_str());
+				m_parseOK = false;
+				return;
+			}
 
-		//Save the attribute
-		net->m_attributes[cname] = value;
+			//Save the attribute
+			net->m_attributes[cname] = value;
+		}
 	}
+
+	if(!reader.Validate())
+		m_parseOK = false;
 }
 
-void Greenpak4NetlistModule::LoadCellAttributes(Greenpak4NetlistCell* cell, json_object* object)
+void Greenpak4NetlistModule::LoadCellAttributes(Greenpak4NetlistCell* cell, Greenpak4JSONReader& reader)
 {
-	json_object_iterator end = json_object_iter_end(object);
-	for(json_object_iterator it = json_object_iter_begin(object);
-		!json_object_iter_equal(&it, &end);
-		json_object_iter_next(&it))
+	string cname;
+	reader.BeginObject();
+	while(reader.NextMember(cname))
 	{
-		string cname = json_object_iter_peek_name(&it);
-		json_object* child = json_object_iter_peek_value(&it);
+		//Source locations of cells are never used, and for big designs they're most of the file
+		if(cname == "src")
+		{
+			reader.SkipValue();
+			continue;
+		}
 
 		//Make sure we don't have it already
 		if(cell->m_attributes.find(cname) != cell->m_attributes.end())
@@ -449,20 +544,19 @@ void Greenpak4NetlistModule::LoadCellAttributes(Greenpak4NetlistCell* cell, json
 		}
 
 		//Save the attribute
-		cell->m_attributes[cname] = json_object_get_string(child);
+		reader.ReadScalar(cell->m_attributes[cname]);
 	}
+
+	if(!reader.Validate())
+		m_parseOK = false;
 }
 
-void Greenpak4NetlistModule::LoadCellParameters(Greenpak4NetlistCell* cell, json_object* object)
+void Greenpak4NetlistModule::LoadCellParameters(Greenpak4NetlistCell* cell, Greenpak4JSONReader& reader)
 {
-	json_object_iterator end = json_object_iter_end(object);
-	for(json_object_iterator it = json_object_iter_begin(object);
-		!json_object_iter_equal(&it, &end);
-		json_object_iter_next(&it))
+	string cname;
+	reader.BeginObject();
+	while(reader.NextMember(cname))
 	{
-		string cname = json_object_iter_peek_name(&it);
-		json_object* child = json_object_iter_peek_value(&it);
-
 		//No type check, just convert back to string
 
 		//Make sure we don't have it already
@@ -474,44 +568,38 @@ void Greenpak4NetlistModule::LoadCellParameters(Greenpak4NetlistCell* cell, json
 		}
 
 		//Save the attribute
-		cell->m_parameters[cname] = json_object_get_string(child);
+		reader.ReadScalar(cell->m_parameters[cname]);
 	}
+
+	if(!reader.Validate())
+		m_parseOK = false;
 }
 
-void Greenpak4NetlistModule::LoadCellConnections(Greenpak4NetlistCell* cell, json_object* object)
+void Greenpak4NetlistModule::LoadCellConnections(Greenpak4NetlistCell* cell, Greenpak4JSONReader& reader)
 {
-	json_object_iterator end = json_object_iter_end(object);
-	for(json_object_iterator it = json_object_iter_begin(object);
-		!json_object_iter_equal(&it, &end);
-		json_object_iter_next(&it))
+	string cname;
+	reader.BeginObject();
+	while(reader.NextMember(cname))
 	{
-		string cname = json_object_iter_peek_name(&it);
-		json_object* child = json_object_iter_peek_value(&it);
-
-		if(!json_object_is_type(child, json_type_array))
+		if(reader.PeekType() != Greenpak4JSONReader::TYPE_ARRAY)
 		{
 			LogError("Cell connection value should be of type array but isn't\n");
 			m_parseOK = false;
 			return;
 		}
 
-		//Sanity check the length. If empty, bail without creating a floating net.
-		//Otherwise should be 1 bit
-		int len = json_object_array_length(child);
-		if(len == 0)
-			continue;
-
-		//May have multiple bits if it's a vector port
-		for(int i=0; i<len; i++)
+		//May have multiple bits if it's a vector port.
+		//If empty, we don't create a floating net.
+		reader.BeginArray();
+		while(reader.NextElement())
 		{
 			Greenpak4NetlistNode* node = NULL;
 
-			json_object* jnode = json_object_array_get_idx(child, i);
-
 			//If it's a string, it's a constant one or zero
-			if(json_object_is_type(jnode, json_type_string))
+			if(reader.PeekType() == Greenpak4JSONReader::TYPE_STRING)
 			{
-				string s = json_object_get_string(jnode);
+				string s;
+				reader.ReadString(s);
 				if(s == "1")
 					node = m_vdd;
 				else
@@ -519,7 +607,7 @@ void Greenpak4NetlistModule::LoadCellConnections(Greenpak4NetlistCell* cell, jso
 			}
 
 			//Otherwise it has to be an integer
-			else if(!json_object_is_type(jnode, json_type_int))
+			else if(reader.PeekType() != Greenpak4JSONReader::TYPE_NUMBER)
 			{
 				LogError("Net number for cell should be of type integer but isn't\n");
 				m_parseOK = false;
@@ -527,10 +615,18 @@ void Greenpak4NetlistModule::LoadCellConnections(Greenpak4NetlistCell* cell, jso
 			}
 
 			else
-				node = GetNode(json_object_get_int(jnode));
+			{
+				int32_t netnum;
+				if(!reader.ReadInt(netnum))
+					break;
+				node = GetNode(netnum);
+			}
 
 			//Hook up the connection
 			cell->m_connections[cname].push_back(node);
 		}
 	}
+
+	if(!reader.Validate())
+		m_parseOK = false;
 }
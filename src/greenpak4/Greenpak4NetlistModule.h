@@ -21,9 +21,11 @@
 
 #include <string>
 #include <vector>
-#include <json-c/json.h>
+
+#include "Greenpak4NetlistSymbol.h"
 
 class Greenpak4Netlist;
+class Greenpak4JSONReader;
 class Greenpak4NetlistPort;
 class Greenpak4NetlistNode;
 
@@ -33,7 +35,7 @@ class Greenpak4NetlistNode;
 class Greenpak4NetlistModule
 {
 public:
-	Greenpak4NetlistModule(Greenpak4Netlist* parent, std::string name, json_object* object);
+	Greenpak4NetlistModule(Greenpak4Netlist* parent, std::string name, Greenpak4JSONReader& reader);
 	virtual ~Greenpak4NetlistModule();
 
 	Greenpak4NetlistNode* GetNode(int32_t netnum);
@@ -43,9 +45,9 @@ public:
 
 	std::map<std::string, std::string> m_attributes;
 
-	typedef std::map<std::string, Greenpak4NetlistPort*> portmap;
-	typedef std::map<std::string, Greenpak4NetlistCell*> cellmap;
-	typedef std::map<std::string, Greenpak4NetlistNode*> netmap;
+	typedef Greenpak4NetlistSymbolMap<Greenpak4NetlistPort*> portmap;
+	typedef Greenpak4NetlistSymbolMap<Greenpak4NetlistCell*> cellmap;
+	typedef Greenpak4NetlistSymbolMap<Greenpak4NetlistNode*> netmap;
 
 	portmap::iterator port_begin()
 	{ return m_ports.begin(); }
@@ -65,34 +67,36 @@ public:
 	netmap::iterator net_end()
 	{ return m_nets.end(); }
 
-	bool HasNet(std::string name)
-	{ return (m_nets.find(name) != m_nets.end()); }
-
-	Greenpak4NetlistNode* GetNet(std::string name)
-	{ return m_nets[name]; }
-
-	Greenpak4NetlistPort* GetPort(std::string name)
-	{ return m_ports[name]; }
+	bool HasNet(std::string name);
+	Greenpak4NetlistNode* GetNet(std::string name);
+	Greenpak4NetlistPort* GetPort(std::string name);
+	Greenpak4NetlistPort* GetPort(const Greenpak4NetlistSymbol& name);
 
 	Greenpak4Netlist* GetNetlist()
 	{ return m_parent; }
 
-	//Add an extra cell (used by make_graphs to add inferred ACMPs etc)
-	void AddCell(Greenpak4NetlistCell* cell)
-	{ m_cells[cell->m_name] = cell; }
+	//Add an extra cell (used by make_graphs to add inferred ACMPs etc).
+	//This invalidates cell iterators.
+	void AddCell(Greenpak4NetlistCell* cell);
+
+	//Add an extra net (used by make_graphs to add inferred VREFs etc).
+	//This invalidates net iterators.
+	void AddNet(Greenpak4NetlistNode* net);
 
-	//Add an extra net (used by make_graphs to add inferred VREFs etc)
-	void AddNet(Greenpak4NetlistNode* net)
-	{
-		m_nets[net->m_name] = net;
-		m_nodes[m_nextNetNumber ++] = net;
-	}
+	//Remove and delete a cell (used by the pre-PAR optimizer).
+	//Nets still point to it until the netlist is reindexed. This invalidates cell iterators.
+	void RemoveCell(Greenpak4NetlistCell* cell);
 
 	//Returns true if we're good, false if parsing failed for some reason
 	bool Validate()
 	{ return m_parseOK; }
 
 protected:
+	friend class Greenpak4Netlist;
+
+	//Creates an empty module (used when loading a cached netlist)
+	Greenpak4NetlistModule(Greenpak4Netlist* parent, std::string name);
+
 	Greenpak4Netlist* m_parent;
 
 	///Internal power/ground nets
@@ -103,13 +107,16 @@ protected:
 
 	std::string m_name;
 
-	void LoadAttributes(json_object* object);
-	void LoadNetName(std::string name, json_object* object);
-	void LoadNetAttributes(Greenpak4NetlistNode* net, json_object* object);
-	void LoadCell(std::string name, json_object* object);
-	void LoadCellAttributes(Greenpak4NetlistCell* cell, json_object* object);
-	void LoadCellParameters(Greenpak4NetlistCell* cell, json_object* object);
-	void LoadCellConnections(Greenpak4NetlistCell* cell, json_object* object);
+	Greenpak4NetlistSymbol Intern(const std::string& name);
+
+	void LoadAttributes(Greenpak4JSONReader& reader);
+	void LoadPorts(Greenpak4JSONReader& reader);
+	void LoadNetName(std::string name, Greenpak4JSONReader& reader);
+	void LoadNetAttributes(std::vector<Greenpak4NetlistNode*>& nets, Greenpak4JSONReader& reader);
+	void LoadCell(std::string name, Greenpak4JSONReader& reader);
+	void LoadCellAttributes(Greenpak4NetlistCell* cell, Greenpak4JSONReader& reader);
+	void LoadCellParameters(Greenpak4NetlistCell* cell, Greenpak4JSONReader& reader);
+	void LoadCellConnections(Greenpak4NetlistCell* cell, Greenpak4JSONReader& reader);
 
 	std::map<int32_t, Greenpak4NetlistNode*> m_nodes;
 	portmap m_ports;
@@ -27,7 +27,11 @@ class Greenpak4NetlistNodePoint
 {
 public:
 
-	Greenpak4NetlistNodePoint(Greenpak4NetlistCell* cell, std::string port, unsigned int nbit, bool vector)
+	Greenpak4NetlistNodePoint(
+		Greenpak4NetlistCell* cell,
+		Greenpak4NetlistSymbol port,
+		unsigned int nbit,
+		bool vector)
 		: m_cell(cell)
 		, m_portname(port)
 		, m_nbit(nbit)
@@ -38,7 +42,7 @@ public:
 	{ return (m_cell == NULL); }
 
 	Greenpak4NetlistCell* m_cell;
-	std::string m_portname;
+	Greenpak4NetlistSymbol m_portname;
 	unsigned int m_nbit;
 	bool m_vector;
 };
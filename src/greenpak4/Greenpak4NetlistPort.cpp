@@ -22,14 +22,17 @@
 using namespace std;
 
 Greenpak4NetlistNode::Greenpak4NetlistNode()
-	: m_driver(NULL, "", -1, false)
+	: m_driver(NULL, Greenpak4NetlistSymbol(), -1, false)
 {
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 // Construction / destruction
 
-Greenpak4NetlistPort::Greenpak4NetlistPort(Greenpak4NetlistModule* module, std::string name, json_object* object)
+Greenpak4NetlistPort::Greenpak4NetlistPort(
+	Greenpak4NetlistModule* module,
+	std::string name,
+	Greenpak4JSONReader& reader)
 	: Greenpak4NetlistEntity(name)
 	, m_direction(DIR_INPUT)
 	, m_module(module)
@@ -37,19 +40,14 @@ Greenpak4NetlistPort::Greenpak4NetlistPort(Greenpak4NetlistModule* module, std::
 	, m_parnode(NULL)
 	, m_parseOK(true)
 {
-	json_object_iterator end = json_object_iter_end(object);
-	for(json_object_iterator it = json_object_iter_begin(object);
-		!json_object_iter_equal(&it, &end);
-		json_object_iter_next(&it))
+	string cname;
+	reader.BeginObject();
+	while(reader.NextMember(cname))
 	{
-		//See what we got
-		string name = json_object_iter_peek_name(&it);
-		json_object* child = json_object_iter_peek_value(&it);
-
 		//Direction should be a string from the enumerated list
-		if(name == "direction")
+		if(cname == "direction")
 		{
-			if(!json_object_is_type(child, json_type_string))
+			if(reader.PeekType() != Greenpak4JSONReader::TYPE_STRING)
 			{
 				LogError("Port direction should be of type string but isn't\n");
 				m_parseOK = false;
@@ -57,7 +55,8 @@ Greenpak4NetlistPort::Greenpak4NetlistPort(Greenpak4NetlistModule* module, std::
 			}
 
 			//See what the direction is
-			string str = json_object_get_string(child);
+			string str;
+			reader.ReadString(str);
 			if(str == "input")
 				m_direction = Greenpak4NetlistPort::DIR_INPUT;
 			else if(str == "output")
@@ -73,9 +72,9 @@ Greenpak4NetlistPort::Greenpak4NetlistPort(Greenpak4NetlistModule* module, std::
 		}
 
 		//List of nodes in the object (should be an array)
-		else if(name == "bits")
+		else if(cname == "bits")
 		{
-			if(!json_object_is_type(child, json_type_array))
+			if(reader.PeekType() != Greenpak4JSONReader::TYPE_ARRAY)
 			{
 				LogError("Port bits (for module %s, port %s) should be of type array but isn't\n",
 					module->GetName().c_str(), name.c_str());
@@ -84,30 +83,44 @@ Greenpak4NetlistPort::Greenpak4NetlistPort(Greenpak4NetlistModule* module, std::
 			}
 
 			//Walk the array
-			int len = json_object_array_length(child);
-			for(int i=0; i<len; i++)
+			reader.BeginArray();
+			while(reader.NextElement())
 			{
-				json_object* jnode = json_object_array_get_idx(child, i);
-				if(!json_object_is_type(jnode, json_type_int))
+				int32_t netnum;
+				if(reader.PeekType() != Greenpak4JSONReader::TYPE_NUMBER)
 				{
 					LogError("Net number of port \"%s\" should be of type integer but isn't\n",
 						m_name.c_str());
 					m_parseOK = false;
-				return;
+					return;
 				}
+				if(!reader.ReadInt(netnum))
+					break;
 
-				m_nodes.push_back(module->GetNode(json_object_get_int(jnode)));
+				m_nodes.push_back(module->GetNode(netnum));
 			}
 		}
 
-		//Garbage
+		//Anything else (signedness, bit offsets, etc) we don't use
 		else
-		{
-			LogError("Unknown JSON blob \"%s\" under module port list\n", name.c_str());
-			m_parseOK = false;
-			return;
-		}
+			reader.SkipValue();
 	}
+
+	if(!reader.Validate())
+		m_parseOK = false;
+}
+
+/**
+	@brief Creates a port with no bits (used when loading a cached netlist)
+ */
+Greenpak4NetlistPort::Greenpak4NetlistPort(Greenpak4NetlistModule* module, std::string name)
+	: Greenpak4NetlistEntity(name)
+	, m_direction(DIR_INPUT)
+	, m_module(module)
+	, m_net(NULL)
+	, m_parnode(NULL)
+	, m_parseOK(true)
+{
 }
 
 Greenpak4NetlistPort::~Greenpak4NetlistPort()
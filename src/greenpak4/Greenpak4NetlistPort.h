@@ -21,13 +21,13 @@
 
 #include <string>
 #include <vector>
-#include <json-c/json.h>
 
 //A module port (attached to one or more nodes)
 class Greenpak4NetlistPort : public Greenpak4NetlistEntity
 {
 public:
-	Greenpak4NetlistPort(Greenpak4NetlistModule* module, std::string name, json_object* object);
+	Greenpak4NetlistPort(Greenpak4NetlistModule* module, std::string name, Greenpak4JSONReader& reader);
+	Greenpak4NetlistPort(Greenpak4NetlistModule* module, std::string name);
 	virtual ~Greenpak4NetlistPort();
 
 	enum Direction
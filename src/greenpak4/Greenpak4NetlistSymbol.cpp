@@ -0,0 +1,54 @@
+/***********************************************************************************************************************
+ * Copyright (C) 2016 Andrew Zonenberg and contributors                                                                *
+ *                                                                                                                     *
+ * This program is free software; you can redistribute it and/or modify it under the terms of the GNU Lesser General   *
+ * Public License as published by the Free Software Foundation; either version 2.1 of the License, or (at your option) *
+ * any later version.                                                                                                  *
+ *                                                                                                                     *
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied  *
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for     *
+ * more details.                                                                                                       *
+ *                                                                                                                     *
+ * You should have received a copy of the GNU Lesser General Public License along with this program; if not, you may   *
+ * find one here:                                                                                                      *
+ * https://www.gnu.org/licenses/old-licenses/lgpl-2.1.txt                                                              *
+ * or you may search the http://www.gnu.org website for the version 2.1 license, or you may write to the Free Software *
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA                                      *
+ **********************************************************************************************************************/
+
+#include <Greenpak4.h>
+
+using namespace std;
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Symbol table
+
+/**
+	@brief Gets the symbol for a name, adding it to the table if it's new
+ */
+Greenpak4NetlistSymbol Greenpak4NetlistSymbolTable::Intern(const string& name)
+{
+	auto it = m_ids.find(name);
+	if(it != m_ids.end())
+		return Get(it->second);
+
+	uint32_t id = m_names.size();
+	m_names.push_back(name);
+	m_ids[name] = id;
+	return Get(id);
+}
+
+/**
+	@brief Looks up the symbol for a name without adding it
+
+	@return True if the name is in the table
+ */
+bool Greenpak4NetlistSymbolTable::Find(const string& name, Greenpak4NetlistSymbol& symbol) const
+{
+	auto it = m_ids.find(name);
+	if(it == m_ids.end())
+		return false;
+
+	symbol = Get(it->second);
+	return true;
+}
@@ -0,0 +1,196 @@
+/***********************************************************************************************************************
+ * Copyright (C) 2016 Andrew Zonenberg and contributors                                                                *
+ *                                                                                                                     *
+ * This program is free software; you can redistribute it and/or modify it under the terms of the GNU Lesser General   *
+ * Public License as published by the Free Software Foundation; either version 2.1 of the License, or (at your option) *
+ * any later version.                                                                                                  *
+ *                                                                                                                     *
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied  *
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for     *
+ * more details.                                                                                                       *
+ *                                                                                                                     *
+ * You should have received a copy of the GNU Lesser General Public License along with this program; if not, you may   *
+ * find one here:                                                                                                      *
+ * https://www.gnu.org/licenses/old-licenses/lgpl-2.1.txt                                                              *
+ * or you may search the http://www.gnu.org website for the version 2.1 license, or you may write to the Free Software *
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA                                      *
+ **********************************************************************************************************************/
+
+#ifndef Greenpak4NetlistSymbol_h
+#define Greenpak4NetlistSymbol_h
+
+#include <algorithm>
+#include <deque>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+/**
+	@brief An interned name in a Greenpak4Netlist
+
+	Two symbols from the same netlist are equal if and only if their IDs are, so comparing and sorting them never
+	looks at the characters. They convert to std::string for everything else.
+ */
+class Greenpak4NetlistSymbol
+{
+public:
+	Greenpak4NetlistSymbol()
+		: m_id(0xffffffff)
+		, m_name(&Empty())
+	{}
+
+	Greenpak4NetlistSymbol(uint32_t id, const std::string* name)
+		: m_id(id)
+		, m_name(name)
+	{}
+
+	uint32_t GetID() const
+	{ return m_id; }
+
+	//True for a default-constructed symbol, which isn't in any table
+	bool IsNull() const
+	{ return (m_id == 0xffffffff); }
+
+	const std::string& str() const
+	{ return *m_name; }
+
+	const char* c_str() const
+	{ return m_name->c_str(); }
+
+	operator const std::string&() const
+	{ return *m_name; }
+
+	bool operator==(const Greenpak4NetlistSymbol& rhs) const
+	{ return m_id == rhs.m_id; }
+
+	bool operator!=(const Greenpak4NetlistSymbol& rhs) const
+	{ return m_id != rhs.m_id; }
+
+	bool operator<(const Greenpak4NetlistSymbol& rhs) const
+	{ return m_id < rhs.m_id; }
+
+	bool operator==(const std::string& rhs) const
+	{ return *m_name == rhs; }
+
+	bool operator!=(const std::string& rhs) const
+	{ return *m_name != rhs; }
+
+	bool operator==(const char* rhs) const
+	{ return *m_name == rhs; }
+
+	bool operator!=(const char* rhs) const
+	{ return *m_name != rhs; }
+
+protected:
+	static const std::string& Empty()
+	{
+		static std::string empty;
+		return empty;
+	}
+
+	uint32_t m_id;
+	const std::string* m_name;
+};
+
+inline bool operator==(const std::string& lhs, const Greenpak4NetlistSymbol& rhs)
+{ return rhs == lhs; }
+
+inline bool operator!=(const std::string& lhs, const Greenpak4NetlistSymbol& rhs)
+{ return rhs != lhs; }
+
+/**
+	@brief All of the names in a netlist. Each distinct string is stored exactly once.
+
+	IDs are handed out in the order names are first seen, starting from zero.
+ */
+class Greenpak4NetlistSymbolTable
+{
+public:
+	Greenpak4NetlistSymbol Intern(const std::string& name);
+	bool Find(const std::string& name, Greenpak4NetlistSymbol& symbol) const;
+
+	Greenpak4NetlistSymbol Get(uint32_t id) const
+	{ return Greenpak4NetlistSymbol(id, &m_names[id]); }
+
+	uint32_t size() const
+	{ return m_names.size(); }
+
+	void clear()
+	{
+		m_ids.clear();
+		m_names.clear();
+	}
+
+protected:
+	std::unordered_map<std::string, uint32_t> m_ids;
+
+	//Deque so the strings never move (symbols point to them)
+	std::deque<std::string> m_names;
+};
+
+/**
+	@brief A map from symbols to T, stored as a flat vector sorted by symbol ID
+
+	Lookups are a binary search over integers. Symbols are normally interned as they're loaded, so nearly all
+	insertions go at the end. Iteration is in ID order, i.e. the order names first appeared in the netlist.
+
+	Unlike std::map, inserting invalidates iterators.
+ */
+template<class T>
+class Greenpak4NetlistSymbolMap
+{
+public:
+	typedef std::pair<Greenpak4NetlistSymbol, T> value_type;
+	typedef typename std::vector<value_type>::iterator iterator;
+
+	iterator begin()
+	{ return m_items.begin(); }
+
+	iterator end()
+	{ return m_items.end(); }
+
+	size_t size() const
+	{ return m_items.size(); }
+
+	void clear()
+	{ m_items.clear(); }
+
+	void erase(iterator it)
+	{ m_items.erase(it); }
+
+	iterator find(const Greenpak4NetlistSymbol& key)
+	{
+		auto it = LowerBound(key);
+		if( (it != m_items.end()) && (it->first == key) )
+			return it;
+		return m_items.end();
+	}
+
+	//Returns the value for a key, inserting a default-constructed one if it's not there
+	T& operator[](const Greenpak4NetlistSymbol& key)
+	{
+		auto it = LowerBound(key);
+		if( (it == m_items.end()) || (it->first != key) )
+			it = m_items.insert(it, value_type(key, T()));
+		return it->second;
+	}
+
+protected:
+	iterator LowerBound(const Greenpak4NetlistSymbol& key)
+	{
+		//Fast path for appending in order
+		if(m_items.empty() || (m_items.back().first < key))
+			return m_items.end();
+
+		return std::lower_bound(
+			m_items.begin(),
+			m_items.end(),
+			key,
+			[](const value_type& a, const Greenpak4NetlistSymbol& b) { return a.first < b; });
+	}
+
+	std::vector<value_type> m_items;
+};
+
+#endif
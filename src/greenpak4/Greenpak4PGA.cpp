@@ -97,45 +97,25 @@ bool Greenpak4PGA::CommitChanges()
 	if(ncell == NULL)
 		return true;
 
-	if(ncell->HasParameter("GAIN"))
-	{
-		//convert to integer so we can sanity check more easily
-		float gain = atof(ncell->m_parameters["GAIN"].c_str());
-		int igain = gain*100;
+	//Gain is stored in hundredths, and was checked against the legal values when the netlist was loaded
+	if(ncell->HasParameter(PARAM_GAIN))
+		m_gain = ncell->GetParameter(PARAM_GAIN);
 
-		switch(igain)
+	if(ncell->HasParameter(PARAM_INPUT_MODE))
+	{
+		switch(ncell->GetParameter(PARAM_INPUT_MODE))
 		{
-			case 25:
-			case 50:
-			case 100:
-			case 200:
-			case 400:
-			case 800:
-			case 1600:
-				m_gain = igain;
+			case CHOICE_DIFF:
+				m_inputMode = MODE_DIFF;
 				break;
 
-			default:
-				LogError("PGA GAIN must be 0.25, 0.25, 1, 2, 4, 8, 16\n");
-				return false;
-		}
-	}
-
-	if(ncell->HasParameter("INPUT_MODE"))
-	{
-		string mode = ncell->m_parameters["INPUT_MODE"];
-
-		if(mode == "SINGLE")
-			m_inputMode = MODE_SINGLE;
-		else if(mode == "DIFF")
-			m_inputMode = MODE_DIFF;
-		else if(mode == "PDIFF")
-			m_inputMode = MODE_PDIFF;
+			case CHOICE_PDIFF:
+				m_inputMode = MODE_PDIFF;
+				break;
 
-		else
-		{
-			LogError("PGA INPUT_MODE must be SINGLE, DIFF, or PDIFF\n");
-			return false;
+			default:
+				m_inputMode = MODE_SINGLE;
+				break;
 		}
 	}
 
@@ -158,14 +138,32 @@ bool Greenpak4PGA::CommitChanges()
 	return true;
 }
 
-bool Greenpak4PGA::Load(bool* /*bitstream*/)
+bool Greenpak4PGA::Load(Greenpak4Bitstream& bitstream)
 {
-	//TODO: Do our inputs
-	LogError("Unimplemented\n");
-	return false;
+	////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+	// Configuration
+
+	//Pin 16 is the only IOB that can drive VIN_SEL
+	m_vinsel = m_device->GetPower();
+	if(bitstream[m_configBase + 1] && (m_device->GetIOB(16) != NULL) )
+		m_vinsel = m_device->GetIOB(16)->GetOutput("OUT");
+
+	if(!bitstream[m_configBase + 2])
+		m_inputMode = MODE_SINGLE;
+	else if(bitstream[m_configBase + 7])
+		m_inputMode = MODE_PDIFF;
+	else
+		m_inputMode = MODE_DIFF;
+
+	static const unsigned int gains[8] = {25, 50, 100, 200, 400, 800, 1600, 3200};
+	m_gain = gains[bitstream.GetField(m_configBase + 3, 3)];
+
+	m_hasNonADCLoads = bitstream[m_configBase + 6];
+
+	return true;
 }
 
-bool Greenpak4PGA::Save(bool* bitstream)
+bool Greenpak4PGA::Save(Greenpak4Bitstream& bitstream)
 {
 	/*
 	////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
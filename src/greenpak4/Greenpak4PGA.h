@@ -31,8 +31,8 @@ public:
 		unsigned int cbase);
 
 	//Serialization
-	virtual bool Load(bool* bitstream);
-	virtual bool Save(bool* bitstream);
+	virtual bool Load(Greenpak4Bitstream& bitstream);
+	virtual bool Save(Greenpak4Bitstream& bitstream);
 
 	virtual ~Greenpak4PGA();
 
@@ -52,6 +52,13 @@ public:
 	Greenpak4EntityOutput GetInputN()
 	{ return m_vinn; }
 
+	Greenpak4EntityOutput GetInputSel()
+	{ return m_vinsel; }
+
+	//in hundredths
+	unsigned int GetGain()
+	{ return m_gain; }
+
 	bool IsUsed();
 
 	enum InputModes
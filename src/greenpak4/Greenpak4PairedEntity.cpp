@@ -138,13 +138,13 @@ bool Greenpak4PairedEntity::CommitChanges()
 	return GetActiveEntity()->CommitChanges();
 }
 
-bool Greenpak4PairedEntity::Load(bool* bitstream)
+bool Greenpak4PairedEntity::Load(Greenpak4Bitstream& bitstream)
 {
 	m_activeEntity = bitstream[m_configBase];
 	return GetActiveEntity()->Load(bitstream);
 }
 
-bool Greenpak4PairedEntity::Save(bool* bitstream)
+bool Greenpak4PairedEntity::Save(Greenpak4Bitstream& bitstream)
 {
 	//Write the select bit
 	bitstream[m_configBase] = m_activeEntity;
@@ -152,3 +152,31 @@ bool Greenpak4PairedEntity::Save(bool* bitstream)
 	//and the config data
 	return GetActiveEntity()->Save(bitstream);
 }
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Timing model
+
+/**
+	@brief Returns the underlying entity that would be used if the given netlist entity were placed on us
+ */
+Greenpak4BitstreamEntity* Greenpak4PairedEntity::GetEntityFor(Greenpak4NetlistEntity* entity)
+{
+	auto ncell = dynamic_cast<Greenpak4NetlistCell*>(entity);
+	if(ncell == NULL)
+		return GetActiveEntity();
+
+	auto it = m_emap.find(ncell->m_type);
+	if(it == m_emap.end())
+		return GetActiveEntity();
+	return m_entities[it->second];
+}
+
+unsigned int Greenpak4PairedEntity::GetPropagationDelay(Greenpak4NetlistEntity* entity)
+{
+	return GetEntityFor(entity)->GetPropagationDelay(entity);
+}
+
+bool Greenpak4PairedEntity::IsSequential(Greenpak4NetlistEntity* entity)
+{
+	return GetEntityFor(entity)->IsSequential(entity);
+}
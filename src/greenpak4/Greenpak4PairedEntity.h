@@ -36,8 +36,8 @@ public:
 	virtual ~Greenpak4PairedEntity();
 
 	//Serialization
-	virtual bool Load(bool* bitstream);
-	virtual bool Save(bool* bitstream);
+	virtual bool Load(Greenpak4Bitstream& bitstream);
+	virtual bool Save(Greenpak4Bitstream& bitstream);
 
 	virtual std::string GetDescription();
 
@@ -49,6 +49,9 @@ public:
 
 	virtual bool CommitChanges();
 
+	virtual unsigned int GetPropagationDelay(Greenpak4NetlistEntity* entity);
+	virtual bool IsSequential(Greenpak4NetlistEntity* entity);
+
 	Greenpak4BitstreamEntity* GetEntity(std::string type)
 	{ return m_entities[m_emap[type]]; }
 
@@ -58,6 +61,8 @@ public:
 	void AddType(std::string type, bool entity);
 	bool SetEntityType(std::string type);
 
+	Greenpak4BitstreamEntity* GetEntityFor(Greenpak4NetlistEntity* entity);
+
 protected:
 
 	//Address of the select bit
@@ -67,39 +67,24 @@ bool Greenpak4PatternGenerator::CommitChanges()
 	if(ncell == NULL)
 		return true;
 
-	for(auto x : ncell->m_parameters)
+	if(ncell->HasParameter(PARAM_PATTERN_DATA))
 	{
-		if(x.first == "PATTERN_DATA")
+		//convert to bit array format
+		uint32_t truth_table = ncell->GetParameter(PARAM_PATTERN_DATA);
+		for(unsigned int i=0; i<16; i++)
 		{
-			//convert to bit array format
-			uint32_t truth_table = atoi(x.second.c_str());
-			for(unsigned int i=0; i<16; i++)
-			{
-				bool a3 = (i & 8) ? true : false;
-				bool a2 = (i & 4) ? true : false;
-				bool a1 = (i & 2) ? true : false;
-				bool a0 = (i & 1) ? true : false;
-				m_truthtable[a3*8 | a2*4 | a1*2 | a0] = (truth_table & (1 << i)) ? true : false;
-			}
-		}
-
-		else if(x.first == "PATTERN_LEN")
-		{
-			m_patternLen = atoi(x.second.c_str());
-			if( (m_patternLen < 2) || (m_patternLen > 16) )
-			{
-				LogError("GP_PGEN PATTERN_LEN must be between 2 and 16 (requested %d)\n", m_patternLen);
-				return false;
-			}
-		}
-
-		else
-		{
-			LogWarning("Cell \"%s\" has unrecognized parameter %s, ignoring\n",
-				ncell->m_name.c_str(), x.first.c_str());
+			bool a3 = (i & 8) ? true : false;
+			bool a2 = (i & 4) ? true : false;
+			bool a1 = (i & 2) ? true : false;
+			bool a0 = (i & 1) ? true : false;
+			m_truthtable[a3*8 | a2*4 | a1*2 | a0] = (truth_table & (1 << i)) ? true : false;
 		}
 	}
 
+	//Range (2 to 16) was checked when the netlist was loaded
+	if(ncell->HasParameter(PARAM_PATTERN_LEN))
+		m_patternLen = ncell->GetParameter(PARAM_PATTERN_LEN);
+
 	return true;
 }
 
@@ -131,13 +116,30 @@ void Greenpak4PatternGenerator::SetInput(string port, Greenpak4EntityOutput src)
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 // Serialization
 
-bool Greenpak4PatternGenerator::Load(bool* /*bitstream*/)
+bool Greenpak4PatternGenerator::Load(Greenpak4Bitstream& bitstream)
 {
-	LogError("unimplemented\n");
-	return false;
+	////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+	// INPUT BUS
+
+	//0/1 are unused in PGEN mode
+	if(!ReadMatrixSelector(bitstream, m_inputBaseWord + 2, m_clk))
+		return false;
+	if(!ReadMatrixSelector(bitstream, m_inputBaseWord + 3, m_reset))
+		return false;
+
+	////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+	// CONFIGURATION
+
+	uint32_t pattern = bitstream.GetField(m_configBase, 16);
+	for(unsigned int i=0; i<16; i++)
+		m_truthtable[i] = (pattern >> i) & 1;
+
+	m_patternLen = bitstream.GetField(m_configBase + 16, 4) + 1;
+
+	return true;
 }
 
-bool Greenpak4PatternGenerator::Save(bool* bitstream)
+bool Greenpak4PatternGenerator::Save(Greenpak4Bitstream& bitstream)
 {
 	////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 	// INPUT BUS
@@ -158,15 +160,29 @@ bool Greenpak4PatternGenerator::Save(bool* bitstream)
 	// CONFIGURATION
 
 	//The pattern we generate
+	uint32_t pattern = 0;
 	for(unsigned int i=0; i<16; i++)
-		bitstream[m_configBase + i] = m_truthtable[i];
+		pattern |= m_truthtable[i] << i;
+	bitstream.SetField(m_configBase, 16, pattern);
 
 	//4-bit counter data
-	int len = m_patternLen - 1;
-	bitstream[m_configBase + 16] = (len & 1) ? true : false;
-	bitstream[m_configBase + 17] = (len & 2) ? true : false;
-	bitstream[m_configBase + 18] = (len & 4) ? true : false;
-	bitstream[m_configBase + 19] = (len & 8) ? true : false;
+	bitstream.SetField(m_configBase + 16, 4, m_patternLen - 1);
+
+	return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Timing model
 
+/**
+	@brief Clock to output delay
+ */
+unsigned int Greenpak4PatternGenerator::GetPropagationDelay(Greenpak4NetlistEntity* /*entity*/)
+{
+	return 10000;
+}
+
+bool Greenpak4PatternGenerator::IsSequential(Greenpak4NetlistEntity* /*entity*/)
+{
 	return true;
 }
@@ -36,12 +36,29 @@ public:
 	virtual ~Greenpak4PatternGenerator();
 
 	//Serialization
-	virtual bool Load(bool* bitstream);
-	virtual bool Save(bool* bitstream);
+	virtual bool Load(Greenpak4Bitstream& bitstream);
+	virtual bool Save(Greenpak4Bitstream& bitstream);
 
 	virtual bool CommitChanges();
 
+	virtual unsigned int GetPropagationDelay(Greenpak4NetlistEntity* entity);
+	virtual bool IsSequential(Greenpak4NetlistEntity* entity);
+
 	virtual std::string GetDescription();
+
+	//Configuration (for simulation)
+	Greenpak4EntityOutput GetClock()
+	{ return m_clk; }
+
+	Greenpak4EntityOutput GetReset()
+	{ return m_reset; }
+
+	bool GetPatternBit(unsigned int step)
+	{ return m_truthtable[step]; }
+
+	int GetPatternLength()
+	{ return m_patternLen; }
+
 	virtual unsigned int GetOutputNetNumber(std::string port);
 
 	virtual std::vector<std::string> GetInputPorts() const;
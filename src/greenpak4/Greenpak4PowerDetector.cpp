@@ -81,13 +81,13 @@ bool Greenpak4PowerDetector::CommitChanges()
 	return true;
 }
 
-bool Greenpak4PowerDetector::Load(bool* /*bitstream*/)
+bool Greenpak4PowerDetector::Load(Greenpak4Bitstream& /*bitstream*/)
 {
-	LogError("Unimplemented\n");
-	return false;
+	//no configuration - output only
+	return true;
 }
 
-bool Greenpak4PowerDetector::Save(bool* /*bitstream*/)
+bool Greenpak4PowerDetector::Save(Greenpak4Bitstream& /*bitstream*/)
 {
 	//no configuration - output only
 	return true;
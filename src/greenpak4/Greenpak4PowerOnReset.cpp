@@ -86,33 +86,20 @@ bool Greenpak4PowerOnReset::CommitChanges()
 	if(ncell == NULL)
 		return true;
 
-	if(ncell->HasParameter("POR_TIME"))
-	{
-		string p = ncell->m_parameters["POR_TIME"];
-		if(p == "4")
-			m_resetDelay = 4;
-		else if(p == "500")
-			m_resetDelay = 500;
-		else
-		{
-			LogError(
-				"Power-on reset \"%s\" has illegal reset delay \"%s\" (must be 4 or 500)\n",
-				ncell->m_name.c_str(),
-				p.c_str());
-			return false;
-		}
-	}
+	//Legal delays (4 or 500) were checked when the netlist was loaded
+	if(ncell->HasParameter(PARAM_POR_TIME))
+		m_resetDelay = ncell->GetParameter(PARAM_POR_TIME);
 
 	return true;
 }
 
-bool Greenpak4PowerOnReset::Load(bool* /*bitstream*/)
+bool Greenpak4PowerOnReset::Load(Greenpak4Bitstream& bitstream)
 {
-	LogError("Unimplemented\n");
-	return false;
+	m_resetDelay = bitstream[m_configBase] ? 500 : 4;
+	return true;
 }
 
-bool Greenpak4PowerOnReset::Save(bool* bitstream)
+bool Greenpak4PowerOnReset::Save(Greenpak4Bitstream& bitstream)
 {
 	if(m_resetDelay == 4)
 		bitstream[m_configBase] = false;
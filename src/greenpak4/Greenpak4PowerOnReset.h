@@ -36,11 +36,15 @@ public:
 	virtual ~Greenpak4PowerOnReset();
 
 	//Serialization
-	virtual bool Load(bool* bitstream);
-	virtual bool Save(bool* bitstream);
+	virtual bool Load(Greenpak4Bitstream& bitstream);
+	virtual bool Save(Greenpak4Bitstream& bitstream);
 
 	virtual std::string GetDescription();
 
+	//Time from power-up to RST_DONE going high, in microseconds
+	unsigned int GetResetDelay()
+	{ return m_resetDelay; }
+
 	virtual void SetInput(std::string port, Greenpak4EntityOutput src);
 	virtual unsigned int GetOutputNetNumber(std::string port);
 
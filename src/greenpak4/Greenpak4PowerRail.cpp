@@ -47,13 +47,13 @@ bool Greenpak4PowerRail::CommitChanges()
 	return true;
 }
 
-bool Greenpak4PowerRail::Load(bool* /*bitstream*/)
+bool Greenpak4PowerRail::Load(Greenpak4Bitstream& /*bitstream*/)
 {
 	//no error, we have no config to read
 	return true;
 }
 
-bool Greenpak4PowerRail::Save(bool* /*bitstream*/)
+bool Greenpak4PowerRail::Save(Greenpak4Bitstream& /*bitstream*/)
 {
 	return true;
 }
@@ -34,8 +34,8 @@ public:
 	virtual ~Greenpak4PowerRail();
 
 	//Serialization (no-ops)
-	virtual bool Load(bool* bitstream);
-	virtual bool Save(bool* bitstream);
+	virtual bool Load(Greenpak4Bitstream& bitstream);
+	virtual bool Save(Greenpak4Bitstream& bitstream);
 
 	//Helper - get digital value (1 = Vdd, 0 = Vss)
 	bool GetDigitalValue()
@@ -98,54 +98,55 @@ bool Greenpak4RingOscillator::CommitChanges()
 	if(ncell == NULL)
 		return true;
 
-	if(ncell->HasParameter("PWRDN_EN"))
-		m_powerDownEn = (ncell->m_parameters["PWRDN_EN"] == "1");
+	if(ncell->HasParameter(PARAM_PWRDN_EN))
+		m_powerDownEn = ncell->GetParameter(PARAM_PWRDN_EN);
 
 	//If auto-powerdown is not specified, but the cell is instantiated, default to always running the osc
-	if(ncell->HasParameter("AUTO_PWRDN"))
-		m_autoPowerDown = (ncell->m_parameters["AUTO_PWRDN"] == "1");
-	else
-		m_autoPowerDown = false;
+	m_autoPowerDown = ncell->GetParameter(PARAM_AUTO_PWRDN);
 
-	if(ncell->HasParameter("HARDIP_DIV"))
-	{
-		int div = atoi(ncell->m_parameters["HARDIP_DIV"].c_str());
+	//Legal dividers were checked when the netlist was loaded
+	if(ncell->HasParameter(PARAM_HARDIP_DIV))
+		m_preDiv = ncell->GetParameter(PARAM_HARDIP_DIV);
 
-		if(	(div == 1) || (div == 4) || (div == 8) || (div == 16) )
-			m_preDiv = div;
-		else
-		{
-			LogError("GP_RINGOSC pre divider must be 1, 4, 8, 16\n");
-			return false;
-		}
-	}
+	if(ncell->HasParameter(PARAM_FABRIC_DIV))
+		m_postDiv = ncell->GetParameter(PARAM_FABRIC_DIV);
 
-	if(ncell->HasParameter("FABRIC_DIV"))
-	{
-		int div = atoi(ncell->m_parameters["FABRIC_DIV"].c_str());
+	return true;
+}
 
-		if(	(div == 1) || (div == 2) || (div == 3) || (div == 4) || (div == 8) ||
-			(div == 12) || (div == 24) || (div == 64))
-		{
-			m_postDiv = div;
-		}
-		else
+bool Greenpak4RingOscillator::Load(Greenpak4Bitstream& bitstream)
+{
+	////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+	// INPUT BUS
+
+	//Save() turns the output off for a constant power-down, so map that back to one
+	m_powerDown = m_device->GetGround();
+	if(!bitstream[m_configBase + 7])
+		m_powerDownEn = true;
+	else
+	{
+		m_powerDownEn = bitstream[m_configBase + 8];
+		if(m_powerDownEn)
 		{
-			LogError("GP_RINGOSC post divider must be 1, 2, 3, 4, 8, 12, 24, or 64\n");
-			return false;
+			if(!ReadMatrixSelector(bitstream, m_inputBaseWord, m_powerDown))
+				return false;
 		}
 	}
 
-	return true;
-}
+	////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+	// Configuration
 
-bool Greenpak4RingOscillator::Load(bool* /*bitstream*/)
-{
-	LogError("Unimplemented\n");
-	return false;
+	m_autoPowerDown = !bitstream[m_configBase + 10];
+
+	static const int prediv[4] = {1, 4, 8, 16};
+	static const int postdiv[8] = {1, 2, 4, 3, 8, 12, 24, 64};
+	m_preDiv = prediv[bitstream.GetField(m_configBase + 5, 2)];
+	m_postDiv = postdiv[bitstream.GetField(m_configBase + 0, 3)];
+
+	return true;
 }
 
-bool Greenpak4RingOscillator::Save(bool* bitstream)
+bool Greenpak4RingOscillator::Save(Greenpak4Bitstream& bitstream)
 {
 	//Optimize PWRDN = 1'b0 and PWRDN_EN = 1 to PWRDN = dontcare and PWRDN_EN = 0.
 	//Detect constant power-down of 1 as "unused port"
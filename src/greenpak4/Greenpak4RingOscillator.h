@@ -38,11 +38,17 @@ public:
 	virtual ~Greenpak4RingOscillator();
 
 	//Serialization
-	virtual bool Load(bool* bitstream);
-	virtual bool Save(bool* bitstream);
+	virtual bool Load(Greenpak4Bitstream& bitstream);
+	virtual bool Save(Greenpak4Bitstream& bitstream);
 
 	virtual std::string GetDescription();
 
+	int GetPreDivider()
+	{ return m_preDiv; }
+
+	int GetPostDivider()
+	{ return m_postDiv; }
+
 	//Get the power-down input (used for DRC)
 	Greenpak4EntityOutput GetPowerDown()
 	{ return m_powerDown; }
@@ -100,51 +100,44 @@ bool Greenpak4SPI::CommitChanges()
 	if(ncell == NULL)
 		return true;
 
-	if(ncell->HasParameter("DATA_WIDTH"))
-	{
-		int width = atoi(ncell->m_parameters["DATA_WIDTH"].c_str());
-		if(width == 8)
-			m_width8Bits = true;
-		else if(width == 16)
-			m_width8Bits = false;
-		else
-		{
-			LogError("Greenpak4SPI: only supported data widths are 8 and 16\n");
-			return false;
-		}
-	}
-
-	if(ncell->HasParameter("SPI_CPHA"))
-		m_cpha = atoi(ncell->m_parameters["SPI_CPHA"].c_str()) ? true : false;
-
-	if(ncell->HasParameter("SPI_CPOL"))
-		m_cpol = atoi(ncell->m_parameters["SPI_CPOL"].c_str()) ? true : false;
-
-	if(ncell->HasParameter("DIRECTION"))
-	{
-		auto s = ncell->m_parameters["DIRECTION"];
-		if(s == "INPUT")
-			m_dirIsOutput = false;
-		else if(s == "OUTPUT")
-			m_dirIsOutput = true;
-		else
-		{
-			LogError("Greenpak4SPI: Direction must be OUTPUT or INPUT\n");
-			return false;
-		}
-	}
+	//Width (8 or 16) was checked when the netlist was loaded
+	if(ncell->HasParameter(PARAM_DATA_WIDTH))
+		m_width8Bits = (ncell->GetParameter(PARAM_DATA_WIDTH) == 8);
+
+	if(ncell->HasParameter(PARAM_SPI_CPHA))
+		m_cpha = ncell->GetParameter(PARAM_SPI_CPHA);
+
+	if(ncell->HasParameter(PARAM_SPI_CPOL))
+		m_cpol = ncell->GetParameter(PARAM_SPI_CPOL);
+
+	if(ncell->HasParameter(PARAM_DIRECTION))
+		m_dirIsOutput = (ncell->GetParameter(PARAM_DIRECTION) == CHOICE_OUTPUT);
 
 	return true;
 }
 
-bool Greenpak4SPI::Load(bool* /*bitstream*/)
+bool Greenpak4SPI::Load(Greenpak4Bitstream& bitstream)
 {
-	//TODO: Do our inputs
-	LogError("Unimplemented\n");
-	return false;
+	////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+	// INPUT BUS
+
+	if(!ReadMatrixSelector(bitstream, m_inputBaseWord, m_csn))
+		return false;
+
+	////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+	// CONFIGURATION
+
+	m_useAsBuffer = bitstream[m_configBase + 0];
+	m_cpha = bitstream[m_configBase + 2];
+	m_cpol = bitstream[m_configBase + 3];
+	m_width8Bits = bitstream[m_configBase + 4];
+	m_dirIsOutput = bitstream[m_configBase + 5];
+	m_parallelOutputToFabric = bitstream[m_configBase + 6];
+
+	return true;
 }
 
-bool Greenpak4SPI::Save(bool* bitstream)
+bool Greenpak4SPI::Save(Greenpak4Bitstream& bitstream)
 {
 	////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 	// INPUT BUS
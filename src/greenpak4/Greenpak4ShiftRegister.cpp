@@ -104,40 +104,43 @@ bool Greenpak4ShiftRegister::CommitChanges()
 	if(ncell == NULL)
 		return true;
 
-	if(ncell->HasParameter("OUTA_TAP"))
-	{
-		m_delayA = atoi(ncell->m_parameters["OUTA_TAP"].c_str());
-		if( (m_delayA < 1) || (m_delayA > 16) )
-		{
-			LogError("Shift register OUTA_TAP must be in [1, 16]\n");
-			return false;
-		}
-	}
-
-	if(ncell->HasParameter("OUTB_TAP"))
-	{
-		m_delayB = atoi(ncell->m_parameters["OUTB_TAP"].c_str());
-		if( (m_delayB < 1) || (m_delayB > 16) )
-		{
-			LogError("Shift register OUTB_TAP must be in [1, 16]\n");
-			return false;
-		}
-	}
-
-	if(ncell->HasParameter("OUTA_INVERT"))
-		m_invertA = atoi(ncell->m_parameters["OUTA_INVERT"].c_str());
+	//Tap ranges ([1, 16]) were checked when the netlist was loaded
+	if(ncell->HasParameter(PARAM_OUTA_TAP))
+		m_delayA = ncell->GetParameter(PARAM_OUTA_TAP);
+
+	if(ncell->HasParameter(PARAM_OUTB_TAP))
+		m_delayB = ncell->GetParameter(PARAM_OUTB_TAP);
+
+	if(ncell->HasParameter(PARAM_OUTA_INVERT))
+		m_invertA = ncell->GetParameter(PARAM_OUTA_INVERT);
 
 	return true;
 }
 
-bool Greenpak4ShiftRegister::Load(bool* /*bitstream*/)
+bool Greenpak4ShiftRegister::Load(Greenpak4Bitstream& bitstream)
 {
-	//TODO: Do our inputs
-	LogError("Unimplemented\n");
-	return false;
+	////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+	// INPUT BUS
+
+	if(!ReadMatrixSelector(bitstream, m_inputBaseWord + 0, m_clock))
+		return false;
+	if(!ReadMatrixSelector(bitstream, m_inputBaseWord + 1, m_input))
+		return false;
+	if(!ReadMatrixSelector(bitstream, m_inputBaseWord + 2, m_reset))
+		return false;
+
+	////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+	// Configuration
+
+	//Taps are stored 0-based, B first (see Save())
+	m_delayB = bitstream.GetField(m_configBase + 0, 4) + 1;
+	m_delayA = bitstream.GetField(m_configBase + 4, 4) + 1;
+	m_invertA = bitstream[m_configBase + 8];
+
+	return true;
 }
 
-bool Greenpak4ShiftRegister::Save(bool* bitstream)
+bool Greenpak4ShiftRegister::Save(Greenpak4Bitstream& bitstream)
 {
 	////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 	// INPUT BUS
@@ -172,3 +175,19 @@ bool Greenpak4ShiftRegister::Save(bool* bitstream)
 
 	return true;
 }
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Timing model
+
+/**
+	@brief Clock to output delay (of the first tap, the rest are whole clock cycles later)
+ */
+unsigned int Greenpak4ShiftRegister::GetPropagationDelay(Greenpak4NetlistEntity* /*entity*/)
+{
+	return 10000;
+}
+
+bool Greenpak4ShiftRegister::IsSequential(Greenpak4NetlistEntity* /*entity*/)
+{
+	return true;
+}
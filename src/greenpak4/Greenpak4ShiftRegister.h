@@ -34,13 +34,32 @@ public:
 		unsigned int cbase);
 
 	//Serialization
-	virtual bool Load(bool* bitstream);
-	virtual bool Save(bool* bitstream);
+	virtual bool Load(Greenpak4Bitstream& bitstream);
+	virtual bool Save(Greenpak4Bitstream& bitstream);
 
 	virtual ~Greenpak4ShiftRegister();
 
 	virtual std::string GetDescription();
 
+	//Configuration (for simulation)
+	Greenpak4EntityOutput GetClock()
+	{ return m_clock; }
+
+	Greenpak4EntityOutput GetInput()
+	{ return m_input; }
+
+	Greenpak4EntityOutput GetReset()
+	{ return m_reset; }
+
+	int GetDelayA()
+	{ return m_delayA; }
+
+	int GetDelayB()
+	{ return m_delayB; }
+
+	bool IsInvertA()
+	{ return m_invertA; }
+
 	virtual void SetInput(std::string port, Greenpak4EntityOutput src);
 	virtual unsigned int GetOutputNetNumber(std::string port);
 
@@ -49,6 +68,9 @@ public:
 
 	virtual bool CommitChanges();
 
+	virtual unsigned int GetPropagationDelay(Greenpak4NetlistEntity* entity);
+	virtual bool IsSequential(Greenpak4NetlistEntity* entity);
+
 protected:
 	Greenpak4EntityOutput m_clock;
 	Greenpak4EntityOutput m_input;
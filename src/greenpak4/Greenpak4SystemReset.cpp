@@ -89,49 +89,36 @@ bool Greenpak4SystemReset::CommitChanges()
 	if(ncell == NULL)
 		return true;
 
-	if(ncell->HasParameter("RESET_MODE"))
+	//Mode and speed were checked when the netlist was loaded
+	if(ncell->HasParameter(PARAM_RESET_MODE))
 	{
-		Greenpak4SystemReset::ResetMode mode = Greenpak4SystemReset::RISING_EDGE;
-		string p = ncell->m_parameters["RESET_MODE"];
-		if(p == "RISING")
-			mode = Greenpak4SystemReset::RISING_EDGE;
-		else if(p == "LEVEL")
-			mode = Greenpak4SystemReset::HIGH_LEVEL;
+		if(ncell->GetParameter(PARAM_RESET_MODE) == CHOICE_LEVEL)
+			SetResetMode(Greenpak4SystemReset::HIGH_LEVEL);
 		else
-		{
-			LogError(
-				"Reset \"%s\" has illegal reset mode \"%s\" (must be RISING or LEVEL)\n",
-				ncell->m_name.c_str(),
-				p.c_str());
-			return false;
-		}
-		SetResetMode(mode);
+			SetResetMode(Greenpak4SystemReset::RISING_EDGE);
 	}
 
-	if(ncell->HasParameter("EDGE_SPEED"))
-	{
-		m_resetDelay = atoi(ncell->m_parameters["EDGE_SPEED"].c_str());
-
-		if( (m_resetDelay != 4) && (m_resetDelay != 500) )
-		{
-			LogError(
-				"Reset \"%s\" has illegal reset speed %d us (must be 4 or 500)\n",
-				ncell->m_name.c_str(),
-				m_resetDelay);
-			return false;
-		}
-	}
+	if(ncell->HasParameter(PARAM_EDGE_SPEED))
+		m_resetDelay = ncell->GetParameter(PARAM_EDGE_SPEED);
 
 	return true;
 }
 
-bool Greenpak4SystemReset::Load(bool* /*bitstream*/)
+bool Greenpak4SystemReset::Load(Greenpak4Bitstream& bitstream)
 {
-	LogError("Unimplemented\n");
-	return false;
+	m_resetMode = bitstream[m_configBase + 0] ? HIGH_LEVEL : RISING_EDGE;
+	m_resetDelay = bitstream[m_configBase + 1] ? 500 : 4;
+
+	//Hard-wired to pin #2 when enabled
+	if(bitstream[m_configBase + 2])
+		m_reset = m_device->GetIOB(2)->GetOutput("OUT");
+	else
+		m_reset = m_device->GetGround();
+
+	return true;
 }
 
-bool Greenpak4SystemReset::Save(bool* bitstream)
+bool Greenpak4SystemReset::Save(Greenpak4Bitstream& bitstream)
 {
 	//No DRC needed - cannot route anything but pin 2 to us
 	//If somebody tries something stupid PAR will fail with an unroutable design
@@ -91,23 +91,23 @@ bool Greenpak4VoltageReference::CommitChanges()
 	if(ncell == NULL)
 		return true;
 
-	if(ncell->HasParameter("VIN_DIV"))
-		m_vinDiv = atoi(ncell->m_parameters["VIN_DIV"].c_str());
+	if(ncell->HasParameter(PARAM_VIN_DIV))
+		m_vinDiv = ncell->GetParameter(PARAM_VIN_DIV);
 
-	if(ncell->HasParameter("VREF"))
-		m_vref = atoi(ncell->m_parameters["VREF"].c_str());
+	if(ncell->HasParameter(PARAM_VREF))
+		m_vref = ncell->GetParameter(PARAM_VREF);
 
 	return true;
 }
 
-bool Greenpak4VoltageReference::Load(bool* /*bitstream*/)
+bool Greenpak4VoltageReference::Load(Greenpak4Bitstream& /*bitstream*/)
 {
-	//TODO: how do we do this?
-	LogError("Unimplemented\n");
-	return false;
+	//no configuration, everything is in the downstream logic
+	//(the comparator we feed recovers our settings, see SetACMPMuxSel())
+	return true;
 }
 
-bool Greenpak4VoltageReference::Save(bool* /*bitstream*/)
+bool Greenpak4VoltageReference::Save(Greenpak4Bitstream& /*bitstream*/)
 {
 	//no configuration, everything is in the downstream logic
 	return true;
@@ -251,3 +251,79 @@ unsigned int Greenpak4VoltageReference::GetACMPMuxSel()
 		return 0xff;
 	}
 }
+
+/**
+	@brief Configures us from an ACMP reference mux selector (the inverse of GetACMPMuxSel())
+
+	This is how our settings are recovered from a bitstream, since the comparator's selector is the only place those
+	are stored.
+
+	@return False if the selector doesn't mean anything for this part
+ */
+bool Greenpak4VoltageReference::SetACMPMuxSel(unsigned int sel)
+{
+	//Constant voltage
+	if(sel < 0x18)
+	{
+		SetConstantVoltage((sel + 1) * 50);
+		return true;
+	}
+
+	switch(sel)
+	{
+		//Divided Vdd
+		case 0x18:
+		case 0x19:
+			m_vin = m_device->GetPower();
+			m_vinDiv = (sel == 0x18) ? 3 : 4;
+			return true;
+
+		//DACs
+		case 0x1e:
+		case 0x1f:
+			if(m_device->GetDACCount() < 2)
+				break;
+			m_vin = m_device->GetDAC((sel == 0x1f) ? 0 : 1)->GetOutput("VOUT");
+			m_vinDiv = 1;
+			return true;
+
+		//External pins, undivided (0x1a, 0x1b) or halved (0x1c, 0x1d)
+		default:
+			{
+				unsigned int pin = 0;
+				bool other = (sel == 0x1b) || (sel == 0x1d);
+
+				auto part = m_device->GetPart();
+				if(part == Greenpak4Device::GREENPAK4_SLG46140)
+					pin = other ? 4 : 5;
+
+				//All vrefs share pin 10, and each has one other pin
+				else if( (part == Greenpak4Device::GREENPAK4_SLG46620) ||
+					(part == Greenpak4Device::GREENPAK4_SLG46621) )
+				{
+					static const unsigned int pins[6] = {7, 7, 14, 14, 14, 5};
+					if(!other)
+						pin = 10;
+					else if(m_refnum < 6)
+						pin = pins[m_refnum];
+				}
+
+				auto iob = m_device->GetIOB(pin);
+				if(iob == NULL)
+					break;
+				m_vin = iob->GetOutput("OUT");
+				m_vinDiv = (sel >= 0x1c) ? 2 : 1;
+			}
+			return true;
+	}
+
+	LogError("Invalid mux selector %u for %s\n", sel, GetDescription().c_str());
+	return false;
+}
+
+void Greenpak4VoltageReference::SetConstantVoltage(unsigned int vref)
+{
+	m_vin = m_device->GetGround();
+	m_vinDiv = 1;
+	m_vref = vref;
+}
@@ -32,8 +32,8 @@ public:
 		unsigned int vout_muxsel = -1);
 
 	//Serialization
-	virtual bool Load(bool* bitstream);
-	virtual bool Save(bool* bitstream);
+	virtual bool Load(Greenpak4Bitstream& bitstream);
+	virtual bool Save(Greenpak4Bitstream& bitstream);
 
 	virtual ~Greenpak4VoltageReference();
 
@@ -53,6 +53,7 @@ public:
 
 	//mux selector for ACMP voltage inputs
 	unsigned int GetACMPMuxSel();
+	bool SetACMPMuxSel(unsigned int sel);
 
 	//return true if we're reporting a constant voltage (divided from the bandgap)
 	bool IsConstantVoltage()
@@ -62,6 +63,14 @@ public:
 	unsigned int GetOutputVoltage()
 	{ return m_vref; }
 
+	void SetConstantVoltage(unsigned int vref);
+
+	Greenpak4EntityOutput GetInput()
+	{ return m_vin; }
+
+	unsigned int GetDivisor()
+	{ return m_vinDiv; }
+
 protected:
 	Greenpak4EntityOutput m_vin;
 
@@ -0,0 +1,176 @@
+/***********************************************************************************************************************
+ * Copyright (C) 2016 Andrew Zonenberg and contributors                                                                *
+ *                                                                                                                     *
+ * This program is free software; you can redistribute it and/or modify it under the terms of the GNU Lesser General   *
+ * Public License as published by the Free Software Foundation; either version 2.1 of the License, or (at your option) *
+ * any later version.                                                                                                  *
+ *                                                                                                                     *
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied  *
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for     *
+ * more details.                                                                                                       *
+ *                                                                                                                     *
+ * You should have received a copy of the GNU Lesser General Public License along with this program; if not, you may   *
+ * find one here:                                                                                                      *
+ * https://www.gnu.org/licenses/old-licenses/lgpl-2.1.txt                                                              *
+ * or you may search the http://www.gnu.org website for the version 2.1 license, or you may write to the Free Software *
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA                                      *
+ **********************************************************************************************************************/
+
+#include "allocstats.h"
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+
+#ifdef __GLIBC__
+#include <malloc.h>
+#endif
+
+using namespace std;
+
+atomic<bool> g_allocationTracking(false);
+
+static atomic<uint64_t> g_allocatedBytes(0);
+static atomic<uint64_t> g_freedBytes(0);
+static atomic<uint64_t> g_allocationCount(0);
+static atomic<uint64_t> g_peakBytes(0);
+
+//Only tracked blocks are counted here, and a block might be freed by a different thread than allocated it, so this can
+//go negative for a moment
+static atomic<int64_t> g_liveBytes(0);
+
+/**
+	@brief Starts counting allocations
+
+	@return True if we can, false (after complaining) if we can't find the size of a block on this platform (so frees
+	couldn't be counted)
+ */
+bool StartAllocationTracking()
+{
+#ifdef __GLIBC__
+	g_allocationTracking = true;
+	return true;
+#else
+	printf("Allocation tracking isn't supported on this platform\n");
+	return false;
+#endif
+}
+
+AllocationCounters GetAllocationCounters()
+{
+	AllocationCounters counters;
+	counters.allocated = g_allocatedBytes;
+	counters.freed = g_freedBytes;
+	counters.allocations = g_allocationCount;
+	counters.peak = g_peakBytes;
+	return counters;
+}
+
+/**
+	@brief Starts a new high-water mark from the bytes live now
+ */
+void ResetAllocationPeak()
+{
+	int64_t live = g_liveBytes;
+	g_peakBytes = (live > 0) ? live : 0;
+}
+
+#ifdef __GLIBC__
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Counting
+
+static void CountAllocation(void* p)
+{
+	if( (p == NULL) || !IsAllocationTracking() )
+		return;
+
+	size_t size = malloc_usable_size(p);
+	g_allocatedBytes.fetch_add(size, memory_order_relaxed);
+	g_allocationCount.fetch_add(1, memory_order_relaxed);
+	int64_t live = g_liveBytes.fetch_add(size, memory_order_relaxed) + size;
+
+	uint64_t peak = g_peakBytes.load(memory_order_relaxed);
+	while( (live > 0) && (static_cast<uint64_t>(live) > peak) &&
+		!g_peakBytes.compare_exchange_weak(peak, live, memory_order_relaxed) )
+	{
+	}
+}
+
+static void CountFree(void* p)
+{
+	if( (p == NULL) || !IsAllocationTracking() )
+		return;
+
+	size_t size = malloc_usable_size(p);
+	g_freedBytes.fetch_add(size, memory_order_relaxed);
+	g_liveBytes.fetch_sub(size, memory_order_relaxed);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Replacement allocation functions
+
+void* operator new(size_t size)
+{
+	void* p = malloc(size ? size : 1);
+	if(p == NULL)
+		throw bad_alloc();
+	CountAllocation(p);
+	return p;
+}
+
+void* operator new[](size_t size)
+{
+	return operator new(size);
+}
+
+void* operator new(size_t size, const nothrow_t&) noexcept
+{
+	void* p = malloc(size ? size : 1);
+	CountAllocation(p);
+	return p;
+}
+
+void* operator new[](size_t size, const nothrow_t&) noexcept
+{
+	return operator new(size, nothrow);
+}
+
+void operator delete(void* p) noexcept
+{
+	CountFree(p);
+	free(p);
+}
+
+void operator delete[](void* p) noexcept
+{
+	operator delete(p);
+}
+
+//Sized forms, which C++14 code (and code built with -fsized-deallocation) calls instead.
+//<new> only declares them when sized deallocation is on, so otherwise declare them ourselves, as the standard does
+#ifndef __cpp_sized_deallocation
+void operator delete(void* p, size_t size) noexcept;
+void operator delete[](void* p, size_t size) noexcept;
+#endif
+
+void operator delete(void* p, size_t) noexcept
+{
+	operator delete(p);
+}
+
+void operator delete[](void* p, size_t) noexcept
+{
+	operator delete(p);
+}
+
+void operator delete(void* p, const nothrow_t&) noexcept
+{
+	operator delete(p);
+}
+
+void operator delete[](void* p, const nothrow_t&) noexcept
+{
+	operator delete(p);
+}
+
+#endif
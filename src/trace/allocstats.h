@@ -0,0 +1,71 @@
+/***********************************************************************************************************************
+ * Copyright (C) 2016 Andrew Zonenberg and contributors                                                                *
+ *                                                                                                                     *
+ * This program is free software; you can redistribute it and/or modify it under the terms of the GNU Lesser General   *
+ * Public License as published by the Free Software Foundation; either version 2.1 of the License, or (at your option) *
+ * any later version.                                                                                                  *
+ *                                                                                                                     *
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied  *
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for     *
+ * more details.                                                                                                       *
+ *                                                                                                                     *
+ * You should have received a copy of the GNU Lesser General Public License along with this program; if not, you may   *
+ * find one here:                                                                                                      *
+ * https://www.gnu.org/licenses/old-licenses/lgpl-2.1.txt                                                              *
+ * or you may search the http://www.gnu.org website for the version 2.1 license, or you may write to the Free Software *
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA                                      *
+ **********************************************************************************************************************/
+
+#ifndef allocstats_h
+#define allocstats_h
+
+#include <atomic>
+#include <cstdint>
+
+/**
+	@file
+	@brief Process-wide counters of heap memory allocated through operator new.
+
+	Linking this in replaces the global operator new and delete. Until StartAllocationTracking() is called they go
+	straight to malloc() and free(), and the only cost is one relaxed load per call.
+
+	The counters cover every thread, so with several compiles running at once each sees the others' allocations too.
+	There's no way to tell whether a block was allocated before tracking started, so freeing one still counts. Start
+	tracking as early as possible to keep this from skewing the figures.
+ */
+
+/**
+	@brief Totals since tracking started (all sizes in bytes, as the usable size of each block)
+ */
+class AllocationCounters
+{
+public:
+	AllocationCounters()
+		: allocated(0)
+		, freed(0)
+		, allocations(0)
+		, peak(0)
+	{
+	}
+
+	uint64_t allocated;
+	uint64_t freed;
+	uint64_t allocations;
+
+	//Highest number of live bytes at any one time (since the last ResetAllocationPeak())
+	uint64_t peak;
+};
+
+extern std::atomic<bool> g_allocationTracking;
+
+/**
+	@brief True if allocations are being counted
+ */
+inline bool IsAllocationTracking()
+{ return g_allocationTracking.load(std::memory_order_relaxed); }
+
+bool StartAllocationTracking();
+AllocationCounters GetAllocationCounters();
+void ResetAllocationPeak();
+
+#endif
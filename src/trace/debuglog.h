@@ -0,0 +1,52 @@
+/***********************************************************************************************************************
+ * Copyright (C) 2016 Andrew Zonenberg and contributors                                                                *
+ *                                                                                                                     *
+ * This program is free software; you can redistribute it and/or modify it under the terms of the GNU Lesser General   *
+ * Public License as published by the Free Software Foundation; either version 2.1 of the License, or (at your option) *
+ * any later version.                                                                                                  *
+ *                                                                                                                     *
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied  *
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for     *
+ * more details.                                                                                                       *
+ *                                                                                                                     *
+ * You should have received a copy of the GNU Lesser General Public License along with this program; if not, you may   *
+ * find one here:                                                                                                      *
+ * https://www.gnu.org/licenses/old-licenses/lgpl-2.1.txt                                                              *
+ * or you may search the http://www.gnu.org website for the version 2.1 license, or you may write to the Free Software *
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA                                      *
+ **********************************************************************************************************************/
+
+#ifndef debuglog_h
+#define debuglog_h
+
+#include <atomic>
+
+/**
+	@file
+	@brief A cached test for whether debug messages go anywhere.
+
+	LogDebug() formats its message before the sinks get to throw it away, and the arguments are evaluated before it's
+	even called. In hot loops, check IsDebugLogging() first, so runs without --debug don't pay for messages nobody sees.
+
+	The tools set this from their verbosity at startup. Until then it's on, so nothing is lost by programs that never
+	set it.
+ */
+
+extern std::atomic<bool> g_debugLogging;
+
+/**
+	@brief True if LogDebug() messages might be printed
+ */
+inline bool IsDebugLogging()
+{ return g_debugLogging.load(std::memory_order_relaxed); }
+
+/**
+	@brief Says whether any log sink wants LogDebug() messages
+
+	Debug messages only go anywhere with --debug, so the tools turn this off otherwise (once their sinks are set up),
+	and don't spend time formatting them.
+ */
+inline void SetDebugLogging(bool enabled)
+{ g_debugLogging.store(enabled, std::memory_order_relaxed); }
+
+#endif
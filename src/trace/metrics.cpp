@@ -0,0 +1,436 @@
+/***********************************************************************************************************************
+ * Copyright (C) 2016 Andrew Zonenberg and contributors                                                                *
+ *                                                                                                                     *
+ * This program is free software; you can redistribute it and/or modify it under the terms of the GNU Lesser General   *
+ * Public License as published by the Free Software Foundation; either version 2.1 of the License, or (at your option) *
+ * any later version.                                                                                                  *
+ *                                                                                                                     *
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied  *
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for     *
+ * more details.                                                                                                       *
+ *                                                                                                                     *
+ * You should have received a copy of the GNU Lesser General Public License along with this program; if not, you may   *
+ * find one here:                                                                                                      *
+ * https://www.gnu.org/licenses/old-licenses/lgpl-2.1.txt                                                              *
+ * or you may search the http://www.gnu.org website for the version 2.1 license, or you may write to the Free Software *
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA                                      *
+ **********************************************************************************************************************/
+
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <netdb.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+#include <log.h>
+#include "metrics.h"
+
+using namespace std;
+
+//Longest HTTP request we'll read (scrapes are a couple of hundred bytes)
+static const size_t MAX_HTTP_REQUEST = 8192;
+
+//How long a scraper can take to send its request
+static const int HTTP_TIMEOUT = 5;
+
+/**
+	@brief One set of labels of a metric family
+ */
+class MetricSeries
+{
+public:
+	MetricSeries()
+		: m_value(0)
+		, m_count(0)
+	{}
+
+	//Counter or gauge value, or the sum of everything observed for a histogram
+	double m_value;
+
+	//Histogram only: observations at or below each bucket's bound, and in total
+	vector<uint64_t> m_buckets;
+	uint64_t m_count;
+};
+
+/**
+	@brief Every series of one metric, and how to describe it
+ */
+class MetricFamily
+{
+public:
+	MetricType m_type;
+	string m_help;
+
+	//Upper bounds of the histogram buckets, in ascending order (the +Inf bucket is implied)
+	vector<double> m_bounds;
+
+	//Series by their label text (what's between the braces, so empty if there are no labels)
+	map<string, MetricSeries> m_series;
+};
+
+/**
+	@brief Every metric family, in the order they were described
+ */
+class MetricRegistry
+{
+public:
+	mutex m_lock;
+	vector<string> m_order;
+	map<string, MetricFamily> m_families;
+};
+
+static MetricRegistry& GetMetricRegistry()
+{
+	static MetricRegistry registry;
+	return registry;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Recording
+
+/**
+	@brief Describes a metric family, before any of its series are updated
+
+	@param family	Name of the family, without labels
+	@param type		What kind of metric it is
+	@param help		One line saying what it measures (and its units)
+	@param buckets	Histogram buckets' upper bounds, in ascending order
+ */
+void DescribeMetric(const string& family, MetricType type, const string& help, const vector<double>& buckets)
+{
+	auto& registry = GetMetricRegistry();
+	lock_guard<mutex> lock(registry.m_lock);
+	if(registry.m_families.find(family) == registry.m_families.end())
+		registry.m_order.push_back(family);
+
+	auto& f = registry.m_families[family];
+	f.m_type = type;
+	f.m_help = help;
+	f.m_bounds = buckets;
+}
+
+/**
+	@brief Adds a label to a metric name (which may already have labels of its own)
+
+	For example, MetricName("gp4par_jobs_total", "status", "ok") is gp4par_jobs_total{status="ok"}.
+ */
+string MetricName(const string& family, const string& label, const string& value)
+{
+	string escaped;
+	for(auto c : value)
+	{
+		if( (c == '\\') || (c == '\"') )
+			escaped += '\\';
+		if(c == '\n')
+			escaped += "\\n";
+		else
+			escaped += c;
+	}
+
+	string pair = label + "=\"" + escaped + "\"";
+	if(!family.empty() && (family[family.length() - 1] == '}') )
+		return family.substr(0, family.length() - 1) + "," + pair + "}";
+	return family + "{" + pair + "}";
+}
+
+/**
+	@brief Finds the series a metric name refers to, creating it if this is the first time it's been updated
+
+	The registry has to be locked.
+ */
+static MetricSeries& GetMetricSeries(MetricRegistry& registry, const string& name, MetricType type)
+{
+	size_t brace = name.find('{');
+	string family = name.substr(0, brace);
+	string labels;
+	if(brace != string::npos)
+		labels = name.substr(brace + 1, name.length() - brace - 2);
+
+	auto it = registry.m_families.find(family);
+	if(it == registry.m_families.end())
+		LogFatal("Metric %s was never described\n", family.c_str());
+	auto& f = it->second;
+
+	//Counters and gauges both go up, but only a gauge can be set
+	bool ok = (f.m_type == type) || ( (type == MetricType::COUNTER) && (f.m_type == MetricType::GAUGE) );
+	if(!ok)
+		LogFatal("Metric %s was updated as the wrong type\n", family.c_str());
+
+	auto& series = f.m_series[labels];
+	if(series.m_buckets.size() != f.m_bounds.size())
+		series.m_buckets.resize(f.m_bounds.size());
+	return series;
+}
+
+/**
+	@brief Adds to a counter (or gauge)
+ */
+void IncrementMetric(const string& name, double amount)
+{
+	auto& registry = GetMetricRegistry();
+	lock_guard<mutex> lock(registry.m_lock);
+	GetMetricSeries(registry, name, MetricType::COUNTER).m_value += amount;
+}
+
+/**
+	@brief Sets a gauge
+ */
+void SetMetric(const string& name, double value)
+{
+	auto& registry = GetMetricRegistry();
+	lock_guard<mutex> lock(registry.m_lock);
+	GetMetricSeries(registry, name, MetricType::GAUGE).m_value = value;
+}
+
+/**
+	@brief Adds an observation to a histogram
+ */
+void ObserveMetric(const string& name, double value)
+{
+	auto& registry = GetMetricRegistry();
+	lock_guard<mutex> lock(registry.m_lock);
+	auto& series = GetMetricSeries(registry, name, MetricType::HISTOGRAM);
+	auto& f = registry.m_families[name.substr(0, name.find('{'))];
+
+	for(size_t i=0; i<f.m_bounds.size(); i++)
+	{
+		if(value <= f.m_bounds[i])
+			series.m_buckets[i] ++;
+	}
+	series.m_value += value;
+	series.m_count ++;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Reporting
+
+/**
+	@brief Writes one sample line, adding a label to the series' own if extra isn't empty
+ */
+static void WriteSample(FILE* fp, const string& name, const string& labels, const string& extra, double value)
+{
+	string all = labels;
+	if(!extra.empty())
+		all += (all.empty() ? "" : ",") + extra;
+
+	if(all.empty())
+		fprintf(fp, "%s %.15g\n", name.c_str(), value);
+	else
+		fprintf(fp, "%s{%s} %.15g\n", name.c_str(), all.c_str(), value);
+}
+
+/**
+	@brief Formats every metric in the Prometheus text exposition format (version 0.0.4)
+ */
+string FormatMetrics()
+{
+	char* buf = NULL;
+	size_t len = 0;
+	FILE* fp = open_memstream(&buf, &len);
+	if(!fp)
+		LogFatal("Couldn't allocate metrics report\n");
+
+	auto& registry = GetMetricRegistry();
+	{
+		lock_guard<mutex> lock(registry.m_lock);
+		for(auto& name : registry.m_order)
+		{
+			auto& f = registry.m_families[name];
+			const char* type = "counter";
+			if(f.m_type == MetricType::GAUGE)
+				type = "gauge";
+			else if(f.m_type == MetricType::HISTOGRAM)
+				type = "histogram";
+			fprintf(fp, "# HELP %s %s\n", name.c_str(), f.m_help.c_str());
+			fprintf(fp, "# TYPE %s %s\n", name.c_str(), type);
+
+			for(auto& it : f.m_series)
+			{
+				auto& series = it.second;
+				if(f.m_type != MetricType::HISTOGRAM)
+				{
+					WriteSample(fp, name, it.first, "", series.m_value);
+					continue;
+				}
+
+				for(size_t i=0; i<f.m_bounds.size(); i++)
+				{
+					char le[64];
+					snprintf(le, sizeof(le), "le=\"%g\"", f.m_bounds[i]);
+					WriteSample(fp, name + "_bucket", it.first, le, series.m_buckets[i]);
+				}
+				WriteSample(fp, name + "_bucket", it.first, "le=\"+Inf\"", series.m_count);
+				WriteSample(fp, name + "_sum", it.first, "", series.m_value);
+				WriteSample(fp, name + "_count", it.first, "", series.m_count);
+			}
+		}
+	}
+
+	fclose(fp);
+	string report(buf, len);
+	free(buf);
+	return report;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// HTTP endpoint
+
+static bool SendAll(int fd, const char* buf, size_t len)
+{
+	while(len > 0)
+	{
+		ssize_t n = send(fd, buf, len, MSG_NOSIGNAL);
+		if( (n < 0) && (errno == EINTR) )
+			continue;
+		if(n <= 0)
+			return false;
+
+		buf += n;
+		len -= n;
+	}
+	return true;
+}
+
+/**
+	@brief Reads one HTTP request and answers it: the metrics for GET /metrics, and 404 for anything else
+ */
+static void HandleMetricsRequest(int fd)
+{
+	string request;
+	while( (request.find("\r\n\r\n") == string::npos) && (request.find("\n\n") == string::npos) )
+	{
+		char buf[512];
+		ssize_t n = recv(fd, buf, sizeof(buf), 0);
+		if( (n < 0) && (errno == EINTR) )
+			continue;
+		if( (n <= 0) || (request.length() + n > MAX_HTTP_REQUEST) )
+			return;
+		request.append(buf, n);
+	}
+
+	//Only the request line matters, and query strings are ignored
+	string line = request.substr(0, request.find_first_of("\r\n"));
+	size_t space = line.find(' ');
+	string method = line.substr(0, space);
+	string path;
+	if(space != string::npos)
+		path = line.substr(space + 1, line.find_first_of(" ?", space + 1) - space - 1);
+
+	string status = "200 OK";
+	string body;
+	if( (method == "GET") && (path == "/metrics") )
+		body = FormatMetrics();
+	else
+	{
+		status = "404 Not Found";
+		body = "Metrics are at /metrics\n";
+	}
+
+	char header[256];
+	int len = snprintf(header, sizeof(header),
+		"HTTP/1.0 %s\r\n"
+		"Content-Type: text/plain; version=0.0.4\r\n"
+		"Content-Length: %zu\r\n"
+		"Connection: close\r\n"
+		"\r\n",
+		status.c_str(),
+		body.length());
+	if(SendAll(fd, header, len))
+		SendAll(fd, body.c_str(), body.length());
+}
+
+/**
+	@brief Answers scrapes one at a time, for as long as the program runs
+ */
+static void ServeMetrics(int listenFd)
+{
+	while(true)
+	{
+		int fd = accept4(listenFd, NULL, NULL, SOCK_CLOEXEC);
+		if(fd < 0)
+		{
+			if( (errno == EINTR) || (errno == ECONNABORTED) )
+				continue;
+			LogError("Metrics endpoint stopped: %s\n", strerror(errno));
+			close(listenFd);
+			return;
+		}
+
+		//Don't let a scraper that never finishes its request block the next one
+		timeval timeout = {HTTP_TIMEOUT, 0};
+		setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+		setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+
+		HandleMetricsRequest(fd);
+		close(fd);
+	}
+}
+
+/**
+	@brief Starts serving the metrics over HTTP, on a thread of its own
+
+	@param address	"port" to listen on every interface, or "host:port" (e.g. localhost:9100) to listen on one
+
+	@return False (after logging why) if we couldn't listen
+ */
+bool StartMetricsServer(const string& address)
+{
+	string host;
+	string port = address;
+	size_t colon = address.rfind(':');
+	if(colon != string::npos)
+	{
+		host = address.substr(0, colon);
+		port = address.substr(colon + 1);
+		if( (host.length() >= 2) && (host[0] == '[') && (host[host.length() - 1] == ']') )
+			host = host.substr(1, host.length() - 2);
+	}
+
+	addrinfo hints;
+	memset(&hints, 0, sizeof(hints));
+	hints.ai_family = AF_UNSPEC;
+	hints.ai_socktype = SOCK_STREAM;
+	hints.ai_flags = AI_PASSIVE;
+	addrinfo* addrs = NULL;
+	int err = getaddrinfo(host.empty() ? NULL : host.c_str(), port.c_str(), &hints, &addrs);
+	if(err != 0)
+	{
+		LogError("Couldn't look up metrics address %s: %s\n", address.c_str(), gai_strerror(err));
+		return false;
+	}
+
+	int fd = -1;
+	for(addrinfo* a = addrs; a != NULL; a = a->ai_next)
+	{
+		fd = socket(a->ai_family, a->ai_socktype | SOCK_CLOEXEC, a->ai_protocol);
+		if(fd < 0)
+			continue;
+
+		//A restarted server shouldn't have to wait for the old one's connections to time out
+		int yes = 1;
+		setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(yes));
+		if( (0 == ::bind(fd, a->ai_addr, a->ai_addrlen)) && (0 == listen(fd, 16)) )
+			break;
+
+		err = errno;
+		close(fd);
+		fd = -1;
+		errno = err;
+	}
+	freeaddrinfo(addrs);
+
+	if(fd < 0)
+	{
+		LogError("Couldn't serve metrics on %s: %s\n", address.c_str(), strerror(errno));
+		return false;
+	}
+
+	thread(ServeMetrics, fd).detach();
+	LogNotice("Serving metrics on http://%s/metrics\n", address.c_str());
+	return true;
+}
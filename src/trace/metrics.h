@@ -0,0 +1,56 @@
+/***********************************************************************************************************************
+ * Copyright (C) 2016 Andrew Zonenberg and contributors                                                                *
+ *                                                                                                                     *
+ * This program is free software; you can redistribute it and/or modify it under the terms of the GNU Lesser General   *
+ * Public License as published by the Free Software Foundation; either version 2.1 of the License, or (at your option) *
+ * any later version.                                                                                                  *
+ *                                                                                                                     *
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied  *
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for     *
+ * more details.                                                                                                       *
+ *                                                                                                                     *
+ * You should have received a copy of the GNU Lesser General Public License along with this program; if not, you may   *
+ * find one here:                                                                                                      *
+ * https://www.gnu.org/licenses/old-licenses/lgpl-2.1.txt                                                              *
+ * or you may search the http://www.gnu.org website for the version 2.1 license, or you may write to the Free Software *
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA                                      *
+ **********************************************************************************************************************/
+
+#ifndef metrics_h
+#define metrics_h
+
+#include <string>
+#include <vector>
+
+/**
+	@file
+	@brief Counters for long-running services, served over HTTP in the Prometheus text format
+
+	Each metric family is described once, up front, with DescribeMetric(). A family has one series per set of labels,
+	named as Prometheus does (e.g. gp4par_jobs_total{status="ok"}, see MetricName()); series are created the first
+	time they're updated. Updates take a lock, so they're meant for once per job or request, not inner loops.
+ */
+
+enum class MetricType
+{
+	COUNTER,
+	GAUGE,
+	HISTOGRAM
+};
+
+void DescribeMetric(
+	const std::string& family,
+	MetricType type,
+	const std::string& help,
+	const std::vector<double>& buckets = std::vector<double>());
+
+std::string MetricName(const std::string& family, const std::string& label, const std::string& value);
+
+void IncrementMetric(const std::string& name, double amount = 1);
+void SetMetric(const std::string& name, double value);
+void ObserveMetric(const std::string& name, double value);
+
+std::string FormatMetrics();
+bool StartMetricsServer(const std::string& address);
+
+#endif
@@ -0,0 +1,269 @@
+/***********************************************************************************************************************
+ * Copyright (C) 2016 Andrew Zonenberg and contributors                                                                *
+ *                                                                                                                     *
+ * This program is free software; you can redistribute it and/or modify it under the terms of the GNU Lesser General   *
+ * Public License as published by the Free Software Foundation; either version 2.1 of the License, or (at your option) *
+ * any later version.                                                                                                  *
+ *                                                                                                                     *
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied  *
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for     *
+ * more details.                                                                                                       *
+ *                                                                                                                     *
+ * You should have received a copy of the GNU Lesser General Public License along with this program; if not, you may   *
+ * find one here:                                                                                                      *
+ * https://www.gnu.org/licenses/old-licenses/lgpl-2.1.txt                                                              *
+ * or you may search the http://www.gnu.org website for the version 2.1 license, or you may write to the Free Software *
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA                                      *
+ **********************************************************************************************************************/
+
+#include <cstdio>
+#include <cstdlib>
+#include <mutex>
+#include <vector>
+#include <unistd.h>
+#include <log.h>
+#include "trace.h"
+
+using namespace std;
+
+atomic<bool> g_tracing(false);
+chrono::steady_clock::time_point g_traceEpoch;
+
+/**
+	@brief One finished span
+ */
+class TraceEvent
+{
+public:
+	const char* m_name;
+	uint64_t m_start;
+	uint64_t m_end;
+};
+
+/**
+	@brief The most recent events of one thread
+ */
+class TraceBuffer
+{
+public:
+	TraceBuffer(uint32_t tid, size_t size)
+		: m_tid(tid)
+		, m_events(size)
+		, m_next(0)
+		, m_wrapped(false)
+	{}
+
+	uint32_t m_tid;
+	vector<TraceEvent> m_events;
+	size_t m_next;
+	bool m_wrapped;
+};
+
+/**
+	@brief Every thread's buffer, and where the trace goes.
+
+	Buffers are never freed while the program is running, since their events haven't been written yet. Threads that
+	exit give theirs back to be reused by the next new thread, so a long-running server doesn't keep allocating them.
+ */
+class TraceRegistry
+{
+public:
+	~TraceRegistry()
+	{
+		for(auto b : m_buffers)
+			delete b;
+	}
+
+	mutex m_lock;
+	vector<TraceBuffer*> m_buffers;
+	vector<TraceBuffer*> m_freeBuffers;
+	size_t m_bufferSize;
+	string m_fname;
+};
+
+static TraceRegistry& GetRegistry()
+{
+	static TraceRegistry registry;
+	return registry;
+}
+
+/**
+	@brief The calling thread's buffer (NULL until it records its first event), given back when the thread exits
+ */
+class TraceBufferHandle
+{
+public:
+	TraceBufferHandle()
+		: m_buffer(NULL)
+	{}
+
+	~TraceBufferHandle()
+	{
+		if(m_buffer == NULL)
+			return;
+		TraceRegistry& registry = GetRegistry();
+		lock_guard<mutex> guard(registry.m_lock);
+		registry.m_freeBuffers.push_back(m_buffer);
+	}
+
+	TraceBuffer* m_buffer;
+};
+
+static thread_local TraceBufferHandle g_traceBuffer;
+
+static void WriteTraceAtExit()
+{
+	WriteTrace(GetRegistry().m_fname);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Recording
+
+/**
+	@brief Starts recording spans, and arranges for them to be written to fname when the program exits.
+
+	Should be called once, at startup, before any other threads are running.
+
+	@param fname				Trace file to write
+	@param events_per_thread	How many of the most recent events of each thread to keep
+ */
+bool StartTracing(const string& fname, size_t events_per_thread)
+{
+	TraceRegistry& registry = GetRegistry();
+	if(IsTracing())
+	{
+		LogError("Tracing to %s already\n", registry.m_fname.c_str());
+		return false;
+	}
+	if(events_per_thread == 0)
+	{
+		LogError("Trace buffers must have room for at least one event\n");
+		return false;
+	}
+
+	registry.m_fname = fname;
+	registry.m_bufferSize = events_per_thread;
+	g_traceEpoch = chrono::steady_clock::now();
+	g_tracing = true;
+
+	//The registry was constructed above, so it's still around when this runs
+	atexit(WriteTraceAtExit);
+	return true;
+}
+
+/**
+	@brief Gets the calling thread's buffer, taking one if it doesn't have one yet
+ */
+static TraceBuffer* GetTraceBuffer()
+{
+	TraceBuffer* buffer = g_traceBuffer.m_buffer;
+	if(buffer == NULL)
+	{
+		TraceRegistry& registry = GetRegistry();
+		lock_guard<mutex> guard(registry.m_lock);
+		if(registry.m_freeBuffers.empty())
+		{
+			buffer = new TraceBuffer(registry.m_buffers.size() + 1, registry.m_bufferSize);
+			registry.m_buffers.push_back(buffer);
+		}
+		else
+		{
+			buffer = registry.m_freeBuffers.back();
+			registry.m_freeBuffers.pop_back();
+		}
+		g_traceBuffer.m_buffer = buffer;
+	}
+	return buffer;
+}
+
+/**
+	@brief Gets the start time of an event, making sure the calling thread has a buffer to record it in by the time
+	it ends.
+
+	Threads that reuse a buffer share its track in the trace. Since the buffer is taken here rather than when the first
+	event ends, a thread that's running never shares its track with another one.
+ */
+uint64_t BeginTraceEvent()
+{
+	GetTraceBuffer();
+	return GetTraceTime();
+}
+
+/**
+	@brief Adds one event to the calling thread's buffer (overwriting its oldest one, if the buffer is full)
+
+	@param name		Name of the event (must outlive the trace)
+	@param start	Start of the event, from GetTraceTime()
+	@param end		End of the event, from GetTraceTime()
+ */
+void RecordTraceEvent(const char* name, uint64_t start, uint64_t end)
+{
+	TraceBuffer* buffer = GetTraceBuffer();
+	TraceEvent& event = buffer->m_events[buffer->m_next];
+	event.m_name = name;
+	event.m_start = start;
+	event.m_end = end;
+
+	buffer->m_next ++;
+	if(buffer->m_next == buffer->m_events.size())
+	{
+		buffer->m_next = 0;
+		buffer->m_wrapped = true;
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Output
+
+/**
+	@brief Writes everything recorded so far as a Chrome trace (JSON object format).
+
+	Other threads must not be recording while this runs. Times are in microseconds, as the format expects.
+ */
+bool WriteTrace(const string& fname)
+{
+	FILE* fp = fopen(fname.c_str(), "w");
+	if(!fp)
+	{
+		LogError("Couldn't open trace file %s for writing\n", fname.c_str());
+		return false;
+	}
+
+	TraceRegistry& registry = GetRegistry();
+	lock_guard<mutex> guard(registry.m_lock);
+
+	int pid = getpid();
+	fprintf(fp, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[");
+	bool first = true;
+	for(auto b : registry.m_buffers)
+	{
+		//Oldest first
+		size_t count = b->m_wrapped ? b->m_events.size() : b->m_next;
+		size_t base = b->m_wrapped ? b->m_next : 0;
+		for(size_t i=0; i<count; i++)
+		{
+			TraceEvent& event = b->m_events[(base + i) % b->m_events.size()];
+			fprintf(fp, "%s\n{\"name\":\"", first ? "" : ",");
+			first = false;
+			for(const char* p = event.m_name; *p; p++)
+			{
+				if( (*p == '\"') || (*p == '\\') )
+					fputc('\\', fp);
+				fputc(*p, fp);
+			}
+			fprintf(fp, "\",\"ph\":\"X\",\"pid\":%d,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}",
+				pid,
+				b->m_tid,
+				event.m_start / 1000.0,
+				(event.m_end - event.m_start) / 1000.0);
+		}
+	}
+	fprintf(fp, "\n]}\n");
+
+	if(fclose(fp) != 0)
+	{
+		LogError("Couldn't write trace file %s\n", fname.c_str());
+		return false;
+	}
+	return true;
+}
@@ -0,0 +1,96 @@
+/***********************************************************************************************************************
+ * Copyright (C) 2016 Andrew Zonenberg and contributors                                                                *
+ *                                                                                                                     *
+ * This program is free software; you can redistribute it and/or modify it under the terms of the GNU Lesser General   *
+ * Public License as published by the Free Software Foundation; either version 2.1 of the License, or (at your option) *
+ * any later version.                                                                                                  *
+ *                                                                                                                     *
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied  *
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for     *
+ * more details.                                                                                                       *
+ *                                                                                                                     *
+ * You should have received a copy of the GNU Lesser General Public License along with this program; if not, you may   *
+ * find one here:                                                                                                      *
+ * https://www.gnu.org/licenses/old-licenses/lgpl-2.1.txt                                                              *
+ * or you may search the http://www.gnu.org website for the version 2.1 license, or you may write to the Free Software *
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA                                      *
+ **********************************************************************************************************************/
+
+#ifndef trace_h
+#define trace_h
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+/**
+	@file
+	@brief Scoped timing spans, written out as a Chrome trace (load in chrome://tracing or ui.perfetto.dev)
+
+	Each thread records into its own ring buffer, so recording never takes a lock, and only the most recent events of
+	each thread are kept. Until StartTracing() is called a span costs one relaxed atomic load.
+ */
+
+bool StartTracing(const std::string& fname, size_t events_per_thread = 65536);
+bool WriteTrace(const std::string& fname);
+uint64_t BeginTraceEvent();
+void RecordTraceEvent(const char* name, uint64_t start, uint64_t end);
+
+extern std::atomic<bool> g_tracing;
+extern std::chrono::steady_clock::time_point g_traceEpoch;
+
+/**
+	@brief True if trace events are being recorded
+ */
+inline bool IsTracing()
+{ return g_tracing.load(std::memory_order_relaxed); }
+
+/**
+	@brief Nanoseconds since tracing started
+ */
+inline uint64_t GetTraceTime()
+{
+	auto elapsed = std::chrono::steady_clock::now() - g_traceEpoch;
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count();
+}
+
+/**
+	@brief Records the time from construction to destruction as one event.
+
+	The name must be a string literal (or otherwise live until the trace is written), since only the pointer is kept.
+ */
+class TraceSpan
+{
+public:
+	TraceSpan(const char* name)
+		: m_name(name)
+		, m_active(IsTracing())
+		, m_start(m_active ? BeginTraceEvent() : 0)
+	{}
+
+	~TraceSpan()
+	{
+		if(m_active)
+			RecordTraceEvent(m_name, m_start, GetTraceTime());
+	}
+
+	/**
+		@brief Ends this span and starts another one with the same name, for timing each pass through a loop
+	 */
+	void Split()
+	{
+		if(!m_active)
+			return;
+		uint64_t now = GetTraceTime();
+		RecordTraceEvent(m_name, m_start, now);
+		m_start = now;
+	}
+
+protected:
+	const char* m_name;
+	bool m_active;
+	uint64_t m_start;
+};
+
+#endif
@@ -0,0 +1,147 @@
+/***********************************************************************************************************************
+ * Copyright (C) 2016 Andrew Zonenberg and contributors                                                                *
+ *                                                                                                                     *
+ * This program is free software; you can redistribute it and/or modify it under the terms of the GNU Lesser General   *
+ * Public License as published by the Free Software Foundation; either version 2.1 of the License, or (at your option) *
+ * any later version.                                                                                                  *
+ *                                                                                                                     *
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied  *
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for     *
+ * more details.                                                                                                       *
+ *                                                                                                                     *
+ * You should have received a copy of the GNU Lesser General Public License along with this program; if not, you may   *
+ * find one here:                                                                                                      *
+ * https://www.gnu.org/licenses/old-licenses/lgpl-2.1.txt                                                              *
+ * or you may search the http://www.gnu.org website for the version 2.1 license, or you may write to the Free Software *
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA                                      *
+ **********************************************************************************************************************/
+
+
+#include <log.h>
+#include <xbpar.h>
+
+using namespace std;
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Construction
+
+/**
+	@brief Builds the matrices for a device graph. The graph's topology must be final.
+ */
+PARAdjacency::PARAdjacency(PARGraph* device)
+	: m_nodeCount(device->GetNumNodes())
+	, m_rowWords( (m_nodeCount + 63) / 64 )
+	, m_portCount(PARGraph::GetNumPorts())
+{
+	//Fabric ports
+	m_fabricOutputs.assign(static_cast<size_t>(m_portCount) * m_rowWords, 0);
+	m_fabricInputs.assign(static_cast<size_t>(m_portCount) * m_rowWords, 0);
+	for(uint32_t i=0; i<m_nodeCount; i++)
+	{
+		PARGraphNode* node = device->GetNodeByIndex(i);
+		for(uint32_t j=0; j<node->GetFabricOutputCount(); j++)
+		{
+			uint16_t port = node->GetFabricOutput(j);
+			if(port < m_portCount)
+				SetBit(&m_fabricOutputs[port * m_rowWords], i);
+		}
+		for(uint32_t j=0; j<node->GetFabricInputCount(); j++)
+		{
+			uint16_t port = node->GetFabricInput(j);
+			if(port < m_portCount)
+				SetBit(&m_fabricInputs[port * m_rowWords], i);
+		}
+	}
+
+	//Dedicated routing. Find all of the port pairs first, so the rows are allocated in one go rather than
+	//reallocated (and copied) every time we find a new pair.
+	for(uint32_t i=0; i<m_nodeCount; i++)
+	{
+		PARGraphNode* node = device->GetNodeByIndex(i);
+		for(uint32_t j=0; j<node->GetEdgeCount(); j++)
+		{
+			PARGraphEdge* edge = node->GetEdgeByIndex(j);
+			uint32_t key = (static_cast<uint32_t>(edge->m_sourceport) << 16) | edge->m_destport;
+			if(m_portPairs.find(key) == m_portPairs.end())
+				m_portPairs.insert(make_pair(key, m_portPairs.size()));
+		}
+	}
+
+	size_t pair_size = static_cast<size_t>(m_nodeCount) * m_rowWords;
+	m_dedicated.assign(m_portPairs.size() * pair_size, 0);
+	for(uint32_t i=0; i<m_nodeCount; i++)
+	{
+		PARGraphNode* node = device->GetNodeByIndex(i);
+		for(uint32_t j=0; j<node->GetEdgeCount(); j++)
+		{
+			PARGraphEdge* edge = node->GetEdgeByIndex(j);
+			uint32_t key = (static_cast<uint32_t>(edge->m_sourceport) << 16) | edge->m_destport;
+			SetBit(&m_dedicated[m_portPairs[key] * pair_size + i * m_rowWords], edge->m_destnode->GetIndex());
+		}
+	}
+
+	LogDebug("Device adjacency matrix: %u nodes, %zu port pairs, %zu KB\n",
+		m_nodeCount,
+		m_portPairs.size(),
+		(m_dedicated.size() + m_fabricOutputs.size() + m_fabricInputs.size()) * sizeof(uint64_t) / 1024);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Queries
+
+/**
+	@brief Returns the dedicated routing row for a source node and port pair, or NULL if no node has that pair
+ */
+const uint64_t* PARAdjacency::GetDedicatedRow(uint32_t source, uint16_t srcport, uint16_t dstport) const
+{
+	uint32_t key = (static_cast<uint32_t>(srcport) << 16) | dstport;
+	auto it = m_portPairs.find(key);
+	if(it == m_portPairs.end())
+		return NULL;
+	return &m_dedicated[ (static_cast<size_t>(it->second) * m_nodeCount + source) * m_rowWords ];
+}
+
+/**
+	@brief Checks if an edge between the given ports of two nodes can be routed (same as PARGraph::HasEdge())
+ */
+bool PARAdjacency::IsRoutable(uint32_t source, uint16_t srcport, uint32_t dest, uint16_t dstport) const
+{
+	if( (srcport < m_portCount) && (dstport < m_portCount) &&
+		TestBit(&m_fabricOutputs[srcport * m_rowWords], source) &&
+		TestBit(&m_fabricInputs[dstport * m_rowWords], dest) )
+	{
+		return true;
+	}
+
+	const uint64_t* row = GetDedicatedRow(source, srcport, dstport);
+	return (row != NULL) && TestBit(row, dest);
+}
+
+/**
+	@brief Counts how many of a set of destination nodes can be reached from the given ports of a source node.
+
+	@param dests	Row with one bit set for each destination node to check
+ */
+uint32_t PARAdjacency::CountRoutable(uint32_t source, uint16_t srcport, uint16_t dstport, const uint64_t* dests) const
+{
+	const uint64_t* dedicated = GetDedicatedRow(source, srcport, dstport);
+
+	const uint64_t* fabric = NULL;
+	if( (srcport < m_portCount) && (dstport < m_portCount) &&
+		TestBit(&m_fabricOutputs[srcport * m_rowWords], source) )
+	{
+		fabric = &m_fabricInputs[dstport * m_rowWords];
+	}
+
+	uint32_t count = 0;
+	for(uint32_t i=0; i<m_rowWords; i++)
+	{
+		uint64_t reachable = 0;
+		if(dedicated != NULL)
+			reachable |= dedicated[i];
+		if(fabric != NULL)
+			reachable |= fabric[i];
+		count += __builtin_popcountll(reachable & dests[i]);
+	}
+	return count;
+}
@@ -0,0 +1,100 @@
+/***********************************************************************************************************************
+ * Copyright (C) 2016 Andrew Zonenberg and contributors                                                                *
+ *                                                                                                                     *
+ * This program is free software; you can redistribute it and/or modify it under the terms of the GNU Lesser General   *
+ * Public License as published by the Free Software Foundation; either version 2.1 of the License, or (at your option) *
+ * any later version.                                                                                                  *
+ *                                                                                                                     *
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied  *
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for     *
+ * more details.                                                                                                       *
+ *                                                                                                                     *
+ * You should have received a copy of the GNU Lesser General Public License along with this program; if not, you may   *
+ * find one here:                                                                                                      *
+ * https://www.gnu.org/licenses/old-licenses/lgpl-2.1.txt                                                              *
+ * or you may search the http://www.gnu.org website for the version 2.1 license, or you may write to the Free Software *
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA                                      *
+ **********************************************************************************************************************/
+
+
+#ifndef PARAdjacency_h
+#define PARAdjacency_h
+
+#include <cstdint>
+#include <vector>
+#include <unordered_map>
+
+class PARGraph;
+
+/**
+	@brief Dense bit-matrix form of a device graph's routing, for checking many edges at once.
+
+	Every row is a bitmask of device nodes (by index), GetRowWords() 64-bit words long. For every (source port,
+	destination port) pair used by at least one dedicated edge, each source node has a row of the destination nodes
+	that pair reaches. General fabric routing is stored as one row per port instead: the nodes with that port as a
+	fabric output, and the nodes with it as a fabric input.
+
+	Only worth it for small devices, since the dedicated rows grow with the square of the node count (a device with
+	a hundred or so nodes needs two words per row).
+ */
+class PARAdjacency
+{
+public:
+	PARAdjacency(PARGraph* device);
+
+	uint32_t GetRowWords() const
+	{ return m_rowWords; }
+
+	bool IsRoutable(uint32_t source, uint16_t srcport, uint32_t dest, uint16_t dstport) const;
+	uint32_t CountRoutable(uint32_t source, uint16_t srcport, uint16_t dstport, const uint64_t* dests) const;
+
+	/**
+		@brief Sets the bit for a node in a row
+	 */
+	static void SetBit(uint64_t* row, uint32_t node)
+	{ row[node / 64] |= (1ULL << (node % 64)); }
+
+	/**
+		@brief Clears the bit for a node in a row
+	 */
+	static void ClearBit(uint64_t* row, uint32_t node)
+	{ row[node / 64] &= ~(1ULL << (node % 64)); }
+
+	/**
+		@brief Checks the bit for a node in a row
+	 */
+	static bool TestBit(const uint64_t* row, uint32_t node)
+	{ return (row[node / 64] >> (node % 64)) & 1; }
+
+protected:
+	const uint64_t* GetDedicatedRow(uint32_t source, uint16_t srcport, uint16_t dstport) const;
+
+	/**
+		@brief Number of nodes in the device, and words per row
+	 */
+	uint32_t m_nodeCount;
+	uint32_t m_rowWords;
+
+	/**
+		@brief Number of port IDs when we were built (ports interned later never have any routing)
+	 */
+	uint32_t m_portCount;
+
+	/**
+		@brief Index of each (source port << 16 | destination port) pair with dedicated routing
+	 */
+	std::unordered_map<uint32_t, uint32_t> m_portPairs;
+
+	/**
+		@brief Dedicated routing rows, indexed [pair][source node][word]
+	 */
+	std::vector<uint64_t> m_dedicated;
+
+	/**
+		@brief Fabric output and input rows, indexed [port][word]
+	 */
+	std::vector<uint64_t> m_fabricOutputs;
+	std::vector<uint64_t> m_fabricInputs;
+};
+
+#endif
@@ -0,0 +1,79 @@
+/***********************************************************************************************************************
+ * Copyright (C) 2016 Andrew Zonenberg and contributors                                                                *
+ *                                                                                                                     *
+ * This program is free software; you can redistribute it and/or modify it under the terms of the GNU Lesser General   *
+ * Public License as published by the Free Software Foundation; either version 2.1 of the License, or (at your option) *
+ * any later version.                                                                                                  *
+ *                                                                                                                     *
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied  *
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for     *
+ * more details.                                                                                                       *
+ *                                                                                                                     *
+ * You should have received a copy of the GNU Lesser General Public License along with this program; if not, you may   *
+ * find one here:                                                                                                      *
+ * https://www.gnu.org/licenses/old-licenses/lgpl-2.1.txt                                                              *
+ * or you may search the http://www.gnu.org website for the version 2.1 license, or you may write to the Free Software *
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA                                      *
+ **********************************************************************************************************************/
+
+#include <xbpar.h>
+
+using namespace std;
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Construction / destruction
+
+PARArena::PARArena(size_t blocksize)
+	: m_blocksize(blocksize)
+	, m_next(NULL)
+	, m_remaining(0)
+	, m_bytesAllocated(0)
+{
+}
+
+PARArena::~PARArena()
+{
+	Clear();
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Allocation
+
+/**
+	@brief Allocate a chunk of memory from the arena
+ */
+void* PARArena::Allocate(size_t size, size_t align)
+{
+	//Pad up to the requested alignment
+	size_t pad = (align - (reinterpret_cast<uintptr_t>(m_next) % align)) % align;
+
+	//Start a new block if this one is full (oversized requests get a block to themselves)
+	if( (m_next == NULL) || (pad + size > m_remaining) )
+	{
+		size_t len = (size + align > m_blocksize) ? (size + align) : m_blocksize;
+		uint8_t* block = new uint8_t[len];
+		m_blocks.push_back(block);
+		m_next = block;
+		m_remaining = len;
+		pad = (align - (reinterpret_cast<uintptr_t>(m_next) % align)) % align;
+	}
+
+	void* ret = m_next + pad;
+	m_next += pad + size;
+	m_remaining -= pad + size;
+	m_bytesAllocated += size;
+	return ret;
+}
+
+/**
+	@brief Free everything in the arena at once
+ */
+void PARArena::Clear()
+{
+	for(auto b : m_blocks)
+		delete[] b;
+	m_blocks.clear();
+	m_next = NULL;
+	m_remaining = 0;
+	m_bytesAllocated = 0;
+}
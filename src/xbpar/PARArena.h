@@ -0,0 +1,73 @@
+/***********************************************************************************************************************
+ * Copyright (C) 2016 Andrew Zonenberg and contributors                                                                *
+ *                                                                                                                     *
+ * This program is free software; you can redistribute it and/or modify it under the terms of the GNU Lesser General   *
+ * Public License as published by the Free Software Foundation; either version 2.1 of the License, or (at your option) *
+ * any later version.                                                                                                  *
+ *                                                                                                                     *
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied  *
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for     *
+ * more details.                                                                                                       *
+ *                                                                                                                     *
+ * You should have received a copy of the GNU Lesser General Public License along with this program; if not, you may   *
+ * find one here:                                                                                                      *
+ * https://www.gnu.org/licenses/old-licenses/lgpl-2.1.txt                                                              *
+ * or you may search the http://www.gnu.org website for the version 2.1 license, or you may write to the Free Software *
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA                                      *
+ **********************************************************************************************************************/
+
+#ifndef PARArena_h
+#define PARArena_h
+
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <utility>
+#include <vector>
+
+/**
+	@brief A simple bump allocator.
+
+	Memory is handed out sequentially from large blocks and is only ever freed all at once, when the arena is cleared
+	or destroyed. Destructors of objects allocated with New() are NOT run by the arena.
+ */
+class PARArena
+{
+public:
+	PARArena(size_t blocksize = 65536);
+	virtual ~PARArena();
+
+	void* Allocate(size_t size, size_t align);
+	void Clear();
+
+	template<class T, class... Args> T* New(Args&&... args)
+	{ return new(Allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...); }
+
+	size_t GetBytesAllocated()
+	{ return m_bytesAllocated; }
+
+protected:
+
+	/**
+		@brief All blocks we've allocated from the system
+	 */
+	std::vector<uint8_t*> m_blocks;
+
+	/**
+		@brief Default size of each new block
+	 */
+	size_t m_blocksize;
+
+	/**
+		@brief Next free byte in the current block, and how much space remains after it
+	 */
+	uint8_t* m_next;
+	size_t m_remaining;
+
+	/**
+		@brief Total bytes handed out (for statistics)
+	 */
+	size_t m_bytesAllocated;
+};
+
+#endif
@@ -0,0 +1,173 @@
+/***********************************************************************************************************************
+ * Copyright (C) 2016 Andrew Zonenberg and contributors                                                                *
+ *                                                                                                                     *
+ * This program is free software; you can redistribute it and/or modify it under the terms of the GNU Lesser General   *
+ * Public License as published by the Free Software Foundation; either version 2.1 of the License, or (at your option) *
+ * any later version.                                                                                                  *
+ *                                                                                                                     *
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied  *
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for     *
+ * more details.                                                                                                       *
+ *                                                                                                                     *
+ * You should have received a copy of the GNU Lesser General Public License along with this program; if not, you may   *
+ * find one here:                                                                                                      *
+ * https://www.gnu.org/licenses/old-licenses/lgpl-2.1.txt                                                              *
+ * or you may search the http://www.gnu.org website for the version 2.1 license, or you may write to the Free Software *
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA                                      *
+ **********************************************************************************************************************/
+
+#include <log.h>
+#include <xbpar.h>
+
+using namespace std;
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Construction / destruction
+
+PARBatchEvaluator::PARBatchEvaluator(PAREngine* master)
+	: m_master(master)
+	, m_labels(NULL)
+	, m_batch(0)
+	, m_busy(0)
+	, m_shutdown(false)
+	, m_candidates(NULL)
+	, m_next(0)
+{
+}
+
+/**
+	@brief Creates an evaluator with the given number of worker threads.
+
+	@return The new evaluator, or NULL if the engine doesn't support replicas
+ */
+PARBatchEvaluator* PARBatchEvaluator::Create(
+	PAREngine* master,
+	uint32_t threads,
+	const PARLabelRegistry& labels)
+{
+	PARBatchEvaluator* evaluator = new PARBatchEvaluator(master);
+	evaluator->m_labels = &labels;
+
+	for(uint32_t i=0; i<threads; i++)
+	{
+		PARGraph* netlist;
+		PARGraph* device;
+		PARGraph::ClonePair(master->m_netlist, master->m_device, netlist, device);
+
+		PAREngine* replica = master->CreateReplica(netlist, device);
+		if(replica == NULL)
+		{
+			delete netlist;
+			delete device;
+			delete evaluator;
+			return NULL;
+		}
+		replica->SetQuiet(true);
+		replica->SetVerifyIncrementalCost(master->m_verifyIncrementalCost);
+		replica->SetCostThreads(master->m_costThreads);
+		replica->SetTimingTarget(master->m_timingTarget, master->m_timingScale);
+		replica->InitCostCache();
+
+		evaluator->m_replicas.push_back(replica);
+		evaluator->m_replicaNetlists.push_back(netlist);
+		evaluator->m_replicaDevices.push_back(device);
+	}
+
+	//Don't start anything until all of the replicas exist, so we don't have to stop threads on failure
+	for(uint32_t i=0; i<threads; i++)
+		evaluator->m_threads.push_back(thread(&PARBatchEvaluator::WorkerThread, evaluator, i));
+
+	return evaluator;
+}
+
+PARBatchEvaluator::~PARBatchEvaluator()
+{
+	{
+		lock_guard<mutex> lock(m_mutex);
+		m_shutdown = true;
+	}
+	m_wake.notify_all();
+	for(auto& t : m_threads)
+		t.join();
+
+	for(uint32_t i=0; i<m_replicas.size(); i++)
+	{
+		delete m_replicas[i];
+		delete m_replicaNetlists[i];
+		delete m_replicaDevices[i];
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Evaluation
+
+/**
+	@brief Measures every candidate against the master's current placement. Blocks until all of them are done.
+ */
+void PARBatchEvaluator::Evaluate(vector<PARCandidateMove>& candidates)
+{
+	m_master->SavePlacement(m_placement);
+
+	{
+		lock_guard<mutex> lock(m_mutex);
+		m_candidates = &candidates;
+		m_next = 0;
+		m_busy = m_threads.size();
+		m_batch ++;
+	}
+	m_wake.notify_all();
+
+	unique_lock<mutex> lock(m_mutex);
+	m_done.wait(lock, [this]{ return m_busy == 0; });
+	m_candidates = NULL;
+}
+
+void PARBatchEvaluator::WorkerThread(uint32_t id)
+{
+	uint32_t seen = 0;
+	while(true)
+	{
+		//Wait for the next batch
+		{
+			unique_lock<mutex> lock(m_mutex);
+			m_wake.wait(lock, [&]{ return m_shutdown || (m_batch != seen); });
+			if(m_shutdown)
+				return;
+			seen = m_batch;
+		}
+
+		//Catch up with whatever the master did since last time, then help out until the queue is empty
+		m_replicas[id]->SyncPlacement(m_placement);
+		while(true)
+		{
+			uint32_t i = m_next ++;
+			if(i >= m_candidates->size())
+				break;
+			EvaluateCandidate(id, (*m_candidates)[i]);
+		}
+
+		lock_guard<mutex> lock(m_mutex);
+		m_busy --;
+		if(m_busy == 0)
+			m_done.notify_one();
+	}
+}
+
+/**
+	@brief Makes a candidate move on one worker's replica, measures it, and undoes it
+ */
+void PARBatchEvaluator::EvaluateCandidate(uint32_t id, PARCandidateMove& candidate)
+{
+	PAREngine* replica = m_replicas[id];
+	PARGraphNode* node = m_replicaNetlists[id]->GetNodeByIndex(candidate.m_node->GetIndex());
+	PARGraphNode* site = m_replicaDevices[id]->GetNodeByIndex(candidate.m_site->GetIndex());
+
+	PARMove move;
+	uint32_t original_cost = replica->GetCachedCost();
+	replica->m_currentMove = &move;
+	replica->m_currentMoveInvalidated = 0;
+	candidate.m_legal = replica->TryMoveStep(move, node, site, *m_labels);
+	if(candidate.m_legal)
+		candidate.m_delta = static_cast<int32_t>(replica->GetCachedCost()) - static_cast<int32_t>(original_cost);
+	replica->RevertMove(move, *m_labels);
+}
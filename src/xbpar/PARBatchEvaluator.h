@@ -0,0 +1,134 @@
+/***********************************************************************************************************************
+ * Copyright (C) 2016 Andrew Zonenberg and contributors                                                                *
+ *                                                                                                                     *
+ * This program is free software; you can redistribute it and/or modify it under the terms of the GNU Lesser General   *
+ * Public License as published by the Free Software Foundation; either version 2.1 of the License, or (at your option) *
+ * any later version.                                                                                                  *
+ *                                                                                                                     *
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied  *
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for     *
+ * more details.                                                                                                       *
+ *                                                                                                                     *
+ * You should have received a copy of the GNU Lesser General Public License along with this program; if not, you may   *
+ * find one here:                                                                                                      *
+ * https://www.gnu.org/licenses/old-licenses/lgpl-2.1.txt                                                              *
+ * or you may search the http://www.gnu.org website for the version 2.1 license, or you may write to the Free Software *
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA                                      *
+ **********************************************************************************************************************/
+
+#ifndef PARBatchEvaluator_h
+#define PARBatchEvaluator_h
+
+#include <vector>
+#include <map>
+#include <string>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+
+class PAREngine;
+class PARGraph;
+class PARGraphNode;
+
+/**
+	@brief A single-step move to be evaluated by a PARBatchEvaluator
+ */
+class PARCandidateMove
+{
+public:
+	PARCandidateMove(PARGraphNode* node, PARGraphNode* site)
+		: m_node(node)
+		, m_site(site)
+		, m_legal(false)
+		, m_delta(0)
+	{}
+
+	/**
+		@brief The netlist node to move, and the device node to move it to (both in the master engine's graphs)
+	 */
+	PARGraphNode* m_node;
+	PARGraphNode* m_site;
+
+	/**
+		@brief Set by the evaluator: whether the move is legal, and if so how much it changes the cost
+	 */
+	bool m_legal;
+	int32_t m_delta;
+};
+
+/**
+	@brief Evaluates batches of candidate moves against an engine's current placement, in parallel.
+
+	Each worker thread owns a replica of the engine (made by PAREngine::CreateReplica()) on its own copy of the
+	graphs. Before every batch the replicas are brought up to date with the master's placement, then the workers take
+	candidates from a shared queue until it's empty. Every candidate is measured on exactly the master's placement, so
+	the results don't depend on which worker ran it or how many workers there are.
+ */
+class PARBatchEvaluator
+{
+public:
+	static PARBatchEvaluator* Create(
+		PAREngine* master,
+		uint32_t threads,
+		const PARLabelRegistry& labels);
+	virtual ~PARBatchEvaluator();
+
+	void Evaluate(std::vector<PARCandidateMove>& candidates);
+
+protected:
+	PARBatchEvaluator(PAREngine* master);
+
+	void WorkerThread(uint32_t id);
+	void EvaluateCandidate(uint32_t id, PARCandidateMove& candidate);
+
+	/**
+		@brief The engine whose placement we're evaluating moves against
+	 */
+	PAREngine* m_master;
+
+	/**
+		@brief Per-worker state: replica engine and the graphs it works on
+	 */
+	std::vector<PAREngine*> m_replicas;
+	std::vector<PARGraph*> m_replicaNetlists;
+	std::vector<PARGraph*> m_replicaDevices;
+
+	/**
+		@brief The labels of the master's graphs (shared by every worker, read-only). Only used during Anneal(), so
+		they always outlive us.
+	 */
+	const PARLabelRegistry* m_labels;
+	std::vector<std::thread> m_threads;
+
+	/**
+		@brief Protects everything below except m_next
+	 */
+	std::mutex m_mutex;
+
+	/**
+		@brief Signaled when a new batch is ready (or we're shutting down), and when the last worker finishes one
+	 */
+	std::condition_variable m_wake;
+	std::condition_variable m_done;
+
+	/**
+		@brief Number of batches started so far, and how many workers are still busy with the current one
+	 */
+	uint32_t m_batch;
+	uint32_t m_busy;
+
+	/**
+		@brief Set to make all workers exit
+	 */
+	bool m_shutdown;
+
+	/**
+		@brief The current batch, the master's placement it's evaluated against, and the next candidate to hand out
+	 */
+	std::vector<PARCandidateMove>* m_candidates;
+	std::vector<uint16_t> m_placement;
+	std::atomic<uint32_t> m_next;
+};
+
+#endif
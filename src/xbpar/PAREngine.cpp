@@ -16,12 +16,26 @@
  * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA                                      *
  **********************************************************************************************************************/
 
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
 #include <cstdlib>
+#include <deque>
+#include <functional>
+#include <set>
+#include <thread>
 #include <log.h>
+#include <debuglog.h>
+#include <trace.h>
 #include <xbpar.h>
 
 using namespace std;
 
+const uint32_t PAREngine::UNSHARED_NET;
+const uint32_t PAREngine::PARALLEL_COST_EDGES;
+const int32_t PAREngine::ANY_REGION;
+
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 // Construction / destruction
 
@@ -29,12 +43,46 @@ PAREngine::PAREngine(PARGraph* netlist, PARGraph* device)
 	: m_netlist(netlist)
 	, m_device(device)
 	, m_temperature(0)
+	, m_currentMove(NULL)
+	, m_currentMoveInvalidated(0)
+	, m_batchSize(1)
+	, m_batchThreads(1)
+	, m_batchEvaluator(NULL)
+	, m_quiet(false)
+	, m_stop(NULL)
+	, m_cancel(NULL)
+	, m_hasDeadline(false)
+	, m_moveLog(NULL)
+	, m_unroutableCost(0)
+	, m_timingTarget(0)
+	, m_timingScale(1)
+	, m_verifyIncrementalCost(false)
+	, m_multilevel(false)
+	, m_costThreads(0)
 {
-
+	AddMoveGenerator(new PARRelocateMoveGenerator);
+	AddMoveGenerator(new PARSwapChainMoveGenerator);
 }
 
 PAREngine::~PAREngine()
 {
+	delete m_batchEvaluator;
+	m_batchEvaluator = NULL;
+
+	for(auto generator : m_moveGenerators)
+		delete generator;
+	m_moveGenerators.clear();
+}
+
+/**
+	@brief Adds another kind of move for the optimizer to try. The engine takes ownership of the generator.
+ */
+void PAREngine::AddMoveGenerator(PARMoveGenerator* generator)
+{
+	m_moveGenerators.push_back(generator);
+	m_moveWeights.push_back(1);
+	m_moveProposed.push_back(0);
+	m_moveAccepted.push_back(0);
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -45,74 +93,417 @@ PAREngine::~PAREngine()
 
 	@return true on success, fail if design could not be routed
  */
-bool PAREngine::PlaceAndRoute(map<uint32_t, string> label_names, uint32_t seed)
+bool PAREngine::PlaceAndRoute(const PARLabelRegistry& labels, uint32_t seed)
 {
 	LogVerbose("\nXBPAR initializing...\n");
-	m_temperature = 100;
 
-	//TODO: glibc rand sucks, replace with something a bit more random
-	//(this may not make a difference for a device this tiny though)
-	srand(seed);
+	if(!Initialize(labels))
+		return false;
 
-	//Detect obviously impossible-to-route designs
-	if(!SanityCheck(label_names))
+	//Converge until we get a passing placement
+	if(!m_quiet)
+		LogNotice("\nOptimizing placement...\n");
+	LogIndenter li;
+	Anneal(labels, seed);
+	if(IsCancelled())
 		return false;
 
+	//Check for any remaining unroutable nets
+	return CheckRouting();
+}
+
+/**
+	@brief Checks the design for feasibility and generates the initial placement
+ */
+bool PAREngine::Initialize(const PARLabelRegistry& labels)
+{
+	//Make routability lookups O(1). Normally done by the caller once the device graph is built,
+	//and reused across multiple runs.
+	if(!m_device->IsEdgeIndexValid())
+		m_device->IndexEdges();
+
+	//Detect obviously impossible-to-route designs
+	{
+		TraceSpan span("Sanity check");
+		if(!SanityCheck(labels))
+			return false;
+	}
+
 	//Do an initial valid, but not necessarily routable, placement
-	if(!InitialPlacement(label_names))
-		return false;
+	TraceSpan span("Initial placement");
+	auto start = chrono::steady_clock::now();
+	bool ok = InitialPlacement(labels);
+	m_stats.initialPlacementTime += chrono::duration<double>(chrono::steady_clock::now() - start).count();
+	return ok;
+}
 
-	//Converge until we get a passing placement
-	LogNotice("\nOptimizing placement...\n");
-	LogIndenter li;
+/**
+	@brief Replaces the current placement with one found by a complete search (see PARExactPlacer), if one can be
+	found within time_budget seconds.
+
+	Like Anneal(), this needs the graphs to be set up by Initialize() first.
+
+	@return True if a placement was found (it's routable, and no congestion bin is over capacity). If not, the
+			current placement is left alone.
+ */
+bool PAREngine::PlaceExactly(const PARLabelRegistry& labels, double time_budget)
+{
+	TraceSpan span("Exact placement");
+	//Don't search past the deadline, if there is one
+	if(m_hasDeadline)
+	{
+		double remaining = chrono::duration<double>(m_deadline - chrono::steady_clock::now()).count();
+		time_budget = max(min(time_budget, remaining), 0.0);
+	}
+
+	PARExactPlacer placer(this, labels);
+	bool found = placer.Search(time_budget);
+
+	if(!m_quiet)
+	{
+		unsigned long long visits = placer.GetVisitCount();
+		if(found && placer.IsComplete())
+		{
+			LogVerbose("Found optimal placement (%u congestion resources used) after %llu steps\n",
+				placer.GetBestUsage(), visits);
+		}
+		else if(found)
+		{
+			LogVerbose("Out of time after %llu steps, using best placement found (%u congestion resources used)\n",
+				visits, placer.GetBestUsage());
+		}
+		else if(placer.IsComplete())
+			LogVerbose("No legal placement exists (searched %llu steps)\n", visits);
+		else
+			LogVerbose("Out of time after %llu steps without finding a placement\n", visits);
+	}
+
+	if(found && !m_netlistEdges.empty())
+		InitCostCache();
+	return found;
+}
+
+/**
+	@brief Iteratively improves the current placement by simulated annealing.
+
+	The netlist must already be fully placed (by Initialize(), or copied from another engine's placement)
+	and both graphs indexed by label.
+
+	The temperature starts high enough to accept most uphill moves and cools at a rate set by how many moves are
+	being accepted. We stop when the system is frozen, when the cost has not improved for a while, or when a zero-cost
+	placement is found. The best placement seen is restored at the end.
+
+	If we stagnate or freeze without reaching zero cost, we restart from the best placement at a raised temperature
+	(up to m_annealOptions.maxReheats times).
+
+	@return true if the final placement is routable
+ */
+bool PAREngine::Anneal(const PARLabelRegistry& labels, uint32_t seed)
+{
+	TraceSpan span("Anneal");
+	auto start = chrono::steady_clock::now();
+	PARAnnealRun run(seed);
+	m_random.Seed(seed);
+	if(m_moveLog != NULL)
+		m_moveLog->BeginRun(seed);
+
+	//Set up the incremental cost tables for the starting placement
+	InitCostCache();
+
+	//Every kind of move starts out equally likely
+	for(uint32_t i=0; i<m_moveGenerators.size(); i++)
+	{
+		m_moveWeights[i] = 1;
+		m_moveProposed[i] = 0;
+		m_moveAccepted[i] = 0;
+	}
+
+	//Start up the workers for batched evaluation, if we're using it
+	if( (m_batchSize > 1) && (m_batchThreads > 0) )
+	{
+		m_batchEvaluator = PARBatchEvaluator::Create(this, m_batchThreads, labels);
+		if( (m_batchEvaluator == NULL) && !m_quiet )
+			LogWarning("This engine can't evaluate moves in parallel, evaluating one at a time\n");
+	}
+
+	double initial_temperature;
+	{
+		TraceSpan temperature_span("Initial temperature");
+		initial_temperature = ComputeInitialTemperature(labels);
+	}
+	m_temperature = initial_temperature;
+
+	uint32_t moves_per_temperature = m_annealOptions.movesPerTemperature;
+	if(moves_per_temperature == 0)
+		moves_per_temperature = 10 * m_netlist->GetNumNodes();
 
 	uint32_t iteration = 0;
 	vector<PARGraphEdge*> unroutes;
-	uint32_t best_cost = 1000000;
+	uint32_t best_cost = GetCachedCost();
+	vector<uint16_t> best_placement;
+	SavePlacement(best_placement);
 	uint32_t time_since_best_cost = 0;
+	uint32_t moves = 0;
+	uint32_t accepted = 0;
+	uint32_t reheats = 0;
 	bool made_change = true;
 	uint32_t newcost = 0;
-	while(m_temperature > 0)
+	TraceSpan step_span("Temperature step");
+	while(m_temperature > m_annealOptions.finalTemperature)
 	{
+		//Stop if somebody else asked us to, or we're out of time
+		if( ( (m_stop != NULL) && *m_stop ) || IsCancelled() )
+			break;
+		if(IsPastDeadline())
+		{
+			run.timedOut = true;
+			if(!m_quiet)
+			{
+				LogVerbose("Out of time after %u iterations, using best placement found (cost %u)\n",
+					iteration, best_cost);
+			}
+			break;
+		}
+
 		//Figure out how good we are now.
 		//Don't recompute the cost if we didn't accept the last iteration's changes
 		if(made_change)
+		{
+			PARMoveLogTimer timer(m_moveLog, PARMoveLog::PHASE_SCORE);
 			newcost = ComputeAndPrintScore(unroutes, iteration);
-		time_since_best_cost ++;
+			if(run.cost.empty() || (run.cost.back().second != newcost) )
+				run.cost.push_back(pair<uint32_t, uint32_t>(iteration, newcost));
+		}
 		iteration ++;
 
-		//If cost is zero, stop now - we found a satisfactory placement!
-		if(newcost == 0)
-			break;
-
 		//If the new placement is better than our previous record, make a note of that
 		if(newcost < best_cost)
 		{
 			best_cost = newcost;
+			SavePlacement(best_placement);
 			time_since_best_cost = 0;
 		}
 
-		//If we failed to improve placement after ten iterations it's hopeless, give up
-		//if(time_since_best_cost > 10)
-		//	break;
+		if(m_progress)
+		{
+			PARProgress progress;
+			progress.seed = seed;
+			progress.iteration = iteration;
+			progress.cost = newcost;
+			progress.bestCost = best_cost;
+			progress.temperature = m_temperature;
+			progress.seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+			m_progress(progress);
+		}
+
+		//If cost is zero, stop now - we found a satisfactory placement!
+		if(newcost == 0)
+			break;
 
 		//Find the set of nodes in the netlist that we can optimize
 		//If none were found, give up
 		vector<PARGraphNode*> badnodes;
-		FindSubOptimalPlacements(badnodes);
+		{
+			PARMoveLogTimer timer(m_moveLog, PARMoveLog::PHASE_FIND);
+			FindSubOptimalPlacements(badnodes);
+		}
 		if(badnodes.empty())
 			break;
+		m_stats.AddCandidateSet(badnodes.size());
 
 		//Try to optimize the placement more
-		made_change = OptimizePlacement(badnodes, label_names);
+		if(m_moveLog != NULL)
+			m_moveLog->SetIteration(iteration);
+		made_change = OptimizePlacement(badnodes, labels);
+		moves ++;
+		if(made_change)
+			accepted ++;
+
+		//Cool the system down once we've spent enough moves at this temperature
+		if(moves < moves_per_temperature)
+			continue;
+		double acceptance = static_cast<double>(accepted) / moves;
+		if(!m_quiet)
+		{
+			LogDebug("Temperature %.3f: accepted %.1f%% of moves, best cost %u\n",
+				m_temperature, acceptance * 100, best_cost);
+		}
+		m_temperature *= GetCoolingRate(acceptance);
+		step_span.Split();
+		moves = 0;
+		accepted = 0;
+		UpdateMoveWeights();
+
+		//If we failed to improve placement for a while, or froze, go back to the best placement so far and heat
+		//it up again. Once we're out of restarts it's hopeless, give up.
+		time_since_best_cost ++;
+		bool frozen = (m_temperature <= m_annealOptions.finalTemperature);
+		if( (time_since_best_cost > m_annealOptions.stagnationLimit) || frozen )
+		{
+			if(reheats >= m_annealOptions.maxReheats)
+				break;
+			reheats ++;
 
-		//Cool the system down
-		//TODO: Decide on a good rate for this?
-		m_temperature --;
+			RestorePlacement(best_placement);
+			made_change = true;
+			time_since_best_cost = 0;
+			m_temperature = max(
+				initial_temperature * m_annealOptions.reheatTemperature,
+				m_annealOptions.finalTemperature * 2);
+			if(!m_quiet)
+			{
+				LogDebug("No improvement, restarting from best placement (cost %u) at temperature %.3f\n",
+					best_cost, m_temperature);
+			}
+		}
 	}
 
-	//Check for any remaining unroutable nets
-	unroutes.clear();
+	delete m_batchEvaluator;
+	m_batchEvaluator = NULL;
+
+	//We may have wandered uphill since the best placement, go back to it
+	uint32_t final_cost = GetCachedCost();
+	if( (final_cost > best_cost) || ( (final_cost == best_cost) && m_annealOptions.keepFirstBest ) )
+		RestorePlacement(best_placement);
+
+	run.iterations = iteration;
+	run.seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+	m_stats.anneals.push_back(run);
+
+	return (m_unroutableCost == 0) && !IsCancelled();
+}
+
+/**
+	@brief Picks a starting temperature at which an average uphill move is accepted with probability
+	m_annealOptions.initialAcceptance.
+
+	The average is estimated from a number of random trial moves, which are all reverted afterwards.
+ */
+double PAREngine::ComputeInitialTemperature(const PARLabelRegistry& labels)
+{
+	uint64_t uphill_total = 0;
+	uint32_t uphill_moves = 0;
+	for(uint32_t i=0; i<m_annealOptions.initialSamples; i++)
+	{
+		vector<PARGraphNode*> badnodes;
+		FindSubOptimalPlacements(badnodes);
+		if(badnodes.empty())
+			break;
+
+		PARMove move;
+		int32_t delta;
+		if(!ProposeMove(badnodes, labels, move, SelectMoveGenerator(), delta))
+			continue;
+		RevertMove(move, labels);
+
+		if(delta > 0)
+		{
+			uphill_total += delta;
+			uphill_moves ++;
+		}
+	}
+
+	//No uphill moves found? Start cold, just above the final temperature
+	if(uphill_moves == 0)
+		return m_annealOptions.finalTemperature * 2;
+
+	double mean = static_cast<double>(uphill_total) / uphill_moves;
+	return -mean / log(m_annealOptions.initialAcceptance);
+}
+
+/**
+	@brief Decides how much to cool the system given the fraction of moves accepted at the current temperature.
+
+	Cool quickly while nearly everything is accepted (we're just doing a random walk) and slowly in the middle band,
+	where most of the improvement happens.
+ */
+double PAREngine::GetCoolingRate(double acceptance)
+{
+	if(acceptance > m_annealOptions.highAcceptance)
+		return m_annealOptions.fastCooling;
+	else if(acceptance < m_annealOptions.lowAcceptance)
+		return m_annealOptions.normalCooling;
+	return m_annealOptions.slowCooling;
+}
+
+/**
+	@brief Metropolis criterion: always accept improvements, accept a move that costs delta more with
+	probability exp(-delta / T)
+ */
+bool PAREngine::AcceptMove(int32_t delta)
+{
+	if(delta <= 0)
+		return true;
+	if(m_temperature <= 0)
+		return false;
+	return m_random.NextUnit() < exp(-delta / m_temperature);
+}
+
+/**
+	@brief Picks a move generator at random, in proportion to the weights
+ */
+uint32_t PAREngine::SelectMoveGenerator()
+{
+	if(m_moveGenerators.size() == 1)
+		return 0;
+
+	double total = 0;
+	for(auto w : m_moveWeights)
+		total += w;
+
+	double r = m_random.NextUnit() * total;
+	for(uint32_t i=0; i+1 < m_moveWeights.size(); i++)
+	{
+		if(r < m_moveWeights[i])
+			return i;
+		r -= m_moveWeights[i];
+	}
+	return m_moveWeights.size() - 1;
+}
+
+/**
+	@brief Moves each generator's weight towards its acceptance rate at the temperature we just finished
+ */
+void PAREngine::UpdateMoveWeights()
+{
+	bool print = !m_quiet && IsDebugLogging();
+	string summary;
+	for(uint32_t i=0; i<m_moveGenerators.size(); i++)
+	{
+		if(m_moveProposed[i] != 0)
+		{
+			double rate = static_cast<double>(m_moveAccepted[i]) / m_moveProposed[i];
+			double alpha = m_annealOptions.moveWeightSmoothing;
+			m_moveWeights[i] = max(
+				(1 - alpha) * m_moveWeights[i] + alpha * rate,
+				m_annealOptions.moveWeightFloor);
+		}
+
+		if(print)
+		{
+			char tmp[128];
+			snprintf(tmp, sizeof(tmp), "%s%s %u/%u (weight %.3f)",
+				i ? ", " : "", m_moveGenerators[i]->GetName().c_str(),
+				m_moveAccepted[i], m_moveProposed[i], m_moveWeights[i]);
+			summary += tmp;
+		}
+
+		m_moveProposed[i] = 0;
+		m_moveAccepted[i] = 0;
+	}
+
+	if(print)
+		LogDebug("Moves accepted: %s\n", summary.c_str());
+}
+
+/**
+	@brief Checks the current placement for unroutable nets, and prints them if there are any
+
+	@return true if everything can be routed
+ */
+bool PAREngine::CheckRouting()
+{
+	vector<PARGraphEdge*> unroutes;
 	if(0 != ComputeUnroutableCost(unroutes))
 	{
 		LogError("Some nets could not be completely routed!\n");
@@ -128,20 +519,26 @@ bool PAREngine::PlaceAndRoute(map<uint32_t, string> label_names, uint32_t seed)
  */
 uint32_t PAREngine::ComputeAndPrintScore(vector<PARGraphEdge*>& unroutes, uint32_t iteration)
 {
-	uint32_t ucost = ComputeUnroutableCost(unroutes);
-	uint32_t ccost = ComputeCongestionCost();
-	uint32_t tcost = ComputeTimingCost();
-	uint32_t cost = ComputeCost();
+	if(m_verifyIncrementalCost)
+		VerifyCostCache();
+
+	uint32_t ucost = m_unroutableCost;
+	uint32_t ccost = GetCachedCongestionCost();
+	uint32_t tcost = GetCachedTimingCost();
+	uint32_t cost = GetCachedCost();
 
 	unroutes.clear();
-	LogVerbose(
-		"Iteration %d: unroutability %d, congestion %d, timing %d (total cost %d)\n",
-		iteration,
-		ucost,
-		ccost,
-		tcost,
-		cost
-		);
+	if(!m_quiet)
+	{
+		LogVerbose(
+			"Iteration %d: unroutability %d, congestion %d, timing %d (total cost %d)\n",
+			iteration,
+			ucost,
+			ccost,
+			tcost,
+			cost
+			);
+	}
 
 	return cost;
 }
@@ -153,9 +550,10 @@ void PAREngine::PrintUnroutes(vector<PARGraphEdge*>& /*unroutes*/)
 /**
 	@brief Quickly find obviously unroutable designs.
 
-	As of now, we only check for the condition where the netlist has more nodes with a given label than the device.
+	We check that the netlist doesn't have more nodes with a given label than the device, then that there is a legal
+	site for every node at once (taking alternate labels and pinned nodes into account).
  */
-bool PAREngine::SanityCheck(map<uint32_t, string> label_names)
+bool PAREngine::SanityCheck(const PARLabelRegistry& labels)
 {
 	LogVerbose("Initial design feasibility check...\n");
 	LogIndenter li;
@@ -186,19 +584,151 @@ bool PAREngine::SanityCheck(map<uint32_t, string> label_names)
 		{
 			LogError("Design is too big for the device "
 				 "(netlist has %d nodes of type %s, device only has %d)\n",
-				nnet, label_names[label].c_str(), ndev);
+				nnet, labels.GetName(label).c_str(), ndev);
 			return false;
 		}
 	}
 
+	//Counts alone miss conflicts between labels sharing sites, so look for an actual assignment
+	if(!CheckPlacementFeasible(labels))
+		return false;
+
 	//OK
 	return true;
 }
 
+/**
+	@brief Returns the device node a netlist node is constrained to, or NULL if it may go anywhere its label allows.
+
+	Default is no constraints.
+ */
+PARGraphNode* PAREngine::GetPinnedSite(PARGraphNode* /*node*/)
+{
+	return NULL;
+}
+
+/**
+	@brief Checks that every netlist node can be given its own legal site at the same time.
+
+	This is a maximum bipartite matching (Hopcroft-Karp) between netlist nodes and the device nodes matching their
+	labels, with pinned nodes only allowed at their pinned site.
+ */
+bool PAREngine::CheckPlacementFeasible(const PARLabelRegistry& labels)
+{
+	const uint32_t NIL = 0xffffffff;
+	uint32_t nnet = m_netlist->GetNumNodes();
+	uint32_t ndev = m_device->GetNumNodes();
+
+	//Legal sites for each netlist node
+	vector< vector<uint32_t> > sites(nnet);
+	for(uint32_t i=0; i<nnet; i++)
+	{
+		PARGraphNode* node = m_netlist->GetNodeByIndex(i);
+		uint32_t label = node->GetLabel();
+		PARGraphNode* pin = GetPinnedSite(node);
+		if(pin != NULL)
+		{
+			if(pin->MatchesLabel(label))
+				sites[i].push_back(pin->GetIndex());
+			continue;
+		}
+
+		for(uint32_t j=0; j<m_device->GetNumNodesWithLabel(label); j++)
+		{
+			PARGraphNode* site = m_device->GetNodeByLabelAndIndex(label, j);
+			if(IsSiteInNodeRegion(node, site))
+				sites[i].push_back(site->GetIndex());
+		}
+	}
+
+	vector<uint32_t> net_match(nnet, NIL);
+	vector<uint32_t> dev_match(ndev, NIL);
+	vector<uint32_t> dist(nnet);
+
+	//Layer the free netlist nodes and everything reachable from them by alternating paths.
+	//Returns true if any augmenting path exists.
+	auto layer = [&]()
+	{
+		deque<uint32_t> queue;
+		for(uint32_t i=0; i<nnet; i++)
+		{
+			if(net_match[i] == NIL)
+			{
+				dist[i] = 0;
+				queue.push_back(i);
+			}
+			else
+				dist[i] = NIL;
+		}
+
+		bool found = false;
+		while(!queue.empty())
+		{
+			uint32_t i = queue.front();
+			queue.pop_front();
+			for(auto s : sites[i])
+			{
+				uint32_t j = dev_match[s];
+				if(j == NIL)
+					found = true;
+				else if(dist[j] == NIL)
+				{
+					dist[j] = dist[i] + 1;
+					queue.push_back(j);
+				}
+			}
+		}
+		return found;
+	};
+
+	//Follow the layers down from a free netlist node to a free site
+	function<bool(uint32_t)> augment = [&](uint32_t i)
+	{
+		for(auto s : sites[i])
+		{
+			uint32_t j = dev_match[s];
+			if( (j == NIL) || ( (dist[j] == dist[i] + 1) && augment(j) ) )
+			{
+				net_match[i] = s;
+				dev_match[s] = i;
+				return true;
+			}
+		}
+		dist[i] = NIL;
+		return false;
+	};
+
+	uint32_t matched = 0;
+	while(layer())
+	{
+		for(uint32_t i=0; i<nnet; i++)
+		{
+			if( (net_match[i] == NIL) && augment(i) )
+				matched ++;
+		}
+	}
+	if(matched == nnet)
+		return true;
+
+	//Report the first node we couldn't place (which one is somewhat arbitrary, any of the conflicting ones could be)
+	for(uint32_t i=0; i<nnet; i++)
+	{
+		if(net_match[i] != NIL)
+			continue;
+
+		PARGraphNode* node = m_netlist->GetNodeByIndex(i);
+		LogError("Design cannot be placed: only %u of %u nodes can be assigned legal sites at once\n"
+				 "    (at least one node of type %s has no site left; check LOC constraints)\n",
+			matched, nnet, labels.GetName(node->GetLabel()).c_str());
+		break;
+	}
+	return false;
+}
+
 /**
 	@brief Generate an initial placement that is legal, but may or may not be routable
  */
-bool PAREngine::InitialPlacement(map<uint32_t, string>& label_names)
+bool PAREngine::InitialPlacement(const PARLabelRegistry& labels)
 {
 	LogVerbose("Global placement of %d instances into %d sites...\n",
 		m_netlist->GetNumNodes(),
@@ -206,9 +736,10 @@ bool PAREngine::InitialPlacement(map<uint32_t, string>& label_names)
 
 	LogIndenter li;
 
-	LogVerbose("%d nets, %d routing channels available\n",
+	LogVerbose("%d nets, %d dedicated routing channels and %llu general fabric routes available\n",
 		m_netlist->GetNumEdges(),
-		m_device->GetNumEdges());
+		m_device->GetNumEdges(),
+		(unsigned long long)m_device->GetNumFabricEdges());
 
 	//Cache the indexes
 	m_netlist->IndexNodesByLabel();
@@ -227,11 +758,11 @@ bool PAREngine::InitialPlacement(map<uint32_t, string>& label_names)
 
 		if(!mate->MatchesLabel(node->GetLabel()))
 		{
-			std::string node_types = GetNodeTypes(mate, label_names);
+			std::string node_types = GetNodeTypes(mate, labels);
 			LogError(
 				"Found a node during initial placement that was assigned to an illegal site.\n"
 				"    The node is type \"%s\". It was placed in a site valid for types:\n%s",
-				label_names[node->GetLabel()].c_str(),
+				labels.GetName(node->GetLabel()).c_str(),
 				node_types.c_str()
 				);
 			return false;
@@ -242,77 +773,336 @@ bool PAREngine::InitialPlacement(map<uint32_t, string>& label_names)
 }
 
 /**
-	@brief Iteratively refine the placement until we can't get any better.
-
-	Calculate a cost function for the current placement, then optimize
+	@brief Makes a single annealing move: try one of the move generators, and keep the move if the Metropolis
+	criterion accepts it.
 
 	@return True if we made changes to the netlist, false if nothing was done
  */
 bool PAREngine::OptimizePlacement(
 	vector<PARGraphNode*>& badnodes,
-	map<uint32_t, string>& label_names)
+	const PARLabelRegistry& labels)
 {
-	LogIndenter li;
-
-	//Pick one of the nodes at random as our pivot node
-	PARGraphNode* pivot = badnodes[rand() % badnodes.size()];
-
-	//Find a new site for the pivot node (but remember the old site)
-	//If nothing was found, bail out
-	PARGraphNode* old_mate = pivot->GetMate();
-	PARGraphNode* new_mate = GetNewPlacementForNode(pivot);
-	if(new_mate == NULL)
-		return false;
+	uint32_t generator = SelectMoveGenerator();
+	if( (m_batchEvaluator != NULL) && m_moveGenerators[generator]->IsSingleStep() )
+		return OptimizePlacementBatch(badnodes, labels, generator);
 
-	//SANITY CHECK: Make sure the OLD placement was legal (if not, something is seriously wrong)
-	if(!old_mate->MatchesLabel(pivot->GetLabel()))
+	PARMove move;
+	int32_t delta;
+	bool ok;
 	{
-		std::string node_types = GetNodeTypes(old_mate, label_names);
-		LogFatal(
-		        "Found a node during optimization that was assigned to an illegal site.\n"
-			"    Our pivot is a node of type \"%s\". It was placed in a site valid for types:\n%s",
-			label_names[pivot->GetLabel()].c_str(),
-			node_types.c_str()
-			);
+		PARMoveLogTimer timer(m_moveLog, PARMoveLog::PHASE_PROPOSE);
+		ok = ProposeMove(badnodes, labels, move, generator, delta);
 	}
-
-	//If the new site is already occupied, make sure the node we displace can go in our current site.
-	//If not, do nothing as the swap is impossible.
-	//Fixes github issue #9.
-	if(!CanMoveNode(pivot, old_mate, new_mate))
+	m_moveProposed[generator] ++;
+	m_stats.movesProposed ++;
+	if(!ok)
+	{
+		if(m_moveLog != NULL)
+			m_moveLog->Record(generator, PARMoveLog::NO_NODE, PARMoveLog::NO_NODE, 0, false);
 		return false;
+	}
 
-	//Do the swap, and measure the old/new scores
-	uint32_t original_cost = ComputeCost();
-	MoveNode(pivot, new_mate, label_names);
-	uint32_t new_cost = ComputeCost();
-
-	//TODO: say what we swapped?
-
-	//LogVerbose("Original cost %u, new cost %u\n", original_cost, new_cost);
-
-	//If new cost is less, or greater with probability temperature, accept it
-	//TODO: make probability depend on dCost?
-	if(new_cost < original_cost)
-		return true;
-	if( (rand() % 100) < (int)m_temperature )
+	bool accept = AcceptMove(delta);
+	if(m_moveLog != NULL)
+	{
+		m_moveLog->Record(generator, move[0].m_node->GetIndex(), move[0].m_node->GetMate()->GetIndex(), delta,
+			accept);
+	}
+	if(accept)
+	{
+		PARMoveLogTimer timer(m_moveLog, PARMoveLog::PHASE_COMMIT);
+		m_moveAccepted[generator] ++;
+		m_stats.movesAccepted ++;
+		CommitMove(move);
 		return true;
+	}
 
 	//If we don't like the change, revert
-	MoveNode(pivot, old_mate, label_names);
+	PARMoveLogTimer timer(m_moveLog, PARMoveLog::PHASE_REVERT);
+	RevertMove(move, labels);
 	return false;
 }
 
 /**
-	@brief Checks if we can move a node from one location to another
+	@brief Makes one annealing move out of a batch of single-step candidates, evaluated in parallel.
+
+	The candidates are picked here, one after another, so they only depend on the seed. The best one is put through
+	the Metropolis criterion like any other move. If it's kept, any other candidates which still improve the cost once
+	it has been made are applied too, as long as they don't touch the same nodes or their neighbors (moves that close
+	together interact too much for their separate costs to mean anything).
+
+	@return True if we made changes to the netlist, false if nothing was done
  */
-bool PAREngine::CanMoveNode(PARGraphNode* /*node*/, PARGraphNode* old_mate, PARGraphNode* new_mate)
+bool PAREngine::OptimizePlacementBatch(
+	vector<PARGraphNode*>& badnodes,
+	const PARLabelRegistry& labels,
+	uint32_t generator)
 {
-	//Labels don't match? No go
-	PARGraphNode* displaced_node = new_mate->GetMate();
-	if(displaced_node != NULL)
+	PARMoveGenerator* gen = m_moveGenerators[generator];
+	vector<PARCandidateMove> candidates;
+	vector<uint32_t> order;
 	{
-		if(!old_mate->MatchesLabel(displaced_node->GetLabel()))
+		PARMoveLogTimer timer(m_moveLog, PARMoveLog::PHASE_PROPOSE);
+		for(uint32_t i=0; i<m_batchSize; i++)
+		{
+			PARGraphNode* node;
+			PARGraphNode* site;
+			if(gen->ProposeStep(this, badnodes, node, site))
+				candidates.push_back(PARCandidateMove(node, site));
+		}
+		m_moveProposed[generator] ++;
+		m_stats.movesProposed ++;
+
+		if(!candidates.empty())
+		{
+			m_batchEvaluator->Evaluate(candidates);
+			m_stats.costEvaluations += candidates.size();
+		}
+
+		//Sort the legal candidates best first (ties go to the one picked first, so thread timing doesn't matter)
+		for(uint32_t i=0; i<candidates.size(); i++)
+		{
+			if(candidates[i].m_legal)
+				order.push_back(i);
+		}
+		stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b)
+			{ return candidates[a].m_delta < candidates[b].m_delta; });
+	}
+	if(order.empty())
+	{
+		if(m_moveLog != NULL)
+			m_moveLog->Record(generator, PARMoveLog::NO_NODE, PARMoveLog::NO_NODE, 0, false);
+		return false;
+	}
+
+	PARCandidateMove& best = candidates[order[0]];
+	if(!AcceptMove(best.m_delta))
+	{
+		if(m_moveLog != NULL)
+			m_moveLog->Record(generator, best.m_node->GetIndex(), best.m_site->GetIndex(), best.m_delta, false);
+		return false;
+	}
+
+	PARMoveLogTimer timer(m_moveLog, PARMoveLog::PHASE_COMMIT);
+	vector<bool> touched(m_netlist->GetNumNodes(), false);
+	bool made_change = false;
+	for(size_t i=0; i<order.size(); i++)
+	{
+		PARCandidateMove& candidate = candidates[order[i]];
+		if( (i > 0) && (candidate.m_delta >= 0) )
+			break;
+
+		PARGraphNode* displaced = candidate.m_site->GetMate();
+		if(touched[candidate.m_node->GetIndex()] || ( (displaced != NULL) && touched[displaced->GetIndex()] ) )
+			continue;
+
+		//Make the move for real, and see what it costs now
+		PARMove move;
+		uint32_t original_cost = GetCachedCost();
+		m_currentMove = &move;
+		m_currentMoveInvalidated = 0;
+		if(!TryMoveStep(move, candidate.m_node, candidate.m_site, labels))
+		{
+			m_currentMove = NULL;
+			continue;
+		}
+		int32_t delta = static_cast<int32_t>(GetCachedCost()) - static_cast<int32_t>(original_cost);
+
+		//The best candidate was measured on exactly this placement, so should cost exactly what we were told
+		if(i == 0)
+		{
+			if(m_verifyIncrementalCost && (delta != candidate.m_delta))
+			{
+				LogFatal("Batched move evaluation mismatch: replica measured %d, engine measured %d\n",
+					candidate.m_delta, delta);
+			}
+		}
+		else if(delta >= 0)
+		{
+			RevertMove(move, labels);
+			continue;
+		}
+		CommitMove(move);
+		made_change = true;
+
+		//Keep later moves away from this one
+		for(auto& step : move)
+		{
+			touched[step.m_node->GetIndex()] = true;
+			for(auto j : m_nodeEdges[step.m_node->GetIndex()])
+			{
+				touched[m_netlistEdges[j]->m_sourcenode->GetIndex()] = true;
+				touched[m_netlistEdges[j]->m_destnode->GetIndex()] = true;
+			}
+			if(step.m_displaced != NULL)
+			{
+				touched[step.m_displaced->GetIndex()] = true;
+				for(auto j : m_nodeEdges[step.m_displaced->GetIndex()])
+				{
+					touched[m_netlistEdges[j]->m_sourcenode->GetIndex()] = true;
+					touched[m_netlistEdges[j]->m_destnode->GetIndex()] = true;
+				}
+			}
+		}
+	}
+
+	if(made_change)
+	{
+		m_moveAccepted[generator] ++;
+		m_stats.movesAccepted ++;
+	}
+	if(m_moveLog != NULL)
+		m_moveLog->Record(generator, best.m_node->GetIndex(), best.m_site->GetIndex(), best.m_delta, made_change);
+	return made_change;
+}
+
+/**
+	@brief Makes a trial move with one of the generators, and measures the change in cost.
+
+	@return True if a move was made (the caller must either keep it with CommitMove(), or undo it with
+			RevertMove()), false if no legal move was found
+ */
+bool PAREngine::ProposeMove(
+	vector<PARGraphNode*>& badnodes,
+	const PARLabelRegistry& labels,
+	PARMove& move,
+	uint32_t generator,
+	int32_t& delta)
+{
+	uint32_t original_cost = GetCachedCost();
+	m_currentMove = &move;
+	m_currentMoveInvalidated = 0;
+	if(!m_moveGenerators[generator]->ProposeMove(this, badnodes, labels, move) || move.empty())
+	{
+		RevertMove(move, labels);
+		return false;
+	}
+	uint32_t new_cost = GetCachedCost();
+
+	//TODO: say what we swapped?
+
+	delta = static_cast<int32_t>(new_cost) - static_cast<int32_t>(original_cost);
+	m_stats.costEvaluations ++;
+	return true;
+}
+
+/**
+	@brief Moves one node as part of the move being tried, swapping it with whatever is at the new site.
+
+	Only edges touching the moved node or the node it displaces can change cost, so only those are updated.
+
+	@return True if the step was made, false if it's illegal (in which case nothing changes)
+ */
+bool PAREngine::TryMoveStep(
+	PARMove& move,
+	PARGraphNode* node,
+	PARGraphNode* site,
+	const PARLabelRegistry& labels)
+{
+	//SANITY CHECK: Make sure the OLD placement was legal (if not, something is seriously wrong)
+	PARGraphNode* old_mate = node->GetMate();
+	if(!old_mate->MatchesLabel(node->GetLabel()))
+	{
+		std::string node_types = GetNodeTypes(old_mate, labels);
+		LogFatal(
+			"Found a node during optimization that was assigned to an illegal site.\n"
+			"    Our pivot is a node of type \"%s\". It was placed in a site valid for types:\n%s",
+			labels.GetName(node->GetLabel()).c_str(),
+			node_types.c_str()
+			);
+	}
+
+	//If the new site is already occupied, make sure the node we displace can go in our current site.
+	//If not, do nothing as the swap is impossible.
+	//Fixes github issue #9.
+	if(!CanMoveNode(node, old_mate, site))
+		return false;
+
+	PARGraphNode* displaced = site->GetMate();
+	MoveNode(node, site, labels);
+	UpdateCostCache(node, displaced);
+	move.push_back(PARMoveStep(node, old_mate, displaced));
+	return true;
+}
+
+/**
+	@brief Undoes a move made by ProposeMove()
+ */
+void PAREngine::RevertMove(PARMove& move, const PARLabelRegistry& labels)
+{
+	for(size_t i=move.size(); i>0; i--)
+	{
+		PARMoveStep& step = move[i-1];
+		MoveNode(step.m_node, step.m_oldMate, labels);
+		UpdateCostCache(step.m_node, step.m_displaced);
+	}
+
+	//If anything was memoized partway through the move, it's stale now that we're back where we started
+	if(m_currentMoveInvalidated != 0)
+	{
+		for(auto& step : move)
+		{
+			InvalidateNodeSiteCosts(step.m_node);
+			if(step.m_displaced != NULL)
+				InvalidateNodeSiteCosts(step.m_displaced);
+		}
+	}
+
+	m_currentMove = NULL;
+	move.clear();
+}
+
+/**
+	@brief Keeps a move made by ProposeMove()
+ */
+void PAREngine::CommitMove(PARMove& move)
+{
+	FlushMoveInvalidations();
+	m_currentMove = NULL;
+
+	for(auto& step : move)
+		UpdateBadNodeCache(step.m_node, step.m_displaced);
+	if(m_verifyIncrementalCost)
+		VerifyBadNodeCache();
+}
+
+/**
+	@brief Picks a site for a node close to a given device node, for moves which keep connected nodes together.
+
+	The default implementation has no notion of distance, and returns NULL (meaning "no suggestion").
+ */
+PARGraphNode* PAREngine::GetNewPlacementNear(PARGraphNode* /*node*/, PARGraphNode* /*site*/)
+{
+	return NULL;
+}
+
+/**
+	@brief Creates another engine of the same kind, with the same cost model, working on the given graphs (a clone of
+	ours). Used for evaluating moves in parallel.
+
+	Engines which don't support this return NULL (the default).
+ */
+PAREngine* PAREngine::CreateReplica(PARGraph* /*netlist*/, PARGraph* /*device*/)
+{
+	return NULL;
+}
+
+/**
+	@brief Checks if we can move a node from one location to another
+ */
+bool PAREngine::CanMoveNode(PARGraphNode* node, PARGraphNode* old_mate, PARGraphNode* new_mate)
+{
+	//Outside the region we're constrained to? No go
+	if(!IsSiteInNodeRegion(node, new_mate))
+		return false;
+
+	//Labels don't match, or the displaced node can't leave its region? No go
+	PARGraphNode* displaced_node = new_mate->GetMate();
+	if(displaced_node != NULL)
+	{
+		if(!old_mate->MatchesLabel(displaced_node->GetLabel()))
+			return false;
+		if(!IsSiteInNodeRegion(displaced_node, old_mate))
 			return false;
 	}
 
@@ -330,16 +1120,16 @@ bool PAREngine::CanMoveNode(PARGraphNode* /*node*/, PARGraphNode* old_mate, PARG
 void PAREngine::MoveNode(
 	PARGraphNode* node,
 	PARGraphNode* newpos,
-	map<uint32_t, string>& label_names)
+	const PARLabelRegistry& labels)
 {
 	//Verify the labels match
 	if(!newpos->MatchesLabel(node->GetLabel()))
 	{
-		std::string node_types = GetNodeTypes(newpos, label_names);
+		std::string node_types = GetNodeTypes(newpos, labels);
 		LogFatal(
 			"Tried to assign node to illegal site (forward direction).\n"
 			"    We attempted to move a node of type \"%s\". The target site is valid for types:\n%s",
-			label_names[node->GetLabel()].c_str(),
+			labels.GetName(node->GetLabel()).c_str(),
 			node_types.c_str()
 			);
 	}
@@ -353,12 +1143,12 @@ void PAREngine::MoveNode(
 		//Verify the labels match in the reverse direction of the swap
 		if(!old_pos->MatchesLabel(other_net->GetLabel()))
 		{
-			std::string node_types = GetNodeTypes(old_pos, label_names);
+			std::string node_types = GetNodeTypes(old_pos, labels);
 			LogFatal(
 				"Tried to assign node to illegal site (reverse direction).\n"
 				"    We attempted to move a node of type \"%s\". "
 				"The target site is valid for types:\n%s",
-				label_names[other_net->GetLabel()].c_str(),
+				labels.GetName(other_net->GetLabel()).c_str(),
 				node_types.c_str()
 				);
 		}
@@ -373,12 +1163,12 @@ void PAREngine::MoveNode(
 /**
 	@brief Serializes all of the types of a given node for debugging
  */
-std::string PAREngine::GetNodeTypes(PARGraphNode* node, std::map<uint32_t, std::string>& label_names)
+std::string PAREngine::GetNodeTypes(PARGraphNode* node, const PARLabelRegistry& labels)
 {
 	std::string ret;
-	ret += "    * " + label_names[node->GetLabel()] + "\n";
+	ret += "    * " + labels.GetName(node->GetLabel()) + "\n";
 	for(uint32_t i=0; i<node->GetAlternateLabelCount(); i++)
-		ret += "    * " + label_names[node->GetAlternateLabel(i)] + "\n";
+		ret += "    * " + labels.GetName(node->GetAlternateLabel(i)) + "\n";
 	return ret;
 }
 
@@ -387,9 +1177,8 @@ std::string PAREngine::GetNodeTypes(PARGraphNode* node, std::map<uint32_t, std::
  */
 uint32_t PAREngine::ComputeCost()
 {
-	vector<PARGraphEdge*> unroutes;
 	return
-		ComputeUnroutableCost(unroutes)*10 +	//weight unroutability above everything else
+		CountUnroutableEdges()*10 +	//weight unroutability above everything else
 		ComputeTimingCost() +
 		ComputeCongestionCost();
 }
@@ -399,54 +1188,173 @@ uint32_t PAREngine::ComputeCost()
  */
 uint32_t PAREngine::ComputeUnroutableCost(vector<PARGraphEdge*>& unroutes)
 {
-	uint32_t cost = 0;
-
 	//Loop over each edge in the source netlist and try to find a matching edge in the destination.
 	//No checks for multiple signals in one place for now.
+	uint32_t threads = GetCostThreadCount(m_netlist->GetNumEdges());
+	vector< vector<PARGraphEdge*> > chunk_unroutes(threads);
+	ParallelFor(m_netlist->GetNumNodes(), threads, [&](uint32_t chunk, uint32_t first, uint32_t last)
+	{
+		for(uint32_t i=first; i<last; i++)
+		{
+			PARGraphNode* netsrc = m_netlist->GetNodeByIndex(i);
+			for(uint32_t j=0; j<netsrc->GetEdgeCount(); j++)
+			{
+				PARGraphEdge* nedge = netsrc->GetEdgeByIndex(j);
+				PARGraphNode* netdst = nedge->m_destnode;
+				if(nedge->m_free)
+					continue;
+
+				//If nothing found, add to list
+				if(!IsEdgeRoutable(nedge, netsrc->GetMate(), netdst->GetMate()))
+					chunk_unroutes[chunk].push_back(nedge);
+			}
+		}
+	});
+
+	//Chunks are in node order, so the list comes out the same as from a single pass
+	uint32_t cost = 0;
+	for(auto& c : chunk_unroutes)
+	{
+		unroutes.insert(unroutes.end(), c.begin(), c.end());
+		cost += c.size();
+	}
+	return cost;
+}
+
+/**
+	@brief Counts the unroutable netlist edges under the current placement, without listing them.
+
+	If the device has adjacency matrices (see PARGraph::BuildAdjacency()), all edges from the same source port to the
+	same kind of destination port are checked together, with one AND and popcount per row word. Otherwise this is the
+	same as ComputeUnroutableCost().
+ */
+uint32_t PAREngine::CountUnroutableEdges()
+{
+	const PARAdjacency* adjacency = m_device->GetAdjacency();
+	if(adjacency == NULL)
+	{
+		vector<PARGraphEdge*> unroutes;
+		return ComputeUnroutableCost(unroutes);
+	}
+
+	if(m_edgeGroupStarts.empty())
+		BuildEdgeGroups();
+	m_adjacencyScratch.resize(adjacency->GetRowWords(), 0);
+	uint64_t* dests = &m_adjacencyScratch[0];
+
+	uint32_t cost = 0;
+	for(size_t g=0; g+1 < m_edgeGroupStarts.size(); g++)
+	{
+		uint32_t begin = m_edgeGroupStarts[g];
+		uint32_t end = m_edgeGroupStarts[g+1];
+		PARGraphEdge* first = m_groupedEdges[begin];
+		uint32_t source = first->m_sourcenode->GetMate()->GetIndex();
+		uint16_t srcport = first->m_sourceport;
+		uint16_t dstport = first->m_destport;
+
+		//Collect the destinations. Parallel edges to the same destination only get one bit, so check the extras
+		//one at a time.
+		uint32_t count = 0;
+		for(uint32_t i=begin; i<end; i++)
+		{
+			uint32_t dest = m_groupedEdges[i]->m_destnode->GetMate()->GetIndex();
+			if(PARAdjacency::TestBit(dests, dest))
+			{
+				if(!adjacency->IsRoutable(source, srcport, dest, dstport))
+					cost ++;
+			}
+			else
+			{
+				PARAdjacency::SetBit(dests, dest);
+				count ++;
+			}
+		}
+
+		cost += count - adjacency->CountRoutable(source, srcport, dstport, dests);
+
+		for(uint32_t i=begin; i<end; i++)
+			PARAdjacency::ClearBit(dests, m_groupedEdges[i]->m_destnode->GetMate()->GetIndex());
+	}
+
+	return cost;
+}
+
+/**
+	@brief Sorts the netlist edges into groups with the same source node, source port and destination port, for
+	CountUnroutableEdges()
+ */
+void PAREngine::BuildEdgeGroups()
+{
+	m_groupedEdges.clear();
+	m_edgeGroupStarts.clear();
+
 	for(uint32_t i=0; i<m_netlist->GetNumNodes(); i++)
 	{
 		PARGraphNode* netsrc = m_netlist->GetNodeByIndex(i);
+		size_t first = m_groupedEdges.size();
 		for(uint32_t j=0; j<netsrc->GetEdgeCount(); j++)
 		{
 			PARGraphEdge* nedge = netsrc->GetEdgeByIndex(j);
-			PARGraphNode* netdst = nedge->m_destnode;
+			if(!nedge->m_free)
+				m_groupedEdges.push_back(nedge);
+		}
 
-			//For now, just bruteforce to find a matching edge (if there is one)
-			bool found = false;
-			PARGraphNode* devsrc = netsrc->GetMate();
-			PARGraphNode* devdst = netdst->GetMate();
-			for(uint32_t k=0; k<devsrc->GetEdgeCount(); k++)
+		sort(m_groupedEdges.begin() + first, m_groupedEdges.end(),
+			[](PARGraphEdge* a, PARGraphEdge* b)
 			{
-				PARGraphEdge* dedge = devsrc->GetEdgeByIndex(k);
-				if(
-					(dedge->m_destnode == devdst) &&
-					(dedge->m_sourceport == nedge->m_sourceport) &&
-					(dedge->m_destport == nedge->m_destport)
-					)
-				{
-
-					found = true;
-					break;
-				}
-			}
+				if(a->m_sourceport != b->m_sourceport)
+					return a->m_sourceport < b->m_sourceport;
+				return a->m_destport < b->m_destport;
+			});
 
-			//If nothing found, add to list
-			if(!found)
-			{
-				unroutes.push_back(nedge);
-				cost ++;
-			}
+		for(size_t j=first; j<m_groupedEdges.size(); j++)
+		{
+			PARGraphEdge* prev = (j == first) ? NULL : m_groupedEdges[j-1];
+			PARGraphEdge* edge = m_groupedEdges[j];
+			if( (prev == NULL) || (prev->m_sourceport != edge->m_sourceport) || (prev->m_destport != edge->m_destport) )
+				m_edgeGroupStarts.push_back(j);
 		}
 	}
+	m_edgeGroupStarts.push_back(m_groupedEdges.size());
+}
 
-	return cost;
+/**
+	@brief Checks if a netlist edge can be routed between two device nodes
+ */
+bool PAREngine::IsEdgeRoutable(PARGraphEdge* nedge, PARGraphNode* devsrc, PARGraphNode* devdst)
+{
+	return m_device->HasEdge(devsrc, nedge->m_sourceport, devdst, nedge->m_destport);
 }
 
 /**
-	@brief Compute the unroutability cost for a single node and a candidate placement for it
+	@brief Compute the unroutability cost for a single node and a candidate placement for it.
+
+	Once the cost cache is set up, results are memoized until one of the pivot's neighbors moves.
  */
 uint32_t PAREngine::ComputeNodeUnroutableCost(PARGraphNode* pivot, PARGraphNode* candidate)
 {
+	if(!m_netlistEdges.empty())
+	{
+		FlushMoveInvalidations();
+
+		size_t slot = static_cast<size_t>(pivot->GetIndex()) * m_device->GetNumNodes() + candidate->GetIndex();
+		uint32_t generation = m_nodeGeneration[pivot->GetIndex()];
+		bool hit = (m_nodeSiteGeneration[slot] == generation);
+		if(hit && !m_verifyIncrementalCost)
+			return m_nodeSiteCost[slot];
+
+		uint32_t cost = ComputeNodeUnroutableCostFromEdges(pivot, candidate);
+		if(hit && (cost != m_nodeSiteCost[slot]))
+		{
+			LogFatal("Node/site cost cache mismatch: node %u at site %u cached as %u, should be %u\n",
+				pivot->GetIndex(), candidate->GetIndex(), m_nodeSiteCost[slot], cost);
+		}
+
+		m_nodeSiteCost[slot] = cost;
+		m_nodeSiteGeneration[slot] = generation;
+		return cost;
+	}
+
 	uint32_t cost = 0;
 
 	//Loop over each edge in the source netlist and try to find a matching edge in the destination.
@@ -462,6 +1370,8 @@ uint32_t PAREngine::ComputeNodeUnroutableCost(PARGraphNode* pivot, PARGraphNode*
 			//If either the source or destination is not our pivot node, ignore it
 			if( (netsrc != pivot) && (netdst != pivot) )
 				continue;
+			if(nedge->m_free)
+				continue;
 
 			//Find the hypothetical source/dest pair
 			PARGraphNode* devsrc = netsrc->GetMate();
@@ -471,25 +1381,8 @@ uint32_t PAREngine::ComputeNodeUnroutableCost(PARGraphNode* pivot, PARGraphNode*
 			else
 				devdst = candidate;
 
-			//For now, just bruteforce to find a matching edge (if there is one)
-			bool found = false;
-			for(uint32_t k=0; k<devsrc->GetEdgeCount(); k++)
-			{
-				PARGraphEdge* dedge = devsrc->GetEdgeByIndex(k);
-				if(
-					(dedge->m_destnode == devdst) &&
-					(dedge->m_sourceport == nedge->m_sourceport) &&
-					(dedge->m_destport == nedge->m_destport)
-					)
-				{
-
-					found = true;
-					break;
-				}
-			}
-
 			//If nothing found, add to cost
-			if(!found)
+			if(!IsEdgeRoutable(nedge, devsrc, devdst))
 				cost ++;
 
 		}
@@ -498,22 +1391,871 @@ uint32_t PAREngine::ComputeNodeUnroutableCost(PARGraphNode* pivot, PARGraphNode*
 	return cost;
 }
 
+/**
+	@brief Compute the unroutability cost for a single node and a candidate placement for it, using the cost cache's
+	per-node edge lists
+ */
+uint32_t PAREngine::ComputeNodeUnroutableCostFromEdges(PARGraphNode* pivot, PARGraphNode* candidate)
+{
+	uint32_t cost = 0;
+	for(auto i : m_nodeEdges[pivot->GetIndex()])
+	{
+		PARGraphEdge* nedge = m_netlistEdges[i];
+		PARGraphNode* devsrc = nedge->m_sourcenode->GetMate();
+		PARGraphNode* devdst = nedge->m_destnode->GetMate();
+		if(nedge->m_sourcenode == pivot)
+			devsrc = candidate;
+		else
+			devdst = candidate;
+
+		if(!IsEdgeRoutable(nedge, devsrc, devdst))
+			cost ++;
+	}
+	return cost;
+}
+
+/**
+	@brief Invalidates the memoized node/site costs around every step of the current move made since last time.
+
+	Single-step moves never read memoized costs between moving and being kept or undone, so as long as nothing is
+	read partway through a move, an undone move costs no invalidation at all. Multi-step moves call this (through
+	ComputeNodeUnroutableCost()) before looking for the next step's site.
+ */
+void PAREngine::FlushMoveInvalidations()
+{
+	if(m_currentMove == NULL)
+		return;
+
+	for(; m_currentMoveInvalidated < m_currentMove->size(); m_currentMoveInvalidated++)
+	{
+		PARMoveStep& step = (*m_currentMove)[m_currentMoveInvalidated];
+		InvalidateNodeSiteCosts(step.m_node);
+		if(step.m_displaced != NULL)
+			InvalidateNodeSiteCosts(step.m_displaced);
+	}
+}
+
+/**
+	@brief Invalidates the memoized node/site costs of every neighbor of a node which just moved
+ */
+void PAREngine::InvalidateNodeSiteCosts(PARGraphNode* moved)
+{
+	for(auto i : m_nodeEdges[moved->GetIndex()])
+	{
+		PARGraphEdge* nedge = m_netlistEdges[i];
+		PARGraphNode* other = (nedge->m_sourcenode == moved) ? nedge->m_destnode : nedge->m_sourcenode;
+		m_nodeGeneration[other->GetIndex()] ++;
+	}
+}
+
 /**
 	@brief Computes the timing cost (measure of how much the current placement fails timing constraints).
 
-	Default is zero (no timing analysis performed).
+	This is a full recompute from scratch; the optimizer normally uses the cached arrival times instead.
+	Zero if there is no timing target.
  */
 uint32_t PAREngine::ComputeTimingCost()
 {
-	return 0;
+	if(m_timingTarget == 0)
+		return 0;
+	return ComputeTimingCostFromDelay(ComputeCriticalPathDelay());
 }
 
 /**
 	@brief Computes the congestion cost (measure of how many routes are simultaneously occupied by multiple signals)
 
-	Default is zero (no congestion analysis performed)
+	This is a full recompute from scratch; the optimizer normally uses the cached bins instead.
  */
 uint32_t PAREngine::ComputeCongestionCost()
 {
-	return 0;
+	uint32_t nbins = GetCongestionBinCount();
+	uint32_t nnets = m_netlist->GetNumNets();
+
+	//Each chunk of nodes counts its unshared edges, and lists the (bin, net) pairs its shared ones use
+	uint32_t threads = GetCostThreadCount(m_netlist->GetNumEdges());
+	vector< vector<uint32_t> > chunk_bins(threads, vector<uint32_t>(nbins, 0));
+	vector< vector<size_t> > chunk_refs(threads);
+	ParallelFor(m_netlist->GetNumNodes(), threads, [&](uint32_t chunk, uint32_t first, uint32_t last)
+	{
+		for(uint32_t i=first; i<last; i++)
+		{
+			PARGraphNode* netsrc = m_netlist->GetNodeByIndex(i);
+			for(uint32_t j=0; j<netsrc->GetEdgeCount(); j++)
+			{
+				PARGraphEdge* nedge = netsrc->GetEdgeByIndex(j);
+				if(nedge->m_free)
+					continue;
+				int32_t bin = GetEdgeCongestionBin(nedge);
+				if(bin < 0)
+					continue;
+
+				uint32_t net = GetEdgeCongestionNet(nedge);
+				if(net >= nnets)
+					chunk_bins[chunk][bin] ++;
+				else
+					chunk_refs[chunk].push_back(static_cast<size_t>(bin)*nnets + net);
+			}
+		}
+	});
+
+	//then each pair is counted once, no matter how many chunks it came up in
+	vector<uint32_t> bins(nbins, 0);
+	vector<bool> seen(static_cast<size_t>(nbins) * nnets, false);
+	for(uint32_t c=0; c<threads; c++)
+	{
+		for(uint32_t b=0; b<nbins; b++)
+			bins[b] += chunk_bins[c][b];
+		for(auto ref : chunk_refs[c])
+		{
+			if(!seen[ref])
+			{
+				seen[ref] = true;
+				bins[ref / nnets] ++;
+			}
+		}
+	}
+
+	return ComputeCongestionCostFromBins(bins);
+}
+
+/**
+	@brief Decides how many threads to split a full recompute over
+
+	@param edges	Number of netlist edges the recompute looks at
+ */
+uint32_t PAREngine::GetCostThreadCount(size_t edges)
+{
+	uint32_t threads = m_costThreads ? m_costThreads : thread::hardware_concurrency();
+
+	//Starting a thread costs about as much as checking a few thousand edges, so don't bother for small netlists
+	size_t useful = edges / PARALLEL_COST_EDGES;
+	return max(static_cast<uint32_t>(min(static_cast<size_t>(threads), useful)), 1u);
+}
+
+/**
+	@brief Splits [0, count) into one contiguous chunk per thread, in order, and runs body(chunk, first, last) on
+	each at the same time.
+
+	With one thread, the body is just called on the calling thread.
+ */
+void PAREngine::ParallelFor(
+	uint32_t count,
+	uint32_t threads,
+	const function<void(uint32_t, uint32_t, uint32_t)>& body)
+{
+	if(threads <= 1)
+	{
+		body(0, 0, count);
+		return;
+	}
+
+	vector<thread> workers;
+	for(uint32_t i=0; i<threads; i++)
+	{
+		uint32_t first = static_cast<uint64_t>(count) * i / threads;
+		uint32_t last = static_cast<uint64_t>(count) * (i + 1) / threads;
+		workers.push_back(thread(body, i, first, last));
+	}
+	for(auto& t : workers)
+		t.join();
+}
+
+/**
+	@brief Returns the number of congestion bins used by this engine.
+
+	Default is zero (no congestion analysis performed)
+ */
+uint32_t PAREngine::GetCongestionBinCount()
+{
+	return 0;
+}
+
+/**
+	@brief Returns the congestion bin a netlist edge falls into under the current placement, or -1 if none.
+
+	Must depend only on the placement of the edge's own source and destination nodes.
+ */
+int32_t PAREngine::GetEdgeCongestionBin(PARGraphEdge* /*edge*/)
+{
+	return -1;
+}
+
+/**
+	@brief Returns the netlist net (PARGraphEdge::m_net) a netlist edge carries, or UNSHARED_NET.
+
+	Edges in the same congestion bin carrying the same net share a single routing resource, so they only count once.
+	Anything that isn't a net index of the frozen netlist is treated as UNSHARED_NET. Default is UNSHARED_NET (every
+	edge counts separately).
+ */
+uint32_t PAREngine::GetEdgeCongestionNet(PARGraphEdge* /*edge*/)
+{
+	return UNSHARED_NET;
+}
+
+/**
+	@brief Converts per-bin usage counts into a congestion cost
+ */
+uint32_t PAREngine::ComputeCongestionCostFromBins(const vector<uint32_t>& /*bins*/)
+{
+	return 0;
+}
+
+/**
+	@brief Returns the number of routing resources in a congestion bin.
+
+	Only used by PlaceExactly(), which rejects any placement needing more. Default is unlimited.
+ */
+uint32_t PAREngine::GetCongestionBinCapacity(uint32_t /*bin*/)
+{
+	return 0xffffffff;
+}
+
+/**
+	@brief Returns the number of regions the device is divided into.
+
+	Default is one (the whole device).
+ */
+uint32_t PAREngine::GetRegionCount()
+{
+	return 1;
+}
+
+/**
+	@brief Returns the region (less than GetRegionCount()) a device site is in
+ */
+uint32_t PAREngine::GetSiteRegion(PARGraphNode* /*site*/)
+{
+	return 0;
+}
+
+/**
+	@brief Returns the region a netlist node is constrained to, or ANY_REGION if it may go in any of them.
+
+	Default is no constraints.
+ */
+int32_t PAREngine::GetNodeRegion(PARGraphNode* /*node*/)
+{
+	return ANY_REGION;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Placement snapshots
+
+/**
+	@brief Saves the current placement so it can be put back later with RestorePlacement()
+ */
+void PAREngine::SavePlacement(vector<uint16_t>& placement)
+{
+	m_netlist->SavePlacement(placement);
+}
+
+/**
+	@brief Restores a placement saved by SavePlacement(), and brings the cost cache back in sync with it
+ */
+void PAREngine::RestorePlacement(const vector<uint16_t>& placement)
+{
+	m_netlist->RestorePlacement(placement, m_device);
+	if(!m_netlistEdges.empty())
+		InitCostCache();
+}
+
+/**
+	@brief Changes the placement to match one saved from another engine working on a clone of our graphs, updating the
+	cost cache for just the nodes which moved.
+ */
+void PAREngine::SyncPlacement(const vector<uint16_t>& placement)
+{
+	//Find out who moved
+	vector<PARGraphNode*> moved;
+	const vector<uint16_t>& mates = m_netlist->GetMateArray();
+	for(uint32_t i=0; i<mates.size(); i++)
+	{
+		if(mates[i] != placement[i])
+			moved.push_back(m_netlist->GetNodeByIndex(i));
+	}
+	if(moved.empty())
+		return;
+
+	//If most of the design moved (say, after a restart) it's cheaper to start over
+	m_netlist->RestorePlacement(placement, m_device);
+	if(moved.size() > mates.size() / 4)
+	{
+		InitCostCache();
+		return;
+	}
+
+	//The cache is inconsistent until every moved node has been updated, so only check it at the end
+	bool verify = m_verifyIncrementalCost;
+	m_verifyIncrementalCost = false;
+	for(auto node : moved)
+	{
+		InvalidateNodeSiteCosts(node);
+		UpdateCostCache(node, NULL);
+		UpdateBadNodeCache(node, NULL);
+	}
+	m_verifyIncrementalCost = verify;
+	if(verify)
+		VerifyCostCache();
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Incremental cost evaluation
+
+/**
+	@brief Builds the edge tables and computes the per-edge cost of the current placement from scratch.
+
+	Must be called after the netlist has been fully placed, and again if the netlist graph is modified.
+ */
+void PAREngine::InitCostCache()
+{
+	m_netlistEdges.clear();
+	m_nodeEdges.assign(m_netlist->GetNumNodes(), vector<uint32_t>());
+	for(uint32_t i=0; i<m_netlist->GetNumNodes(); i++)
+	{
+		PARGraphNode* netsrc = m_netlist->GetNodeByIndex(i);
+		for(uint32_t j=0; j<netsrc->GetEdgeCount(); j++)
+		{
+			PARGraphEdge* nedge = netsrc->GetEdgeByIndex(j);
+			if(nedge->m_free)
+				continue;
+			uint32_t index = m_netlistEdges.size();
+			m_netlistEdges.push_back(nedge);
+
+			m_nodeEdges[i].push_back(index);
+			if(nedge->m_destnode != netsrc)
+				m_nodeEdges[nedge->m_destnode->GetIndex()].push_back(index);
+		}
+	}
+
+	m_edgeUnroutable.assign(m_netlistEdges.size(), false);
+	m_edgeCongestionBin.assign(m_netlistEdges.size(), -1);
+	m_edgeCongestionNet.assign(m_netlistEdges.size(), UNSHARED_NET);
+	m_congestionBins.assign(GetCongestionBinCount(), 0);
+	m_congestionNetRefs.assign(static_cast<size_t>(GetCongestionBinCount()) * m_netlist->GetNumNets(), 0);
+	m_unroutableCost = 0;
+
+	//Generation zero is never current, so every memoized node/site cost starts out invalid
+	m_nodeGeneration.assign(m_netlist->GetNumNodes(), 1);
+	m_nodeSiteCost.assign(static_cast<size_t>(m_netlist->GetNumNodes()) * m_device->GetNumNodes(), 0);
+	m_nodeSiteGeneration.assign(m_nodeSiteCost.size(), 0);
+
+	//Work out the cost of every edge (split across threads for big netlists), then add them up in edge order
+	uint32_t nedges = m_netlistEdges.size();
+	uint32_t threads = GetCostThreadCount(nedges);
+	if(threads <= 1)
+	{
+		for(uint32_t i=0; i<nedges; i++)
+			UpdateEdgeCost(i);
+	}
+	else
+	{
+		vector<uint8_t> unroutable(nedges);
+		vector<int32_t> bins(nedges);
+		vector<uint32_t> nets(nedges);
+		ParallelFor(nedges, threads, [&](uint32_t /*chunk*/, uint32_t first, uint32_t last)
+		{
+			for(uint32_t i=first; i<last; i++)
+			{
+				bool u;
+				ComputeEdgeCost(m_netlistEdges[i], u, bins[i], nets[i]);
+				unroutable[i] = u;
+			}
+		});
+		for(uint32_t i=0; i<nedges; i++)
+			SetEdgeCost(i, unroutable[i], bins[i], nets[i]);
+	}
+
+	InitTimingCache();
+	InitBadNodeCache();
+}
+
+/**
+	@brief Rebuilds any cached state used by FindSubOptimalPlacements() from the current placement.
+
+	Called at the end of InitCostCache(), so the per-edge cost tables are already valid. Default does nothing.
+ */
+void PAREngine::InitBadNodeCache()
+{
+}
+
+/**
+	@brief Updates cached state used by FindSubOptimalPlacements() after an accepted move of a and b (either may be
+	NULL).
+
+	Called after UpdateCostCache(), so the per-edge cost tables are already valid. Rejected moves are reverted before
+	this would be called, so they never reach it. Default does nothing.
+ */
+void PAREngine::UpdateBadNodeCache(PARGraphNode* /*a*/, PARGraphNode* /*b*/)
+{
+}
+
+/**
+	@brief Checks the state kept by UpdateBadNodeCache() against the current placement (for --verify-cost).
+
+	Only called once every step of a move has been applied, since the cache can't be consistent in between. Default
+	does nothing.
+ */
+void PAREngine::VerifyBadNodeCache()
+{
+}
+
+/**
+	@brief Recomputes the cached cost of every edge touching either of two netlist nodes (either may be NULL).
+
+	Call after swapping the placement of a and b, or moving a alone.
+ */
+void PAREngine::UpdateCostCache(PARGraphNode* a, PARGraphNode* b)
+{
+	//An edge between a and b gets updated twice, which is harmless
+	if(a != NULL)
+		UpdateNodeEdgeCosts(a);
+	if( (b != NULL) && (b != a) )
+		UpdateNodeEdgeCosts(b);
+	UpdateTimingCache(a, b);
+
+	if(m_verifyIncrementalCost)
+		VerifyCostCache();
+}
+
+/**
+	@brief Recomputes the cached cost of every edge touching a netlist node.
+
+	This is the innermost loop of the optimizer. Engines which can evaluate their cost hooks without virtual calls
+	override it (see PARModelEngine).
+ */
+void PAREngine::UpdateNodeEdgeCosts(PARGraphNode* node)
+{
+	for(auto i : m_nodeEdges[node->GetIndex()])
+		UpdateEdgeCost(i);
+}
+
+/**
+	@brief Removes the cached contribution of a single edge, then re-adds it based on the current placement
+ */
+void PAREngine::UpdateEdgeCost(uint32_t index)
+{
+	bool unroutable;
+	int32_t bin;
+	uint32_t net;
+	ComputeEdgeCost(m_netlistEdges[index], unroutable, bin, net);
+	SetEdgeCost(index, unroutable, bin, net);
+}
+
+/**
+	@brief Works out a single edge's cost contribution under the current placement, without touching the cache
+ */
+void PAREngine::ComputeEdgeCost(PARGraphEdge* nedge, bool& unroutable, int32_t& bin, uint32_t& net)
+{
+	unroutable = !IsEdgeRoutable(nedge, nedge->m_sourcenode->GetMate(), nedge->m_destnode->GetMate());
+	bin = GetEdgeCongestionBin(nedge);
+	net = (bin >= 0) ? GetEdgeCongestionNet(nedge) : UNSHARED_NET;
+}
+
+/**
+	@brief Replaces the cached contribution of a single edge with a new one
+ */
+void PAREngine::SetEdgeCost(uint32_t index, bool unroutable, int32_t bin, uint32_t net)
+{
+	//Remove the old contribution
+	if(m_edgeUnroutable[index])
+		m_unroutableCost --;
+	if(m_edgeCongestionBin[index] >= 0)
+		RemoveCongestionUse(m_edgeCongestionBin[index], m_edgeCongestionNet[index]);
+
+	//Add the new one
+	m_edgeUnroutable[index] = unroutable;
+	m_edgeCongestionBin[index] = bin;
+	if(unroutable)
+		m_unroutableCost ++;
+	if(bin >= 0)
+	{
+		m_edgeCongestionNet[index] = net;
+		AddCongestionUse(bin, net);
+	}
+}
+
+/**
+	@brief Adds one edge's use of a congestion bin (only counted if no other edge carries the same net through it)
+ */
+void PAREngine::AddCongestionUse(uint32_t bin, uint32_t net)
+{
+	uint32_t nnets = m_netlist->GetNumNets();
+	if( (net >= nnets) || (m_congestionNetRefs[static_cast<size_t>(bin)*nnets + net] ++ == 0) )
+		m_congestionBins[bin] ++;
+}
+
+/**
+	@brief Removes one edge's use of a congestion bin
+ */
+void PAREngine::RemoveCongestionUse(uint32_t bin, uint32_t net)
+{
+	uint32_t nnets = m_netlist->GetNumNets();
+	if( (net < nnets) && (-- m_congestionNetRefs[static_cast<size_t>(bin)*nnets + net] != 0) )
+		return;
+	m_congestionBins[bin] --;
+}
+
+/**
+	@brief Returns the cost of the current placement using the cached per-edge contributions.
+
+	Same weighting as ComputeCost().
+ */
+uint32_t PAREngine::GetCachedCost()
+{
+	return
+		m_unroutableCost*10 +
+		GetCachedTimingCost() +
+		GetCachedCongestionCost();
+}
+
+/**
+	@brief Checks the cached cost against a full recompute and aborts if they disagree
+ */
+void PAREngine::VerifyCostCache()
+{
+	uint32_t cached = GetCachedCost();
+	uint32_t full = ComputeCost();
+	if(cached != full)
+	{
+		LogFatal("Incremental cost is out of sync with full recompute (cached %u, actual %u)\n",
+			cached, full);
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Timing analysis
+
+/**
+	@brief Returns the delay through a netlist node at its current site, from its inputs (or its clock, if it's a
+	timing boundary) to its outputs.
+
+	Default is zero (no timing analysis performed).
+ */
+uint32_t PAREngine::GetNodeDelay(PARGraphNode* /*node*/)
+{
+	return 0;
+}
+
+/**
+	@brief Returns the routing delay of a netlist edge under the current placement.
+
+	Must depend only on the placement of the edge's own source and destination nodes. Default is zero.
+ */
+uint32_t PAREngine::GetEdgeDelay(PARGraphEdge* /*edge*/)
+{
+	return 0;
+}
+
+/**
+	@brief Returns true if timing paths end at a netlist node's inputs and start over at its outputs (i.e. it's a
+	register).
+
+	Must not depend on placement. Default is false.
+ */
+bool PAREngine::IsTimingBoundary(PARGraphNode* /*node*/)
+{
+	return false;
+}
+
+/**
+	@brief Returns false if a netlist edge is not part of any timing path (for example, a clock or a constant).
+
+	Must not depend on placement. Default is true.
+ */
+bool PAREngine::IsTimingEdge(PARGraphEdge* /*edge*/)
+{
+	return true;
+}
+
+/**
+	@brief Sorts the netlist nodes so every timed edge between combinational nodes goes forward.
+
+	This is the reverse postorder of a depth-first search over the timing edges into non-boundary nodes. Any edge which
+	goes backwards closes a combinational loop, and is left out of the timing graph (see IsTimedEdge()) since there is
+	no meaningful longest path through it. Node and edge order are fixed, so the result is deterministic.
+
+	@param rank		Filled with the position of each netlist node (by index) in the order
+	@param boundary	Filled with IsTimingBoundary() of each netlist node
+ */
+void PAREngine::ComputeTimingOrder(vector<uint32_t>& rank, vector<bool>& boundary)
+{
+	uint32_t nnodes = m_netlist->GetNumNodes();
+	boundary.assign(nnodes, false);
+	for(uint32_t i=0; i<nnodes; i++)
+		boundary[i] = IsTimingBoundary(m_netlist->GetNodeByIndex(i));
+
+	//Iterative DFS, each stack entry is a node and the index of the next edge to look at
+	vector<bool> visited(nnodes, false);
+	vector<uint32_t> postorder;
+	vector< pair<uint32_t, uint32_t> > stack;
+	for(uint32_t root=0; root<nnodes; root++)
+	{
+		if(visited[root])
+			continue;
+		visited[root] = true;
+		stack.push_back(pair<uint32_t, uint32_t>(root, 0));
+
+		while(!stack.empty())
+		{
+			uint32_t i = stack.back().first;
+			PARGraphNode* node = m_netlist->GetNodeByIndex(i);
+			if(stack.back().second < node->GetEdgeCount())
+			{
+				PARGraphEdge* edge = node->GetEdgeByIndex(stack.back().second ++);
+				uint32_t k = edge->m_destnode->GetIndex();
+				if(!visited[k] && !boundary[k] && !edge->m_free && IsTimingEdge(edge))
+				{
+					visited[k] = true;
+					stack.push_back(pair<uint32_t, uint32_t>(k, 0));
+				}
+				continue;
+			}
+
+			postorder.push_back(i);
+			stack.pop_back();
+		}
+	}
+
+	rank.assign(nnodes, 0);
+	for(uint32_t i=0; i<nnodes; i++)
+		rank[postorder[i]] = nnodes - 1 - i;
+}
+
+/**
+	@brief Returns true if a netlist edge is part of the timing graph, given the order from ComputeTimingOrder()
+ */
+bool PAREngine::IsTimedEdge(PARGraphEdge* edge, const vector<uint32_t>& rank, const vector<bool>& boundary)
+{
+	uint32_t src = edge->m_sourcenode->GetIndex();
+	uint32_t dst = edge->m_destnode->GetIndex();
+	if(edge->m_free || (!boundary[dst] && (rank[src] >= rank[dst])))
+		return false;
+	return IsTimingEdge(edge);
+}
+
+/**
+	@brief Computes the longest path delay of the current placement from scratch
+ */
+uint32_t PAREngine::ComputeCriticalPathDelay()
+{
+	vector<uint32_t> rank;
+	vector<bool> boundary;
+	ComputeTimingOrder(rank, boundary);
+
+	uint32_t nnodes = m_netlist->GetNumNodes();
+	vector<uint32_t> order(nnodes);
+	for(uint32_t i=0; i<nnodes; i++)
+		order[rank[i]] = i;
+
+	//Push arrival times forward in topological order. Boundaries can be fed from anywhere, but their outputs don't
+	//depend on their inputs, so that's fine.
+	vector<uint32_t> input(nnodes, 0);
+	vector<uint32_t> output(nnodes, 0);
+	vector<bool> fanout(nnodes, false);
+	for(auto i : order)
+	{
+		PARGraphNode* node = m_netlist->GetNodeByIndex(i);
+		output[i] = GetNodeDelay(node) + (boundary[i] ? 0 : input[i]);
+
+		for(uint32_t j=0; j<node->GetEdgeCount(); j++)
+		{
+			PARGraphEdge* edge = node->GetEdgeByIndex(j);
+			if(!IsTimedEdge(edge, rank, boundary))
+				continue;
+
+			fanout[i] = true;
+			uint32_t k = edge->m_destnode->GetIndex();
+			input[k] = max(input[k], output[i] + GetEdgeDelay(edge));
+		}
+	}
+
+	uint32_t critical = 0;
+	for(uint32_t i=0; i<nnodes; i++)
+	{
+		if(boundary[i])
+			critical = max(critical, input[i]);
+		else if(!fanout[i])
+			critical = max(critical, output[i]);
+	}
+	return critical;
+}
+
+/**
+	@brief Converts the critical path delay into a cost
+ */
+uint32_t PAREngine::ComputeTimingCostFromDelay(uint32_t delay)
+{
+	if(delay <= m_timingTarget)
+		return 0;
+
+	//Round up, so that any violation at all costs something
+	return (delay - m_timingTarget + m_timingScale - 1) / m_timingScale;
+}
+
+/**
+	@brief Returns the timing cost of the current placement from the cached arrival times
+ */
+uint32_t PAREngine::GetCachedTimingCost()
+{
+	if( (m_timingTarget == 0) || m_endpointDelays.empty() )
+		return 0;
+	return ComputeTimingCostFromDelay(*m_endpointDelays.rbegin());
+}
+
+/**
+	@brief Builds the timing graph and computes every arrival time of the current placement from scratch.
+
+	Called from InitCostCache() once the edge tables are built. Does nothing (beyond clearing old state) if there is no
+	timing target, so designs without one don't pay for it.
+ */
+void PAREngine::InitTimingCache()
+{
+	m_endpointDelays.clear();
+	m_timingQueue.clear();
+	if(m_timingTarget == 0)
+	{
+		m_timingRank.clear();
+		m_timingBoundary.clear();
+		m_timingEndpoint.clear();
+		m_edgeTimed.clear();
+		m_edgeDelay.clear();
+		m_nodeDelay.clear();
+		m_nodeInputArrival.clear();
+		m_nodeArrival.clear();
+		m_timingQueued.clear();
+		return;
+	}
+
+	ComputeTimingOrder(m_timingRank, m_timingBoundary);
+
+	uint32_t nnodes = m_netlist->GetNumNodes();
+	m_timingEndpoint = m_timingBoundary;
+	vector<bool> fanout(nnodes, false);
+	m_edgeTimed.assign(m_netlistEdges.size(), false);
+	m_edgeDelay.assign(m_netlistEdges.size(), 0);
+	for(uint32_t i=0; i<m_netlistEdges.size(); i++)
+	{
+		PARGraphEdge* edge = m_netlistEdges[i];
+		if(!IsTimedEdge(edge, m_timingRank, m_timingBoundary))
+			continue;
+
+		m_edgeTimed[i] = true;
+		m_edgeDelay[i] = GetEdgeDelay(edge);
+		fanout[edge->m_sourcenode->GetIndex()] = true;
+	}
+	for(uint32_t i=0; i<nnodes; i++)
+	{
+		if(!fanout[i])
+			m_timingEndpoint[i] = true;
+	}
+
+	//Same forward pass as ComputeCriticalPathDelay(), but using (and filling) the cached delays
+	vector<uint32_t> order(nnodes);
+	for(uint32_t i=0; i<nnodes; i++)
+		order[m_timingRank[i]] = i;
+	m_nodeDelay.assign(nnodes, 0);
+	m_nodeInputArrival.assign(nnodes, 0);
+	m_nodeArrival.assign(nnodes, 0);
+	for(auto i : order)
+	{
+		m_nodeDelay[i] = GetNodeDelay(m_netlist->GetNodeByIndex(i));
+		m_nodeArrival[i] = m_nodeDelay[i] + (m_timingBoundary[i] ? 0 : m_nodeInputArrival[i]);
+
+		for(auto j : m_nodeEdges[i])
+		{
+			PARGraphEdge* edge = m_netlistEdges[j];
+			if(!m_edgeTimed[j] || (edge->m_sourcenode->GetIndex() != i))
+				continue;
+
+			uint32_t k = edge->m_destnode->GetIndex();
+			m_nodeInputArrival[k] = max(m_nodeInputArrival[k], m_nodeArrival[i] + m_edgeDelay[j]);
+		}
+	}
+
+	for(uint32_t i=0; i<nnodes; i++)
+	{
+		if(m_timingEndpoint[i])
+			m_endpointDelays.insert(GetEndpointDelay(i));
+	}
+	m_timingQueued.assign(nnodes, false);
+}
+
+/**
+	@brief Adds a netlist node to the set whose arrival times need recomputing
+ */
+void PAREngine::QueueTimingUpdate(uint32_t node)
+{
+	if(m_timingQueued[node])
+		return;
+	m_timingQueued[node] = true;
+	m_timingQueue.push_back(pair<uint32_t, uint32_t>(m_timingRank[node], node));
+	push_heap(m_timingQueue.begin(), m_timingQueue.end(), greater< pair<uint32_t, uint32_t> >());
+}
+
+/**
+	@brief Updates the cached arrival times after a and b (either may be NULL) were moved.
+
+	Only the moved nodes and their fan-out cone are revisited, in topological order so each node is recomputed after
+	everything feeding it. Propagation stops wherever an arrival time doesn't change.
+ */
+void PAREngine::UpdateTimingCache(PARGraphNode* a, PARGraphNode* b)
+{
+	if(m_timingTarget == 0)
+		return;
+
+	//The moved nodes' own delays, and the delays of every edge touching them, may have changed
+	PARGraphNode* moved[2] = {a, b};
+	for(auto node : moved)
+	{
+		if(node == NULL)
+			continue;
+
+		uint32_t i = node->GetIndex();
+		m_nodeDelay[i] = GetNodeDelay(node);
+		QueueTimingUpdate(i);
+		for(auto j : m_nodeEdges[i])
+		{
+			if(!m_edgeTimed[j])
+				continue;
+			m_edgeDelay[j] = GetEdgeDelay(m_netlistEdges[j]);
+			QueueTimingUpdate(m_netlistEdges[j]->m_destnode->GetIndex());
+		}
+	}
+
+	while(!m_timingQueue.empty())
+	{
+		pop_heap(m_timingQueue.begin(), m_timingQueue.end(), greater< pair<uint32_t, uint32_t> >());
+		uint32_t i = m_timingQueue.back().second;
+		m_timingQueue.pop_back();
+		m_timingQueued[i] = false;
+
+		//Latest arrival at our inputs
+		uint32_t input = 0;
+		for(auto j : m_nodeEdges[i])
+		{
+			PARGraphEdge* edge = m_netlistEdges[j];
+			if(m_edgeTimed[j] && (edge->m_destnode->GetIndex() == i))
+				input = max(input, m_nodeArrival[edge->m_sourcenode->GetIndex()] + m_edgeDelay[j]);
+		}
+		uint32_t output = m_nodeDelay[i] + (m_timingBoundary[i] ? 0 : input);
+
+		//Update the endpoint list and our own arrival times
+		uint32_t old_output = m_nodeArrival[i];
+		if(m_timingEndpoint[i])
+			m_endpointDelays.erase(m_endpointDelays.find(GetEndpointDelay(i)));
+		m_nodeInputArrival[i] = input;
+		m_nodeArrival[i] = output;
+		if(m_timingEndpoint[i])
+			m_endpointDelays.insert(GetEndpointDelay(i));
+
+		//If our output changed, everything we drive has to be looked at again
+		if(output == old_output)
+			continue;
+		for(auto j : m_nodeEdges[i])
+		{
+			PARGraphEdge* edge = m_netlistEdges[j];
+			if(m_edgeTimed[j] && (edge->m_sourcenode->GetIndex() == i))
+				QueueTimingUpdate(edge->m_destnode->GetIndex());
+		}
+	}
 }
@@ -21,6 +21,120 @@
 
 #include <vector>
 #include <map>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <set>
+
+/**
+	@brief Tuning parameters for the simulated-annealing schedule
+ */
+class PARAnnealOptions
+{
+public:
+	PARAnnealOptions()
+		: initialAcceptance(0.8)
+		, initialSamples(50)
+		, movesPerTemperature(0)
+		, finalTemperature(0.1)
+		, highAcceptance(0.8)
+		, lowAcceptance(0.15)
+		, fastCooling(0.5)
+		, normalCooling(0.9)
+		, slowCooling(0.95)
+		, stagnationLimit(10)
+		, maxReheats(3)
+		, reheatTemperature(0.3)
+		, moveWeightFloor(0.02)
+		, moveWeightSmoothing(0.5)
+		, keepFirstBest(false)
+	{
+	}
+
+	/**
+		@brief Probability of accepting an average uphill move at the initial temperature
+	 */
+	double initialAcceptance;
+
+	/**
+		@brief Number of trial moves used to estimate the initial temperature
+	 */
+	uint32_t initialSamples;
+
+	/**
+		@brief Moves attempted at each temperature (0 = ten times the number of netlist nodes)
+	 */
+	uint32_t movesPerTemperature;
+
+	/**
+		@brief Temperature at which annealing stops
+	 */
+	double finalTemperature;
+
+	/**
+		@brief Acceptance rates above highAcceptance cool at fastCooling, below lowAcceptance at normalCooling,
+		and in between (where most of the useful work happens) at slowCooling
+	 */
+	double highAcceptance;
+	double lowAcceptance;
+	double fastCooling;
+	double normalCooling;
+	double slowCooling;
+
+	/**
+		@brief Stop after this many temperature steps without a new best cost
+	 */
+	uint32_t stagnationLimit;
+
+	/**
+		@brief Number of times to restart from the best placement when we stagnate or freeze
+	 */
+	uint32_t maxReheats;
+
+	/**
+		@brief Temperature to restart at, as a fraction of the initial temperature
+	 */
+	double reheatTemperature;
+
+	/**
+		@brief Each move generator is picked with probability proportional to its weight, which tracks its recent
+		acceptance rate. After every temperature step the weight moves moveWeightSmoothing of the way towards the
+		acceptance rate seen at that temperature, but never drops below moveWeightFloor (so a generator which is
+		useless now still gets tried now and then, in case it becomes useful later).
+	 */
+	double moveWeightFloor;
+	double moveWeightSmoothing;
+
+	/**
+		@brief End on the first placement found with the best cost, rather than wherever we were when we stopped
+		if that's just as good. Useful when the starting placement is one we'd rather not move away from needlessly.
+	 */
+	bool keepFirstBest;
+};
+
+/**
+	@brief Where an annealing run is, as reported to the progress callback (see PAREngine::SetProgressCallback())
+ */
+class PARProgress
+{
+public:
+	///Seed of the annealing run
+	uint32_t seed;
+
+	///Iterations so far in this run
+	uint32_t iteration;
+
+	///Cost of the current placement, and of the best one found so far in this run
+	uint32_t cost;
+	uint32_t bestCost;
+
+	double temperature;
+
+	///Time since this run started, in seconds
+	double seconds;
+};
+
+typedef std::function<void(const PARProgress&)> PARProgressCallback;
 
 /**
 	@brief The core place-and-route engine
@@ -31,17 +145,170 @@ public:
 	PAREngine(PARGraph* netlist, PARGraph* device);
 	virtual ~PAREngine();
 
-	virtual bool PlaceAndRoute(std::map<uint32_t, std::string> label_names, uint32_t seed = 0);
+	virtual bool PlaceAndRoute(const PARLabelRegistry& labels, uint32_t seed = 0);
+
+	//The individual steps of PlaceAndRoute(), for callers that need to run them separately
+	bool Initialize(const PARLabelRegistry& labels);
+	bool Anneal(const PARLabelRegistry& labels, uint32_t seed);
+	bool PlaceExactly(const PARLabelRegistry& labels, double time_budget);
+	bool CheckRouting();
+
+	//Placement snapshots
+	void SavePlacement(std::vector<uint16_t>& placement);
+	void RestorePlacement(const std::vector<uint16_t>& placement);
 
 	virtual uint32_t ComputeCost();
 
+	/**
+		@brief Suppresses all non-fatal log output from the optimizer (for running several engines concurrently)
+	 */
+	void SetQuiet(bool quiet)
+	{ m_quiet = quiet; }
+
+	/**
+		@brief Sets a flag which, when it becomes true, makes Anneal() stop at the end of the current iteration
+	 */
+	void SetStopFlag(std::atomic<bool>* stop)
+	{ m_stop = stop; }
+
+	/**
+		@brief Sets a flag which, when it becomes true, abandons placement altogether.
+
+		Unlike the stop flag, which keeps the best placement found so far, a cancelled run always fails.
+	 */
+	void SetCancelFlag(const std::atomic<bool>* cancel)
+	{ m_cancel = cancel; }
+
+	bool IsCancelled() const
+	{ return (m_cancel != NULL) && *m_cancel; }
+
+	/**
+		@brief Sets a time after which Anneal() stops at the end of the current iteration (like the stop flag, the best
+		placement found so far is kept), and PlaceExactly() gives up searching
+	 */
+	void SetDeadline(std::chrono::steady_clock::time_point deadline)
+	{
+		m_deadline = deadline;
+		m_hasDeadline = true;
+	}
+
+	bool HasDeadline() const
+	{ return m_hasDeadline; }
+
+	std::chrono::steady_clock::time_point GetDeadline() const
+	{ return m_deadline; }
+
+	bool IsPastDeadline() const
+	{ return m_hasDeadline && (std::chrono::steady_clock::now() >= m_deadline); }
+
+	/**
+		@brief Sets a function to call after every annealing iteration (empty for none). It's called on the thread
+		running Anneal(), and should return quickly.
+	 */
+	void SetProgressCallback(const PARProgressCallback& callback)
+	{ m_progress = callback; }
+
+	/**
+		@brief Sets a log to record every annealing move in (NULL for none, see PARMoveLog). Only moves made by this
+		engine are recorded, not by its replicas.
+	 */
+	void SetMoveLog(PARMoveLog* log)
+	{ m_moveLog = log; }
+
+	/**
+		@brief Sets the annealing schedule parameters
+	 */
+	void SetAnnealOptions(const PARAnnealOptions& options)
+	{ m_annealOptions = options; }
+
+	const PARAnnealOptions& GetAnnealOptions()
+	{ return m_annealOptions; }
+
+	/**
+		@brief Enables checking of every incremental cost update against a full recompute (slow, for debugging)
+	 */
+	void SetVerifyIncrementalCost(bool verify)
+	{ m_verifyIncrementalCost = verify; }
+
+	/**
+		@brief Makes the initial placement spread nodes over regions with a PARMultilevelPlacer, for engines which
+		support it (see GetRegionCount())
+	 */
+	void SetMultilevel(bool multilevel)
+	{ m_multilevel = multilevel; }
+
+	bool IsMultilevel()
+	{ return m_multilevel; }
+
+	/**
+		@brief Sets the number of threads full cost recomputes are split across (0, the default, for one per core).
+
+		Only netlists with at least PARALLEL_COST_EDGES edges per thread are split, smaller ones are always
+		recomputed on the calling thread. Results don't depend on the thread count.
+	 */
+	void SetCostThreads(uint32_t threads)
+	{ m_costThreads = threads; }
+
+	/**
+		@brief Sets the longest path delay the placer should try to meet, or zero to ignore timing.
+
+		Every timingScale delay units over the target cost as much as one unit of congestion.
+	 */
+	void SetTimingTarget(uint32_t target, uint32_t scale = 1)
+	{
+		m_timingTarget = target;
+		m_timingScale = scale;
+	}
+
+	uint32_t GetTimingTarget()
+	{ return m_timingTarget; }
+
+	uint32_t ComputeCriticalPathDelay();
+
+	void AddMoveGenerator(PARMoveGenerator* generator);
+
+	/**
+		@brief Evaluates batches of candidate moves on several threads at once, and applies the best of each batch.
+
+		Only used for generators which can propose a move without making it (see PARMoveGenerator::IsSingleStep()),
+		and only if the engine can make replicas of itself. Results depend only on the seed, not the thread count.
+
+		@param size		Number of candidates per batch (1 to evaluate every move by itself, as usual)
+		@param threads	Number of worker threads
+	 */
+	void SetMoveBatch(uint32_t size, uint32_t threads)
+	{
+		m_batchSize = size;
+		m_batchThreads = threads;
+	}
+
+	/**
+		@brief Counters of what the engine has done so far (see PARStatistics)
+	 */
+	const PARStatistics& GetStatistics() const
+	{ return m_stats; }
+
+	/**
+		@brief Adds the work done by another engine to our counters (for engines working on copies of our graphs)
+	 */
+	void AddStatistics(const PARStatistics& stats)
+	{ m_stats.Add(stats); }
+
 protected:
+	friend class PARBatchEvaluator;
+	friend class PARExactPlacer;
+	friend class PARMultilevelPlacer;
+	friend class PARRelocateMoveGenerator;
+	friend class PARSwapChainMoveGenerator;
+	friend class PARClusterMoveGenerator;
 
 	virtual bool CanMoveNode(PARGraphNode* node, PARGraphNode* old_mate, PARGraphNode* new_mate);
 
-	void MoveNode(PARGraphNode* node, PARGraphNode* newpos, std::map<uint32_t, std::string>& label_names);
+	void MoveNode(PARGraphNode* node, PARGraphNode* newpos, const PARLabelRegistry& labels);
 
 	virtual PARGraphNode* GetNewPlacementForNode(PARGraphNode* pivot) =0;
+	virtual PARGraphNode* GetNewPlacementNear(PARGraphNode* node, PARGraphNode* site);
+	virtual PAREngine* CreateReplica(PARGraph* netlist, PARGraph* device);
 	virtual void FindSubOptimalPlacements(std::vector<PARGraphNode*>& bad_nodes) =0;
 
 	virtual uint32_t ComputeAndPrintScore(std::vector<PARGraphEdge*>& unroutes, uint32_t iteration);
@@ -51,22 +318,308 @@ protected:
 	virtual uint32_t ComputeCongestionCost();
 	virtual uint32_t ComputeTimingCost();
 	virtual uint32_t ComputeUnroutableCost(std::vector<PARGraphEdge*>& unroutes);
+	uint32_t CountUnroutableEdges();
+	void BuildEdgeGroups();
+
+	//Full recomputes of big netlists are split into chunks of nodes or edges, one per thread. The cost hooks
+	//(IsEdgeRoutable(), GetEdgeCongestionBin() and GetEdgeCongestionNet()) must be safe to call from several threads
+	//at once, which they are as long as they only read the placement.
+	uint32_t GetCostThreadCount(size_t edges);
+	void ParallelFor(uint32_t count, uint32_t threads, const std::function<void(uint32_t, uint32_t, uint32_t)>& body);
+	static const uint32_t PARALLEL_COST_EDGES = 8192;
+
+	bool IsEdgeRoutable(PARGraphEdge* nedge, PARGraphNode* devsrc, PARGraphNode* devdst);
+
+	//Congestion is modeled as a set of bins (e.g. routing resources); each netlist edge lands in at most one
+	virtual uint32_t GetCongestionBinCount();
+	virtual int32_t GetEdgeCongestionBin(PARGraphEdge* edge);
+	virtual uint32_t GetEdgeCongestionNet(PARGraphEdge* edge);
+	static const uint32_t UNSHARED_NET = 0xffffffff;
+	virtual uint32_t ComputeCongestionCostFromBins(const std::vector<uint32_t>& bins);
+	virtual uint32_t GetCongestionBinCapacity(uint32_t bin);
+
+	//Regions are groups of device sites which are cheap to route within and expensive to route between (e.g.
+	//routing matrices), for multi-level placement (see PARMultilevelPlacer). A netlist node may be constrained to
+	//one region, in which case it's never placed or moved anywhere else.
+	virtual uint32_t GetRegionCount();
+	virtual uint32_t GetSiteRegion(PARGraphNode* site);
+	virtual int32_t GetNodeRegion(PARGraphNode* node);
+	static const int32_t ANY_REGION = -1;
+	bool IsSiteInNodeRegion(PARGraphNode* node, PARGraphNode* site)
+	{
+		int32_t region = GetNodeRegion(node);
+		return (region == ANY_REGION) || (GetSiteRegion(site) == static_cast<uint32_t>(region));
+	}
+
+	//Timing is modeled as the longest path through the netlist, with node and edge delays that depend on placement.
+	//Paths start and end at timing boundaries (registers) and at nodes with no timed fan-in or fan-out.
+	virtual uint32_t GetNodeDelay(PARGraphNode* node);
+	virtual uint32_t GetEdgeDelay(PARGraphEdge* edge);
+	virtual bool IsTimingBoundary(PARGraphNode* node);
+	virtual bool IsTimingEdge(PARGraphEdge* edge);
+	void ComputeTimingOrder(std::vector<uint32_t>& rank, std::vector<bool>& boundary);
+	bool IsTimedEdge(PARGraphEdge* edge, const std::vector<uint32_t>& rank, const std::vector<bool>& boundary);
+	uint32_t ComputeTimingCostFromDelay(uint32_t delay);
+
+	//Incremental cost evaluation
+	void InitCostCache();
+	void UpdateCostCache(PARGraphNode* a, PARGraphNode* b);
+	virtual void UpdateNodeEdgeCosts(PARGraphNode* node);
+	void UpdateEdgeCost(uint32_t index);
+	void ComputeEdgeCost(PARGraphEdge* nedge, bool& unroutable, int32_t& bin, uint32_t& net);
+	void SetEdgeCost(uint32_t index, bool unroutable, int32_t bin, uint32_t net);
+	void AddCongestionUse(uint32_t bin, uint32_t net);
+	void RemoveCongestionUse(uint32_t bin, uint32_t net);
+	uint32_t GetCachedCost();
+	uint32_t GetCachedCongestionCost()
+	{ return ComputeCongestionCostFromBins(m_congestionBins); }
+	uint32_t GetCachedTimingCost();
+	void VerifyCostCache();
+	void InitTimingCache();
+	void UpdateTimingCache(PARGraphNode* a, PARGraphNode* b);
+	void QueueTimingUpdate(uint32_t node);
+	uint32_t GetEndpointDelay(uint32_t node)
+	{ return m_timingBoundary[node] ? m_nodeInputArrival[node] : m_nodeArrival[node]; }
 
-	virtual bool SanityCheck(std::map<uint32_t, std::string> label_names);
-	virtual bool InitialPlacement(std::map<uint32_t, std::string>& label_names);
+	//Incremental tracking of the nodes FindSubOptimalPlacements() returns
+	virtual void InitBadNodeCache();
+	virtual void UpdateBadNodeCache(PARGraphNode* a, PARGraphNode* b);
+	virtual void VerifyBadNodeCache();
+
+	virtual bool SanityCheck(const PARLabelRegistry& labels);
+	virtual PARGraphNode* GetPinnedSite(PARGraphNode* node);
+	bool CheckPlacementFeasible(const PARLabelRegistry& labels);
+	virtual bool InitialPlacement(const PARLabelRegistry& labels);
 	virtual bool InitialPlacement_core() =0;
 	virtual bool OptimizePlacement(
 		std::vector<PARGraphNode*>& badnodes,
-		std::map<uint32_t, std::string>& label_names);
+		const PARLabelRegistry& labels);
+	bool OptimizePlacementBatch(
+		std::vector<PARGraphNode*>& badnodes,
+		const PARLabelRegistry& labels,
+		uint32_t generator);
+	void SyncPlacement(const std::vector<uint16_t>& placement);
+
+	//Annealing schedule
+	bool ProposeMove(
+		std::vector<PARGraphNode*>& badnodes,
+		const PARLabelRegistry& labels,
+		PARMove& move,
+		uint32_t generator,
+		int32_t& delta);
+	bool TryMoveStep(
+		PARMove& move,
+		PARGraphNode* node,
+		PARGraphNode* site,
+		const PARLabelRegistry& labels);
+	void RevertMove(PARMove& move, const PARLabelRegistry& labels);
+	void CommitMove(PARMove& move);
+	bool AcceptMove(int32_t delta);
+	uint32_t SelectMoveGenerator();
+	void UpdateMoveWeights();
+	double ComputeInitialTemperature(const PARLabelRegistry& labels);
+	double GetCoolingRate(double acceptance);
 
 	virtual uint32_t ComputeNodeUnroutableCost(PARGraphNode* pivot, PARGraphNode* candidate);
+	uint32_t ComputeNodeUnroutableCostFromEdges(PARGraphNode* pivot, PARGraphNode* candidate);
+	void InvalidateNodeSiteCosts(PARGraphNode* moved);
+	void FlushMoveInvalidations();
 
-	std::string GetNodeTypes(PARGraphNode* node, std::map<uint32_t, std::string>& label_names);
+	std::string GetNodeTypes(PARGraphNode* node, const PARLabelRegistry& labels);
 
 	PARGraph* m_netlist;
 	PARGraph* m_device;
 
-	uint32_t m_temperature;
+	/**
+		@brief Current annealing temperature, in cost units
+	 */
+	double m_temperature;
+
+	/**
+		@brief Parameters for the annealing schedule
+	 */
+	PARAnnealOptions m_annealOptions;
+
+	/**
+		@brief Source of all randomness in the optimizer (seeded by Anneal())
+	 */
+	PARRandom m_random;
+
+	/**
+		@brief The kinds of move we can make (owned by the engine), and how likely each one is to be picked
+	 */
+	std::vector<PARMoveGenerator*> m_moveGenerators;
+	std::vector<double> m_moveWeights;
+
+	/**
+		@brief Moves each generator made, and how many of those were accepted, at the current temperature
+	 */
+	std::vector<uint32_t> m_moveProposed;
+	std::vector<uint32_t> m_moveAccepted;
+
+	/**
+		@brief The move being tried right now (NULL between moves), and how many of its steps have had their
+		memoized node/site costs invalidated (see FlushMoveInvalidations())
+	 */
+	PARMove* m_currentMove;
+	size_t m_currentMoveInvalidated;
+
+	/**
+		@brief Candidates per batch and worker threads (see SetMoveBatch()), and the evaluator (only while annealing)
+	 */
+	uint32_t m_batchSize;
+	uint32_t m_batchThreads;
+	PARBatchEvaluator* m_batchEvaluator;
+
+	/**
+		@brief True if we should not log anything from the optimizer
+	 */
+	bool m_quiet;
+
+	/**
+		@brief External request to stop optimizing (may be NULL)
+	 */
+	std::atomic<bool>* m_stop;
+
+	/**
+		@brief External request to give up on placement entirely (may be NULL)
+	 */
+	const std::atomic<bool>* m_cancel;
+
+	/**
+		@brief Time to stop annealing by, if m_hasDeadline is set
+	 */
+	std::chrono::steady_clock::time_point m_deadline;
+	bool m_hasDeadline;
+
+	/**
+		@brief Called after every annealing iteration (may be empty)
+	 */
+	PARProgressCallback m_progress;
+
+	/**
+		@brief Where to record moves (may be NULL)
+	 */
+	PARMoveLog* m_moveLog;
+
+	/**
+		@brief Every edge in the netlist graph except free ones (PARGraphEdge::m_free), in a fixed order (indexes into
+		the cost cache)
+	 */
+	std::vector<PARGraphEdge*> m_netlistEdges;
+
+	/**
+		@brief Indexes of the netlist edges with each netlist node (by node index) as source or destination
+	 */
+	std::vector< std::vector<uint32_t> > m_nodeEdges;
+
+	/**
+		@brief Netlist edges sorted into groups with the same source node and ports (group i is m_groupedEdges
+		[m_edgeGroupStarts[i], m_edgeGroupStarts[i+1]) ), and a bit row of their destinations, for checking a group
+		against the device adjacency matrices in one go
+	 */
+	std::vector<PARGraphEdge*> m_groupedEdges;
+	std::vector<uint32_t> m_edgeGroupStarts;
+	std::vector<uint64_t> m_adjacencyScratch;
+
+	/**
+		@brief Cached per-edge cost contributions for the current placement
+	 */
+	std::vector<bool> m_edgeUnroutable;
+	std::vector<int32_t> m_edgeCongestionBin;
+	std::vector<uint32_t> m_edgeCongestionNet;
+
+	/**
+		@brief Number of resources (distinct nets, or unshared edges) currently used in each congestion bin
+	 */
+	std::vector<uint32_t> m_congestionBins;
+
+	/**
+		@brief Number of netlist edges carrying each netlist net through each congestion bin (indexed by
+		bin * m_netlist->GetNumNets() + net)
+	 */
+	std::vector<uint32_t> m_congestionNetRefs;
+
+	/**
+		@brief Number of netlist edges currently unroutable
+	 */
+	uint32_t m_unroutableCost;
+
+	/**
+		@brief Memoized ComputeNodeUnroutableCost() results, indexed by netlist node * device size + device node.
+
+		An entry is only valid if its generation matches the netlist node's current one in m_nodeGeneration.
+	 */
+	std::vector<uint32_t> m_nodeSiteCost;
+	std::vector<uint32_t> m_nodeSiteGeneration;
+
+	/**
+		@brief Per netlist node counter, bumped whenever one of the node's neighbors is moved
+	 */
+	std::vector<uint32_t> m_nodeGeneration;
+
+	/**
+		@brief Longest path delay we're trying to meet (zero if timing is ignored), and how many delay units over it
+		cost one unit
+	 */
+	uint32_t m_timingTarget;
+	uint32_t m_timingScale;
+
+	/**
+		@brief Position of each netlist node (by index) in topological order, and whether it's a timing boundary
+	 */
+	std::vector<uint32_t> m_timingRank;
+	std::vector<bool> m_timingBoundary;
+
+	/**
+		@brief True for the netlist nodes timing paths end at
+	 */
+	std::vector<bool> m_timingEndpoint;
+
+	/**
+		@brief Per-edge timing state (indexed like m_netlistEdges): whether the edge is on any timing path, and its
+		delay under the current placement
+	 */
+	std::vector<bool> m_edgeTimed;
+	std::vector<uint32_t> m_edgeDelay;
+
+	/**
+		@brief Per-node timing state: delay through the node, and latest arrival time at its inputs and outputs
+	 */
+	std::vector<uint32_t> m_nodeDelay;
+	std::vector<uint32_t> m_nodeInputArrival;
+	std::vector<uint32_t> m_nodeArrival;
+
+	/**
+		@brief Path delay at every timing endpoint (the largest is the critical path)
+	 */
+	std::multiset<uint32_t> m_endpointDelays;
+
+	/**
+		@brief Nodes waiting for their arrival times to be recomputed, as a min-heap of (rank, node index)
+	 */
+	std::vector< std::pair<uint32_t, uint32_t> > m_timingQueue;
+	std::vector<bool> m_timingQueued;
+
+	/**
+		@brief If set, check every incremental cost update against ComputeCost()
+	 */
+	bool m_verifyIncrementalCost;
+
+	/**
+		@brief If set, derived engines should use PARMultilevelPlacer for their initial placement
+	 */
+	bool m_multilevel;
+
+	/**
+		@brief Maximum number of threads for full cost recomputes (0 for one per core, see SetCostThreads())
+	 */
+	uint32_t m_costThreads;
+
+	/**
+		@brief Counters for profiling
+	 */
+	PARStatistics m_stats;
 };
 
 #endif
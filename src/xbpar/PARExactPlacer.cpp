@@ -0,0 +1,321 @@
+/***********************************************************************************************************************
+ * Copyright (C) 2016 Andrew Zonenberg and contributors                                                                *
+ *                                                                                                                     *
+ * This program is free software; you can redistribute it and/or modify it under the terms of the GNU Lesser General   *
+ * Public License as published by the Free Software Foundation; either version 2.1 of the License, or (at your option) *
+ * any later version.                                                                                                  *
+ *                                                                                                                     *
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied  *
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for     *
+ * more details.                                                                                                       *
+ *                                                                                                                     *
+ * You should have received a copy of the GNU Lesser General Public License along with this program; if not, you may   *
+ * find one here:                                                                                                      *
+ * https://www.gnu.org/licenses/old-licenses/lgpl-2.1.txt                                                              *
+ * or you may search the http://www.gnu.org website for the version 2.1 license, or you may write to the Free Software *
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA                                      *
+ **********************************************************************************************************************/
+
+#include <algorithm>
+#include <log.h>
+#include <xbpar.h>
+
+using namespace std;
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Construction / destruction
+
+PARExactPlacer::PARExactPlacer(PAREngine* engine, const PARLabelRegistry& labels)
+	: m_engine(engine)
+	, m_labels(labels)
+	, m_usage(0)
+	, m_found(false)
+	, m_bestUsage(0)
+	, m_timedOut(false)
+	, m_visits(0)
+{
+	PARGraph* netlist = engine->m_netlist;
+	PARGraph* device = engine->m_device;
+	uint32_t nnodes = netlist->GetNumNodes();
+
+	m_edges.resize(nnodes);
+	m_candidates.resize(nnodes);
+	m_placed.assign(nnodes, false);
+	for(uint32_t i=0; i<nnodes; i++)
+	{
+		PARGraphNode* node = netlist->GetNodeByIndex(i);
+		for(uint32_t j=0; j<node->GetEdgeCount(); j++)
+		{
+			PARGraphEdge* edge = node->GetEdgeByIndex(j);
+			if(edge->m_free)
+				continue;
+			m_edges[i].push_back(edge);
+			if(edge->m_destnode != node)
+				m_edges[edge->m_destnode->GetIndex()].push_back(edge);
+		}
+
+		PARGraphNode* pin = engine->GetPinnedSite(node);
+		if(pin != NULL)
+			m_candidates[i].push_back(pin);
+		else
+		{
+			uint32_t label = node->GetLabel();
+			for(uint32_t j=0; j<device->GetNumNodesWithLabel(label); j++)
+			{
+				PARGraphNode* site = device->GetNodeByLabelAndIndex(label, j);
+				if(engine->IsSiteInNodeRegion(node, site))
+					m_candidates[i].push_back(site);
+			}
+		}
+	}
+
+	uint32_t nbins = engine->GetCongestionBinCount();
+	m_binUse.assign(nbins, 0);
+	m_netCount = netlist->GetNumNets();
+	m_binNetRefs.assign(static_cast<size_t>(nbins) * m_netCount, 0);
+	for(uint32_t i=0; i<nbins; i++)
+		m_binCapacity.push_back(engine->GetCongestionBinCapacity(i));
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Search
+
+/**
+	@brief Searches for the best placement, for at most time_budget seconds.
+
+	@return True if a placement was found (the best one is applied to the engine's graphs). Otherwise the engine's
+			original placement is put back.
+ */
+bool PARExactPlacer::Search(double time_budget)
+{
+	m_deadline = chrono::steady_clock::now() +
+		chrono::duration_cast<chrono::steady_clock::duration>(chrono::duration<double>(time_budget));
+
+	//Start from nothing, but remember where we were
+	vector<uint16_t> original;
+	m_engine->SavePlacement(original);
+	PARGraph* netlist = m_engine->m_netlist;
+	for(uint32_t i=0; i<netlist->GetNumNodes(); i++)
+		netlist->GetNodeByIndex(i)->MateWith(NULL);
+
+	ChooseOrder();
+	Visit(0);
+
+	m_engine->RestorePlacement(m_found ? m_best : original);
+	return m_found;
+}
+
+/**
+	@brief Decides which order to place nodes in.
+
+	Pinned nodes go first since they have no choices to make. After that we always pick the node with the most
+	connections to nodes already placed, since its choices are the most constrained (ties go to the node with the
+	fewest candidate sites).
+ */
+void PARExactPlacer::ChooseOrder()
+{
+	uint32_t nnodes = m_candidates.size();
+	vector<bool> ordered(nnodes, false);
+	vector<uint32_t> links(nnodes, 0);
+	vector<bool> pinned(nnodes, false);
+	for(uint32_t i=0; i<nnodes; i++)
+		pinned[i] = (m_engine->GetPinnedSite(m_engine->m_netlist->GetNodeByIndex(i)) != NULL);
+
+	m_order.clear();
+	for(uint32_t n=0; n<nnodes; n++)
+	{
+		uint32_t best = nnodes;
+		for(uint32_t i=0; i<nnodes; i++)
+		{
+			if(ordered[i])
+				continue;
+			if(best == nnodes)
+			{
+				best = i;
+				continue;
+			}
+
+			if(pinned[i] != pinned[best])
+			{
+				if(pinned[i])
+					best = i;
+			}
+			else if(links[i] != links[best])
+			{
+				if(links[i] > links[best])
+					best = i;
+			}
+			else if(m_candidates[i].size() < m_candidates[best].size())
+				best = i;
+		}
+
+		ordered[best] = true;
+		m_order.push_back(best);
+		for(auto edge : m_edges[best])
+		{
+			links[edge->m_sourcenode->GetIndex()] ++;
+			links[edge->m_destnode->GetIndex()] ++;
+		}
+	}
+}
+
+/**
+	@brief Places the node at the given depth in every way we haven't ruled out, and recurses
+ */
+void PARExactPlacer::Visit(uint32_t depth)
+{
+	if(m_timedOut)
+		return;
+	m_visits ++;
+	if( ((m_visits & 0x3ff) == 0) && ( (chrono::steady_clock::now() > m_deadline) || m_engine->IsCancelled() ) )
+	{
+		m_timedOut = true;
+		return;
+	}
+
+	//Everything placed? This is the best placement so far (or it would have been pruned)
+	if(depth == m_order.size())
+	{
+		m_found = true;
+		m_bestUsage = m_usage;
+		m_engine->SavePlacement(m_best);
+		return;
+	}
+
+	//Try the sites which add the fewest resources first, so the first placement we find is already a good one
+	PARGraphNode* node = m_engine->m_netlist->GetNodeByIndex(m_order[depth]);
+	auto& candidates = m_candidates[node->GetIndex()];
+	vector< pair<uint32_t, uint32_t> > options;
+	for(uint32_t i=0; i<candidates.size(); i++)
+	{
+		if(candidates[i]->GetMate() != NULL)
+			continue;
+
+		size_t mark = m_undo.size();
+		uint32_t usage = m_usage;
+		if(Assign(node, candidates[i]))
+			options.push_back(pair<uint32_t, uint32_t>(m_usage - usage, i));
+		Unassign(node, mark);
+	}
+	sort(options.begin(), options.end());
+
+	for(auto& option : options)
+	{
+		//Check again, since finding a better placement may have tightened the bound
+		size_t mark = m_undo.size();
+		if(Assign(node, candidates[option.second]))
+			Visit(depth + 1);
+		Unassign(node, mark);
+
+		//Can't beat zero
+		if(m_timedOut || (m_found && (m_bestUsage == 0)) )
+			return;
+	}
+}
+
+/**
+	@brief Places a node at a site, and checks if the partial placement can still lead to a (better) solution.
+
+	Must be followed by Unassign() whether it succeeds or not.
+ */
+bool PARExactPlacer::Assign(PARGraphNode* node, PARGraphNode* site)
+{
+	if(!site->MatchesLabel(node->GetLabel()))
+	{
+		LogFatal("Exact placer tried to put a node of type \"%s\" in an illegal site\n",
+			m_labels.GetName(node->GetLabel()).c_str());
+	}
+
+	node->MateWith(site);
+	m_placed[node->GetIndex()] = true;
+
+	for(auto edge : m_edges[node->GetIndex()])
+	{
+		//If the other end isn't placed yet, make sure it still has somewhere to go
+		PARGraphNode* other = (edge->m_sourcenode == node) ? edge->m_destnode : edge->m_sourcenode;
+		if(!m_placed[other->GetIndex()])
+		{
+			if(!HasRoutableSite(other, edge))
+				return false;
+			continue;
+		}
+
+		//Both ends are placed, so the edge has to be routable and fit in its bin
+		if(!m_engine->IsEdgeRoutable(edge, edge->m_sourcenode->GetMate(), edge->m_destnode->GetMate()))
+			return false;
+		int32_t bin = m_engine->GetEdgeCongestionBin(edge);
+		if(bin < 0)
+			continue;
+		AddUse(bin, m_engine->GetEdgeCongestionNet(edge));
+		if(m_binUse[bin] > m_binCapacity[bin])
+			return false;
+	}
+
+	//Bound: resource usage never goes down as we place more nodes
+	if(m_found && (m_usage >= m_bestUsage))
+		return false;
+
+	return true;
+}
+
+/**
+	@brief Undoes Assign()
+
+	@param mark		Size of the undo list before the Assign() call
+ */
+void PARExactPlacer::Unassign(PARGraphNode* node, size_t mark)
+{
+	while(m_undo.size() > mark)
+	{
+		auto use = m_undo.back();
+		m_undo.pop_back();
+		RemoveUse(use.first, use.second);
+	}
+
+	m_placed[node->GetIndex()] = false;
+	node->MateWith(NULL);
+}
+
+/**
+	@brief Checks if an unplaced node has a free site where one edge (to a placed node) is routable
+ */
+bool PARExactPlacer::HasRoutableSite(PARGraphNode* node, PARGraphEdge* edge)
+{
+	for(auto site : m_candidates[node->GetIndex()])
+	{
+		if(site->GetMate() != NULL)
+			continue;
+
+		PARGraphNode* devsrc = edge->m_sourcenode->GetMate();
+		PARGraphNode* devdst = edge->m_destnode->GetMate();
+		if(edge->m_sourcenode == node)
+			devsrc = site;
+		else
+			devdst = site;
+
+		if(m_engine->IsEdgeRoutable(edge, devsrc, devdst))
+			return true;
+	}
+	return false;
+}
+
+/**
+	@brief Records one more edge in a congestion bin (same accounting as PAREngine::AddCongestionUse())
+ */
+void PARExactPlacer::AddUse(uint32_t bin, uint32_t net)
+{
+	if( (net >= m_netCount) || (m_binNetRefs[static_cast<size_t>(bin)*m_netCount + net] ++ == 0) )
+	{
+		m_binUse[bin] ++;
+		m_usage ++;
+	}
+	m_undo.push_back(pair<uint32_t, uint32_t>(bin, net));
+}
+
+void PARExactPlacer::RemoveUse(uint32_t bin, uint32_t net)
+{
+	if( (net < m_netCount) && (-- m_binNetRefs[static_cast<size_t>(bin)*m_netCount + net] != 0) )
+		return;
+	m_binUse[bin] --;
+	m_usage --;
+}
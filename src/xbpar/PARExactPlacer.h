@@ -0,0 +1,133 @@
+/***********************************************************************************************************************
+ * Copyright (C) 2016 Andrew Zonenberg and contributors                                                                *
+ *                                                                                                                     *
+ * This program is free software; you can redistribute it and/or modify it under the terms of the GNU Lesser General   *
+ * Public License as published by the Free Software Foundation; either version 2.1 of the License, or (at your option) *
+ * any later version.                                                                                                  *
+ *                                                                                                                     *
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied  *
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for     *
+ * more details.                                                                                                       *
+ *                                                                                                                     *
+ * You should have received a copy of the GNU Lesser General Public License along with this program; if not, you may   *
+ * find one here:                                                                                                      *
+ * https://www.gnu.org/licenses/old-licenses/lgpl-2.1.txt                                                              *
+ * or you may search the http://www.gnu.org website for the version 2.1 license, or you may write to the Free Software *
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA                                      *
+ **********************************************************************************************************************/
+
+#ifndef PARExactPlacer_h
+#define PARExactPlacer_h
+
+#include <vector>
+#include <map>
+#include <string>
+#include <chrono>
+
+class PAREngine;
+class PARGraphNode;
+class PARGraphEdge;
+
+/**
+	@brief Complete search for a placement, by branch and bound over every label-compatible assignment.
+
+	Nodes are placed one at a time (pinned nodes first, then whichever node has the most connections to nodes already
+	placed), trying each free site in order of how many congestion resources it adds. A partial placement is pruned as
+	soon as an edge between two placed nodes is unroutable, an unplaced neighbor has no routable site left, a
+	congestion bin goes over capacity, or it uses at least as many congestion resources as the best complete placement
+	found so far.
+
+	So the first placement found is routable and fits in every bin, and if the search finishes, the last one found
+	uses as few congestion resources as possible. Timing is not considered.
+ */
+class PARExactPlacer
+{
+public:
+	PARExactPlacer(PAREngine* engine, const PARLabelRegistry& labels);
+
+	bool Search(double time_budget);
+
+	/**
+		@brief True if the search ran to completion (so the result is optimal, or there is no legal placement)
+	 */
+	bool IsComplete()
+	{ return !m_timedOut; }
+
+	/**
+		@brief Congestion resources used by the best placement found
+	 */
+	uint32_t GetBestUsage()
+	{ return m_bestUsage; }
+
+	/**
+		@brief Number of partial placements looked at
+	 */
+	uint64_t GetVisitCount()
+	{ return m_visits; }
+
+protected:
+	void ChooseOrder();
+	void Visit(uint32_t depth);
+	bool Assign(PARGraphNode* node, PARGraphNode* site);
+	void Unassign(PARGraphNode* node, size_t mark);
+	bool HasRoutableSite(PARGraphNode* node, PARGraphEdge* edge);
+	void AddUse(uint32_t bin, uint32_t net);
+	void RemoveUse(uint32_t bin, uint32_t net);
+
+	/**
+		@brief The engine we're placing for, and its label names (for error messages)
+	 */
+	PAREngine* m_engine;
+	const PARLabelRegistry& m_labels;
+
+	/**
+		@brief Order in which netlist nodes (by index) are placed, and the sites each one may go in
+	 */
+	std::vector<uint32_t> m_order;
+	std::vector< std::vector<PARGraphNode*> > m_candidates;
+
+	/**
+		@brief Every edge into or out of each netlist node (by index), except free ones. Loops are only listed once.
+	 */
+	std::vector< std::vector<PARGraphEdge*> > m_edges;
+
+	/**
+		@brief Whether each netlist node (by index) is placed yet
+	 */
+	std::vector<bool> m_placed;
+
+	/**
+		@brief Resources used in each congestion bin, how many edges use each netlist net in it (indexed by
+		bin * m_netCount + net), and its capacity
+	 */
+	std::vector<uint32_t> m_binUse;
+	std::vector<uint32_t> m_binNetRefs;
+	std::vector<uint32_t> m_binCapacity;
+	uint32_t m_netCount;
+
+	/**
+		@brief Total resources used in all bins by the current partial placement
+	 */
+	uint32_t m_usage;
+
+	/**
+		@brief Congestion uses added while placing nodes, so they can be taken back out (bin, net)
+	 */
+	std::vector< std::pair<uint32_t, uint32_t> > m_undo;
+
+	/**
+		@brief The best complete placement found so far (if m_found), and its resource usage
+	 */
+	bool m_found;
+	std::vector<uint16_t> m_best;
+	uint32_t m_bestUsage;
+
+	/**
+		@brief When to give up, and whether we did
+	 */
+	std::chrono::steady_clock::time_point m_deadline;
+	bool m_timedOut;
+	uint64_t m_visits;
+};
+
+#endif
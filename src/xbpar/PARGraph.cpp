@@ -16,21 +16,42 @@
  * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA                                      *
  **********************************************************************************************************************/
 
+#include <algorithm>
+#include <unordered_map>
+#include <memory>
+#include <log.h>
 #include <xbpar.h>
 
+using namespace std;
+
+const uint16_t PARGraph::NO_MATE;
+
+deque<string> PARGraph::m_portNames;
+map<string, uint16_t> PARGraph::m_portIDs;
+mutex PARGraph::m_portMutex;
+
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 // Construction / destruction
 
 PARGraph::PARGraph()
-	: m_nextLabel(0)
+	: m_mateGraph(NULL)
+	, m_nextLabel(0)
+	, m_edgeIndexValid(false)
+	, m_frozen(false)
 {
 
 }
 
 PARGraph::~PARGraph()
 {
+	//Nodes in the arena still need their destructors run, but the memory is freed in bulk with the arena
 	for(auto x : m_nodes)
-		delete x;
+	{
+		if(x->m_graph == this)
+			x->~PARGraphNode();
+		else
+			delete x;
+	}
 	m_nodes.clear();
 }
 
@@ -73,12 +94,356 @@ uint32_t PARGraph::GetNumEdges()
 	return netcount;
 }
 
+/**
+	@brief Get the number of implicit routes through the general fabric (every fabric output to every fabric input)
+ */
+uint64_t PARGraph::GetNumFabricEdges()
+{
+	uint64_t outputs = 0;
+	uint64_t inputs = 0;
+	for(auto x : m_nodes)
+	{
+		outputs += x->GetFabricOutputCount();
+		inputs += x->GetFabricInputCount();
+	}
+	return outputs * inputs;
+}
+
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 // Insertion
 
+/**
+	@brief Create a new node in this graph's arena and add it to the graph.
+
+	Prefer this over AddNode() with a node from new, since it avoids per-node and per-edge heap allocations.
+ */
+PARGraphNode* PARGraph::CreateNode(uint32_t label, void* pData)
+{
+	PARGraphNode* node = m_arena.New<PARGraphNode>(label, pData);
+	node->m_graph = this;
+	AddNode(node);
+	return node;
+}
+
+/**
+	@brief Allocate an edge in this graph's arena. Used by nodes created with CreateNode().
+ */
+PARGraphEdge* PARGraph::AllocateEdge(PARGraphNode* source, uint16_t srcport, PARGraphNode* dest, uint16_t dstport)
+{
+	return m_arena.New<PARGraphEdge>(source, srcport, dest, dstport);
+}
+
+/**
+	@brief Add a heap-allocated node to the graph. The graph takes ownership and will delete it.
+ */
 void PARGraph::AddNode(PARGraphNode* node)
 {
+	if(m_frozen)
+		LogFatal("Tried to add a node to a frozen graph\n");
+
+	//Mates are stored as 16-bit indexes
+	if(m_nodes.size() >= NO_MATE)
+		LogFatal("Graphs are limited to %u nodes\n", NO_MATE);
+
+	node->m_index = m_nodes.size();
+	node->m_owner = this;
 	m_nodes.push_back(node);
+	m_mates.push_back(NO_MATE);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Copying
+
+/**
+	@brief Makes a deep copy of the graph.
+
+	Nodes are cloned in the same order (so node indexes match between the two graphs) and point at the same external
+	data. The edge index is immutable, so it's shared with the original rather than copied.
+
+	Mates are not copied, since they point into another graph; use ClonePair() or CopyPlacement() for that.
+ */
+PARGraph* PARGraph::Clone()
+{
+	PARGraph* ret = new PARGraph;
+	ret->m_nextLabel = m_nextLabel;
+
+	//Copy the nodes first, so we can map edge destinations
+	unordered_map<PARGraphNode*, PARGraphNode*> nodemap;
+	for(auto x : m_nodes)
+	{
+		auto node = ret->CreateNode(x->m_label, x->m_pData);
+		node->m_alternateLabels = x->m_alternateLabels;
+		node->m_labelMask = x->m_labelMask;
+		node->m_fabricOutputs = x->m_fabricOutputs;
+		node->m_fabricInputs = x->m_fabricInputs;
+		nodemap[x] = node;
+	}
+
+	//Then the edges
+	for(auto x : m_nodes)
+	{
+		auto node = nodemap[x];
+		for(uint32_t i=0; i<x->GetEdgeCount(); i++)
+		{
+			auto edge = x->GetEdgeByIndex(i);
+			node->m_edges.push_back(
+				ret->AllocateEdge(node, edge->m_sourceport, nodemap[edge->m_destnode], edge->m_destport));
+		}
+	}
+
+	//Bring the copy to the same state as the original
+	if(m_frozen)
+		ret->Freeze();
+	if(m_edgeIndexValid)
+	{
+		ret->m_edgeIndex = m_edgeIndex;
+		ret->m_edgeIndexValid = true;
+	}
+	ret->m_adjacency = m_adjacency;
+	if(!m_labeledNodes.empty())
+		ret->IndexNodesByLabel();
+
+	return ret;
+}
+
+/**
+	@brief Clones a netlist/device graph pair, including the current placement
+ */
+void PARGraph::ClonePair(PARGraph* netlist, PARGraph* device, PARGraph*& nclone, PARGraph*& dclone)
+{
+	nclone = netlist->Clone();
+	dclone = device->Clone();
+	CopyPlacement(netlist, nclone, dclone);
+}
+
+/**
+	@brief Copies the placement (mate assignment) of one netlist graph to another.
+
+	The destination graphs must have the same nodes in the same order as the source pair, for example they must be
+	Clone()s of each other.
+ */
+void PARGraph::CopyPlacement(PARGraph* fromNetlist, PARGraph* toNetlist, PARGraph* toDevice)
+{
+	vector<uint16_t> placement;
+	fromNetlist->SavePlacement(placement);
+	toNetlist->RestorePlacement(placement, toDevice);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Placement snapshots
+
+/**
+	@brief Saves the current placement of a netlist graph.
+
+	The snapshot is our mate array followed by the paired device graph's, so saving and restoring are plain copies.
+ */
+void PARGraph::SavePlacement(vector<uint16_t>& placement)
+{
+	placement = m_mates;
+	if(m_mateGraph != NULL)
+		placement.insert(placement.end(), m_mateGraph->m_mates.begin(), m_mateGraph->m_mates.end());
+}
+
+/**
+	@brief Restores a placement saved by SavePlacement() on this graph (or a clone of it)
+
+	@param device		The device graph to pair this graph with (the original, or the matching clone)
+ */
+void PARGraph::RestorePlacement(const vector<uint16_t>& placement, PARGraph* device)
+{
+	m_mateGraph = device;
+	device->m_mateGraph = this;
+
+	size_t n = m_mates.size();
+	if(placement.size() == n)
+	{
+		//Saved before anything was placed
+		copy(placement.begin(), placement.end(), m_mates.begin());
+		fill(device->m_mates.begin(), device->m_mates.end(), NO_MATE);
+		return;
+	}
+	if(placement.size() != n + device->m_mates.size())
+		LogFatal("Placement snapshot doesn't match the graphs it's being restored to\n");
+
+	copy(placement.begin(), placement.begin() + n, m_mates.begin());
+	copy(placement.begin() + n, placement.end(), device->m_mates.begin());
+}
+
+/**
+	@brief Pack all edges into a single compressed-sparse-row array so the PAR inner loops walk contiguous memory.
+
+	Also groups the edges into nets (one per source port), see GetNetByIndex().
+
+	After this, no nodes or edges may be added or removed. Any PARGraphEdge pointers obtained before freezing
+	are invalidated.
+ */
+void PARGraph::Freeze()
+{
+	if(m_frozen)
+		return;
+
+	//Compute offsets first so the array is allocated exactly once (node edge pointers must not move)
+	m_edgeOffsets.clear();
+	m_edgeOffsets.reserve(m_nodes.size() + 1);
+	uint32_t nedges = 0;
+	for(auto x : m_nodes)
+	{
+		m_edgeOffsets.push_back(nedges);
+		nedges += x->m_edges.size();
+	}
+	m_edgeOffsets.push_back(nedges);
+
+	m_edgeArray.clear();
+	m_edgeArray.reserve(nedges);
+	for(auto x : m_nodes)
+	{
+		for(auto e : x->m_edges)
+		{
+			m_edgeArray.push_back(*e);
+			if(x->m_graph == NULL)
+				delete e;
+		}
+		x->m_edges.clear();
+		x->m_edges.shrink_to_fit();
+	}
+
+	for(size_t i=0; i<m_nodes.size(); i++)
+	{
+		auto x = m_nodes[i];
+		x->m_frozen = true;
+		x->m_frozenEdges = m_edgeArray.data() + m_edgeOffsets[i];
+		x->m_frozenEdgeCount = m_edgeOffsets[i+1] - m_edgeOffsets[i];
+	}
+
+	//Group each node's edges by source port, in order of each port's first edge. Edge order itself doesn't change.
+	//m_netSinks is sized exactly once so the nets can point into it.
+	m_nets.clear();
+	m_netSinks.clear();
+	m_netSinks.reserve(nedges);
+	vector<uint16_t> ports;
+	for(auto x : m_nodes)
+	{
+		ports.clear();
+		for(uint32_t j=0; j<x->m_frozenEdgeCount; j++)
+		{
+			uint16_t port = x->m_frozenEdges[j].m_sourceport;
+			if(find(ports.begin(), ports.end(), port) == ports.end())
+				ports.push_back(port);
+		}
+
+		for(auto port : ports)
+		{
+			uint32_t net = m_nets.size();
+			size_t first = m_netSinks.size();
+			for(uint32_t j=0; j<x->m_frozenEdgeCount; j++)
+			{
+				PARGraphEdge* e = x->m_frozenEdges + j;
+				if(e->m_sourceport != port)
+					continue;
+				e->m_net = net;
+				m_netSinks.push_back(e);
+			}
+			m_nets.push_back(PARGraphNet(x, port, m_netSinks.data() + first, m_netSinks.size() - first));
+		}
+	}
+
+	m_frozen = true;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Edge lookup
+
+/**
+	@brief Build a hash index of all edges in the graph so HasEdge() is O(1).
+
+	Call once the graph topology is final (the device graph never changes during PAR).
+ */
+void PARGraph::IndexEdges()
+{
+	auto index = make_shared<PARGraphEdgeIndex>();
+	index->reserve(GetNumEdges());
+	for(auto x : m_nodes)
+	{
+		for(uint32_t i=0; i<x->GetEdgeCount(); i++)
+		{
+			auto edge = x->GetEdgeByIndex(i);
+			index->insert(PARGraphEdgeKey(
+				x->m_index, edge->m_sourceport, edge->m_destnode->m_index, edge->m_destport));
+		}
+	}
+	m_edgeIndex = index;
+	m_edgeIndexValid = true;
+}
+
+/**
+	@brief Build bit matrices of the routing between every pair of nodes (see PARAdjacency).
+
+	Like IndexEdges(), call once the graph topology is final. Only sensible for small graphs.
+ */
+void PARGraph::BuildAdjacency()
+{
+	m_adjacency = make_shared<PARAdjacency>(this);
+}
+
+/**
+	@brief Checks if the graph has a route between the given ports of two nodes.
+
+	Routes through the general fabric are implicit. Dedicated routes use the edge index if it's valid,
+	otherwise we fall back to searching the source node's edges.
+ */
+bool PARGraph::HasEdge(PARGraphNode* source, uint16_t srcport, PARGraphNode* dest, uint16_t dstport)
+{
+	if(source->HasFabricOutput(srcport) && dest->HasFabricInput(dstport))
+		return true;
+
+	if(m_edgeIndexValid)
+	{
+		PARGraphEdgeKey key(source->m_index, srcport, dest->m_index, dstport);
+		return (m_edgeIndex->find(key) != m_edgeIndex->end());
+	}
+
+	for(uint32_t i=0; i<source->GetEdgeCount(); i++)
+	{
+		auto edge = source->GetEdgeByIndex(i);
+		if( (edge->m_destnode == dest) && (edge->m_sourceport == srcport) && (edge->m_destport == dstport) )
+			return true;
+	}
+	return false;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Port name interning
+
+/**
+	@brief Look up the ID for a port name, allocating a new one if we haven't seen it before
+ */
+uint16_t PARGraph::InternPort(const string& name)
+{
+	lock_guard<mutex> lock(m_portMutex);
+
+	auto it = m_portIDs.find(name);
+	if(it != m_portIDs.end())
+		return it->second;
+
+	if(m_portNames.size() > 0xffff)
+		LogFatal("Too many distinct port names (max 65536)\n");
+
+	uint16_t id = m_portNames.size();
+	m_portNames.push_back(name);
+	m_portIDs[name] = id;
+	return id;
+}
+
+const string& PARGraph::GetPortName(uint16_t id)
+{
+	lock_guard<mutex> lock(m_portMutex);
+	return m_portNames[id];
+}
+
+uint32_t PARGraph::GetNumPorts()
+{
+	lock_guard<mutex> lock(m_portMutex);
+	return m_portNames.size();
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
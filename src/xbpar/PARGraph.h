@@ -21,8 +21,63 @@
 
 #include <cstdint>
 #include <vector>
+#include <string>
+#include <map>
+#include <deque>
+#include <mutex>
+#include <functional>
+#include <memory>
+#include <unordered_set>
+#include "PARGraphNet.h"
 
 class PARGraphNode;
+class PARGraphEdge;
+class PARAdjacency;
+
+/**
+	@brief Key for looking up an edge by its endpoints.
+
+	Nodes are identified by index rather than pointer, so an index can be shared by clones of the same graph.
+ */
+class PARGraphEdgeKey
+{
+public:
+	PARGraphEdgeKey(uint32_t source, uint16_t srcport, uint32_t dest, uint16_t dstport)
+		: m_sourcenode(source)
+		, m_destnode(dest)
+		, m_sourceport(srcport)
+		, m_destport(dstport)
+	{
+	}
+
+	bool operator==(const PARGraphEdgeKey& rhs) const
+	{
+		return
+			(m_sourcenode == rhs.m_sourcenode) &&
+			(m_destnode == rhs.m_destnode) &&
+			(m_sourceport == rhs.m_sourceport) &&
+			(m_destport == rhs.m_destport);
+	}
+
+	uint32_t m_sourcenode;
+	uint32_t m_destnode;
+	uint16_t m_sourceport;
+	uint16_t m_destport;
+};
+
+class PARGraphEdgeKeyHash
+{
+public:
+	size_t operator()(const PARGraphEdgeKey& key) const
+	{
+		size_t h = key.m_sourcenode;
+		h = h*31 + key.m_destnode;
+		h = h*31 + ( (static_cast<size_t>(key.m_sourceport) << 16) | key.m_destport );
+		return h;
+	}
+};
+
+typedef std::unordered_set<PARGraphEdgeKey, PARGraphEdgeKeyHash> PARGraphEdgeIndex;
 
 /**
 	@brief A place-and-route graph (may be either a netlist or a device)
@@ -48,11 +103,75 @@ public:
 
 	//Net iteration
 	uint32_t GetNumEdges();
+	uint64_t GetNumFabricEdges();
+
+	/**
+		@brief Returns the number of nets (source ports with at least one edge). Zero until the graph is frozen.
+	 */
+	uint32_t GetNumNets()
+	{ return m_nets.size(); }
+
+	PARGraphNet* GetNetByIndex(uint32_t index)
+	{ return &m_nets[index]; }
+
+	//Edge lookup
+	void IndexEdges();
+	bool IsEdgeIndexValid()
+	{ return m_edgeIndexValid; }
+	void InvalidateEdgeIndex()
+	{ m_edgeIndexValid = false; m_edgeIndex.reset(); m_adjacency.reset(); }
+	bool HasEdge(PARGraphNode* source, uint16_t srcport, PARGraphNode* dest, uint16_t dstport);
+
+	//Dense adjacency matrices (optional, for checking many edges at once)
+	void BuildAdjacency();
+
+	/**
+		@brief Returns the adjacency matrices, or NULL if BuildAdjacency() hasn't been called
+	 */
+	const PARAdjacency* GetAdjacency()
+	{ return m_adjacency.get(); }
+
+	//Port name interning (shared by all graphs, so IDs can be compared between netlist and device)
+	static uint16_t InternPort(const std::string& name);
+	static const std::string& GetPortName(uint16_t id);
+	static uint32_t GetNumPorts();
 
 	//Insertion
+	PARGraphNode* CreateNode(uint32_t label, void* pData);
 	void AddNode(PARGraphNode* node);
+	PARGraphEdge* AllocateEdge(PARGraphNode* source, uint16_t srcport, PARGraphNode* dest, uint16_t dstport);
+
+	//Copying
+	PARGraph* Clone();
+	static void ClonePair(PARGraph* netlist, PARGraph* device, PARGraph*& nclone, PARGraph*& dclone);
+	static void CopyPlacement(PARGraph* fromNetlist, PARGraph* toNetlist, PARGraph* toDevice);
+
+	//Placement state
+	static const uint16_t NO_MATE = 0xffff;
+
+	/**
+		@brief Returns the node in the paired graph mated with our node at a given index, or NULL if none
+	 */
+	PARGraphNode* GetMateOf(uint32_t index)
+	{
+		uint16_t mate = m_mates[index];
+		return (mate == NO_MATE) ? NULL : m_mateGraph->m_nodes[mate];
+	}
+
+	const std::vector<uint16_t>& GetMateArray()
+	{ return m_mates; }
+
+	//Placement snapshots (netlist graphs only)
+	void SavePlacement(std::vector<uint16_t>& placement);
+	void RestorePlacement(const std::vector<uint16_t>& placement, PARGraph* device);
+
+	//Packing of edges into flat storage once topology is final
+	void Freeze();
+	bool IsFrozen()
+	{ return m_frozen; }
 
 protected:
+	friend class PARGraphNode;
 
 	typedef std::vector<PARGraphNode*> NodeVector;
 
@@ -61,6 +180,20 @@ protected:
 	 */
 	NodeVector m_nodes;
 
+	/**
+		@brief Placement state: for each of our nodes, the index of its mate in m_mateGraph (or NO_MATE).
+
+		A netlist graph and a device graph become paired the first time a node in one is mated with a node in the
+		other, and each holds the inverse of the other's array.
+	 */
+	std::vector<uint16_t> m_mates;
+	PARGraph* m_mateGraph;
+
+	/**
+		@brief Backing storage for nodes created by CreateNode() and their edges
+	 */
+	PARArena m_arena;
+
 	/**
 		@brief The highest label allocated to date.
 	 */
@@ -70,6 +203,47 @@ protected:
 		@brief Set of nodes sorted by label
 	 */
 	std::vector< NodeVector > m_labeledNodes;
+
+	/**
+		@brief Set of all edges in the graph, hashed by endpoints. Only valid if m_edgeIndexValid is set.
+
+		Changing edges after IndexEdges() must be followed by InvalidateEdgeIndex() or another call to IndexEdges().
+		The index is immutable once built, and shared with any clones of this graph.
+	 */
+	std::shared_ptr<const PARGraphEdgeIndex> m_edgeIndex;
+	bool m_edgeIndexValid;
+
+	/**
+		@brief Bit-matrix form of the edges (NULL if not built). Like the edge index, it's immutable once built, shared
+		with any clones of this graph, and dropped by InvalidateEdgeIndex().
+	 */
+	std::shared_ptr<const PARAdjacency> m_adjacency;
+
+	/**
+		@brief Flat array of all edges, grouped by source node, once the graph is frozen.
+
+		m_edgeOffsets[i] is the index of the first edge of node i (with one extra entry at the end).
+	 */
+	std::vector<PARGraphEdge> m_edgeArray;
+	std::vector<uint32_t> m_edgeOffsets;
+	bool m_frozen;
+
+	/**
+		@brief The nets, built by Freeze(): every edge of one source port, numbered in node order and then in the
+		order each port's first edge appears. m_netSinks holds the sink edges of all nets back to back.
+	 */
+	std::vector<PARGraphNet> m_nets;
+	std::vector<PARGraphEdge*> m_netSinks;
+
+	/**
+		@brief Port name for each interned port ID, and the inverse mapping.
+
+		Graphs for unrelated designs may be built on different threads at once, so these are guarded by
+		m_portMutex. A deque is used so names already handed out by GetPortName() never move.
+	 */
+	static std::deque<std::string> m_portNames;
+	static std::map<std::string, uint16_t> m_portIDs;
+	static std::mutex m_portMutex;
 };
 
 #endif
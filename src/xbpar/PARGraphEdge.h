@@ -0,0 +1,69 @@
+/***********************************************************************************************************************
+ * Copyright (C) 2016 Andrew Zonenberg and contributors                                                                *
+ *                                                                                                                     *
+ * This program is free software; you can redistribute it and/or modify it under the terms of the GNU Lesser General   *
+ * Public License as published by the Free Software Foundation; either version 2.1 of the License, or (at your option) *
+ * any later version.                                                                                                  *
+ *                                                                                                                     *
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied  *
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for     *
+ * more details.                                                                                                       *
+ *                                                                                                                     *
+ * You should have received a copy of the GNU Lesser General Public License along with this program; if not, you may   *
+ * find one here:                                                                                                      *
+ * https://www.gnu.org/licenses/old-licenses/lgpl-2.1.txt                                                              *
+ * or you may search the http://www.gnu.org website for the version 2.1 license, or you may write to the Free Software *
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA                                      *
+ **********************************************************************************************************************/
+
+#ifndef PARGraphEdge_h
+#define PARGraphEdge_h
+
+#include <cstdint>
+#include <string>
+
+class PARGraphNode;
+
+/**
+	@brief A single directed edge in a place-and-route graph
+ */
+class PARGraphEdge
+{
+public:
+
+	PARGraphEdge(PARGraphNode* source, uint16_t srcport, PARGraphNode* dest, uint16_t dstport)
+		: m_sourcenode(source)
+		, m_sourceport(srcport)
+		, m_destnode(dest)
+		, m_destport(dstport)
+		, m_free(false)
+		, m_net(NO_NET)
+	{
+	}
+
+	const std::string& GetSourcePortName() const;
+	const std::string& GetDestPortName() const;
+
+	//the source node
+	PARGraphNode* m_sourcenode;
+
+	//output port ID (see PARGraph::InternPort) on the source node
+	uint16_t m_sourceport;
+
+	//the destination node
+	PARGraphNode* m_destnode;
+
+	//input port ID on the destination node
+	uint16_t m_destport;
+
+	//set if this edge is routable and uses no shared resources wherever its ends are placed (e.g. a constant every
+	//matrix can supply locally). PAREngine leaves such edges out of every cost, including timing.
+	bool m_free;
+
+	//index of the net this edge is part of (see PARGraph::GetNetByIndex()), or NO_NET if the graph isn't frozen
+	uint32_t m_net;
+
+	static const uint32_t NO_NET = 0xffffffff;
+};
+
+#endif
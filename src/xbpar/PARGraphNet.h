@@ -0,0 +1,66 @@
+/***********************************************************************************************************************
+ * Copyright (C) 2016 Andrew Zonenberg and contributors                                                                *
+ *                                                                                                                     *
+ * This program is free software; you can redistribute it and/or modify it under the terms of the GNU Lesser General   *
+ * Public License as published by the Free Software Foundation; either version 2.1 of the License, or (at your option) *
+ * any later version.                                                                                                  *
+ *                                                                                                                     *
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied  *
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for     *
+ * more details.                                                                                                       *
+ *                                                                                                                     *
+ * You should have received a copy of the GNU Lesser General Public License along with this program; if not, you may   *
+ * find one here:                                                                                                      *
+ * https://www.gnu.org/licenses/old-licenses/lgpl-2.1.txt                                                              *
+ * or you may search the http://www.gnu.org website for the version 2.1 license, or you may write to the Free Software *
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA                                      *
+ **********************************************************************************************************************/
+
+#ifndef PARGraphNet_h
+#define PARGraphNet_h
+
+#include <cstdint>
+
+class PARGraphNode;
+class PARGraphEdge;
+
+/**
+	@brief One signal in a frozen place-and-route graph: a source port and every edge it drives.
+
+	The graph still stores one edge per sink (that's what the placer routes), but each edge knows which net it belongs
+	to (PARGraphEdge::m_net), so costs which depend on the signal rather than the individual sink (such as sharing one
+	routing resource between every load of a net) can index flat arrays by net instead of re-discovering it.
+ */
+class PARGraphNet
+{
+public:
+	PARGraphNet(PARGraphNode* source, uint16_t srcport, PARGraphEdge** sinks, uint32_t count)
+		: m_sourcenode(source)
+		, m_sourceport(srcport)
+		, m_sinks(sinks)
+		, m_sinkCount(count)
+	{
+	}
+
+	uint32_t GetSinkCount() const
+	{ return m_sinkCount; }
+
+	/**
+		@brief Returns the edge to one of our sinks, in the order the source node's edges are stored
+	 */
+	PARGraphEdge* GetSink(uint32_t i) const
+	{ return m_sinks[i]; }
+
+	//the source node
+	PARGraphNode* m_sourcenode;
+
+	//output port ID on the source node
+	uint16_t m_sourceport;
+
+protected:
+	//The edges to our sinks (points into the graph's flat list)
+	PARGraphEdge** m_sinks;
+	uint32_t m_sinkCount;
+};
+
+#endif
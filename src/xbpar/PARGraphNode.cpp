@@ -16,64 +16,116 @@
  * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA                                      *
  **********************************************************************************************************************/
 
+#include <algorithm>
+#include <log.h>
 #include <xbpar.h>
 
 using namespace std;
 
+const uint32_t PARGraphNode::LABEL_MASK_BITS;
+const uint32_t PARGraphEdge::NO_NET;
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// PARGraphEdge
+
+const string& PARGraphEdge::GetSourcePortName() const
+{
+	return PARGraph::GetPortName(m_sourceport);
+}
+
+const string& PARGraphEdge::GetDestPortName() const
+{
+	return PARGraph::GetPortName(m_destport);
+}
+
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 // Construction / destruction
 
 PARGraphNode::PARGraphNode(uint32_t label, void* pData)
 	: m_label(label)
 	, m_pData(pData)
-	, m_mate(NULL)
+	, m_index(0)
+	, m_owner(NULL)
+	, m_graph(NULL)
+	, m_frozen(false)
+	, m_frozenEdges(NULL)
+	, m_frozenEdgeCount(0)
 {
+	UpdateLabelMask();
 }
 
 PARGraphNode::~PARGraphNode()
 {
-	for(auto x : m_edges)
-		delete x;
+	//Arena-allocated edges are freed by the graph
+	if(m_graph == NULL)
+	{
+		for(auto x : m_edges)
+			delete x;
+	}
 	m_edges.clear();
 }
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 // Accessors
 
+/**
+	@brief Mates this node with a node in the other graph (or unmates it, if mate is NULL).
+
+	Any previous mates of either node are unmated.
+ */
 void PARGraphNode::MateWith(PARGraphNode* mate)
 {
+	PARGraph* graph = m_owner;
+
 	//Clear our prior mate, if any
-	//need to set m_mate to null FIRST to avoid infinite recursion
-	if(m_mate != NULL)
+	uint16_t old = graph->m_mates[m_index];
+	if(old != PARGraph::NO_MATE)
 	{
-		PARGraphNode* oldmate = m_mate;
-		m_mate = NULL;
-		oldmate->MateWith(NULL);
+		graph->m_mateGraph->m_mates[old] = PARGraph::NO_MATE;
+		graph->m_mates[m_index] = PARGraph::NO_MATE;
 	}
+	if(mate == NULL)
+		return;
 
-	//Valid mate, set up back pointer
-	//Clear out old partner of the new mating node, of any
-	if(mate != NULL)
-	{
-		mate->MateWith(NULL);
-		mate->m_mate = this;
-	}
+	//Pair up the graphs the first time we're used
+	PARGraph* mgraph = mate->m_owner;
+	if(graph->m_mateGraph == NULL)
+		graph->m_mateGraph = mgraph;
+	if(mgraph->m_mateGraph == NULL)
+		mgraph->m_mateGraph = graph;
+	if( (graph->m_mateGraph != mgraph) || (mgraph->m_mateGraph != graph) )
+		LogFatal("Tried to mate nodes in two graphs that aren't paired with each other\n");
 
-	//and set the forward pointer regardless
-	m_mate = mate;
+	//Clear out old partner of the new mating node, if any, then link both ways
+	uint16_t mold = mgraph->m_mates[mate->m_index];
+	if(mold != PARGraph::NO_MATE)
+		graph->m_mates[mold] = PARGraph::NO_MATE;
+	mgraph->m_mates[mate->m_index] = m_index;
+	graph->m_mates[m_index] = mate->m_index;
 }
 
-uint32_t PARGraphNode::GetEdgeCount()
+/**
+	@brief Changes the primary label of this node
+ */
+void PARGraphNode::Relabel(uint32_t label)
 {
-	return m_edges.size();
+	m_label = label;
+	UpdateLabelMask();
 }
 
-PARGraphEdge* PARGraphNode::GetEdgeByIndex(uint32_t index)
+/**
+	@brief Adds another label of netlist nodes which may be mapped to this one
+ */
+void PARGraphNode::AddAlternateLabel(uint32_t alt)
 {
-	return m_edges[index];
+	m_alternateLabels.push_back(alt);
+	UpdateLabelMask();
 }
 
-bool PARGraphNode::MatchesLabel(uint32_t target)
+/**
+	@brief Handles labels too big for m_labelMask
+ */
+bool PARGraphNode::MatchesLabelSlow(uint32_t target)
 {
 	if(m_label == target)
 		return true;
@@ -85,25 +137,99 @@ bool PARGraphNode::MatchesLabel(uint32_t target)
 	return false;
 }
 
+/**
+	@brief Rebuilds m_labelMask from the primary and alternate labels
+ */
+void PARGraphNode::UpdateLabelMask()
+{
+	m_labelMask = 0;
+	if(m_label < LABEL_MASK_BITS)
+		m_labelMask |= 1ULL << m_label;
+	for(auto x : m_alternateLabels)
+	{
+		if(x < LABEL_MASK_BITS)
+			m_labelMask |= 1ULL << x;
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// General fabric routing
+
+void PARGraphNode::AddFabricOutput(string port)
+{
+	AddFabricOutput(PARGraph::InternPort(port));
+}
+
+void PARGraphNode::AddFabricInput(string port)
+{
+	AddFabricInput(PARGraph::InternPort(port));
+}
+
+/**
+	@brief Marks a port as connected to general fabric routing, given an ID already returned by PARGraph::InternPort()
+ */
+void PARGraphNode::AddFabricOutput(uint16_t port)
+{
+	auto it = lower_bound(m_fabricOutputs.begin(), m_fabricOutputs.end(), port);
+	if( (it == m_fabricOutputs.end()) || (*it != port) )
+		m_fabricOutputs.insert(it, port);
+}
+
+void PARGraphNode::AddFabricInput(uint16_t port)
+{
+	auto it = lower_bound(m_fabricInputs.begin(), m_fabricInputs.end(), port);
+	if( (it == m_fabricInputs.end()) || (*it != port) )
+		m_fabricInputs.insert(it, port);
+}
+
+bool PARGraphNode::HasFabricOutput(uint16_t port)
+{
+	return binary_search(m_fabricOutputs.begin(), m_fabricOutputs.end(), port);
+}
+
+bool PARGraphNode::HasFabricInput(uint16_t port)
+{
+	return binary_search(m_fabricInputs.begin(), m_fabricInputs.end(), port);
+}
+
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 // Topology modification
 
+void PARGraphNode::AddEdge(string srcport, PARGraphNode* sink, string dstport)
+{
+	if(m_frozen)
+		LogFatal("Tried to add an edge to a node in a frozen graph\n");
+
+	uint16_t srcid = PARGraph::InternPort(srcport);
+	uint16_t dstid = PARGraph::InternPort(dstport);
+	if(m_graph)
+		m_edges.push_back(m_graph->AllocateEdge(this, srcid, sink, dstid));
+	else
+		m_edges.push_back(new PARGraphEdge(this, srcid, sink, dstid));
+}
+
 /**
 	@brief Remove the given edge, if found
  */
 void PARGraphNode::RemoveEdge(string srcport, PARGraphNode* sink, string dstport)
 {
+	if(m_frozen)
+		LogFatal("Tried to remove an edge from a node in a frozen graph\n");
+
+	uint16_t srcid = PARGraph::InternPort(srcport);
+	uint16_t dstid = PARGraph::InternPort(dstport);
 	for(ssize_t i=m_edges.size()-1; i>=0; i--)
 	{
 		//skip if not a match
 		auto edge = m_edges[i];
-		if( (edge->m_sourceport != srcport) || (edge->m_destport != dstport) )
+		if( (edge->m_sourceport != srcid) || (edge->m_destport != dstid) )
 			continue;
 		if(edge->m_destnode != sink)
 			continue;
 
 		//Match, remove it
-		delete edge;
+		if(m_graph == NULL)
+			delete edge;
 		m_edges.erase(m_edges.begin() + i);
 	}
 }
@@ -23,31 +23,6 @@
 #include <string>
 #include <set>
 
-class PARGraphEdge
-{
-public:
-
-	PARGraphEdge(PARGraphNode* source, std::string srcport, PARGraphNode* dest, std::string dstport)
-		: m_sourcenode(source)
-		, m_sourceport(srcport)
-		, m_destnode(dest)
-		, m_destport(dstport)
-	{
-	}
-
-	//the source node
-	PARGraphNode* m_sourcenode;
-
-	//output port name on the source node
-	std::string m_sourceport;
-
-	//the destination node
-	PARGraphNode* m_destnode;
-
-	//input port name on the destination node
-	std::string m_destport;
-};
-
 /**
 	@brief A single node in a place-and-route graph
  */
@@ -61,28 +36,57 @@ public:
 
 	//do not call during PAR, only during initialization of constraints
 	//or caches will get very confused
-	void Relabel(uint32_t label)
-	{ m_label = label; }
+	void Relabel(uint32_t label);
 
 	uint32_t GetLabel()
 	{ return m_label; }
 
+	/**
+		@brief Returns the node in the paired graph we're mated with, or NULL if none. Only valid once in a graph.
+	 */
 	PARGraphNode* GetMate()
-	{ return m_mate; }
+	{ return m_owner->GetMateOf(m_index); }
+
+	uint32_t GetIndex()
+	{ return m_index; }
+
+	uint32_t GetEdgeCount()
+	{ return m_frozen ? m_frozenEdgeCount : m_edges.size(); }
 
-	uint32_t GetEdgeCount();
-	PARGraphEdge* GetEdgeByIndex(uint32_t index);
+	PARGraphEdge* GetEdgeByIndex(uint32_t index)
+	{ return m_frozen ? (m_frozenEdges + index) : m_edges[index]; }
 
-	void AddEdge(std::string srcport, PARGraphNode* sink, std::string dstport = "")
-	{ m_edges.push_back(new PARGraphEdge(this, srcport, sink, dstport)); }
+	void AddEdge(std::string srcport, PARGraphNode* sink, std::string dstport = "");
 
 	void RemoveEdge(std::string srcport, PARGraphNode* sink, std::string dstport);
 
+	//General fabric routing: any fabric output port can reach any fabric input port, with no explicit edge
+	void AddFabricOutput(std::string port);
+	void AddFabricInput(std::string port);
+	void AddFabricOutput(uint16_t port);
+	void AddFabricInput(uint16_t port);
+	bool HasFabricOutput(uint16_t port);
+	bool HasFabricInput(uint16_t port);
+
+	uint32_t GetFabricOutputCount()
+	{ return m_fabricOutputs.size(); }
+
+	uint32_t GetFabricInputCount()
+	{ return m_fabricInputs.size(); }
+
+	uint16_t GetFabricOutput(uint32_t i)
+	{ return m_fabricOutputs[i]; }
+
+	uint16_t GetFabricInput(uint32_t i)
+	{ return m_fabricInputs[i]; }
+
 	void* GetData()
 	{ return m_pData; }
 
-	void AddAlternateLabel(uint32_t alt)
-	{ m_alternateLabels.push_back(alt); }
+	void SetData(void* pData)
+	{ m_pData = pData; }
+
+	void AddAlternateLabel(uint32_t alt);
 
 	uint32_t GetAlternateLabelCount()
 	{ return m_alternateLabels.size(); }
@@ -90,9 +94,32 @@ public:
 	uint32_t GetAlternateLabel(uint32_t i)
 	{ return m_alternateLabels[i]; }
 
-	bool MatchesLabel(uint32_t target);
+	/**
+		@brief Checks if a node with the given label may be mapped to this one (primary or alternate label)
+	 */
+	bool MatchesLabel(uint32_t target)
+	{
+		if(target < LABEL_MASK_BITS)
+			return (m_labelMask >> target) & 1;
+		return MatchesLabelSlow(target);
+	}
+
+	/**
+		@brief Bitmask of every label below LABEL_MASK_BITS this node accepts (bit N set = matches label N).
+
+		Lets callers test a node against a whole set of labels with one AND. Higher labels are not represented
+		here, use MatchesLabel() for those.
+	 */
+	uint64_t GetLabelMask()
+	{ return m_labelMask; }
+
+	static const uint32_t LABEL_MASK_BITS = 64;
 
 protected:
+	friend class PARGraph;
+
+	bool MatchesLabelSlow(uint32_t target);
+	void UpdateLabelMask();
 
 	/**
 		@brief Label of this node. All nodes with the same label in a given graph are indistinguishable.
@@ -111,22 +138,50 @@ protected:
 	 */
 	std::vector<uint32_t> m_alternateLabels;
 
+	/**
+		@brief Bitmask form of m_label and m_alternateLabels, for labels below LABEL_MASK_BITS
+	 */
+	uint64_t m_labelMask;
+
 	/**
 		@brief Pointer to the external node (netlist or device entity) associated with this PAR node
 	 */
 	void* m_pData;
 
 	/**
-		@brief Pointer to the mating node of this one.
+		@brief List of all outbound edges from this node (dedicated routing only, not general fabric)
+	 */
+	std::vector<PARGraphEdge*> m_edges;
+
+	/**
+		@brief Position of this node in its graph's node list
+	 */
+	uint32_t m_index;
+
+	/**
+		@brief The graph this node has been added to.
 
-		For the netlist, this points to a device node. For the device, this points to a netlist node.
+		Our mate is stored there, in a flat array: for the netlist it is a device node, for the device a netlist node.
 	 */
-	PARGraphNode* m_mate;
+	PARGraph* m_owner;
 
 	/**
-		@brief List of all outbound edges from this node
+		@brief The graph whose arena this node (and its edges) were allocated from, or NULL if allocated with new
 	 */
-	std::vector<PARGraphEdge*> m_edges;
+	PARGraph* m_graph;
+
+	/**
+		@brief Once the graph is frozen, our edges live in the graph's flat edge array instead of m_edges
+	 */
+	bool m_frozen;
+	PARGraphEdge* m_frozenEdges;
+	uint32_t m_frozenEdgeCount;
+
+	/**
+		@brief Sorted lists of port IDs connected to the general fabric routing
+	 */
+	std::vector<uint16_t> m_fabricOutputs;
+	std::vector<uint16_t> m_fabricInputs;
 };
 
 #endif
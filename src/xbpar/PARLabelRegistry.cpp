@@ -0,0 +1,85 @@
+/***********************************************************************************************************************
+ * Copyright (C) 2016 Andrew Zonenberg and contributors                                                                *
+ *                                                                                                                     *
+ * This program is free software; you can redistribute it and/or modify it under the terms of the GNU Lesser General   *
+ * Public License as published by the Free Software Foundation; either version 2.1 of the License, or (at your option) *
+ * any later version.                                                                                                  *
+ *                                                                                                                     *
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied  *
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for     *
+ * more details.                                                                                                       *
+ *                                                                                                                     *
+ * You should have received a copy of the GNU Lesser General Public License along with this program; if not, you may   *
+ * find one here:                                                                                                      *
+ * https://www.gnu.org/licenses/old-licenses/lgpl-2.1.txt                                                              *
+ * or you may search the http://www.gnu.org website for the version 2.1 license, or you may write to the Free Software *
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA                                      *
+ **********************************************************************************************************************/
+
+#include <algorithm>
+#include <xbpar.h>
+
+using namespace std;
+
+PARLabelRegistry::PARLabelRegistry()
+	: m_regionCount(0)
+	, m_indexed(false)
+{
+}
+
+/**
+	@brief Names a label (called by whoever allocates it)
+ */
+void PARLabelRegistry::SetName(uint32_t label, const string& name)
+{
+	if(label >= m_names.size())
+		m_names.resize(label + 1);
+	m_names[label] = name;
+}
+
+/**
+	@brief Builds the site tables from a complete device graph. Any existing tables are replaced.
+
+	@param device		The device graph. Its nodes must already be indexed by label (see
+						PARGraph::IndexNodesByLabel()).
+	@param nregions		Number of regions to split the sites into (1 if the device doesn't have any)
+	@param region		Returns the region a site is in (0 to nregions-1)
+ */
+void PARLabelRegistry::IndexSites(
+	PARGraph* device,
+	uint32_t nregions,
+	const function<uint32_t(PARGraphNode*)>& region)
+{
+	uint32_t ndev = device->GetMaxLabel() + 1;
+	uint32_t nlabels = max(static_cast<uint32_t>(m_names.size()), ndev);
+	m_names.resize(nlabels);
+
+	m_siteCounts.assign(nlabels, 0);
+	m_regionCount = nregions;
+	m_sites.assign(static_cast<size_t>(nregions) * nlabels, vector<uint32_t>());
+	for(uint32_t label=0; label<ndev; label++)
+	{
+		m_siteCounts[label] = device->GetNumNodesWithLabel(label);
+		for(uint32_t i=0; i<m_siteCounts[label]; i++)
+		{
+			PARGraphNode* site = device->GetNodeByLabelAndIndex(label, i);
+			m_sites[region(site)*nlabels + label].push_back(site->GetIndex());
+		}
+	}
+
+	m_alternates.assign(nlabels, vector<uint32_t>());
+	for(uint32_t i=0; i<device->GetNumNodes(); i++)
+	{
+		PARGraphNode* site = device->GetNodeByIndex(i);
+		auto& alternates = m_alternates[site->GetLabel()];
+		for(uint32_t j=0; j<site->GetAlternateLabelCount(); j++)
+			alternates.push_back(site->GetAlternateLabel(j));
+	}
+	for(auto& alternates : m_alternates)
+	{
+		sort(alternates.begin(), alternates.end());
+		alternates.erase(unique(alternates.begin(), alternates.end()), alternates.end());
+	}
+
+	m_indexed = true;
+}
@@ -0,0 +1,111 @@
+/***********************************************************************************************************************
+ * Copyright (C) 2016 Andrew Zonenberg and contributors                                                                *
+ *                                                                                                                     *
+ * This program is free software; you can redistribute it and/or modify it under the terms of the GNU Lesser General   *
+ * Public License as published by the Free Software Foundation; either version 2.1 of the License, or (at your option) *
+ * any later version.                                                                                                  *
+ *                                                                                                                     *
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied  *
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for     *
+ * more details.                                                                                                       *
+ *                                                                                                                     *
+ * You should have received a copy of the GNU Lesser General Public License along with this program; if not, you may   *
+ * find one here:                                                                                                      *
+ * https://www.gnu.org/licenses/old-licenses/lgpl-2.1.txt                                                              *
+ * or you may search the http://www.gnu.org website for the version 2.1 license, or you may write to the Free Software *
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA                                      *
+ **********************************************************************************************************************/
+
+#ifndef PARLabelRegistry_h
+#define PARLabelRegistry_h
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+class PARGraph;
+class PARGraphNode;
+
+/**
+	@brief Everything known about the labels of a netlist/device graph pair, in flat arrays indexed by label.
+
+	Names are added as the labels are allocated, and the site tables are filled in by IndexSites() once the device
+	graph is complete. Read-only from then on, so one registry can be shared by every engine working on clones of the
+	same graphs (site lists hold device node indexes rather than pointers for the same reason).
+ */
+class PARLabelRegistry
+{
+public:
+	PARLabelRegistry();
+
+	void SetName(uint32_t label, const std::string& name);
+	void IndexSites(PARGraph* device, uint32_t nregions, const std::function<uint32_t(PARGraphNode*)>& region);
+
+	/**
+		@brief Returns the number of labels we know about (one more than the highest named or indexed one)
+	 */
+	uint32_t GetNumLabels() const
+	{ return m_names.size(); }
+
+	/**
+		@brief Returns the name of a label, or an empty string if it doesn't have one
+	 */
+	const std::string& GetName(uint32_t label) const
+	{ return (label < m_names.size()) ? m_names[label] : m_unnamed; }
+
+	/**
+		@brief Returns true if IndexSites() has been called
+	 */
+	bool IsIndexed() const
+	{ return m_indexed; }
+
+	/**
+		@brief Returns the number of device sites that can hold a node with a label (by primary or alternate label)
+	 */
+	uint32_t GetSiteCount(uint32_t label) const
+	{ return (label < m_siteCounts.size()) ? m_siteCounts[label] : 0; }
+
+	/**
+		@brief Returns the other labels that sites whose primary label is this one can also hold, in ascending order
+	 */
+	const std::vector<uint32_t>& GetAlternates(uint32_t label) const
+	{ return (label < m_alternates.size()) ? m_alternates[label] : m_none; }
+
+	/**
+		@brief Returns the number of regions the sites were split into by IndexSites()
+	 */
+	uint32_t GetRegionCount() const
+	{ return m_regionCount; }
+
+	/**
+		@brief Returns the indexes of the device sites in a region that can hold a label, in the same order as
+		PARGraph::GetNodeByLabelAndIndex() visits them
+	 */
+	const std::vector<uint32_t>& GetSites(uint32_t label, uint32_t region) const
+	{
+		return ( (label < m_names.size()) && (region < m_regionCount) ) ?
+			m_sites[region*m_names.size() + label] : m_none;
+	}
+
+protected:
+
+	//Name of each label
+	std::vector<std::string> m_names;
+
+	//Number of sites for each label, and the alternates of each primary label
+	std::vector<uint32_t> m_siteCounts;
+	std::vector< std::vector<uint32_t> > m_alternates;
+
+	//Sites for each label in each region, indexed [region*GetNumLabels() + label]
+	uint32_t m_regionCount;
+	std::vector< std::vector<uint32_t> > m_sites;
+
+	bool m_indexed;
+
+	//Returned for out of range queries
+	std::string m_unnamed;
+	std::vector<uint32_t> m_none;
+};
+
+#endif
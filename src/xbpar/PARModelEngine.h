@@ -0,0 +1,75 @@
+/***********************************************************************************************************************
+ * Copyright (C) 2016 Andrew Zonenberg and contributors                                                                *
+ *                                                                                                                     *
+ * This program is free software; you can redistribute it and/or modify it under the terms of the GNU Lesser General   *
+ * Public License as published by the Free Software Foundation; either version 2.1 of the License, or (at your option) *
+ * any later version.                                                                                                  *
+ *                                                                                                                     *
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied  *
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for     *
+ * more details.                                                                                                       *
+ *                                                                                                                     *
+ * You should have received a copy of the GNU Lesser General Public License along with this program; if not, you may   *
+ * find one here:                                                                                                      *
+ * https://www.gnu.org/licenses/old-licenses/lgpl-2.1.txt                                                              *
+ * or you may search the http://www.gnu.org website for the version 2.1 license, or you may write to the Free Software *
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA                                      *
+ **********************************************************************************************************************/
+
+
+#ifndef PARModelEngine_h
+#define PARModelEngine_h
+
+/**
+	@brief A PAREngine whose per-edge cost model is known at compile time.
+
+	T is the device-specific engine deriving from this class, and must provide non-virtual versions of the per-edge
+	congestion hooks:
+
+		int32_t EdgeCongestionBin(PARGraphEdge* edge);
+		uint32_t EdgeCongestionNet(PARGraphEdge* edge);
+
+	with the same meaning as GetEdgeCongestionBin() and GetEdgeCongestionNet(). The innermost cost loop calls them
+	directly, so they can be inlined into it. The virtual hooks are still implemented (on top of the same functions),
+	so anything using the plain PAREngine interface sees the same cost model.
+
+	Models should keep whatever per-site attributes they need in flat arrays indexed by node, rather than chasing
+	GetData() pointers, or most of the benefit is lost.
+ */
+template<class T>
+class PARModelEngine : public PAREngine
+{
+public:
+	PARModelEngine(PARGraph* netlist, PARGraph* device)
+		: PAREngine(netlist, device)
+	{
+	}
+
+protected:
+	T* GetModel()
+	{ return static_cast<T*>(this); }
+
+	virtual int32_t GetEdgeCongestionBin(PARGraphEdge* edge)
+	{ return GetModel()->EdgeCongestionBin(edge); }
+
+	virtual uint32_t GetEdgeCongestionNet(PARGraphEdge* edge)
+	{ return GetModel()->EdgeCongestionNet(edge); }
+
+	/**
+		@brief Same as PAREngine::UpdateNodeEdgeCosts(), but with the cost model inlined
+	 */
+	virtual void UpdateNodeEdgeCosts(PARGraphNode* node)
+	{
+		T* model = GetModel();
+		for(auto i : m_nodeEdges[node->GetIndex()])
+		{
+			PARGraphEdge* nedge = m_netlistEdges[i];
+			bool unroutable = !IsEdgeRoutable(nedge, nedge->m_sourcenode->GetMate(), nedge->m_destnode->GetMate());
+			int32_t bin = model->EdgeCongestionBin(nedge);
+			uint32_t net = (bin >= 0) ? model->EdgeCongestionNet(nedge) : UNSHARED_NET;
+			SetEdgeCost(i, unroutable, bin, net);
+		}
+	}
+};
+
+#endif
@@ -0,0 +1,176 @@
+/***********************************************************************************************************************
+ * Copyright (C) 2016 Andrew Zonenberg and contributors                                                                *
+ *                                                                                                                     *
+ * This program is free software; you can redistribute it and/or modify it under the terms of the GNU Lesser General   *
+ * Public License as published by the Free Software Foundation; either version 2.1 of the License, or (at your option) *
+ * any later version.                                                                                                  *
+ *                                                                                                                     *
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied  *
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for     *
+ * more details.                                                                                                       *
+ *                                                                                                                     *
+ * You should have received a copy of the GNU Lesser General Public License along with this program; if not, you may   *
+ * find one here:                                                                                                      *
+ * https://www.gnu.org/licenses/old-licenses/lgpl-2.1.txt                                                              *
+ * or you may search the http://www.gnu.org website for the version 2.1 license, or you may write to the Free Software *
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA                                      *
+ **********************************************************************************************************************/
+
+#include <log.h>
+#include <xbpar.h>
+
+using namespace std;
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Construction / destruction
+
+PARMoveGenerator::PARMoveGenerator(const string& name)
+	: m_name(name)
+{
+}
+
+PARMoveGenerator::~PARMoveGenerator()
+{
+}
+
+PARRelocateMoveGenerator::PARRelocateMoveGenerator()
+	: PARMoveGenerator("relocate")
+{
+}
+
+PARSwapChainMoveGenerator::PARSwapChainMoveGenerator(uint32_t length)
+	: PARMoveGenerator("swap chain")
+	, m_length(length)
+{
+}
+
+PARClusterMoveGenerator::PARClusterMoveGenerator(uint32_t max_size)
+	: PARMoveGenerator("cluster")
+	, m_maxSize(max_size)
+{
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Helpers
+
+/**
+	@brief Returns true if a netlist node was moved or displaced by any step of a move
+ */
+bool PARMoveGenerator::IsInMove(const PARMove& move, PARGraphNode* node)
+{
+	if(node == NULL)
+		return false;
+	for(auto& step : move)
+	{
+		if( (step.m_node == node) || (step.m_displaced == node) )
+			return true;
+	}
+	return false;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Move generation
+
+/**
+	@brief Picks a single-step move without making it.
+
+	Only generators for which IsSingleStep() is true implement this; the default never proposes anything.
+
+	@return True if a candidate was found
+ */
+bool PARMoveGenerator::ProposeStep(
+	PAREngine* /*engine*/,
+	vector<PARGraphNode*>& /*badnodes*/,
+	PARGraphNode*& /*node*/,
+	PARGraphNode*& /*site*/)
+{
+	return false;
+}
+
+bool PARRelocateMoveGenerator::ProposeMove(
+	PAREngine* engine,
+	vector<PARGraphNode*>& badnodes,
+	const PARLabelRegistry& labels,
+	PARMove& move)
+{
+	PARGraphNode* node;
+	PARGraphNode* site;
+	if(!ProposeStep(engine, badnodes, node, site))
+		return false;
+	return engine->TryMoveStep(move, node, site, labels);
+}
+
+bool PARRelocateMoveGenerator::ProposeStep(
+	PAREngine* engine,
+	vector<PARGraphNode*>& badnodes,
+	PARGraphNode*& node,
+	PARGraphNode*& site)
+{
+	node = badnodes[engine->m_random.NextBelow(badnodes.size())];
+	site = engine->GetNewPlacementForNode(node);
+	return (site != NULL);
+}
+
+bool PARSwapChainMoveGenerator::ProposeMove(
+	PAREngine* engine,
+	vector<PARGraphNode*>& badnodes,
+	const PARLabelRegistry& labels,
+	PARMove& move)
+{
+	PARGraphNode* node = badnodes[engine->m_random.NextBelow(badnodes.size())];
+	for(uint32_t i=0; i+1 < m_length; i++)
+	{
+		PARGraphNode* site = engine->GetNewPlacementForNode(node);
+		if(site == NULL)
+			return false;
+
+		//Every step has to displace a node we haven't touched yet, otherwise this is just a shorter chain
+		//(which the other generators already cover)
+		PARGraphNode* next = site->GetMate();
+		if( (next == NULL) || (next == node) || IsInMove(move, next) )
+			return false;
+
+		if(!engine->TryMoveStep(move, node, site, labels))
+			return false;
+		node = next;
+	}
+
+	return true;
+}
+
+bool PARClusterMoveGenerator::ProposeMove(
+	PAREngine* engine,
+	vector<PARGraphNode*>& badnodes,
+	const PARLabelRegistry& labels,
+	PARMove& move)
+{
+	PARGraphNode* pivot = badnodes[engine->m_random.NextBelow(badnodes.size())];
+	PARGraphNode* site = engine->GetNewPlacementForNode(pivot);
+	if(site == NULL)
+		return false;
+	if(!engine->TryMoveStep(move, pivot, site, labels))
+		return false;
+
+	//Pull neighbors after the pivot, starting from a random edge so we don't always favor the same ones
+	auto& edges = engine->m_nodeEdges[pivot->GetIndex()];
+	uint32_t nedges = edges.size();
+	uint32_t first = (nedges > 1) ? engine->m_random.NextBelow(nedges) : 0;
+	for(uint32_t i=0; (i < nedges) && (move.size() < m_maxSize); i++)
+	{
+		PARGraphEdge* edge = engine->m_netlistEdges[edges[(first + i) % nedges]];
+		PARGraphNode* other = (edge->m_sourcenode == pivot) ? edge->m_destnode : edge->m_sourcenode;
+		if(IsInMove(move, other) || (engine->GetPinnedSite(other) != NULL) )
+			continue;
+
+		//Don't push anything we already moved back out of its new site
+		PARGraphNode* near = engine->GetNewPlacementNear(other, site);
+		if( (near == NULL) || IsInMove(move, near->GetMate()) )
+			continue;
+
+		//Not being able to take one neighbor along isn't fatal, the rest of the cluster may still help
+		engine->TryMoveStep(move, other, near, labels);
+	}
+
+	//If no neighbors came along, this was a plain relocation
+	return (move.size() > 1);
+}
@@ -0,0 +1,187 @@
+/***********************************************************************************************************************
+ * Copyright (C) 2016 Andrew Zonenberg and contributors                                                                *
+ *                                                                                                                     *
+ * This program is free software; you can redistribute it and/or modify it under the terms of the GNU Lesser General   *
+ * Public License as published by the Free Software Foundation; either version 2.1 of the License, or (at your option) *
+ * any later version.                                                                                                  *
+ *                                                                                                                     *
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied  *
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for     *
+ * more details.                                                                                                       *
+ *                                                                                                                     *
+ * You should have received a copy of the GNU Lesser General Public License along with this program; if not, you may   *
+ * find one here:                                                                                                      *
+ * https://www.gnu.org/licenses/old-licenses/lgpl-2.1.txt                                                              *
+ * or you may search the http://www.gnu.org website for the version 2.1 license, or you may write to the Free Software *
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA                                      *
+ **********************************************************************************************************************/
+
+#ifndef PARMoveGenerator_h
+#define PARMoveGenerator_h
+
+#include <cstdint>
+#include <vector>
+#include <map>
+#include <string>
+
+class PAREngine;
+class PARGraphNode;
+
+/**
+	@brief One step of a trial move: a netlist node moved to a new site, swapping with whatever was there
+ */
+class PARMoveStep
+{
+public:
+	PARMoveStep(PARGraphNode* node, PARGraphNode* old_mate, PARGraphNode* displaced)
+		: m_node(node)
+		, m_oldMate(old_mate)
+		, m_displaced(displaced)
+	{}
+
+	/**
+		@brief The netlist node we moved
+	 */
+	PARGraphNode* m_node;
+
+	/**
+		@brief The device node it was at before
+	 */
+	PARGraphNode* m_oldMate;
+
+	/**
+		@brief The netlist node which was at the new site, and is now at m_oldMate (may be NULL)
+	 */
+	PARGraphNode* m_displaced;
+};
+
+/**
+	@brief A trial move, as the list of steps made so far (undone in reverse order)
+ */
+typedef std::vector<PARMoveStep> PARMove;
+
+/**
+	@brief A kind of annealing move.
+
+	The engine picks a generator at random for each move, favoring the ones whose moves have recently been accepted
+	most often (see PAREngine::UpdateMoveWeights()). A generator makes its move one step at a time with
+	PAREngine::TryMoveStep(), and the engine then keeps or undoes the whole move.
+ */
+class PARMoveGenerator
+{
+public:
+	PARMoveGenerator(const std::string& name);
+	virtual ~PARMoveGenerator();
+
+	const std::string& GetName()
+	{ return m_name; }
+
+	/**
+		@brief Makes a trial move involving at least one of the bad nodes.
+
+		@return True if a move was made, false if no legal move was found (any steps already made are undone by the
+				caller)
+	 */
+	virtual bool ProposeMove(
+		PAREngine* engine,
+		std::vector<PARGraphNode*>& badnodes,
+		const PARLabelRegistry& labels,
+		PARMove& move) =0;
+
+	/**
+		@brief True if every move is a single step, which ProposeStep() can pick without making it
+	 */
+	virtual bool IsSingleStep()
+	{ return false; }
+
+	virtual bool ProposeStep(
+		PAREngine* engine,
+		std::vector<PARGraphNode*>& badnodes,
+		PARGraphNode*& node,
+		PARGraphNode*& site);
+
+protected:
+	static bool IsInMove(const PARMove& move, PARGraphNode* node);
+
+	/**
+		@brief Human-readable name, for statistics
+	 */
+	std::string m_name;
+};
+
+/**
+	@brief Moves a random bad node to the site picked by PAREngine::GetNewPlacementForNode(), swapping if it's occupied.
+ */
+class PARRelocateMoveGenerator : public PARMoveGenerator
+{
+public:
+	PARRelocateMoveGenerator();
+
+	virtual bool ProposeMove(
+		PAREngine* engine,
+		std::vector<PARGraphNode*>& badnodes,
+		const PARLabelRegistry& labels,
+		PARMove& move);
+
+	virtual bool IsSingleStep()
+	{ return true; }
+
+	virtual bool ProposeStep(
+		PAREngine* engine,
+		std::vector<PARGraphNode*>& badnodes,
+		PARGraphNode*& node,
+		PARGraphNode*& site);
+};
+
+/**
+	@brief Rotates a chain of nodes: a bad node moves to the site picked for it, the node it displaces moves on to the
+	site picked for that one, and so on. The last node in the chain ends up in the first one's old site.
+
+	This reaches placements which need several nodes to move at once, where any single swap would be uphill.
+ */
+class PARSwapChainMoveGenerator : public PARMoveGenerator
+{
+public:
+	PARSwapChainMoveGenerator(uint32_t length = 3);
+
+	virtual bool ProposeMove(
+		PAREngine* engine,
+		std::vector<PARGraphNode*>& badnodes,
+		const PARLabelRegistry& labels,
+		PARMove& move);
+
+protected:
+
+	/**
+		@brief Number of nodes in the rotation
+	 */
+	uint32_t m_length;
+};
+
+/**
+	@brief Moves a bad node, then pulls its netlist neighbors after it (to the sites PAREngine::GetNewPlacementNear()
+	picks next to its new site).
+
+	Useful when tightly connected nodes have to move together (e.g. between routing regions), since moving any one of
+	them alone only makes things worse. Engines must implement GetNewPlacementNear() for this to do anything.
+ */
+class PARClusterMoveGenerator : public PARMoveGenerator
+{
+public:
+	PARClusterMoveGenerator(uint32_t max_size = 4);
+
+	virtual bool ProposeMove(
+		PAREngine* engine,
+		std::vector<PARGraphNode*>& badnodes,
+		const PARLabelRegistry& labels,
+		PARMove& move);
+
+protected:
+
+	/**
+		@brief Largest number of nodes to move at once (including the bad node)
+	 */
+	uint32_t m_maxSize;
+};
+
+#endif
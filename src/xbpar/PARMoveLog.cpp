@@ -0,0 +1,330 @@
+/***********************************************************************************************************************
+ * Copyright (C) 2016 Andrew Zonenberg and contributors                                                                *
+ *                                                                                                                     *
+ * This program is free software; you can redistribute it and/or modify it under the terms of the GNU Lesser General   *
+ * Public License as published by the Free Software Foundation; either version 2.1 of the License, or (at your option) *
+ * any later version.                                                                                                  *
+ *                                                                                                                     *
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied  *
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for     *
+ * more details.                                                                                                       *
+ *                                                                                                                     *
+ * You should have received a copy of the GNU Lesser General Public License along with this program; if not, you may   *
+ * find one here:                                                                                                      *
+ * https://www.gnu.org/licenses/old-licenses/lgpl-2.1.txt                                                              *
+ * or you may search the http://www.gnu.org website for the version 2.1 license, or you may write to the Free Software *
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA                                      *
+ **********************************************************************************************************************/
+
+#include <cstdio>
+#include <cstring>
+#include <log.h>
+#include <xbpar.h>
+
+using namespace std;
+
+const uint32_t PARMoveLog::NO_NODE;
+const uint32_t PARMoveLog::VERSION;
+
+static const char MOVE_LOG_MAGIC[8] = {'X', 'B', 'P', 'A', 'R', 'M', 'O', 'V'};
+static const size_t MOVE_LOG_HEADER_SIZE = 20;
+static const size_t MOVE_LOG_RECORD_SIZE = 22;
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Construction / destruction
+
+PARMoveLog::PARMoveLog()
+	: m_run(0)
+	, m_iteration(0)
+	, m_phaseTimes(PHASE_COUNT, 0)
+	, m_diverged(false)
+	, m_divergence(0)
+{
+}
+
+const char* PARMoveLog::GetPhaseName(Phase phase)
+{
+	switch(phase)
+	{
+		case PHASE_SCORE:
+			return "score";
+		case PHASE_FIND:
+			return "find nodes";
+		case PHASE_PROPOSE:
+			return "propose";
+		case PHASE_COMMIT:
+			return "commit";
+		case PHASE_REVERT:
+			return "revert";
+		default:
+			return "unknown";
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Recording
+
+/**
+	@brief Starts recording a new call to PAREngine::Anneal()
+ */
+void PARMoveLog::BeginRun(uint32_t seed)
+{
+	m_run = m_runSeeds.size();
+	m_iteration = 0;
+	m_runSeeds.push_back(seed);
+
+	//A different seed means everything after this will be different too, so stop comparing here
+	if(!m_referenceFile.empty() && !m_diverged)
+	{
+		if( (m_run >= m_referenceSeeds.size()) || (m_referenceSeeds[m_run] != seed) )
+		{
+			m_diverged = true;
+			m_divergence = m_records.size();
+		}
+	}
+}
+
+/**
+	@brief Records one move, and checks it against the reference if we're replaying one
+ */
+void PARMoveLog::Record(uint32_t generator, uint32_t node, uint32_t site, int32_t delta, bool accepted)
+{
+	PARMoveRecord record;
+	record.run = m_run;
+	record.iteration = m_iteration;
+	record.node = node;
+	record.site = site;
+	record.delta = delta;
+	record.generator = generator;
+	record.accepted = accepted;
+
+	if(!m_referenceFile.empty() && !m_diverged)
+	{
+		size_t i = m_records.size();
+		if( (i >= m_reference.size()) || (m_reference[i] != record) )
+		{
+			m_diverged = true;
+			m_divergence = i;
+		}
+	}
+
+	m_records.push_back(record);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Serialization
+
+static void WriteLE(vector<uint8_t>& out, uint64_t value, size_t bytes)
+{
+	for(size_t i=0; i<bytes; i++)
+		out.push_back(value >> (8*i));
+}
+
+static uint64_t ReadLE(const uint8_t* p, size_t bytes)
+{
+	uint64_t value = 0;
+	for(size_t i=0; i<bytes; i++)
+		value |= (uint64_t)p[i] << (8*i);
+	return value;
+}
+
+/**
+	@brief Saves everything recorded so far (see PARMoveRecord for the format)
+ */
+bool PARMoveLog::Write(const string& fname) const
+{
+	vector<uint8_t> out(MOVE_LOG_MAGIC, MOVE_LOG_MAGIC + sizeof(MOVE_LOG_MAGIC));
+	WriteLE(out, VERSION, 4);
+	WriteLE(out, m_records.size(), 4);
+	WriteLE(out, m_runSeeds.size(), 4);
+	for(auto& record : m_records)
+	{
+		WriteLE(out, record.run, 4);
+		WriteLE(out, record.iteration, 4);
+		WriteLE(out, record.node, 4);
+		WriteLE(out, record.site, 4);
+		WriteLE(out, (uint32_t)record.delta, 4);
+		WriteLE(out, record.generator, 1);
+		WriteLE(out, record.accepted, 1);
+	}
+	for(auto seed : m_runSeeds)
+		WriteLE(out, seed, 4);
+	for(auto t : m_phaseTimes)
+		WriteLE(out, t, 8);
+
+	FILE* fp = fopen(fname.c_str(), "wb");
+	if(!fp)
+	{
+		LogError("Couldn't open move log %s\n", fname.c_str());
+		return false;
+	}
+	bool ok = (fwrite(&out[0], 1, out.size(), fp) == out.size());
+	ok &= (fclose(fp) == 0);
+	if(!ok)
+	{
+		LogError("Couldn't write move log %s\n", fname.c_str());
+		return false;
+	}
+
+	LogVerbose("Wrote %zu moves to %s\n", m_records.size(), fname.c_str());
+	return true;
+}
+
+/**
+	@brief Reads a move log written by Write()
+ */
+bool PARMoveLog::Read(
+	const string& fname,
+	vector<PARMoveRecord>& records,
+	vector<uint32_t>& seeds,
+	vector<uint64_t>& times)
+{
+	FILE* fp = fopen(fname.c_str(), "rb");
+	if(!fp)
+	{
+		LogError("Couldn't open move log %s\n", fname.c_str());
+		return false;
+	}
+	vector<uint8_t> data;
+	uint8_t buf[4096];
+	size_t len;
+	while( (len = fread(buf, 1, sizeof(buf), fp)) > 0)
+		data.insert(data.end(), buf, buf + len);
+	fclose(fp);
+
+	if( (data.size() < MOVE_LOG_HEADER_SIZE) || (0 != memcmp(&data[0], MOVE_LOG_MAGIC, sizeof(MOVE_LOG_MAGIC))) )
+	{
+		LogError("%s is not a move log\n", fname.c_str());
+		return false;
+	}
+	uint32_t version = ReadLE(&data[8], 4);
+	if(version != VERSION)
+	{
+		LogError("%s is a version %u move log, but only version %u is supported\n",
+			fname.c_str(), version, VERSION);
+		return false;
+	}
+	uint32_t count = ReadLE(&data[12], 4);
+	uint32_t runs = ReadLE(&data[16], 4);
+	size_t expected = MOVE_LOG_HEADER_SIZE + count*MOVE_LOG_RECORD_SIZE + runs*4 + PHASE_COUNT*8;
+	if(data.size() != expected)
+	{
+		LogError("Move log %s is truncated (should have %u moves)\n", fname.c_str(), count);
+		return false;
+	}
+
+	const uint8_t* p = &data[MOVE_LOG_HEADER_SIZE];
+	records.resize(count);
+	for(auto& record : records)
+	{
+		record.run = ReadLE(p, 4);
+		record.iteration = ReadLE(p + 4, 4);
+		record.node = ReadLE(p + 8, 4);
+		record.site = ReadLE(p + 12, 4);
+		record.delta = (int32_t)ReadLE(p + 16, 4);
+		record.generator = p[20];
+		record.accepted = p[21];
+		p += MOVE_LOG_RECORD_SIZE;
+	}
+	seeds.resize(runs);
+	for(auto& seed : seeds)
+	{
+		seed = ReadLE(p, 4);
+		p += 4;
+	}
+	times.resize(PHASE_COUNT);
+	for(auto& t : times)
+	{
+		t = ReadLE(p, 8);
+		p += 8;
+	}
+	return true;
+}
+
+/**
+	@brief Loads a log to compare the moves against as they're recorded. Must be called before anything is recorded.
+ */
+bool PARMoveLog::LoadReference(const string& fname)
+{
+	if(!Read(fname, m_reference, m_referenceSeeds, m_referenceTimes))
+		return false;
+	m_referenceFile = fname;
+	LogVerbose("Replaying %zu moves from %s\n", m_reference.size(), fname.c_str());
+	return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Replay reports
+
+/**
+	@brief True if every move matched the reference, and there were exactly as many of them (only meaningful after
+	LoadReference())
+ */
+bool PARMoveLog::IsMatching() const
+{
+	return !m_diverged && (m_records.size() == m_reference.size()) && (m_runSeeds == m_referenceSeeds);
+}
+
+string PARMoveLog::FormatRecord(const PARMoveRecord& record)
+{
+	char buf[128];
+	if(record.node == NO_NODE)
+	{
+		snprintf(buf, sizeof(buf), "run %u iteration %u: generator %u found no move",
+			record.run, record.iteration, record.generator);
+	}
+	else
+	{
+		snprintf(buf, sizeof(buf), "run %u iteration %u: generator %u moved node %u to site %u, delta %d, %s",
+			record.run, record.iteration, record.generator, record.node, record.site, record.delta,
+			record.accepted ? "accepted" : "rejected");
+	}
+	return buf;
+}
+
+/**
+	@brief Says where the replay first went differently from the reference (if it did), then compares the time spent
+	in each phase.
+
+	@return True if every move matched
+ */
+bool PARMoveLog::PrintReplayReport() const
+{
+	LogNotice("\nMove log replay of %s:\n", m_referenceFile.c_str());
+	LogIndenter li;
+
+	bool matching = IsMatching();
+	if(matching)
+		LogNotice("All %zu moves matched\n", m_records.size());
+	else
+	{
+		//If nothing differed but one side stopped early, the first missing move is where they part
+		size_t i = m_diverged ? m_divergence : min(m_records.size(), m_reference.size());
+		LogWarning("Moves diverged after %zu matched\n", i);
+		LogIndenter li2;
+		if(i < m_reference.size())
+			LogNotice("Recorded: %s\n", FormatRecord(m_reference[i]).c_str());
+		else
+			LogNotice("Recorded: no more moves\n");
+		if(i < m_records.size())
+			LogNotice("Replayed: %s\n", FormatRecord(m_records[i]).c_str());
+		else
+			LogNotice("Replayed: no more moves\n");
+		if(m_runSeeds != m_referenceSeeds)
+			LogNotice("The runs used different seeds, or there were a different number of them\n");
+	}
+
+	//Per-move times aren't comparable once the moves are different, so just show the totals
+	LogNotice("%-12s  %14s  %14s  %8s\n", "Phase", "Recorded (ms)", "Replayed (ms)", "Change");
+	for(unsigned int i=0; i<PHASE_COUNT; i++)
+	{
+		double before = m_referenceTimes[i] * 1e-6;
+		double after = m_phaseTimes[i] * 1e-6;
+		char change[32] = "";
+		if(m_referenceTimes[i] != 0)
+			snprintf(change, sizeof(change), "%+7.1f%%", (after - before) * 100 / before);
+		LogNotice("%-12s  %14.3f  %14.3f  %8s\n", GetPhaseName(static_cast<Phase>(i)), before, after, change);
+	}
+
+	return matching;
+}
@@ -0,0 +1,195 @@
+/***********************************************************************************************************************
+ * Copyright (C) 2016 Andrew Zonenberg and contributors                                                                *
+ *                                                                                                                     *
+ * This program is free software; you can redistribute it and/or modify it under the terms of the GNU Lesser General   *
+ * Public License as published by the Free Software Foundation; either version 2.1 of the License, or (at your option) *
+ * any later version.                                                                                                  *
+ *                                                                                                                     *
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied  *
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for     *
+ * more details.                                                                                                       *
+ *                                                                                                                     *
+ * You should have received a copy of the GNU Lesser General Public License along with this program; if not, you may   *
+ * find one here:                                                                                                      *
+ * https://www.gnu.org/licenses/old-licenses/lgpl-2.1.txt                                                              *
+ * or you may search the http://www.gnu.org website for the version 2.1 license, or you may write to the Free Software *
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA                                      *
+ **********************************************************************************************************************/
+
+#ifndef PARMoveLog_h
+#define PARMoveLog_h
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/**
+	@brief One annealing move, as recorded by PARMoveLog
+
+	Move logs start with "XBPARMOV", then the version, record count and run count (32 bits each), then the records in
+	the order the moves were made, each written as these fields in order (little-endian, 22 bytes in all). After that
+	come the seed of each run (32 bits each) and the time spent in each phase (PARMoveLog::PHASE_COUNT totals in ns,
+	64 bits each). The layout mustn't change without bumping PARMoveLog::VERSION.
+ */
+class PARMoveRecord
+{
+public:
+	PARMoveRecord()
+		: run(0)
+		, iteration(0)
+		, node(0)
+		, site(0)
+		, delta(0)
+		, generator(0)
+		, accepted(0)
+	{}
+
+	bool operator==(const PARMoveRecord& rhs) const
+	{
+		return (run == rhs.run) && (iteration == rhs.iteration) && (node == rhs.node) && (site == rhs.site) &&
+			(delta == rhs.delta) && (generator == rhs.generator) && (accepted == rhs.accepted);
+	}
+
+	bool operator!=(const PARMoveRecord& rhs) const
+	{ return !(*this == rhs); }
+
+	///Which call to PAREngine::Anneal() the move was made in (0 for the first), and the iteration within it
+	uint32_t run;
+	uint32_t iteration;
+
+	///Index of the netlist node moved (the first one, if the move had several steps) and of the device node it was
+	///moved to. Both are PARMoveLog::NO_NODE if the generator didn't find a legal move.
+	uint32_t node;
+	uint32_t site;
+
+	///Change in cost (for batched moves, of the best candidate)
+	int32_t delta;
+
+	///Which of the engine's move generators made the move
+	uint8_t generator;
+
+	///1 if the move was kept, 0 if it was reverted
+	uint8_t accepted;
+};
+
+/**
+	@brief A record of every move an engine made while annealing, and how long each phase of the moves took.
+
+	Give one to PAREngine::SetMoveLog() to record a run, and save it with Write(). To look for a change in behavior,
+	load the saved log with LoadReference() before running the same design with the same options again: every move is
+	checked against the one at the same position in the reference, and PrintReplayReport() shows the first move that
+	differs and how the phase timings compare.
+ */
+class PARMoveLog
+{
+public:
+	PARMoveLog();
+
+	enum Phase
+	{
+		PHASE_SCORE,		//Computing and printing the cost of the placement
+		PHASE_FIND,			//Finding the badly placed nodes to move
+		PHASE_PROPOSE,		//Picking moves and measuring how much they change the cost
+		PHASE_COMMIT,		//Keeping accepted moves
+		PHASE_REVERT,		//Undoing rejected moves
+
+		PHASE_COUNT
+	};
+
+	static const char* GetPhaseName(Phase phase);
+
+	static const uint32_t NO_NODE = 0xffffffff;
+	static const uint32_t VERSION = 1;
+
+	void BeginRun(uint32_t seed);
+
+	/**
+		@brief Sets the iteration of the current run that the next moves belong to
+	 */
+	void SetIteration(uint32_t iteration)
+	{ m_iteration = iteration; }
+
+	void Record(uint32_t generator, uint32_t node, uint32_t site, int32_t delta, bool accepted);
+
+	/**
+		@brief Adds to the time spent in one phase
+	 */
+	void AddTime(Phase phase, std::chrono::steady_clock::duration time)
+	{ m_phaseTimes[phase] += std::chrono::duration_cast<std::chrono::nanoseconds>(time).count(); }
+
+	const std::vector<PARMoveRecord>& GetRecords() const
+	{ return m_records; }
+
+	bool Write(const std::string& fname) const;
+	bool LoadReference(const std::string& fname);
+
+	bool IsMatching() const;
+	bool PrintReplayReport() const;
+
+protected:
+	static bool Read(
+		const std::string& fname,
+		std::vector<PARMoveRecord>& records,
+		std::vector<uint32_t>& seeds,
+		std::vector<uint64_t>& times);
+
+	static std::string FormatRecord(const PARMoveRecord& record);
+
+	/**
+		@brief Where we are: the current run (index into m_runSeeds) and iteration
+	 */
+	uint32_t m_run;
+	uint32_t m_iteration;
+
+	/**
+		@brief Everything recorded so far: the moves, the seed of each run, and the time spent in each phase (in ns)
+	 */
+	std::vector<PARMoveRecord> m_records;
+	std::vector<uint32_t> m_runSeeds;
+	std::vector<uint64_t> m_phaseTimes;
+
+	/**
+		@brief The log we're replaying (empty if we're only recording)
+	 */
+	std::string m_referenceFile;
+	std::vector<PARMoveRecord> m_reference;
+	std::vector<uint32_t> m_referenceSeeds;
+	std::vector<uint64_t> m_referenceTimes;
+
+	/**
+		@brief Set once a move (or a run's seed) doesn't match the reference. m_divergence is the index of the first
+		move that didn't (equal to the number of moves recorded at the time, if it was a seed).
+	 */
+	bool m_diverged;
+	size_t m_divergence;
+};
+
+/**
+	@brief Adds the time from construction to destruction to one phase of a move log (does nothing without a log)
+ */
+class PARMoveLogTimer
+{
+public:
+	PARMoveLogTimer(PARMoveLog* log, PARMoveLog::Phase phase)
+		: m_log(log)
+		, m_phase(phase)
+	{
+		if(m_log != NULL)
+			m_start = std::chrono::steady_clock::now();
+	}
+
+	~PARMoveLogTimer()
+	{
+		if(m_log != NULL)
+			m_log->AddTime(m_phase, std::chrono::steady_clock::now() - m_start);
+	}
+
+protected:
+	PARMoveLog* m_log;
+	PARMoveLog::Phase m_phase;
+	std::chrono::steady_clock::time_point m_start;
+};
+
+#endif
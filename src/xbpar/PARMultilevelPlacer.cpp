@@ -0,0 +1,503 @@
+/***********************************************************************************************************************
+ * Copyright (C) 2016 Andrew Zonenberg and contributors                                                                *
+ *                                                                                                                     *
+ * This program is free software; you can redistribute it and/or modify it under the terms of the GNU Lesser General   *
+ * Public License as published by the Free Software Foundation; either version 2.1 of the License, or (at your option) *
+ * any later version.                                                                                                  *
+ *                                                                                                                     *
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied  *
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for     *
+ * more details.                                                                                                       *
+ *                                                                                                                     *
+ * You should have received a copy of the GNU Lesser General Public License along with this program; if not, you may   *
+ * find one here:                                                                                                      *
+ * https://www.gnu.org/licenses/old-licenses/lgpl-2.1.txt                                                              *
+ * or you may search the http://www.gnu.org website for the version 2.1 license, or you may write to the Free Software *
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA                                      *
+ **********************************************************************************************************************/
+
+#include <algorithm>
+#include <climits>
+#include <log.h>
+#include <xbpar.h>
+
+using namespace std;
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Construction / destruction
+
+PARMultilevelPlacer::PARMultilevelPlacer(PAREngine* engine)
+	: m_engine(engine)
+	, m_regionCount(engine->GetRegionCount())
+	, m_labelCount(engine->m_netlist->GetMaxLabel() + 1)
+	, m_cutNets(0)
+{
+	//Count the free sites for each label in each region
+	PARGraph* device = engine->m_device;
+	m_capacity.assign(static_cast<size_t>(m_regionCount) * m_labelCount, 0);
+	for(uint32_t label=0; (label<m_labelCount) && (label<=device->GetMaxLabel()); label++)
+	{
+		for(uint32_t i=0; i<device->GetNumNodesWithLabel(label); i++)
+		{
+			PARGraphNode* site = device->GetNodeByLabelAndIndex(label, i);
+			if(site->GetMate() == NULL)
+				m_capacity[engine->GetSiteRegion(site)*m_labelCount + label] ++;
+		}
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Top level
+
+/**
+	@brief Picks a region for every netlist node.
+
+	Nodes which are already placed stay in the region of their site. The others are spread so each region has room
+	for them (counting a site once for every label it accepts, so this is a hint rather than a guarantee) with as few
+	nets as possible spanning two regions.
+
+	@param regions	Filled with the region of each netlist node, by node index
+ */
+void PARMultilevelPlacer::AssignRegions(vector<uint32_t>& regions)
+{
+	PARGraph* netlist = m_engine->m_netlist;
+	uint32_t nnodes = netlist->GetNumNodes();
+	m_levels.clear();
+	BuildFinestLevel();
+
+	//Stop once there are a few clusters per region left, or nothing more can be merged. Capping the cluster size
+	//keeps any one cluster from taking a whole region, so there's something left to balance.
+	const uint32_t clusters_per_region = 4;
+	uint32_t nfree = 0;
+	for(auto n : m_levels[0].size)
+		nfree += n;
+	uint32_t max_size = max(2u, nfree / (2 * max(m_regionCount, 1u)));
+	while( (m_regionCount > 1) && (m_levels.back().GetClusterCount() > clusters_per_region * m_regionCount) )
+	{
+		if(!Coarsen(max_size))
+			break;
+	}
+
+	//Place the coarsest clusters, then work back down refining as we go
+	PartitionCoarsest();
+	for(size_t i=m_levels.size()-1; i>0; i--)
+	{
+		Project(m_levels[i], m_levels[i-1]);
+		Refine(m_levels[i-1]);
+	}
+
+	Level& finest = m_levels[0];
+	regions.resize(nnodes);
+	for(uint32_t i=0; i<nnodes; i++)
+		regions[i] = finest.region[finest.nodeCluster[i]];
+	m_cutNets = CountCutNets(finest);
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Coarsening
+
+/**
+	@brief Makes the first level, with one cluster per netlist node
+ */
+void PARMultilevelPlacer::BuildFinestLevel()
+{
+	PARGraph* netlist = m_engine->m_netlist;
+	uint32_t nnodes = netlist->GetNumNodes();
+
+	m_levels.push_back(Level());
+	Level& level = m_levels.back();
+	level.nodeCluster.resize(nnodes);
+	level.labels.assign(static_cast<size_t>(nnodes) * m_labelCount, 0);
+	level.size.assign(nnodes, 0);
+	level.region.assign(nnodes, 0);
+	level.fixed.assign(nnodes, false);
+	for(uint32_t i=0; i<nnodes; i++)
+	{
+		level.nodeCluster[i] = i;
+
+		PARGraphNode* node = netlist->GetNodeByIndex(i);
+		if(node->GetMate() != NULL)
+		{
+			level.fixed[i] = true;
+			level.region[i] = m_engine->GetSiteRegion(node->GetMate());
+		}
+		else
+		{
+			level.labels[static_cast<size_t>(i)*m_labelCount + node->GetLabel()] = 1;
+			level.size[i] = 1;
+
+			//Region constraints fix a node just like being placed, except that it still needs a site
+			int32_t region = m_engine->GetNodeRegion(node);
+			if(region != PAREngine::ANY_REGION)
+			{
+				level.fixed[i] = true;
+				level.region[i] = region;
+			}
+		}
+	}
+
+	FindNeighbors(level);
+}
+
+/**
+	@brief Builds the next coarser level by merging pairs of clusters (heavy edge matching).
+
+	Smaller clusters pick first, each taking the unmatched neighbor it shares the most nets with (relative to their
+	combined size, so clusters don't snowball).
+
+	@return False if nothing could be merged
+ */
+bool PARMultilevelPlacer::Coarsen(uint32_t max_size)
+{
+	Level& fine = m_levels.back();
+	uint32_t count = fine.GetClusterCount();
+
+	vector<uint32_t> order(count);
+	for(uint32_t i=0; i<count; i++)
+		order[i] = i;
+	stable_sort(order.begin(), order.end(),
+		[&](uint32_t a, uint32_t b) { return fine.size[a] < fine.size[b]; });
+
+	const uint32_t NONE = 0xffffffff;
+	vector<uint32_t> mate(count, NONE);
+	uint32_t merged = 0;
+	for(auto a : order)
+	{
+		if(mate[a] != NONE)
+			continue;
+
+		uint32_t best = NONE;
+		double best_rating = 0;
+		for(auto& n : fine.neighbors[a])
+		{
+			uint32_t b = n.first;
+			if( (mate[b] != NONE) || !CanMerge(fine, a, b, max_size) )
+				continue;
+			double rating = n.second / static_cast<double>(fine.size[a] + fine.size[b]);
+			if(rating > best_rating)
+			{
+				best = b;
+				best_rating = rating;
+			}
+		}
+
+		if(best == NONE)
+			continue;
+		mate[a] = best;
+		mate[best] = a;
+		merged ++;
+	}
+	if(merged == 0)
+		return false;
+
+	//Number the new clusters in order of their lowest-numbered member
+	fine.parent.assign(count, NONE);
+	uint32_t ncoarse = 0;
+	for(uint32_t i=0; i<count; i++)
+	{
+		if(fine.parent[i] != NONE)
+			continue;
+		fine.parent[i] = ncoarse;
+		if(mate[i] != NONE)
+			fine.parent[mate[i]] = ncoarse;
+		ncoarse ++;
+	}
+
+	Level coarse;
+	coarse.labels.assign(static_cast<size_t>(ncoarse) * m_labelCount, 0);
+	coarse.size.assign(ncoarse, 0);
+	coarse.region.assign(ncoarse, 0);
+	coarse.fixed.assign(ncoarse, false);
+	for(uint32_t i=0; i<count; i++)
+	{
+		uint32_t c = fine.parent[i];
+		coarse.size[c] += fine.size[i];
+		for(uint32_t label=0; label<m_labelCount; label++)
+		{
+			coarse.labels[static_cast<size_t>(c)*m_labelCount + label] +=
+				fine.labels[static_cast<size_t>(i)*m_labelCount + label];
+		}
+		if(fine.fixed[i])
+		{
+			coarse.fixed[c] = true;
+			coarse.region[c] = fine.region[i];
+		}
+	}
+	coarse.nodeCluster.resize(fine.nodeCluster.size());
+	for(size_t i=0; i<fine.nodeCluster.size(); i++)
+		coarse.nodeCluster[i] = fine.parent[fine.nodeCluster[i]];
+
+	FindNeighbors(coarse);
+	m_levels.push_back(coarse);
+	return true;
+}
+
+/**
+	@brief Checks if two clusters may be merged: not too big, not pinned to two different regions, and small enough
+	to fit in a region (the one it's pinned to, if either is)
+ */
+bool PARMultilevelPlacer::CanMerge(Level& level, uint32_t a, uint32_t b, uint32_t max_size)
+{
+	if(level.size[a] + level.size[b] > max_size)
+		return false;
+	if(level.fixed[a] && level.fixed[b] && (level.region[a] != level.region[b]) )
+		return false;
+
+	for(uint32_t region=0; region<m_regionCount; region++)
+	{
+		if(level.fixed[a] && (level.region[a] != region))
+			continue;
+		if(level.fixed[b] && (level.region[b] != region))
+			continue;
+
+		bool fits = true;
+		for(uint32_t label=0; fits && (label<m_labelCount); label++)
+		{
+			uint32_t n = level.labels[static_cast<size_t>(a)*m_labelCount + label] +
+				level.labels[static_cast<size_t>(b)*m_labelCount + label];
+			fits = (n <= m_capacity[region*m_labelCount + label]);
+		}
+		if(fits)
+			return true;
+	}
+	return false;
+}
+
+/**
+	@brief Finds the clusters sharing nets with each cluster of a level.
+
+	Each net connects its source's cluster to every other cluster with one of its sinks, once however many sinks are
+	there, since that's what it costs to route the net between regions. Free edges don't count.
+ */
+void PARMultilevelPlacer::FindNeighbors(Level& level)
+{
+	PARGraph* netlist = m_engine->m_netlist;
+
+	vector< pair<uint32_t, uint32_t> > links;
+	vector<uint32_t> sinks;
+	for(uint32_t i=0; i<netlist->GetNumNets(); i++)
+	{
+		PARGraphNet* net = netlist->GetNetByIndex(i);
+		uint32_t src = level.nodeCluster[net->m_sourcenode->GetIndex()];
+
+		sinks.clear();
+		for(uint32_t j=0; j<net->GetSinkCount(); j++)
+		{
+			PARGraphEdge* edge = net->GetSink(j);
+			uint32_t dst = level.nodeCluster[edge->m_destnode->GetIndex()];
+			if( !edge->m_free && (dst != src) && (find(sinks.begin(), sinks.end(), dst) == sinks.end()) )
+				sinks.push_back(dst);
+		}
+		for(auto dst : sinks)
+		{
+			links.push_back(pair<uint32_t, uint32_t>(src, dst));
+			links.push_back(pair<uint32_t, uint32_t>(dst, src));
+		}
+	}
+	sort(links.begin(), links.end());
+
+	level.neighbors.assign(level.GetClusterCount(), vector< pair<uint32_t, uint32_t> >());
+	for(size_t i=0; i<links.size(); )
+	{
+		size_t j = i;
+		while( (j < links.size()) && (links[j] == links[i]) )
+			j ++;
+		level.neighbors[links[i].first].push_back(pair<uint32_t, uint32_t>(links[i].second, j - i));
+		i = j;
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Partitioning
+
+/**
+	@brief Checks if a cluster fits in a region, on top of what's there already
+ */
+bool PARMultilevelPlacer::Fits(Level& level, uint32_t cluster, uint32_t region, const vector<uint32_t>& used)
+{
+	for(uint32_t label=0; label<m_labelCount; label++)
+	{
+		size_t i = region*m_labelCount + label;
+		if(used[i] + level.labels[static_cast<size_t>(cluster)*m_labelCount + label] > m_capacity[i])
+			return false;
+	}
+	return true;
+}
+
+/**
+	@brief Adds (sign = 1) or removes (sign = -1) a cluster's nodes to the per-label usage of a region
+ */
+void PARMultilevelPlacer::AddUse(Level& level, uint32_t cluster, uint32_t region, vector<uint32_t>& used, int sign)
+{
+	for(uint32_t label=0; label<m_labelCount; label++)
+		used[region*m_labelCount + label] += sign * level.labels[static_cast<size_t>(cluster)*m_labelCount + label];
+}
+
+/**
+	@brief Gives every free cluster of the coarsest level a region, biggest first, each going where most of its
+	already-placed neighbors are (or failing that, where there's the most room)
+ */
+void PARMultilevelPlacer::PartitionCoarsest()
+{
+	Level& level = m_levels.back();
+	uint32_t count = level.GetClusterCount();
+
+	vector<uint32_t> order;
+	vector<bool> assigned(count, false);
+	for(uint32_t i=0; i<count; i++)
+	{
+		if(level.fixed[i])
+			assigned[i] = true;
+		else
+			order.push_back(i);
+	}
+	stable_sort(order.begin(), order.end(),
+		[&](uint32_t a, uint32_t b) { return level.size[a] > level.size[b]; });
+
+	//Region constrained nodes take up room in their fixed cluster's region (placed ones already have their sites)
+	vector<uint32_t> used(m_capacity.size(), 0);
+	for(uint32_t c=0; c<count; c++)
+	{
+		if(level.fixed[c])
+			AddUse(level, c, level.region[c], used, 1);
+	}
+
+	vector<uint32_t> conn(m_regionCount);
+	for(auto c : order)
+	{
+		conn.assign(m_regionCount, 0);
+		for(auto& n : level.neighbors[c])
+		{
+			if(assigned[n.first])
+				conn[level.region[n.first]] += n.second;
+		}
+
+		//Free sites left for our labels in each region, to break ties
+		uint32_t best = 0;
+		bool best_fits = false;
+		uint32_t best_room = 0;
+		for(uint32_t region=0; region<m_regionCount; region++)
+		{
+			bool fits = Fits(level, c, region, used);
+			uint32_t room = 0;
+			for(uint32_t label=0; label<m_labelCount; label++)
+			{
+				size_t i = region*m_labelCount + label;
+				if(level.labels[static_cast<size_t>(c)*m_labelCount + label] != 0)
+					room += m_capacity[i] - min(used[i], m_capacity[i]);
+			}
+
+			bool better;
+			if(region == 0)
+				better = true;
+			else if(fits != best_fits)
+				better = fits;
+			else if(conn[region] != conn[best])
+				better = (conn[region] > conn[best]);
+			else
+				better = (room > best_room);
+
+			if(better)
+			{
+				best = region;
+				best_fits = fits;
+				best_room = room;
+			}
+		}
+
+		level.region[c] = best;
+		assigned[c] = true;
+		AddUse(level, c, best, used, 1);
+	}
+
+	Refine(level);
+}
+
+/**
+	@brief Moves single clusters to other regions while that cuts fewer nets (or gets them out of a region that has
+	no room for them)
+ */
+void PARMultilevelPlacer::Refine(Level& level)
+{
+	uint32_t count = level.GetClusterCount();
+	vector<uint32_t> used(m_capacity.size(), 0);
+	for(uint32_t c=0; c<count; c++)
+		AddUse(level, c, level.region[c], used, 1);
+
+	const uint32_t max_passes = 8;
+	vector<int64_t> conn(m_regionCount);
+	for(uint32_t pass=0; pass<max_passes; pass++)
+	{
+		bool moved = false;
+		for(uint32_t c=0; c<count; c++)
+		{
+			if(level.fixed[c] || (level.size[c] == 0))
+				continue;
+
+			conn.assign(m_regionCount, 0);
+			for(auto& n : level.neighbors[c])
+				conn[level.region[n.first]] += n.second;
+
+			uint32_t current = level.region[c];
+			AddUse(level, c, current, used, -1);
+
+			uint32_t best = current;
+			int64_t best_gain = Fits(level, c, current, used) ? 0 : INT64_MIN;
+			for(uint32_t region=0; region<m_regionCount; region++)
+			{
+				if( (region == current) || !Fits(level, c, region, used) )
+					continue;
+				int64_t gain = conn[region] - conn[current];
+				if(gain > best_gain)
+				{
+					best = region;
+					best_gain = gain;
+				}
+			}
+
+			level.region[c] = best;
+			AddUse(level, c, best, used, 1);
+			if(best != current)
+				moved = true;
+		}
+
+		if(!moved)
+			break;
+	}
+}
+
+/**
+	@brief Copies the regions of one level down to the next finer one
+ */
+void PARMultilevelPlacer::Project(Level& coarse, Level& fine)
+{
+	for(uint32_t c=0; c<fine.GetClusterCount(); c++)
+	{
+		if(!fine.fixed[c])
+			fine.region[c] = coarse.region[fine.parent[c]];
+	}
+}
+
+/**
+	@brief Counts the nets with a sink in a different region from their source
+ */
+uint32_t PARMultilevelPlacer::CountCutNets(Level& level)
+{
+	PARGraph* netlist = m_engine->m_netlist;
+	uint32_t cut = 0;
+	for(uint32_t i=0; i<netlist->GetNumNets(); i++)
+	{
+		PARGraphNet* net = netlist->GetNetByIndex(i);
+		uint32_t src = level.region[level.nodeCluster[net->m_sourcenode->GetIndex()]];
+		for(uint32_t j=0; j<net->GetSinkCount(); j++)
+		{
+			PARGraphEdge* edge = net->GetSink(j);
+			if(!edge->m_free && (level.region[level.nodeCluster[edge->m_destnode->GetIndex()]] != src))
+			{
+				cut ++;
+				break;
+			}
+		}
+	}
+	return cut;
+}
@@ -0,0 +1,118 @@
+/***********************************************************************************************************************
+ * Copyright (C) 2016 Andrew Zonenberg and contributors                                                                *
+ *                                                                                                                     *
+ * This program is free software; you can redistribute it and/or modify it under the terms of the GNU Lesser General   *
+ * Public License as published by the Free Software Foundation; either version 2.1 of the License, or (at your option) *
+ * any later version.                                                                                                  *
+ *                                                                                                                     *
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied  *
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for     *
+ * more details.                                                                                                       *
+ *                                                                                                                     *
+ * You should have received a copy of the GNU Lesser General Public License along with this program; if not, you may   *
+ * find one here:                                                                                                      *
+ * https://www.gnu.org/licenses/old-licenses/lgpl-2.1.txt                                                              *
+ * or you may search the http://www.gnu.org website for the version 2.1 license, or you may write to the Free Software *
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA                                      *
+ **********************************************************************************************************************/
+
+#ifndef PARMultilevelPlacer_h
+#define PARMultilevelPlacer_h
+
+#include <vector>
+#include <cstdint>
+
+class PAREngine;
+
+/**
+	@brief Multi-level placement at region granularity (see PAREngine::GetRegionCount()).
+
+	The unplaced netlist nodes are coarsened into clusters by repeatedly merging pairs sharing the most nets (so a LUT
+	and the flipflop it feeds, or the nodes of a counter and its decoder, end up together), as long as the merged
+	cluster still fits in one region. The coarsest clusters are spread over the regions, then each level is uncoarsened
+	in turn and refined by moving single clusters to whichever region cuts the fewest nets.
+
+	Only decides a region for each node; the engine picks the actual sites and anneals from there.
+ */
+class PARMultilevelPlacer
+{
+public:
+	PARMultilevelPlacer(PAREngine* engine);
+
+	void AssignRegions(std::vector<uint32_t>& regions);
+
+	/**
+		@brief Number of levels built by the last AssignRegions() call (1 = nothing was merged)
+	 */
+	uint32_t GetLevelCount()
+	{ return m_levels.size(); }
+
+	/**
+		@brief Number of nets which span more than one region in the result of the last AssignRegions() call
+	 */
+	uint32_t GetCutNets()
+	{ return m_cutNets; }
+
+protected:
+
+	/**
+		@brief One level of the cluster hierarchy
+	 */
+	class Level
+	{
+	public:
+		//Cluster of each netlist node (by node index), and the cluster each of ours was merged into at the next
+		//coarser level
+		std::vector<uint32_t> nodeCluster;
+		std::vector<uint32_t> parent;
+
+		//Clusters sharing a net with each cluster, and how many nets they share
+		std::vector< std::vector< std::pair<uint32_t, uint32_t> > > neighbors;
+
+		//Number of unplaced nodes of each label in each cluster, indexed [cluster*m_labelCount + label]
+		std::vector<uint32_t> labels;
+
+		//Number of unplaced nodes in each cluster
+		std::vector<uint32_t> size;
+
+		//Region of each cluster, and whether it's fixed by a node that's already placed (or constrained to a region)
+		std::vector<uint32_t> region;
+		std::vector<bool> fixed;
+
+		uint32_t GetClusterCount()
+		{ return size.size(); }
+	};
+
+	void BuildFinestLevel();
+	bool Coarsen(uint32_t max_size);
+	void FindNeighbors(Level& level);
+	bool CanMerge(Level& level, uint32_t a, uint32_t b, uint32_t max_size);
+	bool Fits(Level& level, uint32_t cluster, uint32_t region, const std::vector<uint32_t>& used);
+	void AddUse(Level& level, uint32_t cluster, uint32_t region, std::vector<uint32_t>& used, int sign);
+	void PartitionCoarsest();
+	void Refine(Level& level);
+	void Project(Level& coarse, Level& fine);
+	uint32_t CountCutNets(Level& level);
+
+	/**
+		@brief The engine we're placing for
+	 */
+	PAREngine* m_engine;
+
+	/**
+		@brief Number of regions and labels, and the free sites for each label in each region (indexed
+		[region*m_labelCount + label])
+	 */
+	uint32_t m_regionCount;
+	uint32_t m_labelCount;
+	std::vector<uint32_t> m_capacity;
+
+	/**
+		@brief The cluster hierarchy, finest (one cluster per netlist node) first
+	 */
+	std::vector<Level> m_levels;
+
+	uint32_t m_cutNets;
+};
+
+#endif
@@ -0,0 +1,102 @@
+/***********************************************************************************************************************
+ * Copyright (C) 2016 Andrew Zonenberg and contributors                                                                *
+ *                                                                                                                     *
+ * This program is free software; you can redistribute it and/or modify it under the terms of the GNU Lesser General   *
+ * Public License as published by the Free Software Foundation; either version 2.1 of the License, or (at your option) *
+ * any later version.                                                                                                  *
+ *                                                                                                                     *
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied  *
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for     *
+ * more details.                                                                                                       *
+ *                                                                                                                     *
+ * You should have received a copy of the GNU Lesser General Public License along with this program; if not, you may   *
+ * find one here:                                                                                                      *
+ * https://www.gnu.org/licenses/old-licenses/lgpl-2.1.txt                                                              *
+ * or you may search the http://www.gnu.org website for the version 2.1 license, or you may write to the Free Software *
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA                                      *
+ **********************************************************************************************************************/
+
+#include <xbpar.h>
+
+using namespace std;
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Construction / destruction
+
+PARRandom::PARRandom(uint64_t seed)
+{
+	Seed(seed);
+}
+
+/**
+	@brief Resets the generator to the start of the sequence for a given seed
+ */
+void PARRandom::Seed(uint64_t seed)
+{
+	//Expand the seed with splitmix64, which can't produce an all-zero state
+	for(int i=0; i<4; i+=2)
+	{
+		seed += 0x9e3779b97f4a7c15ULL;
+		uint64_t z = seed;
+		z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+		z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+		z = z ^ (z >> 31);
+		m_state[i] = static_cast<uint32_t>(z);
+		m_state[i+1] = static_cast<uint32_t>(z >> 32);
+	}
+}
+
+////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Generation
+
+static inline uint32_t rotl(uint32_t x, int k)
+{
+	return (x << k) | (x >> (32 - k));
+}
+
+/**
+	@brief Returns the next 32-bit output
+ */
+uint32_t PARRandom::Next()
+{
+	uint32_t ret = rotl(m_state[1] * 5, 7) * 9;
+	uint32_t t = m_state[1] << 9;
+
+	m_state[2] ^= m_state[0];
+	m_state[3] ^= m_state[1];
+	m_state[1] ^= m_state[2];
+	m_state[0] ^= m_state[3];
+	m_state[2] ^= t;
+	m_state[3] = rotl(m_state[3], 11);
+
+	return ret;
+}
+
+/**
+	@brief Returns a uniformly distributed integer in [0, n). n must be nonzero.
+
+	Uses a multiply-and-shift rather than a modulo, rejecting the few outputs that would bias the result.
+ */
+uint32_t PARRandom::NextBelow(uint32_t n)
+{
+	uint64_t m = static_cast<uint64_t>(Next()) * n;
+	uint32_t low = static_cast<uint32_t>(m);
+	if(low < n)
+	{
+		uint32_t threshold = (0 - n) % n;
+		while(low < threshold)
+		{
+			m = static_cast<uint64_t>(Next()) * n;
+			low = static_cast<uint32_t>(m);
+		}
+	}
+	return static_cast<uint32_t>(m >> 32);
+}
+
+/**
+	@brief Returns a uniformly distributed number in [0, 1)
+ */
+double PARRandom::NextUnit()
+{
+	return Next() * (1.0 / 4294967296.0);
+}
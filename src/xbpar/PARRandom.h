@@ -0,0 +1,49 @@
+/***********************************************************************************************************************
+ * Copyright (C) 2016 Andrew Zonenberg and contributors                                                                *
+ *                                                                                                                     *
+ * This program is free software; you can redistribute it and/or modify it under the terms of the GNU Lesser General   *
+ * Public License as published by the Free Software Foundation; either version 2.1 of the License, or (at your option) *
+ * any later version.                                                                                                  *
+ *                                                                                                                     *
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied  *
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for     *
+ * more details.                                                                                                       *
+ *                                                                                                                     *
+ * You should have received a copy of the GNU Lesser General Public License along with this program; if not, you may   *
+ * find one here:                                                                                                      *
+ * https://www.gnu.org/licenses/old-licenses/lgpl-2.1.txt                                                              *
+ * or you may search the http://www.gnu.org website for the version 2.1 license, or you may write to the Free Software *
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA                                      *
+ **********************************************************************************************************************/
+
+#ifndef PARRandom_h
+#define PARRandom_h
+
+#include <cstdint>
+
+/**
+	@brief Small, fast pseudorandom number generator (xoshiro128**).
+
+	Each engine owns its own generator, so results depend only on the seed (not on the C library) and engines can run
+	on different threads without sharing any state.
+ */
+class PARRandom
+{
+public:
+	PARRandom(uint64_t seed = 0);
+
+	void Seed(uint64_t seed);
+
+	uint32_t Next();
+	uint32_t NextBelow(uint32_t n);
+	double NextUnit();
+
+protected:
+
+	/**
+		@brief Generator state (must never be all zero)
+	 */
+	uint32_t m_state[4];
+};
+
+#endif
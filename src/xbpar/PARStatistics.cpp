@@ -0,0 +1,56 @@
+/***********************************************************************************************************************
+ * Copyright (C) 2016 Andrew Zonenberg and contributors                                                                *
+ *                                                                                                                     *
+ * This program is free software; you can redistribute it and/or modify it under the terms of the GNU Lesser General   *
+ * Public License as published by the Free Software Foundation; either version 2.1 of the License, or (at your option) *
+ * any later version.                                                                                                  *
+ *                                                                                                                     *
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied  *
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for     *
+ * more details.                                                                                                       *
+ *                                                                                                                     *
+ * You should have received a copy of the GNU Lesser General Public License along with this program; if not, you may   *
+ * find one here:                                                                                                      *
+ * https://www.gnu.org/licenses/old-licenses/lgpl-2.1.txt                                                              *
+ * or you may search the http://www.gnu.org website for the version 2.1 license, or you may write to the Free Software *
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA                                      *
+ **********************************************************************************************************************/
+
+#include <algorithm>
+#include <xbpar.h>
+
+using namespace std;
+
+/**
+	@brief Adds the counters and annealing runs of another engine (for example, one working on a copy of our graphs)
+ */
+void PARStatistics::Add(const PARStatistics& other)
+{
+	initialPlacementTime += other.initialPlacementTime;
+	costEvaluations += other.costEvaluations;
+	movesProposed += other.movesProposed;
+	movesAccepted += other.movesAccepted;
+
+	if(other.candidateSets != 0)
+	{
+		if( (candidateSets == 0) || (other.candidateMin < candidateMin) )
+			candidateMin = other.candidateMin;
+		candidateMax = max(candidateMax, other.candidateMax);
+	}
+	candidateSets += other.candidateSets;
+	candidateTotal += other.candidateTotal;
+
+	anneals.insert(anneals.end(), other.anneals.begin(), other.anneals.end());
+}
+
+/**
+	@brief Counts one set of candidate nodes for an annealing move
+ */
+void PARStatistics::AddCandidateSet(uint32_t size)
+{
+	if( (candidateSets == 0) || (size < candidateMin) )
+		candidateMin = size;
+	candidateMax = max(candidateMax, size);
+	candidateSets ++;
+	candidateTotal += size;
+}
@@ -0,0 +1,95 @@
+/***********************************************************************************************************************
+ * Copyright (C) 2016 Andrew Zonenberg and contributors                                                                *
+ *                                                                                                                     *
+ * This program is free software; you can redistribute it and/or modify it under the terms of the GNU Lesser General   *
+ * Public License as published by the Free Software Foundation; either version 2.1 of the License, or (at your option) *
+ * any later version.                                                                                                  *
+ *                                                                                                                     *
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied  *
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for     *
+ * more details.                                                                                                       *
+ *                                                                                                                     *
+ * You should have received a copy of the GNU Lesser General Public License along with this program; if not, you may   *
+ * find one here:                                                                                                      *
+ * https://www.gnu.org/licenses/old-licenses/lgpl-2.1.txt                                                              *
+ * or you may search the http://www.gnu.org website for the version 2.1 license, or you may write to the Free Software *
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA                                      *
+ **********************************************************************************************************************/
+
+#ifndef PARStatistics_h
+#define PARStatistics_h
+
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+/**
+	@brief What happened during one call to PAREngine::Anneal()
+ */
+class PARAnnealRun
+{
+public:
+	PARAnnealRun(uint32_t s = 0)
+		: seed(s)
+		, iterations(0)
+		, seconds(0)
+		, timedOut(false)
+	{}
+
+	uint32_t seed;
+	uint32_t iterations;
+	double seconds;
+
+	//True if the run was cut short by the engine's deadline
+	bool timedOut;
+
+	//Cost of the placement at each iteration where it changed, as (iteration, cost)
+	std::vector< std::pair<uint32_t, uint32_t> > cost;
+};
+
+/**
+	@brief Counters kept by the PAR engine, for finding out where the time goes.
+
+	These are cheap enough to always keep.
+ */
+class PARStatistics
+{
+public:
+	PARStatistics()
+		: initialPlacementTime(0)
+		, costEvaluations(0)
+		, movesProposed(0)
+		, movesAccepted(0)
+		, candidateSets(0)
+		, candidateTotal(0)
+		, candidateMin(0)
+		, candidateMax(0)
+	{}
+
+	void Add(const PARStatistics& other);
+	void AddCandidateSet(uint32_t size);
+
+	uint64_t GetMovesRejected() const
+	{ return movesProposed - movesAccepted; }
+
+	//Time spent in InitialPlacement(), in seconds
+	double initialPlacementTime;
+
+	//Number of times the change in cost of a trial move was measured
+	uint64_t costEvaluations;
+
+	//Annealing moves attempted, and how many of them were kept
+	uint64_t movesProposed;
+	uint64_t movesAccepted;
+
+	//Sizes of the sets of badly placed nodes moves were picked from (one per annealing iteration)
+	uint64_t candidateSets;
+	uint64_t candidateTotal;
+	uint32_t candidateMin;
+	uint32_t candidateMax;
+
+	//Every annealing run, in the order they finished
+	std::vector<PARAnnealRun> anneals;
+};
+
+#endif
@@ -19,9 +19,22 @@
 #ifndef xbpar_h
 #define xbpar_h
 
+#include "PARArena.h"
+#include "PARRandom.h"
+#include "PARGraphEdge.h"
+#include "PARGraphNet.h"
 #include "PARGraph.h"
 #include "PARGraphNode.h"
+#include "PARAdjacency.h"
+#include "PARLabelRegistry.h"
+#include "PARMoveGenerator.h"
+#include "PARBatchEvaluator.h"
+#include "PARExactPlacer.h"
+#include "PARMultilevelPlacer.h"
+#include "PARMoveLog.h"
+#include "PARStatistics.h"
 
 #include "PAREngine.h"
+#include "PARModelEngine.h"
 
 #endif
@@ -0,0 +1,25 @@
+########################################################################################################################
+# Flips one bit of a text bitstream and checks gp4equiv notices
+#
+# Run with cmake -P, defining GP4EQUIV, PART, NETLIST, BITSTREAM, PLACEMENT, BIT and OUTPUT (the mutated bitstream)
+
+file(READ "${BITSTREAM}" bits)
+string(REGEX MATCH "\n${BIT}\t\t[01]\t" line "${bits}")
+if(line STREQUAL "")
+	message(FATAL_ERROR "${BITSTREAM} doesn't have bit ${BIT}")
+endif()
+
+if(line MATCHES "\t1\t$")
+	string(REPLACE "\t\t1\t" "\t\t0\t" flipped "${line}")
+else()
+	string(REPLACE "\t\t0\t" "\t\t1\t" flipped "${line}")
+endif()
+string(REPLACE "${line}" "${flipped}" bits "${bits}")
+file(WRITE "${OUTPUT}" "${bits}")
+
+execute_process(
+	COMMAND "${GP4EQUIV}" --part ${PART} "${NETLIST}" "${OUTPUT}" "${PLACEMENT}"
+	RESULT_VARIABLE result)
+if(result EQUAL 0)
+	message(FATAL_ERROR "gp4equiv didn't notice bit ${BIT} of ${BITSTREAM} was flipped")
+endif()
@@ -145,15 +145,18 @@ bool RunTest(hdevice hdev)
 		if(!ConfigureSiggen(hdev, 4, vtest))
 			return false;
 
-		//Read the outputs
+		//Read all of the outputs in one go
+		vector<unsigned int> outputs;
+		for(int i=0; i<6; i++)
+			outputs.push_back(acmps[i][0]);
+		vector<double> values;
+		if(!BurstReadADC(hdev, outputs, 1, values))
+			return false;
+
 		for(int i=0; i<6; i++)
 		{
-			double v;
 			int npin = acmps[i][0];
-			if(!SingleReadADC(hdev, npin, v))
-				return false;
-
-			bool b = (v > 0.5);
+			bool b = (values[i] > 0.5);
 
 			//If we went LOW, something is wrong. We should never turn off on a rising edge
 			if(pin_states[i] && !b)
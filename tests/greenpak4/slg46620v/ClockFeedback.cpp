@@ -0,0 +1,162 @@
+/***********************************************************************************************************************
+ * Copyright (C) 2016 Andrew Zonenberg and contributors                                                                *
+ *                                                                                                                     *
+ * This program is free software; you can redistribute it and/or modify it under the terms of the GNU Lesser General   *
+ * Public License as published by the Free Software Foundation; either version 2.1 of the License, or (at your option) *
+ * any later version.                                                                                                  *
+ *                                                                                                                     *
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied  *
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for     *
+ * more details.                                                                                                       *
+ *                                                                                                                     *
+ * You should have received a copy of the GNU Lesser General Public License along with this program; if not, you may   *
+ * find one here:                                                                                                      *
+ * https://www.gnu.org/licenses/old-licenses/lgpl-2.1.txt                                                              *
+ * or you may search the http://www.gnu.org website for the version 2.1 license, or you may write to the Free Software *
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA                                      *
+ **********************************************************************************************************************/
+
+#include <log.h>
+#include <Greenpak4Simulator.h>
+#include <Greenpak4VectorSimulator.h>
+#include <Greenpak4CompiledModel.h>
+#include <cstdlib>
+
+using namespace std;
+
+bool RunTest(Greenpak4Simulator& sim, Greenpak4VectorSimulator& vsim, Greenpak4CompiledModel& model);
+
+int main(int argc, char* argv[])
+{
+	g_log_sinks.emplace(g_log_sinks.begin(), new STDLogSink(Severity::VERBOSE));
+
+	//expect two args: the bitstream, and the model gp4simgen compiled from it
+	if(argc != 3)
+	{
+		LogNotice("Usage: [testcase] bitstream.txt model.so\n");
+		return 1;
+	}
+
+	Greenpak4Device device(Greenpak4Device::GREENPAK4_SLG46620);
+	uint8_t userid;
+	bool readProtect;
+	if(!device.LoadFromFile(argv[1], userid, readProtect))
+		return 1;
+
+	Greenpak4Simulator sim(&device);
+	if(!sim.Build())
+		return 1;
+	Greenpak4VectorSimulator vsim(&device);
+	if(!vsim.Build())
+		return 1;
+	Greenpak4CompiledModel model;
+	if(!model.Load(argv[2]))
+		return 1;
+
+	LogNotice("Running simulation test case\n");
+	return RunTest(sim, vsim, model) ? 0 : 1;
+}
+
+/**
+	@brief Checks one output pin of every simulator against what it should be
+ */
+bool CheckPin(
+	Greenpak4Simulator& sim,
+	Greenpak4VectorSimulator& vsim,
+	Greenpak4CompiledModel& model,
+	unsigned int step,
+	unsigned int pin,
+	bool expected)
+{
+	auto state = expected ? Greenpak4SimulationModel::PIN_HIGH : Greenpak4SimulationModel::PIN_LOW;
+	Greenpak4VectorSimulator::lanes lanes = expected ? ~0ULL : 0;
+
+	bool ok = true;
+	if(sim.GetPinOutput(pin) != state)
+	{
+		LogError("Step %u: Greenpak4Simulator has P%u = %d, expected %d\n", step, pin, sim.GetPinOutput(pin), expected);
+		ok = false;
+	}
+	if( (vsim.GetPinOutputEnables(pin) != ~0ULL) || (vsim.GetPinOutputs(pin) != lanes) )
+	{
+		LogError("Step %u: Greenpak4VectorSimulator has P%u = %016llx, expected %d in every lane\n",
+			step, pin, static_cast<unsigned long long>(vsim.GetPinOutputs(pin)), expected);
+		ok = false;
+	}
+	if(model.GetPinOutput(pin) != state)
+	{
+		LogError("Step %u: compiled model has P%u = %d, expected %d\n", step, pin, model.GetPinOutput(pin), expected);
+		ok = false;
+	}
+	return ok;
+}
+
+/**
+	@brief Drives the same random pin changes into the interpreted, lane-parallel and compiled simulators, and checks
+	all of them against what ClockFeedback.v says the outputs should be
+ */
+bool RunTest(Greenpak4Simulator& sim, Greenpak4VectorSimulator& vsim, Greenpak4CompiledModel& model)
+{
+	LogIndenter li;
+
+	//Get through power-on reset (the lane-parallel simulator starts after it), which takes 500 ms at most
+	uint64_t time = 1000000000000ULL;
+	sim.RunUntil(time);
+	model.RunUntil(time);
+
+	//Everything starts low
+	bool clk = false;
+	bool a = false;
+	bool q1 = false;
+	bool q2 = false;
+	bool q3 = false;
+	for(unsigned int pin : {3, 5})
+	{
+		sim.SetPinInput(pin, Greenpak4SimulationModel::PIN_LOW);
+		vsim.SetPinInputs(pin, 0);
+		model.SetPinInput(pin, Greenpak4SimulationModel::PIN_LOW);
+	}
+	vsim.Settle();
+
+	//Change one input at a time, so every simulator sees each edge on its own
+	srand(1);
+	for(unsigned int step=0; step<1000; step++)
+	{
+		unsigned int pin = (rand() & 1) ? 3 : 5;
+		bool value = rand() & 1;
+
+		if(pin == 3)
+		{
+			//Each flipflop samples its D from just before the edge
+			if(value && !clk)
+			{
+				q1 = a;
+				q2 = !q2;
+				if(q2)
+					q3 = !q3;
+			}
+			clk = value;
+		}
+		else
+			a = value;
+
+		auto state = value ? Greenpak4SimulationModel::PIN_HIGH : Greenpak4SimulationModel::PIN_LOW;
+		sim.SetPinInput(pin, state);
+		vsim.SetPinInputs(pin, value ? ~0ULL : 0);
+		model.SetPinInput(pin, state);
+
+		time += 1000000;
+		sim.RunUntil(time);
+		vsim.Settle();
+		model.RunUntil(time);
+
+		bool ok = CheckPin(sim, vsim, model, step, 4, q1);
+		ok &= CheckPin(sim, vsim, model, step, 7, q2);
+		ok &= CheckPin(sim, vsim, model, step, 8, q3);
+		if(!ok)
+			return false;
+	}
+
+	LogNotice("All simulators agree\n");
+	return true;
+}
@@ -0,0 +1,91 @@
+/***********************************************************************************************************************
+ * Copyright (C) 2016 Andrew Zonenberg and contributors                                                                *
+ *                                                                                                                     *
+ * This program is free software; you can redistribute it and/or modify it under the terms of the GNU Lesser General   *
+ * Public License as published by the Free Software Foundation; either version 2.1 of the License, or (at your option) *
+ * any later version.                                                                                                  *
+ *                                                                                                                     *
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied  *
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for     *
+ * more details.                                                                                                       *
+ *                                                                                                                     *
+ * You should have received a copy of the GNU Lesser General Public License along with this program; if not, you may   *
+ * find one here:                                                                                                      *
+ * https://www.gnu.org/licenses/old-licenses/lgpl-2.1.txt                                                              *
+ * or you may search the http://www.gnu.org website for the version 2.1 license, or you may write to the Free Software *
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA                                      *
+ **********************************************************************************************************************/
+
+`default_nettype none
+
+/**
+	Flipflops whose D depends on their own clock, so they only work if D is sampled as it was before the edge.
+
+	INPUTS:
+		Clock on pin 3, data on pin 5
+
+	OUTPUTS:
+		P4 is the value of P5 at the last rising edge of P3.
+		P7 toggles on every rising edge of P3.
+		P8 toggles on every rising edge of P7.
+ */
+module ClockFeedback(clk, a, q1, q2, q3);
+
+	////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+	// I/O declarations
+
+	(* LOC = "P3" *)
+	input wire clk;
+
+	(* LOC = "P5" *)
+	input wire a;
+
+	(* LOC = "P4" *)
+	output wire q1;
+
+	(* LOC = "P7" *)
+	output wire q2;
+
+	(* LOC = "P8" *)
+	output wire q3;
+
+	////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+	// D is a ^ clk, which is just a until the edge gets through the LUT
+
+	wire d1 = a ^ clk;
+
+	GP_DFF #(
+		.INIT(1'b0)
+	) ff1 (
+		.D(d1),
+		.CLK(clk),
+		.Q(q1)
+	);
+
+	////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+	// D is ~(q2 | clk), which is ~q2 until the edge gets through the LUT
+
+	wire d2 = ~(q2 | clk);
+
+	GP_DFF #(
+		.INIT(1'b0)
+	) ff2 (
+		.D(d2),
+		.CLK(clk),
+		.Q(q2)
+	);
+
+	////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+	// The same again, clocked by ff2
+
+	wire d3 = ~(q3 | q2);
+
+	GP_DFF #(
+		.INIT(1'b0)
+	) ff3 (
+		.D(d3),
+		.CLK(q2),
+		.Q(q3)
+	);
+
+endmodule
@@ -0,0 +1,57 @@
+/***********************************************************************************************************************
+ * Copyright (C) 2016 Andrew Zonenberg and contributors                                                                *
+ *                                                                                                                     *
+ * This program is free software; you can redistribute it and/or modify it under the terms of the GNU Lesser General   *
+ * Public License as published by the Free Software Foundation; either version 2.1 of the License, or (at your option) *
+ * any later version.                                                                                                  *
+ *                                                                                                                     *
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY; without even the implied  *
+ * warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for     *
+ * more details.                                                                                                       *
+ *                                                                                                                     *
+ * You should have received a copy of the GNU Lesser General Public License along with this program; if not, you may   *
+ * find one here:                                                                                                      *
+ * https://www.gnu.org/licenses/old-licenses/lgpl-2.1.txt                                                              *
+ * or you may search the http://www.gnu.org website for the version 2.1 license, or you may write to the Free Software *
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301, USA                                      *
+ **********************************************************************************************************************/
+
+
+`default_nettype none
+
+/**
+	An output-inverted flipflop at a known site, so the equivalence test can break its polarity bit.
+
+	INPUTS:
+		Data on pin 3, clock on pin 5
+
+	OUTPUTS:
+		P4 is the inverse of the value of P3 at the last rising edge of P5.
+ */
+module OutputInvert(d, clk, nq);
+
+	////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+	// I/O declarations
+
+	(* LOC = "P3" *)
+	input wire d;
+
+	(* LOC = "P5" *)
+	input wire clk;
+
+	(* LOC = "P4" *)
+	output wire nq;
+
+	////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+	// The flipflop (bit 690 is the output invert of DFF_3)
+
+	(* LOC = "DFF_3" *)
+	GP_DFFI #(
+		.INIT(1'b0)
+	) ff (
+		.D(d),
+		.CLK(clk),
+		.nQ(nq)
+	);
+
+endmodule
@@ -90,19 +90,12 @@ bool RunTest(hdevice hdev)
 		if(!ConfigureSiggen(hdev, INPUT_PIN, vtest))
 			return false;
 
-		//Read the input
-		if(!SelectADCChannel(hdev, INPUT_PIN))
-			return false;
-		double vin;
-		if(!ReadADC(hdev, vin))
-			return false;
-
-		//Read the output
-		if(!SelectADCChannel(hdev, OUTPUT_PIN))
-			return false;
-		double vout;
-		if(!ReadADC(hdev, vout))
+		//Read the input and output in one go
+		vector<double> samples;
+		if(!BurstReadADC(hdev, {INPUT_PIN, OUTPUT_PIN}, 1, samples))
 			return false;
+		double vin = samples[0];
+		double vout = samples[1];
 
 		double expected = vin * 2;
 		double error = expected - vout;